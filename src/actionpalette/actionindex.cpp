@@ -0,0 +1,254 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "actionindex.h"
+
+#include <KLocalizedString>
+
+#include <QAction>
+
+#include <algorithm>
+
+namespace {
+    const int WordStartBonus = 8;
+    const int ConsecutiveBonus = 4;
+    const int PrefixBonus = 6;
+
+    // A query that equals the shortcut of an action ranks the action first,
+    // a query that is only the start of a shortcut ranks it last
+    const int ShortcutScore = 1000;
+    const int ShortcutPrefixScore = 1;
+
+    bool isWordStart(const QString& text, int index)
+    {
+        return index == 0 || !text.at(index - 1).isLetterOrNumber();
+    }
+
+    int matchScore(const QString& query, const QString& text, bool preferWordStarts)
+    {
+        const int length = text.length();
+        int result = 0;
+        int position = 0;
+        for (int q = 0; q < query.length(); ++q) {
+            const QChar c = query.at(q);
+
+            int index = -1;
+            if (position < length && text.at(position) == c) {
+                index = position;
+            } else {
+                for (int i = position; i < length; ++i) {
+                    if (text.at(i) == c) {
+                        if (index < 0) {
+                            index = i;
+                        }
+                        if (!preferWordStarts || isWordStart(text, i)) {
+                            index = i;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            if (index < 0) {
+                return -1;
+            }
+
+            ++result;
+            if (isWordStart(text, index)) {
+                result += WordStartBonus;
+            }
+            if (index == position) {
+                result += (q == 0) ? PrefixBonus : ConsecutiveBonus;
+            }
+            position = index + 1;
+        }
+        return result;
+    }
+}
+
+ActionIndex::ActionIndex() :
+    m_entries(),
+    m_entryIndexes(),
+    m_lastQuery(),
+    m_candidates(),
+    m_candidatesValid(false)
+{
+}
+
+void ActionIndex::addAction(QAction* action, const QString& category)
+{
+    if (!action || action->isSeparator() || action->text().isEmpty()) {
+        return;
+    }
+
+    // The entry of a deleted action might have the same address
+    const auto it = m_entryIndexes.constFind(action);
+    if (it != m_entryIndexes.constEnd() && m_entries.at(it.value()).action == action) {
+        return;
+    }
+
+    Entry entry;
+    entry.action = action;
+    entry.category = category.toCaseFolded();
+    setEntryTexts(entry, action);
+    m_entryIndexes.insert(action, m_entries.count());
+    m_entries.append(entry);
+    resetCandidates();
+}
+
+void ActionIndex::updateAction(QAction* action)
+{
+    const auto it = m_entryIndexes.constFind(action);
+    if (it == m_entryIndexes.constEnd()) {
+        return;
+    }
+
+    Entry& entry = m_entries[it.value()];
+    if (entry.action == action) {
+        setEntryTexts(entry, action);
+        resetCandidates();
+    }
+}
+
+void ActionIndex::clear()
+{
+    m_entries.clear();
+    m_entryIndexes.clear();
+    resetCandidates();
+}
+
+int ActionIndex::count() const
+{
+    return m_entries.count();
+}
+
+void ActionIndex::truncate(int count)
+{
+    if (count < m_entries.count()) {
+        m_entries.resize(count);
+        for (auto it = m_entryIndexes.begin(); it != m_entryIndexes.end();) {
+            if (it.value() >= count) {
+                it = m_entryIndexes.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        resetCandidates();
+    }
+}
+
+QVector<QAction*> ActionIndex::match(const QString& query, int maximumCount)
+{
+    QVector<QAction*> actions;
+    const QString foldedQuery = query.trimmed().toCaseFolded();
+    if (foldedQuery.isEmpty()) {
+        for (const Entry& entry : qAsConst(m_entries)) {
+            if (actions.count() >= maximumCount) {
+                break;
+            }
+            if (entry.action && entry.action->isEnabled()) {
+                actions.append(entry.action);
+            }
+        }
+        resetCandidates();
+        return actions;
+    }
+
+    // Each entry that matches the extended query has matched the previous
+    // query, as the characters of both must appear in the same order
+    const bool narrowing = m_candidatesValid && foldedQuery.startsWith(m_lastQuery);
+    const int candidateCount = narrowing ? m_candidates.count() : m_entries.count();
+
+    struct Result
+    {
+        int score;
+        int index;
+    };
+    QVector<Result> results;
+    QVector<int> candidates;
+
+    for (int i = 0; i < candidateCount; ++i) {
+        const int index = narrowing ? m_candidates.at(i) : i;
+        const Entry& entry = m_entries.at(index);
+        if (!entry.action) {
+            continue;
+        }
+
+        int entryScore = score(foldedQuery, entry.text);
+        if (!entry.category.isEmpty()) {
+            const int categoryScore = score(foldedQuery, entry.category);
+            if (categoryScore >= 0) {
+                entryScore = qMax(entryScore, categoryScore / 2);
+            }
+        }
+        if (!entry.shortcut.isEmpty()) {
+            if (entry.shortcut == foldedQuery) {
+                entryScore = ShortcutScore;
+            } else if (entryScore < 0 && entry.shortcut.startsWith(foldedQuery)) {
+                entryScore = ShortcutPrefixScore;
+            }
+        }
+        if (entryScore < 0) {
+            continue;
+        }
+
+        candidates.append(index);
+        if (entry.action->isEnabled()) {
+            results.append({entryScore, index});
+        }
+    }
+
+    m_lastQuery = foldedQuery;
+    m_candidates = candidates;
+    m_candidatesValid = true;
+
+    // Shorter texts are closer to the query if the scores are equal
+    std::sort(results.begin(), results.end(), [this](const Result& a, const Result& b) {
+        if (a.score != b.score) {
+            return a.score > b.score;
+        }
+        const int lengthA = m_entries.at(a.index).text.length();
+        const int lengthB = m_entries.at(b.index).text.length();
+        if (lengthA != lengthB) {
+            return lengthA < lengthB;
+        }
+        return a.index < b.index;
+    });
+
+    const int count = qMin(maximumCount, results.count());
+    actions.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        actions.append(m_entries.at(results.at(i).index).action);
+    }
+    return actions;
+}
+
+QString ActionIndex::displayText(const QAction* action)
+{
+    return KLocalizedString::removeAcceleratorMarker(action->text());
+}
+
+void ActionIndex::setEntryTexts(Entry& entry, const QAction* action)
+{
+    entry.text = displayText(action).toCaseFolded();
+    entry.shortcut = action->shortcut().toString(QKeySequence::NativeText).toCaseFolded();
+}
+
+void ActionIndex::resetCandidates()
+{
+    m_lastQuery.clear();
+    m_candidates.clear();
+    m_candidatesValid = false;
+}
+
+int ActionIndex::score(const QString& query, const QString& text)
+{
+    // Preferring the starts of words matches "hf" at "Hidden Files" instead
+    // of "sHow ... Files", but can skip a character that is needed by the
+    // rest of the query
+    const int result = matchScore(query, text, true);
+    return result >= 0 ? result : matchScore(query, text, false);
+}
@@ -0,0 +1,103 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef ACTIONINDEX_H
+#define ACTIONINDEX_H
+
+#include "dolphin_export.h"
+
+#include <QHash>
+#include <QPointer>
+#include <QString>
+#include <QVector>
+
+class QAction;
+
+/**
+ * @brief Finds actions by a fuzzy match of their texts.
+ *
+ * The texts of the actions are normalized once when the actions are added,
+ * so that matching a query does not touch the actions except for checking
+ * whether they are enabled. A query matches an action if its characters
+ * appear in the same order in the text, the category or the shortcut of the
+ * action. Matches at the start of words and consecutive characters are
+ * ranked higher.
+ *
+ * If a query extends the previous query, only the actions that matched the
+ * previous query are matched again, so typing into the action palette stays
+ * fast independent from the number of actions.
+ */
+class DOLPHIN_EXPORT ActionIndex
+{
+public:
+    ActionIndex();
+
+    /**
+     * Adds \a action with the user visible \a category, for example the
+     * name of the menu or of the plugin that provides the action. Separators,
+     * actions without text and actions that have been added already, for
+     * example by another action collection, are ignored.
+     */
+    void addAction(QAction* action, const QString& category = QString());
+
+    /**
+     * Normalizes the text of \a action again after it has been changed.
+     */
+    void updateAction(QAction* action);
+
+    void clear();
+    int count() const;
+
+    /**
+     * Removes all actions except the first \a count actions.
+     */
+    void truncate(int count);
+
+    /**
+     * @return Up to \a maximumCount enabled actions that match \a query,
+     *         the best match first. An empty query matches all actions
+     *         in the order they have been added.
+     */
+    QVector<QAction*> match(const QString& query, int maximumCount);
+
+    /**
+     * @return The text of \a action without accelerator markers, as it
+     *         should be shown by the action palette.
+     */
+    static QString displayText(const QAction* action);
+
+private:
+    struct Entry
+    {
+        QPointer<QAction> action;
+        QString text;
+        QString category;
+        QString shortcut;
+    };
+
+    void setEntryTexts(Entry& entry, const QAction* action);
+    void resetCandidates();
+
+    /**
+     * @return Score of the fuzzy match of \a query in \a text, or -1 if
+     *         the characters of \a query do not appear in \a text in order.
+     */
+    static int score(const QString& query, const QString& text);
+
+private:
+    QVector<Entry> m_entries;
+
+    // Indexes of the entries of the actions, so that changed and
+    // added actions are found without iterating the entries
+    QHash<const QAction*, int> m_entryIndexes;
+
+    // Indexes of the entries that matched m_lastQuery
+    QString m_lastQuery;
+    QVector<int> m_candidates;
+    bool m_candidatesValid;
+};
+
+#endif
@@ -0,0 +1,243 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "actionpalette.h"
+
+#include <KActionCollection>
+#include <KActionMenu>
+#include <KFileItemActions>
+#include <KFileItemListProperties>
+#include <KLocalizedString>
+#include <KXMLGUIClient>
+#include <KXMLGUIFactory>
+#include <KXmlGuiWindow>
+
+#include <QAction>
+#include <QApplication>
+#include <QHeaderView>
+#include <QKeyEvent>
+#include <QLineEdit>
+#include <QMenu>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+namespace {
+    const int MaximumResultCount = 50;
+    const int MaximumWidth = 600;
+}
+
+ActionPalette::ActionPalette(KXmlGuiWindow* window) :
+    QFrame(window, Qt::Popup),
+    m_window(window),
+    m_queryInput(nullptr),
+    m_resultsList(nullptr),
+    m_indexTimer(nullptr),
+    m_indexDirty(true),
+    m_index(),
+    m_windowActionCount(0),
+    m_results(),
+    m_fileItemActions(nullptr),
+    m_contextMenu(nullptr)
+{
+    setFrameStyle(QFrame::StyledPanel | QFrame::Raised);
+
+    m_queryInput = new QLineEdit(this);
+    m_queryInput->setClearButtonEnabled(true);
+    m_queryInput->setPlaceholderText(i18nc("@info:placeholder", "Find action..."));
+    m_queryInput->installEventFilter(this);
+    connect(m_queryInput, &QLineEdit::textChanged, this, &ActionPalette::updateResults);
+
+    m_resultsList = new QTreeWidget(this);
+    m_resultsList->setColumnCount(2);
+    m_resultsList->setHeaderHidden(true);
+    m_resultsList->setRootIsDecorated(false);
+    m_resultsList->setUniformRowHeights(true);
+    m_resultsList->setFocusPolicy(Qt::NoFocus);
+    m_resultsList->header()->setStretchLastSection(false);
+    m_resultsList->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_resultsList->header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+    connect(m_resultsList, &QTreeWidget::itemActivated, this, [this](QTreeWidgetItem* item) {
+        triggerAction(m_resultsList->indexOfTopLevelItem(item));
+    });
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addWidget(m_queryInput);
+    layout->addWidget(m_resultsList);
+
+    m_indexTimer = new QTimer(this);
+    m_indexTimer->setSingleShot(true);
+    m_indexTimer->setInterval(0);
+    connect(m_indexTimer, &QTimer::timeout, this, &ActionPalette::updateIndex);
+
+    KXMLGUIFactory* factory = m_window->guiFactory();
+    connect(factory, &KXMLGUIFactory::clientAdded, this, &ActionPalette::scheduleIndexUpdate);
+    connect(factory, &KXMLGUIFactory::clientRemoved, this, &ActionPalette::scheduleIndexUpdate);
+}
+
+ActionPalette::~ActionPalette()
+{
+    delete m_contextMenu;
+    delete m_fileItemActions;
+}
+
+void ActionPalette::prepareIndexWhenIdle()
+{
+    if (m_indexDirty) {
+        m_indexTimer->start();
+    }
+}
+
+void ActionPalette::popup(const KFileItemListProperties& selection)
+{
+    if (m_indexDirty) {
+        updateIndex();
+    }
+
+    // The service menu actions are resolved for the current selection,
+    // as they are resolved for the context menu
+    m_index.truncate(m_windowActionCount);
+    delete m_contextMenu;
+    delete m_fileItemActions;
+    m_fileItemActions = new KFileItemActions(this);
+    m_fileItemActions->setParentWidget(m_window);
+    m_fileItemActions->setItemListProperties(selection);
+    m_contextMenu = new QMenu();
+    if (!selection.items().isEmpty()) {
+        m_fileItemActions->addActionsTo(m_contextMenu, KFileItemActions::MenuActionSource::All);
+    }
+    addContextActions(m_contextMenu, QString());
+
+    const QWidget* anchor = m_window->centralWidget() ? m_window->centralWidget() : m_window;
+    const int width = qMin(MaximumWidth, anchor->width() * 2 / 3);
+    resize(width, anchor->height() / 2);
+    move(anchor->mapToGlobal(QPoint((anchor->width() - width) / 2, 0)));
+
+    m_queryInput->clear();
+    updateResults();
+    show();
+    m_queryInput->setFocus();
+}
+
+bool ActionPalette::eventFilter(QObject* watched, QEvent* event)
+{
+    if (watched == m_queryInput && event->type() == QEvent::KeyPress) {
+        QKeyEvent* keyEvent = static_cast<QKeyEvent*>(event);
+        switch (keyEvent->key()) {
+        case Qt::Key_Up:
+        case Qt::Key_Down:
+        case Qt::Key_PageUp:
+        case Qt::Key_PageDown:
+            QApplication::sendEvent(m_resultsList, event);
+            return true;
+        case Qt::Key_Return:
+        case Qt::Key_Enter:
+            triggerAction(m_resultsList->indexOfTopLevelItem(m_resultsList->currentItem()));
+            return true;
+        case Qt::Key_Escape:
+            hide();
+            return true;
+        default:
+            break;
+        }
+    }
+    return QFrame::eventFilter(watched, event);
+}
+
+void ActionPalette::scheduleIndexUpdate()
+{
+    m_indexDirty = true;
+    m_indexTimer->start();
+}
+
+void ActionPalette::updateIndex()
+{
+    m_indexTimer->stop();
+    m_indexDirty = false;
+    m_index.clear();
+
+    const QList<KXMLGUIClient*> clients = m_window->guiFactory()->clients();
+    for (const KXMLGUIClient* client : clients) {
+        KActionCollection* collection = client->actionCollection();
+        if (!collection) {
+            continue;
+        }
+        connect(collection, &KActionCollection::changed,
+                this, &ActionPalette::scheduleIndexUpdate, Qt::UniqueConnection);
+
+        // The actions of plugins are found by the name of the plugin
+        const QString category = (client == m_window) ? QString() : collection->componentDisplayName();
+        const QList<QAction*> actions = collection->actions();
+        for (QAction* action : actions) {
+            // Triggering a menu action does not show its menu
+            if (qobject_cast<KActionMenu*>(action)) {
+                continue;
+            }
+            m_index.addAction(action, category);
+            connect(action, &QAction::changed, this, &ActionPalette::slotActionChanged, Qt::UniqueConnection);
+        }
+    }
+
+    m_windowActionCount = m_index.count();
+    if (isVisible()) {
+        // The service menu actions of the shown palette are still valid
+        if (m_contextMenu) {
+            addContextActions(m_contextMenu, QString());
+        }
+        updateResults();
+    }
+}
+
+void ActionPalette::addContextActions(const QMenu* menu, const QString& category)
+{
+    const QList<QAction*> actions = menu->actions();
+    for (QAction* action : actions) {
+        if (action->menu()) {
+            addContextActions(action->menu(), ActionIndex::displayText(action));
+        } else {
+            m_index.addAction(action, category);
+        }
+    }
+}
+
+void ActionPalette::slotActionChanged()
+{
+    m_index.updateAction(qobject_cast<QAction*>(sender()));
+}
+
+void ActionPalette::updateResults()
+{
+    const QVector<QAction*> actions = m_index.match(m_queryInput->text(), MaximumResultCount);
+
+    m_results.clear();
+    m_resultsList->clear();
+    for (QAction* action : actions) {
+        QTreeWidgetItem* item = new QTreeWidgetItem(m_resultsList);
+        item->setIcon(0, action->icon());
+        item->setText(0, ActionIndex::displayText(action));
+        item->setText(1, action->shortcut().toString(QKeySequence::NativeText));
+        m_results.append(action);
+    }
+
+    if (m_resultsList->topLevelItemCount() > 0) {
+        m_resultsList->setCurrentItem(m_resultsList->topLevelItem(0));
+    }
+}
+
+void ActionPalette::triggerAction(int row)
+{
+    if (row < 0 || row >= m_results.count()) {
+        return;
+    }
+
+    // The action might show a dialog or a menu, which requires
+    // that the palette does not grab the input anymore
+    const QPointer<QAction> action = m_results.at(row);
+    hide();
+    if (action && action->isEnabled()) {
+        action->trigger();
+    }
+}
@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef ACTIONPALETTE_H
+#define ACTIONPALETTE_H
+
+#include "actionpalette/actionindex.h"
+
+#include <QFrame>
+#include <QPointer>
+
+class KFileItemActions;
+class KFileItemListProperties;
+class KXmlGuiWindow;
+class QLineEdit;
+class QMenu;
+class QTimer;
+class QTreeWidget;
+
+/**
+ * @brief Popup that finds and triggers the actions of a window by typing.
+ *
+ * The actions of all action collections of the window are indexed by
+ * ActionIndex when the event loop is idle, so that showing the palette and
+ * typing into it does not iterate the menus of the window. The index is
+ * updated if a GUI client or an action is added, removed or changed.
+ *
+ * The service menu actions depend on the selected items and are added to
+ * the index each time the palette is shown.
+ */
+class ActionPalette : public QFrame
+{
+    Q_OBJECT
+
+public:
+    explicit ActionPalette(KXmlGuiWindow* window);
+    ~ActionPalette() override;
+
+    /**
+     * Builds the index as soon as the event loop is idle.
+     */
+    void prepareIndexWhenIdle();
+
+    /**
+     * Shows the palette at the top of the window. The service menu
+     * actions for \a selection are matched in addition to the actions
+     * of the window.
+     */
+    void popup(const KFileItemListProperties& selection);
+
+protected:
+    bool eventFilter(QObject* watched, QEvent* event) override;
+
+private:
+    void scheduleIndexUpdate();
+    void updateIndex();
+    void addContextActions(const QMenu* menu, const QString& category);
+    void slotActionChanged();
+    void updateResults();
+    void triggerAction(int row);
+
+private:
+    KXmlGuiWindow* m_window;
+    QLineEdit* m_queryInput;
+    QTreeWidget* m_resultsList;
+    QTimer* m_indexTimer;
+    bool m_indexDirty;
+
+    ActionIndex m_index;
+    int m_windowActionCount; // The actions after it are service menu actions
+    QVector<QPointer<QAction>> m_results;
+
+    // Own the service menu actions while the palette is shown
+    KFileItemActions* m_fileItemActions;
+    QMenu* m_contextMenu;
+};
+
+#endif
@@ -7,13 +7,25 @@
 #include "dbusinterface.h"
 #include "global.h"
 #include "dolphin_generalsettings.h"
+#include "dolphinmainwindow.h"
+#include "dolphinplacesmodelsingleton.h"
 
+#include <KFilePlacesModel>
 #include <KPropertiesDialog>
+#include <KStartupInfo>
 
 #include <QApplication>
 #include <QDBusConnection>
 #include <QDBusInterface>
 #include <QDBusConnectionInterface>
+#include <QIcon>
+#include <QTimer>
+
+namespace {
+    // Delay before a new hidden main window is prepared after the previous
+    // one has been shown. Gives the shown window the time to load its folders.
+    const int SpareWindowDelay = 3000;
+}
 
 DBusInterface::DBusInterface() :
     QObject()
@@ -26,28 +38,32 @@ DBusInterface::DBusInterface() :
 
 void DBusInterface::ShowFolders(const QStringList& uriList, const QString& startUpId)
 {
-    Q_UNUSED(startUpId)
     const QList<QUrl> urls = Dolphin::validateUris(uriList);
     if (urls.isEmpty()) {
         return;
     }
     const auto serviceName = isDaemon() ? QString() : QStringLiteral("org.kde.dolphin-%1").arg(QCoreApplication::applicationPid());
-    if(!Dolphin::attachToExistingInstance(urls, false, GeneralSettings::splitView(), serviceName)) {
+    if (Dolphin::attachToExistingInstance(urls, false, GeneralSettings::splitView(), serviceName)) {
+        return;
+    }
+    if (!isDaemon() || !showInSpareWindow(urls, false, startUpId)) {
         Dolphin::openNewWindow(urls);
     }
 }
 
 void DBusInterface::ShowItems(const QStringList& uriList, const QString& startUpId)
 {
-    Q_UNUSED(startUpId)
     const QList<QUrl> urls = Dolphin::validateUris(uriList);
     if (urls.isEmpty()) {
         return;
     }
     const auto serviceName = isDaemon() ? QString() : QStringLiteral("org.kde.dolphin-%1").arg(QCoreApplication::applicationPid());
-    if(!Dolphin::attachToExistingInstance(urls, true, GeneralSettings::splitView(), serviceName)) {
+    if (Dolphin::attachToExistingInstance(urls, true, GeneralSettings::splitView(), serviceName)) {
+        return;
+    }
+    if (!isDaemon() || !showInSpareWindow(urls, true, startUpId)) {
         Dolphin::openNewWindow(urls, nullptr, Dolphin::OpenNewWindowFlag::Select);
-    };
+    }
 }
 
 void DBusInterface::ShowItemProperties(const QStringList& uriList, const QString& startUpId)
@@ -62,9 +78,63 @@ void DBusInterface::ShowItemProperties(const QStringList& uriList, const QString
 void DBusInterface::setAsDaemon()
 {
     m_isDaemon = true;
+    QTimer::singleShot(0, this, [this]() {
+        prepareSpareWindow();
+    });
 }
 
 bool DBusInterface::isDaemon() const
 {
     return m_isDaemon;
 }
+
+void DBusInterface::prepareSpareWindow()
+{
+    if (m_spareWindow) {
+        return;
+    }
+
+    // The window stays hidden and is not polished yet, so it is not
+    // registered on the session bus and cannot be found by
+    // Dolphin::attachToExistingInstance() before it is shown.
+    m_spareWindow = new DolphinMainWindow();
+
+    // Warm up the places and the icon theme, which are shared with
+    // the window once it is shown.
+    DolphinPlacesModelSingleton::instance().placesModel()->rowCount();
+    QIcon::fromTheme(QStringLiteral("folder")).pixmap(16, 16);
+    QIcon::fromTheme(QStringLiteral("inode-directory")).pixmap(16, 16);
+}
+
+bool DBusInterface::showInSpareWindow(const QList<QUrl>& urls, bool openFiles, const QString& startUpId)
+{
+    if (!m_spareWindow) {
+        return false;
+    }
+
+    DolphinMainWindow* window = m_spareWindow;
+    m_spareWindow = nullptr;
+
+    const bool splitView = GeneralSettings::splitView();
+    QList<QUrl> dirs = urls;
+    if (splitView && dirs.size() < 2) {
+        // Split view does only make sense if we have at least 2 URLs
+        dirs.append(dirs.last());
+    }
+    if (openFiles) {
+        window->openFiles(dirs, splitView);
+    } else {
+        window->openDirectories(dirs, splitView);
+    }
+
+    if (!startUpId.isEmpty()) {
+        KStartupInfo::setStartupId(startUpId.toUtf8());
+    }
+    window->show();
+    window->activateWindow();
+
+    QTimer::singleShot(SpareWindowDelay, this, [this]() {
+        prepareSpareWindow();
+    });
+    return true;
+}
@@ -7,7 +7,13 @@
 #ifndef DBUSINTERFACE_H
 #define DBUSINTERFACE_H
 
+#include "dbusmetricsinterface.h"
+
 #include <QObject>
+#include <QPointer>
+#include <QUrl>
+
+class DolphinMainWindow;
 
 class DBusInterface : QObject
 {
@@ -22,6 +28,11 @@ public:
 
     /**
      * Set whether this interface has been created by dolphin --daemon.
+     * The daemon keeps a hidden main window ready, so that requests
+     * to show folders or items can be answered without creating
+     * a new process. As the session management is disabled for the
+     * daemon, the windows that it has shown are not restored after
+     * logging in again.
      */
     void setAsDaemon();
 
@@ -30,8 +41,24 @@ public:
      */
     bool isDaemon() const;
 
+private:
+    /**
+     * Creates the hidden main window that is used by showInSpareWindow(),
+     * if none exists yet.
+     */
+    void prepareSpareWindow();
+
+    /**
+     * Opens \a urls in the hidden main window and shows it. A new
+     * hidden main window is prepared after a delay.
+     * @return True if a hidden main window has been available.
+     */
+    bool showInSpareWindow(const QList<QUrl>& urls, bool openFiles, const QString& startUpId);
+
 private:
     bool m_isDaemon = false;
+    QPointer<DolphinMainWindow> m_spareWindow;
+    DBusMetricsInterface m_metrics;
 };
 
 #endif // DBUSINTERFACE_H
@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "dbusmetricsinterface.h"
+
+#include "dolphinmainwindow.h"
+#include "kitemviews/private/kitemlistmetrics.h"
+#include "kitemviews/private/kmemorybudget.h"
+
+#include <QApplication>
+#include <QDBusConnection>
+#include <QFile>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+DBusMetricsInterface::DBusMetricsInterface() :
+    QObject(),
+    m_uptime()
+{
+    m_uptime.start();
+    QDBusConnection::sessionBus().registerObject(QStringLiteral("/org/kde/dolphin/Metrics"), this,
+            QDBusConnection::ExportScriptableContents);
+}
+
+DBusMetricsInterface::~DBusMetricsInterface()
+{
+    QDBusConnection::sessionBus().unregisterObject(QStringLiteral("/org/kde/dolphin/Metrics"));
+}
+
+QVariantMap DBusMetricsInterface::Metrics() const
+{
+    QVariantMap metrics;
+
+    const KItemListMetrics& itemListMetrics = KItemListMetrics::instance();
+    for (int i = 0; i < KItemListMetrics::MetricCount; ++i) {
+        const auto metric = static_cast<KItemListMetrics::Metric>(i);
+        metrics.insert(KItemListMetrics::name(metric), itemListMetrics.value(metric));
+    }
+
+    const KMemoryBudget& memoryBudget = KMemoryBudget::instance();
+    metrics.insert(QStringLiteral("memoryEstimatedBytes"), memoryBudget.totalUsage());
+    metrics.insert(QStringLiteral("memoryBudgetBytes"), memoryBudget.budget());
+    metrics.insert(QStringLiteral("memoryResidentBytes"), residentMemory());
+
+    // The hidden window that is kept ready by the daemon is counted as well
+    int windows = 0;
+    int tabs = 0;
+    const QWidgetList topLevelWidgets = QApplication::topLevelWidgets();
+    for (QWidget* widget : topLevelWidgets) {
+        if (const DolphinMainWindow* window = qobject_cast<DolphinMainWindow*>(widget)) {
+            ++windows;
+            tabs += window->tabCount();
+        }
+    }
+    metrics.insert(QStringLiteral("windows"), windows);
+    metrics.insert(QStringLiteral("tabs"), tabs);
+
+    metrics.insert(QStringLiteral("uptimeSecs"), m_uptime.elapsed() / 1000);
+    return metrics;
+}
+
+qint64 DBusMetricsInterface::residentMemory()
+{
+#ifdef Q_OS_LINUX
+    // The second field is the number of resident pages
+    QFile file(QStringLiteral("/proc/self/statm"));
+    if (file.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> fields = file.readAll().split(' ');
+        if (fields.count() >= 2) {
+            bool ok = false;
+            const qint64 pages = fields.at(1).toLongLong(&ok);
+            if (ok) {
+                return pages * sysconf(_SC_PAGESIZE);
+            }
+        }
+    }
+#endif
+    return -1;
+}
@@ -0,0 +1,50 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef DBUSMETRICSINTERFACE_H
+#define DBUSMETRICSINTERFACE_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QVariantMap>
+
+/**
+ * @brief Provides the metrics of the process as D-Bus object /org/kde/dolphin/Metrics.
+ *
+ * Allows to monitor processes that are running for a long time, like
+ * dolphin --daemon, e.g. by scraping the metrics periodically with
+ * "qdbus org.kde.dolphin-<pid> /org/kde/dolphin/Metrics Metrics".
+ */
+class DBusMetricsInterface : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.dolphin.Metrics")
+
+public:
+    DBusMetricsInterface();
+    ~DBusMetricsInterface() override;
+
+    /**
+     * @return The counters and gauges of KItemListMetrics, e.g. "itemsLoaded"
+     *         or "sortNsecs", together with the memory usage estimated by
+     *         KMemoryBudget ("memoryEstimatedBytes", "memoryBudgetBytes"),
+     *         the resident memory of the process ("memoryResidentBytes",
+     *         only on Linux), the number of windows and tabs and the
+     *         uptime in seconds.
+     */
+    Q_SCRIPTABLE QVariantMap Metrics() const;
+
+private:
+    /**
+     * @return Resident memory of the process in bytes, or -1 if unknown.
+     */
+    static qint64 residentMemory();
+
+private:
+    QElapsedTimer m_uptime;
+};
+
+#endif // DBUSMETRICSINTERFACE_H
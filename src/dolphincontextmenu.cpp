@@ -39,6 +39,21 @@
 #include <QKeyEvent>
 #include <QMenuBar>
 #include <QMimeDatabase>
+#include <QSet>
+
+namespace {
+    // Maximum number of kinds of selections whose actions are remembered
+    // as resolved, see DolphinContextMenu::prewarm()
+    const int MaximumResolvedSelectionKinds = 100;
+
+    QString openWithConstraint()
+    {
+        // Dolphin itself is not offered in the "Open With" entries
+        return QStringLiteral("DesktopEntryName != '%1'").arg(qApp->desktopFileName());
+    }
+}
+
+Q_GLOBAL_STATIC(QSet<QString>, s_resolvedSelectionKinds)
 
 DolphinContextMenu::DolphinContextMenu(DolphinMainWindow* parent,
                                        const QPoint& pos,
@@ -51,7 +66,7 @@ DolphinContextMenu::DolphinContextMenu(DolphinMainWindow* parent,
     m_baseUrl(baseUrl),
     m_baseFileItem(nullptr),
     m_selectedItems(),
-    m_selectedItemsProperties(nullptr),
+    m_selectedItemsProperties(),
     m_context(NoContext),
     m_copyToMenu(parent),
     m_customActions(),
@@ -60,8 +75,11 @@ DolphinContextMenu::DolphinContextMenu(DolphinMainWindow* parent,
 {
     // The context menu either accesses the URLs of the selected items
     // or the items itself. To increase the performance both lists are cached.
+    // The view determines the capabilities only once per selection, and
+    // they are shared by copying them.
     const DolphinView* view = m_mainWindow->activeViewContainer()->view();
-    m_selectedItems = view->selectedItems();
+    m_selectedItemsProperties = view->selectedItemsProperties();
+    m_selectedItems = m_selectedItemsProperties.items();
 
     installEventFilter(this);
 }
@@ -70,8 +88,6 @@ DolphinContextMenu::~DolphinContextMenu()
 {
     delete m_baseFileItem;
     m_baseFileItem = nullptr;
-    delete m_selectedItemsProperties;
-    m_selectedItemsProperties = nullptr;
 }
 
 void DolphinContextMenu::setCustomActions(const QList<QAction*>& actions)
@@ -227,6 +243,7 @@ void DolphinContextMenu::openItemContextMenu()
     KFileItemActions fileItemActions;
     fileItemActions.setParentWidget(m_mainWindow);
     fileItemActions.setItemListProperties(selectedItemsProps);
+    markResolved(selectedItemsProps);
 
     if (m_selectedItems.count() == 1) {
         // single files
@@ -318,6 +335,7 @@ void DolphinContextMenu::openViewportContextMenu()
     KFileItemActions fileItemActions;
     fileItemActions.setParentWidget(m_mainWindow);
     fileItemActions.setItemListProperties(baseUrlProperties);
+    markResolved(baseUrlProperties);
 
     // Set up and insert 'Create New' menu
     KNewFileMenu* newFileMenu = m_mainWindow->newFileMenu();
@@ -470,12 +488,9 @@ QAction* DolphinContextMenu::createPasteAction()
     return action;
 }
 
-KFileItemListProperties& DolphinContextMenu::selectedItemsProperties() const
+const KFileItemListProperties& DolphinContextMenu::selectedItemsProperties() const
 {
-    if (!m_selectedItemsProperties) {
-        m_selectedItemsProperties = new KFileItemListProperties(m_selectedItems);
-    }
-    return *m_selectedItemsProperties;
+    return m_selectedItemsProperties;
 }
 
 KFileItem DolphinContextMenu::baseFileItem()
@@ -492,10 +507,61 @@ KFileItem DolphinContextMenu::baseFileItem()
     return *m_baseFileItem;
 }
 
+void DolphinContextMenu::prewarm(DolphinMainWindow* mainWindow, const KFileItemListProperties& properties)
+{
+    if (properties.items().isEmpty() || !markResolved(properties)) {
+        return;
+    }
+
+    // The actions are created like for a context menu, but the menu is never shown
+    QMenu menu;
+    KFileItemActions fileItemActions;
+    fileItemActions.setParentWidget(mainWindow);
+    fileItemActions.setItemListProperties(properties);
+    fileItemActions.addOpenWithActionsTo(&menu, openWithConstraint());
+    fileItemActions.addActionsTo(&menu, KFileItemActions::MenuActionSource::All);
+}
+
+QString DolphinContextMenu::selectionKind(const KFileItemListProperties& properties)
+{
+    const KFileItemList& items = properties.items();
+    QSet<QString> mimeTypes;
+    for (const KFileItem& item : items) {
+        // Determining the MIME type by the content would block the main thread
+        mimeTypes.insert(item.isMimeTypeKnown() ? item.mimetype() : item.currentMimeType().name());
+    }
+    QStringList sortedMimeTypes = mimeTypes.values();
+    sortedMimeTypes.sort();
+
+    const QChar capabilities[] = {
+        items.count() == 1 ? QLatin1Char('1') : QLatin1Char('n'),
+        properties.isLocal() ? QLatin1Char('l') : QLatin1Char('-'),
+        properties.supportsWriting() ? QLatin1Char('w') : QLatin1Char('-'),
+        properties.supportsMoving() ? QLatin1Char('m') : QLatin1Char('-'),
+        properties.supportsDeleting() ? QLatin1Char('d') : QLatin1Char('-')
+    };
+    return QString(capabilities, 5) + QLatin1Char(':') + sortedMimeTypes.join(QLatin1Char(';'));
+}
+
+bool DolphinContextMenu::markResolved(const KFileItemListProperties& properties)
+{
+    QSet<QString>& resolvedKinds = *s_resolvedSelectionKinds;
+    if (resolvedKinds.count() >= MaximumResolvedSelectionKinds) {
+        resolvedKinds.clear();
+    }
+
+    const QString kind = selectionKind(properties);
+    if (resolvedKinds.contains(kind)) {
+        return false;
+    }
+    resolvedKinds.insert(kind);
+    return true;
+}
+
 void DolphinContextMenu::addOpenWithActions(KFileItemActions& fileItemActions)
 {
     // insert 'Open With...' action or sub menu
-    fileItemActions.addOpenWithActionsTo(this, QStringLiteral("DesktopEntryName != '%1'").arg(qApp->desktopFileName()));
+    fileItemActions.addOpenWithActionsTo(this, openWithConstraint());
 }
 
 void DolphinContextMenu::addCustomActions()
@@ -9,6 +9,7 @@
 
 #include <KFileCopyToMenu>
 #include <KFileItem>
+#include <KFileItemListProperties>
 
 #include <QMenu>
 #include <QUrl>
@@ -16,7 +17,6 @@
 class QAction;
 class DolphinMainWindow;
 class KFileItemActions;
-class KFileItemListProperties;
 class DolphinRemoveAction;
 
 /**
@@ -73,6 +73,16 @@ public:
      */
     Command open();
 
+    /**
+     * Resolves the "Open With" entries, service menus and plugin actions
+     * for items with the capabilities \a properties without showing them.
+     * Is invoked while Dolphin is idle, so that opening the first context
+     * menu for a kind of selection does not need to load the service menus
+     * and plugins. Each kind of selection, given by the MIME types, the
+     * number of items and the capabilities, is only prepared once.
+     */
+    static void prewarm(DolphinMainWindow* mainWindow, const KFileItemListProperties& properties);
+
 protected:
     void childEvent(QChildEvent* event) override;
     bool eventFilter(QObject* dest, QEvent* event) override;
@@ -95,13 +105,28 @@ private:
 
     QAction* createPasteAction();
 
-    KFileItemListProperties& selectedItemsProperties() const;
+    const KFileItemListProperties& selectedItemsProperties() const;
 
     /**
      * Returns the file item for m_baseUrl.
      */
     KFileItem baseFileItem();
 
+    /**
+     * @return Key for the kind of selection with the capabilities
+     *         \a properties, see prewarm(). The MIME types are only
+     *         determined by the names of the items, if they are not
+     *         known yet.
+     */
+    static QString selectionKind(const KFileItemListProperties& properties);
+
+    /**
+     * Remembers that the actions for the selection with the capabilities
+     * \a properties have been resolved.
+     * @return True if they have not been resolved before.
+     */
+    static bool markResolved(const KFileItemListProperties& properties);
+
     /**
      * Adds "Open With" actions
      */
@@ -147,7 +172,7 @@ private:
     KFileItem* m_baseFileItem;  /// File item for m_baseUrl
 
     KFileItemList m_selectedItems;
-    mutable KFileItemListProperties* m_selectedItemsProperties;
+    KFileItemListProperties m_selectedItemsProperties;  /// Capabilities of m_selectedItems
 
     int m_context;
     KFileCopyToMenu m_copyToMenu;
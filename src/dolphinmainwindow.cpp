@@ -11,6 +11,10 @@
 #include "dolphinmainwindowadaptor.h"
 #include "config-terminal.h"
 #include "global.h"
+#include "kitemviews/private/kmemorybudget.h"
+#include "kitemviews/private/kitemlisttracer.h"
+#include "kitemviews/private/kpluginregistry.h"
+#include "actionpalette/actionpalette.h"
 #include "dolphinbookmarkhandler.h"
 #include "dolphindockwidget.h"
 #include "dolphincontextmenu.h"
@@ -31,6 +35,9 @@
 #include "views/dolphinviewactionhandler.h"
 #include "views/dolphinremoteencoding.h"
 #include "views/draganddrophelper.h"
+#include "views/fileoperationqueue.h"
+#include "views/fileoperationsdialog.h"
+#include "views/localoperationundo.h"
 #include "views/viewproperties.h"
 #include "views/dolphinnewfilemenuobserver.h"
 #include "dolphin_generalsettings.h"
@@ -88,6 +95,30 @@ namespace {
     const int MaxNumberOfNavigationentries = 12;
     // The maximum number of "Activate Tab" shortcuts
     const int MaxActivateTabShortcuts = 9;
+    // Time in ms without selection changes after which the context menu is prepared
+    const int ContextMenuPrewarmDelay = 2000;
+
+    /**
+     * Takes the place of a panel in its dock until the panel is attached,
+     * so that the layout of the docks is the same as with the panel.
+     */
+    class PanelPlaceholder : public QWidget
+    {
+    public:
+        PanelPlaceholder(const Panel* panel, QWidget* parent) :
+            QWidget(parent),
+            m_panel(panel)
+        {
+        }
+
+        QSize sizeHint() const override
+        {
+            return m_panel->sizeHint();
+        }
+
+    private:
+        const Panel* m_panel;
+    };
 }
 
 DolphinMainWindow::DolphinMainWindow() :
@@ -100,17 +131,25 @@ DolphinMainWindow::DolphinMainWindow() :
     m_remoteEncoding(nullptr),
     m_settingsDialog(),
     m_bookmarkHandler(nullptr),
+    m_actionPalette(nullptr),
     m_controlButton(nullptr),
     m_updateToolBarTimer(nullptr),
+    m_contextMenuPrewarmTimer(nullptr),
     m_lastHandleUrlOpenJob(nullptr),
     m_terminalPanel(nullptr),
     m_placesPanel(nullptr),
     m_tearDownFromPlacesRequested(false),
+    m_deferredDockWidgets(),
+    m_deferredPartsInitialized(false),
     m_backAction(nullptr),
     m_forwardAction(nullptr)
 {
+    const KItemListTraceScope traceScope("DolphinMainWindow::DolphinMainWindow");
     Q_INIT_RESOURCE(dolphin);
 
+    // The plugins are discovered in parallel while the window is being set up
+    KPluginRegistry::instance().startDiscovery();
+
     new MainWindowAdaptor(this);
 
 #ifndef Q_OS_WIN
@@ -126,14 +165,26 @@ DolphinMainWindow::DolphinMainWindow() :
     undoManager->setUiInterface(new UndoUiInterface());
 
     connect(undoManager, QOverload<bool>::of(&KIO::FileUndoManager::undoAvailable),
-            this, &DolphinMainWindow::slotUndoAvailable);
+            this, &DolphinMainWindow::updateUndoAction);
     connect(undoManager, &KIO::FileUndoManager::undoTextChanged,
-            this, &DolphinMainWindow::slotUndoTextChanged);
+            this, &DolphinMainWindow::updateUndoAction);
+    connect(&LocalOperationUndo::instance(), &LocalOperationUndo::undoChanged,
+            this, &DolphinMainWindow::updateUndoAction);
+    connect(&LocalOperationUndo::instance(), &LocalOperationUndo::errorMessage,
+            this, &DolphinMainWindow::showErrorMessage);
     connect(undoManager, &KIO::FileUndoManager::jobRecordingStarted,
             this, &DolphinMainWindow::clearStatusBar);
     connect(undoManager, &KIO::FileUndoManager::jobRecordingFinished,
             this, &DolphinMainWindow::showCommand);
 
+    // The caches of all windows are trimmed if the system runs out of memory
+    KMemoryBudget::instance().startPressureMonitoring();
+
+    m_contextMenuPrewarmTimer = new QTimer(this);
+    m_contextMenuPrewarmTimer->setSingleShot(true);
+    m_contextMenuPrewarmTimer->setInterval(ContextMenuPrewarmDelay);
+    connect(m_contextMenuPrewarmTimer, &QTimer::timeout, this, &DolphinMainWindow::prewarmContextMenu);
+
     const bool firstRun = (GeneralSettings::version() < 200);
     if (firstRun) {
         GeneralSettings::setViewPropsTimestamp(QDateTime::currentDateTime());
@@ -221,6 +272,11 @@ QVector<DolphinViewContainer*> DolphinMainWindow::viewContainers() const
     return viewContainers;
 }
 
+int DolphinMainWindow::tabCount() const
+{
+    return m_tabWidget->count();
+}
+
 void DolphinMainWindow::setViewsWithInvalidPathsToHome()
 {
     const QVector<DolphinViewContainer*> theViewContainers = viewContainers();
@@ -605,6 +661,49 @@ void DolphinMainWindow::closeEvent(QCloseEvent* event)
         }
     }
 
+    // The file operations are shared by all windows of the process and
+    // get lost if the last window is closed
+    const int fileOperationsCount = FileOperationQueue::instance().operations().count();
+    if (fileOperationsCount > 0 && KMainWindow::memberList().count() == 1 && closedByUser) {
+        // Open a confirmation dialog with 3 buttons:
+        // QDialogButtonBox::Yes    -> Quit
+        // QDialogButtonBox::No     -> Show the file operations
+        // QDialogButtonBox::Cancel -> do nothing
+        QDialog *dialog = new QDialog(this, Qt::Dialog);
+        dialog->setWindowTitle(i18nc("@title:window", "Confirmation"));
+        dialog->setModal(true);
+        QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Yes | QDialogButtonBox::No | QDialogButtonBox::Cancel);
+        KGuiItem::assign(buttons->button(QDialogButtonBox::Yes), KStandardGuiItem::quit());
+        KGuiItem::assign(buttons->button(QDialogButtonBox::No),
+                         KGuiItem(i18n("Show &File Operations"), QIcon::fromTheme(QStringLiteral("view-process-tree"))));
+        KGuiItem::assign(buttons->button(QDialogButtonBox::Cancel), KStandardGuiItem::cancel());
+        buttons->button(QDialogButtonBox::Cancel)->setDefault(true);
+
+        const auto result = KMessageBox::createKMessageBox(
+                dialog,
+                buttons,
+                QMessageBox::Warning,
+                i18np("A copy or move operation has not been finished yet. It will be canceled if you quit. Are you sure you want to quit?",
+                      "%1 copy or move operations have not been finished yet. They will be canceled if you quit. Are you sure you want to quit?",
+                      fileOperationsCount),
+                QStringList(),
+                QString(),
+                nullptr,
+                KMessageBox::Dangerous);
+
+        switch (result) {
+            case QDialogButtonBox::Yes:
+                // Quit
+                break;
+            case QDialogButtonBox::No:
+                showFileOperations();
+                Q_FALLTHROUGH();
+            default:
+                event->ignore();
+                return;
+        }
+    }
+
     if (GeneralSettings::rememberOpenedTabs())  {
         KConfigGui::setSessionConfig(QStringLiteral("dolphin"), QStringLiteral("dolphin"));
         KConfig *config = KConfigGui::sessionConfig();
@@ -653,19 +752,22 @@ void DolphinMainWindow::showErrorMessage(const QString& message)
     m_activeViewContainer->showMessage(message, DolphinViewContainer::Error);
 }
 
-void DolphinMainWindow::slotUndoAvailable(bool available)
+void DolphinMainWindow::updateUndoAction()
 {
     QAction* undoAction = actionCollection()->action(KStandardAction::name(KStandardAction::Undo));
-    if (undoAction) {
-        undoAction->setEnabled(available);
+    if (!undoAction) {
+        return;
     }
-}
 
-void DolphinMainWindow::slotUndoTextChanged(const QString& text)
-{
-    QAction* undoAction = actionCollection()->action(KStandardAction::name(KStandardAction::Undo));
-    if (undoAction) {
-        undoAction->setText(text);
+    // The operation of LocalOperationUndo is newer than the ones of KIO
+    const LocalOperationUndo& localUndo = LocalOperationUndo::instance();
+    KIO::FileUndoManager* undoManager = KIO::FileUndoManager::self();
+    if (localUndo.isUndoAvailable()) {
+        undoAction->setEnabled(true);
+        undoAction->setText(localUndo.undoText());
+    } else {
+        undoAction->setEnabled(undoManager->isUndoAvailable());
+        undoAction->setText(undoManager->undoText());
     }
 }
 
@@ -673,7 +775,11 @@ void DolphinMainWindow::undo()
 {
     clearStatusBar();
     KIO::FileUndoManager::self()->uiInterface()->setParentWidget(this);
-    KIO::FileUndoManager::self()->undo();
+    if (LocalOperationUndo::instance().isUndoAvailable()) {
+        LocalOperationUndo::instance().undo();
+    } else {
+        KIO::FileUndoManager::self()->undo();
+    }
 }
 
 void DolphinMainWindow::cut()
@@ -713,6 +819,9 @@ void DolphinMainWindow::updatePasteAction()
 void DolphinMainWindow::slotDirectoryLoadingCompleted()
 {
     updatePasteAction();
+
+    // The root item of the view is known now
+    m_contextMenuPrewarmTimer->start();
 }
 
 void DolphinMainWindow::slotToolBarActionMiddleClicked(QAction *action)
@@ -953,6 +1062,29 @@ void DolphinMainWindow::goHomeInNewTab()
     openNewTab(Dolphin::homeUrl());
 }
 
+void DolphinMainWindow::showFileOperations()
+{
+    FileOperationsDialog* dialog = new FileOperationsDialog(this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->show();
+}
+
+void DolphinMainWindow::showActionPalette()
+{
+    if (!m_actionPalette) {
+        m_actionPalette = new ActionPalette(this);
+    }
+
+    const DolphinView* view = m_activeViewContainer->view();
+    if (view->selectedItemsCount() > 0) {
+        m_actionPalette->popup(view->selectedItemsProperties());
+    } else if (!view->rootItem().isNull()) {
+        m_actionPalette->popup(KFileItemListProperties(KFileItemList() << view->rootItem()));
+    } else {
+        m_actionPalette->popup(KFileItemListProperties());
+    }
+}
+
 void DolphinMainWindow::compareFiles()
 {
     const KFileItemList items = m_tabWidget->currentTabPage()->selectedItems();
@@ -1632,6 +1764,25 @@ void DolphinMainWindow::setupActions()
     compareFiles->setEnabled(false);
     connect(compareFiles, &QAction::triggered, this, &DolphinMainWindow::compareFiles);
 
+    QAction* showFileOperations = actionCollection()->addAction(QStringLiteral("file_operations"));
+    showFileOperations->setText(i18nc("@action:inmenu Tools", "File Operations..."));
+    showFileOperations->setWhatsThis(xi18nc("@info:whatsthis",
+        "<para>This shows the copy and move operations with their speed and remaining time.</para>"
+        "<para>Operations that write to the same device are queued, "
+        "they can be paused and reordered.</para>"));
+    showFileOperations->setIcon(QIcon::fromTheme(QStringLiteral("view-process-tree")));
+    connect(showFileOperations, &QAction::triggered, this, &DolphinMainWindow::showFileOperations);
+
+    QAction* findAction = actionCollection()->addAction(QStringLiteral("find_action"));
+    findAction->setText(i18nc("@action:inmenu Tools", "Find Action..."));
+    findAction->setWhatsThis(xi18nc("@info:whatsthis",
+        "<para>This opens a search field to find an action by typing "
+        "a part of its name and to trigger it with <shortcut>Enter</shortcut>.</para>"
+        "<para>Actions of the context menu for the selected items are found as well.</para>"));
+    findAction->setIcon(QIcon::fromTheme(QStringLiteral("search")));
+    actionCollection()->setDefaultShortcut(findAction, Qt::CTRL | Qt::ALT | Qt::Key_I);
+    connect(findAction, &QAction::triggered, this, &DolphinMainWindow::showActionPalette);
+
     QAction* openPreferredSearchTool = actionCollection()->addAction(QStringLiteral("open_preferred_search_tool"));
     openPreferredSearchTool->setText(i18nc("@action:inmenu Tools", "Open Preferred Search Tool"));
     openPreferredSearchTool->setWhatsThis(xi18nc("@info:whatsthis",
@@ -1774,7 +1925,7 @@ void DolphinMainWindow::setupDockWidgets()
     InformationPanel* infoPanel = new InformationPanel(infoDock);
     infoPanel->setCustomContextMenuActions({lockLayoutAction});
     connect(infoPanel, &InformationPanel::urlActivated, this, &DolphinMainWindow::handleUrl);
-    infoDock->setWidget(infoPanel);
+    setDeferredDockWidget(infoDock, infoPanel);
 
     QAction* infoAction = infoDock->toggleViewAction();
     createPanelAction(QIcon::fromTheme(QStringLiteral("dialog-information")), Qt::Key_F11, infoAction, QStringLiteral("show_information_panel"));
@@ -1815,7 +1966,7 @@ void DolphinMainWindow::setupDockWidgets()
     foldersDock->setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea);
     FoldersPanel* foldersPanel = new FoldersPanel(foldersDock);
     foldersPanel->setCustomContextMenuActions({lockLayoutAction});
-    foldersDock->setWidget(foldersPanel);
+    setDeferredDockWidget(foldersDock, foldersPanel);
 
     QAction* foldersAction = foldersDock->toggleViewAction();
     createPanelAction(QIcon::fromTheme(QStringLiteral("folder")), Qt::Key_F7, foldersAction, QStringLiteral("show_folders_panel"));
@@ -1849,7 +2000,7 @@ void DolphinMainWindow::setupDockWidgets()
         terminalDock->setObjectName(QStringLiteral("terminalDock"));
         m_terminalPanel = new TerminalPanel(terminalDock);
         m_terminalPanel->setCustomContextMenuActions({lockLayoutAction});
-        terminalDock->setWidget(m_terminalPanel);
+        setDeferredDockWidget(terminalDock, m_terminalPanel);
 
         connect(m_terminalPanel, &TerminalPanel::hideTerminalPanel, terminalDock, &DolphinDockWidget::hide);
         connect(m_terminalPanel, &TerminalPanel::changeUrl, this, &DolphinMainWindow::slotTerminalDirectoryChanged);
@@ -1900,7 +2051,7 @@ void DolphinMainWindow::setupDockWidgets()
 
     m_placesPanel = new PlacesPanel(placesDock);
     m_placesPanel->setCustomContextMenuActions({lockLayoutAction});
-    placesDock->setWidget(m_placesPanel);
+    setDeferredDockWidget(placesDock, m_placesPanel);
 
     QAction *placesAction = placesDock->toggleViewAction();
     createPanelAction(QIcon::fromTheme(QStringLiteral("compass")), Qt::Key_F9, placesAction, QStringLiteral("show_places_panel"));
@@ -1982,11 +2133,28 @@ void DolphinMainWindow::setupDockWidgets()
 }
 
 
+void DolphinMainWindow::prewarmContextMenu()
+{
+    if (!m_activeViewContainer || QApplication::activePopupWidget()) {
+        // Resolving the actions would block the shown menu
+        m_contextMenuPrewarmTimer->start();
+        return;
+    }
+
+    const DolphinView* view = m_activeViewContainer->view();
+    if (view->selectedItemsCount() > 0) {
+        DolphinContextMenu::prewarm(this, view->selectedItemsProperties());
+    } else if (!view->rootItem().isNull()) {
+        DolphinContextMenu::prewarm(this, KFileItemListProperties(KFileItemList() << view->rootItem()));
+    }
+}
+
 void DolphinMainWindow::updateFileAndEditActions()
 {
     const KFileItemList list = m_activeViewContainer->view()->selectedItems();
     const KActionCollection* col = actionCollection();
-    KFileItemListProperties capabilitiesSource(list);
+    const KFileItemListProperties& capabilitiesSource = m_activeViewContainer->view()->selectedItemsProperties();
+    m_contextMenuPrewarmTimer->start();
 
     QAction* addToPlacesAction = col->action(QStringLiteral("add_to_places"));
     QAction* copyToOtherViewAction   = col->action(QStringLiteral("copy_to_inactive_split_view"));
@@ -2149,6 +2317,31 @@ void DolphinMainWindow::refreshViews()
     Q_EMIT settingsChanged();
 }
 
+void DolphinMainWindow::initializeDeferredParts()
+{
+    for (const auto& dockWidget : qAsConst(m_deferredDockWidgets)) {
+        DolphinDockWidget* dock = dockWidget.first;
+        Panel* panel = dockWidget.second;
+        QWidget* placeholder = dock->widget();
+        dock->setWidget(panel);
+        delete placeholder;
+        // The panel creates its contents on the first show event, which
+        // is only received if the dock is visible.
+        panel->show();
+    }
+    m_deferredDockWidgets.clear();
+
+    Dolphin::logStartupPhase("panels attached");
+
+    m_newFileMenu->prepareTemplatesWhenIdle();
+
+    // The actions are indexed before the palette is shown the first time
+    if (!m_actionPalette) {
+        m_actionPalette = new ActionPalette(this);
+    }
+    m_actionPalette->prepareIndexWhenIdle();
+}
+
 void DolphinMainWindow::clearStatusBar()
 {
     m_activeViewContainer->statusBar()->resetToDefaultText();
@@ -2277,6 +2470,13 @@ void DolphinMainWindow::createPanelAction(const QIcon& icon,
     connect(dockAction, &QAction::toggled, panelAction, &QAction::setChecked);
 }
 
+void DolphinMainWindow::setDeferredDockWidget(DolphinDockWidget* dock, Panel* panel)
+{
+    panel->hide();
+    dock->setWidget(new PanelPlaceholder(panel, dock));
+    m_deferredDockWidgets.append(qMakePair(dock, panel));
+}
+
 void DolphinMainWindow::setupWhatsThis()
 {
     // main widgets
@@ -2440,6 +2640,14 @@ bool DolphinMainWindow::event(QEvent *event)
         QDesktopServices::openUrl(QUrl(whatsThisEvent->href()));
         return true;
     }
+
+    if (event->type() == QEvent::Paint && !m_deferredPartsInitialized) {
+        // The window has been painted the first time: Attach the
+        // panels as soon as the event loop gets idle.
+        m_deferredPartsInitialized = true;
+        Dolphin::logStartupPhase("main window painted");
+        QTimer::singleShot(0, this, &DolphinMainWindow::initializeDeferredParts);
+    }
     return KXmlGuiWindow::event(event);
 }
 
@@ -2509,3 +2717,8 @@ bool DolphinMainWindow::isUrlOpen(const QString& url)
     return m_tabWidget->isUrlOpen(QUrl::fromUserInput((url)));
 }
 
+QString DolphinMainWindow::memoryUsageReport() const
+{
+    return KMemoryBudget::instance().report();
+}
+
@@ -24,7 +24,9 @@
 
 typedef KIO::FileUndoManager::CommandType CommandType;
 
+class ActionPalette;
 class DolphinBookmarkHandler;
+class DolphinDockWidget;
 class DolphinViewActionHandler;
 class DolphinSettingsDialog;
 class DolphinViewContainer;
@@ -38,6 +40,7 @@ class KHelpMenu;
 class KToolBarPopupAction;
 class QToolButton;
 class QIcon;
+class Panel;
 class PlacesPanel;
 class TerminalPanel;
 
@@ -72,6 +75,11 @@ public:
      */
     QVector<DolphinViewContainer*> viewContainers() const;
 
+    /**
+     * @return Number of open tabs.
+     */
+    int tabCount() const;
+
     /**
      * Opens each directory in \p dirs in a separate tab. If \a splitView is set,
      * 2 directories are collected within one tab.
@@ -144,6 +152,13 @@ public Q_SLOTS:
      */
     bool isUrlOpen(const QString &url);
 
+    /**
+     * @return Report of the memory that is estimated to be used by the
+     *         models, views and caches of the process, see KMemoryBudget.
+     * @note This is a slot so that it is callable via DBus.
+     */
+    QString memoryUsageReport() const;
+
 
     /**
      * Pastes the clipboard data into the currently selected folder
@@ -231,6 +246,20 @@ private Q_SLOTS:
      */
     void refreshViews();
 
+    /**
+     * Attaches the panels to their docks. Is invoked after the main
+     * window has been painted the first time, so that the panels don't
+     * delay showing the window and the first folder.
+     */
+    void initializeDeferredParts();
+
+    /**
+     * Prepares the context menu for the selection of the active view, or
+     * for its folder if nothing is selected, see DolphinContextMenu::prewarm().
+     * Is invoked if the user has not changed the selection for a while.
+     */
+    void prewarmContextMenu();
+
     void clearStatusBar();
 
     /** Updates the 'Create New...' sub menu. */
@@ -242,13 +271,10 @@ private Q_SLOTS:
     void showErrorMessage(const QString& message);
 
     /**
-     * Updates the state of the 'Undo' menu action dependent
-     * on the parameter \a available.
+     * Updates the state and the text of the 'Undo' menu action dependent
+     * on the operations of KIO::FileUndoManager and LocalOperationUndo.
      */
-    void slotUndoAvailable(bool available);
-
-    /** Sets the text of the 'Undo' menu action to \a text. */
-    void slotUndoTextChanged(const QString& text);
+    void updateUndoAction();
 
     /** Performs the current undo operation. */
     void undo();
@@ -359,6 +385,15 @@ private Q_SLOTS:
     /** Opens Kompare for 2 selected files. */
     void compareFiles();
 
+    /** Shows the queued and running copy and move operations. */
+    void showFileOperations();
+
+    /**
+     * Shows the palette to find and trigger an action by typing
+     * a part of its name.
+     */
+    void showActionPalette();
+
     /**
      * Hides the menu bar if it is visible, makes the menu bar
      * visible if it is hidden.
@@ -610,6 +645,13 @@ private:
                            QAction* dockAction,
                            const QString& actionName);
 
+    /**
+     * Sets \a panel as widget of \a dock after the main window has been
+     * painted the first time, see initializeDeferredParts(). Until then the
+     * dock contains a placeholder with the size hint of the panel.
+     */
+    void setDeferredDockWidget(DolphinDockWidget* dock, Panel* panel);
+
     /** Adds "What's This?" texts to many widgets and StandardActions. */
     void setupWhatsThis();
 
@@ -639,10 +681,12 @@ private:
     DolphinRemoteEncoding* m_remoteEncoding;
     QPointer<DolphinSettingsDialog> m_settingsDialog;
     DolphinBookmarkHandler* m_bookmarkHandler;
+    ActionPalette* m_actionPalette;
 
     // Members for the toolbar menu that is shown when the menubar is hidden:
     QToolButton* m_controlButton;
     QTimer* m_updateToolBarTimer;
+    QTimer* m_contextMenuPrewarmTimer;
 
     KIO::OpenUrlJob *m_lastHandleUrlOpenJob;
 
@@ -650,6 +694,10 @@ private:
     PlacesPanel* m_placesPanel;
     bool m_tearDownFromPlacesRequested;
 
+    // Docks whose panels are attached by initializeDeferredParts()
+    QVector<QPair<DolphinDockWidget*, Panel*>> m_deferredDockWidgets;
+    bool m_deferredPartsInitialized;
+
     KToolBarPopupAction* m_backAction;
     KToolBarPopupAction* m_forwardAction;
 
@@ -30,7 +30,8 @@ DolphinNavigatorsWidgetAction::DolphinNavigatorsWidgetAction(QWidget *parent) :
     QWidgetAction{parent},
     m_splitter{new QSplitter(Qt::Horizontal)},
     m_adjustSpacingTimer{new QTimer(this)},
-    m_viewGeometriesHelper{m_splitter.get(), this}
+    m_viewGeometriesHelper{m_splitter.get(), this},
+    m_spacingInputs{}
 {
     updateText();
     setIcon(QIcon::fromTheme(QStringLiteral("dialog-scripts")));
@@ -48,6 +49,30 @@ DolphinNavigatorsWidgetAction::DolphinNavigatorsWidgetAction(QWidget *parent) :
 void DolphinNavigatorsWidgetAction::adjustSpacing()
 {
     auto viewGeometries = m_viewGeometriesHelper.viewGeometries();
+
+    const bool hasSecondary = m_splitter->count() > 1;
+    const QVector<int> spacingInputs = {
+        viewGeometries.globalXOfNavigatorsWidget,
+        viewGeometries.globalXOfPrimary,
+        viewGeometries.widthOfPrimary,
+        viewGeometries.globalXOfSecondary,
+        viewGeometries.widthOfSecondary,
+        m_splitter->width(),
+        m_splitter->widget(0)->width(),
+        hasSecondary ? m_splitter->widget(1)->width() : -1,
+        hasSecondary && m_splitter->widget(1)->isVisible(),
+        primaryUrlNavigator()->sizeHint().width(),
+        hasSecondary ? secondaryUrlNavigator()->sizeHint().width() : -1,
+        emptyTrashButton(Primary)->isVisible(),
+        networkFolderButton(Primary)->isVisible(),
+        hasSecondary && emptyTrashButton(Secondary)->isVisible(),
+        hasSecondary && networkFolderButton(Secondary)->isVisible()
+    };
+    if (spacingInputs == m_spacingInputs) {
+        return;
+    }
+    m_spacingInputs = spacingInputs;
+
     const int widthOfSplitterPrimary = viewGeometries.globalXOfPrimary + viewGeometries.widthOfPrimary - viewGeometries.globalXOfNavigatorsWidget;
     const QList<int> splitterSizes = {widthOfSplitterPrimary,
                                       m_splitter->width() - widthOfSplitterPrimary};
@@ -118,6 +143,7 @@ void DolphinNavigatorsWidgetAction::followViewContainersGeometry(QWidget *primar
                                                                  QWidget *secondaryViewContainer)
 {
     m_viewGeometriesHelper.setViewContainers(primaryViewContainer, secondaryViewContainer);
+    m_spacingInputs.clear();
     adjustSpacing();
 }
 
@@ -13,6 +13,7 @@
 #include <QPointer>
 #include <QSplitter>
 #include <QTimer>
+#include <QVector>
 #include <QWidgetAction>
 
 #include <memory>
@@ -216,6 +217,13 @@ private:
     };
 
     ViewGeometriesHelper m_viewGeometriesHelper;
+
+    /**
+     * The geometries and size hints the spacing has been adjusted for last.
+     * Moving to a sibling folder usually keeps them, so adjustSpacing() does
+     * not need to lay out the splitter again.
+     */
+    QVector<int> m_spacingInputs;
 };
 
 #endif // DOLPHINNAVIGATORSWIDGETACTION_H
@@ -11,6 +11,8 @@
 #include <KActionCollection>
 #include <KIO/Job>
 
+#include <QTimer>
+
 DolphinNewFileMenu::DolphinNewFileMenu(KActionCollection* collection, QObject* parent) :
     KNewFileMenu(collection, QStringLiteral("new_menu"), parent)
 {
@@ -22,6 +24,11 @@ DolphinNewFileMenu::~DolphinNewFileMenu()
     DolphinNewFileMenuObserver::instance().detach(this);
 }
 
+void DolphinNewFileMenu::prepareTemplatesWhenIdle()
+{
+    QTimer::singleShot(0, this, &DolphinNewFileMenu::checkUpToDate);
+}
+
 void DolphinNewFileMenu::slotResult(KJob* job)
 {
     if (job->error()) {
@@ -28,6 +28,14 @@ public:
     DolphinNewFileMenu(KActionCollection* collection, QObject* parent);
     ~DolphinNewFileMenu() override;
 
+    /**
+     * Reads the templates as soon as the event loop gets idle, so that the
+     * menu is shown without delay the first time. KNewFileMenu parses the
+     * templates once for all menus of the process and parses them again only
+     * if the template folders change, see KNewFileMenu::checkUpToDate().
+     */
+    void prepareTemplatesWhenIdle();
+
 Q_SIGNALS:
     void errorMessage(const QString& error);
 
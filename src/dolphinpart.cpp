@@ -162,6 +162,7 @@ void DolphinPart::createActions()
     m_newFileMenu->setParentWidget(widget());
     connect(m_newFileMenu->menu(), &QMenu::aboutToShow,
             this, &DolphinPart::updateNewMenu);
+    m_newFileMenu->prepareTemplatesWhenIdle();
 
     QAction *editMimeTypeAction = actionCollection()->addAction( QStringLiteral("editMimeType") );
     editMimeTypeAction->setText( i18nc("@action:inmenu Edit", "&Edit File Type..." ) );
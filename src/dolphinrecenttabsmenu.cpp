@@ -6,14 +6,24 @@
 
 #include "dolphinrecenttabsmenu.h"
 
+#include "dolphin_generalsettings.h"
+
 #include <KAcceleratorManager>
 #include <KLocalizedString>
 #include <kio/global.h>
 
 #include <QMenu>
 
+namespace {
+    // Number of closed tabs that are shown in the menu. More closed
+    // tabs can be restored by undoCloseTab().
+    const int MaximumShownTabs = 6;
+}
+
 DolphinRecentTabsMenu::DolphinRecentTabsMenu(QObject* parent) :
-    KActionMenu(QIcon::fromTheme(QStringLiteral("edit-undo")), i18n("Recently Closed Tabs"), parent)
+    KActionMenu(QIcon::fromTheme(QStringLiteral("edit-undo")), i18n("Recently Closed Tabs"), parent),
+    m_clearListAction(nullptr),
+    m_closedTabs()
 {
     setDelayed(false);
     setEnabled(false);
@@ -30,56 +40,99 @@ DolphinRecentTabsMenu::DolphinRecentTabsMenu(QObject* parent) :
 
 void DolphinRecentTabsMenu::rememberClosedTab(const QUrl& url, const QByteArray& state)
 {
-    QAction* action = new QAction(menu());
-    action->setText(url.path());
-    action->setData(state);
-    const QString iconName = KIO::iconNameForUrl(url);
-    action->setIcon(QIcon::fromTheme(iconName));
-
-    // Add the closed tab menu entry after the separator and
-    // "Empty Recently Closed Tabs" entry
-    if (menu()->actions().size() == 2) {
-        addAction(action);
-    } else {
-        insertAction(menu()->actions().at(2), action);
+    // The states contain many similar URLs, e.g. of the selected items
+    m_closedTabs.prepend({url, KIO::iconNameForUrl(url), qCompress(state)});
+
+    const int maximumCount = qMax(1, GeneralSettings::closedTabsHistorySize());
+    while (m_closedTabs.count() > maximumCount) {
+        m_closedTabs.removeLast();
     }
-    Q_EMIT closedTabsCountChanged(menu()->actions().size() - 2);
-    // Assure that only up to 6 closed tabs are shown in the menu.
-    // 8 because of clear action + separator + 6 closed tabs
-    if (menu()->actions().size() > 8) {
-        removeAction(menu()->actions().last());
+
+    updateActions();
+}
+
+QString DolphinRecentTabsMenu::memoryConsumerName() const
+{
+    return QStringLiteral("DolphinRecentTabsMenu");
+}
+
+qint64 DolphinRecentTabsMenu::memoryUsage() const
+{
+    qint64 bytes = 0;
+    for (const ClosedTab& closedTab : m_closedTabs) {
+        bytes += memoryUsage(closedTab.url, closedTab.state);
     }
-    setEnabled(true);
-    KAcceleratorManager::manage(menu());
+    return bytes;
+}
+
+qint64 DolphinRecentTabsMenu::releaseMemory(qint64 bytes)
+{
+    qint64 released = 0;
+    while (!m_closedTabs.isEmpty() && released < bytes) {
+        const ClosedTab closedTab = m_closedTabs.takeLast();
+        released += memoryUsage(closedTab.url, closedTab.state);
+    }
+
+    if (released > 0) {
+        updateActions();
+    }
+    return released;
 }
 
 void DolphinRecentTabsMenu::undoCloseTab()
 {
-    Q_ASSERT(menu()->actions().size() > 2);
-    handleAction(menu()->actions().at(2));
+    Q_ASSERT(!m_closedTabs.isEmpty());
+    restoreTab(0);
 }
 
 void DolphinRecentTabsMenu::handleAction(QAction* action)
 {
     if (action == m_clearListAction) {
-        // Clear all actions except the "Empty Recently Closed Tabs"
-        // action and the separator
-        QList<QAction*> actions = menu()->actions();
-        const int count = actions.size();
-        for (int i = 2; i < count; ++i) {
-            removeAction(actions.at(i));
-        }
-        Q_EMIT closedTabsCountChanged(0);
-    } else {
-        const QByteArray state = action->data().toByteArray();
-        removeAction(action);
-        delete action;
-        action = nullptr;
-        Q_EMIT restoreClosedTab(state);
-        Q_EMIT closedTabsCountChanged(menu()->actions().size() - 2);
+        m_closedTabs.clear();
+        updateActions();
+    } else if (action->data().isValid()) {
+        restoreTab(action->data().toInt());
     }
+}
 
-    if (menu()->actions().count() <= 2) {
-        setEnabled(false);
+void DolphinRecentTabsMenu::restoreTab(int index)
+{
+    if (index < 0 || index >= m_closedTabs.count()) {
+        return;
+    }
+
+    const ClosedTab closedTab = m_closedTabs.takeAt(index);
+    updateActions();
+    Q_EMIT restoreClosedTab(qUncompress(closedTab.state));
+}
+
+void DolphinRecentTabsMenu::updateActions()
+{
+    // Remove the entries of the closed tabs after the
+    // "Empty Recently Closed Tabs" action and the separator
+    const QList<QAction*> actions = menu()->actions();
+    for (int i = 2; i < actions.count(); ++i) {
+        removeAction(actions.at(i));
+        // The action might have been triggered
+        actions.at(i)->deleteLater();
     }
+
+    const int shownCount = qMin(m_closedTabs.count(), MaximumShownTabs);
+    for (int i = 0; i < shownCount; ++i) {
+        const ClosedTab& closedTab = m_closedTabs.at(i);
+        QAction* action = new QAction(menu());
+        action->setText(closedTab.url.path());
+        action->setData(i);
+        action->setIcon(QIcon::fromTheme(closedTab.iconName));
+        addAction(action);
+    }
+
+    setEnabled(!m_closedTabs.isEmpty());
+    KAcceleratorManager::manage(menu());
+    Q_EMIT closedTabsCountChanged(m_closedTabs.count());
+}
+
+qint64 DolphinRecentTabsMenu::memoryUsage(const QUrl& url, const QByteArray& state)
+{
+    return state.size() + url.toString().size() * qint64(sizeof(QChar));
 }
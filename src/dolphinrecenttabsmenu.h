@@ -7,19 +7,41 @@
 #ifndef DOLPHIN_RECENT_TABS_MENU_H
 #define DOLPHIN_RECENT_TABS_MENU_H
 
+#include "kitemviews/private/kmemorybudget.h"
+
 #include <KActionMenu>
 
+#include <QList>
 #include <QUrl>
 
 class QAction;
 
-class DolphinRecentTabsMenu : public KActionMenu
+/**
+ * @brief Remembers the recently closed tabs, so that they can be restored.
+ *
+ * The states of the tabs are kept compressed, and only up to
+ * GeneralSettings::closedTabsHistorySize() tabs are remembered. The menu
+ * shows the most recently closed tabs.
+ */
+class DolphinRecentTabsMenu : public KActionMenu, public KMemoryBudget::Consumer
 {
     Q_OBJECT
 
 public:
     explicit DolphinRecentTabsMenu(QObject* parent);
 
+    QString memoryConsumerName() const override;
+
+    /**
+     * @return Estimated number of bytes used by the states of the closed tabs.
+     */
+    qint64 memoryUsage() const override;
+
+    /**
+     * Forgets the least recently closed tabs.
+     */
+    qint64 releaseMemory(qint64 bytes) override;
+
 public Q_SLOTS:
     void rememberClosedTab(const QUrl& url, const QByteArray& state);
     void undoCloseTab();
@@ -32,7 +54,32 @@ private Q_SLOTS:
     void handleAction(QAction* action);
 
 private:
+    /**
+     * Forgets the closed tab with the index \a index
+     * and emits restoreClosedTab() for it.
+     */
+    void restoreTab(int index);
+
+    /**
+     * Updates the menu entries of the closed tabs, the
+     * enabled state and emits closedTabsCountChanged().
+     */
+    void updateActions();
+
+    static qint64 memoryUsage(const QUrl& url, const QByteArray& state);
+
+private:
+    struct ClosedTab
+    {
+        QUrl url;
+        QString iconName;
+        QByteArray state; // Compressed by qCompress()
+    };
+
     QAction* m_clearListAction;
+
+    // The most recently closed tab is the first one
+    QList<ClosedTab> m_closedTabs;
 };
 
 #endif
@@ -22,7 +22,10 @@ DolphinTabPage::DolphinTabPage(const QUrl &primaryUrl, const QUrl &secondaryUrl,
     m_expandingContainer{nullptr},
     m_primaryViewActive(true),
     m_splitViewEnabled(false),
-    m_active(true)
+    m_active(true),
+    m_loadingDeferred(false),
+    m_inBackground(false),
+    m_deferredState()
 {
     QGridLayout *layout = new QGridLayout(this);
     layout->setSpacing(0);
@@ -253,6 +256,30 @@ void DolphinTabPage::refreshViews()
 
 QByteArray DolphinTabPage::saveState() const
 {
+    return stateData(true);
+}
+
+QByteArray DolphinTabPage::saveClosedState() const
+{
+    return stateData(false);
+}
+
+void DolphinTabPage::retainSnapshots()
+{
+    m_primaryViewContainer->view()->retainSnapshot();
+    if (m_splitViewEnabled) {
+        m_secondaryViewContainer->view()->retainSnapshot();
+    }
+}
+
+QByteArray DolphinTabPage::stateData(bool includeSplitterState) const
+{
+    if (m_loadingDeferred && !m_deferredState.isEmpty()) {
+        // The views have not loaded their directories yet, so they
+        // cannot provide the current item and the selection
+        return m_deferredState;
+    }
+
     QByteArray state;
     QDataStream stream(&state, QIODevice::WriteOnly);
 
@@ -271,7 +298,8 @@ QByteArray DolphinTabPage::saveState() const
     }
 
     stream << m_primaryViewActive;
-    stream << m_splitter->saveState();
+    // An empty splitter state keeps the default layout when being restored
+    stream << (includeSplitterState ? m_splitter->saveState() : QByteArray());
 
     return state;
 }
@@ -293,6 +321,10 @@ void DolphinTabPage::restoreState(const QByteArray& state)
         return;
     }
 
+    if (m_loadingDeferred) {
+        m_deferredState = state;
+    }
+
     bool isSplitViewEnabled = false;
     stream >> isSplitViewEnabled;
     setSplitViewEnabled(isSplitViewEnabled, WithoutAnimation);
@@ -380,6 +412,43 @@ void DolphinTabPage::setActive(bool active)
     }
     // we want view to fire activated when goes from false to true
     activeViewContainer()->setActive(active);
+
+    if (active) {
+        setLoadingDeferred(false);
+    }
+
+    m_inBackground = !active;
+    m_primaryViewContainer->view()->setInBackground(m_inBackground);
+    if (m_secondaryViewContainer) {
+        m_secondaryViewContainer->view()->setInBackground(m_inBackground);
+    }
+}
+
+void DolphinTabPage::setLoadingDeferred(bool deferred)
+{
+    if (deferred == m_loadingDeferred) {
+        return;
+    }
+
+    m_loadingDeferred = deferred;
+    if (!deferred) {
+        m_deferredState.clear();
+    }
+
+    m_primaryViewContainer->view()->setLoadingDeferred(deferred);
+    if (m_secondaryViewContainer) {
+        m_secondaryViewContainer->view()->setLoadingDeferred(deferred);
+    }
+}
+
+bool DolphinTabPage::isLoadingDeferred() const
+{
+    return m_loadingDeferred;
+}
+
+bool DolphinTabPage::isInBackground() const
+{
+    return m_inBackground;
 }
 
 void DolphinTabPage::slotAnimationFinished()
@@ -507,6 +576,8 @@ DolphinViewContainer* DolphinTabPage::createViewContainer(const QUrl& url) const
 {
     DolphinViewContainer* container = new DolphinViewContainer(url, m_splitter);
     container->setActive(false);
+    container->view()->setLoadingDeferred(m_loadingDeferred);
+    container->view()->setInBackground(m_inBackground);
 
     const DolphinView* view = container->view();
     connect(view, &DolphinView::activated,
@@ -122,6 +122,19 @@ public:
      */
     QByteArray saveState() const;
 
+    /**
+     * @return The state of the tab like saveState(), but without the layout
+     *         of the splitter, which is not needed to restore a closed tab.
+     */
+    QByteArray saveClosedState() const;
+
+    /**
+     * Keeps the snapshots of the shown folders after the tab page has been
+     * deleted, so that they are shown at once if the closed tab is restored.
+     * @see KFileItemModel::retainSnapshot()
+     */
+    void retainSnapshots();
+
     /**
      * Restores all tab related properties (urls, splitter layout, ...) from
      * the given \a state.
@@ -143,6 +156,21 @@ public:
      */
     void setActive(bool active);
 
+    /**
+     * If \a deferred is true, the view containers don't load their
+     * directories until the tab page gets activated by setActive(true),
+     * see DolphinView::setLoadingDeferred(). While the loading is deferred,
+     * saveState() returns the state that has been passed to restoreState().
+     */
+    void setLoadingDeferred(bool deferred);
+    bool isLoadingDeferred() const;
+
+    /**
+     * @return True if the tab page is not the current tab, so that its
+     *         views are in the background, see DolphinView::setInBackground().
+     */
+    bool isInBackground() const;
+
 Q_SIGNALS:
     void activeViewChanged(DolphinViewContainer* viewContainer);
     void activeViewUrlChanged(const QUrl& url);
@@ -193,6 +221,12 @@ private:
      */
     void startExpandViewAnimation(DolphinViewContainer *expandingContainer);
 
+    /**
+     * @return The state of saveState(), that contains the layout of
+     *         the splitter if \a includeSplitterState is true.
+     */
+    QByteArray stateData(bool includeSplitterState) const;
+
 private:
     QSplitter* m_splitter;
 
@@ -206,6 +240,9 @@ private:
     bool m_primaryViewActive;
     bool m_splitViewEnabled;
     bool m_active;
+    bool m_loadingDeferred;
+    bool m_inBackground;
+    QByteArray m_deferredState;
 };
 
 #endif // DOLPHIN_TAB_PAGE_H
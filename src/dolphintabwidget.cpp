@@ -18,6 +18,7 @@
 
 #include <QApplication>
 #include <QDropEvent>
+#include <QTimer>
 
 DolphinTabWidget::DolphinTabWidget(DolphinNavigatorsWidgetAction *navigatorsWidget, QWidget* parent) :
     QTabWidget(parent),
@@ -83,10 +84,17 @@ void DolphinTabWidget::saveProperties(KConfigGroup& group) const
 void DolphinTabWidget::readProperties(const KConfigGroup& group)
 {
     const int tabCount = group.readEntry("Tab Count", 0);
+    const int index = group.readEntry("Active Tab Index", 0);
+    // New tabs are opened at the already loaded URL of the first tab
+    // and not at the restored URL of the previous tab, which is not loaded yet
+    const QUrl initialUrl = currentTabPage()->activeViewContainer()->url();
     for (int i = 0; i < tabCount; ++i) {
         if (i >= count()) {
-            openNewActivatedTab();
+            openNewActivatedTab(initialUrl);
         }
+        // Only the active tab loads its directories now, the other tabs
+        // load them when they get activated
+        tabPageAt(i)->setLoadingDeferred(i != index);
         if (group.hasKey("Tab Data " % QString::number(i))) {
             // Tab state created with Dolphin > 4.14.x
             const QByteArray state = group.readEntry("Tab Data " % QString::number(i), QByteArray());
@@ -98,8 +106,8 @@ void DolphinTabWidget::readProperties(const KConfigGroup& group)
         }
     }
 
-    const int index = group.readEntry("Active Tab Index", 0);
     setCurrentIndex(index);
+    currentTabPage()->setLoadingDeferred(false);
 }
 
 void DolphinTabWidget::refreshViews()
@@ -265,7 +273,8 @@ void DolphinTabWidget::closeTab(const int index)
     }
 
     DolphinTabPage* tabPage = tabPageAt(index);
-    Q_EMIT rememberClosedTab(tabPage->activeViewContainer()->url(), tabPage->saveState());
+    Q_EMIT rememberClosedTab(tabPage->activeViewContainer()->url(), tabPage->saveClosedState());
+    tabPage->retainSnapshots();
 
     removeTab(index);
     tabPage->deleteLater();
@@ -411,6 +420,15 @@ void DolphinTabWidget::currentTabChanged(int index)
     tabPage->connectNavigators(m_navigatorsWidget);
     m_navigatorsWidget->setSecondaryNavigatorVisible(tabPage->splitViewEnabled());
     m_lastViewedTab = tabPage;
+
+    // Load the directories of the next restored tab in the background,
+    // as it is likely to be activated soon
+    DolphinTabPage* nextTabPage = tabPageAt(index + 1);
+    if (nextTabPage && nextTabPage->isLoadingDeferred()) {
+        QTimer::singleShot(0, nextTabPage, [nextTabPage]() {
+            nextTabPage->setLoadingDeferred(false);
+        });
+    }
 }
 
 void DolphinTabWidget::tabInserted(int index)
@@ -0,0 +1,200 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "dolphinurlcompletion.h"
+
+#include "kitemviews/kfileitemmodel.h"
+
+#include <KIO/ListJob>
+
+#include <QDir>
+
+namespace {
+    // Number of folders whose subfolders are cached
+    const int MaximumListings = 50;
+
+    // Time in ms after which the cached subfolders of a listed folder are
+    // outdated. The listings of shown folders are kept up to date.
+    const int ListingLifetime = 30000;
+
+    // Time in ms for which the subfolders of a shown folder or of a snapshot
+    // are reused while typing, before they are taken from the model again.
+    const int KnownListingLifetime = 2000;
+}
+
+DolphinUrlCompletion::DolphinUrlCompletion() :
+    KUrlCompletion(KUrlCompletion::DirCompletion),
+    m_baseUrl(),
+    m_text(),
+    m_listJob(),
+    m_listedDirectory(),
+    m_listedNames(),
+    m_listings(MaximumListings)
+{
+}
+
+DolphinUrlCompletion::~DolphinUrlCompletion()
+{
+    if (m_listJob) {
+        m_listJob->kill();
+    }
+}
+
+void DolphinUrlCompletion::setBaseUrl(const QUrl& url)
+{
+    m_baseUrl = url;
+    setDir(url);
+}
+
+QString DolphinUrlCompletion::makeCompletion(const QString& text)
+{
+    m_text = text;
+
+    const Location typedLocation = location(text);
+    if (!typedLocation.directory.isValid()) {
+        return KUrlCompletion::makeCompletion(text);
+    }
+
+    QStringList names;
+    if (cachedNames(typedLocation, names)) {
+        // Results of a previous listing of KUrlCompletion would
+        // replace the completion items
+        stop();
+        return complete(typedLocation, names, text);
+    }
+
+    if (typedLocation.directory.isLocalFile()) {
+        return KUrlCompletion::makeCompletion(text);
+    }
+
+    // The completion is announced when the listing has been finished
+    stop();
+    startListing(typedLocation.directory);
+    return QString();
+}
+
+DolphinUrlCompletion::Location DolphinUrlCompletion::location(const QString& text) const
+{
+    Location result;
+    result.hiddenFiles = false;
+
+    const int index = text.lastIndexOf(QLatin1Char('/'));
+    if (index < 0 || text.startsWith(QLatin1Char('$'))) {
+        // Partial names of the base folder, users and environment
+        // variables are completed by KUrlCompletion
+        return result;
+    }
+
+    result.directoryText = text.left(index + 1);
+    result.hiddenFiles = text.midRef(index + 1).startsWith(QLatin1Char('.'));
+
+    QString directory = result.directoryText;
+    if (directory.startsWith(QLatin1String("~/"))) {
+        directory = QDir::homePath() + directory.mid(1);
+    } else if (directory.startsWith(QLatin1Char('~'))) {
+        return result;
+    }
+
+    if (directory.startsWith(QLatin1Char('/')) || directory.contains(QLatin1String(":/"))) {
+        result.directory = QUrl::fromUserInput(directory, QString(), QUrl::AssumeLocalFile);
+    } else if (m_baseUrl.isValid()) {
+        result.directory = m_baseUrl;
+        result.directory.setPath(QDir::cleanPath(m_baseUrl.path() + QLatin1Char('/') + directory));
+    }
+    result.directory = result.directory.adjusted(QUrl::StripTrailingSlash | QUrl::NormalizePathSegments);
+    return result;
+}
+
+bool DolphinUrlCompletion::cachedNames(const Location& location, QStringList& names)
+{
+    const Listing* listing = m_listings.object(location.directory);
+    if (listing && (listing->hiddenFiles || !location.hiddenFiles) && listing->age.elapsed() < listing->lifetime) {
+        names = listing->names;
+        return true;
+    }
+
+    KFileItemList items;
+    if (KFileItemModel::cachedListing(location.directory, location.hiddenFiles, items)) {
+        names.clear();
+        for (const KFileItem& item : qAsConst(items)) {
+            if (item.isDir()) {
+                names.append(item.name());
+            }
+        }
+        insertListing(location.directory, names, location.hiddenFiles, KnownListingLifetime);
+        return true;
+    }
+
+    return false;
+}
+
+void DolphinUrlCompletion::insertListing(const QUrl& directory, const QStringList& names, bool hiddenFiles, int lifetime)
+{
+    Listing* listing = new Listing();
+    listing->names = names;
+    listing->hiddenFiles = hiddenFiles;
+    listing->lifetime = lifetime;
+    listing->age.start();
+    m_listings.insert(directory, listing);
+}
+
+QString DolphinUrlCompletion::complete(const Location& location, const QStringList& names, const QString& text)
+{
+    QStringList items;
+    items.reserve(names.count());
+    for (const QString& name : names) {
+        if (location.hiddenFiles || !name.startsWith(QLatin1Char('.'))) {
+            items.append(location.directoryText + name + QLatin1Char('/'));
+        }
+    }
+
+    setItems(items);
+    return KCompletion::makeCompletion(text);
+}
+
+void DolphinUrlCompletion::startListing(const QUrl& directory)
+{
+    if (m_listJob) {
+        if (m_listedDirectory == directory) {
+            return;
+        }
+        m_listJob->kill();
+    }
+
+    m_listedDirectory = directory;
+    m_listedNames.clear();
+
+    m_listJob = KIO::listDir(directory, KIO::HideProgressInfo);
+    connect(m_listJob, &KIO::ListJob::entries, this, &DolphinUrlCompletion::slotEntries);
+    connect(m_listJob, &KJob::result, this, &DolphinUrlCompletion::slotListingResult);
+}
+
+void DolphinUrlCompletion::slotEntries(KIO::Job* job, const KIO::UDSEntryList& entries)
+{
+    Q_UNUSED(job)
+    for (const KIO::UDSEntry& entry : entries) {
+        const QString name = entry.stringValue(KIO::UDSEntry::UDS_NAME);
+        if (entry.isDir() && name != QLatin1String(".") && name != QLatin1String("..")) {
+            m_listedNames.append(name);
+        }
+    }
+}
+
+void DolphinUrlCompletion::slotListingResult(KJob* job)
+{
+    if (job->error()) {
+        return;
+    }
+
+    insertListing(m_listedDirectory, m_listedNames, true, ListingLifetime);
+
+    const Location typedLocation = location(m_text);
+    if (typedLocation.directory == m_listedDirectory) {
+        // Announces the completion by the signals of KCompletion
+        complete(typedLocation, m_listedNames, m_text);
+    }
+    m_listedNames.clear();
+}
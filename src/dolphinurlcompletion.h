@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef DOLPHINURLCOMPLETION_H
+#define DOLPHINURLCOMPLETION_H
+
+#include <KIO/UDSEntry>
+#include <KUrlCompletion>
+
+#include <QCache>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QUrl>
+
+class KJob;
+
+namespace KIO {
+    class Job;
+    class ListJob;
+}
+
+/**
+ * @brief Completes the folders that are typed into the location bar.
+ *
+ * KUrlCompletion lists the folder of the typed location again for each
+ * typed character that changes the folder, which lags on remote
+ * locations. DolphinUrlCompletion completes from the items that are
+ * already known, if the folder is shown by a view or has a valid snapshot,
+ * see KFileItemModel::cachedListing(). Other remote folders are listed
+ * asynchronously once and the names of their subfolders are cached for
+ * a while. The completion is announced by the signals of KCompletion
+ * when the listing has been finished. Local folders that are not known
+ * are completed by KUrlCompletion.
+ */
+class DolphinUrlCompletion : public KUrlCompletion
+{
+    Q_OBJECT
+
+public:
+    DolphinUrlCompletion();
+    ~DolphinUrlCompletion() override;
+
+    /**
+     * Sets the URL that locations without a scheme or absolute
+     * path are relative to, which is the current location.
+     */
+    void setBaseUrl(const QUrl& url);
+
+    QString makeCompletion(const QString& text) override;
+
+private:
+    struct Location
+    {
+        QUrl directory;         // Folder whose subfolders are completed
+        QString directoryText;  // Typed text up to and including the last '/'
+        bool hiddenFiles;       // True if the typed name starts with a dot
+    };
+
+    /**
+     * @return The folder of the typed location \a text. The directory
+     *         is invalid if the text cannot be completed by this class.
+     */
+    Location location(const QString& text) const;
+
+    /**
+     * @return True if the subfolders of \a location are known without listing the
+     *         folder, which are stored in \a names. The names of known folders are
+     *         remembered for a short time, so that checking whether a snapshot is
+     *         still valid does not access the filesystem for each typed character.
+     */
+    bool cachedNames(const Location& location, QStringList& names);
+
+    void insertListing(const QUrl& directory, const QStringList& names, bool hiddenFiles, int lifetime);
+
+    /**
+     * Uses the subfolders \a names of \a location as completion items and
+     * completes \a text.
+     */
+    QString complete(const Location& location, const QStringList& names, const QString& text);
+
+    void startListing(const QUrl& directory);
+    void slotEntries(KIO::Job* job, const KIO::UDSEntryList& entries);
+    void slotListingResult(KJob* job);
+
+private:
+    struct Listing
+    {
+        QStringList names;
+        bool hiddenFiles;   // True if the names contain the hidden folders
+        int lifetime;       // Time in ms after which the names are outdated
+        QElapsedTimer age;
+    };
+
+    QUrl m_baseUrl;
+
+    // Text of the last completion, which is completed again if
+    // the listing of its folder has been finished
+    QString m_text;
+
+    QPointer<KIO::ListJob> m_listJob;
+    QUrl m_listedDirectory;
+    QStringList m_listedNames;
+
+    // Names of the subfolders of recently listed or completed folders
+    QCache<QUrl, Listing> m_listings;
+};
+
+#endif
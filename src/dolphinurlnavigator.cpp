@@ -9,6 +9,7 @@
 
 #include "dolphin_generalsettings.h"
 #include "dolphinplacesmodelsingleton.h"
+#include "dolphinurlcompletion.h"
 #include "dolphinurlnavigatorscontroller.h"
 #include "global.h"
 
@@ -31,6 +32,15 @@ DolphinUrlNavigator::DolphinUrlNavigator(const QUrl &url, QWidget *parent) :
     setShowFullPath(settings->showFullPath());
     setHomeUrl(Dolphin::homeUrl());
     setPlacesSelectorVisible(DolphinUrlNavigatorsController::placesSelectorVisible());
+
+    // Completes from the known folders and does not list remote folders repeatedly
+    auto urlCompletion = new DolphinUrlCompletion();
+    urlCompletion->setBaseUrl(url);
+    editor()->setCompletionObject(urlCompletion);
+    editor()->setAutoDeleteCompletionObject(true);
+    connect(this, &KUrlNavigator::urlChanged,
+            urlCompletion, &DolphinUrlCompletion::setBaseUrl);
+
     editor()->setCompletionMode(KCompletion::CompletionMode(settings->urlCompletionMode()));
     setWhatsThis(xi18nc("@info:whatsthis location bar",
         "<para>This describes the location of the files and folders "
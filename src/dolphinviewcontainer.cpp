@@ -11,6 +11,9 @@
 #include "dolphinplacesmodelsingleton.h"
 #include "filterbar/filterbar.h"
 #include "global.h"
+#include "kitemviews/private/kitemlisttracer.h"
+#include "search/dolphinfacetsfilter.h"
+#include "search/dolphinquery.h"
 #include "search/dolphinsearchbox.h"
 #include "statusbar/dolphinstatusbar.h"
 #include "views/viewmodecontroller.h"
@@ -22,6 +25,7 @@
 #endif
 #include <KFileItemActions>
 #include <KFilePlacesModel>
+#include <KIO/Global>
 #include <KIO/PreviewJob>
 #include <KIO/OpenUrlJob>
 #include <KIO/JobUiDelegate>
@@ -33,9 +37,12 @@
 #include <KUrlNavigator>
 
 #include <QDropEvent>
+#include <QGuiApplication>
 #include <QLoggingCategory>
 #include <QMimeData>
+#include <QScreen>
 #include <QTimer>
+#include <QtMath>
 #include <QUrl>
 #include <QVBoxLayout>
 #include <QDesktopServices>
@@ -53,6 +60,9 @@ DolphinViewContainer::DolphinViewContainer(const QUrl& url, QWidget* parent) :
     m_statusBar(nullptr),
     m_statusBarTimer(nullptr),
     m_statusBarTimestamp(),
+    m_statusBarUpdatePending(false),
+    m_progressTimer(nullptr),
+    m_pendingProgressUpdate(),
     m_autoGrabFocus(true)
 #ifdef HAVE_KACTIVITIES
     , m_activityResourceInstance(nullptr)
@@ -69,6 +79,7 @@ DolphinViewContainer::DolphinViewContainer(const QUrl& url, QWidget* parent) :
     connect(m_searchBox, &DolphinSearchBox::activated, this, &DolphinViewContainer::activate);
     connect(m_searchBox, &DolphinSearchBox::closeRequest, this, &DolphinViewContainer::closeSearchBox);
     connect(m_searchBox, &DolphinSearchBox::searchRequest, this, &DolphinViewContainer::startSearching);
+    connect(m_searchBox, &DolphinSearchBox::searchTextEdited, this, &DolphinViewContainer::cancelOutdatedSearch);
     connect(m_searchBox, &DolphinSearchBox::focusViewRequest, this, &DolphinViewContainer::requestFocus);
     m_searchBox->setWhatsThis(xi18nc("@info:whatsthis findbar",
         "<para>This helps you find files and folders. Enter a <emphasis>"
@@ -144,6 +155,8 @@ DolphinViewContainer::DolphinViewContainer(const QUrl& url, QWidget* parent) :
             this, &DolphinViewContainer::updateDirectoryLoadingProgress);
     connect(m_view, &DolphinView::directorySortingProgress,
             this, &DolphinViewContainer::updateDirectorySortingProgress);
+    connect(m_view, &DolphinView::directoryLoadingEstimateChanged,
+            this, &DolphinViewContainer::updateDirectoryLoadingEstimate);
     connect(m_view, &DolphinView::selectionChanged,
             this, &DolphinViewContainer::delayedStatusBarUpdate);
     connect(m_view, &DolphinView::errorMessage,
@@ -179,6 +192,17 @@ DolphinViewContainer::DolphinViewContainer(const QUrl& url, QWidget* parent) :
     m_statusBarTimer->setInterval(300);
     connect(m_statusBarTimer, &QTimer::timeout, this, &DolphinViewContainer::updateStatusBar);
 
+    // The status bar receives a show event if it gets visible again and
+    // if the window is restored after having been minimized
+    m_statusBar->installEventFilter(this);
+
+    const QScreen* screen = QGuiApplication::primaryScreen();
+    const qreal refreshRate = screen ? screen->refreshRate() : 0;
+    m_progressTimer = new QTimer(this);
+    m_progressTimer->setSingleShot(true);
+    m_progressTimer->setInterval(refreshRate > 0 ? qCeil(1000 / refreshRate) : 16);
+    connect(m_progressTimer, &QTimer::timeout, this, &DolphinViewContainer::applyPendingProgressUpdate);
+
     KIO::FileUndoManager* undoManager = KIO::FileUndoManager::self();
     connect(undoManager, &KIO::FileUndoManager::jobRecordingFinished,
             this, &DolphinViewContainer::delayedStatusBarUpdate);
@@ -209,6 +233,19 @@ DolphinViewContainer::~DolphinViewContainer()
 {
 }
 
+bool DolphinViewContainer::eventFilter(QObject* watched, QEvent* event)
+{
+    if (watched == m_statusBar && event->type() == QEvent::Show) {
+        if (m_statusBarUpdatePending) {
+            updateStatusBar();
+        }
+        if (m_pendingProgressUpdate) {
+            m_progressTimer->start();
+        }
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
 QUrl DolphinViewContainer::url() const
 {
     return m_view->url();
@@ -508,6 +545,8 @@ QString DolphinViewContainer::caption() const
 
 void DolphinViewContainer::setUrl(const QUrl& newUrl)
 {
+    // Includes the start of the listing by the view
+    const KItemListTraceScope traceScope("DolphinViewContainer::setUrl");
     if (newUrl != m_urlNavigator->locationUrl()) {
         m_urlNavigator->setLocationUrl(newUrl);
     }
@@ -548,27 +587,56 @@ void DolphinViewContainer::delayedStatusBarUpdate()
 void DolphinViewContainer::updateStatusBar()
 {
     m_statusBarTimestamp.start();
+    if (!isStatusBarShown()) {
+        m_statusBarUpdatePending = true;
+        return;
+    }
+
+    m_statusBarUpdatePending = false;
     m_view->requestStatusBarText();
 }
 
 void DolphinViewContainer::updateDirectoryLoadingProgress(int percent)
 {
-    if (m_statusBar->progressText().isEmpty()) {
-        m_statusBar->setProgressText(i18nc("@info:progress", "Loading folder..."));
-    }
-    m_statusBar->setProgress(percent);
+    delayedProgressUpdate([this, percent]() {
+        if (m_statusBar->progressText().isEmpty()) {
+            m_statusBar->setProgressText(i18nc("@info:progress", "Loading folder..."));
+        }
+        m_statusBar->setProgress(percent);
+    });
 }
 
 void DolphinViewContainer::updateDirectorySortingProgress(int percent)
 {
-    if (m_statusBar->progressText().isEmpty()) {
-        m_statusBar->setProgressText(i18nc("@info:progress", "Sorting..."));
-    }
-    m_statusBar->setProgress(percent);
+    delayedProgressUpdate([this, percent]() {
+        if (m_statusBar->progressText().isEmpty()) {
+            m_statusBar->setProgressText(i18nc("@info:progress", "Sorting..."));
+        }
+        m_statusBar->setProgress(percent);
+    });
+}
+
+void DolphinViewContainer::updateDirectoryLoadingEstimate(int listedCount, int estimatedCount, KIO::filesize_t estimatedSize)
+{
+    delayedProgressUpdate([this, listedCount, estimatedCount, estimatedSize]() {
+        if (estimatedCount > 0) {
+            m_statusBar->setProgressText(i18ncp("@info:progress", "Loading %2 of about %1 item (%3)...",
+                                                "Loading %2 of about %1 items (%3)...",
+                                                estimatedCount, listedCount, KIO::convertSize(estimatedSize)));
+            // Huge directories would overflow an int
+            m_statusBar->setProgress(static_cast<int>(qint64(listedCount) * 100 / estimatedCount));
+        } else {
+            m_statusBar->setProgressText(i18ncp("@info:progress", "Loading %1 item (%2)...",
+                                                "Loading %1 items (%2)...",
+                                                listedCount, KIO::convertSize(estimatedSize)));
+            m_statusBar->setProgress(-1);
+        }
+    });
 }
 
 void DolphinViewContainer::slotDirectoryLoadingStarted()
 {
+    discardPendingProgressUpdate();
     if (isSearchUrl(url())) {
         // Search KIO-slaves usually don't provide any progress information. Give
         // a hint to the user that a searching is done:
@@ -586,6 +654,7 @@ void DolphinViewContainer::slotDirectoryLoadingStarted()
 
 void DolphinViewContainer::slotDirectoryLoadingCompleted()
 {
+    discardPendingProgressUpdate();
     if (!m_statusBar->progressText().isEmpty()) {
         m_statusBar->setProgressText(QString());
         m_statusBar->setProgress(100);
@@ -598,10 +667,15 @@ void DolphinViewContainer::slotDirectoryLoadingCompleted()
     } else {
         updateStatusBar();
     }
+
+    if (url().scheme() == QLatin1String("baloosearch")) {
+        updateSearchResultsCache();
+    }
 }
 
 void DolphinViewContainer::slotDirectoryLoadingCanceled()
 {
+    discardPendingProgressUpdate();
     if (!m_statusBar->progressText().isEmpty()) {
         m_statusBar->setProgressText(QString());
         m_statusBar->setProgress(100);
@@ -693,6 +767,7 @@ void DolphinViewContainer::slotUrlNavigatorLocationChanged(const QUrl& url)
 
     if (KProtocolManager::supportsListing(url)) {
         setSearchModeEnabled(isSearchUrl(url));
+        clearOutdatedFacetCounts(url);
         m_view->setUrl(url);
         tryRestoreViewState();
 
@@ -754,6 +829,7 @@ void DolphinViewContainer::startSearching()
     const QUrl url = m_searchBox->urlForSearching();
     if (url.isValid() && !url.isEmpty()) {
         m_view->setViewPropertiesContext(QStringLiteral("search"));
+        narrowSearchResults(url);
         m_urlNavigatorConnected->setLocationUrl(url);
     }
 }
@@ -763,6 +839,13 @@ void DolphinViewContainer::closeSearchBox()
     setSearchModeEnabled(false);
 }
 
+void DolphinViewContainer::cancelOutdatedSearch()
+{
+    if (isSearchUrl(m_view->url())) {
+        stopDirectoryLoading();
+    }
+}
+
 void DolphinViewContainer::stopDirectoryLoading()
 {
     m_view->stopLoading();
@@ -784,6 +867,59 @@ bool DolphinViewContainer::isSearchUrl(const QUrl& url) const
     return url.scheme().contains(QLatin1String("search"));
 }
 
+void DolphinViewContainer::narrowSearchResults(const QUrl& url)
+{
+    const QUrl cachedUrl = m_view->cachedSearchResultsUrl();
+    if (url.scheme() != QLatin1String("baloosearch") || cachedUrl.isEmpty() || cachedUrl == url) {
+        return;
+    }
+
+    const DolphinQuery query = DolphinQuery::fromSearchUrl(url);
+    const DolphinQuery cachedQuery = DolphinQuery::fromSearchUrl(cachedUrl);
+    const DolphinFacetsFilter filter = DolphinFacetsFilter::fromQuery(query);
+    if (query.hasSameSearch(cachedQuery) && DolphinFacetsFilter::fromQuery(cachedQuery).isNarrowedBy(filter)) {
+        // Show the cached results that match with the facets until Baloo has answered
+        m_view->prepareNarrowedSearch(url, [filter](const KFileItem& item, const QHash<QByteArray, QVariant>& values) {
+            return filter.matches(item, values);
+        });
+    }
+}
+
+void DolphinViewContainer::updateSearchResultsCache()
+{
+    // The cached results are kept as long as they contain the shown results,
+    // so that the facets can be widened again without querying Baloo.
+    const QUrl cachedUrl = m_view->cachedSearchResultsUrl();
+    bool keepCache = false;
+    if (!cachedUrl.isEmpty() && cachedUrl != url()) {
+        const DolphinQuery query = DolphinQuery::fromSearchUrl(url());
+        const DolphinQuery cachedQuery = DolphinQuery::fromSearchUrl(cachedUrl);
+        keepCache = query.hasSameSearch(cachedQuery)
+                 && DolphinFacetsFilter::fromQuery(cachedQuery).isNarrowedBy(DolphinFacetsFilter::fromQuery(query));
+    }
+    if (!keepCache) {
+        m_view->cacheSearchResults();
+    }
+
+    // The options of each facet are counted for the results that match with the other facets
+    const DolphinFacetsFilter filter = DolphinFacetsFilter::fromQuery(DolphinQuery::fromSearchUrl(url()));
+    DolphinFacetsFilter::Counts counts;
+    m_view->forEachCachedSearchResult([&filter, &counts](const KFileItem& item, const QHash<QByteArray, QVariant>& values) {
+        filter.count(item, values, counts);
+    });
+    m_searchBox->setFacetCounts(counts);
+}
+
+void DolphinViewContainer::clearOutdatedFacetCounts(const QUrl& url)
+{
+    const QUrl cachedUrl = m_view->cachedSearchResultsUrl();
+    if (url.scheme() == QLatin1String("baloosearch") && !cachedUrl.isEmpty()
+        && DolphinQuery::fromSearchUrl(url).hasSameSearch(DolphinQuery::fromSearchUrl(cachedUrl))) {
+        return;
+    }
+    m_searchBox->clearFacetCounts();
+}
+
 void DolphinViewContainer::saveViewState()
 {
     QByteArray locationState;
@@ -800,3 +936,34 @@ void DolphinViewContainer::tryRestoreViewState()
         m_view->restoreState(stream);
     }
 }
+
+bool DolphinViewContainer::isStatusBarShown() const
+{
+    return m_statusBar->isVisible() && !window()->isMinimized();
+}
+
+void DolphinViewContainer::delayedProgressUpdate(const std::function<void()>& update)
+{
+    m_pendingProgressUpdate = update;
+    if (!m_progressTimer->isActive()) {
+        m_progressTimer->start();
+    }
+}
+
+void DolphinViewContainer::applyPendingProgressUpdate()
+{
+    if (!m_pendingProgressUpdate || !isStatusBarShown()) {
+        // The update is applied by eventFilter() when the status bar is shown
+        return;
+    }
+
+    const std::function<void()> update = m_pendingProgressUpdate;
+    m_pendingProgressUpdate = nullptr;
+    update();
+}
+
+void DolphinViewContainer::discardPendingProgressUpdate()
+{
+    m_progressTimer->stop();
+    m_pendingProgressUpdate = nullptr;
+}
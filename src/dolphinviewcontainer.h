@@ -19,6 +19,8 @@
 #include <QPushButton>
 #include <QWidget>
 
+#include <functional>
+
 #ifdef HAVE_KACTIVITIES
 namespace KActivities {
     class ResourceInstance;
@@ -59,6 +61,8 @@ public:
     DolphinViewContainer(const QUrl& url, QWidget* parent);
     ~DolphinViewContainer() override;
 
+    bool eventFilter(QObject* watched, QEvent* event) override;
+
     /**
      * Returns the current active URL, where all actions are applied.
      * The URL navigator is synchronized with this URL.
@@ -230,7 +234,8 @@ private Q_SLOTS:
 
     /**
      * Is invoked by DolphinViewContainer::delayedStatusBarUpdate() and
-     * updates the status bar synchronously.
+     * updates the status bar synchronously. If the status bar is not shown,
+     * the update is done as soon as it gets shown again.
      */
     void updateStatusBar();
 
@@ -238,6 +243,12 @@ private Q_SLOTS:
 
     void updateDirectorySortingProgress(int percent);
 
+    /**
+     * Shows the estimated number of items and their size while
+     * a huge directory is loaded.
+     */
+    void updateDirectoryLoadingEstimate(int listedCount, int estimatedCount, KIO::filesize_t estimatedSize);
+
     /**
      * Updates the statusbar to show an undetermined progress with the correct
      * context information whether a searching or a directory loading is done.
@@ -328,6 +339,13 @@ private Q_SLOTS:
     void startSearching();
     void closeSearchBox();
 
+    /**
+     * Stops the search that is shown by the view, as its results are
+     * outdated after the user has edited the search text. The refined
+     * search is started by startSearching().
+     */
+    void cancelOutdatedSearch();
+
     /**
      * Stops the loading of a directory. Is connected with the "stopPressed" signal
      * from the statusbar.
@@ -347,6 +365,25 @@ private:
      */
     bool isSearchUrl(const QUrl& url) const;
 
+    /**
+     * Shows the cached results of the Baloo search at once, if the search
+     * \a url only narrows the facets of the cached search.
+     */
+    void narrowSearchResults(const QUrl& url);
+
+    /**
+     * Caches the loaded results of the Baloo search, unless they are a subset
+     * of the cached results, and shows their number next to the facets.
+     */
+    void updateSearchResultsCache();
+
+    /**
+     * Removes the numbers of the results from the facets, unless \a url
+     * only changes the facets of the cached Baloo search. In this case
+     * they are updated when the new results have been loaded.
+     */
+    void clearOutdatedFacetCounts(const QUrl& url);
+
     /**
      * Saves the state of the current view: contents position,
      * root URL, ...
@@ -359,6 +396,21 @@ private:
      */
     void tryRestoreViewState();
 
+    /**
+     * @return True if the status bar is visible and the window is not minimized.
+     */
+    bool isStatusBarShown() const;
+
+    /**
+     * Remembers \a update of the progress information in the status bar. The
+     * last remembered update is applied once per frame of the display, so that
+     * the frequent progress signals of huge directories don't update the
+     * widgets more often than they can be painted.
+     */
+    void delayedProgressUpdate(const std::function<void()>& update);
+    void applyPendingProgressUpdate();
+    void discardPendingProgressUpdate();
+
 private:
     QVBoxLayout* m_topLayout;
 
@@ -386,6 +438,9 @@ private:
     DolphinStatusBar* m_statusBar;
     QTimer* m_statusBarTimer;            // Triggers a delayed update
     QElapsedTimer m_statusBarTimestamp;  // Time in ms since last update
+    bool m_statusBarUpdatePending;       // The status bar has been hidden during an update
+    QTimer* m_progressTimer;             // Applies m_pendingProgressUpdate once per frame
+    std::function<void()> m_pendingProgressUpdate;
     bool m_autoGrabFocus;
     /**
      * The visual state to be applied to the next UrlNavigator that gets
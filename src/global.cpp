@@ -9,6 +9,7 @@
 #include "dolphin_generalsettings.h"
 #include "dolphindebug.h"
 #include "dolphinmainwindowinterface.h"
+#include "kitemviews/private/kitemlisttracer.h"
 
 #include <KConfigWatcher>
 #include <KDialogJobUiDelegate>
@@ -17,6 +18,7 @@
 #include <KWindowSystem>
 
 #include <QApplication>
+#include <QElapsedTimer>
 #include <QIcon>
 
 QList<QUrl> Dolphin::validateUris(const QStringList& uriList)
@@ -140,6 +142,18 @@ QVector<QPair<QSharedPointer<OrgKdeDolphinMainWindowInterface>, QStringList>> Do
     return dolphinInterfaces;
 }
 
+void Dolphin::logStartupPhase(const char* phase)
+{
+    static QElapsedTimer timer;
+    if (!timer.isValid()) {
+        timer.start();
+    }
+    qCDebug(DolphinDebug) << "Startup:" << phase << "after" << timer.elapsed() << "ms";
+    if (KItemListTracer::isEnabled()) {
+        KItemListTracer::addInstantEvent(phase);
+    }
+}
+
 double GlobalConfig::animationDurationFactor()
 {
     if (s_animationDurationFactor >= 0.0) {
@@ -46,6 +46,15 @@ namespace Dolphin {
      */
     QVector<QPair<QSharedPointer<OrgKdeDolphinMainWindowInterface>, QStringList>> dolphinGuiInstances(const QString& preferredService);
 
+    /**
+     * Writes the time that has passed since the first invocation together
+     * with \a phase to the debug output. Allows to measure the duration of
+     * the phases when starting Dolphin. If the tracing of KItemListTracer
+     * is enabled, the phase is also recorded in the trace file, so
+     * \a phase must be a string literal.
+     */
+    void logStartupPhase(const char* phase);
+
     /**
      * TODO: Move this somewhere global to all KDE apps, not just Dolphin
      */
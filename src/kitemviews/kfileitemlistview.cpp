@@ -9,10 +9,12 @@
 #include "kfileitemlistwidget.h"
 #include "kfileitemmodel.h"
 #include "kfileitemmodelrolesupdater.h"
+#include "kitemlistcontroller.h"
 #include "private/kpixmapmodifier.h"
 
 #include <KIconLoader>
 
+#include <QApplication>
 #include <QGraphicsScene>
 #include <QGraphicsView>
 #include <QPainter>
@@ -40,7 +42,10 @@ KFileItemListView::KFileItemListView(QGraphicsWidget* parent) :
     m_modelRolesUpdater(nullptr),
     m_updateVisibleIndexRangeTimer(nullptr),
     m_updateIconSizeTimer(nullptr),
-    m_scanDirectories(true)
+    m_scrollVelocityTimer(),
+    m_scanDirectories(true),
+    m_inBackground(false),
+    m_lowPriority(false)
 {
     setAcceptDrops(true);
 
@@ -131,6 +136,53 @@ bool KFileItemListView::scanDirectories()
     return m_scanDirectories;
 }
 
+void KFileItemListView::setInBackground(bool background)
+{
+    if (m_inBackground == background) {
+        return;
+    }
+
+    m_inBackground = background;
+    if (m_modelRolesUpdater) {
+        const bool timerActive = m_updateVisibleIndexRangeTimer->isActive() ||
+                                 m_updateIconSizeTimer->isActive();
+        if (background || !timerActive) {
+            // Otherwise the model-roles-updater is unpaused when the timer has been exceeded
+            m_modelRolesUpdater->setPaused(background || isTransactionActive());
+        }
+    }
+}
+
+bool KFileItemListView::isInBackground() const
+{
+    return m_inBackground;
+}
+
+void KFileItemListView::setLowPriority(bool lowPriority)
+{
+    m_lowPriority = lowPriority;
+    if (m_modelRolesUpdater) {
+        m_modelRolesUpdater->setLowPriority(m_lowPriority);
+    }
+}
+
+bool KFileItemListView::isLowPriority() const
+{
+    return m_lowPriority;
+}
+
+int KFileItemListView::averagePreviewTime() const
+{
+    return m_modelRolesUpdater ? m_modelRolesUpdater->averagePreviewTime() : -1;
+}
+
+void KFileItemListView::resetPreviewStatistics()
+{
+    if (m_modelRolesUpdater) {
+        m_modelRolesUpdater->resetPreviewStatistics();
+    }
+}
+
 QPixmap KFileItemListView::createDragPixmap(const KItemSet& indexes) const
 {
     if (!model()) {
@@ -244,6 +296,20 @@ void KFileItemListView::onPreviewsShownChanged(bool shown)
     Q_UNUSED(shown)
 }
 
+void KFileItemListView::onControllerChanged(KItemListController* current, KItemListController* previous)
+{
+    KStandardItemListView::onControllerChanged(current, previous);
+
+    if (previous) {
+        disconnect(previous, &KItemListController::itemHovered, this, &KFileItemListView::slotItemHovered);
+        disconnect(previous, &KItemListController::itemUnhovered, this, &KFileItemListView::slotItemUnhovered);
+    }
+    if (current) {
+        connect(current, &KItemListController::itemHovered, this, &KFileItemListView::slotItemHovered);
+        connect(current, &KItemListController::itemUnhovered, this, &KFileItemListView::slotItemUnhovered);
+    }
+}
+
 void KFileItemListView::onItemLayoutChanged(ItemLayout current, ItemLayout previous)
 {
     KStandardItemListView::onItemLayoutChanged(current, previous);
@@ -261,7 +327,10 @@ void KFileItemListView::onModelChanged(KItemModelBase* current, KItemModelBase*
     if (current) {
         m_modelRolesUpdater = new KFileItemModelRolesUpdater(static_cast<KFileItemModel*>(current), this);
         m_modelRolesUpdater->setIconSize(availableIconSize());
+        m_modelRolesUpdater->setDevicePixelRatio(devicePixelRatio());
         m_modelRolesUpdater->setScanDirectories(scanDirectories());
+        m_modelRolesUpdater->setLowPriority(m_lowPriority);
+        m_modelRolesUpdater->setPaused(m_inBackground);
 
         applyRolesToModel();
     }
@@ -283,7 +352,42 @@ void KFileItemListView::onItemSizeChanged(const QSizeF& current, const QSizeF& p
 void KFileItemListView::onScrollOffsetChanged(qreal current, qreal previous)
 {
     KStandardItemListView::onScrollOffsetChanged(current, previous);
-    triggerVisibleIndexRangeUpdate();
+
+    if (!m_modelRolesUpdater) {
+        triggerVisibleIndexRangeUpdate();
+        return;
+    }
+
+    updateScrollVelocity(current - previous);
+
+    if (m_modelRolesUpdater->isScrollingFast()) {
+        // The items will have left the viewport before their previews
+        // could be shown. Wait until the scrolling has been slowed down.
+        triggerVisibleIndexRangeUpdate();
+    } else if (!m_updateVisibleIndexRangeTimer->isActive() && !m_updateIconSizeTimer->isActive()) {
+        // When scrolling slowly, only a few items enter the viewport between
+        // two updates. Update the visible index range periodically without
+        // pausing the model-roles-updater, so that the previews of these
+        // items are shown while scrolling.
+        m_updateVisibleIndexRangeTimer->start();
+    }
+}
+
+void KFileItemListView::onScrollOffsetPredicted(int firstIndex, int lastIndex, qreal velocity)
+{
+    KStandardItemListView::onScrollOffsetPredicted(firstIndex, lastIndex, velocity);
+
+    if (!m_modelRolesUpdater) {
+        return;
+    }
+
+    // The velocity of the animation is known in advance, so the roles updater
+    // does not need to wait for the measured velocity.
+    const qreal pageSize = (scrollOrientation() == Qt::Vertical) ? size().height() : size().width();
+    if (pageSize > 0) {
+        m_modelRolesUpdater->setScrollVelocity(velocity / pageSize);
+    }
+    m_modelRolesUpdater->setTargetIndexRange(firstIndex, lastIndex - firstIndex + 1);
 }
 
 void KFileItemListView::onVisibleRolesChanged(const QList<QByteArray>& current, const QList<QByteArray>& previous)
@@ -324,7 +428,7 @@ void KFileItemListView::onTransactionEnd()
     const bool timerActive = m_updateVisibleIndexRangeTimer->isActive() ||
                              m_updateIconSizeTimer->isActive();
     if (!timerActive) {
-        m_modelRolesUpdater->setPaused(false);
+        m_modelRolesUpdater->setPaused(m_inBackground);
     }
 }
 
@@ -369,11 +473,18 @@ void KFileItemListView::updateVisibleIndexRange()
         return;
     }
 
+    if (!m_scrollVelocityTimer.isValid() || m_scrollVelocityTimer.elapsed() >= ShortInterval) {
+        // The scrolling has been stopped.
+        m_modelRolesUpdater->setScrollVelocity(0);
+    }
+
     const int index = firstVisibleIndex();
     const int count = lastVisibleIndex() - index + 1;
+    // The window might have been moved to a screen with another device pixel ratio
+    m_modelRolesUpdater->setDevicePixelRatio(devicePixelRatio());
     m_modelRolesUpdater->setMaximumVisibleItems(maximumVisibleItems());
     m_modelRolesUpdater->setVisibleIndexRange(index, count);
-    m_modelRolesUpdater->setPaused(isTransactionActive());
+    m_modelRolesUpdater->setPaused(m_inBackground || isTransactionActive());
 }
 
 void KFileItemListView::triggerIconSizeUpdate()
@@ -397,6 +508,7 @@ void KFileItemListView::updateIconSize()
     }
 
     m_modelRolesUpdater->setIconSize(availableIconSize());
+    m_modelRolesUpdater->setDevicePixelRatio(devicePixelRatio());
 
     // Update the visible index range (which has most likely changed after the
     // icon size change) before unpausing m_modelRolesUpdater.
@@ -404,7 +516,53 @@ void KFileItemListView::updateIconSize()
     const int count = lastVisibleIndex() - index + 1;
     m_modelRolesUpdater->setVisibleIndexRange(index, count);
 
-    m_modelRolesUpdater->setPaused(isTransactionActive());
+    m_modelRolesUpdater->setPaused(m_inBackground || isTransactionActive());
+}
+
+void KFileItemListView::updateScrollVelocity(qreal distance)
+{
+    if (qFuzzyIsNull(distance)) {
+        return;
+    }
+
+    const qint64 elapsed = m_scrollVelocityTimer.isValid() ? m_scrollVelocityTimer.restart() : -1;
+    if (elapsed < 0) {
+        m_scrollVelocityTimer.start();
+    }
+
+    const qreal pageSize = (scrollOrientation() == Qt::Vertical) ? size().height() : size().width();
+    if (pageSize <= 0) {
+        return;
+    }
+
+    if (elapsed <= 0 || elapsed >= LongInterval) {
+        // A single scroll step after a pause, e.g. caused by pressing
+        // the page-down key, is treated as if it took LongInterval ms.
+        m_modelRolesUpdater->setScrollVelocity((distance / pageSize) * 1000.0 / LongInterval);
+        return;
+    }
+
+    // The velocity is given in visible pages per second. Average it with
+    // the previous velocity to smooth out irregular repaint intervals.
+    const qreal velocity = (distance / pageSize) * 1000.0 / elapsed;
+    m_modelRolesUpdater->setScrollVelocity((m_modelRolesUpdater->scrollVelocity() + velocity) / 2);
+}
+
+void KFileItemListView::slotItemHovered(int index)
+{
+    // Scrubbing through a sequence would repaint the item for each frame
+    if (m_modelRolesUpdater && !enabledRemoteRendering()) {
+        const KFileItemModel* fileItemModel = static_cast<KFileItemModel*>(model());
+        m_modelRolesUpdater->setHoverSequenceItem(fileItemModel->fileItem(index));
+    }
+}
+
+void KFileItemListView::slotItemUnhovered(int index)
+{
+    Q_UNUSED(index)
+    if (m_modelRolesUpdater) {
+        m_modelRolesUpdater->setHoverSequenceItem(KFileItem());
+    }
 }
 
 void KFileItemListView::applyRolesToModel()
@@ -439,6 +597,15 @@ void KFileItemListView::applyRolesToModel()
     m_modelRolesUpdater->setRoles(roles);
 }
 
+qreal KFileItemListView::devicePixelRatio() const
+{
+    const QGraphicsScene* itemScene = scene();
+    if (!itemScene || itemScene->views().isEmpty()) {
+        return qApp->devicePixelRatio();
+    }
+    return itemScene->views().first()->devicePixelRatioF();
+}
+
 QSize KFileItemListView::availableIconSize() const
 {
     const KItemListStyleOption& option = styleOption();
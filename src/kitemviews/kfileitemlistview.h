@@ -10,6 +10,8 @@
 #include "dolphin_export.h"
 #include "kitemviews/kstandarditemlistview.h"
 
+#include <QElapsedTimer>
+
 class KFileItemModelRolesUpdater;
 class QTimer;
 
@@ -76,17 +78,46 @@ public:
     void setScanDirectories(bool enabled);
     bool scanDirectories();
 
+    /**
+     * If \a background is true, the view is not visible to the user, e.g.
+     * because it is part of an inactive tab. The roles of the items are
+     * not resolved, no previews are created and no directories are counted
+     * until the view is in the foreground again. The changes of the items
+     * in the meantime are resolved once afterwards. Per default the view
+     * is in the foreground.
+     */
+    void setInBackground(bool background);
+    bool isInBackground() const;
+
+    /**
+     * If \a lowPriority is true, the view is visible but not active, e.g.
+     * because it is the inactive view of a split view. The roles are only
+     * resolved for the visible items, see
+     * KFileItemModelRolesUpdater::setLowPriority(). Per default false.
+     */
+    void setLowPriority(bool lowPriority);
+    bool isLowPriority() const;
+
+    /**
+     * @return Average time in milliseconds per preview, see
+     *         KFileItemModelRolesUpdater::averagePreviewTime().
+     */
+    int averagePreviewTime() const;
+    void resetPreviewStatistics();
+
     QPixmap createDragPixmap(const KItemSet& indexes) const override;
 
 protected:
     KItemListWidgetCreatorBase* defaultWidgetCreator() const override;
     void initializeItemListWidget(KItemListWidget* item) override;
     virtual void onPreviewsShownChanged(bool shown);
+    void onControllerChanged(KItemListController* current, KItemListController* previous) override;
     void onItemLayoutChanged(ItemLayout current, ItemLayout previous) override;
     void onModelChanged(KItemModelBase* current, KItemModelBase* previous) override;
     void onScrollOrientationChanged(Qt::Orientation current, Qt::Orientation previous) override;
     void onItemSizeChanged(const QSizeF& current, const QSizeF& previous) override;
     void onScrollOffsetChanged(qreal current, qreal previous) override;
+    void onScrollOffsetPredicted(int firstIndex, int lastIndex, qreal velocity) override;
     void onVisibleRolesChanged(const QList<QByteArray>& current, const QList<QByteArray>& previous) override;
     void onStyleOptionChanged(const KItemListStyleOption& current, const KItemListStyleOption& previous) override;
     void onSupportsItemExpandingChanged(bool supportsExpanding) override;
@@ -105,6 +136,13 @@ private Q_SLOTS:
     void triggerIconSizeUpdate();
     void updateIconSize();
 
+    /**
+     * Let KFileItemModelRolesUpdater create the thumbnail sequence of the
+     * hovered item, see KFileItemModelRolesUpdater::setHoverSequenceItem().
+     */
+    void slotItemHovered(int index);
+    void slotItemUnhovered(int index);
+
 private:
     /**
      * Applies the roles defined by KItemListView::visibleRoles() to the
@@ -121,11 +159,25 @@ private:
      */
     QSize availableIconSize() const;
 
+    /**
+     * @return Device pixel ratio of the screen that shows the view.
+     */
+    qreal devicePixelRatio() const;
+
+    /**
+     * Measures the scroll velocity from the scroll offset change \a distance
+     * and passes it to the KFileItemModelRolesUpdater.
+     */
+    void updateScrollVelocity(qreal distance);
+
 private:
     KFileItemModelRolesUpdater* m_modelRolesUpdater;
     QTimer* m_updateVisibleIndexRangeTimer;
     QTimer* m_updateIconSizeTimer;
+    QElapsedTimer m_scrollVelocityTimer;
     bool m_scanDirectories;
+    bool m_inBackground;
+    bool m_lowPriority;
 
     friend class KFileItemListViewTest; // For unit testing
 };
@@ -10,13 +10,26 @@
 
 #include "dolphin_detailsmodesettings.h"
 
-#include <KFormat>
 #include <KLocalizedString>
 
+#include <QDateTime>
 #include <QMimeDatabase>
 
+namespace {
+    // Maximum number of memoized texts per kind. The texts are discarded
+    // if there are more, which only happens for huge directories.
+    const int MaximumMemoizedTexts = 10000;
+}
+
 KFileItemListWidgetInformant::KFileItemListWidgetInformant() :
-    KStandardItemListWidgetInformant()
+    KStandardItemListWidgetInformant(),
+    m_locale(),
+    m_formatter(m_locale),
+    m_useShortRelativeDates(DetailsModeSettings::useShortRelativeDates()),
+    m_dateTextsMinute(-1),
+    m_dateTexts(),
+    m_sizeTexts(),
+    m_countTexts()
 {
 }
 
@@ -47,49 +60,41 @@ QString KFileItemListWidgetInformant::roleText(const QByteArray& role,
 {
     QString text;
     const QVariant roleValue = values.value(role);
-    QLocale local;
-    KFormat formatter(local);
 
     // Implementation note: In case if more roles require a custom handling
     // use a hash + switch for a linear runtime.
 
-    auto formatDate = [formatter, local](const QDateTime& time) {
-        if (DetailsModeSettings::useShortRelativeDates()) {
-            return formatter.formatRelativeDateTime(time, QLocale::ShortFormat);
-        } else {
-            return local.toString(time, QLocale::ShortFormat);
-        }
-    };
-
     if (role == "size") {
+        updateFormatters();
         if (values.value("isDir").toBool()) {
             if (!roleValue.isNull() && roleValue != -1) {
                 // The item represents a directory.
                 if (DetailsModeSettings::directorySizeCount()) {
                     //  Show the number of sub directories instead of the file size of the directory.
                     const int count = values.value("count").toInt();
-                    text = i18ncp("@item:intable", "%1 item", "%1 items", count);
+                    text = countText(count);
                 } else {
                     // if we have directory size available
                     const KIO::filesize_t size = roleValue.value<KIO::filesize_t>();
-                    text = formatter.formatByteSize(size);
+                    text = sizeText(size);
                 }
             }
         } else {
             const KIO::filesize_t size = roleValue.value<KIO::filesize_t>();
-            text = formatter.formatByteSize(size);
+            text = sizeText(size);
         }
     } else if (role == "modificationtime" || role == "creationtime" || role == "accesstime") {
             bool ok;
             const long long time = roleValue.toLongLong(&ok);
             if (ok && time != -1) {
-                const QDateTime dateTime = QDateTime::fromSecsSinceEpoch(time);
-                text = formatDate(dateTime);
+                updateFormatters();
+                text = dateText(time);
             }
     } else if (role == "deletiontime" || role == "imageDateTime") {
         const QDateTime dateTime = roleValue.toDateTime();
         if (dateTime.isValid()) {
-            text = formatDate(dateTime);
+            updateFormatters();
+            text = dateText(dateTime.toSecsSinceEpoch());
         }
     } else {
         text = KStandardItemListWidgetInformant::roleText(role, values);
@@ -98,6 +103,75 @@ QString KFileItemListWidgetInformant::roleText(const QByteArray& role,
     return text;
 }
 
+void KFileItemListWidgetInformant::updateFormatters() const
+{
+    const QLocale locale;
+    if (locale != m_locale) {
+        m_locale = locale;
+        m_formatter = KFormat(m_locale);
+        m_dateTexts.clear();
+        m_sizeTexts.clear();
+        m_countTexts.clear();
+    }
+
+    const bool useShortRelativeDates = DetailsModeSettings::useShortRelativeDates();
+    const qint64 minute = QDateTime::currentSecsSinceEpoch() / 60;
+    if (useShortRelativeDates != m_useShortRelativeDates || (m_useShortRelativeDates && minute != m_dateTextsMinute)) {
+        m_useShortRelativeDates = useShortRelativeDates;
+        m_dateTexts.clear();
+    }
+    m_dateTextsMinute = minute;
+}
+
+QString KFileItemListWidgetInformant::dateText(qint64 secsSinceEpoch) const
+{
+    // Negative times are rounded towards the earlier minute
+    const qint64 minute = secsSinceEpoch >= 0 ? secsSinceEpoch / 60 : (secsSinceEpoch - 59) / 60;
+    auto it = m_dateTexts.constFind(minute);
+    if (it != m_dateTexts.constEnd()) {
+        return it.value();
+    }
+
+    const QDateTime time = QDateTime::fromSecsSinceEpoch(minute * 60);
+    const QString text = m_useShortRelativeDates ? m_formatter.formatRelativeDateTime(time, QLocale::ShortFormat)
+                                                 : m_locale.toString(time, QLocale::ShortFormat);
+    if (m_dateTexts.count() >= MaximumMemoizedTexts) {
+        m_dateTexts.clear();
+    }
+    m_dateTexts.insert(minute, text);
+    return text;
+}
+
+QString KFileItemListWidgetInformant::sizeText(KIO::filesize_t size) const
+{
+    auto it = m_sizeTexts.constFind(size);
+    if (it != m_sizeTexts.constEnd()) {
+        return it.value();
+    }
+
+    const QString text = m_formatter.formatByteSize(size);
+    if (m_sizeTexts.count() >= MaximumMemoizedTexts) {
+        m_sizeTexts.clear();
+    }
+    m_sizeTexts.insert(size, text);
+    return text;
+}
+
+QString KFileItemListWidgetInformant::countText(int count) const
+{
+    auto it = m_countTexts.constFind(count);
+    if (it != m_countTexts.constEnd()) {
+        return it.value();
+    }
+
+    const QString text = i18ncp("@item:intable", "%1 item", "%1 items", count);
+    if (m_countTexts.count() >= MaximumMemoizedTexts) {
+        m_countTexts.clear();
+    }
+    m_countTexts.insert(count, text);
+    return text;
+}
+
 QFont KFileItemListWidgetInformant::customizedFontForLinks(const QFont& baseFont) const
 {
     // The customized font should be italic if the file is a symbolic link.
@@ -10,6 +10,12 @@
 #include "dolphin_export.h"
 #include "kitemviews/kstandarditemlistwidget.h"
 
+#include <KFormat>
+#include <KIO/Global>
+
+#include <QHash>
+#include <QLocale>
+
 class DOLPHIN_EXPORT KFileItemListWidgetInformant : public KStandardItemListWidgetInformant
 {
 public:
@@ -21,6 +27,35 @@ protected:
     bool itemIsLink(int index, const KItemListView* view) const override;
     QString roleText(const QByteArray& role, const QHash<QByteArray, QVariant>& values) const override;
     QFont customizedFontForLinks(const QFont& baseFont) const override;
+
+private:
+    /**
+     * Recreates the formatters if the locale has been changed and discards
+     * the memoized texts that might be outdated. The texts of relative
+     * dates like "Today" depend on the current time, so they are only
+     * reused within the same minute.
+     */
+    void updateFormatters() const;
+
+    /**
+     * @return Formatted time \a secsSinceEpoch. The texts are memoized per
+     *         minute, which is the precision of the short date formats.
+     */
+    QString dateText(qint64 secsSinceEpoch) const;
+
+    QString sizeText(KIO::filesize_t size) const;
+    QString countText(int count) const;
+
+private:
+    // roleText() is invoked for each role of each item while measuring and
+    // painting, so the formatters and the texts are kept per view.
+    mutable QLocale m_locale;
+    mutable KFormat m_formatter;
+    mutable bool m_useShortRelativeDates;
+    mutable qint64 m_dateTextsMinute; // Minute since the epoch when m_dateTexts have been formatted
+    mutable QHash<qint64, QString> m_dateTexts; // Keys are the minutes since the epoch
+    mutable QHash<KIO::filesize_t, QString> m_sizeTexts;
+    mutable QHash<int, QString> m_countTexts;
 };
 
 class DOLPHIN_EXPORT KFileItemListWidget : public KStandardItemListWidget
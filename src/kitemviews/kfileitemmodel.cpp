@@ -11,43 +11,382 @@
 #include "dolphin_generalsettings.h"
 #include "dolphin_detailsmodesettings.h"
 #include "dolphindebug.h"
+#include "private/kdirectoryprefetcher.h"
+#include "private/kdirlisterrecorder.h"
+#include "private/kfileitemmimedata.h"
+#include "private/kfileitemmimetyperesolver.h"
 #include "private/kfileitemmodeldirlister.h"
 #include "private/kfileitemmodelsortalgorithm.h"
+#include "private/kitemlistcostmodel.h"
+#include "private/kitemlistmetrics.h"
+#include "private/kitemlisttracer.h"
+#include "private/kitemroleregistry.h"
+#include "private/ktaskscheduler.h"
 
 #include <kio_version.h>
+#include <KIconLoader>
 #include <KLocalizedString>
-#include <KUrlMimeData>
+#include <KUser>
 
+#include <QCoreApplication>
 #include <QElapsedTimer>
+#include <QFileInfo>
+#include <QtConcurrentRun>
 #include <QMimeData>
 #include <QMimeDatabase>
+#include <QPixmap>
+#include <QPointer>
+#include <QRegularExpression>
+#include <QScopedPointer>
+#include <QThreadPool>
 #include <QTimer>
 #include <QWidget>
 #include <QRecursiveMutex>
 #include <QIcon>
 
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <limits>
+
 Q_GLOBAL_STATIC(QRecursiveMutex, s_collatorMutex)
 
+// Threads of the parallel loops over the items, see parallelFor(). The loops
+// don't use QThreadPool::globalInstance(), which sorts the items in the
+// background, and the retrieved role values might block on name lookups.
+Q_GLOBAL_STATIC(QThreadPool, s_parallelForPool)
+
+// Models with enabled snapshots, which share their items with each other
+Q_GLOBAL_STATIC(QSet<KFileItemModel*>, s_sharingModels)
+
 // #define KFILEITEMMODEL_DEBUG
 
+namespace {
+    // If the sort role values of at most RepositionItemsLimit items have
+    // changed, only these items are moved to their new positions instead
+    // of resorting all items.
+    const int RepositionItemsLimit = 100;
+
+    // If at least ParallelFilterItemsLimit items must be checked by the
+    // name filter, the check is done in parallel by several threads.
+    const int ParallelFilterItemsLimit = 5000;
+
+    // If the role values of at least ParallelRetrieveDataItemsLimit items
+    // must be retrieved for sorting, they are retrieved by several threads.
+    const int ParallelRetrieveDataItemsLimit = 5000;
+
+    // If the model contains at least PrefixIndexItemsLimit items, the keyboard
+    // search uses a prefix index instead of comparing the names of all items.
+    const int PrefixIndexItemsLimit = 10000;
+
+    // Bounds in milliseconds of the interval for inserting the items that
+    // have been received while loading a directory. If a visible item count
+    // hint is set, the interval is adjusted so that inserting the items takes
+    // at most a tenth of the loading time. The upper bound is provided by
+    // KItemListCostModel, based on the measured insertion costs.
+    const int MinimumUpdateInterval = 200;
+    const int UpdateCostFactor = 10;
+
+    // Number of search results that are kept in order while searching,
+    // if the visible item count hint is smaller.
+    const int RankedSearchResultsCount = 100;
+
+    // If a directory contains more than HugeDirectoryItemsLimit items, the
+    // items are inserted like search results while it is listed: Merging
+    // hundreds of thousands of items into the sorted items would block the
+    // user interface for too long. All items are sorted in the background
+    // after the listing has been completed.
+    const int HugeDirectoryItemsLimit = 100000;
+
+    // Estimated memory in bytes per item of a collation key, including the
+    // allocation overhead, and of the buffers of parallelMergeSort() and
+    // radixSort(). They are compared with the sorting memory limit.
+    const int SortKeyCost = 96;
+    const int SortBufferCost = 4 * sizeof(void*);
+
+    // Maximum number of directories that are listed at the same time
+    // while restoring expanded directories. The directories are listed
+    // in parallel to avoid one round trip per directory on slow mounts.
+    const int MaximumParallelExpansions = 8;
+
+    // Maximum number of sub-directories that are listed at the
+    // same time if the recursive listing is enabled
+    const int MaximumParallelRecursiveListings = 8;
+
+    // Maximum number of sub-directories of the recursive listing whose
+    // changes are watched. The directory lister forgets the other
+    // sub-directories once they have been listed, as every watched
+    // directory takes an inotify watch.
+    const int MaximumWatchedRecursiveDirs = 256;
+
+    // Maximum time in ms that the low priority background tasks are held
+    // back by one listing, in case it neither completes nor gets canceled
+    const int HoldBackBackgroundTasksTimeout = 10000;
+
+    // Maximum cost in KiB of the snapshots of the recently shown
+    // directories, and the cost in bytes of an item without preview.
+    const int MaximumSnapshotsCost = 32 * 1024;
+    const int SnapshotItemCost = 512;
+
+    // Maximum cost in KiB of the snapshots that are retained after their
+    // models have been deleted
+    const int MaximumRetainedSnapshotsCost = 16 * 1024;
+
+    // Estimated memory in bytes of a KFileItem including its UDS entry, of
+    // a role value in the hash of an item, of an entry of the URL index
+    // and of a group. They are only used for KMemoryBudget.
+    const int FileItemCost = 512;
+    const int RoleValueCost = 48;
+    const int UrlIndexCost = 48;
+    const int GroupCost = 64;
+
+    /**
+     * @return True if the string values of \a role are equal for
+     *         many items and should be shared, see KFileItemModel::sharedString().
+     */
+    bool isSharedStringRole(const QByteArray& role)
+    {
+        return role == "iconName" || role == "type" || role == "owner"
+            || role == "group" || role == "permissions";
+    }
+
+    /**
+     * @return False if both items provide an inode and the inodes differ,
+     *         e.g. because a file has been replaced by another one.
+     */
+    bool sameInode(const KFileItem& item1, const KFileItem& item2)
+    {
+        const long long inode1 = item1.entry().numberValue(KIO::UDSEntry::UDS_INODE, 0);
+        const long long inode2 = item2.entry().numberValue(KIO::UDSEntry::UDS_INODE, 0);
+        return inode1 == 0 || inode2 == 0 || inode1 == inode2;
+    }
+
+    /**
+     * @return True if the item \a listedItem, which has been listed by the
+     *         directory lister, describes the same file as the item
+     *         \a restoredItem of a snapshot.
+     */
+    bool hasSameEntry(const KFileItem& restoredItem, const KFileItem& listedItem)
+    {
+        return restoredItem.size() == listedItem.size()
+            && restoredItem.time(KFileItem::ModificationTime) == listedItem.time(KFileItem::ModificationTime)
+            && restoredItem.mode() == listedItem.mode()
+            && restoredItem.permissions() == listedItem.permissions()
+            && restoredItem.user() == listedItem.user()
+            && restoredItem.group() == listedItem.group()
+            && restoredItem.linkDest() == listedItem.linkDest()
+            && sameInode(restoredItem, listedItem);
+    }
+
+    /**
+     * @return The index of the entry of each role type in \a map,
+     *         or -1 for role types without entry.
+     */
+    template<typename RoleInfoMap, std::size_t count>
+    constexpr std::array<int, KFileItemModel::RolesCount> roleInfoIndexes(const RoleInfoMap (&map)[count])
+    {
+        std::array<int, KFileItemModel::RolesCount> indexes{};
+        for (int& index : indexes) {
+            index = -1;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            indexes[map[i].roleType] = i;
+        }
+        return indexes;
+    }
+
+    /**
+     * Describes how the values of a role are compared by
+     * KFileItemModel::compareRoleValues().
+     */
+    enum class RoleValueKind {
+        NoValue,      // Only the fallbacks are compared, e.g. for the name role
+        Size,         // File sizes and the sizes or item counts of folders
+        Int64Column,  // Values of a KFileItemModelRoleStore::Int64Column
+        StringColumn, // Values of a KFileItemModelRoleStore::StringColumn
+        Integer,      // Integer values in the hash of the items
+        String        // Any other values in the hash of the items
+    };
+
+    constexpr RoleValueKind roleValueKind(KFileItemModel::RoleType roleType)
+    {
+        switch (roleType) {
+        case KFileItemModel::NoRole:
+        case KFileItemModel::NameRole:
+            return RoleValueKind::NoValue;
+        case KFileItemModel::SizeRole:
+            return RoleValueKind::Size;
+        case KFileItemModel::ModificationTimeRole:
+        case KFileItemModel::CreationTimeRole:
+        case KFileItemModel::AccessTimeRole:
+        case KFileItemModel::DeletionTimeRole:
+            return RoleValueKind::Int64Column;
+        case KFileItemModel::PermissionsRole:
+        case KFileItemModel::OwnerRole:
+        case KFileItemModel::GroupRole:
+            return RoleValueKind::StringColumn;
+        case KFileItemModel::RatingRole:
+        case KFileItemModel::WidthRole:
+        case KFileItemModel::HeightRole:
+        case KFileItemModel::WordCountRole:
+        case KFileItemModel::LineCountRole:
+        case KFileItemModel::TrackRole:
+        case KFileItemModel::ReleaseYearRole:
+            return RoleValueKind::Integer;
+        default:
+            return RoleValueKind::String;
+        }
+    }
+
+    constexpr KFileItemModelRoleStore::Int64Column int64Column(KFileItemModel::RoleType roleType)
+    {
+        switch (roleType) {
+        case KFileItemModel::ModificationTimeRole: return KFileItemModelRoleStore::ModificationTimeColumn;
+        case KFileItemModel::CreationTimeRole:     return KFileItemModelRoleStore::CreationTimeColumn;
+        case KFileItemModel::AccessTimeRole:       return KFileItemModelRoleStore::AccessTimeColumn;
+        default:                                   return KFileItemModelRoleStore::DeletionTimeColumn;
+        }
+    }
+
+    constexpr KFileItemModelRoleStore::StringColumn stringColumn(KFileItemModel::RoleType roleType)
+    {
+        switch (roleType) {
+        case KFileItemModel::PermissionsRole: return KFileItemModelRoleStore::PermissionsColumn;
+        case KFileItemModel::OwnerRole:       return KFileItemModelRoleStore::OwnerColumn;
+        default:                              return KFileItemModelRoleStore::GroupColumn;
+        }
+    }
+
+    /**
+     * Calls \a function(first, last) for consecutive ranges that cover the indexes
+     * from 0 to \a count. If \a count is at least \a parallelLimit, the ranges are
+     * processed by the threads of s_parallelForPool together with the calling
+     * thread, which only returns when all ranges have been processed. A few
+     * ranges per thread balance the load, as the items take different amounts
+     * of time. The ranges don't overlap, so each item is accessed by one thread.
+     */
+    void parallelFor(int count, int parallelLimit, const std::function<void(int, int)>& function)
+    {
+        static const int numberOfThreads = QThread::idealThreadCount();
+        if (numberOfThreads < 2 || count < parallelLimit) {
+            function(0, count);
+            return;
+        }
+
+        const int chunkCount = numberOfThreads * 4;
+        QAtomicInt nextChunk(0);
+        const auto processChunks = [&]() {
+            for (int chunk = nextChunk.fetchAndAddRelaxed(1); chunk < chunkCount; chunk = nextChunk.fetchAndAddRelaxed(1)) {
+                function(static_cast<qint64>(count) * chunk / chunkCount,
+                         static_cast<qint64>(count) * (chunk + 1) / chunkCount);
+            }
+        };
+
+        QVector<QFuture<void>> futures;
+        futures.reserve(numberOfThreads - 1);
+        for (int i = 1; i < numberOfThreads; ++i) {
+            futures.append(QtConcurrent::run(s_parallelForPool(), processChunks));
+        }
+        processChunks();
+        for (QFuture<void>& future : futures) {
+            future.waitForFinished();
+        }
+    }
+}
+
 KFileItemModel::KFileItemModel(QObject* parent) :
     KItemModelBase("text", parent),
     m_dirLister(nullptr),
     m_sortDirsFirst(true),
+    m_sortingMemoryLimit(0),
+    m_sortKeysAllowed(true),
     m_sortRole(NameRole),
+    m_sortRoleComparator(roleValueComparator(NameRole)),
     m_sortingProgressPercent(-1),
     m_roles(),
+    m_itemDataPool(),
     m_itemData(),
+    m_roleStore(),
     m_items(),
+    m_itemDataById(),
+    m_nextItemId(1),
     m_filter(),
     m_filteredItems(),
+    m_keptItems(),
+    m_unconfirmedKeptItems(),
+    m_changedKeptItems(),
+    m_prefixIndex(),
     m_requestRole(),
     m_maximumUpdateIntervalTimer(nullptr),
+    m_visibleItemCountHint(0),
+    m_searchModeEnabled(false),
+    m_rankedItemCount(-1),
+    m_hugeDirectory(false),
+    m_estimatedItemCount(-1),
+    m_expectedItemCount(-1),
+    m_listedItemCount(0),
+    m_listedFilesSize(0),
+    m_changeCoalescer(),
+    m_changeCoalescingTimer(nullptr),
+    m_changesDeferred(false),
+    m_listing(false),
+    m_holdingBackBackgroundTasks(false),
+    m_holdBackBackgroundTasksTimer(nullptr),
+    m_keepItemsOnClear(false),
+    m_reloadingKeptItems(false),
+    m_loadingTraceStart(-1),
+    m_firstItemsTraced(false),
     m_resortAllItemsTimer(nullptr),
+    m_itemsToReposition(),
+    m_repositionItemsOnly(false),
+    m_resortingDeferred(false),
+    m_deferredResortPending(false),
+    m_resortProgressThreshold(100),
+    m_movingItemsInBackground(false),
+    m_asyncResortInBackground(false),
+    m_asyncResortWatcher(nullptr),
+    m_asyncResortCanceled(0),
+    m_asyncResortRunning(false),
+    m_asyncResortDuration(0),
+    m_pendingValues(),
+    m_itemsAddedWhileResorting(),
+    m_itemsAddedWhileResortingCount(0),
     m_pendingItemsToInsert(),
+    m_pendingRunEnds(),
+    m_mimeTypeResolver(nullptr),
+    m_pendingMimeTypes(),
     m_groups(),
+    m_nameGroupValues(),
+    m_timeGroupValues(),
+    m_timeGroupValuesDate(),
+    m_permissionGroupValues(),
+    m_sharedStrings(),
+    m_userNames(),
+    m_groupNames(),
+    m_themeIcons(),
+    m_sharedValuesMutex(),
+    m_retrievingDataInParallel(false),
     m_expandedDirs(),
-    m_urlsToExpand()
+    m_urlsToExpand(),
+    m_expandingDirs(),
+    m_recursiveListing(false),
+    m_recursiveListingDepth(0),
+    m_recursiveDirs(),
+    m_recursiveDirsToList(),
+    m_listingRecursiveDirs(),
+    m_watchedRecursiveDirs(),
+    m_recursiveDirsToForget(),
+    m_recursiveDirsForgotten(false),
+    m_recursiveListingTimer(nullptr),
+    m_snapshots(0),
+    m_snapshotContext(),
+    m_unconfirmedRestoredUrls(),
+    m_restoredItems(),
+    m_cachedSearchResults(),
+    m_cachedSearchResultsUrl(),
+    m_narrowedSearchUrl(),
+    m_narrowedSearchItems(),
+    m_itemsSnapshotTracker(nullptr)
 {
     m_collator.setNumericMode(true);
 
@@ -55,6 +394,14 @@ KFileItemModel::KFileItemModel(QObject* parent) :
 
     m_dirLister = new KFileItemModelDirLister(this);
     m_dirLister->setDelayedMimeTypes(true);
+    m_dirLister->setLocalListingEnabled(GeneralSettings::listLocalDirectoriesDirectly());
+    m_dirLister->setIndexedSearchEnabled(GeneralSettings::indexFileNameSearch());
+    m_dirLister->setContentSearchEnabled(GeneralSettings::searchContentDirectly());
+
+    const QString recordingFilePath = KDirListerRecorder::nextRecordingFilePath();
+    if (!recordingFilePath.isEmpty()) {
+        new KDirListerRecorder(m_dirLister, recordingFilePath);
+    }
 
     const QWidget* parentWidget = qobject_cast<QWidget*>(parent);
     if (parentWidget) {
@@ -62,16 +409,32 @@ KFileItemModel::KFileItemModel(QObject* parent) :
     }
 
     connect(m_dirLister, &KFileItemModelDirLister::started, this, &KFileItemModel::directoryLoadingStarted);
+    connect(m_dirLister, &KFileItemModelDirLister::started, this, [this](const QUrl& url) {
+        // Listing remote folders does not compete with the background tasks for the local disks
+        setHoldingBackBackgroundTasks(url.isLocalFile());
+    });
     connect(m_dirLister, QOverload<>::of(&KCoreDirLister::canceled), this, &KFileItemModel::slotCanceled);
-    connect(m_dirLister, &KFileItemModelDirLister::itemsAdded, this, &KFileItemModel::slotItemsAdded);
-    connect(m_dirLister, &KFileItemModelDirLister::itemsDeleted, this, &KFileItemModel::slotItemsDeleted);
-    connect(m_dirLister, &KFileItemModelDirLister::refreshItems, this, &KFileItemModel::slotRefreshItems);
+    connect(m_dirLister, &KFileItemModelDirLister::itemsAdded, this, &KFileItemModel::queueItemsAdded);
+    connect(m_dirLister, &KFileItemModelDirLister::itemsDeleted, this, &KFileItemModel::queueItemsDeleted);
+    connect(m_dirLister, &KFileItemModelDirLister::refreshItems, this, &KFileItemModel::queueRefreshItems);
+    connect(m_dirLister, QOverload<>::of(&KCoreDirLister::completed), this, [this]() {
+        m_listing = false;
+        setHoldingBackBackgroundTasks(false);
+    });
     connect(m_dirLister, QOverload<>::of(&KCoreDirLister::clear), this, &KFileItemModel::slotClear);
     connect(m_dirLister, &KFileItemModelDirLister::infoMessage, this, &KFileItemModel::infoMessage);
     connect(m_dirLister, &KFileItemModelDirLister::errorMessage, this, &KFileItemModel::errorMessage);
+    connect(m_dirLister, &KFileItemModelDirLister::errorMessage, this, [this]() {
+        setHoldingBackBackgroundTasks(false);
+    });
     connect(m_dirLister, &KFileItemModelDirLister::percent, this, &KFileItemModel::directoryLoadingProgress);
     connect(m_dirLister, QOverload<const QUrl&, const QUrl&>::of(&KCoreDirLister::redirection), this, &KFileItemModel::directoryRedirection);
     connect(m_dirLister, &KFileItemModelDirLister::urlIsFileError, this, &KFileItemModel::urlIsFileError);
+    connect(m_dirLister, &KFileItemModelDirLister::entryCountKnown, this, [this](const QUrl& url, int count) {
+        if (url.adjusted(QUrl::StripTrailingSlash) == directory().adjusted(QUrl::StripTrailingSlash)) {
+            m_estimatedItemCount = count;
+        }
+    });
 
 #if KIO_VERSION < QT_VERSION_CHECK(5, 79, 0)
     connect(m_dirLister, QOverload<const QUrl&>::of(&KCoreDirLister::completed), this, &KFileItemModel::slotCompleted);
@@ -92,36 +455,134 @@ KFileItemModel::KFileItemModel(QObject* parent) :
     // For slow KIO-slaves like used for searching it makes sense to show results periodically even
     // before the completed() or canceled() signal has been emitted.
     m_maximumUpdateIntervalTimer = new QTimer(this);
-    m_maximumUpdateIntervalTimer->setInterval(2000);
+    m_maximumUpdateIntervalTimer->setInterval(KItemListCostModel::instance().maximumUpdateInterval());
     m_maximumUpdateIntervalTimer->setSingleShot(true);
     connect(m_maximumUpdateIntervalTimer, &QTimer::timeout, this, &KFileItemModel::dispatchPendingItemsToInsert);
 
+    m_changeCoalescingTimer = new QTimer(this);
+    m_changeCoalescingTimer->setInterval(0);
+    m_changeCoalescingTimer->setSingleShot(true);
+    connect(m_changeCoalescingTimer, &QTimer::timeout, this, &KFileItemModel::applyQueuedChanges);
+
+    m_holdBackBackgroundTasksTimer = new QTimer(this);
+    m_holdBackBackgroundTasksTimer->setInterval(HoldBackBackgroundTasksTimeout);
+    m_holdBackBackgroundTasksTimer->setSingleShot(true);
+    connect(m_holdBackBackgroundTasksTimer, &QTimer::timeout, this, [this]() {
+        setHoldingBackBackgroundTasks(false);
+    });
+
+    // The icons of the theme are looked up again after the theme has been changed
+    connect(KIconLoader::global(), &KIconLoader::iconLoaderSettingsChanged, this, [this]() {
+        m_themeIcons.clear();
+    });
+
+    m_recursiveListingTimer = new QTimer(this);
+    m_recursiveListingTimer->setInterval(0);
+    m_recursiveListingTimer->setSingleShot(true);
+    connect(m_recursiveListingTimer, &QTimer::timeout, this, &KFileItemModel::updateRecursiveListing);
+
     // When changing the value of an item which represents the sort-role a resorting must be
     // triggered. Especially in combination with KFileItemModelRolesUpdater this might be done
     // for a lot of items within a quite small timeslot. To prevent expensive resortings the
     // resorting is postponed until the timer has been exceeded.
     m_resortAllItemsTimer = new QTimer(this);
-    m_resortAllItemsTimer->setInterval(500);
+    m_resortAllItemsTimer->setInterval(KItemListCostModel::instance().resortDelay(0));
     m_resortAllItemsTimer->setSingleShot(true);
-    connect(m_resortAllItemsTimer, &QTimer::timeout, this, &KFileItemModel::resortAllItems);
+    connect(m_resortAllItemsTimer, &QTimer::timeout, this, &KFileItemModel::slotResortTimerTimeout);
+
+    m_asyncResortWatcher = new QFutureWatcher<QList<ItemData*> >(this);
+    connect(m_asyncResortWatcher, &QFutureWatcher<QList<ItemData*> >::finished, this, &KFileItemModel::slotAsyncResortFinished);
+
+    // The model indexes of the prefix index get invalid by any change of the items
+    connect(this, &KFileItemModel::itemsInserted, this, [this]() { m_prefixIndex.clear(); });
+    connect(this, &KFileItemModel::itemsRemoved, this, [this]() { m_prefixIndex.clear(); });
+    connect(this, &KFileItemModel::itemsMoved, this, [this]() { m_prefixIndex.clear(); });
+    connect(this, &KFileItemModel::itemsChanged, this, [this](const KItemRangeList&, const QSet<QByteArray>& roles) {
+        if (roles.contains("text")) {
+            m_prefixIndex.clear();
+        }
+    });
+
+    m_mimeTypeResolver = new KFileItemMimeTypeResolver(this);
+    connect(m_mimeTypeResolver, &KFileItemMimeTypeResolver::mimeTypesResolved, this, &KFileItemModel::slotMimeTypesResolved);
 
     connect(GeneralSettings::self(), &GeneralSettings::sortingChoiceChanged, this, &KFileItemModel::slotSortingChoiceChanged);
+
+    KItemListMetrics::instance().add(KItemListMetrics::Models);
 }
 
 KFileItemModel::~KFileItemModel()
 {
-    qDeleteAll(m_itemData);
-    qDeleteAll(m_filteredItems);
-    qDeleteAll(m_pendingItemsToInsert);
+    // The worker thread must not access the items anymore. Unlike
+    // cancelAsyncResort() the pending values are not applied, as
+    // the destroyed model may not emit any signals.
+    if (isAsyncResortRunning()) {
+        m_asyncResortCanceled.storeRelaxed(1);
+        m_asyncResortWatcher->waitForFinished();
+        m_asyncResortRunning = false;
+    }
+    setHoldingBackBackgroundTasks(false);
+    KItemListMetrics::instance().add(KItemListMetrics::Models, -1);
+
+    if (!s_sharingModels.isDestroyed()) {
+        s_sharingModels->remove(this);
+    }
+
+    // The item-data of m_itemData, m_filteredItems, m_keptItems and
+    // m_pendingItemsToInsert is destroyed by m_itemDataPool.
 }
 
 void KFileItemModel::loadDirectory(const QUrl &url)
 {
+    if (KItemListTracer::isEnabled()) {
+        m_loadingTraceStart = KItemListTracer::timestamp();
+        m_firstItemsTraced = false;
+    }
+
+    updateCollatorLocale();
+    takeSnapshot();
+    m_listing = true;
     m_dirLister->openUrl(url);
+
+    // The directory lister has cleared the estimate of the previous directory synchronously
+    if (m_expectedItemCount >= 0 && m_estimatedItemCount < 0) {
+        m_estimatedItemCount = m_expectedItemCount;
+    }
+    m_expectedItemCount = -1;
+    if (!restoreNarrowedSearch(url)) {
+        restoreSnapshot(url);
+    }
+    traceFirstItems();
 }
 
 void KFileItemModel::refreshDirectory(const QUrl &url)
 {
+    applyQueuedChanges();
+    m_listing = true;
+
+    if (m_expandedDirs.isEmpty() && !m_recursiveListing && !m_searchModeEnabled && !m_itemData.isEmpty()
+            && m_dirLister->isFinished() && url.matches(directory(), QUrl::StripTrailingSlash)) {
+        // The current items are handled like the items of a snapshot: The items
+        // that are listed again are confirmed by confirmRestoredItems() and keep
+        // their role values and previews, the changed items are refreshed, and
+        // the items that are not listed again are removed when the listing is
+        // completed. The filtered items are created again while listing.
+        dispatchPendingItemsToInsert();
+        removeFilteredItems([](const ItemData*) {
+            return true;
+        });
+        for (const ItemData* itemData : qAsConst(m_itemData)) {
+            m_unconfirmedRestoredUrls.insert(itemData->item.url());
+        }
+
+        // The directory lister emits clear() synchronously
+        m_keepItemsOnClear = true;
+        m_reloadingKeptItems = true;
+        m_dirLister->openUrl(url, KDirLister::Reload);
+        m_keepItemsOnClear = false;
+        return;
+    }
+
     // Refresh all expanded directories first (Bug 295300)
     QHashIterator<QUrl, QUrl> expandedDirs(m_expandedDirs);
     while (expandedDirs.hasNext()) {
@@ -130,6 +591,7 @@ void KFileItemModel::refreshDirectory(const QUrl &url)
     }
 
     m_dirLister->openUrl(url, KDirLister::Reload);
+    clearRecursiveDirectories();
 }
 
 QUrl KFileItemModel::directory() const
@@ -137,6 +599,11 @@ QUrl KFileItemModel::directory() const
     return m_dirLister->url();
 }
 
+bool KFileItemModel::isMovingItemsInBackground() const
+{
+    return m_movingItemsInBackground;
+}
+
 void KFileItemModel::cancelDirectoryLoading()
 {
     m_dirLister->stop();
@@ -152,6 +619,10 @@ QHash<QByteArray, QVariant> KFileItemModel::data(int index) const
     if (index >= 0 && index < count()) {
         ItemData* data = m_itemData.at(index);
         if (data->values.isEmpty()) {
+            if (isAsyncResortRunning()) {
+                // The worker thread might read the values while sorting.
+                return retrieveData(data->item, data->parent);
+            }
             data->values = retrieveData(data->item, data->parent);
         }
 
@@ -160,41 +631,172 @@ QHash<QByteArray, QVariant> KFileItemModel::data(int index) const
     return QHash<QByteArray, QVariant>();
 }
 
+QVariant KFileItemModel::retrievedValue(int index, const QByteArray& role) const
+{
+    if (index >= 0 && index < count()) {
+        return m_itemData.at(index)->values.value(role);
+    }
+    return QVariant();
+}
+
 bool KFileItemModel::setData(int index, const QHash<QByteArray, QVariant>& values)
 {
     if (index < 0 || index >= count()) {
         return false;
     }
 
-    QHash<QByteArray, QVariant> currentValues = data(index);
+    if (isAsyncResortRunning()) {
+        // The items must not be changed while they are sorted in the worker
+        // thread. The values are applied after the resorting has been finished.
+        m_pendingValues.append(qMakePair(m_itemData.at(index), values));
+        return true;
+    }
 
-    // Determine which roles have been changed
     QSet<QByteArray> changedRoles;
-    QHashIterator<QByteArray, QVariant> it(values);
-    while (it.hasNext()) {
-        it.next();
-        const QByteArray role = sharedValue(it.key());
-        const QVariant value = it.value();
+    if (!updateValues(index, values, changedRoles)) {
+        return false;
+    }
+
+    emitItemsChangedAndTriggerResorting(KItemRangeList() << KItemRange(index, 1), changedRoles);
+
+    return true;
+}
+
+bool KFileItemModel::setItemsData(const QHash<int, QHash<QByteArray, QVariant> >& itemsValues)
+{
+    QVector<int> changedIndexes;
+    changedIndexes.reserve(itemsValues.count());
+    QSet<QByteArray> changedRoles;
+
+    const bool asyncResortRunning = isAsyncResortRunning();
+    for (auto it = itemsValues.constBegin(); it != itemsValues.constEnd(); ++it) {
+        const int index = it.key();
+        if (index < 0 || index >= count()) {
+            continue;
+        }
 
-        if (currentValues[role] != value) {
-            currentValues[role] = value;
-            changedRoles.insert(role);
+        if (asyncResortRunning) {
+            m_pendingValues.append(qMakePair(m_itemData.at(index), it.value()));
+            changedIndexes.append(index);
+        } else if (updateValues(index, it.value(), changedRoles)) {
+            changedIndexes.append(index);
         }
     }
 
-    if (changedRoles.isEmpty()) {
+    if (changedIndexes.isEmpty()) {
         return false;
     }
 
-    m_itemData[index]->values = currentValues;
-    if (changedRoles.contains("text")) {
-        QUrl url = m_itemData[index]->item.url();
-        url = url.adjusted(QUrl::RemoveFilename);
-        url.setPath(url.path() + currentValues["text"].toString());
-        m_itemData[index]->item.setUrl(url);
+    if (!asyncResortRunning) {
+        std::sort(changedIndexes.begin(), changedIndexes.end());
+        emitItemsChangedAndTriggerResorting(KItemRangeList::fromSortedContainer(changedIndexes), changedRoles);
     }
 
-    emitItemsChangedAndTriggerResorting(KItemRangeList() << KItemRange(index, 1), changedRoles);
+    return true;
+}
+
+bool KFileItemModel::setRoleValues(const QByteArray& role, const KItemRangeList& itemRanges, const QVector<QVariant>& values)
+{
+    const QByteArray internedRole = KItemRoleRegistry::intern(role);
+    if (isAsyncResortRunning()) {
+        // The values have to be collected while resorting, which is done by setItemsData()
+        QHash<int, QHash<QByteArray, QVariant> > itemsValues;
+        int valueIndex = 0;
+        for (const KItemRange& range : itemRanges) {
+            for (int index = range.index; index < range.index + range.count && valueIndex < values.count(); ++index) {
+                QHash<QByteArray, QVariant> itemValues;
+                itemValues.insert(internedRole, values.at(valueIndex++));
+                itemsValues.insert(index, itemValues);
+            }
+        }
+        return setItemsData(itemsValues);
+    }
+
+    const int itemCount = count();
+    QVector<int> changedIndexes;
+    QSet<QByteArray> changedRoles;
+    // The hash is reused for all items, so that it is only allocated once
+    QHash<QByteArray, QVariant> itemValues;
+    int valueIndex = 0;
+    for (const KItemRange& range : itemRanges) {
+        for (int index = range.index; index < range.index + range.count; ++index, ++valueIndex) {
+            if (valueIndex >= values.count()) {
+                Q_ASSERT_X(false, "KFileItemModel::setRoleValues", "Fewer values than items");
+                break;
+            }
+            if (index < 0 || index >= itemCount) {
+                continue;
+            }
+
+            itemValues.insert(internedRole, values.at(valueIndex));
+            if (updateValues(index, itemValues, changedRoles)) {
+                changedIndexes.append(index);
+            }
+        }
+    }
+
+    if (changedIndexes.isEmpty()) {
+        return false;
+    }
+
+    // The ranges might not be sorted
+    std::sort(changedIndexes.begin(), changedIndexes.end());
+    emitItemsChangedAndTriggerResorting(KItemRangeList::fromSortedContainer(changedIndexes), changedRoles);
+    return true;
+}
+
+bool KFileItemModel::updateValues(int index, const QHash<QByteArray, QVariant>& values, QSet<QByteArray>& changedRoles)
+{
+    static const QByteArray textRole = KItemRoleRegistry::intern("text");
+
+    ItemData* itemData = m_itemData[index];
+    if (itemData->values.isEmpty()) {
+        itemData->values = retrieveData(itemData->item, itemData->parent);
+    }
+
+    // Determine which roles have been changed. The values are changed in
+    // place, so that the values of the item are only detached from the
+    // copies of the item widgets if a value has really changed.
+    QHash<QByteArray, QVariant>& currentValues = itemData->values;
+    bool changed = false;
+    bool textChanged = false;
+    for (auto it = values.constBegin(); it != values.constEnd(); ++it) {
+        const QByteArray role = KItemRoleRegistry::intern(it.key());
+        QVariant value = it.value();
+        if (value.type() == QVariant::String && isSharedStringRole(role)) {
+            value = sharedString(value.toString());
+        }
+
+        const auto currentIt = currentValues.constFind(role);
+        const bool valueChanged = (currentIt == currentValues.constEnd()) ? value.isValid() : (*currentIt != value);
+        if (!valueChanged) {
+            continue;
+        }
+
+        currentValues.insert(role, value);
+        changedRoles.insert(role);
+        changed = true;
+        textChanged = textChanged || role == textRole;
+    }
+
+    if (!changed) {
+        return false;
+    }
+
+    if (textChanged) {
+        const bool isInIndexCache = (m_items.remove(urlKey(itemData)) > 0);
+
+        QUrl url = itemData->item.url();
+        url = url.adjusted(QUrl::RemoveFilename);
+        url.setPath(url.path() + currentValues.value(textRole).toString());
+        itemData->item.setUrl(url);
+        updateUrlHash(itemData);
+        updateSortKey(itemData);
+
+        if (isInIndexCache) {
+            m_items.insert(urlKey(itemData), index);
+        }
+    }
 
     return true;
 }
@@ -202,8 +804,9 @@ bool KFileItemModel::setData(int index, const QHash<QByteArray, QVariant>& value
 void KFileItemModel::setSortDirectoriesFirst(bool dirsFirst)
 {
     if (dirsFirst != m_sortDirsFirst) {
+        cancelAsyncResort();
         m_sortDirsFirst = dirsFirst;
-        resortAllItems();
+        reorderDirectoriesAndFiles();
     }
 }
 
@@ -215,10 +818,7 @@ bool KFileItemModel::sortDirectoriesFirst() const
 void KFileItemModel::setShowHiddenFiles(bool show)
 {
     m_dirLister->setShowingDotFiles(show);
-    m_dirLister->emitChanges();
-    if (show) {
-        dispatchPendingItemsToInsert();
-    }
+    applyDirListerSettings(show);
 }
 
 bool KFileItemModel::showHiddenFiles() const
@@ -236,15 +836,47 @@ bool KFileItemModel::showDirectoriesOnly() const
     return m_dirLister->dirOnlyMode();
 }
 
-QMimeData* KFileItemModel::createMimeData(const KItemSet& indexes) const
+void KFileItemModel::setRecursiveListing(bool enabled)
+{
+    if (m_recursiveListing == enabled) {
+        return;
+    }
+
+    m_recursiveListing = enabled;
+    m_urlsToExpand.clear();
+
+    const QUrl url = directory();
+    if (url.isValid()) {
+        // KDirLister clears the model before listing the directory again
+        m_listing = true;
+        m_dirLister->openUrl(url);
+    }
+}
+
+bool KFileItemModel::recursiveListing() const
+{
+    return m_recursiveListing;
+}
+
+void KFileItemModel::setRecursiveListingDepth(int depth)
+{
+    m_recursiveListingDepth = qMax(0, depth);
+}
+
+int KFileItemModel::recursiveListingDepth() const
 {
-    QMimeData* data = new QMimeData();
+    return m_recursiveListingDepth;
+}
 
+QMimeData* KFileItemModel::createMimeData(const KItemSet& indexes) const
+{
     // The following code has been taken from KDirModel::mimeData()
     // (kdelibs/kio/kio/kdirmodel.cpp)
     // SPDX-FileCopyrightText: 2006 David Faure <faure@kde.org>
-    QList<QUrl> urls;
-    QList<QUrl> mostLocalUrls;
+    // The URLs are only created by KFileItemMimeData when they are
+    // requested by the drop target or the clipboard.
+    KFileItemList items;
+    items.reserve(indexes.count());
     const ItemData* lastAddedItem = nullptr;
 
     for (int index : indexes) {
@@ -263,20 +895,30 @@ QMimeData* KFileItemModel::createMimeData(const KItemSet& indexes) const
         lastAddedItem = itemData;
         const KFileItem& item = itemData->item;
         if (!item.isNull()) {
-            urls << item.url();
-
-            bool isLocal;
-            mostLocalUrls << item.mostLocalUrl(&isLocal);
+            items.append(item);
         }
     }
 
-    KUrlMimeData::setUrls(urls, mostLocalUrls, data);
-    return data;
+    return new KFileItemMimeData(items);
 }
 
 int KFileItemModel::indexForKeyboardSearch(const QString& text, int startFromIndex) const
 {
     startFromIndex = qMax(0, startFromIndex);
+
+    const int itemCount = count();
+    if (itemCount >= PrefixIndexItemsLimit) {
+        if (!m_prefixIndex.isBuilt()) {
+            QVector<QString> names;
+            names.reserve(itemCount);
+            for (const ItemData* itemData : m_itemData) {
+                names.append(itemData->item.text());
+            }
+            m_prefixIndex.build(names);
+        }
+        return m_prefixIndex.indexOf(text, startFromIndex);
+    }
+
     for (int i = startFromIndex; i < count(); ++i) {
         if (fileItem(i).text().startsWith(text, Qt::CaseInsensitive)) {
             return i;
@@ -290,6 +932,36 @@ int KFileItemModel::indexForKeyboardSearch(const QString& text, int startFromInd
     return -1;
 }
 
+KItemSet KFileItemModel::indexesMatching(const QRegularExpression& regexp) const
+{
+    const int itemCount = count();
+
+    // Each thread writes to its own part of the vector only
+    QVector<bool> matches(itemCount, false);
+    bool* matchesData = matches.data();
+    const auto matchNames = [&](int first, int last) {
+        for (int i = first; i < last; ++i) {
+            matchesData[i] = regexp.match(m_itemData.at(i)->item.text()).hasMatch();
+        }
+    };
+
+    parallelFor(itemCount, ParallelFilterItemsLimit, matchNames);
+
+    // Consecutive matches are stored as one range
+    KItemRangeList ranges;
+    int rangeBegin = -1;
+    for (int i = 0; i <= itemCount; ++i) {
+        const bool match = i < itemCount && matchesData[i];
+        if (match && rangeBegin < 0) {
+            rangeBegin = i;
+        } else if (!match && rangeBegin >= 0) {
+            ranges.append(KItemRange(rangeBegin, i - rangeBegin));
+            rangeBegin = -1;
+        }
+    }
+    return KItemSet(ranges);
+}
+
 bool KFileItemModel::supportsDropping(int index) const
 {
     const KFileItem item = fileItem(index);
@@ -320,32 +992,16 @@ QList<QPair<int, QVariant> > KFileItemModel::groups() const
         QElapsedTimer timer;
         timer.start();
 #endif
-        switch (typeForRole(sortRole())) {
-        case NameRole:        m_groups = nameRoleGroups(); break;
-        case SizeRole:        m_groups = sizeRoleGroups(); break;
-        case ModificationTimeRole:
-            m_groups = timeRoleGroups([](const ItemData *item) {
-                return item->item.time(KFileItem::ModificationTime);
-            });
-            break;
-        case CreationTimeRole:
-            m_groups = timeRoleGroups([](const ItemData *item) {
-                return item->item.time(KFileItem::CreationTime);
-            });
-            break;
-        case AccessTimeRole:
-            m_groups = timeRoleGroups([](const ItemData *item) {
-                return item->item.time(KFileItem::AccessTime);
-            });
-            break;
-        case DeletionTimeRole:
-            m_groups = timeRoleGroups([](const ItemData *item) {
-                return item->values.value("deletiontime").toDateTime();
-            });
-            break;
-        case PermissionsRole: m_groups = permissionRoleGroups(); break;
-        case RatingRole:      m_groups = ratingRoleGroups(); break;
-        default:              m_groups = genericStringRoleGroups(sortRole()); break;
+        const int maxIndex = count() - 1;
+        for (int i = 0; i <= maxIndex; ++i) {
+            if (isChildItem(i)) {
+                continue;
+            }
+
+            const QVariant newGroupValue = groupValue(m_itemData.at(i));
+            if (m_groups.isEmpty() || newGroupValue != m_groups.last().second) {
+                m_groups.append(QPair<int, QVariant>(i, newGroupValue));
+            }
         }
 
 #ifdef KFILEITEMMODEL_DEBUG
@@ -365,6 +1021,14 @@ KFileItem KFileItemModel::fileItem(int index) const
     return KFileItem();
 }
 
+KFileItemModelSnapshot KFileItemModel::itemsSnapshot() const
+{
+    if (!m_itemsSnapshotTracker) {
+        m_itemsSnapshotTracker = new KFileItemModelSnapshotTracker(const_cast<KFileItemModel*>(this));
+    }
+    return m_itemsSnapshotTracker->snapshot();
+}
+
 KFileItem KFileItemModel::fileItem(const QUrl &url) const
 {
     const int indexForUrl = index(url);
@@ -381,31 +1045,7 @@ int KFileItemModel::index(const KFileItem& item) const
 
 int KFileItemModel::index(const QUrl& url) const
 {
-    const QUrl urlToFind = url.adjusted(QUrl::StripTrailingSlash);
-
-    const int itemCount = m_itemData.count();
-    int itemsInHash = m_items.count();
-
-    int index = m_items.value(urlToFind, -1);
-    while (index < 0 && itemsInHash < itemCount) {
-        // Not all URLs are stored yet in m_items. We grow m_items until either
-        // urlToFind is found, or all URLs have been stored in m_items.
-        // Note that we do not add the URLs to m_items one by one, but in
-        // larger blocks. After each block, we check if urlToFind is in
-        // m_items. We could in principle compare urlToFind with each URL while
-        // we are going through m_itemData, but comparing two QUrls will,
-        // unlike calling qHash for the URLs, trigger a parsing of the URLs
-        // which costs both CPU cycles and memory.
-        const int blockSize = 1000;
-        const int currentBlockEnd = qMin(itemsInHash + blockSize, itemCount);
-        for (int i = itemsInHash; i < currentBlockEnd; ++i) {
-            const QUrl nextUrl = m_itemData.at(i)->item.url();
-            m_items.insert(nextUrl, i);
-        }
-
-        itemsInHash = currentBlockEnd;
-        index = m_items.value(urlToFind, -1);
-    }
+    const int index = indexForKey(urlKey(url.adjusted(QUrl::StripTrailingSlash)));
 
     if (index < 0) {
         // The item could not be found, even though all items from m_itemData
@@ -450,6 +1090,54 @@ int KFileItemModel::index(const QUrl& url) const
     return index;
 }
 
+quint32 KFileItemModel::itemId(int index) const
+{
+    if (index < 0 || index >= m_itemData.count()) {
+        return 0;
+    }
+    return m_itemData.at(index)->id;
+}
+
+int KFileItemModel::indexForItemId(quint32 id) const
+{
+    const ItemData* data = m_itemDataById.value(id);
+    if (!data) {
+        return -1;
+    }
+
+    // Filtered, kept and pending items are not in m_itemData
+    const int index = indexForKey(urlKey(data));
+    return (index >= 0 && m_itemData.at(index) == data) ? index : -1;
+}
+
+int KFileItemModel::indexForKey(const UrlKey& keyToFind) const
+{
+    const int itemCount = m_itemData.count();
+    int itemsInHash = m_items.count();
+
+    int index = m_items.value(keyToFind, -1);
+    while (index < 0 && itemsInHash < itemCount) {
+        // Not all URLs are stored yet in m_items. We grow m_items until either
+        // keyToFind is found, or all URLs have been stored in m_items.
+        // Note that we do not add the URLs to m_items one by one, but in
+        // larger blocks. After each block, we check if keyToFind is in
+        // m_items. We could in principle compare the URL with each URL while
+        // we are going through m_itemData, but comparing two QUrls will,
+        // unlike using the precalculated hash values of the URLs, trigger a
+        // parsing of the URLs which costs both CPU cycles and memory.
+        const int blockSize = 1000;
+        const int currentBlockEnd = qMin(itemsInHash + blockSize, itemCount);
+        for (int i = itemsInHash; i < currentBlockEnd; ++i) {
+            m_items.insert(urlKey(m_itemData.at(i)), i);
+        }
+
+        itemsInHash = currentBlockEnd;
+        index = m_items.value(keyToFind, -1);
+    }
+
+    return index;
+}
+
 KFileItem KFileItemModel::rootItem() const
 {
     return m_dirLister->rootItem();
@@ -466,6 +1154,8 @@ void KFileItemModel::setRoles(const QSet<QByteArray>& roles)
         return;
     }
 
+    cancelAsyncResort();
+
     const QSet<QByteArray> changedRoles = (roles - m_roles) + (m_roles - roles);
     m_roles = roles;
 
@@ -493,18 +1183,25 @@ void KFileItemModel::setRoles(const QSet<QByteArray>& roles)
         const int maxIndex = count() - 1;
         for (int i = 0; i <= maxIndex; ++i) {
             m_itemData[i]->values = retrieveData(m_itemData.at(i)->item, m_itemData.at(i)->parent);
+            updateRoleStore(m_itemData.at(i));
         }
 
         Q_EMIT itemsChanged(KItemRangeList() << KItemRange(0, count()), changedRoles);
     }
 
-    // Clear the 'values' of all filtered items. They will be re-populated with the
-    // correct roles the next time 'values' will be accessed via data(int).
-    QHash<KFileItem, ItemData*>::iterator filteredIt = m_filteredItems.begin();
-    const QHash<KFileItem, ItemData*>::iterator filteredEnd = m_filteredItems.end();
-    while (filteredIt != filteredEnd) {
-        (*filteredIt)->values.clear();
-        ++filteredIt;
+    // Clear the 'values' of all filtered and kept items. They will be re-populated with
+    // the correct roles the next time 'values' will be accessed via data(int).
+    for (ItemData* itemData : qAsConst(m_filteredItems)) {
+        itemData->values.clear();
+        updateRoleStore(itemData);
+    }
+    for (ItemData* itemData : qAsConst(m_keptItems)) {
+        itemData->values.clear();
+        updateRoleStore(itemData);
+    }
+
+    for (const ItemData* itemData : qAsConst(m_pendingItemsToInsert)) {
+        updateRoleStore(itemData);
     }
 }
 
@@ -519,8 +1216,12 @@ bool KFileItemModel::setExpanded(int index, bool expanded)
         return false;
     }
 
+    // The values of the item are read and changed below, which is
+    // not possible while the items are sorted.
+    cancelAsyncResort();
+
     QHash<QByteArray, QVariant> values;
-    values.insert(sharedValue("isExpanded"), expanded);
+    values.insert(roleForType(IsExpandedRole), expanded);
     if (!setData(index, values)) {
         return false;
     }
@@ -529,7 +1230,11 @@ bool KFileItemModel::setExpanded(int index, bool expanded)
     const QUrl url = item.url();
     const QUrl targetUrl = item.targetUrl();
     if (expanded) {
+        applyQueuedChanges();
+        m_listing = true;
+
         m_expandedDirs.insert(targetUrl, url);
+        m_expandingDirs.insert(url);
         m_dirLister->openUrl(url, KDirLister::Keep);
 
         const QVariantList previouslyExpandedChildren = m_itemData.at(index)->values.value("previouslyExpandedChildren").value<QVariantList>();
@@ -550,27 +1255,26 @@ bool KFileItemModel::setExpanded(int index, bool expanded)
         }
 
         m_expandedDirs.remove(targetUrl);
+        m_expandingDirs.remove(url);
         m_dirLister->stop(url);
 
-        const int parentLevel = expandedParentsCount(index);
-        const int itemCount = m_itemData.count();
         const int firstChildIndex = index + 1;
+        const int childrenEnd = subtreeEnd(index);
 
         QVariantList expandedChildren;
 
-        int childIndex = firstChildIndex;
-        while (childIndex < itemCount && expandedParentsCount(childIndex) > parentLevel) {
+        for (int childIndex = firstChildIndex; childIndex < childrenEnd; ++childIndex) {
             ItemData* itemData = m_itemData.at(childIndex);
             if (itemData->values.value("isExpanded").toBool()) {
                 const QUrl targetUrl = itemData->item.targetUrl();
                 const QUrl url = itemData->item.url();
                 m_expandedDirs.remove(targetUrl);
+                m_expandingDirs.remove(url);
                 m_dirLister->stop(url);     // TODO: try to unit-test this, see https://bugs.kde.org/show_bug.cgi?id=332102#c11
                 expandedChildren.append(targetUrl);
             }
-            ++childIndex;
         }
-        const int childrenCount = childIndex - firstChildIndex;
+        const int childrenCount = childrenEnd - firstChildIndex;
 
         removeFilteredChildren(KItemRangeList() << KItemRange(index, 1 + childrenCount));
         removeItems(KItemRangeList() << KItemRange(firstChildIndex, childrenCount), DeleteItemData);
@@ -591,6 +1295,11 @@ bool KFileItemModel::isExpanded(int index) const
 
 bool KFileItemModel::isExpandable(int index) const
 {
+    if (m_recursiveListing) {
+        // All items are shown as top-level items of one flat list
+        return false;
+    }
+
     if (index >= 0 && index < count()) {
         // Call data (instead of accessing m_itemData directly)
         // to ensure that the value is initialized.
@@ -617,6 +1326,11 @@ QSet<QUrl> KFileItemModel::expandedDirectories() const
     return result;
 }
 
+QSet<QUrl> KFileItemModel::directoriesToBeExpanded() const
+{
+    return m_urlsToExpand;
+}
+
 void KFileItemModel::restoreExpandedDirectories(const QSet<QUrl> &urls)
 {
     m_urlsToExpand = urls;
@@ -648,84 +1362,1187 @@ void KFileItemModel::expandParentDirectories(const QUrl &url)
     // KDirLister::open() must called at least once to trigger an initial
     // loading. The pending URLs that must be restored are handled
     // in slotCompleted().
-    QSetIterator<QUrl> it2(m_urlsToExpand);
-    while (it2.hasNext()) {
-        const int idx = index(it2.next());
-        if (idx >= 0 && !isExpanded(idx)) {
-            setExpanded(idx, true);
-            break;
-        }
-    }
+    expandPendingDirectories();
 }
 
-void KFileItemModel::setNameFilter(const QString& nameFilter)
+void KFileItemModel::expandPendingDirectories()
 {
-    if (m_filter.pattern() != nameFilter) {
+    if (m_urlsToExpand.isEmpty()) {
+        return;
+    }
+
+    // Note that the parent folder must be expanded before any of its subfolders become visible.
+    // Therefore, some URLs in m_urlsToExpand might not be visible yet. All visible URLs are
+    // expanded at once, and their children are expanded as soon as their listings are completed.
+    // The listed items are inserted by dispatchPendingItemsToInsert() like all other items, which
+    // keeps them in tree order independent of the order in which the listings are completed.
+    // Iterate over a const copy because items are deleted and inserted within the loop
+    const auto urlsToExpand = m_urlsToExpand;
+    for (const QUrl &url : urlsToExpand) {
+        if (m_expandingDirs.count() >= MaximumParallelExpansions) {
+            return;
+        }
+
+        const int indexForUrl = index(url);
+        if (indexForUrl >= 0) {
+            m_urlsToExpand.remove(url);
+            setExpanded(indexForUrl, true);
+        }
+    }
+
+    if (m_expandingDirs.isEmpty()) {
+        // None of the URLs in m_urlsToExpand could be found in the model. This can happen
+        // if these URLs have been deleted in the meantime.
+        m_urlsToExpand.clear();
+    }
+}
+
+void KFileItemModel::queueRecursiveDirectories(const QUrl& directoryUrl, const KFileItemList& items)
+{
+    const int level = m_recursiveDirs.value(directoryUrl.adjusted(QUrl::StripTrailingSlash), 0) + 1;
+    if (m_recursiveListingDepth > 0 && level > m_recursiveListingDepth) {
+        return;
+    }
+
+    for (const KFileItem& item : items) {
+        if (!item.isDir() || item.isLink()) {
+            continue;
+        }
+
+        const QUrl url = item.url().adjusted(QUrl::StripTrailingSlash);
+        if (!m_recursiveDirs.contains(url)) {
+            m_recursiveDirs.insert(url, level);
+            m_recursiveDirsToList.append(url);
+        }
+    }
+
+    if (!m_recursiveDirsToList.isEmpty()) {
+        // The sub-directories are listed after the items have been emitted. This
+        // also lists the sub-directories that are created after the listing.
+        m_recursiveListingTimer->start();
+    }
+}
+
+void KFileItemModel::listRecursiveDirectories()
+{
+    while (!m_recursiveDirsToList.isEmpty() && m_listingRecursiveDirs.count() < MaximumParallelRecursiveListings) {
+        const QUrl url = m_recursiveDirsToList.takeFirst();
+        m_listing = true;
+        m_listingRecursiveDirs.insert(url);
+        m_dirLister->openUrl(url, KDirLister::Keep);
+    }
+}
+
+void KFileItemModel::updateRecursiveListing()
+{
+    for (const QUrl& url : qAsConst(m_recursiveDirsToForget)) {
+        m_dirLister->forgetDirectory(url);
+    }
+    m_recursiveDirsForgotten = m_recursiveDirsForgotten || !m_recursiveDirsToForget.isEmpty();
+    m_recursiveDirsToForget.clear();
+
+    listRecursiveDirectories();
+}
+
+QList<int> KFileItemModel::forgetRecursiveDirectories(const QList<QUrl>& dirs)
+{
+    const auto isInDirs = [&dirs](const QUrl& url) {
+        for (const QUrl& dir : dirs) {
+            if (dir.isParentOf(url)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    for (auto it = m_recursiveDirs.begin(); it != m_recursiveDirs.end();) {
+        if (dirs.contains(it.key()) || isInDirs(it.key())) {
+            m_recursiveDirsToList.removeOne(it.key());
+            m_recursiveDirsToForget.removeOne(it.key());
+            if (m_listingRecursiveDirs.remove(it.key())) {
+                m_dirLister->stop(it.key());
+            } else if (m_watchedRecursiveDirs.remove(it.key())) {
+                m_dirLister->forgetDirectory(it.key());
+            }
+            it = m_recursiveDirs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    QList<int> indexes;
+    const int itemCount = m_itemData.count();
+    for (int i = 0; i < itemCount; ++i) {
+        if (isInDirs(m_itemData.at(i)->item.url())) {
+            indexes.append(i);
+        }
+    }
+    return indexes;
+}
+
+void KFileItemModel::clearRecursiveDirectories()
+{
+    m_recursiveDirs.clear();
+    m_recursiveDirsToList.clear();
+    m_listingRecursiveDirs.clear();
+    m_watchedRecursiveDirs.clear();
+    m_recursiveDirsToForget.clear();
+    m_recursiveDirsForgotten = false;
+    m_recursiveListingTimer->stop();
+}
+
+void KFileItemModel::setVisibleItemCountHint(int count)
+{
+    m_visibleItemCountHint = qMax(0, count);
+    if (m_visibleItemCountHint == 0) {
+        m_maximumUpdateIntervalTimer->setInterval(m_searchModeEnabled ? MinimumUpdateInterval : KItemListCostModel::instance().maximumUpdateInterval());
+    }
+}
+
+int KFileItemModel::visibleItemCountHint() const
+{
+    return m_visibleItemCountHint;
+}
+
+void KFileItemModel::setSearchModeEnabled(bool enabled)
+{
+    if (m_searchModeEnabled == enabled) {
+        return;
+    }
+
+    m_searchModeEnabled = enabled;
+
+    // Appending search results is cheap, so they can be inserted
+    // more often than the items of a directory.
+    if (m_visibleItemCountHint == 0) {
+        m_maximumUpdateIntervalTimer->setInterval(enabled ? MinimumUpdateInterval : KItemListCostModel::instance().maximumUpdateInterval());
+    }
+}
+
+bool KFileItemModel::isSearchModeEnabled() const
+{
+    return m_searchModeEnabled;
+}
+
+bool KFileItemModel::isHugeDirectory() const
+{
+    return m_hugeDirectory;
+}
+
+void KFileItemModel::setExpectedItemCount(int count)
+{
+    m_expectedItemCount = count;
+}
+
+int KFileItemModel::estimatedItemCount() const
+{
+    if (m_estimatedItemCount < 0) {
+        return -1;
+    }
+    return qMax(m_estimatedItemCount, m_listedItemCount);
+}
+
+int KFileItemModel::listedItemCount() const
+{
+    return m_listedItemCount;
+}
+
+KIO::filesize_t KFileItemModel::estimatedTotalSize() const
+{
+    if (m_listedItemCount == 0) {
+        return 0;
+    }
+
+    const int itemCount = estimatedItemCount();
+    if (itemCount <= m_listedItemCount) {
+        return m_listedFilesSize;
+    }
+
+    // Assume that the remaining items have the same average size
+    return static_cast<KIO::filesize_t>(m_listedFilesSize * (static_cast<double>(itemCount) / m_listedItemCount));
+}
+
+void KFileItemModel::setChangeCoalescingInterval(int msec)
+{
+    if (msec <= 0 && !m_changesDeferred) {
+        applyQueuedChanges();
+    }
+    m_changeCoalescingTimer->setInterval(qMax(0, msec));
+}
+
+int KFileItemModel::changeCoalescingInterval() const
+{
+    return m_changeCoalescingTimer->interval();
+}
+
+void KFileItemModel::setChangesDeferred(bool deferred)
+{
+    if (m_changesDeferred == deferred) {
+        return;
+    }
+
+    m_changesDeferred = deferred;
+    if (deferred) {
+        m_changeCoalescingTimer->stop();
+    } else {
+        applyQueuedChanges();
+    }
+}
+
+bool KFileItemModel::changesDeferred() const
+{
+    return m_changesDeferred;
+}
+
+void KFileItemModel::setResortingDeferred(bool deferred)
+{
+    if (m_resortingDeferred == deferred) {
+        return;
+    }
+
+    m_resortingDeferred = deferred;
+    if (!deferred) {
+        applyDeferredResort();
+    }
+}
+
+bool KFileItemModel::resortingDeferred() const
+{
+    return m_resortingDeferred;
+}
+
+void KFileItemModel::setResortProgressThreshold(int percent)
+{
+    m_resortProgressThreshold = qBound(0, percent, 100);
+}
+
+int KFileItemModel::resortProgressThreshold() const
+{
+    return m_resortProgressThreshold;
+}
+
+void KFileItemModel::setSortingMemoryLimit(qint64 bytes)
+{
+    bytes = qMax<qint64>(0, bytes);
+    if (m_sortingMemoryLimit == bytes) {
+        return;
+    }
+
+    m_sortingMemoryLimit = bytes;
+
+    // The sort keys are read while the items are sorted asynchronously
+    cancelAsyncResort();
+    if (updateSortKeysAllowed(count() + m_pendingItemsToInsert.count())) {
+        updateSortKeys();
+    }
+}
+
+qint64 KFileItemModel::sortingMemoryLimit() const
+{
+    return m_sortingMemoryLimit;
+}
+
+void KFileItemModel::setSnapshotsEnabled(bool enabled)
+{
+    m_snapshots.setMaxCost(enabled ? MaximumSnapshotsCost : 0);
+    if (enabled) {
+        s_sharingModels->insert(this);
+    } else {
+        s_sharingModels->remove(this);
+    }
+}
+
+bool KFileItemModel::snapshotsEnabled() const
+{
+    return m_snapshots.maxCost() > 0;
+}
+
+void KFileItemModel::setSnapshotContext(const QByteArray& context)
+{
+    m_snapshotContext = context;
+}
+
+void KFileItemModel::prefetchDirectory(const QUrl& url)
+{
+    KDirectoryPrefetcher::instance().prefetch(url);
+}
+
+void KFileItemModel::cancelPrefetching(const QUrl& url)
+{
+    KDirectoryPrefetcher::instance().cancel(url);
+}
+
+bool KFileItemModel::cachedListing(const QUrl& url, bool includeHiddenFiles, KFileItemList& items)
+{
+    const QUrl dirUrl = url.adjusted(QUrl::StripTrailingSlash);
+    const auto useSnapshot = [&items](const Snapshot* snapshot) {
+        items.clear();
+        items.reserve(snapshot->items.count());
+        for (const auto& snapshotItem : snapshot->items) {
+            items.append(snapshotItem.first);
+        }
+    };
+
+    // The directory lister keeps the items of a shown directory up to date, so
+    // they are preferred to the snapshots, whose validation accesses the filesystem.
+    for (const KFileItemModel* model : qAsConst(*s_sharingModels)) {
+        if (model->m_itemData.isEmpty()
+            || !model->m_pendingItemsToInsert.isEmpty()
+            || !model->m_expandedDirs.isEmpty()
+            || !model->m_dirLister->isFinished()
+            || !model->directory().matches(dirUrl, QUrl::StripTrailingSlash)
+            || (includeHiddenFiles && !model->showHiddenFiles())
+            || !model->nameFilter().isEmpty()
+            || !model->mimeTypeFilters().isEmpty()) {
+            continue;
+        }
+
+        items.clear();
+        items.reserve(model->m_itemData.count());
+        for (const ItemData* itemData : qAsConst(model->m_itemData)) {
+            items.append(itemData->item);
+        }
+        return true;
+    }
+
+    for (const KFileItemModel* model : qAsConst(*s_sharingModels)) {
+        const Snapshot* snapshot = model->m_snapshots.object(dirUrl);
+        if (isUsableForListing(snapshot, dirUrl, includeHiddenFiles)) {
+            useSnapshot(snapshot);
+            return true;
+        }
+    }
+
+    // The directory might have been shown by a deleted model, e.g. of a closed tab
+    const RetainedSnapshots* retained = retainedSnapshots();
+    const Snapshot* snapshot = retained ? retained->object(dirUrl) : nullptr;
+    if (isUsableForListing(snapshot, dirUrl, includeHiddenFiles)) {
+        useSnapshot(snapshot);
+        return true;
+    }
+
+    return false;
+}
+
+bool KFileItemModel::isUsableForListing(const Snapshot* snapshot, const QUrl& dirUrl, bool includeHiddenFiles)
+{
+    return snapshot
+        && (snapshot->hiddenFilesShown || !includeHiddenFiles)
+        && snapshot->nameFilter.isEmpty()
+        && snapshot->mimeTypeFilters.isEmpty()
+        && snapshot->directoryModificationTime == QFileInfo(dirUrl.toLocalFile()).lastModified();
+}
+
+QString KFileItemModel::memoryConsumerName() const
+{
+    return QStringLiteral("KFileItemModel %1").arg(directory().toDisplayString(QUrl::PreferLocalFile));
+}
+
+qint64 KFileItemModel::itemDataCost(const ItemData* data)
+{
+    static const QByteArray iconPixmapRole("iconPixmap");
+
+    qint64 bytes = sizeof(ItemData) + FileItemCost + qint64(data->values.count()) * RoleValueCost;
+    if (data->sortKey.has_value()) {
+        bytes += SortKeyCost;
+    }
+
+    // Previews are not shared with the icon caches
+    const auto it = data->values.constFind(iconPixmapRole);
+    if (it != data->values.constEnd()) {
+        const QPixmap pixmap = it->value<QPixmap>();
+        bytes += qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+    }
+    return bytes;
+}
+
+qint64 KFileItemModel::keptItemsCost() const
+{
+    qint64 bytes = 0;
+    for (const ItemData* data : qAsConst(m_keptItems)) {
+        bytes += itemDataCost(data);
+    }
+    return bytes;
+}
+
+qint64 KFileItemModel::memoryUsage() const
+{
+
+    qint64 bytes = 0;
+    for (const ItemData* data : qAsConst(m_itemData)) {
+        bytes += itemDataCost(data);
+    }
+    for (const ItemData* data : qAsConst(m_filteredItems)) {
+        bytes += itemDataCost(data);
+    }
+    bytes += keptItemsCost();
+    for (const ItemData* data : qAsConst(m_pendingItemsToInsert)) {
+        bytes += itemDataCost(data);
+    }
+
+    bytes += qint64(m_items.count()) * UrlIndexCost;
+    bytes += qint64(m_itemDataById.count()) * UrlIndexCost;
+    bytes += qint64(m_groups.count()) * GroupCost;
+    bytes += m_roleStore.memoryUsage();
+
+    // The cost of the snapshots is given in KiB
+    bytes += qint64(m_snapshots.totalCost()) * 1024;
+    if (m_cachedSearchResults) {
+        bytes += qint64(m_cachedSearchResults->cost) * 1024;
+    }
+    return bytes;
+}
+
+qint64 KFileItemModel::releaseMemory(qint64 bytes)
+{
+    const int previousCost = m_snapshots.totalCost();
+    const int maxCost = m_snapshots.maxCost();
+    m_snapshots.setMaxCost(int(qMax<qint64>(0, previousCost - bytes / 1024 - 1)));
+    m_snapshots.setMaxCost(maxCost);
+    qint64 released = qint64(previousCost - m_snapshots.totalCost()) * 1024;
+
+    if (released < bytes && m_cachedSearchResults) {
+        released += qint64(m_cachedSearchResults->cost) * 1024;
+        m_cachedSearchResults.reset();
+        m_cachedSearchResultsUrl.clear();
+    }
+
+    if (released < bytes && m_unconfirmedKeptItems.isEmpty() && !m_keptItems.isEmpty()) {
+        // Showing the items again inserts them as new items of the directory lister
+        released += keptItemsCost();
+        for (ItemData* itemData : qAsConst(m_keptItems)) {
+            deleteItemData(itemData);
+        }
+        m_keptItems.clear();
+    }
+    return released;
+}
+
+qint64 KFileItemModel::releasableMemory() const
+{
+    qint64 bytes = qint64(m_snapshots.totalCost()) * 1024;
+    if (m_cachedSearchResults) {
+        bytes += qint64(m_cachedSearchResults->cost) * 1024;
+    }
+    if (m_unconfirmedKeptItems.isEmpty()) {
+        bytes += keptItemsCost();
+    }
+    return bytes;
+}
+
+KFileItemList KFileItemModel::takeRestoredItems()
+{
+    KFileItemList items;
+    items.swap(m_restoredItems);
+    return items;
+}
+
+void KFileItemModel::cacheSearchResults()
+{
+    dispatchPendingItemsToInsert();
+
+    m_cachedSearchResults.reset(new Snapshot());
+    m_cachedSearchResultsUrl = directory();
+    m_cachedSearchResults->context = m_snapshotContext;
+    m_cachedSearchResults->hiddenFilesShown = showHiddenFiles();
+    m_cachedSearchResults->nameFilter = nameFilter();
+    m_cachedSearchResults->mimeTypeFilters = mimeTypeFilters();
+    m_cachedSearchResults->items.reserve(m_itemData.count());
+
+    qint64 cost = 0;
+    for (const ItemData* itemData : qAsConst(m_itemData)) {
+        m_cachedSearchResults->items.append(qMakePair(itemData->item, itemData->values));
+
+        const QPixmap pixmap = itemData->values.value("iconPixmap").value<QPixmap>();
+        cost += SnapshotItemCost + qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+    }
+
+    // The cost is given in KiB like for the snapshots
+    m_cachedSearchResults->cost = int(qMin<qint64>(cost / 1024 + 1, MaximumSnapshotsCost));
+    KMemoryBudget::instance().scheduleCheck();
+}
+
+QUrl KFileItemModel::cachedSearchResultsUrl() const
+{
+    return m_cachedSearchResultsUrl;
+}
+
+void KFileItemModel::forEachCachedSearchResult(const ItemVisitor& visitor) const
+{
+    if (!m_cachedSearchResults) {
+        return;
+    }
+
+    for (const auto& searchResult : qAsConst(m_cachedSearchResults->items)) {
+        visitor(searchResult.first, searchResult.second);
+    }
+}
+
+void KFileItemModel::prepareNarrowedSearch(const QUrl& url, const ItemPredicate& matches)
+{
+    m_narrowedSearchUrl.clear();
+    m_narrowedSearchItems.clear();
+    if (!m_cachedSearchResults
+        || m_cachedSearchResults->hiddenFilesShown != showHiddenFiles()
+        || m_cachedSearchResults->nameFilter != nameFilter()
+        || m_cachedSearchResults->mimeTypeFilters != mimeTypeFilters()) {
+        return;
+    }
+
+    const bool restoreValues = (m_cachedSearchResults->context == m_snapshotContext);
+    for (const auto& searchResult : qAsConst(m_cachedSearchResults->items)) {
+        if (matches(searchResult.first, searchResult.second)) {
+            m_narrowedSearchItems.append(restoreValues ? searchResult
+                                                       : qMakePair(searchResult.first, QHash<QByteArray, QVariant>()));
+        }
+    }
+    m_narrowedSearchUrl = url;
+}
+
+void KFileItemModel::retainSnapshot()
+{
+    takeSnapshot();
+
+    const QUrl url = directory().adjusted(QUrl::StripTrailingSlash);
+    Snapshot* snapshot = m_snapshots.take(url);
+    RetainedSnapshots* retained = retainedSnapshots();
+    if (snapshot && retained) {
+        retained->insert(url, snapshot);
+    } else {
+        delete snapshot;
+    }
+}
+
+void KFileItemModel::setNameFilter(const QString& nameFilter)
+{
+    if (m_filter.pattern() != nameFilter) {
         dispatchPendingItemsToInsert();
+        const bool narrowed = m_filter.isNarrowedBy(nameFilter);
         m_filter.setPattern(nameFilter);
+        applyFilters(!narrowed);
+    }
+}
+
+QString KFileItemModel::nameFilter() const
+{
+    return m_filter.pattern();
+}
+
+void KFileItemModel::setMimeTypeFilters(const QStringList& filters)
+{
+    if (m_filter.mimeTypes() != filters) {
+        dispatchPendingItemsToInsert();
+        m_filter.setMimeTypes(filters);
         applyFilters();
     }
 }
 
-QString KFileItemModel::nameFilter() const
+QStringList KFileItemModel::mimeTypeFilters() const
+{
+    return m_filter.mimeTypes();
+}
+
+
+void KFileItemModel::applyFilters(bool checkFilteredItems)
+{
+    QElapsedTimer timer;
+    timer.start();
+    KItemListMetrics& metrics = KItemListMetrics::instance();
+    metrics.add(KItemListMetrics::Filters);
+
+    // Check which shown items from m_itemData must get
+    // hidden and hence moved to m_filteredItems.
+    QVector<int> newFilteredIndexes;
+    QList<ItemData*> newFilteredItems;
+
+    const QVector<bool> shownItemsMatches = filterMatches(m_itemData);
+    const QByteArray isExpandedRole("isExpanded");
+    const int itemCount = m_itemData.count();
+    for (int index = 0; index < itemCount; ++index) {
+        if (shownItemsMatches.at(index)) {
+            continue;
+        }
+
+        // Only filter non-expanded items as child items may never
+        // exist without a parent item
+        ItemData* itemData = m_itemData.at(index);
+        if (!itemData->values.value(isExpandedRole).toBool()) {
+            newFilteredIndexes.append(index);
+            newFilteredItems.append(itemData);
+        }
+    }
+
+    const KItemRangeList removedRanges = KItemRangeList::fromSortedContainer(newFilteredIndexes);
+    removeItems(removedRanges, KeepItemData);
+
+    // Check which hidden items from m_filteredItems should
+    // get visible again and hence removed from m_filteredItems.
+    // The items that have just been hidden don't match.
+    QList<ItemData*> newVisibleItems;
+    if (checkFilteredItems && !m_filteredItems.isEmpty()) {
+        QList<ItemData*> remainingFilteredItems;
+        remainingFilteredItems.reserve(m_filteredItems.count());
+
+        const QVector<bool> filteredItemsMatches = filterMatches(m_filteredItems);
+        for (int i = 0; i < m_filteredItems.count(); ++i) {
+            ItemData* itemData = m_filteredItems.at(i);
+            if (filteredItemsMatches.at(i)) {
+                newVisibleItems.append(itemData);
+            } else {
+                remainingFilteredItems.append(itemData);
+            }
+        }
+        m_filteredItems = remainingFilteredItems;
+    }
+
+    // The newly hidden items are merged once into the sorted filtered items
+    if (!newFilteredItems.isEmpty()) {
+        sortPresortedItems(m_filteredItems);
+        sortPresortedItems(newFilteredItems);
+        m_filteredItems = mergeSortedItems(m_filteredItems, newFilteredItems);
+    }
+
+    insertPresortedItems(newVisibleItems);
+    metrics.add(KItemListMetrics::FilterNsecs, timer.nsecsElapsed());
+}
+
+QVector<bool> KFileItemModel::filterMatches(const QList<ItemData*>& items) const
+{
+    const int count = items.count();
+    QVector<bool> matches(count, true);
+    if (!m_filter.hasSetFilters()) {
+        return matches;
+    }
+
+    if (!m_filter.pattern().isEmpty()) {
+        // Each thread writes to its own part of the vector only
+        bool* matchesData = matches.data();
+        const auto matchPatterns = [&](int first, int last) {
+            for (int i = first; i < last; ++i) {
+                matchesData[i] = m_filter.matchesPattern(items.at(i)->item);
+            }
+        };
+
+        parallelFor(count, ParallelFilterItemsLimit, matchPatterns);
+    }
+
+    if (!m_filter.mimeTypes().isEmpty()) {
+        // Determining the MIME-type of a KFileItem is not thread-safe, so
+        // the remaining items are checked by the main thread.
+        for (int i = 0; i < count; ++i) {
+            if (matches.at(i)) {
+                matches[i] = m_filter.matchesType(items.at(i)->item);
+            }
+        }
+    }
+
+    return matches;
+}
+
+void KFileItemModel::setHoldingBackBackgroundTasks(bool holdBack)
+{
+    if (m_holdingBackBackgroundTasks == holdBack) {
+        return;
+    }
+
+    m_holdingBackBackgroundTasks = holdBack;
+    if (holdBack) {
+        KTaskScheduler::instance().beginInteractiveWork();
+        m_holdBackBackgroundTasksTimer->start();
+    } else {
+        KTaskScheduler::instance().endInteractiveWork();
+        m_holdBackBackgroundTasksTimer->stop();
+    }
+}
+
+void KFileItemModel::takeSnapshot()
+{
+    const QUrl url = directory().adjusted(QUrl::StripTrailingSlash);
+    if (m_snapshots.maxCost() <= 0 || !url.isLocalFile() || m_itemData.isEmpty()
+        || !m_expandedDirs.isEmpty() || !m_dirLister->isFinished()) {
+        // Expanded folders are not part of snapshots, as the restored items
+        // are only verified by listing the root directory. Remote directories
+        // are skipped, as checking whether they have been changed is expensive.
+        return;
+    }
+
+    Snapshot* snapshot = new Snapshot();
+    snapshot->directoryModificationTime = QFileInfo(url.toLocalFile()).lastModified();
+    snapshot->context = m_snapshotContext;
+    snapshot->hiddenFilesShown = showHiddenFiles();
+    snapshot->nameFilter = nameFilter();
+    snapshot->mimeTypeFilters = mimeTypeFilters();
+    snapshot->items.reserve(m_itemData.count());
+
+    qint64 cost = 0;
+    for (const ItemData* itemData : qAsConst(m_itemData)) {
+        snapshot->items.append(qMakePair(itemData->item, itemData->values));
+
+        const QPixmap pixmap = itemData->values.value("iconPixmap").value<QPixmap>();
+        cost += SnapshotItemCost + qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+    }
+
+    // The cost is given in KiB
+    snapshot->cost = int(qMin<qint64>(cost / 1024 + 1, MaximumSnapshotsCost));
+    m_snapshots.insert(url, snapshot, snapshot->cost);
+    KMemoryBudget::instance().scheduleCheck();
+}
+
+void KFileItemModel::restoreSnapshot(const QUrl& url)
+{
+    const QUrl dirUrl = url.adjusted(QUrl::StripTrailingSlash);
+    QScopedPointer<Snapshot> snapshot(m_snapshots.take(dirUrl));
+    if (m_snapshots.maxCost() <= 0 || !m_itemData.isEmpty() || !m_pendingItemsToInsert.isEmpty()) {
+        return;
+    }
+
+    if (!snapshot) {
+        // The directory might have been shown by a deleted model, e.g. of a closed tab
+        RetainedSnapshots* retained = retainedSnapshots();
+        snapshot.reset(retained ? retained->take(dirUrl) : nullptr);
+    }
+
+    const bool validSnapshot = snapshot
+        && snapshot->directoryModificationTime == QFileInfo(dirUrl.toLocalFile()).lastModified()
+        && snapshot->hiddenFilesShown == showHiddenFiles()
+        && snapshot->nameFilter == nameFilter()
+        && snapshot->mimeTypeFilters == mimeTypeFilters();
+    if (!validSnapshot) {
+        if (!restoreSharedItems(dirUrl)) {
+            restorePrefetchedItems(dirUrl);
+        }
+        return;
+    }
+
+    // The roles, which have been determined by the roles updater, can only
+    // be reused if they are still based on the same settings.
+    const bool restoreValues = (snapshot->context == m_snapshotContext);
+
+    QList<ItemData*> itemDataList;
+    itemDataList.reserve(snapshot->items.count());
+    for (const auto& snapshotItem : qAsConst(snapshot->items)) {
+        ItemData* itemData = createRestoredItemData(snapshotItem.first,
+                                                    restoreValues ? snapshotItem.second : QHash<QByteArray, QVariant>());
+        itemDataList.append(itemData);
+        if (restoreValues) {
+            m_restoredItems.append(itemData->item);
+        }
+    }
+
+    insertItems(itemDataList);
+}
+
+bool KFileItemModel::restoreNarrowedSearch(const QUrl& url)
+{
+    const bool prepared = !m_narrowedSearchUrl.isEmpty() && m_narrowedSearchUrl == url;
+    QVector<QPair<KFileItem, QHash<QByteArray, QVariant> > > searchResults;
+    searchResults.swap(m_narrowedSearchItems);
+    m_narrowedSearchUrl.clear();
+
+    if (!prepared || searchResults.isEmpty() || !m_itemData.isEmpty() || !m_pendingItemsToInsert.isEmpty()) {
+        return false;
+    }
+
+    QList<ItemData*> itemDataList;
+    itemDataList.reserve(searchResults.count());
+    for (const auto& searchResult : qAsConst(searchResults)) {
+        ItemData* itemData = createRestoredItemData(searchResult.first, searchResult.second);
+        itemDataList.append(itemData);
+        if (!searchResult.second.isEmpty()) {
+            m_restoredItems.append(itemData->item);
+        }
+    }
+
+    insertItems(itemDataList);
+    return true;
+}
+
+class KFileItemModel::RetainedSnapshots : public QObject, public KMemoryBudget::Consumer
+{
+public:
+    explicit RetainedSnapshots(QObject* parent) :
+        QObject(parent),
+        m_snapshots(MaximumRetainedSnapshotsCost),
+        m_quitting(false)
+    {
+        // The pixmaps of the snapshots must be destroyed while the
+        // application still exists, and no snapshots are retained
+        // anymore while the windows are closed.
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, [this]() {
+            m_quitting = true;
+            m_snapshots.clear();
+        });
+    }
+
+    bool isQuitting() const
+    {
+        return m_quitting;
+    }
+
+    void insert(const QUrl& url, Snapshot* snapshot)
+    {
+        Q_ASSERT(!m_quitting);
+        m_snapshots.insert(url, snapshot, qMin(snapshot->cost, MaximumRetainedSnapshotsCost));
+        KMemoryBudget::instance().scheduleCheck();
+    }
+
+    Snapshot* take(const QUrl& url)
+    {
+        return m_snapshots.take(url);
+    }
+
+    const Snapshot* object(const QUrl& url) const
+    {
+        return m_snapshots.object(url);
+    }
+
+    QString memoryConsumerName() const override
+    {
+        return QStringLiteral("KFileItemModel retained snapshots");
+    }
+
+    qint64 memoryUsage() const override
+    {
+        // The cost of the snapshots is given in KiB
+        return qint64(m_snapshots.totalCost()) * 1024;
+    }
+
+    qint64 releaseMemory(qint64 bytes) override
+    {
+        const int previousCost = m_snapshots.totalCost();
+        m_snapshots.setMaxCost(int(qMax<qint64>(0, previousCost - bytes / 1024 - 1)));
+        m_snapshots.setMaxCost(MaximumRetainedSnapshotsCost);
+        return qint64(previousCost - m_snapshots.totalCost()) * 1024;
+    }
+
+private:
+    QCache<QUrl, Snapshot> m_snapshots;
+    bool m_quitting;
+};
+
+KFileItemModel::RetainedSnapshots* KFileItemModel::retainedSnapshots()
+{
+    static QPointer<RetainedSnapshots> snapshots;
+    QCoreApplication* application = QCoreApplication::instance();
+    if (!snapshots && application && !QCoreApplication::closingDown()) {
+        snapshots = new RetainedSnapshots(application);
+    }
+    return (snapshots && !snapshots->isQuitting()) ? snapshots.data() : nullptr;
+}
+
+bool KFileItemModel::restoreSharedItems(const QUrl& url)
+{
+    const bool dirOnlyMode = m_dirLister->dirOnlyMode();
+    for (const KFileItemModel* model : qAsConst(*s_sharingModels)) {
+        // Only models that show all items of the directory with the same
+        // settings can share them. The directory lister of such a model keeps
+        // its items up to date, so unlike snapshots the items of remote
+        // directories can be shared too.
+        if (model == this
+            || model->m_itemData.isEmpty()
+            || !model->m_pendingItemsToInsert.isEmpty()
+            || !model->m_expandedDirs.isEmpty()
+            || !model->m_dirLister->isFinished()
+            || !model->directory().matches(url, QUrl::StripTrailingSlash)
+            || model->m_dirLister->dirOnlyMode() != dirOnlyMode
+            || model->showHiddenFiles() != showHiddenFiles()
+            || model->nameFilter() != nameFilter()
+            || model->mimeTypeFilters() != mimeTypeFilters()) {
+            continue;
+        }
+
+        // The role values are implicitly shared, including the previews
+        const bool restoreValues = (model->m_snapshotContext == m_snapshotContext);
+
+        QList<ItemData*> itemDataList;
+        itemDataList.reserve(model->m_itemData.count());
+        for (const ItemData* sharedItemData : qAsConst(model->m_itemData)) {
+            ItemData* itemData = createRestoredItemData(sharedItemData->item,
+                                                        restoreValues ? sharedItemData->values : QHash<QByteArray, QVariant>());
+            itemDataList.append(itemData);
+            if (restoreValues) {
+                m_restoredItems.append(itemData->item);
+            }
+        }
+
+        insertItems(itemDataList);
+        return true;
+    }
+
+    return false;
+}
+
+void KFileItemModel::restorePrefetchedItems(const QUrl& url)
+{
+    if (!m_filter.mimeTypes().isEmpty()) {
+        // Determining the MIME types of all items would
+        // take longer than waiting for the directory lister.
+        return;
+    }
+
+    KFileItemList items;
+    if (!KDirectoryPrefetcher::instance().takeListing(url, items)) {
+        return;
+    }
+
+    // The prefetched items contain all hidden files and all files. The items
+    // hidden by the directory lister are skipped, the filtered items are
+    // added to m_filteredItems when they are listed by the directory lister.
+    const bool showHiddenFiles = this->showHiddenFiles();
+    const bool dirOnlyMode = m_dirLister->dirOnlyMode();
+
+    QList<ItemData*> itemDataList;
+    itemDataList.reserve(items.count());
+    for (const KFileItem& item : qAsConst(items)) {
+        if ((!showHiddenFiles && item.isHidden()) || (dirOnlyMode && !item.isDir())
+            || (m_filter.hasSetFilters() && !m_filter.matchesPattern(item))) {
+            continue;
+        }
+        itemDataList.append(createRestoredItemData(item, QHash<QByteArray, QVariant>()));
+    }
+
+    insertItems(itemDataList);
+}
+
+KFileItemModel::ItemData* KFileItemModel::createRestoredItemData(const KFileItem& item, const QHash<QByteArray, QVariant>& values)
 {
-    return m_filter.pattern();
+    ItemData* itemData = m_itemDataPool.create();
+    itemData->item = item;
+    itemData->parent = nullptr;
+    itemData->depth = 0;
+    itemData->slot = m_roleStore.acquireSlot();
+    itemData->values = values;
+    assignItemId(itemData);
+    updateUrlHash(itemData);
+    updateRoleStore(itemData);
+    updateSortKey(itemData);
+
+    m_unconfirmedRestoredUrls.insert(item.url());
+    return itemData;
 }
 
-void KFileItemModel::setMimeTypeFilters(const QStringList& filters)
+KFileItemList KFileItemModel::confirmRestoredItems(const KFileItemList& items)
 {
-    if (m_filter.mimeTypes() != filters) {
-        dispatchPendingItemsToInsert();
-        m_filter.setMimeTypes(filters);
-        applyFilters();
+    KFileItemList newItems;
+    QList<QPair<KFileItem, KFileItem> > changedItems;
+
+    for (const KFileItem& item : items) {
+        const int index = m_unconfirmedRestoredUrls.remove(item.url()) ? this->index(item.url()) : -1;
+        if (index < 0) {
+            newItems.append(item);
+            continue;
+        }
+
+        const KFileItem& restoredItem = m_itemData.at(index)->item;
+        if (!hasSameEntry(restoredItem, item)) {
+            changedItems.append(qMakePair(restoredItem, item));
+        }
     }
+
+    if (!changedItems.isEmpty()) {
+        slotRefreshItems(changedItems);
+    }
+
+    return newItems;
 }
 
-QStringList KFileItemModel::mimeTypeFilters() const
+void KFileItemModel::removeUnconfirmedRestoredItems()
 {
-    return m_filter.mimeTypes();
+    if (m_unconfirmedRestoredUrls.isEmpty()) {
+        return;
+    }
+
+    KFileItemList removedItems;
+    for (const QUrl& url : qAsConst(m_unconfirmedRestoredUrls)) {
+        const int index = this->index(url);
+        if (index >= 0) {
+            removedItems.append(m_itemData.at(index)->item);
+        }
+    }
+    m_unconfirmedRestoredUrls.clear();
+
+    if (!removedItems.isEmpty()) {
+        slotItemsDeleted(removedItems);
+    }
+}
+
+void KFileItemModel::applyDirListerSettings(bool moreItemsShown)
+{
+    if (m_recursiveListing && m_recursiveDirsForgotten && directory().isValid()) {
+        // The directory lister cannot apply the settings to the
+        // sub-directories that it has forgotten
+        m_listing = true;
+        m_dirLister->openUrl(directory());
+        return;
+    }
+
+    if (moreItemsShown) {
+        // The kept items that are shown again must be listed again by the
+        // directory lister, see confirmKeptItems().
+        for (int i = 0; i < m_keptItems.count(); ++i) {
+            const KFileItem& item = m_keptItems.at(i)->item;
+            if (isShownByDirLister(item)) {
+                m_unconfirmedKeptItems.insert(item.url(), i);
+            }
+        }
+    } else {
+        removeItemsNotShown();
+    }
+
+    m_dirLister->emitChanges();
+    if (moreItemsShown) {
+        insertKeptItems();
+        dispatchPendingItemsToInsert();
+    }
 }
 
+bool KFileItemModel::isShownByDirLister(const KFileItem& item) const
+{
+    return (showHiddenFiles() || !item.isHidden()) && (!showDirectoriesOnly() || item.isDir());
+}
 
-void KFileItemModel::applyFilters()
+void KFileItemModel::removeItemsNotShown()
 {
-    // Check which shown items from m_itemData must get
-    // hidden and hence moved to m_filteredItems.
-    QVector<int> newFilteredIndexes;
+    if (m_recursiveListing || m_searchModeEnabled || m_rankedItemCount >= 0) {
+        // The items are not in the sorting order of the directory,
+        // so they are removed by the directory lister.
+        return;
+    }
 
-    const int itemCount = m_itemData.count();
-    for (int index = 0; index < itemCount; ++index) {
-        ItemData* itemData = m_itemData.at(index);
+    cancelAsyncResort();
+    dispatchPendingItemsToInsert();
 
-        // Only filter non-expanded items as child items may never
-        // exist without a parent item
-        if (!itemData->values.value("isExpanded").toBool()) {
-            const KFileItem item = itemData->item;
-            if (!m_filter.matches(item)) {
-                newFilteredIndexes.append(index);
-                m_filteredItems.insert(item, itemData);
-            }
+    // Only the items of the directory itself are kept. The children of an
+    // expanded folder are removed together with the folder.
+    static const QByteArray isExpandedRole("isExpanded");
+    QVector<int> removedIndexes;
+    QList<ItemData*> removedItems;
+    const int itemCount = m_itemData.count();
+    for (int i = 0; i < itemCount; ++i) {
+        ItemData* itemData = m_itemData.at(i);
+        if (!itemData->parent && !isShownByDirLister(itemData->item) && !itemData->values.value(isExpandedRole).toBool()) {
+            removedIndexes.append(i);
+            removedItems.append(itemData);
         }
     }
 
-    const KItemRangeList removedRanges = KItemRangeList::fromSortedContainer(newFilteredIndexes);
-    removeItems(removedRanges, KeepItemData);
+    if (removedItems.isEmpty()) {
+        return;
+    }
 
-    // Check which hidden items from m_filteredItems should
-    // get visible again and hence removed from m_filteredItems.
-    QList<ItemData*> newVisibleItems;
+    // Items might be kept already because of the other setting of the
+    // directory lister.
+    m_keptItems = mergeSortedItems(m_keptItems, removedItems);
+    KMemoryBudget::instance().scheduleCheck();
+
+    // The directory lister reports the removed items as deleted
+    // afterwards, which is ignored, as they are not part of the model
+    // anymore.
+    removeItems(KItemRangeList::fromSortedContainer(removedIndexes), KeepItemData);
+}
+
+KFileItemList KFileItemModel::confirmKeptItems(const KFileItemList& items)
+{
+    KFileItemList newItems;
+    for (const KFileItem& item : items) {
+        const auto it = m_unconfirmedKeptItems.find(item.url());
+        if (it == m_unconfirmedKeptItems.end()) {
+            newItems.append(item);
+            continue;
+        }
+
+        const int index = it.value();
+        m_unconfirmedKeptItems.erase(it);
+
+        // Items that have been changed while they have not been shown keep
+        // their values and are refreshed after inserting them
+        const KFileItem& keptItem = m_keptItems.at(index)->item;
+        if (!hasSameEntry(keptItem, item)) {
+            m_changedKeptItems.append(qMakePair(keptItem, item));
+        }
+    }
+    return newItems;
+}
+
+void KFileItemModel::insertKeptItems()
+{
+    if (m_keptItems.isEmpty()) {
+        return;
+    }
 
-    QHash<KFileItem, ItemData*>::iterator it = m_filteredItems.begin();
-    while (it != m_filteredItems.end()) {
-        if (m_filter.matches(it.key())) {
-            newVisibleItems.append(it.value());
-            it = m_filteredItems.erase(it);
+    // The items that have not been listed again have been deleted.
+    QList<ItemData*> items;
+    items.reserve(m_keptItems.count());
+    QList<ItemData*> keptItems;
+    QList<ItemData*> filteredItems;
+    for (ItemData* itemData : qAsConst(m_keptItems)) {
+        if (!isShownByDirLister(itemData->item)) {
+            keptItems.append(itemData);
+        } else if (m_unconfirmedKeptItems.contains(itemData->item.url())) {
+            deleteItemData(itemData);
+        } else if (m_filter.hasSetFilters() && !m_filter.matches(itemData->item)) {
+            filteredItems.append(itemData);
         } else {
-            ++it;
+            items.append(itemData);
         }
     }
+    m_keptItems = keptItems;
+    m_unconfirmedKeptItems.clear();
+
+    QList<QPair<KFileItem, KFileItem> > changedItems;
+    changedItems.swap(m_changedKeptItems);
+
+    if (!filteredItems.isEmpty()) {
+        sortPresortedItems(m_filteredItems);
+        sortPresortedItems(filteredItems);
+        m_filteredItems = mergeSortedItems(m_filteredItems, filteredItems);
+    }
+    insertPresortedItems(items);
+
+    if (!changedItems.isEmpty()) {
+        slotRefreshItems(changedItems);
+    }
+}
+
+void KFileItemModel::insertPresortedItems(QList<ItemData*>& items)
+{
+    // The items are still in the sorting order, unless the sorting
+    // has been changed while they have not been shown.
+    prepareItemsForSorting(items);
+    const bool sorted = std::is_sorted(items.cbegin(), items.cend(), [this](const ItemData* a, const ItemData* b) {
+        return lessThan(a, b, m_collator);
+    });
+    if (sorted) {
+        insertSortedItems(items);
+    } else {
+        insertItems(items);
+    }
+}
+
+void KFileItemModel::sortPresortedItems(QList<ItemData*>& items)
+{
+    prepareItemsForSorting(items);
+    const bool sorted = std::is_sorted(items.cbegin(), items.cend(), [this](const ItemData* a, const ItemData* b) {
+        return lessThan(a, b, m_collator);
+    });
+    if (!sorted) {
+        sort(items.begin(), items.end());
+    }
+}
+
+QList<KFileItemModel::ItemData*> KFileItemModel::mergeSortedItems(const QList<ItemData*>& items1, const QList<ItemData*>& items2) const
+{
+    if (items1.isEmpty()) {
+        return items2;
+    }
 
-    insertItems(newVisibleItems);
+    QList<ItemData*> mergedItems;
+    mergedItems.reserve(items1.count() + items2.count());
+    std::merge(items1.cbegin(), items1.cend(), items2.cbegin(), items2.cend(),
+               std::back_inserter(mergedItems), [this](const ItemData* a, const ItemData* b) {
+        return lessThan(a, b, m_collator);
+    });
+    return mergedItems;
 }
 
 void KFileItemModel::removeFilteredChildren(const KItemRangeList& itemRanges)
@@ -743,15 +2560,20 @@ void KFileItemModel::removeFilteredChildren(const KItemRangeList& itemRanges)
         }
     }
 
-    QHash<KFileItem, ItemData*>::iterator it = m_filteredItems.begin();
-    while (it != m_filteredItems.end()) {
-        if (parents.contains(it.value()->parent)) {
-            delete it.value();
-            it = m_filteredItems.erase(it);
-        } else {
-            ++it;
-        }
+    removeFilteredItems([&parents](const ItemData* itemData) {
+        return parents.contains(itemData->parent);
+    });
+}
+
+void KFileItemModel::removeFilteredItems(const std::function<bool(const ItemData*)>& shouldRemove)
+{
+    const auto removedBegin = std::stable_partition(m_filteredItems.begin(), m_filteredItems.end(), [&shouldRemove](const ItemData* itemData) {
+        return !shouldRemove(itemData);
+    });
+    for (auto it = removedBegin; it != m_filteredItems.end(); ++it) {
+        deleteItemData(*it);
     }
+    m_filteredItems.erase(removedBegin, m_filteredItems.end());
 }
 
 QList<KFileItemModel::RoleInfo> KFileItemModel::rolesInformation()
@@ -792,7 +2614,10 @@ void KFileItemModel::onGroupedSortingChanged(bool current)
 void KFileItemModel::onSortRoleChanged(const QByteArray& current, const QByteArray& previous, bool resortItems)
 {
     Q_UNUSED(previous)
+    cancelAsyncResort();
     m_sortRole = typeForRole(current);
+    m_sortRoleComparator = roleValueComparator(m_sortRole);
+    m_groups.clear();
 
     if (!m_requestRole[m_sortRole]) {
         QSet<QByteArray> newRoles = m_roles;
@@ -812,6 +2637,15 @@ void KFileItemModel::onSortOrderChanged(Qt::SortOrder current, Qt::SortOrder pre
     resortAllItems();
 }
 
+void KFileItemModel::onSortOrderAboutToBeChanged(Qt::SortOrder current, Qt::SortOrder next)
+{
+    Q_UNUSED(current)
+    Q_UNUSED(next)
+    // The worker thread sorts with its own copy of the sort order, but its
+    // result is outdated anyway.
+    cancelAsyncResort();
+}
+
 void KFileItemModel::loadSortingSettings()
 {
     using Choice = GeneralSettings::EnumSortingChoice;
@@ -831,49 +2665,415 @@ void KFileItemModel::loadSortingSettings()
     default:
         Q_UNREACHABLE();
     }
-    // Workaround for bug https://bugreports.qt.io/browse/QTBUG-69361
-    // Force the clean state of QCollator in single thread to avoid thread safety problems in sort
-    m_collator.compare(QString(), QString());
+    // The name groups depend on the collator.
+    m_nameGroupValues.clear();
+
+    // Workaround for bug https://bugreports.qt.io/browse/QTBUG-69361
+    // Force the clean state of QCollator in single thread to avoid thread safety problems in sort
+    m_collator.compare(QString(), QString());
+}
+
+void KFileItemModel::resortAllItems()
+{
+    const KItemListTraceScope traceScope("KFileItemModel::resortAllItems",
+                                         KItemListTracer::isStallDetectionEnabled() ? roleTypeName(m_sortRole) : nullptr);
+    m_resortAllItemsTimer->stop();
+    m_itemsToReposition.clear();
+    m_repositionItemsOnly = false;
+    m_deferredResortPending = false;
+
+    // A newer request replaces a resorting that is still running.
+    cancelAsyncResort();
+    m_resortAllItemsTimer->stop();
+    updateCollatorLocale();
+
+    const int itemCount = count();
+    if (itemCount <= 0) {
+        m_rankedItemCount = -1;
+        return;
+    }
+
+    // Resorting many items is done in a worker thread, as it would block
+    // the user interface of all windows of the process
+    if (itemCount >= KItemListCostModel::instance().asyncResortItemsLimit()) {
+        startAsyncResort();
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+#ifdef KFILEITEMMODEL_DEBUG
+    qCDebug(DolphinDebug) << "===========================================================";
+    qCDebug(DolphinDebug) << "Resorting" << itemCount << "items";
+#endif
+
+    QList<ItemData*> sortedItems = m_itemData;
+    sort(sortedItems.begin(), sortedItems.end());
+    applySortedItems(sortedItems);
+    KItemListCostModel::instance().addResortSample(itemCount, timer.nsecsElapsed());
+    KItemListMetrics::instance().add(KItemListMetrics::Sorts);
+    KItemListMetrics::instance().add(KItemListMetrics::SortNsecs, timer.nsecsElapsed());
+
+#ifdef KFILEITEMMODEL_DEBUG
+    qCDebug(DolphinDebug) << "[TIME] Resorting of" << itemCount << "items:" << timer.elapsed();
+#endif
+}
+
+void KFileItemModel::slotResortTimerTimeout()
+{
+    const bool resolvingSortRole = (m_sortingProgressPercent >= 0);
+    if (m_resortingDeferred && resolvingSortRole && m_sortingProgressPercent < m_resortProgressThreshold) {
+        // Keep the items of m_itemsToReposition for applyDeferredResort().
+        m_deferredResortPending = true;
+        return;
+    }
+
+    m_deferredResortPending = false;
+    m_movingItemsInBackground = true;
+    if (m_repositionItemsOnly) {
+        repositionItems();
+    } else {
+        resortAllItems();
+    }
+    m_movingItemsInBackground = false;
+}
+
+void KFileItemModel::applyDeferredResort()
+{
+    if (m_deferredResortPending) {
+        m_resortAllItemsTimer->stop();
+        slotResortTimerTimeout();
+    }
+}
+
+void KFileItemModel::startRepositionTimer(const KItemRangeList& itemRanges)
+{
+    const bool resortPending = m_resortAllItemsTimer->isActive() || m_deferredResortPending;
+    if (resortPending && !m_repositionItemsOnly) {
+        // All items will be resorted anyway.
+        return;
+    }
+
+    for (const KItemRange& range : itemRanges) {
+        for (int index = range.index; index < range.index + range.count; ++index) {
+            m_itemsToReposition.insert(m_itemData.at(index));
+        }
+    }
+
+    if (m_itemsToReposition.count() > RepositionItemsLimit) {
+        startResortTimer();
+        return;
+    }
+
+    m_repositionItemsOnly = true;
+    m_resortAllItemsTimer->setInterval(KItemListCostModel::instance().resortDelay(count()));
+    m_resortAllItemsTimer->start();
+}
+
+void KFileItemModel::repositionItems()
+{
+    const KItemListTraceScope traceScope("KFileItemModel::repositionItems",
+                                         KItemListTracer::isStallDetectionEnabled() ? roleTypeName(m_sortRole) : nullptr);
+    m_resortAllItemsTimer->stop();
+    const QSet<ItemData*> itemsToReposition = m_itemsToReposition;
+    m_itemsToReposition.clear();
+    m_repositionItemsOnly = false;
+
+    if (m_rankedItemCount >= 0 || isAsyncResortRunning()) {
+        // The other items are not sorted yet.
+        resortAllItems();
+        return;
+    }
+
+    // The remaining items keep their order.
+    const int itemCount = count();
+    QList<ItemData*> remainingItems;
+    remainingItems.reserve(itemCount);
+    QList<ItemData*> movingItems;
+    movingItems.reserve(itemsToReposition.count());
+    for (int i = 0; i < itemCount; ++i) {
+        ItemData* itemData = m_itemData.at(i);
+        if (!itemsToReposition.contains(itemData)) {
+            remainingItems.append(itemData);
+        } else if (i + 1 < itemCount && m_itemData.at(i + 1)->parent == itemData) {
+            // The items of an expanded folder would have to be moved
+            // together with the folder.
+            resortAllItems();
+            return;
+        } else {
+            movingItems.append(itemData);
+        }
+    }
+
+    const auto lessThanItem = [this](const ItemData* a, const ItemData* b) {
+        return lessThan(a, b, m_collator);
+    };
+    std::stable_sort(movingItems.begin(), movingItems.end(), lessThanItem);
+
+    // As the moving items are sorted, each position is behind the previous one.
+    QList<ItemData*> sortedItems;
+    sortedItems.reserve(itemCount);
+    auto remainingIt = remainingItems.cbegin();
+    for (ItemData* itemData : qAsConst(movingItems)) {
+        const auto position = std::upper_bound(remainingIt, remainingItems.cend(), itemData, lessThanItem);
+        std::copy(remainingIt, position, std::back_inserter(sortedItems));
+        sortedItems.append(itemData);
+        remainingIt = position;
+    }
+    std::copy(remainingIt, remainingItems.cend(), std::back_inserter(sortedItems));
+
+    applySortedItems(sortedItems);
+}
+
+void KFileItemModel::reorderDirectoriesAndFiles()
+{
+    const bool resortPending = m_resortAllItemsTimer->isActive() || m_deferredResortPending;
+    const bool hasExpandedItems = std::any_of(m_itemData.cbegin(), m_itemData.cend(), [](const ItemData* itemData) {
+        return itemData->parent;
+    });
+    if (resortPending || hasExpandedItems || m_rankedItemCount >= 0 || isAsyncResortRunning()) {
+        resortAllItems();
+        return;
+    }
+
+    // The directories and the files are sorted segments, which keep
+    // their order if they are separated or merged.
+    const auto isDir = [](const ItemData* item) {
+        return item->item.isDir();
+    };
+    QList<ItemData*> sortedItems = m_itemData;
+    if (m_sortDirsFirst) {
+        std::stable_partition(sortedItems.begin(), sortedItems.end(), isDir);
+    } else {
+        const auto filesBegin = std::partition_point(sortedItems.begin(), sortedItems.end(), isDir);
+        std::inplace_merge(sortedItems.begin(), filesBegin, sortedItems.end(), [this](const ItemData* a, const ItemData* b) {
+            return lessThan(a, b, m_collator);
+        });
+    }
+
+    applySortedItems(sortedItems);
+}
+
+void KFileItemModel::startAsyncResort()
+{
+    Q_ASSERT(!isAsyncResortRunning());
+
+    m_asyncResortCanceled.storeRelaxed(0);
+    m_asyncResortRunning = true;
+    m_asyncResortInBackground = m_movingItemsInBackground;
+
+    // Inserting the pending items would cancel the resorting, so
+    // they are inserted when the sorted items have been applied.
+    m_maximumUpdateIntervalTimer->stop();
+
+    // Show an undetermined progress while the old order is kept.
+    Q_EMIT directorySortingProgress(-1);
+
+    // The worker thread uses copies of the settings, which may be
+    // changed by the main thread while sorting.
+    const QList<ItemData*> items = m_itemData;
+    const QAtomicInt* canceled = &m_asyncResortCanceled;
+    qint64* duration = &m_asyncResortDuration;
+    const QCollator collator = m_collator;
+    const Qt::SortOrder order = sortOrder();
+    m_asyncResortWatcher->setFuture(QtConcurrent::run([this, items, canceled, duration, collator, order]() {
+        QElapsedTimer timer;
+        timer.start();
+        QList<ItemData*> sortedItems = items;
+        sort(sortedItems.begin(), sortedItems.end(), canceled, collator, order);
+        if (!canceled->loadRelaxed()) {
+            *duration = timer.nsecsElapsed();
+            KItemListMetrics::instance().add(KItemListMetrics::Sorts);
+            KItemListMetrics::instance().add(KItemListMetrics::SortNsecs, *duration);
+        }
+        return sortedItems;
+    }));
+}
+
+void KFileItemModel::cancelAsyncResort()
+{
+    if (!isAsyncResortRunning()) {
+        return;
+    }
+
+    m_asyncResortCanceled.storeRelaxed(1);
+    m_asyncResortWatcher->waitForFinished();
+    m_asyncResortRunning = false;
+
+    applyPendingValues();
+    applyPendingMimeTypes();
+    addItemsAddedWhileResorting();
+
+    // Try again later.
+    startResortTimer();
+}
+
+void KFileItemModel::addItemsAddedWhileResorting()
+{
+    const QList<QPair<QUrl, KFileItemList> > addedItems = m_itemsAddedWhileResorting;
+    m_itemsAddedWhileResorting.clear();
+    m_itemsAddedWhileResortingCount = 0;
+    for (const auto& directoryItems : addedItems) {
+        slotItemsAdded(directoryItems.first, directoryItems.second);
+    }
+}
+
+void KFileItemModel::startResortTimer()
+{
+    m_itemsToReposition.clear();
+    m_repositionItemsOnly = false;
+    m_resortAllItemsTimer->setInterval(KItemListCostModel::instance().resortDelay(count()));
+    m_resortAllItemsTimer->start();
+}
+
+bool KFileItemModel::isAsyncResortRunning() const
+{
+    // The worker thread might already be done while the finished() signal
+    // has not been delivered yet. The items are still considered as being
+    // sorted until the result has been applied or discarded.
+    return m_asyncResortRunning;
+}
+
+void KFileItemModel::slotAsyncResortFinished()
+{
+    if (!m_asyncResortRunning) {
+        // The result has been discarded by cancelAsyncResort().
+        return;
+    }
+    m_asyncResortRunning = false;
+
+    const QList<ItemData*> sortedItems = m_asyncResortWatcher->result();
+    Q_ASSERT(sortedItems.count() == m_itemData.count());
+    // The cost model may only be used by the main thread. The duration has
+    // been written by the worker thread before the result became available.
+    KItemListCostModel::instance().addResortSample(sortedItems.count(), m_asyncResortDuration);
+    m_movingItemsInBackground = m_asyncResortInBackground;
+    applySortedItems(sortedItems);
+    m_movingItemsInBackground = false;
+    applyPendingValues();
+    applyPendingMimeTypes();
+
+    // The items are inserted into the sorted items
+    addItemsAddedWhileResorting();
+    if (!m_pendingItemsToInsert.isEmpty() && !m_maximumUpdateIntervalTimer->isActive()) {
+        m_maximumUpdateIntervalTimer->start();
+    }
+
+    Q_EMIT directorySortingProgress(100);
+}
+
+void KFileItemModel::slotMimeTypesResolved(const QHash<QUrl, QString>& mimeTypes)
+{
+    if (m_asyncResortRunning) {
+        // The worker thread accesses the items, so they may not be
+        // replaced until the resorting has been finished.
+        for (auto it = mimeTypes.constBegin(); it != mimeTypes.constEnd(); ++it) {
+            m_pendingMimeTypes.insert(it.key(), it.value());
+        }
+        return;
+    }
+
+    QList<int> indexes;
+    indexes.reserve(mimeTypes.count());
+
+    QSet<QByteArray> changedRoles;
+
+    for (auto it = mimeTypes.constBegin(); it != mimeTypes.constEnd(); ++it) {
+        const int indexForItem = index(it.key());
+        if (indexForItem < 0) {
+            // The item has been removed or renamed in the meantime.
+            continue;
+        }
+
+        ItemData* data = m_itemData.at(indexForItem);
+        if (data->item.isMimeTypeKnown()) {
+            // The MIME-type has been determined synchronously in the meantime.
+            continue;
+        }
+
+        // KFileItem offers no way to set the MIME-type, so the item is
+        // replaced by an item with the same URL and the determined MIME-type.
+        KIO::UDSEntry entry = data->item.entry();
+        entry.replace(KIO::UDSEntry::UDS_MIME_TYPE, it.value());
+        data->item = KFileItem(entry, data->item.url());
+
+        QHashIterator<QByteArray, QVariant> valuesIt(retrieveData(data->item, data->parent));
+        QHash<QByteArray, QVariant>& values = data->values;
+        while (valuesIt.hasNext()) {
+            valuesIt.next();
+            const QByteArray& role = valuesIt.key();
+            if (values.value(role) != valuesIt.value()) {
+                values.insert(role, valuesIt.value());
+                changedRoles.insert(role);
+            }
+        }
+
+        indexes.append(indexForItem);
+    }
+
+    if (indexes.isEmpty() || changedRoles.isEmpty()) {
+        return;
+    }
+
+    std::sort(indexes.begin(), indexes.end());
+    emitItemsChangedAndTriggerResorting(KItemRangeList::fromSortedContainer(indexes), changedRoles);
 }
 
-void KFileItemModel::resortAllItems()
+void KFileItemModel::applyPendingValues()
 {
-    m_resortAllItemsTimer->stop();
-
-    const int itemCount = count();
-    if (itemCount <= 0) {
+    if (m_pendingValues.isEmpty()) {
         return;
     }
 
-#ifdef KFILEITEMMODEL_DEBUG
-    QElapsedTimer timer;
-    timer.start();
-    qCDebug(DolphinDebug) << "===========================================================";
-    qCDebug(DolphinDebug) << "Resorting" << itemCount << "items";
-#endif
+    const auto pendingValues = m_pendingValues;
+    m_pendingValues.clear();
 
-    // Remember the order of the current URLs so
-    // that it can be determined which indexes have
-    // been moved because of the resorting.
-    QList<QUrl> oldUrls;
-    oldUrls.reserve(itemCount);
-    for (const ItemData* itemData : qAsConst(m_itemData)) {
-        oldUrls.append(itemData->item.url());
+    // Values that have been set later for the same item win.
+    QHash<int, QHash<QByteArray, QVariant> > itemsValues;
+    for (const auto& pending : pendingValues) {
+        const int indexForItem = index(pending.first->item);
+        if (indexForItem >= 0) {
+            QHash<QByteArray, QVariant>& values = itemsValues[indexForItem];
+            for (auto it = pending.second.constBegin(); it != pending.second.constEnd(); ++it) {
+                values.insert(it.key(), it.value());
+            }
+        }
     }
 
-    m_items.clear();
-    m_items.reserve(itemCount);
+    setItemsData(itemsValues);
+}
 
-    // Resort the items
-    sort(m_itemData.begin(), m_itemData.end());
-    for (int i = 0; i < itemCount; ++i) {
-        m_items.insert(m_itemData.at(i)->item.url(), i);
+void KFileItemModel::applyPendingMimeTypes()
+{
+    if (m_pendingMimeTypes.isEmpty()) {
+        return;
+    }
+
+    const QHash<QUrl, QString> pendingMimeTypes = m_pendingMimeTypes;
+    m_pendingMimeTypes.clear();
+    slotMimeTypesResolved(pendingMimeTypes);
+}
+
+void KFileItemModel::resolveMimeTypes(const KFileItemList& items)
+{
+    m_mimeTypeResolver->resolve(items);
+
+    for (const KFileItem& item : items) {
+        if (!item.isDir() && !item.isMimeTypeKnown() && item.localPath().isEmpty()) {
+            item.determineMimeType();
+        }
     }
+}
+
+void KFileItemModel::applySortedItems(const QList<ItemData*>& sortedItems)
+{
+    const int itemCount = sortedItems.count();
+    m_rankedItemCount = -1;
 
     // Determine the first index that has been moved.
     int firstMovedIndex = 0;
     while (firstMovedIndex < itemCount
-           && firstMovedIndex == m_items.value(oldUrls.at(firstMovedIndex))) {
+           && m_itemData.at(firstMovedIndex) == sortedItems.at(firstMovedIndex)) {
         ++firstMovedIndex;
     }
 
@@ -883,21 +3083,39 @@ void KFileItemModel::resortAllItems()
 
         int lastMovedIndex = itemCount - 1;
         while (lastMovedIndex > firstMovedIndex
-               && lastMovedIndex == m_items.value(oldUrls.at(lastMovedIndex))) {
+               && m_itemData.at(lastMovedIndex) == sortedItems.at(lastMovedIndex)) {
             --lastMovedIndex;
         }
 
         Q_ASSERT(firstMovedIndex <= lastMovedIndex);
 
+        const int movedItemsCount = lastMovedIndex - firstMovedIndex + 1;
+        QHash<const ItemData*, int> newIndexes;
+        newIndexes.reserve(movedItemsCount);
+        for (int i = firstMovedIndex; i <= lastMovedIndex; ++i) {
+            newIndexes.insert(sortedItems.at(i), i);
+        }
+
         // Create a list movedToIndexes, which has the property that
         // movedToIndexes[i] is the new index of the item with the old index
         // firstMovedIndex + i.
-        const int movedItemsCount = lastMovedIndex - firstMovedIndex + 1;
         QList<int> movedToIndexes;
         movedToIndexes.reserve(movedItemsCount);
         for (int i = firstMovedIndex; i <= lastMovedIndex; ++i) {
-            const int newIndex = m_items.value(oldUrls.at(i));
-            movedToIndexes.append(newIndex);
+            movedToIndexes.append(newIndexes.value(m_itemData.at(i)));
+        }
+
+        // Only the moved items get other indexes in m_items, which
+        // contains the first itemsInIndexCache items of m_itemData.
+        const int itemsInIndexCache = m_items.count();
+        const int indexCacheEnd = qMin(lastMovedIndex + 1, itemsInIndexCache);
+        for (int i = firstMovedIndex; i < indexCacheEnd; ++i) {
+            m_items.remove(urlKey(m_itemData.at(i)));
+        }
+
+        m_itemData = sortedItems;
+        for (int i = firstMovedIndex; i < indexCacheEnd; ++i) {
+            m_items.insert(urlKey(m_itemData.at(i)), i);
         }
 
         Q_EMIT itemsMoved(KItemRange(firstMovedIndex, movedItemsCount), movedToIndexes);
@@ -909,41 +3127,53 @@ void KFileItemModel::resortAllItems()
             Q_EMIT groupsChanged();
         }
     }
-
-#ifdef KFILEITEMMODEL_DEBUG
-    qCDebug(DolphinDebug) << "[TIME] Resorting of" << itemCount << "items:" << timer.elapsed();
-#endif
 }
 
-void KFileItemModel::slotCompleted()
+void KFileItemModel::slotCompleted(const QUrl& url)
 {
     m_maximumUpdateIntervalTimer->stop();
     dispatchPendingItemsToInsert();
+    removeUnconfirmedRestoredItems();
+    m_reloadingKeptItems = false;
 
-    if (!m_urlsToExpand.isEmpty()) {
-        // Try to find a URL that can be expanded.
-        // Note that the parent folder must be expanded before any of its subfolders become visible.
-        // Therefore, some URLs in m_restoredExpandedUrls might not be visible yet
-        // -> we expand the first visible URL we find in m_restoredExpandedUrls.
-        // Iterate over a const copy because items are deleted and inserted within the loop
-        const auto urlsToExpand = m_urlsToExpand;
-        for(const QUrl &url : urlsToExpand) {
-            const int indexForUrl = index(url);
-            if (indexForUrl >= 0) {
-                m_urlsToExpand.remove(url);
-                if (setExpanded(indexForUrl, true)) {
-                    // The dir lister has been triggered. This slot will be called
-                    // again after the directory has been expanded.
-                    return;
-                }
-            }
+    if (m_rankedItemCount >= 0) {
+        // Sort the items of a huge directory that have been appended while
+        // listing. The search results have been kept sorted.
+        finishRankedItems();
+    }
+    m_hugeDirectory = false;
+
+    m_expandingDirs.remove(url);
+    if (m_listingRecursiveDirs.remove(url)) {
+        if (m_watchedRecursiveDirs.count() < MaximumWatchedRecursiveDirs) {
+            m_watchedRecursiveDirs.insert(url);
+        } else {
+            m_recursiveDirsToForget.append(url);
+            m_recursiveListingTimer->start();
         }
+    }
+    if (m_dirLister->isFinished()) {
+        // Directories whose listing has failed are not reported as completed
+        m_expandingDirs.clear();
+        m_listingRecursiveDirs.clear();
+    }
 
-        // None of the URLs in m_restoredExpandedUrls could be found in the model. This can happen
-        // if these URLs have been deleted in the meantime.
-        m_urlsToExpand.clear();
+    expandPendingDirectories();
+    listRecursiveDirectories();
+    if (!m_expandingDirs.isEmpty() || !m_listingRecursiveDirs.isEmpty()) {
+        // This slot will be called again after the
+        // directories have been expanded.
+        return;
     }
 
+    // The caches might have to make room for the listed items
+    KMemoryBudget::instance().scheduleCheck();
+
+    if (m_loadingTraceStart >= 0) {
+        KItemListTracer::addAsyncEvent("KFileItemModel::loadDirectory", this, m_loadingTraceStart,
+                                       KItemListTracer::timestamp() - m_loadingTraceStart);
+        m_loadingTraceStart = -1;
+    }
     Q_EMIT directoryLoadingCompleted();
 }
 
@@ -951,6 +3181,27 @@ void KFileItemModel::slotCanceled()
 {
     m_maximumUpdateIntervalTimer->stop();
     dispatchPendingItemsToInsert();
+    m_listing = false;
+    setHoldingBackBackgroundTasks(false);
+
+    if (m_rankedItemCount >= 0) {
+        finishRankedItems();
+    }
+    m_hugeDirectory = false;
+
+    if (m_reloadingKeptItems) {
+        // The reloaded directory might not exist anymore, so only the
+        // items that have been listed again are kept
+        m_reloadingKeptItems = false;
+        removeUnconfirmedRestoredItems();
+    }
+
+    // It is unknown whether the items of a restored snapshot still exist, so they are kept
+    m_unconfirmedRestoredUrls.clear();
+    m_expandingDirs.clear();
+    m_recursiveDirsToList.clear();
+    m_listingRecursiveDirs.clear();
+    m_loadingTraceStart = -1;
 
     Q_EMIT directoryLoadingCanceled();
 }
@@ -959,14 +3210,57 @@ void KFileItemModel::slotItemsAdded(const QUrl &directoryUrl, const KFileItemLis
 {
     Q_ASSERT(!items.isEmpty());
 
+    if (!m_unconfirmedRestoredUrls.isEmpty() && directoryUrl.adjusted(QUrl::StripTrailingSlash) == directory().adjusted(QUrl::StripTrailingSlash)) {
+        // Only the items that are not part of the restored snapshot must be added
+        const KFileItemList newItems = confirmRestoredItems(items);
+        if (newItems.count() < items.count()) {
+            if (!newItems.isEmpty()) {
+                slotItemsAdded(directoryUrl, newItems);
+            }
+            return;
+        }
+    }
+
+    if (!m_unconfirmedKeptItems.isEmpty() && directoryUrl.adjusted(QUrl::StripTrailingSlash) == directory().adjusted(QUrl::StripTrailingSlash)) {
+        // The hidden items that have been kept are inserted by insertKeptItems()
+        const KFileItemList newItems = confirmKeptItems(items);
+        if (newItems.count() < items.count()) {
+            if (!newItems.isEmpty()) {
+                slotItemsAdded(directoryUrl, newItems);
+            }
+            return;
+        }
+    }
+
+    // Creating the item-data changes m_roleStore, which is read while sorting.
+    // Canceling the resorting for each received batch would never let a huge
+    // directory get sorted while it is loading. So the items are added when
+    // the worker thread is done, unless they would make its result outdated.
+    if (isAsyncResortRunning() && m_itemsAddedWhileResortingCount + items.count() <= count()) {
+        m_itemsAddedWhileResorting.append(qMakePair(directoryUrl, items));
+        m_itemsAddedWhileResortingCount += items.count();
+        m_maximumUpdateIntervalTimer->stop();
+        return;
+    }
+    cancelAsyncResort();
+
     QUrl parentUrl;
-    if (m_expandedDirs.contains(directoryUrl)) {
+    if (m_recursiveListing) {
+        // The items of all sub-directories are top-level items without parent
+        // and are inserted and sorted like the items of the directory
+        if (index(items.first().url()) >= 0) {
+            // KDirLister might emit the items of a sub-directory that is listed with
+            // KDirLister::Keep again, if the directory has been listed before.
+            return;
+        }
+        queueRecursiveDirectories(directoryUrl, items);
+    } else if (m_expandedDirs.contains(directoryUrl)) {
         parentUrl = m_expandedDirs.value(directoryUrl);
     } else {
         parentUrl = directoryUrl.adjusted(QUrl::StripTrailingSlash);
     }
 
-    if (m_requestRole[ExpandedParentsCountRole]) {
+    if (m_requestRole[ExpandedParentsCountRole] && !m_recursiveListing) {
         // If the expanding of items is enabled, the call
         // dirLister->openUrl(url, KDirLister::Keep) in KFileItemModel::setExpanded()
         // might result in emitting the same items twice due to the Keep-parameter.
@@ -993,6 +3287,20 @@ void KFileItemModel::slotItemsAdded(const QUrl &directoryUrl, const KFileItemLis
         }
     }
 
+    if (m_listing && !m_recursiveListing && directoryUrl.adjusted(QUrl::StripTrailingSlash) == directory().adjusted(QUrl::StripTrailingSlash)) {
+        m_listedItemCount += items.count();
+        for (const KFileItem& item : items) {
+            if (!item.isDir()) {
+                m_listedFilesSize += item.size();
+            }
+        }
+
+        if (!m_hugeDirectory && !m_searchModeEnabled
+                && (m_listedItemCount > HugeDirectoryItemsLimit || m_estimatedItemCount > HugeDirectoryItemsLimit)) {
+            m_hugeDirectory = true;
+        }
+    }
+
     const QList<ItemData*> itemDataList = createItemDataList(parentUrl, items);
 
     if (!m_filter.hasSetFilters()) {
@@ -1005,11 +3313,31 @@ void KFileItemModel::slotItemsAdded(const QUrl &directoryUrl, const KFileItemLis
             if (m_filter.matches(itemData->item)) {
                 m_pendingItemsToInsert.append(itemData);
             } else {
-                m_filteredItems.insert(itemData->item, itemData);
+                // The filtered items are sorted when they are shown
+                m_filteredItems.append(itemData);
             }
         }
     }
 
+    if (!m_dirLister->isListingLocally() && !m_searchModeEnabled && !m_hugeDirectory) {
+        presortPendingItems();
+    }
+
+    if (m_searchModeEnabled && m_itemData.isEmpty()) {
+        // Show the first search results as soon as they arrive
+        m_maximumUpdateIntervalTimer->stop();
+        dispatchPendingItemsToInsert();
+        return;
+    }
+
+    if (m_visibleItemCountHint > 0 && m_itemData.isEmpty() && m_pendingItemsToInsert.count() >= m_visibleItemCountHint) {
+        // Show the first screenful of items as soon as possible instead of
+        // waiting for the update interval.
+        m_maximumUpdateIntervalTimer->stop();
+        dispatchPendingItemsToInsert();
+        return;
+    }
+
     if (!m_maximumUpdateIntervalTimer->isActive()) {
         // Assure that items get dispatched if no completed() or canceled() signal is
         // emitted during the maximum update interval.
@@ -1019,10 +3347,12 @@ void KFileItemModel::slotItemsAdded(const QUrl &directoryUrl, const KFileItemLis
 
 void KFileItemModel::slotItemsDeleted(const KFileItemList& items)
 {
+    cancelAsyncResort();
     dispatchPendingItemsToInsert();
 
     QVector<int> indexesToRemove;
     indexesToRemove.reserve(items.count());
+    QSet<UrlKey> filteredUrls;
 
     for (const KFileItem& item : items) {
         const int indexForItem = index(item);
@@ -1030,30 +3360,50 @@ void KFileItemModel::slotItemsDeleted(const KFileItemList& items)
             indexesToRemove.append(indexForItem);
         } else {
             // Probably the item has been filtered.
-            QHash<KFileItem, ItemData*>::iterator it = m_filteredItems.find(item);
-            if (it != m_filteredItems.end()) {
-                delete it.value();
-                m_filteredItems.erase(it);
+            filteredUrls.insert(urlKey(item.url()));
+        }
+    }
+
+    if (!filteredUrls.isEmpty() && !m_filteredItems.isEmpty()) {
+        removeFilteredItems([&filteredUrls](const ItemData* itemData) {
+            return filteredUrls.contains(urlKey(itemData));
+        });
+    }
+
+    if (m_recursiveListing) {
+        // The items of deleted sub-directories are not children of the
+        // sub-directories in the flat list, so they are removed separately
+        QList<QUrl> deletedDirs;
+        for (const KFileItem& item : items) {
+            const QUrl url = item.url().adjusted(QUrl::StripTrailingSlash);
+            if (item.isDir() && m_recursiveDirs.contains(url)) {
+                deletedDirs.append(url);
             }
         }
+
+        if (!deletedDirs.isEmpty()) {
+            indexesToRemove.append(forgetRecursiveDirectories(deletedDirs));
+        }
     }
 
     std::sort(indexesToRemove.begin(), indexesToRemove.end());
+    indexesToRemove.erase(std::unique(indexesToRemove.begin(), indexesToRemove.end()), indexesToRemove.end());
 
     if (m_requestRole[ExpandedParentsCountRole] && !m_expandedDirs.isEmpty()) {
         // Assure that removing a parent item also results in removing all children
         QVector<int> indexesToRemoveWithChildren;
         indexesToRemoveWithChildren.reserve(m_itemData.count());
 
-        const int itemCount = m_itemData.count();
+        int removedEnd = 0;
         for (int index : qAsConst(indexesToRemove)) {
-            indexesToRemoveWithChildren.append(index);
+            if (index < removedEnd) {
+                // The item is a child of an item that is removed already
+                continue;
+            }
 
-            const int parentLevel = expandedParentsCount(index);
-            int childIndex = index + 1;
-            while (childIndex < itemCount && expandedParentsCount(childIndex) > parentLevel) {
-                indexesToRemoveWithChildren.append(childIndex);
-                ++childIndex;
+            removedEnd = subtreeEnd(index);
+            for (int i = index; i < removedEnd; ++i) {
+                indexesToRemoveWithChildren.append(i);
             }
         }
 
@@ -1072,12 +3422,46 @@ void KFileItemModel::slotRefreshItems(const QList<QPair<KFileItem, KFileItem> >&
     qCDebug(DolphinDebug) << "Refreshing" << items.count() << "items";
 #endif
 
+    cancelAsyncResort();
+
+    if (m_recursiveListing) {
+        // The items that have been listed in renamed sub-directories still have
+        // the old URLs, so they are removed and the sub-directories are listed again
+        QList<QUrl> renamedDirs;
+        QList<QPair<QUrl, int> > newDirs;
+        for (const QPair<KFileItem, KFileItem>& itemPair : items) {
+            const QUrl oldUrl = itemPair.first.url().adjusted(QUrl::StripTrailingSlash);
+            const QUrl newUrl = itemPair.second.url().adjusted(QUrl::StripTrailingSlash);
+            if (oldUrl != newUrl && m_recursiveDirs.contains(oldUrl)) {
+                renamedDirs.append(oldUrl);
+                newDirs.append(qMakePair(newUrl, m_recursiveDirs.value(oldUrl)));
+            }
+        }
+
+        if (!renamedDirs.isEmpty()) {
+            QList<int> indexesToRemove = forgetRecursiveDirectories(renamedDirs);
+            if (!indexesToRemove.isEmpty()) {
+                std::sort(indexesToRemove.begin(), indexesToRemove.end());
+                removeItems(KItemRangeList::fromSortedContainer(indexesToRemove), DeleteItemData);
+            }
+
+            for (const QPair<QUrl, int>& newDir : qAsConst(newDirs)) {
+                m_recursiveDirs.insert(newDir.first, newDir.second);
+                m_recursiveDirsToList.append(newDir.first);
+            }
+            m_recursiveListingTimer->start();
+        }
+    }
+
     // Get the indexes of all items that have been refreshed
     QList<int> indexes;
     indexes.reserve(items.count());
 
     QSet<QByteArray> changedRoles;
 
+    // Filtered items are looked up by one pass over m_filteredItems
+    QHash<UrlKey, KFileItem> refreshedFilteredItems;
+
     QListIterator<QPair<KFileItem, KFileItem> > it(items);
     while (it.hasNext()) {
         const QPair<KFileItem, KFileItem>& itemPair = it.next();
@@ -1085,7 +3469,13 @@ void KFileItemModel::slotRefreshItems(const QList<QPair<KFileItem, KFileItem> >&
         const KFileItem& newItem = itemPair.second;
         const int indexForItem = index(oldItem);
         if (indexForItem >= 0) {
+            m_items.remove(urlKey(m_itemData.at(indexForItem)));
             m_itemData[indexForItem]->item = newItem;
+            updateUrlHash(m_itemData[indexForItem]);
+            updateRoleStore(m_itemData.at(indexForItem));
+            if (oldItem.text() != newItem.text()) {
+                updateSortKey(m_itemData[indexForItem]);
+            }
 
             // Keep old values as long as possible if they could not retrieved synchronously yet.
             // The update of the values will be done asynchronously by KFileItemModelRolesUpdater.
@@ -1100,23 +3490,32 @@ void KFileItemModel::slotRefreshItems(const QList<QPair<KFileItem, KFileItem> >&
                 }
             }
 
-            m_items.remove(oldItem.url());
-            m_items.insert(newItem.url(), indexForItem);
+            m_items.insert(urlKey(m_itemData.at(indexForItem)), indexForItem);
             indexes.append(indexForItem);
         } else {
-            // Check if 'oldItem' is one of the filtered items.
-            QHash<KFileItem, ItemData*>::iterator it = m_filteredItems.find(oldItem);
-            if (it != m_filteredItems.end()) {
-                ItemData* itemData = it.value();
-                itemData->item = newItem;
+            // Check later if 'oldItem' is one of the filtered items.
+            refreshedFilteredItems.insert(urlKey(oldItem.url()), newItem);
+        }
+    }
 
-                // The data stored in 'values' might have changed. Therefore, we clear
-                // 'values' and re-populate it the next time it is requested via data(int).
-                itemData->values.clear();
+    if (!refreshedFilteredItems.isEmpty()) {
+        for (ItemData* itemData : qAsConst(m_filteredItems)) {
+            const auto refreshedIt = refreshedFilteredItems.constFind(urlKey(itemData));
+            if (refreshedIt == refreshedFilteredItems.constEnd()) {
+                continue;
+            }
 
-                m_filteredItems.erase(it);
-                m_filteredItems.insert(newItem, itemData);
+            const QString oldText = itemData->item.text();
+            itemData->item = refreshedIt.value();
+            updateUrlHash(itemData);
+            updateRoleStore(itemData);
+            if (oldText != itemData->item.text()) {
+                updateSortKey(itemData);
             }
+
+            // The data stored in 'values' might have changed. Therefore, we clear
+            // 'values' and re-populate it the next time it is requested via data(int).
+            itemData->values.clear();
         }
     }
 
@@ -1126,59 +3525,386 @@ void KFileItemModel::slotRefreshItems(const QList<QPair<KFileItem, KFileItem> >&
         return;
     }
 
-    // Extract the item-ranges out of the changed indexes
-    std::sort(indexes.begin(), indexes.end());
-    const KItemRangeList itemRangeList = KItemRangeList::fromSortedContainer(indexes);
-    emitItemsChangedAndTriggerResorting(itemRangeList, changedRoles);
+    // Extract the item-ranges out of the changed indexes
+    std::sort(indexes.begin(), indexes.end());
+    const KItemRangeList itemRangeList = KItemRangeList::fromSortedContainer(indexes);
+    emitItemsChangedAndTriggerResorting(itemRangeList, changedRoles);
+}
+
+void KFileItemModel::slotClear()
+{
+#ifdef KFILEITEMMODEL_DEBUG
+    qCDebug(DolphinDebug) << "Clearing all items";
+#endif
+
+    if (m_keepItemsOnClear) {
+        // The items are compared with the listed items, see refreshDirectory()
+        return;
+    }
+
+    m_itemsAddedWhileResorting.clear();
+    m_itemsAddedWhileResortingCount = 0;
+    cancelAsyncResort();
+    m_pendingValues.clear();
+    m_pendingMimeTypes.clear();
+    m_mimeTypeResolver->cancel();
+
+    m_filteredItems.clear();
+    m_keptItems.clear();
+    m_unconfirmedKeptItems.clear();
+    m_changedKeptItems.clear();
+    m_groups.clear();
+
+    m_maximumUpdateIntervalTimer->stop();
+    m_resortAllItemsTimer->stop();
+    m_itemsToReposition.clear();
+    m_repositionItemsOnly = false;
+    m_deferredResortPending = false;
+
+    m_pendingItemsToInsert.clear();
+    m_pendingRunEnds.clear();
+    m_rankedItemCount = -1;
+    m_hugeDirectory = false;
+    // The collation keys of the new items are determined when they are created
+    m_sortKeysAllowed = true;
+    m_estimatedItemCount = -1;
+    m_listedItemCount = 0;
+    m_listedFilesSize = 0;
+    m_unconfirmedRestoredUrls.clear();
+    m_reloadingKeptItems = false;
+    m_expandingDirs.clear();
+    clearRecursiveDirectories();
+    m_restoredItems.clear();
+    m_changeCoalescer.clear();
+    m_changeCoalescingTimer->stop();
+
+    const int removedCount = m_itemData.count();
+    if (removedCount > 0) {
+        m_itemData.clear();
+        m_items.clear();
+        Q_EMIT itemsRemoved(KItemRangeList() << KItemRange(0, removedCount));
+    }
+
+    // No item refers to the item-data or the role values anymore, so
+    // they can be released at once.
+    m_itemDataPool.clear();
+    m_itemDataById.clear();
+    m_roleStore.clear();
+    m_sharedStrings.clear();
+    m_userNames.clear();
+    m_groupNames.clear();
+    m_themeIcons.clear();
+
+    m_expandedDirs.clear();
+}
+
+void KFileItemModel::queueItemsAdded(const QUrl& directoryUrl, const KFileItemList& items)
+{
+    if (!coalesceChanges()) {
+        // The order of the changes must be kept
+        applyQueuedChanges();
+        slotItemsAdded(directoryUrl, items);
+        return;
+    }
+
+    m_changeCoalescer.addItems(directoryUrl, items);
+    if (!m_changesDeferred && !m_changeCoalescingTimer->isActive()) {
+        m_changeCoalescingTimer->start();
+    }
+}
+
+void KFileItemModel::queueItemsDeleted(const KFileItemList& items)
+{
+    if (!coalesceChanges()) {
+        applyQueuedChanges();
+        slotItemsDeleted(items);
+        return;
+    }
+
+    m_changeCoalescer.deleteItems(items);
+    if (!m_changesDeferred && !m_changeCoalescingTimer->isActive()) {
+        m_changeCoalescingTimer->start();
+    }
+}
+
+void KFileItemModel::queueRefreshItems(const QList<QPair<KFileItem, KFileItem> >& items)
+{
+    bool coalesce = coalesceChanges();
+    for (int i = 0; coalesce && i < items.count(); ++i) {
+        // Renamed items are identified by their old URL, which
+        // cannot be merged with other changes.
+        coalesce = (items.at(i).first.url() == items.at(i).second.url());
+    }
+
+    if (!coalesce) {
+        applyQueuedChanges();
+        slotRefreshItems(items);
+        return;
+    }
+
+    m_changeCoalescer.refreshItems(items);
+    if (!m_changesDeferred && !m_changeCoalescingTimer->isActive()) {
+        m_changeCoalescingTimer->start();
+    }
+}
+
+bool KFileItemModel::coalesceChanges() const
+{
+    return !m_listing && (m_changesDeferred || m_changeCoalescingTimer->interval() > 0);
+}
+
+void KFileItemModel::applyQueuedChanges()
+{
+    m_changeCoalescingTimer->stop();
+    if (m_changeCoalescer.isEmpty()) {
+        return;
+    }
+
+    const KFileItemModelChangeCoalescer::Changes changes = m_changeCoalescer.takeChanges();
+    if (!changes.deletedItems.isEmpty()) {
+        slotItemsDeleted(changes.deletedItems);
+    }
+    if (!changes.refreshedItems.isEmpty()) {
+        slotRefreshItems(changes.refreshedItems);
+    }
+    if (!changes.addedItems.isEmpty()) {
+        for (auto it = changes.addedItems.constBegin(); it != changes.addedItems.constEnd(); ++it) {
+            slotItemsAdded(it.key(), it.value());
+        }
+
+        // The directory lister has reported the completion already, so
+        // the added items must be inserted now.
+        m_maximumUpdateIntervalTimer->stop();
+        dispatchPendingItemsToInsert();
+    }
+}
+
+void KFileItemModel::slotSortingChoiceChanged()
+{
+    cancelAsyncResort();
+    loadSortingSettings();
+    updateSortKeys();
+    resortAllItems();
+}
+
+void KFileItemModel::traceFirstItems()
+{
+    if (m_loadingTraceStart >= 0 && !m_firstItemsTraced && count() > 0) {
+        m_firstItemsTraced = true;
+        KItemListTracer::addAsyncEvent("KFileItemModel::timeToFirstItem", this, m_loadingTraceStart,
+                                       KItemListTracer::timestamp() - m_loadingTraceStart);
+    }
+}
+
+void KFileItemModel::dispatchPendingItemsToInsert()
+{
+    if (m_pendingItemsToInsert.isEmpty() && m_itemsAddedWhileResorting.isEmpty()) {
+        return;
+    }
+
+    // Inserting the items changes m_itemData, which is read while sorting.
+    // The items that have been listed meanwhile become pending items.
+    cancelAsyncResort();
+    if (m_pendingItemsToInsert.isEmpty()) {
+        return;
+    }
+
+    const KItemListTraceScope traceScope("KFileItemModel::dispatchPendingItemsToInsert", nullptr, m_pendingItemsToInsert.count());
+
+    QElapsedTimer timer;
+    timer.start();
+
+    KItemListCostModel& costModel = KItemListCostModel::instance();
+    const int insertedCount = m_pendingItemsToInsert.count();
+
+    if (m_sortKeysAllowed && updateSortKeysAllowed(count() + insertedCount)) {
+        // The collation keys of all items would exceed the sorting memory limit
+        cancelAsyncResort();
+        updateSortKeys();
+    }
+    if ((m_searchModeEnabled || m_hugeDirectory) && m_listing && m_expandedDirs.isEmpty()) {
+        insertSearchResults(m_pendingItemsToInsert);
+    } else if (mergePendingRuns()) {
+        insertPresortedItems(m_pendingItemsToInsert);
+    } else {
+        insertItems(m_pendingItemsToInsert);
+    }
+
+    if (m_hugeDirectory && m_listing) {
+        Q_EMIT directoryLoadingEstimateChanged(m_listedItemCount, estimatedItemCount(), estimatedTotalSize());
+    }
+    m_pendingItemsToInsert.clear();
+    m_pendingRunEnds.clear();
+    costModel.addInsertionSample(insertedCount, timer.nsecsElapsed());
+    KItemListMetrics::instance().add(KItemListMetrics::ItemsLoaded, insertedCount);
+    traceFirstItems();
+
+    if (m_visibleItemCountHint > 0) {
+        // The time includes the layouting of the view, which is triggered
+        // by the itemsInserted() signal. Items that are inserted after the
+        // last visible item don't move the visible items, so inserting
+        // often is cheap as long as the items arrive in the sort order.
+        const qint64 interval = timer.elapsed() * UpdateCostFactor;
+        const int maximumInterval = costModel.maximumUpdateInterval();
+        m_maximumUpdateIntervalTimer->setInterval(static_cast<int>(qBound<qint64>(MinimumUpdateInterval, interval, maximumInterval)));
+    } else if (!m_searchModeEnabled) {
+        m_maximumUpdateIntervalTimer->setInterval(costModel.maximumUpdateInterval());
+    }
+}
+
+void KFileItemModel::insertSearchResults(QList<ItemData*>& items)
+{
+    const int rankedItemsLimit = qMax(RankedSearchResultsCount, m_visibleItemCountHint);
+
+    if (m_rankedItemCount < 0) {
+        // All items are sorted. Merging the first results is cheap, and the
+        // best ranked items are known afterwards.
+        insertItems(items);
+        m_rankedItemCount = qMin(count(), rankedItemsLimit);
+        return;
+    }
+
+    if (m_rankedItemCount == 0) {
+        // All ranked items have been removed, the best ranked
+        // items are unknown until the listing is completed.
+        if (m_searchModeEnabled) {
+            insertItems(items);
+        } else {
+            appendItems(items);
+        }
+        return;
+    }
+
+    prepareItemsForSorting(items);
+
+    // Only the results that rank higher than the last ranked item must be
+    // merged into the ranked items, all items behind it rank lower.
+    const ItemData* lastRankedItem = m_itemData.at(m_rankedItemCount - 1);
+    QList<ItemData*> rankedItems;
+    QList<ItemData*> otherItems;
+    for (ItemData* itemData : qAsConst(items)) {
+        if (lessThan(itemData, lastRankedItem, m_collator)) {
+            rankedItems.append(itemData);
+        } else {
+            otherItems.append(itemData);
+        }
+    }
+
+    if (!rankedItems.isEmpty()) {
+        insertItems(rankedItems, m_rankedItemCount);
+        m_rankedItemCount = qMin(m_rankedItemCount + rankedItems.count(), rankedItemsLimit);
+    }
+
+    if (m_searchModeEnabled) {
+        // The search results behind the ranked items are kept sorted too.
+        // They rank lower than the ranked items, so merging them only
+        // moves the items behind the ranked items.
+        insertItems(otherItems);
+    } else {
+        appendItems(otherItems);
+    }
 }
 
-void KFileItemModel::slotClear()
+void KFileItemModel::finishRankedItems()
 {
-#ifdef KFILEITEMMODEL_DEBUG
-    qCDebug(DolphinDebug) << "Clearing all items";
-#endif
+    if (m_searchModeEnabled) {
+        m_rankedItemCount = -1;
+    } else {
+        resortAllItems();
+    }
+}
 
-    qDeleteAll(m_filteredItems);
-    m_filteredItems.clear();
-    m_groups.clear();
+void KFileItemModel::appendItems(QList<ItemData*>& newItems)
+{
+    if (newItems.isEmpty()) {
+        return;
+    }
 
-    m_maximumUpdateIntervalTimer->stop();
-    m_resortAllItemsTimer->stop();
+    cancelAsyncResort();
 
-    qDeleteAll(m_pendingItemsToInsert);
-    m_pendingItemsToInsert.clear();
+    const int existingItemCount = m_itemData.count();
+    const bool indexCacheComplete = (existingItemCount > 0 && m_items.count() == existingItemCount);
+    m_itemData.append(newItems);
+    updateIndexCache(existingItemCount, indexCacheComplete);
 
-    const int removedCount = m_itemData.count();
-    if (removedCount > 0) {
-        qDeleteAll(m_itemData);
-        m_itemData.clear();
-        m_items.clear();
-        Q_EMIT itemsRemoved(KItemRangeList() << KItemRange(0, removedCount));
+    const KItemRangeList itemRanges = {KItemRange(existingItemCount, newItems.count())};
+    if (existingItemCount == 0) {
+        m_groups.clear();
+    } else {
+        updateGroupsForInsertedItems(itemRanges);
     }
 
-    m_expandedDirs.clear();
+    Q_EMIT itemsInserted(itemRanges);
+
+    if (m_sortRole == TypeRole) {
+        KFileItemList items;
+        items.reserve(newItems.count());
+        for (const ItemData* itemData : qAsConst(newItems)) {
+            items.append(itemData->item);
+        }
+        m_mimeTypeResolver->resolve(items);
+    }
 }
 
-void KFileItemModel::slotSortingChoiceChanged()
+void KFileItemModel::presortPendingItems()
 {
-    loadSortingSettings();
-    resortAllItems();
+    const int itemCount = m_pendingItemsToInsert.count();
+    const int runStart = m_pendingRunEnds.isEmpty() ? 0 : m_pendingRunEnds.last();
+    if (runStart >= itemCount) {
+        return;
+    }
+
+    QList<ItemData*> newItems = m_pendingItemsToInsert.mid(runStart);
+    prepareItemsForSorting(newItems);
+    sort(m_pendingItemsToInsert.begin() + runStart, m_pendingItemsToInsert.end());
+    m_pendingRunEnds.append(itemCount);
+
+    // Each item takes part in O(log N) merges only, because the last
+    // run is merged with the previous one as soon as it is not shorter.
+    const auto itemLessThan = [this](const ItemData* a, const ItemData* b) {
+        return lessThan(a, b, m_collator);
+    };
+    while (m_pendingRunEnds.count() >= 2) {
+        const int runCount = m_pendingRunEnds.count();
+        const int lastRunStart = m_pendingRunEnds.at(runCount - 2);
+        const int previousRunStart = (runCount >= 3) ? m_pendingRunEnds.at(runCount - 3) : 0;
+        if (itemCount - lastRunStart < lastRunStart - previousRunStart) {
+            break;
+        }
+
+        const auto begin = m_pendingItemsToInsert.begin();
+        std::inplace_merge(begin + previousRunStart, begin + lastRunStart, m_pendingItemsToInsert.end(), itemLessThan);
+        m_pendingRunEnds.remove(runCount - 2);
+    }
 }
 
-void KFileItemModel::dispatchPendingItemsToInsert()
+bool KFileItemModel::mergePendingRuns()
 {
-    if (!m_pendingItemsToInsert.isEmpty()) {
-        insertItems(m_pendingItemsToInsert);
-        m_pendingItemsToInsert.clear();
+    // Items that have been appended without presorting are not part of a run
+    if (m_pendingRunEnds.isEmpty() || m_pendingRunEnds.last() != m_pendingItemsToInsert.count()) {
+        return false;
+    }
+
+    const auto itemLessThan = [this](const ItemData* a, const ItemData* b) {
+        return lessThan(a, b, m_collator);
+    };
+    const auto begin = m_pendingItemsToInsert.begin();
+    for (int i = m_pendingRunEnds.count() - 2; i >= 0; --i) {
+        const int runStart = (i > 0) ? m_pendingRunEnds.at(i - 1) : 0;
+        std::inplace_merge(begin + runStart, begin + m_pendingRunEnds.at(i), m_pendingItemsToInsert.end(), itemLessThan);
     }
+    m_pendingRunEnds = {m_pendingItemsToInsert.count()};
+    return true;
 }
 
-void KFileItemModel::insertItems(QList<ItemData*>& newItems)
+void KFileItemModel::insertItems(QList<ItemData*>& newItems, int mergedItemCount)
 {
     if (newItems.isEmpty()) {
         return;
     }
 
+    cancelAsyncResort();
+
 #ifdef KFILEITEMMODEL_DEBUG
     QElapsedTimer timer;
     timer.start();
@@ -1186,7 +3912,6 @@ void KFileItemModel::insertItems(QList<ItemData*>& newItems)
     qCDebug(DolphinDebug) << "Inserting" << newItems.count() << "items";
 #endif
 
-    m_groups.clear();
     prepareItemsForSorting(newItems);
 
     // Natural sorting of items can be very slow. However, it becomes much faster
@@ -1198,7 +3923,7 @@ void KFileItemModel::insertItems(QList<ItemData*>& newItems)
         } else if (isRoleValueNatural(m_sortRole)) {
             auto lambdaLessThan = [&] (const KFileItemModel::ItemData* a, const KFileItemModel::ItemData* b)
             {
-                const QByteArray role = roleForType(m_sortRole);
+                const QByteArray& role = roleForType(m_sortRole);
                 return a->values.value(role).toString() < b->values.value(role).toString();
             };
             parallelMergeSort(newItems.begin(), newItems.end(), lambdaLessThan, QThread::idealThreadCount());
@@ -1211,10 +3936,31 @@ void KFileItemModel::insertItems(QList<ItemData*>& newItems)
     qCDebug(DolphinDebug) << "[TIME] Sorting:" << timer.elapsed();
 #endif
 
+    insertSortedItems(newItems, mergedItemCount);
+
+#ifdef KFILEITEMMODEL_DEBUG
+    qCDebug(DolphinDebug) << "[TIME] Inserting of" << newItems.count() << "items:" << timer.elapsed();
+#endif
+}
+
+void KFileItemModel::insertSortedItems(const QList<ItemData*>& newItems, int mergedItemCount)
+{
+    if (newItems.isEmpty()) {
+        return;
+    }
+
+    cancelAsyncResort();
+
     KItemRangeList itemRanges;
     const int existingItemCount = m_itemData.count();
+    // If the model is empty, m_items is populated lazily by index(const QUrl&)
+    // to keep entering a folder fast.
+    const bool indexCacheComplete = (existingItemCount > 0 && m_items.count() == existingItemCount);
     const int newItemCount = newItems.count();
     const int totalItemCount = existingItemCount + newItemCount;
+    if (mergedItemCount < 0 || mergedItemCount > existingItemCount) {
+        mergedItemCount = existingItemCount;
+    }
 
     if (existingItemCount == 0) {
         // Optimization for the common special case that there are no
@@ -1227,10 +3973,15 @@ void KFileItemModel::insertItems(QList<ItemData*>& newItems)
             m_itemData.append(nullptr);
         }
 
+        // The items behind the merged items are only moved.
+        for (int i = existingItemCount - 1; i >= mergedItemCount; --i) {
+            m_itemData[i + newItemCount] = m_itemData.at(i);
+        }
+
         // We build the new list m_itemData in reverse order to minimize
         // the number of moves and guarantee O(N) complexity.
-        int targetIndex = totalItemCount - 1;
-        int sourceIndexExistingItems = existingItemCount - 1;
+        int targetIndex = mergedItemCount + newItemCount - 1;
+        int sourceIndexExistingItems = mergedItemCount - 1;
         int sourceIndexNewItems = newItemCount - 1;
 
         int rangeCount = 0;
@@ -1265,15 +4016,26 @@ void KFileItemModel::insertItems(QList<ItemData*>& newItems)
         std::reverse(itemRanges.begin(), itemRanges.end());
     }
 
-    // The indexes in m_items are not correct anymore. Therefore, we clear m_items.
-    // It will be re-populated with the updated indices if index(const QUrl&) is called.
-    m_items.clear();
+    // The indexes in m_items are not correct anymore for the items behind
+    // the first inserted item.
+    updateIndexCache(itemRanges.first().index, indexCacheComplete);
+
+    if (existingItemCount == 0) {
+        m_groups.clear();
+    } else {
+        updateGroupsForInsertedItems(itemRanges);
+    }
 
     Q_EMIT itemsInserted(itemRanges);
 
-#ifdef KFILEITEMMODEL_DEBUG
-    qCDebug(DolphinDebug) << "[TIME] Inserting of" << newItems.count() << "items:" << timer.elapsed();
-#endif
+    if (m_sortRole == TypeRole) {
+        KFileItemList items;
+        items.reserve(newItemCount);
+        for (const ItemData* itemData : qAsConst(newItems)) {
+            items.append(itemData->item);
+        }
+        m_mimeTypeResolver->resolve(items);
+    }
 }
 
 void KFileItemModel::removeItems(const KItemRangeList& itemRanges, RemoveItemsBehavior behavior)
@@ -1282,16 +4044,31 @@ void KFileItemModel::removeItems(const KItemRangeList& itemRanges, RemoveItemsBe
         return;
     }
 
-    m_groups.clear();
+    cancelAsyncResort();
 
     // Step 1: Remove the items from m_itemData, and free the ItemData.
+    // The removed items must also be removed from m_items, which contains
+    // the first itemsInIndexCache items of m_itemData.
+    const int itemsInIndexCache = m_items.count();
     int removedItemsCount = 0;
+    int removedRankedItemsCount = 0;
     for (const KItemRange& range : itemRanges) {
         removedItemsCount += range.count;
+        if (range.index < m_rankedItemCount) {
+            removedRankedItemsCount += qMin(range.index + range.count, m_rankedItemCount) - range.index;
+        }
 
         for (int index = range.index; index < range.index + range.count; ++index) {
+            if (index < itemsInIndexCache) {
+                m_items.remove(urlKey(m_itemData.at(index)));
+            }
+
+            if (!m_itemsToReposition.isEmpty()) {
+                m_itemsToReposition.remove(m_itemData.at(index));
+            }
+
             if (behavior == DeleteItemData) {
-                delete m_itemData.at(index);
+                deleteItemData(m_itemData.at(index));
             }
 
             m_itemData[index] = nullptr;
@@ -1304,6 +4081,7 @@ void KFileItemModel::removeItems(const KItemRangeList& itemRanges, RemoveItemsBe
     int nextRange = 1;
 
     const int oldItemDataCount = m_itemData.count();
+    const bool indexCacheComplete = (itemsInIndexCache == oldItemDataCount);
     while (source < oldItemDataCount) {
         m_itemData[target] = m_itemData[source];
         ++target;
@@ -1317,20 +4095,70 @@ void KFileItemModel::removeItems(const KItemRangeList& itemRanges, RemoveItemsBe
     }
 
     m_itemData.erase(m_itemData.end() - removedItemsCount, m_itemData.end());
+    if (m_rankedItemCount > 0) {
+        m_rankedItemCount -= removedRankedItemsCount;
+    }
+
+    // The indexes in m_items are not correct anymore for the items behind the
+    // first removed item.
+    updateIndexCache(itemRanges.at(0).index, indexCacheComplete);
 
-    // The indexes in m_items are not correct anymore. Therefore, we clear m_items.
-    // It will be re-populated with the updated indices if index(const QUrl&) is called.
-    m_items.clear();
+    updateGroupsForRemovedItems(itemRanges);
 
     Q_EMIT itemsRemoved(itemRanges);
 }
 
-QList<KFileItemModel::ItemData*> KFileItemModel::createItemDataList(const QUrl& parentUrl, const KFileItemList& items) const
+void KFileItemModel::updateIndexCache(int index, bool indexCacheComplete)
+{
+    if (!indexCacheComplete) {
+        // The stale entries will be re-populated with the updated indices
+        // if index(const QUrl&) is called.
+        truncateIndexCache(index);
+        return;
+    }
+
+    // Inserting an existing key only replaces the index. Thanks to the
+    // precalculated hash values, no URL must be hashed.
+    const int itemCount = m_itemData.count();
+    m_items.reserve(itemCount);
+    for (int i = index; i < itemCount; ++i) {
+        m_items.insert(urlKey(m_itemData.at(i)), i);
+    }
+}
+
+void KFileItemModel::truncateIndexCache(int index)
+{
+    int staleEntriesCount = m_items.count() - index;
+    if (staleEntriesCount <= 0) {
+        return;
+    }
+
+    if (staleEntriesCount > index) {
+        // Most entries are stale, it is cheaper to start from scratch.
+        m_items.clear();
+        return;
+    }
+
+    // All items that have stale entries are located at or behind 'index'.
+    const int itemCount = m_itemData.count();
+    for (int i = index; i < itemCount && staleEntriesCount > 0; ++i) {
+        staleEntriesCount -= m_items.remove(urlKey(m_itemData.at(i)));
+    }
+
+    if (staleEntriesCount > 0) {
+        // Should never happen, but assure that m_items stays consistent.
+        m_items.clear();
+    }
+}
+
+QList<KFileItemModel::ItemData*> KFileItemModel::createItemDataList(const QUrl& parentUrl, const KFileItemList& items)
 {
     if (m_sortRole == TypeRole) {
-        // Try to resolve the MIME-types synchronously to prevent a reordering of
-        // the items when sorting by type (per default MIME-types are resolved
-        // asynchronously by KFileItemModelRolesUpdater).
+        // Try to resolve the MIME-types of remote items synchronously to prevent
+        // a reordering of the items when sorting by type (per default MIME-types
+        // are resolved asynchronously by KFileItemModelRolesUpdater). Reading
+        // local files might block for a long time on slow mounts, so they are
+        // resolved by worker threads after having been inserted.
         determineMimeTypes(items, 200);
     }
 
@@ -1341,15 +4169,78 @@ QList<KFileItemModel::ItemData*> KFileItemModel::createItemDataList(const QUrl&
     itemDataList.reserve(items.count());
 
     for (const KFileItem& item : items) {
-        ItemData* itemData = new ItemData();
+        ItemData* itemData = m_itemDataPool.create();
         itemData->item = item;
         itemData->parent = parentItem;
+        itemData->depth = parentItem ? parentItem->depth + 1 : 0;
+        itemData->slot = m_roleStore.acquireSlot();
+        assignItemId(itemData);
+        updateUrlHash(itemData);
+        updateRoleStore(itemData);
+        updateSortKey(itemData);
         itemDataList.append(itemData);
     }
 
     return itemDataList;
 }
 
+void KFileItemModel::assignItemId(ItemData* data)
+{
+    data->id = m_nextItemId++;
+    if (m_nextItemId == 0) {
+        // Skip the invalid identifier after an overflow
+        m_nextItemId = 1;
+    }
+    m_itemDataById.insert(data->id, data);
+}
+
+void KFileItemModel::deleteItemData(ItemData* data)
+{
+    m_itemDataById.remove(data->id);
+    m_roleStore.releaseSlot(data->slot);
+    m_itemDataPool.destroy(data);
+}
+
+void KFileItemModel::updateRoleStore(const ItemData* data)
+{
+    const KFileItem& item = data->item;
+    const int slot = data->slot;
+    const KIO::UDSEntry entry = item.entry();
+
+    m_roleStore.setInt64(slot, KFileItemModelRoleStore::ModificationTimeColumn,
+                         entry.numberValue(KIO::UDSEntry::UDS_MODIFICATION_TIME, -1));
+    m_roleStore.setInt64(slot, KFileItemModelRoleStore::CreationTimeColumn,
+                         entry.numberValue(KIO::UDSEntry::UDS_CREATION_TIME, -1));
+    m_roleStore.setInt64(slot, KFileItemModelRoleStore::AccessTimeColumn,
+                         entry.numberValue(KIO::UDSEntry::UDS_ACCESS_TIME, -1));
+    m_roleStore.setInt64(slot, KFileItemModelRoleStore::SizeColumn,
+                         item.isDir() ? -1 : static_cast<qint64>(item.size()));
+
+    // The deletion time is provided as string by the trash KIO worker. It is
+    // parsed only once, so that sorting and grouping the items of a huge
+    // trash by the deletion time does not require to retrieve all role values.
+    qint64 deletionTime = -1;
+    if (item.url().scheme() == QLatin1String("trash")) {
+        const QDateTime dateTime = QDateTime::fromString(entry.stringValue(KIO::UDSEntry::UDS_EXTRA + 1), Qt::ISODate);
+        if (dateTime.isValid()) {
+            deletionTime = dateTime.toMSecsSinceEpoch();
+        }
+    }
+    m_roleStore.setInt64(slot, KFileItemModelRoleStore::DeletionTimeColumn, deletionTime);
+
+    // Determining the string values might be expensive, so they are only
+    // stored if they are actually needed.
+    if (m_requestRole[PermissionsRole]) {
+        m_roleStore.setString(slot, KFileItemModelRoleStore::PermissionsColumn, item.permissionsString());
+    }
+    if (m_requestRole[OwnerRole]) {
+        m_roleStore.setString(slot, KFileItemModelRoleStore::OwnerColumn, item.user());
+    }
+    if (m_requestRole[GroupRole]) {
+        m_roleStore.setString(slot, KFileItemModelRoleStore::GroupColumn, item.group());
+    }
+}
+
 void KFileItemModel::prepareItemsForSorting(QList<ItemData*>& itemDataList)
 {
     switch (m_sortRole) {
@@ -1357,16 +4248,31 @@ void KFileItemModel::prepareItemsForSorting(QList<ItemData*>& itemDataList)
     case OwnerRole:
     case GroupRole:
     case DestinationRole:
-    case PathRole:
-    case DeletionTimeRole:
+    case PathRole: {
         // These roles can be determined with retrieveData, and they have to be stored
         // in the QHash "values" for the sorting.
+        QVector<ItemData*> items;
         for (ItemData* itemData : qAsConst(itemDataList)) {
             if (itemData->values.isEmpty()) {
-                itemData->values = retrieveData(itemData->item, itemData->parent);
+                items.append(itemData);
             }
         }
+
+        // Each item is only accessed by one thread.
+        const auto retrieveItemsData = [this, &items](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                ItemData* itemData = items.at(i);
+                itemData->values = retrieveData(itemData->item, itemData->parent);
+            }
+        };
+
+        // The shared values are only locked while the items are retrieved by several threads
+        const int itemCount = items.count();
+        m_retrievingDataInParallel = (itemCount >= ParallelRetrieveDataItemsLimit);
+        parallelFor(itemCount, ParallelRetrieveDataItemsLimit, retrieveItemsData);
+        m_retrievingDataInParallel = false;
         break;
+    }
 
     case TypeRole:
         // At least store the data including the file type for items with known MIME type.
@@ -1390,23 +4296,84 @@ void KFileItemModel::prepareItemsForSorting(QList<ItemData*>& itemDataList)
     }
 }
 
-int KFileItemModel::expandedParentsCount(const ItemData* data)
+bool KFileItemModel::exceedsSortingMemoryLimit(int itemCount, int costPerItem) const
 {
-    // The hash 'values' is only guaranteed to contain the key "expandedParentsCount"
-    // if the corresponding item is expanded, and it is not a top-level item.
-    const ItemData* parent = data->parent;
-    if (parent) {
-        if (parent->parent) {
-            Q_ASSERT(parent->values.contains("expandedParentsCount"));
-            return parent->values.value("expandedParentsCount").toInt() + 1;
-        } else {
-            return 1;
-        }
+    return m_sortingMemoryLimit > 0 && static_cast<qint64>(itemCount) * costPerItem > m_sortingMemoryLimit;
+}
+
+bool KFileItemModel::updateSortKeysAllowed(int itemCount)
+{
+    const bool allowed = !exceedsSortingMemoryLimit(itemCount, SortKeyCost);
+    if (m_sortKeysAllowed == allowed) {
+        return false;
+    }
+
+    m_sortKeysAllowed = allowed;
+    return true;
+}
+
+void KFileItemModel::updateSortKey(ItemData* data) const
+{
+    // Without collation keys lessThan() compares the names by the collator,
+    // which results in the same order.
+    if (m_naturalSorting && m_sortKeysAllowed) {
+        // QCollator is not reentrant, see stringCompare().
+        QMutexLocker collatorLock(s_collatorMutex());
+        data->sortKey = m_collator.sortKey(data->item.text());
     } else {
-        return 0;
+        data->sortKey.reset();
+    }
+}
+
+bool KFileItemModel::updateCollatorLocale()
+{
+    const QLocale locale;
+    if (m_collator.locale() == locale) {
+        return false;
+    }
+
+    m_collator.setLocale(locale);
+    m_nameGroupValues.clear();
+    // Workaround for bug https://bugreports.qt.io/browse/QTBUG-69361, see loadSortingSettings()
+    m_collator.compare(QString(), QString());
+    updateSortKeys();
+    return true;
+}
+
+void KFileItemModel::updateSortKeys()
+{
+    for (ItemData* itemData : qAsConst(m_itemData)) {
+        updateSortKey(itemData);
+    }
+    for (ItemData* itemData : qAsConst(m_filteredItems)) {
+        updateSortKey(itemData);
+    }
+    for (ItemData* itemData : qAsConst(m_keptItems)) {
+        updateSortKey(itemData);
+    }
+    for (ItemData* itemData : qAsConst(m_pendingItemsToInsert)) {
+        updateSortKey(itemData);
     }
 }
 
+int KFileItemModel::expandedParentsCount(const ItemData* data)
+{
+    return data->depth;
+}
+
+int KFileItemModel::subtreeEnd(int index) const
+{
+    // Only the depths of the children are compared, so finding the end is
+    // not more expensive than removing the children from the model.
+    const int parentDepth = m_itemData.at(index)->depth;
+    const int itemCount = m_itemData.count();
+    int end = index + 1;
+    while (end < itemCount && m_itemData.at(end)->depth > parentDepth) {
+        ++end;
+    }
+    return end;
+}
+
 void KFileItemModel::removeExpandedItems()
 {
     QVector<int> indexesToRemove;
@@ -1423,17 +4390,9 @@ void KFileItemModel::removeExpandedItems()
     m_expandedDirs.clear();
 
     // Also remove all filtered items which have a parent.
-    QHash<KFileItem, ItemData*>::iterator it = m_filteredItems.begin();
-    const QHash<KFileItem, ItemData*>::iterator end = m_filteredItems.end();
-
-    while (it != end) {
-        if (it.value()->parent) {
-            delete it.value();
-            it = m_filteredItems.erase(it);
-        } else {
-            ++it;
-        }
-    }
+    removeFilteredItems([](const ItemData* itemData) {
+        return itemData->parent;
+    });
 }
 
 void KFileItemModel::emitItemsChangedAndTriggerResorting(const KItemRangeList& itemRanges, const QSet<QByteArray>& changedRoles)
@@ -1469,7 +4428,7 @@ void KFileItemModel::emitItemsChangedAndTriggerResorting(const KItemRangeList& i
             }
 
             if (needsResorting) {
-                m_resortAllItemsTimer->start();
+                startRepositionTimer(itemRanges);
                 return;
             }
         }
@@ -1483,8 +4442,8 @@ void KFileItemModel::emitItemsChangedAndTriggerResorting(const KItemRangeList& i
         // first or last one in its group and then update the groups
         // (possibly with a delayed timer to make sure that we don't
         // re-calculate the groups very often if items are updated one by
-        // one), but starting m_resortAllItemsTimer is easier.
-        m_resortAllItemsTimer->start();
+        // one), but repositioning the items updates the groups too.
+        startRepositionTimer(itemRanges);
     }
 }
 
@@ -1497,56 +4456,55 @@ void KFileItemModel::resetRoles()
 
 KFileItemModel::RoleType KFileItemModel::typeForRole(const QByteArray& role) const
 {
-    static QHash<QByteArray, RoleType> roles;
-    if (roles.isEmpty()) {
-        // Insert user visible roles that can be accessed with
-        // KFileItemModel::roleInformation()
-        int count = 0;
-        const RoleInfoMap* map = rolesInfoMap(count);
-        for (int i = 0; i < count; ++i) {
-            roles.insert(map[i].role, map[i].roleType);
+    // The table is built only once, thread-safely, and is only read afterwards,
+    // so the role types may be determined by worker threads without locking.
+    static const QHash<QByteArray, RoleType> roles = [] {
+        QHash<QByteArray, RoleType> roles;
+        for (int i = NoRole + 1; i < RolesCount; ++i) {
+            const RoleType type = static_cast<RoleType>(i);
+            roles.insert(roleNames().at(type), type);
         }
-
-        // Insert internal roles (take care to synchronize the implementation
-        // with KFileItemModel::roleForType() in case if a change is done).
-        roles.insert("isDir", IsDirRole);
-        roles.insert("isLink", IsLinkRole);
-        roles.insert("isHidden", IsHiddenRole);
-        roles.insert("isExpanded", IsExpandedRole);
-        roles.insert("isExpandable", IsExpandableRole);
-        roles.insert("expandedParentsCount", ExpandedParentsCountRole);
-
-        Q_ASSERT(roles.count() == RolesCount);
-    }
+        return roles;
+    }();
 
     return roles.value(role, NoRole);
 }
 
-QByteArray KFileItemModel::roleForType(RoleType roleType) const
+const QByteArray& KFileItemModel::roleForType(RoleType roleType) const
+{
+    return roleNames().at(roleType);
+}
+
+const QVector<QByteArray>& KFileItemModel::roleNames()
 {
-    static QHash<RoleType, QByteArray> roles;
-    if (roles.isEmpty()) {
+    static const QVector<QByteArray> names = [] {
+        QVector<QByteArray> names(RolesCount);
+
         // Insert user visible roles that can be accessed with
         // KFileItemModel::roleInformation()
         int count = 0;
         const RoleInfoMap* map = rolesInfoMap(count);
         for (int i = 0; i < count; ++i) {
-            roles.insert(map[i].roleType, map[i].role);
+            if (map[i].role) {
+                names[map[i].roleType] = KItemRoleRegistry::intern(map[i].role);
+            }
         }
 
-        // Insert internal roles (take care to synchronize the implementation
-        // with KFileItemModel::typeForRole() in case if a change is done).
-        roles.insert(IsDirRole, "isDir");
-        roles.insert(IsLinkRole, "isLink");
-        roles.insert(IsHiddenRole, "isHidden");
-        roles.insert(IsExpandedRole, "isExpanded");
-        roles.insert(IsExpandableRole, "isExpandable");
-        roles.insert(ExpandedParentsCountRole, "expandedParentsCount");
-
-        Q_ASSERT(roles.count() == RolesCount);
-    };
-
-    return roles.value(roleType);
+        // Insert internal roles
+        names[IsDirRole] = KItemRoleRegistry::intern("isDir");
+        names[IsLinkRole] = KItemRoleRegistry::intern("isLink");
+        names[IsHiddenRole] = KItemRoleRegistry::intern("isHidden");
+        names[IsExpandedRole] = KItemRoleRegistry::intern("isExpanded");
+        names[IsExpandableRole] = KItemRoleRegistry::intern("isExpandable");
+        names[ExpandedParentsCountRole] = KItemRoleRegistry::intern("expandedParentsCount");
+
+        Q_ASSERT(std::none_of(names.begin() + NoRole + 1, names.end(), [](const QByteArray& name) {
+            return name.isEmpty();
+        }));
+        return names;
+    }();
+
+    return names;
 }
 
 QHash<QByteArray, QVariant> KFileItemModel::retrieveData(const KFileItem& item, const ItemData* parent) const
@@ -1554,28 +4512,32 @@ QHash<QByteArray, QVariant> KFileItemModel::retrieveData(const KFileItem& item,
     // It is important to insert only roles that are fast to retrieve. E.g.
     // KFileItem::iconName() can be very expensive if the MIME-type is unknown
     // and hence will be retrieved asynchronously by KFileItemModelRolesUpdater.
+    static const QByteArray urlRole = KItemRoleRegistry::intern("url");
+    static const QByteArray iconNameRole = KItemRoleRegistry::intern("iconName");
+    const QVector<QByteArray>& roles = roleNames();
+
     QHash<QByteArray, QVariant> data;
-    data.insert(sharedValue("url"), item.url());
+    data.insert(urlRole, item.url());
 
     const bool isDir = item.isDir();
     if (m_requestRole[IsDirRole] && isDir) {
-        data.insert(sharedValue("isDir"), true);
+        data.insert(roles[IsDirRole], true);
     }
 
     if (m_requestRole[IsLinkRole] && item.isLink()) {
-        data.insert(sharedValue("isLink"), true);
+        data.insert(roles[IsLinkRole], true);
     }
 
     if (m_requestRole[IsHiddenRole]) {
-        data.insert(sharedValue("isHidden"), item.isHidden());
+        data.insert(roles[IsHiddenRole], item.isHidden());
     }
 
     if (m_requestRole[NameRole]) {
-        data.insert(sharedValue("text"), item.text());
+        data.insert(roles[NameRole], item.text());
     }
 
     if (m_requestRole[SizeRole] && !isDir) {
-        data.insert(sharedValue("size"), item.size());
+        data.insert(roles[SizeRole], item.size());
     }
 
     if (m_requestRole[ModificationTimeRole]) {
@@ -1583,7 +4545,7 @@ QHash<QByteArray, QVariant> KFileItemModel::retrieveData(const KFileItem& item,
         // having several thousands of items. Instead read the raw number from UDSEntry directly
         // and the formatting of the date-time will be done on-demand by the view when the date will be shown.
         const long long dateTime = item.entry().numberValue(KIO::UDSEntry::UDS_MODIFICATION_TIME, -1);
-        data.insert(sharedValue("modificationtime"), dateTime);
+        data.insert(roles[ModificationTimeRole], dateTime);
     }
 
     if (m_requestRole[CreationTimeRole]) {
@@ -1591,7 +4553,7 @@ QHash<QByteArray, QVariant> KFileItemModel::retrieveData(const KFileItem& item,
         // having several thousands of items. Instead read the raw number from UDSEntry directly
         // and the formatting of the date-time will be done on-demand by the view when the date will be shown.
         const long long dateTime = item.entry().numberValue(KIO::UDSEntry::UDS_CREATION_TIME, -1);
-        data.insert(sharedValue("creationtime"), dateTime);
+        data.insert(roles[CreationTimeRole], dateTime);
     }
 
     if (m_requestRole[AccessTimeRole]) {
@@ -1599,19 +4561,19 @@ QHash<QByteArray, QVariant> KFileItemModel::retrieveData(const KFileItem& item,
         // having several thousands of items. Instead read the raw number from UDSEntry directly
         // and the formatting of the date-time will be done on-demand by the view when the date will be shown.
         const long long dateTime = item.entry().numberValue(KIO::UDSEntry::UDS_ACCESS_TIME, -1);
-        data.insert(sharedValue("accesstime"), dateTime);
+        data.insert(roles[AccessTimeRole], dateTime);
     }
 
     if (m_requestRole[PermissionsRole]) {
-        data.insert(sharedValue("permissions"), item.permissionsString());
+        data.insert(roles[PermissionsRole], sharedString(item.permissionsString()));
     }
 
     if (m_requestRole[OwnerRole]) {
-        data.insert(sharedValue("owner"), item.user());
+        data.insert(roles[OwnerRole], userName(item));
     }
 
     if (m_requestRole[GroupRole]) {
-        data.insert(sharedValue("group"), item.group());
+        data.insert(roles[GroupRole], groupName(item));
     }
 
     if (m_requestRole[DestinationRole]) {
@@ -1619,7 +4581,7 @@ QHash<QByteArray, QVariant> KFileItemModel::retrieveData(const KFileItem& item,
         if (destination.isEmpty()) {
             destination = QLatin1Char('-');
         }
-        data.insert(sharedValue("destination"), destination);
+        data.insert(roles[DestinationRole], destination);
     }
 
     if (m_requestRole[PathRole]) {
@@ -1629,10 +4591,7 @@ QHash<QByteArray, QVariant> KFileItemModel::retrieveData(const KFileItem& item,
         } else {
             // For performance reasons cache the home-path in a static QString
             // (see QDir::homePath() for more details)
-            static QString homePath;
-            if (homePath.isEmpty()) {
-                homePath = QDir::homePath();
-            }
+            static const QString homePath = QDir::homePath();
 
             path = item.localPath();
             if (path.startsWith(homePath)) {
@@ -1642,7 +4601,7 @@ QHash<QByteArray, QVariant> KFileItemModel::retrieveData(const KFileItem& item,
 
         const int index = path.lastIndexOf(item.text());
         path = path.mid(0, index - 1);
-        data.insert(sharedValue("path"), path);
+        data.insert(roles[PathRole], path);
     }
 
     if (m_requestRole[DeletionTimeRole]) {
@@ -1650,41 +4609,46 @@ QHash<QByteArray, QVariant> KFileItemModel::retrieveData(const KFileItem& item,
         if (item.url().scheme() == QLatin1String("trash")) {
             deletionTime = QDateTime::fromString(item.entry().stringValue(KIO::UDSEntry::UDS_EXTRA + 1), Qt::ISODate);
         }
-        data.insert(sharedValue("deletiontime"), deletionTime);
+        data.insert(roles[DeletionTimeRole], deletionTime);
     }
 
-    if (m_requestRole[IsExpandableRole] && isDir) {
-        data.insert(sharedValue("isExpandable"), true);
+    if (m_requestRole[IsExpandableRole] && isDir && !m_recursiveListing) {
+        data.insert(roles[IsExpandableRole], true);
     }
 
     if (m_requestRole[ExpandedParentsCountRole]) {
         if (parent) {
             const int level = expandedParentsCount(parent) + 1;
-            data.insert(sharedValue("expandedParentsCount"), level);
+            data.insert(roles[ExpandedParentsCountRole], level);
         }
     }
 
     if (item.isMimeTypeKnown()) {
         QString iconName = item.iconName();
-        if (!QIcon::hasThemeIcon(iconName)) {
+        if (!hasThemeIcon(iconName)) {
             QMimeType mimeType = QMimeDatabase().mimeTypeForName(item.mimetype());
             iconName = mimeType.genericIconName();
         }
 
-        data.insert(sharedValue("iconName"), iconName);
+        data.insert(iconNameRole, sharedString(iconName));
 
         if (m_requestRole[TypeRole]) {
-            data.insert(sharedValue("type"), item.mimeComment());
+            data.insert(roles[TypeRole], sharedString(item.mimeComment()));
         }
     } else if (m_requestRole[TypeRole] && isDir) {
         static const QString folderMimeType = item.mimeComment();
-        data.insert(sharedValue("type"), folderMimeType);
+        data.insert(roles[TypeRole], folderMimeType);
     }
 
     return data;
 }
 
 bool KFileItemModel::lessThan(const ItemData* a, const ItemData* b, const QCollator& collator) const
+{
+    return lessThan(a, b, collator, sortOrder());
+}
+
+bool KFileItemModel::lessThan(const ItemData* a, const ItemData* b, const QCollator& collator, Qt::SortOrder order) const
 {
     int result = 0;
 
@@ -1729,50 +4693,129 @@ bool KFileItemModel::lessThan(const ItemData* a, const ItemData* b, const QColla
         }
     }
 
-    result = sortRoleCompare(a, b, collator);
+    return sortRoleLessThan(a, b, collator, order);
+}
+
+bool KFileItemModel::sortRoleLessThan(const ItemData* a, const ItemData* b, const QCollator& collator, Qt::SortOrder order) const
+{
+    const int result = sortRoleCompare(a, b, collator);
+    return (order == Qt::AscendingOrder) ? result < 0 : result > 0;
+}
 
-    return (sortOrder() == Qt::AscendingOrder) ? result < 0 : result > 0;
+void KFileItemModel::sort(const QList<KFileItemModel::ItemData*>::iterator &begin,
+                          const QList<KFileItemModel::ItemData*>::iterator &end,
+                          const QAtomicInt* canceled) const
+{
+    sort(begin, end, canceled, m_collator, sortOrder());
 }
 
 void KFileItemModel::sort(const QList<KFileItemModel::ItemData*>::iterator &begin,
-                          const QList<KFileItemModel::ItemData*>::iterator &end) const
+                          const QList<KFileItemModel::ItemData*>::iterator &end,
+                          const QAtomicInt* canceled, const QCollator& collator, Qt::SortOrder order) const
 {
+    // The user is waiting for the sorted items, so prefetching
+    // and background tasks don't compete for the cores
+    const KTaskScheduler::InteractiveScope interactiveScope;
+
+    // Items in expanded folders must be sorted below their parents,
+    // which is only possible by comparing pairs of items.
+    const ItemData* parent = (end - begin > 0) ? (*begin)->parent : nullptr;
+    const bool haveSameParent = std::all_of(begin, end, [parent](const ItemData* item) {
+        return item->parent == parent;
+    });
+
+    // Sorting in place by one thread needs no buffers
+    const bool sortInPlace = exceedsSortingMemoryLimit(end - begin, SortBufferCost);
+
+    // If the directories are sorted first, the directories and the files are
+    // sorted as separate segments, which spares comparing their types.
+    const bool sortSegments = haveSameParent && m_sortDirsFirst && !sortInPlace;
+
     auto lambdaLessThan = [&] (const KFileItemModel::ItemData* a, const KFileItemModel::ItemData* b)
     {
-        return lessThan(a, b, m_collator);
+        if (canceled && canceled->loadRelaxed()) {
+            // The result will be discarded anyway.
+            return false;
+        }
+        return sortSegments ? sortRoleLessThan(a, b, collator, order) : lessThan(a, b, collator, order);
     };
 
-    if (m_sortRole == NameRole || isRoleValueNatural(m_sortRole)) {
-        // Sorting by string can be expensive, in particular if natural sorting is
-        // enabled. Use all CPU cores to speed up the sorting process.
-        static const int numberOfThreads = QThread::idealThreadCount();
-        parallelMergeSort(begin, end, lambdaLessThan, numberOfThreads);
+    const auto isDir = [](const ItemData* item) {
+        return item->item.isDir();
+    };
+
+    QList<ItemData*>::iterator filesBegin = begin;
+    if (sortSegments) {
+        filesBegin = std::stable_partition(begin, end, isDir);
+    }
+
+    if (isRoleValueInteger(m_sortRole) && end - begin > 1 && !sortInPlace) {
+        // The size of folders is compared by values that depend on the
+        // settings, see sortRoleCompare(). Folders can only be
+        // sorted separately if they are shown first.
+        if (haveSameParent && (m_sortDirsFirst || m_sortRole != SizeRole || std::none_of(begin, end, isDir))) {
+            const auto integerValue = [this, order](const ItemData* item) {
+                const qint64 value = integerSortRoleValue(item);
+                // ~value reverses the order without overflowing.
+                return (order == Qt::AscendingOrder) ? value : ~value;
+            };
+
+            if (sortSegments) {
+                if (m_sortRole == SizeRole) {
+                    mergeSort(begin, filesBegin, lambdaLessThan);
+                } else {
+                    radixSort(begin, filesBegin, integerValue, lambdaLessThan);
+                }
+            }
+            radixSort(filesBegin, end, integerValue, lambdaLessThan);
+            return;
+        }
+    }
+
+    const auto sortRange = [&](const QList<ItemData*>::iterator& rangeBegin, const QList<ItemData*>::iterator& rangeEnd) {
+        if (isRoleComparisonReentrant(m_sortRole) && !sortInPlace) {
+            // Sorting by string can be expensive, in particular if natural sorting is
+            // enabled. Use all CPU cores to speed up the sorting process.
+            static const int numberOfThreads = QThread::idealThreadCount();
+            parallelMergeSort(rangeBegin, rangeEnd, lambdaLessThan, numberOfThreads);
+        } else {
+            // Use only one thread to prevent problems caused by non-reentrant
+            // comparison functions, see https://bugs.kde.org/show_bug.cgi?id=312679
+            mergeSort(rangeBegin, rangeEnd, lambdaLessThan);
+        }
+    };
+
+    if (sortSegments) {
+        sortRange(begin, filesBegin);
+        sortRange(filesBegin, end);
     } else {
-        // Sorting by other roles is quite fast. Use only one thread to prevent
-        // problems caused by non-reentrant comparison functions, see
-        // https://bugs.kde.org/show_bug.cgi?id=312679
-        mergeSort(begin, end, lambdaLessThan);
+        sortRange(begin, end);
     }
 }
 
 int KFileItemModel::sortRoleCompare(const ItemData* a, const ItemData* b, const QCollator& collator) const
 {
-    const KFileItem& itemA = a->item;
-    const KFileItem& itemB = b->item;
+    return (this->*m_sortRoleComparator)(a, b, collator);
+}
 
+template<KFileItemModel::RoleType roleType>
+int KFileItemModel::compareRoleValues(const ItemData* a, const ItemData* b, const QCollator& collator) const
+{
+    constexpr RoleValueKind kind = roleValueKind(roleType);
     int result = 0;
 
-    switch (m_sortRole) {
-    case NameRole:
-        // The name role is handled as default fallback after the switch
-        break;
-
-    case SizeRole: {
+    if constexpr (kind == RoleValueKind::Size) {
+        // The roles are interned once instead of converting
+        // the names for each comparison
+        static const QByteArray countRole = KItemRoleRegistry::intern("count");
+        static const QByteArray sizeRole = KItemRoleRegistry::intern("size");
+        const KFileItem& itemA = a->item;
+        const KFileItem& itemB = b->item;
         if (DetailsModeSettings::directorySizeCount() && (itemA.isDir() || itemB.isDir())) {
             // folders first then
             if (itemA.isDir() && itemB.isDir()) {
-                auto valueA = a->values.value("count");
-                auto valueB = b->values.value("count");
+                auto valueA = a->values.value(countRole);
+                auto valueB = b->values.value(countRole);
                 if (valueA.isNull()) {
                     if (valueB.isNull()) {
                         return 0;
@@ -1796,86 +4839,59 @@ int KFileItemModel::sortRoleCompare(const ItemData* a, const ItemData* b, const
         }
         KIO::filesize_t sizeA = 0;
         if (itemA.isDir()) {
-            sizeA = a->values.value("size").toULongLong();
+            sizeA = a->values.value(sizeRole).toULongLong();
         } else {
-            sizeA = itemA.size();
+            sizeA = int64RoleValue(a, KFileItemModelRoleStore::SizeColumn);
         }
         KIO::filesize_t sizeB = 0;
         if (itemB.isDir()) {
-            sizeB = b->values.value("size").toULongLong();
+            sizeB = b->values.value(sizeRole).toULongLong();
         } else {
-            sizeB = itemB.size();
+            sizeB = int64RoleValue(b, KFileItemModelRoleStore::SizeColumn);
         }
         if (sizeA > sizeB) {
             result = +1;
         } else if (sizeA < sizeB) {
             result = -1;
         } else {
-            result = 0;
-        }
-        break;
-    }
-
-    case ModificationTimeRole: {
-        const long long dateTimeA = itemA.entry().numberValue(KIO::UDSEntry::UDS_MODIFICATION_TIME, -1);
-        const long long dateTimeB = itemB.entry().numberValue(KIO::UDSEntry::UDS_MODIFICATION_TIME, -1);
-        if (dateTimeA < dateTimeB) {
-            result = -1;
-        } else if (dateTimeA > dateTimeB) {
-            result = +1;
+            result = 0;
         }
-        break;
-    }
-
-    case CreationTimeRole: {
-        const long long dateTimeA = itemA.entry().numberValue(KIO::UDSEntry::UDS_CREATION_TIME, -1);
-        const long long dateTimeB = itemB.entry().numberValue(KIO::UDSEntry::UDS_CREATION_TIME, -1);
-        if (dateTimeA < dateTimeB) {
+    } else if constexpr (kind == RoleValueKind::Int64Column) {
+        const qint64 valueA = int64RoleValue(a, int64Column(roleType));
+        const qint64 valueB = int64RoleValue(b, int64Column(roleType));
+        if (valueA < valueB) {
             result = -1;
-        } else if (dateTimeA > dateTimeB) {
+        } else if (valueA > valueB) {
             result = +1;
         }
-        break;
-    }
-
-    case DeletionTimeRole: {
-        const QDateTime dateTimeA = a->values.value("deletiontime").toDateTime();
-        const QDateTime dateTimeB = b->values.value("deletiontime").toDateTime();
-        if (dateTimeA < dateTimeB) {
+    } else if constexpr (kind == RoleValueKind::StringColumn) {
+        const QString& roleValueA = stringRoleValue(a, stringColumn(roleType));
+        const QString& roleValueB = stringRoleValue(b, stringColumn(roleType));
+        if (!roleValueA.isEmpty() && roleValueB.isEmpty()) {
             result = -1;
-        } else if (dateTimeA > dateTimeB) {
+        } else if (roleValueA.isEmpty() && !roleValueB.isEmpty()) {
             result = +1;
+        } else if constexpr (isRoleValueNatural(roleType)) {
+            result = stringCompare(roleValueA, roleValueB, collator);
+        } else {
+            result = QString::compare(roleValueA, roleValueB);
         }
-        break;
-    }
-
-    case RatingRole:
-    case WidthRole:
-    case HeightRole:
-    case WordCountRole:
-    case LineCountRole:
-    case TrackRole:
-    case ReleaseYearRole: {
-        result = a->values.value(roleForType(m_sortRole)).toInt() - b->values.value(roleForType(m_sortRole)).toInt();
-        break;
-    }
-
-    default: {
-        const QByteArray role = roleForType(m_sortRole);
+    } else if constexpr (kind == RoleValueKind::Integer) {
+        const QByteArray& role = roleNames().at(roleType);
+        result = a->values.value(role).toInt() - b->values.value(role).toInt();
+    } else if constexpr (kind == RoleValueKind::String) {
+        const QByteArray& role = roleNames().at(roleType);
         const QString roleValueA = a->values.value(role).toString();
         const QString roleValueB = b->values.value(role).toString();
         if (!roleValueA.isEmpty() && roleValueB.isEmpty()) {
             result = -1;
         } else if (roleValueA.isEmpty() && !roleValueB.isEmpty()) {
             result = +1;
-        } else if (isRoleValueNatural(m_sortRole)) {
+        } else if constexpr (isRoleValueNatural(roleType)) {
             result = stringCompare(roleValueA, roleValueB, collator);
         } else {
             result = QString::compare(roleValueA, roleValueB);
         }
-        break;
-    }
-
     }
 
     if (result != 0) {
@@ -1883,8 +4899,23 @@ int KFileItemModel::sortRoleCompare(const ItemData* a, const ItemData* b, const
         return result;
     }
 
-    // Fallback #1: Compare the text of the items
-    result = stringCompare(itemA.text(), itemB.text(), collator);
+    return compareFallbacks(a, b, collator);
+}
+
+int KFileItemModel::compareFallbacks(const ItemData* a, const ItemData* b, const QCollator& collator) const
+{
+    const KFileItem& itemA = a->item;
+    const KFileItem& itemB = b->item;
+    int result = 0;
+
+    // Fallback #1: Compare the text of the items. If natural sorting is enabled,
+    // the precalculated collation keys are used, which is much cheaper than
+    // QCollator::compare().
+    if (a->sortKey && b->sortKey) {
+        result = a->sortKey->compare(*b->sortKey);
+    } else {
+        result = stringCompare(itemA.text(), itemB.text(), collator);
+    }
     if (result != 0) {
         return result;
     }
@@ -1901,11 +4932,50 @@ int KFileItemModel::sortRoleCompare(const ItemData* a, const ItemData* b, const
     return QString::compare(itemA.url().url(), itemB.url().url(), Qt::CaseSensitive);
 }
 
-int KFileItemModel::stringCompare(const QString& a, const QString& b, const QCollator& collator) const
+template<std::size_t... roleTypes>
+constexpr std::array<KFileItemModel::RoleValueComparator, KFileItemModel::RolesCount> KFileItemModel::roleValueComparators(std::index_sequence<roleTypes...>)
+{
+    return {{&KFileItemModel::compareRoleValues<static_cast<RoleType>(roleTypes)>...}};
+}
+
+KFileItemModel::RoleValueComparator KFileItemModel::roleValueComparator(RoleType roleType)
 {
-    QMutexLocker collatorLock(s_collatorMutex());
+    // The role is only checked once when the sort role is changed,
+    // and not for each of the O(n log n) comparisons while sorting
+    static constexpr std::array<RoleValueComparator, RolesCount> comparators =
+        roleValueComparators(std::make_index_sequence<RolesCount>());
+    return comparators[roleType];
+}
+
+qint64 KFileItemModel::integerSortRoleValue(const ItemData* item) const
+{
+    switch (m_sortRole) {
+    case SizeRole:
+        Q_ASSERT(!item->item.isDir());
+        return int64RoleValue(item, KFileItemModelRoleStore::SizeColumn);
+    case ModificationTimeRole:
+        return int64RoleValue(item, KFileItemModelRoleStore::ModificationTimeColumn);
+    case CreationTimeRole:
+        return int64RoleValue(item, KFileItemModelRoleStore::CreationTimeColumn);
+    case AccessTimeRole:
+        return int64RoleValue(item, KFileItemModelRoleStore::AccessTimeColumn);
+    case DeletionTimeRole: {
+        // Invalid date times are ordered before all valid ones.
+        const qint64 dateTime = int64RoleValue(item, KFileItemModelRoleStore::DeletionTimeColumn);
+        return dateTime >= 0 ? dateTime : std::numeric_limits<qint64>::min();
+    }
+    default:
+        Q_ASSERT(false);
+        return 0;
+    }
+}
 
+int KFileItemModel::stringCompare(const QString& a, const QString& b, const QCollator& collator) const
+{
     if (m_naturalSorting) {
+        // Only QCollator::compare() is not reentrant. Reading the case
+        // sensitivity below does not need to be protected.
+        QMutexLocker collatorLock(s_collatorMutex());
         return collator.compare(a, b);
     }
 
@@ -1920,397 +4990,429 @@ int KFileItemModel::stringCompare(const QString& a, const QString& b, const QCol
     return QString::compare(a, b, Qt::CaseSensitive);
 }
 
-QList<QPair<int, QVariant> > KFileItemModel::nameRoleGroups() const
+QVariant KFileItemModel::groupValue(const ItemData* itemData) const
 {
-    Q_ASSERT(!m_itemData.isEmpty());
+    switch (m_sortRole) {
+    case NameRole:             return nameRoleGroupValue(itemData);
+    case SizeRole:             return sizeRoleGroupValue(itemData);
+    case ModificationTimeRole: return timeRoleGroupValue(itemData->item.time(KFileItem::ModificationTime));
+    case CreationTimeRole:     return timeRoleGroupValue(itemData->item.time(KFileItem::CreationTime));
+    case AccessTimeRole:       return timeRoleGroupValue(itemData->item.time(KFileItem::AccessTime));
+    case DeletionTimeRole: {
+        const qint64 deletionTime = int64RoleValue(itemData, KFileItemModelRoleStore::DeletionTimeColumn);
+        return timeRoleGroupValue(deletionTime >= 0 ? QDateTime::fromMSecsSinceEpoch(deletionTime) : QDateTime());
+    }
+    case PermissionsRole:      return permissionRoleGroupValue(itemData);
+    case RatingRole:           return ratingRoleGroupValue(itemData);
+    default:                   return genericStringRoleGroupValue(itemData, sortRole());
+    }
+}
+
+void KFileItemModel::updateGroupsForInsertedItems(const KItemRangeList& itemRanges)
+{
+    if (m_groups.isEmpty()) {
+        // The groups are calculated on demand by groups().
+        return;
+    }
 
-    const int maxIndex = count() - 1;
+    // The groups behind the inserted items are only moved. Only the inserted
+    // items and the item behind each range can start a new group or end
+    // an existing one.
     QList<QPair<int, QVariant> > groups;
+    groups.reserve(m_groups.count());
 
-    QString groupValue;
-    QChar firstChar;
-    for (int i = 0; i <= maxIndex; ++i) {
-        if (isChildItem(i)) {
-            continue;
+    const int oldGroupCount = m_groups.count();
+    int oldGroupIndex = 0;
+    int insertedItemsCount = 0;
+    for (const KItemRange& range : itemRanges) {
+        while (oldGroupIndex < oldGroupCount && m_groups.at(oldGroupIndex).first < range.index) {
+            const QPair<int, QVariant>& group = m_groups.at(oldGroupIndex);
+            groups.append(QPair<int, QVariant>(group.first + insertedItemsCount, group.second));
+            ++oldGroupIndex;
+        }
+        if (oldGroupIndex < oldGroupCount && m_groups.at(oldGroupIndex).first == range.index) {
+            // Is calculated again below.
+            ++oldGroupIndex;
         }
 
-        const QString name = m_itemData.at(i)->item.text();
+        const int firstIndex = range.index + insertedItemsCount;
+        const int lastIndex = qMin(firstIndex + range.count, count() - 1);
+        for (int i = firstIndex; i <= lastIndex; ++i) {
+            if (isChildItem(i)) {
+                continue;
+            }
 
-        // Use the first character of the name as group indication
-        QChar newFirstChar = name.at(0).toUpper();
-        if (newFirstChar == QLatin1Char('~') && name.length() > 1) {
-            newFirstChar = name.at(1).toUpper();
+            const QVariant newGroupValue = groupValue(m_itemData.at(i));
+            if (groups.isEmpty() || newGroupValue != groups.last().second) {
+                groups.append(QPair<int, QVariant>(i, newGroupValue));
+            }
         }
 
-        if (firstChar != newFirstChar) {
-            QString newGroupValue;
-            if (newFirstChar.isLetter()) {
+        insertedItemsCount += range.count;
+    }
 
-                if (m_collator.compare(newFirstChar, QChar(QLatin1Char('A'))) >= 0 && m_collator.compare(newFirstChar, QChar(QLatin1Char('Z'))) <= 0) {
-                    // WARNING! Symbols based on latin 'Z' like 'Z' with acute are treated wrong as non Latin and put in a new group.
+    while (oldGroupIndex < oldGroupCount) {
+        const QPair<int, QVariant>& group = m_groups.at(oldGroupIndex);
+        groups.append(QPair<int, QVariant>(group.first + insertedItemsCount, group.second));
+        ++oldGroupIndex;
+    }
 
-                    // Try to find a matching group in the range 'A' to 'Z'.
-                    static std::vector<QChar> lettersAtoZ;
-                    lettersAtoZ.reserve('Z' - 'A' + 1);
-                    if (lettersAtoZ.empty()) {
-                        for (char c = 'A'; c <= 'Z'; ++c) {
-                            lettersAtoZ.push_back(QLatin1Char(c));
-                        }
-                    }
+    m_groups = groups;
+}
 
-                    auto localeAwareLessThan = [this](QChar c1, QChar c2) -> bool {
-                        return m_collator.compare(c1, c2) < 0;
-                    };
+void KFileItemModel::updateGroupsForRemovedItems(const KItemRangeList& itemRanges)
+{
+    if (m_groups.isEmpty()) {
+        // The groups are calculated on demand by groups().
+        return;
+    }
 
-                    std::vector<QChar>::iterator it = std::lower_bound(lettersAtoZ.begin(), lettersAtoZ.end(), newFirstChar, localeAwareLessThan);
-                    if (it != lettersAtoZ.end()) {
-                        if (localeAwareLessThan(newFirstChar, *it)) {
-                            // newFirstChar belongs to the group preceding *it.
-                            // Example: for an umlaut 'A' in the German locale, *it would be 'B' now.
-                            --it;
-                        }
-                        newGroupValue = *it;
-                    }
+    // The groups that start inside the removed ranges are removed. Only the
+    // item behind each range can start a new group or end an existing one.
+    QList<QPair<int, QVariant> > groups;
+    groups.reserve(m_groups.count());
 
-                } else {
-                    // Symbols from non Latin-based scripts
-                    newGroupValue = newFirstChar;
+    const int oldGroupCount = m_groups.count();
+    int oldGroupIndex = 0;
+    int removedItemsCount = 0;
+    for (const KItemRange& range : itemRanges) {
+        while (oldGroupIndex < oldGroupCount && m_groups.at(oldGroupIndex).first < range.index) {
+            const QPair<int, QVariant>& group = m_groups.at(oldGroupIndex);
+            groups.append(QPair<int, QVariant>(group.first - removedItemsCount, group.second));
+            ++oldGroupIndex;
+        }
+        bool groupsRemoved = false;
+        while (oldGroupIndex < oldGroupCount && m_groups.at(oldGroupIndex).first <= range.index + range.count) {
+            groupsRemoved = true;
+            ++oldGroupIndex;
+        }
+
+        removedItemsCount += range.count;
+
+        const int index = range.index + range.count - removedItemsCount;
+        if (index < count()) {
+            if (isChildItem(index)) {
+                if (groupsRemoved) {
+                    // A group might start at an item behind the child items
+                    // now. Let groups() calculate all groups again.
+                    m_groups.clear();
+                    return;
                 }
-            } else if (newFirstChar >= QLatin1Char('0') && newFirstChar <= QLatin1Char('9')) {
-                // Apply group '0 - 9' for any name that starts with a digit
-                newGroupValue = i18nc("@title:group Groups that start with a digit", "0 - 9");
-            } else {
-                newGroupValue = i18nc("@title:group", "Others");
+                continue;
             }
 
-            if (newGroupValue != groupValue) {
-                groupValue = newGroupValue;
-                groups.append(QPair<int, QVariant>(i, newGroupValue));
+            const QVariant newGroupValue = groupValue(m_itemData.at(index));
+            if (groups.isEmpty() || newGroupValue != groups.last().second) {
+                groups.append(QPair<int, QVariant>(index, newGroupValue));
             }
-
-            firstChar = newFirstChar;
         }
     }
-    return groups;
+
+    while (oldGroupIndex < oldGroupCount) {
+        const QPair<int, QVariant>& group = m_groups.at(oldGroupIndex);
+        groups.append(QPair<int, QVariant>(group.first - removedItemsCount, group.second));
+        ++oldGroupIndex;
+    }
+
+    m_groups = groups;
 }
 
-QList<QPair<int, QVariant> > KFileItemModel::sizeRoleGroups() const
+QString KFileItemModel::nameRoleGroupValue(const ItemData* itemData) const
 {
-    Q_ASSERT(!m_itemData.isEmpty());
+    const QString name = itemData->item.text();
 
-    const int maxIndex = count() - 1;
-    QList<QPair<int, QVariant> > groups;
+    // Use the first character of the name as group indication
+    QChar newFirstChar = name.at(0).toUpper();
+    if (newFirstChar == QLatin1Char('~') && name.length() > 1) {
+        newFirstChar = name.at(1).toUpper();
+    }
 
-    QString groupValue;
-    for (int i = 0; i <= maxIndex; ++i) {
-        if (isChildItem(i)) {
-            continue;
-        }
+    const auto cached = m_nameGroupValues.constFind(newFirstChar);
+    if (cached != m_nameGroupValues.constEnd()) {
+        return cached.value();
+    }
 
-        const KFileItem& item = m_itemData.at(i)->item;
-        const KIO::filesize_t fileSize = !item.isNull() ? item.size() : ~0U;
-        QString newGroupValue;
-        if (!item.isNull() && item.isDir()) {
-            newGroupValue = i18nc("@title:group Size", "Folders");
-        } else if (fileSize < 5 * 1024 * 1024) {
-            newGroupValue = i18nc("@title:group Size", "Small");
-        } else if (fileSize < 10 * 1024 * 1024) {
-            newGroupValue = i18nc("@title:group Size", "Medium");
-        } else {
-            newGroupValue = i18nc("@title:group Size", "Big");
-        }
+    QString newGroupValue;
+    if (newFirstChar.isLetter()) {
+        // QCollator is not reentrant, see stringCompare()
+        QMutexLocker collatorLock(s_collatorMutex());
+
+        if (m_collator.compare(newFirstChar, QChar(QLatin1Char('A'))) >= 0 && m_collator.compare(newFirstChar, QChar(QLatin1Char('Z'))) <= 0) {
+            // WARNING! Symbols based on latin 'Z' like 'Z' with acute are treated wrong as non Latin and put in a new group.
+
+            // Try to find a matching group in the range 'A' to 'Z'.
+            static std::vector<QChar> lettersAtoZ;
+            lettersAtoZ.reserve('Z' - 'A' + 1);
+            if (lettersAtoZ.empty()) {
+                for (char c = 'A'; c <= 'Z'; ++c) {
+                    lettersAtoZ.push_back(QLatin1Char(c));
+                }
+            }
 
-        if (newGroupValue != groupValue) {
-            groupValue = newGroupValue;
-            groups.append(QPair<int, QVariant>(i, newGroupValue));
+            auto localeAwareLessThan = [this](QChar c1, QChar c2) -> bool {
+                return m_collator.compare(c1, c2) < 0;
+            };
+
+            std::vector<QChar>::iterator it = std::lower_bound(lettersAtoZ.begin(), lettersAtoZ.end(), newFirstChar, localeAwareLessThan);
+            if (it != lettersAtoZ.end()) {
+                if (localeAwareLessThan(newFirstChar, *it)) {
+                    // newFirstChar belongs to the group preceding *it.
+                    // Example: for an umlaut 'A' in the German locale, *it would be 'B' now.
+                    --it;
+                }
+                newGroupValue = *it;
+            }
+
+        } else {
+            // Symbols from non Latin-based scripts
+            newGroupValue = newFirstChar;
         }
+    } else if (newFirstChar >= QLatin1Char('0') && newFirstChar <= QLatin1Char('9')) {
+        // Apply group '0 - 9' for any name that starts with a digit
+        newGroupValue = i18nc("@title:group Groups that start with a digit", "0 - 9");
+    } else {
+        newGroupValue = i18nc("@title:group", "Others");
     }
 
-    return groups;
+    m_nameGroupValues.insert(newFirstChar, newGroupValue);
+    return newGroupValue;
 }
 
-QList<QPair<int, QVariant> > KFileItemModel::timeRoleGroups(const std::function<QDateTime(const ItemData *)> &fileTimeCb) const
+QString KFileItemModel::sizeRoleGroupValue(const ItemData* itemData) const
 {
-    Q_ASSERT(!m_itemData.isEmpty());
+    const KFileItem& item = itemData->item;
+    const KIO::filesize_t fileSize = !item.isNull() ? item.size() : ~0U;
+    QString newGroupValue;
+    if (!item.isNull() && item.isDir()) {
+        newGroupValue = i18nc("@title:group Size", "Folders");
+    } else if (fileSize < 5 * 1024 * 1024) {
+        newGroupValue = i18nc("@title:group Size", "Small");
+    } else if (fileSize < 10 * 1024 * 1024) {
+        newGroupValue = i18nc("@title:group Size", "Medium");
+    } else {
+        newGroupValue = i18nc("@title:group Size", "Big");
+    }
 
-    const int maxIndex = count() - 1;
-    QList<QPair<int, QVariant> > groups;
+    return newGroupValue;
+}
 
+QString KFileItemModel::timeRoleGroupValue(const QDateTime& fileTime) const
+{
+    // Formatting the dates is expensive, so the group values are memoized
+    // for each date. They are relative to the current date.
     const QDate currentDate = QDate::currentDate();
+    if (m_timeGroupValuesDate != currentDate) {
+        m_timeGroupValues.clear();
+        m_timeGroupValuesDate = currentDate;
+    }
 
-    QDate previousFileDate;
-    QString groupValue;
-    for (int i = 0; i <= maxIndex; ++i) {
-        if (isChildItem(i)) {
-            continue;
-        }
-
-        const QDateTime fileTime = fileTimeCb(m_itemData.at(i));
-        const QDate fileDate = fileTime.date();
-        if (fileDate == previousFileDate) {
-            // The current item is in the same group as the previous item
-            continue;
-        }
-        previousFileDate = fileDate;
+    const QDate fileDate = fileTime.date();
+    const auto cached = m_timeGroupValues.constFind(fileDate);
+    if (cached != m_timeGroupValues.constEnd()) {
+        return cached.value();
+    }
 
-        const int daysDistance = fileDate.daysTo(currentDate);
+    const int daysDistance = fileDate.daysTo(currentDate);
 
-        QString newGroupValue;
-        if (currentDate.year() == fileDate.year() &&
-            currentDate.month() == fileDate.month()) {
+    QString newGroupValue;
+    if (currentDate.year() == fileDate.year() &&
+        currentDate.month() == fileDate.month()) {
 
-            switch (daysDistance / 7) {
-            case 0:
-                switch (daysDistance) {
-                case 0:  newGroupValue = i18nc("@title:group Date", "Today"); break;
-                case 1:  newGroupValue = i18nc("@title:group Date", "Yesterday"); break;
-                default:
-                    newGroupValue = fileTime.toString(
-                        i18nc("@title:group Date: The week day name: dddd", "dddd"));
-                    newGroupValue = i18nc("Can be used to script translation of \"dddd\""
-                        "with context @title:group Date", "%1", newGroupValue);
-                }
-                break;
-            case 1:
-                newGroupValue = i18nc("@title:group Date", "One Week Ago");
-                break;
-            case 2:
-                newGroupValue = i18nc("@title:group Date", "Two Weeks Ago");
-                break;
-            case 3:
-                newGroupValue = i18nc("@title:group Date", "Three Weeks Ago");
-                break;
-            case 4:
-            case 5:
-                newGroupValue = i18nc("@title:group Date", "Earlier this Month");
-                break;
+        switch (daysDistance / 7) {
+        case 0:
+            switch (daysDistance) {
+            case 0:  newGroupValue = i18nc("@title:group Date", "Today"); break;
+            case 1:  newGroupValue = i18nc("@title:group Date", "Yesterday"); break;
             default:
-                Q_ASSERT(false);
+                newGroupValue = fileTime.toString(
+                    i18nc("@title:group Date: The week day name: dddd", "dddd"));
+                newGroupValue = i18nc("Can be used to script translation of \"dddd\""
+                    "with context @title:group Date", "%1", newGroupValue);
             }
-        } else {
-            const QDate lastMonthDate = currentDate.addMonths(-1);
-            if  (lastMonthDate.year() == fileDate.year() &&
-                 lastMonthDate.month() == fileDate.month()) {
-
-                if (daysDistance == 1) {
-                    const KLocalizedString format = ki18nc("@title:group Date: "
-                                                    "MMMM is full month name in current locale, and yyyy is "
-                                                    "full year number", "'Yesterday' (MMMM, yyyy)");
-                    const QString translatedFormat = format.toString();
-                    if (translatedFormat.count(QLatin1Char('\'')) == 2) {
-                        newGroupValue = fileTime.toString(translatedFormat);
-                        newGroupValue = i18nc("Can be used to script translation of "
-                            "\"'Yesterday' (MMMM, yyyy)\" with context @title:group Date",
-                            "%1", newGroupValue);
-                    } else {
-                        qCWarning(DolphinDebug).nospace() << "A wrong translation was found: " << translatedFormat << ". Please file a bug report at bugs.kde.org";
-                        const QString untranslatedFormat = format.toString({ QLatin1String("en_US") });
-                        newGroupValue = fileTime.toString(untranslatedFormat);
-                    }
-                } else if (daysDistance <= 7) {
-                    newGroupValue = fileTime.toString(i18nc("@title:group Date: "
-                        "The week day name: dddd, MMMM is full month name "
-                        "in current locale, and yyyy is full year number",
-                        "dddd (MMMM, yyyy)"));
+            break;
+        case 1:
+            newGroupValue = i18nc("@title:group Date", "One Week Ago");
+            break;
+        case 2:
+            newGroupValue = i18nc("@title:group Date", "Two Weeks Ago");
+            break;
+        case 3:
+            newGroupValue = i18nc("@title:group Date", "Three Weeks Ago");
+            break;
+        case 4:
+        case 5:
+            newGroupValue = i18nc("@title:group Date", "Earlier this Month");
+            break;
+        default:
+            Q_ASSERT(false);
+        }
+    } else {
+        const QDate lastMonthDate = currentDate.addMonths(-1);
+        if  (lastMonthDate.year() == fileDate.year() &&
+             lastMonthDate.month() == fileDate.month()) {
+
+            if (daysDistance == 1) {
+                const KLocalizedString format = ki18nc("@title:group Date: "
+                                                "MMMM is full month name in current locale, and yyyy is "
+                                                "full year number", "'Yesterday' (MMMM, yyyy)");
+                const QString translatedFormat = format.toString();
+                if (translatedFormat.count(QLatin1Char('\'')) == 2) {
+                    newGroupValue = fileTime.toString(translatedFormat);
                     newGroupValue = i18nc("Can be used to script translation of "
-                        "\"dddd (MMMM, yyyy)\" with context @title:group Date",
+                        "\"'Yesterday' (MMMM, yyyy)\" with context @title:group Date",
                         "%1", newGroupValue);
-                } else if (daysDistance <= 7 * 2) {
-                    const KLocalizedString format = ki18nc("@title:group Date: "
-                                                           "MMMM is full month name in current locale, and yyyy is "
-                                                           "full year number", "'One Week Ago' (MMMM, yyyy)");
-                    const QString translatedFormat = format.toString();
-                    if (translatedFormat.count(QLatin1Char('\'')) == 2) {
-                        newGroupValue = fileTime.toString(translatedFormat);
-                        newGroupValue = i18nc("Can be used to script translation of "
-                            "\"'One Week Ago' (MMMM, yyyy)\" with context @title:group Date",
-                            "%1", newGroupValue);
-                    } else {
-                        qCWarning(DolphinDebug).nospace() << "A wrong translation was found: " << translatedFormat << ". Please file a bug report at bugs.kde.org";
-                        const QString untranslatedFormat = format.toString({ QLatin1String("en_US") });
-                        newGroupValue = fileTime.toString(untranslatedFormat);
-                    }
-                } else if (daysDistance <= 7 * 3) {
-                    const KLocalizedString format = ki18nc("@title:group Date: "
-                                                           "MMMM is full month name in current locale, and yyyy is "
-                                                           "full year number", "'Two Weeks Ago' (MMMM, yyyy)");
-                    const QString translatedFormat = format.toString();
-                    if (translatedFormat.count(QLatin1Char('\'')) == 2) {
-                        newGroupValue = fileTime.toString(translatedFormat);
-                        newGroupValue = i18nc("Can be used to script translation of "
-                            "\"'Two Weeks Ago' (MMMM, yyyy)\" with context @title:group Date",
-                            "%1", newGroupValue);
-                    } else {
-                        qCWarning(DolphinDebug).nospace() << "A wrong translation was found: " << translatedFormat << ". Please file a bug report at bugs.kde.org";
-                        const QString untranslatedFormat = format.toString({ QLatin1String("en_US") });
-                        newGroupValue = fileTime.toString(untranslatedFormat);
-                    }
-                } else if (daysDistance <= 7 * 4) {
-                    const KLocalizedString format = ki18nc("@title:group Date: "
-                                                           "MMMM is full month name in current locale, and yyyy is "
-                                                           "full year number", "'Three Weeks Ago' (MMMM, yyyy)");
-                    const QString translatedFormat = format.toString();
-                    if (translatedFormat.count(QLatin1Char('\'')) == 2) {
-                        newGroupValue = fileTime.toString(translatedFormat);
-                        newGroupValue = i18nc("Can be used to script translation of "
-                            "\"'Three Weeks Ago' (MMMM, yyyy)\" with context @title:group Date",
-                            "%1", newGroupValue);
-                    } else {
-                        qCWarning(DolphinDebug).nospace() << "A wrong translation was found: " << translatedFormat << ". Please file a bug report at bugs.kde.org";
-                        const QString untranslatedFormat = format.toString({ QLatin1String("en_US") });
-                        newGroupValue = fileTime.toString(untranslatedFormat);
-                    }
                 } else {
-                    const KLocalizedString format = ki18nc("@title:group Date: "
-                                                           "MMMM is full month name in current locale, and yyyy is "
-                                                           "full year number", "'Earlier on' MMMM, yyyy");
-                    const QString translatedFormat = format.toString();
-                    if (translatedFormat.count(QLatin1Char('\'')) == 2) {
-                        newGroupValue = fileTime.toString(translatedFormat);
-                        newGroupValue = i18nc("Can be used to script translation of "
-                            "\"'Earlier on' MMMM, yyyy\" with context @title:group Date",
-                            "%1", newGroupValue);
-                    } else {
-                        qCWarning(DolphinDebug).nospace() << "A wrong translation was found: " << translatedFormat << ". Please file a bug report at bugs.kde.org";
-                        const QString untranslatedFormat = format.toString({ QLatin1String("en_US") });
-                        newGroupValue = fileTime.toString(untranslatedFormat);
-                    }
+                    qCWarning(DolphinDebug).nospace() << "A wrong translation was found: " << translatedFormat << ". Please file a bug report at bugs.kde.org";
+                    const QString untranslatedFormat = format.toString({ QLatin1String("en_US") });
+                    newGroupValue = fileTime.toString(untranslatedFormat);
                 }
-            } else {
-                newGroupValue = fileTime.toString(i18nc("@title:group "
-                    "The month and year: MMMM is full month name in current locale, "
-                    "and yyyy is full year number", "MMMM, yyyy"));
+            } else if (daysDistance <= 7) {
+                newGroupValue = fileTime.toString(i18nc("@title:group Date: "
+                    "The week day name: dddd, MMMM is full month name "
+                    "in current locale, and yyyy is full year number",
+                    "dddd (MMMM, yyyy)"));
                 newGroupValue = i18nc("Can be used to script translation of "
-                    "\"MMMM, yyyy\" with context @title:group Date",
+                    "\"dddd (MMMM, yyyy)\" with context @title:group Date",
                     "%1", newGroupValue);
+            } else if (daysDistance <= 7 * 2) {
+                const KLocalizedString format = ki18nc("@title:group Date: "
+                                                       "MMMM is full month name in current locale, and yyyy is "
+                                                       "full year number", "'One Week Ago' (MMMM, yyyy)");
+                const QString translatedFormat = format.toString();
+                if (translatedFormat.count(QLatin1Char('\'')) == 2) {
+                    newGroupValue = fileTime.toString(translatedFormat);
+                    newGroupValue = i18nc("Can be used to script translation of "
+                        "\"'One Week Ago' (MMMM, yyyy)\" with context @title:group Date",
+                        "%1", newGroupValue);
+                } else {
+                    qCWarning(DolphinDebug).nospace() << "A wrong translation was found: " << translatedFormat << ". Please file a bug report at bugs.kde.org";
+                    const QString untranslatedFormat = format.toString({ QLatin1String("en_US") });
+                    newGroupValue = fileTime.toString(untranslatedFormat);
+                }
+            } else if (daysDistance <= 7 * 3) {
+                const KLocalizedString format = ki18nc("@title:group Date: "
+                                                       "MMMM is full month name in current locale, and yyyy is "
+                                                       "full year number", "'Two Weeks Ago' (MMMM, yyyy)");
+                const QString translatedFormat = format.toString();
+                if (translatedFormat.count(QLatin1Char('\'')) == 2) {
+                    newGroupValue = fileTime.toString(translatedFormat);
+                    newGroupValue = i18nc("Can be used to script translation of "
+                        "\"'Two Weeks Ago' (MMMM, yyyy)\" with context @title:group Date",
+                        "%1", newGroupValue);
+                } else {
+                    qCWarning(DolphinDebug).nospace() << "A wrong translation was found: " << translatedFormat << ". Please file a bug report at bugs.kde.org";
+                    const QString untranslatedFormat = format.toString({ QLatin1String("en_US") });
+                    newGroupValue = fileTime.toString(untranslatedFormat);
+                }
+            } else if (daysDistance <= 7 * 4) {
+                const KLocalizedString format = ki18nc("@title:group Date: "
+                                                       "MMMM is full month name in current locale, and yyyy is "
+                                                       "full year number", "'Three Weeks Ago' (MMMM, yyyy)");
+                const QString translatedFormat = format.toString();
+                if (translatedFormat.count(QLatin1Char('\'')) == 2) {
+                    newGroupValue = fileTime.toString(translatedFormat);
+                    newGroupValue = i18nc("Can be used to script translation of "
+                        "\"'Three Weeks Ago' (MMMM, yyyy)\" with context @title:group Date",
+                        "%1", newGroupValue);
+                } else {
+                    qCWarning(DolphinDebug).nospace() << "A wrong translation was found: " << translatedFormat << ". Please file a bug report at bugs.kde.org";
+                    const QString untranslatedFormat = format.toString({ QLatin1String("en_US") });
+                    newGroupValue = fileTime.toString(untranslatedFormat);
+                }
+            } else {
+                const KLocalizedString format = ki18nc("@title:group Date: "
+                                                       "MMMM is full month name in current locale, and yyyy is "
+                                                       "full year number", "'Earlier on' MMMM, yyyy");
+                const QString translatedFormat = format.toString();
+                if (translatedFormat.count(QLatin1Char('\'')) == 2) {
+                    newGroupValue = fileTime.toString(translatedFormat);
+                    newGroupValue = i18nc("Can be used to script translation of "
+                        "\"'Earlier on' MMMM, yyyy\" with context @title:group Date",
+                        "%1", newGroupValue);
+                } else {
+                    qCWarning(DolphinDebug).nospace() << "A wrong translation was found: " << translatedFormat << ". Please file a bug report at bugs.kde.org";
+                    const QString untranslatedFormat = format.toString({ QLatin1String("en_US") });
+                    newGroupValue = fileTime.toString(untranslatedFormat);
+                }
             }
-        }
-
-        if (newGroupValue != groupValue) {
-            groupValue = newGroupValue;
-            groups.append(QPair<int, QVariant>(i, newGroupValue));
+        } else {
+            newGroupValue = fileTime.toString(i18nc("@title:group "
+                "The month and year: MMMM is full month name in current locale, "
+                "and yyyy is full year number", "MMMM, yyyy"));
+            newGroupValue = i18nc("Can be used to script translation of "
+                "\"MMMM, yyyy\" with context @title:group Date",
+                "%1", newGroupValue);
         }
     }
 
-    return groups;
+    m_timeGroupValues.insert(fileDate, newGroupValue);
+    return newGroupValue;
 }
 
-QList<QPair<int, QVariant> > KFileItemModel::permissionRoleGroups() const
+QString KFileItemModel::permissionRoleGroupValue(const ItemData* itemData) const
 {
-    Q_ASSERT(!m_itemData.isEmpty());
-
-    const int maxIndex = count() - 1;
-    QList<QPair<int, QVariant> > groups;
-
-    QString permissionsString;
-    QString groupValue;
-    for (int i = 0; i <= maxIndex; ++i) {
-        if (isChildItem(i)) {
-            continue;
-        }
-
-        const ItemData* itemData = m_itemData.at(i);
-        const QString newPermissionsString = itemData->values.value("permissions").toString();
-        if (newPermissionsString == permissionsString) {
-            continue;
-        }
-        permissionsString = newPermissionsString;
-
-        const QFileInfo info(itemData->item.url().toLocalFile());
+    // Items with equal permissions strings are in the same group.
+    const QString permissionsString = itemData->values.value(roleForType(PermissionsRole)).toString();
+    const auto cached = m_permissionGroupValues.constFind(permissionsString);
+    if (cached != m_permissionGroupValues.constEnd()) {
+        return cached.value();
+    }
 
-        // Set user string
-        QString user;
-        if (info.permission(QFile::ReadUser)) {
-            user = i18nc("@item:intext Access permission, concatenated", "Read, ");
-        }
-        if (info.permission(QFile::WriteUser)) {
-            user += i18nc("@item:intext Access permission, concatenated", "Write, ");
-        }
-        if (info.permission(QFile::ExeUser)) {
-            user += i18nc("@item:intext Access permission, concatenated", "Execute, ");
-        }
-        user = user.isEmpty() ? i18nc("@item:intext Access permission, concatenated", "Forbidden") : user.mid(0, user.count() - 2);
+    const QFileInfo info(itemData->item.url().toLocalFile());
 
-        // Set group string
-        QString group;
-        if (info.permission(QFile::ReadGroup)) {
-            group = i18nc("@item:intext Access permission, concatenated", "Read, ");
-        }
-        if (info.permission(QFile::WriteGroup)) {
-            group += i18nc("@item:intext Access permission, concatenated", "Write, ");
-        }
-        if (info.permission(QFile::ExeGroup)) {
-            group += i18nc("@item:intext Access permission, concatenated", "Execute, ");
-        }
-        group = group.isEmpty() ? i18nc("@item:intext Access permission, concatenated", "Forbidden") : group.mid(0, group.count() - 2);
+    // Set user string
+    QString user;
+    if (info.permission(QFile::ReadUser)) {
+        user = i18nc("@item:intext Access permission, concatenated", "Read, ");
+    }
+    if (info.permission(QFile::WriteUser)) {
+        user += i18nc("@item:intext Access permission, concatenated", "Write, ");
+    }
+    if (info.permission(QFile::ExeUser)) {
+        user += i18nc("@item:intext Access permission, concatenated", "Execute, ");
+    }
+    user = user.isEmpty() ? i18nc("@item:intext Access permission, concatenated", "Forbidden") : user.mid(0, user.count() - 2);
 
-        // Set others string
-        QString others;
-        if (info.permission(QFile::ReadOther)) {
-            others = i18nc("@item:intext Access permission, concatenated", "Read, ");
-        }
-        if (info.permission(QFile::WriteOther)) {
-            others += i18nc("@item:intext Access permission, concatenated", "Write, ");
-        }
-        if (info.permission(QFile::ExeOther)) {
-            others += i18nc("@item:intext Access permission, concatenated", "Execute, ");
-        }
-        others = others.isEmpty() ? i18nc("@item:intext Access permission, concatenated", "Forbidden") : others.mid(0, others.count() - 2);
+    // Set group string
+    QString group;
+    if (info.permission(QFile::ReadGroup)) {
+        group = i18nc("@item:intext Access permission, concatenated", "Read, ");
+    }
+    if (info.permission(QFile::WriteGroup)) {
+        group += i18nc("@item:intext Access permission, concatenated", "Write, ");
+    }
+    if (info.permission(QFile::ExeGroup)) {
+        group += i18nc("@item:intext Access permission, concatenated", "Execute, ");
+    }
+    group = group.isEmpty() ? i18nc("@item:intext Access permission, concatenated", "Forbidden") : group.mid(0, group.count() - 2);
 
-        const QString newGroupValue = i18nc("@title:group Files and folders by permissions", "User: %1 | Group: %2 | Others: %3", user, group, others);
-        if (newGroupValue != groupValue) {
-            groupValue = newGroupValue;
-            groups.append(QPair<int, QVariant>(i, newGroupValue));
-        }
+    // Set others string
+    QString others;
+    if (info.permission(QFile::ReadOther)) {
+        others = i18nc("@item:intext Access permission, concatenated", "Read, ");
+    }
+    if (info.permission(QFile::WriteOther)) {
+        others += i18nc("@item:intext Access permission, concatenated", "Write, ");
     }
+    if (info.permission(QFile::ExeOther)) {
+        others += i18nc("@item:intext Access permission, concatenated", "Execute, ");
+    }
+    others = others.isEmpty() ? i18nc("@item:intext Access permission, concatenated", "Forbidden") : others.mid(0, others.count() - 2);
+
+    const QString newGroupValue = i18nc("@title:group Files and folders by permissions", "User: %1 | Group: %2 | Others: %3", user, group, others);
 
-    return groups;
+    m_permissionGroupValues.insert(permissionsString, newGroupValue);
+    return newGroupValue;
 }
 
-QList<QPair<int, QVariant> > KFileItemModel::ratingRoleGroups() const
+int KFileItemModel::ratingRoleGroupValue(const ItemData* itemData) const
 {
-    Q_ASSERT(!m_itemData.isEmpty());
-
-    const int maxIndex = count() - 1;
-    QList<QPair<int, QVariant> > groups;
-
-    int groupValue = -1;
-    for (int i = 0; i <= maxIndex; ++i) {
-        if (isChildItem(i)) {
-            continue;
-        }
-        const int newGroupValue = m_itemData.at(i)->values.value("rating", 0).toInt();
-        if (newGroupValue != groupValue) {
-            groupValue = newGroupValue;
-            groups.append(QPair<int, QVariant>(i, newGroupValue));
-        }
-    }
-
-    return groups;
+    return itemData->values.value(roleForType(RatingRole), 0).toInt();
 }
 
-QList<QPair<int, QVariant> > KFileItemModel::genericStringRoleGroups(const QByteArray& role) const
+QString KFileItemModel::genericStringRoleGroupValue(const ItemData* itemData, const QByteArray& role) const
 {
-    Q_ASSERT(!m_itemData.isEmpty());
-
-    const int maxIndex = count() - 1;
-    QList<QPair<int, QVariant> > groups;
-
-    bool isFirstGroupValue = true;
-    QString groupValue;
-    for (int i = 0; i <= maxIndex; ++i) {
-        if (isChildItem(i)) {
-            continue;
-        }
-        const QString newGroupValue = m_itemData.at(i)->values.value(role).toString();
-        if (newGroupValue != groupValue || isFirstGroupValue) {
-            groupValue = newGroupValue;
-            groups.append(QPair<int, QVariant>(i, newGroupValue));
-            isFirstGroupValue = false;
-        }
-    }
-
-    return groups;
+    return itemData->values.value(role).toString();
 }
 
 void KFileItemModel::emitSortProgress(int resolvedCount)
@@ -2326,7 +5428,9 @@ void KFileItemModel::emitSortProgress(int resolvedCount)
         m_sortingProgressPercent = -1;
         if (m_resortAllItemsTimer->isActive()) {
             m_resortAllItemsTimer->stop();
-            resortAllItems();
+            slotResortTimerTimeout();
+        } else {
+            applyDeferredResort();
         }
 
         Q_EMIT directorySortingProgress(100);
@@ -2337,55 +5441,77 @@ void KFileItemModel::emitSortProgress(int resolvedCount)
         if (m_sortingProgressPercent != progress) {
             m_sortingProgressPercent = progress;
             Q_EMIT directorySortingProgress(progress);
+
+            if (progress >= m_resortProgressThreshold) {
+                applyDeferredResort();
+            }
         }
     }
 }
 
+constexpr KFileItemModel::RoleInfoMap KFileItemModel::s_rolesInfoMap[] = {
+//  |         role           |        roleType        |                role translation                     |            group translation               | requires Baloo | requires indexer
+    { nullptr,               NoRole,                  nullptr, nullptr,                                     nullptr, nullptr,                            false,           false },
+    { "text",                NameRole,                I18NC_NOOP("@label", "Name"),                 nullptr, nullptr,                            false,           false },
+    { "size",                SizeRole,                I18NC_NOOP("@label", "Size"),                 nullptr, nullptr,                            false,           false },
+    { "modificationtime",    ModificationTimeRole,    I18NC_NOOP("@label", "Modified"),             nullptr, nullptr,                            false,           false },
+    { "creationtime",        CreationTimeRole,        I18NC_NOOP("@label", "Created"),              nullptr, nullptr,                            false,           false },
+    { "accesstime",          AccessTimeRole,          I18NC_NOOP("@label", "Accessed"),             nullptr, nullptr,                            false,           false },
+    { "type",                TypeRole,                I18NC_NOOP("@label", "Type"),                 nullptr, nullptr,                            false,           false },
+    { "rating",              RatingRole,              I18NC_NOOP("@label", "Rating"),               nullptr, nullptr,                            true,            false },
+    { "tags",                TagsRole,                I18NC_NOOP("@label", "Tags"),                 nullptr, nullptr,                            true,            false },
+    { "comment",             CommentRole,             I18NC_NOOP("@label", "Comment"),              nullptr, nullptr,                            true,            false },
+    { "title",               TitleRole,               I18NC_NOOP("@label", "Title"),                I18NC_NOOP("@label", "Document"),    true,            true  },
+    { "wordCount",           WordCountRole,           I18NC_NOOP("@label", "Word Count"),           I18NC_NOOP("@label", "Document"),    true,            true  },
+    { "lineCount",           LineCountRole,           I18NC_NOOP("@label", "Line Count"),           I18NC_NOOP("@label", "Document"),    true,            true  },
+    { "imageDateTime",       ImageDateTimeRole,       I18NC_NOOP("@label", "Date Photographed"),    I18NC_NOOP("@label", "Image"),       true,            true  },
+    { "width",               WidthRole,               I18NC_NOOP("@label", "Width"),                I18NC_NOOP("@label", "Image"),       true,            true  },
+    { "height",              HeightRole,              I18NC_NOOP("@label", "Height"),               I18NC_NOOP("@label", "Image"),       true,            true  },
+    { "orientation",         OrientationRole,         I18NC_NOOP("@label", "Orientation"),          I18NC_NOOP("@label", "Image"),       true,            true  },
+    { "artist",              ArtistRole,              I18NC_NOOP("@label", "Artist"),               I18NC_NOOP("@label", "Audio"),       true,            true  },
+    { "genre",               GenreRole,               I18NC_NOOP("@label", "Genre"),                I18NC_NOOP("@label", "Audio"),       true,            true  },
+    { "album",               AlbumRole,               I18NC_NOOP("@label", "Album"),                I18NC_NOOP("@label", "Audio"),       true,            true  },
+    { "duration",            DurationRole,            I18NC_NOOP("@label", "Duration"),             I18NC_NOOP("@label", "Audio"),       true,            true  },
+    { "bitrate",             BitrateRole,             I18NC_NOOP("@label", "Bitrate"),              I18NC_NOOP("@label", "Audio"),       true,            true  },
+    { "track",               TrackRole,               I18NC_NOOP("@label", "Track"),                I18NC_NOOP("@label", "Audio"),       true,            true  },
+    { "releaseYear",         ReleaseYearRole,         I18NC_NOOP("@label", "Release Year"),         I18NC_NOOP("@label", "Audio"),       true,            true  },
+    { "aspectRatio",         AspectRatioRole,         I18NC_NOOP("@label", "Aspect Ratio"),         I18NC_NOOP("@label", "Video"),       true,            true  },
+    { "frameRate",           FrameRateRole,           I18NC_NOOP("@label", "Frame Rate"),           I18NC_NOOP("@label", "Video"),       true,            true  },
+    { "path",                PathRole,                I18NC_NOOP("@label", "Path"),                 I18NC_NOOP("@label", "Other"),       false,           false },
+    { "deletiontime",        DeletionTimeRole,        I18NC_NOOP("@label", "Deletion Time"),        I18NC_NOOP("@label", "Other"),       false,           false },
+    { "destination",         DestinationRole,         I18NC_NOOP("@label", "Link Destination"),     I18NC_NOOP("@label", "Other"),       false,           false },
+    { "originUrl",           OriginUrlRole,           I18NC_NOOP("@label", "Downloaded From"),      I18NC_NOOP("@label", "Other"),       true,            false },
+    { "permissions",         PermissionsRole,         I18NC_NOOP("@label", "Permissions"),          I18NC_NOOP("@label", "Other"),       false,           false },
+    { "owner",               OwnerRole,               I18NC_NOOP("@label", "Owner"),                I18NC_NOOP("@label", "Other"),       false,           false },
+    { "group",               GroupRole,               I18NC_NOOP("@label", "User Group"),           I18NC_NOOP("@label", "Other"),       false,           false },
+};
+
 const KFileItemModel::RoleInfoMap* KFileItemModel::rolesInfoMap(int& count)
 {
-    static const RoleInfoMap rolesInfoMap[] = {
-    //  |         role           |        roleType        |                role translation                     |            group translation               | requires Baloo | requires indexer
-        { nullptr,               NoRole,                  nullptr, nullptr,                                     nullptr, nullptr,                            false,           false },
-        { "text",                NameRole,                I18NC_NOOP("@label", "Name"),                 nullptr, nullptr,                            false,           false },
-        { "size",                SizeRole,                I18NC_NOOP("@label", "Size"),                 nullptr, nullptr,                            false,           false },
-        { "modificationtime",    ModificationTimeRole,    I18NC_NOOP("@label", "Modified"),             nullptr, nullptr,                            false,           false },
-        { "creationtime",        CreationTimeRole,        I18NC_NOOP("@label", "Created"),              nullptr, nullptr,                            false,           false },
-        { "accesstime",          AccessTimeRole,          I18NC_NOOP("@label", "Accessed"),             nullptr, nullptr,                            false,           false },
-        { "type",                TypeRole,                I18NC_NOOP("@label", "Type"),                 nullptr, nullptr,                            false,           false },
-        { "rating",              RatingRole,              I18NC_NOOP("@label", "Rating"),               nullptr, nullptr,                            true,            false },
-        { "tags",                TagsRole,                I18NC_NOOP("@label", "Tags"),                 nullptr, nullptr,                            true,            false },
-        { "comment",             CommentRole,             I18NC_NOOP("@label", "Comment"),              nullptr, nullptr,                            true,            false },
-        { "title",               TitleRole,               I18NC_NOOP("@label", "Title"),                I18NC_NOOP("@label", "Document"),    true,            true  },
-        { "wordCount",           WordCountRole,           I18NC_NOOP("@label", "Word Count"),           I18NC_NOOP("@label", "Document"),    true,            true  },
-        { "lineCount",           LineCountRole,           I18NC_NOOP("@label", "Line Count"),           I18NC_NOOP("@label", "Document"),    true,            true  },
-        { "imageDateTime",       ImageDateTimeRole,       I18NC_NOOP("@label", "Date Photographed"),    I18NC_NOOP("@label", "Image"),       true,            true  },
-        { "width",               WidthRole,               I18NC_NOOP("@label", "Width"),                I18NC_NOOP("@label", "Image"),       true,            true  },
-        { "height",              HeightRole,              I18NC_NOOP("@label", "Height"),               I18NC_NOOP("@label", "Image"),       true,            true  },
-        { "orientation",         OrientationRole,         I18NC_NOOP("@label", "Orientation"),          I18NC_NOOP("@label", "Image"),       true,            true  },
-        { "artist",              ArtistRole,              I18NC_NOOP("@label", "Artist"),               I18NC_NOOP("@label", "Audio"),       true,            true  },
-        { "genre",               GenreRole,               I18NC_NOOP("@label", "Genre"),                I18NC_NOOP("@label", "Audio"),       true,            true  },
-        { "album",               AlbumRole,               I18NC_NOOP("@label", "Album"),                I18NC_NOOP("@label", "Audio"),       true,            true  },
-        { "duration",            DurationRole,            I18NC_NOOP("@label", "Duration"),             I18NC_NOOP("@label", "Audio"),       true,            true  },
-        { "bitrate",             BitrateRole,             I18NC_NOOP("@label", "Bitrate"),              I18NC_NOOP("@label", "Audio"),       true,            true  },
-        { "track",               TrackRole,               I18NC_NOOP("@label", "Track"),                I18NC_NOOP("@label", "Audio"),       true,            true  },
-        { "releaseYear",         ReleaseYearRole,         I18NC_NOOP("@label", "Release Year"),         I18NC_NOOP("@label", "Audio"),       true,            true  },
-        { "aspectRatio",         AspectRatioRole,         I18NC_NOOP("@label", "Aspect Ratio"),         I18NC_NOOP("@label", "Video"),       true,            true  },
-        { "frameRate",           FrameRateRole,           I18NC_NOOP("@label", "Frame Rate"),           I18NC_NOOP("@label", "Video"),       true,            true  },
-        { "path",                PathRole,                I18NC_NOOP("@label", "Path"),                 I18NC_NOOP("@label", "Other"),       false,           false },
-        { "deletiontime",        DeletionTimeRole,        I18NC_NOOP("@label", "Deletion Time"),        I18NC_NOOP("@label", "Other"),       false,           false },
-        { "destination",         DestinationRole,         I18NC_NOOP("@label", "Link Destination"),     I18NC_NOOP("@label", "Other"),       false,           false },
-        { "originUrl",           OriginUrlRole,           I18NC_NOOP("@label", "Downloaded From"),      I18NC_NOOP("@label", "Other"),       true,            false },
-        { "permissions",         PermissionsRole,         I18NC_NOOP("@label", "Permissions"),          I18NC_NOOP("@label", "Other"),       false,           false },
-        { "owner",               OwnerRole,               I18NC_NOOP("@label", "Owner"),                I18NC_NOOP("@label", "Other"),       false,           false },
-        { "group",               GroupRole,               I18NC_NOOP("@label", "User Group"),           I18NC_NOOP("@label", "Other"),       false,           false },
-    };
+    count = std::size(s_rolesInfoMap);
+    return s_rolesInfoMap;
+}
+
+const char* KFileItemModel::roleTypeName(RoleType roleType)
+{
+    static constexpr std::array<int, RolesCount> indexes = roleInfoIndexes(s_rolesInfoMap);
+    static_assert(std::size(s_rolesInfoMap) == IsDirRole, "Each user visible role must have one entry in s_rolesInfoMap");
+    static_assert([] {
+        for (int i = NoRole; i < IsDirRole; ++i) {
+            if (indexes[i] < 0) {
+                return false;
+            }
+        }
+        return true;
+    }(), "Each user visible role must have one entry in s_rolesInfoMap");
 
-    count = sizeof(rolesInfoMap) / sizeof(RoleInfoMap);
-    return rolesInfoMap;
+    const int index = indexes[roleType];
+    return index >= 0 ? s_rolesInfoMap[index].role : nullptr;
 }
 
 void KFileItemModel::determineMimeTypes(const KFileItemList& items, int timeout)
 {
+    const KItemListTraceScope traceScope("KFileItemModel::determineMimeTypes", "timeout", timeout);
     QElapsedTimer timer;
     timer.start();
     for (const KFileItem& item : items) {
@@ -2394,7 +5520,7 @@ void KFileItemModel::determineMimeTypes(const KFileItemList& items, int timeout)
         // load the icon, but this is not necessary at all if we just need the
         // type. Some special code for setting the correct mime type for
         // directories is in retrieveData().
-        if (!item.isDir()) {
+        if (!item.isDir() && item.localPath().isEmpty()) {
             item.determineMimeType();
         }
 
@@ -2406,17 +5532,64 @@ void KFileItemModel::determineMimeTypes(const KFileItemList& items, int timeout)
     }
 }
 
-QByteArray KFileItemModel::sharedValue(const QByteArray& value)
+QMutex* KFileItemModel::sharedValuesMutex() const
 {
-    static QSet<QByteArray> pool;
-    const QSet<QByteArray>::const_iterator it = pool.constFind(value);
+    return m_retrievingDataInParallel ? &m_sharedValuesMutex : nullptr;
+}
 
-    if (it != pool.constEnd()) {
+QString KFileItemModel::sharedString(const QString& value) const
+{
+    QMutexLocker locker(sharedValuesMutex());
+    const auto it = m_sharedStrings.constFind(value);
+    if (it != m_sharedStrings.constEnd()) {
         return *it;
-    } else {
-        pool.insert(value);
-        return value;
     }
+
+    m_sharedStrings.insert(value);
+    return value;
+}
+
+QString KFileItemModel::userName(const KFileItem& item) const
+{
+    const KIO::UDSEntry entry = item.entry();
+    const qint64 userId = entry.numberValue(KIO::UDSEntry::UDS_LOCAL_USER_ID, -1);
+    if (userId < 0 || entry.contains(KIO::UDSEntry::UDS_USER)) {
+        return sharedString(item.user());
+    }
+
+    // The names are looked up while the mutex is locked, as KUser is not thread-safe.
+    QMutexLocker locker(sharedValuesMutex());
+    auto it = m_userNames.constFind(userId);
+    if (it == m_userNames.constEnd()) {
+        it = m_userNames.insert(userId, KUser(static_cast<K_UID>(userId)).loginName());
+    }
+    return *it;
+}
+
+QString KFileItemModel::groupName(const KFileItem& item) const
+{
+    const KIO::UDSEntry entry = item.entry();
+    const qint64 groupId = entry.numberValue(KIO::UDSEntry::UDS_LOCAL_GROUP_ID, -1);
+    if (groupId < 0 || entry.contains(KIO::UDSEntry::UDS_GROUP)) {
+        return sharedString(item.group());
+    }
+
+    QMutexLocker locker(sharedValuesMutex());
+    auto it = m_groupNames.constFind(groupId);
+    if (it == m_groupNames.constEnd()) {
+        it = m_groupNames.insert(groupId, KUserGroup(static_cast<K_GID>(groupId)).name());
+    }
+    return *it;
+}
+
+bool KFileItemModel::hasThemeIcon(const QString& iconName) const
+{
+    QMutexLocker locker(sharedValuesMutex());
+    auto it = m_themeIcons.constFind(iconName);
+    if (it == m_themeIcons.constEnd()) {
+        it = m_themeIcons.insert(iconName, QIcon::hasThemeIcon(iconName));
+    }
+    return *it;
 }
 
 bool KFileItemModel::isConsistent() const
@@ -2441,15 +5614,26 @@ bool KFileItemModel::isConsistent() const
             return false;
         }
 
-        // Check if the items are sorted correctly.
-        if (i > 0 && !lessThan(m_itemData.at(i - 1), m_itemData.at(i), m_collator)) {
-            qCWarning(DolphinDebug) << "The order of items" << i - 1 << "and" << i << "is wrong:"
-                << fileItem(i - 1) << fileItem(i);
-            return false;
+        // Check if the items are sorted correctly. While searching, only
+        // the ranked items are sorted and the other items rank lower.
+        if (i > 0) {
+            const bool ranked = (m_rankedItemCount < 0 || i < m_rankedItemCount);
+            const int previousIndex = ranked ? i - 1 : m_rankedItemCount - 1;
+            if (previousIndex >= 0 && !lessThan(m_itemData.at(previousIndex), m_itemData.at(i), m_collator)) {
+                qCWarning(DolphinDebug) << "The order of items" << previousIndex << "and" << i << "is wrong:"
+                    << fileItem(previousIndex) << fileItem(i);
+                return false;
+            }
         }
 
         // Check if all parent-child relationships are consistent.
         const ItemData* data = m_itemData.at(i);
+        const auto level = data->values.constFind("expandedParentsCount");
+        if (level != data->values.constEnd() && level->toInt() != data->depth) {
+            qCWarning(DolphinDebug) << "The role expandedParentsCount" << level->toInt() << "differs from the depth" << data->depth << "of" << data->item;
+            return false;
+        }
+
         const ItemData* parent = data->parent;
         if (parent) {
             if (expandedParentsCount(data) != expandedParentsCount(parent) + 1) {
@@ -9,18 +9,35 @@
 
 #include "dolphin_export.h"
 #include "kitemviews/kitemmodelbase.h"
+#include "kitemviews/private/kfileitemmodelchangecoalescer.h"
 #include "kitemviews/private/kfileitemmodelfilter.h"
+#include "kitemviews/private/kfileitemmodelprefixindex.h"
+#include "kitemviews/private/kfileitemmodelrolestore.h"
+#include "kitemviews/private/kfileitemmodelsnapshot.h"
+#include "kitemviews/private/kitemslabpool.h"
+#include "kitemviews/private/kmemorybudget.h"
 
 #include <KFileItem>
 
+#include <QAtomicInt>
+#include <QCache>
 #include <QCollator>
+#include <QDateTime>
+#include <QFutureWatcher>
 #include <QHash>
+#include <QMutex>
 #include <QSet>
 #include <QUrl>
+#include <QVector>
 
+#include <array>
 #include <functional>
+#include <optional>
+#include <utility>
 
+class KFileItemMimeTypeResolver;
 class KFileItemModelDirLister;
+class QRegularExpression;
 class QTimer;
 
 /**
@@ -33,7 +50,7 @@ class QTimer;
  * Recursive expansion of sub-directories is supported by
  * KFileItemModel::setExpanded().
  */
-class DOLPHIN_EXPORT KFileItemModel : public KItemModelBase
+class DOLPHIN_EXPORT KFileItemModel : public KItemModelBase, public KMemoryBudget::Consumer
 {
     Q_OBJECT
 
@@ -50,8 +67,11 @@ public:
     void loadDirectory(const QUrl& url);
 
     /**
-     * Throws away all currently loaded items and refreshes the directory
-     * by reloading all items again.
+     * Refreshes the directory by reloading all items again. If \a url is the
+     * current directory and no folder is expanded, the current items are
+     * compared with the listed items: Only new, changed and deleted items
+     * are inserted, refreshed and removed, and the unchanged items keep
+     * their role values. Otherwise all currently loaded items are thrown away.
      */
     void refreshDirectory(const QUrl& url);
 
@@ -63,6 +83,8 @@ public:
      */
     QUrl directory() const override;
 
+    bool isMovingItemsInBackground() const override;
+
     /**
      * Cancels the loading of a directory which has been started by either
      * loadDirectory() or refreshDirectory().
@@ -73,27 +95,96 @@ public:
     QHash<QByteArray, QVariant> data(int index) const override;
     bool setData(int index, const QHash<QByteArray, QVariant>& values) override;
 
+    /**
+     * @return Value of \a role of the item with the index \a index, or an
+     *         invalid value if the values of the item have not been retrieved
+     *         yet. In opposite to data() the values are not retrieved.
+     */
+    QVariant retrievedValue(int index, const QByteArray& role) const;
+
+    /**
+     * Sets the values of several items at once. In opposite to invoking
+     * setData() for each item, the signal itemsChanged() is only emitted
+     * once for all changed items.
+     * @param itemsValues  Values for the items, with the index of the
+     *                     item as key.
+     * @return True if the values of at least one item have been changed.
+     */
+    bool setItemsData(const QHash<int, QHash<QByteArray, QVariant> >& itemsValues);
+
+    /**
+     * Sets the value of the role \a role for the items of \a itemRanges.
+     * The values are passed in the order of the indexes of the ranges,
+     * so \a values must contain one value per item of the ranges. No
+     * hash of item indexes is built, and the signal itemsChanged() is
+     * only emitted once for the items whose value has been changed.
+     * @return True if the value of at least one item has been changed.
+     */
+    bool setRoleValues(const QByteArray& role, const KItemRangeList& itemRanges, const QVector<QVariant>& values);
+
+    /**
+     * Determines the MIME-types of \a items without blocking the user interface.
+     * The MIME-types of local files are determined by their content in worker
+     * threads. Until the items are updated, which is done in batches, their
+     * MIME-types are guessed from the file names. For remote files KFileItem
+     * only looks at the name anyway, so they are resolved immediately.
+     */
+    void resolveMimeTypes(const KFileItemList& items);
+
     /**
      * Sets a separate sorting with directories first (true) or a mixed
-     * sorting of files and directories (false).
+     * sorting of files and directories (false). As the directories and the
+     * files of a directory are sorted segments in both cases, changing the
+     * setting only requires to merge or to separate the segments.
      */
     void setSortDirectoriesFirst(bool dirsFirst);
     bool sortDirectoriesFirst() const;
 
+    /**
+     * Shows or hides the hidden files. The hidden items of the directory are
+     * kept with their role values and in their order while they are not
+     * shown, so that showing them again only requires to merge them into
+     * the shown items.
+     */
     void setShowHiddenFiles(bool show);
     bool showHiddenFiles() const;
 
     /**
      * If set to true, only directories are shown as items of the model. Files
-     * are ignored.
+     * are ignored. The setting is applied when the next directory is loaded.
      */
     void setShowDirectoriesOnly(bool enabled);
     bool showDirectoriesOnly() const;
 
+    /**
+     * If set to true, the items of all sub-directories are shown as one flat
+     * list together with the items of the directory. The sub-directories are
+     * listed in parallel and their items are inserted while they are listed.
+     * Items cannot be expanded while the recursive listing is enabled.
+     * Changing the setting lists the directory again.
+     */
+    void setRecursiveListing(bool enabled);
+    bool recursiveListing() const;
+
+    /**
+     * Sets the maximum number of sub-directory levels below the directory
+     * whose items are shown by the recursive listing. A \a depth of 0 means
+     * that all levels are shown. Symbolic links to directories are never
+     * followed to prevent cycles.
+     */
+    void setRecursiveListingDepth(int depth);
+    int recursiveListingDepth() const;
+
     QMimeData* createMimeData(const KItemSet& indexes) const override;
 
     int indexForKeyboardSearch(const QString& text, int startFromIndex = 0) const override;
 
+    /**
+     * @return Indexes of all items whose names match \a regexp. For large
+     *         models the names are matched in parallel by several threads.
+     */
+    KItemSet indexesMatching(const QRegularExpression& regexp) const;
+
     bool supportsDropping(int index) const override;
 
     QString roleDescription(const QByteArray& role) const override;
@@ -107,6 +198,14 @@ public:
      */
     KFileItem fileItem(int index) const;
 
+    /**
+     * @return Immutable copy of the items and their values, which stays
+     *         unchanged while the model is changed. Only the parts that have
+     *         changed since the last snapshot that is still used are copied.
+     *         Must only be used in the GUI thread.
+     */
+    KFileItemModelSnapshot itemsSnapshot() const;
+
     /**
      * @return The file-item for the url \a url. If no file-item with the given
      *         URL is found KFileItem::isNull() will be true for the returned
@@ -127,6 +226,25 @@ public:
      */
     int index(const QUrl &url) const;
 
+    /**
+     * @return Identifier of the item with the index \a index, or 0 if the
+     *         index is invalid. The identifier is assigned when the item is
+     *         added to the model and does not change if the item is moved,
+     *         renamed or refreshed, so it can be used instead of the URL to
+     *         refer to the item. Identifiers are not reused during the lifetime
+     *         of the model.
+     */
+    quint32 itemId(int index) const;
+
+    /**
+     * @return The index of the item with the identifier \a id. -1 is returned
+     *         if no item has the identifier, or if the item is currently not
+     *         shown, e.g. because it is filtered. The amortized runtime
+     *         complexity of this call is O(1), and unlike index(const QUrl&)
+     *         no URL must be hashed.
+     */
+    int indexForItemId(quint32 id) const;
+
     /**
      * @return Root item of all items representing the item
      *         for KFileItemModel::dir().
@@ -158,11 +276,252 @@ public:
      */
     void restoreExpandedDirectories(const QSet<QUrl>& urls);
 
+    /**
+     * @return URLs of the sub-directories that have been marked by
+     *         restoreExpandedDirectories() or expandParentDirectories()
+     *         and have not been expanded yet. Together with
+     *         expandedDirectories() they describe the expansion state
+     *         that should be restored later.
+     */
+    QSet<QUrl> directoriesToBeExpanded() const;
+
     /**
      * Expands all parent-directories of the item \a url.
      */
     void expandParentDirectories(const QUrl& url);
 
+    /**
+     * Sets the number of items that are required to fill the visible area
+     * of the view. While a directory is loaded into the empty model, the
+     * first items are inserted as soon as \a count items have been received,
+     * and the following items are inserted in intervals that depend on the
+     * time needed for inserting. Per default \a count is 0, which means that
+     * all items are inserted when the loading has been completed or after
+     * the maximum update interval of 2 seconds.
+     */
+    void setVisibleItemCountHint(int count);
+    int visibleItemCountHint() const;
+
+    /**
+     * Enables the mode for showing search results, which usually arrive
+     * slowly and in many small batches. The first results are inserted as
+     * soon as they arrive and the following ones in short intervals. To keep
+     * inserting cheap, the best ranked items according to the current
+     * sorting are kept in their place while the search is running. The
+     * other results are merged into the items behind them once per batch,
+     * so all results stay sorted. Per default the search mode is disabled.
+     */
+    void setSearchModeEnabled(bool enabled);
+    bool isSearchModeEnabled() const;
+
+    /**
+     * @return True if the directory that is being listed contains so many
+     *         items that only the first items are kept sorted while it is
+     *         listed, like the best ranked results of the search mode. The other
+     *         items are appended in the order in which they are listed, and
+     *         all items are sorted in the background when the listing has
+     *         been completed.
+     */
+    bool isHugeDirectory() const;
+
+    /**
+     * @return Estimated number of items of the directory that is being
+     *         listed, or -1 if it is unknown. It is known before all items
+     *         have been listed if the directory is listed locally, or if
+     *         it has been passed to setExpectedItemCount().
+     */
+    int estimatedItemCount() const;
+
+    /**
+     * @return Number of items of the directory that have been listed since
+     *         the last loadDirectory(), including the items that are hidden
+     *         by the name filter or the MIME type filters.
+     */
+    int listedItemCount() const;
+
+    /**
+     * Sets the number of items that the directory passed to the next
+     * loadDirectory() is expected to contain, e.g. because it contained
+     * them when it has been visited before. A huge directory is inserted
+     * like one from the start, see isHugeDirectory(). The number that is
+     * reported by the local lister replaces the expected number.
+     */
+    void setExpectedItemCount(int count);
+
+    /**
+     * @return Estimated total size in bytes of the files of the directory
+     *         that is being listed, which is extrapolated from the sizes of
+     *         the files that have been listed so far.
+     */
+    KIO::filesize_t estimatedTotalSize() const;
+
+    /**
+     * Sets the time in milliseconds during which the changes of the listed
+     * directories are collected before they are applied to the model at
+     * once, see KFileItemModelChangeCoalescer. While directories are being
+     * loaded, the changes are applied immediately. Per default the interval
+     * is 0, which applies all changes immediately.
+     */
+    void setChangeCoalescingInterval(int msec);
+    int changeCoalescingInterval() const;
+
+    /**
+     * If \a deferred is true, the changes of the listed directories are
+     * collected until the changes are not deferred anymore, independent from
+     * the coalescing interval. Is used for views that are not visible, e.g.
+     * the views of inactive tabs, so that a directory with frequent changes
+     * only results in one update when the view becomes visible again. While
+     * directories are being loaded and for renamed items, the changes are
+     * still applied immediately.
+     */
+    void setChangesDeferred(bool deferred);
+    bool changesDeferred() const;
+
+    /**
+     * If \a deferred is true, the resortings that are needed because of the
+     * sort role values that KFileItemModelRolesUpdater resolves are collected
+     * until the resortings are not deferred anymore, or until
+     * resortProgressThreshold() percent of the values have been resolved.
+     * The collected changes of the order are applied at once afterwards.
+     * Is used while the user interacts with the view, so that the items
+     * do not move under the cursor.
+     */
+    void setResortingDeferred(bool deferred);
+    bool resortingDeferred() const;
+
+    /**
+     * Sets the percentage of resolved sort role values from which on
+     * resortings are not deferred anymore, see setResortingDeferred().
+     * Per default the resortings are deferred until all values have
+     * been resolved.
+     */
+    void setResortProgressThreshold(int percent);
+    int resortProgressThreshold() const;
+
+    /**
+     * Limits the memory in bytes that may be used additionally to the items
+     * for sorting them. If the collation keys of all items would exceed
+     * \a bytes, no collation keys are kept and the names are compared
+     * directly. If the buffers of the parallel sort would exceed it, the
+     * items are sorted in place by one thread. Both are slower, but the
+     * used memory does not grow with the number of items. Per default the
+     * limit is 0, which means that the memory is not limited.
+     */
+    void setSortingMemoryLimit(qint64 bytes);
+    qint64 sortingMemoryLimit() const;
+
+    /**
+     * Enables keeping snapshots of the items of the recently shown local
+     * directories. If such a directory is loaded again by loadDirectory() and
+     * has not been modified since, its items are shown at once including the
+     * values of their roles. The items that are listed afterwards by the
+     * directory lister only update the differences. Per default the
+     * snapshots are disabled.
+     *
+     * If no snapshot is available, the items and their role values are
+     * taken from another model with enabled snapshots, which shows the
+     * same directory with the same settings, like the other side of a
+     * split view. The sorting, filtering and selection are kept per model.
+     */
+    void setSnapshotsEnabled(bool enabled);
+    bool snapshotsEnabled() const;
+
+    /**
+     * Sets a description of the settings that influence the values set by
+     * KFileItemModelRolesUpdater, like the size of the previews. The values
+     * of the items of a snapshot are only restored if the snapshot has
+     * been taken with the same \a context.
+     */
+    void setSnapshotContext(const QByteArray& context);
+
+    /**
+     * @return Items that have been restored from a snapshot including the
+     *         values of their roles since the last invocation.
+     */
+    KFileItemList takeRestoredItems();
+
+    /**
+     * Takes a snapshot of the shown directory that is kept after the model
+     * has been deleted, e.g. for restoring a closed tab. The retained
+     * snapshots are shared by all models with enabled snapshots and are
+     * used like their own snapshots by loadDirectory().
+     */
+    void retainSnapshot();
+
+    /**
+     * Lists the directory \a url speculatively, so that it can be shown at
+     * once when it is loaded by a model with enabled snapshots. Should be
+     * invoked for folders the user is likely to open next, like the hovered
+     * folder. The prefetching is shared by all models, see KDirectoryPrefetcher.
+     */
+    void prefetchDirectory(const QUrl& url);
+    void cancelPrefetching(const QUrl& url);
+
+    /**
+     * @return True if the items of the directory \a url are known without
+     *         listing it, because a model with enabled snapshots shows the
+     *         directory or has a valid snapshot of it. The items are stored
+     *         in \a items. Only unfiltered listings are used, which contain
+     *         the hidden files if \a includeHiddenFiles is true. Is used e.g.
+     *         for completing the location that is typed by the user.
+     */
+    static bool cachedListing(const QUrl& url, bool includeHiddenFiles, KFileItemList& items);
+
+    typedef std::function<bool(const KFileItem& item, const QHash<QByteArray, QVariant>& values)> ItemPredicate;
+    typedef std::function<void(const KFileItem& item, const QHash<QByteArray, QVariant>& values)> ItemVisitor;
+
+    /**
+     * Keeps the items of the shown search results including the values of
+     * their roles after another directory has been loaded, so that a
+     * narrowed search can be shown from them, see prepareNarrowedSearch().
+     * Only one result set is kept, it is replaced by the next invocation.
+     */
+    void cacheSearchResults();
+
+    /**
+     * @return URL of the search results that have been kept by
+     *         cacheSearchResults(), or an empty URL.
+     */
+    QUrl cachedSearchResultsUrl() const;
+
+    /**
+     * Invokes \a visitor for each of the kept search results, e.g. for
+     * counting the results by their properties in one pass.
+     */
+    void forEachCachedSearchResult(const ItemVisitor& visitor) const;
+
+    /**
+     * Prepares loading the search \a url, whose results are a subset of
+     * the kept search results: When \a url is loaded by loadDirectory(),
+     * the kept results for which \a matches returns true are shown at
+     * once including the values of their roles. Like the items of a
+     * snapshot, they are verified by the listing of \a url, and the items
+     * that are not listed are removed when the listing has been completed.
+     */
+    void prepareNarrowedSearch(const QUrl& url, const ItemPredicate& matches);
+
+    QString memoryConsumerName() const override;
+
+    /**
+     * @return Estimated number of bytes used by the items including the
+     *         values of their roles, the filtered items, the groups and
+     *         the snapshots. See KMemoryBudget.
+     */
+    qint64 memoryUsage() const override;
+
+    /**
+     * Releases the least recently used snapshots, the cached search results
+     * and the items that are kept while they are not shown. The shown items
+     * of the model are never released.
+     */
+    qint64 releaseMemory(qint64 bytes) override;
+
+    /**
+     * @return Estimated number of bytes used by the snapshots, the cached
+     *         search results and the kept items.
+     */
+    qint64 releasableMemory() const override;
+
     void setNameFilter(const QString& nameFilter);
     QString nameFilter() const;
 
@@ -221,6 +580,15 @@ Q_SIGNALS:
      */
     void directorySortingProgress(int percent);
 
+    /**
+     * Is emitted periodically while a huge directory is listed, see
+     * isHugeDirectory(). \a listedCount items have been listed so far, and
+     * the directory is estimated to contain \a estimatedCount items with a
+     * total size of \a estimatedSize bytes. \a estimatedCount is -1 if the
+     * number of items is unknown.
+     */
+    void directoryLoadingEstimateChanged(int listedCount, int estimatedCount, KIO::filesize_t estimatedSize);
+
     /**
      * Is emitted if an information message (e.g. "Connecting to host...")
      * should be shown.
@@ -249,6 +617,7 @@ protected:
     void onGroupedSortingChanged(bool current) override;
     void onSortRoleChanged(const QByteArray& current, const QByteArray& previous, bool resortItems = true) override;
     void onSortOrderChanged(Qt::SortOrder current, Qt::SortOrder previous) override;
+    void onSortOrderAboutToBeChanged(Qt::SortOrder current, Qt::SortOrder next) override;
 
 private Q_SLOTS:
     /**
@@ -257,7 +626,20 @@ private Q_SLOTS:
      */
     void resortAllItems();
 
-    void slotCompleted();
+    /**
+     * Is invoked if m_resortAllItemsTimer has been exceeded. Only the items
+     * in m_itemsToReposition are repositioned if the other items are still
+     * sorted, otherwise all items are resorted.
+     */
+    void slotResortTimerTimeout();
+
+    /**
+     * Applies the resorting that has been deferred by
+     * slotResortTimerTimeout(), if there is one.
+     */
+    void applyDeferredResort();
+
+    void slotCompleted(const QUrl& url);
     void slotCanceled();
     void slotItemsAdded(const QUrl& directoryUrl, const KFileItemList& items);
     void slotItemsDeleted(const KFileItemList& items);
@@ -265,8 +647,73 @@ private Q_SLOTS:
     void slotClear();
     void slotSortingChoiceChanged();
 
+    /**
+     * Collect the changes that are reported by the directory lister
+     * if the coalescing of changes is enabled, see setChangeCoalescingInterval()
+     * and setChangesDeferred(). Otherwise the changes are applied directly.
+     */
+    void queueItemsAdded(const QUrl& directoryUrl, const KFileItemList& items);
+    void queueItemsDeleted(const KFileItemList& items);
+    void queueRefreshItems(const QList<QPair<KFileItem, KFileItem> >& items);
+
+    /**
+     * @return True if changes should be collected by m_changeCoalescer
+     *         instead of being applied directly.
+     */
+    bool coalesceChanges() const;
+
+    /**
+     * Applies the changes that have been collected by m_changeCoalescer.
+     */
+    void applyQueuedChanges();
+
     void dispatchPendingItemsToInsert();
 
+    /**
+     * Sorts the items that have been appended to m_pendingItemsToInsert since
+     * the last call and merges the sorted runs of similar length. If KIO
+     * delivers the items of a directory in chunks, each chunk is sorted while
+     * waiting for the next one, so that dispatchPendingItemsToInsert() only
+     * has to merge the remaining runs.
+     */
+    void presortPendingItems();
+
+    /**
+     * Merges the sorted runs of m_pendingItemsToInsert.
+     * @return True if m_pendingItemsToInsert is presorted.
+     */
+    bool mergePendingRuns();
+
+    /**
+     * Records the time from loadDirectory() until the first items have
+     * been inserted, once per loading, if the tracing is enabled.
+     */
+    void traceFirstItems();
+
+    /**
+     * Inserts the search results \a items, see setSearchModeEnabled().
+     */
+    void insertSearchResults(QList<ItemData*>& items);
+
+    /**
+     * Sorts the items that have been appended behind the ranked items of a
+     * huge directory. The search results are sorted already, so only the
+     * ranking is ended for them.
+     */
+    void finishRankedItems();
+
+    /**
+     * Applies the result of the resorting that has been started by
+     * startAsyncResort().
+     */
+    void slotAsyncResortFinished();
+
+    /**
+     * Replaces the items whose MIME-types have been determined by
+     * m_mimeTypeResolver and updates their values.
+     */
+    void slotMimeTypesResolved(const QHash<QUrl, QString>& mimeTypes);
+
 private:
     enum RoleType {
         // User visible roles:
@@ -287,6 +734,39 @@ private:
         KFileItem item;
         QHash<QByteArray, QVariant> values;
         ItemData* parent;
+        // Number of expanded parents, which is determined when the item is created
+        // and never changes, because the parent of an item never changes.
+        int depth;
+        // Slot of the item in m_roleStore
+        int slot;
+        // Hash value of item.url(), see UrlKey
+        uint urlHash;
+        // Identifier of the item, which is unique during the lifetime of the model
+        quint32 id;
+        // Collation key of item.text(). It is only set if natural sorting is
+        // enabled and allows to compare names without invoking QCollator::compare().
+        std::optional<QCollatorSortKey> sortKey;
+    };
+
+    /**
+     * Key of the URL-to-index hash m_items. The hash value of the URL of an item
+     * is calculated only once and stored in ItemData::urlHash, so that
+     * maintaining m_items does not require to hash complete URLs again and again.
+     */
+    struct UrlKey
+    {
+        QUrl url;
+        uint hash;
+
+        bool operator==(const UrlKey& other) const
+        {
+            return hash == other.hash && url == other.url;
+        }
+
+        friend uint qHash(const UrlKey& key, uint seed = 0)
+        {
+            return key.hash ^ seed;
+        }
     };
 
     enum RemoveItemsBehavior {
@@ -294,26 +774,161 @@ private:
         DeleteItemData
     };
 
-    void insertItems(QList<ItemData*>& items);
+    /**
+     * Inserts the \a items in the sorting order. The items are merged into
+     * the first \a mergedItemCount items of the model, the items behind
+     * keep their order. If \a mergedItemCount is negative, the items are
+     * merged into all items of the model.
+     */
+    void insertItems(QList<ItemData*>& items, int mergedItemCount = -1);
+
+    /**
+     * Inserts the \a items, which are in the sorting order already,
+     * see insertItems().
+     */
+    void insertSortedItems(const QList<ItemData*>& items, int mergedItemCount = -1);
+
+    /**
+     * Appends the \a items behind the items of the model without sorting them.
+     */
+    void appendItems(QList<ItemData*>& items);
     void removeItems(const KItemRangeList& itemRanges, RemoveItemsBehavior behavior);
 
+    /**
+     * Updates m_items after items have been inserted or removed at \a index.
+     * The entries of the items in front of \a index are still valid and are
+     * kept. If \a indexCacheComplete is true, m_items contained all items
+     * before the change, and the entries of the items behind \a index get
+     * the new indexes, so that m_items stays complete and per-item lookups
+     * never need to rebuild it. Otherwise the stale entries are removed and
+     * m_items gets re-populated lazily by index(const QUrl&).
+     */
+    void updateIndexCache(int index, bool indexCacheComplete);
+
+    /**
+     * Removes the entries of all items with an index >= \a index from m_items.
+     */
+    void truncateIndexCache(int index);
+
+    /**
+     * Updates ItemData::urlHash after the URL of the item \a data has been changed.
+     */
+    static void updateUrlHash(ItemData* data);
+
+    static UrlKey urlKey(const ItemData* data);
+    static UrlKey urlKey(const QUrl& url);
+
+    /**
+     * @return The index of the item with the key \a key, or -1 if no item
+     *         is found. Items are added to m_items until the key is found.
+     */
+    int indexForKey(const UrlKey& key) const;
+
+    /**
+     * Assigns a new identifier to \a data and remembers it in m_itemDataById.
+     */
+    void assignItemId(ItemData* data);
+
     /**
      * Helper method for insertItems() and removeItems(): Creates
      * a list of ItemData elements based on the given items.
-     * Note that the ItemData instances are created dynamically and
-     * must be deleted by the caller.
+     * Note that the ItemData instances are allocated from m_itemDataPool
+     * and must be deleted by the caller with deleteItemData().
+     */
+    QList<ItemData*> createItemDataList(const QUrl& parentUrl, const KFileItemList& items);
+
+    /**
+     * Destroys the item-data \a data, returns its memory to m_itemDataPool
+     * and releases its slot in m_roleStore.
      */
-    QList<ItemData*> createItemDataList(const QUrl& parentUrl, const KFileItemList& items) const;
+    void deleteItemData(ItemData* data);
+
+    /**
+     * @return Estimated number of bytes used by the item-data \a data
+     *         including the values of its roles. See memoryUsage().
+     */
+    static qint64 itemDataCost(const ItemData* data);
+
+    /**
+     * @return Estimated number of bytes used by m_keptItems.
+     */
+    qint64 keptItemsCost() const;
+
+    /**
+     * Stores the role values of \a data that can be determined directly
+     * from the KFileItem into m_roleStore. String values are only stored
+     * for requested roles.
+     */
+    void updateRoleStore(const ItemData* data);
+
+    /**
+     * @return Value of the numeric role \a column for \a data, which has been
+     *         stored by updateRoleStore(). The runtime complexity is O(1).
+     */
+    qint64 int64RoleValue(const ItemData* data, KFileItemModelRoleStore::Int64Column column) const;
+
+    /**
+     * @return Value of the string role \a column for \a data, which has been
+     *         stored by updateRoleStore(). The runtime complexity is O(1).
+     */
+    const QString& stringRoleValue(const ItemData* data, KFileItemModelRoleStore::StringColumn column) const;
 
     /**
      * Prepares the items for sorting. Normally, the hash 'values' in ItemData is filled
      * lazily to save time and memory, but for some sort roles, it is expected that the
-     * sort role data is stored in 'values'.
+     * sort role data is stored in 'values'. The values of many items are
+     * retrieved by several threads.
      */
     void prepareItemsForSorting(QList<ItemData*>& itemDataList);
 
+    /**
+     * Updates the collation sort key of \a data. The key is only calculated if
+     * natural sorting is enabled, otherwise it gets reset.
+     */
+    void updateSortKey(ItemData* data) const;
+
+    /**
+     * Updates the collation sort keys of all items. Must be invoked if the
+     * settings of m_collator have been changed.
+     */
+    void updateSortKeys();
+
+    /**
+     * Applies the default locale to m_collator if it has been changed, e.g. by
+     * QLocale::setDefault(), and updates the collation sort keys and the name
+     * groups. QLocale does not notify about changes, so the locale is checked
+     * before a directory is loaded and before all items are resorted.
+     * @return True if the locale has been changed.
+     */
+    bool updateCollatorLocale();
+
+    /**
+     * @return True if sorting \a itemCount items would exceed the memory
+     *         limit, if each item requires \a costPerItem bytes.
+     *         See setSortingMemoryLimit().
+     */
+    bool exceedsSortingMemoryLimit(int itemCount, int costPerItem) const;
+
+    /**
+     * Disables or enables the collation keys depending on the number
+     * of items and the memory limit. Returns true if it has been changed.
+     */
+    bool updateSortKeysAllowed(int itemCount);
+
+    /**
+     * @return Number of expanded parents of \a data. Runtime complexity is O(1).
+     */
     static int expandedParentsCount(const ItemData* data);
 
+    /**
+     * @return Index after the last (indirect) child of the expanded
+     *         item at \a index, which is index + 1 if the item has no
+     *         children in the model. The children of an item directly
+     *         follow the item, so they form the range from index + 1
+     *         up to the returned index.
+     */
+    int subtreeEnd(int index) const;
+
     void removeExpandedItems();
 
     /**
@@ -323,6 +938,27 @@ private:
      */
     void emitItemsChangedAndTriggerResorting(const KItemRangeList& itemRanges, const QSet<QByteArray>& changedRoles);
 
+    /**
+     * Remembers the items in \a itemRanges in m_itemsToReposition and starts
+     * m_resortAllItemsTimer. If too many items have changed, all items
+     * are resorted instead.
+     */
+    void startRepositionTimer(const KItemRangeList& itemRanges);
+
+    /**
+     * Moves the items of m_itemsToReposition to their positions in the
+     * otherwise unchanged order of the items. Their positions are found by a
+     * binary search, which is much cheaper than resorting all items.
+     */
+    void repositionItems();
+
+    /**
+     * Separates the directories from the files after enabling
+     * sortDirectoriesFirst(), or merges them after disabling it. Falls back
+     * to resortAllItems() if the items are not sorted or are expanded.
+     */
+    void reorderDirectoriesAndFiles();
+
     /**
      * Resets all values from m_requestRole to false.
      */
@@ -330,22 +966,56 @@ private:
 
     /**
      * @return Role-type for the given role.
-     *         Runtime complexity is O(1).
+     *         Runtime complexity is O(1). May be invoked by any thread.
      */
     RoleType typeForRole(const QByteArray& role) const;
 
     /**
-     * @return Role-byte-array for the given role-type.
-     *         Runtime complexity is O(1).
+     * @return Role-byte-array for the given role-type, which is interned
+     *         by KItemRoleRegistry. Runtime complexity is O(1) without
+     *         hashing. May be invoked by any thread.
      */
-    QByteArray roleForType(RoleType roleType) const;
+    const QByteArray& roleForType(RoleType roleType) const;
 
+    /**
+     * @return Interned names of all role-types, indexed by the role-type.
+     *         The names are determined only once and never change afterwards.
+     */
+    static const QVector<QByteArray>& roleNames();
+
+    /**
+     * @return The role values of \a item that are fast to retrieve. Is
+     *         thread-safe, so that the values of many items can be retrieved
+     *         in parallel, see prepareItemsForSorting().
+     */
     QHash<QByteArray, QVariant> retrieveData(const KFileItem& item, const ItemData* parent) const;
 
     /**
      * @return True if role values benefit from natural or case insensitive sorting.
      */
-    static bool isRoleValueNatural(const RoleType roleType);
+    static constexpr bool isRoleValueNatural(const RoleType roleType);
+
+    /**
+     * @return True if the comparison of items by the role \a roleType only
+     *         reads data that is not modified while sorting, which allows to
+     *         sort the items with multiple threads.
+     */
+    static bool isRoleComparisonReentrant(const RoleType roleType);
+
+    /**
+     * @return True if items are compared by an integer value for the role
+     *         \a roleType, see integerSortRoleValue().
+     */
+    static bool isRoleValueInteger(const RoleType roleType);
+
+    /**
+     * @return Integer value of the sort role for the item-data \a item, which
+     *         allows to sort the items with a radix sort. The order of the
+     *         values is the order of sortRoleCompare() for \a item and other
+     *         items, that have the same parent. For the size role, only
+     *         files are supported.
+     */
+    qint64 integerSortRoleValue(const ItemData* item) const;
 
     /**
      * @return True if \a a has a KFileItem whose text is 'less than' the one
@@ -359,11 +1029,97 @@ private:
      */
     bool lessThan(const ItemData* a, const ItemData* b, const QCollator& collator) const;
 
+    /**
+     * Like lessThan(const ItemData*, const ItemData*, const QCollator&), but
+     * sorts by the order \a order instead of sortOrder().
+     */
+    bool lessThan(const ItemData* a, const ItemData* b, const QCollator& collator, Qt::SortOrder order) const;
+
+    /**
+     * @return True if the item-data \a a should be ordered before the item-data
+     *         \b when only the sort role is compared. Both items must have the
+     *         same parent item and must both be directories or files if the
+     *         directories are sorted first. The items are sorted by the order \a order.
+     */
+    bool sortRoleLessThan(const ItemData* a, const ItemData* b, const QCollator& collator, Qt::SortOrder order) const;
+
     /**
      * Sorts the items between \a begin and \a end using the comparison
-     * function lessThan().
+     * function lessThan(). If \a canceled is set to a non-zero value while
+     * sorting, the sorting is aborted as fast as possible and leaves the
+     * items in an undefined order.
+     */
+    void sort(const QList<ItemData*>::iterator &begin, const QList<ItemData*>::iterator &end,
+              const QAtomicInt* canceled = nullptr) const;
+
+    /**
+     * Sorts like sort() above, but by the sort order \a order and with the
+     * collator \a collator. Is used by the worker thread of startAsyncResort()
+     * with copies of the settings, as they may be changed by the main thread.
+     */
+    void sort(const QList<ItemData*>::iterator &begin, const QList<ItemData*>::iterator &end,
+              const QAtomicInt* canceled, const QCollator& collator, Qt::SortOrder order) const;
+
+    /**
+     * Sorts a copy of m_itemData in a worker thread. The model keeps its
+     * current order until the sorted items are applied in
+     * slotAsyncResortFinished(). Changes of the values of the items that are
+     * done with setData() in the meantime are applied afterwards.
+     */
+    void startAsyncResort();
+
+    /**
+     * Cancels the resorting that has been started by startAsyncResort()
+     * and waits until the worker thread is done. Must be invoked before
+     * the items or the sort settings are changed. The resorting is retried
+     * later with m_resortAllItemsTimer.
+     */
+    void cancelAsyncResort();
+
+    /**
+     * Adds the items that have been listed while resorting in a
+     * worker thread by passing them to slotItemsAdded() again.
+     */
+    void addItemsAddedWhileResorting();
+
+    /**
+     * Starts m_resortAllItemsTimer with the delay that KItemListCostModel
+     * provides for the current number of items. All items are resorted
+     * if the timer has been exceeded.
+     */
+    void startResortTimer();
+
+    /**
+     * @return True if a resorting started by startAsyncResort() is running.
+     */
+    bool isAsyncResortRunning() const;
+
+    /**
+     * Replaces m_itemData by \a sortedItems, which contains the same items
+     * in a different order, and emits itemsMoved() for the moved items.
+     * Only the indexes of the moved items are updated in m_items.
+     */
+    void applySortedItems(const QList<ItemData*>& sortedItems);
+
+    /**
+     * Applies the values that have been passed to setData() while
+     * a resorting was running.
+     */
+    void applyPendingValues();
+
+    /**
+     * Applies the MIME-types that have been determined while
+     * a resorting was running.
+     */
+    void applyPendingMimeTypes();
+
+    /**
+     * Stores \a values as values of the item with the index \a index,
+     * without emitting itemsChanged(). Roles whose values have been
+     * changed are added to \a changedRoles.
+     * @return True if at least one value has been changed.
      */
-    void sort(const QList<ItemData*>::iterator &begin, const QList<ItemData*>::iterator &end) const;
+    bool updateValues(int index, const QHash<QByteArray, QVariant>& values, QSet<QByteArray>& changedRoles);
 
     /**
      * Helper method for lessThan() and expandedParentsCountCompare(): Compares
@@ -372,19 +1128,67 @@ private:
      */
     int sortRoleCompare(const ItemData* a, const ItemData* b, const QCollator& collator) const;
 
+    /**
+     * Compares the items \a a and \a b by the values of \a roleType and
+     * by the fallbacks of compareFallbacks() if the values are equal. An
+     * instance exists for each role, so that the role is not checked again
+     * for each comparison, see roleValueComparator().
+     */
+    template<RoleType roleType>
+    int compareRoleValues(const ItemData* a, const ItemData* b, const QCollator& collator) const;
+
+    /**
+     * Compares the items \a a and \a b by their text, their name and
+     * their URL. The result is only 0 if the URLs are equal.
+     */
+    int compareFallbacks(const ItemData* a, const ItemData* b, const QCollator& collator) const;
+
+    typedef int (KFileItemModel::*RoleValueComparator)(const ItemData*, const ItemData*, const QCollator&) const;
+
+    /**
+     * @return The instance of compareRoleValues() for \a roleType.
+     */
+    static RoleValueComparator roleValueComparator(RoleType roleType);
+
+    template<std::size_t... roleTypes>
+    static constexpr std::array<RoleValueComparator, RolesCount> roleValueComparators(std::index_sequence<roleTypes...>);
+
     int stringCompare(const QString& a, const QString& b, const QCollator& collator) const;
 
-    QList<QPair<int, QVariant> > nameRoleGroups() const;
-    QList<QPair<int, QVariant> > sizeRoleGroups() const;
-    QList<QPair<int, QVariant> > timeRoleGroups(const std::function<QDateTime(const ItemData *)> &fileTimeCb) const;
-    QList<QPair<int, QVariant> > permissionRoleGroups() const;
-    QList<QPair<int, QVariant> > ratingRoleGroups() const;
-    QList<QPair<int, QVariant> > genericStringRoleGroups(const QByteArray& typeForRole) const;
+    /**
+     * @return Value of the group of the item-data \a itemData for the
+     *         current sort role. Subsequent items with equal group values
+     *         are in the same group.
+     */
+    QVariant groupValue(const ItemData* itemData) const;
+
+    QString nameRoleGroupValue(const ItemData* itemData) const;
+    QString sizeRoleGroupValue(const ItemData* itemData) const;
+    QString timeRoleGroupValue(const QDateTime& fileTime) const;
+    QString permissionRoleGroupValue(const ItemData* itemData) const;
+    int ratingRoleGroupValue(const ItemData* itemData) const;
+    QString genericStringRoleGroupValue(const ItemData* itemData, const QByteArray& role) const;
+
+    /**
+     * Updates m_groups after inserting the items \a itemRanges into
+     * m_itemData. Only the group values of the inserted items and their
+     * successors are calculated. Does nothing if m_groups has not been
+     * calculated yet.
+     */
+    void updateGroupsForInsertedItems(const KItemRangeList& itemRanges);
+
+    /**
+     * Updates m_groups after removing the items \a itemRanges from
+     * m_itemData. Only the group values of the successors of the removed
+     * items are calculated. Does nothing if m_groups has not been
+     * calculated yet.
+     */
+    void updateGroupsForRemovedItems(const KItemRangeList& itemRanges);
 
     /**
-     * Helper method for all xxxRoleGroups() methods to check whether the
+     * Helper method for groups() to check whether the
      * item with the given index is a child-item. A child-item is defined
-     * as item having an expansion-level > 0. All xxxRoleGroups() methods
+     * as item having an expansion-level > 0. groups()
      * should skip the grouping if the item is a child-item (although
      * KItemListView would be capable to show sub-groups in groups this
      * results in visual clutter for most usecases).
@@ -399,8 +1203,20 @@ private:
 
     /**
      * Applies the filters set through @ref setNameFilter and @ref setMimeTypeFilters.
+     * If \a checkFilteredItems is false, only the shown items are checked. This
+     * is only valid if the filter has been narrowed, as the hidden items cannot
+     * match then (see KFileItemModelFilter::isNarrowedBy()).
      */
-    void applyFilters();
+    void applyFilters(bool checkFilteredItems = true);
+
+    /**
+     * Helper method for applyFilters(): Checks for each item of \a items whether
+     * it matches with the filters. For large lists the name filter is applied
+     * in parallel by several threads.
+     *
+     * @return Vector of the same size as \a items containing the results.
+     */
+    QVector<bool> filterMatches(const QList<ItemData*>& items) const;
 
     /**
      * Removes filtered items whose expanded parents have been deleted
@@ -408,6 +1224,160 @@ private:
      */
     void removeFilteredChildren(const KItemRangeList& parents);
 
+    /**
+     * Deletes the filtered items for which \a shouldRemove returns true. The
+     * order of the remaining filtered items is kept.
+     */
+    void removeFilteredItems(const std::function<bool(const ItemData*)>& shouldRemove);
+
+    /**
+     * Stores the items of the current directory in m_snapshots,
+     * see setSnapshotsEnabled().
+     */
+    void takeSnapshot();
+
+    /**
+     * Holds back the low priority background tasks of KTaskScheduler
+     * while the directory lister is loading a local folder. The hold is
+     * released when the listing is completed, canceled or has failed,
+     * and after HoldBackBackgroundTasksTimeout ms at the latest.
+     */
+    void setHoldingBackBackgroundTasks(bool holdBack);
+
+    /**
+     * Inserts the items of the snapshot of \a url if the directory
+     * has not been modified since the snapshot has been taken.
+     * Otherwise the items of another model that shows \a url or the
+     * prefetched items of \a url are inserted if available.
+     */
+    void restoreSnapshot(const QUrl& url);
+
+    /**
+     * Inserts the search results that have been prepared by
+     * prepareNarrowedSearch() for \a url.
+     * @return True if the results have been inserted.
+     */
+    bool restoreNarrowedSearch(const QUrl& url);
+    bool restoreSharedItems(const QUrl& url);
+    void restorePrefetchedItems(const QUrl& url);
+
+    /**
+     * @return New item data for the restored item \a item with the role
+     *         values \a values. The item is added to m_unconfirmedRestoredUrls.
+     */
+    ItemData* createRestoredItemData(const KFileItem& item, const QHash<QByteArray, QVariant>& values);
+
+    /**
+     * Removes the restored items of \a items, which have been listed by the
+     * directory lister, from m_unconfirmedRestoredUrls and refreshes the
+     * restored items that have been changed.
+     *
+     * @return Items of \a items that have not been restored.
+     */
+    KFileItemList confirmRestoredItems(const KFileItemList& items);
+
+    /**
+     * Removes the restored items that have not been listed by the directory lister.
+     */
+    void removeUnconfirmedRestoredItems();
+
+    /**
+     * Applies the changed settings of the directory lister. If
+     * \a moreItemsShown is true, the kept items that are shown now are
+     * inserted again, otherwise the items that are not shown anymore are
+     * kept, see setShowHiddenFiles().
+     */
+    void applyDirListerSettings(bool moreItemsShown);
+
+    /**
+     * @return True if the directory lister shows \a item with its current
+     *         settings for hidden files and directories only.
+     */
+    bool isShownByDirLister(const KFileItem& item) const;
+
+    /**
+     * Removes the items of the directory that are not shown by the directory
+     * lister anymore from the model and keeps them in m_keptItems.
+     */
+    void removeItemsNotShown();
+
+    /**
+     * Removes the items of \a items, which have been listed again by the
+     * directory lister after showing more items, from
+     * m_unconfirmedKeptItems.
+     *
+     * @return Items of \a items that must be added as new items.
+     */
+    KFileItemList confirmKeptItems(const KFileItemList& items);
+
+    /**
+     * Inserts the items of m_keptItems that have been confirmed by
+     * confirmKeptItems(), refreshes the ones that have been changed and
+     * deletes the unconfirmed ones. The items that are still not shown
+     * are kept.
+     */
+    void insertKeptItems();
+
+    /**
+     * Inserts the \a items like insertItems(). If the items are in the sorting
+     * order already, like items that have been shown before, they are only
+     * merged into the shown items.
+     */
+    void insertPresortedItems(QList<ItemData*>& items);
+
+    /**
+     * @return The items of \a items1 and \a items2, which must be in the
+     *         sorting order, merged in the sorting order.
+     */
+    QList<ItemData*> mergeSortedItems(const QList<ItemData*>& items1, const QList<ItemData*>& items2) const;
+
+    /**
+     * Sorts the \a items unless they are in the sorting order already. The
+     * filtered items are appended while listing and keep their position
+     * if they are refreshed or if the sorting is changed.
+     */
+    void sortPresortedItems(QList<ItemData*>& items);
+
+    /**
+     * Expands the visible directories of m_urlsToExpand. At most
+     * MaximumParallelExpansions directories are listed at the same time.
+     */
+    void expandPendingDirectories();
+
+    /**
+     * Queues the sub-directories of \a items, which have been listed in the
+     * directory \a directoryUrl, for the recursive listing.
+     */
+    void queueRecursiveDirectories(const QUrl& directoryUrl, const KFileItemList& items);
+
+    /**
+     * Lists the queued sub-directories of the recursive listing. At most
+     * MaximumParallelRecursiveListings directories are listed at the same time.
+     */
+    void listRecursiveDirectories();
+
+    /**
+     * Lets the directory lister forget the sub-directories of
+     * m_recursiveDirsToForget and lists the queued sub-directories. Is
+     * invoked by m_recursiveListingTimer, as KDirLister may not be used
+     * while it emits the items.
+     */
+    void updateRecursiveListing();
+
+    /**
+     * Forgets the sub-directories \a dirs of the recursive listing and all
+     * sub-directories that have been found in them.
+     * @return Indexes of the items that have been listed in \a dirs or in
+     *         their sub-directories. The indexes are not sorted.
+     */
+    QList<int> forgetRecursiveDirectories(const QList<QUrl>& dirs);
+
+    /**
+     * Forgets all sub-directories of the recursive listing. They are
+     * found again while the directory is listed.
+     */
+    void clearRecursiveDirectories();
+
     /**
      * Loads the selected choice of sorting method from Dolphin General Settings
      */
@@ -435,16 +1405,52 @@ private:
     static const RoleInfoMap* rolesInfoMap(int& count);
 
     /**
-     * Determines the MIME-types of all items that can be done within
-     * the given timeout.
+     * Map of the user visible roles in the order of rolesInformation(). The
+     * map is a constant expression, so that the entry of each role type is
+     * determined by the compiler.
+     */
+    static const RoleInfoMap s_rolesInfoMap[];
+
+    /**
+     * @return Name of the user visible role \a roleType as string literal,
+     *         or nullptr for other roles. Runtime complexity is O(1).
+     */
+    static const char* roleTypeName(RoleType roleType);
+
+    /**
+     * Determines the MIME-types of all remote items that can be done within
+     * the given timeout. The MIME-types of local files are determined by
+     * m_mimeTypeResolver after the items have been inserted.
      */
     static void determineMimeTypes(const KFileItemList& items, int timeout);
 
     /**
-     * @return Returns a copy of \a value that is implicitly shared
-     * with other users to save memory.
+     * @return A copy of \a value that shares its data with all equal strings
+     *         returned before. Is used for role values that are equal for
+     *         many items, like the type or the icon name, so that each
+     *         distinct string is stored only once instead of once per item.
      */
-    static QByteArray sharedValue(const QByteArray& value);
+    QString sharedString(const QString& value) const;
+
+    /**
+     * @return The mutex that protects the shared values, or nullptr if
+     *         the values are only used by the main thread right now.
+     */
+    QMutex* sharedValuesMutex() const;
+
+    /**
+     * @return The names of the owner and of the group of \a item. The names
+     *         of the user and group IDs are looked up only once per model.
+     */
+    QString userName(const KFileItem& item) const;
+    QString groupName(const KFileItem& item) const;
+
+    /**
+     * @return True if the icon theme contains the icon \a iconName. The
+     *         result is remembered, as the lookup is expensive and QIcon
+     *         may not be used by several threads at once.
+     */
+    bool hasThemeIcon(const QString& iconName) const;
 
     /**
      * Checks if the model's internal data structures are consistent.
@@ -457,31 +1463,156 @@ private:
     QCollator m_collator;
     bool m_naturalSorting;
     bool m_sortDirsFirst;
+    qint64 m_sortingMemoryLimit;
+    // False if the collation keys are omitted to stay below m_sortingMemoryLimit
+    bool m_sortKeysAllowed;
 
     RoleType m_sortRole;
+    RoleValueComparator m_sortRoleComparator; // Instance of compareRoleValues() for m_sortRole
     int m_sortingProgressPercent; // Value of directorySortingProgress() signal
     QSet<QByteArray> m_roles;
 
+    // Owns the memory of all ItemData instances. Allocating the item-data
+    // from slabs prevents malloc churn when loading huge directories, and
+    // slotClear() can release all of them at once.
+    KItemSlabPool<ItemData> m_itemDataPool;
+
     QList<ItemData*> m_itemData;
 
+    // Role values of all items (including the filtered and pending ones),
+    // indexed by ItemData::slot.
+    KFileItemModelRoleStore m_roleStore;
+
     // m_items is a cache for the method index(const QUrl&). If it contains N
     // entries, it is guaranteed that these correspond to the first N items in
     // the model, i.e., that (for every i between 0 and N - 1)
-    // m_items.value(fileItem(i).url()) == i
-    mutable QHash<QUrl, int> m_items;
+    // m_items.value(urlKey(fileItem(i).url())) == i
+    mutable QHash<UrlKey, int> m_items;
+
+    // Item-data of all items (including the filtered and pending ones) by
+    // ItemData::id. The identifier 0 is never assigned.
+    QHash<quint32, ItemData*> m_itemDataById;
+    quint32 m_nextItemId;
 
     KFileItemModelFilter m_filter;
-    QHash<KFileItem, ItemData*> m_filteredItems; // Items that got hidden by KFileItemModel::setNameFilter()
+    // Items that got hidden by KFileItemModel::setNameFilter() or setMimeTypeFilters().
+    // They are in the sorting order, unless they have been added to the directory
+    // or the sorting has been changed while they have been filtered, so that
+    // showing them again is usually a merge without sorting.
+    QList<ItemData*> m_filteredItems;
+
+    // Items of the directory in their sorting order, which are kept while the
+    // hidden files or the files are not shown, and the indexes of the kept
+    // items that have not been listed again while showing them.
+    QList<ItemData*> m_keptItems;
+    QHash<QUrl, int> m_unconfirmedKeptItems;
+    // Kept items that have been listed again with changed entries
+    QList<QPair<KFileItem, KFileItem> > m_changedKeptItems;
+
+    // Names of the shown items for indexForKeyboardSearch(). It is built
+    // on demand and cleared as soon as the items or their names change.
+    mutable KFileItemModelPrefixIndex m_prefixIndex;
 
     bool m_requestRole[RolesCount];
 
     QTimer* m_maximumUpdateIntervalTimer;
+    int m_visibleItemCountHint;
+
+    // While search results or the items of a huge directory are received,
+    // all items behind the first m_rankedItemCount items rank lower. The
+    // lower ranked search results are kept sorted, the lower ranked items of
+    // a huge directory are appended. It is -1 if the items are not ranked.
+    bool m_searchModeEnabled;
+    int m_rankedItemCount;
+
+    // Set while a directory with more than HugeDirectoryItemsLimit items is
+    // listed. The items are inserted like search results in this case.
+    bool m_hugeDirectory;
+    int m_estimatedItemCount;
+    int m_expectedItemCount; // Used by the next loadDirectory()
+    int m_listedItemCount;
+    KIO::filesize_t m_listedFilesSize;
+
+    // Collects the changes of the listed directories for the interval of
+    // m_changeCoalescingTimer, or as long as m_changesDeferred is set.
+    // m_listing is set while directories are loaded.
+    KFileItemModelChangeCoalescer m_changeCoalescer;
+    QTimer* m_changeCoalescingTimer;
+    bool m_changesDeferred;
+    bool m_listing;
+    bool m_holdingBackBackgroundTasks;
+    QTimer* m_holdBackBackgroundTasksTimer;
+    // True while refreshDirectory() keeps the items, which are cleared by the directory lister
+    bool m_keepItemsOnClear;
+    // True while the items kept by refreshDirectory() are listed again. If
+    // the listing fails, the items that have not been listed are removed.
+    bool m_reloadingKeptItems;
+
+    // Start of the loading of the directory for KItemListTracer,
+    // -1 if the tracing is disabled.
+    qint64 m_loadingTraceStart;
+    bool m_firstItemsTraced;
+
     QTimer* m_resortAllItemsTimer;
+
+    // Items whose sort role values have changed. If m_repositionItemsOnly
+    // is true, only these items are moved when m_resortAllItemsTimer has
+    // been exceeded, see repositionItems().
+    QSet<ItemData*> m_itemsToReposition;
+    bool m_repositionItemsOnly;
+
+    // True if m_resortAllItemsTimer has been exceeded while the
+    // resortings are deferred, see setResortingDeferred().
+    bool m_resortingDeferred;
+    bool m_deferredResortPending;
+    int m_resortProgressThreshold;
+    // True while the items are resorted because of changed values, see
+    // isMovingItemsInBackground(). The asynchronous resorting keeps the
+    // value with which it has been started.
+    bool m_movingItemsInBackground;
+    bool m_asyncResortInBackground;
+
+    // Watches the resorting in a worker thread, see startAsyncResort().
+    QFutureWatcher<QList<ItemData*> >* m_asyncResortWatcher;
+    QAtomicInt m_asyncResortCanceled;
+    bool m_asyncResortRunning;
+    qint64 m_asyncResortDuration; // Time in ns the worker thread needed for the last resorting
+    // Values that have been passed to setData() while resorting
+    QList<QPair<ItemData*, QHash<QByteArray, QVariant> > > m_pendingValues;
+    // Items that have been listed while resorting, with the URLs of their
+    // directories, and their number. See slotItemsAdded().
+    QList<QPair<QUrl, KFileItemList> > m_itemsAddedWhileResorting;
+    int m_itemsAddedWhileResortingCount;
     QList<ItemData*> m_pendingItemsToInsert;
+    // End indexes of the sorted runs of m_pendingItemsToInsert, see presortPendingItems()
+    QVector<int> m_pendingRunEnds;
+
+    KFileItemMimeTypeResolver* m_mimeTypeResolver;
+    // MIME-types that have been determined while resorting
+    QHash<QUrl, QString> m_pendingMimeTypes;
 
     // Cache for KFileItemModel::groups()
     mutable QList<QPair<int, QVariant> > m_groups;
 
+    // Memoized group values, see nameRoleGroupValue(), timeRoleGroupValue()
+    // and permissionRoleGroupValue(). The time group values are relative
+    // to m_timeGroupValuesDate.
+    mutable QHash<QChar, QString> m_nameGroupValues;
+    mutable QHash<QDate, QString> m_timeGroupValues;
+    mutable QDate m_timeGroupValuesDate;
+    mutable QHash<QString, QString> m_permissionGroupValues;
+
+    // Strings that are shared by the role values of the items, see sharedString(),
+    // the names of the user and group IDs and the icons of the theme that exist.
+    // They are protected by m_sharedValuesMutex while they are also used by the
+    // threads of prepareItemsForSorting(), see sharedValuesMutex().
+    mutable QSet<QString> m_sharedStrings;
+    mutable QHash<qint64, QString> m_userNames;
+    mutable QHash<qint64, QString> m_groupNames;
+    mutable QHash<QString, bool> m_themeIcons;
+    mutable QMutex m_sharedValuesMutex;
+    bool m_retrievingDataInParallel;
+
     // Stores the URLs (key: target url, value: url) of the expanded directories.
     QHash<QUrl, QUrl> m_expandedDirs;
 
@@ -489,14 +1620,89 @@ private:
     // and done step after step in slotCompleted().
     QSet<QUrl> m_urlsToExpand;
 
+    // URLs of the expanded directories whose listing has not been completed yet
+    QSet<QUrl> m_expandingDirs;
+
+    bool m_recursiveListing;
+    int m_recursiveListingDepth;
+    // Levels below the directory of the sub-directories that have been
+    // queued or listed by the recursive listing, with the URLs as keys
+    QHash<QUrl, int> m_recursiveDirs;
+    // Sub-directories that must be listed, in the order they have been found
+    QList<QUrl> m_recursiveDirsToList;
+    // Sub-directories whose listing has not been completed yet
+    QSet<QUrl> m_listingRecursiveDirs;
+    // Listed sub-directories whose changes are watched by the directory
+    // lister, at most MaximumWatchedRecursiveDirs
+    QSet<QUrl> m_watchedRecursiveDirs;
+    // Listed sub-directories that the directory lister must forget
+    QList<QUrl> m_recursiveDirsToForget;
+    // Is set if the directory lister has forgotten sub-directories
+    bool m_recursiveDirsForgotten;
+    QTimer* m_recursiveListingTimer;
+
+    struct Snapshot
+    {
+        QDateTime directoryModificationTime;
+        QByteArray context;
+        bool hiddenFilesShown;
+        QString nameFilter;
+        QStringList mimeTypeFilters;
+        QVector<QPair<KFileItem, QHash<QByteArray, QVariant> > > items;
+        int cost;   // Estimated size in KiB
+    };
+
+    /**
+     * Keeps the snapshots that have been retained by retainSnapshot().
+     * Is owned by the application and accounted by KMemoryBudget.
+     */
+    class RetainedSnapshots;
+
+    /**
+     * @return Snapshots that have been retained by retainSnapshot(), or
+     *         nullptr if there is no application or it is about to quit.
+     */
+    static RetainedSnapshots* retainedSnapshots();
+
+    /**
+     * @return True if the items of \a snapshot can be used for a listing of
+     *         its directory \a dirUrl that includes the hidden files if
+     *         \a includeHiddenFiles is true, see cachedListing().
+     */
+    static bool isUsableForListing(const Snapshot* snapshot, const QUrl& dirUrl, bool includeHiddenFiles);
+
+    // Snapshots of the recently shown directories. The cost is the
+    // estimated size in KiB.
+    QCache<QUrl, Snapshot> m_snapshots;
+    QByteArray m_snapshotContext;
+    // Restored items that have not been listed by the directory lister yet
+    QSet<QUrl> m_unconfirmedRestoredUrls;
+    KFileItemList m_restoredItems;
+
+    // Search results kept by cacheSearchResults() and the
+    // results prepared by prepareNarrowedSearch()
+    QScopedPointer<Snapshot> m_cachedSearchResults;
+    QUrl m_cachedSearchResultsUrl;
+    QUrl m_narrowedSearchUrl;
+    QVector<QPair<KFileItem, QHash<QByteArray, QVariant> > > m_narrowedSearchItems;
+
+    // Is created by the first invocation of itemsSnapshot()
+    mutable KFileItemModelSnapshotTracker* m_itemsSnapshotTracker;
+
     friend class KFileItemModelRolesUpdater;   // Accesses emitSortProgress() method
+    friend class KFileItemModelSnapshotTracker; // Reads m_itemData and m_roleStore
     friend class KFileItemModelTest;           // For unit testing
     friend class KFileItemModelBenchmark;      // For unit testing
+    friend class KFileItemModelOperationsBenchmark; // For benchmarking
+    friend class BenchmarkHelpers;             // For benchmarking
+    friend class KFileItemModelReplayBenchmark; // For benchmarking
+    friend class KFileItemModelComparatorBenchmark; // For benchmarking
+    friend class KFileItemModelPreviewBenchmark; // For benchmarking
     friend class KFileItemListViewTest;        // For unit testing
     friend class DolphinPart;                  // Accesses m_dirLister
 };
 
-inline bool KFileItemModel::isRoleValueNatural(RoleType roleType)
+constexpr bool KFileItemModel::isRoleValueNatural(RoleType roleType)
 {
     return (roleType == TypeRole ||
             roleType == TagsRole ||
@@ -512,11 +1718,59 @@ inline bool KFileItemModel::isRoleValueNatural(RoleType roleType)
             roleType == GroupRole);
 }
 
+inline bool KFileItemModel::isRoleComparisonReentrant(RoleType roleType)
+{
+    // These roles are either compared by using values from m_roleStore, or
+    // by comparing strings. KFileItemModel::stringCompare() serializes the
+    // calls of QCollator::compare().
+    return (roleType == NameRole ||
+            roleType == SizeRole ||
+            roleType == ModificationTimeRole ||
+            roleType == CreationTimeRole ||
+            roleType == AccessTimeRole ||
+            roleType == PermissionsRole ||
+            isRoleValueNatural(roleType));
+}
+
+inline bool KFileItemModel::isRoleValueInteger(RoleType roleType)
+{
+    return (roleType == SizeRole ||
+            roleType == ModificationTimeRole ||
+            roleType == CreationTimeRole ||
+            roleType == AccessTimeRole ||
+            roleType == DeletionTimeRole);
+}
+
 inline bool KFileItemModel::nameLessThan(const ItemData* a, const ItemData* b)
 {
     return a->item.text() < b->item.text();
 }
 
+inline qint64 KFileItemModel::int64RoleValue(const ItemData* data, KFileItemModelRoleStore::Int64Column column) const
+{
+    return m_roleStore.int64(data->slot, column);
+}
+
+inline const QString& KFileItemModel::stringRoleValue(const ItemData* data, KFileItemModelRoleStore::StringColumn column) const
+{
+    return m_roleStore.string(data->slot, column);
+}
+
+inline void KFileItemModel::updateUrlHash(ItemData* data)
+{
+    data->urlHash = qHash(data->item.url());
+}
+
+inline KFileItemModel::UrlKey KFileItemModel::urlKey(const ItemData* data)
+{
+    return UrlKey{data->item.url(), data->urlHash};
+}
+
+inline KFileItemModel::UrlKey KFileItemModel::urlKey(const QUrl& url)
+{
+    return UrlKey{url, qHash(url)};
+}
+
 inline bool KFileItemModel::isChildItem(int index) const
 {
     if (m_itemData.at(index)->parent) {
@@ -7,8 +7,18 @@
 #include "kfileitemmodelrolesupdater.h"
 
 #include "kfileitemmodel.h"
+#include "dolphindebug.h"
 #include "private/kdirectorycontentscounter.h"
+#include "private/kiogovernor.h"
+#include "private/kitemlistcostmodel.h"
+#include "private/kitemlistmetrics.h"
+#include "private/kitemlisttracer.h"
+#include "private/kitemroleregistry.h"
+#include "private/koverlayiconresolver.h"
 #include "private/kpixmapmodifier.h"
+#include "private/kpluginregistry.h"
+#include "private/kpreviewcache.h"
+#include "private/kpreviewjoblimiter.h"
 
 #include <KConfig>
 #include <KConfigGroup>
@@ -16,65 +26,155 @@
 #include <KIO/PreviewJob>
 #include <KIconLoader>
 #include <KJobWidgets>
-#include <KOverlayIconPlugin>
-#include <KPluginLoader>
 #include <KSharedConfig>
 
 #ifdef HAVE_BALOO
 #include "private/kbaloorolesprovider.h"
-#include <Baloo/File>
 #include <Baloo/FileMonitor>
 #endif
 
 #include <QApplication>
+#include <QCache>
+#include <QDateTime>
 #include <QIcon>
 #include <QPainter>
 #include <QElapsedTimer>
 #include <QTimer>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <numeric>
 
 // #define KFILEITEMMODELROLESUPDATER_DEBUG
 
 namespace {
-    // Maximum time in ms that the KFileItemModelRolesUpdater
-    // may perform a blocking operation
-    const int MaxBlockTimeout = 200;
-
-    // If the number of items is smaller than ResolveAllItemsLimit,
-    // the roles of all items will be resolved.
-    const int ResolveAllItemsLimit = 500;
+    // The maximum time that the KFileItemModelRolesUpdater may perform a
+    // blocking operation, and the number of items up to which the roles of
+    // all items are resolved, are provided by KItemListCostModel.
 
     // Not only the visible area, but up to ReadAheadPages before and after
     // this area will be resolved.
     const int ReadAheadPages = 5;
+
+    // Scroll velocity in visible pages per second, above which only the
+    // visible items and the next page in scroll direction are resolved.
+    const qreal FastScrollVelocity = 2.0;
+
+    // Default number of preview jobs that a KFileItemModelRolesUpdater runs
+    // in parallel. The number of preview jobs of all roles updaters is
+    // limited by KPreviewJobLimiter.
+    const int DefaultMaximumPreviewJobs = 4;
+
+    // Interval in ms in which resolved role values are applied to the
+    // model. Corresponds to one frame at 60 Hz.
+    const int PendingRoleValuesInterval = 16;
+
+    // Sizes in device pixels of the previews that are requested from
+    // KIO::PreviewJob. The size is doubled from the minimum size until it
+    // covers the icon size.
+    const int MinimumPreviewCacheSize = 128;
+    const int MaximumPreviewCacheSize = 1024;
+
+    // Factors by which the previews may be stretched after changing the
+    // icon size before new previews are created. Downscaling keeps the
+    // quality, but wastes memory for larger factors. The item widgets
+    // don't upscale previews beyond the size they have been created for,
+    // so zooming in always requires new previews.
+    const qreal MinimumPreviewStretch = 0.5;
+    const qreal MaximumPreviewStretch = 1.0;
+
+    // Maximum number of frames of the thumbnail sequence of a hovered video
+    const int SequenceFrameCount = 8;
+
+    // Time in ms after which a preview job that has not received a preview
+    // is considered to hang on its current file, and the interval in ms in
+    // which the preview jobs are checked
+    const int PreviewTimeout = 10000;
+    const int StalledPreviewJobsInterval = 1000;
+
+    // Factor by which the timeout is extended for files that are downloaded
+    // by the preview job or are on a mount classified as slow by KIoGovernor
+    const int SlowPreviewTimeoutFactor = 6;
+
+    // Files whose preview has timed out, with their modification time. A
+    // file is skipped by all roles updaters of the process after its preview
+    // has timed out MaximumPreviewTimeouts times, until it is modified or its
+    // entry has expired after TimedOutPreviewLifetime ms. At most
+    // MaximumTimedOutPreviews files are remembered.
+    struct TimedOutPreview
+    {
+        QDateTime modificationTime;
+        QElapsedTimer lastTimeout;
+        int count;
+    };
+    typedef QCache<QUrl, TimedOutPreview> TimedOutPreviewCache;
+
+    const int MaximumPreviewTimeouts = 2;
+    const qint64 TimedOutPreviewLifetime = 30 * 60 * 1000;
+    const int MaximumTimedOutPreviews = 1000;
+
+    // Estimated memory in bytes of an entry of the sets and lists of pending
+    // items, which share the data of the items with the model, and of a
+    // pending role value. They are only used for KMemoryBudget.
+    const int PendingItemCost = 32;
+    const int PendingRoleValueCost = 48;
 }
 
+Q_GLOBAL_STATIC_WITH_ARGS(TimedOutPreviewCache, s_timedOutPreviews, (MaximumTimedOutPreviews))
+
 KFileItemModelRolesUpdater::KFileItemModelRolesUpdater(KFileItemModel* model, QObject* parent) :
     QObject(parent),
     m_state(Idle),
+    m_updatingTraceStart(-1),
     m_previewChangedDuringPausing(false),
     m_iconSizeChangedDuringPausing(false),
     m_rolesChangedDuringPausing(false),
     m_previewShown(false),
     m_enlargeSmallPreviews(true),
     m_clearPreviews(false),
-    m_finishedItems(),
+    m_itemStates(model ? model->count() : 0),
     m_model(model),
     m_iconSize(),
+    m_devicePixelRatio(qApp->devicePixelRatio()),
+    m_previewsIconSize(),
     m_firstVisibleIndex(0),
     m_lastVisibleIndex(-1),
+    m_firstTargetIndex(0),
+    m_lastTargetIndex(-1),
     m_maximumVisibleItems(50),
+    m_scrollVelocity(0),
+    m_scrollingBackward(false),
     m_roles(),
     m_resolvableRoles(),
     m_enabledPlugins(),
     m_localFileSizePreviewLimit(0),
     m_scanDirectories(true),
-    m_pendingSortRoleItems(),
+    m_lowPriority(false),
     m_pendingIndexes(),
     m_pendingPreviewItems(),
-    m_previewJob(),
+    m_maximumPreviewJobs(DefaultMaximumPreviewJobs),
+    m_previewJobs(),
+    m_previewTimer(),
+    m_previewTime(0),
+    m_previewCount(0),
+    m_previewJobProgress(),
+    m_stalledPreviewJobsTimer(nullptr),
+    m_sequenceItem(),
+    m_sequenceJob(nullptr),
+    m_sequenceJobTimer(),
+    m_sequenceFrames(),
+    m_sequenceJobPending(false),
+    m_sequenceApplied(false),
+    m_previewJobItems(),
+    m_previewGeneration(0),
+    m_receivedPreviews(),
+    m_processingPreviews(),
+    m_processingPreviewsGeneration(0),
+    m_previewProcessingWatcher(nullptr),
     m_recentlyChangedItemsTimer(nullptr),
-    m_recentlyChangedItems(),
-    m_changedItems(),
+    m_updateOnItemsMoved(true),
+    m_pendingRoleValues(),
+    m_pendingRoleValuesTimer(nullptr),
     m_directoryContentsCounter(nullptr)
   #ifdef HAVE_BALOO
    , m_balooFileMonitor(nullptr)
@@ -83,8 +183,9 @@ KFileItemModelRolesUpdater::KFileItemModelRolesUpdater(KFileItemModel* model, QO
     Q_ASSERT(model);
 
     const KConfigGroup globalConfig(KSharedConfig::openConfig(), "PreviewSettings");
-    m_enabledPlugins = globalConfig.readEntry("Plugins", KIO::PreviewJob::defaultPlugins());
+    m_enabledPlugins = globalConfig.readEntry("Plugins", KPluginRegistry::instance().defaultPreviewPlugins());
     m_localFileSizePreviewLimit = static_cast<qulonglong>(globalConfig.readEntry("MaximumSize", 0));
+    m_maximumPreviewJobs = qMax(1, globalConfig.readEntry("MaximumConcurrentJobs", DefaultMaximumPreviewJobs));
 
     connect(m_model, &KFileItemModel::itemsInserted,
             this,    &KFileItemModelRolesUpdater::slotItemsInserted);
@@ -104,6 +205,15 @@ KFileItemModelRolesUpdater::KFileItemModelRolesUpdater(KFileItemModel* model, QO
     m_recentlyChangedItemsTimer->setSingleShot(true);
     connect(m_recentlyChangedItemsTimer, &QTimer::timeout, this, &KFileItemModelRolesUpdater::resolveRecentlyChangedItems);
 
+    m_pendingRoleValuesTimer = new QTimer(this);
+    m_pendingRoleValuesTimer->setInterval(PendingRoleValuesInterval);
+    m_pendingRoleValuesTimer->setSingleShot(true);
+    connect(m_pendingRoleValuesTimer, &QTimer::timeout, this, &KFileItemModelRolesUpdater::applyPendingRoleValues);
+
+    m_stalledPreviewJobsTimer = new QTimer(this);
+    m_stalledPreviewJobsTimer->setInterval(StalledPreviewJobsInterval);
+    connect(m_stalledPreviewJobsTimer, &QTimer::timeout, this, &KFileItemModelRolesUpdater::slotCheckStalledPreviewJobs);
+
     m_resolvableRoles.insert("size");
     m_resolvableRoles.insert("type");
     m_resolvableRoles.insert("isExpandable");
@@ -111,40 +221,66 @@ KFileItemModelRolesUpdater::KFileItemModelRolesUpdater(KFileItemModel* model, QO
     m_resolvableRoles += KBalooRolesProvider::instance().roles();
 #endif
 
+    m_previewProcessingWatcher = new QFutureWatcher<void>(this);
+    connect(m_previewProcessingWatcher, &QFutureWatcher<void>::finished,
+            this, &KFileItemModelRolesUpdater::slotPreviewsProcessed);
+
+    // Use a queued connection, so that a roles updater that releases a
+    // preview job is not reentered.
+    connect(&KPreviewJobLimiter::instance(), &KPreviewJobLimiter::released,
+            this, &KFileItemModelRolesUpdater::slotPreviewJobsReleased, Qt::QueuedConnection);
+
+    // The mounts are classified by worker threads
+    connect(&KIoGovernor::instance(), &KIoGovernor::slowMountsChanged,
+            this, &KFileItemModelRolesUpdater::slotSlowMountsChanged, Qt::QueuedConnection);
+
     m_directoryContentsCounter = new KDirectoryContentsCounter(m_model, this);
     connect(m_directoryContentsCounter, &KDirectoryContentsCounter::result,
             this,                       &KFileItemModelRolesUpdater::slotDirectoryContentsCountReceived);
 
-    const auto plugins = KPluginLoader::instantiatePlugins(QStringLiteral("kf5/overlayicon"), nullptr, qApp);
-    for (QObject *it : plugins) {
-        auto plugin = qobject_cast<KOverlayIconPlugin*>(it);
-        if (plugin) {
-            m_overlayIconsPlugin.append(plugin);
-            connect(plugin, &KOverlayIconPlugin::overlaysChanged, this, &KFileItemModelRolesUpdater::slotOverlaysChanged);
-        } else {
-            // not our/valid plugin, so delete the created object
-            it->deleteLater();
-        }
-    }
+    connect(&KOverlayIconResolver::instance(), &KOverlayIconResolver::overlaysResolved,
+            this, &KFileItemModelRolesUpdater::slotOverlaysResolved);
+
+    updateSnapshotContext();
 }
 
 KFileItemModelRolesUpdater::~KFileItemModelRolesUpdater()
 {
-    killPreviewJob();
+    killPreviewJobs();
+
+    // The model may not be changed anymore while the view is destroyed
+    m_sequenceApplied = false;
+    stopHoverSequence();
+
+    // The worker threads may not access m_processingPreviews anymore
+    // after it has been destroyed.
+    m_previewProcessingWatcher->cancel();
+    m_previewProcessingWatcher->waitForFinished();
 }
 
 void KFileItemModelRolesUpdater::setIconSize(const QSize& size)
 {
     if (size != m_iconSize) {
         m_iconSize = size;
+        stopHoverSequence();
+        if (m_previewShown && !iconSizeRequiresNewPreviews()) {
+            // The item widgets shrink the shown previews to the new icon
+            // size. Previews that are created from now on get the new size.
+            updateSnapshotContext();
+            return;
+        }
+
+        m_previewsIconSize = size;
+        ++m_previewGeneration;
         if (m_state == Paused) {
             m_iconSizeChangedDuringPausing = true;
         } else if (m_previewShown) {
             // An icon size change requires the regenerating of
             // all previews
-            m_finishedItems.clear();
+            m_itemStates.clearFlag(FinishedItem);
             startUpdating();
         }
+        updateSnapshotContext();
     }
 }
 
@@ -153,6 +289,32 @@ QSize KFileItemModelRolesUpdater::iconSize() const
     return m_iconSize;
 }
 
+void KFileItemModelRolesUpdater::setDevicePixelRatio(qreal dpr)
+{
+    if (dpr == m_devicePixelRatio) {
+        return;
+    }
+
+    m_devicePixelRatio = dpr;
+    stopHoverSequence();
+    ++m_previewGeneration;
+    if (m_state == Paused) {
+        m_iconSizeChangedDuringPausing = true;
+    } else if (m_previewShown) {
+        // The previews must be scaled again for the new device pixel ratio.
+        // Previews that are still available in a sufficient size are
+        // taken from KPreviewCache without starting a preview job.
+        m_itemStates.clearFlag(FinishedItem);
+        startUpdating();
+    }
+    updateSnapshotContext();
+}
+
+qreal KFileItemModelRolesUpdater::devicePixelRatio() const
+{
+    return m_devicePixelRatio;
+}
+
 void KFileItemModelRolesUpdater::setVisibleIndexRange(int index, int count)
 {
     if (index < 0) {
@@ -170,7 +332,14 @@ void KFileItemModelRolesUpdater::setVisibleIndexRange(int index, int count)
     m_firstVisibleIndex = index;
     m_lastVisibleIndex = qMin(index + count - 1, m_model->count() - 1);
 
-    startUpdating();
+    if (m_firstTargetIndex >= m_firstVisibleIndex && m_lastTargetIndex <= m_lastVisibleIndex) {
+        // The target of the scroll animation has been reached
+        resetTargetIndexRange();
+    }
+
+    // Previews of items that are still visible don't need to be
+    // generated again from scratch.
+    startUpdating(KeepVisiblePreviews);
 }
 
 void KFileItemModelRolesUpdater::setMaximumVisibleItems(int count)
@@ -178,6 +347,50 @@ void KFileItemModelRolesUpdater::setMaximumVisibleItems(int count)
     m_maximumVisibleItems = count;
 }
 
+void KFileItemModelRolesUpdater::setTargetIndexRange(int index, int count)
+{
+    int firstIndex = qMax(0, index);
+    int lastIndex = qMin(index + count - 1, m_model->count() - 1);
+    if (firstIndex >= m_firstVisibleIndex && lastIndex <= m_lastVisibleIndex) {
+        firstIndex = 0;
+        lastIndex = -1;
+    }
+
+    if (firstIndex == m_firstTargetIndex && lastIndex == m_lastTargetIndex) {
+        return;
+    }
+
+    m_firstTargetIndex = firstIndex;
+    m_lastTargetIndex = lastIndex;
+
+    // Reschedule the pending items, so that the items of the target
+    // range are resolved first.
+    startUpdating(KeepVisiblePreviews);
+}
+
+void KFileItemModelRolesUpdater::setScrollVelocity(qreal velocity)
+{
+    m_scrollVelocity = velocity;
+    if (velocity != 0) {
+        m_scrollingBackward = (velocity < 0);
+    } else if (m_lastTargetIndex >= 0) {
+        // The scrolling has been stopped before the target of the scroll
+        // animation has been reached.
+        resetTargetIndexRange();
+        startUpdating(KeepVisiblePreviews);
+    }
+}
+
+qreal KFileItemModelRolesUpdater::scrollVelocity() const
+{
+    return m_scrollVelocity;
+}
+
+bool KFileItemModelRolesUpdater::isScrollingFast() const
+{
+    return qAbs(m_scrollVelocity) >= FastScrollVelocity;
+}
+
 void KFileItemModelRolesUpdater::setPreviewsShown(bool show)
 {
     if (show == m_previewShown) {
@@ -185,6 +398,7 @@ void KFileItemModelRolesUpdater::setPreviewsShown(bool show)
     }
 
     m_previewShown = show;
+    updateSnapshotContext();
     if (!show) {
         m_clearPreviews = true;
     }
@@ -201,6 +415,7 @@ void KFileItemModelRolesUpdater::setEnlargeSmallPreviews(bool enlarge)
 {
     if (enlarge != m_enlargeSmallPreviews) {
         m_enlargeSmallPreviews = enlarge;
+        updateSnapshotContext();
         if (m_previewShown) {
             updateAllPreviews();
         }
@@ -216,6 +431,7 @@ void KFileItemModelRolesUpdater::setEnabledPlugins(const QStringList& list)
 {
     if (m_enabledPlugins != list) {
         m_enabledPlugins = list;
+        updateSnapshotContext();
         if (m_previewShown) {
             updateAllPreviews();
         }
@@ -228,29 +444,38 @@ void KFileItemModelRolesUpdater::setPaused(bool paused)
         return;
     }
 
+    // Directories that have been changed while being paused
+    // are counted once after the updating has been continued
+    m_directoryContentsCounter->setPaused(paused);
+
     if (paused) {
-        m_state = Paused;
-        killPreviewJob();
+        setState(Paused);
+        killPreviewJobs();
+        stopHoverSequence();
     } else {
         const bool updatePreviews = (m_iconSizeChangedDuringPausing && m_previewShown) ||
                                     m_previewChangedDuringPausing;
         const bool resolveAll = updatePreviews || m_rolesChangedDuringPausing;
         if (resolveAll) {
-            m_finishedItems.clear();
+            m_itemStates.clearFlag(FinishedItem);
         }
 
         m_iconSizeChangedDuringPausing = false;
         m_previewChangedDuringPausing = false;
         m_rolesChangedDuringPausing = false;
 
-        if (!m_pendingSortRoleItems.isEmpty()) {
-            m_state = ResolvingSortRole;
+        if (m_itemStates.flagCount(PendingSortRoleItem) > 0) {
+            setState(ResolvingSortRole);
             resolveNextSortRole();
         } else {
-            m_state = Idle;
+            setState(Idle);
         }
 
         startUpdating();
+
+        // The items that have been changed while being paused are
+        // resolved once, independent from the number of changes
+        updateChangedItems();
     }
 }
 
@@ -258,6 +483,7 @@ void KFileItemModelRolesUpdater::setRoles(const QSet<QByteArray>& roles)
 {
     if (m_roles != roles) {
         m_roles = roles;
+        updateSnapshotContext();
 
 #ifdef HAVE_BALOO
         // Check whether there is at least one role that must be resolved
@@ -311,6 +537,7 @@ QStringList KFileItemModelRolesUpdater::enabledPlugins() const
 void KFileItemModelRolesUpdater::setLocalFileSizePreviewLimit(const qlonglong size)
 {
     m_localFileSizePreviewLimit = size;
+    updateSnapshotContext();
 }
 
 qlonglong KFileItemModelRolesUpdater::localFileSizePreviewLimit() const
@@ -321,6 +548,7 @@ qlonglong KFileItemModelRolesUpdater::localFileSizePreviewLimit() const
 void KFileItemModelRolesUpdater::setScanDirectories(bool enabled)
 {
     m_scanDirectories = enabled;
+    updateSnapshotContext();
 }
 
 bool KFileItemModelRolesUpdater::scanDirectories() const
@@ -328,10 +556,197 @@ bool KFileItemModelRolesUpdater::scanDirectories() const
     return m_scanDirectories;
 }
 
+void KFileItemModelRolesUpdater::setLowPriority(bool lowPriority)
+{
+    if (m_lowPriority == lowPriority) {
+        return;
+    }
+
+    m_lowPriority = lowPriority;
+    if (!lowPriority) {
+        // Resolve the items around the visible range that have been skipped
+        startUpdating(KeepVisiblePreviews);
+    }
+}
+
+bool KFileItemModelRolesUpdater::isLowPriority() const
+{
+    return m_lowPriority;
+}
+
+void KFileItemModelRolesUpdater::setHoverSequenceItem(const KFileItem& item)
+{
+    if (item == m_sequenceItem) {
+        return;
+    }
+
+    // Determining the MIME type from the content may block, so only
+    // the already known or the extension based type is used
+    stopHoverSequence();
+    if (item.isNull() || !m_previewShown || m_state == Paused
+        || !item.currentMimeType().name().startsWith(QLatin1String("video/"))) {
+        return;
+    }
+
+    m_sequenceItem = item;
+
+    int frameCount = 0;
+    const QImage strip = KPreviewCache::instance().findSequence(item, sequenceFrameSize(), m_enabledPlugins, &frameCount);
+    if (!strip.isNull()) {
+        applyHoverSequence(strip, frameCount);
+        return;
+    }
+
+    startSequenceJob();
+}
+
+int KFileItemModelRolesUpdater::averagePreviewTime() const
+{
+    if (m_previewCount == 0) {
+        return -1;
+    }
+
+    qint64 time = m_previewTime;
+    if (m_state == PreviewJobRunning) {
+        time += m_previewTimer.elapsed();
+    }
+    return qMax<qint64>(0, time) / m_previewCount;
+}
+
+void KFileItemModelRolesUpdater::resetPreviewStatistics()
+{
+    m_previewTime = 0;
+    m_previewCount = 0;
+    if (m_state == PreviewJobRunning) {
+        m_previewTimer.start();
+    }
+}
+
+QString KFileItemModelRolesUpdater::memoryConsumerName() const
+{
+    return QStringLiteral("KFileItemModelRolesUpdater %1").arg(m_model->directory().toDisplayString(QUrl::PreferLocalFile));
+}
+
+qint64 KFileItemModelRolesUpdater::memoryUsage() const
+{
+    const int pendingItems = m_pendingIndexes.count() + m_pendingPreviewItems.count() + m_previewJobItems.count();
+    qint64 bytes = qint64(pendingItems) * PendingItemCost;
+
+    // One byte per item for the flags of m_itemStates
+    bytes += m_itemStates.count();
+
+    for (auto it = m_pendingRoleValues.constBegin(); it != m_pendingRoleValues.constEnd(); ++it) {
+        bytes += PendingItemCost + qint64(it->count()) * PendingRoleValueCost;
+    }
+
+    for (const ProcessedPreview& preview : m_receivedPreviews) {
+        bytes += PendingItemCost + preview.image.sizeInBytes();
+    }
+
+    // The images of m_processingPreviews are modified by worker threads and
+    // may not be accessed. Their size is estimated by the requested size.
+    const QSize size = previewCacheSize();
+    bytes += qint64(m_processingPreviews.count()) * (PendingItemCost + qint64(size.width()) * size.height() * 4);
+    return bytes;
+}
+
+qint64 KFileItemModelRolesUpdater::releaseMemory(qint64 bytes)
+{
+    int firstKeptIndex;
+    int lastKeptIndex;
+    if (!releasablePreviewsRange(firstKeptIndex, lastKeptIndex)) {
+        return 0;
+    }
+
+    const int count = m_model->count();
+    QHash<int, QHash<QByteArray, QVariant> > itemsData;
+    qint64 released = 0;
+
+    // Start with the items that are farthest away from the visible area
+    int low = 0;
+    int high = count - 1;
+    while (released < bytes && (low < firstKeptIndex || high > lastKeptIndex)) {
+        int index;
+        if (high > lastKeptIndex && (low >= firstKeptIndex || high - lastKeptIndex > firstKeptIndex - low)) {
+            index = high--;
+        } else {
+            index = low++;
+        }
+
+        // data() would retrieve the values of the items that have none yet
+        const QPixmap pixmap = m_model->retrievedValue(index, "iconPixmap").value<QPixmap>();
+        if (pixmap.isNull()) {
+            continue;
+        }
+
+        released += qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+        itemsData.insert(index, {{"iconPixmap", QPixmap()}});
+        m_itemStates.setFlag(index, FinishedItem, false);
+    }
+
+    if (!itemsData.isEmpty()) {
+        disconnect(m_model, &KFileItemModel::itemsChanged,
+                   this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+        m_model->setItemsData(itemsData);
+        connect(m_model, &KFileItemModel::itemsChanged,
+                this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+    }
+    return released;
+}
+
+qint64 KFileItemModelRolesUpdater::releasableMemory() const
+{
+    int firstKeptIndex;
+    int lastKeptIndex;
+    if (!releasablePreviewsRange(firstKeptIndex, lastKeptIndex)) {
+        return 0;
+    }
+
+    qint64 bytes = 0;
+    const int count = m_model->count();
+    for (int index = 0; index < count; ++index) {
+        if (index >= firstKeptIndex && index <= lastKeptIndex) {
+            continue;
+        }
+        const QPixmap pixmap = m_model->retrievedValue(index, "iconPixmap").value<QPixmap>();
+        bytes += qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+    }
+    return bytes;
+}
+
+bool KFileItemModelRolesUpdater::releasablePreviewsRange(int& firstKeptIndex, int& lastKeptIndex) const
+{
+    if (!m_previewShown || m_model->count() <= KItemListCostModel::instance().resolveAllItemsLimit()) {
+        // The previews of all items would be requested again at once
+        return false;
+    }
+
+    // Keep the previews of the items that are resolved by
+    // indexesToResolve() before the user can see them
+    const int margin = ReadAheadPages * m_maximumVisibleItems;
+    firstKeptIndex = m_firstVisibleIndex - margin;
+    lastKeptIndex = m_lastVisibleIndex + margin;
+    return true;
+}
+
+KMemoryBudget::Consumer::ReleaseOrder KFileItemModelRolesUpdater::releaseOrder() const
+{
+    return ReleaseLast;
+}
+
 void KFileItemModelRolesUpdater::slotItemsInserted(const KItemRangeList& itemRanges)
 {
     QElapsedTimer timer;
     timer.start();
+    const int blockTimeout = maxBlockTimeout();
+
+    m_itemStates.insertItems(itemRanges);
+
+    // The indexes of the target range are not valid anymore
+    resetTargetIndexRange();
+
+    // The items of a restored snapshot might not need to be resolved again
+    applyRestoredItems();
 
     // Determine the sort role synchronously for as many items as possible.
     if (m_resolvableRoles.contains(m_model->sortRole())) {
@@ -339,10 +754,14 @@ void KFileItemModelRolesUpdater::slotItemsInserted(const KItemRangeList& itemRan
         for (const KItemRange& range : itemRanges) {
             const int lastIndex = insertedCount + range.index + range.count - 1;
             for (int i = insertedCount + range.index; i <= lastIndex; ++i) {
-                if (timer.elapsed() < MaxBlockTimeout) {
+                if (m_itemStates.testFlag(i, FinishedItem)) {
+                    // Only the restored items can be finished already
+                    continue;
+                }
+                if (timer.elapsed() < blockTimeout) {
                     applySortRole(i);
                 } else {
-                    m_pendingSortRoleItems.insert(m_model->fileItem(i));
+                    m_itemStates.setFlag(i, PendingSortRoleItem);
                 }
             }
             insertedCount += range.count;
@@ -353,9 +772,9 @@ void KFileItemModelRolesUpdater::slotItemsInserted(const KItemRangeList& itemRan
         // If there are still items whose sort role is unknown, check if the
         // asynchronous determination of the sort role is already in progress,
         // and start it if that is not the case.
-        if (!m_pendingSortRoleItems.isEmpty() && m_state != ResolvingSortRole) {
-            killPreviewJob();
-            m_state = ResolvingSortRole;
+        if (m_itemStates.flagCount(PendingSortRoleItem) > 0 && m_state != ResolvingSortRole) {
+            killPreviewJobs();
+            setState(ResolvingSortRole);
             resolveNextSortRole();
         }
     }
@@ -365,7 +784,8 @@ void KFileItemModelRolesUpdater::slotItemsInserted(const KItemRangeList& itemRan
 
 void KFileItemModelRolesUpdater::slotItemsRemoved(const KItemRangeList& itemRanges)
 {
-    Q_UNUSED(itemRanges)
+    m_itemStates.removeItems(itemRanges);
+    resetTargetIndexRange();
 
     const bool allItemsRemoved = (m_model->count() == 0);
 
@@ -388,29 +808,14 @@ void KFileItemModelRolesUpdater::slotItemsRemoved(const KItemRangeList& itemRang
 #endif
 
     if (allItemsRemoved) {
-        m_state = Idle;
+        setState(Idle);
 
-        m_finishedItems.clear();
-        m_pendingSortRoleItems.clear();
         m_pendingIndexes.clear();
         m_pendingPreviewItems.clear();
-        m_recentlyChangedItems.clear();
         m_recentlyChangedItemsTimer->stop();
-        m_changedItems.clear();
 
-        killPreviewJob();
+        killPreviewJobs();
     } else {
-        // Only remove the items from m_finishedItems. They will be removed
-        // from the other sets later on.
-        QSet<KFileItem>::iterator it = m_finishedItems.begin();
-        while (it != m_finishedItems.end()) {
-            if (m_model->index(*it) < 0) {
-                it = m_finishedItems.erase(it);
-            } else {
-                ++it;
-            }
-        }
-
         // The visible items might have changed.
         startUpdating();
     }
@@ -418,33 +823,73 @@ void KFileItemModelRolesUpdater::slotItemsRemoved(const KItemRangeList& itemRang
 
 void KFileItemModelRolesUpdater::slotItemsMoved(const KItemRange& itemRange, const QList<int> &movedToIndexes)
 {
-    Q_UNUSED(itemRange)
-    Q_UNUSED(movedToIndexes)
+    m_itemStates.moveItems(itemRange, movedToIndexes);
+    resetTargetIndexRange();
 
     // The visible items might have changed.
-    startUpdating();
+    if (m_updateOnItemsMoved) {
+        startUpdating();
+    }
 }
 
 void KFileItemModelRolesUpdater::slotItemsChanged(const KItemRangeList& itemRanges,
                                                   const QSet<QByteArray>& roles)
 {
-    Q_UNUSED(roles)
+    static const QByteArray typeRole = KItemRoleRegistry::intern("type");
+    if (roles.count() == 1 && roles.contains(typeRole)) {
+        // The model has determined the MIME-types of the items in a worker
+        // thread. Only the type description has changed, which does not
+        // require resolving any role.
+        return;
+    }
 
     // Find out if slotItemsChanged() has been done recently. If that is the
     // case, resolving the roles is postponed until a timer has exceeded
     // to prevent expensive repeated updates if files are updated frequently.
     const bool itemsChangedRecently = m_recentlyChangedItemsTimer->isActive();
 
-    QSet<KFileItem>& targetSet = itemsChangedRecently ? m_recentlyChangedItems : m_changedItems;
+    if (m_itemStates.count() != m_model->count()) {
+        // Another receiver of a signal of the model has changed items before
+        // the slot of this updater has applied the inserted or removed items
+        // to m_itemStates. The changed items are found by their URLs after
+        // the other slots have been invoked.
+        QList<QUrl> urls;
+        for (const KItemRange& itemRange : itemRanges) {
+            for (int index = itemRange.index; index < itemRange.index + itemRange.count; ++index) {
+                urls.append(m_model->fileItem(index).url());
+            }
+        }
+        QTimer::singleShot(0, this, [this, urls, roles]() {
+            KItemRangeList changedRanges;
+            for (const QUrl& url : urls) {
+                const int index = m_model->index(url);
+                if (index >= 0) {
+                    changedRanges.append(KItemRange(index, 1));
+                }
+            }
+            if (!changedRanges.isEmpty()) {
+                slotItemsChanged(changedRanges, roles);
+            }
+        });
+        return;
+    }
+
+    const ItemState targetState = itemsChangedRecently ? RecentlyChangedItem : ChangedItem;
+
+    // The cached overlays of changed items might be outdated
+    KOverlayIconResolver& overlayIconResolver = KOverlayIconResolver::instance();
+    const bool invalidateOverlays = overlayIconResolver.hasPlugins();
+    QList<QUrl> changedUrls;
 
     for (const KItemRange& itemRange : itemRanges) {
-        int index = itemRange.index;
-        for (int count = itemRange.count; count > 0; --count) {
-            const KFileItem item = m_model->fileItem(index);
-            targetSet.insert(item);
-            ++index;
+        for (int index = itemRange.index; index < itemRange.index + itemRange.count; ++index) {
+            m_itemStates.setFlag(index, targetState);
+            if (invalidateOverlays) {
+                changedUrls.append(m_model->fileItem(index).url());
+            }
         }
     }
+    overlayIconResolver.invalidate(changedUrls);
 
     m_recentlyChangedItemsTimer->start();
 
@@ -460,33 +905,34 @@ void KFileItemModelRolesUpdater::slotSortRoleChanged(const QByteArray& current,
     Q_UNUSED(previous)
 
     if (m_resolvableRoles.contains(current)) {
-        m_pendingSortRoleItems.clear();
-        m_finishedItems.clear();
+        m_itemStates.clearFlag(PendingSortRoleItem);
+        m_itemStates.clearFlag(FinishedItem);
 
         const int count = m_model->count();
         QElapsedTimer timer;
         timer.start();
+        const int blockTimeout = maxBlockTimeout();
 
         // Determine the sort role synchronously for as many items as possible.
         for (int index = 0; index < count; ++index) {
-            if (timer.elapsed() < MaxBlockTimeout) {
+            if (timer.elapsed() < blockTimeout) {
                 applySortRole(index);
             } else {
-                m_pendingSortRoleItems.insert(m_model->fileItem(index));
+                m_itemStates.setFlag(index, PendingSortRoleItem);
             }
         }
 
         applySortProgressToModel();
 
-        if (!m_pendingSortRoleItems.isEmpty()) {
+        if (m_itemStates.flagCount(PendingSortRoleItem) > 0) {
             // Trigger the asynchronous determination of the sort role.
-            killPreviewJob();
-            m_state = ResolvingSortRole;
+            killPreviewJobs();
+            setState(ResolvingSortRole);
             resolveNextSortRole();
         }
     } else {
-        m_state = Idle;
-        m_pendingSortRoleItems.clear();
+        setState(Idle);
+        m_itemStates.clearFlag(PendingSortRoleItem);
         applySortProgressToModel();
     }
 }
@@ -497,79 +943,27 @@ void KFileItemModelRolesUpdater::slotGotPreview(const KFileItem& item, const QPi
         return;
     }
 
-    m_changedItems.remove(item);
-
-    const int index = m_model->index(item);
-    if (index < 0) {
-        return;
-    }
-
-    QPixmap scaledPixmap = pixmap;
-
-    if (!pixmap.hasAlpha() && !pixmap.isNull()
-        && m_iconSize.width()  > KIconLoader::SizeSmallMedium
-        && m_iconSize.height() > KIconLoader::SizeSmallMedium) {
-        if (m_enlargeSmallPreviews) {
-            KPixmapModifier::applyFrame(scaledPixmap, m_iconSize);
-        } else {
-            // Assure that small previews don't get enlarged. Instead they
-            // should be shown centered within the frame.
-            const QSize contentSize = KPixmapModifier::sizeInsideFrame(m_iconSize);
-            const bool enlargingRequired = scaledPixmap.width()  < contentSize.width() &&
-                                           scaledPixmap.height() < contentSize.height();
-            if (enlargingRequired) {
-                QSize frameSize = scaledPixmap.size() / scaledPixmap.devicePixelRatio();
-                frameSize.scale(m_iconSize, Qt::KeepAspectRatio);
+    takePreviewJobItem(item);
+    KItemListMetrics::instance().add(KItemListMetrics::PreviewsCreated);
 
-                QPixmap largeFrame(frameSize);
-                largeFrame.fill(Qt::transparent);
+    const QImage preview = pixmap.toImage();
+    KPreviewCache::instance().insert(item, previewCacheSize(), m_enabledPlugins, preview);
+    processPreview(item, preview);
+}
 
-                KPixmapModifier::applyFrame(largeFrame, frameSize);
+void KFileItemModelRolesUpdater::slotPreviewsProcessed()
+{
+    const QVector<ProcessedPreview> previews = m_processingPreviews;
+    m_processingPreviews.clear();
 
-                QPainter painter(&largeFrame);
-                painter.drawPixmap((largeFrame.width()  - scaledPixmap.width() / scaledPixmap.devicePixelRatio()) / 2,
-                                   (largeFrame.height() - scaledPixmap.height() / scaledPixmap.devicePixelRatio()) / 2,
-                                   scaledPixmap);
-                scaledPixmap = largeFrame;
-            } else {
-                // The image must be shrunk as it is too large to fit into
-                // the available icon size
-                KPixmapModifier::applyFrame(scaledPixmap, m_iconSize);
-            }
-        }
-    } else if (!pixmap.isNull()) {
-        KPixmapModifier::scale(scaledPixmap, m_iconSize * qApp->devicePixelRatio());
-        scaledPixmap.setDevicePixelRatio(qApp->devicePixelRatio());
-    }
-
-    QHash<QByteArray, QVariant> data = rolesData(item);
-
-    const QStringList overlays = data["iconOverlays"].toStringList();
-    // Strangely KFileItem::overlays() returns empty string-values, so
-    // we need to check first whether an overlay must be drawn at all.
-    // It is more efficient to do it here, as KIconLoader::drawOverlays()
-    // assumes that an overlay will be drawn and has some additional
-    // setup time.
-    if (!scaledPixmap.isNull()) {
-        for (const QString& overlay : overlays) {
-            if (!overlay.isEmpty()) {
-                // There is at least one overlay, draw all overlays above m_pixmap
-                // and cancel the check
-                KIconLoader::global()->drawOverlays(overlays, scaledPixmap, KIconLoader::Desktop);
-                break;
-            }
-        }
+    // Previews that have been processed for an outdated icon size or
+    // plugin configuration are skipped. The corresponding items are not
+    // finished and get new previews later.
+    if (m_processingPreviewsGeneration == m_previewGeneration && m_state != Paused) {
+        applyPreviews(previews);
     }
 
-    data.insert("iconPixmap", scaledPixmap);
-
-    disconnect(m_model, &KFileItemModel::itemsChanged,
-               this,    &KFileItemModelRolesUpdater::slotItemsChanged);
-    m_model->setData(index, data);
-    connect(m_model, &KFileItemModel::itemsChanged,
-            this,    &KFileItemModelRolesUpdater::slotItemsChanged);
-
-    m_finishedItems.insert(item);
+    startPreviewProcessing();
 }
 
 void KFileItemModelRolesUpdater::slotPreviewFailed(const KFileItem& item)
@@ -578,10 +972,12 @@ void KFileItemModelRolesUpdater::slotPreviewFailed(const KFileItem& item)
         return;
     }
 
-    m_changedItems.remove(item);
+    takePreviewJobItem(item);
 
     const int index = m_model->index(item);
     if (index >= 0) {
+        m_itemStates.setFlag(index, ChangedItem, false);
+
         QHash<QByteArray, QVariant> data;
         data.insert("iconPixmap", QPixmap());
 
@@ -592,64 +988,183 @@ void KFileItemModelRolesUpdater::slotPreviewFailed(const KFileItem& item)
                 this,    &KFileItemModelRolesUpdater::slotItemsChanged);
 
         applyResolvedRoles(index, ResolveAll);
-        m_finishedItems.insert(item);
+        m_itemStates.setFlag(index, FinishedItem);
     }
 }
 
-void KFileItemModelRolesUpdater::slotPreviewJobFinished()
+void KFileItemModelRolesUpdater::slotPreviewJobFinished(KJob* job)
 {
-    m_previewJob = nullptr;
+    if (job) {
+        KIO::PreviewJob* previewJob = static_cast<KIO::PreviewJob*>(job);
+        if (!m_previewJobs.removeOne(previewJob)) {
+            return;
+        }
+
+        removePreviewJobItems(previewJob);
+        KPreviewJobLimiter::instance().release();
+    }
 
     if (m_state != PreviewJobRunning) {
         return;
     }
 
-    m_state = Idle;
-
     if (!m_pendingPreviewItems.isEmpty()) {
         startPreviewJob();
-    } else {
-        if (!m_changedItems.isEmpty()) {
+    } else if (m_previewJobs.isEmpty()) {
+        setState(Idle);
+        if (m_itemStates.flagCount(ChangedItem) > 0) {
             updateChangedItems();
         }
     }
 }
 
+void KFileItemModelRolesUpdater::slotCheckStalledPreviewJobs()
+{
+    if (m_previewJobs.isEmpty() && !m_sequenceJob) {
+        m_stalledPreviewJobsTimer->stop();
+        return;
+    }
+
+    if (m_sequenceJob && m_sequenceJobTimer.hasExpired(previewTimeout(m_sequenceItem))) {
+        abortStalledSequenceJob();
+    }
+
+    QVector<KIO::PreviewJob*> stalledJobs;
+    for (auto it = m_previewJobProgress.cbegin(); it != m_previewJobProgress.cend(); ++it) {
+        if (!it->sinceLastPreview.hasExpired(PreviewTimeout)) {
+            continue;
+        }
+        const KFileItem item = currentPreviewJobItem(it.key());
+        if (item.isNull() || it->sinceLastPreview.hasExpired(previewTimeout(item))) {
+            stalledJobs.append(it.key());
+        }
+    }
+    if (stalledJobs.isEmpty()) {
+        return;
+    }
+
+    for (KIO::PreviewJob* job : qAsConst(stalledJobs)) {
+        abortStalledPreviewJob(job);
+    }
+
+    // Start new jobs for the remaining items, or finish
+    slotPreviewJobFinished(nullptr);
+}
+
+void KFileItemModelRolesUpdater::slotPreviewJobsReleased()
+{
+    if (m_state == PreviewJobRunning && !m_pendingPreviewItems.isEmpty()
+        && m_previewJobs.count() < m_maximumPreviewJobs) {
+        startPreviewJob();
+    }
+
+    if (m_sequenceJobPending) {
+        startSequenceJob();
+    }
+}
+
+void KFileItemModelRolesUpdater::slotSlowMountsChanged(const QString& mountPoint)
+{
+    const KIoGovernor& governor = KIoGovernor::instance();
+    const QString directoryPath = m_model->directory().toLocalFile();
+    if (directoryPath.isEmpty() || governor.mountPoint(directoryPath) != mountPoint) {
+        return;
+    }
+
+    if (governor.isSlow(directoryPath)) {
+        if (m_state == PreviewJobRunning) {
+            // The pending previews are skipped by startPreviewJob()
+            startUpdating();
+        }
+    } else if (m_state == Paused) {
+        m_previewChangedDuringPausing = true;
+    } else {
+        // The items on the slow mount have been marked as finished
+        // without a preview or without the recursive size
+        m_itemStates.clearFlag(FinishedItem);
+        startUpdating();
+    }
+}
+
+void KFileItemModelRolesUpdater::slotGotSequenceFrame(const KFileItem& item, const QPixmap& pixmap)
+{
+    Q_UNUSED(item)
+
+    const QImage frame = pixmap.toImage();
+    if (!m_sequenceFrames.isEmpty()) {
+        // Thumbnailers that don't support sequences return the same frame
+        // for each index, others start again after their last frame.
+        const QImage& firstFrame = m_sequenceFrames.first();
+        if (frame.size() != firstFrame.size() || frame == firstFrame) {
+            killSequenceJob();
+            storeHoverSequence();
+            return;
+        }
+    }
+
+    m_sequenceFrames.append(frame);
+    if (m_sequenceFrames.count() > 1) {
+        applyHoverSequence(sequenceStrip(m_sequenceFrames), m_sequenceFrames.count());
+    }
+
+    if (m_sequenceJob && m_sequenceFrames.count() < SequenceFrameCount) {
+        // The index is read when the job starts the thumbnailer for
+        // the next entry of m_sequenceItem
+        m_sequenceJob->setSequenceIndex(m_sequenceFrames.count());
+        m_sequenceJobTimer.start();
+    }
+}
+
+void KFileItemModelRolesUpdater::slotSequenceFrameFailed(const KFileItem& item)
+{
+    Q_UNUSED(item)
+    killSequenceJob();
+    storeHoverSequence();
+}
+
+void KFileItemModelRolesUpdater::slotSequenceJobFinished(KJob* job)
+{
+    if (job != m_sequenceJob) {
+        return;
+    }
+
+    m_sequenceJob = nullptr;
+    KPreviewJobLimiter::instance().release();
+    storeHoverSequence();
+}
+
 void KFileItemModelRolesUpdater::resolveNextSortRole()
 {
     if (m_state != ResolvingSortRole) {
         return;
     }
 
-    QSet<KFileItem>::iterator it = m_pendingSortRoleItems.begin();
-    while (it != m_pendingSortRoleItems.end()) {
-        const KFileItem item = *it;
-        const int index = m_model->index(item);
+    int index = m_itemStates.firstIndexWithFlag(PendingSortRoleItem);
+    while (index >= 0) {
+        m_itemStates.setFlag(index, PendingSortRoleItem, false);
 
         // Continue if the sort role has already been determined for the
         // item, and the item has not been changed recently.
-        if (!m_changedItems.contains(item) && m_model->data(index).contains(m_model->sortRole())) {
-            it = m_pendingSortRoleItems.erase(it);
+        if (!m_itemStates.testFlag(index, ChangedItem) && m_model->data(index).contains(m_model->sortRole())) {
+            index = m_itemStates.firstIndexWithFlag(PendingSortRoleItem);
             continue;
         }
 
         applySortRole(index);
-        m_pendingSortRoleItems.erase(it);
         break;
     }
 
-    if (!m_pendingSortRoleItems.isEmpty()) {
+    if (m_itemStates.flagCount(PendingSortRoleItem) > 0) {
         applySortProgressToModel();
         QTimer::singleShot(0, this, &KFileItemModelRolesUpdater::resolveNextSortRole);
     } else {
-        m_state = Idle;
+        setState(Idle);
 
-        // Prevent that we try to update the items twice.
-        disconnect(m_model, &KFileItemModel::itemsMoved,
-                   this,    &KFileItemModelRolesUpdater::slotItemsMoved);
+        // Prevent that we try to update the items twice. The moved
+        // items are still applied to m_itemStates.
+        m_updateOnItemsMoved = false;
         applySortProgressToModel();
-        connect(m_model, &KFileItemModel::itemsMoved,
-                this,    &KFileItemModelRolesUpdater::slotItemsMoved);
+        m_updateOnItemsMoved = true;
         startUpdating();
     }
 }
@@ -662,26 +1177,30 @@ void KFileItemModelRolesUpdater::resolveNextPendingRoles()
 
     while (!m_pendingIndexes.isEmpty()) {
         const int index = m_pendingIndexes.takeFirst();
-        const KFileItem item = m_model->fileItem(index);
-
-        if (m_finishedItems.contains(item)) {
+        if (m_itemStates.testFlag(index, FinishedItem)) {
             continue;
         }
 
-        applyResolvedRoles(index, ResolveAll);
-        m_finishedItems.insert(item);
-        m_changedItems.remove(item);
+        // Only resolving all roles is measured, as the cheap ResolveFast
+        // would let the budgets appear larger than they are.
+        QElapsedTimer timer;
+        timer.start();
+        applyResolvedRoles(index, ResolveAll);
+        KItemListCostModel::instance().addResolveSample(1, timer.nsecsElapsed());
+
+        m_itemStates.setFlag(index, FinishedItem);
+        m_itemStates.setFlag(index, ChangedItem, false);
         break;
     }
 
     if (!m_pendingIndexes.isEmpty()) {
         QTimer::singleShot(0, this, &KFileItemModelRolesUpdater::resolveNextPendingRoles);
     } else {
-        m_state = Idle;
+        setState(Idle);
 
         if (m_clearPreviews) {
             // Only go through the list if there are items which might still have previews.
-            if (m_finishedItems.count() != m_model->count()) {
+            if (m_itemStates.flagCount(FinishedItem) != m_model->count()) {
                 QHash<QByteArray, QVariant> data;
                 data.insert("iconPixmap", QPixmap());
 
@@ -699,7 +1218,7 @@ void KFileItemModelRolesUpdater::resolveNextPendingRoles()
             m_clearPreviews = false;
         }
 
-        if (!m_changedItems.isEmpty()) {
+        if (m_itemStates.flagCount(ChangedItem) > 0) {
             updateChangedItems();
         }
     }
@@ -707,8 +1226,11 @@ void KFileItemModelRolesUpdater::resolveNextPendingRoles()
 
 void KFileItemModelRolesUpdater::resolveRecentlyChangedItems()
 {
-    m_changedItems += m_recentlyChangedItems;
-    m_recentlyChangedItems.clear();
+    const QVector<int> recentlyChangedIndexes = m_itemStates.indexesWithFlag(RecentlyChangedItem);
+    for (int index : recentlyChangedIndexes) {
+        m_itemStates.setFlag(index, ChangedItem);
+    }
+    m_itemStates.clearFlag(RecentlyChangedItem);
     updateChangedItems();
 }
 
@@ -722,6 +1244,9 @@ void KFileItemModelRolesUpdater::applyChangedBalooRoles(const QString& file)
         // the corresponding file has been deleted in the meantime.
         return;
     }
+
+    // Only the metadata of the reported file must be loaded again.
+    KBalooRolesProvider::instance().invalidate(item.url());
     applyChangedBalooRolesForItem(item);
 #else
     Q_UNUSED(file)
@@ -731,32 +1256,12 @@ void KFileItemModelRolesUpdater::applyChangedBalooRoles(const QString& file)
 void KFileItemModelRolesUpdater::applyChangedBalooRolesForItem(const KFileItem &item)
 {
 #ifdef HAVE_BALOO
-    Baloo::File file(item.localPath());
-    file.load();
-
-    const KBalooRolesProvider& rolesProvider = KBalooRolesProvider::instance();
-    QHash<QByteArray, QVariant> data;
-
-    const auto roles = rolesProvider.roles();
-    for (const QByteArray& role : roles) {
-        // Overwrite all the role values with an empty QVariant, because the roles
-        // provider doesn't overwrite it when the property value list is empty.
-        // See bug 322348
-        data.insert(role, QVariant());
-    }
-
-    QHashIterator<QByteArray, QVariant> it(rolesProvider.roleValues(file, m_roles));
-    while (it.hasNext()) {
-        it.next();
-        data.insert(it.key(), it.value());
-    }
-
-    disconnect(m_model, &KFileItemModel::itemsChanged,
-               this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+    // All role values of the provider are contained: Roles without value
+    // are overwritten by an empty QVariant (see bug 322348).
     const int index = m_model->index(item);
-    m_model->setData(index, data);
-    connect(m_model, &KFileItemModel::itemsChanged,
-            this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+    if (index >= 0) {
+        setRoleValues(index, KBalooRolesProvider::instance().roleValues(KFileItemList{item}, m_roles).value(item.url()));
+    }
 #else
 #ifndef Q_CC_MSVC
     Q_UNUSED(item)
@@ -764,13 +1269,13 @@ void KFileItemModelRolesUpdater::applyChangedBalooRolesForItem(const KFileItem &
 #endif
 }
 
-void KFileItemModelRolesUpdater::slotDirectoryContentsCountReceived(const QString& path, int count, long size)
+void KFileItemModelRolesUpdater::slotDirectoryContentsCountReceived(const QString& path, int count, qint64 size)
 {
     const bool getSizeRole = m_roles.contains("size");
     const bool getIsExpandableRole = m_roles.contains("isExpandable");
 
     if (getSizeRole || getIsExpandableRole) {
-        const int index = m_model->index(QUrl::fromLocalFile(path));
+        const int index = m_directoryContentsCounter->index(path);
         if (index >= 0) {
             QHash<QByteArray, QVariant> data;
 
@@ -782,29 +1287,35 @@ void KFileItemModelRolesUpdater::slotDirectoryContentsCountReceived(const QStrin
                 data.insert("isExpandable", count > 0);
             }
 
-            disconnect(m_model, &KFileItemModel::itemsChanged,
-                       this,    &KFileItemModelRolesUpdater::slotItemsChanged);
-            m_model->setData(index, data);
-            connect(m_model, &KFileItemModel::itemsChanged,
-                       this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+            setRoleValues(index, data);
         }
     }
 }
 
-void KFileItemModelRolesUpdater::startUpdating()
+void KFileItemModelRolesUpdater::startUpdating(PreviewJobHint hint)
 {
     if (m_state == Paused) {
         return;
     }
 
-    if (m_finishedItems.count() == m_model->count()) {
+    if (m_itemStates.count() != m_model->count()) {
+        // Another receiver of a signal of the model has invoked the updating
+        // before the slot of this updater, which updates again afterwards.
+        return;
+    }
+
+    if (m_itemStates.flagCount(FinishedItem) == m_model->count()) {
         // All roles have been resolved already.
-        m_state = Idle;
+        setState(Idle);
         return;
     }
 
     // Terminate all updates that are currently active.
-    killPreviewJob();
+    if (hint == KeepVisiblePreviews && m_previewShown && m_state == PreviewJobRunning) {
+        cancelInvisiblePreviews();
+    } else {
+        killPreviewJobs();
+    }
     m_pendingIndexes.clear();
 
     QElapsedTimer timer;
@@ -827,21 +1338,33 @@ void KFileItemModelRolesUpdater::startUpdating()
         m_pendingPreviewItems.reserve(indexes.count());
 
         for (int index : qAsConst(indexes)) {
+            if (m_itemStates.testFlag(index, FinishedItem)) {
+                continue;
+            }
             const KFileItem item = m_model->fileItem(index);
-            if (!m_finishedItems.contains(item)) {
+            if (!m_previewJobItems.contains(item)) {
                 m_pendingPreviewItems.append(item);
             }
         }
 
+        // If the preview jobs for the visible items are still running, the
+        // pending items will be passed to the next job when one of them is
+        // finished.
         startPreviewJob();
     } else {
         m_pendingIndexes = indexes;
         // Trigger the asynchronous resolving of all roles.
-        m_state = ResolvingAllRoles;
+        setState(ResolvingAllRoles);
         QTimer::singleShot(0, this, &KFileItemModelRolesUpdater::resolveNextPendingRoles);
     }
 }
 
+void KFileItemModelRolesUpdater::resetTargetIndexRange()
+{
+    m_firstTargetIndex = 0;
+    m_lastTargetIndex = -1;
+}
+
 void KFileItemModelRolesUpdater::updateVisibleIcons()
 {
     int lastVisibleIndex = m_lastVisibleIndex;
@@ -856,10 +1379,11 @@ void KFileItemModelRolesUpdater::updateVisibleIcons()
 
     QElapsedTimer timer;
     timer.start();
+    const int blockTimeout = maxBlockTimeout();
 
     // Try to determine the final icons for all visible items.
     int index;
-    for (index = m_firstVisibleIndex; index <= lastVisibleIndex && timer.elapsed() < MaxBlockTimeout; ++index) {
+    for (index = m_firstVisibleIndex; index <= lastVisibleIndex && timer.elapsed() < blockTimeout; ++index) {
         applyResolvedRoles(index, ResolveFast);
     }
 
@@ -870,20 +1394,31 @@ void KFileItemModelRolesUpdater::updateVisibleIcons()
 
 void KFileItemModelRolesUpdater::startPreviewJob()
 {
-    m_state = PreviewJobRunning;
+    setState(PreviewJobRunning);
 
     if (m_pendingPreviewItems.isEmpty()) {
-        QTimer::singleShot(0, this, &KFileItemModelRolesUpdater::slotPreviewJobFinished);
+        QTimer::singleShot(0, this, [this]() { slotPreviewJobFinished(nullptr); });
         return;
     }
 
-    // PreviewJob internally caches items always with the size of
-    // 128 x 128 pixels or 256 x 256 pixels. A (slow) downscaling is done
-    // by PreviewJob if a smaller size is requested. For images KFileItemModelRolesUpdater must
-    // do a downscaling anyhow because of the frame, so in this case only the provided
-    // cache sizes are requested.
-    const QSize cacheSize = (m_iconSize.width() > 128) || (m_iconSize.height() > 128)
-                             ? QSize(256, 256) : QSize(128, 128);
+    applyCachedPreviews();
+    skipPreviewsOnSlowMounts();
+    skipTimedOutPreviews();
+    if (m_pendingPreviewItems.isEmpty()) {
+        QTimer::singleShot(0, this, [this]() { slotPreviewJobFinished(nullptr); });
+        return;
+    }
+
+    // If no preview job may be started currently, startPreviewJob() will be
+    // invoked again as soon as any roles updater has finished a job.
+    KPreviewJobLimiter& limiter = KPreviewJobLimiter::instance();
+    const int jobCount = limiter.acquire(m_maximumPreviewJobs - m_previewJobs.count(),
+                                         m_lowPriority ? KPreviewJobLimiter::LowPriority : KPreviewJobLimiter::NormalPriority);
+    if (jobCount <= 0) {
+        return;
+    }
+
+    const QSize cacheSize = previewCacheSize();
 
     // KIO::filePreview() will request the MIME-type of all passed items, which (in the
     // worst case) might block the application for several seconds. To prevent such
@@ -901,33 +1436,378 @@ void KFileItemModelRolesUpdater::startPreviewJob()
             itemSubSet.append(m_pendingPreviewItems.takeFirst());
         } while (!m_pendingPreviewItems.isEmpty() && m_pendingPreviewItems.first().isMimeTypeKnown());
     } else {
-        // Determine mime types for MaxBlockTimeout ms, and start a preview
+        // Determine mime types for maxBlockTimeout() ms, and start a preview
         // job for the corresponding items.
         QElapsedTimer timer;
         timer.start();
+        const int blockTimeout = maxBlockTimeout();
 
         do {
             const KFileItem item = m_pendingPreviewItems.takeFirst();
             item.determineMimeType();
             itemSubSet.append(item);
-        } while (!m_pendingPreviewItems.isEmpty() && timer.elapsed() < MaxBlockTimeout);
+        } while (!m_pendingPreviewItems.isEmpty() && timer.elapsed() < blockTimeout);
+    }
+
+    const QVector<KFileItemList> jobItems = splitPreviewItems(itemSubSet, jobCount);
+    limiter.release(jobCount - jobItems.count());
+
+    for (const KFileItemList& items : jobItems) {
+        KIO::PreviewJob* job = new KIO::PreviewJob(items, cacheSize, &m_enabledPlugins);
+
+        job->setIgnoreMaximumSize(items.first().isLocalFile() && m_localFileSizePreviewLimit <= 0);
+        if (job->uiDelegate()) {
+            KJobWidgets::setWindow(job, qApp->activeWindow());
+        }
+
+        connect(job,  &KIO::PreviewJob::gotPreview,
+                this, &KFileItemModelRolesUpdater::slotGotPreview);
+        connect(job,  &KIO::PreviewJob::failed,
+                this, &KFileItemModelRolesUpdater::slotPreviewFailed);
+        connect(job,  &KIO::PreviewJob::finished,
+                this, &KFileItemModelRolesUpdater::slotPreviewJobFinished);
+
+        for (const KFileItem& item : items) {
+            m_previewJobItems.insert(item, job);
+        }
+        m_previewJobs.append(job);
+
+        PreviewJobProgress& progress = m_previewJobProgress[job];
+        progress.items = items;
+        progress.sinceLastPreview.start();
+    }
+
+    if (!m_stalledPreviewJobsTimer->isActive()) {
+        m_stalledPreviewJobsTimer->start();
+    }
+}
+
+QVector<KFileItemList> KFileItemModelRolesUpdater::splitPreviewItems(const KFileItemList& items, int count)
+{
+    count = qBound(1, count, items.count());
+
+    // Group the items by their MIME type, as the MIME type decides
+    // which thumbnailer plugin creates the preview.
+    QHash<QString, int> groupIndexes;
+    QVector<int> groupSizes;
+    QVector<int> itemGroups;
+    itemGroups.reserve(items.count());
+    for (const KFileItem& item : items) {
+        const QString mimeType = item.mimetype();
+        auto it = groupIndexes.constFind(mimeType);
+        if (it == groupIndexes.constEnd()) {
+            it = groupIndexes.insert(mimeType, groupSizes.count());
+            groupSizes.append(0);
+        }
+        ++groupSizes[it.value()];
+        itemGroups.append(it.value());
+    }
+
+    const int groupCount = groupSizes.count();
+    QVector<int> firstJobOfGroup(groupCount, 0);
+    QVector<int> jobsOfGroup(groupCount, 1);
+
+    if (groupCount >= count) {
+        // Each MIME type is handled by one job. Assign the largest groups
+        // first, each one to the job that has the fewest items.
+        QVector<int> groupsBySize(groupCount);
+        std::iota(groupsBySize.begin(), groupsBySize.end(), 0);
+        std::stable_sort(groupsBySize.begin(), groupsBySize.end(), [&groupSizes](int a, int b) {
+            return groupSizes[a] > groupSizes[b];
+        });
+
+        QVector<int> jobSizes(count, 0);
+        for (int group : qAsConst(groupsBySize)) {
+            const int job = static_cast<int>(std::min_element(jobSizes.constBegin(), jobSizes.constEnd()) - jobSizes.constBegin());
+            firstJobOfGroup[group] = job;
+            jobSizes[job] += groupSizes[group];
+        }
+    } else {
+        // Each MIME type gets at least one job, the remaining jobs are
+        // assigned to the groups with the most items per job.
+        for (int i = groupCount; i < count; ++i) {
+            int group = 0;
+            for (int j = 1; j < groupCount; ++j) {
+                if (groupSizes[j] * jobsOfGroup[group] > groupSizes[group] * jobsOfGroup[j]) {
+                    group = j;
+                }
+            }
+            ++jobsOfGroup[group];
+        }
+
+        int job = 0;
+        for (int group = 0; group < groupCount; ++group) {
+            firstJobOfGroup[group] = job;
+            job += jobsOfGroup[group];
+        }
+    }
+
+    // The items of a group are distributed alternately over the jobs of the
+    // group, so that each job starts with the items that have the highest
+    // priority. The order of the items is kept within each job.
+    QVector<KFileItemList> result(count);
+    QVector<int> assignedItemsOfGroup(groupCount, 0);
+    for (int i = 0; i < items.count(); ++i) {
+        const int group = itemGroups[i];
+        const int job = firstJobOfGroup[group] + (assignedItemsOfGroup[group]++ % jobsOfGroup[group]);
+        result[job].append(items[i]);
+    }
+
+    return result;
+}
+
+void KFileItemModelRolesUpdater::applyCachedPreviews()
+{
+    KPreviewCache& cache = KPreviewCache::instance();
+    const QSize cacheSize = previewCacheSize();
+
+    QElapsedTimer timer;
+    timer.start();
+    const int blockTimeout = maxBlockTimeout();
+
+    // Look up the cached previews for maxBlockTimeout() ms. The items that
+    // could not be checked in time are passed to the preview job.
+    const int count = m_pendingPreviewItems.count();
+    KFileItemList uncachedItems;
+    uncachedItems.reserve(count);
+
+    int i = 0;
+    for (; i < count && timer.elapsed() < blockTimeout; ++i) {
+        const KFileItem& item = m_pendingPreviewItems.at(i);
+        const QImage preview = cache.findClosest(item, cacheSize, m_enabledPlugins);
+        if (preview.isNull()) {
+            uncachedItems.append(item);
+        } else {
+            processPreview(item, preview);
+        }
+    }
+
+    KItemListMetrics& metrics = KItemListMetrics::instance();
+    metrics.add(KItemListMetrics::PreviewCacheHits, i - uncachedItems.count());
+    metrics.add(KItemListMetrics::PreviewCacheMisses, uncachedItems.count());
+
+    for (; i < count; ++i) {
+        uncachedItems.append(m_pendingPreviewItems.at(i));
+    }
+
+    m_pendingPreviewItems = uncachedItems;
+}
+
+int KFileItemModelRolesUpdater::maxBlockTimeout() const
+{
+    return KItemListCostModel::instance().maxBlockTimeout(m_maximumVisibleItems);
+}
+
+void KFileItemModelRolesUpdater::skipTimedOutPreviews()
+{
+    if (s_timedOutPreviews->isEmpty()) {
+        return;
+    }
+
+    KFileItemList items;
+    KFileItemList timedOutItems;
+    items.reserve(m_pendingPreviewItems.count());
+    for (const KFileItem& item : qAsConst(m_pendingPreviewItems)) {
+        if (isPreviewTimedOut(item)) {
+            timedOutItems.append(item);
+        } else {
+            items.append(item);
+        }
+    }
+    m_pendingPreviewItems = items;
+
+    for (const KFileItem& item : qAsConst(timedOutItems)) {
+        slotPreviewFailed(item);
+    }
+}
+
+void KFileItemModelRolesUpdater::skipPreviewsOnSlowMounts()
+{
+    const KIoGovernor& governor = KIoGovernor::instance();
+    if (!governor.hasSlowMounts()) {
+        return;
+    }
+
+    KFileItemList fastItems;
+    KFileItemList slowItems;
+    fastItems.reserve(m_pendingPreviewItems.count());
+    for (const KFileItem& item : qAsConst(m_pendingPreviewItems)) {
+        const QString localPath = item.localPath();
+        if (!localPath.isEmpty() && governor.isSlow(localPath)) {
+            slowItems.append(item);
+        } else {
+            fastItems.append(item);
+        }
+    }
+    m_pendingPreviewItems = fastItems;
+
+    // The items keep their icons, like if the preview could not be created.
+    for (const KFileItem& item : qAsConst(slowItems)) {
+        slotPreviewFailed(item);
     }
+}
+
+void KFileItemModelRolesUpdater::processPreview(const KFileItem& item, const QImage& preview)
+{
+    m_receivedPreviews.append({item, preview});
+    startPreviewProcessing();
+}
+
+void KFileItemModelRolesUpdater::startPreviewProcessing()
+{
+    if (m_receivedPreviews.isEmpty() || m_previewProcessingWatcher->isRunning()) {
+        // The received previews will be processed as one batch when the
+        // running processing has been finished.
+        return;
+    }
+
+    m_processingPreviews.swap(m_receivedPreviews);
+    m_processingPreviewsGeneration = m_previewGeneration;
+
+    const QSize iconSize = m_iconSize;
+    const bool enlargeSmallPreviews = m_enlargeSmallPreviews;
+    const qreal devicePixelRatio = m_devicePixelRatio;
+    m_previewProcessingWatcher->setFuture(QtConcurrent::map(m_processingPreviews,
+        [iconSize, enlargeSmallPreviews, devicePixelRatio](ProcessedPreview& preview) {
+            preview.image = scaledPreview(preview.image, iconSize, enlargeSmallPreviews, devicePixelRatio);
+        }));
+}
+
+QImage KFileItemModelRolesUpdater::scaledPreview(const QImage& preview, const QSize& iconSize,
+                                                 bool enlargeSmallPreviews, qreal devicePixelRatio)
+{
+    QImage scaledImage = preview;
 
-    KIO::PreviewJob* job = new KIO::PreviewJob(itemSubSet, cacheSize, &m_enabledPlugins);
+    if (!preview.hasAlphaChannel() && !preview.isNull()
+        && iconSize.width()  > KIconLoader::SizeSmallMedium
+        && iconSize.height() > KIconLoader::SizeSmallMedium) {
+        if (enlargeSmallPreviews) {
+            KPixmapModifier::applyFrame(scaledImage, iconSize, devicePixelRatio);
+        } else {
+            // Assure that small previews don't get enlarged. Instead they
+            // should be shown centered within the frame.
+            const QSize contentSize = KPixmapModifier::sizeInsideFrame(iconSize);
+            const bool enlargingRequired = scaledImage.width()  < contentSize.width() &&
+                                           scaledImage.height() < contentSize.height();
+            if (enlargingRequired) {
+                QSize frameSize = scaledImage.size() / scaledImage.devicePixelRatio();
+                frameSize.scale(iconSize, Qt::KeepAspectRatio);
+
+                QImage largeFrame(frameSize, QImage::Format_ARGB32_Premultiplied);
+                largeFrame.fill(Qt::transparent);
 
-    job->setIgnoreMaximumSize(itemSubSet.first().isLocalFile() && m_localFileSizePreviewLimit <= 0);
-    if (job->uiDelegate()) {
-        KJobWidgets::setWindow(job, qApp->activeWindow());
+                KPixmapModifier::applyFrame(largeFrame, frameSize, devicePixelRatio);
+
+                QPainter painter(&largeFrame);
+                painter.drawImage((largeFrame.width()  - scaledImage.width() / scaledImage.devicePixelRatio()) / 2,
+                                  (largeFrame.height() - scaledImage.height() / scaledImage.devicePixelRatio()) / 2,
+                                  scaledImage);
+                painter.end();
+                scaledImage = largeFrame;
+            } else {
+                // The image must be shrunk as it is too large to fit into
+                // the available icon size
+                KPixmapModifier::applyFrame(scaledImage, iconSize, devicePixelRatio);
+            }
+        }
+    } else if (!preview.isNull()) {
+        KPixmapModifier::scale(scaledImage, iconSize * devicePixelRatio);
+        scaledImage.setDevicePixelRatio(devicePixelRatio);
+    }
+
+    return scaledImage;
+}
+
+void KFileItemModelRolesUpdater::applyPreviews(const QVector<ProcessedPreview>& previews)
+{
+    // Values that have been resolved before may not overwrite the previews.
+    applyPendingRoleValues();
+
+    QHash<int, QHash<QByteArray, QVariant> > itemsData;
+    itemsData.reserve(previews.count());
+
+#ifdef HAVE_BALOO
+    if (m_balooFileMonitor) {
+        // Load the metadata of all items at once, rolesData() reads them from the cache.
+        KFileItemList items;
+        items.reserve(previews.count());
+        for (const ProcessedPreview& preview : previews) {
+            items.append(preview.item);
+        }
+        KBalooRolesProvider::instance().roleValues(items, m_roles);
+    }
+#endif
+
+    for (const ProcessedPreview& preview : previews) {
+        const int index = m_model->index(preview.item);
+        if (index < 0) {
+            continue;
+        }
+        m_itemStates.setFlag(index, ChangedItem, false);
+
+        QPixmap scaledPixmap = QPixmap::fromImage(preview.image);
+
+        QHash<QByteArray, QVariant> data = rolesData(preview.item);
+
+        const QStringList overlays = data["iconOverlays"].toStringList();
+        // Strangely KFileItem::overlays() returns empty string-values, so
+        // we need to check first whether an overlay must be drawn at all.
+        // It is more efficient to do it here, as KIconLoader::drawOverlays()
+        // assumes that an overlay will be drawn and has some additional
+        // setup time.
+        if (!scaledPixmap.isNull()) {
+            for (const QString& overlay : overlays) {
+                if (!overlay.isEmpty()) {
+                    // There is at least one overlay, draw all overlays above m_pixmap
+                    // and cancel the check
+                    KIconLoader::global()->drawOverlays(overlays, scaledPixmap, KIconLoader::Desktop);
+                    break;
+                }
+            }
+        }
+
+        data.insert("iconPixmap", scaledPixmap);
+        itemsData.insert(index, data);
+
+        m_itemStates.setFlag(index, FinishedItem);
+    }
+
+    if (itemsData.isEmpty()) {
+        return;
     }
 
-    connect(job,  &KIO::PreviewJob::gotPreview,
-            this, &KFileItemModelRolesUpdater::slotGotPreview);
-    connect(job,  &KIO::PreviewJob::failed,
-            this, &KFileItemModelRolesUpdater::slotPreviewFailed);
-    connect(job,  &KIO::PreviewJob::finished,
-            this, &KFileItemModelRolesUpdater::slotPreviewJobFinished);
+    disconnect(m_model, &KFileItemModel::itemsChanged,
+               this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+    m_model->setItemsData(itemsData);
+    connect(m_model, &KFileItemModel::itemsChanged,
+            this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+}
 
-    m_previewJob = job;
+QSize KFileItemModelRolesUpdater::previewCacheSize() const
+{
+    // PreviewJob internally caches items with the size classes of the
+    // thumbnail specification, starting at 128 x 128 pixels. A (slow) downscaling
+    // is done by PreviewJob if a smaller size is requested. For images
+    // KFileItemModelRolesUpdater must do a downscaling anyhow because of the frame,
+    // so in this case only the size classes are requested. The size is given in
+    // device pixels, so that previews on high-DPI screens are not upscaled.
+    const qreal iconSize = qMax(m_iconSize.width(), m_iconSize.height()) * m_devicePixelRatio;
+    int cacheSize = MinimumPreviewCacheSize;
+    while (cacheSize < iconSize && cacheSize < MaximumPreviewCacheSize) {
+        cacheSize *= 2;
+    }
+    return QSize(cacheSize, cacheSize);
+}
+
+bool KFileItemModelRolesUpdater::iconSizeRequiresNewPreviews() const
+{
+    const int previewsSize = qMax(m_previewsIconSize.width(), m_previewsIconSize.height());
+    if (previewsSize <= 0) {
+        return true;
+    }
+
+    const qreal stretch = qreal(qMax(m_iconSize.width(), m_iconSize.height())) / previewsSize;
+    return stretch < MinimumPreviewStretch || stretch > MaximumPreviewStretch;
 }
 
 void KFileItemModelRolesUpdater::updateChangedItems()
@@ -936,42 +1816,38 @@ void KFileItemModelRolesUpdater::updateChangedItems()
         return;
     }
 
-    if (m_changedItems.isEmpty()) {
+    const QVector<int> changedIndexes = m_itemStates.indexesWithFlag(ChangedItem);
+    if (changedIndexes.isEmpty()) {
         return;
     }
 
-    m_finishedItems -= m_changedItems;
+    for (int index : changedIndexes) {
+        m_itemStates.setFlag(index, FinishedItem, false);
+    }
 
     if (m_resolvableRoles.contains(m_model->sortRole())) {
-        m_pendingSortRoleItems += m_changedItems;
+        for (int index : changedIndexes) {
+            m_itemStates.setFlag(index, PendingSortRoleItem);
+        }
 
         if (m_state != ResolvingSortRole) {
             // Stop the preview job if necessary, and trigger the
             // asynchronous determination of the sort role.
-            killPreviewJob();
-            m_state = ResolvingSortRole;
+            killPreviewJobs();
+            setState(ResolvingSortRole);
             QTimer::singleShot(0, this, &KFileItemModelRolesUpdater::resolveNextSortRole);
         }
 
         return;
     }
 
+    // The changed indexes are sorted already
     QList<int> visibleChangedIndexes;
     QList<int> invisibleChangedIndexes;
-    visibleChangedIndexes.reserve(m_changedItems.size());
-    invisibleChangedIndexes.reserve(m_changedItems.size());
-
-    auto changedItemsIt = m_changedItems.begin();
-    while (changedItemsIt != m_changedItems.end()) {
-        const auto& item = *changedItemsIt;
-        const int index = m_model->index(item);
-
-        if (index < 0) {
-            changedItemsIt = m_changedItems.erase(changedItemsIt);
-            continue;
-        }
-        ++changedItemsIt;
+    visibleChangedIndexes.reserve(changedIndexes.size());
+    invisibleChangedIndexes.reserve(changedIndexes.size());
 
+    for (int index : changedIndexes) {
         if (index >= m_firstVisibleIndex && index <= m_lastVisibleIndex) {
             visibleChangedIndexes.append(index);
         } else {
@@ -979,8 +1855,6 @@ void KFileItemModelRolesUpdater::updateChangedItems()
         }
     }
 
-    std::sort(visibleChangedIndexes.begin(), visibleChangedIndexes.end());
-
     if (m_previewShown) {
         for (int index : qAsConst(visibleChangedIndexes)) {
             m_pendingPreviewItems.append(m_model->fileItem(index));
@@ -990,7 +1864,7 @@ void KFileItemModelRolesUpdater::updateChangedItems()
             m_pendingPreviewItems.append(m_model->fileItem(index));
         }
 
-        if (!m_previewJob) {
+        if (m_previewJobs.count() < m_maximumPreviewJobs) {
             startPreviewJob();
         }
     } else {
@@ -998,7 +1872,7 @@ void KFileItemModelRolesUpdater::updateChangedItems()
         m_pendingIndexes = visibleChangedIndexes + m_pendingIndexes + invisibleChangedIndexes;
         if (!resolvingInProgress) {
             // Trigger the asynchronous resolving of the changed roles.
-            m_state = ResolvingAllRoles;
+            setState(ResolvingAllRoles);
             QTimer::singleShot(0, this, &KFileItemModelRolesUpdater::resolveNextPendingRoles);
         }
     }
@@ -1011,14 +1885,15 @@ void KFileItemModelRolesUpdater::applySortRole(int index)
 
     if (m_model->sortRole() == "type") {
         if (!item.isMimeTypeKnown()) {
-            item.determineMimeType();
+            // Sort by the type that is guessed from the file name. The model
+            // resorts the item if the determined MIME-type differs.
+            m_model->resolveMimeTypes(KFileItemList{item});
         }
 
         data.insert("type", item.mimeComment());
-    } else if (m_model->sortRole() == "size" && item.isLocalFile() && item.isDir()) {
-        const QString path = item.localPath();
+    } else if (m_model->sortRole() == "size" && !item.localPath().isEmpty() && item.isDir()) {
         if (m_scanDirectories) {
-            m_directoryContentsCounter->scanDirectory(path);
+            m_directoryContentsCounter->scanDirectory(item);
         }
     } else {
         // Probably the sort role is a baloo role - just determine all roles.
@@ -1036,7 +1911,7 @@ void KFileItemModelRolesUpdater::applySortProgressToModel()
 {
     // Inform the model about the progress of the resolved items,
     // so that it can give an indication when the sorting has been finished.
-    const int resolvedCount = m_model->count() - m_pendingSortRoleItems.count();
+    const int resolvedCount = m_model->count() - m_itemStates.flagCount(PendingSortRoleItem);
     m_model->emitSortProgress(resolvedCount);
 }
 
@@ -1045,13 +1920,22 @@ bool KFileItemModelRolesUpdater::applyResolvedRoles(int index, ResolveHint hint)
     const KFileItem item = m_model->fileItem(index);
     const bool resolveAll = (hint == ResolveAll);
 
+    QElapsedTimer timer;
+    timer.start();
+
     bool iconChanged = false;
-    if (!item.isMimeTypeKnown() || !item.isFinalIconKnown()) {
+    if (!item.isMimeTypeKnown()) {
+        // The icon that is guessed from the file name is shown until
+        // the MIME-type has been determined without blocking.
+        m_model->resolveMimeTypes(KFileItemList{item});
+        iconChanged = true;
+    } else if (!item.isFinalIconKnown()) {
         item.determineMimeType();
         iconChanged = true;
     } else if (!m_model->data(index).contains("iconName")) {
         iconChanged = true;
     }
+    KItemListMetrics::instance().add(KItemListMetrics::RoleIconNsecs, timer.nsecsElapsed());
 
     if (iconChanged || resolveAll || m_clearPreviews) {
         if (index < 0) {
@@ -1071,104 +1955,546 @@ bool KFileItemModelRolesUpdater::applyResolvedRoles(int index, ResolveHint hint)
             data.insert("iconPixmap", QPixmap());
         }
 
-        disconnect(m_model, &KFileItemModel::itemsChanged,
-                   this,    &KFileItemModelRolesUpdater::slotItemsChanged);
-        m_model->setData(index, data);
-        connect(m_model, &KFileItemModel::itemsChanged,
-                this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+        setRoleValues(index, data);
         return true;
     }
 
     return false;
 }
 
+void KFileItemModelRolesUpdater::setRoleValues(int index, const QHash<QByteArray, QVariant>& values)
+{
+    QHash<QByteArray, QVariant>& pendingValues = m_pendingRoleValues[m_model->itemId(index)];
+    if (pendingValues.isEmpty()) {
+        // Sharing the values avoids copying them
+        pendingValues = values;
+    } else {
+        for (auto it = values.constBegin(); it != values.constEnd(); ++it) {
+            pendingValues.insert(it.key(), it.value());
+        }
+    }
+
+    if (!m_pendingRoleValuesTimer->isActive()) {
+        m_pendingRoleValuesTimer->start();
+    }
+}
+
+void KFileItemModelRolesUpdater::applyPendingRoleValues()
+{
+    m_pendingRoleValuesTimer->stop();
+    if (m_pendingRoleValues.isEmpty()) {
+        return;
+    }
+
+    QHash<int, QHash<QByteArray, QVariant> > itemsData;
+    itemsData.reserve(m_pendingRoleValues.count());
+    for (auto it = m_pendingRoleValues.constBegin(); it != m_pendingRoleValues.constEnd(); ++it) {
+        // The items might have been removed or moved in the meantime.
+        const int index = m_model->indexForItemId(it.key());
+        if (index >= 0) {
+            itemsData.insert(index, it.value());
+        }
+    }
+    m_pendingRoleValues.clear();
+
+    disconnect(m_model, &KFileItemModel::itemsChanged,
+               this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+    m_model->setItemsData(itemsData);
+    connect(m_model, &KFileItemModel::itemsChanged,
+            this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+}
+
 QHash<QByteArray, QVariant> KFileItemModelRolesUpdater::rolesData(const KFileItem& item)
 {
     QHash<QByteArray, QVariant> data;
 
+    // The time of each provider is accumulated separately, so that
+    // the metrics show which provider makes the resolving slow
+    KItemListMetrics& metrics = KItemListMetrics::instance();
+    metrics.add(KItemListMetrics::RoleResolutions);
+    QElapsedTimer timer;
+    timer.start();
+    const auto addElapsedTime = [&metrics, &timer](KItemListMetrics::Metric metric) {
+        metrics.add(metric, timer.nsecsElapsed());
+        timer.restart();
+    };
+
     const bool getSizeRole = m_roles.contains("size");
     const bool getIsExpandableRole = m_roles.contains("isExpandable");
 
     if ((getSizeRole || getIsExpandableRole) && item.isDir()) {
-        if (item.isLocalFile()) {
+        if (!item.localPath().isEmpty()) {
             // Tell m_directoryContentsCounter that we want to count the items
             // inside the directory. The result will be received in slotDirectoryContentsCountReceived.
+            // Items of e.g. desktop:/ are counted by their local path.
             if (m_scanDirectories) {
-                const QString path = item.localPath();
-                m_directoryContentsCounter->scanDirectory(path);
+                m_directoryContentsCounter->scanDirectory(item);
             }
         } else if (getSizeRole) {
             data.insert("size", -1); // -1 indicates an unknown number of items
         }
     }
+    addElapsedTime(KItemListMetrics::RoleDirectoryCountNsecs);
 
     if (m_roles.contains("type")) {
         data.insert("type", item.mimeComment());
     }
+    addElapsedTime(KItemListMetrics::RoleTypeNsecs);
 
+    // The overlays of the plugins are determined in time slices and are
+    // applied by slotOverlaysResolved() if they are not cached yet
     QStringList overlays = item.overlays();
-    for (KOverlayIconPlugin *it : qAsConst(m_overlayIconsPlugin)) {
-        overlays.append(it->getOverlays(item.url()));
+    KOverlayIconResolver& overlayIconResolver = KOverlayIconResolver::instance();
+    if (overlayIconResolver.hasPlugins()) {
+        QStringList pluginOverlays;
+        if (overlayIconResolver.cachedOverlays(item.url(), pluginOverlays)) {
+            overlays.append(pluginOverlays);
+        } else {
+            overlayIconResolver.requestOverlays({item.url()});
+        }
     }
     data.insert("iconOverlays", overlays);
+    addElapsedTime(KItemListMetrics::RoleOverlaysNsecs);
 
 #ifdef HAVE_BALOO
     if (m_balooFileMonitor) {
         m_balooFileMonitor->addFile(item.localPath());
-        applyChangedBalooRolesForItem(item);
+
+        const QHash<QByteArray, QVariant> balooValues = KBalooRolesProvider::instance().roleValues(KFileItemList{item}, m_roles).value(item.url());
+        for (auto it = balooValues.constBegin(); it != balooValues.constEnd(); ++it) {
+            data.insert(it.key(), it.value());
+        }
+        addElapsedTime(KItemListMetrics::RoleBalooNsecs);
     }
 #endif
     return data;
 }
 
-void KFileItemModelRolesUpdater::slotOverlaysChanged(const QUrl& url, const QStringList &)
+void KFileItemModelRolesUpdater::slotOverlaysResolved(const QHash<QUrl, QStringList>& overlays)
 {
-    const KFileItem item = m_model->fileItem(url);
-    if (item.isNull()) {
-        return;
+    bool previewsOutdated = false;
+    for (auto it = overlays.constBegin(); it != overlays.constEnd(); ++it) {
+        const int index = m_model->index(it.key());
+        if (index < 0) {
+            continue;
+        }
+
+        const KFileItem item = m_model->fileItem(index);
+        const QStringList itemOverlays = item.overlays() + it.value();
+        const QHash<QByteArray, QVariant> data = m_model->data(index);
+        if (data.value("iconOverlays").toStringList() == itemOverlays) {
+            continue;
+        }
+
+        if (!data.value("iconPixmap").value<QPixmap>().isNull()) {
+            // The overlays are drawn into the previews, so the preview
+            // gets outdated. It is usually available in KPreviewCache.
+            m_itemStates.setFlag(index, ChangedItem);
+            previewsOutdated = true;
+        }
+        setRoleValues(index, {{"iconOverlays", itemOverlays}});
     }
-    const int index = m_model->index(item);
-    QHash<QByteArray, QVariant> data =  m_model->data(index);
-    QStringList overlays = item.overlays();
-    for (KOverlayIconPlugin *it : qAsConst(m_overlayIconsPlugin)) {
-        overlays.append(it->getOverlays(url));
+
+    if (previewsOutdated) {
+        updateChangedItems();
     }
-    data.insert("iconOverlays", overlays);
-    m_model->setData(index, data);
 }
 
 void KFileItemModelRolesUpdater::updateAllPreviews()
 {
+    stopHoverSequence();
+    m_previewsIconSize = m_iconSize;
+    ++m_previewGeneration;
     if (m_state == Paused) {
         m_previewChangedDuringPausing = true;
     } else {
-        m_finishedItems.clear();
+        m_itemStates.clearFlag(FinishedItem);
         startUpdating();
     }
 }
 
-void KFileItemModelRolesUpdater::killPreviewJob()
+void KFileItemModelRolesUpdater::updateSnapshotContext()
+{
+    QStringList roles;
+    roles.reserve(m_roles.count());
+    for (const QByteArray& role : qAsConst(m_roles)) {
+        roles.append(QString::fromLatin1(role));
+    }
+    roles.sort();
+
+    QStringList plugins = m_enabledPlugins;
+    plugins.sort();
+
+    const QStringList context = {
+        QString::number(m_previewShown),
+        QString::number(m_iconSize.width()),
+        QString::number(m_iconSize.height()),
+        QString::number(m_devicePixelRatio),
+        QString::number(m_enlargeSmallPreviews),
+        QString::number(m_localFileSizePreviewLimit),
+        QString::number(m_scanDirectories),
+        roles.join(QLatin1Char(',')),
+        plugins.join(QLatin1Char(','))
+    };
+    m_model->setSnapshotContext(context.join(QLatin1Char(';')).toUtf8());
+}
+
+void KFileItemModelRolesUpdater::applyRestoredItems()
+{
+    const KFileItemList items = m_model->takeRestoredItems();
+    if (items.isEmpty() || m_itemStates.count() != m_model->count()) {
+        // If the indexes of the model don't match m_itemStates yet,
+        // the restored items are resolved again
+        return;
+    }
+
+    static const QByteArray iconOverlaysRole = KItemRoleRegistry::intern("iconOverlays");
+    static const QByteArray iconPixmapRole = KItemRoleRegistry::intern("iconPixmap");
+    static const QByteArray sizeRole = KItemRoleRegistry::intern("size");
+
+    const bool countItems = m_roles.contains(sizeRole) && m_scanDirectories;
+    for (const KFileItem& item : items) {
+        const int index = m_model->index(item);
+        if (index < 0) {
+            continue;
+        }
+
+        const QHash<QByteArray, QVariant> data = m_model->data(index);
+        const bool finished = data.contains(iconOverlaysRole)
+                           && (!m_previewShown || data.contains(iconPixmapRole))
+                           && (!countItems || !item.isDir() || data.contains(sizeRole));
+        if (finished) {
+            m_itemStates.setFlag(index, FinishedItem);
+        }
+    }
+}
+
+void KFileItemModelRolesUpdater::startSequenceJob()
+{
+    m_sequenceJobPending = false;
+    if (KPreviewJobLimiter::instance().acquire(1, KPreviewJobLimiter::LowPriority) == 0) {
+        m_sequenceJobPending = true;
+        return;
+    }
+
+    // Starting a job and a thumbnailer for each frame would be much slower
+    KFileItemList items;
+    for (int i = m_sequenceFrames.count(); i < SequenceFrameCount; ++i) {
+        items.append(m_sequenceItem);
+    }
+
+    m_sequenceJob = new KIO::PreviewJob(items, sequenceFrameSize(), &m_enabledPlugins);
+    m_sequenceJob->setSequenceIndex(m_sequenceFrames.count());
+    m_sequenceJobTimer.start();
+    m_sequenceJob->setIgnoreMaximumSize(m_sequenceItem.isLocalFile() && m_localFileSizePreviewLimit <= 0);
+
+    connect(m_sequenceJob, &KIO::PreviewJob::gotPreview,
+            this,          &KFileItemModelRolesUpdater::slotGotSequenceFrame);
+    connect(m_sequenceJob, &KIO::PreviewJob::failed,
+            this,          &KFileItemModelRolesUpdater::slotSequenceFrameFailed);
+    connect(m_sequenceJob, &KIO::PreviewJob::finished,
+            this,          &KFileItemModelRolesUpdater::slotSequenceJobFinished);
+
+    if (!m_stalledPreviewJobsTimer->isActive()) {
+        m_stalledPreviewJobsTimer->start();
+    }
+}
+
+void KFileItemModelRolesUpdater::killSequenceJob()
+{
+    if (m_sequenceJob) {
+        disconnect(m_sequenceJob, nullptr, this, nullptr);
+        m_sequenceJob->kill();
+        m_sequenceJob = nullptr;
+        KPreviewJobLimiter::instance().release();
+    }
+}
+
+void KFileItemModelRolesUpdater::storeHoverSequence()
+{
+    if (!m_sequenceFrames.isEmpty()) {
+        // Also sequences with one frame are stored, so that videos whose
+        // thumbnailer does not support sequences are not decoded again.
+        KPreviewCache::instance().insertSequence(m_sequenceItem, sequenceFrameSize(), m_enabledPlugins,
+                                                 sequenceStrip(m_sequenceFrames), m_sequenceFrames.count());
+    }
+    m_sequenceFrames.clear();
+}
+
+void KFileItemModelRolesUpdater::stopHoverSequence()
+{
+    killSequenceJob();
+
+    const int index = m_sequenceApplied ? m_model->index(m_sequenceItem) : -1;
+    if (index >= 0) {
+        QHash<QByteArray, QVariant> data;
+        data.insert("iconSequence", QPixmap());
+        data.insert("iconSequenceFrames", 0);
+
+        disconnect(m_model, &KFileItemModel::itemsChanged,
+                   this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+        m_model->setData(index, data);
+        connect(m_model, &KFileItemModel::itemsChanged,
+                this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+    }
+
+    m_sequenceItem = KFileItem();
+    m_sequenceFrames.clear();
+    m_sequenceJobPending = false;
+    m_sequenceApplied = false;
+}
+
+void KFileItemModelRolesUpdater::applyHoverSequence(const QImage& strip, int frameCount)
 {
-    if (m_previewJob) {
-        disconnect(m_previewJob,  &KIO::PreviewJob::gotPreview,
-                   this, &KFileItemModelRolesUpdater::slotGotPreview);
-        disconnect(m_previewJob,  &KIO::PreviewJob::failed,
-                   this, &KFileItemModelRolesUpdater::slotPreviewFailed);
-        disconnect(m_previewJob,  &KIO::PreviewJob::finished,
-                   this, &KFileItemModelRolesUpdater::slotPreviewJobFinished);
-        m_previewJob->kill();
-        m_previewJob = nullptr;
+    const int index = m_model->index(m_sequenceItem);
+    if (index < 0 || frameCount <= 1) {
+        return;
+    }
+
+    QPixmap pixmap = QPixmap::fromImage(strip);
+    pixmap.setDevicePixelRatio(m_devicePixelRatio);
+
+    QHash<QByteArray, QVariant> data;
+    data.insert("iconSequence", pixmap);
+    data.insert("iconSequenceFrames", frameCount);
+
+    disconnect(m_model, &KFileItemModel::itemsChanged,
+               this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+    m_model->setData(index, data);
+    connect(m_model, &KFileItemModel::itemsChanged,
+            this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+    m_sequenceApplied = true;
+}
+
+QSize KFileItemModelRolesUpdater::sequenceFrameSize() const
+{
+    return QSize(qRound(m_iconSize.width() * m_devicePixelRatio),
+                 qRound(m_iconSize.height() * m_devicePixelRatio));
+}
+
+QImage KFileItemModelRolesUpdater::sequenceStrip(const QVector<QImage>& frames)
+{
+    if (frames.count() == 1) {
+        return frames.first();
+    }
+
+    const QSize frameSize = frames.first().size();
+    QImage strip(frameSize.width() * frames.count(), frameSize.height(), QImage::Format_ARGB32_Premultiplied);
+    strip.fill(Qt::transparent);
+
+    QPainter painter(&strip);
+    for (int i = 0; i < frames.count(); ++i) {
+        painter.drawImage(i * frameSize.width(), 0, frames.at(i));
+    }
+    return strip;
+}
+
+void KFileItemModelRolesUpdater::killPreviewJobs()
+{
+    if (!m_previewJobs.isEmpty()) {
+        const QList<KIO::PreviewJob*> jobs = m_previewJobs;
+        for (KIO::PreviewJob* job : jobs) {
+            killPreviewJob(job);
+        }
         m_pendingPreviewItems.clear();
     }
 }
 
+void KFileItemModelRolesUpdater::killPreviewJob(KIO::PreviewJob* job)
+{
+    disconnect(job,  &KIO::PreviewJob::gotPreview,
+               this, &KFileItemModelRolesUpdater::slotGotPreview);
+    disconnect(job,  &KIO::PreviewJob::failed,
+               this, &KFileItemModelRolesUpdater::slotPreviewFailed);
+    disconnect(job,  &KIO::PreviewJob::finished,
+               this, &KFileItemModelRolesUpdater::slotPreviewJobFinished);
+    job->kill();
+
+    m_previewJobs.removeOne(job);
+    removePreviewJobItems(job);
+    KPreviewJobLimiter::instance().release();
+}
+
+void KFileItemModelRolesUpdater::removePreviewJobItems(KIO::PreviewJob* job)
+{
+    m_previewJobProgress.remove(job);
+
+    auto it = m_previewJobItems.begin();
+    while (it != m_previewJobItems.end()) {
+        if (it.value() == job) {
+            it = m_previewJobItems.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void KFileItemModelRolesUpdater::takePreviewJobItem(const KFileItem& item)
+{
+    KIO::PreviewJob* job = m_previewJobItems.take(item);
+    if (!job) {
+        // The items that are skipped without a job are not counted
+        return;
+    }
+
+    ++m_previewCount;
+    const auto it = m_previewJobProgress.find(job);
+    if (it != m_previewJobProgress.end()) {
+        it->sinceLastPreview.start();
+    }
+}
+
+void KFileItemModelRolesUpdater::abortStalledPreviewJob(KIO::PreviewJob* job)
+{
+    // The job handles its items one after another, so it hangs on
+    // the first item for which it has not reported a result yet
+    KFileItem stalledItem;
+    KFileItemList remainingItems;
+    const KFileItemList items = m_previewJobProgress.value(job).items;
+    for (const KFileItem& item : items) {
+        if (m_previewJobItems.value(item) != job) {
+            continue;
+        }
+        if (stalledItem.isNull()) {
+            stalledItem = item;
+        } else {
+            remainingItems.append(item);
+        }
+    }
+
+    if (!stalledItem.isNull()) {
+        qCWarning(DolphinDebug) << "Creating the preview of" << stalledItem.url() << "has timed out";
+        markPreviewTimedOut(stalledItem);
+
+        // The time waited for the timed out preview would dominate the
+        // average, so neither the time nor the preview are counted
+        const qint64 stalledTime = m_previewJobProgress.value(job).sinceLastPreview.elapsed();
+        const int previewCount = m_previewCount;
+        slotPreviewFailed(stalledItem);
+        if (m_previewCount > previewCount) {
+            --m_previewCount;
+            m_previewTime -= stalledTime;
+        }
+    }
+    killPreviewJob(job);
+
+    remainingItems.append(m_pendingPreviewItems);
+    m_pendingPreviewItems = remainingItems;
+}
+
+void KFileItemModelRolesUpdater::abortStalledSequenceJob()
+{
+    qCWarning(DolphinDebug) << "Creating the thumbnail sequence of" << m_sequenceItem.url() << "has timed out";
+
+    // The frames that have been received are kept like the frames of a
+    // sequence that has been finished
+    killSequenceJob();
+    storeHoverSequence();
+}
+
+KFileItem KFileItemModelRolesUpdater::currentPreviewJobItem(KIO::PreviewJob* job) const
+{
+    const KFileItemList items = m_previewJobProgress.value(job).items;
+    for (const KFileItem& item : items) {
+        if (m_previewJobItems.value(item) == job) {
+            return item;
+        }
+    }
+    return KFileItem();
+}
+
+int KFileItemModelRolesUpdater::previewTimeout(const KFileItem& item)
+{
+    const QString localPath = item.localPath();
+    if (localPath.isEmpty() || KIoGovernor::instance().isSlow(localPath)) {
+        return PreviewTimeout * SlowPreviewTimeoutFactor;
+    }
+    return PreviewTimeout;
+}
+
+void KFileItemModelRolesUpdater::markPreviewTimedOut(const KFileItem& item)
+{
+    const QDateTime modificationTime = item.time(KFileItem::ModificationTime);
+    TimedOutPreview* timedOut = s_timedOutPreviews->object(item.url());
+    if (!timedOut || timedOut->modificationTime != modificationTime
+            || timedOut->lastTimeout.hasExpired(TimedOutPreviewLifetime)) {
+        timedOut = new TimedOutPreview{modificationTime, QElapsedTimer(), 0};
+        s_timedOutPreviews->insert(item.url(), timedOut);
+    }
+    ++timedOut->count;
+    timedOut->lastTimeout.start();
+}
+
+bool KFileItemModelRolesUpdater::isPreviewTimedOut(const KFileItem& item)
+{
+    const TimedOutPreview* timedOut = s_timedOutPreviews->object(item.url());
+    if (!timedOut) {
+        return false;
+    }
+
+    if (timedOut->modificationTime != item.time(KFileItem::ModificationTime)
+            || timedOut->lastTimeout.hasExpired(TimedOutPreviewLifetime)) {
+        s_timedOutPreviews->remove(item.url());
+        return false;
+    }
+    return timedOut->count >= MaximumPreviewTimeouts;
+}
+
+void KFileItemModelRolesUpdater::retryTimedOutPreviews(const QUrl& url)
+{
+    const QList<QUrl> timedOutUrls = s_timedOutPreviews->keys();
+    for (const QUrl& timedOutUrl : timedOutUrls) {
+        if (url.isParentOf(timedOutUrl)) {
+            s_timedOutPreviews->remove(timedOutUrl);
+        }
+    }
+}
+
+void KFileItemModelRolesUpdater::cancelInvisiblePreviews()
+{
+    if (m_previewJobs.isEmpty()) {
+        return;
+    }
+
+    QSet<KIO::PreviewJob*> busyJobs;
+    auto it = m_previewJobItems.begin();
+    while (it != m_previewJobItems.end()) {
+        const int index = m_model->index(it.key());
+        const bool visible = (index >= m_firstVisibleIndex && index <= m_lastVisibleIndex);
+        const bool target = (index >= m_firstTargetIndex && index <= m_lastTargetIndex);
+        if (!visible && !target) {
+            it.value()->removeItem(it.key().url());
+            it = m_previewJobItems.erase(it);
+        } else {
+            busyJobs.insert(it.value());
+            ++it;
+        }
+    }
+
+    if (busyJobs.isEmpty()) {
+        killPreviewJobs();
+        return;
+    }
+
+    // Kill the jobs that don't have any visible items left. The pending
+    // items get rescheduled for the new visible range.
+    const QList<KIO::PreviewJob*> jobs = m_previewJobs;
+    for (KIO::PreviewJob* job : jobs) {
+        if (!busyJobs.contains(job)) {
+            killPreviewJob(job);
+        }
+    }
+    m_pendingPreviewItems.clear();
+}
+
 QList<int> KFileItemModelRolesUpdater::indexesToResolve() const
 {
     const int count = m_model->count();
+    const int resolveAllItemsLimit = KItemListCostModel::instance().resolveAllItemsLimit();
 
     QList<int> result;
     result.reserve(qMin(count, (m_lastVisibleIndex - m_firstVisibleIndex + 1) +
-                               ResolveAllItemsLimit +
+                               resolveAllItemsLimit +
                                (2 * m_maximumVisibleItems)));
 
     // Add visible items.
@@ -1176,48 +2502,136 @@ QList<int> KFileItemModelRolesUpdater::indexesToResolve() const
         result.append(i);
     }
 
+    // Add the items that will be visible at the end of a running scroll
+    // animation, so that they are resolved before they become visible.
+    const int firstTargetIndex = qMax(0, m_firstTargetIndex);
+    const int lastTargetIndex = qMin(m_lastTargetIndex, count - 1);
+    const auto isTargetIndex = [=](int index) {
+        return index >= firstTargetIndex && index <= lastTargetIndex;
+    };
+    for (int i = firstTargetIndex; i <= lastTargetIndex; ++i) {
+        if (i < m_firstVisibleIndex || i > m_lastVisibleIndex) {
+            result.append(i);
+        }
+    }
+
     // We need a reasonable upper limit for number of items to resolve after
     // and before the visible range. m_maximumVisibleItems can be quite large
     // when using Compact View.
-    const int readAheadItems = qMin(ReadAheadPages * m_maximumVisibleItems, ResolveAllItemsLimit / 2);
+    int readAheadItems = qMin(ReadAheadPages * m_maximumVisibleItems, resolveAllItemsLimit / 2);
+    int readBehindItems = readAheadItems;
+
+    // While scrolling fast, most of the items will have left the viewport
+    // before their roles could be shown. Only resolve the next page in
+    // scroll direction in this case.
+    const bool scrollingFast = isScrollingFast();
+    if (m_lowPriority) {
+        readAheadItems = 0;
+        readBehindItems = 0;
+    } else if (scrollingFast) {
+        readAheadItems = qMin(m_maximumVisibleItems, readAheadItems);
+        readBehindItems = 0;
+    }
+
+    const int endExtendedVisibleRange = qMin(m_lastVisibleIndex + (m_scrollingBackward ? readBehindItems : readAheadItems),
+                                             count - 1);
+    const int beginExtendedVisibleRange = qMax(0, m_firstVisibleIndex - (m_scrollingBackward ? readAheadItems : readBehindItems));
+
+    const auto addItemsAfterVisibleRange = [&]() {
+        for (int i = m_lastVisibleIndex + 1; i <= endExtendedVisibleRange; ++i) {
+            if (!isTargetIndex(i)) {
+                result.append(i);
+            }
+        }
+    };
 
-    // Add items after the visible range.
-    const int endExtendedVisibleRange = qMin(m_lastVisibleIndex + readAheadItems, count - 1);
-    for (int i = m_lastVisibleIndex + 1; i <= endExtendedVisibleRange; ++i) {
-        result.append(i);
+    // Items before the visible range are added in reverse order.
+    const auto addItemsBeforeVisibleRange = [&]() {
+        for (int i = m_firstVisibleIndex - 1; i >= beginExtendedVisibleRange; --i) {
+            if (!isTargetIndex(i)) {
+                result.append(i);
+            }
+        }
+    };
+
+    // Add the items in scroll direction first.
+    if (m_scrollingBackward) {
+        addItemsBeforeVisibleRange();
+        addItemsAfterVisibleRange();
+    } else {
+        addItemsAfterVisibleRange();
+        addItemsBeforeVisibleRange();
     }
 
-    // Add items before the visible range in reverse order.
-    const int beginExtendedVisibleRange = qMax(0, m_firstVisibleIndex - readAheadItems);
-    for (int i = m_firstVisibleIndex - 1; i >= beginExtendedVisibleRange; --i) {
-        result.append(i);
+    if (scrollingFast) {
+        return result;
     }
 
     // Add items on the last page.
     const int beginLastPage = qMax(endExtendedVisibleRange + 1, count - m_maximumVisibleItems);
     for (int i = beginLastPage; i < count; ++i) {
-        result.append(i);
+        if (!isTargetIndex(i)) {
+            result.append(i);
+        }
     }
 
     // Add items on the first page.
     const int endFirstPage = qMin(beginExtendedVisibleRange, m_maximumVisibleItems);
     for (int i = 0; i < endFirstPage; ++i) {
-        result.append(i);
+        if (!isTargetIndex(i)) {
+            result.append(i);
+        }
     }
 
-    // Continue adding items until ResolveAllItemsLimit is reached.
-    int remainingItems = ResolveAllItemsLimit - result.count();
+    // Continue adding items until resolveAllItemsLimit is reached.
+    int remainingItems = resolveAllItemsLimit - result.count();
 
     for (int i = endExtendedVisibleRange + 1; i < beginLastPage && remainingItems > 0; ++i) {
-        result.append(i);
-        --remainingItems;
+        if (!isTargetIndex(i)) {
+            result.append(i);
+            --remainingItems;
+        }
     }
 
     for (int i = beginExtendedVisibleRange - 1; i >= endFirstPage && remainingItems > 0; --i) {
-        result.append(i);
-        --remainingItems;
+        if (!isTargetIndex(i)) {
+            result.append(i);
+            --remainingItems;
+        }
     }
 
     return result;
 }
 
+void KFileItemModelRolesUpdater::setState(State state)
+{
+    if (state == m_state) {
+        return;
+    }
+    if (m_state == PreviewJobRunning) {
+        m_previewTime += m_previewTimer.elapsed();
+    } else if (state == PreviewJobRunning) {
+        m_previewTimer.start();
+    }
+    m_state = state;
+
+    if (!KItemListTracer::isEnabled()) {
+        return;
+    }
+
+    KItemListTracer::addCounter("KFileItemModelRolesUpdater::state", state);
+    if (state == Idle) {
+        if (m_updatingTraceStart >= 0) {
+            // The time from the loading of a directory until the previews
+            // of the visible items are shown is split into the loading of
+            // the model and this phase.
+            const char* name = m_previewShown ? "KFileItemModelRolesUpdater::timeToAllPreviews"
+                                              : "KFileItemModelRolesUpdater::timeToAllRoles";
+            KItemListTracer::addAsyncEvent(name, this, m_updatingTraceStart,
+                                           KItemListTracer::timestamp() - m_updatingTraceStart);
+            m_updatingTraceStart = -1;
+        }
+    } else if (state != Paused && m_updatingTraceStart < 0) {
+        m_updatingTraceStart = KItemListTracer::timestamp();
+    }
+}
@@ -9,20 +9,27 @@
 
 #include "dolphin_export.h"
 #include "kitemviews/kitemmodelbase.h"
+#include "kitemviews/private/kitemstateflags.h"
+#include "kitemviews/private/kmemorybudget.h"
 
 #include <KFileItem>
 #include <config-baloo.h>
 
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QImage>
 #include <QObject>
 #include <QSet>
 #include <QSize>
 #include <QStringList>
+#include <QVector>
 
 class KDirectoryContentsCounter;
 class KFileItemModel;
+class KJob;
 class QPixmap;
 class QTimer;
-class KOverlayIconPlugin;
 
 namespace KIO {
     class PreviewJob;
@@ -75,7 +82,7 @@ namespace KIO {
  * 3.   Finally, the entire process is repeated for any items that might have
  *      changed in the mean time.
  */
-class DOLPHIN_EXPORT KFileItemModelRolesUpdater : public QObject
+class DOLPHIN_EXPORT KFileItemModelRolesUpdater : public QObject, public KMemoryBudget::Consumer
 {
     Q_OBJECT
 
@@ -83,9 +90,24 @@ public:
     explicit KFileItemModelRolesUpdater(KFileItemModel* model, QObject* parent = nullptr);
     ~KFileItemModelRolesUpdater() override;
 
+    /**
+     * Sets the icon size to \a size. The previews are regenerated if \a size
+     * is larger or considerably smaller than the size the previews have been
+     * created for. Otherwise the item widgets shrink the existing previews,
+     * which makes zooming out fast.
+     */
     void setIconSize(const QSize& size);
     QSize iconSize() const;
 
+    /**
+     * Sets the device pixel ratio of the screen that shows the items. The
+     * previews are requested and scaled in device pixels, so that they are
+     * not upscaled on high-DPI screens. The default is the device pixel
+     * ratio of the application.
+     */
+    void setDevicePixelRatio(qreal dpr);
+    qreal devicePixelRatio() const;
+
     /**
      * Sets the range of items that are visible currently. The roles
      * of visible items are resolved first.
@@ -94,6 +116,33 @@ public:
 
     void setMaximumVisibleItems(int count);
 
+    /**
+     * Sets the range of items that will be visible at the end of a running
+     * scroll animation. The roles and previews of these items are resolved
+     * directly after the visible items, so that they are available when the
+     * items become visible. The range is reset as soon as it is covered by
+     * the visible index range, when the scrolling has been stopped before
+     * and when items are inserted, removed or moved.
+     */
+    void setTargetIndexRange(int index, int count);
+
+    /**
+     * Sets the scroll velocity in visible pages per second. A positive value
+     * means that the view is scrolled towards the end of the model. Items in
+     * the scroll direction are resolved before the items in the opposite
+     * direction. While scrolling fast, only the visible items and the next
+     * page in scroll direction are resolved. The velocity 0 indicates that
+     * the scrolling has been stopped, the last scroll direction is kept.
+     */
+    void setScrollVelocity(qreal velocity);
+    qreal scrollVelocity() const;
+
+    /**
+     * @return True if the scroll velocity is so high that resolving items
+     *         outside the visible area is not worthwhile.
+     */
+    bool isScrollingFast() const;
+
     /**
      * If \a show is set to true, the "iconPixmap" role will be filled with a preview
      * of the file. If \a show is false the MIME type icon will be used for the "iconPixmap"
@@ -113,7 +162,9 @@ public:
     /**
      * If \a paused is set to true the asynchronous resolving of roles will be paused.
      * State changes during pauses like changing the icon size or the preview-shown
-     * will be remembered and handled after unpausing.
+     * will be remembered and handled after unpausing. Items and directories
+     * that have been changed during pauses are resolved and counted once
+     * after unpausing, independent from the number of changes.
      */
     void setPaused(bool paused);
     bool isPaused() const;
@@ -159,6 +210,71 @@ public:
     void setScanDirectories(bool enabled);
     bool scanDirectories() const;
 
+    /**
+     * If set to true, the view is visible but has not the focus, like the
+     * inactive view of a split view. Only the visible items are resolved
+     * and the previews are created with KPreviewJobLimiter::LowPriority,
+     * so that the active view gets most of the resources. The items that
+     * are shown in both views benefit from the previews and sizes in the
+     * shared caches anyway. Per default false.
+     */
+    void setLowPriority(bool lowPriority);
+    bool isLowPriority() const;
+
+    /**
+     * Creates a thumbnail sequence of the video \a item, which is hovered
+     * by the mouse, so that the user can scrub through the video. The
+     * frames are created with the icon size one after another by a single
+     * preview job that uses one KPreviewJobLimiter::LowPriority slot. They are applied as the role
+     * "iconSequence", which contains the frames side by side, and the role
+     * "iconSequenceFrames", which contains the number of frames. The
+     * complete sequence is stored in KPreviewCache.
+     *
+     * The sequence of the previously hovered item is removed from the
+     * model. A null item only stops the creation of the sequence.
+     */
+    void setHoverSequenceItem(const KFileItem& item);
+
+    /**
+     * @return Average time in milliseconds that has been spent per created
+     *         or failed preview since the last resetPreviewStatistics(), or
+     *         -1 if no preview has been created. As the preview jobs run in
+     *         parallel, it is the time that the user waits for a preview.
+     *         Previews that have timed out are not counted.
+     */
+    int averagePreviewTime() const;
+    void resetPreviewStatistics();
+
+    /**
+     * Forgets the timed out previews of the items inside the directory
+     * \a url, so that they are created again, e.g. if it is reloaded.
+     */
+    static void retryTimedOutPreviews(const QUrl& url);
+
+    QString memoryConsumerName() const override;
+
+    /**
+     * @return Estimated number of bytes used by the pending items and role
+     *         values and by the previews that have not been applied to the
+     *         model yet. The applied previews are accounted by the model.
+     *         See KMemoryBudget.
+     */
+    qint64 memoryUsage() const override;
+
+    /**
+     * Removes the previews of the items that are far away from the visible
+     * area from the model. They are created again when the items get close
+     * to the visible area.
+     */
+    qint64 releaseMemory(qint64 bytes) override;
+
+    /**
+     * @return Estimated number of bytes used by the previews that
+     *         releaseMemory() would remove from the model.
+     */
+    qint64 releasableMemory() const override;
+    ReleaseOrder releaseOrder() const override;
+
 private Q_SLOTS:
     void slotItemsInserted(const KItemRangeList& itemRanges);
     void slotItemsRemoved(const KItemRangeList& itemRanges);
@@ -181,17 +297,66 @@ private Q_SLOTS:
     void slotPreviewFailed(const KFileItem& item);
 
     /**
-     * Is invoked when the preview job has been finished. Starts a new preview
+     * Is invoked when the worker threads have processed the previews of
+     * m_processingPreviews. Applies them, and starts processing the
+     * previews that have been received in the meantime.
+     */
+    void slotPreviewsProcessed();
+
+    /**
+     * Is invoked when the preview job \a job has been finished. Starts a new preview
      * job if there are any interesting items without previews left, or updates
-     * the changed items otherwise.     *
+     * the changed items otherwise if no other preview job is running.
      * @see startPreviewJob()
      */
-    void slotPreviewJobFinished();
+    void slotPreviewJobFinished(KJob* job);
+
+    /**
+     * Is invoked periodically while preview jobs are running. A job that has
+     * not received a preview for previewTimeout() ms hangs on its current
+     * file, e.g. because a thumbnailer loops on a malformed file. The job is
+     * killed, which also terminates its worker process, the file keeps its
+     * icon and the remaining items get a new job with a new worker process.
+     * A hanging sequence job of the hovered item is killed the same way.
+     */
+    void slotCheckStalledPreviewJobs();
 
     /**
-     * Is invoked when one of the KOverlayIconPlugin emit the signal that an overlay has changed
+     * Is invoked when any roles updater has finished a preview job. Starts a
+     * new preview job if there are any interesting items without previews
+     * left, that are waiting for the limit of KPreviewJobLimiter.
      */
-    void slotOverlaysChanged(const QUrl& url, const QStringList&);
+    void slotPreviewJobsReleased();
+
+    /**
+     * Is invoked when KIoGovernor has classified \a mountPoint as slow or as
+     * fast again. If the shown directory is on the mount, the running preview
+     * jobs are stopped if the mount is slow, so that they don't saturate it.
+     * If it is fast again, the previews and the directory sizes that have been
+     * skipped are resolved.
+     */
+    void slotSlowMountsChanged(const QString& mountPoint);
+
+    /**
+     * Is invoked after a frame of the thumbnail sequence has been received.
+     * @see setHoverSequenceItem()
+     */
+    void slotGotSequenceFrame(const KFileItem& item, const QPixmap& pixmap);
+    void slotSequenceFrameFailed(const KFileItem& item);
+
+    /**
+     * Stores the thumbnail sequence in KPreviewCache after the job has
+     * created all frames.
+     */
+    void slotSequenceJobFinished(KJob* job);
+
+    /**
+     * Is invoked when KOverlayIconResolver has determined the overlays of
+     * the plugins for the URLs \a overlays, after they have been requested
+     * by rolesData() or a plugin has reported a change. The overlays are
+     * applied together with the other pending role values.
+     */
+    void slotOverlaysResolved(const QHash<QUrl, QStringList>& overlays);
 
     /**
      * Resolves the sort role of the next item in m_pendingSortRole, applies it
@@ -217,13 +382,32 @@ private Q_SLOTS:
     void applyChangedBalooRoles(const QString& file);
     void applyChangedBalooRolesForItem(const KFileItem& file);
 
-    void slotDirectoryContentsCountReceived(const QString& path, int count, long size);
+    void slotDirectoryContentsCountReceived(const QString& path, int count, qint64 size);
+
+    /**
+     * Applies the values that have been passed to setRoleValues() with
+     * one KFileItemModel::setItemsData() call.
+     */
+    void applyPendingRoleValues();
 
 private:
+    enum PreviewJobHint {
+        RestartPreviewJob,
+        KeepVisiblePreviews
+    };
+
     /**
      * Starts the updating of all roles. The visible items are handled first.
+     * If \a hint is KeepVisiblePreviews, running preview jobs are not killed,
+     * but only the generation of previews for invisible items is canceled.
      */
-    void startUpdating();
+    void startUpdating(PreviewJobHint hint = RestartPreviewJob);
+
+    /**
+     * Resets the target index range, so that only the visible items
+     * are preferred.
+     */
+    void resetTargetIndexRange();
 
     /**
      * Loads the icons for the visible items. After 200 ms, the function
@@ -236,13 +420,93 @@ private:
 
     /**
      * Creates previews for the items starting from the first item in
-     * m_pendingPreviewItems.
+     * m_pendingPreviewItems. Up to m_maximumPreviewJobs preview jobs are
+     * run in parallel, as far as KPreviewJobLimiter allows it.
      * @see slotGotPreview()
      * @see slotPreviewFailed()
      * @see slotPreviewJobFinished()
      */
     void startPreviewJob();
 
+    /**
+     * Passes the preview \a preview of the item \a item to the worker
+     * threads, that scale it and add a frame if required.
+     * @see slotPreviewsProcessed()
+     */
+    void processPreview(const KFileItem& item, const QImage& preview);
+
+    /**
+     * Starts processing all received previews in the worker threads,
+     * if the processing of the previous previews has been finished.
+     */
+    void startPreviewProcessing();
+
+    /**
+     * @return The preview \a preview scaled to the icon size \a iconSize,
+     *         and with a frame if required. Is invoked in worker threads.
+     */
+    static QImage scaledPreview(const QImage& preview, const QSize& iconSize,
+                                bool enlargeSmallPreviews, qreal devicePixelRatio);
+
+    struct ProcessedPreview {
+        KFileItem item;
+        QImage image;
+    };
+
+    /**
+     * Converts the processed previews to pixmaps, adds the overlays and
+     * applies them to the model with one KFileItemModel::setItemsData() call.
+     */
+    void applyPreviews(const QVector<ProcessedPreview>& previews);
+
+    /**
+     * Applies the previews that are available in KPreviewCache to the items
+     * of m_pendingPreviewItems and removes those items from the list, so that
+     * no preview job is required for them.
+     */
+    void applyCachedPreviews();
+
+    /**
+     * Removes the items on mounts that KIoGovernor has classified as slow
+     * from m_pendingPreviewItems. Creating their previews would read the
+     * files and saturate the mount, so they keep their icons.
+     */
+    void skipPreviewsOnSlowMounts();
+
+    /**
+     * Sets \a firstKeptIndex and \a lastKeptIndex to the range of the items
+     * whose previews are kept by releaseMemory().
+     * @return False if no previews may be released at all.
+     */
+    bool releasablePreviewsRange(int& firstKeptIndex, int& lastKeptIndex) const;
+
+    /**
+     * Removes the items whose preview creation has timed out before from
+     * m_pendingPreviewItems, see slotCheckStalledPreviewJobs(). They keep
+     * their icons unless they are modified.
+     */
+    void skipTimedOutPreviews();
+
+    /**
+     * @return Maximum time in ms that a blocking operation may take,
+     *         as determined by KItemListCostModel.
+     */
+    int maxBlockTimeout() const;
+
+    /**
+     * @return Size of the previews in device pixels that are requested from
+     *         KIO::PreviewJob. It is the smallest size class that covers the
+     *         icon size for the current device pixel ratio.
+     */
+    QSize previewCacheSize() const;
+
+    /**
+     * @return True if the previews that have been created for the icon size
+     *         m_previewsIconSize may not be stretched to the current icon
+     *         size without a visible loss of quality or too much memory.
+     */
+    bool iconSizeRequiresNewPreviews() const;
+
     /**
      * Ensures that icons, previews, and other roles are determined for any
      * items that have been changed.
@@ -261,6 +525,14 @@ private:
         ResolveAll
     };
     bool applyResolvedRoles(int index, ResolveHint hint);
+
+    /**
+     * Stores \a values as new values of the item with the index \a index.
+     * The values of all items are applied together by applyPendingRoleValues()
+     * at most once per frame, so that the view is not updated separately for
+     * each item.
+     */
+    void setRoleValues(int index, const QHash<QByteArray, QVariant>& values);
     QHash<QByteArray, QVariant> rolesData(const KFileItem& item);
 
     /**
@@ -269,10 +541,131 @@ private:
      */
     void updateAllPreviews();
 
-    void killPreviewJob();
+    /**
+     * @return The items \a items split into up to \a count lists, one for
+     *         each preview job. Items with the same MIME type are put into
+     *         the same list if there are more MIME types than lists, so that
+     *         a slow thumbnailer does not delay the previews of other types.
+     *         Otherwise the items of a MIME type are distributed over several
+     *         lists. The order of the items is kept within each list.
+     */
+    static QVector<KFileItemList> splitPreviewItems(const KFileItemList& items, int count);
+
+    void killPreviewJobs();
+    void killPreviewJob(KIO::PreviewJob* job);
+
+    /**
+     * Removes the items of the preview job \a job from m_previewJobItems.
+     */
+    void removePreviewJobItems(KIO::PreviewJob* job);
+
+    /**
+     * Removes \a item from m_previewJobItems after its preview job has
+     * created a preview for it or has failed. Counts the preview for
+     * averagePreviewTime() and resets the timeout of the job.
+     */
+    void takePreviewJobItem(const KFileItem& item);
+
+    /**
+     * Kills the preview job \a job that hangs on its current item and
+     * reschedules its remaining items.
+     */
+    void abortStalledPreviewJob(KIO::PreviewJob* job);
+
+    /**
+     * Kills m_sequenceJob, which hangs on the current frame, so that it
+     * releases its KPreviewJobLimiter slot. The received frames are kept.
+     */
+    void abortStalledSequenceJob();
+
+    /**
+     * @return Item of \a job for which no preview has been received yet and
+     *         on which the job works currently, or a null item.
+     */
+    KFileItem currentPreviewJobItem(KIO::PreviewJob* job) const;
+
+    /**
+     * @return Time in ms after which a preview job is considered to hang
+     *         on \a item. Remote files and files on slow mounts get longer.
+     */
+    static int previewTimeout(const KFileItem& item);
+
+    /**
+     * Remembers that creating the preview of \a item has timed out.
+     */
+    static void markPreviewTimedOut(const KFileItem& item);
+
+    /**
+     * @return True if the preview of \a item should not be created, as it
+     *         has timed out repeatedly and has not been modified meanwhile.
+     */
+    static bool isPreviewTimedOut(const KFileItem& item);
+
+    /**
+     * Removes the items that are not visible anymore from the running
+     * preview jobs. Jobs without any visible items left are killed.
+     */
+    void cancelInvisiblePreviews();
 
     QList<int> indexesToResolve() const;
 
+    /**
+     * Passes the settings that affect the determined roles to
+     * KFileItemModel::setSnapshotContext(), so that the roles of a restored
+     * snapshot are only reused if they are still valid.
+     */
+    void updateSnapshotContext();
+
+    /**
+     * Marks the items of a restored snapshot as finished if all roles
+     * have been determined already.
+     */
+    void applyRestoredItems();
+
+    /**
+     * Starts the preview job for the remaining frames of the thumbnail
+     * sequence of m_sequenceItem. The job gets m_sequenceItem once for
+     * each frame, and the sequence index is increased after each received
+     * frame. If no KPreviewJobLimiter slot is available, the job is
+     * started by slotPreviewJobsReleased().
+     */
+    void startSequenceJob();
+
+    /**
+     * Kills m_sequenceJob, e.g. because the remaining frames are not
+     * needed anymore, and releases its KPreviewJobLimiter slot.
+     */
+    void killSequenceJob();
+
+    /**
+     * Stores the received frames of the thumbnail sequence in KPreviewCache.
+     */
+    void storeHoverSequence();
+
+    /**
+     * Kills the sequence job and removes the thumbnail sequence of
+     * m_sequenceItem from the model.
+     */
+    void stopHoverSequence();
+
+    /**
+     * Applies the roles "iconSequence" and "iconSequenceFrames" to
+     * m_sequenceItem, if \a strip contains more than one frame.
+     */
+    void applyHoverSequence(const QImage& strip, int frameCount);
+
+    /**
+     * @return Size of the frames of thumbnail sequences in device pixels.
+     *         The frames are only as large as the icons, so that they are
+     *         created faster than the previews.
+     */
+    QSize sequenceFrameSize() const;
+
+    /**
+     * @return Image that contains \a frames side by side.
+     */
+    static QImage sequenceStrip(const QVector<QImage>& frames);
+
 private:
     enum State {
         Idle,
@@ -282,7 +675,17 @@ private:
         PreviewJobRunning
     };
 
+    /**
+     * Sets m_state to \a state. If the tracing is enabled, the state is
+     * recorded as counter and the time from leaving Idle until all roles
+     * and previews have been determined as asynchronous event.
+     */
+    void setState(State state);
+
     State m_state;
+    // Time when the updating has been started for KItemListTracer,
+    // -1 if the updater is idle or the tracing is disabled.
+    qint64 m_updatingTraceStart;
 
     // Property changes during pausing must be remembered to be able
     // to react when unpausing again:
@@ -301,23 +704,40 @@ private:
     // during the roles-updater has been paused by setPaused().
     bool m_clearPreviews;
 
-    // Remembers which items have been handled already, to prevent that
-    // previews and other expensive roles are determined again.
-    QSet<KFileItem> m_finishedItems;
+    // Flags of m_itemStates, which follow the model indexes of the items.
+    enum ItemState {
+        // The item has been handled already, to prevent that previews
+        // and other expensive roles are determined again.
+        FinishedItem = 0x1,
+        // The sort role still has to be determined for the item.
+        PendingSortRoleItem = 0x2,
+        // The item has been changed while m_recentlyChangedItemsTimer is active.
+        RecentlyChangedItem = 0x4,
+        // The item has been changed and has not been changed repeatedly recently.
+        ChangedItem = 0x8
+    };
+    KItemStateFlags m_itemStates;
 
     KFileItemModel* m_model;
     QSize m_iconSize;
+    qreal m_devicePixelRatio;
+
+    // Icon size for which the shown previews have been created. May differ
+    // from m_iconSize if the previews are shrunk after zooming out.
+    QSize m_previewsIconSize;
     int m_firstVisibleIndex;
     int m_lastVisibleIndex;
+    int m_firstTargetIndex;
+    int m_lastTargetIndex;
     int m_maximumVisibleItems;
+    qreal m_scrollVelocity;
+    bool m_scrollingBackward;
     QSet<QByteArray> m_roles;
     QSet<QByteArray> m_resolvableRoles;
     QStringList m_enabledPlugins;
     qulonglong m_localFileSizePreviewLimit;
     bool m_scanDirectories;
-
-    // Items for which the sort role still has to be determined.
-    QSet<KFileItem> m_pendingSortRoleItems;
+    bool m_lowPriority;
 
     // Indexes of items which still have to be handled by
     // resolveNextPendingRoles().
@@ -327,7 +747,54 @@ private:
     // A new preview job will be started from them once the first one finishes.
     KFileItemList m_pendingPreviewItems;
 
-    KIO::PreviewJob* m_previewJob;
+    int m_maximumPreviewJobs;
+    QList<KIO::PreviewJob*> m_previewJobs;
+
+    // Time spent in the state PreviewJobRunning and the number of previews
+    // received meanwhile, see averagePreviewTime()
+    QElapsedTimer m_previewTimer;
+    qint64 m_previewTime;
+    int m_previewCount;
+
+    // Items of each preview job in the order in which the job handles them,
+    // and the time since the job has received its last preview
+    struct PreviewJobProgress
+    {
+        KFileItemList items;
+        QElapsedTimer sinceLastPreview;
+    };
+    QHash<KIO::PreviewJob*, PreviewJobProgress> m_previewJobProgress;
+    QTimer* m_stalledPreviewJobsTimer;
+
+    // Hovered video for setHoverSequenceItem(), the job that creates the
+    // frames of its thumbnail sequence and the received frames.
+    KFileItem m_sequenceItem;
+    KIO::PreviewJob* m_sequenceJob;
+    // Time since m_sequenceJob has been started or has created the last
+    // frame, see slotCheckStalledPreviewJobs()
+    QElapsedTimer m_sequenceJobTimer;
+    QVector<QImage> m_sequenceFrames;
+    // True if the sequence job waits for a KPreviewJobLimiter slot
+    bool m_sequenceJobPending;
+    // True if the roles of the sequence have been applied to the model
+    bool m_sequenceApplied;
+
+    // Items which have been passed to one of m_previewJobs and for which no
+    // preview has been received yet, with the corresponding job.
+    QHash<KFileItem, KIO::PreviewJob*> m_previewJobItems;
+
+    // Is increased if the previews in the worker threads get outdated,
+    // e.g. because the icon size has been changed.
+    int m_previewGeneration;
+
+    // Previews that have been received and wait for being processed.
+    QVector<ProcessedPreview> m_receivedPreviews;
+
+    // Previews that are processed in the worker threads currently, and the
+    // m_previewGeneration they belong to.
+    QVector<ProcessedPreview> m_processingPreviews;
+    int m_processingPreviewsGeneration;
+    QFutureWatcher<void>* m_previewProcessingWatcher;
 
     // When downloading or copying large files, the slot slotItemsChanged()
     // will be called periodically within a quite short delay. To prevent
@@ -335,19 +802,27 @@ private:
     // will be postponed until no file change has been done within a longer period
     // of time.
     QTimer* m_recentlyChangedItemsTimer;
-    QSet<KFileItem> m_recentlyChangedItems;
 
-    // Items which have not been changed repeatedly recently.
-    QSet<KFileItem> m_changedItems;
+    // False while resolveNextSortRole() applies the sort progress, as the
+    // items are updated afterwards anyway.
+    bool m_updateOnItemsMoved;
 
-    KDirectoryContentsCounter* m_directoryContentsCounter;
+    // Values that have been passed to setRoleValues() and that will be
+    // applied to the model when m_pendingRoleValuesTimer is exceeded.
+    // The values are stored by the item identifier of the model, which
+    // stays valid if the item is moved in the meantime.
+    QHash<quint32, QHash<QByteArray, QVariant> > m_pendingRoleValues;
+    QTimer* m_pendingRoleValuesTimer;
 
-    QList<KOverlayIconPlugin*> m_overlayIconsPlugin;
+    KDirectoryContentsCounter* m_directoryContentsCounter;
 
 #ifdef HAVE_BALOO
     Baloo::FileMonitor* m_balooFileMonitor;
     Baloo::IndexerConfig m_balooConfig;
 #endif
+
+    friend class KFileItemModelPreviewBenchmark; // For benchmarking
+    friend class KFileItemModelRolesUpdaterTest; // For testing
 };
 
 #endif
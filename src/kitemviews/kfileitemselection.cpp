@@ -0,0 +1,173 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kfileitemselection.h"
+
+#include "kfileitemmodel.h"
+
+KFileItem KFileItemSelection::const_iterator::operator*() const
+{
+    return m_model->fileItem(*m_it);
+}
+
+KFileItemSelection::KFileItemSelection() :
+    KFileItemSelection(nullptr)
+{
+}
+
+KFileItemSelection::KFileItemSelection(const KFileItemModel* model) :
+    m_model(model),
+    m_indexes(),
+    m_summaryIndexes(),
+    m_summaryValid(false),
+    m_folderCount(0),
+    m_fileCount(0),
+    m_totalFileSize(0)
+{
+}
+
+void KFileItemSelection::setIndexes(const KItemSet& indexes)
+{
+    m_indexes = indexes;
+}
+
+KItemSet KFileItemSelection::indexes() const
+{
+    return m_indexes;
+}
+
+void KFileItemSelection::invalidateSummary()
+{
+    m_summaryValid = false;
+    m_summaryIndexes.clear();
+}
+
+int KFileItemSelection::count() const
+{
+    return m_indexes.count();
+}
+
+bool KFileItemSelection::isEmpty() const
+{
+    return m_indexes.isEmpty();
+}
+
+KFileItem KFileItemSelection::first() const
+{
+    if (!m_model || m_indexes.isEmpty()) {
+        return KFileItem();
+    }
+    return m_model->fileItem(m_indexes.first());
+}
+
+int KFileItemSelection::folderCount() const
+{
+    updateSummary();
+    return m_folderCount;
+}
+
+int KFileItemSelection::fileCount() const
+{
+    updateSummary();
+    return m_fileCount;
+}
+
+KIO::filesize_t KFileItemSelection::totalFileSize() const
+{
+    updateSummary();
+    return m_totalFileSize;
+}
+
+KFileItemList KFileItemSelection::toList() const
+{
+    KFileItemList items;
+    if (!m_model) {
+        return items;
+    }
+
+    items.reserve(m_indexes.count());
+    for (int index : m_indexes) {
+        items.append(m_model->fileItem(index));
+    }
+    return items;
+}
+
+QList<QUrl> KFileItemSelection::urlList() const
+{
+    QList<QUrl> urls;
+    if (!m_model) {
+        return urls;
+    }
+
+    urls.reserve(m_indexes.count());
+    for (int index : m_indexes) {
+        urls.append(m_model->fileItem(index).url());
+    }
+    return urls;
+}
+
+KFileItemSelection::const_iterator KFileItemSelection::begin() const
+{
+    return const_iterator(m_model, m_model ? m_indexes.constBegin() : m_indexes.constEnd());
+}
+
+KFileItemSelection::const_iterator KFileItemSelection::end() const
+{
+    return const_iterator(m_model, m_indexes.constEnd());
+}
+
+void KFileItemSelection::updateSummary() const
+{
+    if (m_summaryValid && m_summaryIndexes == m_indexes) {
+        return;
+    }
+
+    if (m_summaryValid) {
+        const KItemSet addedIndexes = m_indexes - m_summaryIndexes;
+        const KItemSet removedIndexes = m_summaryIndexes - m_indexes;
+        if (addedIndexes.count() + removedIndexes.count() < m_indexes.count()) {
+            addToSummary(addedIndexes, true);
+            addToSummary(removedIndexes, false);
+            m_summaryIndexes = m_indexes;
+            return;
+        }
+    }
+
+    // Calculating the summary from scratch is cheaper than
+    // applying the changes
+    m_folderCount = 0;
+    m_fileCount = 0;
+    m_totalFileSize = 0;
+    addToSummary(m_indexes, true);
+    m_summaryIndexes = m_indexes;
+    m_summaryValid = true;
+}
+
+void KFileItemSelection::addToSummary(const KItemSet& indexes, bool add) const
+{
+    if (!m_model) {
+        return;
+    }
+
+    const int sign = add ? 1 : -1;
+    for (int index : indexes) {
+        const KFileItem item = m_model->fileItem(index);
+        if (item.isNull()) {
+            continue;
+        }
+
+        if (item.isDir()) {
+            m_folderCount += sign;
+        } else {
+            m_fileCount += sign;
+            if (add) {
+                m_totalFileSize += item.size();
+            } else {
+                m_totalFileSize -= item.size();
+            }
+        }
+    }
+}
@@ -0,0 +1,143 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KFILEITEMSELECTION_H
+#define KFILEITEMSELECTION_H
+
+#include "dolphin_export.h"
+#include "kitemviews/kitemset.h"
+
+#include <KFileItem>
+#include <KIO/Global>
+
+class KFileItemModel;
+
+/**
+ * @brief Lightweight view on the selected items of a KFileItemModel.
+ *
+ * Instead of copying all selected items into a KFileItemList, only the
+ * selected indexes are stored and the items are requested from the model
+ * while iterating. The number of selected folders and files and the total
+ * size of the files are cached, and when the selection is changed by
+ * setIndexes() only the added and removed items are taken into account.
+ *
+ * As the cached values refer to the indexes of the model, the owner must
+ * call invalidateSummary() whenever items of the model are inserted,
+ * removed, moved or changed.
+ */
+class DOLPHIN_EXPORT KFileItemSelection
+{
+public:
+    KFileItemSelection();
+    explicit KFileItemSelection(const KFileItemModel* model);
+
+    /**
+     * Sets the selected indexes. The cached folder and file counts are
+     * updated lazily when they are requested the next time.
+     */
+    void setIndexes(const KItemSet& indexes);
+    KItemSet indexes() const;
+
+    /**
+     * Discards the cached folder and file counts and the total size,
+     * so that they are calculated from scratch when requested.
+     */
+    void invalidateSummary();
+
+    int count() const;
+    bool isEmpty() const;
+
+    /**
+     * @return The selected item with the smallest index, or a null item
+     *         if the selection is empty.
+     */
+    KFileItem first() const;
+
+    int folderCount() const;
+    int fileCount() const;
+
+    /**
+     * @return Sum of the sizes of all selected files. Folders are not
+     *         taken into account.
+     */
+    KIO::filesize_t totalFileSize() const;
+
+    /**
+     * @return All selected items. Should only be used if a KFileItemList is
+     *         required, as each item gets copied.
+     */
+    KFileItemList toList() const;
+    QList<QUrl> urlList() const;
+
+    class const_iterator
+    {
+    public:
+        const_iterator(const KFileItemModel* model, const KItemSet::const_iterator& it) :
+            m_model(model),
+            m_it(it)
+        {
+        }
+
+        KFileItem operator*() const;
+
+        inline bool operator==(const const_iterator& other) const
+        {
+            return m_it == other.m_it;
+        }
+
+        inline bool operator!=(const const_iterator& other) const
+        {
+            return !(*this == other);
+        }
+
+        inline const_iterator& operator++()
+        {
+            ++m_it;
+            return *this;
+        }
+
+        /**
+         * @return Index of the item in the model.
+         */
+        inline int index() const
+        {
+            return *m_it;
+        }
+
+    private:
+        const KFileItemModel* m_model;
+        KItemSet::const_iterator m_it;
+    };
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+private:
+    /**
+     * Updates the cached folder and file counts and the total size,
+     * so that they match with the current indexes.
+     */
+    void updateSummary() const;
+
+    /**
+     * Adds the items with the given \a indexes to the cached values if
+     * \a add is true, or subtracts them otherwise.
+     */
+    void addToSummary(const KItemSet& indexes, bool add) const;
+
+private:
+    const KFileItemModel* m_model;
+    KItemSet m_indexes;
+
+    // The summary is only valid for m_summaryIndexes
+    mutable KItemSet m_summaryIndexes;
+    mutable bool m_summaryValid;
+    mutable int m_folderCount;
+    mutable int m_fileCount;
+    mutable KIO::filesize_t m_totalFileSize;
+};
+
+#endif
@@ -10,9 +10,12 @@
 
 #include "kitemlistcontroller.h"
 #include "kitemlistview.h"
+#include "private/kitemlistcostmodel.h"
 #include "private/kitemlistsmoothscroller.h"
+#include "private/kitemlisttracer.h"
 
 #include <QApplication>
+#include <QElapsedTimer>
 #include <QFontMetrics>
 #include <QGraphicsScene>
 #include <QGraphicsView>
@@ -20,6 +23,16 @@
 #include <QScroller>
 #include <QStyleOption>
 
+#ifndef QT_NO_OPENGL
+#include <QOpenGLWidget>
+#endif
+
+namespace {
+    // Minimum interval in ms between two frames when scrolling with the
+    // remote rendering, which corresponds to 20 frames per second
+    const int RemoteFrameInterval = 50;
+}
+
 /**
  * Replaces the default viewport of KItemListContainer by a
  * non-scrollable viewport. The scrolling is done in an optimized
@@ -32,6 +45,7 @@ class KItemListContainerViewport : public QGraphicsView
 public:
     KItemListContainerViewport(QGraphicsScene* scene, QWidget* parent);
 protected:
+    void paintEvent(QPaintEvent* event) override;
     void wheelEvent(QWheelEvent* event) override;
 };
 
@@ -44,6 +58,16 @@ KItemListContainerViewport::KItemListContainerViewport(QGraphicsScene* scene, QW
     setFrameShape(QFrame::NoFrame);
 }
 
+void KItemListContainerViewport::paintEvent(QPaintEvent* event)
+{
+    // Each paint event of the viewport results in one frame
+    const KItemListTraceScope traceScope("KItemListContainer::frame");
+    QElapsedTimer timer;
+    timer.start();
+    QGraphicsView::paintEvent(event);
+    KItemListCostModel::instance().addPaintSample(timer.nsecsElapsed());
+}
+
 void KItemListContainerViewport::wheelEvent(QWheelEvent* event)
 {
     // Assure that the wheel-event gets forwarded to the parent
@@ -56,7 +80,8 @@ KItemListContainer::KItemListContainer(KItemListController* controller, QWidget*
     m_controller(controller),
     m_horizontalSmoothScroller(nullptr),
     m_verticalSmoothScroller(nullptr),
-    m_scroller(nullptr)
+    m_scroller(nullptr),
+    m_enabledRemoteRendering(false)
 {
     Q_ASSERT(controller);
     controller->setParent(this);
@@ -66,6 +91,10 @@ KItemListContainer::KItemListContainer(KItemListController* controller, QWidget*
 
     m_horizontalSmoothScroller = new KItemListSmoothScroller(horizontalScrollBar(), this);
     m_verticalSmoothScroller = new KItemListSmoothScroller(verticalScrollBar(), this);
+    connect(m_horizontalSmoothScroller, &KItemListSmoothScroller::scrollAnimationStarted,
+            this, &KItemListContainer::slotScrollAnimationStarted);
+    connect(m_verticalSmoothScroller, &KItemListSmoothScroller::scrollAnimationStarted,
+            this, &KItemListContainer::slotScrollAnimationStarted);
 
     if (controller->model()) {
         slotModelChanged(controller->model(), nullptr);
@@ -127,6 +156,92 @@ bool KItemListContainer::enabledFrame() const
     return graphicsView->autoFillBackground();
 }
 
+void KItemListContainer::setEnabledHardwareAcceleration(bool enable)
+{
+#ifndef QT_NO_OPENGL
+    if (enabledHardwareAcceleration() == enable) {
+        return;
+    }
+
+    QGraphicsView* graphicsView = qobject_cast<QGraphicsView*>(viewport());
+    const bool autoFillBackground = graphicsView->viewport()->autoFillBackground();
+
+    QWidget* newViewport = nullptr;
+    if (enable) {
+        newViewport = new QOpenGLWidget();
+
+        // The whole OpenGL viewport is rendered for each frame anyhow, so
+        // calculating the minimal region to update would only cost time.
+        // The background is not filled automatically for an OpenGL
+        // viewport and must be drawn by the scene.
+        graphicsView->setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
+        graphicsView->setBackgroundBrush(autoFillBackground ? graphicsView->palette().brush(QPalette::Base) : Qt::NoBrush);
+    } else {
+        newViewport = new QWidget();
+        graphicsView->setViewportUpdateMode(QGraphicsView::MinimalViewportUpdate);
+        graphicsView->setBackgroundBrush(Qt::NoBrush);
+    }
+
+    // QGraphicsView deletes the previous viewport
+    graphicsView->setViewport(newViewport);
+    newViewport->setAutoFillBackground(autoFillBackground);
+
+    KItemListView* view = m_controller->view();
+    if (view) {
+        newViewport->setGeometry(view->geometry().toRect());
+    }
+#else
+    Q_UNUSED(enable)
+#endif
+}
+
+bool KItemListContainer::enabledHardwareAcceleration() const
+{
+#ifndef QT_NO_OPENGL
+    const QGraphicsView* graphicsView = qobject_cast<QGraphicsView*>(viewport());
+    return qobject_cast<QOpenGLWidget*>(graphicsView->viewport()) != nullptr;
+#else
+    return false;
+#endif
+}
+
+void KItemListContainer::setEnabledRemoteRendering(bool enable)
+{
+    if (m_enabledRemoteRendering == enable) {
+        return;
+    }
+
+    m_enabledRemoteRendering = enable;
+    const int updateInterval = enable ? RemoteFrameInterval : 0;
+    for (KItemListSmoothScroller* smoothScroller : {m_horizontalSmoothScroller, m_verticalSmoothScroller}) {
+        smoothScroller->setAnimationEnabled(!enable);
+        smoothScroller->setMinimumUpdateInterval(updateInterval);
+    }
+
+    KItemListView* view = m_controller->view();
+    if (view) {
+        view->setEnabledRemoteRendering(enable);
+    }
+}
+
+bool KItemListContainer::enabledRemoteRendering() const
+{
+    return m_enabledRemoteRendering;
+}
+
+bool KItemListContainer::isRemoteSession()
+{
+    if (QGuiApplication::platformName() == QLatin1String("vnc")
+        || qEnvironmentVariableIsSet("XRDP_SESSION") || qEnvironmentVariableIsSet("VNCDESKTOP")) {
+        return true;
+    }
+
+    // A forwarded X11 display refers to another host, like "localhost:10.0",
+    // while a local display is identified by ":0".
+    const QString display = qEnvironmentVariable("DISPLAY");
+    return qEnvironmentVariableIsSet("SSH_CONNECTION") && !display.isEmpty() && !display.startsWith(QLatin1Char(':'));
+}
+
 void KItemListContainer::keyPressEvent(QKeyEvent* event)
 {
     // TODO: We should find a better way to handle the key press events in the view.
@@ -227,6 +342,7 @@ void KItemListContainer::slotViewChanged(KItemListView* current, KItemListView*
         m_horizontalSmoothScroller->setTargetObject(current);
         m_verticalSmoothScroller->setTargetObject(current);
         updateSmoothScrollers(current->scrollOrientation());
+        current->setEnabledRemoteRendering(m_enabledRemoteRendering);
     }
 }
 
@@ -339,6 +455,20 @@ void KItemListContainer::stopScroller()
     m_scroller->stop();
 }
 
+void KItemListContainer::slotScrollAnimationStarted(qreal targetOffset, qreal velocity)
+{
+    KItemListView* view = m_controller->view();
+    if (!view) {
+        return;
+    }
+
+    // Only the scroll offset determines which items become visible
+    const KItemListSmoothScroller* smoothScroller = qobject_cast<KItemListSmoothScroller*>(sender());
+    if (smoothScroller && smoothScroller->propertyName() == "scrollOffset") {
+        view->predictScrollOffset(targetOffset, velocity);
+    }
+}
+
 void KItemListContainer::updateGeometries()
 {
     QRect rect = geometry();
@@ -44,6 +44,39 @@ public:
     void setEnabledFrame(bool enable);
     bool enabledFrame() const;
 
+    /**
+     * If enabled, the items are painted by OpenGL into a QOpenGLWidget
+     * viewport instead of the raster paint engine. Pixmaps like previews
+     * are uploaded as textures once and are drawn by the GPU afterwards,
+     * which reduces the CPU load when scrolling through large previews on
+     * high resolution displays. The viewport is always repainted completely.
+     *
+     * The OpenGL viewport cannot be composed with a transparent background,
+     * so it should only be enabled if the frame is enabled or the view
+     * fills its background. Has no effect if Qt has been built without
+     * OpenGL support. Per default the hardware acceleration is disabled.
+     */
+    void setEnabledHardwareAcceleration(bool enable);
+    bool enabledHardwareAcceleration() const;
+
+    /**
+     * If enabled, the view is painted for remote sessions like VNC, RDP or
+     * X11 forwarding, where each frame must be transferred to the client:
+     * scrolling is not animated and is limited to a lower frame rate, and
+     * the view uses KItemListView::setEnabledRemoteRendering(). Per default
+     * the remote rendering is disabled.
+     */
+    void setEnabledRemoteRendering(bool enable);
+    bool enabledRemoteRendering() const;
+
+    /**
+     * @return True if the application is shown by a remote session, in which
+     *         each frame must be transferred to the client: the VNC platform
+     *         plugin, XRDP and VNC sessions, and X11 displays that are
+     *         forwarded by SSH are detected.
+     */
+    static bool isRemoteSession();
+
 protected:
     void keyPressEvent(QKeyEvent* event) override;
     void showEvent(QShowEvent* event) override;
@@ -59,6 +92,7 @@ private Q_SLOTS:
     void updateScrollOffsetScrollBar();
     void updateItemOffsetScrollBar();
     void stopScroller();
+    void slotScrollAnimationStarted(qreal targetOffset, qreal velocity);
 
 private:
     void updateGeometries();
@@ -77,6 +111,7 @@ private:
     KItemListSmoothScroller* m_horizontalSmoothScroller;
     KItemListSmoothScroller* m_verticalSmoothScroller;
     QScroller* m_scroller;
+    bool m_enabledRemoteRendering;
 };
 
 #endif
@@ -13,6 +13,7 @@
 #include "kitemlistview.h"
 #include "private/kitemlistkeyboardsearchmanager.h"
 #include "private/kitemlistrubberband.h"
+#include "private/kitemlistviewlayouter.h"
 #include "private/ktwofingerswipe.h"
 #include "private/ktwofingertap.h"
 #include "views/draganddrophelper.h"
@@ -28,6 +29,12 @@
 #include <QTimer>
 #include <QTouchEvent>
 
+namespace {
+    // Limits of the scale of the shown items during a pinch gesture
+    const qreal MinimumPinchScale = 0.25;
+    const qreal MaximumPinchScale = 4;
+}
+
 KItemListController::KItemListController(KItemModelBase* model, KItemListView* view, QObject* parent) :
     QObject(parent),
     m_singleClickActivationEnforced(false),
@@ -772,7 +779,7 @@ bool KItemListController::dragMoveEvent(QGraphicsSceneDragDropEvent* event, cons
         m_view->hideDropIndicator();
     }
 
-    if (DragAndDropHelper::urlListMatchesUrl(event->mimeData()->urls(), hoveredDir)) {
+    if (DragAndDropHelper::mimeDataMatchesUrl(event->mimeData(), hoveredDir)) {
         event->setDropAction(Qt::IgnoreAction);
         event->ignore();
     } else {
@@ -1017,29 +1024,43 @@ void KItemListController::tapAndHoldTriggered(QGestureEvent* event, const QTrans
 
 void KItemListController::pinchTriggered(QGestureEvent* event, const QTransform& transform)
 {
-    Q_UNUSED(transform)
-
     const QPinchGesture* pinch = static_cast<QPinchGesture*>(event->gesture(Qt::PinchGesture));
-    const qreal sensitivityModifier = 0.2;
-    static qreal counter = 0;
 
-    if (pinch->state() == Qt::GestureStarted) {
+    switch (pinch->state()) {
+    case Qt::GestureStarted:
         m_pinchGestureInProgress = true;
-        counter = 0;
-    }
-    if (pinch->state() == Qt::GestureUpdated) {
+        break;
+
+    case Qt::GestureUpdated: {
         //if a swipe gesture was recognized or in progress, we don't want a pinch gesture to change the zoom
         if (m_isSwipeGesture) {
+            m_view->setGestureScale(1);
             return;
         }
-        counter = counter + (pinch->scaleFactor() - 1);
-        if (counter >= sensitivityModifier) {
-            Q_EMIT increaseZoom();
-            counter = 0;
-        } else if (counter <= -sensitivityModifier) {
-            Q_EMIT decreaseZoom();
-            counter = 0;
+
+        // The rendered items are only scaled during the gesture. The zoom
+        // level is changed once at the end of the gesture.
+        const qreal scale = qBound(MinimumPinchScale, m_view->gestureScale() * pinch->scaleFactor(), MaximumPinchScale);
+        const QPointF center = transform.map(event->mapToGraphicsScene(pinch->startCenterPoint()));
+        m_view->setGestureScale(scale, center);
+        break;
+    }
+
+    case Qt::GestureFinished: {
+        const qreal scale = m_view->gestureScale();
+        m_view->setGestureScale(1);
+        if (!qFuzzyCompare(scale, 1)) {
+            Q_EMIT pinchZoomFinished(scale);
         }
+        break;
+    }
+
+    case Qt::GestureCanceled:
+        m_view->setGestureScale(1);
+        break;
+
+    default:
+        break;
     }
 }
 
@@ -1194,11 +1215,13 @@ void KItemListController::slotRubberBandChanged()
     }
 
     KItemSet selectedItems;
+    KItemSet visibleItems;
 
     // Select all visible items that intersect with the rubberband
     const auto widgets = m_view->visibleItemListWidgets();
     for (const KItemListWidget* widget : widgets) {
         const int index = widget->index();
+        visibleItems.insert(index);
 
         const QRectF widgetRect = m_view->itemRect(index);
         if (widgetRect.intersects(rubberBandRect)) {
@@ -1210,32 +1233,11 @@ void KItemListController::slotRubberBandChanged()
         }
     }
 
-    // Select all invisible items that intersect with the rubberband. Instead of
-    // iterating all items only the area which might be touched by the rubberband
-    // will be checked.
-    const bool increaseIndex = scrollVertical ?
-                               startPos.y() > endPos.y(): startPos.x() > endPos.x();
-
-    int index = increaseIndex ? m_view->lastVisibleIndex() + 1 : m_view->firstVisibleIndex() - 1;
-    bool selectionFinished = false;
-    do {
-        const QRectF widgetRect = m_view->itemRect(index);
-        if (widgetRect.intersects(rubberBandRect)) {
-            selectedItems.insert(index);
-        }
-
-        if (increaseIndex) {
-            ++index;
-            selectionFinished = (index >= m_model->count()) ||
-                                ( scrollVertical && widgetRect.top()  > rubberBandRect.bottom()) ||
-                                (!scrollVertical && widgetRect.left() > rubberBandRect.right());
-        } else {
-            --index;
-            selectionFinished = (index < 0) ||
-                                ( scrollVertical && widgetRect.bottom() < rubberBandRect.top()) ||
-                                (!scrollVertical && widgetRect.right()  < rubberBandRect.left());
-        }
-    } while (!selectionFinished);
+    // Select all invisible items that intersect with the rubberband. The layouter
+    // provides them as ranges, so that the costs only depend on the number of rows
+    // that are touched by the rubberband and not on the number of selected items.
+    const KItemSet rubberBandItems(m_view->m_layouter->itemRangesInRect(rubberBandRect));
+    selectedItems = selectedItems + (rubberBandItems - visibleItems);
 
     if (QApplication::keyboardModifiers() & Qt::ControlModifier) {
         // If Control is pressed, the selection state of all items in the rubberband is toggled.
@@ -1300,15 +1302,9 @@ KItemListWidget* KItemListController::widgetForPos(const QPointF& pos) const
 {
     Q_ASSERT(m_view);
 
-    const auto widgets = m_view->visibleItemListWidgets();
-    for (KItemListWidget* widget : widgets) {
-        const QPointF mappedPos = widget->mapFromItem(m_view, pos);
-
-        const bool hovered = widget->contains(mappedPos) &&
-                             !widget->expansionToggleRect().contains(mappedPos);
-        if (hovered) {
-            return widget;
-        }
+    KItemListWidget* widget = m_view->m_visibleItems.value(m_view->itemAt(pos), nullptr);
+    if (widget && !widget->expansionToggleRect().contains(widget->mapFromItem(m_view, pos))) {
+        return widget;
     }
 
     return nullptr;
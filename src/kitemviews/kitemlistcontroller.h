@@ -213,8 +213,13 @@ Q_SIGNALS:
     void selectedItemTextPressed(int index);
 
     void scrollerStop();
-    void increaseZoom();
-    void decreaseZoom();
+
+    /**
+     * Is emitted at the end of a pinch gesture. The shown items have been
+     * scaled by \a scaleFactor during the gesture, so the zoom level that
+     * fits best to the scaled items should be applied.
+     */
+    void pinchZoomFinished(qreal scaleFactor);
     void swipeUp();
 
 public Q_SLOTS:
@@ -70,9 +70,7 @@ KItemSet KItemListSelectionManager::selectedItems() const
         const int from = qMin(m_anchorItem, m_currentItem);
         const int to = qMax(m_anchorItem, m_currentItem);
 
-        for (int index = from; index <= to; ++index) {
-            selectedItems.insert(index);
-        }
+        selectedItems = selectedItems + KItemSet(KItemRangeList() << KItemRange(from, to - from + 1));
     }
 
     return selectedItems;
@@ -109,33 +107,30 @@ void KItemListSelectionManager::setSelected(int index, int count, SelectionMode
         return;
     }
 
+    count = qMin(count, m_model->count() - index);
+    setSelected(KItemSet(KItemRangeList() << KItemRange(index, count)), mode);
+}
+
+void KItemListSelectionManager::setSelected(const KItemSet& items, SelectionMode mode)
+{
+    if (items.isEmpty() || !m_model) {
+        return;
+    }
+
     endAnchoredSelection();
     const KItemSet previous = selectedItems();
 
-    count = qMin(count, m_model->count() - index);
-
-    const int endIndex = index + count -1;
     switch (mode) {
     case Select:
-        for (int i = index; i <= endIndex; ++i) {
-            m_selectedItems.insert(i);
-        }
+        m_selectedItems = m_selectedItems + items;
         break;
 
     case Deselect:
-        for (int i = index; i <= endIndex; ++i) {
-            m_selectedItems.remove(i);
-        }
+        m_selectedItems = m_selectedItems - items;
         break;
 
     case Toggle:
-        for (int i = index; i <= endIndex; ++i) {
-            if (m_selectedItems.contains(i)) {
-                m_selectedItems.remove(i);
-            } else {
-                m_selectedItems.insert(i);
-            }
-        }
+        m_selectedItems = m_selectedItems ^ items;
         break;
 
     default:
@@ -185,9 +180,7 @@ void KItemListSelectionManager::endAnchoredSelection()
         const int from = qMin(m_anchorItem, m_currentItem);
         const int to = qMax(m_anchorItem, m_currentItem);
 
-        for (int index = from; index <= to; ++index) {
-            m_selectedItems.insert(index);
-        }
+        m_selectedItems = m_selectedItems + KItemSet(KItemRangeList() << KItemRange(from, to - from + 1));
     }
 
     m_isAnchoredSelectionActive = false;
@@ -252,21 +245,7 @@ void KItemListSelectionManager::itemsInserted(const KItemRangeList& itemRanges)
     }
 
     // Update the selections
-    if (!m_selectedItems.isEmpty()) {
-        const KItemSet previous = m_selectedItems;
-        m_selectedItems.clear();
-
-        for (int index: previous) {
-            int inc = 0;
-            for (const KItemRange& itemRange : itemRanges) {
-                if (index < itemRange.index) {
-                    break;
-                }
-                inc += itemRange.count;
-            }
-            m_selectedItems.insert(index + inc);
-        }
-    }
+    m_selectedItems = m_selectedItems.shiftedForInsertedRanges(itemRanges);
 
     const KItemSet selection = selectedItems();
     if (selection != previousSelection) {
@@ -300,18 +279,8 @@ void KItemListSelectionManager::itemsRemoved(const KItemRangeList& itemRanges)
         }
     }
 
-    // Update the selections and the anchor item
-    if (!m_selectedItems.isEmpty()) {
-        const KItemSet previous = m_selectedItems;
-        m_selectedItems.clear();
-
-        for (int oldIndex : previous) {
-            const int index = indexAfterRangesRemoving(oldIndex, itemRanges, DiscardRemovedIndex);
-            if (index >= 0)  {
-                m_selectedItems.insert(index);
-            }
-        }
-    }
+    // Update the selections
+    m_selectedItems = m_selectedItems.shiftedForRemovedRanges(itemRanges);
 
     const KItemSet selection = selectedItems();
     if (selection != previousSelection) {
@@ -352,19 +321,7 @@ void KItemListSelectionManager::itemsMoved(const KItemRange& itemRange, const QL
     }
 
     // Update the selections
-    if (!m_selectedItems.isEmpty()) {
-        const KItemSet previous = m_selectedItems;
-        m_selectedItems.clear();
-
-        for (int index : previous) {
-            if (index >= itemRange.index && index < itemRange.index + itemRange.count) {
-                m_selectedItems.insert(movedToIndexes.at(index - itemRange.index));
-            }
-            else {
-                m_selectedItems.insert(index);
-            }
-        }
-    }
+    m_selectedItems = m_selectedItems.permuted(itemRange, movedToIndexes);
 
     const KItemSet selection = selectedItems();
     if (selection != previousSelection) {
@@ -48,6 +48,14 @@ public:
     bool hasSelection() const;
 
     void setSelected(int index, int count = 1, SelectionMode mode = Select);
+
+    /**
+     * Applies \a mode to all items of \a items at once, so that
+     * selectionChanged() is emitted only once. The items are combined
+     * range by range, which is fast even for huge sets. All items must
+     * be valid indexes of the model.
+     */
+    void setSelected(const KItemSet& items, SelectionMode mode = Select);
     /**
      * Equivalent to:
      * clearSelection();
@@ -91,6 +99,7 @@ private:
     friend class KItemListController; // Calls setModel()
     friend class KItemListView;       // Calls itemsInserted(), itemsRemoved() and itemsMoved()
     friend class KItemListSelectionManagerTest;
+    friend class KItemListSelectionManagerBenchmark; // For benchmarking
 };
 
 #endif
@@ -16,14 +16,19 @@
 #include "kitemlistviewaccessible.h"
 #include "kstandarditemlistwidget.h"
 
+#include "private/kitemlistcolumnwidthcache.h"
+#include "private/kiconpixmapcache.h"
 #include "private/kitemlistheaderwidget.h"
 #include "private/kitemlistrubberband.h"
 #include "private/kitemlistsizehintresolver.h"
+#include "private/kitemlisttracer.h"
 #include "private/kitemlistviewlayouter.h"
 
+#include <QAccessible>
 #include <QElapsedTimer>
 #include <QGraphicsSceneMouseEvent>
 #include <QGraphicsView>
+#include <QGuiApplication>
 #include <QPropertyAnimation>
 #include <QStyleOptionRubberBand>
 #include <QTimer>
@@ -42,6 +47,37 @@ namespace {
     const int RubberFadeSpeed = 150;
 
     const char* RubberPropertyName = "_kitemviews_rubberBandPosition";
+
+    // Maximum time in ms that doLayout() spends on creating new widgets.
+    // The remaining widgets are created in the next event loop iterations.
+    const int WidgetCreationBudget = 8;
+
+    // Maximum number of group headers of invisible items that are kept
+    // for being shown again without updating their content.
+    const int MaximumRecycledGroupHeaders = 20;
+
+    // Estimated bytes of a widget, including the pixmaps and texts
+    // that are not shared with the caches
+    const int WidgetCost = 4 * 1024;
+
+    /**
+     * Informs the accessibility bridge about the changed items. Only one
+     * event is sent for all ranges, which covers the first to the last
+     * changed item, and nothing is done if no assistive technology is active.
+     */
+    void updateAccessibleRows(QObject* view, QAccessibleTableModelChangeEvent::ModelChangeType type,
+                              const KItemRangeList& itemRanges)
+    {
+        if (itemRanges.isEmpty() || !QAccessible::isActive()) {
+            return;
+        }
+
+        const KItemRange& lastRange = itemRanges.last();
+        QAccessibleTableModelChangeEvent ev(view, type);
+        ev.setFirstRow(itemRanges.first().index);
+        ev.setLastRow(lastRange.index + lastRange.count - 1);
+        QAccessible::updateAccessibility(&ev);
+    }
 }
 
 #ifndef QT_NO_ACCESSIBILITY
@@ -62,9 +98,12 @@ QAccessibleInterface* accessibleInterfaceFactory(const QString& key, QObject* ob
 KItemListView::KItemListView(QGraphicsWidget* parent) :
     QGraphicsWidget(parent),
     m_enabledSelectionToggles(false),
+    m_enabledWidgetPixmapCache(false),
+    m_enabledRemoteRendering(false),
     m_grouped(false),
     m_supportsItemExpanding(false),
     m_editingRole(false),
+    m_layoutDeferredByEditing(false),
     m_activeTransactions(0),
     m_endTransactionAnimationHint(Animation),
     m_itemSize(),
@@ -76,11 +115,14 @@ KItemListView::KItemListView(QGraphicsWidget* parent) :
     m_styleOption(),
     m_visibleItems(),
     m_visibleGroups(),
+    m_recycledGroupHeaders(),
     m_visibleCells(),
     m_sizeHintResolver(nullptr),
+    m_columnWidthCache(nullptr),
     m_layouter(nullptr),
     m_animation(nullptr),
     m_layoutTimer(nullptr),
+    m_pendingWidgetsTimer(nullptr),
     m_oldScrollOffset(0),
     m_oldMaximumScrollOffset(0),
     m_oldItemOffset(0),
@@ -100,6 +142,7 @@ KItemListView::KItemListView(QGraphicsWidget* parent) :
     setAcceptTouchEvents(true);
 
     m_sizeHintResolver = new KItemListSizeHintResolver(this);
+    m_columnWidthCache = new KItemListColumnWidthCache();
 
     m_layouter = new KItemListViewLayouter(m_sizeHintResolver, this);
 
@@ -112,6 +155,13 @@ KItemListView::KItemListView(QGraphicsWidget* parent) :
     m_layoutTimer->setSingleShot(true);
     connect(m_layoutTimer, &QTimer::timeout, this, &KItemListView::slotLayoutTimerFinished);
 
+    m_pendingWidgetsTimer = new QTimer(this);
+    m_pendingWidgetsTimer->setInterval(0);
+    m_pendingWidgetsTimer->setSingleShot(true);
+    connect(m_pendingWidgetsTimer, &QTimer::timeout, this, [this]() {
+        doLayout(NoAnimation);
+    });
+
     m_rubberBand = new KItemListRubberBand(this);
     connect(m_rubberBand, &KItemListRubberBand::activationChanged, this, &KItemListView::slotRubberBandActivationChanged);
 
@@ -145,6 +195,8 @@ KItemListView::KItemListView(QGraphicsWidget* parent) :
 
 KItemListView::~KItemListView()
 {
+    KIconPixmapCache::instance().removeWorkingSetHint(this);
+
     // The group headers are children of the widgets created by
     // widgetCreator(). So it is mandatory to delete the group headers
     // first.
@@ -156,6 +208,9 @@ KItemListView::~KItemListView()
 
     delete m_sizeHintResolver;
     m_sizeHintResolver = nullptr;
+
+    delete m_columnWidthCache;
+    m_columnWidthCache = nullptr;
 }
 
 void KItemListView::setScrollOffset(qreal offset)
@@ -232,6 +287,7 @@ void KItemListView::setVisibleRoles(const QList<QByteArray>& roles)
 
     if (m_itemSize.isEmpty()) {
         m_headerWidget->setColumns(roles);
+        m_columnWidthCache->setRoles(roles);
         updatePreferredColumnWidths();
         if (!m_headerWidget->automaticColumnResizing()) {
             // The column-width of new roles are still 0. Apply the preferred
@@ -251,7 +307,7 @@ void KItemListView::setVisibleRoles(const QList<QByteArray>& roles)
                                              ((roles.count() > 1 && previousRoles.count() <= 1) ||
                                               (roles.count() <= 1 && previousRoles.count() > 1));
 
-    QHashIterator<int, KItemListWidget*> it(m_visibleItems);
+    KItemListRingBuffer<KItemListWidget*>::Iterator it(m_visibleItems);
     while (it.hasNext()) {
         it.next();
         KItemListWidget* widget = it.value();
@@ -292,7 +348,7 @@ void KItemListView::setEnabledSelectionToggles(bool enabled)
     if (m_enabledSelectionToggles != enabled) {
         m_enabledSelectionToggles = enabled;
 
-        QHashIterator<int, KItemListWidget*> it(m_visibleItems);
+        KItemListRingBuffer<KItemListWidget*>::Iterator it(m_visibleItems);
         while (it.hasNext()) {
             it.next();
             it.value()->setEnabledSelectionToggle(enabled);
@@ -305,6 +361,63 @@ bool KItemListView::enabledSelectionToggles() const
     return m_enabledSelectionToggles;
 }
 
+void KItemListView::setEnabledWidgetPixmapCache(bool enabled)
+{
+    if (m_enabledWidgetPixmapCache != enabled) {
+        m_enabledWidgetPixmapCache = enabled;
+        updateWidgetCacheModes();
+    }
+}
+
+bool KItemListView::enabledWidgetPixmapCache() const
+{
+    return m_enabledWidgetPixmapCache;
+}
+
+void KItemListView::setEnabledRemoteRendering(bool enabled)
+{
+    if (m_enabledRemoteRendering == enabled) {
+        return;
+    }
+
+    m_enabledRemoteRendering = enabled;
+    m_animation->setEnabled(!enabled);
+
+    KItemListRingBuffer<KItemListWidget*>::Iterator it(m_visibleItems);
+    while (it.hasNext()) {
+        it.next();
+        it.value()->setEnabledHoverEffects(!enabled);
+    }
+    updateWidgetCacheModes();
+}
+
+bool KItemListView::enabledRemoteRendering() const
+{
+    return m_enabledRemoteRendering;
+}
+
+void KItemListView::setGestureScale(qreal scale, const QPointF& center)
+{
+    const qreal previousScale = gestureScale();
+    if (qFuzzyCompare(scale, previousScale)) {
+        return;
+    }
+
+    if (qFuzzyCompare(previousScale, 1)) {
+        setTransformOriginPoint(center);
+    }
+    setScale(scale);
+
+    if (qFuzzyCompare(previousScale, 1) || qFuzzyCompare(scale, 1)) {
+        updateWidgetCacheModes();
+    }
+}
+
+qreal KItemListView::gestureScale() const
+{
+    return scale();
+}
+
 KItemListController* KItemListView::controller() const
 {
     return m_controller;
@@ -331,6 +444,8 @@ KItemListWidgetCreatorBase* KItemListView::widgetCreator() const
 
 void KItemListView::setGroupHeaderCreator(KItemListGroupHeaderCreatorBase* groupHeaderCreator)
 {
+    // The recycled group headers are deleted by their creator
+    m_recycledGroupHeaders.clear();
     delete m_groupHeaderCreator;
     m_groupHeaderCreator = groupHeaderCreator;
 }
@@ -391,15 +506,12 @@ qreal KItemListView::verticalPageStep() const
 
 int KItemListView::itemAt(const QPointF& pos) const
 {
-    QHashIterator<int, KItemListWidget*> it(m_visibleItems);
-    while (it.hasNext()) {
-        it.next();
-
-        const KItemListWidget* widget = it.value();
-        const QPointF mappedPos = widget->mapFromItem(this, pos);
-        if (widget->contains(mappedPos)) {
-            return it.key();
-        }
+    // The layouter provides the only item that might contain the position,
+    // so that not all visible widgets need to be checked on each mouse move.
+    const int index = m_layouter->indexAt(pos);
+    const KItemListWidget* widget = m_visibleItems.value(index, nullptr);
+    if (widget && widget->contains(widget->mapFromItem(this, pos))) {
+        return index;
     }
 
     return -1;
@@ -458,9 +570,9 @@ int KItemListView::lastVisibleIndex() const
     return m_layouter->lastVisibleIndex();
 }
 
-void KItemListView::calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint) const
+void KItemListView::calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, int firstIndex, int lastIndex) const
 {
-    widgetCreator()->calculateItemSizeHints(logicalHeightHints, logicalWidthHint, this);
+    widgetCreator()->calculateItemSizeHints(logicalHeightHints, logicalWidthHint, firstIndex, lastIndex, this);
 }
 
 void KItemListView::setSupportsItemExpanding(bool supportsExpanding)
@@ -647,6 +759,7 @@ void KItemListView::editRole(int index, const QByteArray& role)
 
 void KItemListView::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
 {
+    const KItemListTraceScope traceScope("KItemListView::paint");
     QGraphicsWidget::paint(painter, option, widget);
 
     for (auto animation : qAsConst(m_rubberBandAnimations)) {
@@ -687,7 +800,8 @@ void KItemListView::paint(QPainter* painter, const QStyleOptionGraphicsItem* opt
         QStyleOptionRubberBand opt;
         initStyleOption(&opt);
         opt.shape = QRubberBand::Rectangle;
-        opt.opaque = false;
+        // An opaque rubberband does not need to be blended with the items
+        opt.opaque = m_enabledRemoteRendering;
         opt.rect = rubberBandRect.toRect();
         style()->drawControl(QStyle::CE_RubberBand, &opt, painter);
     }
@@ -759,6 +873,13 @@ void KItemListView::setItemSize(const QSizeF& size)
     }
 
     if (size.isEmpty()) {
+        if (!previousSize.isEmpty()) {
+            // The cached column widths have not been updated while
+            // a fixed item size has been used.
+            m_columnWidthCache->setRoles(m_visibleRoles);
+            m_columnWidthCache->reset(m_model ? m_model->count() : 0);
+        }
+
         if (m_headerWidget->automaticColumnResizing()) {
             updatePreferredColumnWidths();
         } else {
@@ -809,7 +930,7 @@ void KItemListView::setStyleOption(const KItemListStyleOption& option)
         animate = false;
     }
 
-    QHashIterator<int, KItemListWidget*> it(m_visibleItems);
+    KItemListRingBuffer<KItemListWidget*>::Iterator it(m_visibleItems);
     while (it.hasNext()) {
         it.next();
         it.value()->setStyleOption(option);
@@ -820,6 +941,7 @@ void KItemListView::setStyleOption(const KItemListStyleOption& option)
     doLayout(animate ? Animation : NoAnimation);
 
     if (m_itemSize.isEmpty()) {
+        m_columnWidthCache->reset(m_model ? m_model->count() : 0);
         updatePreferredColumnWidths();
     }
 
@@ -909,6 +1031,13 @@ void KItemListView::onScrollOffsetChanged(qreal current, qreal previous)
     Q_UNUSED(previous)
 }
 
+void KItemListView::onScrollOffsetPredicted(int firstIndex, int lastIndex, qreal velocity)
+{
+    Q_UNUSED(firstIndex)
+    Q_UNUSED(lastIndex)
+    Q_UNUSED(velocity)
+}
+
 void KItemListView::onVisibleRolesChanged(const QList<QByteArray>& current, const QList<QByteArray>& previous)
 {
     Q_UNUSED(current)
@@ -1028,7 +1157,9 @@ void KItemListView::updatePalette()
 
 void KItemListView::slotItemsInserted(const KItemRangeList& itemRanges)
 {
+    const KItemListTraceScope traceScope("KItemListView::slotItemsInserted");
     if (m_itemSize.isEmpty()) {
+        m_columnWidthCache->itemsInserted(itemRanges);
         updatePreferredColumnWidths(itemRanges);
     }
 
@@ -1037,7 +1168,7 @@ void KItemListView::slotItemsInserted(const KItemRangeList& itemRanges)
         beginTransaction();
     }
 
-    m_layouter->markAsDirty();
+    m_layouter->markAsDirty(itemRanges.first().index);
 
     m_sizeHintResolver->itemsInserted(itemRanges);
 
@@ -1054,32 +1185,10 @@ void KItemListView::slotItemsInserted(const KItemRangeList& itemRanges)
         }
         previouslyInsertedCount += count;
 
-        // Determine which visible items must be moved
-        QList<int> itemsToMove;
-        QHashIterator<int, KItemListWidget*> it(m_visibleItems);
-        while (it.hasNext()) {
-            it.next();
-            const int visibleItemIndex = it.key();
-            if (visibleItemIndex >= index) {
-                itemsToMove.append(visibleItemIndex);
-            }
-        }
-
         // Update the indexes of all KItemListWidget instances that are located
-        // after the inserted items. It is important to adjust the indexes in the order
-        // from the highest index to the lowest index to prevent overlaps when setting the new index.
-        std::sort(itemsToMove.begin(), itemsToMove.end());
-        for (int i = itemsToMove.count() - 1; i >= 0; --i) {
-            KItemListWidget* widget = m_visibleItems.value(itemsToMove[i]);
-            Q_ASSERT(widget);
-            const int newIndex = widget->index() + count;
-            if (hasMultipleRanges) {
-                setWidgetIndex(widget, newIndex);
-            } else {
-                // Try to animate the moving of the item
-                moveWidgetToIndex(widget, newIndex);
-            }
-        }
+        // after the inserted items. For a single range try to animate the moving
+        // of the items.
+        shiftWidgetIndexes(index, count, !hasMultipleRanges);
 
         if (m_model->count() == count && m_activeTransactions == 0) {
             // Check whether a scrollbar is required to show the inserted items. In this case
@@ -1116,6 +1225,8 @@ void KItemListView::slotItemsInserted(const KItemRangeList& itemRanges)
         m_controller->selectionManager()->itemsInserted(itemRanges);
     }
 
+    updateAccessibleRows(this, QAccessibleTableModelChangeEvent::RowsInserted, itemRanges);
+
     if (hasMultipleRanges) {
         m_endTransactionAnimationHint = NoAnimation;
         endTransaction();
@@ -1137,9 +1248,12 @@ void KItemListView::slotItemsInserted(const KItemRangeList& itemRanges)
 
 void KItemListView::slotItemsRemoved(const KItemRangeList& itemRanges)
 {
+    const KItemListTraceScope traceScope("KItemListView::slotItemsRemoved");
     if (m_itemSize.isEmpty()) {
         // Don't pass the item-range: The preferred column-widths of
-        // all items must be adjusted when removing items.
+        // all items must be adjusted when removing items. This is cheap,
+        // as the widths of the remaining items are cached.
+        m_columnWidthCache->itemsRemoved(itemRanges);
         updatePreferredColumnWidths();
     }
 
@@ -1148,7 +1262,7 @@ void KItemListView::slotItemsRemoved(const KItemRangeList& itemRanges)
         beginTransaction();
     }
 
-    m_layouter->markAsDirty();
+    m_layouter->markAsDirty(itemRanges.first().index);
 
     m_sizeHintResolver->itemsRemoved(itemRanges);
 
@@ -1164,22 +1278,21 @@ void KItemListView::slotItemsRemoved(const KItemRangeList& itemRanges)
         const int firstRemovedIndex = index;
         const int lastRemovedIndex = index + count - 1;
 
-        // Remember which items have to be moved because they are behind the removed range.
-        QVector<int> itemsToMove;
-
         // Remove all KItemListWidget instances that got deleted
-        // Iterate over a const copy because the container is mutated within the loop
+        // The iterator works on a copy because the container is mutated within the loop
         // directly and in `recycleWidget()` (https://bugs.kde.org/show_bug.cgi?id=428374)
-        const auto visibleItems = m_visibleItems;
-        for (KItemListWidget* widget : visibleItems) {
-            const int i = widget->index();
+        KItemListRingBuffer<KItemListWidget*>::Iterator it(m_visibleItems);
+        while (it.hasNext()) {
+            it.next();
+            const int i = it.key();
             if (i < firstRemovedIndex) {
                 continue;
             } else if (i > lastRemovedIndex) {
-                itemsToMove.append(i);
-                continue;
+                break;
             }
 
+            KItemListWidget* widget = it.value();
+
             m_animation->stop(widget);
             // Stopping the animation might lead to recycling the widget if
             // it is invisible (see slotAnimationFinished()).
@@ -1204,20 +1317,9 @@ void KItemListView::slotItemsRemoved(const KItemRangeList& itemRanges)
         }
 
         // Update the indexes of all KItemListWidget instances that are located
-        // after the deleted items. It is important to update them in ascending
-        // order to prevent overlaps when setting the new index.
-        std::sort(itemsToMove.begin(), itemsToMove.end());
-        for (int i : qAsConst(itemsToMove)) {
-            KItemListWidget* widget = m_visibleItems.value(i);
-            Q_ASSERT(widget);
-            const int newIndex = i - count;
-            if (hasMultipleRanges) {
-                setWidgetIndex(widget, newIndex);
-            } else {
-                // Try to animate the moving of the item
-                moveWidgetToIndex(widget, newIndex);
-            }
-        }
+        // after the deleted items. For a single range try to animate the moving
+        // of the items.
+        shiftWidgetIndexes(lastRemovedIndex + 1, -count, !hasMultipleRanges);
 
         if (!hasMultipleRanges) {
             // The decrease-layout-size optimization in KItemListView::slotItemsInserted()
@@ -1236,6 +1338,8 @@ void KItemListView::slotItemsRemoved(const KItemRangeList& itemRanges)
         m_controller->selectionManager()->itemsRemoved(itemRanges);
     }
 
+    updateAccessibleRows(this, QAccessibleTableModelChangeEvent::RowsRemoved, itemRanges);
+
     if (hasMultipleRanges) {
         m_endTransactionAnimationHint = NoAnimation;
         endTransaction();
@@ -1255,8 +1359,22 @@ void KItemListView::slotItemsRemoved(const KItemRangeList& itemRanges)
 
 void KItemListView::slotItemsMoved(const KItemRange& itemRange, const QList<int>& movedToIndexes)
 {
+    const KItemListTraceScope traceScope("KItemListView::slotItemsMoved");
+
+    // A visible current item keeps its position, so that the items that
+    // are resorted in the background do not move under the cursor. If
+    // the user changes the sorting, the view is not moved.
+    const int oldCurrentIndex = m_controller && m_model->isMovingItemsInBackground() ? m_controller->selectionManager()->currentItem() : -1;
+    const bool anchorCurrentItem = oldCurrentIndex >= 0 && oldCurrentIndex >= firstVisibleIndex() && oldCurrentIndex <= lastVisibleIndex()
+                                   && oldCurrentIndex >= itemRange.index && oldCurrentIndex < itemRange.index + itemRange.count;
+    const QRectF oldCurrentRect = anchorCurrentItem ? itemRect(oldCurrentIndex) : QRectF();
+
     m_sizeHintResolver->itemsMoved(itemRange, movedToIndexes);
-    m_layouter->markAsDirty();
+    m_layouter->markAsDirty(itemRange.index);
+
+    if (m_itemSize.isEmpty()) {
+        m_columnWidthCache->itemsMoved(itemRange, movedToIndexes);
+    }
 
     if (m_controller) {
         m_controller->selectionManager()->itemsMoved(itemRange, movedToIndexes);
@@ -1275,13 +1393,29 @@ void KItemListView::slotItemsMoved(const KItemRange& itemRange, const QList<int>
 
     doLayout(NoAnimation);
     updateSiblingsInformation();
+
+    if (anchorCurrentItem && m_controller) {
+        const QRectF currentRect = itemRect(m_controller->selectionManager()->currentItem());
+        const bool vertical = (scrollOrientation() == Qt::Vertical);
+        const qreal diff = vertical ? currentRect.top() - oldCurrentRect.top()
+                                    : currentRect.left() - oldCurrentRect.left();
+        if (diff != 0) {
+            const qreal visibleSize = vertical ? size().height() : size().width();
+            const qreal maxVisibleOffset = qMax(qreal(0), maximumScrollOffset() - visibleSize);
+            setScrollOffset(qBound(qreal(0), scrollOffset() + diff, maxVisibleOffset));
+        }
+    }
+
+    updateAccessibleRows(this, QAccessibleTableModelChangeEvent::DataChanged, KItemRangeList() << itemRange);
 }
 
 void KItemListView::slotItemsChanged(const KItemRangeList& itemRanges,
                                      const QSet<QByteArray>& roles)
 {
+    const KItemListTraceScope traceScope("KItemListView::slotItemsChanged");
     const bool updateSizeHints = itemSizeHintUpdateRequired(roles);
     if (updateSizeHints && m_itemSize.isEmpty()) {
+        m_columnWidthCache->itemsChanged(itemRanges);
         updatePreferredColumnWidths(itemRanges);
     }
 
@@ -1291,7 +1425,7 @@ void KItemListView::slotItemsChanged(const KItemRangeList& itemRanges,
 
         if (updateSizeHints) {
             m_sizeHintResolver->itemsChanged(index, count, roles);
-            m_layouter->markAsDirty();
+            m_layouter->markAsDirty(index);
 
             if (!m_layoutTimer->isActive()) {
                 m_layoutTimer->start();
@@ -1313,12 +1447,9 @@ void KItemListView::slotItemsChanged(const KItemRangeList& itemRanges,
             updateVisibleGroupHeaders();
             doLayout(NoAnimation);
         }
-
-        QAccessibleTableModelChangeEvent ev(this, QAccessibleTableModelChangeEvent::DataChanged);
-        ev.setFirstRow(itemRange.index);
-        ev.setLastRow(itemRange.index + itemRange.count);
-        QAccessible::updateAccessibility(&ev);
     }
+
+    updateAccessibleRows(this, QAccessibleTableModelChangeEvent::DataChanged, itemRanges);
 }
 
 void KItemListView::slotGroupsChanged()
@@ -1345,6 +1476,11 @@ void KItemListView::slotGroupedSortingChanged(bool current)
             recycleGroupHeaderForWidget(it.key());
         }
         Q_ASSERT(m_visibleGroups.isEmpty());
+
+        for (KItemListGroupHeader* header : qAsConst(m_recycledGroupHeaders)) {
+            groupHeaderCreator()->recycle(header);
+        }
+        m_recycledGroupHeaders.clear();
     }
 
     if (useAlternateBackgrounds()) {
@@ -1404,7 +1540,7 @@ void KItemListView::slotSelectionChanged(const KItemSet& current, const KItemSet
 {
     Q_UNUSED(previous)
 
-    QHashIterator<int, KItemListWidget*> it(m_visibleItems);
+    KItemListRingBuffer<KItemListWidget*>::Iterator it(m_visibleItems);
     while (it.hasNext()) {
         it.next();
         const int index = it.key();
@@ -1452,6 +1588,14 @@ void KItemListView::slotAnimationFinished(QGraphicsWidget* widget,
 
 void KItemListView::slotLayoutTimerFinished()
 {
+    if (m_editingRole) {
+        // Changing the size of the edited widget would finish the editing, and
+        // moving it would leave the editor behind. The changed size hints, e.g.
+        // of items that got a preview in the meantime, are applied afterwards.
+        m_layoutDeferredByEditing = true;
+        return;
+    }
+
     m_layouter->setSize(geometry().size());
     doLayout(Animation);
 }
@@ -1468,29 +1612,32 @@ void KItemListView::slotRubberBandActivationChanged(bool active)
         connect(m_rubberBand, &KItemListRubberBand::endPositionChanged, this, &KItemListView::slotRubberBandPosChanged);
         m_skipAutoScrollForRubberBand = true;
     } else {
-        QRectF rubberBandRect = QRectF(m_rubberBand->startPosition(),
-                                       m_rubberBand->endPosition()).normalized();
-
-        auto animation = new QVariantAnimation(this);
-        animation->setStartValue(1.0);
-        animation->setEndValue(0.0);
-        animation->setDuration(RubberFadeSpeed);
-        animation->setProperty(RubberPropertyName, rubberBandRect);
-
-        QEasingCurve curve;
-        curve.setType(QEasingCurve::BezierSpline);
-        curve.addCubicBezierSegment(QPointF(0.4, 0.0), QPointF(1.0, 1.0), QPointF(1.0, 1.0));
-        animation->setEasingCurve(curve);
-
-        connect(animation, &QVariantAnimation::valueChanged, this, [=](const QVariant&) {
-            update();
-        });
-        connect(animation, &QVariantAnimation::finished, this, [=]() {
-            m_rubberBandAnimations.removeAll(animation);
-            delete animation;
-        });
-        animation->start();
-        m_rubberBandAnimations << animation;
+        // The rubberband of the remote rendering disappears without fading out
+        if (!m_enabledRemoteRendering) {
+            QRectF rubberBandRect = QRectF(m_rubberBand->startPosition(),
+                                           m_rubberBand->endPosition()).normalized();
+
+            auto animation = new QVariantAnimation(this);
+            animation->setStartValue(1.0);
+            animation->setEndValue(0.0);
+            animation->setDuration(RubberFadeSpeed);
+            animation->setProperty(RubberPropertyName, rubberBandRect);
+
+            QEasingCurve curve;
+            curve.setType(QEasingCurve::BezierSpline);
+            curve.addCubicBezierSegment(QPointF(0.4, 0.0), QPointF(1.0, 1.0), QPointF(1.0, 1.0));
+            animation->setEasingCurve(curve);
+
+            connect(animation, &QVariantAnimation::valueChanged, this, [=](const QVariant&) {
+                update();
+            });
+            connect(animation, &QVariantAnimation::finished, this, [=]() {
+                m_rubberBandAnimations.removeAll(animation);
+                delete animation;
+            });
+            animation->start();
+            m_rubberBandAnimations << animation;
+        }
 
         disconnect(m_rubberBand, &KItemListRubberBand::startPositionChanged, this, &KItemListView::slotRubberBandPosChanged);
         disconnect(m_rubberBand, &KItemListRubberBand::endPositionChanged, this, &KItemListView::slotRubberBandPosChanged);
@@ -1663,6 +1810,7 @@ void KItemListView::setModel(KItemModelBase* model)
                    this,    &KItemListView::slotSortRoleChanged);
 
         m_sizeHintResolver->itemsRemoved(KItemRangeList() << KItemRange(0, m_model->count()));
+        m_columnWidthCache->reset(0);
     }
 
     m_model = model;
@@ -1703,6 +1851,7 @@ KItemListRubberBand* KItemListView::rubberBand() const
 
 void KItemListView::doLayout(LayoutAnimationHint hint, int changedIndex, int changedCount)
 {
+    const KItemListTraceScope traceScope("KItemListView::doLayout");
     if (m_layoutTimer->isActive()) {
         m_layoutTimer->stop();
     }
@@ -1736,18 +1885,40 @@ void KItemListView::doLayout(LayoutAnimationHint hint, int changedIndex, int cha
         firstVisibleIndex = m_layouter->firstVisibleIndex();
     }
 
-    const int lastVisibleIndex = m_layouter->lastVisibleIndex();
+    int lastVisibleIndex = m_layouter->lastVisibleIndex();
+
+    // Only the sizehints of the visible items are calculated exactly, all other
+    // items are layouted with estimated sizehints. Correct the layout as long as the
+    // exact sizehints of the visible items differ from the estimated ones.
+    int changedSizeHintIndex = m_sizeHintResolver->updateCache(firstVisibleIndex, lastVisibleIndex);
+    while (changedSizeHintIndex >= 0) {
+        m_layouter->markAsDirty(changedSizeHintIndex);
+        firstVisibleIndex = m_layouter->firstVisibleIndex();
+        lastVisibleIndex = m_layouter->lastVisibleIndex();
+        changedSizeHintIndex = m_sizeHintResolver->updateCache(firstVisibleIndex, lastVisibleIndex);
+    }
 
     int firstSibblingIndex = -1;
     int lastSibblingIndex = -1;
     const bool supportsExpanding = supportsItemExpanding();
 
-    QList<int> reusableItems = recycleInvisibleItems(firstVisibleIndex, lastVisibleIndex, hint);
+    // Keep enough invisible widgets to refill the whole viewport, e.g. after
+    // zooming in and out again.
+    widgetCreator()->setMaximumRecycleableWidgets(qMax(100, 2 * m_layouter->maximumVisibleItems()));
+
+    // The icons of the visible and the recycleable widgets should fit into the cache
+    KIconPixmapCache::instance().setWorkingSetHint(this, 2 * m_layouter->maximumVisibleItems(),
+                                                         qMax(0, styleOption().iconSize) * qApp->devicePixelRatio());
+
+    QList<KItemListWidget*> reusableItems = recycleInvisibleItems(firstVisibleIndex, lastVisibleIndex, hint);
 
     // Assure that for each visible item a KItemListWidget is available. KItemListWidget
     // instances from invisible items are reused. If no reusable items are
     // found then new KItemListWidget instances get created.
     const bool animate = (hint == Animation);
+    QElapsedTimer widgetCreationTimer;
+    widgetCreationTimer.start();
+    bool widgetsCreated = false;
     for (int i = firstVisibleIndex; i <= lastVisibleIndex; ++i) {
         bool applyNewPos = true;
         bool wasHidden = false;
@@ -1759,14 +1930,22 @@ void KItemListView::doLayout(LayoutAnimationHint hint, int changedIndex, int cha
             wasHidden = true;
             if (!reusableItems.isEmpty()) {
                 // Reuse a KItemListWidget instance from an invisible item
-                const int oldIndex = reusableItems.takeLast();
-                widget = m_visibleItems.value(oldIndex);
+                widget = reusableItems.takeLast();
                 setWidgetIndex(widget, i);
                 updateWidgetProperties(widget, i);
                 initializeItemListWidget(widget);
+            } else if (widgetsCreated && widgetCreationTimer.elapsed() > WidgetCreationBudget) {
+                // Creating hundreds of widgets at once, e.g. after maximizing the window,
+                // would block the user interface for several frames. Create the
+                // remaining widgets in the next event loop iteration.
+                if (!m_pendingWidgetsTimer->isActive()) {
+                    m_pendingWidgetsTimer->start();
+                }
+                continue;
             } else {
                 // No reusable KItemListWidget instance is available, create a new one
                 widget = createWidget(i);
+                widgetsCreated = true;
             }
             widget->resize(itemBounds.size());
 
@@ -1860,8 +2039,8 @@ void KItemListView::doLayout(LayoutAnimationHint hint, int changedIndex, int cha
     }
 
     // Delete invisible KItemListWidget instances that have not been reused
-    for (int index : qAsConst(reusableItems)) {
-        recycleWidget(m_visibleItems.value(index));
+    for (KItemListWidget* widget : qAsConst(reusableItems)) {
+        recycleWidget(widget);
     }
 
     if (supportsExpanding && firstSibblingIndex >= 0) {
@@ -1881,9 +2060,9 @@ void KItemListView::doLayout(LayoutAnimationHint hint, int changedIndex, int cha
     emitOffsetChanges();
 }
 
-QList<int> KItemListView::recycleInvisibleItems(int firstVisibleIndex,
-                                                int lastVisibleIndex,
-                                                LayoutAnimationHint hint)
+QList<KItemListWidget*> KItemListView::recycleInvisibleItems(int firstVisibleIndex,
+                                                             int lastVisibleIndex,
+                                                             LayoutAnimationHint hint)
 {
     // Determine all items that are completely invisible and might be
     // reused for items that just got (at least partly) visible. If the
@@ -1891,9 +2070,9 @@ QList<int> KItemListView::recycleInvisibleItems(int firstVisibleIndex,
     // moving of their position are not marked as invisible: This assures
     // that a scrolling inside the view can be done without breaking an animation.
 
-    QList<int> items;
+    QList<KItemListWidget*> items;
 
-    QHashIterator<int, KItemListWidget*> it(m_visibleItems);
+    KItemListRingBuffer<KItemListWidget*>::Iterator it(m_visibleItems);
     while (it.hasNext()) {
         it.next();
 
@@ -1910,7 +2089,9 @@ QList<int> KItemListView::recycleInvisibleItems(int firstVisibleIndex,
                 }
             } else {
                 widget->setVisible(false);
-                items.append(index);
+                items.append(widget);
+                m_visibleItems.remove(index);
+                m_visibleCells.remove(index);
 
                 if (m_grouped) {
                     recycleGroupHeaderForWidget(widget);
@@ -1988,6 +2169,7 @@ void KItemListView::emitOffsetChanges()
 
 KItemListWidget* KItemListView::createWidget(int index)
 {
+    const KItemListTraceScope traceScope("KItemListView::createWidget");
     KItemListWidget* widget = widgetCreator()->create(this);
     widget->setFlag(QGraphicsItem::ItemStacksBehindParent);
 
@@ -2000,6 +2182,7 @@ KItemListWidget* KItemListView::createWidget(int index)
 
 void KItemListView::recycleWidget(KItemListWidget* widget)
 {
+    const KItemListTraceScope traceScope("KItemListView::recycleWidget");
     if (m_grouped) {
         recycleGroupHeaderForWidget(widget);
     }
@@ -2023,19 +2206,36 @@ void KItemListView::setWidgetIndex(KItemListWidget* widget, int index)
     widget->setIndex(index);
 }
 
-void KItemListView::moveWidgetToIndex(KItemListWidget* widget, int index)
+void KItemListView::shiftWidgetIndexes(int fromIndex, int delta, bool updateCells)
 {
-    const int oldIndex = widget->index();
-    const Cell oldCell = m_visibleCells.value(oldIndex);
-
-    setWidgetIndex(widget, index);
+    m_visibleItems.shiftIndexes(fromIndex, delta);
+    m_visibleCells.shiftIndexes(fromIndex, delta);
 
-    const Cell newCell(m_layouter->itemColumn(index), m_layouter->itemRow(index));
+    const int firstMovedIndex = fromIndex + delta;
     const bool vertical = (scrollOrientation() == Qt::Vertical);
-    const bool updateCell = (vertical  && oldCell.row    == newCell.row) ||
-                            (!vertical && oldCell.column == newCell.column);
-    if (updateCell) {
-        m_visibleCells.insert(index, newCell);
+
+    KItemListRingBuffer<KItemListWidget*>::Iterator it(m_visibleItems);
+    while (it.hasNext()) {
+        it.next();
+        const int index = it.key();
+        if (index < firstMovedIndex) {
+            continue;
+        }
+
+        KItemListWidget* widget = it.value();
+        widget->setIndex(index);
+
+        Cell cell;
+        if (updateCells) {
+            const Cell oldCell = m_visibleCells.value(index);
+            const Cell newCell(m_layouter->itemColumn(index), m_layouter->itemRow(index));
+            const bool updateCell = (vertical  && oldCell.row    == newCell.row) ||
+                                    (!vertical && oldCell.column == newCell.column);
+            if (updateCell) {
+                cell = newCell;
+            }
+        }
+        m_visibleCells.insert(index, cell);
     }
 }
 
@@ -2064,6 +2264,11 @@ void KItemListView::updateWidgetProperties(KItemListWidget* widget, int index)
     widget->setSelected(selectionManager->isSelected(index));
     widget->setHovered(false);
     widget->setEnabledSelectionToggle(enabledSelectionToggles());
+    widget->setEnabledHoverEffects(!m_enabledRemoteRendering);
+    // The cached pixmap is only moved when the scroll offset changes. It is
+    // painted again by QGraphicsItem::update(), which is triggered by all
+    // changes of the data or the state of the widget.
+    widget->setCacheMode(widgetCacheMode());
     widget->setIndex(index);
     widget->setData(m_model->data(index));
     widget->setSiblingsInformation(QBitArray());
@@ -2093,7 +2298,12 @@ void KItemListView::updateGroupHeaderForWidget(KItemListWidget* widget)
 
     KItemListGroupHeader* groupHeader = m_visibleGroups.value(widget);
     if (!groupHeader) {
-        groupHeader = groupHeaderCreator()->create(this);
+        // Prefer the group header that has been shown for the item before,
+        // e.g. when scrolling back and forth: Its content is still up to date.
+        groupHeader = m_recycledGroupHeaders.take(index);
+        if (!groupHeader) {
+            groupHeader = groupHeaderCreator()->create(this);
+        }
         groupHeader->setParentItem(widget);
         m_visibleGroups.insert(widget, groupHeader);
         connect(widget, &KItemListWidget::geometryChanged, this, &KItemListView::slotGeometryOfGroupHeaderParentChanged);
@@ -2138,21 +2348,44 @@ void KItemListView::updateGroupHeaderLayout(KItemListWidget* widget)
 
 void KItemListView::recycleGroupHeaderForWidget(KItemListWidget* widget)
 {
-    KItemListGroupHeader* header = m_visibleGroups.value(widget);
-    if (header) {
-        header->setParentItem(nullptr);
-        groupHeaderCreator()->recycle(header);
-        m_visibleGroups.remove(widget);
-        disconnect(widget, &KItemListWidget::geometryChanged, this, &KItemListView::slotGeometryOfGroupHeaderParentChanged);
+    KItemListGroupHeader* header = m_visibleGroups.take(widget);
+    if (!header) {
+        return;
+    }
+
+    header->setParentItem(nullptr);
+    header->hide();
+    disconnect(widget, &KItemListWidget::geometryChanged, this, &KItemListView::slotGeometryOfGroupHeaderParentChanged);
+
+    const int itemIndex = header->itemIndex();
+    KItemListGroupHeader* previousHeader = m_recycledGroupHeaders.value(itemIndex);
+    if (previousHeader) {
+        groupHeaderCreator()->recycle(previousHeader);
+    }
+    m_recycledGroupHeaders.insert(itemIndex, header);
+
+    if (m_recycledGroupHeaders.count() > MaximumRecycledGroupHeaders) {
+        // Pass the header that is farthest away from the recycled one to the
+        // group header creator, as it will most probably not be shown again soon.
+        auto farthestIt = m_recycledGroupHeaders.begin();
+        for (auto it = m_recycledGroupHeaders.begin(); it != m_recycledGroupHeaders.end(); ++it) {
+            if (qAbs(it.key() - itemIndex) > qAbs(farthestIt.key() - itemIndex)) {
+                farthestIt = it;
+            }
+        }
+        groupHeaderCreator()->recycle(farthestIt.value());
+        m_recycledGroupHeaders.erase(farthestIt);
     }
 }
 
 void KItemListView::updateVisibleGroupHeaders()
 {
     Q_ASSERT(m_grouped);
-    m_layouter->markAsDirty();
+    // The layouter compares the group boundaries with the cached ones and
+    // only layouts the rows again that are behind the first changed boundary.
+    m_layouter->markAsDirty(m_model->count());
 
-    QHashIterator<int, KItemListWidget*> it(m_visibleItems);
+    KItemListRingBuffer<KItemListWidget*>::Iterator it(m_visibleItems);
     while (it.hasNext()) {
         it.next();
         updateGroupHeaderForWidget(it.value());
@@ -2191,10 +2424,26 @@ int KItemListView::groupIndexForItem(int index) const
 
 void KItemListView::updateAlternateBackgrounds()
 {
-    QHashIterator<int, KItemListWidget*> it(m_visibleItems);
-    while (it.hasNext()) {
-        it.next();
-        updateAlternateBackgroundForWidget(it.value());
+    if (m_visibleItems.isEmpty()) {
+        return;
+    }
+
+    const bool enabled = useAlternateBackgrounds();
+    const int firstIndex = m_visibleItems.firstIndex();
+    const int lastIndex = m_visibleItems.lastIndex();
+
+    // The first item of the group is only searched for the first visible
+    // item; the following items can only start a new group.
+    int groupStart = (enabled && m_grouped) ? firstGroupItem(firstIndex) : 0;
+    for (int index = firstIndex; index <= lastIndex; ++index) {
+        if (enabled && m_grouped && index > firstIndex && m_layouter->isFirstGroupItem(index)) {
+            groupStart = index;
+        }
+
+        KItemListWidget* widget = m_visibleItems.value(index);
+        if (widget) {
+            widget->setAlternateBackground(enabled && ((index - groupStart) & 0x1) > 0);
+        }
     }
 }
 
@@ -2203,26 +2452,24 @@ void KItemListView::updateAlternateBackgroundForWidget(KItemListWidget* widget)
     bool enabled = useAlternateBackgrounds();
     if (enabled) {
         const int index = widget->index();
-        enabled = (index & 0x1) > 0;
-        if (m_grouped) {
-            const int groupIndex = groupIndexForItem(index);
-            if (groupIndex >= 0) {
-                const QList<QPair<int, QVariant> > groups = model()->groups();
-                const int indexOfFirstGroupItem = groups[groupIndex].first;
-                const int relativeIndex = index - indexOfFirstGroupItem;
-                enabled = (relativeIndex & 0x1) > 0;
-            }
-        }
+        const int groupStart = m_grouped ? firstGroupItem(index) : 0;
+        enabled = ((index - groupStart) & 0x1) > 0;
     }
     widget->setAlternateBackground(enabled);
 }
 
+int KItemListView::firstGroupItem(int index) const
+{
+    const int groupIndex = groupIndexForItem(index);
+    return (groupIndex >= 0) ? model()->groups().at(groupIndex).first : 0;
+}
+
 bool KItemListView::useAlternateBackgrounds() const
 {
     return m_itemSize.isEmpty() && m_visibleRoles.count() > 1;
 }
 
-QHash<QByteArray, qreal> KItemListView::preferredColumnWidths(const KItemRangeList& itemRanges) const
+QHash<QByteArray, qreal> KItemListView::preferredColumnWidths(const KItemRangeList& itemRanges)
 {
     QElapsedTimer timer;
     timer.start();
@@ -2240,9 +2487,16 @@ QHash<QByteArray, qreal> KItemListView::preferredColumnWidths(const KItemRangeLi
         widths.insert(visibleRole, headerWidth);
     }
 
-    // Calculate the preferred column withs for each item and ignore values
-    // smaller than the width for showing the headline unclipped.
+    if (m_columnWidthCache->roles() != m_visibleRoles) {
+        m_columnWidthCache->setRoles(m_visibleRoles);
+    }
+    if (m_columnWidthCache->count() != m_model->count()) {
+        m_columnWidthCache->reset(m_model->count());
+    }
+
+    // Calculate the preferred column withs for each item that is not cached yet.
     const KItemListWidgetCreatorBase* creator = widgetCreator();
+    const int roleCount = m_visibleRoles.count();
     int calculatedItemCount = 0;
     bool maxTimeExceeded = false;
     for (const KItemRange& itemRange : itemRanges) {
@@ -2250,11 +2504,13 @@ QHash<QByteArray, qreal> KItemListView::preferredColumnWidths(const KItemRangeLi
         const int endIndex = startIndex + itemRange.count - 1;
 
         for (int i = startIndex; i <= endIndex; ++i) {
-            for (const QByteArray& visibleRole : qAsConst(m_visibleRoles)) {
-                qreal maxWidth = widths.value(visibleRole, 0);
-                const qreal width = creator->preferredRoleColumnWidth(visibleRole, i, this);
-                maxWidth = qMax(width, maxWidth);
-                widths.insert(visibleRole, maxWidth);
+            if (m_columnWidthCache->isCalculated(i)) {
+                continue;
+            }
+
+            for (int roleIndex = 0; roleIndex < roleCount; ++roleIndex) {
+                const qreal width = creator->preferredRoleColumnWidth(m_visibleRoles[roleIndex], i, this);
+                m_columnWidthCache->setWidth(i, roleIndex, width);
             }
 
             if (calculatedItemCount > 100 && timer.elapsed() > 200) {
@@ -2271,6 +2527,12 @@ QHash<QByteArray, qreal> KItemListView::preferredColumnWidths(const KItemRangeLi
         }
     }
 
+    // Ignore values smaller than the width for showing the headline unclipped.
+    for (int roleIndex = 0; roleIndex < roleCount; ++roleIndex) {
+        const QByteArray& role = m_visibleRoles[roleIndex];
+        widths.insert(role, qMax(widths.value(role), m_columnWidthCache->maximumWidth(roleIndex)));
+    }
+
     return widths;
 }
 
@@ -2283,7 +2545,7 @@ void KItemListView::applyColumnWidthsFromHeader()
     m_layouter->setItemSize(dynamicItemSize);
 
     // Update the role sizes for all visible widgets
-    QHashIterator<int, KItemListWidget*> it(m_visibleItems);
+    KItemListRingBuffer<KItemListWidget*>::Iterator it(m_visibleItems);
     while (it.hasNext()) {
         it.next();
         updateWidgetColumnWidths(it.value());
@@ -2306,38 +2568,25 @@ void KItemListView::updatePreferredColumnWidths(const KItemRangeList& itemRanges
         rangesItemCount += range.count;
     }
 
-    if (itemCount == rangesItemCount) {
-        const QHash<QByteArray, qreal> preferredWidths = preferredColumnWidths(itemRanges);
-        for (const QByteArray& role : qAsConst(m_visibleRoles)) {
-            m_headerWidget->setPreferredColumnWidth(role, preferredWidths.value(role));
-        }
-    } else {
-        // Only a sub range of the roles need to be determined.
-        // The chances are good that the widths of the sub ranges
-        // already fit into the available widths and hence no
-        // expensive update might be required.
-        bool changed = false;
-
-        const QHash<QByteArray, qreal> updatedWidths = preferredColumnWidths(itemRanges);
-        QHashIterator<QByteArray, qreal> it(updatedWidths);
-        while (it.hasNext()) {
-            it.next();
-            const QByteArray& role = it.key();
-            const qreal updatedWidth = it.value();
-            const qreal currentWidth = m_headerWidget->preferredColumnWidth(role);
-            if (updatedWidth > currentWidth) {
-                m_headerWidget->setPreferredColumnWidth(role, updatedWidth);
-                changed = true;
-            }
-        }
+    // The returned widths contain the cached widths of all items, only
+    // the widths of the items in the ranges are calculated if required.
+    const QHash<QByteArray, qreal> preferredWidths = preferredColumnWidths(itemRanges);
 
-        if (!changed) {
-            // All the updated sizes are smaller than the current sizes and no change
-            // of the stretched roles-widths is required
-            return;
+    bool changed = false;
+    for (const QByteArray& role : qAsConst(m_visibleRoles)) {
+        const qreal preferredWidth = preferredWidths.value(role);
+        if (preferredWidth != m_headerWidget->preferredColumnWidth(role)) {
+            m_headerWidget->setPreferredColumnWidth(role, preferredWidth);
+            changed = true;
         }
     }
 
+    if (!changed && itemCount != rangesItemCount) {
+        // The widths of the sub ranges already fit into the current widths
+        // and no change of the stretched roles-widths is required
+        return;
+    }
+
     if (m_headerWidget->automaticColumnResizing()) {
         applyAutomaticColumnWidths();
     }
@@ -2400,7 +2649,7 @@ void KItemListView::applyAutomaticColumnWidths()
     m_layouter->setItemSize(dynamicItemSize);
 
     // Update the role sizes for all visible widgets
-    QHashIterator<int, KItemListWidget*> it(m_visibleItems);
+    KItemListRingBuffer<KItemListWidget*>::Iterator it(m_visibleItems);
     while (it.hasNext()) {
         it.next();
         updateWidgetColumnWidths(it.value());
@@ -2492,9 +2741,45 @@ bool KItemListView::scrollBarRequired(const QSizeF& size) const
                                                            : maxOffset > size.width();
 }
 
+void KItemListView::predictScrollOffset(qreal offset, qreal velocity)
+{
+    if (!m_model || m_model->count() <= 0) {
+        return;
+    }
+
+    const bool vertical = (scrollOrientation() == Qt::Vertical);
+    const qreal visibleOffsetRange = vertical ? size().height() : size().width();
+    offset = qBound(qreal(0), offset, qMax(qreal(0), maximumScrollOffset() - visibleOffsetRange));
+
+    // The rectangle that will be visible at the target offset, relative to
+    // the current scroll offset
+    const qreal distance = offset - scrollOffset();
+    const QRectF targetRect = vertical ? QRectF(QPointF(0, distance), size())
+                                       : QRectF(QPointF(distance, 0), size());
+    const KItemRangeList itemRanges = m_layouter->itemRangesInRect(targetRect);
+    if (itemRanges.isEmpty()) {
+        return;
+    }
+
+    const int firstIndex = itemRanges.first().index;
+    const int lastIndex = itemRanges.last().index + itemRanges.last().count - 1;
+
+    // Calculating the exact sizehints requires a text layout of the roles. Do it
+    // only for items after the visible items, as correcting the layout of items
+    // before them would move the visible items.
+    if (firstIndex > m_layouter->lastVisibleIndex()) {
+        const int changedSizeHintIndex = m_sizeHintResolver->updateCache(firstIndex, lastIndex);
+        if (changedSizeHintIndex >= 0) {
+            m_layouter->markAsDirty(changedSizeHintIndex);
+        }
+    }
+
+    onScrollOffsetPredicted(firstIndex, lastIndex, velocity);
+}
+
 int KItemListView::showDropIndicator(const QPointF& pos)
 {
-    QHashIterator<int, KItemListWidget*> it(m_visibleItems);
+    KItemListRingBuffer<KItemListWidget*>::Iterator it(m_visibleItems);
     while (it.hasNext()) {
         it.next();
         const KItemListWidget* widget = it.value();
@@ -2580,118 +2865,76 @@ void KItemListView::updateSiblingsInformation(int firstIndex, int lastIndex)
         }
     }
 
-    int previousParents = 0;
-    QBitArray previousSiblings;
+    lastIndex = qMin(lastIndex, m_model->count() - 1);
+    if (firstIndex < 0 || firstIndex > lastIndex) {
+        return;
+    }
 
-    // The rootIndex describes the first index where the siblings get
-    // calculated from. For the calculation the upper most parent item
-    // is required. For performance reasons it is checked first whether
-    // the visible items before or after the current range already
-    // contain a siblings information which can be used as base.
-    int rootIndex = firstIndex;
+    int maxParents = 0;
+    for (int i = firstIndex; i <= lastIndex; ++i) {
+        maxParents = qMax(maxParents, m_model->expandedParentsCount(i));
+    }
 
-    KItemListWidget* widget = m_visibleItems.value(firstIndex - 1);
-    if (!widget) {
-        // There is no visible widget before the range, check whether there
-        // is one after the range:
-        widget = m_visibleItems.value(lastIndex + 1);
+    // The siblings of all items of the range are determined by going
+    // backwards once, see siblingSuccessors(). Adding the item i in front
+    // of the items behind it sets the bit for its own level and clears the
+    // bits of the deeper levels, as no item behind it can be their successor.
+    QBitArray successors = siblingSuccessors(lastIndex, maxParents);
+    for (int i = lastIndex; i >= firstIndex; --i) {
+        const int parents = m_model->expandedParentsCount(i);
+
+        KItemListWidget* widget = m_visibleItems.value(i);
         if (widget) {
-            // The sibling information of the widget may only be used if
-            // all items of the range have the same number of parents.
-            const int parents = m_model->expandedParentsCount(lastIndex + 1);
-            for (int i = lastIndex; i >= firstIndex; --i) {
-                if (m_model->expandedParentsCount(i) != parents) {
-                    widget = nullptr;
-                    break;
-                }
+            QBitArray siblings(parents + 1);
+            for (int level = 0; level <= parents; ++level) {
+                siblings.setBit(level, successors.testBit(level));
             }
+            widget->setSiblingsInformation(siblings);
         }
-    }
 
-    if (widget) {
-        // Performance optimization: Use the sibling information of the visible
-        // widget beside the given range.
-        previousSiblings = widget->siblingsInformation();
-        if (previousSiblings.isEmpty()) {
-            return;
-        }
-        previousParents = previousSiblings.count() - 1;
-        previousSiblings.truncate(previousParents);
-    } else {
-        // Potentially slow path: Go back to the upper most parent of firstIndex
-        // to be able to calculate the initial value for the siblings.
-        while (rootIndex > 0 && m_model->expandedParentsCount(rootIndex) > 0) {
-            --rootIndex;
-        }
-    }
-
-    Q_ASSERT(previousParents >= 0);
-    for (int i = rootIndex; i <= lastIndex; ++i) {
-        // Update the parent-siblings in case if the current item represents
-        // a child or an upper parent.
-        const int currentParents = m_model->expandedParentsCount(i);
-        Q_ASSERT(currentParents >= 0);
-        if (previousParents < currentParents) {
-            previousParents = currentParents;
-            previousSiblings.resize(currentParents);
-            previousSiblings.setBit(currentParents - 1, hasSiblingSuccessor(i - 1));
-        } else if (previousParents > currentParents) {
-            previousParents = currentParents;
-            previousSiblings.truncate(currentParents);
-        }
-
-        if (i >= firstIndex) {
-            // The index represents a visible item. Apply the parent-siblings
-            // and update the sibling of the current item.
-            KItemListWidget* widget = m_visibleItems.value(i);
-            if (!widget) {
-                continue;
+        if (m_grouped && m_layouter->isFirstGroupItem(i)) {
+            // The group header is between the sibling connections
+            successors.fill(false);
+        } else {
+            successors.setBit(parents);
+            for (int level = parents + 1; level <= maxParents; ++level) {
+                successors.clearBit(level);
             }
-
-            QBitArray siblings = previousSiblings;
-            siblings.resize(siblings.count() + 1);
-            siblings.setBit(siblings.count() - 1, hasSiblingSuccessor(i));
-
-            widget->setSiblingsInformation(siblings);
         }
     }
 }
 
-bool KItemListView::hasSiblingSuccessor(int index) const
+QBitArray KItemListView::siblingSuccessors(int index, int maxParents) const
 {
-    bool hasSuccessor = false;
-    const int parentsCount = m_model->expandedParentsCount(index);
-    int successorIndex = index + 1;
+    QBitArray successors(maxParents + 1);
 
-    // Search the next sibling
+    // Only the first item with fewer parents than all items before it can be
+    // a sibling successor, so the items of expanded sub-folders are skipped
+    // after one comparison.
+    int minParents = maxParents + 1;
     const int itemCount = m_model->count();
-    while (successorIndex < itemCount) {
-        const int currentParentsCount = m_model->expandedParentsCount(successorIndex);
-        if (currentParentsCount == parentsCount) {
-            hasSuccessor = true;
-            break;
-        } else if (currentParentsCount < parentsCount) {
+    for (int i = index + 1; i < itemCount && minParents > 0; ++i) {
+        if (m_grouped && m_layouter->isFirstGroupItem(i)) {
             break;
         }
-        ++successorIndex;
-    }
 
-    if (m_grouped && hasSuccessor) {
-        // If the sibling is part of another group, don't mark it as
-        // successor as the group header is between the sibling connections.
-        for (int i = index + 1; i <= successorIndex; ++i) {
-            if (m_layouter->isFirstGroupItem(i)) {
-                hasSuccessor = false;
-                break;
-            }
+        const int parents = m_model->expandedParentsCount(i);
+        if (parents < minParents) {
+            successors.setBit(parents);
+            minParents = parents;
         }
     }
 
-    return hasSuccessor;
+    return successors;
 }
 
 void KItemListView::disconnectRoleEditingSignals(int index)
 {
+    if (m_layoutDeferredByEditing) {
+        m_layoutDeferredByEditing = false;
+        m_layoutTimer->start();
+    }
+
     KStandardItemListWidget* widget = qobject_cast<KStandardItemListWidget *>(m_visibleItems.value(index));
     if (!widget) {
         return;
@@ -2702,6 +2945,27 @@ void KItemListView::disconnectRoleEditingSignals(int index)
     disconnect(this, &KItemListView::scrollOffsetChanged, widget, nullptr);
 }
 
+QGraphicsItem::CacheMode KItemListView::widgetCacheMode() const
+{
+    if (!qFuzzyCompare(gestureScale(), 1)) {
+        // The pixmaps in item coordinates are transformed without painting
+        // the widgets again, while the device coordinate cache would be
+        // invalidated for each step of the gesture
+        return QGraphicsItem::ItemCoordinateCache;
+    }
+    return m_enabledWidgetPixmapCache || m_enabledRemoteRendering ? QGraphicsItem::DeviceCoordinateCache : QGraphicsItem::NoCache;
+}
+
+void KItemListView::updateWidgetCacheModes()
+{
+    const QGraphicsItem::CacheMode mode = widgetCacheMode();
+    KItemListRingBuffer<KItemListWidget*>::Iterator it(m_visibleItems);
+    while (it.hasNext()) {
+        it.next();
+        it.value()->setCacheMode(mode);
+    }
+}
+
 int KItemListView::calculateAutoScrollingIncrement(int pos, int range, int oldInc)
 {
     int inc = 0;
@@ -2737,6 +3001,13 @@ int KItemListView::itemsPerSize(qreal size, qreal itemSize, qreal itemMargin)
 
 
 
+KItemListCreatorBase::KItemListCreatorBase() :
+    m_createdWidgets(),
+    m_recycleableWidgets(),
+    m_maximumRecycleableWidgets(100)
+{
+}
+
 KItemListCreatorBase::~KItemListCreatorBase()
 {
     qDeleteAll(m_recycleableWidgets);
@@ -2753,7 +3024,7 @@ void KItemListCreatorBase::pushRecycleableWidget(QGraphicsWidget* widget)
     Q_ASSERT(m_createdWidgets.contains(widget));
     m_createdWidgets.remove(widget);
 
-    if (m_recycleableWidgets.count() < 100) {
+    if (m_recycleableWidgets.count() < m_maximumRecycleableWidgets) {
         m_recycleableWidgets.append(widget);
         widget->setVisible(false);
     } else {
@@ -2761,6 +3032,44 @@ void KItemListCreatorBase::pushRecycleableWidget(QGraphicsWidget* widget)
     }
 }
 
+void KItemListCreatorBase::setMaximumRecycleableWidgets(int count)
+{
+    m_maximumRecycleableWidgets = count;
+    while (m_recycleableWidgets.count() > count) {
+        delete m_recycleableWidgets.takeLast();
+    }
+}
+
+QString KItemListCreatorBase::memoryConsumerName() const
+{
+    return QStringLiteral("KItemListCreatorBase");
+}
+
+qint64 KItemListCreatorBase::memoryUsage() const
+{
+    return qint64(m_createdWidgets.count() + m_recycleableWidgets.count()) * WidgetCost;
+}
+
+qint64 KItemListCreatorBase::releaseMemory(qint64 bytes)
+{
+    // Only the invisible widgets may be released, the
+    // created widgets are used by the view
+    int count = int(qMin<qint64>(bytes / WidgetCost + 1, m_recycleableWidgets.count()));
+    const qint64 released = qint64(count) * WidgetCost;
+    while (count > 0) {
+        delete m_recycleableWidgets.takeLast();
+        --count;
+    }
+    return released;
+}
+
+KMemoryBudget::Consumer::ReleaseOrder KItemListCreatorBase::releaseOrder() const
+{
+    // Widgets are created again quickly when they are needed. If the
+    // view is in a background tab, they are not needed at all.
+    return ReleaseFirst;
+}
+
 QGraphicsWidget* KItemListCreatorBase::popRecycleableWidget()
 {
     if (m_recycleableWidgets.isEmpty()) {
@@ -14,11 +14,14 @@
 #include "kitemviews/kitemlistwidget.h"
 #include "kitemviews/kitemmodelbase.h"
 #include "kitemviews/kstandarditemlistgroupheader.h"
+#include "kitemviews/private/kitemlistringbuffer.h"
 #include "kitemviews/private/kitemlistviewanimation.h"
+#include "kitemviews/private/kmemorybudget.h"
 
 #include <QGraphicsWidget>
 #include <QSet>
 
+class KItemListColumnWidthCache;
 class KItemListController;
 class KItemListGroupHeaderCreatorBase;
 class KItemListHeader;
@@ -99,6 +102,38 @@ public:
     void setEnabledSelectionToggles(bool enabled);
     bool enabledSelectionToggles() const;
 
+    /**
+     * If set to true each item widget is rendered into a pixmap, which is
+     * reused as long as the widget has not been changed. When scrolling,
+     * the pixmaps are only moved and the items don't need to be painted
+     * again, which is a lot cheaper if the painting is done in software,
+     * e.g. on remote desktops. Per default the pixmap cache is disabled.
+     */
+    void setEnabledWidgetPixmapCache(bool enabled);
+    bool enabledWidgetPixmapCache() const;
+
+    /**
+     * If set to true, the view is painted with as few repaints as possible,
+     * e.g. for remote sessions like VNC, RDP or X11 forwarding, where each
+     * repaint must be transferred: the items are not animated, hovering an
+     * item is not shown and the rubberband is painted opaque without fading
+     * out. The item widgets are cached as pixmaps like with
+     * setEnabledWidgetPixmapCache(), so that scrolling only moves them.
+     * Per default the remote rendering is disabled.
+     */
+    void setEnabledRemoteRendering(bool enabled);
+    bool enabledRemoteRendering() const;
+
+    /**
+     * Scales the view by \a scale around the point \a center during a pinch
+     * gesture, without changing the layout. The item widgets are rendered
+     * into pixmaps once, which are only transformed while the scale changes.
+     * \a center is only used when the scaling starts. A scale of 1 ends the
+     * scaling; the zoom level should be changed afterwards.
+     */
+    void setGestureScale(qreal scale, const QPointF& center = QPointF());
+    qreal gestureScale() const;
+
     /**
      * @return Controller of the item-list. The controller gets
      *         initialized by KItemListController::setView() and will
@@ -181,7 +216,8 @@ public:
     int lastVisibleIndex() const;
 
     /**
-     * Calculates the required size for all items in the model.
+     * Calculates the required size for the items between \a firstIndex
+     * and \a lastIndex whose logical height hint is not positive.
      * It might be larger than KItemListView::itemSize().
      * In this case the layout grid will be stretched to assure an
      * unclipped item.
@@ -189,7 +225,7 @@ public:
      * @note the logical height (width) is actually the
      * width (height) if the scroll orientation is Qt::Vertical!
      */
-    void calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint) const;
+    void calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, int firstIndex, int lastIndex) const;
 
     /**
      * If set to true, items having child-items can be expanded to show the child-items as
@@ -358,6 +394,16 @@ protected:
     virtual void onScrollOrientationChanged(Qt::Orientation current, Qt::Orientation previous);
     virtual void onItemSizeChanged(const QSizeF& current, const QSizeF& previous);
     virtual void onScrollOffsetChanged(qreal current, qreal previous);
+
+    /**
+     * Is invoked when a smooth-scrolling animation has been started. At the end
+     * of the animation the items between \p firstIndex and \p lastIndex will be
+     * visible. \p velocity is the average scroll velocity of the animation in pixels
+     * per second. Derived classes may prepare the data of these items before they
+     * become visible.
+     */
+    virtual void onScrollOffsetPredicted(int firstIndex, int lastIndex, qreal velocity);
+
     virtual void onVisibleRolesChanged(const QList<QByteArray>& current, const QList<QByteArray>& previous);
     virtual void onStyleOptionChanged(const KItemListStyleOption& current, const KItemListStyleOption& previous);
     virtual void onSupportsItemExpandingChanged(bool supportsExpanding);
@@ -461,11 +507,13 @@ private:
      * area. Invisible group headers get recycled. The reusable items are items that are
      * invisible. If the animation hint is 'Animation' then items that are currently animated
      * won't be reused. Reusing items is faster in comparison to deleting invisible
-     * items and creating a new instance for visible items.
+     * items and creating a new instance for visible items. The returned widgets are
+     * removed from m_visibleItems and m_visibleCells already, so that reusing a widget
+     * from a far away index does not enlarge the range of the visible items.
      */
-    QList<int> recycleInvisibleItems(int firstVisibleIndex,
-                                     int lastVisibleIndex,
-                                     LayoutAnimationHint hint);
+    QList<KItemListWidget*> recycleInvisibleItems(int firstVisibleIndex,
+                                                  int lastVisibleIndex,
+                                                  LayoutAnimationHint hint);
 
     /**
      * Helper method for doLayout: Starts a moving-animation for the widget to the given
@@ -488,12 +536,15 @@ private:
     void setWidgetIndex(KItemListWidget* widget, int index);
 
     /**
-     * Changes the index of the widget to \a index. In opposite to
-     * setWidgetIndex() the cell-information for the widget gets updated.
-     * This update gives doLayout() the chance to animate the moving
-     * of the item visually (see moveWidget()).
+     * Adds \a delta to the indexes of all widgets whose index is equal to
+     * or greater than \a fromIndex. The entries of m_visibleItems and
+     * m_visibleCells are moved as a whole, without re-inserting each widget.
+     * If \a updateCells is true, the cell-information of the moved widgets
+     * gets updated. This update gives doLayout() the chance to animate the
+     * moving of the items visually (see moveWidget()). Otherwise the cells
+     * are initialized as empty cells like in setWidgetIndex().
      */
-    void moveWidgetToIndex(KItemListWidget* widget, int index);
+    void shiftWidgetIndexes(int fromIndex, int delta, bool updateCells);
 
     /**
      * Helper method for prepareLayoutForIncreasedItemCount().
@@ -550,6 +601,12 @@ private:
      */
     void updateAlternateBackgroundForWidget(KItemListWidget* widget);
 
+    /**
+     * @return Index of the first item of the group that contains the item
+     *         with the index \a index, or 0 if no groups are available.
+     */
+    int firstGroupItem(int index) const;
+
     /**
      * @return True if alternate backgrounds should be used for the items.
      *         This is the case if an empty item-size is given and if there
@@ -558,13 +615,14 @@ private:
     bool useAlternateBackgrounds() const;
 
     /**
-     * @param itemRanges Items that must be checked for getting the widths of columns.
-     * @return           The preferred width of the column of each visible role. The width will
-     *                   be respected if the width of the item size is <= 0 (see
-     *                   KItemListView::setItemSize()). Per default an empty hash
-     *                   is returned.
+     * @param itemRanges Items whose widths must be calculated if they are not
+     *                   cached in m_columnWidthCache yet.
+     * @return           The preferred width of the column of each visible role for all
+     *                   items. The width will be respected if the width of the item size
+     *                   is <= 0 (see KItemListView::setItemSize()). Per default an empty
+     *                   hash is returned.
      */
-    QHash<QByteArray, qreal> preferredColumnWidths(const KItemRangeList& itemRanges) const;
+    QHash<QByteArray, qreal> preferredColumnWidths(const KItemRangeList& itemRanges);
 
     /**
      * Applies the column-widths from m_headerWidget to the layout
@@ -630,6 +688,15 @@ private:
      */
     bool scrollBarRequired(const QSizeF& size) const;
 
+    /**
+     * Is invoked by KItemListContainer when a smooth-scrolling animation towards
+     * the scroll offset \p offset has been started. Calculates the exact sizehints
+     * of the items that will be visible at \p offset, so that the layout does not
+     * need to be corrected when they become visible, and invokes
+     * onScrollOffsetPredicted().
+     */
+    void predictScrollOffset(qreal offset, qreal velocity);
+
     /**
      * Shows a drop-indicator between items dependent on the given
      * cursor position. The cursor position is relative to the upper left
@@ -656,19 +723,31 @@ private:
     void updateSiblingsInformation(int firstIndex = -1, int lastIndex = -1);
 
     /**
-     * Helper method for updateExpansionIndicators().
-     * @return True if the item with the index \a index has a sibling successor
-     *         (= the item is not the last item of the current hierarchy).
+     * Helper method for updateSiblingsInformation().
+     * @return Bit k is set if the first item behind the item with the index
+     *         \a index that has at most k expanded parents has exactly k
+     *         expanded parents and is not part of another group. This is true
+     *         if the parent of the item at the level k, or the item itself for
+     *         its own level, has a sibling successor. The bits are determined
+     *         up to the level \a maxParents.
      */
-    bool hasSiblingSuccessor(int index) const;
+    QBitArray siblingSuccessors(int index, int maxParents) const;
 
     /**
      * Helper method for slotRoleEditingCanceled() and slotRoleEditingFinished().
      * Disconnects the two Signals "roleEditingCanceled" and
-     * "roleEditingFinished"
+     * "roleEditingFinished" and starts the layout that has been
+     * deferred during the editing.
      */
     void disconnectRoleEditingSignals(int index);
 
+    /**
+     * @return Cache mode of the item widgets, which depends on
+     *         enabledWidgetPixmapCache() and on gestureScale().
+     */
+    QGraphicsItem::CacheMode widgetCacheMode() const;
+    void updateWidgetCacheModes();
+
     /**
      * Helper function for triggerAutoScrolling().
      * @param pos    Logical position of the mouse relative to the range.
@@ -690,9 +769,12 @@ private:
 
 private:
     bool m_enabledSelectionToggles;
+    bool m_enabledWidgetPixmapCache;
+    bool m_enabledRemoteRendering;
     bool m_grouped;
     bool m_supportsItemExpanding;
     bool m_editingRole;
+    bool m_layoutDeferredByEditing; // The layout timer has been exceeded while editing a role
     int m_activeTransactions; // Counter for beginTransaction()/endTransaction()
     LayoutAnimationHint m_endTransactionAnimationHint;
 
@@ -704,9 +786,13 @@ private:
     mutable KItemListGroupHeaderCreatorBase* m_groupHeaderCreator;
     KItemListStyleOption m_styleOption;
 
-    QHash<int, KItemListWidget*> m_visibleItems;
+    KItemListRingBuffer<KItemListWidget*> m_visibleItems;
     QHash<KItemListWidget*, KItemListGroupHeader*> m_visibleGroups;
 
+    // Hidden group headers of items that have left the viewport, identified
+    // by the index of the item. They are reused if the item gets visible again.
+    QHash<int, KItemListGroupHeader*> m_recycledGroupHeaders;
+
     struct Cell
     {
         Cell() : column(-1), row(-1) {}
@@ -714,14 +800,16 @@ private:
         int column;
         int row;
     };
-    QHash<int, Cell> m_visibleCells;
+    KItemListRingBuffer<Cell> m_visibleCells;
 
     int m_scrollBarExtent;
     KItemListSizeHintResolver* m_sizeHintResolver;
+    KItemListColumnWidthCache* m_columnWidthCache; // Only used if m_itemSize is empty
     KItemListViewLayouter* m_layouter;
     KItemListViewAnimation* m_animation;
 
     QTimer* m_layoutTimer; // Triggers an asynchronous doLayout() call.
+    QTimer* m_pendingWidgetsTimer; // Creates the widgets that did not fit into the time budget of doLayout()
     qreal m_oldScrollOffset;
     qreal m_oldMaximumScrollOffset;
     qreal m_oldItemOffset;
@@ -750,7 +838,7 @@ private:
 
     QList<QVariantAnimation*> m_rubberBandAnimations;
 
-    friend class KItemListContainer; // Accesses scrollBarRequired()
+    friend class KItemListContainer; // Accesses scrollBarRequired() and predictScrollOffset()
     friend class KItemListHeader;    // Accesses m_headerWidget
     friend class KItemListController;
     friend class KItemListControllerTest;
@@ -762,12 +850,27 @@ private:
  * Allows to do a fast logical creation and deletion of QGraphicsWidgets
  * by recycling existing QGraphicsWidgets instances. Is used by
  * KItemListWidgetCreatorBase and KItemListGroupHeaderCreatorBase.
+ * The recycleable widgets are released if the memory budget of
+ * KMemoryBudget is exceeded.
  * @internal
  */
-class DOLPHIN_EXPORT KItemListCreatorBase
+class DOLPHIN_EXPORT KItemListCreatorBase : public KMemoryBudget::Consumer
 {
 public:
-    virtual ~KItemListCreatorBase();
+    KItemListCreatorBase();
+    ~KItemListCreatorBase() override;
+
+    /**
+     * Sets the maximum number of invisible widgets that are kept for
+     * being reused. KItemListView adjusts it to the number of items that
+     * fit into the viewport. Per default 100 widgets are kept.
+     */
+    void setMaximumRecycleableWidgets(int count);
+
+    QString memoryConsumerName() const override;
+    qint64 memoryUsage() const override;
+    qint64 releaseMemory(qint64 bytes) override;
+    ReleaseOrder releaseOrder() const override;
 
 protected:
     void addCreatedWidget(QGraphicsWidget* widget);
@@ -777,6 +880,7 @@ protected:
 private:
     QSet<QGraphicsWidget*> m_createdWidgets;
     QList<QGraphicsWidget*> m_recycleableWidgets;
+    int m_maximumRecycleableWidgets;
 };
 
 /**
@@ -797,7 +901,7 @@ public:
 
     virtual void recycle(KItemListWidget* widget);
 
-    virtual void calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const = 0;
+    virtual void calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, int firstIndex, int lastIndex, const KItemListView* view) const = 0;
 
     virtual qreal preferredRoleColumnWidth(const QByteArray& role,
                                            int index,
@@ -816,7 +920,7 @@ public:
 
     KItemListWidget* create(KItemListView* view) override;
 
-    void calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const override;
+    void calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, int firstIndex, int lastIndex, const KItemListView* view) const override;
 
     qreal preferredRoleColumnWidth(const QByteArray& role,
                                            int index,
@@ -849,9 +953,9 @@ KItemListWidget* KItemListWidgetCreator<T>::create(KItemListView* view)
 }
 
 template<class T>
-void KItemListWidgetCreator<T>::calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const
+void KItemListWidgetCreator<T>::calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, int firstIndex, int lastIndex, const KItemListView* view) const
 {
-    return m_informant->calculateItemSizeHints(logicalHeightHints, logicalWidthHint, view);
+    return m_informant->calculateItemSizeHints(logicalHeightHints, logicalWidthHint, firstIndex, lastIndex, view);
 }
 
 template<class T>
@@ -16,6 +16,13 @@
 
 #include <QGraphicsScene>
 #include <QGraphicsView>
+#include <QTimer>
+
+namespace {
+    // Number of cell interfaces that may exist besides the ones of the
+    // visible items before the cells get trimmed
+    const int MaxCachedCells = 200;
+}
 
 KItemListView* KItemListViewAccessible::view() const
 {
@@ -23,19 +30,16 @@ KItemListView* KItemListViewAccessible::view() const
 }
 
 KItemListViewAccessible::KItemListViewAccessible(KItemListView* view_) :
-    QAccessibleObject(view_)
+    QAccessibleObject(view_),
+    m_cells(),
+    m_cellsTrimmingScheduled(false)
 {
     Q_ASSERT(view());
-    m_cells.resize(childCount());
 }
 
 KItemListViewAccessible::~KItemListViewAccessible()
 {
-    for (AccessibleIdWrapper idWrapper : qAsConst(m_cells)) {
-        if (idWrapper.isValid) {
-            QAccessible::deleteAccessibleInterface(idWrapper.id);
-        }
-    }
+    removeCells(0);
 }
 
 void* KItemListViewAccessible::interface_cast(QAccessible::InterfaceType type)
@@ -56,18 +60,67 @@ QAccessibleInterface* KItemListViewAccessible::cell(int index) const
         return nullptr;
     }
 
-    if (m_cells.size() <= index) {
-        m_cells.resize(childCount());
+    auto it = m_cells.find(index);
+    if (it == m_cells.end()) {
+        const QAccessible::Id id = QAccessible::registerAccessibleInterface(new KItemListAccessibleCell(view(), index));
+        it = m_cells.insert(index, id);
+
+        const int visibleCount = view()->lastVisibleIndex() - view()->firstVisibleIndex() + 1;
+        if (m_cells.count() > visibleCount + MaxCachedCells) {
+            scheduleCellsTrimming();
+        }
+    }
+    return QAccessible::accessibleInterface(it.value());
+}
+
+void KItemListViewAccessible::removeCells(int fromIndex)
+{
+    auto it = m_cells.begin();
+    while (it != m_cells.end()) {
+        if (it.key() >= fromIndex) {
+            QAccessible::deleteAccessibleInterface(it.value());
+            it = m_cells.erase(it);
+        } else {
+            ++it;
+        }
     }
-    Q_ASSERT(index < m_cells.size());
+}
 
-    AccessibleIdWrapper idWrapper = m_cells.at(index);
-    if (!idWrapper.isValid) {
-        idWrapper.id = QAccessible::registerAccessibleInterface(new KItemListAccessibleCell(view(), index));
-        idWrapper.isValid = true;
-        m_cells.insert(index, idWrapper);
+void KItemListViewAccessible::scheduleCellsTrimming() const
+{
+    if (m_cellsTrimmingScheduled) {
+        return;
+    }
+    m_cellsTrimmingScheduled = true;
+
+    // The view is used as context, as the interface gets deleted together with the view
+    KItemListView* view = this->view();
+    QTimer::singleShot(0, view, [view]() {
+        QAccessibleInterface* interface = QAccessible::queryAccessibleInterface(view);
+        if (interface) {
+            static_cast<KItemListViewAccessible*>(interface)->trimCells();
+        }
+    });
+}
+
+void KItemListViewAccessible::trimCells()
+{
+    m_cellsTrimmingScheduled = false;
+
+    const int firstVisibleIndex = view()->firstVisibleIndex();
+    const int lastVisibleIndex = view()->lastVisibleIndex();
+    const int currentIndex = view()->controller()->selectionManager()->currentItem();
+
+    auto it = m_cells.begin();
+    while (it != m_cells.end()) {
+        const int index = it.key();
+        if ((index < firstVisibleIndex || index > lastVisibleIndex) && index != currentIndex) {
+            QAccessible::deleteAccessibleInterface(it.value());
+            it = m_cells.erase(it);
+        } else {
+            ++it;
+        }
     }
-    return QAccessible::accessibleInterface(idWrapper.id);
 }
 
 QAccessibleInterface* KItemListViewAccessible::cellAt(int row, int column) const
@@ -185,8 +238,25 @@ bool KItemListViewAccessible::unselectColumn(int)
     return true;
 }
 
-void KItemListViewAccessible::modelChange(QAccessibleTableModelChangeEvent* /*event*/)
-{}
+void KItemListViewAccessible::modelChange(QAccessibleTableModelChangeEvent* event)
+{
+    switch (event->modelChangeType()) {
+    case QAccessibleTableModelChangeEvent::DataChanged:
+        // The cells only refer to the index of the item, so they can be kept
+        break;
+
+    case QAccessibleTableModelChangeEvent::ModelReset:
+        removeCells(0);
+        break;
+
+    default:
+        // Items have been inserted or removed, so the cells at and after
+        // the first changed row refer to other items now. They are
+        // created again when they are queried.
+        removeCells(qMax(0, event->firstRow()));
+        break;
+    }
+}
 
 QAccessible::Role KItemListViewAccessible::role() const
 {
@@ -252,12 +322,6 @@ QAccessibleInterface* KItemListViewAccessible::child(int index) const
     return nullptr;
 }
 
-KItemListViewAccessible::AccessibleIdWrapper::AccessibleIdWrapper() :
-    isValid(false),
-    id(0)
-{
-}
-
 // Table Cell
 
 KItemListAccessibleCell::KItemListAccessibleCell(KItemListView* view, int index) :
@@ -14,6 +14,7 @@
 #include <QAccessible>
 #include <QAccessibleObject>
 #include <QAccessibleWidget>
+#include <QHash>
 #include <QPointer>
 
 class KItemListView;
@@ -73,13 +74,25 @@ protected:
     inline QAccessibleInterface* cell(int index) const;
 
 private:
-    class AccessibleIdWrapper {
-    public:
-        AccessibleIdWrapper();
-        bool isValid;
-        QAccessible::Id id;
-    };
-    mutable QVector<AccessibleIdWrapper> m_cells;
+    /**
+     * Deletes the interfaces of all cells with an index equal to
+     * or greater than \a fromIndex.
+     */
+    void removeCells(int fromIndex);
+
+    /**
+     * Deletes the interfaces of all cells that are neither visible nor
+     * current. This is done asynchronously, as the interfaces that have
+     * been returned by a query must stay valid until it is finished.
+     */
+    void scheduleCellsTrimming() const;
+    void trimCells();
+
+private:
+    // The interfaces of the cells are only created when they are queried,
+    // as the model may contain many thousands of items.
+    mutable QHash<int, QAccessible::Id> m_cells;
+    mutable bool m_cellsTrimmingScheduled;
 };
 
 class DOLPHIN_EXPORT KItemListAccessibleCell: public QAccessibleInterface, public QAccessibleTableCellInterface
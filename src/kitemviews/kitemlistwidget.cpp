@@ -33,6 +33,7 @@ KItemListWidget::KItemListWidget(KItemListWidgetInformant* informant, QGraphicsI
     m_hovered(false),
     m_alternateBackground(false),
     m_enabledSelectionToggle(false),
+    m_enabledHoverEffects(true),
     m_data(),
     m_visibleRoles(),
     m_columnWidths(),
@@ -232,6 +233,19 @@ void KItemListWidget::setHovered(bool hovered)
 
     m_hovered = hovered;
 
+    if (!m_enabledHoverEffects) {
+        // The selection toggle is shown and hidden without fading
+        if (hovered && m_enabledSelectionToggle && !(QApplication::mouseButtons() & Qt::LeftButton)) {
+            initializeSelectionToggle();
+            m_selectionToggle->setOpacity(1.0);
+        } else if (!hovered && m_selectionToggle) {
+            m_selectionToggle->deleteLater();
+            m_selectionToggle = nullptr;
+        }
+        hoveredChanged(hovered);
+        return;
+    }
+
     if (!m_hoverAnimation) {
         m_hoverAnimation = new QPropertyAnimation(this, "hoverOpacity", this);
         const int duration = style()->styleHint(QStyle::SH_Widget_Animate) ? 200 : 1;
@@ -268,6 +282,7 @@ void KItemListWidget::setHoverPosition(const QPointF& pos)
     if (m_selectionToggle) {
         m_selectionToggle->setHovered(selectionToggleRect().contains(pos));
     }
+    hoverPositionChanged(pos);
 }
 
 void KItemListWidget::setAlternateBackground(bool enable)
@@ -297,6 +312,26 @@ bool KItemListWidget::enabledSelectionToggle() const
     return m_enabledSelectionToggle;
 }
 
+void KItemListWidget::setEnabledHoverEffects(bool enabled)
+{
+    if (m_enabledHoverEffects != enabled) {
+        m_enabledHoverEffects = enabled;
+        if (!enabled) {
+            if (m_hoverAnimation) {
+                m_hoverAnimation->stop();
+            }
+            m_hoverOpacity = 0;
+            clearHoverCache();
+        }
+        update();
+    }
+}
+
+bool KItemListWidget::enabledHoverEffects() const
+{
+    return m_enabledHoverEffects;
+}
+
 void KItemListWidget::setSiblingsInformation(const QBitArray& siblings)
 {
     const QBitArray previous = m_siblingsInfo;
@@ -421,6 +456,11 @@ void KItemListWidget::hoveredChanged(bool hovered)
     Q_UNUSED(hovered)
 }
 
+void KItemListWidget::hoverPositionChanged(const QPointF& pos)
+{
+    Q_UNUSED(pos)
+}
+
 void KItemListWidget::alternateBackgroundChanged(bool enabled)
 {
     Q_UNUSED(enabled)
@@ -34,7 +34,12 @@ public:
     KItemListWidgetInformant();
     virtual ~KItemListWidgetInformant();
 
-    virtual void calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const = 0;
+    /**
+     * Calculates the logical height hints of the items between \a firstIndex
+     * and \a lastIndex that are not positive in \a logicalHeightHints. The
+     * other entries of \a logicalHeightHints must not be touched.
+     */
+    virtual void calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, int firstIndex, int lastIndex, const KItemListView* view) const = 0;
 
     virtual qreal preferredRoleColumnWidth(const QByteArray& role,
                                            int index,
@@ -101,6 +106,14 @@ public:
     void setEnabledSelectionToggle(bool enabled);
     bool enabledSelectionToggle() const;
 
+    /**
+     * If set to false, the hovered state of the item is not shown and
+     * changing it does not result in a repaint. Per default the hover
+     * effects are enabled.
+     */
+    void setEnabledHoverEffects(bool enabled);
+    bool enabledHoverEffects() const;
+
     /**
      * Sets the sibling information for the item and all of its parents.
      * The sibling information of the upper most parent is represented by
@@ -185,6 +198,7 @@ protected:
     virtual void currentChanged(bool current);
     virtual void selectedChanged(bool selected);
     virtual void hoveredChanged(bool hovered);
+    virtual void hoverPositionChanged(const QPointF& pos);
     virtual void alternateBackgroundChanged(bool enabled);
     virtual void siblingsInformationChanged(const QBitArray& current, const QBitArray& previous);
     virtual void editedRoleChanged(const QByteArray& current, const QByteArray& previous);
@@ -217,6 +231,7 @@ private:
     bool m_hovered;
     bool m_alternateBackground;
     bool m_enabledSelectionToggle;
+    bool m_enabledHoverEffects;
     QHash<QByteArray, QVariant> m_data;
     QList<QByteArray> m_visibleRoles;
     QHash<QByteArray, qreal> m_columnWidths;
@@ -67,6 +67,7 @@ QByteArray KItemModelBase::sortRole() const
 void KItemModelBase::setSortOrder(Qt::SortOrder order)
 {
     if (order != m_sortOrder) {
+        onSortOrderAboutToBeChanged(m_sortOrder, order);
         const Qt::SortOrder previous = m_sortOrder;
         m_sortOrder = order;
         onSortOrderChanged(order, previous);
@@ -151,6 +152,12 @@ void KItemModelBase::onSortOrderChanged(Qt::SortOrder current, Qt::SortOrder pre
     Q_UNUSED(previous)
 }
 
+void KItemModelBase::onSortOrderAboutToBeChanged(Qt::SortOrder current, Qt::SortOrder next)
+{
+    Q_UNUSED(current)
+    Q_UNUSED(next)
+}
+
 QUrl KItemModelBase::url(int index) const
 {
     return data(index).value("url").toUrl();
@@ -165,3 +172,8 @@ QUrl KItemModelBase::directory() const
 {
     return QUrl();
 }
+
+bool KItemModelBase::isMovingItemsInBackground() const
+{
+    return false;
+}
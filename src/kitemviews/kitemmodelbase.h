@@ -183,6 +183,14 @@ public:
      * @return Parent directory of the items that are shown
      */
     virtual QUrl directory() const;
+
+    /**
+     * @return True while itemsMoved() is emitted because values of the
+     *         items have changed in the background, and not because the
+     *         user has changed the sorting. The views keep the current
+     *         item at its position for such moves.
+     */
+    virtual bool isMovingItemsInBackground() const;
 Q_SIGNALS:
     /**
      * Is emitted if one or more items have been inserted. Each item-range consists
@@ -267,6 +275,13 @@ protected:
      */
     virtual void onSortOrderChanged(Qt::SortOrder current, Qt::SortOrder previous);
 
+    /**
+     * Is invoked by KItemModelBase::setSortOrder() before the sort order is changed
+     * from \a current to \a next, so that e.g. a sorting in a worker thread, which
+     * reads the sort order, can be stopped first.
+     */
+    virtual void onSortOrderAboutToBeChanged(Qt::SortOrder current, Qt::SortOrder next);
+
 private:
     bool m_groupedSorting;
     QByteArray m_sortRole;
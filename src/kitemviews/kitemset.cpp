@@ -6,6 +6,39 @@
 
 #include "kitemset.h"
 
+#include <algorithm>
+
+KItemSet::KItemSet(const KItemRangeList& itemRanges) :
+    m_itemRanges()
+{
+    KItemRangeList sortedRanges = itemRanges;
+    const auto lessThan = [](const KItemRange& a, const KItemRange& b) {
+        return a.index < b.index;
+    };
+    if (!std::is_sorted(sortedRanges.begin(), sortedRanges.end(), lessThan)) {
+        std::sort(sortedRanges.begin(), sortedRanges.end(), lessThan);
+    }
+
+    // Merge the ranges that overlap or touch each other
+    for (const KItemRange& range : qAsConst(sortedRanges)) {
+        if (range.count <= 0) {
+            continue;
+        }
+
+        if (!m_itemRanges.isEmpty()) {
+            KItemRange& lastRange = m_itemRanges.last();
+            const int lastRangeEnd = lastRange.index + lastRange.count;
+            if (range.index <= lastRangeEnd) {
+                lastRange.count = qMax(lastRangeEnd, range.index + range.count) - lastRange.index;
+                continue;
+            }
+        }
+
+        m_itemRanges.append(range);
+    }
+
+    Q_ASSERT(isValid());
+}
 
 KItemSet::iterator KItemSet::insert(int i)
 {
@@ -256,6 +289,187 @@ KItemSet KItemSet::operator^(const KItemSet& other) const
     return result;
 }
 
+KItemSet KItemSet::operator&(const KItemSet& other) const
+{
+    KItemSet intersection;
+
+    KItemRangeList::const_iterator it1 = m_itemRanges.constBegin();
+    KItemRangeList::const_iterator it2 = other.m_itemRanges.constBegin();
+
+    const KItemRangeList::const_iterator end1 = m_itemRanges.constEnd();
+    const KItemRangeList::const_iterator end2 = other.m_itemRanges.constEnd();
+
+    while (it1 != end1 && it2 != end2) {
+        const int rangeEnd1 = it1->index + it1->count;
+        const int rangeEnd2 = it2->index + it2->count;
+
+        const int index = qMax(it1->index, it2->index);
+        const int count = qMin(rangeEnd1, rangeEnd2) - index;
+        if (count > 0) {
+            intersection.m_itemRanges.append(KItemRange(index, count));
+        }
+
+        // Continue with the range that ends first, as the other one
+        // might still overlap with the next range.
+        if (rangeEnd1 < rangeEnd2) {
+            ++it1;
+        } else {
+            ++it2;
+        }
+    }
+
+    return intersection;
+}
+
+KItemSet KItemSet::operator-(const KItemSet& other) const
+{
+    KItemSet difference;
+
+    KItemRangeList::const_iterator it2 = other.m_itemRanges.constBegin();
+    const KItemRangeList::const_iterator end2 = other.m_itemRanges.constEnd();
+
+    for (const KItemRange& range : qAsConst(m_itemRanges)) {
+        int index = range.index;
+        const int rangeEnd = range.index + range.count;
+
+        // Skip the ranges from 'other' which end before the current range.
+        while (it2 != end2 && it2->index + it2->count <= index) {
+            ++it2;
+        }
+
+        // The last range from 'other' that overlaps with the current range
+        // might also overlap with the next range. Therefore it2 is not moved.
+        KItemRangeList::const_iterator removedIt = it2;
+        while (index < rangeEnd) {
+            if (removedIt != end2 && removedIt->index <= index) {
+                index = removedIt->index + removedIt->count;
+                ++removedIt;
+                continue;
+            }
+
+            const int partEnd = (removedIt != end2) ? qMin(rangeEnd, removedIt->index) : rangeEnd;
+            difference.m_itemRanges.append(KItemRange(index, partEnd - index));
+            index = partEnd;
+        }
+    }
+
+    return difference;
+}
+
+KItemSet KItemSet::shiftedForInsertedRanges(const KItemRangeList& itemRanges) const
+{
+    KItemSet result;
+
+    KItemRangeList::const_iterator insertedIt = itemRanges.constBegin();
+    const KItemRangeList::const_iterator insertedEnd = itemRanges.constEnd();
+    int inc = 0;
+
+    for (const KItemRange& range : qAsConst(m_itemRanges)) {
+        int index = range.index;
+        const int rangeEnd = range.index + range.count;
+
+        while (index < rangeEnd) {
+            // All items at or after the index of an inserted range are moved
+            while (insertedIt != insertedEnd && insertedIt->index <= index) {
+                inc += insertedIt->count;
+                ++insertedIt;
+            }
+
+            // An insertion inside the range splits it
+            const int partEnd = (insertedIt != insertedEnd) ? qMin(rangeEnd, insertedIt->index) : rangeEnd;
+            result.appendRange(index + inc, partEnd - index);
+            index = partEnd;
+        }
+    }
+
+    return result;
+}
+
+KItemSet KItemSet::shiftedForRemovedRanges(const KItemRangeList& itemRanges) const
+{
+    KItemSet result;
+
+    KItemRangeList::const_iterator removedIt = itemRanges.constBegin();
+    const KItemRangeList::const_iterator removedEnd = itemRanges.constEnd();
+    int dec = 0;
+
+    for (const KItemRange& range : qAsConst(m_itemRanges)) {
+        int index = range.index;
+        const int rangeEnd = range.index + range.count;
+
+        while (index < rangeEnd) {
+            while (removedIt != removedEnd && removedIt->index + removedIt->count <= index) {
+                dec += removedIt->count;
+                ++removedIt;
+            }
+
+            if (removedIt != removedEnd && removedIt->index <= index) {
+                // Skip the removed items
+                index = qMin(rangeEnd, removedIt->index + removedIt->count);
+                continue;
+            }
+
+            // Parts of the range that have been separated by removed items
+            // which were not part of the set get merged by appendRange().
+            const int partEnd = (removedIt != removedEnd) ? qMin(rangeEnd, removedIt->index) : rangeEnd;
+            result.appendRange(index - dec, partEnd - index);
+            index = partEnd;
+        }
+    }
+
+    return result;
+}
+
+KItemSet KItemSet::permuted(const KItemRange& itemRange, const QList<int>& movedToIndexes) const
+{
+    Q_ASSERT(movedToIndexes.count() == itemRange.count);
+
+    const int movedBegin = itemRange.index;
+    const int movedEnd = itemRange.index + itemRange.count;
+
+    KItemSet unmovedItems;
+    QVector<bool> movedItems;
+
+    for (const KItemRange& range : qAsConst(m_itemRanges)) {
+        const int rangeEnd = range.index + range.count;
+        if (rangeEnd <= movedBegin || range.index >= movedEnd
+            || (range.index <= movedBegin && rangeEnd >= movedEnd)) {
+            // The range is not touched by the move, or the items
+            // are only moved inside the range.
+            unmovedItems.m_itemRanges.append(range);
+            continue;
+        }
+
+        if (range.index < movedBegin) {
+            unmovedItems.m_itemRanges.append(KItemRange(range.index, movedBegin - range.index));
+        }
+
+        if (movedItems.isEmpty()) {
+            movedItems.resize(itemRange.count);
+        }
+        const int end = qMin(rangeEnd, movedEnd);
+        for (int index = qMax(range.index, movedBegin); index < end; ++index) {
+            movedItems[movedToIndexes.at(index - movedBegin) - movedBegin] = true;
+        }
+
+        if (rangeEnd > movedEnd) {
+            unmovedItems.m_itemRanges.append(KItemRange(movedEnd, rangeEnd - movedEnd));
+        }
+    }
+
+    if (movedItems.isEmpty()) {
+        return unmovedItems;
+    }
+
+    KItemSet result;
+    for (int i = 0; i < movedItems.count(); ++i) {
+        if (movedItems.at(i)) {
+            result.appendRange(movedBegin + i, 1);
+        }
+    }
+    return result + unmovedItems;
+}
+
 bool KItemSet::isValid() const
 {
     const KItemRangeList::const_iterator begin = m_itemRanges.constBegin();
@@ -330,3 +544,21 @@ KItemRangeList::const_iterator KItemSet::constRangeForItem(int i) const
 
     return end;
 }
+
+void KItemSet::appendRange(int index, int count)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    if (!m_itemRanges.isEmpty()) {
+        KItemRange& lastRange = m_itemRanges.last();
+        const int lastRangeEnd = lastRange.index + lastRange.count;
+        if (index <= lastRangeEnd) {
+            lastRange.count = qMax(lastRangeEnd, index + count) - lastRange.index;
+            return;
+        }
+    }
+
+    m_itemRanges.append(KItemRange(index, count));
+}
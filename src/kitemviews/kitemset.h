@@ -34,6 +34,13 @@ class DOLPHIN_EXPORT KItemSet
 public:
     KItemSet();
     KItemSet(const KItemSet& other);
+
+    /**
+     * Creates a set that contains all items of \a itemRanges. The ranges
+     * may overlap and need not be sorted.
+     * Complexity: O(number of ranges) if the ranges are sorted.
+     */
+    explicit KItemSet(const KItemRangeList& itemRanges);
     ~KItemSet();
     KItemSet& operator=(const KItemSet& other);
 
@@ -255,8 +262,47 @@ public:
      */
     KItemSet operator^(const KItemSet& other) const;
 
+    /**
+     * Returns a new set which contains all items that are contained both in
+     * this KItemSet and in \a other.
+     */
+    KItemSet operator&(const KItemSet& other) const;
+
+    /**
+     * Returns a new set which contains all items that are contained in this
+     * KItemSet, but not in \a other.
+     */
+    KItemSet operator-(const KItemSet& other) const;
+
     KItemSet& operator<<(int i);
 
+    /**
+     * Returns the set with the indexes that the items of this KItemSet get
+     * if the items \a itemRanges are inserted into the model. Like in
+     * KItemModelBase::itemsInserted(), the indexes of the ranges refer to
+     * the model before the insertion.
+     * Complexity: O(number of ranges of both).
+     */
+    KItemSet shiftedForInsertedRanges(const KItemRangeList& itemRanges) const;
+
+    /**
+     * Returns the set with the indexes that the items of this KItemSet get
+     * if the items \a itemRanges are removed from the model. The removed
+     * items are not part of the result. Like in KItemModelBase::itemsRemoved(),
+     * the indexes of the ranges refer to the model before the removal.
+     * Complexity: O(number of ranges of both).
+     */
+    KItemSet shiftedForRemovedRanges(const KItemRangeList& itemRanges) const;
+
+    /**
+     * Returns the set with the indexes that the items of this KItemSet get
+     * if the items in \a itemRange are moved to \a movedToIndexes (see
+     * KItemModelBase::itemsMoved()). Ranges that contain the whole moved
+     * range are kept as they are.
+     * Complexity: O(number of ranges + number of moved items).
+     */
+    KItemSet permuted(const KItemRange& itemRange, const QList<int>& movedToIndexes) const;
+
 private:
     /**
      * Returns true if the KItemSet is valid, and false otherwise.
@@ -277,6 +323,13 @@ private:
      */
     KItemRangeList::const_iterator constRangeForItem(int i) const;
 
+    /**
+     * Appends the range \a index, \a count to the end of the set and merges
+     * it with the last range if they touch. \a index must not be smaller
+     * than the beginning of the last range.
+     */
+    void appendRange(int index, int count);
+
     KItemRangeList m_itemRanges;
 
     friend class KItemSetTest;
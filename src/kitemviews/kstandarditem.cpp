@@ -83,6 +83,9 @@ void KStandardItem::setDataValue(const QByteArray& role, const QVariant& value)
     }
 
     m_data.insert(role, value);
+    if (m_model && role == "url") {
+        m_model->onItemUrlChanged(this, previous.toUrl());
+    }
     onDataValueChanged(role, value, previous);
 
     if (m_model) {
@@ -103,6 +106,12 @@ void KStandardItem::setData(const QHash<QByteArray, QVariant>& values)
 {
     const QHash<QByteArray, QVariant> previous = m_data;
     m_data = values;
+    if (m_model) {
+        const QUrl previousUrl = previous.value("url").toUrl();
+        if (previousUrl != values.value("url").toUrl()) {
+            m_model->onItemUrlChanged(this, previousUrl);
+        }
+    }
     onDataChanged(values, previous);
 }
 
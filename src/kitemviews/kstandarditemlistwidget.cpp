@@ -9,7 +9,10 @@
 #include "kfileitemlistview.h"
 #include "kfileitemmodel.h"
 #include "private/kfileitemclipboard.h"
+#include "private/kiconpixmapcache.h"
 #include "private/kitemlistroleeditor.h"
+#include "private/kitemlisttextlayoutcache.h"
+#include "private/kitemlisttracer.h"
 #include "private/kpixmapmodifier.h"
 
 #include <KIconEffect>
@@ -21,33 +24,46 @@
 #include <QGraphicsSceneResizeEvent>
 #include <QGraphicsView>
 #include <QGuiApplication>
-#include <QPixmapCache>
 #include <QStyleOption>
 
+#include <algorithm>
+
 // #define KSTANDARDITEMLISTWIDGET_DEBUG
 
+namespace {
+    // Icon effects for the states of an item, see KStandardItemListWidget::pixmapWithEffects()
+    enum IconEffect {
+        CutEffect = 0x1,
+        HiddenEffect = 0x2,
+        SelectedEffect = 0x4,
+        HoverEffect = 0x8
+    };
+}
+
 KStandardItemListWidgetInformant::KStandardItemListWidgetInformant() :
-    KItemListWidgetInformant()
+    KItemListWidgetInformant(),
+    m_textLayoutCache(new KItemListTextLayoutCache())
 {
 }
 
 KStandardItemListWidgetInformant::~KStandardItemListWidgetInformant()
 {
+    delete m_textLayoutCache;
 }
 
-void KStandardItemListWidgetInformant::calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const
+void KStandardItemListWidgetInformant::calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, int firstIndex, int lastIndex, const KItemListView* view) const
 {
     switch (static_cast<const KStandardItemListView*>(view)->itemLayout()) {
     case KStandardItemListView::IconsLayout:
-        calculateIconsLayoutItemSizeHints(logicalHeightHints, logicalWidthHint, view);
+        calculateIconsLayoutItemSizeHints(logicalHeightHints, logicalWidthHint, firstIndex, lastIndex, view);
         break;
 
     case KStandardItemListView::CompactLayout:
-        calculateCompactLayoutItemSizeHints(logicalHeightHints, logicalWidthHint, view);
+        calculateCompactLayoutItemSizeHints(logicalHeightHints, logicalWidthHint, firstIndex, lastIndex, view);
         break;
 
     case KStandardItemListView::DetailsLayout:
-        calculateDetailsLayoutItemSizeHints(logicalHeightHints, logicalWidthHint, view);
+        calculateDetailsLayoutItemSizeHints(logicalHeightHints, logicalWidthHint, firstIndex, lastIndex, view);
         break;
 
     default:
@@ -93,6 +109,11 @@ qreal KStandardItemListWidgetInformant::preferredRoleColumnWidth(const QByteArra
     return width;
 }
 
+KItemListTextLayoutCache* KStandardItemListWidgetInformant::textLayoutCache() const
+{
+    return m_textLayoutCache;
+}
+
 QString KStandardItemListWidgetInformant::itemText(int index, const KItemListView* view) const
 {
     return view->model()->data(index).value("text").toString();
@@ -120,7 +141,7 @@ QFont KStandardItemListWidgetInformant::customizedFontForLinks(const QFont& base
     return baseFont;
 }
 
-void KStandardItemListWidgetInformant::calculateIconsLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const
+void KStandardItemListWidgetInformant::calculateIconsLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, int firstIndex, int lastIndex, const KItemListView* view) const
 {
     const KItemListStyleOption& option = view->styleOption();
     const QFont& normalFont = option.font;
@@ -136,7 +157,7 @@ void KStandardItemListWidgetInformant::calculateIconsLayoutItemSizeHints(QVector
     QTextOption textOption(Qt::AlignHCenter);
     textOption.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
 
-    for (int index = 0; index < logicalHeightHints.count(); ++index) {
+    for (int index = firstIndex; index <= lastIndex; ++index) {
         if (logicalHeightHints.at(index) > 0.0) {
             continue;
         }
@@ -174,7 +195,7 @@ void KStandardItemListWidgetInformant::calculateIconsLayoutItemSizeHints(QVector
     logicalWidthHint = itemWidth;
 }
 
-void KStandardItemListWidgetInformant::calculateCompactLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const
+void KStandardItemListWidgetInformant::calculateCompactLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, int firstIndex, int lastIndex, const KItemListView* view) const
 {
     const KItemListStyleOption& option = view->styleOption();
     const QFontMetrics& normalFontMetrics = option.fontMetrics;
@@ -188,7 +209,7 @@ void KStandardItemListWidgetInformant::calculateCompactLayoutItemSizeHints(QVect
 
     const QFontMetrics linkFontMetrics(customizedFontForLinks(option.font));
 
-    for (int index = 0; index < logicalHeightHints.count(); ++index) {
+    for (int index = firstIndex; index <= lastIndex; ++index) {
         if (logicalHeightHints.at(index) > 0.0) {
             continue;
         }
@@ -222,11 +243,11 @@ void KStandardItemListWidgetInformant::calculateCompactLayoutItemSizeHints(QVect
     logicalWidthHint = height;
 }
 
-void KStandardItemListWidgetInformant::calculateDetailsLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const
+void KStandardItemListWidgetInformant::calculateDetailsLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, int firstIndex, int lastIndex, const KItemListView* view) const
 {
     const KItemListStyleOption& option = view->styleOption();
     const qreal height = option.padding * 2 + qMax(option.iconSize, option.fontMetrics.height());
-    logicalHeightHints.fill(height);
+    std::fill(logicalHeightHints.begin() + firstIndex, logicalHeightHints.begin() + lastIndex + 1, height);
     logicalWidthHint = -1.0;
 }
 
@@ -242,6 +263,8 @@ KStandardItemListWidget::KStandardItemListWidget(KItemListWidgetInformant* infor
     m_dirtyLayout(true),
     m_dirtyContent(true),
     m_dirtyContentRoles(),
+    m_dirtyColumns(false),
+    m_resizedColumns(),
     m_layout(IconsLayout),
     m_pixmapPos(),
     m_pixmap(),
@@ -255,8 +278,12 @@ KStandardItemListWidget::KStandardItemListWidget(KItemListWidgetInformant* infor
     m_additionalInfoTextColor(),
     m_overlay(),
     m_rating(),
-    m_roleEditor(nullptr),
-    m_oldRoleEditor(nullptr)
+    m_sequencePixmap(),
+    m_sequenceFrameCount(0),
+    m_sequenceFrame(-1),
+    m_sequenceFramePixmap(),
+    m_hoverPosition(),
+    m_roleEditor(nullptr)
 {
 }
 
@@ -266,11 +293,7 @@ KStandardItemListWidget::~KStandardItemListWidget()
     m_textInfo.clear();
 
     if (m_roleEditor) {
-        m_roleEditor->deleteLater();
-    }
-
-    if (m_oldRoleEditor) {
-        m_oldRoleEditor->deleteLater();
+        m_roleEditor->hide();
     }
 }
 
@@ -305,6 +328,7 @@ bool KStandardItemListWidget::supportsItemExpanding() const
 
 void KStandardItemListWidget::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
 {
+    const KItemListTraceScope traceScope("KStandardItemListWidget::paint");
     const_cast<KStandardItemListWidget*>(this)->triggerCacheRefreshing();
 
     KItemListWidget::paint(painter, option, widget);
@@ -314,7 +338,10 @@ void KStandardItemListWidget::paint(QPainter* painter, const QStyleOptionGraphic
     }
 
     const KItemListStyleOption& itemListStyleOption = styleOption();
-    if (isHovered() && !m_pixmap.isNull()) {
+    const bool showHover = isHovered() && enabledHoverEffects();
+    if (showHover && !m_sequenceFramePixmap.isNull()) {
+        drawPixmap(painter, m_sequenceFramePixmap);
+    } else if (showHover && !m_pixmap.isNull()) {
         if (hoverOpacity() < 1.0) {
             /*
              * Linear interpolation between m_pixmap and m_hoverPixmap.
@@ -361,6 +388,15 @@ void KStandardItemListWidget::paint(QPainter* painter, const QStyleOptionGraphic
         drawPixmap(painter, m_pixmap);
     }
 
+    if (!m_overlay.isNull() && !m_pixmap.isNull()) {
+        // The overlay is not painted into m_pixmap, which is shared with
+        // the pixmap cache and the other items that have the same icon
+        const qreal scale = m_scaledPixmapSize.height() / (m_pixmap.height() / m_pixmap.devicePixelRatio());
+        const QSizeF overlaySize = QSizeF(m_overlay.size()) / m_overlay.devicePixelRatio() * scale;
+        const QPointF overlayPos(m_pixmapPos.x(), m_pixmapPos.y() + m_scaledPixmapSize.height() - overlaySize.height());
+        painter->drawPixmap(QRectF(overlayPos, overlaySize), m_overlay, QRectF(m_overlay.rect()));
+    }
+
     painter->setFont(m_customizedFont);
     painter->setPen(textColor());
     const TextInfo* textInfo = m_textInfo.value("text");
@@ -632,8 +668,8 @@ QColor KStandardItemListWidget::textColor() const
 
 void KStandardItemListWidget::setOverlay(const QPixmap& overlay)
 {
+    // The overlay is painted above the pixmap, which stays valid
     m_overlay = overlay;
-    m_dirtyContent = true;
     update();
 }
 
@@ -652,8 +688,6 @@ QString KStandardItemListWidget::roleText(const QByteArray& role,
 void KStandardItemListWidget::dataChanged(const QHash<QByteArray, QVariant>& current,
                                           const QSet<QByteArray>& roles)
 {
-    Q_UNUSED(current)
-
     m_dirtyContent = true;
 
     QSet<QByteArray> dirtyRoles;
@@ -680,24 +714,43 @@ void KStandardItemListWidget::dataChanged(const QHash<QByteArray, QVariant>& cur
         const QByteArray& role = it.next();
         m_dirtyContentRoles.insert(role);
     }
+
+    if (roles.isEmpty() || roles.contains("iconSequence")) {
+        m_sequencePixmap = current.value("iconSequence").value<QPixmap>();
+        m_sequenceFrameCount = current.value("iconSequenceFrames").toInt();
+        m_sequenceFrame = -1;
+        updateSequenceFrame();
+    }
 }
 
 void KStandardItemListWidget::visibleRolesChanged(const QList<QByteArray>& current,
                                               const QList<QByteArray>& previous)
 {
-    Q_UNUSED(previous)
+    const bool columnsMoved = (m_layout == DetailsLayout && !m_dirtyLayout && current.count() == previous.count()
+                               && std::is_permutation(current.cbegin(), current.cend(), previous.cbegin()));
     m_sortedVisibleRoles = current;
-    m_dirtyLayout = true;
+    if (columnsMoved) {
+        // The texts of moved columns can be kept
+        m_dirtyColumns = true;
+    } else {
+        m_dirtyLayout = true;
+    }
 }
 
 void KStandardItemListWidget::columnWidthChanged(const QByteArray& role,
                                              qreal current,
                                              qreal previous)
 {
-    Q_UNUSED(role)
     Q_UNUSED(current)
     Q_UNUSED(previous)
-    m_dirtyLayout = true;
+    if (m_layout == DetailsLayout && !m_dirtyLayout) {
+        // Resizing a column only requires to elide its texts again, so
+        // dragging the edge of a column header does not rebuild all texts
+        m_dirtyColumns = true;
+        m_resizedColumns.insert(role);
+    } else {
+        m_dirtyLayout = true;
+    }
 }
 
 void KStandardItemListWidget::styleOptionChanged(const KItemListStyleOption& current,
@@ -713,6 +766,14 @@ void KStandardItemListWidget::hoveredChanged(bool hovered)
 {
     Q_UNUSED(hovered)
     m_dirtyLayout = true;
+    m_sequenceFrame = -1;
+    updateSequenceFrame();
+}
+
+void KStandardItemListWidget::hoverPositionChanged(const QPointF& pos)
+{
+    m_hoverPosition = pos;
+    updateSequenceFrame();
 }
 
 void KStandardItemListWidget::selectedChanged(bool selected)
@@ -748,10 +809,6 @@ void KStandardItemListWidget::editedRoleChanged(const QByteArray& current, const
             disconnect(m_roleEditor, &KItemListRoleEditor::roleEditingFinished,
                        this, &KStandardItemListWidget::slotRoleEditingFinished);
 
-            if (m_oldRoleEditor) {
-                m_oldRoleEditor->deleteLater();
-            }
-            m_oldRoleEditor = m_roleEditor;
             m_roleEditor->hide();
             m_roleEditor = nullptr;
         }
@@ -762,15 +819,27 @@ void KStandardItemListWidget::editedRoleChanged(const QByteArray& current, const
 
     const TextInfo* textInfo = m_textInfo.value("text");
 
-    m_roleEditor = new KItemListRoleEditor(parent);
+    m_roleEditor = KItemListRoleEditor::sharedEditor(parent);
     m_roleEditor->setRole(current);
     m_roleEditor->setFont(styleOption().font);
 
+    QTextOption textOption = textInfo->staticText.textOption();
+    m_roleEditor->document()->setDefaultTextOption(textOption);
+
+    // Clears the undo history of the previous renaming. The text is set
+    // before the geometry, so that the editor is enlarged by autoAdjustSize()
+    // only if the text does not fit into the final size.
     const QString text = data().value(current).toString();
     m_roleEditor->setPlainText(text);
 
-    QTextOption textOption = textInfo->staticText.textOption();
-    m_roleEditor->document()->setDefaultTextOption(textOption);
+    QRectF rect = roleEditingRect(current);
+    const int frameWidth = m_roleEditor->frameWidth();
+    rect.adjust(-frameWidth, -frameWidth, frameWidth, frameWidth);
+    rect.translate(pos());
+    if (rect.right() > parent->width()) {
+        rect.setWidth(parent->width() - rect.left());
+    }
+    m_roleEditor->setGeometry(rect.toRect());
 
     const int textSelectionLength = selectionLength(text);
 
@@ -786,15 +855,6 @@ void KStandardItemListWidget::editedRoleChanged(const QByteArray& current, const
     connect(m_roleEditor, &KItemListRoleEditor::roleEditingFinished,
             this, &KStandardItemListWidget::slotRoleEditingFinished);
 
-    // Adjust the geometry of the editor
-    QRectF rect = roleEditingRect(current);
-    const int frameWidth = m_roleEditor->frameWidth();
-    rect.adjust(-frameWidth, -frameWidth, frameWidth, frameWidth);
-    rect.translate(pos());
-    if (rect.right() > parent->width()) {
-        rect.setWidth(parent->width() - rect.left());
-    }
-    m_roleEditor->setGeometry(rect.toRect());
     m_roleEditor->show();
     m_roleEditor->setFocus();
 }
@@ -850,9 +910,13 @@ void KStandardItemListWidget::finishRoleEditing()
     }
 }
 
-void KStandardItemListWidget::slotCutItemsChanged()
+void KStandardItemListWidget::slotCutItemsChanged(const QSet<QUrl>& directories)
 {
     const QUrl itemUrl = data().value("url").toUrl();
+    if (!directories.contains(KFileItemClipboard::directoryUrl(itemUrl))) {
+        return;
+    }
+
     const bool isCut = KFileItemClipboard::instance()->isCut(itemUrl);
     if (m_isCut != isCut) {
         m_isCut = isCut;
@@ -880,7 +944,19 @@ void KStandardItemListWidget::slotRoleEditingFinished(const QByteArray& role,
 
 void KStandardItemListWidget::triggerCacheRefreshing()
 {
-    if ((!m_dirtyContent && !m_dirtyLayout) || index() < 0) {
+    if (index() < 0) {
+        return;
+    }
+
+    if (!m_dirtyContent && !m_dirtyLayout) {
+        if (m_dirtyColumns) {
+            updateDetailsLayoutTextCache(true);
+            if (m_resizedColumns.contains("rating")) {
+                updateRatingCache();
+            }
+            m_dirtyColumns = false;
+            m_resizedColumns.clear();
+        }
         return;
     }
 
@@ -899,6 +975,8 @@ void KStandardItemListWidget::triggerCacheRefreshing()
     m_dirtyLayout = false;
     m_dirtyContent = false;
     m_dirtyContentRoles.clear();
+    m_dirtyColumns = false;
+    m_resizedColumns.clear();
 }
 
 void KStandardItemListWidget::updateExpansionArea()
@@ -967,32 +1045,26 @@ void KStandardItemListWidget::updatePixmapCache()
             return;
         }
 
+        quint32 effects = 0;
         if (m_isCut) {
-            KIconEffect* effect = KIconLoader::global()->iconEffect();
-            m_pixmap = effect->apply(m_pixmap, KIconLoader::Desktop, KIconLoader::DisabledState);
+            effects |= CutEffect;
         }
-
         if (m_isHidden) {
-            KIconEffect::semiTransparent(m_pixmap);
+            effects |= HiddenEffect;
         }
-
         if (m_layout == IconsLayout && isSelected()) {
-            const QColor color = palette().brush(QPalette::Normal, QPalette::Highlight).color();
-            QImage image = m_pixmap.toImage();
-            if (image.isNull()) {
+            effects |= SelectedEffect;
+        }
+
+        if (effects != 0) {
+            m_pixmap = pixmapWithEffects(m_pixmap, effects);
+            if (m_pixmap.isNull()) {
                 m_hoverPixmap = QPixmap();
                 return;
             }
-            KIconEffect::colorize(image, color, 0.8f);
-            m_pixmap = QPixmap::fromImage(image);
         }
     }
 
-    if (!m_overlay.isNull()) {
-        QPainter painter(&m_pixmap);
-        painter.drawPixmap(0, (m_pixmap.height() - m_overlay.height()) / m_pixmap.devicePixelRatio(), m_overlay);
-    }
-
     int scaledIconSize = 0;
     if (iconOnTop) {
         const TextInfo* textInfo = m_textInfo.value("text");
@@ -1033,12 +1105,11 @@ void KStandardItemListWidget::updatePixmapCache()
     m_iconRect = QRectF(m_pixmapPos, QSizeF(m_scaledPixmapSize));
 
     // Prepare the pixmap that is used when the item gets hovered
-    if (isHovered()) {
-        m_hoverPixmap = m_pixmap;
+    if (isHovered() && enabledHoverEffects()) {
         KIconEffect* effect = KIconLoader::global()->iconEffect();
         // In the KIconLoader terminology, active = hover.
         if (effect->hasEffect(KIconLoader::Desktop, KIconLoader::ActiveState)) {
-            m_hoverPixmap = effect->apply(m_pixmap, KIconLoader::Desktop, KIconLoader::ActiveState);
+            m_hoverPixmap = pixmapWithEffects(m_pixmap, HoverEffect);
         } else {
             m_hoverPixmap = m_pixmap;
         }
@@ -1048,6 +1119,28 @@ void KStandardItemListWidget::updatePixmapCache()
     }
 }
 
+void KStandardItemListWidget::updateSequenceFrame()
+{
+    if (!isHovered() || !enabledHoverEffects() || m_sequenceFrameCount <= 1 || m_sequencePixmap.isNull() || m_iconRect.width() <= 0) {
+        if (!m_sequenceFramePixmap.isNull()) {
+            m_sequenceFramePixmap = QPixmap();
+            update();
+        }
+        m_sequenceFrame = -1;
+        return;
+    }
+
+    const qreal position = (m_hoverPosition.x() - m_iconRect.left()) / m_iconRect.width();
+    const int frame = qBound(0, static_cast<int>(position * m_sequenceFrameCount), m_sequenceFrameCount - 1);
+    if (frame != m_sequenceFrame) {
+        m_sequenceFrame = frame;
+        const int frameWidth = m_sequencePixmap.width() / m_sequenceFrameCount;
+        m_sequenceFramePixmap = m_sequencePixmap.copy(frame * frameWidth, 0, frameWidth, m_sequencePixmap.height());
+        m_sequenceFramePixmap.setDevicePixelRatio(m_sequencePixmap.devicePixelRatio());
+        update();
+    }
+}
+
 void KStandardItemListWidget::updateTextsCache()
 {
     QTextOption textOption;
@@ -1083,6 +1176,11 @@ void KStandardItemListWidget::updateTextsCache()
     default: Q_ASSERT(false); break;
     }
 
+    updateRatingCache();
+}
+
+void KStandardItemListWidget::updateRatingCache()
+{
     const TextInfo* ratingTextInfo = m_textInfo.value("rating");
     if (ratingTextInfo) {
         // The text of the rating-role has been set to empty to get
@@ -1110,6 +1208,11 @@ void KStandardItemListWidget::updateTextsCache()
     }
 }
 
+KItemListTextLayoutCache* KStandardItemListWidget::textLayoutCache() const
+{
+    return static_cast<const KStandardItemListWidgetInformant*>(informant())->textLayoutCache();
+}
+
 QString KStandardItemListWidget::elideRightKeepExtension(const QString &text, int elidingWidth) const
 {
     const auto extensionIndex = text.lastIndexOf('.');
@@ -1154,55 +1257,66 @@ void KStandardItemListWidget::updateIconsLayoutTextCache()
     // for initializing the position of the other roles.
     TextInfo* nameTextInfo = m_textInfo.value("text");
     const QString nameText = KStringHandler::preProcessWrap(values["text"].toString());
-    nameTextInfo->staticText.setText(nameText);
 
     // Calculate the number of lines required for the name and the required width
     qreal nameWidth = 0;
     qreal nameHeight = 0;
-    QTextLine line;
-
-    QTextLayout layout(nameTextInfo->staticText.text(), m_customizedFont);
-    layout.setTextOption(nameTextInfo->staticText.textOption());
-    layout.beginLayout();
-    int nameLineIndex = 0;
-    while ((line = layout.createLine()).isValid()) {
-        line.setLineWidth(maxWidth);
-        nameWidth = qMax(nameWidth, line.naturalTextWidth());
-        nameHeight += line.height();
-
-        ++nameLineIndex;
-        if (nameLineIndex == option.maxTextLines) {
-            // The maximum number of textlines has been reached. If this is
-            // the case provide an elided text if necessary.
-            const int textLength = line.textStart() + line.textLength();
-            if (textLength < nameText.length()) {
-                // Elide the last line of the text
-                qreal elidingWidth = maxWidth;
-                qreal lastLineWidth;
-                do {
-                    QString lastTextLine = nameText.mid(line.textStart());
-                    lastTextLine = elideRightKeepExtension(lastTextLine, elidingWidth);
-                    const QString elidedText = nameText.left(line.textStart()) + lastTextLine;
-                    nameTextInfo->staticText.setText(elidedText);
-
-                    lastLineWidth = m_customizedFontMetrics.horizontalAdvance(lastTextLine);
-
-                    // We do the text eliding in a loop with decreasing width (1 px / iteration)
-                    // to avoid problems related to different width calculation code paths
-                    // within Qt. (see bug 337104)
-                    elidingWidth -= 1.0;
-                } while (lastLineWidth > maxWidth);
-
-                nameWidth = qMax(nameWidth, lastLineWidth);
+
+    KItemListTextLayoutCache* cache = textLayoutCache();
+    const KItemListTextLayoutCache::Key nameKey(nameText, m_customizedFont, maxWidth, IconsLayout, option.maxTextLines);
+    if (const KItemListTextLayoutCache::TextLayout* textLayout = cache->textLayout(nameKey)) {
+        nameTextInfo->staticText = textLayout->staticText;
+        nameWidth = textLayout->width;
+        nameHeight = textLayout->height;
+    } else {
+        nameTextInfo->staticText.setText(nameText);
+
+        QTextLine line;
+        QTextLayout layout(nameTextInfo->staticText.text(), m_customizedFont);
+        layout.setTextOption(nameTextInfo->staticText.textOption());
+        layout.beginLayout();
+        int nameLineIndex = 0;
+        while ((line = layout.createLine()).isValid()) {
+            line.setLineWidth(maxWidth);
+            nameWidth = qMax(nameWidth, line.naturalTextWidth());
+            nameHeight += line.height();
+
+            ++nameLineIndex;
+            if (nameLineIndex == option.maxTextLines) {
+                // The maximum number of textlines has been reached. If this is
+                // the case provide an elided text if necessary.
+                const int textLength = line.textStart() + line.textLength();
+                if (textLength < nameText.length()) {
+                    // Elide the last line of the text
+                    qreal elidingWidth = maxWidth;
+                    qreal lastLineWidth;
+                    do {
+                        QString lastTextLine = nameText.mid(line.textStart());
+                        lastTextLine = elideRightKeepExtension(lastTextLine, elidingWidth);
+                        const QString elidedText = nameText.left(line.textStart()) + lastTextLine;
+                        nameTextInfo->staticText.setText(elidedText);
+
+                        lastLineWidth = m_customizedFontMetrics.horizontalAdvance(lastTextLine);
+
+                        // We do the text eliding in a loop with decreasing width (1 px / iteration)
+                        // to avoid problems related to different width calculation code paths
+                        // within Qt. (see bug 337104)
+                        elidingWidth -= 1.0;
+                    } while (lastLineWidth > maxWidth);
+
+                    nameWidth = qMax(nameWidth, lastLineWidth);
+                }
+                break;
             }
-            break;
         }
+        layout.endLayout();
+
+        nameTextInfo->staticText.setTextWidth(maxWidth);
+        cache->insert(nameKey, {nameTextInfo->staticText, nameWidth, nameHeight});
     }
-    layout.endLayout();
 
     // Use one line for each additional information
     const int additionalRolesCount = qMax(visibleRoles().count() - 1, 0);
-    nameTextInfo->staticText.setTextWidth(maxWidth);
     nameTextInfo->pos = QPointF(padding, widgetHeight -
                                          nameHeight -
                                          additionalRolesCount * lineSpacing -
@@ -1221,33 +1335,44 @@ void KStandardItemListWidget::updateIconsLayoutTextCache()
 
         const QString text = roleText(role, values);
         TextInfo* textInfo = m_textInfo.value(role);
-        textInfo->staticText.setText(text);
 
         qreal requiredWidth = 0;
 
-        QTextLayout layout(text, m_customizedFont);
-        QTextOption textOption;
-        textOption.setWrapMode(QTextOption::NoWrap);
-        layout.setTextOption(textOption);
-
-        layout.beginLayout();
-        QTextLine textLine = layout.createLine();
-        if (textLine.isValid()) {
-            textLine.setLineWidth(maxWidth);
-            requiredWidth = textLine.naturalTextWidth();
-            if (requiredWidth > maxWidth) {
-                const QString elidedText = elideRightKeepExtension(text, maxWidth);
-                textInfo->staticText.setText(elidedText);
-                requiredWidth = m_customizedFontMetrics.horizontalAdvance(elidedText);
-            } else if (role == "rating") {
-                // Use the width of the rating pixmap, because the rating text is empty.
-                requiredWidth = m_rating.width();
+        const KItemListTextLayoutCache::Key key(text, m_customizedFont, maxWidth, IconsLayout, -1);
+        if (const KItemListTextLayoutCache::TextLayout* textLayout = cache->textLayout(key)) {
+            textInfo->staticText = textLayout->staticText;
+            requiredWidth = textLayout->width;
+        } else {
+            textInfo->staticText.setText(text);
+
+            QTextLayout layout(text, m_customizedFont);
+            QTextOption textOption;
+            textOption.setWrapMode(QTextOption::NoWrap);
+            layout.setTextOption(textOption);
+
+            layout.beginLayout();
+            QTextLine textLine = layout.createLine();
+            if (textLine.isValid()) {
+                textLine.setLineWidth(maxWidth);
+                requiredWidth = textLine.naturalTextWidth();
+                if (requiredWidth > maxWidth) {
+                    const QString elidedText = elideRightKeepExtension(text, maxWidth);
+                    textInfo->staticText.setText(elidedText);
+                    requiredWidth = m_customizedFontMetrics.horizontalAdvance(elidedText);
+                }
             }
+            layout.endLayout();
+
+            textInfo->staticText.setTextWidth(maxWidth);
+            cache->insert(key, {textInfo->staticText, requiredWidth, lineSpacing});
+        }
+
+        if (role == "rating" && requiredWidth <= maxWidth) {
+            // Use the width of the rating pixmap, because the rating text is empty.
+            requiredWidth = m_rating.width();
         }
-        layout.endLayout();
 
         textInfo->pos = QPointF(padding, y);
-        textInfo->staticText.setTextWidth(maxWidth);
 
         const QRectF textRect(padding + (maxWidth - requiredWidth) / 2, y, requiredWidth, lineSpacing);
         m_textRect |= textRect;
@@ -1277,20 +1402,32 @@ void KStandardItemListWidget::updateCompactLayoutTextCache()
     const qreal x = option.padding * 3 + scaledIconSize;
     qreal y = qRound((widgetHeight - textLinesHeight) / 2);
     const qreal maxWidth = size().width() - x - option.padding;
+    KItemListTextLayoutCache* cache = textLayoutCache();
     for (const QByteArray& role : qAsConst(m_sortedVisibleRoles)) {
         const QString text = roleText(role, values);
         TextInfo* textInfo = m_textInfo.value(role);
-        textInfo->staticText.setText(text);
 
-        qreal requiredWidth = m_customizedFontMetrics.horizontalAdvance(text);
-        if (requiredWidth > maxWidth) {
-            requiredWidth = maxWidth;
-            const QString elidedText = elideRightKeepExtension(text, maxWidth);
-            textInfo->staticText.setText(elidedText);
+        qreal requiredWidth = 0;
+
+        const KItemListTextLayoutCache::Key key(text, m_customizedFont, maxWidth, CompactLayout, -1);
+        if (const KItemListTextLayoutCache::TextLayout* textLayout = cache->textLayout(key)) {
+            textInfo->staticText = textLayout->staticText;
+            requiredWidth = textLayout->width;
+        } else {
+            textInfo->staticText.setText(text);
+
+            requiredWidth = m_customizedFontMetrics.horizontalAdvance(text);
+            if (requiredWidth > maxWidth) {
+                requiredWidth = maxWidth;
+                const QString elidedText = elideRightKeepExtension(text, maxWidth);
+                textInfo->staticText.setText(elidedText);
+            }
+
+            textInfo->staticText.setTextWidth(maxWidth);
+            cache->insert(key, {textInfo->staticText, requiredWidth, lineSpacing});
         }
 
         textInfo->pos = QPointF(x, y);
-        textInfo->staticText.setTextWidth(maxWidth);
 
         maximumRequiredTextWidth = qMax(maximumRequiredTextWidth, requiredWidth);
 
@@ -1300,7 +1437,7 @@ void KStandardItemListWidget::updateCompactLayoutTextCache()
     m_textRect = QRectF(x - option.padding, 0, maximumRequiredTextWidth + 2 * option.padding, widgetHeight);
 }
 
-void KStandardItemListWidget::updateDetailsLayoutTextCache()
+void KStandardItemListWidget::updateDetailsLayoutTextCache(bool resizedColumnsOnly)
 {
     // Precondition: Requires already updated m_expansionArea
     // to determine the left position.
@@ -1328,11 +1465,8 @@ void KStandardItemListWidget::updateDetailsLayoutTextCache()
     qreal x = firstColumnInc;
     const qreal y = qMax(qreal(option.padding), (widgetHeight - fontHeight) / 2);
 
+    KItemListTextLayoutCache* cache = textLayoutCache();
     for (const QByteArray& role : qAsConst(m_sortedVisibleRoles)) {
-        QString text = roleText(role, values);
-
-        // Elide the text in case it does not fit into the available column-width
-        qreal requiredWidth = m_customizedFontMetrics.horizontalAdvance(text);
         const qreal roleWidth = columnWidth(role);
         qreal availableTextWidth = roleWidth - columnWidthInc;
 
@@ -1341,13 +1475,28 @@ void KStandardItemListWidget::updateDetailsLayoutTextCache()
             availableTextWidth -= firstColumnInc;
         }
 
-        if (requiredWidth > availableTextWidth) {
-            text = elideRightKeepExtension(text, availableTextWidth);
-            requiredWidth = m_customizedFontMetrics.horizontalAdvance(text);
+        TextInfo* textInfo = m_textInfo.value(role);
+        if (!resizedColumnsOnly || m_resizedColumns.contains(role)) {
+            const QString text = roleText(role, values);
+            const KItemListTextLayoutCache::Key key(text, m_customizedFont, availableTextWidth, DetailsLayout, -1);
+            if (const KItemListTextLayoutCache::TextLayout* textLayout = cache->textLayout(key)) {
+                textInfo->staticText = textLayout->staticText;
+                textInfo->width = textLayout->width;
+            } else {
+                // Elide the text in case it does not fit into the available column-width
+                QString elidedText = text;
+                textInfo->width = m_customizedFontMetrics.horizontalAdvance(text);
+                if (textInfo->width > availableTextWidth) {
+                    elidedText = elideRightKeepExtension(text, availableTextWidth);
+                    textInfo->width = m_customizedFontMetrics.horizontalAdvance(elidedText);
+                }
+
+                textInfo->staticText.setText(elidedText);
+                cache->insert(key, {textInfo->staticText, textInfo->width, qreal(fontHeight)});
+            }
         }
+        const qreal requiredWidth = textInfo->width;
 
-        TextInfo* textInfo = m_textInfo.value(role);
-        textInfo->staticText.setText(text);
         textInfo->pos = QPointF(x + columnWidthInc / 2, y);
         x += roleWidth;
 
@@ -1466,10 +1615,6 @@ void KStandardItemListWidget::closeRoleEditor()
         scene()->views()[0]->parentWidget()->setFocus();
     }
 
-    if (m_oldRoleEditor) {
-        m_oldRoleEditor->deleteLater();
-    }
-    m_oldRoleEditor = m_roleEditor;
     m_roleEditor->hide();
     m_roleEditor = nullptr;
 }
@@ -1478,12 +1623,13 @@ QPixmap KStandardItemListWidget::pixmapForIcon(const QString& name, const QStrin
 {
     static const QIcon fallbackIcon = QIcon::fromTheme(QStringLiteral("unknown"));
 
-    size *= qApp->devicePixelRatio();
+    const qreal dpr = qApp->devicePixelRatio();
+    size *= dpr;
 
-    const QString key = "KStandardItemListWidget:" % name % ":" % overlays.join(QLatin1Char(':')) % ":" % QString::number(size) % ":" % QString::number(mode);
+    KIconPixmapCache& cache = KIconPixmapCache::instance();
     QPixmap pixmap;
 
-    if (!QPixmapCache::find(key, &pixmap)) {
+    if (!cache.find(name, overlays, size, mode, dpr, &pixmap)) {
         QIcon icon = QIcon::fromTheme(name);
         if (icon.isNull()) {
             icon = QIcon(name);
@@ -1528,13 +1674,55 @@ QPixmap KStandardItemListWidget::pixmapForIcon(const QString& name, const QStrin
             }
         }
 
-        QPixmapCache::insert(key, pixmap);
+        // The ratio is set before inserting, so that the cached pixmap is not
+        // detached when returning it. Otherwise the variants of the pixmap,
+        // which are identified by QPixmap::cacheKey(), could not be shared.
+        pixmap.setDevicePixelRatio(dpr);
+        cache.insert(name, overlays, size, mode, dpr, pixmap);
     }
-    pixmap.setDevicePixelRatio(qApp->devicePixelRatio());
 
     return pixmap;
 }
 
+QPixmap KStandardItemListWidget::pixmapWithEffects(const QPixmap& pixmap, quint32 effects) const
+{
+    const QColor selectionColor = palette().brush(QPalette::Normal, QPalette::Highlight).color();
+    const QRgb color = (effects & SelectedEffect) ? selectionColor.rgba() : 0;
+
+    KIconPixmapCache& cache = KIconPixmapCache::instance();
+    QPixmap result;
+    if (cache.findVariant(pixmap, effects, color, &result)) {
+        return result;
+    }
+
+    KIconEffect* effect = KIconLoader::global()->iconEffect();
+    result = pixmap;
+
+    if (effects & CutEffect) {
+        result = effect->apply(result, KIconLoader::Desktop, KIconLoader::DisabledState);
+    }
+
+    if (effects & HiddenEffect) {
+        KIconEffect::semiTransparent(result);
+    }
+
+    if (effects & SelectedEffect) {
+        QImage image = result.toImage();
+        if (image.isNull()) {
+            return QPixmap();
+        }
+        KIconEffect::colorize(image, selectionColor, 0.8f);
+        result = QPixmap::fromImage(image);
+    }
+
+    if (effects & HoverEffect) {
+        result = effect->apply(result, KIconLoader::Desktop, KIconLoader::ActiveState);
+    }
+
+    cache.insertVariant(pixmap, effects, color, result);
+    return result;
+}
+
 QSizeF KStandardItemListWidget::preferredRatingSize(const KItemListStyleOption& option)
 {
     const qreal height = option.fontMetrics.ascent();
@@ -12,10 +12,14 @@
 
 #include <QPixmap>
 #include <QPointF>
+#include <QPointer>
+#include <QSet>
 #include <QStaticText>
+#include <QUrl>
 
 class KItemListRoleEditor;
 class KItemListStyleOption;
+class KItemListTextLayoutCache;
 class KItemListView;
 
 class DOLPHIN_EXPORT KStandardItemListWidgetInformant : public KItemListWidgetInformant
@@ -24,11 +28,18 @@ public:
     KStandardItemListWidgetInformant();
     ~KStandardItemListWidgetInformant() override;
 
-    void calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const override;
+    void calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, int firstIndex, int lastIndex, const KItemListView* view) const override;
 
     qreal preferredRoleColumnWidth(const QByteArray& role,
                                            int index,
                                            const KItemListView* view) const override;
+
+    /**
+     * @return Cache for the layouted texts, which is shared by all
+     *         widgets that have been created for the same view.
+     */
+    KItemListTextLayoutCache* textLayoutCache() const;
+
 protected:
     /**
      * @return The value of the "text" role. The default implementation returns
@@ -59,11 +70,14 @@ protected:
     */
     virtual QFont customizedFontForLinks(const QFont& baseFont) const;
 
-    void calculateIconsLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const;
-    void calculateCompactLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const;
-    void calculateDetailsLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const;
+    void calculateIconsLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, int firstIndex, int lastIndex, const KItemListView* view) const;
+    void calculateCompactLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, int firstIndex, int lastIndex, const KItemListView* view) const;
+    void calculateDetailsLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, int firstIndex, int lastIndex, const KItemListView* view) const;
 
     friend class KStandardItemListWidget; // Accesses roleText()
+
+private:
+    KItemListTextLayoutCache* m_textLayoutCache;
 };
 
 /**
@@ -163,6 +177,7 @@ protected:
     void columnWidthChanged(const QByteArray& role, qreal current, qreal previous) override;
     void styleOptionChanged(const KItemListStyleOption& current, const KItemListStyleOption& previous) override;
     void hoveredChanged(bool hovered) override;
+    void hoverPositionChanged(const QPointF& pos) override;
     void selectedChanged(bool selected) override;
     void siblingsInformationChanged(const QBitArray& current, const QBitArray& previous) override;
     void editedRoleChanged(const QByteArray& current, const QByteArray& previous) override;
@@ -175,13 +190,15 @@ protected:
     {
         QPointF pos;
         QStaticText staticText;
+        // Width of the elided text
+        qreal width = 0;
     };
 
 public Q_SLOTS:
     void finishRoleEditing();
 
 private Q_SLOTS:
-    void slotCutItemsChanged();
+    void slotCutItemsChanged(const QSet<QUrl>& directories);
     void slotRoleEditingCanceled(const QByteArray& role, const QVariant& value);
     void slotRoleEditingFinished(const QByteArray& role, const QVariant& value);
 
@@ -190,10 +207,24 @@ private:
     void updateExpansionArea();
     void updatePixmapCache();
 
+    /**
+     * Selects the frame of the thumbnail sequence "iconSequence" that
+     * corresponds to the horizontal hover position above the icon, so that
+     * moving the mouse from the left to the right scrubs through the video.
+     */
+    void updateSequenceFrame();
+
     void updateTextsCache();
     void updateIconsLayoutTextCache();
     void updateCompactLayoutTextCache();
-    void updateDetailsLayoutTextCache();
+
+    /**
+     * Updates the texts of the details layout. If \a resizedColumnsOnly
+     * is true, only the texts of the columns in m_resizedColumns are elided
+     * again and the texts of the other columns are only moved.
+     */
+    void updateDetailsLayoutTextCache(bool resizedColumnsOnly = false);
+    void updateRatingCache();
 
     void updateAdditionalInfoTextColor();
 
@@ -204,6 +235,8 @@ private:
 
     QString elideRightKeepExtension(const QString &text, int elidingWidth) const;
 
+    KItemListTextLayoutCache* textLayoutCache() const;
+
     /**
      * Closes the role editor and returns the focus back
      * to the KItemListContainer.
@@ -212,6 +245,12 @@ private:
 
     static QPixmap pixmapForIcon(const QString& name, const QStringList& overlays, int size, QIcon::Mode mode);
 
+    /**
+     * @return \a pixmap with the icon effects \a effects applied, which are
+     *         taken from KIconPixmapCache if they have been applied already.
+     */
+    QPixmap pixmapWithEffects(const QPixmap& pixmap, quint32 effects) const;
+
     /**
      * @return Preferred size of the rating-image based on the given
      *         style-option. The height of the font is taken as
@@ -239,6 +278,10 @@ private:
     bool m_dirtyLayout;
     bool m_dirtyContent;
     QSet<QByteArray> m_dirtyContentRoles;
+    // True if only the columns of the details layout have been resized or
+    // moved. The texts of m_resizedColumns must be elided again.
+    bool m_dirtyColumns;
+    QSet<QByteArray> m_resizedColumns;
 
     Layout m_layout;
     QPointF m_pixmapPos;
@@ -260,8 +303,16 @@ private:
     QPixmap m_overlay;
     QPixmap m_rating;
 
-    KItemListRoleEditor* m_roleEditor;
-    KItemListRoleEditor* m_oldRoleEditor;
+    // Thumbnail sequence of the roles "iconSequence" and "iconSequenceFrames",
+    // and the frame that is shown instead of m_pixmap while hovering
+    QPixmap m_sequencePixmap;
+    int m_sequenceFrameCount;
+    int m_sequenceFrame;
+    QPixmap m_sequenceFramePixmap;
+    QPointF m_hoverPosition;
+
+    // Shared by all widgets of the view, see KItemListRoleEditor::sharedEditor()
+    QPointer<KItemListRoleEditor> m_roleEditor;
 
     friend class KStandardItemListWidgetInformant; // Accesses private static methods to be able to
                                                    // share a common layout calculation
@@ -11,7 +11,9 @@
 KStandardItemModel::KStandardItemModel(QObject* parent) :
     KItemModelBase(parent),
     m_items(),
-    m_indexesForItems()
+    m_indexesForItems(),
+    m_itemsForUrls(),
+    m_itemsForKeys()
 {
 }
 
@@ -20,6 +22,8 @@ KStandardItemModel::~KStandardItemModel()
     qDeleteAll(m_items);
     m_items.clear();
     m_indexesForItems.clear();
+    m_itemsForUrls.clear();
+    m_itemsForKeys.clear();
 }
 
 void KStandardItemModel::insertItem(int index, KStandardItem* item)
@@ -29,22 +33,45 @@ void KStandardItemModel::insertItem(int index, KStandardItem* item)
         return;
     }
 
-    if (!m_indexesForItems.contains(item)) {
-        item->m_model = this;
-        m_items.insert(index, item);
-        m_indexesForItems.insert(item, index);
+    insertItems(index, {item});
+}
 
-        // Inserting an item requires to update the indexes
-        // afterwards from m_indexesForItems.
-        for (int i = index + 1; i < m_items.count(); ++i) {
-            m_indexesForItems.insert(m_items[i], i);
+void KStandardItemModel::insertItems(int index, const QList<KStandardItem*>& items)
+{
+    if (index < 0 || index > count()) {
+        qDeleteAll(items);
+        return;
+    }
+
+    int insertedCount = 0;
+    for (KStandardItem* item : items) {
+        if (!item || m_indexesForItems.contains(item)) {
+            continue;
         }
 
-        // TODO: no hierarchical items are handled yet
+        item->m_model = this;
+        m_items.insert(index + insertedCount, item);
+        m_indexesForItems.insert(item, index + insertedCount);
+        addToLookupTables(item);
+        ++insertedCount;
+    }
 
-        onItemInserted(index);
-        Q_EMIT itemsInserted(KItemRangeList() << KItemRange(index, 1));
+    if (insertedCount == 0) {
+        return;
     }
+
+    // Inserting items requires to update the indexes
+    // afterwards from m_indexesForItems.
+    for (int i = index + insertedCount; i < m_items.count(); ++i) {
+        m_indexesForItems.insert(m_items[i], i);
+    }
+
+    // TODO: no hierarchical items are handled yet
+
+    for (int i = index; i < index + insertedCount; ++i) {
+        onItemInserted(i);
+    }
+    Q_EMIT itemsInserted(KItemRangeList() << KItemRange(index, insertedCount));
 }
 
 void KStandardItemModel::changeItem(int index, KStandardItem* item)
@@ -74,11 +101,13 @@ void KStandardItemModel::changeItem(int index, KStandardItem* item)
     }
 
     m_indexesForItems.remove(oldItem);
+    removeFromLookupTables(oldItem);
     delete oldItem;
     oldItem = nullptr;
 
     m_items[index] = item;
     m_indexesForItems.insert(item, index);
+    addToLookupTables(item);
 
     onItemChanged(index, changedRoles);
     Q_EMIT itemsChanged(KItemRangeList() << KItemRange(index, 1), changedRoles);
@@ -89,6 +118,7 @@ void KStandardItemModel::removeItem(int index)
     if (index >= 0 && index < count()) {
         KStandardItem* item = m_items[index];
         m_indexesForItems.remove(item);
+        removeFromLookupTables(item);
         m_items.removeAt(index);
 
         // Removing an item requires to update the indexes
@@ -113,6 +143,8 @@ void KStandardItemModel::clear()
     int size = m_items.size();
     m_items.clear();
     m_indexesForItems.clear();
+    m_itemsForUrls.clear();
+    m_itemsForKeys.clear();
 
     Q_EMIT itemsRemoved(KItemRangeList() << KItemRange(0, size));
 }
@@ -130,6 +162,23 @@ int KStandardItemModel::index(const KStandardItem* item) const
     return m_indexesForItems.value(item, -1);
 }
 
+int KStandardItemModel::indexForUrl(const QUrl& url) const
+{
+    int result = -1;
+    for (auto it = m_itemsForUrls.constFind(url); it != m_itemsForUrls.constEnd() && it.key() == url; ++it) {
+        const int itemIndex = index(it.value());
+        if (result < 0 || itemIndex < result) {
+            result = itemIndex;
+        }
+    }
+    return result;
+}
+
+KStandardItem* KStandardItemModel::itemForKey(const QString& key) const
+{
+    return key.isEmpty() ? nullptr : m_itemsForKeys.value(key);
+}
+
 void KStandardItemModel::appendItem(KStandardItem *item)
 {
     insertItem(m_items.count(), item);
@@ -206,6 +255,12 @@ QList<QPair<int, QVariant> > KStandardItemModel::groups() const
     return groups;
 }
 
+QString KStandardItemModel::itemKey(const KStandardItem* item) const
+{
+    Q_UNUSED(item)
+    return QString();
+}
+
 void KStandardItemModel::onItemInserted(int index)
 {
     Q_UNUSED(index)
@@ -223,3 +278,40 @@ void KStandardItemModel::onItemRemoved(int index, KStandardItem* removedItem)
     Q_UNUSED(removedItem)
 }
 
+void KStandardItemModel::addToLookupTables(KStandardItem* item)
+{
+    const QUrl url = item->dataValue("url").toUrl();
+    if (!url.isEmpty()) {
+        m_itemsForUrls.insert(url, item);
+    }
+
+    const QString key = itemKey(item);
+    if (!key.isEmpty()) {
+        m_itemsForKeys.insert(key, item);
+    }
+}
+
+void KStandardItemModel::removeFromLookupTables(KStandardItem* item)
+{
+    const QUrl url = item->dataValue("url").toUrl();
+    if (!url.isEmpty()) {
+        m_itemsForUrls.remove(url, item);
+    }
+
+    const QString key = itemKey(item);
+    if (!key.isEmpty() && m_itemsForKeys.value(key) == item) {
+        m_itemsForKeys.remove(key);
+    }
+}
+
+void KStandardItemModel::onItemUrlChanged(KStandardItem* item, const QUrl& previous)
+{
+    if (!previous.isEmpty()) {
+        m_itemsForUrls.remove(previous, item);
+    }
+
+    const QUrl url = item->dataValue("url").toUrl();
+    if (!url.isEmpty()) {
+        m_itemsForUrls.insert(url, item);
+    }
+}
@@ -12,6 +12,7 @@
 
 #include <QHash>
 #include <QList>
+#include <QUrl>
 
 class KStandardItem;
 
@@ -40,6 +41,15 @@ public:
      */
     void insertItem(int index, KStandardItem* item);
 
+    /**
+     * Inserts the items \a items at the index \a index. Compared to
+     * inserting the items one by one, the indexes of the following items
+     * are updated only once and only one itemsInserted() signal is emitted.
+     * KStandardItemModel takes the ownership of the items. If the index is
+     * invalid, the items get deleted.
+     */
+    void insertItems(int index, const QList<KStandardItem*>& items);
+
     /**
      * Changes the item on the index \a index to \a item.
      * KStandardItemModel takes the ownership of the item. The
@@ -52,6 +62,19 @@ public:
     KStandardItem* item(int index) const;
     int index(const KStandardItem* item) const;
 
+    /**
+     * @return Index of the first item whose "url" role is equal to \a url,
+     *         or -1 if there is no such item. The items are looked up by a
+     *         hash table, so no iteration over all items is necessary.
+     */
+    int indexForUrl(const QUrl& url) const;
+
+    /**
+     * @return Item whose key is equal to \a key (see itemKey()), or nullptr
+     *         if there is no such item.
+     */
+    KStandardItem* itemForKey(const QString& key) const;
+
     /**
      * Convenience method for insertItem(count(), item).
      */
@@ -68,6 +91,16 @@ public:
 
     virtual void clear();
 protected:
+    /**
+     * @return Key that identifies the item \a item uniquely, e.g. the
+     *         identifier of a bookmark. Allows to find the item by
+     *         itemForKey() without iterating over all items. The key of an
+     *         item must not change as long as the item is part of the model.
+     *         Items with an empty key cannot be found by itemForKey(). Per
+     *         default an empty key is returned.
+     */
+    virtual QString itemKey(const KStandardItem* item) const;
+
     /**
      * Is invoked after an item has been inserted and before the signal
      * itemsInserted() gets emitted.
@@ -88,9 +121,24 @@ protected:
      */
     virtual void onItemRemoved(int index, KStandardItem* removedItem);
 
+private:
+    /**
+     * Adds the item \a item to the lookup tables for indexForUrl() and itemForKey().
+     */
+    void addToLookupTables(KStandardItem* item);
+    void removeFromLookupTables(KStandardItem* item);
+
+    /**
+     * Is invoked by KStandardItem if the "url" role of the item \a item has
+     * been changed from \a previous.
+     */
+    void onItemUrlChanged(KStandardItem* item, const QUrl& previous);
+
 private:
     QList<KStandardItem*> m_items;
     QHash<const KStandardItem*, int> m_indexesForItems;
+    QMultiHash<QUrl, KStandardItem*> m_itemsForUrls;
+    QHash<QString, KStandardItem*> m_itemsForKeys;
 
     friend class KStandardItem;
     friend class KStandardItemModelTest;  // For unit testing
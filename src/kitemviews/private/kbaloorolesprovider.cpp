@@ -29,6 +29,9 @@ namespace {
         return alphabeticalOrderTags.join(QLatin1String(", "));
     }
 
+    // Maximum number of files whose role values are cached.
+    const int MaximumCachedFiles = 10000;
+
     using Property = KFileMetaData::Property::Property;
     // Mapping from the KFM::Property to the KFileItemModel roles.
     const QHash<Property, QByteArray> propertyRoleMap() {
@@ -154,7 +157,54 @@ QHash<QByteArray, QVariant> KBalooRolesProvider::roleValues(const Baloo::File& f
     return values;
 }
 
-KBalooRolesProvider::KBalooRolesProvider()
+QHash<QUrl, QHash<QByteArray, QVariant> > KBalooRolesProvider::roleValues(const KFileItemList& items,
+                                                                          const QSet<QByteArray>& roles)
+{
+    QHash<QUrl, QHash<QByteArray, QVariant> > itemsValues;
+    itemsValues.reserve(items.count());
+
+    for (const KFileItem& item : items) {
+        const QUrl url = item.url();
+        const QDateTime modificationTime = item.time(KFileItem::ModificationTime);
+
+        CacheEntry* entry = m_cache.object(url);
+        if (!entry || entry->modificationTime != modificationTime) {
+            Baloo::File file(item.localPath());
+            file.load();
+
+            entry = new CacheEntry{modificationTime, {}};
+            for (const QByteArray& role : qAsConst(m_roles)) {
+                // Overwrite all the role values with an empty QVariant, because the roles
+                // provider doesn't overwrite it when the property value list is empty.
+                // See bug 322348
+                entry->values.insert(role, QVariant());
+            }
+
+            QHashIterator<QByteArray, QVariant> it(roleValues(file, m_roles));
+            while (it.hasNext()) {
+                it.next();
+                entry->values.insert(it.key(), it.value());
+            }
+            m_cache.insert(url, entry);
+        }
+
+        QHash<QByteArray, QVariant>& values = itemsValues[url];
+        for (auto it = entry->values.constBegin(); it != entry->values.constEnd(); ++it) {
+            values.insert(it.key(), roles.contains(it.key()) ? it.value() : QVariant());
+        }
+    }
+
+    return itemsValues;
+}
+
+void KBalooRolesProvider::invalidate(const QUrl& url)
+{
+    m_cache.remove(url);
+}
+
+KBalooRolesProvider::KBalooRolesProvider() :
+    m_roles(),
+    m_cache(MaximumCachedFiles)
 {
     // Display roles filled from Baloo property cache
     for (const auto& role : propertyRoleMap()) {
@@ -10,8 +10,13 @@
 
 #include "dolphin_export.h"
 
+#include <KFileItem>
+
+#include <QCache>
+#include <QDateTime>
 #include <QHash>
 #include <QSet>
+#include <QUrl>
 #include <QVariant>
 
 namespace Baloo {
@@ -42,11 +47,35 @@ public:
     QHash<QByteArray, QVariant> roleValues(const Baloo::File& file,
                                            const QSet<QByteArray>& roles) const;
 
+    /**
+     * @return Values for the roles \a roles of the local files \a items, with
+     *         the URLs of the items as keys. Each role of roles() is contained,
+     *         roles without value have an invalid QVariant as value.
+     *
+     * The values are cached per URL and modification time, so that only the
+     * metadata of files that have not been loaded yet or that have been
+     * modified is read from Baloo.
+     */
+    QHash<QUrl, QHash<QByteArray, QVariant> > roleValues(const KFileItemList& items,
+                                                         const QSet<QByteArray>& roles);
+
+    /**
+     * Removes the cached values of the file with the URL \a url, e.g. because
+     * Baloo::FileMonitor reported that its metadata has been changed.
+     */
+    void invalidate(const QUrl& url);
+
 protected:
     KBalooRolesProvider();
 
 private:
+    struct CacheEntry {
+        QDateTime modificationTime;
+        QHash<QByteArray, QVariant> values; // Values for all roles of m_roles
+    };
+
     QSet<QByteArray> m_roles;
+    QCache<QUrl, CacheEntry> m_cache;
 
     friend struct KBalooRolesProviderSingleton;
 };
@@ -6,121 +6,297 @@
  */
 
 #include "kdirectorycontentscounter.h"
+#include "dolphin_generalsettings.h"
+#include "kiogovernor.h"
+#include "kitemlistmetrics.h"
 #include "kitemviews/kfileitemmodel.h"
+#include "kmemorybudget.h"
+#include "ktaskscheduler.h"
 
 #include <KDirWatch>
 
-#include <QFileInfo>
-#include <QDir>
-#include <QThread>
+#include <QCache>
+#include <QDateTime>
+#include <QElapsedTimer>
 
 namespace  {
-    /// cache of directory counting result
-    static QHash<QString, QPair<int, long>> *s_cache;
+    // Maximum number of directories of one filesystem that are
+    // counted at the same time.
+    const int MaximumWorkersPerDevice = 2;
+
+    // Maximum number of directories whose results are cached.
+    const int MaximumCacheEntries = 20000;
+
+    // Estimated memory in bytes of a cached result and of a cached identity,
+    // including the paths. They are only used for KMemoryBudget.
+    const int CacheEntryCost = 160;
+    const int PathIdentityCost = 256;
+
+    // Changes deep inside a directory don't affect its modification time.
+    // To show them eventually, a cached result is only reused for this time
+    // in ms without counting the directory again.
+    const qint64 CacheEntryLifetime = 10 * 60 * 1000;
+
+    struct CacheEntry {
+        int count;
+        qint64 size;
+        qint64 modificationTime; // Of the directory when it has been counted, in s
+        qint64 timestamp;        // When the entry has been inserted
+    };
+
+    typedef QCache<QString, CacheEntry> Cache;
+
+    struct PathIdentity {
+        QString resolvedPath;
+        quint64 device;
+        quint64 inode;
+    };
+
+    typedef QCache<QString, PathIdentity> PathCache;
+
+    QString parentPath(const QString& path)
+    {
+        const int slashIndex = path.lastIndexOf(QLatin1Char('/'));
+        return slashIndex > 0 ? path.left(slashIndex) : QStringLiteral("/");
+    }
+}
+
+/// Least recently used cache of the counting results, with the canonical paths as keys
+Q_GLOBAL_STATIC_WITH_ARGS(Cache, s_cache, (MaximumCacheEntries))
+
+/// Canonical paths and identities of the counted directories, with the requested paths
+/// as keys. They are resolved by the workers, as this might block on network filesystems.
+Q_GLOBAL_STATIC_WITH_ARGS(PathCache, s_resolvedPaths, (MaximumCacheEntries))
+
+namespace {
+    /**
+     * Removes the least recently used entries of \a cache until at
+     * least \a count entries have been removed.
+     */
+    template<typename T>
+    void trimCache(QCache<QString, T>& cache, int count)
+    {
+        const int maxCost = cache.maxCost();
+        cache.setMaxCost(qMax(0, cache.totalCost() - count));
+        cache.setMaxCost(maxCost);
+    }
+
+    /**
+     * Accounts the caches that are shared by all counters, see KMemoryBudget.
+     */
+    class CacheMemoryConsumer : public KMemoryBudget::Consumer
+    {
+    public:
+        QString memoryConsumerName() const override
+        {
+            return QStringLiteral("KDirectoryContentsCounter");
+        }
+
+        qint64 memoryUsage() const override
+        {
+            return qint64(s_cache->count()) * CacheEntryCost + qint64(s_resolvedPaths->count()) * PathIdentityCost;
+        }
+
+        qint64 releaseMemory(qint64 bytes) override
+        {
+            const qint64 previousUsage = memoryUsage();
+            const int count = int(qMin<qint64>(bytes / (CacheEntryCost + PathIdentityCost) + 1, MaximumCacheEntries));
+            trimCache(*s_cache, count);
+            trimCache(*s_resolvedPaths, count);
+            return previousUsage - memoryUsage();
+        }
+
+        ReleaseOrder releaseOrder() const override
+        {
+            // Counting the directories again is expensive
+            return ReleaseLast;
+        }
+    };
 }
 
+Q_GLOBAL_STATIC(CacheMemoryConsumer, s_cacheMemoryConsumer)
+
 KDirectoryContentsCounter::KDirectoryContentsCounter(KFileItemModel* model, QObject* parent) :
     QObject(parent),
     m_model(model),
-    m_queue(),
-    m_worker(nullptr),
-    m_workerIsBusy(false),
+    m_deviceQueues(),
+    m_queuedPaths(),
+    m_parentDevices(),
+    m_itemUrls(),
+    m_runningWorkers(),
     m_dirWatcher(nullptr),
-    m_watchedDirs()
+    m_watchedDirs(),
+    m_paused(false),
+    m_dirtyPaths()
 {
     connect(m_model, &KFileItemModel::itemsRemoved,
             this,    &KDirectoryContentsCounter::slotItemsRemoved);
 
-    if (!m_workerThread) {
-        m_workerThread = new QThread();
-        m_workerThread->start();
-    }
+    m_dirWatcher = new KDirWatch(this);
+    connect(m_dirWatcher, &KDirWatch::dirty, this, &KDirectoryContentsCounter::slotDirWatchDirty);
+
+    connect(&KIoGovernor::instance(), &KIoGovernor::released,
+            this, &KDirectoryContentsCounter::slotIoBudgetReleased);
 
-    if (s_cache == nullptr) {
-        s_cache = new QHash<QString, QPair<int, long>>();
+    // Registers the shared caches at KMemoryBudget
+    s_cacheMemoryConsumer();
+}
+
+KDirectoryContentsCounter::~KDirectoryContentsCounter()
+{
+    // The workers only operate on copies of the paths, so they may
+    // continue running. Their watchers are deleted as children.
+    // Their tokens are released, as nobody would release them later.
+    KIoGovernor& governor = KIoGovernor::instance();
+    disconnect(&governor, nullptr, this, nullptr);
+    for (const RunningWorker& worker : qAsConst(m_runningWorkers)) {
+        governor.release(KIoGovernor::DirectoryCounting, worker.path);
     }
 
-    m_worker = new KDirectoryContentsCounterWorker();
-    m_worker->moveToThread(m_workerThread);
+    KItemListMetrics::instance().add(KItemListMetrics::QueuedDirectories, -m_queuedPaths.count());
+}
 
-    connect(this,     &KDirectoryContentsCounter::requestDirectoryContentsCount,
-            m_worker, &KDirectoryContentsCounterWorker::countDirectoryContents);
-    connect(m_worker, &KDirectoryContentsCounterWorker::result,
-            this,     &KDirectoryContentsCounter::slotResult);
+void KDirectoryContentsCounter::scanDirectory(const KFileItem& item)
+{
+    const QString path = item.localPath();
+    if (path.isEmpty()) {
+        return;
+    }
 
-    m_dirWatcher = new KDirWatch(this);
-    connect(m_dirWatcher, &KDirWatch::dirty, this, &KDirectoryContentsCounter::slotDirWatchDirty);
+    if (!item.url().isLocalFile()) {
+        m_itemUrls.insert(path, item.url());
+    }
+    startWorker(path);
 }
 
-KDirectoryContentsCounter::~KDirectoryContentsCounter()
+int KDirectoryContentsCounter::index(const QString& path) const
 {
-    if (m_workerThread->isRunning()) {
-        // The worker thread will continue running. It could even be running
-        // a method of m_worker at the moment, so we delete it using
-        // deleteLater() to prevent a crash.
-        m_worker->deleteLater();
-    } else {
-        // There are no remaining workers -> stop the worker thread.
-        m_workerThread->quit();
-        m_workerThread->wait();
-        delete m_workerThread;
-        m_workerThread = nullptr;
+    const auto it = m_itemUrls.constFind(path);
+    return m_model->index(it != m_itemUrls.constEnd() ? *it : QUrl::fromLocalFile(path));
+}
 
-        // The worker thread has finished running now, so it's safe to delete
-        // m_worker. deleteLater() would not work at all because the event loop
-        // which would deliver the event to m_worker is not running any more.
-        delete m_worker;
+void KDirectoryContentsCounter::setPaused(bool paused)
+{
+    if (paused == m_paused) {
+        return;
     }
+
+    m_paused = paused;
+    if (paused) {
+        return;
+    }
+
+    const QSet<QString> dirtyPaths = m_dirtyPaths;
+    m_dirtyPaths.clear();
+    for (const QString& path : dirtyPaths) {
+        if (index(path) >= 0) {
+            startWorker(path);
+        }
+    }
+
+    // Continue with the directories that have been queued while being paused
+    slotIoBudgetReleased();
 }
 
-void KDirectoryContentsCounter::scanDirectory(const QString& path)
+bool KDirectoryContentsCounter::isPaused() const
 {
-    startWorker(path);
+    return m_paused;
 }
 
-void KDirectoryContentsCounter::slotResult(const QString& path, int count, long size)
+void KDirectoryContentsCounter::slotWorkerFinished()
 {
-    m_workerIsBusy = false;
+    auto watcher = static_cast<WorkerWatcher*>(sender());
+    const RunningWorker worker = m_runningWorkers.take(watcher);
+    const KDirectoryContentsCounterWorker::CountResult countResult = watcher->result();
+    watcher->deleteLater();
 
-    const QFileInfo info = QFileInfo(path);
-    const QString resolvedPath = info.canonicalFilePath();
+    --m_deviceQueues[worker.device].runningWorkers;
+    KIoGovernor::instance().release(KIoGovernor::DirectoryCounting, worker.path);
+    startWorkers(worker.device);
 
-    if (!m_dirWatcher->contains(resolvedPath)) {
-        m_dirWatcher->addDir(resolvedPath);
-        m_watchedDirs.insert(resolvedPath);
+    processResult(worker.path, countResult);
+}
+
+void KDirectoryContentsCounter::processResult(const QString& path, const KDirectoryContentsCounterWorker::CountResult& countResult)
+{
+    const int count = countResult.count;
+    const qint64 size = countResult.size;
+    const QString& resolvedPath = countResult.resolvedPath;
+    if (resolvedPath.isEmpty()) {
+        // The directory does not exist anymore
+        s_resolvedPaths->remove(path);
+        Q_EMIT result(path, count, size);
+        return;
     }
 
-    if (!m_priorityQueue.empty()) {
-        const QString firstPath = m_priorityQueue.front();
-        m_priorityQueue.pop_front();
-        startWorker(firstPath);
-    } else if (!m_queue.empty()) {
-        const QString firstPath = m_queue.front();
-        m_queue.pop_front();
-        startWorker(firstPath);
+    const PathIdentity* identity = s_resolvedPaths->object(path);
+    if (identity && (identity->resolvedPath != resolvedPath || identity->device != countResult.device
+                     || identity->inode != countResult.inode)) {
+        // The path refers to another directory than before, e.g. because the
+        // directory has been replaced or a symbolic link has been changed.
+        invalidateCache(identity->resolvedPath);
     }
+    s_resolvedPaths->insert(path, new PathIdentity{resolvedPath, countResult.device, countResult.inode});
+    m_parentDevices.insert(parentPath(path), countResult.device);
 
-    if (s_cache->contains(resolvedPath)) {
-        const auto pair = s_cache->value(resolvedPath);
-        if (pair.first == count && pair.second == size) {
-            // no change no need to send another result event
-            return;
-        }
+    watchDirectory(resolvedPath);
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    CacheEntry* entry = s_cache->object(resolvedPath);
+    if (entry && entry->count == count && entry->size == size) {
+        // no change no need to send another result event
+        entry->modificationTime = countResult.modificationTime;
+        entry->timestamp = now;
+        return;
     }
 
-    if (info.dir().path() == m_model->rootItem().url().path()) {
-        // update cache or overwrite value
-        // when path is a direct children of the current model root
-        s_cache->insert(resolvedPath, QPair<int, long>(count, size));
+    if (entry) {
+        // The cached results of the parent directories contain the old result.
+        invalidateCache(parentPath(resolvedPath));
+    }
+
+    // A size of -1 is not cached, as the recursive size has only been
+    // skipped because the mount was slow
+    if (count >= 0 && size >= 0) {
+        s_cache->insert(resolvedPath, new CacheEntry{count, size, countResult.modificationTime, now});
+    } else {
+        s_cache->remove(resolvedPath);
     }
 
     // sends the results
     Q_EMIT result(path, count, size);
 }
 
+void KDirectoryContentsCounter::watchDirectory(const QString& resolvedPath)
+{
+    if (!m_dirWatcher->contains(resolvedPath)) {
+        m_dirWatcher->addDir(resolvedPath);
+        m_watchedDirs.insert(resolvedPath);
+    }
+}
+
+void KDirectoryContentsCounter::invalidateCache(const QString& resolvedPath)
+{
+    QString path = resolvedPath;
+    while (!path.isEmpty()) {
+        s_cache->remove(path);
+
+        const int slashIndex = path.lastIndexOf(QLatin1Char('/'));
+        if (slashIndex < 0 || path == QLatin1String("/")) {
+            break;
+        }
+        // Keep the slash of the root directory.
+        path.truncate(slashIndex > 0 ? slashIndex : 1);
+    }
+}
+
 void KDirectoryContentsCounter::slotDirWatchDirty(const QString& path)
 {
-    const int index = m_model->index(QUrl::fromLocalFile(path));
+    // The size of a changed file or directory is part of the
+    // recursive size of all its parent directories.
+    invalidateCache(path);
+
+    const int index = this->index(path);
     if (index >= 0) {
         if (!m_model->fileItem(index).isDir()) {
             // If INotify is used, KDirWatch issues the dirty() signal
@@ -129,7 +305,11 @@ void KDirectoryContentsCounter::slotDirWatchDirty(const QString& path)
             return;
         }
 
-        startWorker(path);
+        if (m_paused) {
+            m_dirtyPaths.insert(path);
+        } else {
+            startWorker(path);
+        }
     }
 }
 
@@ -144,44 +324,129 @@ void KDirectoryContentsCounter::slotItemsRemoved()
                 m_dirWatcher->removeDir(path);
             }
             m_watchedDirs.clear();
-            m_queue.clear();
         } else {
             QMutableSetIterator<QString> it(m_watchedDirs);
             while (it.hasNext()) {
                 const QString& path = it.next();
-                if (m_model->index(QUrl::fromLocalFile(path)) < 0) {
+                if (index(path) < 0) {
                     m_dirWatcher->removeDir(path);
                     it.remove();
                 }
             }
         }
     }
+
+    if (allItemsRemoved) {
+        // Don't count directories that are not part of the model anymore
+        KItemListMetrics::instance().add(KItemListMetrics::QueuedDirectories, -m_queuedPaths.count());
+        m_queuedPaths.clear();
+        m_parentDevices.clear();
+        m_itemUrls.clear();
+        QMutableHashIterator<quint64, DeviceQueue> it(m_deviceQueues);
+        while (it.hasNext()) {
+            DeviceQueue& deviceQueue = it.next().value();
+            if (deviceQueue.runningWorkers > 0) {
+                deviceQueue.priorityQueue.clear();
+                deviceQueue.queue.clear();
+            } else {
+                it.remove();
+            }
+        }
+    }
+}
+
+void KDirectoryContentsCounter::slotIoBudgetReleased()
+{
+    // startWorkers() removes the queues that are done
+    const QList<quint64> devices = m_deviceQueues.keys();
+    for (quint64 device : devices) {
+        const DeviceQueue deviceQueue = m_deviceQueues.value(device);
+        if (deviceQueue.runningWorkers < MaximumWorkersPerDevice
+                && (!deviceQueue.priorityQueue.isEmpty() || !deviceQueue.queue.isEmpty())) {
+            startWorkers(device);
+        }
+    }
 }
 
 void KDirectoryContentsCounter::startWorker(const QString& path)
 {
-    const QString resolvedPath = QFileInfo(path).canonicalFilePath();
-    const bool alreadyInCache = s_cache->contains(resolvedPath);
+    // Only the identities that have been resolved by the workers are used,
+    // the filesystem is never accessed here.
+    const PathIdentity* cachedIdentity = s_resolvedPaths->object(path);
+    const PathIdentity identity = cachedIdentity ? *cachedIdentity : PathIdentity{QString(), 0, 0};
+    const CacheEntry* cachedEntry = identity.resolvedPath.isEmpty() ? nullptr : s_cache->object(identity.resolvedPath);
+    const bool alreadyInCache = (cachedEntry != nullptr);
     if (alreadyInCache) {
+        // Copy the entry, as the receivers of result() might change the cache.
+        const CacheEntry entry = *cachedEntry;
+
         // fast path when in cache
         // will be updated later if result has changed
-        const auto pair = s_cache->value(resolvedPath);
-        Q_EMIT result(path, pair.first, pair.second);
-    }
+        Q_EMIT result(path, entry.count, entry.size);
 
-    if (m_workerIsBusy) {
-        if (std::find(m_queue.begin(), m_queue.end(), path) == m_queue.end() &&
-            std::find(m_priorityQueue.begin(), m_priorityQueue.end(), path) == m_priorityQueue.end()) {
-            if (alreadyInCache) {
-                m_queue.push_back(path);
-            } else {
-                // append to priority queue
-                m_priorityQueue.push_back(path);
-            }
+        const bool upToDate = entry.modificationTime == modificationTime(path) &&
+                              QDateTime::currentMSecsSinceEpoch() - entry.timestamp < CacheEntryLifetime;
+        if (upToDate) {
+            watchDirectory(identity.resolvedPath);
+            return;
         }
+    }
+
+    if (m_queuedPaths.contains(path)) {
+        return;
+    }
+    m_queuedPaths.insert(path);
+    KItemListMetrics::instance().add(KItemListMetrics::QueuedDirectories);
+
+    // Directories that have not been counted yet are most likely on the
+    // same filesystem as their siblings.
+    const quint64 device = cachedIdentity ? identity.device : m_parentDevices.value(parentPath(path), 0);
+    DeviceQueue& deviceQueue = m_deviceQueues[device];
+    if (alreadyInCache) {
+        deviceQueue.queue.append(path);
     } else {
+        // append to priority queue
+        deviceQueue.priorityQueue.append(path);
+    }
+
+    startWorkers(device);
+}
+
+void KDirectoryContentsCounter::startWorkers(quint64 device)
+{
+    DeviceQueue& deviceQueue = m_deviceQueues[device];
+    KIoGovernor& governor = KIoGovernor::instance();
+
+    while (!m_paused && deviceQueue.runningWorkers < MaximumWorkersPerDevice) {
+        QStringList* queue = nullptr;
+        KTaskScheduler::Priority priority = KTaskScheduler::Visible;
+        if (!deviceQueue.priorityQueue.isEmpty()) {
+            queue = &deviceQueue.priorityQueue;
+        } else if (!deviceQueue.queue.isEmpty()) {
+            // The items are not visible
+            queue = &deviceQueue.queue;
+            priority = KTaskScheduler::Prefetch;
+        } else {
+            break;
+        }
+
+        const QString path = queue->first();
+        if (governor.acquire(KIoGovernor::DirectoryCounting, path) == 0) {
+            // Other views are counting on the same mount. The counting is
+            // continued in slotIoBudgetReleased().
+            break;
+        }
+        queue->removeFirst();
+        m_queuedPaths.remove(path);
+        KItemListMetrics::instance().add(KItemListMetrics::QueuedDirectories, -1);
+
         KDirectoryContentsCounterWorker::Options options;
 
+        if (governor.isSlow(path)) {
+            // The recursive size would saturate the mount
+            options |= KDirectoryContentsCounterWorker::SkipRecursiveSize;
+        }
+
         if (m_model->showHiddenFiles()) {
             options |= KDirectoryContentsCounterWorker::CountHiddenFiles;
         }
@@ -190,9 +455,38 @@ void KDirectoryContentsCounter::startWorker(const QString& path)
             options |= KDirectoryContentsCounterWorker::CountDirectoriesOnly;
         }
 
-        Q_EMIT requestDirectoryContentsCount(path, options);
-        m_workerIsBusy = true;
+        auto watcher = new WorkerWatcher(this);
+        connect(watcher, &WorkerWatcher::finished, this, &KDirectoryContentsCounter::slotWorkerFinished);
+        m_runningWorkers.insert(watcher, RunningWorker{path, device});
+        // The visible folders keep their class with a low priority, so that
+        // their counts are neither held back nor queued behind other work
+        const KTaskScheduler::ThreadPriority threadPriority = GeneralSettings::lowPriorityDirectorySizes() ? KTaskScheduler::LowThreadPriority
+                                                                                                           : KTaskScheduler::DefaultThreadPriority;
+        watcher->setFuture(KTaskScheduler::instance().run(priority, threadPriority, [path, options]() {
+            QElapsedTimer timer;
+            timer.start();
+            const KDirectoryContentsCounterWorker::CountResult result = KDirectoryContentsCounterWorker::subItemsCount(path, options);
+
+            KItemListMetrics& metrics = KItemListMetrics::instance();
+            metrics.add(KItemListMetrics::DirectoriesCounted);
+            metrics.add(KItemListMetrics::DirectoryCountNsecs, timer.nsecsElapsed());
+            return result;
+        }));
+        ++deviceQueue.runningWorkers;
+    }
+
+    if (deviceQueue.runningWorkers == 0 && deviceQueue.priorityQueue.isEmpty() && deviceQueue.queue.isEmpty()) {
+        m_deviceQueues.remove(device);
     }
 }
 
-QThread* KDirectoryContentsCounter::m_workerThread = nullptr;
+qint64 KDirectoryContentsCounter::modificationTime(const QString& path) const
+{
+    const int index = this->index(path);
+    if (index < 0) {
+        return -1;
+    }
+
+    const QDateTime time = m_model->fileItem(index).time(KFileItem::ModificationTime);
+    return time.isValid() ? time.toSecsSinceEpoch() : -1;
+}
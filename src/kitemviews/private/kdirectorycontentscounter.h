@@ -10,10 +10,14 @@
 
 #include "kdirectorycontentscounterworker.h"
 
-#include <QSet>
+#include <QFutureWatcher>
 #include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QUrl>
 
 class KDirWatch;
+class KFileItem;
 class KFileItemModel;
 class QString;
 
@@ -26,50 +30,122 @@ public:
     ~KDirectoryContentsCounter() override;
 
     /**
-     * Requests the number of items inside the directory \a path. The actual
+     * Requests the number of items inside the directory \a item. The actual
      * counting is done asynchronously, and the result is announced via the
-     * signal \a result.
+     * signal \a result with the local path of the item. Also items whose URL
+     * is not a local file URL, like the items of desktop:/, are counted by
+     * their local path.
      *
-     * The directory \a path is watched for changes, and the signal is emitted
+     * The directory is watched for changes, and the signal is emitted
      * again if a change occurs.
      *
-     * Uses a cache internally to speed up first result,
-     * but emit again result when the cache was updated
+     * Uses a cache that is shared by all counters to speed up the first
+     * result. If the modification time of the directory has not changed
+     * since the result has been cached, the directory is not counted
+     * again. Otherwise the result is emitted again when it has changed.
+     */
+    void scanDirectory(const KFileItem& item);
+
+    /**
+     * @return Index of the item with the local path \a path in the model,
+     *         or -1 if the model does not contain it.
+     */
+    int index(const QString& path) const;
+
+    /**
+     * If \a paused is true, no directories are counted, e.g. because the
+     * view is not visible. The directories that have been requested or
+     * that have been changed in the meantime are counted after the
+     * counting has been continued. Repeated changes of a directory
+     * result in only one counting.
      */
-    void scanDirectory(const QString& path);
+    void setPaused(bool paused);
+    bool isPaused() const;
 
 Q_SIGNALS:
     /**
      * Signals that the directory \a path contains \a count items of size \a
      * Size calculation depends on parameter DetailsModeSettings::recursiveDirectorySizeLimit
      */
-    void result(const QString& path, int count, long size);
-
-    void requestDirectoryContentsCount(const QString& path, KDirectoryContentsCounterWorker::Options options);
+    void result(const QString& path, int count, qint64 size);
 
 private Q_SLOTS:
-    void slotResult(const QString& path, int count, long size);
+    void slotWorkerFinished();
     void slotDirWatchDirty(const QString& path);
     void slotItemsRemoved();
+    void slotIoBudgetReleased();
 
 private:
+    typedef QFutureWatcher<KDirectoryContentsCounterWorker::CountResult> WorkerWatcher;
+
+    /**
+     * Queues the directory \a path for being counted. Directories which
+     * are not in the cache yet are counted first.
+     */
     void startWorker(const QString& path);
 
+    /**
+     * Starts counting the queued directories of the device \a device,
+     * as long as MaximumWorkersPerDevice is not exceeded and KIoGovernor
+     * grants a token for the directories.
+     */
+    void startWorkers(quint64 device);
+
+    void processResult(const QString& path, const KDirectoryContentsCounterWorker::CountResult& countResult);
+
+    void watchDirectory(const QString& resolvedPath);
+
+    /**
+     * Removes the cached results of \a resolvedPath and of all its parent
+     * directories, as their recursive sizes might have changed too.
+     */
+    static void invalidateCache(const QString& resolvedPath);
+
+    /**
+     * @return Modification time of the directory \a path in seconds since
+     *         the epoch as known by the model, or -1 if it is unknown.
+     *         The filesystem is not accessed.
+     */
+    qint64 modificationTime(const QString& path) const;
+
 private:
+    struct RunningWorker {
+        QString path;
+        quint64 device;
+    };
+
+    struct DeviceQueue {
+        DeviceQueue() : priorityQueue(), queue(), runningWorkers(0) {}
+
+        // Used as FIFO queues.
+        QStringList priorityQueue;
+        QStringList queue;
+        int runningWorkers;
+    };
+
     KFileItemModel* m_model;
 
-    // Used as FIFO queues.
-    std::list<QString> m_priorityQueue;
-    std::list<QString> m_queue;
+    // The queues are separated per filesystem, so that a slow network
+    // share cannot block the counting of directories on local disks.
+    QHash<quint64, DeviceQueue> m_deviceQueues;
+    QSet<QString> m_queuedPaths; // Paths in any queue of m_deviceQueues
+
+    // Filesystem of the last counted directory per parent directory. Used to queue
+    // the directories whose identity has not been resolved by a worker yet.
+    QHash<QString, quint64> m_parentDevices;
 
-    static QThread* m_workerThread;
+    // URLs of the requested items that are not local file URLs, e.g. of
+    // desktop:/, with their local paths as keys.
+    QHash<QString, QUrl> m_itemUrls;
 
-    KDirectoryContentsCounterWorker* m_worker;
-    bool m_workerIsBusy;
+    QHash<WorkerWatcher*, RunningWorker> m_runningWorkers;
 
     KDirWatch* m_dirWatcher;
     QSet<QString> m_watchedDirs;    // Required as sadly KDirWatch does not offer a getter method
                                     // to get all watched directories.
+
+    bool m_paused;
+    QSet<QString> m_dirtyPaths;     // Directories that have been changed while being paused
 };
 
 #endif
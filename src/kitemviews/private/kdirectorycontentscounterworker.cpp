@@ -6,13 +6,26 @@
  */
 
 #include "kdirectorycontentscounterworker.h"
+#include "kfilestatengine.h"
+#include "kiogovernor.h"
+
+#include <QElapsedTimer>
+#include <QFileInfo>
 
 // Required includes for subItemsCount():
 #ifdef Q_OS_WIN
+#include <QDateTime>
 #include <QDir>
 #else
 #include <QFile>
+#include <QPair>
+#include <QSet>
 #include <qplatformdefs.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 #include "dolphin_detailsmodesettings.h"
@@ -24,27 +37,53 @@ KDirectoryContentsCounterWorker::KDirectoryContentsCounterWorker(QObject* parent
 }
 
 #ifndef Q_OS_WIN
-KDirectoryContentsCounterWorker::CountResult walkDir(const QString &dirPath,
-                                                     const bool countHiddenFiles,
-                                                     const bool countDirectoriesOnly,
-                                                     QT_DIRENT *dirEntry,
-                                                     const uint allowedRecursiveLevel)
-{
-    int count = -1;
-    long size = -1;
-    auto dir = QT_OPENDIR(QFile::encodeName(dirPath));
-    if (dir) {
-        count = 0;
-        size = 0;
-        QT_STATBUF buf;
+namespace {
+    struct WalkOptions {
+        bool countHiddenFiles;
+        bool countDirectoriesOnly;
+        // Device and inode of the files with several hardlinks that have
+        // been counted already. Their size is only added once.
+        QSet<QPair<quint64, quint64> > hardLinks;
+    };
+
+    int openDirAt(int dirFd, const char* name)
+    {
+        return openat(dirFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    }
+
+    /**
+     * Counts the entries of the directory \a dirFd and sums up the sizes of
+     * the files inside up to \a allowedRecursiveLevel levels. The entries are
+     * accessed relative to the file descriptors of their directories, so no
+     * paths need to be built and resolved. Takes ownership of \a dirFd.
+     */
+    KDirectoryContentsCounterWorker::CountResult walkDir(int dirFd,
+                                                         WalkOptions& options,
+                                                         const uint allowedRecursiveLevel)
+    {
+        QT_DIR* dir = fdopendir(dirFd);
+        if (!dir) {
+            QT_CLOSE(dirFd);
+            return KDirectoryContentsCounterWorker::CountResult{-1, -1, QString(), 0, 0, -1};
+        }
+
+        int count = 0;
+        qint64 size = 0;
+
+        // The status of the entries that might be files is requested at once
+        // after reading the directory, the folders are walked afterwards.
+        QVector<QByteArray> statNames;
+        QVector<QByteArray> subDirNames;
 
+        QT_DIRENT* dirEntry;
         while ((dirEntry = QT_READDIR(dir))) {
-            if (dirEntry->d_name[0] == '.') {
-                if (dirEntry->d_name[1] == '\0' || !countHiddenFiles) {
+            const char* name = dirEntry->d_name;
+            if (name[0] == '.') {
+                if (name[1] == '\0' || !options.countHiddenFiles) {
                     // Skip "." or hidden files
                     continue;
                 }
-                if (dirEntry->d_name[1] == '.' && dirEntry->d_name[2] == '\0') {
+                if (name[1] == '.' && name[2] == '\0') {
                     // Skip ".."
                     continue;
                 }
@@ -53,7 +92,7 @@ KDirectoryContentsCounterWorker::CountResult walkDir(const QString &dirPath,
             // If only directories are counted, consider an unknown file type and links also
             // as directory instead of trying to do an expensive stat()
             // (see bugs 292642 and 299997).
-            const bool countEntry = !countDirectoriesOnly ||
+            const bool countEntry = !options.countDirectoriesOnly ||
                     dirEntry->d_type == DT_DIR ||
                     dirEntry->d_type == DT_LNK ||
                     dirEntry->d_type == DT_UNKNOWN;
@@ -61,29 +100,57 @@ KDirectoryContentsCounterWorker::CountResult walkDir(const QString &dirPath,
                 ++count;
             }
 
-            if (allowedRecursiveLevel > 0) {
+            if (allowedRecursiveLevel == 0) {
+                continue;
+            }
+
+            if (dirEntry->d_type == DT_DIR) {
+                subDirNames.append(QByteArray(name));
+            } else {
+                statNames.append(QByteArray(name));
+            }
+        }
 
-                bool linkFound = false;
-                QString nameBuf = QStringLiteral("%1/%2").arg(dirPath, dirEntry->d_name);
+        // Symbolic links are not followed: Their targets are either
+        // counted anyway or are not part of the directory. Network
+        // filesystems may use their cached attributes.
+        QVector<KFileStatEngine::Stat> fileStats;
+        const QVector<bool> found = KFileStatEngine::statBatch(dirfd(dir), statNames,
+                KFileStatEngine::NoFollowSymlinks | KFileStatEngine::DontSync | KFileStatEngine::BasicFieldsOnly, fileStats);
+        for (int i = 0; i < statNames.count(); ++i) {
+            if (!found.at(i)) {
+                continue;
+            }
+
+            const KFileStatEngine::Stat& fileStat = fileStats.at(i);
+            if (S_ISDIR(fileStat.mode)) {
+                subDirNames.append(statNames.at(i));
+                continue;
+            }
 
-                if (dirEntry->d_type == DT_REG || dirEntry->d_type == DT_LNK) {
-                    if (QT_STAT(nameBuf.toLocal8Bit(), &buf) == 0) {
-                        if (S_ISDIR(buf.st_mode)) {
-                            // was a dir link, recurse
-                            linkFound = true;
-                        }
-                        size += buf.st_size;
-                    }
+            if (fileStat.linkCount > 1) {
+                const QPair<quint64, quint64> id(fileStat.device, fileStat.inode);
+                if (options.hardLinks.contains(id)) {
+                    continue;
                 }
-                if (dirEntry->d_type == DT_DIR || linkFound) {
-                    // recursion for dirs and dir links
-                    size += walkDir(nameBuf, countHiddenFiles, countDirectoriesOnly, dirEntry, allowedRecursiveLevel - 1).size;
+                options.hardLinks.insert(id);
+            }
+            size += fileStat.size;
+        }
+
+        for (const QByteArray& name : qAsConst(subDirNames)) {
+            const int subDirFd = openDirAt(dirfd(dir), name.constData());
+            if (subDirFd >= 0) {
+                const qint64 subDirSize = walkDir(subDirFd, options, allowedRecursiveLevel - 1).size;
+                if (subDirSize > 0) {
+                    size += subDirSize;
                 }
             }
         }
         QT_CLOSEDIR(dir);
+
+        return KDirectoryContentsCounterWorker::CountResult{count, size, QString(), 0, 0, -1};
     }
-    return KDirectoryContentsCounterWorker::CountResult{count, size};
 }
 #endif
 
@@ -92,6 +159,11 @@ KDirectoryContentsCounterWorker::CountResult KDirectoryContentsCounterWorker::su
     const bool countHiddenFiles = options & CountHiddenFiles;
     const bool countDirectoriesOnly = options & CountDirectoriesOnly;
 
+    // Resolve the path before opening the directory, so that the
+    // identity is known even if the directory cannot be read.
+    const QFileInfo info(path);
+    const QString resolvedPath = info.canonicalFilePath();
+
 #ifdef Q_OS_WIN
     QDir dir(path);
     QDir::Filters filters = QDir::NoDotAndDotDot | QDir::System;
@@ -103,21 +175,44 @@ KDirectoryContentsCounterWorker::CountResult KDirectoryContentsCounterWorker::su
     } else {
         filters |= QDir::AllEntries;
     }
-    return {dir.entryList(filters).count(), 0};
+    return {dir.entryList(filters).count(), 0, resolvedPath, 0, 0, info.lastModified().toSecsSinceEpoch()};
 #else
 
-    const uint maxRecursiveLevel = DetailsModeSettings::directorySizeCount() ? 1 : DetailsModeSettings::recursiveDirectorySizeLimit();
+    const bool skipRecursiveSize = options & SkipRecursiveSize;
+    uint maxRecursiveLevel = DetailsModeSettings::directorySizeCount() ? 1 : DetailsModeSettings::recursiveDirectorySizeLimit();
+    if (skipRecursiveSize) {
+        maxRecursiveLevel = 0;
+    }
+
+    // Opening and reading the status of the directory are cheap operations,
+    // so their latency tells how slow the mount is.
+    QElapsedTimer timer;
+    timer.start();
 
-    QT_DIRENT *dirEntry = nullptr;
+    const int dirFd = QT_OPEN(QFile::encodeName(path), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        return CountResult{-1, -1, resolvedPath, 0, 0, -1};
+    }
 
-    auto res = walkDir(path, countHiddenFiles, countDirectoriesOnly, dirEntry, maxRecursiveLevel);
+    // The modification time is read before counting, so that changes
+    // while counting make the cached result outdated.
+    QT_STATBUF buf;
+    if (QT_FSTAT(dirFd, &buf) != 0) {
+        QT_CLOSE(dirFd);
+        return CountResult{-1, -1, resolvedPath, 0, 0, -1};
+    }
+    KIoGovernor::instance().reportLatency(path, timer.elapsed());
 
-    return res;
+    WalkOptions walkOptions{countHiddenFiles, countDirectoriesOnly, {}};
+    CountResult result = walkDir(dirFd, walkOptions, maxRecursiveLevel);
+    if (skipRecursiveSize && !DetailsModeSettings::directorySizeCount()) {
+        // The size is unknown, instead of being 0
+        result.size = -1;
+    }
+    result.resolvedPath = resolvedPath;
+    result.device = static_cast<quint64>(buf.st_dev);
+    result.inode = static_cast<quint64>(buf.st_ino);
+    result.modificationTime = static_cast<qint64>(buf.st_mtime);
+    return result;
 #endif
 }
-
-void KDirectoryContentsCounterWorker::countDirectoryContents(const QString& path, Options options)
-{
-    auto res = subItemsCount(path, options);
-    Q_EMIT result(path, res.count, res.size);
-}
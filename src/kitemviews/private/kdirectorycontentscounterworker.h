@@ -9,8 +9,7 @@
 
 #include <QMetaType>
 #include <QObject>
-
-class QString;
+#include <QString>
 
 class KDirectoryContentsCounterWorker : public QObject
 {
@@ -20,7 +19,8 @@ public:
     enum Option {
         NoOptions = 0x0,
         CountHiddenFiles = 0x1,
-        CountDirectoriesOnly = 0x2
+        CountDirectoriesOnly = 0x2,
+        SkipRecursiveSize = 0x4 // Only count the entries, e.g. on slow mounts
     };
     Q_DECLARE_FLAGS(Options, Option)
 
@@ -29,34 +29,27 @@ public:
         int count;
         /// Recursive sum of the size of the directory content files and folders
         /// Calculation depends on DetailsModeSettings::recursiveDirectorySizeLimit
-        long size;
+        qint64 size;
+        /// Canonical path of the directory, or an empty string if it cannot be resolved
+        QString resolvedPath;
+        /// Identifiers of the filesystem and of the inode of the directory
+        quint64 device;
+        quint64 inode;
+        /// Of the directory before it has been counted, in seconds since the epoch
+        qint64 modificationTime;
     };
 
     explicit KDirectoryContentsCounterWorker(QObject* parent = nullptr);
 
     /**
      * Counts the items inside the directory \a path using the options
-     * \a options.
+     * \a options. Resolving the canonical path and reading the status of
+     * the directory is done here as well, as both might block for a long
+     * time on network filesystems.
      *
-     * @return The number of items.
+     * @return The number of items and the identity of the directory.
      */
     static CountResult subItemsCount(const QString& path, Options options);
-
-Q_SIGNALS:
-    /**
-     * Signals that the directory \a path contains \a count items and optionally the size of its content.
-     */
-    void result(const QString& path, int count, long size);
-
-public Q_SLOTS:
-    /**
-     * Requests the number of items inside the directory \a path using the
-     * options \a options. The result is announced via the signal \a result.
-     */
-    // Note that the full type name KDirectoryContentsCounterWorker::Options
-    // is needed here. Just using 'Options' is OK for the compiler, but
-    // confuses moc.
-    void countDirectoryContents(const QString& path, KDirectoryContentsCounterWorker::Options options);
 };
 
 Q_DECLARE_METATYPE(KDirectoryContentsCounterWorker::Options)
@@ -0,0 +1,183 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kdirectoryprefetcher.h"
+
+#include <KCoreDirLister>
+#include <KMountPoint>
+
+#include <QScopedPointer>
+#include <QSet>
+#include <QTimer>
+
+namespace {
+    // Delay in ms before a prefetch is started, so that folders that are
+    // only crossed by the mouse are not listed.
+    const int PrefetchDelay = 300;
+
+    // Maximum number of URLs that wait for being prefetched
+    const int MaximumPendingUrls = 4;
+
+    // Time in ms during which prefetched items are considered to be valid
+    const int ListingLifetime = 60 * 1000;
+
+    // Maximum number of prefetched items that are kept
+    const int MaximumCachedItems = 50000;
+}
+
+struct KDirectoryPrefetcherSingleton
+{
+    KDirectoryPrefetcher instance;
+};
+Q_GLOBAL_STATIC(KDirectoryPrefetcherSingleton, s_directoryPrefetcher)
+
+
+KDirectoryPrefetcher& KDirectoryPrefetcher::instance()
+{
+    return s_directoryPrefetcher->instance;
+}
+
+KDirectoryPrefetcher::~KDirectoryPrefetcher()
+{
+}
+
+void KDirectoryPrefetcher::prefetch(const QUrl& url)
+{
+    const QUrl dirUrl = url.adjusted(QUrl::StripTrailingSlash);
+    if (!dirUrl.isValid() || m_pendingUrls.contains(dirUrl)) {
+        return;
+    }
+
+    const Listing* listing = m_listings.object(dirUrl);
+    if (listing && !listing->age.hasExpired(ListingLifetime)) {
+        return;
+    }
+
+    for (const KCoreDirLister* lister : qAsConst(m_runningListers)) {
+        if (lister->url() == dirUrl) {
+            return;
+        }
+    }
+
+    m_pendingUrls.append(dirUrl);
+    if (m_pendingUrls.count() > MaximumPendingUrls) {
+        m_pendingUrls.removeFirst();
+    }
+    m_startTimer->start();
+}
+
+void KDirectoryPrefetcher::cancel(const QUrl& url)
+{
+    const QUrl dirUrl = url.adjusted(QUrl::StripTrailingSlash);
+    m_pendingUrls.removeAll(dirUrl);
+
+    const QList<KCoreDirLister*> listers = m_runningListers.values();
+    for (KCoreDirLister* lister : listers) {
+        if (lister->url() == dirUrl) {
+            // Other listers of the directory, like the one of a view that
+            // has opened it meanwhile, keep receiving the items.
+            removeLister(lister);
+            startPendingListings();
+            return;
+        }
+    }
+}
+
+bool KDirectoryPrefetcher::takeListing(const QUrl& url, KFileItemList& items)
+{
+    QScopedPointer<Listing> listing(m_listings.take(url.adjusted(QUrl::StripTrailingSlash)));
+    if (!listing || listing->age.hasExpired(ListingLifetime)) {
+        return false;
+    }
+
+    items = listing->items;
+    return true;
+}
+
+KDirectoryPrefetcher::KDirectoryPrefetcher() :
+    QObject(nullptr),
+    m_startTimer(nullptr),
+    m_pendingUrls(),
+    m_runningListers(),
+    m_listings(MaximumCachedItems)
+{
+    m_startTimer = new QTimer(this);
+    m_startTimer->setSingleShot(true);
+    m_startTimer->setInterval(PrefetchDelay);
+    connect(m_startTimer, &QTimer::timeout, this, &KDirectoryPrefetcher::startPendingListings);
+}
+
+void KDirectoryPrefetcher::startPendingListings()
+{
+    // The most recently requested URLs are preferred. Only the
+    // newest URL of each mount is kept.
+    QVector<QUrl> pendingUrls;
+    QSet<QString> pendingMounts;
+    for (int i = m_pendingUrls.count() - 1; i >= 0; --i) {
+        const QUrl& url = m_pendingUrls.at(i);
+        const QString key = mountKey(url);
+        if (pendingMounts.contains(key)) {
+            continue;
+        }
+        pendingMounts.insert(key);
+
+        if (m_runningListers.contains(key)) {
+            pendingUrls.prepend(url);
+            continue;
+        }
+
+        KCoreDirLister* lister = new KCoreDirLister(this);
+        lister->setAutoUpdate(false);
+        lister->setShowingDotFiles(true);
+        lister->setDelayedMimeTypes(true);
+        connect(lister, QOverload<>::of(&KCoreDirLister::completed), this, [this, lister]() {
+            slotListingFinished(lister, true);
+        });
+        connect(lister, QOverload<>::of(&KCoreDirLister::canceled), this, [this, lister]() {
+            slotListingFinished(lister, false);
+        });
+
+        m_runningListers.insert(key, lister);
+        lister->openUrl(url);
+    }
+
+    m_pendingUrls = pendingUrls;
+}
+
+void KDirectoryPrefetcher::slotListingFinished(KCoreDirLister* lister, bool completed)
+{
+    if (completed) {
+        Listing* listing = new Listing();
+        listing->items = lister->items(KCoreDirLister::AllItems);
+        listing->age.start();
+        m_listings.insert(lister->url(), listing, qMax(1, listing->items.count()));
+    }
+
+    removeLister(lister);
+    startPendingListings();
+}
+
+void KDirectoryPrefetcher::removeLister(KCoreDirLister* lister)
+{
+    disconnect(lister, nullptr, this, nullptr);
+    m_runningListers.remove(m_runningListers.key(lister));
+    lister->stop();
+
+    // The lister might emit the signal that is handled currently
+    lister->deleteLater();
+}
+
+QString KDirectoryPrefetcher::mountKey(const QUrl& url)
+{
+    if (url.isLocalFile()) {
+        const KMountPoint::Ptr mountPoint = KMountPoint::currentMountPoints().findByPath(url.toLocalFile());
+        if (mountPoint) {
+            return mountPoint->mountPoint();
+        }
+    }
+
+    return url.scheme() + QLatin1String("://") + url.authority();
+}
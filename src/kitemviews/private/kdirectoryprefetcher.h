@@ -0,0 +1,98 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KDIRECTORYPREFETCHER_H
+#define KDIRECTORYPREFETCHER_H
+
+#include "dolphin_export.h"
+
+#include <KFileItem>
+
+#include <QCache>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QUrl>
+#include <QVector>
+
+class KCoreDirLister;
+class QTimer;
+
+/**
+ * @brief Lists directories speculatively before they are opened.
+ *
+ * Is shared by all instances of KFileItemModel, so that a folder that is
+ * hovered in the Folders panel can be shown at once in the view. A
+ * prefetch is started after a short delay, and at most one directory per
+ * mount is listed at the same time, so that sweeping the mouse over many
+ * folders does not flood a slow network share with listings. The listed
+ * items are kept for a limited time and are taken by
+ * KFileItemModel::loadDirectory() like a snapshot of the directory.
+ */
+class DOLPHIN_EXPORT KDirectoryPrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    static KDirectoryPrefetcher& instance();
+    ~KDirectoryPrefetcher() override;
+
+    /**
+     * Schedules listing the directory \a url. If another directory
+     * of the same mount is waiting to be listed, it is replaced
+     * by \a url.
+     */
+    void prefetch(const QUrl& url);
+
+    /**
+     * Cancels the prefetching of \a url if it has not been finished yet.
+     * Items that have been prefetched already are kept.
+     */
+    void cancel(const QUrl& url);
+
+    /**
+     * Removes the recently prefetched items of the directory \a url
+     * from the cache and returns them in \a items. The items contain
+     * hidden files.
+     * @return True if prefetched items of \a url have been available.
+     */
+    bool takeListing(const QUrl& url, KFileItemList& items);
+
+protected:
+    KDirectoryPrefetcher();
+
+private:
+    /**
+     * Starts the listings of the pending URLs whose mount is not
+     * being listed already.
+     */
+    void startPendingListings();
+
+    void slotListingFinished(KCoreDirLister* lister, bool completed);
+    void removeLister(KCoreDirLister* lister);
+
+    /**
+     * @return Identifier of the mount of \a url, which
+     *         is used to limit the listings per mount.
+     */
+    static QString mountKey(const QUrl& url);
+
+private:
+    struct Listing
+    {
+        KFileItemList items;
+        QElapsedTimer age;
+    };
+
+    QTimer* m_startTimer;
+    QVector<QUrl> m_pendingUrls;
+    QHash<QString, KCoreDirLister*> m_runningListers; // The keys are the mount keys
+    QCache<QUrl, Listing> m_listings;                  // The cost is the number of items
+
+    friend struct KDirectoryPrefetcherSingleton;
+};
+
+#endif
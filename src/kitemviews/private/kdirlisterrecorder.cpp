@@ -0,0 +1,209 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kdirlisterrecorder.h"
+
+#include <kio_version.h>
+#include <KCoreDirLister>
+
+#include <QAtomicInt>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+    // Number of recordings that have been started by this process
+    QAtomicInt s_recordingCount;
+
+    const QLatin1String TypeNames[] = {
+        QLatin1String("itemsAdded"),
+        QLatin1String("itemsDeleted"),
+        QLatin1String("refreshItems"),
+        QLatin1String("completed"),
+        QLatin1String("clear")
+    };
+
+    QJsonObject itemToJson(const KFileItem& item)
+    {
+        // The fields are stored with the numbers of KIO::UDSEntry::StandardFieldTypes.
+        // JSON numbers are doubles, so the numbers of the fields are stored as
+        // strings to keep the precision of e.g. large sizes or inode numbers.
+        QJsonObject fields;
+        const KIO::UDSEntry entry = item.entry();
+        const QVector<uint> fieldNumbers = entry.fields();
+        for (const uint field : fieldNumbers) {
+            if (field & KIO::UDSEntry::UDS_NUMBER) {
+                fields.insert(QString::number(field), QString::number(entry.numberValue(field)));
+            } else {
+                fields.insert(QString::number(field), entry.stringValue(field));
+            }
+        }
+
+        QJsonObject object;
+        object.insert(QLatin1String("url"), item.url().toString());
+        object.insert(QLatin1String("entry"), fields);
+        return object;
+    }
+
+    KFileItem itemFromJson(const QJsonObject& object)
+    {
+        const QJsonObject fields = object.value(QLatin1String("entry")).toObject();
+        KIO::UDSEntry entry;
+        entry.reserve(fields.count());
+        for (auto it = fields.constBegin(); it != fields.constEnd(); ++it) {
+            const uint field = it.key().toUInt();
+            if (field & KIO::UDSEntry::UDS_NUMBER) {
+                // Older recordings contain the numbers as doubles
+                const QJsonValue value = it.value();
+                entry.fastInsert(field, value.isString() ? value.toString().toLongLong() : qint64(value.toDouble()));
+            } else {
+                entry.fastInsert(field, it.value().toString());
+            }
+        }
+
+        // The URL of the item is passed, so that the entry does not need to
+        // contain the name of the item
+        return KFileItem(entry, QUrl(object.value(QLatin1String("url")).toString()), true);
+    }
+
+    QJsonArray itemsToJson(const KFileItemList& items)
+    {
+        QJsonArray array;
+        for (const KFileItem& item : items) {
+            array.append(itemToJson(item));
+        }
+        return array;
+    }
+
+    KFileItemList itemsFromJson(const QJsonArray& array)
+    {
+        KFileItemList items;
+        items.reserve(array.count());
+        for (const QJsonValue& value : array) {
+            items.append(itemFromJson(value.toObject()));
+        }
+        return items;
+    }
+}
+
+KDirListerRecorder::KDirListerRecorder(KCoreDirLister* dirLister, const QString& filePath) :
+    QObject(dirLister),
+    m_file(filePath),
+    m_timer()
+{
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return;
+    }
+    m_timer.start();
+
+    connect(dirLister, &KCoreDirLister::itemsAdded, this, [this](const QUrl& url, const KFileItemList& items) {
+        writeEvent({m_timer.elapsed(), Event::ItemsAdded, url, items, {}});
+    });
+    connect(dirLister, &KCoreDirLister::itemsDeleted, this, [this](const KFileItemList& items) {
+        writeEvent({m_timer.elapsed(), Event::ItemsDeleted, QUrl(), items, {}});
+    });
+    connect(dirLister, &KCoreDirLister::refreshItems, this, [this](const QList<QPair<KFileItem, KFileItem> >& items) {
+        writeEvent({m_timer.elapsed(), Event::RefreshItems, QUrl(), {}, items});
+    });
+#if KIO_VERSION < QT_VERSION_CHECK(5, 79, 0)
+    connect(dirLister, QOverload<const QUrl&>::of(&KCoreDirLister::completed), this, [this](const QUrl& url) {
+#else
+    connect(dirLister, &KCoreDirLister::listingDirCompleted, this, [this](const QUrl& url) {
+#endif
+        writeEvent({m_timer.elapsed(), Event::Completed, url, {}, {}});
+    });
+    connect(dirLister, QOverload<>::of(&KCoreDirLister::clear), this, [this]() {
+        writeEvent({m_timer.elapsed(), Event::Clear, QUrl(), {}, {}});
+    });
+}
+
+KDirListerRecorder::~KDirListerRecorder()
+{
+}
+
+bool KDirListerRecorder::isRecording() const
+{
+    return m_file.isOpen();
+}
+
+QString KDirListerRecorder::nextRecordingFilePath()
+{
+    static const QString prefix = qEnvironmentVariable("DOLPHIN_DIRLISTER_RECORDING");
+    if (prefix.isEmpty()) {
+        return QString();
+    }
+
+    return prefix + QLatin1Char('-') + QString::number(s_recordingCount.fetchAndAddRelaxed(1) + 1) + QLatin1String(".jsonl");
+}
+
+bool KDirListerRecorder::readEvents(const QString& filePath, QVector<Event>& events)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    events.clear();
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        const QJsonObject object = QJsonDocument::fromJson(line).object();
+        const QString typeName = object.value(QLatin1String("type")).toString();
+        const auto type = std::find(std::begin(TypeNames), std::end(TypeNames), typeName);
+        if (type == std::end(TypeNames)) {
+            return false;
+        }
+
+        Event event;
+        event.time = qint64(object.value(QLatin1String("time")).toDouble());
+        event.type = static_cast<Event::Type>(type - std::begin(TypeNames));
+        event.url = QUrl(object.value(QLatin1String("url")).toString());
+        event.items = itemsFromJson(object.value(QLatin1String("items")).toArray());
+
+        const QJsonArray refreshedItems = object.value(QLatin1String("refreshedItems")).toArray();
+        for (const QJsonValue& value : refreshedItems) {
+            const QJsonArray pair = value.toArray();
+            event.refreshedItems.append(qMakePair(itemFromJson(pair.at(0).toObject()),
+                                                  itemFromJson(pair.at(1).toObject())));
+        }
+
+        events.append(event);
+    }
+
+    return true;
+}
+
+void KDirListerRecorder::writeEvent(const Event& event)
+{
+    QJsonObject object;
+    object.insert(QLatin1String("time"), double(event.time));
+    object.insert(QLatin1String("type"), TypeNames[event.type]);
+    if (!event.url.isEmpty()) {
+        object.insert(QLatin1String("url"), event.url.toString());
+    }
+    if (!event.items.isEmpty()) {
+        object.insert(QLatin1String("items"), itemsToJson(event.items));
+    }
+    if (!event.refreshedItems.isEmpty()) {
+        QJsonArray refreshedItems;
+        for (const auto& pair : event.refreshedItems) {
+            refreshedItems.append(QJsonArray({itemToJson(pair.first), itemToJson(pair.second)}));
+        }
+        object.insert(QLatin1String("refreshedItems"), refreshedItems);
+    }
+
+    m_file.write(QJsonDocument(object).toJson(QJsonDocument::Compact));
+    m_file.write("\n");
+
+    // The session may not end regularly if the recording is needed
+    m_file.flush();
+}
@@ -0,0 +1,97 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KDIRLISTERRECORDER_H
+#define KDIRLISTERRECORDER_H
+
+#include "dolphin_export.h"
+
+#include <KFileItem>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QUrl>
+#include <QVector>
+
+class KCoreDirLister;
+
+/**
+ * @brief Records the signals of a directory lister to a file.
+ *
+ * Changes with a high churn, like a compiler rewriting thousands of object
+ * files, are hard to reproduce with real files in tests. If the environment
+ * variable DOLPHIN_DIRLISTER_RECORDING is set to a path prefix, each
+ * KFileItemModel records the signals itemsAdded(), itemsDeleted(),
+ * refreshItems(), the completion of the listings and clear() of its
+ * directory lister. The recording of the n-th model is written to the file
+ * "<prefix>-<n>.jsonl", which contains one JSON object per signal with the
+ * time in ms since the recording has been started and the UDS entries of
+ * the items.
+ *
+ * The recordings can be read with readEvents() and be replayed against
+ * KFileItemModel and KFileItemModelRolesUpdater by
+ * kfileitemmodelreplaybenchmark.
+ */
+class DOLPHIN_EXPORT KDirListerRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Event
+    {
+        enum Type {
+            ItemsAdded,
+            ItemsDeleted,
+            RefreshItems,
+            Completed,
+            Clear
+        };
+
+        qint64 time;    // Milliseconds since the recording has been started
+        Type type;
+        QUrl url;       // Directory of ItemsAdded and Completed
+        KFileItemList items;    // Items of ItemsAdded and ItemsDeleted
+        QList<QPair<KFileItem, KFileItem> > refreshedItems;
+    };
+
+    /**
+     * Records the signals of \a dirLister to the file \a filePath, which is
+     * overwritten. Nothing is recorded if the file cannot be opened.
+     */
+    KDirListerRecorder(KCoreDirLister* dirLister, const QString& filePath);
+    ~KDirListerRecorder() override;
+
+    /**
+     * @return True if the file could be opened for the recording.
+     */
+    bool isRecording() const;
+
+    /**
+     * @return Path of the file for the next recording if the recording is
+     *         enabled by the environment variable DOLPHIN_DIRLISTER_RECORDING,
+     *         otherwise an empty string.
+     */
+    static QString nextRecordingFilePath();
+
+    /**
+     * Reads the events of the recording \a filePath into \a events.
+     *
+     * @return False if the file cannot be read or contains invalid events.
+     */
+    static bool readEvents(const QString& filePath, QVector<Event>& events);
+
+private:
+    void writeEvent(const Event& event);
+
+private:
+    QFile m_file;
+    QElapsedTimer m_timer;
+};
+
+#endif
@@ -0,0 +1,620 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kfilecontentsearcher.h"
+#include "dolphin_generalsettings.h"
+
+#include "kfilenamesearchindex.h"
+#include "ktaskscheduler.h"
+
+#include <QFile>
+#include <QRegularExpression>
+#include <QThread>
+#include <QUrlQuery>
+#include <QtAlgorithms>
+
+#include <cerrno>
+#include <cstring>
+
+#ifndef Q_OS_WIN
+#include <qplatformdefs.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // Number of files that are known before a folder reading task returns
+    const int CrawlBatchSize = 2000;
+
+    // Number of files whose content is scanned by one task
+    const int ScanBatchSize = 100;
+
+    // Number of bytes that are read at once. The files are not memory-mapped,
+    // as a mapped file that is truncated meanwhile or whose network mount
+    // fails raises SIGBUS instead of a read error.
+    const qint64 ReadChunkSize = 256 * 1024;
+
+    // Files that contain a null byte within the first bytes are treated
+    // as binary files, like git does
+    const qint64 BinaryCheckSize = 8000;
+
+    // Characters of regular expressions and wildcard patterns, which are
+    // left to the KIO worker
+    const QLatin1String PatternCharacters("^$()+|\\{}*?[]");
+
+    int maximumRunningScans()
+    {
+        return qMax(2, QThread::idealThreadCount());
+    }
+
+    inline bool isLowerAsciiLetter(char c)
+    {
+        return c >= 'a' && c <= 'z';
+    }
+
+    /**
+     * @return True if \a data starts with \a needle, whose ASCII
+     *         letters are lower case.
+     */
+    inline bool startsWithFolded(const char* data, const QByteArray& needle)
+    {
+        for (int i = 0; i < needle.size(); ++i) {
+            const char n = needle.at(i);
+            const char c = isLowerAsciiLetter(n) ? char(data[i] | 0x20) : data[i];
+            if (c != n) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @return True if \a data contains \a needle, whose ASCII letters
+     *         are lower case. Setting the bit 0x20 folds upper case
+     *         ASCII letters to lower case. It changes some other
+     *         characters as well, but only the first and last byte are
+     *         compared this way before the candidate is verified.
+     */
+    bool containsFolded(const char* data, qint64 size, const QByteArray& needle)
+    {
+        const qint64 length = needle.size();
+        if (length == 0 || size < length) {
+            return false;
+        }
+
+        const char first = needle.at(0);
+        const char last = needle.at(length - 1);
+        const char firstFold = isLowerAsciiLetter(first) ? 0x20 : 0;
+        const char lastFold = isLowerAsciiLetter(last) ? 0x20 : 0;
+
+        qint64 i = 0;
+#ifdef __SSE2__
+        // Compares the first and last byte of the needle at 16 positions at once
+        const __m128i firstBytes = _mm_set1_epi8(first);
+        const __m128i lastBytes = _mm_set1_epi8(last);
+        const __m128i firstFoldBytes = _mm_set1_epi8(firstFold);
+        const __m128i lastFoldBytes = _mm_set1_epi8(lastFold);
+        for (; i + length - 1 + 16 <= size; i += 16) {
+            const __m128i a = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), firstFoldBytes);
+            const __m128i b = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + length - 1)), lastFoldBytes);
+            uint mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, firstBytes), _mm_cmpeq_epi8(b, lastBytes)));
+            while (mask != 0) {
+                if (startsWithFolded(data + i + qCountTrailingZeroBits(mask), needle)) {
+                    return true;
+                }
+                mask &= mask - 1;
+            }
+        }
+#endif
+
+        for (; i + length <= size; ++i) {
+            if (char(data[i] | firstFold) == first && startsWithFolded(data + i, needle)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool isBinary(const char* data, qint64 size)
+    {
+        return std::memchr(data, 0, qMin(size, BinaryCheckSize)) != nullptr;
+    }
+
+    /**
+     * @return Regular expression for the pattern \a pattern of a .gitignore
+     *         file. Like git, "*" and "?" don't match a slash, while "**"
+     *         between slashes matches any number of folders.
+     */
+    QString gitPatternToRegularExpression(const QString& pattern)
+    {
+        QString expression;
+        expression.reserve(pattern.length() * 2);
+        for (int i = 0; i < pattern.length(); ++i) {
+            const QChar c = pattern.at(i);
+            if (pattern.midRef(i, 3) == QLatin1String("**/") && (i == 0 || pattern.at(i - 1) == QLatin1Char('/'))) {
+                expression += QLatin1String("(?:.*/)?");
+                i += 2;
+            } else if (pattern.midRef(i) == QLatin1String("**") && i > 0 && pattern.at(i - 1) == QLatin1Char('/')) {
+                expression += QLatin1String(".*");
+                break;
+            } else if (c == QLatin1Char('*')) {
+                expression += QLatin1String("[^/]*");
+            } else if (c == QLatin1Char('?')) {
+                expression += QLatin1String("[^/]");
+            } else if (c == QLatin1Char('[')) {
+                const int end = pattern.indexOf(QLatin1Char(']'), i + 2);
+                if (end < 0) {
+                    expression += QLatin1String("\\[");
+                    continue;
+                }
+                QString characters = pattern.mid(i + 1, end - i - 1);
+                if (characters.startsWith(QLatin1Char('!'))) {
+                    characters[0] = QLatin1Char('^');
+                }
+                expression += QLatin1Char('[') + characters.replace(QLatin1Char('\\'), QLatin1String("\\\\")) + QLatin1Char(']');
+                i = end;
+            } else if (c == QLatin1Char('\\') && i + 1 < pattern.length()) {
+                expression += QRegularExpression::escape(pattern.at(++i));
+            } else {
+                expression += QRegularExpression::escape(c);
+            }
+        }
+        return QRegularExpression::anchoredPattern(expression);
+    }
+}
+
+struct KFileContentSearcher::IgnoreList
+{
+    struct Rule
+    {
+        QRegularExpression expression;
+        bool negated = false;
+        bool directoryOnly = false;
+        bool matchesPath = false;   // Matches the path relative to the folder instead of the name
+    };
+
+    QString path;
+    QVector<Rule> rules;
+    IgnoreListPointer parent;
+};
+
+KFileContentSearcher::KFileContentSearcher(QObject* parent) :
+    QObject(parent),
+    m_searches()
+{
+}
+
+KFileContentSearcher::~KFileContentSearcher()
+{
+    // The running tasks only work on copies of the paths, so there is no need
+    // to wait for them. The watchers are deleted as children of this object.
+    cancelAll();
+}
+
+bool KFileContentSearcher::isSupported(const QUrl& searchUrl)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(searchUrl)
+    return false;
+#else
+    if (searchUrl.scheme() != QLatin1String("filenamesearch")) {
+        return false;
+    }
+
+    const QUrlQuery query(searchUrl);
+    if (query.queryItemValue(QStringLiteral("checkContent")) != QLatin1String("yes")) {
+        return false;
+    }
+
+    const QString text = query.queryItemValue(QStringLiteral("search"), QUrl::FullyDecoded);
+    if (text.isEmpty()) {
+        return false;
+    }
+    for (const QChar c : text) {
+        if (PatternCharacters.contains(c)) {
+            return false;
+        }
+    }
+
+    return !KFileNameSearchIndex::searchPath(searchUrl).isEmpty();
+#endif
+}
+
+void KFileContentSearcher::search(const QUrl& searchUrl)
+{
+    cancel(searchUrl);
+
+    Search& search = m_searches[searchUrl];
+    search.query.text = QUrlQuery(searchUrl).queryItemValue(QStringLiteral("search"), QUrl::FullyDecoded);
+    search.query.needle = search.query.text.toUtf8();
+    for (char& c : search.query.needle) {
+        // QByteArray::toLower() would change the bytes of UTF-8 sequences as Latin-1
+        if (c >= 'A' && c <= 'Z') {
+            c |= 0x20;
+        }
+    }
+    search.canceled = CancelFlag(new std::atomic<bool>(false));
+    search.pendingDirectories.append({KFileNameSearchIndex::searchPath(searchUrl), IgnoreListPointer()});
+
+    startTasks();
+}
+
+void KFileContentSearcher::cancel(const QUrl& searchUrl)
+{
+    auto it = m_searches.find(searchUrl);
+    if (it != m_searches.end()) {
+        deleteWatchers(it.value());
+        m_searches.erase(it);
+        startTasks();
+    }
+}
+
+void KFileContentSearcher::cancelAll()
+{
+    for (Search& search : m_searches) {
+        deleteWatchers(search);
+    }
+    m_searches.clear();
+}
+
+bool KFileContentSearcher::isSearching(const QUrl& searchUrl) const
+{
+    return m_searches.contains(searchUrl);
+}
+
+bool KFileContentSearcher::isSearching() const
+{
+    return !m_searches.isEmpty();
+}
+
+void KFileContentSearcher::slotCrawled(const QUrl& searchUrl, CrawlWatcher* watcher)
+{
+    watcher->deleteLater();
+
+    auto it = m_searches.find(searchUrl);
+    Q_ASSERT(it != m_searches.end() && it->crawlWatcher == watcher);
+    it->crawlWatcher = nullptr;
+
+    const CrawlResult result = watcher->result();
+    it->pendingFiles += result.files;
+    it->pendingDirectories += result.pendingDirectories;
+    startTasks();
+
+    if (!result.foundPaths.isEmpty()) {
+        Q_EMIT filesFound(searchUrl, result.foundPaths);
+    }
+    checkCompleted(searchUrl);
+}
+
+void KFileContentSearcher::slotScanned(const QUrl& searchUrl, ScanWatcher* watcher)
+{
+    watcher->deleteLater();
+
+    auto it = m_searches.find(searchUrl);
+    Q_ASSERT(it != m_searches.end());
+    it->scanWatchers.removeOne(watcher);
+
+    const QStringList foundPaths = watcher->result();
+    startTasks();
+
+    if (!foundPaths.isEmpty()) {
+        Q_EMIT filesFound(searchUrl, foundPaths);
+    }
+    checkCompleted(searchUrl);
+}
+
+void KFileContentSearcher::startTasks()
+{
+    KTaskScheduler& scheduler = KTaskScheduler::instance();
+    const KTaskScheduler::ThreadPriority threadPriority = GeneralSettings::lowPriorityContentSearch() ? KTaskScheduler::LowThreadPriority
+                                                                                                      : KTaskScheduler::DefaultThreadPriority;
+
+    // The folders are read ahead while the files are scanned, so
+    // that the scanning tasks don't run out of files
+    for (auto it = m_searches.begin(); it != m_searches.end(); ++it) {
+        Search& search = it.value();
+        if (search.crawlWatcher || search.pendingDirectories.isEmpty() || search.pendingFiles.count() >= CrawlBatchSize) {
+            continue;
+        }
+
+        const QUrl searchUrl = it.key();
+        auto watcher = new CrawlWatcher(this);
+        connect(watcher, &CrawlWatcher::finished, this, [this, searchUrl, watcher]() {
+            slotCrawled(searchUrl, watcher);
+        });
+        search.crawlWatcher = watcher;
+        watcher->setFuture(scheduler.run(KTaskScheduler::Visible, threadPriority, &KFileContentSearcher::crawl,
+                                          search.pendingDirectories, search.query, search.canceled));
+        search.pendingDirectories.clear();
+    }
+
+    const int maximumRunning = maximumRunningScans();
+    int running = runningScansCount();
+
+    // Start one batch for each search in turn
+    bool started = true;
+    while (started && running < maximumRunning) {
+        started = false;
+        for (auto it = m_searches.begin(); it != m_searches.end() && running < maximumRunning; ++it) {
+            Search& search = it.value();
+            if (search.pendingFiles.isEmpty()) {
+                continue;
+            }
+
+            const int count = qMin(ScanBatchSize, search.pendingFiles.count());
+            const QVector<QByteArray> files = search.pendingFiles.mid(search.pendingFiles.count() - count);
+            search.pendingFiles.resize(search.pendingFiles.count() - count);
+
+            const QUrl searchUrl = it.key();
+            auto watcher = new ScanWatcher(this);
+            connect(watcher, &ScanWatcher::finished, this, [this, searchUrl, watcher]() {
+                slotScanned(searchUrl, watcher);
+            });
+            search.scanWatchers.append(watcher);
+            watcher->setFuture(scheduler.run(KTaskScheduler::Visible, threadPriority, &KFileContentSearcher::scan,
+                                              files, search.query, search.canceled));
+
+            ++running;
+            started = true;
+        }
+    }
+}
+
+void KFileContentSearcher::checkCompleted(const QUrl& searchUrl)
+{
+    auto it = m_searches.find(searchUrl);
+    if (it == m_searches.end()) {
+        return;
+    }
+
+    const Search& search = it.value();
+    if (!search.crawlWatcher && search.pendingDirectories.isEmpty() && search.pendingFiles.isEmpty() && search.scanWatchers.isEmpty()) {
+        m_searches.erase(it);
+        Q_EMIT searchCompleted(searchUrl);
+    }
+}
+
+void KFileContentSearcher::deleteWatchers(Search& search)
+{
+    if (search.canceled) {
+        search.canceled->store(true);
+    }
+
+    if (search.crawlWatcher) {
+        disconnect(search.crawlWatcher, nullptr, this, nullptr);
+        search.crawlWatcher->deleteLater();
+        search.crawlWatcher = nullptr;
+    }
+
+    for (ScanWatcher* watcher : qAsConst(search.scanWatchers)) {
+        disconnect(watcher, nullptr, this, nullptr);
+        watcher->deleteLater();
+    }
+    search.scanWatchers.clear();
+    search.pendingFiles.clear();
+    search.pendingDirectories.clear();
+}
+
+int KFileContentSearcher::runningScansCount() const
+{
+    int count = 0;
+    for (const Search& search : m_searches) {
+        count += search.scanWatchers.count();
+    }
+    return count;
+}
+
+KFileContentSearcher::CrawlResult KFileContentSearcher::crawl(QVector<PendingDirectory> directories, const Query& query, CancelFlag canceled)
+{
+    CrawlResult result;
+
+#ifdef Q_OS_WIN
+    Q_UNUSED(directories)
+    Q_UNUSED(query)
+    Q_UNUSED(canceled)
+#else
+    while (!directories.isEmpty() && result.files.count() < CrawlBatchSize && !canceled->load(std::memory_order_relaxed)) {
+        const PendingDirectory directory = directories.takeLast();
+        const IgnoreListPointer ignoreList = readIgnoreFile(directory.path, directory.ignoreList);
+
+        QT_DIR* dir = QT_OPENDIR(QFile::encodeName(directory.path).constData());
+        if (!dir) {
+            continue;
+        }
+
+        const QString prefix = directory.path.endsWith(QLatin1Char('/')) ? directory.path : directory.path + QLatin1Char('/');
+        QT_DIRENT* dirEntry;
+        while ((dirEntry = QT_READDIR(dir))) {
+            const char* encodedName = dirEntry->d_name;
+            if (encodedName[0] == '.' && (encodedName[1] == '\0' || (encodedName[1] == '.' && encodedName[2] == '\0'))) {
+                // Skip "." and ".."
+                continue;
+            }
+
+            // Links are neither followed nor scanned, like by the KIO worker
+            bool isDir = (dirEntry->d_type == DT_DIR);
+            bool isFile = (dirEntry->d_type == DT_REG);
+            if (dirEntry->d_type == DT_UNKNOWN) {
+                struct stat buf;
+                if (fstatat(dirfd(dir), encodedName, &buf, AT_SYMLINK_NOFOLLOW) == 0) {
+                    isDir = S_ISDIR(buf.st_mode);
+                    isFile = S_ISREG(buf.st_mode);
+                }
+            }
+
+            const QString name = QFile::decodeName(encodedName);
+            if (isDir && name == QLatin1String(".git")) {
+                continue;
+            }
+
+            const QString path = prefix + name;
+            if (isIgnored(ignoreList, path, name, isDir)) {
+                continue;
+            }
+
+            if (name.contains(query.text, Qt::CaseInsensitive)) {
+                result.foundPaths.append(path);
+            } else if (isFile) {
+                result.files.append(QFile::encodeName(path));
+            }
+
+            if (isDir) {
+                directories.append({path, ignoreList});
+            }
+        }
+        QT_CLOSEDIR(dir);
+    }
+
+    result.pendingDirectories = directories;
+#endif
+
+    return result;
+}
+
+QStringList KFileContentSearcher::scan(const QVector<QByteArray>& files, const Query& query, CancelFlag canceled)
+{
+    QStringList foundPaths;
+    for (const QByteArray& file : files) {
+        if (canceled->load(std::memory_order_relaxed)) {
+            break;
+        }
+        if (containsText(file, query.needle)) {
+            foundPaths.append(QFile::decodeName(file));
+        }
+    }
+    return foundPaths;
+}
+
+bool KFileContentSearcher::containsText(const QByteArray& file, const QByteArray& needle)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(file)
+    Q_UNUSED(needle)
+    return false;
+#else
+    const int fd = QT_OPEN(file.constData(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_NOCTTY);
+    if (fd < 0) {
+        return false;
+    }
+
+    QT_STATBUF buf;
+    if (QT_FSTAT(fd, &buf) != 0 || !S_ISREG(buf.st_mode) || buf.st_size < needle.size()) {
+        QT_CLOSE(fd);
+        return false;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    // The end of each chunk is kept in front of the next one,
+    // so that texts across the chunks are found
+    const qint64 chunkSize = qMin(qint64(buf.st_size), ReadChunkSize);
+    const int overlap = needle.size() - 1;
+    QByteArray buffer(int(chunkSize) + overlap, Qt::Uninitialized);
+    qint64 offset = 0;
+    int kept = 0;
+    bool found = false;
+    while (!found) {
+        const qint64 result = pread(fd, buffer.data() + kept, size_t(chunkSize), offset);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0 || (offset == 0 && isBinary(buffer.constData(), result))) {
+            break;
+        }
+
+        offset += result;
+        const int size = kept + int(result);
+        found = containsFolded(buffer.constData(), size, needle);
+        kept = qMin(overlap, size);
+        std::memmove(buffer.data(), buffer.constData() + size - kept, size_t(kept));
+    }
+
+    QT_CLOSE(fd);
+    return found;
+#endif
+}
+
+KFileContentSearcher::IgnoreListPointer KFileContentSearcher::readIgnoreFile(const QString& path, const IgnoreListPointer& parent)
+{
+    QFile file(path + QLatin1String("/.gitignore"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return parent;
+    }
+
+    QSharedPointer<IgnoreList> ignoreList(new IgnoreList);
+    ignoreList->path = path;
+    ignoreList->parent = parent;
+
+    // Supports the patterns of git except for the escaped trailing spaces:
+    // comments, negations, folders only, "**" and patterns relative to the folder
+    while (!file.atEnd()) {
+        QString line = QString::fromUtf8(file.readLine());
+        while (line.endsWith(QLatin1Char('\n')) || line.endsWith(QLatin1Char('\r'))
+               || (line.endsWith(QLatin1Char(' ')) && !line.endsWith(QLatin1String("\\ ")))) {
+            line.chop(1);
+        }
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#'))) {
+            continue;
+        }
+
+        IgnoreList::Rule rule;
+        if (line.startsWith(QLatin1Char('!'))) {
+            rule.negated = true;
+            line.remove(0, 1);
+        } else if (line.startsWith(QLatin1Char('\\'))) {
+            line.remove(0, 1);
+        }
+        if (line.endsWith(QLatin1Char('/'))) {
+            rule.directoryOnly = true;
+            line.chop(1);
+        }
+        if (line.startsWith(QLatin1String("**/"))) {
+            line.remove(0, 3);
+        }
+        rule.matchesPath = line.contains(QLatin1Char('/'));
+        if (line.startsWith(QLatin1Char('/'))) {
+            line.remove(0, 1);
+        }
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        rule.expression = QRegularExpression(gitPatternToRegularExpression(line));
+        ignoreList->rules.append(rule);
+    }
+
+    if (ignoreList->rules.isEmpty()) {
+        return parent;
+    }
+    return ignoreList;
+}
+
+bool KFileContentSearcher::isIgnored(const IgnoreListPointer& ignoreList, const QString& path, const QString& name, bool isDir)
+{
+    // The rules of nested folders and later rules take precedence
+    for (const IgnoreList* list = ignoreList.data(); list; list = list->parent.data()) {
+        const int prefixLength = list->path.endsWith(QLatin1Char('/')) ? list->path.length() : list->path.length() + 1;
+        const QString relativePath = path.mid(prefixLength);
+        for (auto it = list->rules.crbegin(); it != list->rules.crend(); ++it) {
+            if (it->directoryOnly && !isDir) {
+                continue;
+            }
+            if (it->expression.match(it->matchesPath ? relativePath : name).hasMatch()) {
+                return !it->negated;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,163 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KFILECONTENTSEARCHER_H
+#define KFILECONTENTSEARCHER_H
+
+#include "dolphin_export.h"
+
+#include <QByteArray>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QUrl>
+#include <QVector>
+
+#include <atomic>
+
+/**
+ * @brief Searches the content of local files in worker threads without using KIO.
+ *
+ * The KIO worker of the scheme "filenamesearch" reads the files one after
+ * another if the content is searched. KFileContentSearcher reads the names
+ * of the folders in portions by one task, and the content of the files is
+ * scanned in batches by worker threads. The files are read in chunks, and
+ * the text is searched by comparing 16 bytes at once where SSE2 is available.
+ * The found files are emitted by filesFound() as soon as their batch has
+ * been finished.
+ *
+ * Like the KIO worker, a file is found if its name or its content contains
+ * the searched text. Binary files, which contain a null byte within their
+ * first bytes, are not scanned. Files and folders that are excluded by
+ * .gitignore files inside the searched folder are skipped, as well as the
+ * folders ".git". The text is compared case-insensitively for ASCII letters
+ * and byte by byte in UTF-8 otherwise.
+ */
+class DOLPHIN_EXPORT KFileContentSearcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KFileContentSearcher(QObject* parent = nullptr);
+    ~KFileContentSearcher() override;
+
+    /**
+     * @return True if \a searchUrl can be answered: The content of the
+     *         files in a local folder is searched and the text is
+     *         no regular expression or wildcard pattern.
+     */
+    static bool isSupported(const QUrl& searchUrl);
+
+    /**
+     * Starts the search \a searchUrl. If the search is running already,
+     * it is started again.
+     */
+    void search(const QUrl& searchUrl);
+
+    /**
+     * Stops the search \a searchUrl. No signals are emitted for the search
+     * anymore, the running tasks stop as soon as possible.
+     */
+    void cancel(const QUrl& searchUrl);
+    void cancelAll();
+
+    bool isSearching(const QUrl& searchUrl) const;
+    bool isSearching() const;
+
+Q_SIGNALS:
+    /**
+     * Is emitted for each batch of files and folders of the search
+     * \a searchUrl that have been found. \a paths is never empty.
+     */
+    void filesFound(const QUrl& searchUrl, const QStringList& paths);
+
+    /**
+     * Is emitted after the last files of the search \a searchUrl have been emitted.
+     */
+    void searchCompleted(const QUrl& searchUrl);
+
+private:
+    struct IgnoreList;
+    typedef QSharedPointer<const IgnoreList> IgnoreListPointer;
+    typedef QSharedPointer<std::atomic<bool> > CancelFlag;
+
+    struct PendingDirectory
+    {
+        QString path;
+        IgnoreListPointer ignoreList;   // Rules of the parent folders
+    };
+
+    struct Query
+    {
+        QString text;
+        QByteArray needle;  // UTF-8 with lower case ASCII letters
+    };
+
+    struct CrawlResult
+    {
+        QStringList foundPaths;     // Paths whose names contain the text
+        QVector<QByteArray> files;  // Files whose content must be scanned
+        QVector<PendingDirectory> pendingDirectories;
+    };
+
+    typedef QFutureWatcher<CrawlResult> CrawlWatcher;
+    typedef QFutureWatcher<QStringList> ScanWatcher;
+
+    struct Search
+    {
+        Query query;
+        CancelFlag canceled;
+        QVector<PendingDirectory> pendingDirectories;
+        QVector<QByteArray> pendingFiles;
+        CrawlWatcher* crawlWatcher = nullptr;
+        QList<ScanWatcher*> scanWatchers;
+    };
+
+    void slotCrawled(const QUrl& searchUrl, CrawlWatcher* watcher);
+    void slotScanned(const QUrl& searchUrl, ScanWatcher* watcher);
+
+    /**
+     * Starts reading the pending folders and scanning the pending files of
+     * all searches until the maximum number of running tasks is reached.
+     */
+    void startTasks();
+
+    /**
+     * Emits searchCompleted() if all files of \a searchUrl have been scanned.
+     */
+    void checkCompleted(const QUrl& searchUrl);
+
+    void deleteWatchers(Search& search);
+    int runningScansCount() const;
+
+    /**
+     * Reads the pending folders \a directories until enough files are
+     * known to keep the thread pool busy. The remaining folders are
+     * returned as pending folders.
+     */
+    static CrawlResult crawl(QVector<PendingDirectory> directories, const Query& query, CancelFlag canceled);
+
+    /**
+     * @return The paths of \a files, whose content contains the text of \a query.
+     */
+    static QStringList scan(const QVector<QByteArray>& files, const Query& query, CancelFlag canceled);
+    static bool containsText(const QByteArray& file, const QByteArray& needle);
+
+    /**
+     * Reads the file .gitignore of the folder \a path, if it exists.
+     * @return The rules of the file, whose parent is \a parent.
+     */
+    static IgnoreListPointer readIgnoreFile(const QString& path, const IgnoreListPointer& parent);
+    static bool isIgnored(const IgnoreListPointer& ignoreList, const QString& path, const QString& name, bool isDir);
+
+private:
+    QHash<QUrl, Search> m_searches;
+};
+
+#endif
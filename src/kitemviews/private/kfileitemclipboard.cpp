@@ -12,6 +12,10 @@
 #include <QClipboard>
 #include <QMimeData>
 
+namespace {
+    const char CutSelectionMimeType[] = "application/x-kde-cutselection";
+}
+
 class KFileItemClipboardSingleton
 {
 public:
@@ -28,12 +32,36 @@ KFileItemClipboard* KFileItemClipboard::instance()
 
 bool KFileItemClipboard::isCut(const QUrl& url) const
 {
-    return m_cutItems.contains(url);
+    if (m_cutItems.isEmpty()) {
+        return false;
+    }
+
+    const auto it = m_cutItems.constFind(directoryUrl(url));
+    return it != m_cutItems.constEnd() && it->contains(url.adjusted(QUrl::StripTrailingSlash).fileName());
 }
 
 QList<QUrl> KFileItemClipboard::cutItems() const
 {
-    return m_cutItems.values();
+    QList<QUrl> items;
+    for (auto it = m_cutItems.constBegin(); it != m_cutItems.constEnd(); ++it) {
+        const QUrl& directory = it.key();
+        QString directoryPath = directory.path();
+        // The root directory already ends with a slash
+        if (!directoryPath.endsWith(QLatin1Char('/'))) {
+            directoryPath += QLatin1Char('/');
+        }
+        for (const QString& name : it.value()) {
+            QUrl url = directory;
+            url.setPath(directoryPath + name);
+            items.append(url);
+        }
+    }
+    return items;
+}
+
+QUrl KFileItemClipboard::directoryUrl(const QUrl& url)
+{
+    return url.adjusted(QUrl::StripTrailingSlash).adjusted(QUrl::RemoveFilename | QUrl::StripTrailingSlash);
 }
 
 KFileItemClipboard::~KFileItemClipboard()
@@ -44,27 +72,55 @@ void KFileItemClipboard::updateCutItems()
 {
     const QMimeData* mimeData = QApplication::clipboard()->mimeData();
 
-    // mimeData can be 0 according to https://bugs.kde.org/show_bug.cgi?id=335053
-    if (!mimeData) {
-        m_cutItems.clear();
-        Q_EMIT cutItemsChanged();
+    // mimeData can be 0 according to https://bugs.kde.org/show_bug.cgi?id=335053.
+    // Only the URLs of a cut selection are of interest, the data of other
+    // clipboard contents is not requested at all.
+    QByteArray cutSelectionData;
+    if (mimeData && mimeData->hasFormat(QLatin1String(CutSelectionMimeType))) {
+        const QByteArray data = mimeData->data(QLatin1String(CutSelectionMimeType));
+        if (!data.isEmpty() && data.at(0) == QLatin1Char('1')) {
+            cutSelectionData = mimeData->data(QStringLiteral("application/x-kde4-urilist"))
+                               + mimeData->data(QStringLiteral("text/uri-list"));
+        }
+    }
+
+    if (cutSelectionData == m_cutSelectionData) {
+        // The cut selection has not been changed
         return;
     }
+    m_cutSelectionData = cutSelectionData;
+
+    QHash<QUrl, QSet<QString>> cutItems;
+    if (!cutSelectionData.isEmpty()) {
+        const QList<QUrl> urls = KUrlMimeData::urlsFromMimeData(mimeData);
+        for (const QUrl& url : urls) {
+            cutItems[directoryUrl(url)].insert(url.adjusted(QUrl::StripTrailingSlash).fileName());
+        }
+    }
+
+    // Only the directories whose cut items have been changed are announced
+    QSet<QUrl> changedDirectories;
+    for (auto it = m_cutItems.constBegin(); it != m_cutItems.constEnd(); ++it) {
+        if (cutItems.value(it.key()) != it.value()) {
+            changedDirectories.insert(it.key());
+        }
+    }
+    for (auto it = cutItems.constBegin(); it != cutItems.constEnd(); ++it) {
+        if (!m_cutItems.contains(it.key())) {
+            changedDirectories.insert(it.key());
+        }
+    }
 
-    const QByteArray data = mimeData->data(QStringLiteral("application/x-kde-cutselection"));
-    const bool isCutSelection = (!data.isEmpty() && data.at(0) == QLatin1Char('1'));
-    if (isCutSelection) {
-        const auto urlsFromMimeData = KUrlMimeData::urlsFromMimeData(mimeData);
-        m_cutItems = QSet<QUrl>(urlsFromMimeData.constBegin(), urlsFromMimeData.constEnd());
-    } else {
-        m_cutItems.clear();
+    m_cutItems = cutItems;
+    if (!changedDirectories.isEmpty()) {
+        Q_EMIT cutItemsChanged(changedDirectories);
     }
-    Q_EMIT cutItemsChanged();
 }
 
 KFileItemClipboard::KFileItemClipboard() :
     QObject(nullptr),
-    m_cutItems()
+    m_cutItems(),
+    m_cutSelectionData()
 {
     updateCutItems();
 
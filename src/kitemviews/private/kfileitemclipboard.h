@@ -9,6 +9,8 @@
 
 #include "dolphin_export.h"
 
+#include <QByteArray>
+#include <QHash>
 #include <QList>
 #include <QObject>
 #include <QSet>
@@ -17,6 +19,10 @@
 /**
  * @brief Wrapper for QClipboard to provide fast access for checking
  *        whether a KFileItem has been clipped.
+ *
+ * The cut items are indexed by their directories. The URLs are only parsed
+ * if the clipboard contains a cut selection that differs from the previous
+ * one, so copying unrelated data does not parse the URL list again.
  */
 class DOLPHIN_EXPORT KFileItemClipboard : public QObject
 {
@@ -29,8 +35,18 @@ public:
 
     QList<QUrl> cutItems() const;
 
+    /**
+     * @return The directory that contains the item with the URL \a url,
+     *         as used for the directories of cutItemsChanged().
+     */
+    static QUrl directoryUrl(const QUrl& url);
+
 Q_SIGNALS:
-    void cutItemsChanged();
+    /**
+     * Is emitted if items have been cut or uncut. \a directories
+     * contains the directories of these items.
+     */
+    void cutItemsChanged(const QSet<QUrl>& directories);
 
 protected:
     ~KFileItemClipboard() override;
@@ -41,7 +57,11 @@ private Q_SLOTS:
 private:
     KFileItemClipboard();
 
-    QSet<QUrl> m_cutItems;
+    // The names of the cut items for each directory
+    QHash<QUrl, QSet<QString>> m_cutItems;
+
+    // The URL data of the current cut selection
+    QByteArray m_cutSelectionData;
 
     friend class KFileItemClipboardSingleton;
 };
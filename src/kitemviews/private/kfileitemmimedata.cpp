@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kfileitemmimedata.h"
+
+#include <KUrlMimeData>
+
+namespace {
+    // Formats that are set by KUrlMimeData::setUrls()
+    const QString UriListFormat = QStringLiteral("text/uri-list");
+    const QString KdeUriListFormat = QStringLiteral("application/x-kde4-urilist");
+}
+
+KFileItemMimeData::KFileItemMimeData(const KFileItemList& items) :
+    QMimeData(),
+    m_items(items)
+{
+}
+
+KFileItemMimeData::~KFileItemMimeData()
+{
+}
+
+QStringList KFileItemMimeData::formats() const
+{
+    QStringList formats = QMimeData::formats();
+    if (!m_items.isEmpty()) {
+        if (!formats.contains(UriListFormat)) {
+            formats.append(UriListFormat);
+        }
+        if (!formats.contains(KdeUriListFormat)) {
+            formats.append(KdeUriListFormat);
+        }
+    }
+    return formats;
+}
+
+bool KFileItemMimeData::hasFormat(const QString& mimeType) const
+{
+    if (!m_items.isEmpty() && isUrlFormat(mimeType)) {
+        return true;
+    }
+    return QMimeData::hasFormat(mimeType);
+}
+
+QVariant KFileItemMimeData::retrieveData(const QString& mimeType, QVariant::Type type) const
+{
+    if (isUrlFormat(mimeType)) {
+        populateUrls();
+    }
+    return QMimeData::retrieveData(mimeType, type);
+}
+
+bool KFileItemMimeData::isUrlFormat(const QString& mimeType)
+{
+    return mimeType == UriListFormat || mimeType == KdeUriListFormat;
+}
+
+void KFileItemMimeData::populateUrls() const
+{
+    if (m_items.isEmpty()) {
+        return;
+    }
+
+    QList<QUrl> urls;
+    QList<QUrl> mostLocalUrls;
+    urls.reserve(m_items.count());
+    mostLocalUrls.reserve(m_items.count());
+
+    for (const KFileItem& item : qAsConst(m_items)) {
+        urls << item.url();
+
+        bool isLocal;
+        mostLocalUrls << item.mostLocalUrl(&isLocal);
+    }
+    m_items.clear();
+
+    // Setting the data does not change the formats that have
+    // been announced already, so it is fine to do it lazily.
+    KUrlMimeData::setUrls(urls, mostLocalUrls, const_cast<KFileItemMimeData*>(this));
+}
@@ -0,0 +1,55 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KFILEITEMMIMEDATA_H
+#define KFILEITEMMIMEDATA_H
+
+#include "dolphin_export.h"
+
+#include <KFileItem>
+
+#include <QMimeData>
+
+/**
+ * @brief Mime data for file items that provides the URLs on demand.
+ *
+ * Converting many items to the URL lists of KUrlMimeData::setUrls() takes
+ * a noticeable time. As a drag or the clipboard only announce the formats
+ * until the data is actually requested, the URLs are only created when one
+ * of the URL formats is retrieved for the first time. Other data can be
+ * added like for a QMimeData.
+ */
+class DOLPHIN_EXPORT KFileItemMimeData : public QMimeData
+{
+    Q_OBJECT
+
+public:
+    explicit KFileItemMimeData(const KFileItemList& items);
+    ~KFileItemMimeData() override;
+
+    QStringList formats() const override;
+    bool hasFormat(const QString& mimeType) const override;
+
+protected:
+    QVariant retrieveData(const QString& mimeType, QVariant::Type type) const override;
+
+private:
+    /**
+     * @return True if \a mimeType is one of the formats that get
+     *         provided by KUrlMimeData::setUrls().
+     */
+    static bool isUrlFormat(const QString& mimeType);
+
+    /**
+     * Adds the URLs of the items to the data if this has not been done yet.
+     */
+    void populateUrls() const;
+
+private:
+    mutable KFileItemList m_items; // Cleared after the URLs have been added
+};
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kfileitemmimetyperesolver.h"
+#include "kiogovernor.h"
+#include "ktaskscheduler.h"
+
+#include <QCache>
+#include <QElapsedTimer>
+#include <QMimeDatabase>
+#include <QTimer>
+
+namespace {
+    // Number of files whose MIME-types are determined by one task.
+    const int BatchSize = 50;
+
+    // Maximum number of batches of one resolver that are running at the
+    // same time. Reading the files is I/O bound, so more batches would
+    // only compete for the same disk. The batches of all resolvers are
+    // additionally limited per mount by KIoGovernor.
+    const int MaximumRunningBatches = 2;
+
+    // Interval in ms in which the results of the finished batches are
+    // collected before they are emitted together.
+    const int ResolvedMimeTypesInterval = 100;
+
+    // Maximum number of MIME-types that are cached for all resolvers.
+    const int MaximumCacheEntries = 50000;
+
+    struct CacheEntry
+    {
+        QString mimeType;
+        QDateTime modificationTime;
+    };
+
+    typedef QCache<QUrl, CacheEntry> Cache;
+}
+
+/// Least recently used cache of the determined MIME-types, shared by all views of the process
+Q_GLOBAL_STATIC_WITH_ARGS(Cache, s_cache, (MaximumCacheEntries))
+
+KFileItemMimeTypeResolver::KFileItemMimeTypeResolver(QObject* parent) :
+    QObject(parent),
+    m_queue(),
+    m_pendingUrls(),
+    m_batchWatchers(),
+    m_resolvedMimeTypes(),
+    m_startBatchesTimer(nullptr),
+    m_resolvedMimeTypesTimer(nullptr)
+{
+    // Several calls of resolve() within one event loop iteration, like
+    // they are done for each visible item by KFileItemModelRolesUpdater,
+    // should end up in the same batch.
+    m_startBatchesTimer = new QTimer(this);
+    m_startBatchesTimer->setInterval(0);
+    m_startBatchesTimer->setSingleShot(true);
+    connect(m_startBatchesTimer, &QTimer::timeout, this, &KFileItemMimeTypeResolver::startBatches);
+
+    m_resolvedMimeTypesTimer = new QTimer(this);
+    m_resolvedMimeTypesTimer->setInterval(ResolvedMimeTypesInterval);
+    m_resolvedMimeTypesTimer->setSingleShot(true);
+    connect(m_resolvedMimeTypesTimer, &QTimer::timeout, this, &KFileItemMimeTypeResolver::emitResolvedMimeTypes);
+
+    connect(&KIoGovernor::instance(), &KIoGovernor::released, this, [this]() {
+        if (!m_queue.isEmpty() && !m_startBatchesTimer->isActive()) {
+            m_startBatchesTimer->start();
+        }
+    });
+}
+
+KFileItemMimeTypeResolver::~KFileItemMimeTypeResolver()
+{
+    // The running batches only work on copies of the URLs and paths, so
+    // there is no need to wait for them. The watchers are deleted as
+    // children of this object.
+    disconnect(&KIoGovernor::instance(), nullptr, this, nullptr);
+    releaseTokens();
+}
+
+void KFileItemMimeTypeResolver::resolve(const KFileItemList& items)
+{
+    bool resolvedFromCache = false;
+    for (const KFileItem& item : items) {
+        if (item.isDir() || item.isMimeTypeKnown()) {
+            continue;
+        }
+
+        const QString localPath = item.localPath();
+        if (localPath.isEmpty()) {
+            continue;
+        }
+
+        const QUrl url = item.url();
+        if (m_pendingUrls.contains(url) || m_resolvedMimeTypes.contains(url)) {
+            continue;
+        }
+
+        const QDateTime modificationTime = item.time(KFileItem::ModificationTime);
+        const CacheEntry* cachedEntry = s_cache->object(url);
+        if (cachedEntry && modificationTime.isValid() && cachedEntry->modificationTime == modificationTime) {
+            m_resolvedMimeTypes.insert(url, cachedEntry->mimeType);
+            resolvedFromCache = true;
+            continue;
+        }
+
+        m_pendingUrls.insert(url, modificationTime);
+        m_queue.append(qMakePair(url, localPath));
+    }
+
+    if (resolvedFromCache && !m_resolvedMimeTypesTimer->isActive()) {
+        m_resolvedMimeTypesTimer->start();
+    }
+
+    if (!m_queue.isEmpty() && !m_startBatchesTimer->isActive()) {
+        m_startBatchesTimer->start();
+    }
+}
+
+void KFileItemMimeTypeResolver::cancel()
+{
+    m_startBatchesTimer->stop();
+    m_resolvedMimeTypesTimer->stop();
+
+    releaseTokens();
+
+    m_queue.clear();
+    m_pendingUrls.clear();
+    m_resolvedMimeTypes.clear();
+}
+
+bool KFileItemMimeTypeResolver::isResolving() const
+{
+    return !m_pendingUrls.isEmpty() || !m_resolvedMimeTypes.isEmpty();
+}
+
+void KFileItemMimeTypeResolver::startBatches()
+{
+    KIoGovernor& governor = KIoGovernor::instance();
+    while (!m_queue.isEmpty() && m_batchWatchers.count() < MaximumRunningBatches) {
+        // The files of a batch are usually part of the same directory
+        const QString path = m_queue.first().second;
+        if (governor.acquire(KIoGovernor::MimeTypes, path) == 0) {
+            // Is continued when any background task releases its token
+            break;
+        }
+
+        const int count = qMin(BatchSize, m_queue.count());
+        const Batch batch = m_queue.mid(0, count);
+        m_queue.remove(0, count);
+
+        auto watcher = new QFutureWatcher<Batch>(this);
+        connect(watcher, &QFutureWatcher<Batch>::finished, this, &KFileItemMimeTypeResolver::slotBatchFinished);
+        m_batchWatchers.insert(watcher, path);
+        watcher->setFuture(KTaskScheduler::instance().run(KTaskScheduler::Visible, &KFileItemMimeTypeResolver::determineMimeTypes, batch));
+    }
+}
+
+void KFileItemMimeTypeResolver::slotBatchFinished()
+{
+    auto watcher = static_cast<QFutureWatcher<Batch>*>(sender());
+    const QString path = m_batchWatchers.take(watcher);
+    watcher->deleteLater();
+    KIoGovernor::instance().release(KIoGovernor::MimeTypes, path);
+
+    const Batch mimeTypes = watcher->result();
+    for (const auto& mimeType : mimeTypes) {
+        const QDateTime modificationTime = m_pendingUrls.take(mimeType.first);
+        if (modificationTime.isValid()) {
+            s_cache->insert(mimeType.first, new CacheEntry{mimeType.second, modificationTime});
+        }
+        m_resolvedMimeTypes.insert(mimeType.first, mimeType.second);
+    }
+
+    if (!m_resolvedMimeTypesTimer->isActive()) {
+        m_resolvedMimeTypesTimer->start();
+    }
+
+    startBatches();
+}
+
+void KFileItemMimeTypeResolver::releaseTokens()
+{
+    KIoGovernor& governor = KIoGovernor::instance();
+    for (auto it = m_batchWatchers.constBegin(); it != m_batchWatchers.constEnd(); ++it) {
+        disconnect(it.key(), nullptr, this, nullptr);
+        it.key()->deleteLater();
+        governor.release(KIoGovernor::MimeTypes, it.value());
+    }
+    m_batchWatchers.clear();
+}
+
+void KFileItemMimeTypeResolver::emitResolvedMimeTypes()
+{
+    if (m_resolvedMimeTypes.isEmpty()) {
+        return;
+    }
+
+    const QHash<QUrl, QString> mimeTypes = m_resolvedMimeTypes;
+    m_resolvedMimeTypes.clear();
+    Q_EMIT mimeTypesResolved(mimeTypes);
+}
+
+KFileItemMimeTypeResolver::Batch KFileItemMimeTypeResolver::determineMimeTypes(const Batch& files)
+{
+    // QMimeDatabase may be used from any thread. In contrast to
+    // KFileItem::currentMimeType() it also looks at the content
+    // if the file name is not sufficient.
+    const QMimeDatabase db;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    Batch mimeTypes;
+    mimeTypes.reserve(files.count());
+    for (const auto& file : files) {
+        mimeTypes.append(qMakePair(file.first, db.mimeTypeForFile(file.second).name()));
+    }
+
+    if (!files.isEmpty()) {
+        // Reading the first bytes of a file is cheap on fast mounts.
+        KIoGovernor::instance().reportLatency(files.first().second, timer.elapsed() / files.count());
+    }
+    return mimeTypes;
+}
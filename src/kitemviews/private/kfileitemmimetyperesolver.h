@@ -0,0 +1,106 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KFILEITEMMIMETYPERESOLVER_H
+#define KFILEITEMMIMETYPERESOLVER_H
+
+#include "dolphin_export.h"
+
+#include <KFileItem>
+
+#include <QDateTime>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QUrl>
+#include <QVector>
+
+class QTimer;
+
+/**
+ * @brief Determines the MIME-types of local files in worker threads.
+ *
+ * KFileItem::determineMimeType() might read the content of the file, which
+ * can block the user interface for a long time on slow or network mounts.
+ * KFileItemMimeTypeResolver reads the files in batches on a thread pool
+ * instead. As KFileItem is not thread-safe, only the URLs and local paths
+ * are passed to the worker threads: The owner gets the names of the
+ * determined MIME-types and must update its items on its own.
+ *
+ * The results of several batches are collected and emitted together with
+ * the signal mimeTypesResolved(), so that the owner does not need to
+ * update and resort its items for each batch.
+ *
+ * The determined MIME-types are kept in a cache that is shared by all
+ * resolvers of the process together with the modification times of the
+ * files. Opening a directory in another view, e.g. in a new tab of an
+ * application that embeds DolphinPart, does not read the files again.
+ */
+class DOLPHIN_EXPORT KFileItemMimeTypeResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KFileItemMimeTypeResolver(QObject* parent = nullptr);
+    ~KFileItemMimeTypeResolver() override;
+
+    /**
+     * Determines the MIME-types of the local files \a items. Directories, items
+     * without local path, items with known MIME-type and items that are
+     * resolved already are ignored.
+     */
+    void resolve(const KFileItemList& items);
+
+    /**
+     * Discards all items that have been passed to resolve(). The results of
+     * batches that are being resolved by the worker threads are ignored.
+     */
+    void cancel();
+
+    /**
+     * @return True if items are waiting for being resolved, or if resolved
+     *         MIME-types have not been emitted yet.
+     */
+    bool isResolving() const;
+
+Q_SIGNALS:
+    /**
+     * Is emitted if the MIME-types of files have been determined. The keys
+     * of \a mimeTypes are the URLs of the items, the values are the names
+     * of the MIME-types.
+     */
+    void mimeTypesResolved(const QHash<QUrl, QString>& mimeTypes);
+
+private Q_SLOTS:
+    void startBatches();
+    void slotBatchFinished();
+    void emitResolvedMimeTypes();
+
+private:
+    // URL and local path of a file, or URL and name of the MIME-type
+    // of a file after the batch has been resolved.
+    typedef QVector<QPair<QUrl, QString> > Batch;
+
+    static Batch determineMimeTypes(const Batch& files);
+
+    /**
+     * Discards the running batches and releases their tokens.
+     */
+    void releaseTokens();
+
+private:
+    Batch m_queue;
+    // Items of m_queue and of the running batches with their modification times
+    QHash<QUrl, QDateTime> m_pendingUrls;
+    // Running batches with the paths their tokens of KIoGovernor have been acquired for
+    QHash<QFutureWatcher<Batch>*, QString> m_batchWatchers;
+    QHash<QUrl, QString> m_resolvedMimeTypes;
+    QTimer* m_startBatchesTimer;
+    QTimer* m_resolvedMimeTypesTimer;
+};
+
+#endif
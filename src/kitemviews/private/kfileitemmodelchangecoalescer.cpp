@@ -0,0 +1,119 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kfileitemmodelchangecoalescer.h"
+
+KFileItemModelChangeCoalescer::KFileItemModelChangeCoalescer() :
+    m_changes()
+{
+}
+
+void KFileItemModelChangeCoalescer::addItems(const QUrl& directoryUrl, const KFileItemList& items)
+{
+    for (const KFileItem& item : items) {
+        const auto it = m_changes.find(item.url());
+        if (it == m_changes.end()) {
+            m_changes.insert(item.url(), {AddedChange, KFileItem(), item, directoryUrl});
+            continue;
+        }
+
+        switch (it->type) {
+        case AddedChange:
+            it->item = item;
+            it->directoryUrl = directoryUrl;
+            break;
+        case DeletedChange:
+            // The item has been replaced, so the item of the
+            // model only needs to be refreshed.
+            it->type = RefreshedChange;
+            it->item = item;
+            break;
+        case RefreshedChange:
+            it->item = item;
+            break;
+        }
+    }
+}
+
+void KFileItemModelChangeCoalescer::deleteItems(const KFileItemList& items)
+{
+    for (const KFileItem& item : items) {
+        const auto it = m_changes.find(item.url());
+        if (it == m_changes.end()) {
+            m_changes.insert(item.url(), {DeletedChange, item, KFileItem(), QUrl()});
+            continue;
+        }
+
+        switch (it->type) {
+        case AddedChange:
+            // The model does not know the item yet
+            m_changes.erase(it);
+            break;
+        case DeletedChange:
+            break;
+        case RefreshedChange:
+            it->type = DeletedChange;
+            it->item = KFileItem();
+            break;
+        }
+    }
+}
+
+void KFileItemModelChangeCoalescer::refreshItems(const QList<QPair<KFileItem, KFileItem> >& items)
+{
+    for (const auto& itemPair : items) {
+        const KFileItem& oldItem = itemPair.first;
+        const KFileItem& newItem = itemPair.second;
+        Q_ASSERT(oldItem.url() == newItem.url());
+
+        const auto it = m_changes.find(newItem.url());
+        if (it == m_changes.end()) {
+            m_changes.insert(newItem.url(), {RefreshedChange, oldItem, newItem, QUrl()});
+            continue;
+        }
+
+        if (it->type == DeletedChange) {
+            it->type = RefreshedChange;
+        }
+        it->item = newItem;
+    }
+}
+
+KFileItemModelChangeCoalescer::Changes KFileItemModelChangeCoalescer::takeChanges()
+{
+    Changes changes;
+    for (const Change& change : qAsConst(m_changes)) {
+        switch (change.type) {
+        case AddedChange:
+            changes.addedItems[change.directoryUrl].append(change.item);
+            break;
+        case DeletedChange:
+            changes.deletedItems.append(change.oldItem);
+            break;
+        case RefreshedChange:
+            changes.refreshedItems.append(qMakePair(change.oldItem, change.item));
+            break;
+        }
+    }
+
+    m_changes.clear();
+    return changes;
+}
+
+void KFileItemModelChangeCoalescer::clear()
+{
+    m_changes.clear();
+}
+
+bool KFileItemModelChangeCoalescer::isEmpty() const
+{
+    return m_changes.isEmpty();
+}
+
+int KFileItemModelChangeCoalescer::count() const
+{
+    return m_changes.count();
+}
@@ -0,0 +1,86 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KFILEITEMMODELCHANGECOALESCER_H
+#define KFILEITEMMODELCHANGECOALESCER_H
+
+#include "dolphin_export.h"
+
+#include <KFileItem>
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QUrl>
+
+/**
+ * @brief Merges the changes of directories that are reported by KDirLister.
+ *
+ * Directories like build or log directories might be changed thousands of
+ * times per second. Instead of applying each batch of added, deleted and
+ * refreshed items separately, KFileItemModel collects the changes for a
+ * short time and applies the net changes at once: Several changes of the
+ * same item are merged into one, and items that have been created and
+ * deleted again are dropped.
+ *
+ * The changes are identified by the URLs of the items. Refreshed items
+ * must keep their URL, renamed items must be applied directly after the
+ * collected changes have been taken.
+ */
+class DOLPHIN_EXPORT KFileItemModelChangeCoalescer
+{
+public:
+    struct Changes
+    {
+        KFileItemList deletedItems;
+        QList<QPair<KFileItem, KFileItem> > refreshedItems;
+        // The added items, grouped by the URL of their directory
+        QHash<QUrl, KFileItemList> addedItems;
+    };
+
+    KFileItemModelChangeCoalescer();
+
+    void addItems(const QUrl& directoryUrl, const KFileItemList& items);
+    void deleteItems(const KFileItemList& items);
+    void refreshItems(const QList<QPair<KFileItem, KFileItem> >& items);
+
+    /**
+     * @return The net changes since the last invocation. Afterwards
+     *         no changes are collected anymore.
+     */
+    Changes takeChanges();
+
+    void clear();
+    bool isEmpty() const;
+
+    /**
+     * @return Number of items with collected changes.
+     */
+    int count() const;
+
+private:
+    enum ChangeType {
+        AddedChange,
+        DeletedChange,
+        RefreshedChange
+    };
+
+    struct Change
+    {
+        ChangeType type;
+        // The item that is known by the model. Is only set
+        // for deleted and refreshed items.
+        KFileItem oldItem;
+        // The current item. Is not set for deleted items.
+        KFileItem item;
+        // The directory of added items
+        QUrl directoryUrl;
+    };
+
+    QHash<QUrl, Change> m_changes;
+};
+
+#endif
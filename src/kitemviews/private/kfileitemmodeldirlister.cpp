@@ -6,19 +6,320 @@
 
 #include "kfileitemmodeldirlister.h"
 
+#include "kfilecontentsearcher.h"
+#include "kfilenamesearchindex.h"
+#include "kfileitemmodellocallister.h"
+
+#include <kio_version.h>
+#include <KDirWatch>
 #include <KLocalizedString>
+#include <KIO/Global>
 #include <KIO/Job>
 
+#include <QTimer>
+
+#include <sys/stat.h>
+
+namespace {
+    // Interval in ms in which the changes of the local directories, which
+    // are reported by KDirWatch, are collected before they are listed again.
+    // Directories whose listing takes long are listed less often, so that
+    // a directory that changes continuously is not listed all the time.
+    const int DirtyDirectoriesInterval = 500;
+    const int MaximumDirtyDirectoriesInterval = 10000;
+    const int DirtyDirectoriesListingFactor = 2;
+}
+
 KFileItemModelDirLister::KFileItemModelDirLister(QObject* parent) :
-    KDirLister(parent)
+    KDirLister(parent),
+    m_localListingEnabled(false),
+    m_indexedSearchEnabled(false),
+    m_contentSearchEnabled(false),
+    m_listingLocally(false),
+    m_localUrl(),
+    m_localRootItem(),
+    m_localDirectories(),
+    m_localLister(nullptr),
+    m_contentSearcher(nullptr),
+    m_searchWatchers(),
+    m_dirWatch(nullptr),
+    m_dirtyDirectories(),
+    m_dirtyDirectoriesTimer(nullptr),
+    m_emittedShowingDotFiles(false),
+    m_emittedDirOnlyMode(false)
 {
     setAutoErrorHandlingEnabled(false, nullptr);
+
+    m_localLister = new KFileItemModelLocalLister(this);
+    connect(m_localLister, &KFileItemModelLocalLister::directoryEntryListed, this, &KFileItemModelDirLister::slotDirectoryEntryListed);
+    connect(m_localLister, &KFileItemModelLocalLister::entriesListed, this, &KFileItemModelDirLister::slotEntriesListed);
+    connect(m_localLister, &KFileItemModelLocalLister::listingCompleted, this, &KFileItemModelDirLister::slotListingCompleted);
+    connect(m_localLister, &KFileItemModelLocalLister::listingFailed, this, &KFileItemModelDirLister::slotListingFailed);
+    connect(m_localLister, &KFileItemModelLocalLister::entryCountKnown, this, &KFileItemModelDirLister::entryCountKnown);
+
+    m_contentSearcher = new KFileContentSearcher(this);
+    connect(m_contentSearcher, &KFileContentSearcher::filesFound, this, &KFileItemModelDirLister::slotContentFilesFound);
+    connect(m_contentSearcher, &KFileContentSearcher::searchCompleted, this, &KFileItemModelDirLister::slotContentSearchCompleted);
+
+    m_dirWatch = new KDirWatch(this);
+    connect(m_dirWatch, &KDirWatch::dirty, this, &KFileItemModelDirLister::slotDirectoryDirty);
+
+    m_dirtyDirectoriesTimer = new QTimer(this);
+    m_dirtyDirectoriesTimer->setInterval(DirtyDirectoriesInterval);
+    m_dirtyDirectoriesTimer->setSingleShot(true);
+    connect(m_dirtyDirectoriesTimer, &QTimer::timeout, this, &KFileItemModelDirLister::refreshDirtyDirectories);
 }
 
 KFileItemModelDirLister::~KFileItemModelDirLister()
 {
 }
 
+void KFileItemModelDirLister::setLocalListingEnabled(bool enabled)
+{
+    m_localListingEnabled = enabled;
+}
+
+bool KFileItemModelDirLister::isLocalListingEnabled() const
+{
+    return m_localListingEnabled;
+}
+
+void KFileItemModelDirLister::setIndexedSearchEnabled(bool enabled)
+{
+    if (enabled == m_indexedSearchEnabled) {
+        return;
+    }
+
+    // The index is only created if it is used
+    KFileNameSearchIndex& index = KFileNameSearchIndex::instance();
+    if (enabled) {
+        connect(&index, &KFileNameSearchIndex::indexChanged, this, &KFileItemModelDirLister::slotSearchIndexChanged);
+    } else {
+        disconnect(&index, &KFileNameSearchIndex::indexChanged, this, &KFileItemModelDirLister::slotSearchIndexChanged);
+    }
+    m_indexedSearchEnabled = enabled;
+}
+
+bool KFileItemModelDirLister::isIndexedSearchEnabled() const
+{
+    return m_indexedSearchEnabled;
+}
+
+void KFileItemModelDirLister::setContentSearchEnabled(bool enabled)
+{
+    m_contentSearchEnabled = enabled;
+}
+
+bool KFileItemModelDirLister::isContentSearchEnabled() const
+{
+    return m_contentSearchEnabled;
+}
+
+bool KFileItemModelDirLister::isListingLocally() const
+{
+    return m_listingLocally;
+}
+
+bool KFileItemModelDirLister::openUrl(const QUrl& url, OpenUrlFlags flags)
+{
+    const QUrl dirUrl = url.adjusted(QUrl::StripTrailingSlash);
+
+    if (flags & Keep) {
+        if (m_listingLocally && KFileItemModelLocalLister::isSupported(dirUrl)) {
+            openLocalDirectory(dirUrl);
+            return true;
+        }
+        return KDirLister::openUrl(url, flags);
+    }
+
+    stopLocalListing();
+    if (m_indexedSearchEnabled) {
+        KFileNameSearchIndex::instance().prepare(dirUrl);
+    }
+    m_listingLocally = (m_localListingEnabled && KFileItemModelLocalLister::isSupported(dirUrl))
+                       || isIndexedSearch(dirUrl) || isContentSearch(dirUrl);
+    if (!m_listingLocally) {
+        return KDirLister::openUrl(url, flags);
+    }
+
+    // KDirLister keeps the previous directories, but they must not be listed
+    // or updated anymore. Otherwise KDirLister would report the changes of
+    // them while the local directory is shown.
+    KDirLister::stop();
+    const QList<QUrl> previousUrls = directories();
+    for (const QUrl& previousUrl : previousUrls) {
+        forgetDirs(previousUrl);
+    }
+
+    m_localUrl = dirUrl;
+    m_emittedShowingDotFiles = showingDotFiles();
+    m_emittedDirOnlyMode = dirOnlyMode();
+
+    if (!dirUrl.isLocalFile()) {
+        // The results of a search have no directory that could be read
+        KIO::UDSEntry entry;
+        entry.fastInsert(KIO::UDSEntry::UDS_NAME, QStringLiteral("."));
+        entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, S_IFDIR);
+        m_localRootItem = KFileItem(entry, dirUrl, delayedMimeTypes(), true);
+    }
+
+    Q_EMIT clear();
+    openLocalDirectory(dirUrl);
+    return true;
+}
+
+void KFileItemModelDirLister::stop()
+{
+    if (m_listingLocally) {
+        QList<QUrl> canceledUrls;
+        for (auto it = m_localDirectories.begin(); it != m_localDirectories.end(); ++it) {
+            if (!m_localLister->isListing(it.key())) {
+                continue;
+            }
+
+            m_localLister->cancel(it.key());
+            m_contentSearcher->cancel(it.key());
+            cancelIndexedSearch(it.key());
+            if (it->updating) {
+                // Like KDirLister, canceled updates are not reported
+                it->updating = false;
+                it->updatedItems.clear();
+            } else {
+                canceledUrls.append(it.key());
+            }
+        }
+
+        for (const QUrl& url : qAsConst(canceledUrls)) {
+            emitCanceled(url);
+        }
+    }
+
+    KDirLister::stop();
+}
+
+void KFileItemModelDirLister::stop(const QUrl& url)
+{
+    const QUrl dirUrl = url.adjusted(QUrl::StripTrailingSlash);
+    if (!m_listingLocally || !m_localDirectories.contains(dirUrl)) {
+        KDirLister::stop(url);
+        return;
+    }
+
+    const bool listing = m_localLister->isListing(dirUrl) && !m_localDirectories.value(dirUrl).updating;
+    m_localLister->cancel(dirUrl);
+    m_contentSearcher->cancel(dirUrl);
+    cancelIndexedSearch(dirUrl);
+    m_localDirectories.remove(dirUrl);
+    m_dirtyDirectories.remove(dirUrl);
+    if (dirUrl.isLocalFile()) {
+        m_dirWatch->removeDir(dirUrl.toLocalFile());
+    }
+
+    if (listing) {
+        emitCanceled(dirUrl);
+    }
+}
+
+void KFileItemModelDirLister::forgetDirectory(const QUrl& url)
+{
+    const QUrl dirUrl = url.adjusted(QUrl::StripTrailingSlash);
+    if (!m_listingLocally || !m_localDirectories.contains(dirUrl)) {
+        forgetDirs(dirUrl);
+        return;
+    }
+
+    m_localLister->cancel(dirUrl);
+    m_localDirectories.remove(dirUrl);
+    m_dirtyDirectories.remove(dirUrl);
+    if (dirUrl.isLocalFile()) {
+        m_dirWatch->removeDir(dirUrl.toLocalFile());
+    }
+}
+
+void KFileItemModelDirLister::emitChanges()
+{
+    if (!m_listingLocally) {
+        KDirLister::emitChanges();
+        return;
+    }
+
+    const bool showDotFiles = showingDotFiles();
+    const bool dirsOnly = dirOnlyMode();
+    if (showDotFiles == m_emittedShowingDotFiles && dirsOnly == m_emittedDirOnlyMode) {
+        return;
+    }
+
+    KFileItemList deletedItems;
+    for (auto it = m_localDirectories.constBegin(); it != m_localDirectories.constEnd(); ++it) {
+        KFileItemList addedItems;
+        for (const KFileItem& item : it->items) {
+            const bool wasShown = isShown(item, m_emittedShowingDotFiles, m_emittedDirOnlyMode);
+            const bool shown = isShown(item, showDotFiles, dirsOnly);
+            if (shown && !wasShown) {
+                addedItems.append(item);
+            } else if (wasShown && !shown) {
+                deletedItems.append(item);
+            }
+        }
+
+        if (!addedItems.isEmpty()) {
+            Q_EMIT itemsAdded(it.key(), addedItems);
+        }
+    }
+
+    m_emittedShowingDotFiles = showDotFiles;
+    m_emittedDirOnlyMode = dirsOnly;
+
+    if (!deletedItems.isEmpty()) {
+        Q_EMIT itemsDeleted(deletedItems);
+    }
+}
+
+QUrl KFileItemModelDirLister::url() const
+{
+    return m_listingLocally ? m_localUrl : KDirLister::url();
+}
+
+KFileItem KFileItemModelDirLister::rootItem() const
+{
+    return m_listingLocally ? m_localRootItem : KDirLister::rootItem();
+}
+
+bool KFileItemModelDirLister::isFinished() const
+{
+    return m_listingLocally ? !m_localLister->isListing() : KDirLister::isFinished();
+}
+
+void KFileItemModelDirLister::updateDirectory(const QUrl& url)
+{
+    const QUrl dirUrl = url.adjusted(QUrl::StripTrailingSlash);
+    if (!m_listingLocally || !m_localDirectories.contains(dirUrl)) {
+        KDirLister::updateDirectory(url);
+        return;
+    }
+
+    LocalDirectory& directory = m_localDirectories[dirUrl];
+    if (m_localLister->isListing(dirUrl)) {
+        // The changes are listed after the current listing has been completed
+        directory.dirty = true;
+        return;
+    }
+
+    if (m_indexedSearchEnabled) {
+        // Outdated indexes are built again
+        KFileNameSearchIndex::instance().prepare(dirUrl);
+    }
+    if (!dirUrl.isLocalFile() && !isContentSearch(dirUrl) && !isIndexedSearch(dirUrl)) {
+        // The index has been released and is built again, until
+        // then the current results are kept
+        return;
+    }
+
+    directory.updating = true;
+    directory.updatedItems.clear();
+    listLocalDirectory(dirUrl);
+}
+
 void KFileItemModelDirLister::handleError(KIO::Job* job)
 {
     if (job->error() == KIO::ERR_IS_FILE) {
@@ -33,3 +334,315 @@ void KFileItemModelDirLister::handleError(KIO::Job* job)
     }
 }
 
+void KFileItemModelDirLister::slotDirectoryEntryListed(const QUrl& url, const KIO::UDSEntry& entry)
+{
+    if (url == m_localUrl) {
+        m_localRootItem = KFileItem(entry, url, delayedMimeTypes(), true);
+    }
+}
+
+void KFileItemModelDirLister::slotEntriesListed(const QUrl& url, const KIO::UDSEntryList& entries)
+{
+    auto it = m_localDirectories.find(url);
+    Q_ASSERT(it != m_localDirectories.end());
+    LocalDirectory& directory = it.value();
+
+    const bool mimeTypesDelayed = delayedMimeTypes();
+    if (directory.updating) {
+        for (const KIO::UDSEntry& entry : entries) {
+            const KFileItem item(entry, url, mimeTypesDelayed, true);
+            directory.updatedItems.insert(itemKey(url, item), item);
+        }
+        return;
+    }
+
+    KFileItemList items;
+    items.reserve(entries.count());
+    for (const KIO::UDSEntry& entry : entries) {
+        const KFileItem item(entry, url, mimeTypesDelayed, true);
+        directory.items.insert(itemKey(url, item), item);
+        if (isShown(item, m_emittedShowingDotFiles, m_emittedDirOnlyMode)) {
+            items.append(item);
+        }
+    }
+
+    if (!items.isEmpty()) {
+        Q_EMIT itemsAdded(url, items);
+    }
+}
+
+void KFileItemModelDirLister::slotListingCompleted(const QUrl& url)
+{
+    auto it = m_localDirectories.find(url);
+    Q_ASSERT(it != m_localDirectories.end());
+    LocalDirectory& directory = it.value();
+
+    directory.listingTime = directory.listingTimer.elapsed();
+    if (directory.updating) {
+        emitLocalChanges(url, directory);
+    }
+
+    if (directory.dirty) {
+        directory.dirty = false;
+        m_dirtyDirectories.insert(url);
+        scheduleDirtyDirectoriesRefresh();
+    }
+
+    emitCompleted(url);
+}
+
+void KFileItemModelDirLister::slotListingFailed(const QUrl& url, int errorCode)
+{
+    auto it = m_localDirectories.find(url);
+    Q_ASSERT(it != m_localDirectories.end());
+    if (it->updating) {
+        // The directory might have been deleted. This is handled
+        // by the parent directory, so the items are just kept.
+        it->updating = false;
+        it->updatedItems.clear();
+        return;
+    }
+
+    if (errorCode == KIO::ERR_IS_FILE) {
+        Q_EMIT urlIsFileError(url);
+    } else {
+        Q_EMIT errorMessage(KIO::buildErrorString(errorCode, url.toDisplayString(QUrl::PreferLocalFile)));
+    }
+
+    m_localDirectories.erase(it);
+    if (url.isLocalFile()) {
+        m_dirWatch->removeDir(url.toLocalFile());
+    }
+    emitCanceled(url);
+}
+
+void KFileItemModelDirLister::slotDirectoryDirty(const QString& path)
+{
+    const QUrl url = QUrl::fromLocalFile(path).adjusted(QUrl::StripTrailingSlash);
+    if (m_localDirectories.contains(url)) {
+        m_dirtyDirectories.insert(url);
+        scheduleDirtyDirectoriesRefresh();
+    }
+}
+
+void KFileItemModelDirLister::slotSearchIndexChanged(const QString& rootPath)
+{
+    if (!m_listingLocally || !autoUpdate()) {
+        return;
+    }
+
+    const QString rootPrefix = rootPath.endsWith(QLatin1Char('/')) ? rootPath : rootPath + QLatin1Char('/');
+    for (auto it = m_localDirectories.constBegin(); it != m_localDirectories.constEnd(); ++it) {
+        if (!KFileNameSearchIndex::isSupported(it.key())) {
+            continue;
+        }
+
+        const QString path = KFileNameSearchIndex::searchPath(it.key());
+        if (path == rootPath || path.startsWith(rootPrefix)) {
+            m_dirtyDirectories.insert(it.key());
+            scheduleDirtyDirectoriesRefresh();
+        }
+    }
+}
+
+void KFileItemModelDirLister::slotContentFilesFound(const QUrl& url, const QStringList& paths)
+{
+    m_localLister->addFiles(url, paths, false);
+}
+
+void KFileItemModelDirLister::slotContentSearchCompleted(const QUrl& url)
+{
+    m_localLister->addFiles(url, QStringList(), true);
+}
+
+void KFileItemModelDirLister::refreshDirtyDirectories()
+{
+    const QSet<QUrl> urls = m_dirtyDirectories;
+    m_dirtyDirectories.clear();
+    for (const QUrl& url : urls) {
+        updateDirectory(url);
+    }
+}
+
+void KFileItemModelDirLister::scheduleDirtyDirectoriesRefresh()
+{
+    if (m_dirtyDirectoriesTimer->isActive()) {
+        // The changes are collected until the timer expires
+        return;
+    }
+
+    qint64 listingTime = 0;
+    for (const QUrl& url : qAsConst(m_dirtyDirectories)) {
+        listingTime = qMax(listingTime, m_localDirectories.value(url).listingTime);
+    }
+
+    const qint64 interval = qBound<qint64>(DirtyDirectoriesInterval,
+                                           DirtyDirectoriesListingFactor * listingTime,
+                                           MaximumDirtyDirectoriesInterval);
+    m_dirtyDirectoriesTimer->start(int(interval));
+}
+
+void KFileItemModelDirLister::openLocalDirectory(const QUrl& url)
+{
+    m_localDirectories.insert(url, LocalDirectory());
+    m_dirtyDirectories.remove(url);
+    if (autoUpdate() && url.isLocalFile()) {
+        m_dirWatch->addDir(url.toLocalFile());
+    }
+
+    Q_EMIT started(url);
+    listLocalDirectory(url);
+}
+
+void KFileItemModelDirLister::stopLocalListing()
+{
+    m_localLister->cancelAll();
+    m_contentSearcher->cancelAll();
+    const QList<QUrl> searchUrls = m_searchWatchers.keys();
+    for (const QUrl& url : searchUrls) {
+        cancelIndexedSearch(url);
+    }
+    for (auto it = m_localDirectories.constBegin(); it != m_localDirectories.constEnd(); ++it) {
+        if (it.key().isLocalFile()) {
+            m_dirWatch->removeDir(it.key().toLocalFile());
+        }
+    }
+    m_localDirectories.clear();
+    m_dirtyDirectories.clear();
+    m_dirtyDirectoriesTimer->stop();
+    m_localUrl.clear();
+    m_localRootItem = KFileItem();
+}
+
+void KFileItemModelDirLister::listLocalDirectory(const QUrl& url)
+{
+    m_localDirectories[url].listingTimer.start();
+    if (url.isLocalFile()) {
+        m_localLister->list(url);
+    } else if (isContentSearch(url)) {
+        // The found files are added while the content is searched
+        m_localLister->listFiles(url, QStringList(), false);
+        m_contentSearcher->search(url);
+    } else {
+        // The index is searched by a worker thread, the
+        // files are listed when the search is finished
+        m_localLister->listFiles(url, QStringList(), false);
+        cancelIndexedSearch(url);
+
+        auto watcher = new QFutureWatcher<QStringList>(this);
+        connect(watcher, &QFutureWatcher<QStringList>::finished, this, [this, url, watcher]() {
+            m_searchWatchers.remove(url);
+            watcher->deleteLater();
+            m_localLister->addFiles(url, watcher->result(), true);
+        });
+        m_searchWatchers.insert(url, watcher);
+        watcher->setFuture(KFileNameSearchIndex::instance().search(url));
+    }
+}
+
+void KFileItemModelDirLister::cancelIndexedSearch(const QUrl& url)
+{
+    QFutureWatcher<QStringList>* watcher = m_searchWatchers.take(url);
+    if (watcher) {
+        disconnect(watcher, nullptr, this, nullptr);
+        watcher->deleteLater();
+    }
+}
+
+bool KFileItemModelDirLister::isIndexedSearch(const QUrl& url) const
+{
+    return m_indexedSearchEnabled && KFileNameSearchIndex::instance().isIndexed(url);
+}
+
+bool KFileItemModelDirLister::isContentSearch(const QUrl& url) const
+{
+    return m_contentSearchEnabled && KFileContentSearcher::isSupported(url);
+}
+
+QString KFileItemModelDirLister::itemKey(const QUrl& url, const KFileItem& item)
+{
+    return url.isLocalFile() ? item.name() : item.localPath();
+}
+
+void KFileItemModelDirLister::emitLocalChanges(const QUrl& url, LocalDirectory& directory)
+{
+    KFileItemList deletedItems;
+    QList<QPair<KFileItem, KFileItem> > refreshedItems;
+    KFileItemList addedItems;
+
+    for (auto it = directory.items.constBegin(); it != directory.items.constEnd(); ++it) {
+        const KFileItem& oldItem = it.value();
+        const bool wasShown = isShown(oldItem, m_emittedShowingDotFiles, m_emittedDirOnlyMode);
+
+        const auto updatedIt = directory.updatedItems.constFind(it.key());
+        if (updatedIt == directory.updatedItems.constEnd()) {
+            if (wasShown) {
+                deletedItems.append(oldItem);
+            }
+            continue;
+        }
+
+        const KFileItem& newItem = updatedIt.value();
+        const bool shown = isShown(newItem, m_emittedShowingDotFiles, m_emittedDirOnlyMode);
+        if (wasShown && shown) {
+            if (!oldItem.cmp(newItem)) {
+                refreshedItems.append(qMakePair(oldItem, newItem));
+            }
+        } else if (wasShown) {
+            deletedItems.append(oldItem);
+        } else if (shown) {
+            addedItems.append(newItem);
+        }
+    }
+
+    for (auto it = directory.updatedItems.constBegin(); it != directory.updatedItems.constEnd(); ++it) {
+        if (!directory.items.contains(it.key()) && isShown(it.value(), m_emittedShowingDotFiles, m_emittedDirOnlyMode)) {
+            addedItems.append(it.value());
+        }
+    }
+
+    directory.items.swap(directory.updatedItems);
+    directory.updatedItems.clear();
+    directory.updating = false;
+
+    if (!deletedItems.isEmpty()) {
+        Q_EMIT itemsDeleted(deletedItems);
+    }
+    if (!refreshedItems.isEmpty()) {
+        Q_EMIT refreshItems(refreshedItems);
+    }
+    if (!addedItems.isEmpty()) {
+        Q_EMIT itemsAdded(url, addedItems);
+    }
+}
+
+bool KFileItemModelDirLister::isShown(const KFileItem& item, bool showingDotFiles, bool dirOnlyMode)
+{
+    return (showingDotFiles || !item.isHidden()) && (!dirOnlyMode || item.isDir());
+}
+
+void KFileItemModelDirLister::emitCompleted(const QUrl& url)
+{
+#if KIO_VERSION < QT_VERSION_CHECK(5, 79, 0)
+    Q_EMIT completed(url);
+#else
+    Q_EMIT listingDirCompleted(url);
+#endif
+
+    if (!m_localLister->isListing()) {
+        Q_EMIT completed();
+    }
+}
+
+void KFileItemModelDirLister::emitCanceled(const QUrl& url)
+{
+#if KIO_VERSION < QT_VERSION_CHECK(5, 79, 0)
+    Q_EMIT canceled(url);
+#else
+    Q_EMIT listingDirCanceled(url);
+#endif
+
+    if (!m_localLister->isListing()) {
+        Q_EMIT canceled();
+    }
+}
@@ -10,13 +10,38 @@
 #include "dolphin_export.h"
 
 #include <KDirLister>
+#include <KIO/UDSEntry>
 
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QSet>
 #include <QUrl>
 
+class KDirWatch;
+class KFileContentSearcher;
+class KFileItemModelLocalLister;
+class QTimer;
+
 /**
  * @brief Extends the class KDirLister by emitting a signal when an
  *        error occurred instead of showing an error dialog.
  *        KDirLister::autoErrorHandlingEnabled() is set to false.
+ *
+ * If the local listing is enabled, local directories are listed by
+ * KFileItemModelLocalLister instead of KIO. The items are emitted by the
+ * same signals as KDirLister would do, and changes of the listed directories
+ * are detected by KDirWatch. While a local directory is listed, KDirLister
+ * forgets its directories, so that it does not report changes of them. The
+ * methods url(), rootItem(), updateDirectory() and isFinished() of KDirLister
+ * are not virtual, so they are hidden by the methods of this class that are
+ * aware of the local listing.
+ *
+ * If the indexed search is enabled, searches by file name in local folders
+ * are answered by KFileNameSearchIndex and the found files are listed like
+ * the items of a local directory. If the content search is enabled,
+ * searches for the content of local files are done by KFileContentSearcher
+ * and the found files are listed as soon as they are found.
  */
 class DOLPHIN_EXPORT KFileItemModelDirLister : public KDirLister
 {
@@ -26,6 +51,51 @@ public:
     explicit KFileItemModelDirLister(QObject* parent = nullptr);
     ~KFileItemModelDirLister() override;
 
+    /**
+     * Enables listing local directories without KIO. The change is
+     * applied the next time a directory is opened without
+     * KDirLister::Keep. Per default the local listing is disabled.
+     */
+    void setLocalListingEnabled(bool enabled);
+    bool isLocalListingEnabled() const;
+
+    /**
+     * Enables answering searches by file name from KFileNameSearchIndex.
+     * As long as the searched folder has not been indexed yet, the search
+     * is done by KIO. Per default the indexed search is disabled.
+     */
+    void setIndexedSearchEnabled(bool enabled);
+    bool isIndexedSearchEnabled() const;
+
+    /**
+     * Enables searching the content of local files by KFileContentSearcher
+     * instead of KIO. Per default the content search is disabled.
+     */
+    void setContentSearchEnabled(bool enabled);
+    bool isContentSearchEnabled() const;
+
+    /**
+     * @return True if the current directory is listed without KIO.
+     */
+    bool isListingLocally() const;
+
+    bool openUrl(const QUrl& url, OpenUrlFlags flags = NoFlags) override;
+    void stop() override;
+    void stop(const QUrl& url) override;
+    void emitChanges() override;
+
+    QUrl url() const;
+    KFileItem rootItem() const;
+    void updateDirectory(const QUrl& url);
+
+    /**
+     * Forgets the directory \a url, which has been listed with KDirLister::Keep,
+     * without removing its items. Changes of the directory are not watched
+     * and reported anymore, and emitChanges() does not apply to it.
+     */
+    void forgetDirectory(const QUrl& url);
+    bool isFinished() const;
+
 Q_SIGNALS:
     /** Is emitted whenever an error has occurred. */
     void errorMessage(const QString& msg);
@@ -36,8 +106,115 @@ Q_SIGNALS:
      */
     void urlIsFileError(const QUrl& url);
 
+    /**
+     * Is emitted if the number of entries of the directory \a url is known
+     * before its items are emitted, which is only the case if the directory
+     * is listed locally.
+     */
+    void entryCountKnown(const QUrl& url, int count);
+
 protected:
     void handleError(KIO::Job* job) override;
+
+private Q_SLOTS:
+    void slotDirectoryEntryListed(const QUrl& url, const KIO::UDSEntry& entry);
+    void slotEntriesListed(const QUrl& url, const KIO::UDSEntryList& entries);
+    void slotListingCompleted(const QUrl& url);
+    void slotListingFailed(const QUrl& url, int errorCode);
+    void slotDirectoryDirty(const QString& path);
+    void slotSearchIndexChanged(const QString& rootPath);
+    void slotContentFilesFound(const QUrl& url, const QStringList& paths);
+    void slotContentSearchCompleted(const QUrl& url);
+    void refreshDirtyDirectories();
+
+private:
+    struct LocalDirectory
+    {
+        // All items of the directory, including the hidden ones. The
+        // keys are the names of the items, see itemKey().
+        QHash<QString, KFileItem> items;
+        // Items that have been listed while updating the directory
+        QHash<QString, KFileItem> updatedItems;
+        bool updating = false;
+        // Is set if the directory has been changed while it is listed
+        bool dirty = false;
+        // Duration of the last listing in ms, see scheduleDirtyDirectoriesRefresh()
+        QElapsedTimer listingTimer;
+        qint64 listingTime = 0;
+    };
+
+    void openLocalDirectory(const QUrl& url);
+    void stopLocalListing();
+
+    /**
+     * Starts the timer that lists the dirty directories again, unless it
+     * is running already. The interval grows with the time that the
+     * last listing of the dirty directories has taken.
+     */
+    void scheduleDirtyDirectoriesRefresh();
+
+    /**
+     * Lists the directory \a url by the local lister. The results of
+     * searches are taken from KFileNameSearchIndex.
+     */
+    void listLocalDirectory(const QUrl& url);
+
+    /**
+     * Stops waiting for the results of the indexed search \a url.
+     */
+    void cancelIndexedSearch(const QUrl& url);
+
+    /**
+     * @return True if \a url is a search that can be answered by
+     *         KFileNameSearchIndex right now. The indexing is started
+     *         by openUrl() and updateDirectory().
+     */
+    bool isIndexedSearch(const QUrl& url) const;
+
+    /**
+     * @return True if \a url is a search that is done by KFileContentSearcher.
+     */
+    bool isContentSearch(const QUrl& url) const;
+
+    /**
+     * @return Key of \a item in LocalDirectory::items. The results of a
+     *         search are stored by their paths, as their names are not unique.
+     */
+    static QString itemKey(const QUrl& url, const KFileItem& item);
+
+    /**
+     * Emits the differences between the items and the updated items of \a directory.
+     */
+    void emitLocalChanges(const QUrl& url, LocalDirectory& directory);
+
+    /**
+     * @return True if \a item is emitted with the given settings for the
+     *         hidden files and the directory only mode.
+     */
+    static bool isShown(const KFileItem& item, bool showingDotFiles, bool dirOnlyMode);
+
+    void emitCompleted(const QUrl& url);
+    void emitCanceled(const QUrl& url);
+
+private:
+    bool m_localListingEnabled;
+    bool m_indexedSearchEnabled;
+    bool m_contentSearchEnabled;
+    bool m_listingLocally;
+    QUrl m_localUrl;
+    KFileItem m_localRootItem;
+    QHash<QUrl, LocalDirectory> m_localDirectories;
+    KFileItemModelLocalLister* m_localLister;
+    KFileContentSearcher* m_contentSearcher;
+    // Searches of KFileNameSearchIndex by the URLs of the searches
+    QHash<QUrl, QFutureWatcher<QStringList>*> m_searchWatchers;
+    KDirWatch* m_dirWatch;
+    QSet<QUrl> m_dirtyDirectories;
+    QTimer* m_dirtyDirectoriesTimer;
+
+    // Settings with which the local items have been emitted, see emitChanges()
+    bool m_emittedShowingDotFiles;
+    bool m_emittedDirOnlyMode;
 };
 
 #endif
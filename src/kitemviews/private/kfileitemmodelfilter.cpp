@@ -10,10 +10,17 @@
 
 #include <KFileItem>
 
+namespace {
+    bool isWildcardPattern(const QString& pattern)
+    {
+        return pattern.contains('*') || pattern.contains('?') || pattern.contains('[');
+    }
+}
+
 KFileItemModelFilter::KFileItemModelFilter() :
     m_useRegExp(false),
     m_regExp(nullptr),
-    m_lowerCasePattern(),
+    m_matcher(QString(), Qt::CaseInsensitive),
     m_pattern()
 {
 }
@@ -27,9 +34,9 @@ KFileItemModelFilter::~KFileItemModelFilter()
 void KFileItemModelFilter::setPattern(const QString& filter)
 {
     m_pattern = filter;
-    m_lowerCasePattern = filter.toLower();
+    m_matcher.setPattern(filter);
 
-    if (filter.contains('*') || filter.contains('?') || filter.contains('[')) {
+    if (isWildcardPattern(filter)) {
         if (!m_regExp) {
             m_regExp = new QRegularExpression();
             m_regExp->setPatternOptions(QRegularExpression::CaseInsensitiveOption);
@@ -46,6 +53,21 @@ QString KFileItemModelFilter::pattern() const
     return m_pattern;
 }
 
+bool KFileItemModelFilter::isNarrowedBy(const QString& pattern) const
+{
+    if (m_pattern.isEmpty()) {
+        return true;
+    }
+
+    if (m_useRegExp || isWildcardPattern(pattern)) {
+        return false;
+    }
+
+    // Each name that contains the new pattern contains the current
+    // pattern as well, e.g. when typing in the filter bar.
+    return pattern.contains(m_pattern, Qt::CaseInsensitive);
+}
+
 void KFileItemModelFilter::setMimeTypes(const QStringList& types)
 {
     m_mimeTypes = types;
@@ -90,7 +112,7 @@ bool KFileItemModelFilter::matchesPattern(const KFileItem& item) const
     if (m_useRegExp) {
         return m_regExp->match(item.text()).hasMatch();
     } else {
-        return item.text().toLower().contains(m_lowerCasePattern);
+        return m_matcher.indexIn(item.text()) >= 0;
     }
 }
 
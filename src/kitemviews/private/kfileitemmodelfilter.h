@@ -10,6 +10,7 @@
 #include "dolphin_export.h"
 
 #include <QStringList>
+#include <QStringMatcher>
 
 class KFileItem;
 class QRegularExpression;
@@ -38,6 +39,14 @@ public:
     void setPattern(const QString& pattern);
     QString pattern() const;
 
+    /**
+     * @return True if each item that matches with \a pattern also matches
+     *         with the current pattern. In this case changing the pattern
+     *         to \a pattern can only hide more items, so items that are
+     *         hidden already don't need to be checked again.
+     */
+    bool isNarrowedBy(const QString& pattern) const;
+
     /**
      * Set the list of mimetypes that are used for comparison with the
      * item in KFileItemModelFilter::matchesMimeType.
@@ -56,22 +65,26 @@ public:
      */
     bool matches(const KFileItem& item) const;
 
-private:
     /**
      * @return True if item matches pattern set by @ref setPattern.
+     *         May be invoked by several threads at the same time, as long
+     *         as the pattern is not changed.
      */
     bool matchesPattern(const KFileItem& item) const;
 
     /**
      * @return True if item matches mimetypes set by @ref setMimeTypes.
+     *         Must be invoked by the main thread, as the MIME-type of the
+     *         item might be determined.
      */
     bool matchesType(const KFileItem& item) const;
 
+private:
     bool m_useRegExp;           // If true, m_regExp is used for filtering,
-                                // otherwise m_lowerCaseFilter is used.
+                                // otherwise m_matcher is used.
     QRegularExpression *m_regExp;
-    QString m_lowerCasePattern; // Lowercase version of m_filter for
-                                // faster comparison in matches().
+    QStringMatcher m_matcher;   // Case insensitive matcher for m_pattern, which
+                                // compares without creating lowercase copies.
     QString m_pattern;          // Property set by setPattern().
     QStringList m_mimeTypes;    // Property set by setMimeTypes()
 };
@@ -0,0 +1,501 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kfileitemmodellocallister.h"
+#include "kfilestatengine.h"
+#include "ktaskscheduler.h"
+
+#include <KIO/Global>
+
+#include <QFile>
+#include <QThread>
+#include <QTimer>
+
+#ifndef Q_OS_WIN
+#include <QMutex>
+#include <QMutexLocker>
+#include <qplatformdefs.h>
+
+#include <cerrno>
+#include <climits>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // Number of entries whose status is read by one task. The first batch
+    // of a directory is smaller, so that the first items can be shown
+    // as soon as possible.
+    const int FirstBatchSize = 100;
+    const int BatchSize = 1000;
+}
+
+#ifndef Q_OS_WIN
+namespace {
+    // The names of the users and groups are cached, as
+    // most entries of a directory share the same owner.
+    QMutex s_namesMutex;
+    QHash<uid_t, QString> s_userNames;
+    QHash<gid_t, QString> s_groupNames;
+
+    QString userName(uid_t userId)
+    {
+        QMutexLocker locker(&s_namesMutex);
+        auto it = s_userNames.constFind(userId);
+        if (it == s_userNames.constEnd()) {
+            const struct passwd* user = getpwuid(userId);
+            const QString name = user ? QString::fromLocal8Bit(user->pw_name) : QString::number(userId);
+            it = s_userNames.insert(userId, name);
+        }
+        return it.value();
+    }
+
+    QString groupName(gid_t groupId)
+    {
+        QMutexLocker locker(&s_namesMutex);
+        auto it = s_groupNames.constFind(groupId);
+        if (it == s_groupNames.constEnd()) {
+            const struct group* group = getgrgid(groupId);
+            const QString name = group ? QString::fromLocal8Bit(group->gr_name) : QString::number(groupId);
+            it = s_groupNames.insert(groupId, name);
+        }
+        return it.value();
+    }
+
+    /**
+     * Creates the entry for \a name inside the directory \a dirFd with
+     * the same fields as the KIO file worker. \a fileStat is the status
+     * of the entry itself, also if it is a symbolic link.
+     */
+    void createEntry(int dirFd, const char* name, KFileStatEngine::Stat fileStat, KIO::UDSEntry& entry)
+    {
+        entry.reserve(10);
+        entry.fastInsert(KIO::UDSEntry::UDS_NAME, QFile::decodeName(name));
+
+        mode_t type = fileStat.mode & S_IFMT;
+        mode_t access = fileStat.mode & 07777;
+        if (S_ISLNK(fileStat.mode)) {
+            char linkTarget[PATH_MAX];
+            const ssize_t length = readlinkat(dirFd, name, linkTarget, sizeof(linkTarget));
+            if (length > 0) {
+                entry.fastInsert(KIO::UDSEntry::UDS_LINK_DEST, QFile::decodeName(QByteArray(linkTarget, length)));
+            }
+
+            // Links are described by their targets
+            KFileStatEngine::Stat targetStat;
+            if (KFileStatEngine::stat(dirFd, name, KFileStatEngine::NoFlags, targetStat)) {
+                fileStat = targetStat;
+                type = fileStat.mode & S_IFMT;
+                access = fileStat.mode & 07777;
+            } else {
+                // Broken link
+                type = S_IFMT - 1;
+                access = S_IRWXU | S_IRWXG | S_IRWXO;
+            }
+        }
+
+        entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, type);
+        entry.fastInsert(KIO::UDSEntry::UDS_ACCESS, access);
+        entry.fastInsert(KIO::UDSEntry::UDS_SIZE, fileStat.size);
+        entry.fastInsert(KIO::UDSEntry::UDS_MODIFICATION_TIME, fileStat.modificationTime);
+        entry.fastInsert(KIO::UDSEntry::UDS_ACCESS_TIME, fileStat.accessTime);
+        if (fileStat.creationTime >= 0) {
+            entry.fastInsert(KIO::UDSEntry::UDS_CREATION_TIME, fileStat.creationTime);
+        }
+        entry.fastInsert(KIO::UDSEntry::UDS_USER, userName(fileStat.userId));
+        entry.fastInsert(KIO::UDSEntry::UDS_GROUP, groupName(fileStat.groupId));
+    }
+
+    /**
+     * Creates the entry for \a name inside the directory \a dirFd.
+     * Returns false if the entry does not exist anymore.
+     */
+    bool createEntry(int dirFd, const char* name, KIO::UDSEntry& entry)
+    {
+        KFileStatEngine::Stat fileStat;
+        if (!KFileStatEngine::stat(dirFd, name, KFileStatEngine::NoFollowSymlinks, fileStat)) {
+            return false;
+        }
+
+        createEntry(dirFd, name, fileStat, entry);
+        return true;
+    }
+
+    int errorCodeForErrno(int error)
+    {
+        switch (error) {
+        case ENOENT:
+            return KIO::ERR_DOES_NOT_EXIST;
+        case ENOTDIR:
+            return KIO::ERR_IS_FILE;
+        case EACCES:
+        case EPERM:
+            return KIO::ERR_CANNOT_ENTER_DIRECTORY;
+        default:
+            return KIO::ERR_CANNOT_OPEN_FOR_READING;
+        }
+    }
+}
+#endif
+
+KFileItemModelLocalLister::KFileItemModelLocalLister(QObject* parent) :
+    QObject(parent),
+    m_listings()
+{
+}
+
+KFileItemModelLocalLister::~KFileItemModelLocalLister()
+{
+    // The running tasks only work on copies of the paths and names, so
+    // there is no need to wait for them. The watchers are deleted as
+    // children of this object.
+}
+
+bool KFileItemModelLocalLister::isSupported(const QUrl& url)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(url)
+    return false;
+#else
+    return url.isLocalFile();
+#endif
+}
+
+void KFileItemModelLocalLister::list(const QUrl& url)
+{
+    cancel(url);
+
+    Listing& listing = m_listings[url];
+    listing.path = url.toLocalFile();
+
+    auto watcher = new ContentsWatcher(this);
+    connect(watcher, &ContentsWatcher::finished, this, [this, url, watcher]() {
+        slotContentsRead(url, watcher);
+    });
+    listing.contentsWatcher = watcher;
+    watcher->setFuture(KTaskScheduler::instance().run(KTaskScheduler::Interactive, &KFileItemModelLocalLister::readDirectory, listing.path));
+}
+
+void KFileItemModelLocalLister::listFiles(const QUrl& url, const QStringList& paths, bool complete)
+{
+    cancel(url);
+
+    Listing& listing = m_listings[url];
+    listing.filesComplete = complete;
+    listing.pendingNames.reserve(paths.count());
+    for (const QString& path : paths) {
+        listing.pendingNames.append(QFile::encodeName(path));
+    }
+    startBatches();
+
+    // Like for directories, the listing is completed asynchronously even if no files are given
+    QTimer::singleShot(0, this, [this, url]() {
+        checkCompleted(url);
+    });
+}
+
+void KFileItemModelLocalLister::addFiles(const QUrl& url, const QStringList& paths, bool complete)
+{
+    auto it = m_listings.find(url);
+    if (it == m_listings.end()) {
+        return;
+    }
+
+    Q_ASSERT(it->path.isEmpty());
+    for (const QString& path : paths) {
+        it->pendingNames.append(QFile::encodeName(path));
+    }
+    it->filesComplete = complete;
+
+    startBatches();
+    checkCompleted(url);
+}
+
+void KFileItemModelLocalLister::cancel(const QUrl& url)
+{
+    auto it = m_listings.find(url);
+    if (it != m_listings.end()) {
+        deleteWatchers(it.value());
+        m_listings.erase(it);
+        startBatches();
+    }
+}
+
+void KFileItemModelLocalLister::cancelAll()
+{
+    for (Listing& listing : m_listings) {
+        deleteWatchers(listing);
+    }
+    m_listings.clear();
+}
+
+bool KFileItemModelLocalLister::isListing(const QUrl& url) const
+{
+    return m_listings.contains(url);
+}
+
+bool KFileItemModelLocalLister::isListing() const
+{
+    return !m_listings.isEmpty();
+}
+
+void KFileItemModelLocalLister::slotContentsRead(const QUrl& url, ContentsWatcher* watcher)
+{
+    watcher->deleteLater();
+
+    auto it = m_listings.find(url);
+    Q_ASSERT(it != m_listings.end() && it->contentsWatcher == watcher);
+    it->contentsWatcher = nullptr;
+
+    const DirectoryContents contents = watcher->result();
+    if (contents.errorCode != 0) {
+        m_listings.erase(it);
+        Q_EMIT listingFailed(url, contents.errorCode);
+        return;
+    }
+
+    it->pendingNames = contents.names;
+    Q_EMIT entryCountKnown(url, contents.names.count());
+    Q_EMIT directoryEntryListed(url, contents.directoryEntry);
+
+    // The directory might have been canceled by a slot connected to directoryEntryListed()
+    if (isListing(url)) {
+        startBatches();
+        checkCompleted(url);
+    }
+}
+
+void KFileItemModelLocalLister::slotBatchFinished(const QUrl& url, BatchWatcher* watcher)
+{
+    watcher->deleteLater();
+
+    auto it = m_listings.find(url);
+    Q_ASSERT(it != m_listings.end());
+    it->batchWatchers.removeOne(watcher);
+
+    const KIO::UDSEntryList entries = watcher->result();
+    startBatches();
+
+    if (!entries.isEmpty()) {
+        Q_EMIT entriesListed(url, entries);
+    }
+    checkCompleted(url);
+}
+
+void KFileItemModelLocalLister::startBatches()
+{
+    const int maximumRunningBatches = qMax(2, QThread::idealThreadCount());
+    int runningBatches = runningBatchesCount();
+
+    // Start one batch for each directory in turn, so that expanding
+    // a folder is not blocked by a large directory that is listed.
+    bool started = true;
+    while (started && runningBatches < maximumRunningBatches) {
+        started = false;
+        for (auto it = m_listings.begin(); it != m_listings.end() && runningBatches < maximumRunningBatches; ++it) {
+            Listing& listing = it.value();
+            if (listing.pendingNames.isEmpty()) {
+                continue;
+            }
+
+            const int count = qMin(listing.batchesStarted ? BatchSize : FirstBatchSize, listing.pendingNames.count());
+            const QVector<QByteArray> names = listing.pendingNames.mid(0, count);
+            listing.pendingNames.remove(0, count);
+
+            const QUrl url = it.key();
+            auto watcher = new BatchWatcher(this);
+            connect(watcher, &BatchWatcher::finished, this, [this, url, watcher]() {
+                slotBatchFinished(url, watcher);
+            });
+            listing.batchWatchers.append(watcher);
+            listing.batchesStarted = true;
+            watcher->setFuture(KTaskScheduler::instance().run(KTaskScheduler::Interactive, &KFileItemModelLocalLister::readEntries, listing.path, names));
+
+            ++runningBatches;
+            started = true;
+        }
+    }
+}
+
+void KFileItemModelLocalLister::checkCompleted(const QUrl& url)
+{
+    auto it = m_listings.find(url);
+    if (it == m_listings.end()) {
+        return;
+    }
+
+    const Listing& listing = it.value();
+    if (!listing.contentsWatcher && listing.filesComplete && listing.pendingNames.isEmpty() && listing.batchWatchers.isEmpty()) {
+        m_listings.erase(it);
+        Q_EMIT listingCompleted(url);
+    }
+}
+
+void KFileItemModelLocalLister::deleteWatchers(Listing& listing)
+{
+    if (listing.contentsWatcher) {
+        disconnect(listing.contentsWatcher, nullptr, this, nullptr);
+        listing.contentsWatcher->deleteLater();
+        listing.contentsWatcher = nullptr;
+    }
+
+    for (BatchWatcher* watcher : qAsConst(listing.batchWatchers)) {
+        disconnect(watcher, nullptr, this, nullptr);
+        watcher->deleteLater();
+    }
+    listing.batchWatchers.clear();
+    listing.pendingNames.clear();
+}
+
+int KFileItemModelLocalLister::runningBatchesCount() const
+{
+    int count = 0;
+    for (const Listing& listing : m_listings) {
+        count += listing.batchWatchers.count();
+    }
+    return count;
+}
+
+KFileItemModelLocalLister::DirectoryContents KFileItemModelLocalLister::readDirectory(const QString& path)
+{
+    DirectoryContents contents;
+
+#ifdef Q_OS_WIN
+    Q_UNUSED(path)
+    contents.errorCode = KIO::ERR_UNSUPPORTED_ACTION;
+#else
+    const int dirFd = open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        contents.errorCode = errorCodeForErrno(errno);
+        return contents;
+    }
+
+    if (!createEntry(dirFd, ".", contents.directoryEntry)) {
+        contents.errorCode = errorCodeForErrno(errno);
+        QT_CLOSE(dirFd);
+        return contents;
+    }
+
+    QT_DIR* dir = fdopendir(dirFd);
+    if (!dir) {
+        contents.errorCode = errorCodeForErrno(errno);
+        QT_CLOSE(dirFd);
+        return contents;
+    }
+
+    QT_DIRENT* dirEntry;
+    while ((dirEntry = QT_READDIR(dir))) {
+        const char* name = dirEntry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            // Skip "." and ".."
+            continue;
+        }
+        contents.names.append(QByteArray(name));
+    }
+    QT_CLOSEDIR(dir);
+#endif
+
+    return contents;
+}
+
+KIO::UDSEntryList KFileItemModelLocalLister::readEntries(const QString& path, const QVector<QByteArray>& names)
+{
+    if (path.isEmpty()) {
+        return readFileEntries(names);
+    }
+
+    KIO::UDSEntryList entries;
+
+#ifdef Q_OS_WIN
+    Q_UNUSED(path)
+    Q_UNUSED(names)
+#else
+    const int dirFd = open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        return entries;
+    }
+
+    // The status of the whole batch is requested at once
+    QVector<KFileStatEngine::Stat> fileStats;
+    const QVector<bool> found = KFileStatEngine::statBatch(dirFd, names, KFileStatEngine::NoFollowSymlinks, fileStats);
+
+    entries.reserve(names.count());
+    for (int i = 0; i < names.count(); ++i) {
+        if (found.at(i)) {
+            KIO::UDSEntry entry;
+            createEntry(dirFd, names.at(i).constData(), fileStats.at(i), entry);
+            entries.append(entry);
+        }
+    }
+    QT_CLOSE(dirFd);
+#endif
+
+    return entries;
+}
+
+KIO::UDSEntryList KFileItemModelLocalLister::readFileEntries(const QVector<QByteArray>& paths)
+{
+    KIO::UDSEntryList entries;
+
+#ifdef Q_OS_WIN
+    Q_UNUSED(paths)
+#else
+    entries.reserve(paths.count());
+
+    // Each folder is opened once for its adjacent files, and
+    // the status of these files is requested at once
+    int index = 0;
+    while (index < paths.count()) {
+        const QByteArray& path = paths.at(index);
+        const int slash = path.lastIndexOf('/');
+        if (slash < 0 || slash == path.length() - 1) {
+            ++index;
+            continue;
+        }
+
+        const QByteArray dirPath = (slash == 0) ? QByteArray("/") : path.left(slash);
+        QVector<QByteArray> names;
+        QVector<int> pathIndexes;
+        for (; index < paths.count(); ++index) {
+            const QByteArray& adjacentPath = paths.at(index);
+            const int adjacentSlash = adjacentPath.lastIndexOf('/');
+            if (adjacentSlash != slash || adjacentSlash == adjacentPath.length() - 1 || !adjacentPath.startsWith(dirPath)) {
+                break;
+            }
+            names.append(adjacentPath.mid(slash + 1));
+            pathIndexes.append(index);
+        }
+
+        const int dirFd = open(dirPath.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dirFd < 0) {
+            continue;
+        }
+
+        QVector<KFileStatEngine::Stat> fileStats;
+        const QVector<bool> found = KFileStatEngine::statBatch(dirFd, names, KFileStatEngine::NoFollowSymlinks, fileStats);
+        for (int i = 0; i < names.count(); ++i) {
+            if (!found.at(i)) {
+                continue;
+            }
+
+            KIO::UDSEntry entry;
+            createEntry(dirFd, names.at(i).constData(), fileStats.at(i), entry);
+            const QString localPath = QFile::decodeName(paths.at(pathIndexes.at(i)));
+            entry.fastInsert(KIO::UDSEntry::UDS_URL, QUrl::fromLocalFile(localPath).toString());
+            entry.fastInsert(KIO::UDSEntry::UDS_LOCAL_PATH, localPath);
+            entries.append(entry);
+        }
+        QT_CLOSE(dirFd);
+    }
+#endif
+
+    return entries;
+}
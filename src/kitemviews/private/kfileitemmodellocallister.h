@@ -0,0 +1,167 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KFILEITEMMODELLOCALLISTER_H
+#define KFILEITEMMODELLOCALLISTER_H
+
+#include "dolphin_export.h"
+
+#include <KIO/UDSEntry>
+
+#include <QByteArray>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QStringList>
+#include <QUrl>
+#include <QVector>
+
+/**
+ * @brief Lists local directories in worker threads without using KIO.
+ *
+ * Listing a directory by KIO requires the file worker process, which
+ * serializes each entry and passes it to the application. For large local
+ * directories reading the entries directly is considerably faster:
+ * The names of the entries are read by one task, and the status of the
+ * entries is read in batches on a thread pool. The entries of each batch
+ * are emitted by entriesListed() as soon as the batch has been finished,
+ * so that the owner can show the first items before all entries are known.
+ *
+ * As KFileItem is not thread-safe, the worker threads only create
+ * KIO::UDSEntry instances, like the KIO file worker does. The owner
+ * creates the items.
+ */
+class DOLPHIN_EXPORT KFileItemModelLocalLister : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KFileItemModelLocalLister(QObject* parent = nullptr);
+    ~KFileItemModelLocalLister() override;
+
+    /**
+     * @return True if the directory \a url can be listed. This is the
+     *         case for local URLs on platforms that provide the
+     *         POSIX directory functions.
+     */
+    static bool isSupported(const QUrl& url);
+
+    /**
+     * Starts listing the directory \a url. If the directory is being
+     * listed already, the listing is started again.
+     */
+    void list(const QUrl& url);
+
+    /**
+     * Starts listing the files and folders \a paths as the contents of
+     * \a url, e.g. the results of a search. The entries contain the URLs of
+     * the files, see KIO::UDSEntry::UDS_URL. The signals
+     * directoryEntryListed() and entryCountKnown() are not emitted for \a url.
+     * Paths of the same folder should be adjacent.
+     *
+     * If \a complete is false, more files are added by addFiles()
+     * before the listing can be completed.
+     */
+    void listFiles(const QUrl& url, const QStringList& paths, bool complete = true);
+
+    /**
+     * Adds the files and folders \a paths to the listing \a url, which
+     * has been started by listFiles(). If \a complete is true, no more
+     * files are added.
+     */
+    void addFiles(const QUrl& url, const QStringList& paths, bool complete);
+
+    /**
+     * Stops listing the directory \a url. No signals are emitted for the
+     * directory anymore, the results of running tasks are ignored.
+     */
+    void cancel(const QUrl& url);
+    void cancelAll();
+
+    bool isListing(const QUrl& url) const;
+    bool isListing() const;
+
+Q_SIGNALS:
+    /**
+     * Is emitted once for each listing before the entries of the directory
+     * \a url are emitted. \a entry describes the directory itself and has
+     * the name ".".
+     */
+    void directoryEntryListed(const QUrl& url, const KIO::UDSEntry& entry);
+
+    /**
+     * Is emitted before directoryEntryListed() when the names of the entries
+     * of the directory \a url have been read. \a count is the number of
+     * entries, which are emitted by entriesListed() afterwards.
+     */
+    void entryCountKnown(const QUrl& url, int count);
+
+    /**
+     * Is emitted for each batch of entries of the directory \a url, which
+     * have been read. \a entries is never empty and does not contain
+     * "." and "..".
+     */
+    void entriesListed(const QUrl& url, const KIO::UDSEntryList& entries);
+
+    /**
+     * Is emitted after the last entries of the directory \a url have been emitted.
+     */
+    void listingCompleted(const QUrl& url);
+
+    /**
+     * Is emitted if the directory \a url cannot be read. \a errorCode
+     * is a KIO::Error.
+     */
+    void listingFailed(const QUrl& url, int errorCode);
+
+private:
+    struct DirectoryContents
+    {
+        KIO::UDSEntry directoryEntry;
+        QVector<QByteArray> names;
+        int errorCode = 0;
+    };
+
+    typedef QFutureWatcher<DirectoryContents> ContentsWatcher;
+    typedef QFutureWatcher<KIO::UDSEntryList> BatchWatcher;
+
+    struct Listing
+    {
+        QString path;   // Empty if files are listed, see listFiles()
+        ContentsWatcher* contentsWatcher = nullptr;
+        QVector<QByteArray> pendingNames; // Names whose status has not been requested yet, or paths of the files
+        QList<BatchWatcher*> batchWatchers;
+        bool batchesStarted = false;
+        bool filesComplete = true;  // Is false while listFiles() awaits more files
+    };
+
+    void slotContentsRead(const QUrl& url, ContentsWatcher* watcher);
+    void slotBatchFinished(const QUrl& url, BatchWatcher* watcher);
+
+    /**
+     * Starts reading the status of the pending names of all
+     * listings until the maximum number of running batches is reached.
+     */
+    void startBatches();
+
+    /**
+     * Emits listingCompleted() if all entries of \a url have been emitted.
+     */
+    void checkCompleted(const QUrl& url);
+
+    void deleteWatchers(Listing& listing);
+    int runningBatchesCount() const;
+
+    static DirectoryContents readDirectory(const QString& path);
+    static KIO::UDSEntryList readEntries(const QString& path, const QVector<QByteArray>& names);
+    static KIO::UDSEntryList readFileEntries(const QVector<QByteArray>& paths);
+
+private:
+    QHash<QUrl, Listing> m_listings;
+};
+
+#endif
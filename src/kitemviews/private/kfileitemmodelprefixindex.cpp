@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kfileitemmodelprefixindex.h"
+
+#include <algorithm>
+
+KFileItemModelPrefixIndex::KFileItemModelPrefixIndex() :
+    m_entries(),
+    m_built(false)
+{
+}
+
+void KFileItemModelPrefixIndex::build(const QVector<QString>& names)
+{
+    const int count = names.count();
+    m_entries.clear();
+    m_entries.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        m_entries.append({names.at(i).toCaseFolded(), i});
+    }
+
+    // The names are compared by their code units: All names
+    // starting with the same text are stored next to each other.
+    std::sort(m_entries.begin(), m_entries.end(), [](const Entry& a, const Entry& b) {
+        return a.foldedName < b.foldedName || (a.foldedName == b.foldedName && a.index < b.index);
+    });
+
+    m_built = true;
+}
+
+void KFileItemModelPrefixIndex::clear()
+{
+    m_entries.clear();
+    m_entries.squeeze();
+    m_built = false;
+}
+
+bool KFileItemModelPrefixIndex::isBuilt() const
+{
+    return m_built;
+}
+
+int KFileItemModelPrefixIndex::indexOf(const QString& text, int startFromIndex) const
+{
+    const QString foldedText = text.toCaseFolded();
+
+    auto it = std::lower_bound(m_entries.constBegin(), m_entries.constEnd(), foldedText, [](const Entry& entry, const QString& text) {
+        return entry.foldedName < text;
+    });
+
+    // Only the model indexes of the matching names must be
+    // compared, which is cheap even for a short text.
+    int index = -1;
+    int wrappedIndex = -1;
+    for (; it != m_entries.constEnd() && it->foldedName.startsWith(foldedText); ++it) {
+        if (it->index >= startFromIndex) {
+            if (index < 0 || it->index < index) {
+                index = it->index;
+            }
+        } else if (wrappedIndex < 0 || it->index < wrappedIndex) {
+            wrappedIndex = it->index;
+        }
+    }
+
+    return (index >= 0) ? index : wrappedIndex;
+}
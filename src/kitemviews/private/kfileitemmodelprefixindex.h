@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KFILEITEMMODELPREFIXINDEX_H
+#define KFILEITEMMODELPREFIXINDEX_H
+
+#include "dolphin_export.h"
+
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Finds the items whose names start with a text by a binary search.
+ *
+ * KFileItemModel::indexForKeyboardSearch() is invoked for each character
+ * that is typed in a view. Comparing the text with the names of all items
+ * gets noticeable in directories with hundred thousands of items. The prefix
+ * index keeps the case folded names sorted together with their model indexes,
+ * so that all names starting with the text can be found by a binary search.
+ *
+ * The index does not follow changes of the model: It must be cleared if
+ * items are inserted, removed, moved or renamed, and built again before
+ * the next search.
+ */
+class DOLPHIN_EXPORT KFileItemModelPrefixIndex
+{
+public:
+    KFileItemModelPrefixIndex();
+
+    /**
+     * Builds the index for \a names. The name of the item with the model
+     * index i must be stored at the position i.
+     */
+    void build(const QVector<QString>& names);
+    void clear();
+
+    /**
+     * @return True if build() has been invoked since the last clear().
+     */
+    bool isBuilt() const;
+
+    /**
+     * @return The first index equal to or greater than \a startFromIndex
+     *         whose name starts with \a text. If there is no such index,
+     *         the first index whose name starts with \a text is returned.
+     *         Returns -1 if no name starts with \a text. The comparison is
+     *         case insensitive.
+     */
+    int indexOf(const QString& text, int startFromIndex) const;
+
+private:
+    struct Entry
+    {
+        QString foldedName;
+        int index;
+    };
+
+    QVector<Entry> m_entries; // Sorted by foldedName and index
+    bool m_built;
+};
+
+#endif
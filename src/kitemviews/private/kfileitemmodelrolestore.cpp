@@ -0,0 +1,101 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kfileitemmodelrolestore.h"
+
+KFileItemModelRoleStore::KFileItemModelRoleStore() :
+    m_strings(),
+    m_stringIds(),
+    m_freeSlots()
+{
+}
+
+int KFileItemModelRoleStore::acquireSlot()
+{
+    if (!m_freeSlots.isEmpty()) {
+        const int slot = m_freeSlots.takeLast();
+        resetSlot(slot);
+        return slot;
+    }
+
+    const int slot = slotCount();
+    for (int i = 0; i < Int64ColumnsCount; ++i) {
+        m_int64Columns[i].append(-1);
+    }
+    for (int i = 0; i < StringColumnsCount; ++i) {
+        m_stringColumns[i].append(-1);
+    }
+    return slot;
+}
+
+void KFileItemModelRoleStore::releaseSlot(int slot)
+{
+    Q_ASSERT(slot >= 0 && slot < slotCount());
+    m_freeSlots.append(slot);
+}
+
+qint64 KFileItemModelRoleStore::memoryUsage() const
+{
+    qint64 bytes = 0;
+    for (int i = 0; i < Int64ColumnsCount; ++i) {
+        bytes += qint64(m_int64Columns[i].capacity()) * sizeof(qint64);
+    }
+    for (int i = 0; i < StringColumnsCount; ++i) {
+        bytes += qint64(m_stringColumns[i].capacity()) * sizeof(int);
+    }
+    for (const QString& string : m_strings) {
+        // The string is shared by m_strings and m_stringIds
+        bytes += 2 * sizeof(QString) + sizeof(int) + string.capacity() * sizeof(QChar);
+    }
+    bytes += qint64(m_freeSlots.capacity()) * sizeof(int);
+    return bytes;
+}
+
+void KFileItemModelRoleStore::clear()
+{
+    for (int i = 0; i < Int64ColumnsCount; ++i) {
+        m_int64Columns[i].clear();
+    }
+    for (int i = 0; i < StringColumnsCount; ++i) {
+        m_stringColumns[i].clear();
+    }
+    m_strings.clear();
+    m_stringIds.clear();
+    m_freeSlots.clear();
+}
+
+void KFileItemModelRoleStore::setInt64(int slot, Int64Column column, qint64 value)
+{
+    m_int64Columns[column][slot] = value;
+}
+
+void KFileItemModelRoleStore::setString(int slot, StringColumn column, const QString& value)
+{
+    m_stringColumns[column][slot] = internString(value);
+}
+
+void KFileItemModelRoleStore::resetSlot(int slot)
+{
+    for (int i = 0; i < Int64ColumnsCount; ++i) {
+        m_int64Columns[i][slot] = -1;
+    }
+    for (int i = 0; i < StringColumnsCount; ++i) {
+        m_stringColumns[i][slot] = -1;
+    }
+}
+
+int KFileItemModelRoleStore::internString(const QString& value)
+{
+    const auto it = m_stringIds.constFind(value);
+    if (it != m_stringIds.constEnd()) {
+        return it.value();
+    }
+
+    const int id = m_strings.count();
+    m_strings.append(value);
+    m_stringIds.insert(value, id);
+    return id;
+}
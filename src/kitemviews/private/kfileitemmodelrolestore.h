@@ -0,0 +1,140 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KFILEITEMMODELROLESTORE_H
+#define KFILEITEMMODELROLESTORE_H
+
+#include "dolphin_export.h"
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Columnar storage for role values of KFileItemModel.
+ *
+ * Each item of the model gets a slot, and for each supported role a
+ * compact array stores the values of all slots. Numeric values like times
+ * and sizes are stored as 64-bit integers, string values like the owner
+ * or the group of an item are interned, so that each distinct string is
+ * stored only once.
+ *
+ * Compared to a QHash<QByteArray, QVariant> per item this saves a lot
+ * of memory for huge directories, and accessing the values while sorting
+ * does neither require hash lookups nor QVariant conversions.
+ *
+ * Reading values is reentrant as long as no slot or value is changed
+ * concurrently.
+ */
+class DOLPHIN_EXPORT KFileItemModelRoleStore
+{
+public:
+    enum Int64Column {
+        ModificationTimeColumn,
+        CreationTimeColumn,
+        AccessTimeColumn,
+        SizeColumn,
+        DeletionTimeColumn, // Milliseconds since the epoch, only set for items in the trash
+        Int64ColumnsCount
+    };
+
+    enum StringColumn {
+        PermissionsColumn,
+        OwnerColumn,
+        GroupColumn,
+        StringColumnsCount
+    };
+
+    KFileItemModelRoleStore();
+
+    /**
+     * @return A free slot for storing the values of an item. All values of
+     *         the slot are unset.
+     */
+    int acquireSlot();
+
+    /**
+     * Marks the slot \a slot as free, so that it may be reused by acquireSlot().
+     */
+    void releaseSlot(int slot);
+
+    /**
+     * Releases all slots and interned strings at once.
+     */
+    void clear();
+
+    void setInt64(int slot, Int64Column column, qint64 value);
+
+    /**
+     * @return The value of \a column for \a slot, or -1 if no value has been set.
+     */
+    qint64 int64(int slot, Int64Column column) const;
+
+    void setString(int slot, StringColumn column, const QString& value);
+
+    /**
+     * @return The value of \a column for \a slot. An empty string is returned
+     *         if no value has been set.
+     */
+    const QString& string(int slot, StringColumn column) const;
+
+    /**
+     * @return True if a value for \a column has been set for \a slot.
+     */
+    bool hasString(int slot, StringColumn column) const;
+
+    /**
+     * Resets all values of \a slot.
+     */
+    void resetSlot(int slot);
+
+    /**
+     * @return Number of slots including the free ones.
+     */
+    int slotCount() const;
+
+    /**
+     * @return Estimated number of bytes used by the columns and the interned strings.
+     */
+    qint64 memoryUsage() const;
+
+private:
+    int internString(const QString& value);
+
+private:
+    QVector<qint64> m_int64Columns[Int64ColumnsCount];
+
+    // Each entry is an index into m_strings, or -1 if no value is set.
+    QVector<int> m_stringColumns[StringColumnsCount];
+    QVector<QString> m_strings;
+    QHash<QString, int> m_stringIds;
+
+    QVector<int> m_freeSlots;
+};
+
+inline qint64 KFileItemModelRoleStore::int64(int slot, Int64Column column) const
+{
+    return m_int64Columns[column].at(slot);
+}
+
+inline const QString& KFileItemModelRoleStore::string(int slot, StringColumn column) const
+{
+    static const QString empty;
+    const int id = m_stringColumns[column].at(slot);
+    return id < 0 ? empty : m_strings.at(id);
+}
+
+inline bool KFileItemModelRoleStore::hasString(int slot, StringColumn column) const
+{
+    return m_stringColumns[column].at(slot) >= 0;
+}
+
+inline int KFileItemModelRoleStore::slotCount() const
+{
+    return m_int64Columns[0].count();
+}
+
+#endif
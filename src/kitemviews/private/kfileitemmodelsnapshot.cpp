@@ -0,0 +1,163 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kfileitemmodelsnapshot.h"
+
+#include "kitemviews/kfileitemmodel.h"
+
+#include <climits>
+
+KFileItemModelSnapshot::KFileItemModelSnapshot() :
+    m_chunks(),
+    m_chunkSize(1),
+    m_count(0)
+{
+}
+
+KFileItem KFileItemModelSnapshot::fileItem(int index) const
+{
+    if (index < 0 || index >= m_count) {
+        return KFileItem();
+    }
+    return entry(index).item;
+}
+
+QHash<QByteArray, QVariant> KFileItemModelSnapshot::data(int index) const
+{
+    if (index < 0 || index >= m_count) {
+        return QHash<QByteArray, QVariant>();
+    }
+    return entry(index).values;
+}
+
+qint64 KFileItemModelSnapshot::int64(int index, KFileItemModelRoleStore::Int64Column column) const
+{
+    if (index < 0 || index >= m_count) {
+        return -1;
+    }
+    return entry(index).int64Values[column];
+}
+
+QString KFileItemModelSnapshot::string(int index, KFileItemModelRoleStore::StringColumn column) const
+{
+    if (index < 0 || index >= m_count) {
+        return QString();
+    }
+    return entry(index).stringValues[column];
+}
+
+bool KFileItemModelSnapshot::sharesChunk(const KFileItemModelSnapshot& other, int index) const
+{
+    if (index < 0 || index >= m_count || index >= other.m_count || m_chunkSize != other.m_chunkSize) {
+        return false;
+    }
+
+    const int chunk = index / m_chunkSize;
+    return m_chunks.at(chunk) == other.m_chunks.at(chunk);
+}
+
+KFileItemModelSnapshotTracker::KFileItemModelSnapshotTracker(KFileItemModel* model, int chunkSize) :
+    QObject(model),
+    m_model(model),
+    m_chunkSize(chunkSize),
+    m_chunks(),
+    m_firstShiftedIndex(0),
+    m_changedChunks()
+{
+    Q_ASSERT(chunkSize > 0);
+
+    connect(model, &KFileItemModel::itemsInserted, this, &KFileItemModelSnapshotTracker::slotItemsInsertedOrRemoved);
+    connect(model, &KFileItemModel::itemsRemoved, this, &KFileItemModelSnapshotTracker::slotItemsInsertedOrRemoved);
+    connect(model, &KFileItemModel::itemsMoved, this, &KFileItemModelSnapshotTracker::slotItemsMoved);
+    connect(model, &KFileItemModel::itemsChanged, this, &KFileItemModelSnapshotTracker::slotItemsChanged);
+}
+
+KFileItemModelSnapshotTracker::~KFileItemModelSnapshotTracker()
+{
+}
+
+KFileItemModelSnapshot KFileItemModelSnapshotTracker::snapshot()
+{
+    const QList<KFileItemModel::ItemData*>& itemData = m_model->m_itemData;
+    const KFileItemModelRoleStore& roleStore = m_model->m_roleStore;
+    const int count = itemData.count();
+    const int chunkCount = (count + m_chunkSize - 1) / m_chunkSize;
+    const int firstShiftedChunk = qMin(m_firstShiftedIndex, count) / m_chunkSize;
+
+    KFileItemModelSnapshot snapshot;
+    snapshot.m_chunkSize = m_chunkSize;
+    snapshot.m_count = count;
+    snapshot.m_chunks.reserve(chunkCount);
+    m_chunks.resize(chunkCount);
+
+    for (int chunk = 0; chunk < chunkCount; ++chunk) {
+        QSharedPointer<const KFileItemModelSnapshot::Chunk> entries;
+        if (chunk < firstShiftedChunk && !m_changedChunks.contains(chunk)) {
+            // Is null if no snapshot uses the chunk anymore
+            entries = m_chunks.at(chunk).toStrongRef();
+        }
+
+        if (!entries) {
+            const int first = chunk * m_chunkSize;
+            const int last = qMin(first + m_chunkSize, count);
+            auto newEntries = QSharedPointer<KFileItemModelSnapshot::Chunk>::create();
+            newEntries->reserve(last - first);
+            for (int i = first; i < last; ++i) {
+                const KFileItemModel::ItemData* data = itemData.at(i);
+                KFileItemModelSnapshot::Entry entry{data->item, data->values, {}, {}};
+                for (int column = 0; column < KFileItemModelRoleStore::Int64ColumnsCount; ++column) {
+                    entry.int64Values[column] = roleStore.int64(data->slot, static_cast<KFileItemModelRoleStore::Int64Column>(column));
+                }
+                for (int column = 0; column < KFileItemModelRoleStore::StringColumnsCount; ++column) {
+                    entry.stringValues[column] = roleStore.string(data->slot, static_cast<KFileItemModelRoleStore::StringColumn>(column));
+                }
+                newEntries->append(entry);
+            }
+            entries = newEntries;
+            m_chunks[chunk] = entries;
+        }
+
+        snapshot.m_chunks.append(entries);
+    }
+
+    m_firstShiftedIndex = INT_MAX;
+    m_changedChunks.clear();
+    return snapshot;
+}
+
+void KFileItemModelSnapshotTracker::slotItemsInsertedOrRemoved(const KItemRangeList& itemRanges)
+{
+    if (!itemRanges.isEmpty()) {
+        m_firstShiftedIndex = qMin(m_firstShiftedIndex, itemRanges.first().index);
+    }
+}
+
+void KFileItemModelSnapshotTracker::slotItemsMoved(const KItemRange& itemRange, const QList<int>& movedToIndexes)
+{
+    // The items are moved inside the range
+    Q_UNUSED(movedToIndexes)
+    markChunksChanged(itemRange);
+}
+
+void KFileItemModelSnapshotTracker::slotItemsChanged(const KItemRangeList& itemRanges, const QSet<QByteArray>& roles)
+{
+    Q_UNUSED(roles)
+    for (const KItemRange& range : itemRanges) {
+        markChunksChanged(range);
+    }
+}
+
+void KFileItemModelSnapshotTracker::markChunksChanged(const KItemRange& itemRange)
+{
+    if (itemRange.count <= 0 || itemRange.index >= m_firstShiftedIndex) {
+        return;
+    }
+
+    const int lastChunk = (itemRange.index + itemRange.count - 1) / m_chunkSize;
+    for (int chunk = itemRange.index / m_chunkSize; chunk <= lastChunk; ++chunk) {
+        m_changedChunks.insert(chunk);
+    }
+}
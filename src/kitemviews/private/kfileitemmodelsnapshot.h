@@ -0,0 +1,162 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KFILEITEMMODELSNAPSHOT_H
+#define KFILEITEMMODELSNAPSHOT_H
+
+#include "dolphin_export.h"
+#include "kitemviews/kitemrange.h"
+#include "kitemviews/private/kfileitemmodelrolestore.h"
+
+#include <KFileItem>
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#include <QVariant>
+#include <QVector>
+#include <QWeakPointer>
+
+#include <array>
+
+class KFileItemModel;
+
+/**
+ * @brief Immutable view of the items of a KFileItemModel.
+ *
+ * Contains the items, their role values and the values of the columns of
+ * KFileItemModelRoleStore in the order of the model at the time the
+ * snapshot has been taken by KFileItemModel::itemsSnapshot(). Snapshots
+ * may be copied cheaply and stay unchanged while the model is changed, so
+ * work that is spread over several iterations of the event loop gets a
+ * consistent view of the items.
+ *
+ * Snapshots may only be used in the GUI thread: KFileItem determines its
+ * MIME-type lazily, and the pixmaps of the role values must not be
+ * destroyed by other threads.
+ *
+ * The items are stored in chunks that are shared between consecutive
+ * snapshots. Taking a snapshot after a change only copies the chunks
+ * that contain changed items, or the chunks behind the first inserted,
+ * removed or moved item.
+ *
+ * The role values are the values that the model has retrieved so far,
+ * see KFileItemModel::data(). Values that have not been requested by a
+ * view yet are not contained.
+ *
+ * Not to be confused with the snapshots of recently shown directories,
+ * see KFileItemModel::setSnapshotsEnabled().
+ */
+class DOLPHIN_EXPORT KFileItemModelSnapshot
+{
+public:
+    KFileItemModelSnapshot();
+
+    int count() const;
+    bool isEmpty() const;
+
+    KFileItem fileItem(int index) const;
+    QHash<QByteArray, QVariant> data(int index) const;
+
+    /**
+     * @return The value of \a column of the role store, or -1 if no value
+     *         has been set, see KFileItemModelRoleStore::int64().
+     */
+    qint64 int64(int index, KFileItemModelRoleStore::Int64Column column) const;
+
+    /**
+     * @return The value of \a column of the role store, or an empty string
+     *         if no value has been set, see KFileItemModelRoleStore::string().
+     */
+    QString string(int index, KFileItemModelRoleStore::StringColumn column) const;
+
+    /**
+     * @return True if the item \a index is stored in the same chunk by both
+     *         snapshots, so that it has not been copied for this snapshot.
+     */
+    bool sharesChunk(const KFileItemModelSnapshot& other, int index) const;
+
+private:
+    struct Entry
+    {
+        KFileItem item;
+        QHash<QByteArray, QVariant> values;
+        std::array<qint64, KFileItemModelRoleStore::Int64ColumnsCount> int64Values;
+        std::array<QString, KFileItemModelRoleStore::StringColumnsCount> stringValues;
+    };
+    typedef QVector<Entry> Chunk;
+
+    const Entry& entry(int index) const;
+
+private:
+    QVector<QSharedPointer<const Chunk>> m_chunks;
+    int m_chunkSize;
+    int m_count;
+
+    friend class KFileItemModelSnapshotTracker;
+};
+
+/**
+ * @brief Follows the changes of a KFileItemModel to take snapshots.
+ *
+ * Remembers which chunks of the last snapshot have been changed since
+ * it has been taken. Only chunks that are still used by a snapshot are
+ * shared with the next snapshot, so that the values of the model are not
+ * copied on changes if no snapshot is used anymore. Is created by
+ * KFileItemModel::itemsSnapshot().
+ */
+class DOLPHIN_EXPORT KFileItemModelSnapshotTracker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KFileItemModelSnapshotTracker(KFileItemModel* model, int chunkSize = 256);
+    ~KFileItemModelSnapshotTracker() override;
+
+    /**
+     * @return Snapshot of the current items of the model. Must be
+     *         invoked in the thread of the model.
+     */
+    KFileItemModelSnapshot snapshot();
+
+private:
+    void slotItemsInsertedOrRemoved(const KItemRangeList& itemRanges);
+    void slotItemsMoved(const KItemRange& itemRange, const QList<int>& movedToIndexes);
+    void slotItemsChanged(const KItemRangeList& itemRanges, const QSet<QByteArray>& roles);
+
+    void markChunksChanged(const KItemRange& itemRange);
+
+private:
+    KFileItemModel* m_model;
+    int m_chunkSize;
+
+    // Chunks of the last snapshot, which are released when all
+    // snapshots that use them have been destroyed
+    QVector<QWeakPointer<const KFileItemModelSnapshot::Chunk>> m_chunks;
+
+    // All chunks starting with the chunk of this index must be copied,
+    // as the indexes of the items have changed
+    int m_firstShiftedIndex;
+    QSet<int> m_changedChunks;
+};
+
+inline int KFileItemModelSnapshot::count() const
+{
+    return m_count;
+}
+
+inline bool KFileItemModelSnapshot::isEmpty() const
+{
+    return m_count == 0;
+}
+
+inline const KFileItemModelSnapshot::Entry& KFileItemModelSnapshot::entry(int index) const
+{
+    return m_chunks.at(index / m_chunkSize)->at(index % m_chunkSize);
+}
+
+#endif
@@ -9,9 +9,20 @@
 #ifndef KFILEITEMMODELSORTALGORITHM_H
 #define KFILEITEMMODELSORTALGORITHM_H
 
+#include <QtConcurrentMap>
 #include <QtConcurrentRun>
+#include <QVector>
 
 #include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <vector>
+
+template <typename RandomAccessIterator, typename LessThan>
+static void merge(RandomAccessIterator begin,
+                  RandomAccessIterator pivot,
+                  RandomAccessIterator end,
+                  const LessThan& lessThan);
 
 /**
  * Sorts the items using the merge sort algorithm is used to assure a
@@ -40,13 +51,110 @@ static void mergeSort(RandomAccessIterator begin,
     merge(begin, middle, end, lessThan);
 }
 
+/**
+ * Sorts the items between \a begin and \a end by the integer value that
+ * \a integerValue returns for each item. A least significant digit radix
+ * sort is used, which needs O(n) time and does not compare pairs of
+ * items. Items with equal values are sorted by \a lessThan afterwards.
+ */
+template <typename RandomAccessIterator, typename IntegerValue, typename LessThan>
+static void radixSort(RandomAccessIterator begin,
+                      RandomAccessIterator end,
+                      const IntegerValue& integerValue,
+                      const LessThan& lessThan)
+{
+    using Item = typename std::iterator_traits<RandomAccessIterator>::value_type;
+    using Key = std::pair<quint64, Item>;
+
+    const int span = end - begin;
+    if (span < 2) {
+        return;
+    }
+
+    std::vector<Key> keys;
+    keys.reserve(span);
+    for (RandomAccessIterator it = begin; it != end; ++it) {
+        // Flipping the sign bit orders negative values before positive ones.
+        const quint64 value = static_cast<quint64>(static_cast<qint64>(integerValue(*it))) ^ (Q_UINT64_C(1) << 63);
+        keys.emplace_back(value, *it);
+    }
+
+    std::vector<Key> buffer(span);
+    for (int shift = 0; shift < 64; shift += 8) {
+        int histogram[256] = {};
+        for (const Key& key : keys) {
+            ++histogram[(key.first >> shift) & 0xff];
+        }
+
+        // Skip the digit if it is equal for all items, which is usually the
+        // case for the high bytes of time stamps and file sizes.
+        if (histogram[(keys.front().first >> shift) & 0xff] == span) {
+            continue;
+        }
+
+        int offset = 0;
+        for (int& count : histogram) {
+            const int bucketSize = count;
+            count = offset;
+            offset += bucketSize;
+        }
+
+        for (const Key& key : keys) {
+            buffer[histogram[(key.first >> shift) & 0xff]++] = key;
+        }
+        keys.swap(buffer);
+    }
+
+    int runBegin = 0;
+    for (int i = 0; i < span; ++i) {
+        *(begin + i) = keys[i].second;
+        if (i + 1 == span || keys[i + 1].first != keys[runBegin].first) {
+            if (i > runBegin) {
+                mergeSort(begin + runBegin, begin + i + 1, lessThan);
+            }
+            runBegin = i + 1;
+        }
+    }
+}
+
+/**
+ * Helper for parallelMergeSort(): Determines how many of the first \a k
+ * elements of the stable merge of the sorted ranges \a a (length \a m)
+ * and \a b (length \a n) are taken from \a a ("co-ranking"). Elements
+ * of \a a are preferred if elements compare equal, like in std::merge().
+ */
+
+template <typename T, typename LessThan>
+static int mergeCoRank(int k, const T* a, int m, const T* b, int n, const LessThan& lessThan)
+{
+    int low = qMax(0, k - n);
+    int high = qMin(k, m);
+    while (low < high) {
+        const int i = low + (high - low) / 2;
+        const int j = k - i;
+        if (j == 0 || i == m || lessThan(b[j - 1], a[i])) {
+            high = i;
+        } else {
+            low = i + 1;
+        }
+    }
+    return low;
+}
+
 /**
  * Uses up to \a numberOfThreads threads to sort the items between
  * \a begin and \a end. Only item ranges longer than
- * \a parallelMergeSortingThreshold are split to be sorted by two different
- * threads.
+ * \a parallelMergeSortingThreshold are sorted in parallel.
+ *
+ * The items are split into chunks, whose number depends on the number of
+ * threads and the number of items. The chunks get sorted as independent
+ * tasks of the global thread pool, so that threads which are done with their
+ * tasks pick up the remaining ones instead of waiting for sibling threads.
+ * Afterwards, neighboring sorted runs are merged pairwise. Each merge is split
+ * into equally large output segments with mergeCoRank(), so that also the
+ * final merges use all threads.
  *
- * The comparison function \a lessThan must be reentrant.
+ * The sort is stable. The comparison function \a lessThan must be reentrant.
  */
 
 template <typename RandomAccessIterator, typename LessThan>
@@ -56,21 +164,93 @@ static void parallelMergeSort(RandomAccessIterator begin,
                               int numberOfThreads,
                               int parallelMergeSortingThreshold = 100)
 {
+    using ValueType = typename std::iterator_traits<RandomAccessIterator>::value_type;
+
     const int span = end - begin;
+    if (numberOfThreads < 2 || span <= parallelMergeSortingThreshold) {
+        mergeSort(begin, end, lessThan);
+        return;
+    }
 
-    if (numberOfThreads > 1 && span > parallelMergeSortingThreshold) {
-        const int newNumberOfThreads = numberOfThreads / 2;
-        const RandomAccessIterator middle = begin + span / 2;
+    // Use a few tasks per thread to balance the load if comparisons take
+    // different amounts of time, but don't create tasks that are so small
+    // that the overhead of scheduling them dominates.
+    const int maxTaskCount = numberOfThreads * 4;
+    const int grainSize = qMax(parallelMergeSortingThreshold, span / maxTaskCount);
 
-        QFuture<void> future = QtConcurrent::run(parallelMergeSort<RandomAccessIterator, LessThan>, begin, middle, lessThan, newNumberOfThreads, parallelMergeSortingThreshold);
-        parallelMergeSort(middle, end, lessThan, newNumberOfThreads, parallelMergeSortingThreshold);
+    std::vector<ValueType> source(begin, end);
+    std::vector<ValueType> target(span);
 
-        future.waitForFinished();
+    // Step 1: Sort the chunks in parallel.
+    const int chunkCount = qMax(1, qMin(maxTaskCount, span / grainSize));
+    QVector<int> runBounds;
+    runBounds.reserve(chunkCount + 1);
+    for (int i = 0; i <= chunkCount; ++i) {
+        runBounds.append(static_cast<int>(static_cast<qint64>(span) * i / chunkCount));
+    }
 
-        merge(begin, middle, end, lessThan);
-    } else {
-        mergeSort(begin, end, lessThan);
+    QVector<int> chunks(chunkCount);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    QtConcurrent::blockingMap(chunks, [&](int chunk) {
+        mergeSort(source.begin() + runBounds.at(chunk), source.begin() + runBounds.at(chunk + 1), lessThan);
+    });
+
+    // Step 2: Merge neighboring runs in parallel until only one run is left.
+    struct MergeTask
+    {
+        int leftBegin;
+        int leftEnd;
+        int rightEnd;
+        int outputBegin;
+        int outputEnd;
+    };
+
+    while (runBounds.count() > 2) {
+        QVector<int> newRunBounds;
+        QVector<MergeTask> tasks;
+
+        newRunBounds.append(0);
+        for (int run = 0; run + 1 < runBounds.count(); run += 2) {
+            const int leftBegin = runBounds.at(run);
+            const int leftEnd = runBounds.at(run + 1);
+            const int rightEnd = (run + 2 < runBounds.count()) ? runBounds.at(run + 2) : leftEnd;
+            newRunBounds.append(rightEnd);
+
+            const int length = rightEnd - leftBegin;
+            const int segmentCount = qMax(1, length / grainSize);
+            for (int segment = 0; segment < segmentCount; ++segment) {
+                const MergeTask task = {
+                    leftBegin,
+                    leftEnd,
+                    rightEnd,
+                    leftBegin + static_cast<int>(static_cast<qint64>(length) * segment / segmentCount),
+                    leftBegin + static_cast<int>(static_cast<qint64>(length) * (segment + 1) / segmentCount)
+                };
+                tasks.append(task);
+            }
+        }
+
+        QtConcurrent::blockingMap(tasks, [&](const MergeTask& task) {
+            const ValueType* left = source.data() + task.leftBegin;
+            const ValueType* right = source.data() + task.leftEnd;
+            const int leftLength = task.leftEnd - task.leftBegin;
+            const int rightLength = task.rightEnd - task.leftEnd;
+
+            const int first = task.outputBegin - task.leftBegin;
+            const int last = task.outputEnd - task.leftBegin;
+            const int leftFirst = mergeCoRank(first, left, leftLength, right, rightLength, lessThan);
+            const int leftLast = mergeCoRank(last, left, leftLength, right, rightLength, lessThan);
+
+            std::merge(left + leftFirst, left + leftLast,
+                       right + (first - leftFirst), right + (last - leftLast),
+                       target.begin() + task.outputBegin, lessThan);
+        });
+
+        source.swap(target);
+        runBounds = newRunBounds;
     }
+
+    std::copy(source.begin(), source.end(), begin);
 }
 
 /**
@@ -0,0 +1,923 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kfilenamesearchindex.h"
+#include "ktaskscheduler.h"
+
+#include <KDirWatch>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureInterface>
+#include <QReadLocker>
+#include <QRegularExpression>
+#include <QTimer>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QWriteLocker>
+
+#include <algorithm>
+#include <iterator>
+
+#ifndef Q_OS_WIN
+#include <qplatformdefs.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // Number of folders that are indexed at the same time. If another
+    // folder is searched, the least recently used index is removed.
+    const int MaximumIndexCount = 4;
+
+    // Interval in ms in which the changes reported by KDirWatch are
+    // collected before the changed folders are read again
+    const int DirtyDirectoriesInterval = 500;
+
+    // Maximum number of folders of an index that are watched by KDirWatch,
+    // so that huge trees don't exhaust the inotify watches of the user
+    const int MaximumWatchedDirectories = 1024;
+
+    // Time in ms after which an index with unwatched folders is read again
+    const int UnwatchedIndexLifetime = 5 * 60 * 1000;
+
+    // Characters of regular expressions that are not supported by the index.
+    // The KIO worker interprets the search text as regular expression, but
+    // file names rarely contain the characters.
+    const QLatin1String RegularExpressionCharacters("^$()+|\\{}");
+
+    struct Pattern
+    {
+        QString text;
+        bool isGlob = false;
+        QRegularExpression glob;
+        // Longest part of the text that must be contained by the names,
+        // the trigrams of the part decide the candidates
+        QString literal;
+    };
+
+    Pattern parsePattern(const QString& text)
+    {
+        Pattern pattern;
+        pattern.text = text;
+        pattern.isGlob = text.contains(QLatin1Char('*')) || text.contains(QLatin1Char('?')) || text.contains(QLatin1Char('['));
+        if (!pattern.isGlob) {
+            pattern.literal = text;
+            return pattern;
+        }
+
+        pattern.glob = QRegularExpression(QRegularExpression::wildcardToRegularExpression(text),
+                                          QRegularExpression::CaseInsensitiveOption);
+
+        QString part;
+        bool inBrackets = false;
+        for (const QChar c : text) {
+            if (inBrackets) {
+                inBrackets = (c != QLatin1Char(']'));
+            } else if (c == QLatin1Char('[') || c == QLatin1Char('*') || c == QLatin1Char('?')) {
+                inBrackets = (c == QLatin1Char('['));
+                if (part.length() > pattern.literal.length()) {
+                    pattern.literal = part;
+                }
+                part.clear();
+            } else {
+                part.append(c);
+            }
+        }
+        if (part.length() > pattern.literal.length()) {
+            pattern.literal = part;
+        }
+        return pattern;
+    }
+
+    bool matches(const Pattern& pattern, const QString& name)
+    {
+        return pattern.isGlob ? pattern.glob.match(name).hasMatch()
+                              : name.contains(pattern.text, Qt::CaseInsensitive);
+    }
+
+    quint64 trigramKey(const QChar* chars)
+    {
+        return (quint64(chars[0].unicode()) << 32) | (quint64(chars[1].unicode()) << 16) | chars[2].unicode();
+    }
+
+    bool isSameOrBelow(const QString& path, const QString& directory)
+    {
+        if (path == directory) {
+            return true;
+        }
+        return directory.endsWith(QLatin1Char('/')) ? path.startsWith(directory)
+                                                    : path.startsWith(directory + QLatin1Char('/'));
+    }
+}
+
+struct KFileNameSearchIndexSingleton
+{
+    KFileNameSearchIndex instance;
+};
+Q_GLOBAL_STATIC(KFileNameSearchIndexSingleton, s_fileNameSearchIndex)
+
+
+KFileNameSearchIndex& KFileNameSearchIndex::instance()
+{
+    return s_fileNameSearchIndex->instance;
+}
+
+KFileNameSearchIndex::~KFileNameSearchIndex()
+{
+    // The worker threads stop reading the folders, the
+    // indexes are kept alive by their tasks
+    m_canceled->store(true);
+}
+
+bool KFileNameSearchIndex::isSupported(const QUrl& searchUrl)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(searchUrl)
+    return false;
+#else
+    if (searchUrl.scheme() != QLatin1String("filenamesearch")) {
+        return false;
+    }
+
+    const QUrlQuery query(searchUrl);
+    if (query.queryItemValue(QStringLiteral("checkContent")) == QLatin1String("yes")) {
+        return false;
+    }
+
+    const QString text = query.queryItemValue(QStringLiteral("search"), QUrl::FullyDecoded);
+    if (text.isEmpty()) {
+        return false;
+    }
+    for (const QChar c : text) {
+        if (RegularExpressionCharacters.contains(c)) {
+            return false;
+        }
+    }
+
+    return !searchPath(searchUrl).isEmpty();
+#endif
+}
+
+QString KFileNameSearchIndex::searchPath(const QUrl& searchUrl)
+{
+    const QUrl url = QUrl::fromUserInput(QUrlQuery(searchUrl).queryItemValue(QStringLiteral("url")), QString(), QUrl::AssumeLocalFile);
+    if (!url.isLocalFile()) {
+        return QString();
+    }
+    return QDir::cleanPath(url.toLocalFile());
+}
+
+bool KFileNameSearchIndex::isIndexed(const QUrl& searchUrl) const
+{
+    if (!isSupported(searchUrl)) {
+        return false;
+    }
+
+    const QString path = searchPath(searchUrl);
+    const IndexState* state = stateForPath(path);
+    if (!state) {
+        return false;
+    }
+
+    // The contents of the mount points are not indexed
+    for (const QString& mountPoint : state->mountPoints) {
+        if (isSameOrBelow(mountPoint, path)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool KFileNameSearchIndex::prepare(const QUrl& searchUrl)
+{
+    if (!isSupported(searchUrl)) {
+        return false;
+    }
+
+    const QString path = searchPath(searchUrl);
+    const IndexState* state = stateForPath(path);
+    if (state) {
+        // Changes of the unwatched folders are only found by reading them again,
+        // until then the current index is used
+        const QString rootPath = state->index->rootPath;
+        if (!state->completelyWatched && state->age.hasExpired(UnwatchedIndexLifetime) && !m_buildWatchers.contains(rootPath)) {
+            startIndexing(rootPath);
+        }
+        return isIndexed(searchUrl);
+    }
+
+    // An index that is built for a parent folder contains the folder as well
+    for (auto it = m_buildWatchers.constBegin(); it != m_buildWatchers.constEnd(); ++it) {
+        if (isSameOrBelow(path, it.key())) {
+            return false;
+        }
+    }
+
+    startIndexing(path);
+    return false;
+}
+
+QFuture<QStringList> KFileNameSearchIndex::search(const QUrl& searchUrl)
+{
+    if (!isIndexed(searchUrl)) {
+        const QStringList paths;
+        QFutureInterface<QStringList> interface;
+        interface.reportStarted();
+        interface.reportFinished(&paths);
+        return interface.future();
+    }
+
+    const QString path = searchPath(searchUrl);
+    IndexState* state = stateForPath(path);
+    state->lastUsed = ++m_usageCounter;
+
+    // The user is waiting for the results
+    const QString text = QUrlQuery(searchUrl).queryItemValue(QStringLiteral("search"), QUrl::FullyDecoded);
+    return KTaskScheduler::instance().run(KTaskScheduler::Interactive, &KFileNameSearchIndex::searchIndex, state->index, path, text);
+}
+
+void KFileNameSearchIndex::clear()
+{
+    m_canceled->store(true);
+    m_canceled = CancelFlag(new std::atomic<bool>(false));
+
+    for (auto watcher : qAsConst(m_buildWatchers)) {
+        disconnect(watcher, nullptr, this, nullptr);
+        watcher->deleteLater();
+    }
+    m_buildWatchers.clear();
+
+    for (auto watcher : qAsConst(m_updateWatchers)) {
+        disconnect(watcher, nullptr, this, nullptr);
+        watcher->deleteLater();
+    }
+    m_updateWatchers.clear();
+
+    const QStringList rootPaths = m_indexes.keys();
+    for (const QString& rootPath : rootPaths) {
+        removeIndex(rootPath);
+    }
+    m_dirtyDirectories.clear();
+    m_dirtyDirectoriesTimer->stop();
+}
+
+QString KFileNameSearchIndex::memoryConsumerName() const
+{
+    return QStringLiteral("KFileNameSearchIndex");
+}
+
+qint64 KFileNameSearchIndex::memoryUsage() const
+{
+    qint64 bytes = 0;
+    for (const IndexState& state : m_indexes) {
+        bytes += state.memoryUsage;
+    }
+    return bytes;
+}
+
+qint64 KFileNameSearchIndex::releaseMemory(qint64 bytes)
+{
+    qint64 released = 0;
+    while (released < bytes && !m_indexes.isEmpty()) {
+        auto leastRecentlyUsed = m_indexes.constBegin();
+        for (auto it = m_indexes.constBegin(); it != m_indexes.constEnd(); ++it) {
+            if (it->lastUsed < leastRecentlyUsed->lastUsed) {
+                leastRecentlyUsed = it;
+            }
+        }
+        released += leastRecentlyUsed->memoryUsage;
+        removeIndex(leastRecentlyUsed.key());
+    }
+    return released;
+}
+
+KFileNameSearchIndex::KFileNameSearchIndex() :
+    QObject(),
+    m_indexes(),
+    m_buildWatchers(),
+    m_updateWatchers(),
+    m_canceled(new std::atomic<bool>(false)),
+    m_usageCounter(0),
+    m_dirWatch(nullptr),
+    m_dirtyDirectories(),
+    m_dirtyDirectoriesTimer(nullptr)
+{
+    m_dirWatch = new KDirWatch(this);
+    connect(m_dirWatch, &KDirWatch::dirty, this, &KFileNameSearchIndex::slotDirectoryDirty);
+    connect(m_dirWatch, &KDirWatch::created, this, &KFileNameSearchIndex::slotDirectoryDirty);
+    connect(m_dirWatch, &KDirWatch::deleted, this, &KFileNameSearchIndex::slotDirectoryDirty);
+
+    m_dirtyDirectoriesTimer = new QTimer(this);
+    m_dirtyDirectoriesTimer->setInterval(DirtyDirectoriesInterval);
+    m_dirtyDirectoriesTimer->setSingleShot(true);
+    connect(m_dirtyDirectoriesTimer, &QTimer::timeout, this, &KFileNameSearchIndex::updateDirtyDirectories);
+}
+
+void KFileNameSearchIndex::startIndexing(const QString& rootPath)
+{
+    auto watcher = new QFutureWatcher<IndexResult>(this);
+    connect(watcher, &QFutureWatcher<IndexResult>::finished, this, [this, rootPath]() {
+        slotIndexBuilt(rootPath);
+    });
+    m_buildWatchers.insert(rootPath, watcher);
+    watcher->setFuture(KTaskScheduler::instance().run(KTaskScheduler::Background, &KFileNameSearchIndex::buildIndex, rootPath, m_canceled));
+}
+
+void KFileNameSearchIndex::slotIndexBuilt(const QString& rootPath)
+{
+    QFutureWatcher<IndexResult>* watcher = m_buildWatchers.take(rootPath);
+    Q_ASSERT(watcher);
+    watcher->deleteLater();
+
+    const IndexResult result = watcher->result();
+    if (!result.index) {
+        return;
+    }
+
+    // The indexes of subfolders are not needed anymore,
+    // unless they are on the devices of the mount points
+    const QStringList rootPaths = m_indexes.keys();
+    for (const QString& path : rootPaths) {
+        if (!isSameOrBelow(path, rootPath)) {
+            continue;
+        }
+        const bool onOtherDevice = std::any_of(result.mountPoints.cbegin(), result.mountPoints.cend(), [&path](const QString& mountPoint) {
+            return isSameOrBelow(path, mountPoint);
+        });
+        if (!onOtherDevice) {
+            removeIndex(path);
+        }
+    }
+
+    IndexState& state = m_indexes[rootPath];
+    state.index = result.index;
+    state.mountPoints = result.mountPoints;
+    state.memoryUsage = result.memoryUsage;
+    state.lastUsed = ++m_usageCounter;
+    state.age.start();
+    watchDirectories(state, result.directories);
+
+    if (m_indexes.count() > MaximumIndexCount) {
+        releaseMemory(1);
+    }
+    KMemoryBudget::instance().scheduleCheck();
+
+    Q_EMIT indexed(rootPath);
+}
+
+void KFileNameSearchIndex::slotDirectoryDirty(const QString& path)
+{
+    if (stateForPath(path)) {
+        m_dirtyDirectories.insert(QDir::cleanPath(path));
+        if (!m_dirtyDirectoriesTimer->isActive()) {
+            m_dirtyDirectoriesTimer->start();
+        }
+    }
+}
+
+void KFileNameSearchIndex::updateDirtyDirectories()
+{
+    QHash<QString, QSet<QString>> dirtyPathsByIndex;
+    for (auto it = m_dirtyDirectories.begin(); it != m_dirtyDirectories.end();) {
+        const IndexState* state = stateForPath(*it);
+        if (!state) {
+            it = m_dirtyDirectories.erase(it);
+            continue;
+        }
+
+        // One update of an index runs at the same time, the
+        // paths are kept until the running update is finished
+        const QString rootPath = state->index->rootPath;
+        if (m_updateWatchers.contains(rootPath)) {
+            ++it;
+            continue;
+        }
+
+        dirtyPathsByIndex[rootPath].insert(*it);
+        it = m_dirtyDirectories.erase(it);
+    }
+
+    for (auto it = dirtyPathsByIndex.constBegin(); it != dirtyPathsByIndex.constEnd(); ++it) {
+        const QString rootPath = it.key();
+        auto watcher = new QFutureWatcher<IndexResult>(this);
+        connect(watcher, &QFutureWatcher<IndexResult>::finished, this, [this, rootPath, watcher]() {
+            slotUpdateRead(rootPath, watcher);
+        });
+        m_updateWatchers.insert(rootPath, watcher);
+        watcher->setFuture(KTaskScheduler::instance().run(KTaskScheduler::Background, &KFileNameSearchIndex::updateIndex,
+                                                          m_indexes.value(rootPath).index, it.value(), m_canceled));
+    }
+}
+
+void KFileNameSearchIndex::slotUpdateRead(const QString& rootPath, QFutureWatcher<IndexResult>* watcher)
+{
+    m_updateWatchers.remove(rootPath);
+    watcher->deleteLater();
+
+    if (!m_dirtyDirectories.isEmpty() && !m_dirtyDirectoriesTimer->isActive()) {
+        m_dirtyDirectoriesTimer->start();
+    }
+
+    const IndexResult result = watcher->result();
+    const auto it = m_indexes.find(rootPath);
+    if (it == m_indexes.end() || it->index != result.index) {
+        // The index has been released or built again in the meantime
+        return;
+    }
+
+    it->mountPoints = result.mountPoints;
+    it->memoryUsage = result.memoryUsage;
+    watchDirectories(*it, result.directories);
+    KMemoryBudget::instance().scheduleCheck();
+
+    Q_EMIT indexChanged(rootPath);
+}
+
+void KFileNameSearchIndex::watchDirectories(IndexState& state, const QStringList& directories)
+{
+    for (const QString& directory : directories) {
+        if (state.watchedDirectories.contains(directory)) {
+            continue;
+        }
+        if (state.watchedDirectories.count() >= MaximumWatchedDirectories) {
+            state.completelyWatched = false;
+            return;
+        }
+        state.watchedDirectories.insert(directory);
+        m_dirWatch->addDir(directory);
+    }
+}
+
+KFileNameSearchIndex::IndexState* KFileNameSearchIndex::stateForPath(const QString& path)
+{
+    return const_cast<IndexState*>(qAsConst(*this).stateForPath(path));
+}
+
+const KFileNameSearchIndex::IndexState* KFileNameSearchIndex::stateForPath(const QString& path) const
+{
+    for (auto it = m_indexes.constBegin(); it != m_indexes.constEnd(); ++it) {
+        if (!isSameOrBelow(path, it.key())) {
+            continue;
+        }
+
+        // The contents of the mount points may be indexed separately
+        const bool belowMountPoint = std::any_of(it->mountPoints.cbegin(), it->mountPoints.cend(), [&path](const QString& mountPoint) {
+            return path != mountPoint && isSameOrBelow(path, mountPoint);
+        });
+        if (!belowMountPoint) {
+            return &it.value();
+        }
+    }
+    return nullptr;
+}
+
+void KFileNameSearchIndex::removeIndex(const QString& rootPath)
+{
+    const auto it = m_indexes.find(rootPath);
+    if (it == m_indexes.end()) {
+        return;
+    }
+
+    for (const QString& directory : qAsConst(it->watchedDirectories)) {
+        m_dirWatch->removeDir(directory);
+    }
+    m_indexes.erase(it);
+}
+
+void KFileNameSearchIndex::mergeFragment(Index& index, int directory, const Fragment& fragment)
+{
+    // The current contents of the folder by their names
+    QHash<QString, int> previousEntries;
+    const QVector<int> children = index.children.value(directory);
+    for (int child : children) {
+        previousEntries.insert(index.entries.at(child).name, child);
+    }
+
+    // Entries of the index by the positions in the fragment
+    QVector<int> ids(fragment.count(), -1);
+    for (int i = 0; i < fragment.count(); ++i) {
+        Entry entry = fragment.at(i);
+        if (entry.parent < 0) {
+            const auto it = previousEntries.find(entry.name);
+            if (it != previousEntries.end()) {
+                const int id = it.value();
+                previousEntries.erase(it);
+                const Entry& previousEntry = index.entries.at(id);
+                if (previousEntry.isDir == entry.isDir && previousEntry.isMountPoint == entry.isMountPoint) {
+                    ids[i] = id;
+                    continue;
+                }
+                removeEntry(index, id);
+            }
+            entry.parent = directory;
+        } else {
+            entry.parent = ids.at(entry.parent);
+        }
+        ids[i] = addEntry(index, entry);
+    }
+
+    for (int id : qAsConst(previousEntries)) {
+        removeEntry(index, id);
+    }
+
+    if (index.removedCount > index.entries.count() / 2) {
+        compact(index);
+    }
+}
+
+void KFileNameSearchIndex::removeEntry(Index& index, int entry)
+{
+    auto siblings = index.children.find(index.entries.at(entry).parent);
+    if (siblings != index.children.end()) {
+        siblings->removeOne(entry);
+    }
+
+    // The trigrams still refer to the removed entries until the
+    // index is compacted, they are skipped by searchIndex()
+    QVector<int> pending = {entry};
+    while (!pending.isEmpty()) {
+        const int id = pending.takeLast();
+        Entry& removedEntry = index.entries[id];
+        if (removedEntry.removed) {
+            continue;
+        }
+
+        removedEntry.removed = true;
+        ++index.removedCount;
+        if (removedEntry.isDir) {
+            const QString path = index.directoryPaths.take(id);
+            index.directories.remove(path);
+            index.mountPoints.remove(path);
+            pending += index.children.take(id);
+        }
+    }
+}
+
+int KFileNameSearchIndex::addEntry(Index& index, const Entry& entry)
+{
+    const int id = index.entries.count();
+    index.entries.append(entry);
+    index.nameBytes += entry.name.size() * sizeof(QChar);
+
+    if (entry.parent < 0) {
+        // The root of the index
+        const QString path = (index.rootPath == QLatin1String("/")) ? QString() : index.rootPath;
+        index.directories.insert(index.rootPath, id);
+        index.directoryPaths.insert(id, path);
+        return id;
+    }
+
+    index.children[entry.parent].append(id);
+    if (entry.isDir) {
+        const QString path = index.directoryPaths.value(entry.parent) + QLatin1Char('/') + entry.name;
+        index.directories.insert(path, id);
+        index.directoryPaths.insert(id, path);
+        if (entry.isMountPoint) {
+            index.mountPoints.insert(path);
+        }
+    }
+
+    addTrigrams(index, id);
+    return id;
+}
+
+void KFileNameSearchIndex::compact(Index& index)
+{
+    Index compacted;
+    compacted.rootPath = index.rootPath;
+    compacted.entries.reserve(index.entries.count() - index.removedCount);
+
+    // The parents of the entries precede them, so the new
+    // positions of the parents are known already
+    QVector<int> ids(index.entries.count(), -1);
+    for (int id = 0; id < index.entries.count(); ++id) {
+        const Entry& entry = index.entries.at(id);
+        if (entry.removed) {
+            continue;
+        }
+
+        Entry movedEntry = entry;
+        if (entry.parent >= 0) {
+            movedEntry.parent = ids.at(entry.parent);
+        }
+        ids[id] = addEntry(compacted, movedEntry);
+    }
+
+    // The lock of the index is kept
+    index.entries = std::move(compacted.entries);
+    index.trigrams = std::move(compacted.trigrams);
+    index.children = std::move(compacted.children);
+    index.directories = std::move(compacted.directories);
+    index.directoryPaths = std::move(compacted.directoryPaths);
+    index.mountPoints = std::move(compacted.mountPoints);
+    index.removedCount = 0;
+    index.initialCount = index.entries.count();
+    index.nameBytes = compacted.nameBytes;
+    index.postingCount = compacted.postingCount;
+}
+
+qint64 KFileNameSearchIndex::indexMemoryUsage(const Index& index)
+{
+    // Estimates the overhead of QString, QHash and QVector by constant sizes
+    return qint64(index.entries.capacity()) * (sizeof(Entry) + 16)
+         + index.nameBytes
+         + index.postingCount * sizeof(int)
+         + qint64(index.trigrams.count()) * 48
+         + qint64(index.children.count()) * 48
+         + qint64(index.directories.count()) * 128;
+}
+
+KFileNameSearchIndex::IndexResult KFileNameSearchIndex::buildIndex(const QString& rootPath, CancelFlag canceled)
+{
+    IndexResult result;
+#ifndef Q_OS_WIN
+    QT_STATBUF buf;
+    if (QT_STAT(QFile::encodeName(rootPath).constData(), &buf) != 0) {
+        return result;
+    }
+
+    Fragment fragment;
+    readDirectory(rootPath, buf.st_dev, QSet<QString>(), fragment, *canceled);
+    if (canceled->load()) {
+        return result;
+    }
+
+    QSharedPointer<Index> index(new Index);
+    index->rootPath = rootPath;
+    index->device = buf.st_dev;
+    index->entries.reserve(fragment.count() + 1);
+    addEntry(*index, {rootPath, -1, true, false, false});
+
+    // The positions in the fragment are shifted by the root
+    QVector<int> depths(fragment.count() + 1, 0);
+    QVector<QPair<int, QString>> directories;
+    for (const Entry& fragmentEntry : qAsConst(fragment)) {
+        Entry entry = fragmentEntry;
+        entry.parent = fragmentEntry.parent + 1;
+        const int id = addEntry(*index, entry);
+        depths[id] = depths.at(entry.parent) + 1;
+        if (entry.isDir && !entry.isMountPoint) {
+            directories.append(qMakePair(depths.at(id), index->directoryPaths.value(id)));
+        }
+    }
+    index->initialCount = index->entries.count();
+
+    // The folders that are closest to the root are watched
+    std::stable_sort(directories.begin(), directories.end(), [](const QPair<int, QString>& a, const QPair<int, QString>& b) {
+        return a.first < b.first;
+    });
+    result.directories.reserve(qMin(directories.count(), MaximumWatchedDirectories) + 1);
+    result.directories.append(rootPath);
+    for (const auto& directory : qAsConst(directories)) {
+        result.directories.append(directory.second);
+        if (result.directories.count() > MaximumWatchedDirectories) {
+            // Tells watchDirectories() that not all folders are watched
+            break;
+        }
+    }
+
+    result.index = index;
+    result.mountPoints = index->mountPoints;
+    result.memoryUsage = indexMemoryUsage(*index);
+#else
+    Q_UNUSED(rootPath)
+    Q_UNUSED(canceled)
+#endif
+    return result;
+}
+
+KFileNameSearchIndex::IndexResult KFileNameSearchIndex::updateIndex(QSharedPointer<Index> index, const QSet<QString>& dirtyPaths,
+                                                                   CancelFlag canceled)
+{
+    IndexResult result;
+    result.index = index;
+
+    // KDirWatch reports created and deleted entries by their own
+    // paths, their folders must be read again. The contents of the
+    // known subfolders are kept, their changes are reported separately.
+    QHash<QString, QSet<QString>> knownDirectories;
+    {
+        QReadLocker locker(&index->lock);
+        for (const QString& dirtyPath : dirtyPaths) {
+            QString path = dirtyPath;
+            if (!index->directories.contains(path)) {
+                path = QFileInfo(dirtyPath).path();
+                if (!index->directories.contains(path)) {
+                    continue;
+                }
+            }
+            if (knownDirectories.contains(path)) {
+                continue;
+            }
+
+            QSet<QString>& known = knownDirectories[path];
+            const QVector<int> children = index->children.value(index->directories.value(path));
+            for (int child : children) {
+                const Entry& entry = index->entries.at(child);
+                if (entry.isDir) {
+                    known.insert(entry.name);
+                }
+            }
+        }
+    }
+
+    // The folders are read without locking the index, so it can be searched meanwhile
+    QVector<QPair<QString, Fragment>> fragments;
+    for (auto it = knownDirectories.constBegin(); it != knownDirectories.constEnd() && !canceled->load(); ++it) {
+        Fragment fragment;
+        readDirectory(it.key(), index->device, it.value(), fragment, *canceled);
+        fragments.append(qMakePair(it.key(), fragment));
+    }
+    if (canceled->load()) {
+        return result;
+    }
+
+    QWriteLocker locker(&index->lock);
+    for (const auto& fragment : qAsConst(fragments)) {
+        const int directory = index->directories.value(fragment.first, -1);
+        if (directory < 0) {
+            // The folder has been removed by the merge of its parent
+            continue;
+        }
+
+        mergeFragment(*index, directory, fragment.second);
+
+        // The paths of the folders are built from the fragment, as the
+        // entries of the index may have been moved by compact()
+        const QString basePath = (fragment.first == QLatin1String("/")) ? QString() : fragment.first;
+        QVector<QString> paths(fragment.second.count());
+        for (int i = 0; i < fragment.second.count(); ++i) {
+            const Entry& entry = fragment.second.at(i);
+            if (!entry.isDir || entry.isMountPoint) {
+                continue;
+            }
+            paths[i] = (entry.parent < 0 ? basePath : paths.at(entry.parent)) + QLatin1Char('/') + entry.name;
+            result.directories.append(paths.at(i));
+        }
+    }
+    result.mountPoints = index->mountPoints;
+    result.memoryUsage = indexMemoryUsage(*index);
+    return result;
+}
+
+QStringList KFileNameSearchIndex::searchIndex(QSharedPointer<Index> index, const QString& path, const QString& text)
+{
+    QStringList paths;
+    QReadLocker locker(&index->lock);
+
+    const int directory = index->directories.value(path, -1);
+    if (directory < 0) {
+        return paths;
+    }
+
+    const Pattern pattern = parsePattern(text);
+    const QString literal = pattern.literal.toCaseFolded();
+
+    // Texts with less than three characters have no trigrams,
+    // then all names are checked
+    const bool checkAll = literal.length() < 3;
+    QVector<int> candidates;
+    if (!checkAll) {
+        QVector<const QVector<int>*> lists;
+        for (int i = 0; i + 2 < literal.length(); ++i) {
+            const auto it = index->trigrams.constFind(trigramKey(literal.constData() + i));
+            if (it == index->trigrams.constEnd()) {
+                return paths;
+            }
+            lists.append(&it.value());
+        }
+
+        std::sort(lists.begin(), lists.end(), [](const QVector<int>* a, const QVector<int>* b) {
+            return a->count() < b->count();
+        });
+        candidates = *lists.first();
+        for (int i = 1; i < lists.count() && !candidates.isEmpty(); ++i) {
+            QVector<int> intersection;
+            std::set_intersection(candidates.constBegin(), candidates.constEnd(),
+                                  lists.at(i)->constBegin(), lists.at(i)->constEnd(),
+                                  std::back_inserter(intersection));
+            candidates.swap(intersection);
+        }
+    }
+
+    const int count = checkAll ? index->entries.count() : candidates.count();
+    for (int i = 0; i < count; ++i) {
+        const int id = checkAll ? i : candidates.at(i);
+        const Entry& entry = index->entries.at(id);
+        if (id == 0 || entry.removed || !matches(pattern, entry.name)) {
+            continue;
+        }
+
+        if (directory != 0) {
+            int parent = entry.parent;
+            while (parent > 0 && parent != directory) {
+                parent = index->entries.at(parent).parent;
+            }
+            if (parent != directory) {
+                continue;
+            }
+        }
+
+        paths.append(index->directoryPaths.value(entry.parent) + QLatin1Char('/') + entry.name);
+    }
+
+    // The entries that have been added by updates are behind the
+    // others, but the paths of a folder must be adjacent
+    if (index->removedCount > 0 || index->entries.count() > index->initialCount) {
+        std::sort(paths.begin(), paths.end());
+    }
+    return paths;
+}
+
+void KFileNameSearchIndex::readDirectory(const QString& path, quint64 device, const QSet<QString>& knownDirectories,
+                                         Fragment& fragment, const std::atomic<bool>& canceled)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(path)
+    Q_UNUSED(device)
+    Q_UNUSED(knownDirectories)
+    Q_UNUSED(fragment)
+    Q_UNUSED(canceled)
+#else
+    const int dirFd = open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd >= 0) {
+        readDirectoryAt(dirFd, -1, device, knownDirectories, fragment, canceled);
+    }
+#endif
+}
+
+void KFileNameSearchIndex::readDirectoryAt(int dirFd, int parent, quint64 device, const QSet<QString>& knownDirectories,
+                                           Fragment& fragment, const std::atomic<bool>& canceled)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(dirFd)
+    Q_UNUSED(parent)
+    Q_UNUSED(device)
+    Q_UNUSED(knownDirectories)
+    Q_UNUSED(fragment)
+    Q_UNUSED(canceled)
+#else
+    // The descriptor is owned by the directory stream
+    QT_DIR* dir = fdopendir(dirFd);
+    if (!dir) {
+        QT_CLOSE(dirFd);
+        return;
+    }
+
+    QT_DIRENT* dirEntry;
+    while (!canceled.load(std::memory_order_relaxed) && (dirEntry = QT_READDIR(dir))) {
+        const char* name = dirEntry->d_name;
+        if (name[0] == '.') {
+            // Skip "." and "..", and the hidden files like the KIO worker
+            continue;
+        }
+
+        // Links to folders are not followed, like by the KIO worker
+        bool isDir = (dirEntry->d_type == DT_DIR);
+        if (dirEntry->d_type == DT_UNKNOWN) {
+            struct stat buf;
+            isDir = fstatat(dirfd(dir), name, &buf, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(buf.st_mode);
+        }
+
+        const QString fileName = QFile::decodeName(name);
+        fragment.append({fileName, parent, isDir, false, false});
+
+        if (isDir && !knownDirectories.contains(fileName)) {
+            const int subDirFd = openat(dirfd(dir), name, O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+            if (subDirFd < 0) {
+                continue;
+            }
+
+            QT_STATBUF buf;
+            if (QT_FSTAT(subDirFd, &buf) == 0 && static_cast<quint64>(buf.st_dev) != device) {
+                fragment.last().isMountPoint = true;
+                QT_CLOSE(subDirFd);
+                continue;
+            }
+            readDirectoryAt(subDirFd, fragment.count() - 1, device, QSet<QString>(), fragment, canceled);
+        }
+    }
+    QT_CLOSEDIR(dir);
+#endif
+}
+
+void KFileNameSearchIndex::addTrigrams(Index& index, int entry)
+{
+    const QString name = index.entries.at(entry).name.toCaseFolded();
+    for (int i = 0; i + 2 < name.length(); ++i) {
+        QVector<int>& ids = index.trigrams[trigramKey(name.constData() + i)];
+        // A trigram may occur several times in a name
+        if (ids.isEmpty() || ids.last() != entry) {
+            ids.append(entry);
+            ++index.postingCount;
+        }
+    }
+}
@@ -0,0 +1,257 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KFILENAMESEARCHINDEX_H
+#define KFILENAMESEARCHINDEX_H
+
+#include "dolphin_export.h"
+#include "kitemviews/private/kmemorybudget.h"
+
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+
+#include <atomic>
+
+class KDirWatch;
+class QTimer;
+class QUrl;
+
+/**
+ * @brief Answers file name searches from an index in memory.
+ *
+ * If Baloo is not available, DolphinSearchBox searches by URLs of the
+ * scheme "filenamesearch", whose KIO worker reads the whole folder
+ * recursively for each search. On the first search in a folder the index
+ * reads the names of all files below the folder once in a worker thread.
+ * The following searches in the folder and its subfolders are answered
+ * from the index within milliseconds, until then the KIO worker is used.
+ *
+ * Like the KIO worker, which lists the folders without hidden files, hidden
+ * files and the contents of hidden folders are not indexed. Folders on
+ * other devices are not read, searches in folders that contain such mount
+ * points are done by the KIO worker.
+ *
+ * The names are indexed by their case-folded trigrams. A search for a
+ * text intersects the lists of the files that contain the trigrams of the
+ * text and checks only the remaining candidates. Glob patterns like
+ * "*.cpp" are checked against the files that contain the trigrams of the
+ * longest text between the wildcards.
+ *
+ * The indexes exist for the session and are released if the memory budget
+ * is exceeded, see KMemoryBudget. They are updated by KDirWatch, which only
+ * watches the MaximumWatchedDirectories folders that are closest to the
+ * indexed folder. Indexes that contain more folders are read again when
+ * they are used after UnwatchedIndexLifetime ms.
+ *
+ * The indexes are built, updated and searched by worker threads, the
+ * main thread only keeps track of them.
+ */
+class DOLPHIN_EXPORT KFileNameSearchIndex : public QObject, public KMemoryBudget::Consumer
+{
+    Q_OBJECT
+
+public:
+    static KFileNameSearchIndex& instance();
+    ~KFileNameSearchIndex() override;
+
+    /**
+     * @return True if the search URL \a searchUrl can be answered by an
+     *         index: The folder is local, the content of the files is
+     *         not searched and the text is no regular expression.
+     */
+    static bool isSupported(const QUrl& searchUrl);
+
+    /**
+     * @return Local path of the folder that is searched by \a searchUrl.
+     */
+    static QString searchPath(const QUrl& searchUrl);
+
+    /**
+     * @return True if \a searchUrl can be answered by an index right now.
+     *         The indexing is not started.
+     */
+    bool isIndexed(const QUrl& searchUrl) const;
+
+    /**
+     * Starts indexing the folder of \a searchUrl if it is not indexed yet,
+     * or if its index may be outdated.
+     * @return isIndexed(searchUrl).
+     */
+    bool prepare(const QUrl& searchUrl);
+
+    /**
+     * Searches the index in a worker thread.
+     * @return Future for the paths of the files and folders that match
+     *         \a searchUrl. The result is an empty list if isIndexed()
+     *         returns false. The paths of the same folder are adjacent.
+     */
+    QFuture<QStringList> search(const QUrl& searchUrl);
+
+    /**
+     * Removes all indexes, e.g. for tests.
+     */
+    void clear();
+
+    QString memoryConsumerName() const override;
+    qint64 memoryUsage() const override;
+    qint64 releaseMemory(qint64 bytes) override;
+
+Q_SIGNALS:
+    /**
+     * Is emitted if the indexed folder \a rootPath has been changed.
+     * Shown search results should be updated.
+     */
+    void indexChanged(const QString& rootPath);
+
+    /**
+     * Is emitted if the indexing of the folder \a rootPath has been finished.
+     */
+    void indexed(const QString& rootPath);
+
+protected:
+    KFileNameSearchIndex();
+
+private:
+    struct Entry
+    {
+        QString name;
+        int parent;     // Entry of the folder, -1 for the root
+        bool isDir;
+        bool removed;
+        bool isMountPoint;  // Folder on another device, whose contents are not read
+    };
+
+    /**
+     * Entries that have been read by a worker thread in pre-order, so
+     * that folders precede their contents. The parents refer to the
+     * positions within the fragment, -1 is the folder that has been read.
+     */
+    typedef QVector<Entry> Fragment;
+
+    /**
+     * Is read by the search and update tasks, which lock the index.
+     * It is only changed by the update tasks.
+     */
+    struct Index
+    {
+        mutable QReadWriteLock lock;
+        QString rootPath;   // Entry 0
+        quint64 device = 0;
+        QVector<Entry> entries;
+        QHash<quint64, QVector<int> > trigrams;
+        QHash<int, QVector<int> > children;
+        QHash<QString, int> directories;    // Path -> entry
+        QHash<int, QString> directoryPaths;
+        QSet<QString> mountPoints;
+        int removedCount = 0;
+        int initialCount = 0;   // Entries that have been read by buildIndex()
+        qint64 nameBytes = 0;
+        qint64 postingCount = 0;
+    };
+
+    /**
+     * Result of the tasks that build or update an index. The properties
+     * of the index are copied, so the main thread never locks the index.
+     */
+    struct IndexResult
+    {
+        QSharedPointer<Index> index;
+        QSet<QString> mountPoints;
+        // Added folders that may be watched, the closest to the root first
+        QStringList directories;
+        qint64 memoryUsage = 0;
+    };
+
+    /**
+     * State of an index that is only used by the main thread.
+     */
+    struct IndexState
+    {
+        QSharedPointer<Index> index;
+        QSet<QString> mountPoints;
+        QSet<QString> watchedDirectories;
+        bool completelyWatched = true;
+        QElapsedTimer age;
+        qint64 memoryUsage = 0;
+        quint64 lastUsed = 0;
+    };
+
+    typedef QSharedPointer<std::atomic<bool> > CancelFlag;
+
+    void startIndexing(const QString& rootPath);
+    void slotIndexBuilt(const QString& rootPath);
+    void slotDirectoryDirty(const QString& path);
+    void updateDirtyDirectories();
+    void slotUpdateRead(const QString& rootPath, QFutureWatcher<IndexResult>* watcher);
+
+    /**
+     * Watches the folders \a directories as long as less than
+     * MaximumWatchedDirectories folders of \a state are watched.
+     */
+    void watchDirectories(IndexState& state, const QStringList& directories);
+
+    /**
+     * @return The state of the index that contains the contents of \a path, or nullptr.
+     */
+    IndexState* stateForPath(const QString& path);
+    const IndexState* stateForPath(const QString& path) const;
+
+    void removeIndex(const QString& rootPath);
+
+    /**
+     * Replaces the contents of the folder \a directory by the entries of
+     * \a fragment. Folders that exist already keep their contents.
+     */
+    static void mergeFragment(Index& index, int directory, const Fragment& fragment);
+    static void removeEntry(Index& index, int entry);
+    static int addEntry(Index& index, const Entry& entry);
+    static void compact(Index& index);
+    static qint64 indexMemoryUsage(const Index& index);
+
+    static IndexResult buildIndex(const QString& rootPath, CancelFlag canceled);
+
+    /**
+     * Reads the folders of \a index again that contain the changed
+     * files and folders \a dirtyPaths and merges their entries.
+     */
+    static IndexResult updateIndex(QSharedPointer<Index> index, const QSet<QString>& dirtyPaths, CancelFlag canceled);
+
+    static QStringList searchIndex(QSharedPointer<Index> index, const QString& path, const QString& text);
+
+    /**
+     * Reads the entries below the folder \a path into \a fragment. The
+     * folders \a knownDirectories are not read recursively, and neither
+     * are folders on another device than \a device.
+     */
+    static void readDirectory(const QString& path, quint64 device, const QSet<QString>& knownDirectories,
+                              Fragment& fragment, const std::atomic<bool>& canceled);
+    static void readDirectoryAt(int dirFd, int parent, quint64 device, const QSet<QString>& knownDirectories,
+                                Fragment& fragment, const std::atomic<bool>& canceled);
+    static void addTrigrams(Index& index, int entry);
+
+private:
+    // Indexes by the paths of their folders
+    QHash<QString, IndexState> m_indexes;
+    QHash<QString, QFutureWatcher<IndexResult>*> m_buildWatchers;
+    QHash<QString, QFutureWatcher<IndexResult>*> m_updateWatchers;
+    CancelFlag m_canceled;
+    quint64 m_usageCounter;
+
+    KDirWatch* m_dirWatch;
+    QSet<QString> m_dirtyDirectories;
+    QTimer* m_dirtyDirectoriesTimer;
+
+    friend struct KFileNameSearchIndexSingleton;
+};
+
+#endif
@@ -0,0 +1,294 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kfilestatengine.h"
+
+#include "config-liburing.h"
+
+#ifndef Q_OS_WIN
+#include <QVarLengthArray>
+
+#include <atomic>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef STATX_TYPE
+#include <sys/sysmacros.h>
+#endif
+#if defined(HAVE_LIBURING) && defined(STATX_TYPE)
+#include <liburing.h>
+#define KFILESTATENGINE_USE_IO_URING
+#endif
+#endif
+
+#ifndef Q_OS_WIN
+namespace {
+    typedef KFileStatEngine::Stat Stat;
+    typedef KFileStatEngine::Flags Flags;
+
+#ifdef STATX_TYPE
+    // Is set if the kernel does not support statx(), then fstatat() is used.
+    std::atomic<bool> s_statxUnsupported(false);
+
+    int statxFlags(Flags flags)
+    {
+        int result = 0;
+        if (flags & KFileStatEngine::NoFollowSymlinks) {
+            result |= AT_SYMLINK_NOFOLLOW;
+        }
+        if (flags & KFileStatEngine::DontSync) {
+            result |= AT_STATX_DONT_SYNC;
+        }
+        return result;
+    }
+
+    unsigned int statxMask(Flags flags)
+    {
+        // Requesting only the required fields saves work on network filesystems
+        if (flags & KFileStatEngine::BasicFieldsOnly) {
+            return STATX_TYPE | STATX_SIZE | STATX_INO | STATX_NLINK;
+        }
+        return STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME | STATX_ATIME |
+               STATX_BTIME | STATX_UID | STATX_GID | STATX_INO | STATX_NLINK;
+    }
+
+    void fromStatx(const struct statx& buf, Stat& result)
+    {
+        result.mode = buf.stx_mode;
+        result.size = static_cast<qint64>(buf.stx_size);
+        result.modificationTime = buf.stx_mtime.tv_sec;
+        result.accessTime = buf.stx_atime.tv_sec;
+        result.creationTime = (buf.stx_mask & STATX_BTIME) ? buf.stx_btime.tv_sec : -1;
+        result.userId = buf.stx_uid;
+        result.groupId = buf.stx_gid;
+        result.device = makedev(buf.stx_dev_major, buf.stx_dev_minor);
+        result.inode = buf.stx_ino;
+        result.linkCount = buf.stx_nlink;
+    }
+#endif
+
+#ifdef KFILESTATENGINE_USE_IO_URING
+    // Maximum number of requests that are processed by the kernel at once
+    const unsigned int RingSize = 64;
+
+    // Is set if io_uring or IORING_OP_STATX is not available,
+    // e.g. because io_uring has been disabled by the administrator.
+    std::atomic<bool> s_ringUnsupported(false);
+
+    /**
+     * The io_uring of one thread. The status buffers belong to the ring,
+     * so that they stay valid as long as the kernel might write to them.
+     */
+    class Ring
+    {
+    public:
+        Ring() :
+            m_ring(),
+            m_initialized(false),
+            m_valid(false),
+            m_buffers(),
+            m_entryOfSlot()
+        {
+            if (s_ringUnsupported.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            if (io_uring_queue_init(RingSize, &m_ring, 0) != 0) {
+                s_ringUnsupported.store(true, std::memory_order_relaxed);
+                return;
+            }
+            m_initialized = true;
+
+            struct io_uring_probe* probe = io_uring_get_probe_ring(&m_ring);
+            m_valid = probe && io_uring_opcode_supported(probe, IORING_OP_STATX);
+            if (probe) {
+                io_uring_free_probe(probe);
+            }
+            if (!m_valid) {
+                s_ringUnsupported.store(true, std::memory_order_relaxed);
+            }
+        }
+
+        ~Ring()
+        {
+            if (m_initialized) {
+                io_uring_queue_exit(&m_ring);
+            }
+        }
+
+        bool isValid() const
+        {
+            return m_valid;
+        }
+
+        /**
+         * Reads the status of \a names by the ring. The entries whose
+         * requests have been completed are marked in \a done, the other
+         * entries must be read by system calls.
+         */
+        void statBatch(int dirFd, const QVector<QByteArray>& names, Flags flags,
+                       QVector<Stat>& results, QVector<bool>& ok, QVector<bool>& done)
+        {
+            const int count = names.count();
+            const int flagsForStatx = statxFlags(flags);
+            const unsigned int mask = statxMask(flags);
+
+            QVarLengthArray<unsigned int, RingSize> freeSlots;
+            for (unsigned int slot = 0; slot < RingSize; ++slot) {
+                freeSlots.append(slot);
+            }
+
+            int next = 0;
+            int inFlight = 0;
+            while (next < count || inFlight > 0) {
+                while (next < count && !freeSlots.isEmpty()) {
+                    struct io_uring_sqe* sqe = io_uring_get_sqe(&m_ring);
+                    if (!sqe) {
+                        break;
+                    }
+
+                    const unsigned int slot = freeSlots.last();
+                    freeSlots.removeLast();
+                    m_entryOfSlot[slot] = next;
+                    io_uring_prep_statx(sqe, dirFd, names.at(next).constData(), flagsForStatx, mask, &m_buffers[slot]);
+                    io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<quintptr>(slot)));
+                    ++next;
+                    ++inFlight;
+                }
+
+                const int submitted = io_uring_submit_and_wait(&m_ring, 1);
+                if (submitted < 0 && submitted != -EINTR && submitted != -EAGAIN && submitted != -EBUSY) {
+                    // The remaining entries are read by system calls. The
+                    // ring is not used anymore, as requests might be pending.
+                    m_valid = false;
+                    return;
+                }
+
+                struct io_uring_cqe* cqe;
+                while (io_uring_peek_cqe(&m_ring, &cqe) == 0) {
+                    const unsigned int slot = static_cast<unsigned int>(reinterpret_cast<quintptr>(io_uring_cqe_get_data(cqe)));
+                    const int index = m_entryOfSlot[slot];
+                    const int result = cqe->res;
+                    io_uring_cqe_seen(&m_ring, cqe);
+
+                    if (result == 0) {
+                        fromStatx(m_buffers[slot], results[index]);
+                        ok[index] = true;
+                        done[index] = true;
+                    } else if (result != -EINVAL && result != -EOPNOTSUPP && result != -EAGAIN) {
+                        // The entry does not exist anymore or is not accessible.
+                        // Unsupported flags are retried by a system call.
+                        done[index] = true;
+                    }
+
+                    freeSlots.append(slot);
+                    --inFlight;
+                }
+            }
+        }
+
+    private:
+        struct io_uring m_ring;
+        bool m_initialized;
+        bool m_valid;
+        struct statx m_buffers[RingSize];
+        int m_entryOfSlot[RingSize];
+    };
+
+    Ring& threadRing()
+    {
+        thread_local Ring ring;
+        return ring;
+    }
+#endif
+}
+#endif
+
+bool KFileStatEngine::stat(int dirFd, const char* name, Flags flags, Stat& result)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(dirFd)
+    Q_UNUSED(name)
+    Q_UNUSED(flags)
+    Q_UNUSED(result)
+    return false;
+#else
+#ifdef STATX_TYPE
+    if (!s_statxUnsupported.load(std::memory_order_relaxed)) {
+        struct statx buf;
+        if (statx(dirFd, name, statxFlags(flags), statxMask(flags), &buf) == 0) {
+            fromStatx(buf, result);
+            return true;
+        }
+
+        if (errno != ENOSYS) {
+            return false;
+        }
+        s_statxUnsupported.store(true, std::memory_order_relaxed);
+    }
+#endif
+
+    struct stat buf;
+    if (fstatat(dirFd, name, &buf, (flags & NoFollowSymlinks) ? AT_SYMLINK_NOFOLLOW : 0) != 0) {
+        return false;
+    }
+
+    result.mode = buf.st_mode;
+    result.size = static_cast<qint64>(buf.st_size);
+    result.modificationTime = buf.st_mtime;
+    result.accessTime = buf.st_atime;
+    result.creationTime = -1;
+    result.userId = buf.st_uid;
+    result.groupId = buf.st_gid;
+    result.device = buf.st_dev;
+    result.inode = buf.st_ino;
+    result.linkCount = buf.st_nlink;
+    return true;
+#endif
+}
+
+QVector<bool> KFileStatEngine::statBatch(int dirFd, const QVector<QByteArray>& names, Flags flags, QVector<Stat>& results)
+{
+    const int count = names.count();
+    results.resize(count);
+    QVector<bool> ok(count, false);
+
+#ifndef Q_OS_WIN
+    QVector<bool> done(count, false);
+
+#ifdef KFILESTATENGINE_USE_IO_URING
+    // A single entry is read faster by one system call
+    if (count > 1) {
+        Ring& ring = threadRing();
+        if (ring.isValid()) {
+            ring.statBatch(dirFd, names, flags, results, ok, done);
+        }
+    }
+#endif
+
+    for (int i = 0; i < count; ++i) {
+        if (!done.at(i)) {
+            ok[i] = stat(dirFd, names.at(i).constData(), flags, results[i]);
+        }
+    }
+#else
+    Q_UNUSED(dirFd)
+    Q_UNUSED(flags)
+#endif
+
+    return ok;
+}
+
+bool KFileStatEngine::isBatchingSupported()
+{
+#ifdef KFILESTATENGINE_USE_IO_URING
+    return threadRing().isValid();
+#else
+    return false;
+#endif
+}
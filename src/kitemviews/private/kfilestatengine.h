@@ -0,0 +1,80 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KFILESTATENGINE_H
+#define KFILESTATENGINE_H
+
+#include "dolphin_export.h"
+
+#include <QByteArray>
+#include <QFlags>
+#include <QVector>
+
+#include <sys/types.h>
+
+/**
+ * @brief Reads the status of the entries of local directories.
+ *
+ * The entries are accessed relative to the file descriptor of their
+ * directory. statBatch() reads the status of many entries of one
+ * directory at once: If Dolphin is built with liburing and the kernel
+ * supports IORING_OP_STATX, all requests of a batch are submitted to an
+ * io_uring and are processed by the kernel concurrently, which saves one
+ * roundtrip per entry on network filesystems. Otherwise the entries are
+ * read one after another by statx() or fstatat(), and the callers read
+ * several batches in parallel tasks of KTaskScheduler instead.
+ *
+ * Not available on Windows.
+ */
+class DOLPHIN_EXPORT KFileStatEngine
+{
+public:
+    struct Stat {
+        mode_t mode = 0;
+        qint64 size = 0;
+        qint64 modificationTime = 0;
+        qint64 accessTime = 0;
+        qint64 creationTime = -1; // -1 if unknown
+        uid_t userId = 0;
+        gid_t groupId = 0;
+        quint64 device = 0;
+        quint64 inode = 0;
+        quint64 linkCount = 0;
+    };
+
+    enum Flag {
+        NoFlags = 0x0,
+        /** Symbolic links are described themselves instead of their targets. */
+        NoFollowSymlinks = 0x1,
+        /** Network filesystems may use their cached attributes. */
+        DontSync = 0x2,
+        /** Only the type, size, device, inode and link count are read. */
+        BasicFieldsOnly = 0x4
+    };
+    Q_DECLARE_FLAGS(Flags, Flag)
+
+    /**
+     * Reads the status of the entry \a name inside the directory \a dirFd.
+     * @return True if the status has been read, otherwise errno is set.
+     */
+    static bool stat(int dirFd, const char* name, Flags flags, Stat& result);
+
+    /**
+     * Reads the status of the entries \a names inside the directory \a dirFd.
+     * \a results gets one status for each name.
+     * @return For each name, whether its status has been read.
+     */
+    static QVector<bool> statBatch(int dirFd, const QVector<QByteArray>& names, Flags flags, QVector<Stat>& results);
+
+    /**
+     * @return True if statBatch() submits the requests to an io_uring.
+     */
+    static bool isBatchingSupported();
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(KFileStatEngine::Flags)
+
+#endif
@@ -0,0 +1,244 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kiconpixmapcache.h"
+
+#include <KIconLoader>
+
+namespace {
+    // Same as the default size of QPixmapCache, in KiB
+    const int DefaultCost = 10 * 1024;
+
+    const int MaximumCost = 100 * 1024;
+
+    // Custom folder icons and thumbnails of .desktop files are given as
+    // paths, so the number of interned icon names is bounded
+    const int MaximumInternedIds = 4096;
+
+    /**
+     * Removes the least recently used pixmaps of \a cache until at least
+     * \a cost KiB have been released.
+     * @return Released cost in KiB.
+     */
+    template<typename Key>
+    int trimCache(QCache<Key, QPixmap>& cache, int cost)
+    {
+        const int previousCost = cache.totalCost();
+        const int maxCost = cache.maxCost();
+        cache.setMaxCost(qMax(0, previousCost - cost));
+        cache.setMaxCost(maxCost);
+        return previousCost - cache.totalCost();
+    }
+}
+
+struct KIconPixmapCacheSingleton
+{
+    KIconPixmapCache instance;
+};
+Q_GLOBAL_STATIC(KIconPixmapCacheSingleton, s_iconPixmapCache)
+
+
+KIconPixmapCache& KIconPixmapCache::instance()
+{
+    return s_iconPixmapCache->instance;
+}
+
+KIconPixmapCache::KIconPixmapCache() :
+    m_nameIds(),
+    m_overlaysIds(),
+    m_pixmaps(DefaultCost),
+    m_variants(DefaultCost),
+    m_workingSetCosts(),
+    m_hits(0),
+    m_misses(0)
+{
+    QObject::connect(KIconLoader::global(), &KIconLoader::iconLoaderSettingsChanged, [this]() {
+        clear();
+    });
+}
+
+KIconPixmapCache::~KIconPixmapCache()
+{
+}
+
+bool KIconPixmapCache::Key::operator==(const Key& other) const
+{
+    return nameId == other.nameId && overlaysId == other.overlaysId && size == other.size
+           && mode == other.mode && dpr == other.dpr;
+}
+
+uint qHash(const KIconPixmapCache::Key& key, uint seed)
+{
+    return qHash(key.nameId, seed) ^ qHash((key.overlaysId << 20) | (key.mode << 16) | key.size, seed) ^ qHash(key.dpr, seed);
+}
+
+bool KIconPixmapCache::VariantKey::operator==(const VariantKey& other) const
+{
+    return pixmapKey == other.pixmapKey && effects == other.effects && color == other.color;
+}
+
+uint qHash(const KIconPixmapCache::VariantKey& key, uint seed)
+{
+    return qHash(key.pixmapKey, seed) ^ qHash(key.effects, seed) ^ qHash(key.color, seed);
+}
+
+bool KIconPixmapCache::find(const QString& name, const QStringList& overlays, int size, QIcon::Mode mode, qreal dpr, QPixmap* pixmap)
+{
+    const QPixmap* cachedPixmap = m_pixmaps.object(key(name, overlays, size, mode, dpr));
+    if (!cachedPixmap) {
+        ++m_misses;
+        return false;
+    }
+
+    ++m_hits;
+    *pixmap = *cachedPixmap;
+    return true;
+}
+
+void KIconPixmapCache::insert(const QString& name, const QStringList& overlays, int size, QIcon::Mode mode, qreal dpr, const QPixmap& pixmap)
+{
+    m_pixmaps.insert(key(name, overlays, size, mode, dpr), new QPixmap(pixmap), cost(pixmap));
+    KMemoryBudget::instance().scheduleCheck();
+}
+
+bool KIconPixmapCache::findVariant(const QPixmap& pixmap, quint32 effects, QRgb color, QPixmap* variant)
+{
+    const QPixmap* cachedVariant = m_variants.object(VariantKey{pixmap.cacheKey(), effects, color});
+    if (!cachedVariant) {
+        ++m_misses;
+        return false;
+    }
+
+    ++m_hits;
+    *variant = *cachedVariant;
+    return true;
+}
+
+void KIconPixmapCache::insertVariant(const QPixmap& pixmap, quint32 effects, QRgb color, const QPixmap& variant)
+{
+    m_variants.insert(VariantKey{pixmap.cacheKey(), effects, color}, new QPixmap(variant), cost(variant));
+    KMemoryBudget::instance().scheduleCheck();
+}
+
+void KIconPixmapCache::setWorkingSetHint(const void* view, int pixmapCount, int size)
+{
+    // Assume 32 bits per pixel
+    const qint64 cost = qint64(pixmapCount) * size * size * 4 / 1024;
+    if (m_workingSetCosts.value(view, -1) != cost) {
+        m_workingSetCosts.insert(view, cost);
+        updateMaximumCost();
+    }
+}
+
+void KIconPixmapCache::removeWorkingSetHint(const void* view)
+{
+    if (m_workingSetCosts.remove(view) > 0) {
+        updateMaximumCost();
+    }
+}
+
+int KIconPixmapCache::maximumCost() const
+{
+    return m_pixmaps.maxCost();
+}
+
+quint64 KIconPixmapCache::hits() const
+{
+    return m_hits;
+}
+
+quint64 KIconPixmapCache::misses() const
+{
+    return m_misses;
+}
+
+void KIconPixmapCache::resetStatistics()
+{
+    m_hits = 0;
+    m_misses = 0;
+}
+
+void KIconPixmapCache::clear()
+{
+    m_nameIds.clear();
+    m_overlaysIds.clear();
+    m_pixmaps.clear();
+    m_variants.clear();
+}
+
+QString KIconPixmapCache::memoryConsumerName() const
+{
+    return QStringLiteral("KIconPixmapCache");
+}
+
+qint64 KIconPixmapCache::memoryUsage() const
+{
+    // The costs are given in KiB
+    return (qint64(m_pixmaps.totalCost()) + m_variants.totalCost()) * 1024;
+}
+
+qint64 KIconPixmapCache::releaseMemory(qint64 bytes)
+{
+    const int cost = int(qMin<qint64>(bytes / 1024 + 1, MaximumCost * 2));
+    int released = trimCache(m_variants, cost);
+    if (released < cost) {
+        released += trimCache(m_pixmaps, cost - released);
+    }
+    return qint64(released) * 1024;
+}
+
+int KIconPixmapCache::cost(const QPixmap& pixmap)
+{
+    const qint64 bytes = qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+    return qMax(1, int(bytes / 1024));
+}
+
+void KIconPixmapCache::updateMaximumCost()
+{
+    qint64 cost = 0;
+    for (qint64 viewCost : qAsConst(m_workingSetCosts)) {
+        cost += viewCost;
+    }
+
+    const int maxCost = int(qBound(qint64(DefaultCost), cost, qint64(MaximumCost)));
+    if (maxCost != m_pixmaps.maxCost()) {
+        m_pixmaps.setMaxCost(maxCost);
+        m_variants.setMaxCost(maxCost);
+    }
+}
+
+KIconPixmapCache::Key KIconPixmapCache::key(const QString& name, const QStringList& overlays, int size, QIcon::Mode mode, qreal dpr)
+{
+    // Usually the number of different icon names and sets of overlays is
+    // small. If the limit is exceeded anyhow, the ids are assigned again,
+    // which invalidates the keys of all cached pixmaps. The variants are
+    // identified by the pixmaps and stay valid.
+    auto nameIt = m_nameIds.constFind(name);
+    if (nameIt == m_nameIds.constEnd()) {
+        if (m_nameIds.count() >= MaximumInternedIds) {
+            m_nameIds.clear();
+            m_overlaysIds.clear();
+            m_pixmaps.clear();
+        }
+        nameIt = m_nameIds.insert(name, m_nameIds.count());
+    }
+
+    int overlaysId = 0;
+    if (!overlays.isEmpty()) {
+        auto overlaysIt = m_overlaysIds.constFind(overlays);
+        if (overlaysIt == m_overlaysIds.constEnd()) {
+            if (m_overlaysIds.count() >= MaximumInternedIds) {
+                m_overlaysIds.clear();
+                m_pixmaps.clear();
+            }
+            // 0 is reserved for the items without overlays
+            overlaysIt = m_overlaysIds.insert(overlays, m_overlaysIds.count() + 1);
+        }
+        overlaysId = overlaysIt.value();
+    }
+
+    return Key{nameIt.value(), overlaysId, size, int(mode), dpr};
+}
@@ -0,0 +1,151 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KICONPIXMAPCACHE_H
+#define KICONPIXMAPCACHE_H
+
+#include "dolphin_export.h"
+#include "kitemviews/private/kmemorybudget.h"
+
+#include <QCache>
+#include <QColor>
+#include <QHash>
+#include <QIcon>
+#include <QPixmap>
+#include <QString>
+#include <QStringList>
+
+/**
+ * @brief Cache for the icon pixmaps of KStandardItemListWidget.
+ *
+ * The global QPixmapCache requires a string key, which must be built for
+ * each lookup, and its default size is too small for large icon views, so
+ * that the icons are loaded again and again while scrolling. Instead the
+ * icon names and the sets of overlays are interned into numbers once, and
+ * the pixmaps are identified by a compact key of these numbers, the size,
+ * the mode and the device pixel ratio.
+ *
+ * Additionally the variants of pixmaps that are shown for the states of the
+ * items, like the selected, hovered or cut state, are cached. Changing the
+ * state of an item, e.g. during a rubber band selection, does not need to
+ * apply the icon effects again.
+ *
+ * The size of the cache is adjusted to the sum of the working sets of the
+ * views, which are passed by setWorkingSetHint(). If the memory budget of KMemoryBudget is exceeded,
+ * the least recently used pixmaps are released, starting with the variants,
+ * which are cheap to recreate. The cache may only be used in the GUI thread.
+ */
+class DOLPHIN_EXPORT KIconPixmapCache : public KMemoryBudget::Consumer
+{
+public:
+    static KIconPixmapCache& instance();
+    ~KIconPixmapCache() override;
+
+    /**
+     * Sets \a pixmap to the cached pixmap of the icon \a name with the
+     * overlays \a overlays, the size \a size in device pixels and the mode
+     * \a mode for the device pixel ratio \a dpr.
+     * @return True if the pixmap has been found.
+     */
+    bool find(const QString& name, const QStringList& overlays, int size, QIcon::Mode mode, qreal dpr, QPixmap* pixmap);
+
+    void insert(const QString& name, const QStringList& overlays, int size, QIcon::Mode mode, qreal dpr, const QPixmap& pixmap);
+
+    /**
+     * Sets \a variant to the cached variant of \a pixmap with the effects
+     * \a effects, whose meaning is defined by the caller. \a color is the
+     * color that is used by the effects, if any. The variants are
+     * identified by QPixmap::cacheKey(), so they are shared by all items
+     * that show the same pixmap.
+     * @return True if the variant has been found.
+     */
+    bool findVariant(const QPixmap& pixmap, quint32 effects, QRgb color, QPixmap* variant);
+
+    void insertVariant(const QPixmap& pixmap, quint32 effects, QRgb color, const QPixmap& variant);
+
+    /**
+     * Assures that at least \a pixmapCount pixmaps of the size \a size in
+     * device pixels fit into the cache for the view \a view, in addition to
+     * the working sets of the other views. The cache never gets smaller than
+     * a default size and never larger than a maximum size.
+     */
+    void setWorkingSetHint(const void* view, int pixmapCount, int size);
+
+    /**
+     * Removes the working set of \a view, e.g. because it gets destroyed.
+     */
+    void removeWorkingSetHint(const void* view);
+
+    /**
+     * @return Maximum size of all cached pixmaps in KiB.
+     */
+    int maximumCost() const;
+
+    /**
+     * @return Number of calls of find() and findVariant() that have found a pixmap or not,
+     *         since the cache has been created or resetStatistics() has
+     *         been invoked.
+     */
+    quint64 hits() const;
+    quint64 misses() const;
+    void resetStatistics();
+
+    /**
+     * Removes all pixmaps and the interned icon names, e.g. because the
+     * icon theme has been changed.
+     */
+    void clear();
+
+    QString memoryConsumerName() const override;
+    qint64 memoryUsage() const override;
+    qint64 releaseMemory(qint64 bytes) override;
+
+protected:
+    KIconPixmapCache();
+
+private:
+    struct Key
+    {
+        int nameId;
+        int overlaysId;
+        int size;
+        int mode;
+        qreal dpr;
+
+        bool operator==(const Key& other) const;
+    };
+
+    struct VariantKey
+    {
+        qint64 pixmapKey;
+        quint32 effects;
+        QRgb color;
+
+        bool operator==(const VariantKey& other) const;
+    };
+
+    friend uint qHash(const Key& key, uint seed);
+    friend uint qHash(const VariantKey& key, uint seed);
+
+    static int cost(const QPixmap& pixmap);
+
+    void updateMaximumCost();
+
+    Key key(const QString& name, const QStringList& overlays, int size, QIcon::Mode mode, qreal dpr);
+
+private:
+    QHash<QString, int> m_nameIds;
+    QHash<QStringList, int> m_overlaysIds;
+    QCache<Key, QPixmap> m_pixmaps;
+    QCache<VariantKey, QPixmap> m_variants;
+    QHash<const void*, qint64> m_workingSetCosts;
+    quint64 m_hits;
+    quint64 m_misses;
+
+    friend struct KIconPixmapCacheSingleton;
+};
+
+#endif
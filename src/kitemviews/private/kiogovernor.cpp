@@ -0,0 +1,208 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kiogovernor.h"
+
+#include <KMountPoint>
+
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <algorithm>
+
+namespace {
+    // Maximum number of tasks per subsystem that may access a fast mount at
+    // the same time. They are shared by all views of the process.
+    const int FastBudgets[KIoGovernor::SubsystemCount] = {
+        4, // DirectoryCounting
+        4, // MimeTypes
+        2  // VersionControl
+    };
+
+    // Maximum number of tasks per subsystem on a slow mount
+    const int SlowBudget = 1;
+
+    // Average latency in ms from which on a mount is considered as slow. It
+    // only becomes fast again if the average falls below a quarter of it,
+    // so that the classification does not jump back and forth.
+    const qreal SlowLatency = 50;
+    const qreal FastLatency = SlowLatency / 4;
+
+    // Number of latencies that must have been reported before a mount
+    // may be classified as slow. A single cold access is not enough.
+    const int MinimumSamples = 4;
+
+    // Weight of a new latency for the exponential moving average
+    const qreal LatencyWeight = 0.2;
+
+    // Time in ms after which the mount table is read again
+    const qint64 MountPointsLifetime = 10 * 1000;
+}
+
+struct KIoGovernorSingleton
+{
+    KIoGovernor instance;
+};
+Q_GLOBAL_STATIC(KIoGovernorSingleton, s_ioGovernor)
+
+
+KIoGovernor& KIoGovernor::instance()
+{
+    return s_ioGovernor->instance;
+}
+
+KIoGovernor::~KIoGovernor()
+{
+}
+
+QString KIoGovernor::mountPoint(const QString& path) const
+{
+    QMutexLocker locker(&m_mutex);
+    return mountPointLocked(path);
+}
+
+void KIoGovernor::reportLatency(const QString& path, qint64 latency)
+{
+    QString changedMountPoint;
+    {
+        QMutexLocker locker(&m_mutex);
+        const QString mountPoint = mountPointLocked(path);
+        MountState& state = m_mounts[mountPoint];
+        if (state.samples == 0) {
+            state.averageLatency = latency;
+        } else {
+            state.averageLatency += LatencyWeight * (latency - state.averageLatency);
+        }
+        ++state.samples;
+
+        if (!state.slow && state.samples >= MinimumSamples && state.averageLatency >= SlowLatency) {
+            state.slow = true;
+            ++m_slowMountCount;
+            changedMountPoint = mountPoint;
+        } else if (state.slow && state.averageLatency < FastLatency) {
+            state.slow = false;
+            --m_slowMountCount;
+            changedMountPoint = mountPoint;
+        }
+    }
+
+    if (!changedMountPoint.isNull()) {
+        Q_EMIT slowMountsChanged(changedMountPoint);
+    }
+}
+
+bool KIoGovernor::isSlow(const QString& path) const
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_slowMountCount == 0) {
+        return false;
+    }
+    return m_mounts.value(mountPointLocked(path)).slow;
+}
+
+bool KIoGovernor::hasSlowMounts() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_slowMountCount > 0;
+}
+
+int KIoGovernor::budget(Subsystem subsystem, const QString& path) const
+{
+    QMutexLocker locker(&m_mutex);
+    return budgetLocked(subsystem, mountPointLocked(path));
+}
+
+int KIoGovernor::acquire(Subsystem subsystem, const QString& path, int count)
+{
+    QMutexLocker locker(&m_mutex);
+    const QString mountPoint = mountPointLocked(path);
+    const int budget = budgetLocked(subsystem, mountPoint);
+    MountState& state = m_mounts[mountPoint];
+    const int acquired = qBound(0, budget - state.usedTokens[subsystem], count);
+    state.usedTokens[subsystem] += acquired;
+    return acquired;
+}
+
+void KIoGovernor::release(Subsystem subsystem, const QString& path, int count)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        MountState& state = m_mounts[mountPointLocked(path)];
+        Q_ASSERT(state.usedTokens[subsystem] >= count);
+        state.usedTokens[subsystem] = qMax(0, state.usedTokens[subsystem] - count);
+    }
+
+    Q_EMIT released();
+}
+
+void KIoGovernor::resetLatencies()
+{
+    QMutexLocker locker(&m_mutex);
+    for (MountState& state : m_mounts) {
+        state.averageLatency = 0;
+        state.samples = 0;
+        state.slow = false;
+    }
+    m_slowMountCount = 0;
+}
+
+KIoGovernor::KIoGovernor() :
+    QObject(),
+    m_mutex(),
+    m_mountPoints(),
+    m_mountPointsTimer(),
+    m_mounts(),
+    m_slowMountCount(0)
+{
+    // The latencies are reported by worker threads, which might create the
+    // instance. The signals are nevertheless used in the main thread.
+    if (QCoreApplication::instance() && thread() != QCoreApplication::instance()->thread()) {
+        moveToThread(QCoreApplication::instance()->thread());
+    }
+}
+
+QString KIoGovernor::mountPointLocked(const QString& path) const
+{
+    if (!m_mountPointsTimer.isValid() || m_mountPointsTimer.elapsed() > MountPointsLifetime) {
+        // KMountPoint::List::findByPath() resolves the path, which would access
+        // the filesystem. Only the mount points are needed to compare them with
+        // the paths.
+        m_mountPoints.clear();
+        const KMountPoint::List mountPoints = KMountPoint::currentMountPoints();
+        for (const KMountPoint::Ptr& mountPoint : mountPoints) {
+            m_mountPoints.append(mountPoint->mountPoint());
+        }
+        std::sort(m_mountPoints.begin(), m_mountPoints.end(), [](const QString& a, const QString& b) {
+            return a.length() > b.length();
+        });
+        m_mountPointsTimer.start();
+    }
+
+    for (const QString& mountPoint : qAsConst(m_mountPoints)) {
+        if (path.startsWith(mountPoint)
+                && (path.length() == mountPoint.length()
+                    || mountPoint.endsWith(QLatin1Char('/'))
+                    || path.at(mountPoint.length()) == QLatin1Char('/'))) {
+            return mountPoint;
+        }
+    }
+
+    return QString();
+}
+
+int KIoGovernor::budgetLocked(Subsystem subsystem, const QString& mountPoint) const
+{
+    const auto it = m_mounts.constFind(mountPoint);
+    if (it != m_mounts.constEnd() && it->slow) {
+        return SlowBudget;
+    }
+    return FastBudgets[subsystem];
+}
@@ -0,0 +1,144 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KIOGOVERNOR_H
+#define KIOGOVERNOR_H
+
+#include "dolphin_export.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+
+/**
+ * @brief Shares the I/O capacity of the mounts between the background tasks.
+ *
+ * Counting directories, determining MIME-types by content and retrieving
+ * version information access the filesystem in the background. On a slow
+ * network mount these tasks of all views would saturate the connection
+ * and starve the listing of the folder the user looks at.
+ *
+ * Each background subsystem acquires a token for the mount of the path it
+ * is going to access, and it is only allowed to run a limited number of
+ * tasks per mount at the same time. The subsystems report the latencies of
+ * cheap filesystem operations, like opening a directory, and mounts whose
+ * average latency is high are classified as slow. On slow mounts only one
+ * task per subsystem may run, and expensive roles like the recursive size of
+ * directories or previews should not be determined at all.
+ *
+ * The mounts are identified by their mount points, which are determined by
+ * comparing the paths with the mount table. The filesystem is not accessed,
+ * so all methods may be called from any thread.
+ */
+class DOLPHIN_EXPORT KIoGovernor : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Subsystem {
+        DirectoryCounting,
+        MimeTypes,
+        VersionControl,
+        SubsystemCount
+    };
+
+    static KIoGovernor& instance();
+    ~KIoGovernor() override;
+
+    /**
+     * @return Mount point of the mount that contains the local \a path,
+     *         or an empty string if it is unknown.
+     */
+    QString mountPoint(const QString& path) const;
+
+    /**
+     * Reports that a cheap filesystem operation on the local \a path has
+     * taken \a latency ms. The signal slowMountsChanged() is emitted if
+     * the mount has been classified as slow or as fast again.
+     */
+    void reportLatency(const QString& path, qint64 latency);
+
+    /**
+     * @return True if the mount that contains the local \a path
+     *         has been classified as slow.
+     */
+    bool isSlow(const QString& path) const;
+
+    /**
+     * @return True if any mount has been classified as slow. Allows to skip
+     *         the per item checks in the common case.
+     */
+    bool hasSlowMounts() const;
+
+    /**
+     * @return Maximum number of tasks of \a subsystem that may access the
+     *         mount of \a path at the same time.
+     */
+    int budget(Subsystem subsystem, const QString& path) const;
+
+    /**
+     * Acquires up to \a count tokens of \a subsystem for the mount of \a path.
+     * @return Number of acquired tokens, which might be 0 if the budget of
+     *         the mount is exhausted.
+     */
+    int acquire(Subsystem subsystem, const QString& path, int count = 1);
+
+    /**
+     * Releases \a count tokens that have been acquired by acquire().
+     * The signal released() is emitted.
+     */
+    void release(Subsystem subsystem, const QString& path, int count = 1);
+
+    /**
+     * Forgets all measured latencies, e.g. for tests.
+     */
+    void resetLatencies();
+
+Q_SIGNALS:
+    /**
+     * Is emitted if tokens have been released. Subsystems that wait
+     * for a token should try to acquire one.
+     */
+    void released();
+
+    /**
+     * Is emitted if the mount \a mountPoint has been classified as
+     * slow or as fast again.
+     */
+    void slowMountsChanged(const QString& mountPoint);
+
+protected:
+    KIoGovernor();
+
+private:
+    struct MountState {
+        qreal averageLatency;
+        int samples;
+        bool slow;
+        int usedTokens[SubsystemCount];
+    };
+
+    /**
+     * Must be invoked while m_mutex is locked.
+     */
+    QString mountPointLocked(const QString& path) const;
+
+    int budgetLocked(Subsystem subsystem, const QString& mountPoint) const;
+
+private:
+    mutable QMutex m_mutex;
+    // Sorted by descending length, so that the first matching mount point is the innermost one
+    mutable QStringList m_mountPoints;
+    mutable QElapsedTimer m_mountPointsTimer;
+    QHash<QString, MountState> m_mounts;
+    int m_slowMountCount;
+
+    friend struct KIoGovernorSingleton;
+};
+
+#endif
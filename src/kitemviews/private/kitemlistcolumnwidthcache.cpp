@@ -0,0 +1,163 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemlistcolumnwidthcache.h"
+
+#include <algorithm>
+#include <iterator>
+
+KItemListColumnWidthCache::KItemListColumnWidthCache() :
+    m_roles(),
+    m_count(0),
+    m_widths(),
+    m_maximumWidths(),
+    m_maximumWidthsDirty()
+{
+}
+
+KItemListColumnWidthCache::~KItemListColumnWidthCache()
+{
+}
+
+void KItemListColumnWidthCache::setRoles(const QList<QByteArray>& roles)
+{
+    m_roles = roles;
+    reset(m_count);
+}
+
+QList<QByteArray> KItemListColumnWidthCache::roles() const
+{
+    return m_roles;
+}
+
+void KItemListColumnWidthCache::reset(int itemCount)
+{
+    m_count = itemCount;
+    m_widths.fill(-1.0, itemCount * m_roles.count());
+    m_maximumWidths.fill(0.0, m_roles.count());
+    m_maximumWidthsDirty.fill(false, m_roles.count());
+}
+
+int KItemListColumnWidthCache::count() const
+{
+    return m_count;
+}
+
+void KItemListColumnWidthCache::itemsInserted(const KItemRangeList& itemRanges)
+{
+    const int roleCount = m_roles.count();
+
+    int insertedCount = 0;
+    for (const KItemRange& range : itemRanges) {
+        insertedCount += range.count;
+    }
+
+    // The indexes of the ranges refer to the items before the insertion.
+    QVector<qreal> widths;
+    widths.reserve((m_count + insertedCount) * roleCount);
+
+    auto begin = m_widths.constBegin();
+    int sourceIndex = 0;
+    for (const KItemRange& range : itemRanges) {
+        std::copy(begin + sourceIndex * roleCount, begin + range.index * roleCount, std::back_inserter(widths));
+        widths.insert(widths.end(), range.count * roleCount, -1.0);
+        sourceIndex = range.index;
+    }
+    std::copy(begin + sourceIndex * roleCount, m_widths.constEnd(), std::back_inserter(widths));
+
+    m_widths = widths;
+    m_count += insertedCount;
+}
+
+void KItemListColumnWidthCache::itemsRemoved(const KItemRangeList& itemRanges)
+{
+    const int roleCount = m_roles.count();
+
+    int removedCount = 0;
+    for (const KItemRange& range : itemRanges) {
+        removedCount += range.count;
+        for (int index = range.index; index < range.index + range.count; ++index) {
+            invalidateMaximumWidths(index);
+        }
+    }
+
+    QVector<qreal> widths;
+    widths.reserve((m_count - removedCount) * roleCount);
+
+    auto begin = m_widths.constBegin();
+    int sourceIndex = 0;
+    for (const KItemRange& range : itemRanges) {
+        std::copy(begin + sourceIndex * roleCount, begin + range.index * roleCount, std::back_inserter(widths));
+        sourceIndex = range.index + range.count;
+    }
+    std::copy(begin + sourceIndex * roleCount, m_widths.constEnd(), std::back_inserter(widths));
+
+    m_widths = widths;
+    m_count -= removedCount;
+}
+
+void KItemListColumnWidthCache::itemsMoved(const KItemRange& range, const QList<int>& movedToIndexes)
+{
+    const int roleCount = m_roles.count();
+    const QVector<qreal> previousWidths = m_widths;
+
+    const int movedRangeEnd = range.index + range.count;
+    for (int i = range.index; i < movedRangeEnd; ++i) {
+        const int newIndex = movedToIndexes.at(i - range.index);
+        std::copy(previousWidths.constBegin() + i * roleCount,
+                  previousWidths.constBegin() + (i + 1) * roleCount,
+                  m_widths.begin() + newIndex * roleCount);
+    }
+}
+
+void KItemListColumnWidthCache::itemsChanged(const KItemRangeList& itemRanges)
+{
+    const int roleCount = m_roles.count();
+    for (const KItemRange& range : itemRanges) {
+        for (int index = range.index; index < range.index + range.count; ++index) {
+            invalidateMaximumWidths(index);
+            std::fill(m_widths.begin() + index * roleCount, m_widths.begin() + (index + 1) * roleCount, -1.0);
+        }
+    }
+}
+
+bool KItemListColumnWidthCache::isCalculated(int index) const
+{
+    return m_roles.isEmpty() || m_widths.at(index * m_roles.count()) >= 0.0;
+}
+
+void KItemListColumnWidthCache::setWidth(int index, int roleIndex, qreal width)
+{
+    m_widths[index * m_roles.count() + roleIndex] = width;
+    if (!m_maximumWidthsDirty.at(roleIndex) && width > m_maximumWidths.at(roleIndex)) {
+        m_maximumWidths[roleIndex] = width;
+    }
+}
+
+qreal KItemListColumnWidthCache::maximumWidth(int roleIndex) const
+{
+    if (m_maximumWidthsDirty.at(roleIndex)) {
+        const int roleCount = m_roles.count();
+        qreal maximumWidth = 0.0;
+        for (int i = roleIndex; i < m_widths.count(); i += roleCount) {
+            maximumWidth = qMax(maximumWidth, m_widths.at(i));
+        }
+        m_maximumWidths[roleIndex] = maximumWidth;
+        m_maximumWidthsDirty[roleIndex] = false;
+    }
+    return m_maximumWidths.at(roleIndex);
+}
+
+void KItemListColumnWidthCache::invalidateMaximumWidths(int index)
+{
+    const int roleCount = m_roles.count();
+    for (int roleIndex = 0; roleIndex < roleCount; ++roleIndex) {
+        const qreal width = m_widths.at(index * roleCount + roleIndex);
+        if (width >= 0.0 && width >= m_maximumWidths.at(roleIndex)) {
+            m_maximumWidthsDirty[roleIndex] = true;
+        }
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KITEMLISTCOLUMNWIDTHCACHE_H
+#define KITEMLISTCOLUMNWIDTHCACHE_H
+
+#include "dolphin_export.h"
+#include "kitemviews/kitemmodelbase.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+
+/**
+ * @brief Caches the preferred column widths of the items in KItemListView.
+ *
+ * Calculating the preferred width of a column for an item requires font
+ * metrics and is expensive. The widths are calculated once for each item
+ * and role and are stored together with the maximum width of each role.
+ * When items are inserted or changed, only the widths of these items must
+ * be calculated. The maximum width of a role is determined again from the
+ * cached widths only if the item having the maximum width is removed or
+ * changed.
+ */
+class DOLPHIN_EXPORT KItemListColumnWidthCache
+{
+public:
+    KItemListColumnWidthCache();
+    ~KItemListColumnWidthCache();
+
+    /**
+     * Sets the roles whose widths are cached. The widths of all
+     * items are invalidated.
+     */
+    void setRoles(const QList<QByteArray>& roles);
+    QList<QByteArray> roles() const;
+
+    /**
+     * Invalidates the widths of all items and sets the number
+     * of items to \a itemCount.
+     */
+    void reset(int itemCount);
+
+    /**
+     * @return Number of items.
+     */
+    int count() const;
+
+    void itemsInserted(const KItemRangeList& itemRanges);
+    void itemsRemoved(const KItemRangeList& itemRanges);
+    void itemsMoved(const KItemRange& range, const QList<int>& movedToIndexes);
+    void itemsChanged(const KItemRangeList& itemRanges);
+
+    /**
+     * @return True if the widths of the item with the index \a index
+     *         have been set by setWidth() since it has been inserted
+     *         or changed.
+     */
+    bool isCalculated(int index) const;
+
+    /**
+     * Sets the preferred width of the role with the index \a roleIndex
+     * in roles() for the item with the index \a index.
+     */
+    void setWidth(int index, int roleIndex, qreal width);
+
+    /**
+     * @return Maximum preferred width of the role with the index
+     *         \a roleIndex in roles() of all calculated items.
+     */
+    qreal maximumWidth(int roleIndex) const;
+
+private:
+    /**
+     * Marks the maximum widths as outdated, if the widths of the
+     * item with the index \a index are equal to them.
+     */
+    void invalidateMaximumWidths(int index);
+
+private:
+    QList<QByteArray> m_roles;
+    int m_count;
+    QVector<qreal> m_widths; // For each item one width per role, -1 if not calculated
+    mutable QVector<qreal> m_maximumWidths;
+    mutable QVector<bool> m_maximumWidthsDirty;
+};
+
+#endif
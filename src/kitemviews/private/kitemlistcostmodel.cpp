@@ -0,0 +1,212 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemlistcostmodel.h"
+
+#include "kitemlisttracer.h"
+
+#include <QGuiApplication>
+#include <QScreen>
+
+namespace {
+    // Costs in ns per item that are assumed before the first measurement.
+    // They result in the budgets that have been fixed before.
+    const qreal DefaultResolveCost = 1000 * 1000;
+    const qreal DefaultInsertionCost = 10 * 1000;
+    const qreal DefaultResortCost = 10 * 1000;
+
+    // Weight of a new sample for the exponential moving averages
+    const qreal SampleWeight = 0.1;
+
+    // Samples of fewer items are dominated by the fixed costs
+    const int MinimumSampleItems = 10;
+
+    // Fallback if the refresh rate of the screen is unknown
+    const qreal DefaultFrameDuration = 1000.0 / 60;
+
+    // Part of a frame in ms that is always assumed to be left for other work
+    const qreal MinimumFrameBudget = 2;
+
+    // Bounds of the blocking time in frame budgets. Resolving the visible
+    // items may take twice as long as the measured cost before it is
+    // continued asynchronously.
+    const int MinimumBlockFrames = 2;
+    const int MaximumBlockFrames = 12;
+    const qreal BlockCostFactor = 2;
+    const int DefaultVisibleItems = 100;
+
+    // The roles of all items are resolved if this takes at most ResolveAllTime ms
+    const qreal ResolveAllTime = 500;
+    const int MinimumResolveAllItemsLimit = 100;
+    const int MaximumResolveAllItemsLimit = 10000;
+
+    // The items of a directory are collected at most as long as inserting
+    // ReferenceInsertionCount items takes, multiplied by UpdateCostFactor.
+    const int ReferenceInsertionCount = 20000;
+    const qreal UpdateCostFactor = 10;
+    const int MinimumMaximumUpdateInterval = 500;
+    const int MaximumMaximumUpdateInterval = 4000;
+
+    // The sort role values are collected ResortCostFactor times as long
+    // as resorting takes, so that at most a tenth of the time is spent
+    // with resorting.
+    const qreal ResortCostFactor = 10;
+    const int MinimumResortDelay = 200;
+    const int MaximumResortDelay = 2000;
+
+    // Resorting is done in a worker thread if it would block the main thread
+    // longer than AsyncResortTime ms. The maximum limit has been fixed before.
+    const qreal AsyncResortTime = 200;
+    const int MinimumAsyncResortItemsLimit = 1000;
+    const int MaximumAsyncResortItemsLimit = 20000;
+
+    void addSample(qreal& average, qreal value)
+    {
+        average += SampleWeight * (value - average);
+    }
+}
+
+struct KItemListCostModelSingleton
+{
+    KItemListCostModel instance;
+};
+Q_GLOBAL_STATIC(KItemListCostModelSingleton, s_costModel)
+
+
+KItemListCostModel& KItemListCostModel::instance()
+{
+    return s_costModel->instance;
+}
+
+KItemListCostModel::~KItemListCostModel()
+{
+}
+
+void KItemListCostModel::addResolveSample(int itemCount, qint64 duration)
+{
+    if (itemCount >= MinimumSampleItems) {
+        addSample(m_resolveCost, qreal(duration) / itemCount);
+        traceBudgets();
+    }
+}
+
+void KItemListCostModel::addInsertionSample(int itemCount, qint64 duration)
+{
+    if (itemCount >= MinimumSampleItems) {
+        addSample(m_insertionCost, qreal(duration) / itemCount);
+        traceBudgets();
+    }
+}
+
+void KItemListCostModel::addResortSample(int itemCount, qint64 duration)
+{
+    if (itemCount >= MinimumSampleItems) {
+        addSample(m_resortCost, qreal(duration) / itemCount);
+        traceBudgets();
+    }
+}
+
+void KItemListCostModel::addPaintSample(qint64 duration)
+{
+    // Painting happens for each frame, the budgets are traced by the other samples
+    addSample(m_paintTime, duration);
+}
+
+qreal KItemListCostModel::resolveCost() const
+{
+    return m_resolveCost;
+}
+
+qreal KItemListCostModel::insertionCost() const
+{
+    return m_insertionCost;
+}
+
+qreal KItemListCostModel::resortCost() const
+{
+    return m_resortCost;
+}
+
+qreal KItemListCostModel::frameBudget() const
+{
+    return qMax(MinimumFrameBudget, frameDuration() - m_paintTime / (1000 * 1000));
+}
+
+int KItemListCostModel::maxBlockTimeout(int visibleItems) const
+{
+    if (visibleItems <= 0) {
+        visibleItems = DefaultVisibleItems;
+    }
+
+    const qreal budget = frameBudget();
+    const qreal timeout = BlockCostFactor * visibleItems * m_resolveCost / (1000 * 1000);
+    return qRound(qBound(MinimumBlockFrames * budget, timeout, MaximumBlockFrames * budget));
+}
+
+int KItemListCostModel::resolveAllItemsLimit() const
+{
+    const qreal limit = ResolveAllTime * 1000 * 1000 / m_resolveCost;
+    return qRound(qBound<qreal>(MinimumResolveAllItemsLimit, limit, MaximumResolveAllItemsLimit));
+}
+
+int KItemListCostModel::maximumUpdateInterval() const
+{
+    const qreal interval = UpdateCostFactor * ReferenceInsertionCount * m_insertionCost / (1000 * 1000);
+    return qRound(qBound<qreal>(MinimumMaximumUpdateInterval, interval, MaximumMaximumUpdateInterval));
+}
+
+int KItemListCostModel::resortDelay(int itemCount) const
+{
+    const qreal delay = ResortCostFactor * itemCount * m_resortCost / (1000 * 1000);
+    return qRound(qBound<qreal>(MinimumResortDelay, delay, MaximumResortDelay));
+}
+
+int KItemListCostModel::asyncResortItemsLimit() const
+{
+    const qreal limit = AsyncResortTime * 1000 * 1000 / m_resortCost;
+    return qRound(qBound<qreal>(MinimumAsyncResortItemsLimit, limit, MaximumAsyncResortItemsLimit));
+}
+
+void KItemListCostModel::reset()
+{
+    m_resolveCost = DefaultResolveCost;
+    m_insertionCost = DefaultInsertionCost;
+    m_resortCost = DefaultResortCost;
+    m_paintTime = 0;
+    m_frameDuration = -1;
+}
+
+KItemListCostModel::KItemListCostModel() :
+    m_resolveCost(DefaultResolveCost),
+    m_insertionCost(DefaultInsertionCost),
+    m_resortCost(DefaultResortCost),
+    m_paintTime(0),
+    m_frameDuration(-1)
+{
+}
+
+qreal KItemListCostModel::frameDuration() const
+{
+    if (m_frameDuration < 0) {
+        const QScreen* screen = qobject_cast<QGuiApplication*>(QCoreApplication::instance())
+                                ? QGuiApplication::primaryScreen() : nullptr;
+        const qreal refreshRate = screen ? screen->refreshRate() : 0;
+        m_frameDuration = refreshRate > 0 ? 1000 / refreshRate : DefaultFrameDuration;
+    }
+    return m_frameDuration;
+}
+
+void KItemListCostModel::traceBudgets() const
+{
+    if (!KItemListTracer::isEnabled()) {
+        return;
+    }
+
+    KItemListTracer::addCounter("KItemListCostModel::maxBlockTimeout", maxBlockTimeout(0));
+    KItemListTracer::addCounter("KItemListCostModel::resolveAllItemsLimit", resolveAllItemsLimit());
+    KItemListTracer::addCounter("KItemListCostModel::maximumUpdateInterval", maximumUpdateInterval());
+    KItemListTracer::addCounter("KItemListCostModel::resortCost", qRound64(m_resortCost));
+}
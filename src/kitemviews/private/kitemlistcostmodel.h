@@ -0,0 +1,139 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KITEMLISTCOSTMODEL_H
+#define KITEMLISTCOSTMODEL_H
+
+#include "dolphin_export.h"
+
+#include <QtGlobal>
+
+/**
+ * @brief Derives the time budgets of the item views from measured costs.
+ *
+ * KFileItemModel and KFileItemModelRolesUpdater block the user interface for
+ * a limited time, e.g. to resolve the icons of the visible items, and delay
+ * expensive operations to bundle them, e.g. resorting. Fixed budgets are too
+ * aggressive on slow machines and too conservative on fast ones, so they are
+ * calculated from the costs that are measured while the views are used:
+ *
+ * - The time for resolving all roles of an item decides how many items may
+ *   be resolved within the time the user interface may be blocked.
+ * - The time for painting a view decides how much of a frame is left for
+ *   other work, which limits the time the user interface may be blocked.
+ * - The times for inserting and resorting items decide how long the items
+ *   are collected before they are inserted or resorted together, and
+ *   whether resorting is done in a worker thread.
+ *
+ * The costs are exponential moving averages, so that single outliers like
+ * a cold cache don't change the budgets much. Without any measurements the
+ * budgets correspond to the values that have been used before they became
+ * adaptive. If tracing is enabled by KItemListTracer, the budgets are
+ * recorded as counters whenever they change.
+ *
+ * The cost model is shared by all views and may only be used by the main thread.
+ */
+class DOLPHIN_EXPORT KItemListCostModel
+{
+public:
+    static KItemListCostModel& instance();
+    virtual ~KItemListCostModel();
+
+    /**
+     * Records that resolving all roles of \a itemCount items took \a duration ns.
+     * Resolving only the roles that are cheap to determine must not be recorded.
+     */
+    void addResolveSample(int itemCount, qint64 duration);
+
+    /**
+     * Records that inserting \a itemCount items into a model, including the
+     * layouting of the view, took \a duration ns.
+     */
+    void addInsertionSample(int itemCount, qint64 duration);
+
+    /**
+     * Records that resorting \a itemCount items took \a duration ns.
+     */
+    void addResortSample(int itemCount, qint64 duration);
+
+    /**
+     * Records that painting a view took \a duration ns.
+     */
+    void addPaintSample(qint64 duration);
+
+    /**
+     * @return Average costs in ns per item.
+     */
+    qreal resolveCost() const;
+    qreal insertionCost() const;
+    qreal resortCost() const;
+
+    /**
+     * @return Time in ms of a frame of the primary screen that is left
+     *         after painting a view.
+     */
+    qreal frameBudget() const;
+
+    /**
+     * @return Maximum time in ms that a blocking operation may take, which
+     *         should usually be sufficient to resolve \a visibleItems items.
+     */
+    int maxBlockTimeout(int visibleItems) const;
+
+    /**
+     * @return Number of items up to which the roles of all items of a
+     *         model are resolved, instead of only the items near the
+     *         visible area.
+     */
+    int resolveAllItemsLimit() const;
+
+    /**
+     * @return Maximum time in ms that the items that are received while
+     *         loading a directory are collected before they are inserted.
+     */
+    int maximumUpdateInterval() const;
+
+    /**
+     * @return Time in ms that the changes of sort role values are collected
+     *         before all \a itemCount items of a model are resorted.
+     */
+    int resortDelay(int itemCount) const;
+
+    /**
+     * @return Number of items from which on resorting all items of a model
+     *         is done in a worker thread. All windows of the process share
+     *         the main thread, so a resorting that takes long would freeze
+     *         all of them.
+     */
+    int asyncResortItemsLimit() const;
+
+    /**
+     * Forgets all measured costs, e.g. for tests.
+     */
+    void reset();
+
+protected:
+    KItemListCostModel();
+
+private:
+    qreal frameDuration() const;
+
+    /**
+     * Records the budgets as counters if tracing is enabled.
+     */
+    void traceBudgets() const;
+
+private:
+    qreal m_resolveCost;
+    qreal m_insertionCost;
+    qreal m_resortCost;
+    qreal m_paintTime;
+    mutable qreal m_frameDuration; // Is determined from the refresh rate when it is needed first
+
+    friend struct KItemListCostModelSingleton;
+};
+
+#endif
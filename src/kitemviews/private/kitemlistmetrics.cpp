@@ -0,0 +1,79 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemlistmetrics.h"
+
+namespace {
+    // Names in the order of KItemListMetrics::Metric
+    const char* const MetricNames[] = {
+        "itemsLoaded",
+        "sorts",
+        "sortNsecs",
+        "filters",
+        "filterNsecs",
+        "previewCacheHits",
+        "previewCacheMisses",
+        "previewsCreated",
+        "queuedDirectories",
+        "versionControlPasses",
+        "versionControlNsecs",
+        "models",
+        "roleResolutions",
+        "roleDirectoryCountNsecs",
+        "roleTypeNsecs",
+        "roleOverlaysNsecs",
+        "roleBalooNsecs",
+        "roleIconNsecs",
+        "directoriesCounted",
+        "directoryCountNsecs"
+    };
+    static_assert(sizeof(MetricNames) / sizeof(MetricNames[0]) == KItemListMetrics::MetricCount,
+                  "Each metric needs a name");
+}
+
+struct KItemListMetricsSingleton
+{
+    KItemListMetrics instance;
+};
+Q_GLOBAL_STATIC(KItemListMetricsSingleton, s_metrics)
+
+
+KItemListMetrics& KItemListMetrics::instance()
+{
+    return s_metrics->instance;
+}
+
+KItemListMetrics::~KItemListMetrics()
+{
+}
+
+void KItemListMetrics::add(Metric metric, qint64 value)
+{
+    m_values[metric].fetchAndAddRelaxed(value);
+}
+
+qint64 KItemListMetrics::value(Metric metric) const
+{
+    return m_values[metric].loadRelaxed();
+}
+
+QString KItemListMetrics::name(Metric metric)
+{
+    return QString::fromLatin1(MetricNames[metric]);
+}
+
+void KItemListMetrics::reset()
+{
+    for (int metric = 0; metric < MetricCount; ++metric) {
+        if (metric != QueuedDirectories && metric != Models) {
+            m_values[metric].storeRelaxed(0);
+        }
+    }
+}
+
+KItemListMetrics::KItemListMetrics()
+{
+}
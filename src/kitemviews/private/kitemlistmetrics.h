@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KITEMLISTMETRICS_H
+#define KITEMLISTMETRICS_H
+
+#include "dolphin_export.h"
+
+#include <QAtomicInteger>
+#include <QString>
+
+/**
+ * @brief Counts the work of the models and views over the lifetime of the process.
+ *
+ * Processes that are started with --daemon run for weeks. The metrics allow
+ * to monitor them, they are provided by the D-Bus object /org/kde/dolphin/Metrics.
+ * Most metrics are counters that only grow, like the number of loaded items
+ * or the accumulated duration of all resortings. Others are gauges that
+ * describe the current state, like the number of queued directories.
+ *
+ * The metrics are atomic and may be updated by any thread.
+ */
+class DOLPHIN_EXPORT KItemListMetrics
+{
+public:
+    enum Metric {
+        ItemsLoaded,            // Items inserted into all models
+        Sorts,                  // Resortings of all items of a model
+        SortNsecs,
+        Filters,                // Filterings of all items of a model
+        FilterNsecs,
+        PreviewCacheHits,       // Previews that have been found in KPreviewCache
+        PreviewCacheMisses,
+        PreviewsCreated,        // Previews that have been created by KIO::PreviewJob
+        QueuedDirectories,      // Gauge: Directories waiting for KDirectoryContentsCounter
+        VersionControlPasses,   // Retrievals of the version control states
+        VersionControlNsecs,
+        Models,                 // Gauge: Existing instances of KFileItemModel
+        RoleResolutions,        // Items whose roles have been resolved by KFileItemModelRolesUpdater
+        RoleDirectoryCountNsecs, // Main thread time of each provider of the roles
+        RoleTypeNsecs,
+        RoleOverlaysNsecs,
+        RoleBalooNsecs,
+        RoleIconNsecs,          // Determining the MIME-types and icons
+        DirectoriesCounted,     // Directories counted by the worker thread of KDirectoryContentsCounter
+        DirectoryCountNsecs,
+        MetricCount
+    };
+
+    static KItemListMetrics& instance();
+    virtual ~KItemListMetrics();
+
+    /**
+     * Adds \a value to the metric \a metric. Gauges are decreased by
+     * negative values.
+     */
+    void add(Metric metric, qint64 value = 1);
+    qint64 value(Metric metric) const;
+
+    /**
+     * @return Name of the metric \a metric, e.g. "itemsLoaded".
+     */
+    static QString name(Metric metric);
+
+    /**
+     * Resets all counters to 0, e.g. for tests. The gauges are kept.
+     */
+    void reset();
+
+protected:
+    KItemListMetrics();
+
+private:
+    QAtomicInteger<qint64> m_values[MetricCount];
+
+    friend struct KItemListMetricsSingleton;
+};
+
+#endif
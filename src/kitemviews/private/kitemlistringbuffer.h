@@ -0,0 +1,370 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KITEMLISTRINGBUFFER_H
+#define KITEMLISTRINGBUFFER_H
+
+#include <QList>
+#include <QPair>
+#include <QVector>
+
+/**
+ * @brief Stores values for a range of item indexes in a contiguous ring buffer.
+ *
+ * KItemListView keeps a value, like the widget, only for the visible items,
+ * whose indexes form a (mostly gapless) range. Instead of hashing the indexes,
+ * the values are stored in a buffer that is indexed relative to the first
+ * index. Extending the range at the front or the back only moves the start
+ * of the ring, and shifting all indexes by shiftIndexes() costs at most one
+ * move per stored value.
+ *
+ * The API follows QHash, so that the buffer can replace a QHash<int, T>.
+ * Copying the buffer is cheap, as the storage is implicitly shared.
+ */
+template <typename T>
+class KItemListRingBuffer
+{
+public:
+    KItemListRingBuffer();
+
+    /**
+     * @return Number of indexes that have a value.
+     */
+    int count() const;
+    bool isEmpty() const;
+
+    /**
+     * @return Smallest and largest index that has a value, or -1 if
+     *         the buffer is empty.
+     */
+    int firstIndex() const;
+    int lastIndex() const;
+
+    bool contains(int index) const;
+
+    /**
+     * @return The value for \a index, or \a defaultValue if
+     *         the index has no value.
+     */
+    T value(int index, const T& defaultValue = T()) const;
+
+    /**
+     * @return Values of all indexes sorted by ascending index.
+     */
+    QList<T> values() const;
+
+    void insert(int index, const T& value);
+    void remove(int index);
+    void clear();
+
+    /**
+     * Adds \a delta to all indexes that are equal to or greater than
+     * \a fromIndex. If \a delta is negative, the values of the indexes
+     * that get overwritten by the moved values are removed.
+     */
+    void shiftIndexes(int fromIndex, int delta);
+
+    /**
+     * @brief Java-style iterator that is compatible to QHashIterator:
+     *        The values are iterated by ascending index.
+     *
+     * The iterator works on a copy of the buffer, which may be changed
+     * during the iteration.
+     */
+    class Iterator
+    {
+    public:
+        explicit Iterator(const KItemListRingBuffer<T>& buffer);
+
+        bool hasNext() const;
+        void next();
+        int key() const;
+        const T& value() const;
+
+    private:
+        const KItemListRingBuffer<T> m_buffer;
+        int m_index;
+        int m_nextIndex;
+        bool m_hasNext;
+    };
+
+private:
+    struct Slot
+    {
+        T value = T();
+        bool used = false;
+    };
+
+    int slotIndex(int index) const;
+    bool isInRange(int index) const;
+
+    /**
+     * Stores the first index equal to or greater than \a index that has
+     * a value in \a nextIndex and returns true. Returns false if there
+     * is no such index.
+     */
+    bool findNextUsedIndex(int index, int& nextIndex) const;
+
+    /**
+     * Assures that the buffer can store a range of \a span indexes.
+     * The ring gets linearized if it must be reallocated.
+     */
+    void reserve(int span);
+
+private:
+    QVector<Slot> m_slots; // The capacity is always 0 or a power of 2
+    int m_firstIndex;      // Index that is stored at m_head
+    int m_head;
+    int m_span;            // Number of slots from the first to the last used index
+    int m_count;
+};
+
+template <typename T>
+KItemListRingBuffer<T>::KItemListRingBuffer() :
+    m_slots(),
+    m_firstIndex(0),
+    m_head(0),
+    m_span(0),
+    m_count(0)
+{
+}
+
+template <typename T>
+int KItemListRingBuffer<T>::count() const
+{
+    return m_count;
+}
+
+template <typename T>
+bool KItemListRingBuffer<T>::isEmpty() const
+{
+    return m_count == 0;
+}
+
+template <typename T>
+int KItemListRingBuffer<T>::firstIndex() const
+{
+    return isEmpty() ? -1 : m_firstIndex;
+}
+
+template <typename T>
+int KItemListRingBuffer<T>::lastIndex() const
+{
+    return isEmpty() ? -1 : m_firstIndex + m_span - 1;
+}
+
+template <typename T>
+bool KItemListRingBuffer<T>::contains(int index) const
+{
+    return isInRange(index) && m_slots.at(slotIndex(index)).used;
+}
+
+template <typename T>
+T KItemListRingBuffer<T>::value(int index, const T& defaultValue) const
+{
+    if (!isInRange(index)) {
+        return defaultValue;
+    }
+
+    const Slot& slot = m_slots.at(slotIndex(index));
+    return slot.used ? slot.value : defaultValue;
+}
+
+template <typename T>
+QList<T> KItemListRingBuffer<T>::values() const
+{
+    QList<T> values;
+    values.reserve(m_count);
+    for (int i = 0; i < m_span; ++i) {
+        const Slot& slot = m_slots.at((m_head + i) & (m_slots.count() - 1));
+        if (slot.used) {
+            values.append(slot.value);
+        }
+    }
+    return values;
+}
+
+template <typename T>
+void KItemListRingBuffer<T>::insert(int index, const T& value)
+{
+    if (isEmpty()) {
+        reserve(1);
+        m_firstIndex = index;
+        m_head = 0;
+        m_span = 1;
+    } else if (index < m_firstIndex) {
+        const int offset = m_firstIndex - index;
+        reserve(m_span + offset);
+        m_head = (m_head - offset) & (m_slots.count() - 1);
+        m_firstIndex = index;
+        m_span += offset;
+    } else if (index >= m_firstIndex + m_span) {
+        const int span = index - m_firstIndex + 1;
+        reserve(span);
+        m_span = span;
+    }
+
+    Slot& slot = m_slots[slotIndex(index)];
+    if (!slot.used) {
+        slot.used = true;
+        ++m_count;
+    }
+    slot.value = value;
+}
+
+template <typename T>
+void KItemListRingBuffer<T>::remove(int index)
+{
+    if (!contains(index)) {
+        return;
+    }
+
+    m_slots[slotIndex(index)] = Slot();
+    --m_count;
+
+    if (isEmpty()) {
+        m_head = 0;
+        m_span = 0;
+        return;
+    }
+
+    // Keep the range as small as possible, so that the buffer does
+    // not grow when the visible range is moved during scrolling.
+    const int mask = m_slots.count() - 1;
+    while (!m_slots.at(m_head).used) {
+        m_head = (m_head + 1) & mask;
+        ++m_firstIndex;
+        --m_span;
+    }
+    while (!m_slots.at((m_head + m_span - 1) & mask).used) {
+        --m_span;
+    }
+}
+
+template <typename T>
+void KItemListRingBuffer<T>::clear()
+{
+    m_slots.clear();
+    m_firstIndex = 0;
+    m_head = 0;
+    m_span = 0;
+    m_count = 0;
+}
+
+template <typename T>
+void KItemListRingBuffer<T>::shiftIndexes(int fromIndex, int delta)
+{
+    if (isEmpty() || delta == 0 || fromIndex > lastIndex()) {
+        return;
+    }
+
+    if (fromIndex <= m_firstIndex) {
+        // All values are moved, only the start of the range changes
+        m_firstIndex += delta;
+        return;
+    }
+
+    QVector<QPair<int, T> > movedValues;
+    for (int i = lastIndex(); i >= fromIndex; --i) {
+        // Removing the last value shrinks the range, so contains()
+        // must be used instead of accessing the slot directly.
+        if (contains(i)) {
+            movedValues.append(qMakePair(i + delta, value(i)));
+            remove(i);
+        }
+    }
+
+    for (int i = fromIndex + delta; i < fromIndex; ++i) {
+        remove(i);
+    }
+
+    for (const auto& movedValue : qAsConst(movedValues)) {
+        insert(movedValue.first, movedValue.second);
+    }
+}
+
+template <typename T>
+int KItemListRingBuffer<T>::slotIndex(int index) const
+{
+    return (m_head + index - m_firstIndex) & (m_slots.count() - 1);
+}
+
+template <typename T>
+bool KItemListRingBuffer<T>::isInRange(int index) const
+{
+    return index >= m_firstIndex && index < m_firstIndex + m_span;
+}
+
+template <typename T>
+bool KItemListRingBuffer<T>::findNextUsedIndex(int index, int& nextIndex) const
+{
+    const int end = m_firstIndex + m_span;
+    for (int i = qMax(index, m_firstIndex); i < end; ++i) {
+        if (m_slots.at(slotIndex(i)).used) {
+            nextIndex = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+void KItemListRingBuffer<T>::reserve(int span)
+{
+    const int capacity = m_slots.count();
+    if (span <= capacity) {
+        return;
+    }
+
+    int newCapacity = qMax(16, capacity);
+    while (newCapacity < span) {
+        newCapacity *= 2;
+    }
+
+    QVector<Slot> slots(newCapacity);
+    for (int i = 0; i < m_span; ++i) {
+        slots[i] = m_slots.at((m_head + i) & (capacity - 1));
+    }
+    m_slots.swap(slots);
+    m_head = 0;
+}
+
+template <typename T>
+KItemListRingBuffer<T>::Iterator::Iterator(const KItemListRingBuffer<T>& buffer) :
+    m_buffer(buffer),
+    m_index(0),
+    m_nextIndex(buffer.m_firstIndex),
+    m_hasNext(!buffer.isEmpty())
+{
+}
+
+template <typename T>
+bool KItemListRingBuffer<T>::Iterator::hasNext() const
+{
+    return m_hasNext;
+}
+
+template <typename T>
+void KItemListRingBuffer<T>::Iterator::next()
+{
+    Q_ASSERT(hasNext());
+    m_index = m_nextIndex;
+    m_hasNext = m_buffer.findNextUsedIndex(m_index + 1, m_nextIndex);
+}
+
+template <typename T>
+int KItemListRingBuffer<T>::Iterator::key() const
+{
+    return m_index;
+}
+
+template <typename T>
+const T& KItemListRingBuffer<T>::Iterator::value() const
+{
+    return m_buffer.m_slots.at(m_buffer.slotIndex(m_index)).value;
+}
+
+#endif
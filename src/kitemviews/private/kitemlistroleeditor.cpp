@@ -8,6 +8,8 @@
 
 #include <KIO/Global>
 
+#include <QAbstractTextDocumentLayout>
+
 KItemListRoleEditor::KItemListRoleEditor(QWidget *parent) :
     KTextEdit(parent),
     m_role(),
@@ -19,17 +21,23 @@ KItemListRoleEditor::KItemListRoleEditor(QWidget *parent) :
     enableFindReplace(false);
     document()->setDocumentMargin(0);
 
-    if (parent) {
-        parent->installEventFilter(this);
-    }
-
-    connect(this, &KItemListRoleEditor::textChanged, this, &KItemListRoleEditor::autoAdjustSize);
+    connect(document()->documentLayout(), &QAbstractTextDocumentLayout::documentSizeChanged,
+            this, &KItemListRoleEditor::autoAdjustSize);
 }
 
 KItemListRoleEditor::~KItemListRoleEditor()
 {
 }
 
+KItemListRoleEditor* KItemListRoleEditor::sharedEditor(QWidget* parent)
+{
+    KItemListRoleEditor* editor = parent->findChild<KItemListRoleEditor*>(QString(), Qt::FindDirectChildrenOnly);
+    if (!editor) {
+        editor = new KItemListRoleEditor(parent);
+    }
+    return editor;
+}
+
 void KItemListRoleEditor::setRole(const QByteArray& role)
 {
     m_role = role;
@@ -60,6 +68,26 @@ bool KItemListRoleEditor::event(QEvent* event)
     return KTextEdit::event(event);
 }
 
+void KItemListRoleEditor::showEvent(QShowEvent* event)
+{
+    // Resizing the view ends the editing
+    if (parentWidget()) {
+        parentWidget()->installEventFilter(this);
+    }
+    KTextEdit::showEvent(event);
+}
+
+void KItemListRoleEditor::hideEvent(QHideEvent* event)
+{
+    // The hidden editor is kept for the next renaming. It must not react on
+    // the resizing of the view, and its size must not depend on the last text.
+    if (parentWidget()) {
+        parentWidget()->removeEventFilter(this);
+    }
+    clear();
+    KTextEdit::hideEvent(event);
+}
+
 void KItemListRoleEditor::keyPressEvent(QKeyEvent* event)
 {
     switch (event->key()) {
@@ -118,11 +146,11 @@ void KItemListRoleEditor::keyPressEvent(QKeyEvent* event)
     KTextEdit::keyPressEvent(event);
 }
 
-void KItemListRoleEditor::autoAdjustSize()
+void KItemListRoleEditor::autoAdjustSize(const QSizeF& documentSize)
 {
     const qreal frameBorder = 2 * frameWidth();
 
-    const qreal requiredWidth = document()->size().width();
+    const qreal requiredWidth = documentSize.width();
     const qreal availableWidth = size().width() - frameBorder;
     if (requiredWidth > availableWidth) {
         qreal newWidth = requiredWidth + frameBorder;
@@ -132,7 +160,7 @@ void KItemListRoleEditor::autoAdjustSize()
         resize(newWidth, size().height());
     }
 
-    const qreal requiredHeight = document()->size().height();
+    const qreal requiredHeight = documentSize.height();
     const qreal availableHeight = size().height() - frameBorder;
     if (requiredHeight > availableHeight) {
         qreal newHeight = requiredHeight + frameBorder;
@@ -19,6 +19,9 @@
  * got finished (e.g. by pressing Enter or Return).
  *
  * The size automatically gets increased if the text does not fit.
+ *
+ * Creating a KTextEdit is expensive, so one editor is shared by all
+ * item widgets of a view, see KItemListRoleEditor::sharedEditor().
  */
 class DOLPHIN_EXPORT KItemListRoleEditor : public KTextEdit
 {
@@ -28,6 +31,12 @@ public:
     explicit KItemListRoleEditor(QWidget* parent);
     ~KItemListRoleEditor() override;
 
+    /**
+     * @return The editor for the view \a parent. It is created on the first
+     *         call and reused for all following renamings in the view.
+     */
+    static KItemListRoleEditor* sharedEditor(QWidget* parent);
+
     void setRole(const QByteArray& role);
     QByteArray role() const;
 
@@ -39,14 +48,18 @@ Q_SIGNALS:
 
 protected:
     bool event(QEvent* event) override;
+    void showEvent(QShowEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
     void keyPressEvent(QKeyEvent* event) override;
 
 private Q_SLOTS:
     /**
      * Increases the size of the editor in case if there is not
-     * enough room for the text.
+     * enough room for the text. Is invoked by the layout of the
+     * document with the new \a documentSize, so that the text
+     * is not measured again for each key press.
      */
-    void autoAdjustSize();
+    void autoAdjustSize(const QSizeF& documentSize);
 
 private:
     /**
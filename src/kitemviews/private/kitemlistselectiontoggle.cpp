@@ -6,8 +6,11 @@
 
 #include "kitemlistselectiontoggle.h"
 
+#include "kiconpixmapcache.h"
+
 #include <KIconLoader>
 
+#include <QGuiApplication>
 #include <QIcon>
 #include <QPainter>
 
@@ -77,8 +80,20 @@ void KItemListSelectionToggle::resizeEvent(QGraphicsSceneResizeEvent* event)
 
 void KItemListSelectionToggle::updatePixmap()
 {
+    // The toggles of all items share the same few pixmaps, so they are
+    // taken from the cache instead of applying the icon effects for each
+    // change of the hover state.
     const QString icon = m_checked ? QStringLiteral("emblem-remove") : QStringLiteral("emblem-added");
-    m_pixmap = QIcon::fromTheme(icon).pixmap(iconSize(), m_hovered ? QIcon::Active : QIcon::Disabled);
+    const QIcon::Mode mode = m_hovered ? QIcon::Active : QIcon::Disabled;
+    const int size = iconSize();
+    const qreal dpr = qApp->devicePixelRatio();
+    const int devicePixelSize = size * dpr;
+
+    KIconPixmapCache& cache = KIconPixmapCache::instance();
+    if (!cache.find(icon, QStringList(), devicePixelSize, mode, dpr, &m_pixmap)) {
+        m_pixmap = QIcon::fromTheme(icon).pixmap(size, mode);
+        cache.insert(icon, QStringList(), devicePixelSize, mode, dpr, m_pixmap);
+    }
 }
 
 int KItemListSelectionToggle::iconSize() const
@@ -5,14 +5,21 @@
  */
 
 #include "kitemlistsizehintresolver.h"
+#include "kitemlisttracer.h"
 #include "kitemviews/kitemlistview.h"
 
+namespace {
+    // Number of items whose sizehints are calculated exactly to get
+    // the estimated sizehint for all other items.
+    const int EstimationItemCount = 100;
+}
+
 KItemListSizeHintResolver::KItemListSizeHintResolver(const KItemListView* itemListView) :
     m_itemListView(itemListView),
     m_logicalHeightHintCache(),
     m_logicalWidthHint(0.0),
     m_minHeightHint(0.0),
-    m_needsResolving(false)
+    m_estimatedLogicalHeightHint(0.0)
 {
 }
 
@@ -22,14 +29,25 @@ KItemListSizeHintResolver::~KItemListSizeHintResolver()
 
 QSizeF KItemListSizeHintResolver::minSizeHint()
 {
-    updateCache();
+    if (!m_logicalHeightHintCache.isEmpty()) {
+        estimateSizeHints(0);
+    }
     return QSizeF(m_logicalWidthHint, m_minHeightHint);
 }
 
 QSizeF KItemListSizeHintResolver::sizeHint(int index)
 {
-    updateCache();
-    return QSizeF(m_logicalWidthHint, m_logicalHeightHintCache.at(index));
+    if (m_logicalHeightHintCache.at(index) == 0.0) {
+        estimateSizeHints(index);
+    }
+
+    const qreal logicalHeightHint = m_logicalHeightHintCache.at(index);
+    if (logicalHeightHint > 0.0) {
+        return QSizeF(m_logicalWidthHint, logicalHeightHint);
+    } else if (logicalHeightHint < 0.0) {
+        return QSizeF(m_logicalWidthHint, -logicalHeightHint);
+    }
+    return QSizeF(m_logicalWidthHint, m_estimatedLogicalHeightHint);
 }
 
 void KItemListSizeHintResolver::itemsInserted(const KItemRangeList& itemRanges)
@@ -68,8 +86,6 @@ void KItemListSizeHintResolver::itemsInserted(const KItemRangeList& itemRanges)
         }
     }
 
-    m_needsResolving = true;
-
     Q_ASSERT(m_logicalHeightHintCache.count() == m_itemListView->model()->count());
 }
 
@@ -124,24 +140,89 @@ void KItemListSizeHintResolver::itemsChanged(int index, int count, const QSet<QB
 {
     Q_UNUSED(roles)
     while (count) {
-        m_logicalHeightHintCache[index] = 0.0;
+        // Keep the outdated sizehint until the item gets calculated again,
+        // so that the layout of the following items stays stable.
+        m_logicalHeightHintCache[index] = -qAbs(m_logicalHeightHintCache[index]);
         ++index;
         --count;
     }
-
-    m_needsResolving = true;
 }
 
 void KItemListSizeHintResolver::clearCache()
 {
     m_logicalHeightHintCache.fill(0.0);
-    m_needsResolving = true;
+    m_estimatedLogicalHeightHint = 0.0;
+}
+
+int KItemListSizeHintResolver::updateCache(int firstIndex, int lastIndex)
+{
+    const KItemListTraceScope traceScope("KItemListSizeHintResolver::updateCache");
+    firstIndex = qMax(firstIndex, 0);
+    lastIndex = qMin(lastIndex, m_logicalHeightHintCache.count() - 1);
+
+    int firstUncalculatedIndex = -1;
+    for (int i = firstIndex; i <= lastIndex; ++i) {
+        if (m_logicalHeightHintCache.at(i) <= 0.0) {
+            firstUncalculatedIndex = i;
+            break;
+        }
+    }
+
+    if (firstUncalculatedIndex < 0) {
+        return -1;
+    }
+
+    // Remember the sizehints that have been returned so far to find
+    // out whether the layout must be updated.
+    const QVector<qreal> previousLogicalHeightHints = m_logicalHeightHintCache.mid(firstUncalculatedIndex,
+                                                                                 lastIndex - firstUncalculatedIndex + 1);
+    const qreal previousLogicalWidthHint = m_logicalWidthHint;
+    const qreal previousEstimatedLogicalHeightHint = m_estimatedLogicalHeightHint;
+
+    calculateSizeHints(firstUncalculatedIndex, lastIndex);
+
+    if (m_logicalWidthHint != previousLogicalWidthHint) {
+        return 0;
+    }
+
+    for (int i = firstUncalculatedIndex; i <= lastIndex; ++i) {
+        const qreal previousLogicalHeightHint = previousLogicalHeightHints.at(i - firstUncalculatedIndex);
+        if (previousLogicalHeightHint > 0.0) {
+            continue;
+        }
+
+        const qreal usedLogicalHeightHint = (previousLogicalHeightHint < 0.0)
+                                            ? -previousLogicalHeightHint
+                                            : previousEstimatedLogicalHeightHint;
+        if (m_logicalHeightHintCache.at(i) != usedLogicalHeightHint) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void KItemListSizeHintResolver::calculateSizeHints(int firstIndex, int lastIndex)
+{
+    m_itemListView->calculateItemSizeHints(m_logicalHeightHintCache, m_logicalWidthHint, firstIndex, lastIndex);
+
+    if (m_estimatedLogicalHeightHint <= 0.0) {
+        qreal sum = 0.0;
+        for (int i = firstIndex; i <= lastIndex; ++i) {
+            sum += m_logicalHeightHintCache.at(i);
+        }
+        m_estimatedLogicalHeightHint = sum / (lastIndex - firstIndex + 1);
+    }
 }
 
-void KItemListSizeHintResolver::updateCache()
+void KItemListSizeHintResolver::estimateSizeHints(int index)
 {
-    if (m_needsResolving) {
-        m_itemListView->calculateItemSizeHints(m_logicalHeightHintCache, m_logicalWidthHint);
-        m_needsResolving = false;
+    if (m_estimatedLogicalHeightHint > 0.0) {
+        return;
     }
+
+    const int count = m_logicalHeightHintCache.count();
+    const int firstIndex = qMax(0, qMin(index, count - EstimationItemCount));
+    const int lastIndex = qMin(count, firstIndex + EstimationItemCount) - 1;
+    calculateSizeHints(firstIndex, lastIndex);
 }
@@ -17,6 +17,13 @@ class KItemListView;
 
 /**
  * @brief Calculates and caches the sizehints of items in KItemListView.
+ *
+ * Calculating the exact sizehint of an item might be expensive, e.g. if the
+ * name must be wrapped into several lines. Only the sizehints of the items
+ * passed to updateCache() are calculated exactly: For all other items an
+ * estimated sizehint is returned, which is the average of the first
+ * calculated sizehints. Items that have been changed keep their previous
+ * sizehint until they are calculated again.
  */
 class DOLPHIN_EXPORT KItemListSizeHintResolver
 {
@@ -32,14 +39,40 @@ public:
     void itemsChanged(int index, int count, const QSet<QByteArray>& roles);
 
     void clearCache();
-    void updateCache();
+
+    /**
+     * Calculates the exact sizehints of the items between \a firstIndex
+     * and \a lastIndex, if this has not been done yet.
+     * @return Index of the first item whose exact sizehint differs from
+     *         the sizehint that has been returned before, or -1 if
+     *         all sizehints are unchanged. The layout must be updated
+     *         starting from this index.
+     */
+    int updateCache(int firstIndex, int lastIndex);
+
+private:
+    /**
+     * Calculates the exact sizehints of the items between \a firstIndex
+     * and \a lastIndex and initializes the estimated sizehint if required.
+     */
+    void calculateSizeHints(int firstIndex, int lastIndex);
+
+    /**
+     * Assures that an estimated sizehint is available by calculating the
+     * exact sizehints for some items around \a index.
+     */
+    void estimateSizeHints(int index);
 
 private:
     const KItemListView* m_itemListView;
+
+    // A positive value is the exact logical height of the item, a negative
+    // value the outdated logical height of a changed item and 0.0 marks
+    // an item that has not been calculated yet.
     mutable QVector<qreal> m_logicalHeightHintCache;
     mutable qreal m_logicalWidthHint;
     mutable qreal m_minHeightHint;
-    bool m_needsResolving;
+    qreal m_estimatedLogicalHeightHint;
 };
 
 #endif
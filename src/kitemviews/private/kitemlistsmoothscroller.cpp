@@ -10,6 +10,7 @@
 #include <QPropertyAnimation>
 #include <QScrollBar>
 #include <QStyle>
+#include <QTimer>
 #include <QWheelEvent>
 
 KItemListSmoothScroller::KItemListSmoothScroller(QScrollBar* scrollBar,
@@ -17,8 +18,12 @@ KItemListSmoothScroller::KItemListSmoothScroller(QScrollBar* scrollBar,
     QObject(parent),
     m_scrollBarPressed(false),
     m_smoothScrolling(true),
+    m_animationEnabled(true),
     m_scrollBar(scrollBar),
-    m_animation(nullptr)
+    m_animation(nullptr),
+    m_updateTimer(nullptr),
+    m_offsetPending(false),
+    m_pendingOffset(0)
 {
     m_animation = new QPropertyAnimation(this);
     const int animationDuration = m_scrollBar->style()->styleHint(QStyle::SH_Widget_Animation_Duration, nullptr, m_scrollBar);
@@ -27,6 +32,11 @@ KItemListSmoothScroller::KItemListSmoothScroller(QScrollBar* scrollBar,
     connect(m_animation, &QPropertyAnimation::stateChanged,
             this, &KItemListSmoothScroller::slotAnimationStateChanged);
 
+    m_updateTimer = new QTimer(this);
+    m_updateTimer->setSingleShot(true);
+    m_updateTimer->setInterval(0);
+    connect(m_updateTimer, &QTimer::timeout, this, &KItemListSmoothScroller::applyPendingOffset);
+
     m_scrollBar->installEventFilter(this);
 }
 
@@ -47,6 +57,7 @@ QScrollBar* KItemListSmoothScroller::scrollBar() const
 void KItemListSmoothScroller::setTargetObject(QObject* target)
 {
     m_animation->setTargetObject(target);
+    m_offsetPending = false;
 }
 
 QObject* KItemListSmoothScroller::targetObject() const
@@ -64,6 +75,34 @@ QByteArray KItemListSmoothScroller::propertyName() const
     return m_animation->propertyName();
 }
 
+void KItemListSmoothScroller::setAnimationEnabled(bool enabled)
+{
+    m_animationEnabled = enabled;
+    if (!enabled && m_animation->state() == QAbstractAnimation::Running) {
+        // Jump to the end of the running animation
+        m_animation->setCurrentTime(m_animation->duration());
+    }
+}
+
+bool KItemListSmoothScroller::isAnimationEnabled() const
+{
+    return m_animationEnabled;
+}
+
+void KItemListSmoothScroller::setMinimumUpdateInterval(int msec)
+{
+    m_updateTimer->setInterval(msec);
+    if (msec <= 0) {
+        m_updateTimer->stop();
+        applyPendingOffset();
+    }
+}
+
+int KItemListSmoothScroller::minimumUpdateInterval() const
+{
+    return m_updateTimer->interval();
+}
+
 void KItemListSmoothScroller::scrollContentsBy(qreal distance)
 {
     QObject* target = targetObject();
@@ -72,7 +111,7 @@ void KItemListSmoothScroller::scrollContentsBy(qreal distance)
     }
 
     const QByteArray name = propertyName();
-    const qreal currentOffset = target->property(name).toReal();
+    const qreal currentOffset = m_offsetPending ? m_pendingOffset : target->property(name).toReal();
     if (static_cast<int>(currentOffset) == m_scrollBar->value()) {
         // The current offset is already synchronous to the scrollbar
         return;
@@ -88,7 +127,7 @@ void KItemListSmoothScroller::scrollContentsBy(qreal distance)
     }
 
     const qreal endOffset = currentOffset - distance;
-    if (m_smoothScrolling || animRunning) {
+    if (m_animationEnabled && (m_smoothScrolling || animRunning)) {
         qreal startOffset = currentOffset;
         if (animRunning) {
             // If the animation was running and has been interrupted by assigning a new end-offset
@@ -109,8 +148,17 @@ void KItemListSmoothScroller::scrollContentsBy(qreal distance)
         m_animation->setEasingCurve(animRunning ? QEasingCurve::OutQuad : QEasingCurve::InOutQuad);
         m_animation->start();
         target->setProperty(name, startOffset);
+
+        const qreal velocity = (endOffset - startOffset) * 1000 / m_animation->duration();
+        Q_EMIT scrollAnimationStarted(endOffset, velocity);
+    } else if (m_updateTimer->isActive()) {
+        m_pendingOffset = endOffset;
+        m_offsetPending = true;
     } else {
         target->setProperty(name, endOffset);
+        if (m_updateTimer->interval() > 0) {
+            m_updateTimer->start();
+        }
     }
 }
 
@@ -140,6 +188,17 @@ bool KItemListSmoothScroller::requestScrollBarUpdate(int newMaximum)
         // update the scrollbars immediately.
         m_animation->stop();
     }
+
+    if (m_offsetPending) {
+        if (newMaximum == m_scrollBar->maximum()) {
+            // The scrollbar is ahead of the target, which reaches the
+            // position of the scrollbar with applyPendingOffset().
+            return false;
+        }
+        // Like a stopped animation, the pending position is skipped
+        // and the scrollbar is updated to the position of the target.
+        m_offsetPending = false;
+    }
     return true;
 }
 
@@ -177,6 +236,22 @@ void KItemListSmoothScroller::slotAnimationStateChanged(QAbstractAnimation::Stat
     }
 }
 
+void KItemListSmoothScroller::applyPendingOffset()
+{
+    if (!m_offsetPending) {
+        return;
+    }
+
+    m_offsetPending = false;
+    QObject* target = targetObject();
+    if (target) {
+        target->setProperty(propertyName(), m_pendingOffset);
+        if (m_updateTimer->interval() > 0) {
+            m_updateTimer->start();
+        }
+    }
+}
+
 void KItemListSmoothScroller::handleWheelEvent(QWheelEvent* event)
 {
     const bool previous = m_smoothScrolling;
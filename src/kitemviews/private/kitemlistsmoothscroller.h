@@ -14,6 +14,7 @@
 
 class QPropertyAnimation;
 class QScrollBar;
+class QTimer;
 class QWheelEvent;
 
 /**
@@ -38,6 +39,24 @@ public:
     void setPropertyName(const QByteArray& propertyName);
     QByteArray propertyName() const;
 
+    /**
+     * If set to false, the target is moved to the new position of the
+     * scrollbar immediately instead of animating it. Per default the
+     * scrolling is animated.
+     */
+    void setAnimationEnabled(bool enabled);
+    bool isAnimationEnabled() const;
+
+    /**
+     * Sets the minimum interval in ms between two changes of the position
+     * of the target, if the scrolling is not animated. Changes of the
+     * scrollbar in between are coalesced, so that e.g. dragging the
+     * scrollbar does not result in more frames than necessary. Per default
+     * the interval is 0 and each change is applied immediately.
+     */
+    void setMinimumUpdateInterval(int msec);
+    int minimumUpdateInterval() const;
+
     /**
      * Adjusts the position of the target by \p distance
      * pixels. Is invoked in the context of QAbstractScrollArea::scrollContentsBy()
@@ -69,6 +88,15 @@ public:
      */
     void handleWheelEvent(QWheelEvent* event);
 
+Q_SIGNALS:
+    /**
+     * Is emitted when an animation towards the offset \p targetOffset has
+     * been started. \p velocity is the average velocity of the animation in
+     * pixels per second. It allows to prepare the items at the target
+     * offset before they become visible.
+     */
+    void scrollAnimationStarted(qreal targetOffset, qreal velocity);
+
 protected:
     bool eventFilter(QObject* obj, QEvent* event) override;
 
@@ -76,11 +104,21 @@ private Q_SLOTS:
     void slotAnimationStateChanged(QAbstractAnimation::State newState,
                                    QAbstractAnimation::State oldState);
 
+    /**
+     * Applies the position that has been coalesced during the
+     * minimum update interval.
+     */
+    void applyPendingOffset();
+
 private:
     bool m_scrollBarPressed;
     bool m_smoothScrolling;
+    bool m_animationEnabled;
     QScrollBar* m_scrollBar;
     QPropertyAnimation* m_animation;
+    QTimer* m_updateTimer;
+    bool m_offsetPending;
+    qreal m_pendingOffset;
 };
 
 #endif
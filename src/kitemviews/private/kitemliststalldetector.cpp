@@ -0,0 +1,153 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemliststalldetector.h"
+
+#include "dolphindebug.h"
+#include "kitemlisttracer.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QTimer>
+#include <QVector>
+
+#include <algorithm>
+
+namespace {
+    // Threshold in ms if DOLPHIN_STALL_THRESHOLD is not a valid number
+    const int DefaultThreshold = 1000;
+
+    // Bounds in ms for the interval of the heartbeat, which is also
+    // the interval in which the stalled main thread is sampled
+    const int MinimumHeartbeatInterval = 10;
+    const int MaximumHeartbeatInterval = 250;
+}
+
+KItemListStallDetector::KItemListStallDetector(QObject* parent) :
+    QThread(parent),
+    m_threshold(DefaultThreshold),
+    m_heartbeatInterval(MaximumHeartbeatInterval),
+    m_logFilePath(),
+    m_clock(),
+    m_heartbeatTimer(nullptr),
+    m_lastHeartbeat(0)
+{
+    if (!KItemListTracer::isStallDetectionEnabled()) {
+        return;
+    }
+
+    bool ok = false;
+    const int threshold = qEnvironmentVariableIntValue("DOLPHIN_STALL_THRESHOLD", &ok);
+    if (ok && threshold > 0) {
+        m_threshold = threshold;
+    }
+    m_heartbeatInterval = qBound(MinimumHeartbeatInterval, m_threshold / 4, MaximumHeartbeatInterval);
+
+    m_logFilePath = qEnvironmentVariable("DOLPHIN_STALL_LOG");
+    if (m_logFilePath.isEmpty()) {
+        m_logFilePath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + QLatin1String("/stalls.log");
+    }
+
+    m_clock.start();
+    m_heartbeatTimer = new QTimer(this);
+    m_heartbeatTimer->setTimerType(Qt::PreciseTimer);
+    m_heartbeatTimer->setInterval(m_heartbeatInterval);
+    connect(m_heartbeatTimer, &QTimer::timeout, this, [this]() {
+        m_lastHeartbeat.storeRelease(m_clock.elapsed());
+    });
+    m_heartbeatTimer->start();
+
+    qCDebug(DolphinDebug) << "Logging stalls of more than" << m_threshold << "ms to" << m_logFilePath;
+    start(QThread::LowPriority);
+}
+
+KItemListStallDetector::~KItemListStallDetector()
+{
+    requestInterruption();
+    wait();
+}
+
+int KItemListStallDetector::threshold() const
+{
+    return m_threshold;
+}
+
+QString KItemListStallDetector::logFilePath() const
+{
+    return m_logFilePath;
+}
+
+void KItemListStallDetector::run()
+{
+    // Heartbeat before the stall, -1 if the main thread is not stalled
+    qint64 stalledHeartbeat = -1;
+    QVector<QPair<QByteArray, int> > samples;
+
+    while (!isInterruptionRequested()) {
+        msleep(m_heartbeatInterval);
+
+        const qint64 heartbeat = m_lastHeartbeat.loadAcquire();
+        if (stalledHeartbeat >= 0 && heartbeat != stalledHeartbeat) {
+            // The event loop continues: The timer has been overdue by the
+            // duration of the stall.
+            const qint64 duration = heartbeat - stalledHeartbeat - m_heartbeatInterval;
+            std::sort(samples.begin(), samples.end(), [](const QPair<QByteArray, int>& a, const QPair<QByteArray, int>& b) {
+                return a.second > b.second;
+            });
+
+            QByteArray text = QDateTime::currentDateTime().toString(Qt::ISODate).toLatin1()
+                            + " Main thread stalled for " + QByteArray::number(duration) + " ms\n";
+            for (const auto& sample : qAsConst(samples)) {
+                text += "    " + QByteArray::number(sample.second) + "x " + sample.first + '\n';
+            }
+            writeLog(text);
+            qCWarning(DolphinDebug) << "Main thread stalled for" << duration << "ms in"
+                                    << (samples.isEmpty() ? QByteArray() : samples.first().first);
+
+            stalledHeartbeat = -1;
+            samples.clear();
+            continue;
+        }
+
+        const qint64 delay = m_clock.elapsed() - heartbeat - m_heartbeatInterval;
+        if (delay < m_threshold) {
+            continue;
+        }
+
+        QByteArray scopes = KItemListTracer::currentScopes();
+        if (scopes.isEmpty()) {
+            scopes = "(no traced operation)";
+        }
+        auto it = std::find_if(samples.begin(), samples.end(), [&scopes](const QPair<QByteArray, int>& sample) {
+            return sample.first == scopes;
+        });
+        if (it != samples.end()) {
+            ++it->second;
+        } else {
+            samples.append(qMakePair(scopes, 1));
+        }
+
+        if (stalledHeartbeat < 0) {
+            // Logged immediately in case the main thread never recovers
+            stalledHeartbeat = heartbeat;
+            writeLog(QDateTime::currentDateTime().toString(Qt::ISODate).toLatin1()
+                     + " Main thread stalled for more than " + QByteArray::number(m_threshold)
+                     + " ms in " + scopes + '\n');
+        }
+    }
+}
+
+void KItemListStallDetector::writeLog(const QByteArray& text)
+{
+    QDir().mkpath(QFileInfo(m_logFilePath).absolutePath());
+    QFile file(m_logFilePath);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        file.write(text);
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KITEMLISTSTALLDETECTOR_H
+#define KITEMLISTSTALLDETECTOR_H
+
+#include "dolphin_export.h"
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QThread>
+
+class QTimer;
+
+/**
+ * @brief Detects and logs the stalls of the event loop of the main thread.
+ *
+ * Reports like "Dolphin froze for 2 seconds" can rarely be reproduced. If the
+ * environment variable DOLPHIN_STALL_THRESHOLD is set to a number of ms, the
+ * main thread updates a heartbeat regularly and a watchdog thread checks
+ * whether it is overdue by more than the threshold. In this case the
+ * operations that the main thread executes are sampled, as tracked by the
+ * KItemListTraceScope instances, e.g. "KFileItemModel::resortAllItems (size)".
+ *
+ * Each stall is appended to the log file given by DOLPHIN_STALL_LOG, per
+ * default "stalls.log" in the data directory of Dolphin, so that it can be
+ * attached to bug reports: Once when the stall has been detected, in case
+ * the main thread never recovers, and once with the duration and the sampled
+ * operations when the event loop continues.
+ *
+ * The detector must be created by the main thread and is inactive if
+ * DOLPHIN_STALL_THRESHOLD is not set.
+ */
+class DOLPHIN_EXPORT KItemListStallDetector : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit KItemListStallDetector(QObject* parent = nullptr);
+    ~KItemListStallDetector() override;
+
+    /**
+     * @return Minimum delay in ms of the event loop that is logged.
+     */
+    int threshold() const;
+
+    /**
+     * @return Path of the file the stalls are appended to.
+     */
+    QString logFilePath() const;
+
+protected:
+    void run() override;
+
+private:
+    void writeLog(const QByteArray& text);
+
+private:
+    int m_threshold;
+    int m_heartbeatInterval;
+    QString m_logFilePath;
+    QElapsedTimer m_clock;
+    QTimer* m_heartbeatTimer;
+    // Time of m_clock in ms when the main thread has updated the heartbeat
+    QAtomicInteger<qint64> m_lastHeartbeat;
+};
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemlisttextlayoutcache.h"
+
+#include <QHash>
+
+namespace {
+    // Estimated bytes of a cached layout, including the glyphs of
+    // QStaticText and the key. Most texts are short file names.
+    const int TextLayoutCost = 1024;
+}
+
+KItemListTextLayoutCache::Key::Key(const QString& text, const QFont& font, qreal maxWidth, int layout, int maxTextLines) :
+    text(text),
+    font(font),
+    maxWidth(maxWidth),
+    layout(layout),
+    maxTextLines(maxTextLines)
+{
+}
+
+bool KItemListTextLayoutCache::Key::operator==(const Key& other) const
+{
+    return maxWidth == other.maxWidth
+        && layout == other.layout
+        && maxTextLines == other.maxTextLines
+        && text == other.text
+        && font == other.font;
+}
+
+KItemListTextLayoutCache::KItemListTextLayoutCache(int maximumTextLayouts) :
+    m_cache(maximumTextLayouts)
+{
+}
+
+KItemListTextLayoutCache::~KItemListTextLayoutCache()
+{
+}
+
+const KItemListTextLayoutCache::TextLayout* KItemListTextLayoutCache::textLayout(const Key& key) const
+{
+    return m_cache.object(key);
+}
+
+void KItemListTextLayoutCache::insert(const Key& key, const TextLayout& textLayout)
+{
+    m_cache.insert(key, new TextLayout(textLayout));
+    KMemoryBudget::instance().scheduleCheck();
+}
+
+void KItemListTextLayoutCache::clear()
+{
+    m_cache.clear();
+}
+
+QString KItemListTextLayoutCache::memoryConsumerName() const
+{
+    return QStringLiteral("KItemListTextLayoutCache");
+}
+
+qint64 KItemListTextLayoutCache::memoryUsage() const
+{
+    return qint64(m_cache.count()) * TextLayoutCost;
+}
+
+qint64 KItemListTextLayoutCache::releaseMemory(qint64 bytes)
+{
+    const int previousCount = m_cache.count();
+    const int count = int(qMin<qint64>(bytes / TextLayoutCost + 1, previousCount));
+    const int maxCost = m_cache.maxCost();
+    m_cache.setMaxCost(previousCount - count);
+    m_cache.setMaxCost(maxCost);
+    return qint64(previousCount - m_cache.count()) * TextLayoutCost;
+}
+
+KMemoryBudget::Consumer::ReleaseOrder KItemListTextLayoutCache::releaseOrder() const
+{
+    return ReleaseFirst;
+}
+
+uint qHash(const KItemListTextLayoutCache::Key& key, uint seed)
+{
+    seed = qHash(key.text, seed);
+    seed = qHash(key.font, seed);
+    seed = qHash(key.maxWidth, seed);
+    seed = qHash(key.layout, seed);
+    return qHash(key.maxTextLines, seed);
+}
@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KITEMLISTTEXTLAYOUTCACHE_H
+#define KITEMLISTTEXTLAYOUTCACHE_H
+
+#include "dolphin_export.h"
+#include "kitemviews/private/kmemorybudget.h"
+
+#include <QCache>
+#include <QFont>
+#include <QStaticText>
+#include <QString>
+
+/**
+ * @brief Caches the layouted texts of the item widgets of a view.
+ *
+ * Wrapping and eliding the texts of an item widget is expensive and is
+ * done again each time KItemListView recycles the widget for another item.
+ * When scrolling back and forth, the same texts are layouted over and over.
+ * KItemListTextLayoutCache stores the result of the layout, which is the
+ * prepared QStaticText containing the wrapped and elided text, together
+ * with the size it requires. It is shared by all widgets of a view and
+ * keeps the most recently used texts, which are also released if the
+ * memory budget of KMemoryBudget is exceeded.
+ */
+class DOLPHIN_EXPORT KItemListTextLayoutCache : public KMemoryBudget::Consumer
+{
+public:
+    struct Key
+    {
+        Key(const QString& text, const QFont& font, qreal maxWidth, int layout, int maxTextLines);
+
+        bool operator==(const Key& other) const;
+
+        QString text;
+        QFont font;
+        qreal maxWidth;
+        int layout;         // KStandardItemListWidget::Layout
+        int maxTextLines;   // -1 if the text is not wrapped
+    };
+
+    struct TextLayout
+    {
+        QStaticText staticText;
+        qreal width;
+        qreal height;
+    };
+
+    explicit KItemListTextLayoutCache(int maximumTextLayouts = 5000);
+    ~KItemListTextLayoutCache() override;
+
+    /**
+     * @return Layout of the text for \a key, or nullptr if the text has
+     *         not been layouted yet or has been removed from the cache.
+     */
+    const TextLayout* textLayout(const Key& key) const;
+
+    /**
+     * Stores the layout \a textLayout of the text for \a key. If the cache
+     * is full, the least recently used text is removed.
+     */
+    void insert(const Key& key, const TextLayout& textLayout);
+
+    void clear();
+
+    QString memoryConsumerName() const override;
+    qint64 memoryUsage() const override;
+    qint64 releaseMemory(qint64 bytes) override;
+    ReleaseOrder releaseOrder() const override;
+
+private:
+    QCache<Key, TextLayout> m_cache;
+};
+
+uint qHash(const KItemListTextLayoutCache::Key& key, uint seed = 0);
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemlisttracer.h"
+
+#include "dolphindebug.h"
+
+#include <QAtomicInteger>
+#include <QAtomicPointer>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+
+namespace {
+    // Size in bytes of the recorded events that are kept
+    // in memory before they are written to the file.
+    const int FlushSize = 64 * 1024;
+
+    // Nested operations beyond this depth are not described by currentScopes()
+    const int MaxScopeDepth = 32;
+
+    // The operations of the main thread for the stall detection. They are
+    // only written by the main thread, while the stall detector reads them.
+    // The names and details are string literals, so they stay valid even if
+    // the scope has been left already while being read.
+    struct Scope
+    {
+        QAtomicPointer<const char> name;
+        QAtomicPointer<const char> detail;
+        QAtomicInteger<qint64> value;
+    };
+    Scope s_scopes[MaxScopeDepth];
+    QAtomicInt s_scopeDepth;
+}
+
+/**
+ * Writes the events into the file given by DOLPHIN_TRACE_FILE. The file
+ * is only opened when the first event is recorded and completed when
+ * the application quits.
+ */
+class KItemListTraceFile
+{
+public:
+    KItemListTraceFile();
+    ~KItemListTraceFile();
+
+    qint64 timestamp() const;
+    void addEvent(const char* name, qint64 start, qint64 duration);
+    void addCounter(const char* name, qint64 value);
+    void addInstantEvent(const char* name);
+    void addAsyncEvent(const char* name, const void* id, qint64 start, qint64 duration);
+
+private:
+    void beginEvent(const char* name, const char* phase, qint64 start);
+    void endEvent();
+    void flush();
+
+private:
+    QElapsedTimer m_timer;
+    QFile m_file;
+    QByteArray m_buffer;
+    bool m_firstEvent;
+};
+
+KItemListTraceFile::KItemListTraceFile() :
+    m_timer(),
+    m_file(qEnvironmentVariable("DOLPHIN_TRACE_FILE")),
+    m_buffer(),
+    m_firstEvent(true)
+{
+    m_timer.start();
+    if (m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_buffer.reserve(FlushSize + 256);
+        m_buffer.append("[\n");
+    } else {
+        qCWarning(DolphinDebug) << "Cannot open the trace file" << m_file.fileName();
+    }
+}
+
+KItemListTraceFile::~KItemListTraceFile()
+{
+    if (m_file.isOpen()) {
+        m_buffer.append("\n]\n");
+        flush();
+    }
+}
+
+qint64 KItemListTraceFile::timestamp() const
+{
+    return m_timer.nsecsElapsed();
+}
+
+void KItemListTraceFile::addEvent(const char* name, qint64 start, qint64 duration)
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    // Complete events ("ph":"X") with timestamps in microseconds
+    beginEvent(name, "X", start);
+    m_buffer.append(",\"dur\":");
+    m_buffer.append(QByteArray::number(duration / 1000.0, 'f', 3));
+    endEvent();
+}
+
+void KItemListTraceFile::addCounter(const char* name, qint64 value)
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    // Counter events ("ph":"C") are shown as graphs by the viewers
+    beginEvent(name, "C", timestamp());
+    m_buffer.append(",\"args\":{\"value\":");
+    m_buffer.append(QByteArray::number(value));
+    m_buffer.append('}');
+    endEvent();
+}
+
+void KItemListTraceFile::addInstantEvent(const char* name)
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    // Instant events ("ph":"i") are shown as markers over the whole process
+    beginEvent(name, "i", timestamp());
+    m_buffer.append(",\"s\":\"p\"");
+    endEvent();
+}
+
+void KItemListTraceFile::addAsyncEvent(const char* name, const void* id, qint64 start, qint64 duration)
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    // Nestable asynchronous events ("ph":"b" and "ph":"e") with the same
+    // id are shown on one track, independent from the other events
+    const QByteArray idValue = ",\"id\":\"0x" + QByteArray::number(quintptr(id), 16) + '"';
+    beginEvent(name, "b", start);
+    m_buffer.append(idValue);
+    endEvent();
+    beginEvent(name, "e", start + duration);
+    m_buffer.append(idValue);
+    endEvent();
+}
+
+void KItemListTraceFile::beginEvent(const char* name, const char* phase, qint64 start)
+{
+    if (!m_firstEvent) {
+        m_buffer.append(",\n");
+    }
+    m_firstEvent = false;
+    m_buffer.append("{\"name\":\"");
+    m_buffer.append(name);
+    m_buffer.append("\",\"cat\":\"kitemviews\",\"ph\":\"");
+    m_buffer.append(phase);
+    m_buffer.append("\",\"ts\":");
+    m_buffer.append(QByteArray::number(start / 1000.0, 'f', 3));
+}
+
+void KItemListTraceFile::endEvent()
+{
+    static const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+
+    m_buffer.append(",\"pid\":");
+    m_buffer.append(pid);
+    m_buffer.append(",\"tid\":1}");
+
+    if (m_buffer.size() >= FlushSize) {
+        flush();
+    }
+}
+
+void KItemListTraceFile::flush()
+{
+    m_file.write(m_buffer);
+    m_file.flush();
+    m_buffer.clear();
+}
+
+Q_GLOBAL_STATIC(KItemListTraceFile, s_traceFile)
+
+const bool KItemListTracer::s_enabled = qEnvironmentVariableIsSet("DOLPHIN_TRACE_FILE");
+const bool KItemListTracer::s_stallDetectionEnabled = qEnvironmentVariableIsSet("DOLPHIN_STALL_THRESHOLD");
+
+qint64 KItemListTracer::timestamp()
+{
+    return s_traceFile.isDestroyed() ? 0 : s_traceFile->timestamp();
+}
+
+void KItemListTracer::addEvent(const char* name, qint64 start, qint64 duration)
+{
+    if (!s_traceFile.isDestroyed()) {
+        s_traceFile->addEvent(name, start, duration);
+    }
+}
+
+void KItemListTracer::addCounter(const char* name, qint64 value)
+{
+    if (!s_traceFile.isDestroyed()) {
+        s_traceFile->addCounter(name, value);
+    }
+}
+
+void KItemListTracer::addInstantEvent(const char* name)
+{
+    if (!s_traceFile.isDestroyed()) {
+        s_traceFile->addInstantEvent(name);
+    }
+}
+
+void KItemListTracer::addAsyncEvent(const char* name, const void* id, qint64 start, qint64 duration)
+{
+    if (!s_traceFile.isDestroyed()) {
+        s_traceFile->addAsyncEvent(name, id, start, duration);
+    }
+}
+
+void KItemListTracer::enterScope(const char* name, const char* detail, qint64 value)
+{
+    const int depth = s_scopeDepth.loadRelaxed();
+    if (depth < MaxScopeDepth) {
+        Scope& scope = s_scopes[depth];
+        scope.name.storeRelaxed(name);
+        scope.detail.storeRelaxed(detail);
+        scope.value.storeRelaxed(value);
+    }
+    s_scopeDepth.storeRelease(depth + 1);
+}
+
+void KItemListTracer::leaveScope()
+{
+    s_scopeDepth.storeRelease(qMax(0, s_scopeDepth.loadRelaxed() - 1));
+}
+
+QByteArray KItemListTracer::currentScopes()
+{
+    QByteArray description;
+    const int depth = qMin(s_scopeDepth.loadAcquire(), MaxScopeDepth);
+    for (int i = 0; i < depth; ++i) {
+        const Scope& scope = s_scopes[i];
+        const char* name = scope.name.loadRelaxed();
+        if (!name) {
+            continue;
+        }
+
+        if (!description.isEmpty()) {
+            description.append(" > ");
+        }
+        description.append(name);
+
+        const char* detail = scope.detail.loadRelaxed();
+        const qint64 value = scope.value.loadRelaxed();
+        if (detail && value >= 0) {
+            description.append(" (" + QByteArray(detail) + ", " + QByteArray::number(value) + ')');
+        } else if (detail) {
+            description.append(" (" + QByteArray(detail) + ')');
+        } else if (value >= 0) {
+            description.append(" (" + QByteArray::number(value) + ')');
+        }
+    }
+    return description;
+}
@@ -0,0 +1,159 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KITEMLISTTRACER_H
+#define KITEMLISTTRACER_H
+
+#include "dolphin_export.h"
+
+#include <QByteArray>
+
+/**
+ * @brief Records the durations of expensive operations of the item views.
+ *
+ * The tracing is disabled per default and can be enabled by setting the
+ * environment variable DOLPHIN_TRACE_FILE to the path of a file. The
+ * durations are written to this file in the JSON format of the Chrome
+ * tracing tools, so that they can be inspected with chrome://tracing or
+ * https://ui.perfetto.dev and attached to bug reports about slow views.
+ * The viewers also provide the accumulated durations and counts for each
+ * operation.
+ *
+ * The operations are recorded by creating a KItemListTraceScope at the
+ * beginning of a method. If the tracing is disabled, this costs only
+ * one check of a boolean. The tracer may only be used by the main thread.
+ *
+ * Phases that span several iterations of the event loop, like the time until
+ * the first items of a directory are shown, are recorded as asynchronous
+ * events and the startup phases of the application as instant events.
+ *
+ * If the environment variable DOLPHIN_STALL_THRESHOLD is set, the operations
+ * that are executed by the main thread are tracked independent from the
+ * tracing, so that KItemListStallDetector can tell which operations have
+ * blocked the main thread.
+ */
+class DOLPHIN_EXPORT KItemListTracer
+{
+public:
+    /**
+     * @return True if DOLPHIN_TRACE_FILE is set.
+     */
+    static bool isEnabled();
+
+    /**
+     * @return Time in nanoseconds since the tracer has been initialized.
+     */
+    static qint64 timestamp();
+
+    /**
+     * Records that the operation \a name has been started at \a start and
+     * took \a duration nanoseconds. \a name must be a string literal.
+     */
+    static void addEvent(const char* name, qint64 start, qint64 duration);
+
+    /**
+     * Records that the counter \a name has the value \a value from now on,
+     * e.g. an adaptive budget. \a name must be a string literal.
+     */
+    static void addCounter(const char* name, qint64 value);
+
+    /**
+     * Records that the point \a name has been reached now, e.g. a startup
+     * phase. \a name must be a string literal.
+     */
+    static void addInstantEvent(const char* name);
+
+    /**
+     * Records that the phase \a name of the object \a id has been started
+     * at \a start and took \a duration nanoseconds. Other operations may
+     * be executed during the phase, so it is shown on an own track per
+     * object by the viewers. \a name must be a string literal.
+     */
+    static void addAsyncEvent(const char* name, const void* id, qint64 start, qint64 duration);
+
+    /**
+     * @return True if DOLPHIN_STALL_THRESHOLD is set.
+     */
+    static bool isStallDetectionEnabled();
+
+    /**
+     * Remembers that the main thread executes the operation \a name on top
+     * of the operations that have been entered before. The optional \a detail
+     * and \a value describe the operation, e.g. the sort role of a resorting
+     * or a timeout. \a name and \a detail must be string literals.
+     */
+    static void enterScope(const char* name, const char* detail, qint64 value);
+    static void leaveScope();
+
+    /**
+     * @return Description of the operations that the main thread executes at
+     *         the moment, e.g. "KItemListView::paint > KStandardItemListWidget::paint".
+     *         May be invoked by any thread.
+     */
+    static QByteArray currentScopes();
+
+private:
+    static const bool s_enabled;
+    static const bool s_stallDetectionEnabled;
+};
+
+/**
+ * @brief Records the duration of the operation \a name between its
+ *        construction and destruction if the tracing is enabled.
+ *
+ * The optional \a detail and \a value are only used by the stall detection,
+ * see KItemListTracer::enterScope().
+ */
+class KItemListTraceScope
+{
+public:
+    explicit KItemListTraceScope(const char* name);
+    KItemListTraceScope(const char* name, const char* detail, qint64 value = -1);
+    ~KItemListTraceScope();
+
+    KItemListTraceScope(const KItemListTraceScope&) = delete;
+    KItemListTraceScope& operator=(const KItemListTraceScope&) = delete;
+
+private:
+    const char* m_name;
+    qint64 m_start; // -1 if the tracing is disabled
+};
+
+inline bool KItemListTracer::isEnabled()
+{
+    return s_enabled;
+}
+
+inline bool KItemListTracer::isStallDetectionEnabled()
+{
+    return s_stallDetectionEnabled;
+}
+
+inline KItemListTraceScope::KItemListTraceScope(const char* name) :
+    KItemListTraceScope(name, nullptr)
+{
+}
+
+inline KItemListTraceScope::KItemListTraceScope(const char* name, const char* detail, qint64 value) :
+    m_name(name),
+    m_start(KItemListTracer::isEnabled() ? KItemListTracer::timestamp() : -1)
+{
+    if (KItemListTracer::isStallDetectionEnabled()) {
+        KItemListTracer::enterScope(name, detail, value);
+    }
+}
+
+inline KItemListTraceScope::~KItemListTraceScope()
+{
+    if (m_start >= 0) {
+        KItemListTracer::addEvent(m_name, m_start, KItemListTracer::timestamp() - m_start);
+    }
+    if (KItemListTracer::isStallDetectionEnabled()) {
+        KItemListTracer::leaveScope();
+    }
+}
+
+#endif
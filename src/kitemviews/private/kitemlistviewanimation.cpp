@@ -7,14 +7,43 @@
 #include "kitemlistviewanimation.h"
 #include "kitemviews/kitemlistview.h"
 
+#include <KConfigGroup>
+#include <KSharedConfig>
+
 #include <QPropertyAnimation>
 
+namespace {
+    // Duration in ms of an animation at normal animation speed
+    const int AnimationDuration = 200;
+
+    // If more animations are running in parallel, new animations
+    // are done without visible transition.
+    const int MaximumAnimationCount = 300;
+
+    // If drawing a frame of the running animations takes longer than this
+    // time in ms for several frames in a row, the animations are skipped
+    // during the interval SkipAnimationsInterval (in ms).
+    const int FrameTimeBudget = 50;
+    const int MaximumSlowFrameCount = 3;
+    const int SkipAnimationsInterval = 10000;
+}
+
 KItemListViewAnimation::KItemListViewAnimation(QObject* parent) :
     QObject(parent),
     m_scrollOrientation(Qt::Vertical),
     m_scrollOffset(0),
-    m_animation()
+    m_animation(),
+    m_enabled(true),
+    m_durationFactor(1.0),
+    m_frameAnimation(nullptr),
+    m_frameTimer(),
+    m_slowFrameCount(0),
+    m_slowFramesTimer()
 {
+    // The animation speed of the workspace, which is set to 0 to disable
+    // all animations, e.g. on headless or remote sessions.
+    const KConfigGroup kdeGroup(KSharedConfig::openConfig(), "KDE");
+    m_durationFactor = kdeGroup.readEntry("AnimationDurationFactor", 1.0);
 }
 
 KItemListViewAnimation::~KItemListViewAnimation()
@@ -96,12 +125,22 @@ qreal KItemListViewAnimation::scrollOffset() const
     return m_scrollOffset;
 }
 
+void KItemListViewAnimation::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+bool KItemListViewAnimation::isEnabled() const
+{
+    return m_enabled;
+}
+
 void KItemListViewAnimation::start(QGraphicsWidget* widget, AnimationType type, const QVariant& endValue)
 {
     stop(widget, type);
 
     QPropertyAnimation* propertyAnim = nullptr;
-    const int animationDuration = widget->style()->styleHint(QStyle::SH_Widget_Animate) ? 200 : 1;
+    const int animationDuration = this->animationDuration(widget);
 
     switch (type) {
     case MovingAnimation: {
@@ -154,6 +193,13 @@ void KItemListViewAnimation::start(QGraphicsWidget* widget, AnimationType type,
     connect(propertyAnim, &QPropertyAnimation::finished, this, &KItemListViewAnimation::slotFinished);
     m_animation[type].insert(widget, propertyAnim);
 
+    if (!m_frameAnimation && animationDuration > 1) {
+        m_frameAnimation = propertyAnim;
+        m_frameTimer.start();
+        m_slowFrameCount = 0;
+        connect(propertyAnim, &QPropertyAnimation::valueChanged, this, &KItemListViewAnimation::slotFrameChanged);
+    }
+
     propertyAnim->start();
 }
 
@@ -172,6 +218,9 @@ void KItemListViewAnimation::stop(QGraphicsWidget* widget, AnimationType type)
         }
 
         m_animation[type].remove(widget);
+        if (propertyAnim == m_frameAnimation) {
+            m_frameAnimation = nullptr;
+        }
         delete propertyAnim;
 
         Q_EMIT finished(widget, type);
@@ -211,6 +260,9 @@ void KItemListViewAnimation::slotFinished()
             if (propertyAnim == finishedAnim) {
                 QGraphicsWidget* widget = it.key();
                 it.remove();
+                if (finishedAnim == m_frameAnimation) {
+                    m_frameAnimation = nullptr;
+                }
                 finishedAnim->deleteLater();
 
                 Q_EMIT finished(widget, static_cast<AnimationType>(type));
@@ -221,3 +273,41 @@ void KItemListViewAnimation::slotFinished()
     Q_ASSERT(false);
 }
 
+void KItemListViewAnimation::slotFrameChanged()
+{
+    if (m_frameTimer.restart() > FrameTimeBudget) {
+        ++m_slowFrameCount;
+        if (m_slowFrameCount >= MaximumSlowFrameCount) {
+            m_slowFramesTimer.start();
+        }
+    } else {
+        m_slowFrameCount = 0;
+    }
+}
+
+int KItemListViewAnimation::animationDuration(const QGraphicsWidget* widget) const
+{
+    if (!m_enabled || !widget->style()->styleHint(QStyle::SH_Widget_Animate) || m_durationFactor <= 0.0) {
+        return 1;
+    }
+
+    if (m_slowFramesTimer.isValid() && m_slowFramesTimer.elapsed() < SkipAnimationsInterval) {
+        return 1;
+    }
+
+    if (animationCount() >= MaximumAnimationCount) {
+        return 1;
+    }
+
+    return qMax(1, qRound(AnimationDuration * m_durationFactor));
+}
+
+int KItemListViewAnimation::animationCount() const
+{
+    int count = 0;
+    for (int type = 0; type < AnimationTypeCount; ++type) {
+        count += m_animation[type].count();
+    }
+    return count;
+}
+
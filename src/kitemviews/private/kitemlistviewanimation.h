@@ -9,6 +9,7 @@
 
 #include "dolphin_export.h"
 
+#include <QElapsedTimer>
 #include <QHash>
 #include <QObject>
 #include <QVariant>
@@ -22,6 +23,12 @@ class QPropertyAnimation;
  *
  * Supports item animations for moving, creating, deleting and resizing
  * an item. Several applications can be applied to one item in parallel.
+ *
+ * The animations are reduced to a minimal duration if they are disabled
+ * globally by the style or by the animation speed of the workspace, if
+ * too many widgets are animated in parallel or if the frames of the
+ * running animations take too long to be drawn, like it is the case on
+ * slow remote sessions.
  */
 class DOLPHIN_EXPORT KItemListViewAnimation : public QObject
 {
@@ -44,6 +51,14 @@ public:
     void setScrollOffset(qreal scrollOffset);
     qreal scrollOffset() const;
 
+    /**
+     * If set to false, all animations are reduced to a minimal duration,
+     * e.g. for KItemListView::setEnabledRemoteRendering(). Per default
+     * the animations are enabled.
+     */
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
     /**
      * Starts the animation of the type \a type for the widget \a widget. If an animation
      * of the type is already running, this animation will be stopped before starting
@@ -78,12 +93,36 @@ Q_SIGNALS:
 private Q_SLOTS:
     void slotFinished();
 
+    /**
+     * Is invoked for each frame of one running animation to measure
+     * the time that is required to draw a frame.
+     */
+    void slotFrameChanged();
+
+private:
+    /**
+     * @return Duration in ms for a new animation of the widget \a widget.
+     */
+    int animationDuration(const QGraphicsWidget* widget) const;
+
+    /**
+     * @return Number of animations that are currently running.
+     */
+    int animationCount() const;
+
 private:
     enum { AnimationTypeCount = 4 };
 
     Qt::Orientation m_scrollOrientation;
     qreal m_scrollOffset;
     QHash<QGraphicsWidget*, QPropertyAnimation*> m_animation[AnimationTypeCount];
+
+    bool m_enabled;
+    qreal m_durationFactor;
+    QPropertyAnimation* m_frameAnimation; // Animation whose frames are measured
+    QElapsedTimer m_frameTimer;
+    int m_slowFrameCount;
+    QElapsedTimer m_slowFramesTimer; // Started when the frame time budget has been exceeded
 };
 
 #endif
@@ -7,13 +7,17 @@
 #include "kitemlistviewlayouter.h"
 #include "dolphindebug.h"
 #include "kitemlistsizehintresolver.h"
+#include "kitemlisttracer.h"
 #include "kitemviews/kitemmodelbase.h"
 
+#include <algorithm>
+
 // #define KITEMLISTVIEWLAYOUTER_DEBUG
 
 KItemListViewLayouter::KItemListViewLayouter(KItemListSizeHintResolver* sizeHintResolver, QObject* parent) :
     QObject(parent),
     m_dirty(true),
+    m_firstDirtyIndex(0),
     m_visibleIndexesDirty(true),
     m_scrollOrientation(Qt::Vertical),
     m_size(),
@@ -32,6 +36,7 @@ KItemListViewLayouter::KItemListViewLayouter(KItemListSizeHintResolver* sizeHint
     m_xPosInc(0),
     m_columnCount(0),
     m_rowOffsets(),
+    m_rowStartOffsets(),
     m_columnOffsets(),
     m_groupItemIndexes(),
     m_groupHeaderHeight(0),
@@ -49,7 +54,7 @@ void KItemListViewLayouter::setScrollOrientation(Qt::Orientation orientation)
 {
     if (m_scrollOrientation != orientation) {
         m_scrollOrientation = orientation;
-        m_dirty = true;
+        markAsDirty();
     }
 }
 
@@ -63,10 +68,10 @@ void KItemListViewLayouter::setSize(const QSizeF& size)
     if (m_size != size) {
         if (m_scrollOrientation == Qt::Vertical) {
             if (m_size.width() != size.width()) {
-                m_dirty = true;
+                markAsDirty();
             }
         } else if (m_size.height() != size.height()) {
-            m_dirty = true;
+            markAsDirty();
         }
 
         m_size = size;
@@ -83,7 +88,7 @@ void KItemListViewLayouter::setItemSize(const QSizeF& size)
 {
     if (m_itemSize != size) {
         m_itemSize = size;
-        m_dirty = true;
+        markAsDirty();
     }
 }
 
@@ -96,7 +101,7 @@ void KItemListViewLayouter::setItemMargin(const QSizeF& margin)
 {
     if (m_itemMargin != margin) {
         m_itemMargin = margin;
-        m_dirty = true;
+        markAsDirty();
     }
 }
 
@@ -109,7 +114,7 @@ void KItemListViewLayouter::setHeaderHeight(qreal height)
 {
     if (m_headerHeight != height) {
         m_headerHeight = height;
-        m_dirty = true;
+        markAsDirty();
     }
 }
 
@@ -122,7 +127,7 @@ void KItemListViewLayouter::setGroupHeaderHeight(qreal height)
 {
     if (m_groupHeaderHeight != height) {
         m_groupHeaderHeight = height;
-        m_dirty = true;
+        markAsDirty();
     }
 }
 
@@ -135,7 +140,7 @@ void KItemListViewLayouter::setGroupHeaderMargin(qreal margin)
 {
     if (m_groupHeaderMargin != margin) {
         m_groupHeaderMargin = margin;
-        m_dirty = true;
+        markAsDirty();
     }
 }
 
@@ -186,7 +191,7 @@ void KItemListViewLayouter::setModel(const KItemModelBase* model)
 {
     if (m_model != model) {
         m_model = model;
-        m_dirty = true;
+        markAsDirty();
     }
 }
 
@@ -237,6 +242,150 @@ QRectF KItemListViewLayouter::itemRect(int index) const
     return QRectF(pos, sizeHint);
 }
 
+KItemRangeList KItemListViewLayouter::itemRangesInRect(const QRectF& rect) const
+{
+    const_cast<KItemListViewLayouter*>(this)->doLayout();
+
+    KItemRangeList itemRanges;
+    const int itemCount = m_itemInfos.count();
+    if (itemCount <= 0 || rect.width() <= 0 || rect.height() <= 0) {
+        // Like QRectF::intersects(), an empty rectangle intersects with nothing
+        return itemRanges;
+    }
+
+    // Map the rectangle to the logical coordinates of the layout, where the
+    // scroll direction is always vertical (see itemRect())
+    qreal top, bottom, left, right;
+    const bool horizontal = (m_scrollOrientation == Qt::Horizontal);
+    if (horizontal) {
+        top = rect.left() + m_scrollOffset;
+        bottom = rect.right() + m_scrollOffset;
+        left = rect.top();
+        right = rect.bottom();
+    } else {
+        top = rect.top() + m_scrollOffset;
+        bottom = rect.bottom() + m_scrollOffset;
+        left = rect.left() + m_itemOffset;
+        right = rect.right() + m_itemOffset;
+    }
+
+    // Find the first item of the first row that starts below the top of the
+    // rectangle. The row before might be touched by the rectangle too.
+    int min = 0;
+    int max = itemCount - 1;
+    while (min <= max) {
+        const int mid = (min + max) / 2;
+        if (m_rowOffsets.at(m_itemInfos.at(mid).row) < top) {
+            min = mid + 1;
+        } else {
+            max = mid - 1;
+        }
+    }
+
+    int index = min;
+    if (index > 0) {
+        const int previousRow = m_itemInfos.at(index - 1).row;
+        do {
+            --index;
+        } while (index > 0 && m_itemInfos.at(index - 1).row == previousRow);
+    }
+
+    for (; index < itemCount; ++index) {
+        const ItemInfo& itemInfo = m_itemInfos.at(index);
+        const qreal y = m_rowOffsets.at(itemInfo.row);
+        if (y >= bottom) {
+            break;
+        }
+
+        const qreal x = m_columnOffsets.at(itemInfo.column);
+        if (x >= right) {
+            continue;
+        }
+
+        // Only the items at the top and left border of the rectangle may
+        // end before it, all other items of the rows intersect
+        if (y < top || x < left) {
+            QSizeF sizeHint = m_sizeHintResolver->sizeHint(index);
+            if (!horizontal && sizeHint.width() <= 0) {
+                sizeHint.rwidth() = m_itemSize.width();
+            }
+            if (y + sizeHint.height() <= top || x + sizeHint.width() <= left) {
+                continue;
+            }
+        }
+
+        if (!itemRanges.isEmpty() && itemRanges.last().index + itemRanges.last().count == index) {
+            ++itemRanges.last().count;
+        } else {
+            itemRanges.append(KItemRange(index, 1));
+        }
+    }
+
+    return itemRanges;
+}
+
+int KItemListViewLayouter::indexAt(const QPointF& pos) const
+{
+    const_cast<KItemListViewLayouter*>(this)->doLayout();
+
+    const int itemCount = m_itemInfos.count();
+    if (itemCount <= 0) {
+        return -1;
+    }
+
+    // Map the position to the logical coordinates of the layout (see itemRect())
+    qreal x, y;
+    if (m_scrollOrientation == Qt::Horizontal) {
+        x = pos.y();
+        y = pos.x() + m_scrollOffset;
+    } else {
+        x = pos.x() + m_itemOffset;
+        y = pos.y() + m_scrollOffset;
+    }
+
+    // Find the first item of the first row that starts below the position.
+    // The item before is the last item of the row that might contain it.
+    int min = 0;
+    int max = itemCount - 1;
+    while (min <= max) {
+        const int mid = (min + max) / 2;
+        if (m_rowOffsets.at(m_itemInfos.at(mid).row) <= y) {
+            min = mid + 1;
+        } else {
+            max = mid - 1;
+        }
+    }
+
+    if (min <= 0) {
+        return -1;
+    }
+
+    // The columns of a row are numbered consecutively from its first item
+    const int lastIndexOfRow = min - 1;
+    const int lastColumn = m_itemInfos.at(lastIndexOfRow).column;
+    int column = lastColumn;
+    while (column > 0 && m_columnOffsets.at(column) > x) {
+        --column;
+    }
+
+    const int index = lastIndexOfRow - lastColumn + column;
+    const qreal itemX = m_columnOffsets.at(column);
+    if (x < itemX) {
+        return -1;
+    }
+
+    QSizeF sizeHint = m_sizeHintResolver->sizeHint(index);
+    if (m_scrollOrientation == Qt::Vertical && sizeHint.width() <= 0) {
+        sizeHint.rwidth() = m_itemSize.width();
+    }
+
+    const qreal itemY = m_rowOffsets.at(m_itemInfos.at(index).row);
+    if (x >= itemX + sizeHint.width() || y >= itemY + sizeHint.height()) {
+        return -1;
+    }
+    return index;
+}
+
 QRectF KItemListViewLayouter::groupHeaderRect(int index) const
 {
     const_cast<KItemListViewLayouter*>(this)->doLayout();
@@ -325,12 +474,21 @@ int KItemListViewLayouter::maximumVisibleItems() const
 bool KItemListViewLayouter::isFirstGroupItem(int itemIndex) const
 {
     const_cast<KItemListViewLayouter*>(this)->doLayout();
-    return m_groupItemIndexes.contains(itemIndex);
+    return std::binary_search(m_groupItemIndexes.constBegin(), m_groupItemIndexes.constEnd(), itemIndex);
 }
 
 void KItemListViewLayouter::markAsDirty()
 {
     m_dirty = true;
+    m_firstDirtyIndex = 0;
+}
+
+void KItemListViewLayouter::markAsDirty(int index)
+{
+    // If the layouter is dirty already, a relayout might be required
+    // for items before the index.
+    m_firstDirtyIndex = m_dirty ? qMin(m_firstDirtyIndex, index) : index;
+    m_dirty = true;
 }
 
 
@@ -344,6 +502,7 @@ void KItemListViewLayouter::markAsDirty()
 void KItemListViewLayouter::doLayout()
 {
     if (m_dirty) {
+        const KItemListTraceScope traceScope("KItemListViewLayouter::doLayout");
 #ifdef KITEMLISTVIEWLAYOUTER_DEBUG
         QElapsedTimer timer;
         timer.start();
@@ -372,6 +531,11 @@ void KItemListViewLayouter::doLayout()
             }
         }
 
+        const qreal previousColumnWidth = m_columnWidth;
+        const qreal previousXPosInc = m_xPosInc;
+        const int previousColumnCount = m_columnCount;
+        const int previousItemCount = m_itemInfos.count();
+
         m_columnWidth = itemSize.width() + itemMargin.width();
         const qreal widthForColumns = size.width() - itemMargin.width();
         m_columnCount = qMax(1, int(widthForColumns / m_columnWidth));
@@ -415,16 +579,41 @@ void KItemListViewLayouter::doLayout()
             numberOfRows += m_groupItemIndexes.count();
         }
         m_rowOffsets.resize(numberOfRows);
+        m_rowStartOffsets.resize(numberOfRows);
 
         qreal y = m_headerHeight + itemMargin.height();
         int row = 0;
-
         int index = 0;
+
+        // If only items behind m_firstDirtyIndex have been changed, the rows
+        // before are kept and the layout is continued at the row that contains
+        // the item before m_firstDirtyIndex. That item might get new neighbours
+        // in its row.
+        const bool columnsChanged = (m_columnCount != previousColumnCount ||
+                                     m_columnWidth != previousColumnWidth ||
+                                     m_xPosInc != previousXPosInc);
+        const int firstKeptIndex = qMin(m_firstDirtyIndex, qMin(itemCount, previousItemCount)) - 1;
+        if (!columnsChanged && firstKeptIndex >= 0) {
+            row = m_itemInfos[firstKeptIndex].row;
+            index = firstKeptIndex;
+            while (index > 0 && m_itemInfos[index - 1].row == row) {
+                --index;
+            }
+            y = m_rowStartOffsets[row];
+        }
+
+        // Index of the first group item that is not before 'index'. The
+        // group items are looked up by walking along the sorted list.
+        auto nextGroupItemIt = std::lower_bound(m_groupItemIndexes.constBegin(), m_groupItemIndexes.constEnd(), index);
+        const auto groupItemIndexesEnd = m_groupItemIndexes.constEnd();
+
         while (index < itemCount) {
             qreal maxItemHeight = itemSize.height();
+            m_rowStartOffsets[row] = y;
 
             if (grouped) {
-                if (m_groupItemIndexes.contains(index)) {
+                if (nextGroupItemIt != groupItemIndexesEnd && *nextGroupItemIt == index) {
+                    ++nextGroupItemIt;
                     // The item is the first item of a group.
                     // Increase the y-position to provide space
                     // for the group header.
@@ -481,7 +670,7 @@ void KItemListViewLayouter::doLayout()
                 ++index;
                 ++column;
 
-                if (grouped && m_groupItemIndexes.contains(index)) {
+                if (grouped && nextGroupItemIt != groupItemIndexesEnd && *nextGroupItemIt == index) {
                     // The item represents the first index of a group
                     // and must aligned in the first column
                     break;
@@ -504,6 +693,7 @@ void KItemListViewLayouter::doLayout()
         qCDebug(DolphinDebug) << "[TIME] doLayout() for " << m_model->count() << "items:" << timer.elapsed();
 #endif
         m_dirty = false;
+        m_firstDirtyIndex = 0;
     }
 
     updateVisibleIndexes();
@@ -515,6 +705,8 @@ void KItemListViewLayouter::updateVisibleIndexes()
         return;
     }
 
+    const KItemListTraceScope traceScope("KItemListViewLayouter::updateVisibleIndexes");
+
     Q_ASSERT(!m_dirty);
 
     if (m_model->count() <= 0) {
@@ -582,23 +774,37 @@ void KItemListViewLayouter::updateVisibleIndexes()
 
 bool KItemListViewLayouter::createGroupHeaders()
 {
-    if (!m_model->groupedSorting()) {
-        return false;
+    const QList<QPair<int, QVariant> > groups = m_model->groupedSorting()
+                                                ? m_model->groups() : QList<QPair<int, QVariant> >();
+    const int groupCount = groups.count();
+    const int previousGroupCount = m_groupItemIndexes.count();
+
+    // The groups are sorted by the index of their first item. Usually most
+    // of the group boundaries are unchanged, e.g. if items have been added
+    // to the last group. Only the rows behind the first changed boundary
+    // must be layouted again.
+    int i = 0;
+    while (i < groupCount && i < previousGroupCount && groups.at(i).first == m_groupItemIndexes.at(i)) {
+        ++i;
     }
 
-    m_groupItemIndexes.clear();
-
-    const QList<QPair<int, QVariant> > groups = m_model->groups();
-    if (groups.isEmpty()) {
-        return false;
-    }
+    if (i < groupCount || i < previousGroupCount) {
+        int firstChangedIndex = m_model->count();
+        if (i < previousGroupCount) {
+            firstChangedIndex = m_groupItemIndexes.at(i);
+        }
+        if (i < groupCount) {
+            firstChangedIndex = qMin(firstChangedIndex, groups.at(i).first);
+        }
+        m_firstDirtyIndex = qMin(m_firstDirtyIndex, firstChangedIndex);
 
-    for (int i = 0; i < groups.count(); ++i) {
-        const int firstItemIndex = groups.at(i).first;
-        m_groupItemIndexes.insert(firstItemIndex);
+        m_groupItemIndexes.resize(groupCount);
+        for (; i < groupCount; ++i) {
+            m_groupItemIndexes[i] = groups.at(i).first;
+        }
     }
 
-    return true;
+    return groupCount > 0;
 }
 
 qreal KItemListViewLayouter::minimumGroupHeaderWidth() const
@@ -8,10 +8,10 @@
 #define KITEMLISTVIEWLAYOUTER_H
 
 #include "dolphin_export.h"
+#include "kitemviews/kitemrange.h"
 
 #include <QObject>
 #include <QRectF>
-#include <QSet>
 #include <QSizeF>
 #include <QVector>
 
@@ -110,6 +110,23 @@ public:
      */
     QRectF itemRect(int index) const;
 
+    /**
+     * @return Ranges of all items whose rectangle (see itemRect()) intersects
+     *         with \a rect, sorted by ascending index. Only the rows that
+     *         are touched by \a rect are checked, and the size hints are
+     *         only requested for the items at the border of \a rect, so
+     *         that the costs do not depend on the total number of items.
+     */
+    KItemRangeList itemRangesInRect(const QRectF& rect) const;
+
+    /**
+     * @return Index of the item whose rectangle (see itemRect()) contains
+     *         \a pos, or -1 if there is no such item. The index is
+     *         calculated by a binary search for the row, so that the
+     *         costs do not depend on the number of items.
+     */
+    int indexAt(const QPointF& pos) const;
+
     /**
      * @return Rectangle of the group header for the item with the
      *         index \a index. Note that the layouter does not check
@@ -149,6 +166,15 @@ public:
      */
     void markAsDirty();
 
+    /**
+     * Marks the layouter as dirty for the items starting at the index
+     * \p index, e.g. because items have been inserted or their size hints
+     * have been changed. The rows before the item are kept on the next
+     * relayout, so that its cost only depends on the number of items
+     * behind the index.
+     */
+    void markAsDirty(int index);
+
     inline int columnCount() const
     {
         return m_columnCount;
@@ -166,6 +192,13 @@ public:
 private:
     void doLayout();
     void updateVisibleIndexes();
+
+    /**
+     * Updates the cached indexes of the first items of the groups. If a group
+     * boundary has been changed, the layout is marked as dirty starting from
+     * the first changed boundary.
+     * @return True if the items are grouped.
+     */
     bool createGroupHeaders();
 
     /**
@@ -180,6 +213,7 @@ private:
 
 private:
     bool m_dirty;
+    int m_firstDirtyIndex;
     bool m_visibleIndexesDirty;
 
     Qt::Orientation m_scrollOrientation;
@@ -205,11 +239,12 @@ private:
     int m_columnCount;
 
     QVector<qreal> m_rowOffsets;
+    QVector<qreal> m_rowStartOffsets; // Offsets of the rows before adding the group headers
     QVector<qreal> m_columnOffsets;
 
-    // Stores all item indexes that are the first item of a group.
-    // Assures fast access for KItemListViewLayouter::isFirstGroupItem().
-    QSet<int> m_groupItemIndexes;
+    // Stores all item indexes that are the first item of a group in
+    // ascending order, so that they can be looked up by binary search.
+    QVector<int> m_groupItemIndexes;
     qreal m_groupHeaderHeight;
     qreal m_groupHeaderMargin;
 
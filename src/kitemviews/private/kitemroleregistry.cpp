@@ -0,0 +1,135 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemroleregistry.h"
+
+#include <QHash>
+#include <QReadLocker>
+#include <QReadWriteLock>
+#include <QVector>
+#include <QWriteLocker>
+
+namespace {
+    // Roles that are used by KFileItemModel, KFileItemModelRolesUpdater and
+    // the widgets. The order defines the ids, so new roles are appended.
+    const char* const BuiltInRoles[] = {
+        "text", "size", "modificationtime", "creationtime", "accesstime", "type",
+        "rating", "tags", "comment", "title", "wordCount", "lineCount",
+        "imageDateTime", "width", "height", "orientation", "artist", "genre",
+        "album", "duration", "bitrate", "track", "releaseYear", "aspectRatio",
+        "frameRate", "path", "deletiontime", "destination", "originUrl",
+        "permissions", "owner", "group",
+        "isDir", "isLink", "isHidden", "isExpanded", "isExpandable", "expandedParentsCount",
+        "url", "iconName", "iconPixmap", "iconOverlays", "count", "version",
+        "iconSequence", "iconSequenceFrames"
+    };
+}
+
+class KItemRoleRegistryPrivate
+{
+public:
+    KItemRoleRegistryPrivate();
+
+    // Are only written by the constructor
+    QVector<QByteArray> builtInNames;
+    QHash<QByteArray, int> builtInIds;
+
+    // Roles that have been registered later, guarded by lock
+    QReadWriteLock lock;
+    QVector<QByteArray> names;
+    QHash<QByteArray, int> ids;
+};
+
+KItemRoleRegistryPrivate::KItemRoleRegistryPrivate() :
+    builtInNames(),
+    builtInIds(),
+    lock(),
+    names(),
+    ids()
+{
+    const int count = sizeof(BuiltInRoles) / sizeof(BuiltInRoles[0]);
+    builtInNames.reserve(count);
+    builtInIds.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const QByteArray role(BuiltInRoles[i]);
+        Q_ASSERT(!builtInIds.contains(role));
+        builtInNames.append(role);
+        builtInIds.insert(role, i);
+    }
+}
+
+// Q_GLOBAL_STATIC creates the registry thread-safely on its first use
+Q_GLOBAL_STATIC(KItemRoleRegistryPrivate, s_registry)
+
+
+int KItemRoleRegistry::id(const QByteArray& role)
+{
+    if (role.isEmpty()) {
+        return -1;
+    }
+
+    KItemRoleRegistryPrivate* registry = s_registry;
+    const auto builtIn = registry->builtInIds.constFind(role);
+    if (builtIn != registry->builtInIds.constEnd()) {
+        return builtIn.value();
+    }
+
+    {
+        QReadLocker locker(&registry->lock);
+        const auto it = registry->ids.constFind(role);
+        if (it != registry->ids.constEnd()) {
+            return it.value();
+        }
+    }
+
+    QWriteLocker locker(&registry->lock);
+    // Another thread might have registered the role in the meantime
+    const auto it = registry->ids.constFind(role);
+    if (it != registry->ids.constEnd()) {
+        return it.value();
+    }
+
+    const int id = registry->builtInNames.count() + registry->names.count();
+    registry->names.append(role);
+    registry->ids.insert(role, id);
+    return id;
+}
+
+QByteArray KItemRoleRegistry::name(int id)
+{
+    KItemRoleRegistryPrivate* registry = s_registry;
+    if (id < 0) {
+        return QByteArray();
+    }
+
+    const int builtInCount = registry->builtInNames.count();
+    if (id < builtInCount) {
+        return registry->builtInNames.at(id);
+    }
+
+    QReadLocker locker(&registry->lock);
+    return registry->names.value(id - builtInCount);
+}
+
+QByteArray KItemRoleRegistry::intern(const QByteArray& role)
+{
+    if (role.isEmpty()) {
+        return role;
+    }
+    return name(id(role));
+}
+
+int KItemRoleRegistry::count()
+{
+    KItemRoleRegistryPrivate* registry = s_registry;
+    QReadLocker locker(&registry->lock);
+    return registry->builtInNames.count() + registry->names.count();
+}
+
+bool KItemRoleRegistry::isBuiltIn(const QByteArray& role)
+{
+    return s_registry->builtInIds.contains(role);
+}
@@ -0,0 +1,64 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KITEMROLEREGISTRY_H
+#define KITEMROLEREGISTRY_H
+
+#include "dolphin_export.h"
+
+#include <QByteArray>
+
+/**
+ * @brief Interns the names of the roles of the item models.
+ *
+ * The values of the items are stored in hashes that use the role names as
+ * keys. Each item would have its own copies of the keys if they were not
+ * shared, so the models use the interned names that are returned by
+ * intern(). Additionally each role gets an integer id, which allows to
+ * keep per role tables as arrays.
+ *
+ * The roles that are known by the models are registered when the registry
+ * is created and never change afterwards, so looking them up does not
+ * require any locking. Other roles, e.g. roles of plugins or tests, are
+ * registered on their first use while a lock is held. All methods may be
+ * called from any thread, which allows to retrieve and to sort the values
+ * of the items in worker threads.
+ */
+class DOLPHIN_EXPORT KItemRoleRegistry
+{
+public:
+    /**
+     * @return Id of \a role. The role is registered if it is unknown.
+     *         Returns -1 for an empty role.
+     */
+    static int id(const QByteArray& role);
+
+    /**
+     * @return Name of the role with the id \a id, or an empty
+     *         byte array if the id is unknown.
+     */
+    static QByteArray name(int id);
+
+    /**
+     * @return A copy of \a role that shares its data with all other
+     *         interned copies. The role is registered if it is unknown.
+     */
+    static QByteArray intern(const QByteArray& role);
+
+    /**
+     * @return Number of registered roles. The ids of the roles are
+     *         in the range from 0 to count() - 1.
+     */
+    static int count();
+
+    /**
+     * @return True if \a role has been registered when the registry was
+     *         created, so that looking it up never blocks.
+     */
+    static bool isBuiltIn(const QByteArray& role);
+};
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KITEMSLABPOOL_H
+#define KITEMSLABPOOL_H
+
+#include <QtGlobal>
+
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Allocates objects of the type T from large memory blocks (slabs).
+ *
+ * Compared to allocating each object with new, creating a huge number of
+ * objects causes much less malloc calls and less fragmentation, and objects
+ * that are created one after another are stored next to each other in
+ * memory. Memory of destroyed objects is reused by later calls of create().
+ *
+ * clear() destroys all objects that are still alive and releases all slabs
+ * at once, which is much cheaper than destroying the objects one by one.
+ *
+ * The pool is not thread-safe.
+ */
+template <typename T>
+class KItemSlabPool
+{
+public:
+    explicit KItemSlabPool(int slabSize = 1024);
+    ~KItemSlabPool();
+
+    KItemSlabPool(const KItemSlabPool&) = delete;
+    KItemSlabPool& operator=(const KItemSlabPool&) = delete;
+
+    /**
+     * Creates a new object by passing \a args to the constructor of T.
+     */
+    template <typename... Args>
+    T* create(Args&&... args);
+
+    /**
+     * Destroys the object \a object, which must have been created by this pool.
+     */
+    void destroy(T* object);
+
+    /**
+     * Destroys all objects that have not been destroyed yet and releases
+     * the memory of all slabs.
+     */
+    void clear();
+
+    /**
+     * @return Number of objects that have been created and not destroyed yet.
+     */
+    int count() const;
+
+private:
+    struct Node
+    {
+        // Keep the storage as first member, so that a T* can be
+        // converted back to the corresponding Node*.
+        alignas(T) unsigned char storage[sizeof(T)];
+        Node* nextFree;
+        bool alive;
+    };
+
+    Node* allocateNode();
+
+private:
+    const int m_slabSize;
+    std::vector<Node*> m_slabs;
+    int m_usedInLastSlab;
+    Node* m_freeList;
+    int m_count;
+};
+
+template <typename T>
+KItemSlabPool<T>::KItemSlabPool(int slabSize) :
+    m_slabSize(slabSize),
+    m_slabs(),
+    m_usedInLastSlab(slabSize),
+    m_freeList(nullptr),
+    m_count(0)
+{
+    Q_ASSERT(slabSize > 0);
+}
+
+template <typename T>
+KItemSlabPool<T>::~KItemSlabPool()
+{
+    clear();
+}
+
+template <typename T>
+template <typename... Args>
+T* KItemSlabPool<T>::create(Args&&... args)
+{
+    Node* node = allocateNode();
+    T* object = new (node->storage) T(std::forward<Args>(args)...);
+    node->alive = true;
+    ++m_count;
+    return object;
+}
+
+template <typename T>
+void KItemSlabPool<T>::destroy(T* object)
+{
+    if (!object) {
+        return;
+    }
+
+    Node* node = reinterpret_cast<Node*>(object);
+    Q_ASSERT(node->alive);
+    object->~T();
+    node->alive = false;
+    node->nextFree = m_freeList;
+    m_freeList = node;
+    --m_count;
+}
+
+template <typename T>
+void KItemSlabPool<T>::clear()
+{
+    const int slabCount = static_cast<int>(m_slabs.size());
+    for (int i = 0; i < slabCount; ++i) {
+        Node* slab = m_slabs[i];
+        const int usedNodes = (i == slabCount - 1) ? m_usedInLastSlab : m_slabSize;
+        for (int j = 0; j < usedNodes; ++j) {
+            if (slab[j].alive) {
+                reinterpret_cast<T*>(slab[j].storage)->~T();
+            }
+        }
+        ::operator delete(slab);
+    }
+
+    m_slabs.clear();
+    m_usedInLastSlab = m_slabSize;
+    m_freeList = nullptr;
+    m_count = 0;
+}
+
+template <typename T>
+int KItemSlabPool<T>::count() const
+{
+    return m_count;
+}
+
+template <typename T>
+typename KItemSlabPool<T>::Node* KItemSlabPool<T>::allocateNode()
+{
+    if (m_freeList) {
+        Node* node = m_freeList;
+        m_freeList = node->nextFree;
+        return node;
+    }
+
+    if (m_usedInLastSlab == m_slabSize) {
+        m_slabs.push_back(static_cast<Node*>(::operator new(sizeof(Node) * m_slabSize)));
+        m_usedInLastSlab = 0;
+    }
+
+    Node* node = m_slabs.back() + m_usedInLastSlab;
+    ++m_usedInLastSlab;
+    node->nextFree = nullptr;
+    node->alive = false;
+    return node;
+}
+
+#endif
@@ -0,0 +1,202 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemstateflags.h"
+
+#include <QtAlgorithms>
+
+KItemStateFlags::KItemStateFlags(int count) :
+    m_flags(count, 0),
+    m_flagCounts(),
+    m_firstIndexHints()
+{
+}
+
+void KItemStateFlags::reset(int count)
+{
+    m_flags.fill(0, count);
+    m_flagCounts.fill(0);
+    m_firstIndexHints.fill(0);
+}
+
+void KItemStateFlags::insertItems(const KItemRangeList& itemRanges)
+{
+    int insertedCount = 0;
+    int previousIndex = 0;
+    for (const KItemRange& range : itemRanges) {
+        Q_ASSERT(range.index >= previousIndex && range.index <= m_flags.count() && range.count >= 0);
+        if (range.index < previousIndex || range.index > m_flags.count() || range.count < 0) {
+            return;
+        }
+        previousIndex = range.index;
+        insertedCount += range.count;
+    }
+    if (insertedCount == 0) {
+        return;
+    }
+
+    // The ranges refer to the indexes before the insertion
+    QVector<quint8> flags;
+    flags.reserve(m_flags.count() + insertedCount);
+    auto it = m_flags.cbegin();
+    for (const KItemRange& range : itemRanges) {
+        const auto insertionPoint = m_flags.cbegin() + range.index;
+        flags.append(QVector<quint8>(it, insertionPoint));
+        flags.append(QVector<quint8>(range.count, 0));
+        it = insertionPoint;
+    }
+    flags.append(QVector<quint8>(it, m_flags.cend()));
+
+    m_flags = flags;
+    resetHints();
+}
+
+void KItemStateFlags::removeItems(const KItemRangeList& itemRanges)
+{
+    if (itemRanges.isEmpty()) {
+        return;
+    }
+
+    int previousEnd = 0;
+    for (const KItemRange& range : itemRanges) {
+        Q_ASSERT(range.index >= previousEnd && range.count >= 0 && range.index + range.count <= m_flags.count());
+        if (range.index < previousEnd || range.count < 0 || range.index + range.count > m_flags.count()) {
+            return;
+        }
+        previousEnd = range.index + range.count;
+    }
+
+    // The ranges refer to the indexes before the removal
+    int targetIndex = itemRanges.first().index;
+    int sourceIndex = targetIndex;
+    for (int r = 0; r < itemRanges.count(); ++r) {
+        const KItemRange& range = itemRanges.at(r);
+        while (sourceIndex < range.index) {
+            m_flags[targetIndex++] = m_flags.at(sourceIndex++);
+        }
+
+        for (int i = range.index; i < range.index + range.count; ++i) {
+            const quint8 flags = m_flags.at(i);
+            for (int bit = 0; flags >> bit; ++bit) {
+                if (flags & (1 << bit)) {
+                    --m_flagCounts[bit];
+                }
+            }
+        }
+        sourceIndex = range.index + range.count;
+    }
+
+    const int count = m_flags.count();
+    while (sourceIndex < count) {
+        m_flags[targetIndex++] = m_flags.at(sourceIndex++);
+    }
+    m_flags.resize(targetIndex);
+    resetHints();
+}
+
+void KItemStateFlags::moveItems(const KItemRange& itemRange, const QList<int>& movedToIndexes)
+{
+    const bool valid = itemRange.index >= 0 && itemRange.count == movedToIndexes.count()
+                       && itemRange.index + itemRange.count <= m_flags.count();
+    Q_ASSERT(valid);
+    if (!valid) {
+        return;
+    }
+
+    const QVector<quint8> movedFlags = m_flags.mid(itemRange.index, itemRange.count);
+    for (int i = 0; i < itemRange.count; ++i) {
+        Q_ASSERT(movedToIndexes.at(i) >= itemRange.index && movedToIndexes.at(i) < itemRange.index + itemRange.count);
+        m_flags[movedToIndexes.at(i)] = movedFlags.at(i);
+    }
+    resetHints();
+}
+
+void KItemStateFlags::setFlag(int index, quint8 flag, bool on)
+{
+    Q_ASSERT(index >= 0 && index < m_flags.count());
+    if (index < 0 || index >= m_flags.count()) {
+        return;
+    }
+
+    quint8& flags = m_flags[index];
+    if (bool(flags & flag) == on) {
+        return;
+    }
+
+    const int bit = bitIndex(flag);
+    if (on) {
+        flags |= flag;
+        ++m_flagCounts[bit];
+        m_firstIndexHints[bit] = qMin(m_firstIndexHints[bit], index);
+    } else {
+        flags &= ~flag;
+        --m_flagCounts[bit];
+    }
+}
+
+void KItemStateFlags::clearFlag(quint8 flag)
+{
+    const int bit = bitIndex(flag);
+    if (m_flagCounts[bit] == 0) {
+        return;
+    }
+
+    for (quint8& flags : m_flags) {
+        flags &= ~flag;
+    }
+    m_flagCounts[bit] = 0;
+    m_firstIndexHints[bit] = 0;
+}
+
+int KItemStateFlags::flagCount(quint8 flag) const
+{
+    return m_flagCounts[bitIndex(flag)];
+}
+
+int KItemStateFlags::firstIndexWithFlag(quint8 flag)
+{
+    const int bit = bitIndex(flag);
+    if (m_flagCounts[bit] == 0) {
+        return -1;
+    }
+
+    const int count = m_flags.count();
+    for (int index = m_firstIndexHints[bit]; index < count; ++index) {
+        if (m_flags.at(index) & flag) {
+            m_firstIndexHints[bit] = index;
+            return index;
+        }
+    }
+
+    Q_ASSERT(false);
+    return -1;
+}
+
+QVector<int> KItemStateFlags::indexesWithFlag(quint8 flag) const
+{
+    const int bit = bitIndex(flag);
+    QVector<int> indexes;
+    indexes.reserve(m_flagCounts[bit]);
+
+    const int count = m_flags.count();
+    for (int index = m_firstIndexHints[bit]; index < count && indexes.count() < m_flagCounts[bit]; ++index) {
+        if (m_flags.at(index) & flag) {
+            indexes.append(index);
+        }
+    }
+    return indexes;
+}
+
+int KItemStateFlags::bitIndex(quint8 flag)
+{
+    Q_ASSERT(flag != 0 && (flag & (flag - 1)) == 0);
+    return qCountTrailingZeroBits(flag);
+}
+
+void KItemStateFlags::resetHints()
+{
+    m_firstIndexHints.fill(0);
+}
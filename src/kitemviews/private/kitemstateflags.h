@@ -0,0 +1,105 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KITEMSTATEFLAGS_H
+#define KITEMSTATEFLAGS_H
+
+#include "dolphin_export.h"
+#include "kitemviews/kitemrange.h"
+
+#include <QVector>
+
+#include <array>
+
+/**
+ * @brief Stores up to eight flags for each item of a model.
+ *
+ * The flags are stored in one byte per item and are indexed by the model
+ * indexes. They follow the changes of the model if insertItems(),
+ * removeItems() and moveItems() are invoked with the ranges of the
+ * corresponding signals of KItemModelBase.
+ *
+ * Each flag must be a single bit. The number of items that have a flag
+ * is counted, and the first item that has a flag is found without
+ * checking the items again that have been checked before.
+ *
+ * Indexes and ranges outside of the items are a bug of the caller. They
+ * are asserted, and ignored in release builds: testFlag() returns false
+ * and the flags are not changed.
+ */
+class DOLPHIN_EXPORT KItemStateFlags
+{
+public:
+    explicit KItemStateFlags(int count = 0);
+
+    /**
+     * Resets the flags of all items and sets the number of items to \a count.
+     */
+    void reset(int count);
+    int count() const;
+
+    /**
+     * Inserts items without flags, see KItemModelBase::itemsInserted().
+     */
+    void insertItems(const KItemRangeList& itemRanges);
+
+    /**
+     * Removes the items, see KItemModelBase::itemsRemoved().
+     */
+    void removeItems(const KItemRangeList& itemRanges);
+
+    /**
+     * Moves the flags of the items, see KItemModelBase::itemsMoved().
+     */
+    void moveItems(const KItemRange& itemRange, const QList<int>& movedToIndexes);
+
+    bool testFlag(int index, quint8 flag) const;
+    void setFlag(int index, quint8 flag, bool on = true);
+
+    /**
+     * Resets \a flag for all items.
+     */
+    void clearFlag(quint8 flag);
+
+    /**
+     * @return Number of items that have \a flag.
+     */
+    int flagCount(quint8 flag) const;
+
+    /**
+     * @return The index of the first item that has \a flag,
+     *         or -1 if no item has the flag.
+     */
+    int firstIndexWithFlag(quint8 flag);
+
+    /**
+     * @return Indexes of the items that have \a flag in ascending order.
+     */
+    QVector<int> indexesWithFlag(quint8 flag) const;
+
+private:
+    static int bitIndex(quint8 flag);
+    void resetHints();
+
+    QVector<quint8> m_flags;
+    std::array<int, 8> m_flagCounts;
+
+    // No item before the hint has the flag
+    std::array<int, 8> m_firstIndexHints;
+};
+
+inline int KItemStateFlags::count() const
+{
+    return m_flags.count();
+}
+
+inline bool KItemStateFlags::testFlag(int index, quint8 flag) const
+{
+    Q_ASSERT(index >= 0 && index < m_flags.count());
+    return index >= 0 && index < m_flags.count() && (m_flags.at(index) & flag);
+}
+
+#endif
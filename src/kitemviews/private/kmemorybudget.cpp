@@ -0,0 +1,322 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kmemorybudget.h"
+
+#include <KIO/Global>
+
+#include <QFile>
+#include <QGuiApplication>
+#include <QPixmapCache>
+#include <QSocketNotifier>
+#include <QStringList>
+#include <QTimer>
+
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // Part of the releasable memory that is released if the system is under memory pressure
+    const qreal PressureReleaseFraction = 0.5;
+
+    // Minimum time in ms between two releases that are caused by memory pressure
+    const qint64 PressureReleaseInterval = 10 * 1000;
+
+    // Time in ms after which the budget is checked if the usage has grown.
+    // Estimating the usage walks all items of all models, so the checks of
+    // the items that are inserted while a directory is loaded are bundled.
+    const int CheckDelay = 500;
+
+#ifdef Q_OS_LINUX
+    // The memory pressure is considered as high if at least one task has been
+    // stalled for 150 ms within a window of 2 s. Unprivileged processes may
+    // only use windows that are a multiple of 2 s.
+    const char PressureTrigger[] = "some 150000 2000000";
+
+    /**
+     * @return Pressure stall information file of the cgroup of the
+     *         process, or an empty string if it is unknown.
+     */
+    QString cgroupPressureFile()
+    {
+        QFile file(QStringLiteral("/proc/self/cgroup"));
+        if (!file.open(QIODevice::ReadOnly)) {
+            return QString();
+        }
+
+        // Only the unified hierarchy of cgroup v2 provides the pressure
+        while (!file.atEnd()) {
+            const QByteArray line = file.readLine().trimmed();
+            if (line.startsWith("0::")) {
+                return QStringLiteral("/sys/fs/cgroup") + QFile::decodeName(line.mid(3)) + QStringLiteral("/memory.pressure");
+            }
+        }
+        return QString();
+    }
+#endif
+}
+
+struct KMemoryBudgetSingleton
+{
+    KMemoryBudget instance;
+};
+Q_GLOBAL_STATIC(KMemoryBudgetSingleton, s_memoryBudget)
+
+
+KMemoryBudget::Consumer::Consumer()
+{
+    s_memoryBudget->instance.addConsumer(this);
+}
+
+KMemoryBudget::Consumer::~Consumer()
+{
+    // Caches that are global statics themselves might be destroyed after the budget
+    if (!s_memoryBudget.isDestroyed()) {
+        s_memoryBudget->instance.removeConsumer(this);
+    }
+}
+
+qint64 KMemoryBudget::Consumer::releaseMemory(qint64 bytes)
+{
+    Q_UNUSED(bytes)
+    return 0;
+}
+
+qint64 KMemoryBudget::Consumer::releasableMemory() const
+{
+    return memoryUsage();
+}
+
+KMemoryBudget::Consumer::ReleaseOrder KMemoryBudget::Consumer::releaseOrder() const
+{
+    return ReleaseDefault;
+}
+
+KMemoryBudget& KMemoryBudget::instance()
+{
+    return s_memoryBudget->instance;
+}
+
+KMemoryBudget::~KMemoryBudget()
+{
+#ifdef Q_OS_LINUX
+    if (m_pressureFd >= 0) {
+        ::close(m_pressureFd);
+    }
+#endif
+}
+
+void KMemoryBudget::setBudget(qint64 bytes)
+{
+    bytes = qMax(qint64(0), bytes);
+    if (bytes != m_budget) {
+        m_budget = bytes;
+        scheduleCheck();
+    }
+}
+
+qint64 KMemoryBudget::budget() const
+{
+    return m_budget;
+}
+
+QVector<KMemoryBudget::Usage> KMemoryBudget::usage() const
+{
+    QVector<Usage> usage;
+    usage.reserve(m_consumers.count());
+    for (const Consumer* consumer : m_consumers) {
+        usage.append(Usage{consumer->memoryConsumerName(), consumer->memoryUsage()});
+    }
+
+    std::stable_sort(usage.begin(), usage.end(), [](const Usage& a, const Usage& b) {
+        return a.bytes > b.bytes;
+    });
+    return usage;
+}
+
+qint64 KMemoryBudget::totalUsage() const
+{
+    qint64 total = 0;
+    for (const Consumer* consumer : m_consumers) {
+        total += consumer->memoryUsage();
+    }
+    return total;
+}
+
+QString KMemoryBudget::report() const
+{
+    QStringList lines;
+    qint64 total = 0;
+    const QVector<Usage> entries = usage();
+    for (const Usage& entry : entries) {
+        lines.append(QStringLiteral("%1: %2").arg(entry.name, KIO::convertSize(entry.bytes)));
+        total += entry.bytes;
+    }
+
+    if (m_budget > 0) {
+        lines.append(QStringLiteral("Total: %1 of %2").arg(KIO::convertSize(total), KIO::convertSize(m_budget)));
+    } else {
+        lines.append(QStringLiteral("Total: %1").arg(KIO::convertSize(total)));
+    }
+    return lines.join(QLatin1Char('\n'));
+}
+
+void KMemoryBudget::scheduleCheck()
+{
+    if (m_budget > 0 && !m_enforcing && !m_checkTimer->isActive()) {
+        m_checkTimer->start();
+    }
+}
+
+qint64 KMemoryBudget::enforceBudget()
+{
+    if (m_budget <= 0 || m_enforcing) {
+        return 0;
+    }
+
+    const qint64 total = totalUsage();
+    if (total <= m_budget) {
+        return 0;
+    }
+
+    Q_EMIT budgetExceeded(total, m_budget);
+    return releaseFromConsumers(total - m_budget);
+}
+
+qint64 KMemoryBudget::releaseMemoryUnderPressure()
+{
+    if (m_enforcing) {
+        return 0;
+    }
+
+    Q_EMIT memoryPressure();
+
+    qint64 releasable = 0;
+    for (const Consumer* consumer : qAsConst(m_consumers)) {
+        releasable += qMax(qint64(0), consumer->releasableMemory());
+    }
+    const qint64 released = releaseFromConsumers(qint64(releasable * PressureReleaseFraction));
+
+    // The icon engines of QIcon keep their pixmaps in the global cache
+    if (qobject_cast<QGuiApplication*>(QCoreApplication::instance())) {
+        QPixmapCache::clear();
+    }
+    return released;
+}
+
+bool KMemoryBudget::startPressureMonitoring()
+{
+    if (m_pressureNotifier) {
+        return true;
+    }
+
+#ifdef Q_OS_LINUX
+    const QStringList pressureFiles = {
+        cgroupPressureFile(),
+        QStringLiteral("/proc/pressure/memory")
+    };
+
+    for (const QString& pressureFile : pressureFiles) {
+        if (pressureFile.isEmpty()) {
+            continue;
+        }
+
+        const int fd = ::open(QFile::encodeName(pressureFile).constData(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+
+        // The trigger must be written including the terminating null character
+        if (::write(fd, PressureTrigger, sizeof(PressureTrigger)) < 0) {
+            ::close(fd);
+            continue;
+        }
+
+        // The kernel signals the exceeded threshold by POLLPRI
+        m_pressureFd = fd;
+        m_pressureNotifier = new QSocketNotifier(fd, QSocketNotifier::Exception, this);
+        // Qt 5.15 has overloaded the signal with a private argument, so
+        // the pointer to member function cannot be used for all versions
+        connect(m_pressureNotifier, SIGNAL(activated(int)), this, SLOT(slotMemoryPressureReported()));
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+KMemoryBudget::KMemoryBudget() :
+    QObject(),
+    m_budget(0),
+    m_consumers(),
+    m_checkTimer(nullptr),
+    m_enforcing(false),
+    m_pressureFd(-1),
+    m_pressureNotifier(nullptr),
+    m_pressureReleaseTimer()
+{
+    m_checkTimer = new QTimer(this);
+    m_checkTimer->setSingleShot(true);
+    m_checkTimer->setInterval(CheckDelay);
+    connect(m_checkTimer, &QTimer::timeout, this, &KMemoryBudget::enforceBudget);
+}
+
+void KMemoryBudget::slotMemoryPressureReported()
+{
+    if (m_pressureReleaseTimer.isValid() && m_pressureReleaseTimer.elapsed() < PressureReleaseInterval) {
+        return;
+    }
+    m_pressureReleaseTimer.start();
+    releaseMemoryUnderPressure();
+}
+
+void KMemoryBudget::addConsumer(Consumer* consumer)
+{
+    m_consumers.append(consumer);
+}
+
+void KMemoryBudget::removeConsumer(Consumer* consumer)
+{
+    m_consumers.removeOne(consumer);
+}
+
+qint64 KMemoryBudget::releaseFromConsumers(qint64 bytes)
+{
+    struct Candidate {
+        Consumer::ReleaseOrder order;
+        qint64 usage;
+        Consumer* consumer;
+    };
+
+    QVector<Candidate> candidates;
+    candidates.reserve(m_consumers.count());
+    for (Consumer* consumer : qAsConst(m_consumers)) {
+        candidates.append(Candidate{consumer->releaseOrder(), consumer->memoryUsage(), consumer});
+    }
+    std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.order < b.order || (a.order == b.order && a.usage > b.usage);
+    });
+
+    // Consumers might remove themselves or invoke scheduleCheck() while releasing memory
+    m_enforcing = true;
+
+    qint64 released = 0;
+    for (const Candidate& candidate : qAsConst(candidates)) {
+        if (released >= bytes) {
+            break;
+        }
+        if (m_consumers.contains(candidate.consumer)) {
+            released += qMax(qint64(0), candidate.consumer->releaseMemory(bytes - released));
+        }
+    }
+
+    m_enforcing = false;
+    return released;
+}
@@ -0,0 +1,211 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KMEMORYBUDGET_H
+#define KMEMORYBUDGET_H
+
+#include "dolphin_export.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+class QSocketNotifier;
+class QTimer;
+
+/**
+ * @brief Accounts the memory used by the models, views and caches.
+ *
+ * Each KFileItemModel, KFileItemModelRolesUpdater, widget pool and pixmap
+ * cache is a consumer that estimates the number of bytes it uses. The
+ * estimates are no exact measurements, but they are good enough to see
+ * which part of the process grows, e.g. by the debug overlay of the status
+ * bar or by the D-Bus method DolphinMainWindow::memoryUsageReport().
+ *
+ * Optionally the consumers share a global budget. If the estimated usage of
+ * all consumers exceeds it, the consumers that are caches are asked to
+ * release memory by KMemoryBudget::Consumer::releaseMemory(). The consumers
+ * are asked in the order given by Consumer::releaseOrder(), and consumers of
+ * the same order starting with the one that uses most memory. Memory that
+ * is required to show the items, like the items of a model, is never released.
+ *
+ * Independent from the budget, memory is released if the system is under
+ * memory pressure, see startPressureMonitoring().
+ *
+ * The budget may only be used by the main thread.
+ */
+class DOLPHIN_EXPORT KMemoryBudget : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Base class of the objects whose memory is accounted.
+     *
+     * Consumers are registered as long as they exist.
+     */
+    class DOLPHIN_EXPORT Consumer
+    {
+    public:
+        enum ReleaseOrder {
+            ReleaseFirst,   // Caches that are cheap to fill again, like pools of widgets
+            ReleaseDefault,
+            ReleaseLast     // Caches of results that are expensive to determine, like previews
+        };
+
+        Consumer();
+        virtual ~Consumer();
+
+        /**
+         * @return Name of the consumer for the usage report,
+         *         e.g. the URL of the directory of a model.
+         */
+        virtual QString memoryConsumerName() const = 0;
+
+        /**
+         * @return Estimated number of bytes used by the consumer.
+         */
+        virtual qint64 memoryUsage() const = 0;
+
+        /**
+         * Is invoked if the budget has been exceeded. Caches should
+         * release at least \a bytes bytes if possible.
+         * @return Number of bytes that have been released. Per default
+         *         nothing is released.
+         */
+        virtual qint64 releaseMemory(qint64 bytes);
+
+        /**
+         * @return Estimated number of bytes that releaseMemory() could
+         *         release. Per default the whole usage is returned, so
+         *         consumers that keep memory they cannot release must
+         *         reimplement it.
+         */
+        virtual qint64 releasableMemory() const;
+
+        /**
+         * @return Order in which the memory of the consumer is released
+         *         compared to the other consumers. Per default
+         *         ReleaseDefault is returned.
+         */
+        virtual ReleaseOrder releaseOrder() const;
+
+    private:
+        Q_DISABLE_COPY(Consumer)
+    };
+
+    struct Usage
+    {
+        QString name;
+        qint64 bytes;
+    };
+
+    static KMemoryBudget& instance();
+    ~KMemoryBudget() override;
+
+    /**
+     * Sets the maximum number of bytes that all consumers may use
+     * together. 0 means that the usage is not limited, which is the default.
+     */
+    void setBudget(qint64 bytes);
+    qint64 budget() const;
+
+    /**
+     * @return Estimated usage of each consumer, sorted by descending usage.
+     */
+    QVector<Usage> usage() const;
+
+    /**
+     * @return Estimated usage of all consumers in bytes.
+     */
+    qint64 totalUsage() const;
+
+    /**
+     * @return Human readable report of the usage of all consumers.
+     */
+    QString report() const;
+
+    /**
+     * Checks the budget after a delay of 500 ms. Is invoked by consumers
+     * whose usage has grown. The invocations within the delay are bundled,
+     * so that the usage is only estimated once for them. Further
+     * invocations don't postpone the check.
+     */
+    void scheduleCheck();
+
+    /**
+     * Asks the consumers to release memory until the usage does not exceed
+     * the budget anymore. The signal budgetExceeded() is emitted before.
+     * @return Number of bytes that have been released.
+     */
+    qint64 enforceBudget();
+
+    /**
+     * Starts listening for memory pressure of the system, which is
+     * reported by the pressure stall information of Linux. The pressure of
+     * the cgroup of the process is preferred over the pressure of the whole
+     * system. If the memory pressure is high, releaseMemoryUnderPressure()
+     * is invoked, but at most once within 10 seconds.
+     * @return True if the memory pressure is monitored.
+     */
+    bool startPressureMonitoring();
+
+public Q_SLOTS:
+    /**
+     * Asks the consumers to release half of the memory they could release,
+     * e.g. because the system is under memory pressure. Additionally the
+     * global QPixmapCache is cleared. The signal memoryPressure() is
+     * emitted before.
+     * @return Number of bytes that have been released by the consumers.
+     */
+    qint64 releaseMemoryUnderPressure();
+
+Q_SIGNALS:
+    /**
+     * Is emitted if the estimated usage \a usage exceeds the budget \a budget.
+     */
+    void budgetExceeded(qint64 usage, qint64 budget);
+
+    /**
+     * Is emitted if the memory is released because of memory pressure.
+     */
+    void memoryPressure();
+
+protected:
+    KMemoryBudget();
+
+private Q_SLOTS:
+    /**
+     * Is invoked if the kernel reports a high memory pressure. The memory
+     * is released at most once per interval, as the pressure usually stays
+     * high for a while after the release.
+     */
+    void slotMemoryPressureReported();
+
+private:
+    void addConsumer(Consumer* consumer);
+    void removeConsumer(Consumer* consumer);
+
+    /**
+     * Asks the consumers in the release order to release
+     * memory until \a bytes bytes have been released.
+     */
+    qint64 releaseFromConsumers(qint64 bytes);
+
+private:
+    qint64 m_budget;
+    QVector<Consumer*> m_consumers;
+    QTimer* m_checkTimer;
+    bool m_enforcing;
+    int m_pressureFd;
+    QSocketNotifier* m_pressureNotifier;
+    QElapsedTimer m_pressureReleaseTimer;
+
+    friend struct KMemoryBudgetSingleton;
+};
+
+#endif
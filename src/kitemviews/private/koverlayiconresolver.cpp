@@ -0,0 +1,174 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "koverlayiconresolver.h"
+
+#include "kpluginregistry.h"
+
+#include <KOverlayIconPlugin>
+#include <KPluginLoader>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTimer>
+
+namespace {
+    // Duration of a slice in which the plugins are asked for overlays. The
+    // results of each slice are announced at once and the event loop runs
+    // between the slices, so that scrolling stays smooth.
+    const int TimeSlice = 8;
+
+    // Maximum number of cached results. All results are discarded if it
+    // is exceeded, which only happens when browsing through many folders.
+    const int MaximumEntries = 20000;
+}
+
+struct KOverlayIconResolverSingleton
+{
+    KOverlayIconResolver instance;
+};
+Q_GLOBAL_STATIC(KOverlayIconResolverSingleton, s_overlayIconResolver)
+
+
+KOverlayIconResolver& KOverlayIconResolver::instance()
+{
+    return s_overlayIconResolver->instance;
+}
+
+KOverlayIconResolver::~KOverlayIconResolver()
+{
+}
+
+bool KOverlayIconResolver::hasPlugins() const
+{
+    return !m_plugins.isEmpty();
+}
+
+bool KOverlayIconResolver::cachedOverlays(const QUrl& url, QStringList& overlays) const
+{
+    const auto it = m_cache.constFind(url);
+    if (it == m_cache.constEnd()) {
+        return false;
+    }
+
+    overlays = it.value();
+    return true;
+}
+
+void KOverlayIconResolver::requestOverlays(const QList<QUrl>& urls)
+{
+    if (m_plugins.isEmpty()) {
+        return;
+    }
+
+    m_pendingUrls.append(urls);
+    if (!m_sliceTimer->isActive()) {
+        m_sliceTimer->start();
+    }
+}
+
+void KOverlayIconResolver::invalidate(const QList<QUrl>& urls)
+{
+    for (const QUrl& url : urls) {
+        m_cache.remove(url);
+    }
+}
+
+KOverlayIconResolver::KOverlayIconResolver() :
+    QObject(),
+    m_plugins(),
+    m_cache(),
+    m_pendingUrls(),
+    m_sliceTimer(nullptr)
+{
+    // The plugins are discovered only once for all views
+    const QVector<KPluginMetaData> pluginsMetaData = KPluginRegistry::instance().overlayIconPlugins();
+    for (const KPluginMetaData& metaData : pluginsMetaData) {
+        KPluginLoader loader(metaData.fileName());
+        QObject* it = loader.instance();
+        if (!it) {
+            continue;
+        }
+        it->setParent(qApp);
+
+        auto plugin = qobject_cast<KOverlayIconPlugin*>(it);
+        if (plugin) {
+            m_plugins.append(plugin);
+        } else {
+            // not our/valid plugin, so delete the created object
+            it->deleteLater();
+        }
+    }
+
+    connectPlugins();
+}
+
+KOverlayIconResolver::KOverlayIconResolver(const QList<KOverlayIconPlugin*>& plugins) :
+    QObject(),
+    m_plugins(plugins),
+    m_cache(),
+    m_pendingUrls(),
+    m_sliceTimer(nullptr)
+{
+    connectPlugins();
+}
+
+void KOverlayIconResolver::resolvePendingOverlays()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QHash<QUrl, QStringList> overlays;
+    while (!m_pendingUrls.isEmpty() && timer.elapsed() < TimeSlice) {
+        const QUrl url = m_pendingUrls.takeFirst();
+        // Duplicates and URLs that have been determined
+        // by a previous slice are skipped
+        if (m_cache.contains(url) || overlays.contains(url)) {
+            continue;
+        }
+
+        QStringList urlOverlays;
+        for (KOverlayIconPlugin* plugin : qAsConst(m_plugins)) {
+            urlOverlays.append(plugin->getOverlays(url));
+        }
+        overlays.insert(url, urlOverlays);
+    }
+
+    if (m_cache.count() + overlays.count() > MaximumEntries) {
+        m_cache.clear();
+    }
+    for (auto it = overlays.constBegin(); it != overlays.constEnd(); ++it) {
+        m_cache.insert(it.key(), it.value());
+    }
+
+    if (!m_pendingUrls.isEmpty()) {
+        m_sliceTimer->start();
+    }
+
+    if (!overlays.isEmpty()) {
+        Q_EMIT overlaysResolved(overlays);
+    }
+}
+
+void KOverlayIconResolver::slotOverlaysChanged(const QUrl& url)
+{
+    // The passed overlays only belong to the emitting plugin,
+    // so the overlays of all plugins are determined again
+    m_cache.remove(url);
+    requestOverlays({url});
+}
+
+void KOverlayIconResolver::connectPlugins()
+{
+    for (KOverlayIconPlugin* plugin : qAsConst(m_plugins)) {
+        connect(plugin, &KOverlayIconPlugin::overlaysChanged, this, &KOverlayIconResolver::slotOverlaysChanged);
+    }
+
+    m_sliceTimer = new QTimer(this);
+    m_sliceTimer->setInterval(0);
+    m_sliceTimer->setSingleShot(true);
+    connect(m_sliceTimer, &QTimer::timeout, this, &KOverlayIconResolver::resolvePendingOverlays);
+}
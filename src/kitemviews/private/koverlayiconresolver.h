@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KOVERLAYICONRESOLVER_H
+#define KOVERLAYICONRESOLVER_H
+
+#include "dolphin_export.h"
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QStringList>
+#include <QUrl>
+
+class KOverlayIconPlugin;
+class QTimer;
+
+/**
+ * @brief Determines the overlays of the overlay icon plugins for all views.
+ *
+ * Plugins like the overlays of sync clients might communicate with another
+ * process for each file, so asking them for all items at once would block
+ * scrolling. Instead the overlays of the requested URLs are determined in
+ * slices of a few milliseconds, see requestOverlays(), and are announced
+ * by overlaysResolved(). The plugins are QObjects that are not required to
+ * be thread-safe, so they are only invoked by the main thread.
+ *
+ * The results are cached per URL, so that the plugins are asked only once
+ * for each file until they report a change by
+ * KOverlayIconPlugin::overlaysChanged() or until the item has been changed,
+ * see invalidate(). The resolver may only be used by the main thread.
+ */
+class DOLPHIN_EXPORT KOverlayIconResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+    static KOverlayIconResolver& instance();
+    ~KOverlayIconResolver() override;
+
+    /**
+     * @return True if any overlay icon plugin is installed. If not,
+     *         no overlays need to be requested at all.
+     */
+    bool hasPlugins() const;
+
+    /**
+     * @return True if the overlays of the plugins for \a url are cached,
+     *         which are stored in \a overlays.
+     */
+    bool cachedOverlays(const QUrl& url, QStringList& overlays) const;
+
+    /**
+     * Requests the overlays of the plugins for \a urls. The URLs of all
+     * requests within one event loop iteration are processed as one batch.
+     * The result is announced by overlaysResolved().
+     */
+    void requestOverlays(const QList<QUrl>& urls);
+
+    /**
+     * Discards the cached overlays of \a urls, e.g. because the items
+     * have been changed. The overlays are determined again when they are
+     * requested the next time.
+     */
+    void invalidate(const QList<QUrl>& urls);
+
+Q_SIGNALS:
+    /**
+     * Is emitted if the overlays of the plugins have been determined for
+     * the URLs that are the keys of \a overlays, either because they have
+     * been requested or because a plugin has reported a change.
+     */
+    void overlaysResolved(const QHash<QUrl, QStringList>& overlays);
+
+protected:
+    KOverlayIconResolver();
+
+    /**
+     * Creates a resolver that uses \a plugins instead of the installed
+     * plugins. Is used by tests.
+     */
+    explicit KOverlayIconResolver(const QList<KOverlayIconPlugin*>& plugins);
+
+private Q_SLOTS:
+    /**
+     * Determines the overlays of the pending URLs until the time slice has
+     * been used up, the remaining URLs are processed by the next slice.
+     */
+    void resolvePendingOverlays();
+
+    void slotOverlaysChanged(const QUrl& url);
+
+private:
+    void connectPlugins();
+
+private:
+    QList<KOverlayIconPlugin*> m_plugins;
+    QHash<QUrl, QStringList> m_cache;
+
+    // URLs whose overlays have been requested but not been determined yet
+    QList<QUrl> m_pendingUrls;
+
+    QTimer* m_sliceTimer;
+
+    friend struct KOverlayIconResolverSingleton;
+};
+
+#endif
@@ -15,9 +15,12 @@
 
 #include "kpixmapmodifier.h"
 
+#include <QCache>
 #include <QGuiApplication>
 #include <QImage>
+#include <QMutex>
 #include <QPainter>
+#include <QPixmap>
 
 static const quint32 stackBlur8Mul[255] =
 {
@@ -259,43 +262,118 @@ namespace {
 
             shadowBlur(image, 3, Qt::black);
 
-            QPixmap pixmap = QPixmap::fromImage(image);
-            m_tiles[TopLeftCorner]     = pixmap.copy(0, 0, 8, 8);
-            m_tiles[TopSide]           = pixmap.copy(8, 0, 8, 8);
-            m_tiles[TopRightCorner]    = pixmap.copy(16, 0, 8, 8);
-            m_tiles[LeftSide]          = pixmap.copy(0, 8, 8, 8);
-            m_tiles[RightSide]         = pixmap.copy(16, 8, 8, 8);
-            m_tiles[BottomLeftCorner]  = pixmap.copy(0, 16, 8, 8);
-            m_tiles[BottomSide]        = pixmap.copy(8, 16, 8, 8);
-            m_tiles[BottomRightCorner] = pixmap.copy(16, 16, 8, 8);
+            // The tiles are kept as images, so that frames can also be
+            // painted outside the GUI thread.
+            m_tiles[TopLeftCorner]     = image.copy(0, 0, 8, 8);
+            m_tiles[TopSide]           = image.copy(8, 0, 8, 8);
+            m_tiles[TopRightCorner]    = image.copy(16, 0, 8, 8);
+            m_tiles[LeftSide]          = image.copy(0, 8, 8, 8);
+            m_tiles[RightSide]         = image.copy(16, 8, 8, 8);
+            m_tiles[BottomLeftCorner]  = image.copy(0, 16, 8, 8);
+            m_tiles[BottomSide]        = image.copy(8, 16, 8, 8);
+            m_tiles[BottomRightCorner] = image.copy(16, 16, 8, 8);
         }
 
         void paint(QPainter* p, const QRect& r)
         {
-            p->drawPixmap(r.topLeft(), m_tiles[TopLeftCorner]);
+            p->drawImage(r.topLeft(), m_tiles[TopLeftCorner]);
             if (r.width() - 16 > 0) {
-                p->drawTiledPixmap(r.x() + 8, r.y(), r.width() - 16, 8, m_tiles[TopSide]);
+                drawTiledImage(p, QRect(r.x() + 8, r.y(), r.width() - 16, 8), m_tiles[TopSide]);
             }
-            p->drawPixmap(r.right() - 8 + 1, r.y(), m_tiles[TopRightCorner]);
+            p->drawImage(QPoint(r.right() - 8 + 1, r.y()), m_tiles[TopRightCorner]);
             if (r.height() - 16 > 0) {
-                p->drawTiledPixmap(r.x(), r.y() + 8, 8, r.height() - 16,  m_tiles[LeftSide]);
-                p->drawTiledPixmap(r.right() - 8 + 1, r.y() + 8, 8, r.height() - 16, m_tiles[RightSide]);
+                drawTiledImage(p, QRect(r.x(), r.y() + 8, 8, r.height() - 16),  m_tiles[LeftSide]);
+                drawTiledImage(p, QRect(r.right() - 8 + 1, r.y() + 8, 8, r.height() - 16), m_tiles[RightSide]);
             }
-            p->drawPixmap(r.x(), r.bottom() - 8 + 1, m_tiles[BottomLeftCorner]);
+            p->drawImage(QPoint(r.x(), r.bottom() - 8 + 1), m_tiles[BottomLeftCorner]);
             if (r.width() - 16 > 0) {
-                p->drawTiledPixmap(r.x() + 8, r.bottom() - 8 + 1, r.width() - 16, 8, m_tiles[BottomSide]);
+                drawTiledImage(p, QRect(r.x() + 8, r.bottom() - 8 + 1, r.width() - 16, 8), m_tiles[BottomSide]);
             }
-            p->drawPixmap(r.right() - 8 + 1, r.bottom() - 8 + 1, m_tiles[BottomRightCorner]);
+            p->drawImage(QPoint(r.right() - 8 + 1, r.bottom() - 8 + 1), m_tiles[BottomRightCorner]);
 
             const QRect contentRect = r.adjusted(LeftMargin + 1, TopMargin + 1,
                                                  -(RightMargin + 1), -(BottomMargin + 1));
             p->fillRect(contentRect, Qt::transparent);
         }
 
-        QPixmap m_tiles[NumTiles];
+        QImage m_tiles[NumTiles];
+
+    private:
+        static void drawTiledImage(QPainter* p, const QRect& r, const QImage& tile)
+        {
+            for (int y = r.y(); y <= r.bottom(); y += tile.height()) {
+                for (int x = r.x(); x <= r.right(); x += tile.width()) {
+                    const QRect source(0, 0, qMin(tile.width(), r.right() - x + 1), qMin(tile.height(), r.bottom() - y + 1));
+                    p->drawImage(QPoint(x, y), tile, source);
+                }
+            }
+        }
+    };
+
+    // Maximum size in KiB of the frames that are cached. Previews of the
+    // same size share their frame, and most previews of a directory only
+    // have a few different sizes.
+    const int MaximumFrameCacheCost = 8 * 1024;
+
+    struct FrameKey
+    {
+        QSize size; // In device pixels
+        qreal dpr;
+
+        bool operator==(const FrameKey& other) const
+        {
+            return size == other.size && dpr == other.dpr;
+        }
+    };
+
+    uint qHash(const FrameKey& key, uint seed = 0)
+    {
+        return ::qHash(qMakePair(key.size.width(), key.size.height()), seed) ^ ::qHash(key.dpr, seed);
+    }
+
+    struct FrameCache
+    {
+        TileSet tileSet;
+        QCache<FrameKey, QImage> frames{MaximumFrameCacheCost};
+        QMutex mutex;
     };
 }
 
+// Frames are applied in the GUI thread and in worker threads
+Q_GLOBAL_STATIC(FrameCache, s_frameCache)
+
+/**
+ * @return Transparent image with \a size device pixels that contains the
+ *         shadow frame. Painting the frame tile by tile requires many
+ *         drawing operations for large previews, so the frames of the
+ *         recently used sizes are cached and applying a frame becomes
+ *         a single copy.
+ */
+static QImage frameImage(const QSize& size, qreal dpr)
+{
+    FrameCache* cache = s_frameCache();
+    const FrameKey key{size, dpr};
+
+    QMutexLocker locker(&cache->mutex);
+    if (const QImage* frame = cache->frames.object(key)) {
+        return *frame;
+    }
+    locker.unlock();
+
+    QImage frame(size, QImage::Format_ARGB32_Premultiplied);
+    frame.setDevicePixelRatio(dpr);
+    frame.fill(Qt::transparent);
+
+    QPainter painter(&frame);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    cache->tileSet.paint(&painter, QRect(QPoint(0, 0), size / dpr));
+    painter.end();
+
+    locker.relock();
+    cache->frames.insert(key, new QImage(frame), qMax(1, int(frame.sizeInBytes() / 1024)));
+    return frame;
+}
+
 void KPixmapModifier::scale(QPixmap& pixmap, const QSize& scaledSize)
 {
     if (scaledSize.isEmpty() || pixmap.isNull()) {
@@ -315,7 +393,6 @@ void KPixmapModifier::applyFrame(QPixmap& icon, const QSize& scaledSize)
         return;
     }
 
-    static TileSet tileSet;
     qreal dpr = qApp->devicePixelRatio();
 
     // Resize the icon to the maximum size minus the space required for the frame
@@ -324,21 +401,54 @@ void KPixmapModifier::applyFrame(QPixmap& icon, const QSize& scaledSize)
     scale(icon, size * dpr);
     icon.setDevicePixelRatio(dpr);
 
-    QPixmap framedIcon(icon.size().width() + (TileSet::LeftMargin + TileSet::RightMargin) * dpr,
-                       icon.size().height() + (TileSet::TopMargin + TileSet::BottomMargin) * dpr);
-    framedIcon.setDevicePixelRatio(dpr);
-    framedIcon.fill(Qt::transparent);
+    const QSize framedSize(icon.size().width() + (TileSet::LeftMargin + TileSet::RightMargin) * dpr,
+                           icon.size().height() + (TileSet::TopMargin + TileSet::BottomMargin) * dpr);
+    QPixmap framedIcon = QPixmap::fromImage(frameImage(framedSize, dpr));
 
     QPainter painter;
     painter.begin(&framedIcon);
-    painter.setCompositionMode(QPainter::CompositionMode_Source);
-    tileSet.paint(&painter, QRect(QPoint(0,0), framedIcon.size() / dpr));
-    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
     painter.drawPixmap(TileSet::LeftMargin, TileSet::TopMargin, icon);
 
     icon = framedIcon;
 }
 
+void KPixmapModifier::scale(QImage& image, const QSize& scaledSize)
+{
+    if (scaledSize.isEmpty() || image.isNull()) {
+        image = QImage();
+        return;
+    }
+    qreal dpr = image.devicePixelRatio();
+    image = image.scaled(scaledSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    image.setDevicePixelRatio(dpr);
+}
+
+void KPixmapModifier::applyFrame(QImage& icon, const QSize& scaledSize, qreal dpr)
+{
+    if (icon.isNull()) {
+        icon = QImage(scaledSize, QImage::Format_ARGB32_Premultiplied);
+        icon.fill(Qt::transparent);
+        return;
+    }
+
+    // Resize the icon to the maximum size minus the space required for the frame
+    const QSize size(scaledSize.width() - TileSet::LeftMargin - TileSet::RightMargin,
+                     scaledSize.height() - TileSet::TopMargin - TileSet::BottomMargin);
+    scale(icon, size * dpr);
+    icon.setDevicePixelRatio(dpr);
+
+    const QSize framedSize(icon.size().width() + (TileSet::LeftMargin + TileSet::RightMargin) * dpr,
+                           icon.size().height() + (TileSet::TopMargin + TileSet::BottomMargin) * dpr);
+    QImage framedIcon = frameImage(framedSize, dpr);
+
+    QPainter painter;
+    painter.begin(&framedIcon);
+    painter.drawImage(TileSet::LeftMargin, TileSet::TopMargin, icon);
+    painter.end();
+
+    icon = framedIcon;
+}
+
 QSize KPixmapModifier::sizeInsideFrame(const QSize& frameSize)
 {
     return QSize(frameSize.width() - TileSet::LeftMargin - TileSet::RightMargin,
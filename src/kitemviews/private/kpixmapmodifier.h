@@ -9,6 +9,9 @@
 
 #include "dolphin_export.h"
 
+#include <QtGlobal>
+
+class QImage;
 class QPixmap;
 class QSize;
 
@@ -29,6 +32,15 @@ public:
      */
     static void applyFrame(QPixmap& icon, const QSize& scaledSize);
 
+    /**
+     * Variants of scale() and applyFrame() that operate on images. In
+     * opposite to the pixmap variants, they may be used outside the GUI thread.
+     * @arg dpr is the device pixel ratio of the resulting image, which is
+     *      the application devicePixelRatio for the pixmap variant
+     */
+    static void scale(QImage& image, const QSize& scaledSize);
+    static void applyFrame(QImage& icon, const QSize& scaledSize, qreal dpr);
+
     /**
      * return and paint a frame round an icon
      * @arg framesize is in device-independent pixels
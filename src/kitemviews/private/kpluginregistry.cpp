@@ -0,0 +1,265 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kpluginregistry.h"
+#include "ktaskscheduler.h"
+
+#include <KIO/PreviewJob>
+#include <KPluginLoader>
+#include <KServiceTypeTrader>
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+    // Is increased if the format of the index is changed
+    const int IndexVersion = 2;
+
+    const QString OverlayIconDirectory = QStringLiteral("kf5/overlayicon");
+    const QString FileItemActionDirectory = QStringLiteral("kf5/kfileitemaction");
+}
+
+struct KPluginRegistrySingleton
+{
+    KPluginRegistry instance;
+};
+Q_GLOBAL_STATIC(KPluginRegistrySingleton, s_pluginRegistry)
+
+
+KPluginRegistry& KPluginRegistry::instance()
+{
+    return s_pluginRegistry->instance;
+}
+
+KPluginRegistry::~KPluginRegistry()
+{
+    // The worker threads may still access the library paths
+    m_previewPlugins.waitForFinished();
+    m_versionControlPlugins.waitForFinished();
+    m_jsonPlugins.waitForFinished();
+}
+
+void KPluginRegistry::startDiscovery()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_started) {
+        return;
+    }
+    m_started = true;
+
+    KTaskScheduler& scheduler = KTaskScheduler::instance();
+    m_previewPlugins = scheduler.run(KTaskScheduler::Visible, &KPluginRegistry::discoverPreviewPlugins);
+    m_versionControlPlugins = scheduler.run(KTaskScheduler::Visible, &KPluginRegistry::discoverVersionControlPlugins);
+    m_jsonPlugins = scheduler.run(KTaskScheduler::Visible, &KPluginRegistry::discoverJsonPlugins,
+                                  QStringList({OverlayIconDirectory, FileItemActionDirectory}),
+                                  indexFilePath());
+}
+
+QStringList KPluginRegistry::defaultPreviewPlugins()
+{
+    startDiscovery();
+    QMutexLocker locker(&m_mutex);
+    return m_previewPlugins.result().defaultPreviewPlugins;
+}
+
+KService::List KPluginRegistry::thumbCreators()
+{
+    startDiscovery();
+    QMutexLocker locker(&m_mutex);
+    return m_previewPlugins.result().thumbCreators;
+}
+
+KService::List KPluginRegistry::versionControlPlugins()
+{
+    startDiscovery();
+    QMutexLocker locker(&m_mutex);
+    return m_versionControlPlugins.result();
+}
+
+QVector<KPluginMetaData> KPluginRegistry::overlayIconPlugins()
+{
+    startDiscovery();
+    QMutexLocker locker(&m_mutex);
+    return m_jsonPlugins.result().value(OverlayIconDirectory);
+}
+
+QVector<KPluginMetaData> KPluginRegistry::fileItemActionPlugins()
+{
+    startDiscovery();
+    QMutexLocker locker(&m_mutex);
+    return m_jsonPlugins.result().value(FileItemActionDirectory);
+}
+
+QString KPluginRegistry::indexFilePath() const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1String("/pluginindex.json");
+}
+
+void KPluginRegistry::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_previewPlugins.waitForFinished();
+    m_versionControlPlugins.waitForFinished();
+    m_jsonPlugins.waitForFinished();
+    m_previewPlugins = QFuture<ServiceDiscovery>();
+    m_versionControlPlugins = QFuture<KService::List>();
+    m_jsonPlugins = QFuture<JsonPlugins>();
+    m_started = false;
+}
+
+KPluginRegistry::KPluginRegistry() :
+    m_mutex(),
+    m_started(false),
+    m_previewPlugins(),
+    m_versionControlPlugins(),
+    m_jsonPlugins()
+{
+}
+
+KPluginRegistry::ServiceDiscovery KPluginRegistry::discoverPreviewPlugins()
+{
+    // KSycoca uses an own instance per thread, so the services
+    // may be queried by the worker thread
+    ServiceDiscovery discovery;
+    discovery.thumbCreators = KServiceTypeTrader::self()->query(QStringLiteral("ThumbCreator"));
+    discovery.defaultPreviewPlugins = KIO::PreviewJob::defaultPlugins();
+    return discovery;
+}
+
+KService::List KPluginRegistry::discoverVersionControlPlugins()
+{
+    return KServiceTypeTrader::self()->query(QStringLiteral("FileViewVersionControlPlugin"));
+}
+
+KPluginRegistry::JsonPlugins KPluginRegistry::discoverJsonPlugins(const QStringList& directories, const QString& indexFilePath)
+{
+    JsonPlugins plugins;
+    if (readIndex(indexFilePath, directories, plugins)) {
+        return plugins;
+    }
+
+    plugins.clear();
+    for (const QString& directory : directories) {
+        plugins.insert(directory, KPluginLoader::findPlugins(directory));
+    }
+    writeIndex(indexFilePath, directories, plugins);
+    return plugins;
+}
+
+QHash<QString, qint64> KPluginRegistry::directoryModificationTimes(const QString& directory)
+{
+    QHash<QString, qint64> modificationTimes;
+    const QStringList libraryPaths = QCoreApplication::libraryPaths();
+    for (const QString& libraryPath : libraryPaths) {
+        const QFileInfo info(libraryPath + QLatin1Char('/') + directory);
+        if (info.isDir()) {
+            modificationTimes.insert(info.absoluteFilePath(), info.lastModified().toMSecsSinceEpoch());
+        }
+    }
+    return modificationTimes;
+}
+
+bool KPluginRegistry::isIndexEntryValid(const QString& fileName, const QJsonObject& entry)
+{
+    // Updating a plugin in place does not change the modification
+    // time of its directory
+    const QFileInfo info(fileName);
+    return info.exists()
+        && qint64(entry.value(QLatin1String("size")).toDouble()) == info.size()
+        && qint64(entry.value(QLatin1String("modificationTime")).toDouble()) == info.lastModified().toMSecsSinceEpoch();
+}
+
+bool KPluginRegistry::readIndex(const QString& indexFilePath, const QStringList& directories, JsonPlugins& plugins)
+{
+    QFile file(indexFilePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const QJsonObject index = QJsonDocument::fromJson(file.readAll()).object();
+    if (index.value(QLatin1String("version")).toInt() != IndexVersion) {
+        return false;
+    }
+
+    const QJsonObject storedDirectories = index.value(QLatin1String("directories")).toObject();
+    const QJsonObject storedPlugins = index.value(QLatin1String("plugins")).toObject();
+    for (const QString& directory : directories) {
+        // The index is outdated if a plugin directory has been
+        // created, removed or modified
+        const QHash<QString, qint64> modificationTimes = directoryModificationTimes(directory);
+        const QJsonObject storedTimes = storedDirectories.value(directory).toObject();
+        if (!storedDirectories.contains(directory) || storedTimes.count() != modificationTimes.count()) {
+            return false;
+        }
+        for (auto it = modificationTimes.constBegin(); it != modificationTimes.constEnd(); ++it) {
+            if (!storedTimes.contains(it.key()) || qint64(storedTimes.value(it.key()).toDouble()) != it.value()) {
+                return false;
+            }
+        }
+
+        QVector<KPluginMetaData> metaDataList;
+        const QJsonArray entries = storedPlugins.value(directory).toArray();
+        for (const QJsonValue& entry : entries) {
+            const QJsonObject object = entry.toObject();
+            const QString fileName = object.value(QLatin1String("fileName")).toString();
+            if (!isIndexEntryValid(fileName, object)) {
+                return false;
+            }
+            metaDataList.append(KPluginMetaData(object.value(QLatin1String("metaData")).toObject(), fileName));
+        }
+        plugins.insert(directory, metaDataList);
+    }
+
+    return true;
+}
+
+void KPluginRegistry::writeIndex(const QString& indexFilePath, const QStringList& directories, const JsonPlugins& plugins)
+{
+    QJsonObject storedDirectories;
+    QJsonObject storedPlugins;
+    for (const QString& directory : directories) {
+        QJsonObject storedTimes;
+        const QHash<QString, qint64> modificationTimes = directoryModificationTimes(directory);
+        for (auto it = modificationTimes.constBegin(); it != modificationTimes.constEnd(); ++it) {
+            storedTimes.insert(it.key(), double(it.value()));
+        }
+        storedDirectories.insert(directory, storedTimes);
+
+        QJsonArray entries;
+        const QVector<KPluginMetaData> metaDataList = plugins.value(directory);
+        for (const KPluginMetaData& metaData : metaDataList) {
+            const QFileInfo info(metaData.fileName());
+            QJsonObject entry;
+            entry.insert(QLatin1String("fileName"), metaData.fileName());
+            entry.insert(QLatin1String("size"), double(info.size()));
+            entry.insert(QLatin1String("modificationTime"), double(info.lastModified().toMSecsSinceEpoch()));
+            entry.insert(QLatin1String("metaData"), metaData.rawData());
+            entries.append(entry);
+        }
+        storedPlugins.insert(directory, entries);
+    }
+
+    QJsonObject index;
+    index.insert(QLatin1String("version"), IndexVersion);
+    index.insert(QLatin1String("directories"), storedDirectories);
+    index.insert(QLatin1String("plugins"), storedPlugins);
+
+    QDir().mkpath(QFileInfo(indexFilePath).absolutePath());
+    QSaveFile file(indexFilePath);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(index).toJson(QJsonDocument::Compact));
+        file.commit();
+    }
+}
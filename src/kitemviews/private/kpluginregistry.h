@@ -0,0 +1,144 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KPLUGINREGISTRY_H
+#define KPLUGINREGISTRY_H
+
+#include "dolphin_export.h"
+
+#include <KPluginMetaData>
+#include <KService>
+
+#include <QFuture>
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+
+class QJsonObject;
+
+/**
+ * @brief Discovers the plugins that are used by Dolphin once per process.
+ *
+ * Each view needs the overlay icon plugins and the default preview plugins,
+ * each version control observer needs the version control plugins, and the
+ * settings list the thumbnailers and the context menu plugins. Discovering
+ * them scans the plugin metadata synchronously, so instead of doing this
+ * for each view on the GUI thread, all categories are discovered once and
+ * in parallel by worker threads, see startDiscovery(). The accessors only
+ * block if the discovery of their category has not been finished yet.
+ *
+ * The metadata of the JSON plugins is stored in an index in the cache
+ * location. The index is valid as long as the modification times of the
+ * plugin directories are unchanged, which change if plugins are installed
+ * or removed, and the sizes and modification times of the indexed plugins
+ * are unchanged, which change if a plugin is overwritten in place. So the
+ * binaries of the plugins usually don't need to be opened at startup. The services are taken from KSycoca, which maintains
+ * its own index.
+ *
+ * The registry may be used by any thread.
+ */
+class DOLPHIN_EXPORT KPluginRegistry
+{
+public:
+    static KPluginRegistry& instance();
+    virtual ~KPluginRegistry();
+
+    /**
+     * Starts discovering all plugin categories in worker threads. Does
+     * nothing if the discovery has already been started. Is invoked
+     * implicitly by the accessors.
+     */
+    void startDiscovery();
+
+    /**
+     * @return Names of the preview plugins that are enabled
+     *         per default, see KIO::PreviewJob::defaultPlugins().
+     */
+    QStringList defaultPreviewPlugins();
+
+    /**
+     * @return Services of all thumbnailers ("ThumbCreator").
+     */
+    KService::List thumbCreators();
+
+    /**
+     * @return Services of all version control plugins
+     *         ("FileViewVersionControlPlugin").
+     */
+    KService::List versionControlPlugins();
+
+    /**
+     * @return Metadata of the overlay icon plugins ("kf5/overlayicon").
+     */
+    QVector<KPluginMetaData> overlayIconPlugins();
+
+    /**
+     * @return Metadata of the JSON based file item action plugins
+     *         ("kf5/kfileitemaction").
+     */
+    QVector<KPluginMetaData> fileItemActionPlugins();
+
+    /**
+     * @return Path of the index of the JSON plugins.
+     */
+    QString indexFilePath() const;
+
+    /**
+     * Discards all results, so that the plugins are discovered again
+     * by the next startDiscovery(), e.g. for tests. The index is kept.
+     */
+    void reset();
+
+protected:
+    KPluginRegistry();
+
+private:
+    struct ServiceDiscovery
+    {
+        QStringList defaultPreviewPlugins;
+        KService::List thumbCreators;
+    };
+
+    typedef QHash<QString, QVector<KPluginMetaData> > JsonPlugins;
+
+    static ServiceDiscovery discoverPreviewPlugins();
+    static KService::List discoverVersionControlPlugins();
+
+    /**
+     * Reads the metadata of the JSON plugins in the plugin directories
+     * \a directories from the index \a indexFilePath, or discovers them
+     * and updates the index if it is outdated.
+     */
+    static JsonPlugins discoverJsonPlugins(const QStringList& directories, const QString& indexFilePath);
+
+    /**
+     * @return Modification times in ms since the epoch of the existing
+     *         plugin directories with the relative path \a directory in
+     *         all library paths, with the absolute paths as keys.
+     */
+    static QHash<QString, qint64> directoryModificationTimes(const QString& directory);
+
+    /**
+     * @return True if the plugin file \a fileName still has the size and the
+     *         modification time that are stored in the index entry \a entry.
+     */
+    static bool isIndexEntryValid(const QString& fileName, const QJsonObject& entry);
+
+    static bool readIndex(const QString& indexFilePath, const QStringList& directories, JsonPlugins& plugins);
+    static void writeIndex(const QString& indexFilePath, const QStringList& directories, const JsonPlugins& plugins);
+
+private:
+    mutable QMutex m_mutex;
+    bool m_started;
+    QFuture<ServiceDiscovery> m_previewPlugins;
+    QFuture<KService::List> m_versionControlPlugins;
+    QFuture<JsonPlugins> m_jsonPlugins;
+
+    friend struct KPluginRegistrySingleton;
+};
+
+#endif
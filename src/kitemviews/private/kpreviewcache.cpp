@@ -0,0 +1,220 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kpreviewcache.h"
+
+#include <KFileItem>
+#include <KSharedDataCache>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QImage>
+
+namespace {
+    // Must be increased if the format of the cached data changes
+    const quint32 CacheVersion = 1;
+
+    const uint CacheSize = 100 * 1024 * 1024;
+    const uint ExpectedItemSize = 64 * 1024;
+
+    // Largest preview size that is checked by KPreviewCache::findClosest()
+    const int MaximumPreviewSize = 1024;
+
+    const char SequenceKeySuffix[] = "|sequence";
+
+    QImage readImage(QDataStream& stream)
+    {
+        // The image is stored uncompressed, so that no decoding is necessary
+        // when reading it.
+        quint32 version;
+        qint32 width;
+        qint32 height;
+        qint32 format;
+        qint32 bytesPerLine;
+        qreal devicePixelRatio;
+        stream >> version >> width >> height >> format >> bytesPerLine >> devicePixelRatio;
+        if (stream.status() != QDataStream::Ok || version != CacheVersion
+            || format <= QImage::Format_Invalid || format >= QImage::NImageFormats) {
+            return QImage();
+        }
+
+        QImage image(width, height, static_cast<QImage::Format>(format));
+        if (image.isNull() || image.bytesPerLine() != bytesPerLine) {
+            return QImage();
+        }
+
+        const int byteCount = static_cast<int>(image.sizeInBytes());
+        if (stream.readRawData(reinterpret_cast<char*>(image.bits()), byteCount) != byteCount) {
+            return QImage();
+        }
+        image.setDevicePixelRatio(devicePixelRatio);
+
+        return image;
+    }
+
+    void writeImage(QDataStream& stream, const QImage& image)
+    {
+        stream << CacheVersion
+               << qint32(image.width())
+               << qint32(image.height())
+               << qint32(image.format())
+               << qint32(image.bytesPerLine())
+               << image.devicePixelRatio();
+        stream.writeRawData(reinterpret_cast<const char*>(image.constBits()), static_cast<int>(image.sizeInBytes()));
+    }
+}
+
+struct KPreviewCacheSingleton
+{
+    KPreviewCache instance;
+};
+Q_GLOBAL_STATIC(KPreviewCacheSingleton, s_previewCache)
+
+
+KPreviewCache& KPreviewCache::instance()
+{
+    return s_previewCache->instance;
+}
+
+KPreviewCache::~KPreviewCache()
+{
+    delete m_cache;
+}
+
+QImage KPreviewCache::find(const KFileItem& item, const QSize& size, const QStringList& plugins)
+{
+    const QString previewKey = key(item, size, plugins);
+    if (previewKey.isEmpty()) {
+        return QImage();
+    }
+
+    QByteArray data;
+    if (!m_cache->find(previewKey, &data)) {
+        return QImage();
+    }
+
+    QDataStream stream(data);
+    return readImage(stream);
+}
+
+QImage KPreviewCache::findClosest(const KFileItem& item, const QSize& size, const QStringList& plugins)
+{
+    QImage image = find(item, size, plugins);
+    QSize largerSize = size * 2;
+    while (image.isNull() && !largerSize.isEmpty()
+           && largerSize.width() <= MaximumPreviewSize && largerSize.height() <= MaximumPreviewSize) {
+        image = find(item, largerSize, plugins);
+        largerSize *= 2;
+    }
+    return image;
+}
+
+void KPreviewCache::insert(const KFileItem& item, const QSize& size, const QStringList& plugins, const QImage& image)
+{
+    if (image.isNull()) {
+        return;
+    }
+
+    const QString previewKey = key(item, size, plugins);
+    if (previewKey.isEmpty()) {
+        return;
+    }
+
+    QByteArray data;
+    data.reserve(static_cast<int>(image.sizeInBytes()) + 64);
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    writeImage(stream, image);
+
+    m_cache->insert(previewKey, data);
+}
+
+QImage KPreviewCache::findSequence(const KFileItem& item, const QSize& frameSize, const QStringList& plugins, int* frameCount)
+{
+    *frameCount = 0;
+
+    const QString previewKey = key(item, frameSize, plugins);
+    if (previewKey.isEmpty()) {
+        return QImage();
+    }
+
+    QByteArray data;
+    if (!m_cache->find(previewKey + QLatin1String(SequenceKeySuffix), &data)) {
+        return QImage();
+    }
+
+    QDataStream stream(data);
+    const QImage strip = readImage(stream);
+    qint32 count;
+    stream >> count;
+    if (strip.isNull() || stream.status() != QDataStream::Ok || count <= 0 || strip.width() % count != 0) {
+        return QImage();
+    }
+
+    *frameCount = count;
+    return strip;
+}
+
+void KPreviewCache::insertSequence(const KFileItem& item, const QSize& frameSize, const QStringList& plugins, const QImage& strip, int frameCount)
+{
+    if (strip.isNull() || frameCount <= 0) {
+        return;
+    }
+
+    const QString previewKey = key(item, frameSize, plugins);
+    if (previewKey.isEmpty()) {
+        return;
+    }
+
+    QByteArray data;
+    data.reserve(static_cast<int>(strip.sizeInBytes()) + 64);
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    writeImage(stream, strip);
+    stream << qint32(frameCount);
+
+    m_cache->insert(previewKey + QLatin1String(SequenceKeySuffix), data);
+}
+
+void KPreviewCache::clear()
+{
+    m_cache->clear();
+}
+
+KPreviewCache::KPreviewCache() :
+    m_cache(new KSharedDataCache(QStringLiteral("dolphin-previews"), CacheSize, ExpectedItemSize)),
+    m_plugins(),
+    m_pluginsKey()
+{
+    m_cache->setEvictionPolicy(KSharedDataCache::EvictLeastRecentlyUsed);
+}
+
+QString KPreviewCache::key(const KFileItem& item, const QSize& size, const QStringList& plugins)
+{
+    const QDateTime modificationTime = item.time(KFileItem::ModificationTime);
+    if (!modificationTime.isValid()) {
+        // Without a modification time it is not possible to find out whether
+        // a cached preview is outdated.
+        return QString();
+    }
+
+    if (m_pluginsKey.isEmpty() || plugins != m_plugins) {
+        // qHash() is seeded differently in each process, so a hash that is
+        // stable across processes is used for the persistent key.
+        QStringList sortedPlugins = plugins;
+        sortedPlugins.sort();
+        const QByteArray hash = QCryptographicHash::hash(sortedPlugins.join(QLatin1Char(',')).toUtf8(),
+                                                         QCryptographicHash::Md5);
+        m_plugins = plugins;
+        m_pluginsKey = QString::fromLatin1(hash.toHex());
+    }
+
+    return item.url().toString()
+            + QLatin1Char('|') + QString::number(modificationTime.toMSecsSinceEpoch())
+            + QLatin1Char('|') + QString::number(item.size())
+            + QLatin1Char('|') + QString::number(size.width())
+            + QLatin1Char('x') + QString::number(size.height())
+            + QLatin1Char('|') + m_pluginsKey;
+}
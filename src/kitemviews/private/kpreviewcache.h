@@ -0,0 +1,104 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KPREVIEWCACHE_H
+#define KPREVIEWCACHE_H
+
+#include "dolphin_export.h"
+
+#include <QStringList>
+
+class KFileItem;
+class KSharedDataCache;
+class QImage;
+class QSize;
+
+/**
+ * @brief Memory-mapped cache for the previews that have been created by KIO::PreviewJob.
+ *
+ * The cache is shared by all instances of KFileItemModelRolesUpdater, and
+ * because it is backed by a KSharedDataCache, also by all Dolphin processes
+ * and sessions. This allows KFileItemModelRolesUpdater to apply previews
+ * synchronously without the overhead of starting a preview job.
+ *
+ * A preview is identified by the URL, the modification time and the size of
+ * the item, the requested preview size and the enabled preview plugins. If
+ * any of them changes, the cached preview is not used anymore. Previews of
+ * items without a valid modification time are not cached.
+ */
+class DOLPHIN_EXPORT KPreviewCache
+{
+public:
+    static KPreviewCache& instance();
+    virtual ~KPreviewCache();
+
+    /**
+     * @return Preview of \a item with the size \a size that has been created
+     *         by the plugins \a plugins. A null image is returned if no
+     *         matching preview is available.
+     */
+    QImage find(const KFileItem& item, const QSize& size, const QStringList& plugins);
+
+    /**
+     * Like find(), but if no preview with the size \a size is available, a
+     * preview with a multiple of \a size is returned. A larger preview can
+     * be downscaled without losing quality, so it is preferred to starting a
+     * preview job, e.g. after moving the window to a screen with a lower
+     * device pixel ratio. Smaller previews are never returned, because they
+     * would need to be upscaled.
+     */
+    QImage findClosest(const KFileItem& item, const QSize& size, const QStringList& plugins);
+
+    /**
+     * Stores the preview \a image of \a item with the size \a size that has
+     * been created by the plugins \a plugins.
+     */
+    void insert(const KFileItem& item, const QSize& size, const QStringList& plugins, const QImage& image);
+
+    /**
+     * @return Thumbnail sequence of \a item with frames of the size \a frameSize
+     *         that has been stored by insertSequence(). The frames are placed
+     *         side by side in the returned strip, and their number is written
+     *         to \a frameCount. A null image is returned if no matching
+     *         sequence is available.
+     */
+    QImage findSequence(const KFileItem& item, const QSize& frameSize, const QStringList& plugins, int* frameCount);
+
+    /**
+     * Stores the thumbnail sequence \a strip of \a item, which contains
+     * \a frameCount frames of the same width side by side. The sequence is
+     * stored separately from the preview with the size \a frameSize.
+     */
+    void insertSequence(const KFileItem& item, const QSize& frameSize, const QStringList& plugins, const QImage& strip, int frameCount);
+
+    /**
+     * Removes all previews from the cache.
+     */
+    void clear();
+
+protected:
+    KPreviewCache();
+
+private:
+    /**
+     * @return Key of the preview for the given parameters, or an empty string
+     *         if no preview of \a item may be cached.
+     */
+    QString key(const KFileItem& item, const QSize& size, const QStringList& plugins);
+
+private:
+    KSharedDataCache* m_cache;
+
+    // Plugins and the corresponding part of the key that have been used
+    // the last time. Usually the plugins don't change, so the (stable)
+    // hash of the plugins does not need to be calculated for each key.
+    QStringList m_plugins;
+    QString m_pluginsKey;
+
+    friend struct KPreviewCacheSingleton;
+};
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kpreviewjoblimiter.h"
+
+#include <QThread>
+
+struct KPreviewJobLimiterSingleton
+{
+    KPreviewJobLimiter instance;
+};
+Q_GLOBAL_STATIC(KPreviewJobLimiterSingleton, s_previewJobLimiter)
+
+
+KPreviewJobLimiter& KPreviewJobLimiter::instance()
+{
+    return s_previewJobLimiter->instance;
+}
+
+KPreviewJobLimiter::~KPreviewJobLimiter()
+{
+}
+
+void KPreviewJobLimiter::setMaximumJobs(int count)
+{
+    const int previousMaximumJobs = m_maximumJobs;
+    m_maximumJobs = qMax(1, count);
+    if (m_maximumJobs > previousMaximumJobs) {
+        Q_EMIT released();
+    }
+}
+
+int KPreviewJobLimiter::maximumJobs() const
+{
+    return m_maximumJobs;
+}
+
+int KPreviewJobLimiter::acquire(int count, Priority priority)
+{
+    const int maximumJobs = (priority == LowPriority) ? qMax(1, m_maximumJobs / 2) : m_maximumJobs;
+    const int acquired = qBound(0, maximumJobs - m_runningJobs, count);
+    m_runningJobs += acquired;
+    return acquired;
+}
+
+void KPreviewJobLimiter::release(int count)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    Q_ASSERT(m_runningJobs >= count);
+    m_runningJobs = qMax(0, m_runningJobs - count);
+    Q_EMIT released();
+}
+
+KPreviewJobLimiter::KPreviewJobLimiter() :
+    QObject(),
+    m_maximumJobs(qMax(1, QThread::idealThreadCount())),
+    m_runningJobs(0)
+{
+}
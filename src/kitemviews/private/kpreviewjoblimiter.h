@@ -0,0 +1,78 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KPREVIEWJOBLIMITER_H
+#define KPREVIEWJOBLIMITER_H
+
+#include "dolphin_export.h"
+
+#include <QObject>
+
+/**
+ * @brief Limits the number of preview jobs that run in parallel.
+ *
+ * Is shared by all instances of KFileItemModelRolesUpdater, so that many
+ * open tabs and windows don't oversubscribe the machine with thumbnailers.
+ * A roles updater acquires a slot for each preview job it starts and
+ * releases the slot as soon as the job is finished or killed.
+ */
+class DOLPHIN_EXPORT KPreviewJobLimiter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Priority {
+        NormalPriority,
+        /**
+         * Is used by roles updaters of views that have not the focus, like
+         * the inactive view of a split view. They may only use half of the
+         * slots, so that the active view gets a slot for its previews
+         * without waiting for the jobs of the other view.
+         */
+        LowPriority
+    };
+
+    static KPreviewJobLimiter& instance();
+    ~KPreviewJobLimiter() override;
+
+    /**
+     * Sets the maximum number of preview jobs that may run at the
+     * same time. Per default QThread::idealThreadCount() is used.
+     */
+    void setMaximumJobs(int count);
+    int maximumJobs() const;
+
+    /**
+     * Acquires up to \a count slots for preview jobs with \a priority.
+     * @return Number of acquired slots, which might be 0 if the
+     *         maximum number of jobs for the priority is running already.
+     */
+    int acquire(int count, Priority priority = NormalPriority);
+
+    /**
+     * Releases \a count slots that have been acquired by acquire().
+     * The signal released() is emitted.
+     */
+    void release(int count = 1);
+
+Q_SIGNALS:
+    /**
+     * Is emitted if slots for preview jobs have been released.
+     * Roles updaters that wait for a slot should try to acquire one.
+     */
+    void released();
+
+protected:
+    KPreviewJobLimiter();
+
+private:
+    int m_maximumJobs;
+    int m_runningJobs;
+
+    friend struct KPreviewJobLimiterSingleton;
+};
+
+#endif
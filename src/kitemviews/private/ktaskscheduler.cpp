@@ -0,0 +1,373 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "ktaskscheduler.h"
+
+#include <QCoreApplication>
+#include <QDeadlineTimer>
+#include <QObject>
+#include <QRunnable>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // Niceness of the threads of the Prefetch and Background tasks
+    const int LowPriorityNiceness = 10;
+
+    // Time in ms without progress of the Interactive work, after which
+    // the Prefetch and Background tasks are no longer held back
+    const int DefaultHoldBackTimeout = 2000;
+
+#ifdef Q_OS_LINUX
+    // See linux/ioprio.h, which is not available on all systems
+    const int IoprioWhoProcess = 1;
+    const int IoprioClassIdle = 3;
+    const int IoprioClassShift = 13;
+#endif
+
+    // Is set for the threads whose priority has been lowered
+    thread_local bool t_lowPriorityThread = false;
+
+    class Task : public QRunnable
+    {
+    public:
+        explicit Task(std::function<void()> function) :
+            m_function(std::move(function))
+        {
+        }
+
+        void run() override
+        {
+            m_function();
+        }
+
+    private:
+        std::function<void()> m_function;
+    };
+}
+
+struct KTaskSchedulerSingleton
+{
+    KTaskScheduler instance;
+};
+Q_GLOBAL_STATIC(KTaskSchedulerSingleton, s_taskScheduler)
+
+KTaskScheduler::InteractiveScope::InteractiveScope(KTaskScheduler& scheduler) :
+    m_scheduler(scheduler)
+{
+    m_scheduler.beginInteractiveWork();
+}
+
+KTaskScheduler::InteractiveScope::~InteractiveScope()
+{
+    m_scheduler.endInteractiveWork();
+}
+
+KTaskScheduler& KTaskScheduler::instance()
+{
+    return s_taskScheduler->instance;
+}
+
+KTaskScheduler::KTaskScheduler() :
+    m_mutex(),
+    m_queues(),
+    m_runningCounts(),
+    m_maximumConcurrency(),
+    m_interactiveScopes(0),
+    m_shuttingDown(false),
+    m_interactiveProgressTimer(),
+    m_holdBackTimeout(DefaultHoldBackTimeout),
+    m_wakeUpScheduled(false),
+    m_startScheduled(false),
+    m_wakeUpContext(new QObject()),
+    m_threadPool(),
+    m_lowPriorityThreadPool()
+{
+    m_interactiveProgressTimer.start();
+    if (QCoreApplication::instance()) {
+        m_wakeUpContext->moveToThread(QCoreApplication::instance()->thread());
+    }
+
+    // Listing and searching read many files in parallel, while the
+    // prefetching and background tasks only use few threads, so that
+    // they don't compete with the work for the shown items.
+    const int threadCount = qMax(2, QThread::idealThreadCount());
+    m_maximumConcurrency[Interactive] = threadCount;
+    m_maximumConcurrency[Visible] = threadCount;
+    m_maximumConcurrency[Prefetch] = 2;
+    m_maximumConcurrency[Background] = 1;
+
+    updateThreadCounts();
+}
+
+KTaskScheduler::~KTaskScheduler()
+{
+    QMutexLocker locker(&m_mutex);
+    m_shuttingDown = true;
+    std::array<QQueue<QueuedTask>, PriorityCount> droppedTasks;
+    droppedTasks.swap(m_queues);
+    locker.unlock();
+
+    for (QQueue<QueuedTask>& queue : droppedTasks) {
+        for (QueuedTask& task : queue) {
+            task.function(true);
+        }
+    }
+
+    m_threadPool.waitForDone();
+    m_lowPriorityThreadPool.waitForDone();
+}
+
+void KTaskScheduler::setMaximumConcurrency(Priority priority, int count)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maximumConcurrency[priority] = qMax(1, count);
+    updateThreadCounts();
+    startTasks();
+}
+
+int KTaskScheduler::maximumConcurrency(Priority priority) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maximumConcurrency[priority];
+}
+
+void KTaskScheduler::setHoldBackTimeout(int msecs)
+{
+    QMutexLocker locker(&m_mutex);
+    m_holdBackTimeout = qMax(0, msecs);
+    startTasks();
+}
+
+int KTaskScheduler::holdBackTimeout() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_holdBackTimeout;
+}
+
+int KTaskScheduler::runningCount(Priority priority) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_runningCounts[priority];
+}
+
+int KTaskScheduler::queuedCount(Priority priority) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_queues[priority].count();
+}
+
+bool KTaskScheduler::waitForDone(int msecs)
+{
+    const QDeadlineTimer deadline(msecs);
+    while (true) {
+        // Finished tasks start the queued tasks from the threads of the pools
+        if (!m_threadPool.waitForDone(deadline.remainingTime()) ||
+            !m_lowPriorityThreadPool.waitForDone(deadline.remainingTime())) {
+            return false;
+        }
+
+        QMutexLocker locker(&m_mutex);
+        const bool done = std::all_of(m_queues.cbegin(), m_queues.cend(), [](const QQueue<QueuedTask>& queue) {
+            return queue.isEmpty();
+        });
+        if (done) {
+            return true;
+        }
+        locker.unlock();
+
+        // The queued tasks are held back by an InteractiveScope
+        if (deadline.hasExpired()) {
+            return false;
+        }
+        QThread::msleep(10);
+
+        // Starts the held back tasks if the wake up timer cannot run,
+        // because the caller blocks the main thread
+        locker.relock();
+        startTasks();
+    }
+}
+
+void KTaskScheduler::enqueue(Priority priority, QueuedTask task)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_shuttingDown) {
+        locker.unlock();
+        task.function(true);
+        return;
+    }
+
+    m_queues[priority].enqueue(std::move(task));
+    startTasks();
+}
+
+void KTaskScheduler::taskFinished(Priority priority)
+{
+    QMutexLocker locker(&m_mutex);
+    --m_runningCounts[priority];
+    if (priority == Interactive) {
+        m_interactiveProgressTimer.restart();
+    }
+    startTasks();
+}
+
+void KTaskScheduler::beginInteractiveWork()
+{
+    QMutexLocker locker(&m_mutex);
+    ++m_interactiveScopes;
+    m_interactiveProgressTimer.restart();
+}
+
+void KTaskScheduler::endInteractiveWork()
+{
+    QMutexLocker locker(&m_mutex);
+    Q_ASSERT(m_interactiveScopes > 0);
+    --m_interactiveScopes;
+    m_interactiveProgressTimer.restart();
+    if (m_interactiveScopes == 0) {
+        startTasks();
+    }
+}
+
+void KTaskScheduler::lowerCurrentThreadPriority()
+{
+    if (t_lowPriorityThread) {
+        return;
+    }
+    t_lowPriorityThread = true;
+
+#ifdef Q_OS_LINUX
+    // Both priorities only affect the calling thread on Linux. Failures
+    // are ignored, e.g. if the niceness of the process is higher already.
+    syscall(SYS_ioprio_set, IoprioWhoProcess, 0, IoprioClassIdle << IoprioClassShift);
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), LowPriorityNiceness);
+#else
+    QThread::currentThread()->setPriority(QThread::LowPriority);
+#endif
+}
+
+void KTaskScheduler::startTasks()
+{
+    if (m_shuttingDown) {
+        return;
+    }
+
+    for (int i = Interactive; i < PriorityCount; ++i) {
+        const Priority priority = static_cast<Priority>(i);
+        if (isHeldBack(priority)) {
+            // The lower classes are held back as well
+            scheduleWakeUp();
+            break;
+        }
+
+        QQueue<QueuedTask>& queue = m_queues[priority];
+        if (t_lowPriorityThread && !isLowPriority(priority)) {
+            // New threads inherit the priorities of the thread that starts them,
+            // so the tasks of this class are started by the main thread
+            if (!queue.isEmpty() && m_runningCounts[priority] < m_maximumConcurrency[priority]) {
+                scheduleStart();
+            }
+            continue;
+        }
+
+        while (!queue.isEmpty() && m_runningCounts[priority] < m_maximumConcurrency[priority]) {
+            ++m_runningCounts[priority];
+            if (priority == Interactive) {
+                m_interactiveProgressTimer.restart();
+            }
+            const QueuedTask task = queue.dequeue();
+            const std::function<void(bool)> function = task.function;
+            if (task.lowPriorityThread) {
+                m_lowPriorityThreadPool.start(new Task([this, priority, function]() {
+                    lowerCurrentThreadPriority();
+                    function(false);
+                    taskFinished(priority);
+                }));
+            } else {
+                m_threadPool.start(new Task([this, priority, function]() {
+                    function(false);
+                    taskFinished(priority);
+                }));
+            }
+        }
+    }
+}
+
+bool KTaskScheduler::isHeldBack(Priority priority) const
+{
+    if (priority < Prefetch) {
+        return false;
+    }
+
+    const bool interactiveWork = m_interactiveScopes > 0 || m_runningCounts[Interactive] > 0 || !m_queues[Interactive].isEmpty();
+    return interactiveWork && !m_interactiveProgressTimer.hasExpired(m_holdBackTimeout);
+}
+
+void KTaskScheduler::scheduleWakeUp()
+{
+    if (m_wakeUpScheduled || !QCoreApplication::instance()) {
+        return;
+    }
+
+    const bool queued = std::any_of(m_queues.cbegin() + Prefetch, m_queues.cend(), [](const QQueue<QueuedTask>& queue) {
+        return !queue.isEmpty();
+    });
+    if (!queued) {
+        return;
+    }
+
+    // The timeout is checked again when the timer fires, as the
+    // Interactive work may have made progress in the meantime
+    m_wakeUpScheduled = true;
+    const int remainingTime = qMax<qint64>(0, m_holdBackTimeout - m_interactiveProgressTimer.elapsed()) + 1;
+    QObject* context = m_wakeUpContext.get();
+    QMetaObject::invokeMethod(context, [this, context, remainingTime]() {
+        QTimer::singleShot(remainingTime, context, [this]() {
+            QMutexLocker locker(&m_mutex);
+            m_wakeUpScheduled = false;
+            startTasks();
+        });
+    }, Qt::QueuedConnection);
+}
+
+void KTaskScheduler::scheduleStart()
+{
+    if (m_startScheduled || !QCoreApplication::instance()) {
+        return;
+    }
+
+    m_startScheduled = true;
+    QMetaObject::invokeMethod(m_wakeUpContext.get(), [this]() {
+        QMutexLocker locker(&m_mutex);
+        m_startScheduled = false;
+        startTasks();
+    }, Qt::QueuedConnection);
+}
+
+bool KTaskScheduler::isLowPriority(Priority priority)
+{
+    return priority >= Prefetch;
+}
+
+void KTaskScheduler::updateThreadCounts()
+{
+    // Interactive and Visible tasks may run in the low priority threads as well
+    int lowPriorityThreadCount = 0;
+    for (int count : m_maximumConcurrency) {
+        lowPriorityThreadCount += count;
+    }
+    m_threadPool.setMaxThreadCount(m_maximumConcurrency[Interactive] + m_maximumConcurrency[Visible]);
+    m_lowPriorityThreadPool.setMaxThreadCount(lowPriorityThreadCount);
+}
@@ -0,0 +1,254 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KTASKSCHEDULER_H
+#define KTASKSCHEDULER_H
+
+#include "dolphin_export.h"
+
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QMutex>
+#include <QQueue>
+#include <QThreadPool>
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <type_traits>
+
+class QObject;
+
+/**
+ * @brief Runs the background work of all views in one thread pool.
+ *
+ * Each task has one of the priority classes Interactive, Visible, Prefetch
+ * and Background, and the scheduler only runs a limited number of tasks
+ * of each class at the same time. The queued tasks of higher classes are
+ * started first whenever a task has been finished. Prefetch and Background
+ * tasks are held back as long as an Interactive task is queued or running,
+ * or as long as an InteractiveScope exists, e.g. while the items are sorted.
+ * If no Interactive task has been started or finished and no scope has been
+ * created or destroyed for holdBackTimeout() ms, e.g. because a listing
+ * hangs on a slow mount, the held back tasks are started nevertheless.
+ *
+ * The Prefetch and Background tasks run in separate threads with a lower
+ * CPU priority and, on Linux, with the idle I/O scheduling class, so that
+ * they only use the disk if no other process needs it. Tasks of the other
+ * classes may run in these threads as well by passing LowThreadPriority
+ * to run(), e.g. for results of the visible items that may be produced slowly. The pools have as
+ * many threads as the limits of their classes allow to run tasks at the
+ * same time. Therefore tasks that block on a slow mount only occupy the
+ * threads of their own class, and the threads of
+ * QThreadPool::globalInstance() stay available for sorting.
+ *
+ * Tasks are started by run(), which returns a QFuture like QtConcurrent::run().
+ * Canceling the future before the task has been started drops the task. A
+ * running task may poll the cancellation by a token that is passed as
+ * argument, like the QAtomicInt of KFileContentSearcher. Tasks that are
+ * dropped, also when the scheduler is destroyed, report a canceled and
+ * finished future, so waiting for them does not block.
+ *
+ * Work that only uses the CPU and never blocks on I/O does not use the
+ * scheduler, as it would only be delayed by the limits of the classes.
+ * The sorting and resorting of KFileItemModel and the scaling of the
+ * received previews keep using QThreadPool::globalInstance(). The filtering
+ * and the retrieving of role values of KFileItemModel use a pool of their
+ * own, in which the calling thread takes part.
+ */
+class DOLPHIN_EXPORT KTaskScheduler
+{
+public:
+    enum Priority {
+        /** Work the user is waiting for, e.g. listing the shown folder. */
+        Interactive,
+        /** Roles and results of the items in the visible area. */
+        Visible,
+        /** Roles of items that are likely to be shown soon. */
+        Prefetch,
+        /** Any other work, whose results are not shown soon. */
+        Background,
+        PriorityCount
+    };
+
+    enum ThreadPriority {
+        /** Only Prefetch and Background tasks run with a low thread priority. */
+        DefaultThreadPriority,
+        /**
+         * The task runs with a low CPU and I/O priority also if it is an
+         * Interactive or Visible task. It keeps its class, so it is neither
+         * held back nor queued behind the Prefetch and Background tasks.
+         */
+        LowThreadPriority
+    };
+
+    /**
+     * Holds back the Prefetch and Background tasks as long as it exists.
+     * Is used for work that does not run in the scheduler, but that the
+     * user is waiting for. May be created in any thread.
+     */
+    class DOLPHIN_EXPORT InteractiveScope
+    {
+    public:
+        explicit InteractiveScope(KTaskScheduler& scheduler = KTaskScheduler::instance());
+        ~InteractiveScope();
+
+    private:
+        Q_DISABLE_COPY(InteractiveScope)
+        KTaskScheduler& m_scheduler;
+    };
+
+    static KTaskScheduler& instance();
+
+    KTaskScheduler();
+    ~KTaskScheduler();
+
+    /**
+     * Sets the number of tasks with \a priority that may run at the same time.
+     */
+    void setMaximumConcurrency(Priority priority, int count);
+    int maximumConcurrency(Priority priority) const;
+
+    /**
+     * Sets the time in ms after which the Prefetch and Background tasks are
+     * no longer held back if the Interactive work does not make progress.
+     * The default is 2000 ms.
+     */
+    void setHoldBackTimeout(int msecs);
+    int holdBackTimeout() const;
+
+    /**
+     * Runs \a function with \a args in a thread of the scheduler.
+     * @return Future for the result of \a function.
+     */
+    template<typename Function, typename... Args>
+    QFuture<std::invoke_result_t<Function, Args...>> run(Priority priority, Function function, Args... args);
+
+    /**
+     * Runs \a function with \a args like run(), with the thread priority
+     * \a threadPriority.
+     */
+    template<typename Function, typename... Args>
+    QFuture<std::invoke_result_t<Function, Args...>> run(Priority priority, ThreadPriority threadPriority, Function function, Args... args);
+
+    int runningCount(Priority priority) const;
+    int queuedCount(Priority priority) const;
+
+    /**
+     * Waits until all tasks have been finished, but at most \a msecs ms.
+     * @return True if all tasks have been finished.
+     */
+    bool waitForDone(int msecs = -1);
+
+    /**
+     * Holds back the Prefetch and Background tasks until
+     * endInteractiveWork() has been invoked as often.
+     * @see InteractiveScope
+     */
+    void beginInteractiveWork();
+    void endInteractiveWork();
+
+    /**
+     * Lowers the CPU priority and the I/O priority of the calling thread,
+     * like for the threads of the Prefetch and Background tasks. Processes
+     * that are started by the thread inherit the priorities. The priorities
+     * cannot be raised again without privileges, so the thread should not
+     * be used for other work afterwards.
+     */
+    static void lowerCurrentThreadPriority();
+
+private:
+    struct QueuedTask
+    {
+        /** Runs the task, or only finishes its future if \a dropped is true. */
+        std::function<void(bool dropped)> function;
+        bool lowPriorityThread;
+    };
+
+    void enqueue(Priority priority, QueuedTask task);
+    void taskFinished(Priority priority);
+
+    /**
+     * Starts the queued tasks that are allowed to run. m_mutex must be locked.
+     */
+    void startTasks();
+
+    bool isHeldBack(Priority priority) const;
+    static bool isLowPriority(Priority priority);
+
+    /**
+     * Starts the held back tasks when the hold back timeout expires, if
+     * any are queued. m_mutex must be locked.
+     */
+    void scheduleWakeUp();
+
+    /**
+     * Starts the queued tasks in the main thread, if tasks of classes with
+     * normal thread priority may be started. m_mutex must be locked.
+     */
+    void scheduleStart();
+
+    /**
+     * Sets the number of threads of the pools to the limits of their classes.
+     */
+    void updateThreadCounts();
+
+private:
+    mutable QMutex m_mutex;
+    std::array<QQueue<QueuedTask>, PriorityCount> m_queues;
+    std::array<int, PriorityCount> m_runningCounts;
+    std::array<int, PriorityCount> m_maximumConcurrency;
+    int m_interactiveScopes;
+    bool m_shuttingDown;
+
+    // Is restarted whenever the Interactive work makes progress
+    QElapsedTimer m_interactiveProgressTimer;
+    int m_holdBackTimeout;
+    bool m_wakeUpScheduled;
+    bool m_startScheduled;
+
+    // Lives in the main thread, where the wake up timer runs
+    std::unique_ptr<QObject> m_wakeUpContext;
+
+    // Are destroyed first, so the running tasks may still access the other members
+    QThreadPool m_threadPool;
+    QThreadPool m_lowPriorityThreadPool;
+};
+
+template<typename Function, typename... Args>
+QFuture<std::invoke_result_t<Function, Args...>> KTaskScheduler::run(Priority priority, Function function, Args... args)
+{
+    return run(priority, DefaultThreadPriority, function, args...);
+}
+
+template<typename Function, typename... Args>
+QFuture<std::invoke_result_t<Function, Args...>> KTaskScheduler::run(Priority priority, ThreadPriority threadPriority, Function function, Args... args)
+{
+    using Result = std::invoke_result_t<Function, Args...>;
+
+    QFutureInterface<Result> interface;
+    interface.reportStarted();
+    const QFuture<Result> future = interface.future();
+
+    auto task = [interface, function, args...](bool dropped) mutable {
+        if (dropped) {
+            interface.reportCanceled();
+        } else if (!interface.isCanceled()) {
+            if constexpr (std::is_void_v<Result>) {
+                std::invoke(function, args...);
+            } else {
+                interface.reportResult(std::invoke(function, args...));
+            }
+        }
+        interface.reportFinished();
+    };
+    enqueue(priority, {task, threadPriority == LowThreadPriority || isLowPriority(priority)});
+
+    return future;
+}
+
+#endif
@@ -12,6 +12,7 @@
 #include "dolphindebug.h"
 #include "dolphinmainwindow.h"
 #include "global.h"
+#include "kitemviews/private/kitemliststalldetector.h"
 #include "config-kuserfeedback.h"
 #ifdef HAVE_KUSERFEEDBACK
 #include "userfeedback/dolphinfeedbackprovider.h"
@@ -36,6 +37,7 @@
 
 extern "C" Q_DECL_EXPORT int kdemain(int argc, char **argv)
 {
+    Dolphin::logStartupPhase("started");
 
     /**
      * enable high dpi support
@@ -44,6 +46,10 @@ extern "C" Q_DECL_EXPORT int kdemain(int argc, char **argv)
     QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling, true);
 
     QApplication app(argc, argv);
+    Dolphin::logStartupPhase("application created");
+
+    // Only active if DOLPHIN_STALL_THRESHOLD is set
+    KItemListStallDetector stallDetector;
     app.setWindowIcon(QIcon::fromTheme(QStringLiteral("system-file-manager"), app.windowIcon()));
 
     KCrash::initialize();
@@ -112,6 +118,7 @@ extern "C" Q_DECL_EXPORT int kdemain(int argc, char **argv)
 
     parser.process(app);
     aboutData.processCommandLine(&parser);
+    Dolphin::logStartupPhase("command line processed");
 
     const bool splitView = parser.isSet(QStringLiteral("split")) || GeneralSettings::splitView();
     const bool openFiles = parser.isSet(QStringLiteral("select"));
@@ -130,6 +137,10 @@ extern "C" Q_DECL_EXPORT int kdemain(int argc, char **argv)
         QObject::connect(&app, &QGuiApplication::commitDataRequest, disableSessionManagement);
         QObject::connect(&app, &QGuiApplication::saveStateRequest, disableSessionManagement);
 
+        // The daemon shows main windows for folders requested by other
+        // applications, but must keep running after they have been closed
+        app.setQuitOnLastWindowClosed(false);
+
         KDBusService dolphinDBusService;
         DBusInterface interface;
         interface.setAsDaemon();
@@ -154,6 +165,7 @@ extern "C" Q_DECL_EXPORT int kdemain(int argc, char **argv)
     }
 
     DolphinMainWindow* mainWindow = new DolphinMainWindow();
+    Dolphin::logStartupPhase("main window created");
 
     if (openFiles) {
         mainWindow->openFiles(urls, splitView);
@@ -162,6 +174,7 @@ extern "C" Q_DECL_EXPORT int kdemain(int argc, char **argv)
     }
 
     mainWindow->show();
+    Dolphin::logStartupPhase("main window shown");
 
     KDBusService dolphinDBusService;
     DBusInterface interface;
@@ -30,13 +30,16 @@
 #include <QGraphicsSceneDragDropEvent>
 #include <QGraphicsView>
 #include <QPropertyAnimation>
+#include <QtMath>
 #include <QTimer>
 
 FoldersPanel::FoldersPanel(QWidget* parent) :
     Panel(parent),
     m_updateCurrentItem(false),
     m_controller(nullptr),
-    m_model(nullptr)
+    m_model(nullptr),
+    m_prefetchedUrl(),
+    m_expandedDirectories()
 {
     setLayoutDirection(Qt::LeftToRight);
 }
@@ -161,6 +164,9 @@ void FoldersPanel::showEvent(QShowEvent* event)
         connect(m_controller, &KItemListController::itemContextMenuRequested, this, &FoldersPanel::slotItemContextMenuRequested);
         connect(m_controller, &KItemListController::viewContextMenuRequested, this, &FoldersPanel::slotViewContextMenuRequested);
         connect(m_controller, &KItemListController::itemDropEvent, this, &FoldersPanel::slotItemDropEvent);
+        connect(m_controller, &KItemListController::itemHovered, this, &FoldersPanel::slotItemHovered);
+        connect(m_controller, &KItemListController::itemUnhovered, this, &FoldersPanel::slotItemUnhovered);
+        connect(m_controller, &KItemListController::itemExpansionToggleClicked, this, &FoldersPanel::slotItemExpansionToggleClicked);
 
         KItemListContainer* container = new KItemListContainer(m_controller, this);
         container->setEnabledFrame(false);
@@ -241,6 +247,26 @@ void FoldersPanel::slotItemDropEvent(int index, QGraphicsSceneDragDropEvent* eve
     }
 }
 
+void FoldersPanel::slotItemHovered(int index)
+{
+    prefetchFolder(m_model->fileItem(index).url());
+}
+
+void FoldersPanel::slotItemUnhovered(int index)
+{
+    Q_UNUSED(index)
+    prefetchFolder(QUrl());
+}
+
+void FoldersPanel::slotItemExpansionToggleClicked(int index)
+{
+    // The expanded folder is listed by the model anyway. Prefetching it
+    // shares that listing and keeps the items for the view.
+    if (m_model->isExpanded(index)) {
+        prefetchFolder(m_model->fileItem(index).url());
+    }
+}
+
 void FoldersPanel::slotRoleEditingFinished(int index, const QByteArray& role, const QVariant& value)
 {
     if (role == "text") {
@@ -290,6 +316,16 @@ void FoldersPanel::startFadeInAnimation()
     anim->setDuration(200);
 }
 
+int FoldersPanel::visibleItemCountHint() const
+{
+    const KItemListView* view = m_controller->view();
+    const qreal itemHeight = view->itemSize().height();
+    if (view->size().isEmpty() || itemHeight <= 0) {
+        return 0;
+    }
+    return qMax(1, qCeil(view->size().height() / itemHeight));
+}
+
 void FoldersPanel::loadTree(const QUrl& url, FoldersPanel::NavigationBehaviour navigationBehaviour)
 {
     Q_ASSERT(m_controller);
@@ -319,7 +355,21 @@ void FoldersPanel::loadTree(const QUrl& url, FoldersPanel::NavigationBehaviour n
 
     if (m_model->directory() != baseUrl && !jumpHome) {
         m_updateCurrentItem = true;
-        m_model->refreshDirectory(baseUrl);
+
+        // Remember the expanded folders of the current tree and expand the
+        // folders again that have been expanded when the new tree has been
+        // shown the last time. The directories are not reloaded, so that
+        // the cached listings of KDirLister can be used.
+        const QUrl previousBaseUrl = m_model->directory();
+        if (previousBaseUrl.isValid()) {
+            m_expandedDirectories.insert(previousBaseUrl, m_model->expandedDirectories() | m_model->directoriesToBeExpanded());
+        }
+        m_model->restoreExpandedDirectories(m_expandedDirectories.take(baseUrl));
+
+        // Show the first rows as soon as they have been listed, the
+        // remaining rows are inserted in batches afterwards.
+        m_model->setVisibleItemCountHint(visibleItemCountHint());
+        m_model->loadDirectory(baseUrl);
     }
 
     const int index = m_model->index(url);
@@ -349,3 +399,18 @@ void FoldersPanel::updateCurrentItem(int index)
     m_controller->view()->scrollToItem(index);
 }
 
+void FoldersPanel::prefetchFolder(const QUrl& url)
+{
+    if (url == m_prefetchedUrl) {
+        return;
+    }
+
+    if (!m_prefetchedUrl.isEmpty()) {
+        m_model->cancelPrefetching(m_prefetchedUrl);
+    }
+
+    m_prefetchedUrl = url;
+    if (!url.isEmpty()) {
+        m_model->prefetchDirectory(url);
+    }
+}
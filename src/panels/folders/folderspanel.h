@@ -9,6 +9,8 @@
 
 #include "panels/panel.h"
 
+#include <QHash>
+#include <QSet>
 #include <QUrl>
 
 class KFileItemModel;
@@ -61,6 +63,9 @@ private Q_SLOTS:
     void slotItemContextMenuRequested(int index, const QPointF& pos);
     void slotViewContextMenuRequested(const QPointF& pos);
     void slotItemDropEvent(int index, QGraphicsSceneDragDropEvent* event);
+    void slotItemHovered(int index);
+    void slotItemUnhovered(int index);
+    void slotItemExpansionToggleClicked(int index);
     void slotRoleEditingFinished(int index, const QByteArray& role, const QVariant& value);
 
     void slotLoadingCompleted();
@@ -96,10 +101,27 @@ private:
      */
     void updateCurrentItem(int index);
 
+    /**
+     * Prefetches the folder \a url, so that the view can show it at once
+     * when it is activated, and cancels prefetching the previous folder.
+     * An empty URL only cancels the prefetching.
+     */
+    void prefetchFolder(const QUrl& url);
+
+    /**
+     * @return Number of rows that fit into the visible area of the view.
+     */
+    int visibleItemCountHint() const;
+
 private:
     bool m_updateCurrentItem;
     KItemListController* m_controller;
     KFileItemModel* m_model;
+    QUrl m_prefetchedUrl;
+
+    // Expanded folders of the trees with other base URLs, which are
+    // expanded again when the tree of the base URL is shown again.
+    QHash<QUrl, QSet<QUrl>> m_expandedDirectories;
 };
 
 #endif // FOLDERSPANEL_H
@@ -7,6 +7,7 @@
 #include "informationpanel.h"
 
 #include "informationpanelcontent.h"
+#include "views/jobscope.h"
 
 #include <KIO/Job>
 #include <KIO/JobUiDelegate>
@@ -35,9 +36,10 @@ InformationPanel::InformationPanel(QWidget* parent) :
     m_invalidUrlCandidate(),
     m_fileItem(),
     m_selection(),
-    m_folderStatJob(nullptr),
+    m_requestScope(nullptr),
     m_content(nullptr)
 {
+    m_requestScope = new JobScope(this);
 }
 
 InformationPanel::~InformationPanel()
@@ -87,12 +89,23 @@ void InformationPanel::requestDelayedItemInfo(const KFileItem& item)
         if (!m_selection.isEmpty()) {
             m_fileItem = KFileItem();
             m_infoTimer->start();
+        } else {
+            // The shown item stays, its preview might have been
+            // stopped while the cursor has been above another item
+            m_content->resumePreview();
         }
     } else if (item.url().isValid() && !isEqualToShownUrl(item.url())) {
         // The cursor is above an item that is not shown currently
         m_urlCandidate = item.url();
         m_fileItem = item;
         m_infoTimer->start();
+
+        // The preview of the shown item is not needed anymore. Stopping its
+        // generation leaves the preview jobs free for the hovered item.
+        m_content->cancelPreview();
+    } else if (isEqualToShownUrl(item.url())) {
+        // The cursor has returned to the shown item before another item has been shown
+        m_content->resumePreview();
     }
 }
 
@@ -235,12 +248,12 @@ void InformationPanel::showItemInfo()
         if (item.isNull()) {
             // No item is hovered and no selection has been done: provide
             // an item for the currently shown directory.
-            m_folderStatJob = KIO::statDetails(url(), KIO::StatJob::SourceSide, KIO::StatDefaultDetails | KIO::StatRecursiveSize, KIO::HideProgressInfo);
-            if (m_folderStatJob->uiDelegate()) {
-                KJobWidgets::setWindow(m_folderStatJob, this);
+            KIO::StatJob* job = m_requestScope->add(KIO::statDetails(url(), KIO::StatJob::SourceSide, KIO::StatDefaultDetails | KIO::StatRecursiveSize, KIO::HideProgressInfo));
+            if (job->uiDelegate()) {
+                KJobWidgets::setWindow(job, this);
             }
-            connect(m_folderStatJob, &KIO::Job::result,
-                    this, &InformationPanel::slotFolderStatFinished);
+            connect(job, &KIO::Job::result,
+                    m_requestScope->context(), [this](KJob* job) { slotFolderStatFinished(job); });
         } else {
             m_content->showItem(item);
         }
@@ -249,7 +262,6 @@ void InformationPanel::showItemInfo()
 
 void InformationPanel::slotFolderStatFinished(KJob* job)
 {
-    m_folderStatJob = nullptr;
     const KIO::UDSEntry entry = static_cast<KIO::StatJob*>(job)->statResult();
     m_content->showItem(KFileItem(entry, m_shownUrl));
 }
@@ -346,8 +358,7 @@ void InformationPanel::slotLeftDirectory(const QString& directory)
 
 void InformationPanel::cancelRequest()
 {
-    delete m_folderStatJob;
-    m_folderStatJob = nullptr;
+    m_requestScope->cancel();
 
     m_infoTimer->stop();
     m_resetUrlTimer->stop();
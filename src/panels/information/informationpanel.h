@@ -12,10 +12,7 @@
 #include <KFileItem>
 
 class InformationPanelContent;
-namespace KIO
-{
-    class Job;
-}
+class JobScope;
 
 /**
  * @brief Panel for showing meta information of one ore more selected items.
@@ -139,7 +136,8 @@ private:
     KFileItem m_fileItem; // file item for m_shownUrl if available (otherwise null)
     KFileItemList m_selection;
 
-    KIO::Job* m_folderStatJob;
+    // Stat job for the shown directory, which is killed by cancelRequest()
+    JobScope* m_requestScope;
 
     InformationPanelContent* m_content;
     bool m_inConfigurationMode = false;
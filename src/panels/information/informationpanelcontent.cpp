@@ -6,6 +6,8 @@
 
 #include "informationpanelcontent.h"
 
+#include "kitemviews/private/kpluginregistry.h"
+
 #include <KIO/JobUiDelegate>
 #include <KIO/PreviewJob>
 #include <KConfigGroup>
@@ -19,6 +21,7 @@
 #include <QPainterPath>
 
 #include <QIcon>
+#include <QImage>
 #include <QTextDocument>
 
 #include <Baloo/FileMetaDataWidget>
@@ -44,17 +47,21 @@
 #include <QGesture>
 
 #include "dolphin_informationpanelsettings.h"
+#include "kitemviews/private/kpreviewcache.h"
 #include "phononwidget.h"
 #include "pixmapviewer.h"
 
 const int PLAY_ARROW_SIZE = 24;
 const int PLAY_ARROW_BORDER_SIZE = 2;
+const int MAX_CACHED_PREVIEWS = 32;
 
 InformationPanelContent::InformationPanelContent(QWidget* parent) :
     QWidget(parent),
     m_item(),
     m_previewJob(nullptr),
     m_outdatedPreviewTimer(nullptr),
+    m_previewCancelled(false),
+    m_previewCache(MAX_CACHED_PREVIEWS),
     m_preview(nullptr),
     m_phononWidget(nullptr),
     m_nameLabel(nullptr),
@@ -180,6 +187,16 @@ void InformationPanelContent::refreshPixmapView()
         m_previewJob->kill();
     }
 
+    m_previewCancelled = false;
+
+    const KConfigGroup globalConfig(KSharedConfig::openConfig(), "PreviewSettings");
+    const QStringList plugins = globalConfig.readEntry("Plugins", KPluginRegistry::instance().defaultPreviewPlugins());
+    const QSize size(m_preview->width(), m_preview->height());
+    if (showCachedPreview(size, plugins)) {
+        m_outdatedPreviewTimer->stop();
+        return;
+    }
+
     // try to get a preview pixmap from the item...
 
     // Mark the currently shown preview as outdated. This is done
@@ -187,11 +204,7 @@ void InformationPanelContent::refreshPixmapView()
     // can be shown within a short timeframe.
     m_outdatedPreviewTimer->start();
 
-    const KConfigGroup globalConfig(KSharedConfig::openConfig(), "PreviewSettings");
-    const QStringList plugins = globalConfig.readEntry("Plugins", KIO::PreviewJob::defaultPlugins());
-    m_previewJob = new KIO::PreviewJob(KFileItemList() << m_item,
-                                       QSize(m_preview->width(), m_preview->height()),
-                                       &plugins);
+    m_previewJob = new KIO::PreviewJob(KFileItemList() << m_item, size, &plugins);
     m_previewJob->setScaleType(KIO::PreviewJob::Unscaled);
     m_previewJob->setIgnoreMaximumSize(m_item.isLocalFile());
     if (m_previewJob->uiDelegate()) {
@@ -199,11 +212,78 @@ void InformationPanelContent::refreshPixmapView()
     }
 
     connect(m_previewJob.data(), &KIO::PreviewJob::gotPreview,
-            this, &InformationPanelContent::showPreview);
+            this, [this, size, plugins](const KFileItem& item, const QPixmap& pixmap) {
+        cachePreview(item, size, plugins, pixmap);
+        showPreview(item, pixmap);
+    });
     connect(m_previewJob.data(), &KIO::PreviewJob::failed,
             this, &InformationPanelContent::showIcon);
 }
 
+void InformationPanelContent::cancelPreview()
+{
+    if (m_previewJob) {
+        m_previewJob->kill();
+        m_previewCancelled = true;
+    }
+}
+
+void InformationPanelContent::resumePreview()
+{
+    if (m_previewCancelled && !m_item.isNull() && m_preview->isVisible()) {
+        refreshPixmapView();
+    }
+}
+
+bool InformationPanelContent::showCachedPreview(const QSize& size, const QStringList& plugins)
+{
+    const QString key = previewCacheKey(m_item, size);
+    if (key.isEmpty()) {
+        return false;
+    }
+
+    if (const QPixmap* pixmap = m_previewCache.object(key)) {
+        showPreview(m_item, *pixmap);
+        return true;
+    }
+
+    // The view stores its previews in the same cache, so the preview
+    // is available if the view has already used the same size.
+    const QImage image = KPreviewCache::instance().find(m_item, size, plugins);
+    if (image.isNull()) {
+        return false;
+    }
+
+    const QPixmap pixmap = QPixmap::fromImage(image);
+    m_previewCache.insert(key, new QPixmap(pixmap));
+    showPreview(m_item, pixmap);
+    return true;
+}
+
+void InformationPanelContent::cachePreview(const KFileItem& item, const QSize& size,
+                                           const QStringList& plugins, const QPixmap& pixmap)
+{
+    const QString key = previewCacheKey(item, size);
+    if (key.isEmpty() || pixmap.isNull()) {
+        return;
+    }
+
+    m_previewCache.insert(key, new QPixmap(pixmap));
+    KPreviewCache::instance().insert(item, size, plugins, pixmap.toImage());
+}
+
+QString InformationPanelContent::previewCacheKey(const KFileItem& item, const QSize& size)
+{
+    const QDateTime modificationTime = item.time(KFileItem::ModificationTime);
+    if (!modificationTime.isValid()) {
+        return QString();
+    }
+
+    return item.url().toString() + QLatin1Char('|')
+           + QString::number(modificationTime.toMSecsSinceEpoch()) + QLatin1Char('|')
+           + QString::number(size.width()) + QLatin1Char('x') + QString::number(size.height());
+}
+
 void InformationPanelContent::refreshPreview()
 {
     // If there is a preview job, kill it to prevent that we have jobs for
@@ -211,6 +291,7 @@ void InformationPanelContent::refreshPreview()
     if (m_previewJob) {
         m_previewJob->kill();
     }
+    m_previewCancelled = false;
 
     m_preview->setCursor(Qt::ArrowCursor);
     setNameLabelText(m_item.text());
@@ -228,14 +309,15 @@ void InformationPanelContent::refreshPreview()
                 QIcon::fromTheme(QStringLiteral("baloo")).pixmap(m_preview->height(), m_preview->width())
             );
         } else {
-
-            refreshPixmapView();
-
             const QString mimeType = m_item.mimetype();
             const bool isAnimatedImage = m_preview->isAnimatedMimeType(mimeType);
             m_isVideo = !isAnimatedImage && mimeType.startsWith(QLatin1String("video/"));
             bool usePhonon = m_isVideo || mimeType.startsWith(QLatin1String("audio/"));
 
+            // A cached preview is shown immediately, so m_isVideo
+            // must be up to date before the pixmap view is refreshed.
+            refreshPixmapView();
+
             if (usePhonon) {
                 // change the cursor of the preview
                 m_preview->setCursor(Qt::PointingHandCursor);
@@ -265,7 +347,7 @@ void InformationPanelContent::refreshPreview()
                 }
             } else {
                 if (isAnimatedImage) {
-                    m_preview->setAnimatedImageFileName(itemUrl.toLocalFile());
+                    m_preview->setAnimatedImageFileName(itemUrl.toLocalFile(), m_item.time(KFileItem::ModificationTime));
                 }
                 // When we don't need it, hide the phonon widget first to avoid flickering
                 m_phononWidget->hide();
@@ -10,6 +10,7 @@
 #include <KFileItem>
 #include <config-baloo.h>
 
+#include <QCache>
 #include <QPointer>
 #include <QUrl>
 #include <QWidget>
@@ -64,6 +65,19 @@ public:
      */
     void refreshPreview();
 
+    /**
+     * Cancels the generation of the preview for the shown item, as another
+     * item is about to be shown. The shown item keeps its current content.
+     * @see resumePreview()
+     */
+    void cancelPreview();
+
+    /**
+     * Generates the preview for the shown item again, if the generation
+     * has been cancelled by cancelPreview() before it has been finished.
+     */
+    void resumePreview();
+
     /**
      * Switch the metadatawidget into configuration mode
      */
@@ -135,6 +149,27 @@ private:
      */
     void refreshPixmapView();
 
+    /**
+     * Shows the preview with the size \a size for the shown item, if it has been
+     * generated before by the Information Panel or by the view.
+     * @return True if a cached preview has been shown.
+     */
+    bool showCachedPreview(const QSize& size, const QStringList& plugins);
+
+    /**
+     * Remembers the generated preview \a pixmap for \a item, so that it
+     * can be shown without a preview job the next time.
+     */
+    void cachePreview(const KFileItem& item, const QSize& size,
+                      const QStringList& plugins, const QPixmap& pixmap);
+
+    /**
+     * @return Key for the preview of \a item with the size \a size, which
+     *         is based on the URL and the modification time of the item.
+     *         An empty string is returned if the item has no modification time.
+     */
+    static QString previewCacheKey(const KFileItem& item, const QSize& size);
+
     bool gestureEvent(QGestureEvent* event);
 
 private:
@@ -142,6 +177,11 @@ private:
 
     QPointer<KIO::PreviewJob> m_previewJob;
     QTimer* m_outdatedPreviewTimer;
+    bool m_previewCancelled;
+
+    // Previews of the recently shown items. The global preview cache is shared
+    // by all processes, looking up the previews in memory is faster.
+    QCache<QString, QPixmap> m_previewCache;
 
     PixmapViewer* m_preview;
     PhononWidget* m_phononWidget;
@@ -6,6 +6,8 @@
 
 #include "pixmapviewer.h"
 
+#include "kitemviews/private/ktaskscheduler.h"
+
 #include <KIconLoader>
 
 #include <QImageReader>
@@ -13,9 +15,34 @@
 #include <QPainter>
 #include <QStyle>
 
+namespace {
+    // Maximum cost in KiB of the decoded frames of one animated image
+    // and of all cached animated images
+    const int MaximumFramesCost = 32 * 1024;
+    const int MaximumFramesCacheCost = 64 * 1024;
+
+    // Browsers use the same delay for frames without a delay
+    const int MinimumFrameDelay = 20;
+    const int DefaultFrameDelay = 100;
+}
+
 PixmapViewer::PixmapViewer(QWidget* parent, Transition transition) :
     QWidget(parent),
+    m_pixmap(),
+    m_oldPixmap(),
+    m_animatedImageFileName(),
+    m_animatedImageModificationTime(),
     m_animatedImage(nullptr),
+    m_frames(),
+    m_frameIndex(0),
+    m_frameTimer(),
+    m_framesCache(MaximumFramesCacheCost),
+    m_decodingWatcher(nullptr),
+    m_decodingKey(),
+    m_decodingSize(),
+    m_decodingCanceled(),
+    m_pendingPixmaps(),
+    m_animation(),
     m_transition(transition),
     m_animationStep(0),
     m_sizeHint(),
@@ -31,10 +58,14 @@ PixmapViewer::PixmapViewer(QWidget* parent, Transition transition) :
         connect(&m_animation, &QTimeLine::valueChanged, this, QOverload<>::of(&PixmapViewer::update));
         connect(&m_animation, &QTimeLine::finished, this, &PixmapViewer::checkPendingPixmaps);
     }
+
+    m_frameTimer.setSingleShot(true);
+    connect(&m_frameTimer, &QTimer::timeout, this, &PixmapViewer::showNextFrame);
 }
 
 PixmapViewer::~PixmapViewer()
 {
+    cancelDecoding();
 }
 
 void PixmapViewer::setPixmap(const QPixmap& pixmap)
@@ -44,7 +75,7 @@ void PixmapViewer::setPixmap(const QPixmap& pixmap)
     }
 
     // Avoid flicker with static pixmap if an animated image is running
-    if (m_animatedImage && m_animatedImage->state() == QMovie::Running) {
+    if (isAnimationRunning()) {
         return;
     }
 
@@ -68,17 +99,18 @@ void PixmapViewer::setPixmap(const QPixmap& pixmap)
     } else if (m_hasAnimatedImage) {
         // If there is no transition animation but an animatedImage
         // and it is not already running, start animating now
-        if (m_animatedImage->state() != QMovie::Running) {
-            m_animatedImage->setScaledSize(m_pixmap.size());
-            m_animatedImage->start();
-        }
+        startAnimatedImage();
     }
 }
 
 void PixmapViewer::setSizeHint(const QSize& size)
 {
-    if (m_animatedImage && size != m_sizeHint) {
-        m_animatedImage->stop();
+    if (size != m_sizeHint) {
+        // The animation is started again at the new size of the pixmap
+        m_frameTimer.stop();
+        if (m_animatedImage) {
+            m_animatedImage->stop();
+        }
     }
 
     m_sizeHint = size;
@@ -90,19 +122,22 @@ QSize PixmapViewer::sizeHint() const
     return m_sizeHint;
 }
 
-void PixmapViewer::setAnimatedImageFileName(const QString &fileName)
+void PixmapViewer::setAnimatedImageFileName(const QString &fileName, const QDateTime& modificationTime)
 {
-    if (!m_animatedImage) {
-        m_animatedImage = new QMovie(this);
-        connect(m_animatedImage, &QMovie::frameChanged, this, &PixmapViewer::updateAnimatedImageFrame);
-    }
-
-    if (m_animatedImage->fileName() != fileName) {
-        m_animatedImage->stop();
-        m_animatedImage->setFileName(fileName);
+    if (m_animatedImageFileName != fileName || m_animatedImageModificationTime != modificationTime) {
+        stopAnimatedImage();
+        cancelDecoding();
+        m_frames = Frames();
+        if (m_animatedImage) {
+            m_animatedImage->setFileName(QString());
+        }
+        m_animatedImageFileName = fileName;
+        m_animatedImageModificationTime = modificationTime;
     }
 
-    m_hasAnimatedImage = m_animatedImage->isValid() && (m_animatedImage->frameCount() > 1);
+    // Whether the image can be read and has more than one frame is
+    // known after decoding, see slotFramesDecoded()
+    m_hasAnimatedImage = !fileName.isEmpty();
 }
 
 
@@ -111,7 +146,7 @@ QString PixmapViewer::animatedImageFileName() const
     if (!m_hasAnimatedImage) {
         return QString();
     }
-    return m_animatedImage->fileName();
+    return m_animatedImageFileName;
 }
 
 void PixmapViewer::paintEvent(QPaintEvent* event)
@@ -120,7 +155,7 @@ void PixmapViewer::paintEvent(QPaintEvent* event)
 
     QPainter painter(this);
 
-    if (m_transition != NoTransition || (m_hasAnimatedImage && m_animatedImage->state() != QMovie::Running)) {
+    if (m_transition != NoTransition || (m_hasAnimatedImage && !isAnimationRunning())) {
         const float value = m_animation.currentValue();
         const int scaledWidth  = static_cast<int>((m_oldPixmap.width()  * (1.0 - value)) + (m_pixmap.width()  * value));
         const int scaledHeight = static_cast<int>((m_oldPixmap.height() * (1.0 - value)) + (m_pixmap.height() * value));
@@ -150,8 +185,7 @@ void PixmapViewer::checkPendingPixmaps()
         update();
         m_animation.start();
     } else if (m_hasAnimatedImage) {
-        m_animatedImage->setScaledSize(m_pixmap.size());
-        m_animatedImage->start();
+        startAnimatedImage();
     } else {
         m_oldPixmap = m_pixmap;
     }
@@ -165,10 +199,30 @@ void PixmapViewer::updateAnimatedImageFrame()
     update();
 }
 
+void PixmapViewer::showNextFrame()
+{
+    if (m_frames.pixmaps.isEmpty()) {
+        return;
+    }
+
+    if (m_frameIndex >= m_frames.pixmaps.count()) {
+        m_frameIndex = 0;
+    }
+    m_pixmap = m_frames.pixmaps.at(m_frameIndex);
+    update();
+
+    m_frameTimer.start(m_frames.delays.at(m_frameIndex));
+    ++m_frameIndex;
+}
+
 void PixmapViewer::stopAnimatedImage()
 {
     if (m_hasAnimatedImage) {
-        m_animatedImage->stop();
+        m_frameTimer.stop();
+        if (m_animatedImage) {
+            m_animatedImage->stop();
+        }
+        cancelDecoding();
         m_hasAnimatedImage = false;
     }
 }
@@ -179,3 +233,165 @@ bool PixmapViewer::isAnimatedMimeType(const QString &mimeType)
     return std::any_of(imageFormats.begin(), imageFormats.end(),
                        [](const QByteArray &format){ return QMovie::supportedFormats().contains(format); });
 }
+
+int PixmapViewer::Frames::cost() const
+{
+    qint64 bytes = 0;
+    for (const QImage& image : images) {
+        bytes += image.sizeInBytes();
+    }
+    for (const QPixmap& pixmap : pixmaps) {
+        bytes += qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+    }
+    return static_cast<int>(bytes / 1024);
+}
+
+void PixmapViewer::startAnimatedImage()
+{
+    if (isAnimationRunning() || m_animatedImageFileName.isEmpty() || m_pixmap.isNull()) {
+        return;
+    }
+
+    const QSize size = m_pixmap.size();
+    if (m_animatedImage && m_animatedImage->fileName() == m_animatedImageFileName) {
+        // The frames of the image are too large for the cache
+        m_animatedImage->setScaledSize(size);
+        m_animatedImage->start();
+        return;
+    }
+
+    const QString key = framesKey(m_animatedImageFileName, m_animatedImageModificationTime, size);
+    if (!m_frames.pixmaps.isEmpty() && m_frames.pixmaps.first().size() == size) {
+        // Continue with the current frame after the animation has been stopped
+    } else if (const Frames* cachedFrames = key.isEmpty() ? nullptr : m_framesCache.object(key)) {
+        m_frames = *cachedFrames;
+        m_frameIndex = 0;
+    } else {
+        if (m_decodingWatcher && m_decodingSize == size) {
+            return;
+        }
+        cancelDecoding();
+
+        m_decodingKey = key;
+        m_decodingSize = size;
+        m_decodingCanceled = CancelFlag(new std::atomic<bool>(false));
+        m_decodingWatcher = new QFutureWatcher<Frames>(this);
+        QFutureWatcher<Frames>* watcher = m_decodingWatcher;
+        connect(watcher, &QFutureWatcher<Frames>::finished, this, [this, watcher]() {
+            slotFramesDecoded(watcher);
+        });
+        watcher->setFuture(KTaskScheduler::instance().run(KTaskScheduler::Visible, &PixmapViewer::decodeFrames,
+                                                          m_animatedImageFileName, size, m_decodingCanceled));
+        return;
+    }
+
+    showNextFrame();
+}
+
+void PixmapViewer::cancelDecoding()
+{
+    if (m_decodingWatcher) {
+        m_decodingCanceled->store(true);
+        m_decodingWatcher->disconnect(this);
+        m_decodingWatcher->deleteLater();
+        m_decodingWatcher = nullptr;
+        m_decodingKey.clear();
+        m_decodingSize = QSize();
+    }
+}
+
+bool PixmapViewer::isAnimationRunning() const
+{
+    return m_frameTimer.isActive() || (m_animatedImage && m_animatedImage->state() == QMovie::Running);
+}
+
+void PixmapViewer::slotFramesDecoded(QFutureWatcher<Frames>* watcher)
+{
+    watcher->deleteLater();
+    m_decodingWatcher = nullptr;
+    const QString key = m_decodingKey;
+    m_decodingKey.clear();
+    m_decodingSize = QSize();
+
+    Frames frames = watcher->result();
+    if (frames.complete && frames.images.count() > 1) {
+        // The images are converted once instead of for each shown frame
+        frames.pixmaps.reserve(frames.images.count());
+        for (const QImage& image : qAsConst(frames.images)) {
+            frames.pixmaps.append(QPixmap::fromImage(image));
+        }
+        frames.images.clear();
+    }
+
+    if (!frames.complete) {
+        if (!m_animatedImage) {
+            m_animatedImage = new QMovie(this);
+            connect(m_animatedImage, &QMovie::frameChanged, this, &PixmapViewer::updateAnimatedImageFrame);
+        }
+        m_animatedImage->setFileName(m_animatedImageFileName);
+    } else if (frames.pixmaps.count() > 1 && !key.isEmpty()) {
+        m_framesCache.insert(key, new Frames(frames), qMax(1, frames.cost()));
+    }
+
+    if (!frames.complete || frames.pixmaps.count() > 1) {
+        m_frames = frames.complete ? frames : Frames();
+        m_frameIndex = 0;
+        startAnimatedImage();
+    } else {
+        // A single image is shown by the preview already
+        m_hasAnimatedImage = false;
+        update();
+    }
+}
+
+PixmapViewer::Frames PixmapViewer::decodeFrames(const QString& fileName, const QSize& size, CancelFlag canceled)
+{
+    Frames frames;
+
+    QImageReader reader(fileName);
+    reader.setScaledSize(size);
+    const int imageCount = reader.imageCount();
+    const bool hasSingleImage = (imageCount == 1);
+
+    // If the header tells the number of images, too large animations are
+    // played by QMovie without decoding them first
+    if (imageCount > 0 && qint64(size.width()) * size.height() * 4 * imageCount / 1024 > MaximumFramesCost) {
+        return frames;
+    }
+
+    qint64 bytes = 0;
+    while (!canceled->load()) {
+        const QImage image = reader.read();
+        if (image.isNull()) {
+            frames.complete = true;
+            break;
+        }
+
+        bytes += image.sizeInBytes();
+        if (bytes / 1024 > MaximumFramesCost) {
+            frames.images.clear();
+            frames.delays.clear();
+            break;
+        }
+
+        // The images are converted to pixmaps without a conversion of the format
+        frames.images.append(image.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+        const int delay = reader.nextImageDelay();
+        frames.delays.append(delay < MinimumFrameDelay ? DefaultFrameDelay : delay);
+
+        if (hasSingleImage) {
+            frames.complete = true;
+            break;
+        }
+    }
+
+    return frames;
+}
+
+QString PixmapViewer::framesKey(const QString& fileName, const QDateTime& modificationTime, const QSize& size)
+{
+    if (!modificationTime.isValid()) {
+        return QString();
+    }
+    return QStringLiteral("%1 %2x%3 %4").arg(fileName).arg(size.width()).arg(size.height()).arg(modificationTime.toMSecsSinceEpoch());
+}
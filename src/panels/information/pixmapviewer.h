@@ -7,11 +7,20 @@
 #ifndef PIXMAPVIEWER_H
 #define PIXMAPVIEWER_H
 
+#include <QCache>
+#include <QDateTime>
+#include <QFutureWatcher>
+#include <QImage>
 #include <QPixmap>
 #include <QQueue>
+#include <QSharedPointer>
 #include <QTimeLine>
+#include <QTimer>
+#include <QVector>
 #include <QWidget>
 
+#include <atomic>
+
 class QPaintEvent;
 class QMovie;
 
@@ -20,6 +29,11 @@ class QMovie;
  *
  * When the pixmap is changed, a smooth transition is done from the old pixmap
  * to the new pixmap.
+ *
+ * The frames of animated images are decoded in a worker thread at the size of
+ * the pixmap and converted to pixmaps once. The frames of the last files are
+ * cached, so that the animation is shown at once if a file is shown again.
+ * Animations whose frames would exceed the cache are played by QMovie.
  */
 class PixmapViewer : public QWidget
 {
@@ -61,7 +75,12 @@ public:
     void setSizeHint(const QSize& size);
     QSize sizeHint() const override;
 
-    void setAnimatedImageFileName(const QString& fileName);
+    /**
+     * Animates the image \a fileName, which has been modified at
+     * \a modificationTime. The file is only read in a worker thread. If
+     * \a modificationTime is invalid, the decoded frames are not cached.
+     */
+    void setAnimatedImageFileName(const QString& fileName, const QDateTime& modificationTime = QDateTime());
     QString animatedImageFileName() const;
 
     void stopAnimatedImage();
@@ -77,11 +96,56 @@ protected:
 private Q_SLOTS:
     void checkPendingPixmaps();
     void updateAnimatedImageFrame();
+    void showNextFrame();
+
+private:
+    typedef QSharedPointer<std::atomic<bool> > CancelFlag;
+
+    struct Frames
+    {
+        QVector<QImage> images;     // Decoded by the worker thread
+        QVector<QPixmap> pixmaps;   // Converted from the images in the GUI thread
+        QVector<int> delays;        // Milliseconds of each frame
+        bool complete = false;      // False if the cost of the images is too large
+        int cost() const;           // KiB
+    };
+
+    /**
+     * Starts the animation of m_animatedImageFileName at the size of the
+     * pixmap. The frames are decoded first if they are not cached.
+     */
+    void startAnimatedImage();
+    void cancelDecoding();
+    bool isAnimationRunning() const;
+    void slotFramesDecoded(QFutureWatcher<Frames>* watcher);
+
+    /**
+     * Decodes all frames of the image \a fileName scaled to \a size
+     * as long as their cost stays below the maximum cost. If the header
+     * tells that the frames exceed the maximum cost, nothing is decoded.
+     */
+    static Frames decodeFrames(const QString& fileName, const QSize& size, CancelFlag canceled);
+
+    /**
+     * @return Key of the frames of \a fileName modified at \a modificationTime
+     *         and decoded at \a size, or an empty key if the time is unknown.
+     */
+    static QString framesKey(const QString& fileName, const QDateTime& modificationTime, const QSize& size);
 
 private:
     QPixmap m_pixmap;
     QPixmap m_oldPixmap;
+    QString m_animatedImageFileName;
+    QDateTime m_animatedImageModificationTime;
     QMovie* m_animatedImage;
+    Frames m_frames;
+    int m_frameIndex;
+    QTimer m_frameTimer;
+    QCache<QString, Frames> m_framesCache;
+    QFutureWatcher<Frames>* m_decodingWatcher;
+    QString m_decodingKey;
+    QSize m_decodingSize;
+    CancelFlag m_decodingCanceled;
     QQueue<QPixmap> m_pendingPixmaps;
     QTimeLine m_animation;
     Transition m_transition;
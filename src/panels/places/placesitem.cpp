@@ -196,8 +196,7 @@ void PlacesItem::initializeDevice(const QString& udi)
     m_disc = m_device.as<Solid::OpticalDisc>();
     m_player = m_device.as<Solid::PortableMediaPlayer>();
 
-    setText(m_device.displayName());
-    setIcon(m_device.icon());
+    // The text and the icon are provided by the source model, see PlacesItemModel::updateItem()
     setIconOverlays(m_device.emblems());
     setUdi(udi);
 
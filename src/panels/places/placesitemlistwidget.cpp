@@ -6,23 +6,22 @@
 
 #include "placesitemlistwidget.h"
 
+#include "statusbar/spaceinfoobserver.h"
+
 #include <QStyleOption>
 #include <QPainter>
 
 #include <KColorScheme>
 
-#include <KIO/FileSystemFreeSpaceJob>
-#include <Solid/Device>
-#include <Solid/NetworkShare>
-
 #define CAPACITYBAR_HEIGHT 2
 #define CAPACITYBAR_MARGIN 2
-#define CAPACITYBAR_CACHE_TTL 60000
-
 
 PlacesItemListWidget::PlacesItemListWidget(KItemListWidgetInformant* informant, QGraphicsItem* parent) :
     KStandardItemListWidget(informant, parent)
     , m_drawCapacityBar(false)
+    , m_usedRatio(0)
+    , m_capacityBarUrl()
+    , m_spaceInfoObserver(nullptr)
 {
 }
 
@@ -43,56 +42,51 @@ QPalette::ColorRole PlacesItemListWidget::normalTextColorRole() const
 
 void PlacesItemListWidget::updateCapacityBar()
 {
-    const QString udi = data().value("udi").toString();
-    if (udi.isEmpty()) {
-        resetCapacityBar();
-        return;
-    }
-    const Solid::Device device = Solid::Device(udi);
-    if (device.isDeviceInterface(Solid::DeviceInterface::NetworkShare)
-            || device.isDeviceInterface(Solid::DeviceInterface::OpticalDrive)
-            || device.isDeviceInterface(Solid::DeviceInterface::OpticalDisc)) {
+    // Whether a capacity bar is recommended for a device is provided by the
+    // places model, so that Solid does not need to be asked on each paint.
+    const QUrl url = data().value("url").toUrl();
+    if (!data().value("capacityBarRecommended").toBool() || url.isEmpty()) {
         resetCapacityBar();
         return;
     }
-    const QUrl url = data().value("url").toUrl();
 
-    if (url.isEmpty() || m_freeSpaceInfo.job || !m_freeSpaceInfo.lastUpdated.hasExpired()) {
-        // No url, job running or cache is still valid.
-        return;
+    // Is invoked on each paint, so the observer is only
+    // changed if another place is shown by the widget
+    if (url != m_capacityBarUrl || !m_spaceInfoObserver) {
+        m_capacityBarUrl = url;
+        if (m_spaceInfoObserver) {
+            m_spaceInfoObserver->setUrl(url);
+        } else {
+            m_spaceInfoObserver = new SpaceInfoObserver(url, this);
+            connect(m_spaceInfoObserver, &SpaceInfoObserver::valuesChanged,
+                    this, &PlacesItemListWidget::slotFreeSpaceRetrieved);
+        }
     }
 
-    m_freeSpaceInfo.job = KIO::fileSystemFreeSpace(url);
-    connect(
-        m_freeSpaceInfo.job,
-        &KIO::FileSystemFreeSpaceJob::result,
-        this,
-        [this](KIO::Job *job, KIO::filesize_t size, KIO::filesize_t available) {
-            // even if we receive an error we want to refresh lastUpdated to avoid repeatedly querying in this case
-            m_freeSpaceInfo.lastUpdated.setRemainingTime(CAPACITYBAR_CACHE_TTL);
-
-            if (job->error()) {
-                return;
-            }
-
-            m_freeSpaceInfo.size = size;
-            m_freeSpaceInfo.used = size - available;
-            m_freeSpaceInfo.usedRatio = (qreal)m_freeSpaceInfo.used / (qreal)m_freeSpaceInfo.size;
-            m_drawCapacityBar = size > 0;
-
-            update();
-        }
-    );
+    const quint64 size = m_spaceInfoObserver->size();
+    m_drawCapacityBar = m_spaceInfoObserver->hasData() && size > 0;
+    m_usedRatio = m_drawCapacityBar ? qreal(size - m_spaceInfoObserver->available()) / qreal(size) : 0;
 }
 
 void PlacesItemListWidget::resetCapacityBar()
 {
     m_drawCapacityBar = false;
-    delete m_freeSpaceInfo.job;
-    m_freeSpaceInfo.lastUpdated.setRemainingTime(0);
-    m_freeSpaceInfo.size = 0;
-    m_freeSpaceInfo.used = 0;
-    m_freeSpaceInfo.usedRatio = 0;
+    m_usedRatio = 0;
+    m_capacityBarUrl = QUrl();
+    delete m_spaceInfoObserver;
+    m_spaceInfoObserver = nullptr;
+}
+
+void PlacesItemListWidget::slotFreeSpaceRetrieved()
+{
+    const bool drawCapacityBar = m_drawCapacityBar;
+    const qreal usedRatio = m_usedRatio;
+
+    updateCapacityBar();
+
+    if (m_drawCapacityBar != drawCapacityBar || m_usedRatio != usedRatio) {
+        update();
+    }
 }
 
 void PlacesItemListWidget::polishEvent()
@@ -130,8 +124,8 @@ void PlacesItemListWidget::paint(QPainter* painter, const QStyleOptionGraphicsIt
             painter->fillRect(capacityRect, bgColor);
 
             // Fill
-            const QRect fillRect(capacityRect.x(), capacityRect.y(), capacityRect.width() * m_freeSpaceInfo.usedRatio, capacityRect.height());
-            if (m_freeSpaceInfo.usedRatio >= 0.95) { // More than 95% full!
+            const QRect fillRect(capacityRect.x(), capacityRect.y(), capacityRect.width() * m_usedRatio, capacityRect.height());
+            if (m_usedRatio >= 0.95) { // More than 95% full!
                 const QColor dangerUsedColor = KColorScheme(group, KColorScheme::View).foreground(KColorScheme::NegativeText).color();
                 painter->fillRect(fillRect, dangerUsedColor);
             } else {
@@ -9,25 +9,12 @@
 
 #include "kitemviews/kstandarditemlistwidget.h"
 
-#include <QDeadlineTimer>
 #include <QPainter>
-#include <QPointer>
 #include <QStyleOptionGraphicsItem>
+#include <QUrl>
 #include <QWidget>
 
-#include <KIO/FileSystemFreeSpaceJob>
-
-
-// The free space / capacity bar is based on KFilePlacesView.
-// https://invent.kde.org/frameworks/kio/-/commit/933887dc334f3498505af7a86d25db7faae91019
-struct PlaceFreeSpaceInfo
-{
-    QDeadlineTimer lastUpdated;
-    KIO::filesize_t used = 0;
-    KIO::filesize_t size = 0;
-    qreal usedRatio = 0;
-    QPointer<KIO::FileSystemFreeSpaceJob> job;
-};
+class SpaceInfoObserver;
 
 
 /**
@@ -51,9 +38,19 @@ protected:
     void updateCapacityBar();
     void resetCapacityBar();
 
+private:
+    void slotFreeSpaceRetrieved();
+
 private:
     bool m_drawCapacityBar;
-    PlaceFreeSpaceInfo m_freeSpaceInfo;
+    qreal m_usedRatio;
+
+    // The free space / capacity bar is based on KFilePlacesView.
+    // https://invent.kde.org/frameworks/kio/-/commit/933887dc334f3498505af7a86d25db7faae91019
+    // The free space is retrieved by the observers of the mount points, which
+    // are shared by all widgets and the status bars, see MountPointObserver.
+    QUrl m_capacityBarUrl;
+    SpaceInfoObserver* m_spaceInfoObserver;
 };
 
 #endif
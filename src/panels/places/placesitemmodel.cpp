@@ -31,13 +31,27 @@
 #include <QMimeData>
 #include <QTimer>
 
+#include <algorithm>
+
+namespace {
+    const int SourceDataChangedDelay = 100;
+}
+
 PlacesItemModel::PlacesItemModel(QObject* parent) :
     KStandardItemModel(parent),
     m_hiddenItemsShown(false),
     m_deviceToTearDown(nullptr),
     m_storageSetupInProgress(),
-    m_sourceModel(DolphinPlacesModelSingleton::instance().placesModel())
+    m_sourceModel(DolphinPlacesModelSingleton::instance().placesModel()),
+    m_indexMap(),
+    m_changedSourceIndexes(),
+    m_sourceDataChangedTimer(nullptr)
 {
+    m_sourceDataChangedTimer = new QTimer(this);
+    m_sourceDataChangedTimer->setSingleShot(true);
+    m_sourceDataChangedTimer->setInterval(SourceDataChangedDelay);
+    connect(m_sourceDataChangedTimer, &QTimer::timeout, this, &PlacesItemModel::applySourceModelDataChanges);
+
     cleanupBookmarks();
     loadBookmarks();
     initializeDefaultViewProperties();
@@ -107,38 +121,38 @@ bool PlacesItemModel::hiddenItemsShown() const
 
 int PlacesItemModel::closestItem(const QUrl& url) const
 {
+    // An item with the same URL is always the closest item
+    const int index = indexForUrl(url);
+    if (index >= 0) {
+        return index;
+    }
+
     return mapFromSource(m_sourceModel->closestItem(url));
 }
 
 // look for the correct position for the item based on source model
-void PlacesItemModel::insertSortedItem(PlacesItem* item)
+void PlacesItemModel::insertSortedItem(PlacesItem* item, const QModelIndex& sourceIndex)
 {
     if (!item) {
         return;
     }
 
-    const KBookmark iBookmark = item->bookmark();
-    const QString iBookmarkId = bookmarkId(iBookmark);
-    QModelIndex sourceIndex;
-    int pos = 0;
-
-    for(int r = 0, rMax = m_sourceModel->rowCount(); r < rMax; r++) {
-        sourceIndex = m_sourceModel->index(r, 0);
-        const KBookmark sourceBookmark = m_sourceModel->bookmarkForIndex(sourceIndex);
-
-        if (bookmarkId(sourceBookmark) == iBookmarkId) {
-            break;
-        }
-
-        if (m_hiddenItemsShown || !m_sourceModel->isHidden(sourceIndex)) {
-            pos++;
-        }
-    }
+    const auto it = std::lower_bound(m_indexMap.constBegin(), m_indexMap.constEnd(), sourceIndex.row(),
+                                     [](const QPersistentModelIndex& index, int row) {
+                                         return index.row() < row;
+                                     });
+    const int pos = it - m_indexMap.constBegin();
 
     m_indexMap.insert(pos, sourceIndex);
     insertItem(pos, item);
 }
 
+QString PlacesItemModel::itemKey(const KStandardItem* item) const
+{
+    const PlacesItem* placesItem = dynamic_cast<const PlacesItem*>(item);
+    return placesItem ? bookmarkId(placesItem->bookmark()) : QString();
+}
+
 void PlacesItemModel::onItemInserted(int index)
 {
     KStandardItemModel::onItemInserted(index);
@@ -363,27 +377,29 @@ void PlacesItemModel::addItemFromSourceModel(const QModelIndex &index)
         return;
     }
 
+    insertSortedItem(createItemFromSourceModel(index), index);
+}
+
+PlacesItem *PlacesItemModel::createItemFromSourceModel(const QModelIndex &index)
+{
     const KBookmark bookmark = m_sourceModel->bookmarkForIndex(index);
     Q_ASSERT(!bookmark.isNull());
     PlacesItem *item = new PlacesItem(bookmark);
     updateItem(item, index);
-    insertSortedItem(item);
 
     if (m_sourceModel->isDevice(index)) {
         connect(item->signalHandler(), &PlacesItemSignalHandler::tearDownExternallyRequested,
                 this, &PlacesItemModel::storageTearDownExternallyRequested);
     }
+    return item;
 }
 
 void PlacesItemModel::removeItemByIndex(const QModelIndex &sourceIndex)
 {
-    QString id = bookmarkId(m_sourceModel->bookmarkForIndex(sourceIndex));
-
-    for (int i = 0, iMax = count(); i < iMax; ++i) {
-        if (bookmarkId(placesItem(i)->bookmark()) == id) {
-            removeItem(i);
-            return;
-        }
+    const QString id = bookmarkId(m_sourceModel->bookmarkForIndex(sourceIndex));
+    const KStandardItem* item = itemForKey(id);
+    if (item) {
+        removeItem(index(item));
     }
 }
 
@@ -442,9 +458,18 @@ void PlacesItemModel::initializeDefaultViewProperties() const
 
 void PlacesItemModel::updateItem(PlacesItem *item, const QModelIndex &index)
 {
+    // KStandardItem only emits a change if a value differs, so
+    // only the changed roles of the item are updated.
     item->setGroup(index.data(KFilePlacesModel::GroupRole).toString());
     item->setIcon(index.data(KFilePlacesModel::IconNameRole).toString());
     item->setGroupHidden(index.data(KFilePlacesModel::GroupHiddenRole).toBool());
+
+    if (!item->udi().isEmpty()) {
+        // The source model caches the properties of the devices, so
+        // Solid does not need to be asked for them again.
+        item->setText(index.data(Qt::DisplayRole).toString());
+        item->setDataValue("capacityBarRecommended", index.data(KFilePlacesModel::CapacityBarRecommendedRole).toBool());
+    }
 }
 
 void PlacesItemModel::slotStorageTearDownDone(Solid::ErrorType error, const QVariant& errorData)
@@ -561,26 +586,50 @@ void PlacesItemModel::onSourceModelDataChanged(const QModelIndex &topLeft, const
     Q_UNUSED(roles)
 
     for (int r = topLeft.row(); r <= bottomRight.row(); r++) {
-        const QModelIndex sourceIndex = m_sourceModel->index(r, 0);
+        m_changedSourceIndexes.insert(QPersistentModelIndex(m_sourceModel->index(r, 0)));
+    }
+
+    if (!m_sourceDataChangedTimer->isActive()) {
+        m_sourceDataChangedTimer->start();
+    }
+}
+
+void PlacesItemModel::applySourceModelDataChanges()
+{
+    const QSet<QPersistentModelIndex> changedSourceIndexes = m_changedSourceIndexes;
+    m_changedSourceIndexes.clear();
+
+    for (const QPersistentModelIndex& changedIndex : changedSourceIndexes) {
+        if (!changedIndex.isValid()) {
+            // The row has been removed in the meantime
+            continue;
+        }
+
+        const QModelIndex sourceIndex = m_sourceModel->index(changedIndex.row(), 0);
         const KBookmark bookmark = m_sourceModel->bookmarkForIndex(sourceIndex);
         PlacesItem *placeItem = itemFromBookmark(bookmark);
 
         if (placeItem && (!m_hiddenItemsShown && m_sourceModel->isHidden(sourceIndex))) {
             //hide item if it became invisible
             removeItem(index(placeItem));
-            return;
+            continue;
         }
 
         if (!placeItem && (m_hiddenItemsShown || !m_sourceModel->isHidden(sourceIndex))) {
             //show item if it became visible
             addItemFromSourceModel(sourceIndex);
-            return;
+            continue;
+        }
+
+        if (!placeItem) {
+            continue;
         }
 
-        if (placeItem && !m_sourceModel->isDevice(sourceIndex)) {
+        if (!m_sourceModel->isDevice(sourceIndex)) {
             // must update the bookmark object
             placeItem->setBookmark(bookmark);
         }
+        updateItem(placeItem, sourceIndex);
     }
 }
 
@@ -630,12 +679,17 @@ void PlacesItemModel::cleanupBookmarks()
 
 void PlacesItemModel::loadBookmarks()
 {
+    // The items are created in the order of the source model and are
+    // inserted at once.
+    QList<KStandardItem*> items;
     for(int r = 0, rMax = m_sourceModel->rowCount(); r < rMax; r++) {
         const QModelIndex sourceIndex = m_sourceModel->index(r, 0);
         if (m_hiddenItemsShown || !m_sourceModel->isHidden(sourceIndex)) {
-            addItemFromSourceModel(sourceIndex);
+            m_indexMap.append(sourceIndex);
+            items.append(createItemFromSourceModel(sourceIndex));
         }
     }
+    insertItems(count(), items);
 }
 
 void PlacesItemModel::clear() {
@@ -740,7 +794,14 @@ int PlacesItemModel::mapFromSource(const QModelIndex &index) const
         return -1;
     }
 
-    return m_indexMap.indexOf(index);
+    const auto it = std::lower_bound(m_indexMap.constBegin(), m_indexMap.constEnd(), index.row(),
+                                     [](const QPersistentModelIndex& mappedIndex, int row) {
+                                         return mappedIndex.row() < row;
+                                     });
+    if (it != m_indexMap.constEnd() && *it == index) {
+        return it - m_indexMap.constBegin();
+    }
+    return -1;
 }
 
 bool PlacesItemModel::isDir(int index) const
@@ -771,14 +832,6 @@ QModelIndex PlacesItemModel::mapToSource(int row) const
 
 PlacesItem *PlacesItemModel::itemFromBookmark(const KBookmark &bookmark) const
 {
-    const QString id = bookmarkId(bookmark);
-    for (int i = 0, iMax = count(); i < iMax; i++) {
-        PlacesItem *item = placesItem(i);
-        const KBookmark itemBookmark = item->bookmark();
-        if (bookmarkId(itemBookmark) == id) {
-            return item;
-        }
-    }
-    return nullptr;
+    return dynamic_cast<PlacesItem*>(itemForKey(bookmarkId(bookmark)));
 }
 
@@ -21,6 +21,7 @@
 class KBookmark;
 class PlacesItem;
 class QAction;
+class QTimer;
 
 /**
  * @brief Model for maintaining the bookmarks of the places panel.
@@ -133,6 +134,7 @@ Q_SIGNALS:
     void storageTearDownSuccessful();
 
 protected:
+    QString itemKey(const KStandardItem* item) const override;
     void onItemInserted(int index) override;
     void onItemRemoved(int index, KStandardItem* removedItem) override;
     void onItemChanged(int index, const QSet<QByteArray>& changedRoles) override;
@@ -149,6 +151,14 @@ private Q_SLOTS:
     void onSourceModelDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles);
     void onSourceModelGroupHiddenChanged(KFilePlacesModel::GroupType group, bool hidden);
 
+    /**
+     * Updates the items for the source model rows that have been changed
+     * since the last invocation. The changes are collected by
+     * onSourceModelDataChanged(), as devices might change many times in a
+     * short time, e.g. while they are mounted.
+     */
+    void applySourceModelDataChanges();
+
 private:
     /**
      * Remove bookmarks created by the previous version of dolphin that are
@@ -178,17 +188,20 @@ private:
     static bool equalBookmarkIdentifiers(const KBookmark& b1, const KBookmark& b2);
 
     /**
-     * Appends the item \a item as last element of the group
-     * the item belongs to. If no item with the same group is
-     * present, the item gets appended as last element of the
-     * model. PlacesItemModel takes the ownership
-     * of the item.
+     * Inserts the item \a item for the source model index \a sourceIndex,
+     * so that the items have the same order as in the source model.
+     * PlacesItemModel takes the ownership of the item.
      */
-    void insertSortedItem(PlacesItem* item);
+    void insertSortedItem(PlacesItem* item, const QModelIndex& sourceIndex);
 
     PlacesItem *itemFromBookmark(const KBookmark &bookmark) const;
 
     void addItemFromSourceModel(const QModelIndex &index);
+
+    /**
+     * @return New item for the source model index \a index.
+     */
+    PlacesItem *createItemFromSourceModel(const QModelIndex &index);
     void removeItemByIndex(const QModelIndex &mapToSource);
 
     QString bookmarkId(const KBookmark &bookmark) const;
@@ -208,7 +221,12 @@ private:
 
     KFilePlacesModel *m_sourceModel;
 
+    // Source model indexes of the items. They are sorted by their
+    // rows, so that they can be looked up by binary search.
     QVector<QPersistentModelIndex> m_indexMap;
+
+    QSet<QPersistentModelIndex> m_changedSourceIndexes;
+    QTimer* m_sourceDataChangedTimer;
 };
 
 #endif
@@ -24,11 +24,19 @@
 #include <QAction>
 #include <QDesktopServices>
 #include <QDir>
+#include <QFileInfo>
 #include <QLabel>
 #include <QShowEvent>
 #include <QTimer>
 #include <QVBoxLayout>
 
+namespace {
+    QUrl authorityUrl(const QUrl& url)
+    {
+        return url.adjusted(QUrl::RemovePath | QUrl::RemoveQuery | QUrl::RemoveFragment);
+    }
+}
+
 TerminalPanel::TerminalPanel(QWidget* parent) :
     Panel(parent),
     m_clearTerminal(true),
@@ -40,6 +48,8 @@ TerminalPanel::TerminalPanel(QWidget* parent) :
     m_konsolePart(nullptr),
     m_konsolePartCurrentDirectory(),
     m_sendCdToTerminalHistory(),
+    m_requestedUrl(),
+    m_localPathPrefixes(),
     m_kiofuseInterface(QStringLiteral("org.kde.KIOFuse"),
                        QStringLiteral("/org/kde/KIOFuse"),
                        QDBusConnection::sessionBus())
@@ -181,14 +191,23 @@ void TerminalPanel::showEvent(QShowEvent* event)
 
 void TerminalPanel::changeDir(const QUrl& url)
 {
+    // Only the latest directory change is applied, the results of
+    // resolving the previous URLs are ignored.
     delete m_mostLocalUrlJob;
     m_mostLocalUrlJob = nullptr;
+    m_requestedUrl = url;
 
     if (url.isLocalFile()) {
         sendCdToTerminal(url.toLocalFile());
         return;
     }
 
+    const QString localPath = cachedLocalPath(url);
+    if (!localPath.isEmpty()) {
+        sendCdToTerminal(localPath);
+        return;
+    }
+
     // Try stat'ing the url; note that mostLocalUrl only works with ":local" protocols
     if (KProtocolInfo::protocolClass(url.scheme()) == QLatin1String(":local")) {
         m_mostLocalUrlJob = KIO::mostLocalUrl(url, KIO::HideProgressInfo);
@@ -242,28 +261,77 @@ void TerminalPanel::sendCdToTerminalKIOFuse(const QUrl &url) {
     // URL isn't local, only hope for the terminal to be in sync with the
     // DolphinView is to mount the remote URL in KIOFuse and point to it.
     // If we can't do that for any reason, silently fail.
+    const QUrl requestedUrl = m_requestedUrl;
     auto reply = m_kiofuseInterface.mountUrl(url.toString());
     QDBusPendingCallWatcher * watcher = new QDBusPendingCallWatcher(reply, this);
     QObject::connect(watcher, &QDBusPendingCallWatcher::finished, this, [=] (QDBusPendingCallWatcher* watcher) {
         watcher->deleteLater();
         if (!reply.isError()) {
-            // Successfully mounted, point to the KIOFuse equivalent path.
-            sendCdToTerminal(reply.value());
+            cacheLocalPath(url, reply.value());
+            if (isCdToTerminalRequested(requestedUrl)) {
+                // Successfully mounted, point to the KIOFuse equivalent path.
+                sendCdToTerminal(reply.value());
+            }
         }
     });
 }
 
+bool TerminalPanel::isCdToTerminalRequested(const QUrl& requestedUrl) const
+{
+    return requestedUrl == m_requestedUrl && m_terminal && isVisible() && !hasProgramRunning();
+}
+
+void TerminalPanel::cacheLocalPath(const QUrl& url, const QString& localPath)
+{
+    // The local path can only be used for other URLs of the authority,
+    // if the path of the URL is appended to a fixed prefix.
+    QString path = url.path();
+    while (path.endsWith(QLatin1Char('/'))) {
+        path.chop(1);
+    }
+    QString localPrefix = localPath;
+    while (localPrefix.endsWith(QLatin1Char('/'))) {
+        localPrefix.chop(1);
+    }
+    if (!localPrefix.endsWith(path)) {
+        return;
+    }
+
+    localPrefix.chop(path.length());
+    if (!localPrefix.isEmpty()) {
+        m_localPathPrefixes.insert(authorityUrl(url), localPrefix);
+    }
+}
+
+QString TerminalPanel::cachedLocalPath(const QUrl& url) const
+{
+    const QString localPrefix = m_localPathPrefixes.value(authorityUrl(url));
+    if (localPrefix.isEmpty() || !QFileInfo::exists(localPrefix)) {
+        // The KIOFuse mount might have been removed in the meantime
+        return QString();
+    }
+
+    QString path = url.path();
+    if (!path.startsWith(QLatin1Char('/'))) {
+        path.prepend(QLatin1Char('/'));
+    }
+    return localPrefix + path;
+}
+
 void TerminalPanel::slotMostLocalUrlResult(KJob* job)
 {
     KIO::StatJob* statJob = static_cast<KIO::StatJob *>(job);
     const QUrl url = statJob->mostLocalUrl();
+    m_mostLocalUrlJob = nullptr;
+
     if (url.isLocalFile()) {
-        sendCdToTerminal(url.toLocalFile());
+        cacheLocalPath(m_requestedUrl, url.toLocalFile());
+        if (isCdToTerminalRequested(m_requestedUrl)) {
+            sendCdToTerminal(url.toLocalFile());
+        }
     } else {
         sendCdToTerminalKIOFuse(url);
     }
-
-    m_mostLocalUrlJob = nullptr;
 }
 
 void TerminalPanel::slotKonsolePartCurrentDirectoryChanged(const QString& dir)
@@ -10,7 +10,9 @@
 #include "panels/panel.h"
 #include "kiofuse_interface.h"
 
+#include <QHash>
 #include <QQueue>
+#include <QUrl>
 
 class TerminalInterface;
 class KMessageWidget;
@@ -78,6 +80,28 @@ private:
     void changeDir(const QUrl& url);
     void sendCdToTerminal(const QString& path, HistoryPolicy addToHistory = HistoryPolicy::AddToHistory);
     void sendCdToTerminalKIOFuse(const QUrl &url);
+
+    /**
+     * @return True if the result of resolving the local path for the URL
+     *         \a requestedUrl should still be sent to the terminal. This is
+     *         not the case if changeDir() has been invoked for another URL
+     *         in the meantime, if the panel is hidden or if a program is running.
+     */
+    bool isCdToTerminalRequested(const QUrl& requestedUrl) const;
+
+    /**
+     * Remembers that the remote URL \a url is available as \a localPath, so
+     * that the local paths of other URLs with the same authority can be
+     * determined without starting a job or a DBus call.
+     */
+    void cacheLocalPath(const QUrl& url, const QString& localPath);
+
+    /**
+     * @return Local path of \a url, if it can be determined from the cached
+     *         local paths of its authority. Otherwise an empty string is returned.
+     */
+    QString cachedLocalPath(const QUrl& url) const;
+
 private:
     bool m_clearTerminal;
     KIO::StatJob* m_mostLocalUrlJob;
@@ -89,6 +113,12 @@ private:
     KParts::ReadOnlyPart* m_konsolePart;
     QString m_konsolePartCurrentDirectory;
     QQueue<QString> m_sendCdToTerminalHistory;
+
+    // URL that has been passed to changeDir() the last time
+    QUrl m_requestedUrl;
+    // Local paths of the root directories of remote authorities, the
+    // keys are the URLs without path
+    QHash<QUrl, QString> m_localPathPrefixes;
     org::kde::KIOFuse::VFS m_kiofuseInterface;
 };
 
@@ -0,0 +1,156 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "dolphinfacetsfilter.h"
+
+#include "dolphinquery.h"
+
+#include <KFileItem>
+
+namespace {
+    bool isDocumentMimeType(const QString& mimeType)
+    {
+        static const QLatin1String documentPrefixes[] {
+            QLatin1String("text/"),
+            QLatin1String("application/pdf"),
+            QLatin1String("application/postscript"),
+            QLatin1String("application/rtf"),
+            QLatin1String("application/epub"),
+            QLatin1String("application/msword"),
+            QLatin1String("application/vnd.ms-"),
+            QLatin1String("application/vnd.oasis.opendocument."),
+            QLatin1String("application/vnd.openxmlformats-officedocument.")
+        };
+
+        for (const auto& prefix : documentPrefixes) {
+            if (mimeType.startsWith(prefix)) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+DolphinFacetsFilter DolphinFacetsFilter::fromQuery(const DolphinQuery& query)
+{
+    DolphinFacetsFilter filter;
+    filter.m_type = query.type();
+
+    const QStringList searchTerms = query.searchTerms();
+    for (const QString& term : searchTerms) {
+        if (term.startsWith(QLatin1String("modified>="))) {
+            filter.m_modificationDate = QDate::fromString(term.mid(10), Qt::ISODate);
+        } else if (term.startsWith(QLatin1String("rating>="))) {
+            filter.m_rating = term.mid(8).toInt();
+        } else if (term.startsWith(QLatin1String("tag:")) || term.startsWith(QLatin1String("tag="))) {
+            filter.m_tags.append(term.mid(4));
+        }
+    }
+    filter.m_tags.sort();
+    return filter;
+}
+
+bool DolphinFacetsFilter::isNarrowedBy(const DolphinFacetsFilter& filter) const
+{
+    if (!m_type.isEmpty() && filter.m_type != m_type) {
+        return false;
+    }
+    if (m_modificationDate.isValid() && (!filter.m_modificationDate.isValid() || filter.m_modificationDate < m_modificationDate)) {
+        return false;
+    }
+    if (filter.m_rating < m_rating) {
+        return false;
+    }
+    for (const QString& tag : m_tags) {
+        if (!filter.m_tags.contains(tag)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DolphinFacetsFilter::matches(const KFileItem& item, const QHash<QByteArray, QVariant>& values) const
+{
+    return matchesType(item) && matchesModificationDate(item) && matchesRoles(values);
+}
+
+void DolphinFacetsFilter::count(const KFileItem& item, const QHash<QByteArray, QVariant>& values, Counts& counts) const
+{
+    if (!matchesRoles(values)) {
+        return;
+    }
+
+    const bool typeMatches = matchesType(item);
+    const bool modificationDateMatches = matchesModificationDate(item);
+
+    if (modificationDateMatches) {
+        ++counts.anyType;
+        const QStringList itemTypes = types(item);
+        for (const QString& type : itemTypes) {
+            ++counts.types[type];
+        }
+    }
+
+    if (typeMatches) {
+        ++counts.anyModificationDate;
+        ++counts.modificationDates[item.time(KFileItem::ModificationTime).date()];
+    }
+}
+
+QStringList DolphinFacetsFilter::types(const KFileItem& item)
+{
+    if (item.isDir()) {
+        return {QStringLiteral("Folder")};
+    }
+
+    const QString mimeType = item.isMimeTypeKnown() ? item.mimetype() : item.currentMimeType().name();
+    if (mimeType.startsWith(QLatin1String("image/"))) {
+        return {QStringLiteral("Image")};
+    } else if (mimeType.startsWith(QLatin1String("audio/"))) {
+        return {QStringLiteral("Audio")};
+    } else if (mimeType.startsWith(QLatin1String("video/"))) {
+        return {QStringLiteral("Video")};
+    } else if (isDocumentMimeType(mimeType)) {
+        return {QStringLiteral("Document")};
+    }
+    return {};
+}
+
+bool DolphinFacetsFilter::matchesType(const KFileItem& item) const
+{
+    return m_type.isEmpty() || types(item).contains(m_type);
+}
+
+bool DolphinFacetsFilter::matchesModificationDate(const KFileItem& item) const
+{
+    return !m_modificationDate.isValid() || item.time(KFileItem::ModificationTime).date() >= m_modificationDate;
+}
+
+bool DolphinFacetsFilter::matchesRoles(const QHash<QByteArray, QVariant>& values) const
+{
+    // KBalooRolesProvider only sets the rating and the tags if they
+    // are not empty, so missing values don't exclude the item
+    if (m_rating > 0) {
+        const auto it = values.constFind("rating");
+        if (it != values.constEnd() && it->toInt() < m_rating) {
+            return false;
+        }
+    }
+
+    if (!m_tags.isEmpty()) {
+        const auto it = values.constFind("tags");
+        if (it != values.constEnd()) {
+            const QStringList itemTags = it->toString().split(QLatin1String(", "));
+            for (const QString& tag : m_tags) {
+                if (!itemTags.contains(tag)) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
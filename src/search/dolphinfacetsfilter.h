@@ -0,0 +1,87 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef DOLPHINFACETSFILTER_H
+#define DOLPHINFACETSFILTER_H
+
+#include <QDate>
+#include <QHash>
+#include <QMap>
+#include <QStringList>
+#include <QVariant>
+
+class DolphinQuery;
+class KFileItem;
+
+/**
+ * @brief Applies the facets of a search, as set by DolphinFacetsWidget,
+ *        to search results that have been loaded already.
+ *
+ * If a facet is narrowed, e.g. from "Any Type" to "Images", the new results
+ * are a subset of the shown results. They are shown at once by filtering
+ * the shown results with matches() while Baloo is queried again, see
+ * KFileItemModel::prepareNarrowedSearch(). The type is approximated by the
+ * MIME type, the rating and the tags are taken from the roles of the items
+ * if they have been resolved. Items whose facets are unknown are kept until
+ * the new listing has been completed.
+ */
+class DolphinFacetsFilter
+{
+public:
+    /**
+     * Number of search results by their facets, see count(). The types
+     * are only counted for results that match with the other facets than
+     * the type, and the dates for results that match with the other facets
+     * than the date, like the results that would be shown if the option
+     * was selected.
+     */
+    struct Counts
+    {
+        int anyType = 0;
+        int anyModificationDate = 0;
+        QHash<QString, int> types;          // Facet type as in DolphinQuery::type()
+        QMap<QDate, int> modificationDates;
+    };
+
+    static DolphinFacetsFilter fromQuery(const DolphinQuery& query);
+
+    /**
+     * @return True if each item that matches with \a filter also matches
+     *         with this filter, so that the results of \a filter are a
+     *         subset of the results of this filter.
+     */
+    bool isNarrowedBy(const DolphinFacetsFilter& filter) const;
+
+    /**
+     * @return True if \a item with the values of its roles \a values
+     *         matches with the facets or if it cannot be decided.
+     */
+    bool matches(const KFileItem& item, const QHash<QByteArray, QVariant>& values) const;
+
+    /**
+     * Adds \a item with the values of its roles \a values to \a counts.
+     */
+    void count(const KFileItem& item, const QHash<QByteArray, QVariant>& values, Counts& counts) const;
+
+    /**
+     * @return The facet types of \a item, like "Image" or "Folder". The MIME
+     *         type is only determined from the name if it is not known yet,
+     *         so that the content of the file is not read.
+     */
+    static QStringList types(const KFileItem& item);
+
+private:
+    bool matchesType(const KFileItem& item) const;
+    bool matchesModificationDate(const KFileItem& item) const;
+    bool matchesRoles(const QHash<QByteArray, QVariant>& values) const;
+
+    QString m_type;
+    QDate m_modificationDate;
+    int m_rating = 0;
+    QStringList m_tags;
+};
+
+#endif
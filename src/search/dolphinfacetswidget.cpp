@@ -17,6 +17,11 @@
 #include <QMenu>
 #include <QToolButton>
 
+namespace {
+    // Text of the options without the number of results
+    const int OptionTextRole = Qt::UserRole + 1;
+}
+
 DolphinFacetsWidget::DolphinFacetsWidget(QWidget* parent) :
     QWidget(parent),
     m_typeSelector(nullptr),
@@ -177,6 +182,41 @@ void DolphinFacetsWidget::setFacetType(const QString& type)
     }
 }
 
+void DolphinFacetsWidget::setFacetCounts(const DolphinFacetsFilter::Counts& counts)
+{
+    const auto setCount = [](QComboBox* combo, int index, int count) {
+        combo->setItemText(index, i18nc("@item:inlistbox %1 is a search option, %2 the number of results",
+                                        "%1 (%2)", combo->itemData(index, OptionTextRole).toString(), count));
+    };
+
+    for (int index = 0; index < m_typeSelector->count(); ++index) {
+        const QString type = m_typeSelector->itemData(index).toString();
+        setCount(m_typeSelector, index, type.isEmpty() ? counts.anyType : counts.types.value(type));
+    }
+
+    for (int index = 0; index < m_dateSelector->count(); ++index) {
+        const QDate date = m_dateSelector->itemData(index).toDate();
+        int count = 0;
+        if (date.isValid()) {
+            for (auto it = counts.modificationDates.lowerBound(date); it != counts.modificationDates.constEnd(); ++it) {
+                count += it.value();
+            }
+        } else {
+            count = counts.anyModificationDate;
+        }
+        setCount(m_dateSelector, index, count);
+    }
+}
+
+void DolphinFacetsWidget::clearFacetCounts()
+{
+    for (QComboBox* combo : {m_typeSelector, m_dateSelector}) {
+        for (int index = 0; index < combo->count(); ++index) {
+            combo->setItemText(index, combo->itemData(index, OptionTextRole).toString());
+        }
+    }
+}
+
 void DolphinFacetsWidget::setRating(const int stars)
 {
     if (stars < 0 || stars > 5) {
@@ -223,6 +263,9 @@ void DolphinFacetsWidget::initComboBox(QComboBox* combo)
     combo->setFrame(false);
     combo->setMinimumHeight(parentWidget()->height());
     combo->setCurrentIndex(0);
+    for (int index = 0; index < combo->count(); ++index) {
+        combo->setItemData(index, combo->itemText(index), OptionTextRole);
+    }
     connect(combo, QOverload<int>::of(&QComboBox::activated), this, &DolphinFacetsWidget::facetChanged);
 }
 
@@ -7,6 +7,8 @@
 #ifndef DOLPHINFACETSWIDGET_H
 #define DOLPHINFACETSWIDGET_H
 
+#include "dolphinfacetsfilter.h"
+
 #include <QWidget>
 #include <KCoreDirLister>
 
@@ -48,6 +50,18 @@ public:
 
     void setFacetType(const QString& type);
 
+    /**
+     * Shows the number of the search results next to the options of the
+     * type and the date, which are counted by DolphinFacetsFilter::count().
+     */
+    void setFacetCounts(const DolphinFacetsFilter::Counts& counts);
+
+    /**
+     * Shows the options of the type and the date without the numbers
+     * of the search results.
+     */
+    void clearFacetCounts();
+
 Q_SIGNALS:
     void facetChanged();
 
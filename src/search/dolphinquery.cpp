@@ -179,3 +179,12 @@ bool DolphinQuery::hasFileName() const
 {
     return m_hasFileName;
 }
+
+bool DolphinQuery::hasSameSearch(const DolphinQuery& other) const
+{
+    return m_searchUrl.scheme() == other.m_searchUrl.scheme()
+        && m_searchText == other.m_searchText
+        && m_includeFolder == other.m_includeFolder
+        && m_hasContentSearch == other.m_hasContentSearch
+        && m_hasFileName == other.m_hasFileName;
+}
@@ -40,6 +40,9 @@ public:
     bool hasContentSearch() const;
     /** @return whether the query includes a filter by fileName */
     bool hasFileName() const;
+    /** @return whether @p other searches for the same text in the same folder,
+     * its type and search terms may differ */
+    bool hasSameSearch(const DolphinQuery& other) const;
 
 private:
     /** Calls Baloo::Query::fromSearchUrl() on the current searchUrl
@@ -153,6 +153,16 @@ void DolphinSearchBox::fromSearchUrl(const QUrl& url)
     updateFacetsVisible();
 }
 
+void DolphinSearchBox::setFacetCounts(const DolphinFacetsFilter::Counts& counts)
+{
+    m_facetsWidget->setFacetCounts(counts);
+}
+
+void DolphinSearchBox::clearFacetCounts()
+{
+    m_facetsWidget->clearFacetCounts();
+}
+
 void DolphinSearchBox::selectAll()
 {
     m_searchInput->selectAll();
@@ -341,6 +351,8 @@ void DolphinSearchBox::init()
             this, &DolphinSearchBox::slotReturnPressed);
     connect(m_searchInput, &QLineEdit::textChanged,
             this, &DolphinSearchBox::slotSearchTextChanged);
+    connect(m_searchInput, &QLineEdit::textEdited,
+            this, &DolphinSearchBox::searchTextEdited);
     setFocusProxy(m_searchInput);
 
     // Add "Save search" button inside search box
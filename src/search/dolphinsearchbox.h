@@ -7,6 +7,8 @@
 #ifndef DOLPHINSEARCHBOX_H
 #define DOLPHINSEARCHBOX_H
 
+#include "dolphinfacetsfilter.h"
+
 #include <QUrl>
 #include <QWidget>
 
@@ -65,6 +67,13 @@ public:
      */
     void fromSearchUrl(const QUrl& url);
 
+    /**
+     * Shows the number of the results of the Baloo search next to
+     * the options of the facets, see DolphinFacetsWidget::setFacetCounts().
+     */
+    void setFacetCounts(const DolphinFacetsFilter::Counts& counts);
+    void clearFacetCounts();
+
     /**
      * Selects the whole text of the search box.
      */
@@ -105,6 +114,13 @@ Q_SIGNALS:
      */
     void searchTextChanged(const QString& text);
 
+    /**
+     * Is emitted when the user has edited the text that should be used
+     * as input for searching. Other than searchTextChanged() it is not
+     * emitted if the text is changed by setText() or by restoring a search.
+     */
+    void searchTextEdited(const QString& text);
+
     /**
      * Emitted as soon as the search box should get closed.
      */
@@ -11,12 +11,18 @@
 
 #include "views/viewproperties.h"
 
+namespace {
+    // Number of directories whose properties are written at once
+    const int WriteBatchSize = 1000;
+}
+
 ApplyViewPropsJob::ApplyViewPropsJob(const QUrl& dir,
                                      const ViewProperties& viewProps) :
     KIO::Job(),
     m_viewProps(nullptr),
     m_progress(0),
-    m_dir(dir)
+    m_dir(dir),
+    m_pendingDirs()
 {
     m_viewProps = new ViewProperties(dir);
     m_viewProps->setViewMode(viewProps.viewMode());
@@ -42,18 +48,16 @@ void ApplyViewPropsJob::slotEntries(KIO::Job*, const KIO::UDSEntryList& list)
     for (const KIO::UDSEntry& entry : list) {
         const QString name = entry.stringValue(KIO::UDSEntry::UDS_NAME);
         if (name != QLatin1Char('.') && name != QLatin1String("..") && entry.isDir()) {
-            ++m_progress;
-
             QUrl url(m_dir);
             url = url.adjusted(QUrl::StripTrailingSlash);
             url.setPath(url.path() + '/' + name);
-
-            Q_ASSERT(m_viewProps);
-
-            ViewProperties props(url);
-            props.setDirProperties(*m_viewProps);
+            m_pendingDirs.append(url);
         }
     }
+
+    if (m_pendingDirs.count() >= WriteBatchSize) {
+        writePendingDirs();
+    }
 }
 
 void ApplyViewPropsJob::slotResult(KJob* job)
@@ -62,6 +66,21 @@ void ApplyViewPropsJob::slotResult(KJob* job)
         setError(job->error());
         setErrorText(job->errorText());
     }
+    writePendingDirs();
     emitResult();
 }
 
+void ApplyViewPropsJob::writePendingDirs()
+{
+    if (m_pendingDirs.isEmpty()) {
+        return;
+    }
+
+    Q_ASSERT(m_viewProps);
+    m_viewProps->saveToDirectories(m_pendingDirs);
+
+    m_progress += m_pendingDirs.count();
+    m_pendingDirs.clear();
+    setProcessedAmount(KJob::Directories, m_progress);
+}
+
@@ -35,6 +35,10 @@ class ViewProperties;
  * - Use a timer to show the progress by invoking ApplyViwePropsJob::progress().
  *   In combination with the total directory count it is possible to show a
  *   progress bar now.
+ *
+ * The properties of the listed sub directories are written in batches to
+ * the ViewPropertiesStore. If the job is killed, the properties of the
+ * directories that have not been written yet are discarded.
  */
 class ApplyViewPropsJob : public KIO::Job
 {
@@ -49,16 +53,27 @@ public:
      */
     ApplyViewPropsJob(const QUrl& dir, const ViewProperties& viewProps);
     ~ApplyViewPropsJob() override;
+
+    /**
+     * @return Number of sub directories whose view properties have been written.
+     */
     int progress() const;
 
 private Q_SLOTS:
     void slotResult(KJob* job) override;
     void slotEntries(KIO::Job*, const KIO::UDSEntryList&);
 
+private:
+    /**
+     * Writes the view properties of the pending directories.
+     */
+    void writePendingDirs();
+
 private:
     ViewProperties* m_viewProps;
     int m_progress;
     QUrl m_dir;
+    QList<QUrl> m_pendingDirs;
 };
 
 inline int ApplyViewPropsJob::progress() const
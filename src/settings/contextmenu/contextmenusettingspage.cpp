@@ -9,6 +9,7 @@
 #include "dolphin_generalsettings.h"
 #include "dolphin_versioncontrolsettings.h"
 #include "dolphin_contextmenusettings.h"
+#include "kitemviews/private/kpluginregistry.h"
 #include "settings/serviceitemdelegate.h"
 #include "settings/servicemodel.h"
 
@@ -27,6 +28,7 @@
 #include <QScroller>
 #include <QShowEvent>
 #include <QSortFilterProxyModel>
+#include <QTimer>
 #include <QLineEdit>
 
 namespace
@@ -43,6 +45,7 @@ ContextMenuSettingsPage::ContextMenuSettingsPage(QWidget* parent,
     SettingsPageBase(parent),
     m_initialized(false),
     m_serviceModel(nullptr),
+    m_loadedServices(),
     m_sortModel(nullptr),
     m_listView(nullptr),
     m_enabledVcsPlugins(),
@@ -83,7 +86,6 @@ ContextMenuSettingsPage::ContextMenuSettingsPage(QWidget* parent,
                                                   this);
     connect(downloadButton, &KNS3::Button::dialogFinished, this, [this](const KNS3::Entry::List &changedEntries) {
            if (!changedEntries.isEmpty()) {
-               m_serviceModel->clear();
                loadServices();
            }
     });
@@ -211,6 +213,15 @@ void ContextMenuSettingsPage::restoreDefaults()
 void ContextMenuSettingsPage::showEvent(QShowEvent* event)
 {
     if (!event->spontaneous() && !m_initialized) {
+        // Show the page before the services are enumerated
+        QTimer::singleShot(0, this, &ContextMenuSettingsPage::initialize);
+    }
+    SettingsPageBase::showEvent(event);
+}
+
+void ContextMenuSettingsPage::initialize()
+{
+    if (!m_initialized) {
         loadServices();
 
         loadVersionControlSystems();
@@ -241,7 +252,6 @@ void ContextMenuSettingsPage::showEvent(QShowEvent* event)
 
         m_initialized = true;
     }
-    SettingsPageBase::showEvent(event);
 }
 
 void ContextMenuSettingsPage::loadServices()
@@ -249,6 +259,21 @@ void ContextMenuSettingsPage::loadServices()
     const KConfig config(QStringLiteral("kservicemenurc"), KConfig::NoGlobals);
     const KConfigGroup showGroup = config.group("Show");
 
+    QSet<QString> rowNames;
+    for (int i = 0; i < m_serviceModel->rowCount(); ++i) {
+        const QModelIndex index = m_serviceModel->index(i, 0);
+        rowNames.insert(m_serviceModel->data(index, ServiceModel::DesktopEntryNameRole).toString());
+    }
+
+    QSet<QString> foundServices;
+    const auto addService = [&](const QString &icon, const QString &text, const QString &serviceName) {
+        foundServices.insert(serviceName);
+        if (!rowNames.contains(serviceName)) {
+            rowNames.insert(serviceName);
+            addRow(icon, text, serviceName, showGroup.readEntry(serviceName, true));
+        }
+    };
+
     // Load generic services
     const KService::List entries = KServiceTypeTrader::self()->query(QStringLiteral("KonqPopupMenu/Plugin"));
     for (const KService::Ptr &service : entries) {
@@ -259,15 +284,11 @@ void ContextMenuSettingsPage::loadServices()
         const QString subMenuName = desktopFile.desktopGroup().readEntry("X-KDE-Submenu");
 
         for (const KServiceAction &action : serviceActions) {
-            const QString serviceName = action.name();
-            const bool addService = !action.noDisplay() && !action.isSeparator() && !isInServicesList(serviceName);
-
-            if (addService) {
+            if (!action.noDisplay() && !action.isSeparator()) {
                 const QString itemName = subMenuName.isEmpty()
                                          ? action.text()
                                          : i18nc("@item:inmenu", "%1: %2", subMenuName, action.text());
-                const bool checked = showGroup.readEntry(serviceName, true);
-                addRow(action.icon(), itemName, serviceName, checked);
+                addService(action.icon(), itemName, action.name());
             }
         }
     }
@@ -275,25 +296,28 @@ void ContextMenuSettingsPage::loadServices()
     // Load service plugins that implement the KFileItemActionPlugin interface
     const KService::List pluginServices = KServiceTypeTrader::self()->query(QStringLiteral("KFileItemAction/Plugin"));
     for (const KService::Ptr &service : pluginServices) {
-        const QString desktopEntryName = service->desktopEntryName();
-        if (!isInServicesList(desktopEntryName)) {
-            const bool checked = showGroup.readEntry(desktopEntryName, true);
-            addRow(service->icon(), service->name(), desktopEntryName, checked);
-        }
+        addService(service->icon(), service->name(), service->desktopEntryName());
     }
 
     // Load JSON-based plugins that implement the KFileItemActionPlugin interface
-    const auto jsonPlugins = KPluginLoader::findPlugins(QStringLiteral("kf5/kfileitemaction"), [](const KPluginMetaData& metaData) {
-        return metaData.serviceTypes().contains(QLatin1String("KFileItemAction/Plugin"));
-    });
-
+    const auto jsonPlugins = KPluginRegistry::instance().fileItemActionPlugins();
     for (const auto &jsonMetadata : jsonPlugins) {
-        const QString desktopEntryName = jsonMetadata.pluginId();
-        if (!isInServicesList(desktopEntryName)) {
-            const bool checked = showGroup.readEntry(desktopEntryName, true);
-            addRow(jsonMetadata.iconName(), jsonMetadata.name(), desktopEntryName, checked);
+        if (!jsonMetadata.serviceTypes().contains(QLatin1String("KFileItemAction/Plugin"))) {
+            continue;
+        }
+
+        addService(jsonMetadata.iconName(), jsonMetadata.name(), jsonMetadata.pluginId());
+    }
+
+    // Remove the services that have been uninstalled since the last call
+    const QSet<QString> removedServices = m_loadedServices - foundServices;
+    for (int i = m_serviceModel->rowCount() - 1; i >= 0 && !removedServices.isEmpty(); --i) {
+        const QModelIndex index = m_serviceModel->index(i, 0);
+        if (removedServices.contains(m_serviceModel->data(index, ServiceModel::DesktopEntryNameRole).toString())) {
+            m_serviceModel->removeRow(i);
         }
     }
+    m_loadedServices = foundServices;
 
     m_sortModel->sort(Qt::DisplayRole);
     m_searchLineEdit->setFocus(Qt::OtherFocusReason);
@@ -304,7 +328,7 @@ void ContextMenuSettingsPage::loadVersionControlSystems()
     const QStringList enabledPlugins = VersionControlSettings::enabledPlugins();
 
     // Create a checkbox for each available version control plugin
-    const KService::List pluginServices = KServiceTypeTrader::self()->query(QStringLiteral("FileViewVersionControlPlugin"));
+    const KService::List pluginServices = KPluginRegistry::instance().versionControlPlugins();
     for (const auto &plugin : pluginServices) {
         const QString pluginName = plugin->name();
         addRow(QStringLiteral("code-class"),
@@ -316,17 +340,6 @@ void ContextMenuSettingsPage::loadVersionControlSystems()
     m_sortModel->sort(Qt::DisplayRole);
 }
 
-bool ContextMenuSettingsPage::isInServicesList(const QString &service) const
-{
-    for (int i = 0; i < m_serviceModel->rowCount(); ++i) {
-        const QModelIndex index = m_serviceModel->index(i, 0);
-        if (m_serviceModel->data(index, ServiceModel::DesktopEntryNameRole).toString() == service) {
-            return true;
-        }
-    }
-    return false;
-}
-
 void ContextMenuSettingsPage::addRow(const QString &icon,
                                      const QString &text,
                                      const QString &value,
@@ -10,6 +10,7 @@
 
 #include <KActionCollection>
 
+#include <QSet>
 #include <QString>
 
 class QListView;
@@ -41,7 +42,15 @@ protected:
 
 private Q_SLOTS:
     /**
-     * Loads locally installed services.
+     * Adds the services, the version control systems and the
+     * built-in actions when the page has been shown the first time.
+     */
+    void initialize();
+
+    /**
+     * Loads locally installed services. If the services have been
+     * loaded already, only the added services are inserted and the
+     * removed services are removed, the other rows keep their state.
      */
     void loadServices();
 
@@ -51,8 +60,6 @@ private:
      */
     void loadVersionControlSystems();
 
-    bool isInServicesList(const QString &service) const;
-
     /**
      * Adds a row to the model of m_listView.
      */
@@ -66,6 +73,7 @@ private:
 private:
     bool m_initialized;
     ServiceModel *m_serviceModel;
+    QSet<QString> m_loadedServices; // Names of the rows added by loadServices()
     QSortFilterProxyModel *m_sortModel;
     QListView* m_listView;
     QLineEdit *m_searchLineEdit;
@@ -17,6 +17,9 @@
 #include <KLocalizedString>
 #include <KShell>
 
+#include <memory>
+#include <vector>
+
 #include "../../../config-packagekit.h"
 
 Q_GLOBAL_STATIC_WITH_ARGS(QStringList, binaryPackages, ({QLatin1String("application/vnd.debian.binary-package"),
@@ -143,7 +146,8 @@ enum ScriptExecution{
     Konsole
 };
 
-void runUncompress(const QString &inputPath, const QString &outputPath)
+// Starts uncompressing the archive inputPath, the process must be passed to finishUncompress()
+std::unique_ptr<QProcess> startUncompress(const QString &inputPath, const QString &outputPath)
 {
     QVector<QPair<QStringList, UncompressCommand>> mimeTypeToCommand;
     mimeTypeToCommand.append({{"application/x-tar", "application/tar", "application/x-gtar", "multipart/x-tar"},
@@ -181,15 +185,19 @@ void runUncompress(const QString &inputPath, const QString &outputPath)
         fail(i18n("Unsupported archive type %1: %2", mime, inputPath));
     }
 
-    QProcess process;
-    process.start(
+    std::unique_ptr<QProcess> process(new QProcess());
+    process->start(
         command.command,
         QStringList() << command.args1 << inputPath << command.args2 << outputPath,
         QIODevice::NotOpen);
-    if (!process.waitForStarted()) {
+    if (!process->waitForStarted()) {
         fail(i18n("Failed to run uncompressor command for %1", inputPath));
     }
+    return process;
+}
 
+void finishUncompress(QProcess &process, const QString &inputPath)
+{
     if (!process.waitForFinished()) {
         fail(
             i18n("Process did not finish in reasonable time: %1 %2", process.program(), process.arguments().join(" ")));
@@ -278,6 +286,50 @@ QString generateDirPath(const QString &archive)
     return QStringLiteral("%1-dir").arg(archive);
 }
 
+bool isBinaryPackage(const QString &archive)
+{
+    return binaryPackages->contains(QMimeDatabase().mimeTypeForFile(archive).name());
+}
+
+bool prepareDirectory(const QString &dir, QString &errorText)
+{
+    if (QFile::exists(dir)) {
+        if (!QDir(dir).removeRecursively()) {
+            errorText = i18n("Failed to remove directory %1", dir);
+            return false;
+        }
+    }
+
+    if (QDir().mkdir(dir)) {
+        errorText = i18n("Failed to create directory %1", dir);
+    }
+    return true;
+}
+
+// Uncompresses the archives at the same time, their install scripts
+// are run one after another by cmdInstall() afterwards.
+bool uncompressArchives(const QStringList &archives, QString &errorText)
+{
+    std::vector<std::pair<QString, std::unique_ptr<QProcess>>> processes;
+    for (const QString &archive : archives) {
+        if (archive.endsWith(QLatin1String(".desktop")) || isBinaryPackage(archive)) {
+            continue;
+        }
+
+        const QString dir = generateDirPath(archive);
+        if (!prepareDirectory(dir, errorText)) {
+            return false;
+        }
+        processes.emplace_back(archive, startUncompress(archive, dir));
+    }
+
+    for (const auto &process : processes) {
+        finishUncompress(*process.second, process.first);
+    }
+    return true;
+}
+
+// The archive must have been uncompressed by uncompressArchives()
 bool cmdInstall(const QString &archive, QString &errorText)
 {
     const auto serviceDir = getServiceMenusDir();
@@ -301,22 +353,10 @@ bool cmdInstall(const QString &archive, QString &errorText)
             return false;
         }
     } else {
-        if (binaryPackages->contains(QMimeDatabase().mimeTypeForFile(archive).name())) {
+        if (isBinaryPackage(archive)) {
             packageKit(PackageOperation::Install, archive);
         }
         const QString dir = generateDirPath(archive);
-        if (QFile::exists(dir)) {
-            if (!QDir(dir).removeRecursively()) {
-                errorText = i18n("Failed to remove directory %1", dir);
-                return false;
-            }
-        }
-
-        if (QDir().mkdir(dir)) {
-            errorText = i18n("Failed to create directory %1", dir);
-        }
-
-        runUncompress(archive, dir);
 
         // Try "install-it" first
         QString installItPath;
@@ -370,7 +410,7 @@ bool cmdUninstall(const QString &archive, QString &errorText)
             return false;
         }
     } else {
-        if (binaryPackages->contains(QMimeDatabase().mimeTypeForFile(archive).name())) {
+        if (isBinaryPackage(archive)) {
             packageKit(PackageOperation::Uninstall, archive);
         }
         const QString dir = generateDirPath(archive);
@@ -431,7 +471,8 @@ int main(int argc, char *argv[])
 
     QCommandLineParser parser;
     parser.addPositionalArgument(QStringLiteral("command"), i18nc("@info:shell", "Command to execute: install or uninstall."));
-    parser.addPositionalArgument(QStringLiteral("path"), i18nc("@info:shell", "Path to archive."));
+    parser.addPositionalArgument(QStringLiteral("path"), i18nc("@info:shell", "Path to archive."),
+                                 QStringLiteral("path [path...]"));
     parser.process(app);
 
     const QStringList args = parser.positionalArguments();
@@ -443,16 +484,32 @@ int main(int argc, char *argv[])
     }
 
     const QString cmd = args[0];
-    const QString archive = args[1];
+    const QStringList archives = args.mid(1);
+
+    // PackageKit ends the installer after the package has been handled
+    if (archives.size() > 1) {
+        for (const QString &archive : archives) {
+            if (isBinaryPackage(archive)) {
+                fail(i18n("Binary packages must be installed one at a time: %1", archive));
+            }
+        }
+    }
 
     QString errorText;
     if (cmd == QLatin1String("install")) {
-        if (!cmdInstall(archive, errorText)) {
+        if (!uncompressArchives(archives, errorText)) {
             fail(errorText);
         }
+        for (const QString &archive : archives) {
+            if (!cmdInstall(archive, errorText)) {
+                fail(errorText);
+            }
+        }
     } else if (cmd == QLatin1String("uninstall")) {
-        if (!cmdUninstall(archive, errorText)) {
-            fail(errorText);
+        for (const QString &archive : archives) {
+            if (!cmdUninstall(archive, errorText)) {
+                fail(errorText);
+            }
         }
     } else {
         fail(i18n("Unsupported command %1", cmd));
@@ -8,12 +8,11 @@
 
 #include "dolphin_generalsettings.h"
 #include "configurepreviewplugindialog.h"
+#include "kitemviews/private/kpluginregistry.h"
 #include "settings/serviceitemdelegate.h"
 #include "settings/servicemodel.h"
 
-#include <KIO/PreviewJob>
 #include <KLocalizedString>
-#include <KServiceTypeTrader>
 
 #include <QHBoxLayout>
 #include <QLabel>
@@ -167,7 +166,7 @@ void PreviewsSettingsPage::loadPreviewPlugins()
 {
     QAbstractItemModel* model = m_listView->model();
 
-    const KService::List plugins = KServiceTypeTrader::self()->query(QStringLiteral("ThumbCreator"));
+    const KService::List plugins = KPluginRegistry::instance().thumbCreators();
     for (const KService::Ptr& service : plugins) {
         const bool configurable = service->property(QStringLiteral("Configurable"), QVariant::Bool).toBool();
         const bool show = m_enabledPreviewPlugins.contains(service->desktopEntryName());
@@ -186,7 +185,7 @@ void PreviewsSettingsPage::loadPreviewPlugins()
 void PreviewsSettingsPage::loadSettings()
 {
     const KConfigGroup globalConfig(KSharedConfig::openConfig(), QStringLiteral("PreviewSettings"));
-    m_enabledPreviewPlugins = globalConfig.readEntry("Plugins", KIO::PreviewJob::defaultPlugins());
+    m_enabledPreviewPlugins = globalConfig.readEntry("Plugins", KPluginRegistry::instance().defaultPreviewPlugins());
 
     const qulonglong defaultLocalPreview = static_cast<qulonglong>(DefaultMaxLocalPreviewSize) * 1024 * 1024;
     const qulonglong maxLocalByteSize = globalConfig.readEntry("MaximumSize", defaultLocalPreview);
@@ -38,6 +38,19 @@ bool ServiceModel::insertRows(int row, int count, const QModelIndex& parent)
     return true;
 }
 
+bool ServiceModel::removeRows(int row, int count, const QModelIndex& parent)
+{
+    if (row < 0 || count <= 0 || row + count > rowCount()) {
+        return false;
+    }
+
+    beginRemoveRows(parent, row, row + count - 1);
+    m_items.erase(m_items.begin() + row, m_items.begin() + row + count);
+    endRemoveRows();
+
+    return true;
+}
+
 bool ServiceModel::setData(const QModelIndex& index, const QVariant& value, int role)
 {
     const int row = index.row();
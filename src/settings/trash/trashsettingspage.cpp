@@ -9,18 +9,14 @@
 #include <KCModuleProxy>
 
 #include <QFormLayout>
+#include <QShowEvent>
 
 TrashSettingsPage::TrashSettingsPage(QWidget* parent) :
-        SettingsPageBase(parent)
+        SettingsPageBase(parent),
+        m_topLayout(nullptr),
+        m_proxy(nullptr)
 {
-    QFormLayout* topLayout = new QFormLayout(this);
-
-    m_proxy = new KCModuleProxy(QStringLiteral("kcmtrash"));
-    topLayout->addRow(m_proxy);
-
-    loadSettings();
-
-    connect(m_proxy, QOverload<bool>::of(&KCModuleProxy::changed), this, &TrashSettingsPage::changed);
+    m_topLayout = new QFormLayout(this);
 }
 
 TrashSettingsPage::~TrashSettingsPage()
@@ -29,16 +25,36 @@ TrashSettingsPage::~TrashSettingsPage()
 
 void TrashSettingsPage::applySettings()
 {
-    m_proxy->save();
+    // The settings cannot have been changed if the KCM has not been loaded
+    if (m_proxy) {
+        m_proxy->save();
+    }
 }
 
 void TrashSettingsPage::restoreDefaults()
 {
+    loadSettings();
     m_proxy->defaults();
 }
 
+void TrashSettingsPage::showEvent(QShowEvent* event)
+{
+    if (!event->spontaneous()) {
+        loadSettings();
+    }
+    SettingsPageBase::showEvent(event);
+}
+
 void TrashSettingsPage::loadSettings()
 {
+    if (m_proxy) {
+        return;
+    }
+
+    m_proxy = new KCModuleProxy(QStringLiteral("kcmtrash"));
+    m_topLayout->addRow(m_proxy);
     m_proxy->load();
+
+    connect(m_proxy, QOverload<bool>::of(&KCModuleProxy::changed), this, &TrashSettingsPage::changed);
 }
 
@@ -9,9 +9,13 @@
 #include "settings/settingspagebase.h"
 
 class KCModuleProxy;
+class QFormLayout;
 
 /**
  * @brief Tab page for the 'Trash' settings of the Dolphin settings dialog, it uses the KCM.
+ *
+ * The KCM is loaded when the page is shown the first time, as it
+ * computes the size of the trash when it is loaded.
  */
 class TrashSettingsPage : public SettingsPageBase
 {
@@ -27,8 +31,16 @@ public:
     /** @see SettingsPageBase::restoreDefaults() */
     void restoreDefaults() override;
 
+protected:
+    void showEvent(QShowEvent* event) override;
+
 private:
+    /**
+     * Creates the KCM and loads its settings, if it has not been created yet.
+     */
     void loadSettings();
+
+    QFormLayout *m_topLayout;
     KCModuleProxy *m_proxy;
 };
 
@@ -354,9 +354,9 @@ void ViewPropertiesDialog::applyViewProperties()
     // are also used as default for new folders.
     const bool useAsDefault = applyToAllFolders || (m_useAsDefault && m_useAsDefault->isChecked());
     if (useAsDefault) {
-        // For directories where no .directory file is available, the .directory
-        // file stored for the global view properties is used as fallback. To update
-        // this file we temporary turn on the global view properties mode.
+        // For directories where no view properties are stored, the global
+        // view properties are used as fallback. To update them we temporary
+        // turn on the global view properties mode.
         Q_ASSERT(!GeneralSettings::globalViewProps());
 
         GeneralSettings::setGlobalViewProps(true);
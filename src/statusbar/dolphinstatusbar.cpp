@@ -7,10 +7,12 @@
 #include "dolphinstatusbar.h"
 
 #include "dolphin_generalsettings.h"
+#include "kitemviews/private/kmemorybudget.h"
 #include "statusbarspaceinfo.h"
 #include "views/dolphinview.h"
 #include "views/zoomlevelinfo.h"
 
+#include <KIO/Global>
 #include <KLocalizedString>
 #include <KSqueezedTextLabel>
 
@@ -27,6 +29,9 @@
 
 namespace {
     const int UpdateDelay = 50;
+
+    // Interval in ms in which the memory usage overlay is updated
+    const int MemoryUsageInterval = 1000;
 }
 
 DolphinStatusBar::DolphinStatusBar(QWidget* parent) :
@@ -42,7 +47,9 @@ DolphinStatusBar::DolphinStatusBar(QWidget* parent) :
     m_progress(100),
     m_showProgressBarTimer(nullptr),
     m_delayUpdateTimer(nullptr),
-    m_textTimestamp()
+    m_textTimestamp(),
+    m_memoryUsageLabel(nullptr),
+    m_memoryUsageTimer(nullptr)
 {
     // Initialize text label
     m_label = new KSqueezedTextLabel(m_text, this);
@@ -124,6 +131,18 @@ DolphinStatusBar::DolphinStatusBar(QWidget* parent) :
     topLayout->addWidget(m_progressTextLabel);
     topLayout->addWidget(m_progressBar);
 
+    if (qEnvironmentVariableIsSet("DOLPHIN_MEMORY_OVERLAY")) {
+        m_memoryUsageLabel = new QLabel(this);
+        m_memoryUsageLabel->setTextFormat(Qt::PlainText);
+        topLayout->addWidget(m_memoryUsageLabel);
+
+        m_memoryUsageTimer = new QTimer(this);
+        m_memoryUsageTimer->setInterval(MemoryUsageInterval);
+        connect(m_memoryUsageTimer, &QTimer::timeout, this, &DolphinStatusBar::updateMemoryUsage);
+        m_memoryUsageTimer->start();
+        updateMemoryUsage();
+    }
+
     setExtensionsVisible(true);
     setWhatsThis(xi18nc("@info:whatsthis Statusbar", "<para>This is "
         "the <emphasis>Statusbar</emphasis>. It contains three elements "
@@ -319,6 +338,18 @@ void DolphinStatusBar::updateZoomSliderToolTip(int zoomLevel)
     m_zoomSlider->setToolTip(i18ncp("@info:tooltip", "Size: 1 pixel", "Size: %1 pixels", size));
 }
 
+void DolphinStatusBar::updateMemoryUsage()
+{
+    // The overlay is meant for debugging, so the texts are not translated
+    const KMemoryBudget& memoryBudget = KMemoryBudget::instance();
+    QString text = QStringLiteral("Memory: %1").arg(KIO::convertSize(memoryBudget.totalUsage()));
+    if (memoryBudget.budget() > 0) {
+        text += QStringLiteral(" / %1").arg(KIO::convertSize(memoryBudget.budget()));
+    }
+    m_memoryUsageLabel->setText(text);
+    m_memoryUsageLabel->setToolTip(memoryBudget.report());
+}
+
 void DolphinStatusBar::setExtensionsVisible(bool visible)
 {
     bool showSpaceInfo = visible;
@@ -111,6 +111,12 @@ private Q_SLOTS:
      */
     void updateZoomSliderToolTip(int zoomLevel);
 
+    /**
+     * Updates the debug overlay that shows the memory usage
+     * estimated by KMemoryBudget.
+     */
+    void updateMemoryUsage();
+
 private:
     /**
      * Makes the space information widget and zoom slider widget
@@ -137,6 +143,10 @@ private:
 
     QTimer* m_delayUpdateTimer;
     QTime m_textTimestamp;
+
+    // Only created if the environment variable DOLPHIN_MEMORY_OVERLAY is set
+    QLabel* m_memoryUsageLabel;
+    QTimer* m_memoryUsageTimer;
 };
 
 #endif
@@ -10,11 +10,66 @@
 
 #include <KIO/FileSystemFreeSpaceJob>
 
+#include <QTimer>
+
+namespace {
+    // Bounds of the interval in which the free space is checked if no changes
+    // of the files on the mount point are noticed
+    const int MinimumPollInterval = 10000;
+    const int InitialPollInterval = 60000;
+    const int MaximumPollInterval = 5 * 60000;
+
+    // A result that is not older than this is shared instead of retrieving the free space again
+    const int RecentSpaceInfoAge = 1000;
+
+    const int ScheduledUpdateDelay = 500;
+
+    // A retrieval that takes longer is canceled, and no retrievals are started for
+    // the mount point for the retry delay, which is doubled up to the maximum
+    // as long as the mount point does not respond
+    const int JobTimeout = 10000;
+    const int InitialRetryDelay = 60000;
+    const int MaximumRetryDelay = 10 * 60000;
+}
+
 MountPointObserver::MountPointObserver(const QUrl& url, QObject* parent) :
     QObject(parent),
     m_url(url),
-    m_referenceCount(0)
+    m_referenceCount(0),
+    m_job(),
+    m_jobQueued(false),
+    m_polling(false),
+    m_retryDelay(0),
+    m_retryDeadline(),
+    m_hasSpaceInfo(false),
+    m_size(0),
+    m_available(0),
+    m_spaceInfoAge(),
+    m_pollTimer(nullptr),
+    m_updateTimer(nullptr),
+    m_jobTimer(nullptr)
+{
+    m_pollTimer = new QTimer(this);
+    m_pollTimer->setInterval(InitialPollInterval);
+    connect(m_pollTimer, &QTimer::timeout, this, &MountPointObserver::slotPollTimeout);
+    m_pollTimer->start();
+
+    m_updateTimer = new QTimer(this);
+    m_updateTimer->setSingleShot(true);
+    m_updateTimer->setInterval(ScheduledUpdateDelay);
+    connect(m_updateTimer, &QTimer::timeout, this, &MountPointObserver::update);
+
+    m_jobTimer = new QTimer(this);
+    m_jobTimer->setSingleShot(true);
+    m_jobTimer->setInterval(JobTimeout);
+    connect(m_jobTimer, &QTimer::timeout, this, &MountPointObserver::slotJobTimeout);
+}
+
+MountPointObserver::~MountPointObserver()
 {
+    if (m_job) {
+        m_job->kill();
+    }
 }
 
 MountPointObserver* MountPointObserver::observerForUrl(const QUrl& url)
@@ -23,21 +78,138 @@ MountPointObserver* MountPointObserver::observerForUrl(const QUrl& url)
     return observer;
 }
 
+bool MountPointObserver::hasSpaceInfo() const
+{
+    return m_hasSpaceInfo;
+}
+
+quint64 MountPointObserver::size() const
+{
+    return m_size;
+}
+
+quint64 MountPointObserver::available() const
+{
+    return m_available;
+}
+
+bool MountPointObserver::isResponsive() const
+{
+    return m_retryDelay == 0 || m_retryDeadline.hasExpired();
+}
+
 void MountPointObserver::update()
+{
+    m_updateTimer->stop();
+    if (isRetrieving()) {
+        // The result of the running job will be emitted
+        if (m_polling && m_jobQueued) {
+            MountPointObserverCache::instance()->requestJob(this, true);
+        }
+        m_polling = false;
+        return;
+    }
+
+    const bool recent = m_hasSpaceInfo && !m_spaceInfoAge.hasExpired(RecentSpaceInfoAge);
+    m_polling = false;
+    if (recent || !startJob(true)) {
+        if (m_hasSpaceInfo) {
+            // Users that have just been connected still need the values,
+            // which are outdated if the mount point is unresponsive
+            QTimer::singleShot(0, this, [this]() {
+                Q_EMIT spaceInfoChanged(m_size, m_available);
+            });
+        }
+    }
+}
+
+void MountPointObserver::scheduleUpdate()
+{
+    if (!m_updateTimer->isActive()) {
+        m_updateTimer->start();
+    }
+}
+
+void MountPointObserver::freeSpaceResult(KIO::Job* job, KIO::filesize_t size, KIO::filesize_t available)
+{
+    m_job = nullptr;
+    m_jobTimer->stop();
+    m_retryDelay = 0;
+    MountPointObserverCache::instance()->startQueuedJobs();
+
+    if (job->error()) {
+        size = 0;
+        available = 0;
+    }
+
+    const bool changed = !m_hasSpaceInfo || size != m_size || available != m_available;
+    if (m_polling) {
+        // Changes that are only noticed by polling are caused by other applications,
+        // which might continue to change the files on the mount point.
+        const int interval = changed ? MinimumPollInterval
+                                     : qMin(m_pollTimer->interval() * 2, MaximumPollInterval);
+        m_pollTimer->setInterval(interval);
+    }
+
+    m_hasSpaceInfo = true;
+    m_size = size;
+    m_available = available;
+    m_spaceInfoAge.start();
+
+    Q_EMIT spaceInfoChanged(size, available);
+}
+
+void MountPointObserver::slotPollTimeout()
 {
     if (m_referenceCount == 0) {
         delete this;
-    } else {
-        KIO::FileSystemFreeSpaceJob* job = KIO::fileSystemFreeSpace(m_url);
-        connect(job, &KIO::FileSystemFreeSpaceJob::result, this, &MountPointObserver::freeSpaceResult);
+        return;
+    }
+
+    if (!isRetrieving()) {
+        m_polling = startJob(false);
     }
 }
 
-void MountPointObserver::freeSpaceResult(KIO::Job* job, KIO::filesize_t size, KIO::filesize_t available)
+void MountPointObserver::slotJobTimeout()
 {
-    if (!job->error()) {
-        Q_EMIT spaceInfoChanged(size, available);
-    } else {
-        Q_EMIT spaceInfoChanged(0, 0);
+    if (!m_job) {
+        return;
     }
+
+    // The last values are kept, as they are more useful than none
+    m_job->kill();
+    m_job = nullptr;
+    m_polling = false;
+
+    m_retryDelay = (m_retryDelay == 0) ? InitialRetryDelay : qMin(m_retryDelay * 2, MaximumRetryDelay);
+    m_retryDeadline.setRemainingTime(m_retryDelay);
+
+    MountPointObserverCache::instance()->startQueuedJobs();
+}
+
+bool MountPointObserver::startJob(bool urgent)
+{
+    if (!isResponsive()) {
+        return false;
+    }
+
+    m_jobQueued = true;
+    MountPointObserverCache::instance()->requestJob(this, urgent);
+    return true;
+}
+
+void MountPointObserver::runJob()
+{
+    m_jobQueued = false;
+
+    KIO::FileSystemFreeSpaceJob* job = KIO::fileSystemFreeSpace(m_url);
+    connect(job, &KIO::FileSystemFreeSpaceJob::result, this, &MountPointObserver::freeSpaceResult);
+    m_job = job;
+    m_jobTimer->start();
+}
+
+bool MountPointObserver::isRetrieving() const
+{
+    return m_job || m_jobQueued;
 }
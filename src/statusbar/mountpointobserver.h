@@ -9,13 +9,23 @@
 
 #include <KIO/Job>
 
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
 #include <QObject>
+#include <QPointer>
 #include <QUrl>
 
+class QTimer;
+
 /**
  * A MountPointObserver can be used to determine the free space on a mount
- * point. It will then check the free space periodically, and emit the signal
- * spaceInfoChanged() if the return value of spaceInfo() has changed.
+ * point. The free space is retrieved again when files on the mount point have
+ * been changed (see MountPointObserverCache) and update() is invoked. As
+ * fallback the free space is checked periodically: The interval is decreased
+ * if a check reveals changed values and increased otherwise. The signal
+ * spaceInfoChanged() is emitted with the retrieved values. As the result of
+ * a retrieval is shared by all users, a retrieval is not started if one is
+ * running already or the last result is recent.
  *
  * Since multiple users which watch paths on the same mount point can share
  * a MountPointObserver, it is not possible to create a MountPointObserver
@@ -31,17 +41,25 @@
  * the MountPointObserver any more.
  *
  * The object will not be deleted immediately if the reference count reaches
- * zero. The object will only be destroyed when the next periodic update of
+ * zero. The object will only be destroyed when the next periodic check of
  * the free space information happens, and the reference count is still zero.
  * This approach makes it possible to re-use the object if a new user requests
  * the free space for the same mount point before the next update.
+ *
+ * The last retrieved values stay available by size() and available() while
+ * they are retrieved again. MountPointObserverCache limits the number of
+ * retrievals that run at the same time. A retrieval that does not finish
+ * within a timeout is canceled, and the mount point is considered as
+ * unresponsive: No retrievals are started for it for a while, which is
+ * increased as long as the mount point stays unresponsive, so that dead
+ * network mounts don't block the retrievals of the other mount points.
  */
 class MountPointObserver : public QObject
 {
     Q_OBJECT
 
     explicit MountPointObserver(const QUrl& url, QObject* parent = nullptr);
-    ~MountPointObserver() override {}
+    ~MountPointObserver() override;
 
 public:
     /**
@@ -53,8 +71,8 @@ public:
 
     /**
      * This function can be used to indicate that the caller does not need this MountPointObserver
-     * any more. Internally, a reference count is decreased. If the reference count is zero while
-     * update() is called, the object deletes itself.
+     * any more. Internally, a reference count is decreased. If the reference count is zero when
+     * the free space is checked periodically, the object deletes itself.
      */
     void deref()
     {
@@ -68,6 +86,21 @@ public:
      */
     static MountPointObserver* observerForUrl(const QUrl& url);
 
+    /**
+     * @return True if the free space has been retrieved at least once.
+     *         The last values are returned by size() and available().
+     */
+    bool hasSpaceInfo() const;
+    quint64 size() const;
+    quint64 available() const;
+
+    /**
+     * @return False if the last retrieval has been canceled because of the
+     *         timeout and no retrievals are started until the retry delay
+     *         is exceeded.
+     */
+    bool isResponsive() const;
+
 Q_SIGNALS:
     /**
      * This signal is emitted when the size has been retrieved.
@@ -77,17 +110,64 @@ Q_SIGNALS:
 public Q_SLOTS:
     /**
      * If this slot is invoked, MountPointObserver starts a new driveSize job
-     * to get the drive's size.
+     * to get the drive's size. If a job is running already, its result is
+     * used. If the size has been retrieved recently, the last result is
+     * emitted again without starting a job.
      */
     void update();
 
+    /**
+     * Invokes update() after a short delay. Is used if files on the mount
+     * point have been changed, so that the free space is retrieved only once
+     * for a series of changes.
+     */
+    void scheduleUpdate();
+
 private Q_SLOTS:
     void freeSpaceResult(KIO::Job* job, KIO::filesize_t size, KIO::filesize_t available);
+    void slotPollTimeout();
+    void slotJobTimeout();
+
+private:
+    /**
+     * Requests a retrieval from MountPointObserverCache, which invokes
+     * runJob() as soon as the number of running retrievals allows it.
+     * If \a urgent is true, the retrieval is preferred to retrievals that
+     * have been requested by polling. Does nothing if the mount point
+     * is unresponsive.
+     * @return True if a retrieval has been requested.
+     */
+    bool startJob(bool urgent);
+
+    void runJob();
+
+    /**
+     * @return True if a retrieval is running or waiting to be run.
+     */
+    bool isRetrieving() const;
 
 private:
     const QUrl m_url;
     int m_referenceCount;
 
+    QPointer<KIO::Job> m_job;
+    bool m_jobQueued;
+    bool m_polling; // True if the running job has been started by slotPollTimeout()
+
+    // Delay after which a retrieval is tried again for an unresponsive
+    // mount point, or 0 if the mount point is responsive
+    int m_retryDelay;
+    QDeadlineTimer m_retryDeadline;
+
+    bool m_hasSpaceInfo;
+    quint64 m_size;
+    quint64 m_available;
+    QElapsedTimer m_spaceInfoAge;
+
+    QTimer* m_pollTimer;
+    QTimer* m_updateTimer;
+    QTimer* m_jobTimer;
+
     friend class MountPointObserverCache;
 };
 
@@ -8,24 +8,55 @@
 
 #include "mountpointobserver.h"
 
-#include <KMountPoint>
+#include <KDirNotify>
+#include <Solid/Device>
+#include <Solid/DeviceNotifier>
+#include <Solid/StorageAccess>
 
-#include <QTimer>
+#include <QDBusConnection>
+
+namespace {
+    // Mount points that are changed without Solid noticing it, e.g. by
+    // invoking mount manually, are recognized after this time
+    const int MountPointsLifetime = 10000;
+
+    // Maximum number of free space retrievals that run at the same time
+    const int MaximumRunningJobs = 4;
+}
 
 class MountPointObserverCacheSingleton
 {
 public:
     MountPointObserverCache instance;
 };
+
 Q_GLOBAL_STATIC(MountPointObserverCacheSingleton, s_MountPointObserverCache)
 
 
 MountPointObserverCache::MountPointObserverCache() :
     m_observerForMountPoint(),
     m_mountPointForObserver(),
-    m_updateTimer(nullptr)
+    m_queuedObservers(),
+    m_mountPoints(),
+    m_mountPointsAge(),
+    m_storageDevices()
 {
-    m_updateTimer = new QTimer(this);
+    org::kde::KDirNotify* dirNotify = new org::kde::KDirNotify(QString(), QString(),
+                                                               QDBusConnection::sessionBus(), this);
+    connect(dirNotify, &OrgKdeKDirNotifyInterface::FilesAdded, this, &MountPointObserverCache::slotFilesAdded);
+    connect(dirNotify, &OrgKdeKDirNotifyInterface::FilesChanged, this, &MountPointObserverCache::slotFilesChanged);
+    connect(dirNotify, &OrgKdeKDirNotifyInterface::FilesRemoved, this, &MountPointObserverCache::slotFilesChanged);
+
+    Solid::DeviceNotifier* deviceNotifier = Solid::DeviceNotifier::instance();
+    connect(deviceNotifier, &Solid::DeviceNotifier::deviceAdded,
+            this, &MountPointObserverCache::slotDeviceAdded);
+    connect(deviceNotifier, &Solid::DeviceNotifier::deviceRemoved,
+            this, &MountPointObserverCache::slotDeviceRemoved);
+
+    const QList<Solid::Device> devices = Solid::Device::listFromType(Solid::DeviceInterface::StorageAccess);
+    for (const Solid::Device& device : devices) {
+        watchStorageAccess(device.udi());
+    }
 }
 
 MountPointObserverCache::~MountPointObserverCache()
@@ -39,21 +70,7 @@ MountPointObserverCache* MountPointObserverCache::instance()
 
 MountPointObserver* MountPointObserverCache::observerForUrl(const QUrl& url)
 {
-    QUrl cachedObserverUrl;
-    // If the url is a local path we can extract the root dir by checking the mount points.
-    if (url.isLocalFile()) {
-        // Try to share the observer with other paths that have the same mount point.
-        KMountPoint::Ptr mountPoint = KMountPoint::currentMountPoints().findByPath(url.toLocalFile());
-        if (mountPoint) {
-            cachedObserverUrl = QUrl::fromLocalFile(mountPoint->mountPoint());
-        } else {
-            // Even if determining the mount point failed, the observer might still
-            // be able to retrieve information about the url.
-            cachedObserverUrl = url;
-        }
-    } else {
-        cachedObserverUrl = url;
-    }
+    const QUrl cachedObserverUrl = mountPointUrl(url);
 
     MountPointObserver* observer = m_observerForMountPoint.value(cachedObserverUrl);
     if (!observer) {
@@ -63,15 +80,39 @@ MountPointObserver* MountPointObserverCache::observerForUrl(const QUrl& url)
         Q_ASSERT(m_observerForMountPoint.count() == m_mountPointForObserver.count());
 
         connect(observer, &MountPointObserver::destroyed, this, &MountPointObserverCache::slotObserverDestroyed);
+    }
 
-        if (!m_updateTimer->isActive()) {
-            m_updateTimer->start(60000); // 1 minute
+    return observer;
+}
+
+void MountPointObserverCache::requestJob(MountPointObserver* observer, bool urgent)
+{
+    const int index = m_queuedObservers.indexOf(observer);
+    if (index >= 0) {
+        if (!urgent) {
+            return;
         }
+        m_queuedObservers.remove(index);
+    }
 
-        connect(m_updateTimer, &QTimer::timeout, observer, &MountPointObserver::update);
+    if (urgent) {
+        m_queuedObservers.prepend(observer);
+    } else {
+        m_queuedObservers.append(observer);
     }
+    startQueuedJobs();
+}
 
-    return observer;
+void MountPointObserverCache::startQueuedJobs()
+{
+    int runningJobs = runningJobsCount();
+    while (runningJobs < MaximumRunningJobs && !m_queuedObservers.isEmpty()) {
+        const QPointer<MountPointObserver> observer = m_queuedObservers.takeFirst();
+        if (observer) {
+            observer->runJob();
+            ++runningJobs;
+        }
+    }
 }
 
 void MountPointObserverCache::slotObserverDestroyed(QObject* observer)
@@ -84,7 +125,105 @@ void MountPointObserverCache::slotObserverDestroyed(QObject* observer)
 
     Q_ASSERT(m_observerForMountPoint.count() == m_mountPointForObserver.count());
 
-    if (m_mountPointForObserver.isEmpty()) {
-        m_updateTimer->stop();
+    // The retrieval of the observer might have been running
+    startQueuedJobs();
+}
+
+void MountPointObserverCache::slotFilesAdded(const QString& directory)
+{
+    scheduleUpdate(QUrl(directory));
+}
+
+void MountPointObserverCache::slotFilesChanged(const QStringList& files)
+{
+    for (const QString& file : files) {
+        scheduleUpdate(QUrl(file));
+    }
+}
+
+void MountPointObserverCache::slotMountPointsChanged()
+{
+    m_mountPoints.clear();
+    for (MountPointObserver* observer : qAsConst(m_observerForMountPoint)) {
+        observer->scheduleUpdate();
+    }
+}
+
+void MountPointObserverCache::slotDeviceAdded(const QString& udi)
+{
+    watchStorageAccess(udi);
+    slotMountPointsChanged();
+}
+
+void MountPointObserverCache::slotDeviceRemoved(const QString& udi)
+{
+    m_storageDevices.remove(udi);
+    slotMountPointsChanged();
+}
+
+QUrl MountPointObserverCache::mountPointUrl(const QUrl& url)
+{
+    // If the url is a local path we can extract the root dir by checking the mount points.
+    if (url.isLocalFile()) {
+        if (m_mountPoints.isEmpty() || m_mountPointsAge.hasExpired(MountPointsLifetime)) {
+            m_mountPoints = KMountPoint::currentMountPoints();
+            m_mountPointsAge.start();
+        }
+
+        // Try to share the observer with other paths that have the same mount point.
+        KMountPoint::Ptr mountPoint = m_mountPoints.findByPath(url.toLocalFile());
+        if (mountPoint) {
+            return QUrl::fromLocalFile(mountPoint->mountPoint());
+        }
+    }
+
+    // Even if determining the mount point failed, the observer might still
+    // be able to retrieve information about the url.
+    return url;
+}
+
+void MountPointObserverCache::scheduleUpdate(const QUrl& url)
+{
+    if (m_observerForMountPoint.isEmpty()) {
+        return;
+    }
+
+    if (url.isLocalFile()) {
+        MountPointObserver* observer = m_observerForMountPoint.value(mountPointUrl(url));
+        if (observer) {
+            observer->scheduleUpdate();
+        }
+        return;
+    }
+
+    // The observers of remote URLs are not shared, so all observers of
+    // the same host are updated.
+    for (auto it = m_observerForMountPoint.constBegin(); it != m_observerForMountPoint.constEnd(); ++it) {
+        const QUrl& observerUrl = it.key();
+        if (observerUrl.scheme() == url.scheme() && observerUrl.authority() == url.authority()) {
+            it.value()->scheduleUpdate();
+        }
+    }
+}
+
+int MountPointObserverCache::runningJobsCount() const
+{
+    int count = 0;
+    for (const MountPointObserver* observer : m_observerForMountPoint) {
+        if (observer->m_job) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+void MountPointObserverCache::watchStorageAccess(const QString& udi)
+{
+    const Solid::Device device(udi);
+    const Solid::StorageAccess* access = device.as<Solid::StorageAccess>();
+    if (access) {
+        connect(access, &Solid::StorageAccess::accessibilityChanged,
+                this, &MountPointObserverCache::slotMountPointsChanged, Qt::UniqueConnection);
+        m_storageDevices.insert(udi, device);
     }
 }
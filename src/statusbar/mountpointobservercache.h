@@ -7,12 +7,28 @@
 #ifndef MOUNTPOINTOBSERVERCACHE_H
 #define MOUNTPOINTOBSERVERCACHE_H
 
+#include <KMountPoint>
+#include <Solid/Device>
+
+#include <QElapsedTimer>
 #include <QHash>
 #include <QObject>
+#include <QPointer>
+#include <QVector>
 
 class MountPointObserver;
-class QTimer;
 
+/**
+ * @brief Provides the MountPointObservers of all windows.
+ *
+ * The free space of a mount point is updated when files on the mount point
+ * are added, changed or removed, which is announced by KIO for the jobs of
+ * all applications, and when devices are mounted or unmounted.
+ *
+ * The observers are shared by the status bars and the capacity bars of the
+ * Places panel. Only a few retrievals of the free space run at the same
+ * time, the other ones wait in a queue, see requestJob().
+ */
 class MountPointObserverCache : public QObject
 {
     Q_OBJECT
@@ -28,16 +44,72 @@ public:
      */
     MountPointObserver* observerForUrl(const QUrl& url);
 
+    /**
+     * Invokes MountPointObserver::runJob() of \a observer as soon as less than
+     * the maximum number of retrievals are running. If \a urgent is true, the
+     * observer is put in front of the observers that are waiting already.
+     */
+    void requestJob(MountPointObserver* observer, bool urgent);
+
+    /**
+     * Runs the retrievals of the waiting observers as far as the maximum
+     * number of running retrievals allows it. Is invoked when a retrieval
+     * has been finished or canceled.
+     */
+    void startQueuedJobs();
+
 private Q_SLOTS:
     /**
      * Removes the given \a observer from the cache.
      */
     void slotObserverDestroyed(QObject* observer);
 
+    void slotFilesAdded(const QString& directory);
+    void slotFilesChanged(const QStringList& files);
+
+    /**
+     * Is invoked if a device has been added, removed, mounted or unmounted.
+     */
+    void slotMountPointsChanged();
+
+    void slotDeviceAdded(const QString& udi);
+    void slotDeviceRemoved(const QString& udi);
+
+private:
+    /**
+     * @return The URL of the mount point of \a url, which is the key of
+     *         the observer for \a url.
+     */
+    QUrl mountPointUrl(const QUrl& url);
+
+    /**
+     * Schedules an update of the observers for the mount point of \a url.
+     */
+    void scheduleUpdate(const QUrl& url);
+
+    void watchStorageAccess(const QString& udi);
+
+    /**
+     * @return Number of observers whose retrieval is running.
+     */
+    int runningJobsCount() const;
+
 private:
     QHash<QUrl, MountPointObserver*> m_observerForMountPoint;
     QHash<QObject*, QUrl> m_mountPointForObserver;
-    QTimer* m_updateTimer;
+
+    // Observers that wait for running their retrieval
+    QVector<QPointer<MountPointObserver> > m_queuedObservers;
+
+    // The current mount points are cached, as reading them requires file
+    // system operations. They are read again on mount events, or if they
+    // are older than MountPointsLifetime.
+    KMountPoint::List m_mountPoints;
+    QElapsedTimer m_mountPointsAge;
+
+    // Devices whose storage access is watched. The devices must be kept,
+    // otherwise Solid deletes the storage access interfaces.
+    QHash<QString, Solid::Device> m_storageDevices;
 
     friend class MountPointObserverCacheSingleton;
 };
@@ -18,6 +18,7 @@ SpaceInfoObserver::SpaceInfoObserver(const QUrl& url, QObject* parent) :
     m_mountPointObserver = MountPointObserver::observerForUrl(url);
     m_mountPointObserver->ref();
     connect(m_mountPointObserver, &MountPointObserver::spaceInfoChanged, this, &SpaceInfoObserver::spaceInfoChanged);
+    applyRetrievedSpaceInfo();
     m_mountPointObserver->update();
 }
 
@@ -52,6 +53,7 @@ void SpaceInfoObserver::setUrl(const QUrl& url)
         m_mountPointObserver = newObserver;
         m_mountPointObserver->ref();
         connect(m_mountPointObserver, &MountPointObserver::spaceInfoChanged, this, &SpaceInfoObserver::spaceInfoChanged);
+        applyRetrievedSpaceInfo();
 
         // If newObserver is cached it won't call update until the next timer update, 
         // so update the observer now.
@@ -59,6 +61,11 @@ void SpaceInfoObserver::setUrl(const QUrl& url)
     }
 }
 
+bool SpaceInfoObserver::hasData() const
+{
+    return m_hasData;
+}
+
 void SpaceInfoObserver::update()
 {
     if (m_mountPointObserver) {
@@ -77,3 +84,12 @@ void SpaceInfoObserver::spaceInfoChanged(quint64 size, quint64 available)
         Q_EMIT valuesChanged();
     }
 }
+
+void SpaceInfoObserver::applyRetrievedSpaceInfo()
+{
+    // The values of a shared observer are shown at once, even
+    // if they are outdated until they have been retrieved again
+    if (m_mountPointObserver->hasSpaceInfo()) {
+        spaceInfoChanged(m_mountPointObserver->size(), m_mountPointObserver->available());
+    }
+}
@@ -25,6 +25,12 @@ public:
     quint64 size() const;
     quint64 available() const;
 
+    /**
+     * @return True if the free space has been retrieved
+     *         for the mount point of the URL.
+     */
+    bool hasData() const;
+
     void setUrl(const QUrl& url);
 
 public Q_SLOTS:
@@ -39,6 +45,13 @@ Q_SIGNALS:
 private Q_SLOTS:
     void spaceInfoChanged(quint64 size, quint64 available);
 
+private:
+    /**
+     * Takes the values that the MountPointObserver has
+     * retrieved already for another user.
+     */
+    void applyRetrievedSpaceInfo();
+
 private:
     MountPointObserver* m_mountPointObserver;
 
@@ -0,0 +1,190 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "actionpalette/actionindex.h"
+
+#include <QAction>
+#include <QTest>
+
+class ActionIndexTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testIgnoredActions();
+    void testMatch();
+    void testRanking();
+    void testNarrowingQuery();
+    void testUpdateAction();
+    void testShortcut();
+    void testTruncate();
+    void testDuplicateAction();
+
+private:
+    QAction* addAction(const QString& text, const QString& category = QString());
+
+    ActionIndex* m_index;
+    QList<QAction*> m_actions;
+};
+
+void ActionIndexTest::init()
+{
+    m_index = new ActionIndex();
+}
+
+void ActionIndexTest::cleanup()
+{
+    delete m_index;
+    m_index = nullptr;
+    qDeleteAll(m_actions);
+    m_actions.clear();
+}
+
+void ActionIndexTest::testIgnoredActions()
+{
+    QAction* separator = new QAction(nullptr);
+    separator->setSeparator(true);
+    m_actions.append(separator);
+    m_index->addAction(separator);
+    addAction(QString());
+    QCOMPARE(m_index->count(), 0);
+
+    QAction* copy = addAction(QStringLiteral("&Copy"));
+    QAction* paste = addAction(QStringLiteral("&Paste"));
+    paste->setEnabled(false);
+    QCOMPARE(m_index->count(), 2);
+    QCOMPARE(m_index->match(QString(), 10), QVector<QAction*>({copy}));
+    QCOMPARE(m_index->match(QStringLiteral("p"), 10), QVector<QAction*>({copy}));
+
+    // Deleted actions are not matched anymore
+    m_actions.removeOne(copy);
+    delete copy;
+    QVERIFY(m_index->match(QStringLiteral("c"), 10).isEmpty());
+}
+
+void ActionIndexTest::testMatch()
+{
+    QAction* newTab = addAction(QStringLiteral("New &Tab"));
+    QAction* closeTab = addAction(QStringLiteral("&Close Tab"));
+    QAction* openTerminal = addAction(QStringLiteral("Open &Terminal"));
+
+    // The characters must appear in order, independent from the case
+    QCOMPARE(m_index->match(QStringLiteral("NTAB"), 10), QVector<QAction*>({newTab}));
+    QCOMPARE(m_index->match(QStringLiteral("oterm"), 10), QVector<QAction*>({openTerminal}));
+    QVERIFY(m_index->match(QStringLiteral("bat"), 10).isEmpty());
+
+    const QVector<QAction*> tabActions = m_index->match(QStringLiteral("tab"), 10);
+    QCOMPARE(tabActions.count(), 2);
+    QVERIFY(tabActions.contains(newTab));
+    QVERIFY(tabActions.contains(closeTab));
+
+    QCOMPARE(m_index->match(QStringLiteral("e"), 2).count(), 2);
+}
+
+void ActionIndexTest::testRanking()
+{
+    QAction* showDetails = addAction(QStringLiteral("Show Details"));
+    QAction* showHiddenFiles = addAction(QStringLiteral("Show Hidden Files"));
+    QAction* hide = addAction(QStringLiteral("Hide"));
+
+    // Starts of words rank higher than characters inside of words
+    QCOMPARE(m_index->match(QStringLiteral("shf"), 10), QVector<QAction*>({showHiddenFiles}));
+    QCOMPARE(m_index->match(QStringLiteral("hf"), 10), QVector<QAction*>({showHiddenFiles}));
+    QCOMPARE(m_index->match(QStringLiteral("sd"), 10).first(), showDetails);
+
+    // A prefix ranks higher and a shorter text wins if the scores are equal
+    QCOMPARE(m_index->match(QStringLiteral("hid"), 10), QVector<QAction*>({hide, showHiddenFiles}));
+}
+
+void ActionIndexTest::testNarrowingQuery()
+{
+    QAction* rename = addAction(QStringLiteral("Rename..."));
+    QAction* reload = addAction(QStringLiteral("Reload"));
+
+    QCOMPARE(m_index->match(QStringLiteral("re"), 10).count(), 2);
+    QCOMPARE(m_index->match(QStringLiteral("ren"), 10), QVector<QAction*>({rename}));
+    QCOMPARE(m_index->match(QStringLiteral("renx"), 10), QVector<QAction*>());
+
+    // A shorter query matches all actions again
+    QCOMPARE(m_index->match(QStringLiteral("rel"), 10), QVector<QAction*>({reload}));
+
+    // An action that has been disabled while typing is matched after it is enabled again
+    QCOMPARE(m_index->match(QStringLiteral("r"), 10).count(), 2);
+    rename->setEnabled(false);
+    QCOMPARE(m_index->match(QStringLiteral("re"), 10), QVector<QAction*>({reload}));
+    rename->setEnabled(true);
+    QCOMPARE(m_index->match(QStringLiteral("ren"), 10), QVector<QAction*>({rename}));
+}
+
+void ActionIndexTest::testUpdateAction()
+{
+    QAction* action = addAction(QStringLiteral("Show Hidden Files"));
+    QCOMPARE(m_index->match(QStringLiteral("show"), 10), QVector<QAction*>({action}));
+
+    action->setText(QStringLiteral("Hide Hidden Files"));
+    m_index->updateAction(action);
+    QVERIFY(m_index->match(QStringLiteral("show"), 10).isEmpty());
+    QCOMPARE(m_index->match(QStringLiteral("hide"), 10), QVector<QAction*>({action}));
+}
+
+void ActionIndexTest::testShortcut()
+{
+    QAction* trash = addAction(QStringLiteral("Move to Trash"));
+    QAction* terminal = addAction(QStringLiteral("Open Terminal"));
+    terminal->setShortcut(QKeySequence(Qt::SHIFT | Qt::Key_F4));
+    m_index->updateAction(terminal);
+
+    const QString shortcut = terminal->shortcut().toString(QKeySequence::NativeText);
+    QCOMPARE(m_index->match(shortcut, 10), QVector<QAction*>({terminal}));
+
+    // The category is matched as well, but ranks lower than the text
+    QAction* compress = addAction(QStringLiteral("Here"), QStringLiteral("Compress"));
+    QCOMPARE(m_index->match(QStringLiteral("compress"), 10), QVector<QAction*>({compress}));
+    QCOMPARE(m_index->match(QStringLiteral("t"), 10).count(), 2);
+    QVERIFY(!m_index->match(QStringLiteral("mt"), 10).contains(compress));
+    QCOMPARE(m_index->match(QStringLiteral("mt"), 10).first(), trash);
+}
+
+void ActionIndexTest::testTruncate()
+{
+    QAction* copy = addAction(QStringLiteral("Copy"));
+    addAction(QStringLiteral("Copy Location"));
+    m_index->truncate(1);
+    QCOMPARE(m_index->count(), 1);
+    QCOMPARE(m_index->match(QStringLiteral("copy"), 10), QVector<QAction*>({copy}));
+}
+
+void ActionIndexTest::testDuplicateAction()
+{
+    QAction* copy = addAction(QStringLiteral("Copy"));
+    m_index->addAction(copy, QStringLiteral("Edit"));
+    QCOMPARE(m_index->count(), 1);
+    QCOMPARE(m_index->match(QStringLiteral("copy"), 10), QVector<QAction*>({copy}));
+
+    // A truncated action can be added again
+    m_index->truncate(0);
+    m_index->addAction(copy);
+    QCOMPARE(m_index->count(), 1);
+
+    copy->setText(QStringLiteral("Duplicate"));
+    m_index->updateAction(copy);
+    QCOMPARE(m_index->match(QStringLiteral("dup"), 10), QVector<QAction*>({copy}));
+}
+
+QAction* ActionIndexTest::addAction(const QString& text, const QString& category)
+{
+    QAction* action = new QAction(text, nullptr);
+    m_actions.append(action);
+    m_index->addAction(action, category);
+    return action;
+}
+
+QTEST_MAIN(ActionIndexTest)
+
+#include "actionindextest.moc"
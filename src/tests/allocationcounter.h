@@ -0,0 +1,34 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+/**
+ * @brief Counts the heap allocations of the benchmark process.
+ *
+ * If the benchmark is linked against glibc, malloc(), calloc() and realloc()
+ * are replaced by functions that count the calls and forward them to
+ * glibc. This includes the allocations of operator new and of the Qt
+ * containers. The allocations of all threads are counted.
+ */
+class AllocationCounter
+{
+public:
+    /**
+     * @return True if the allocations are counted on this platform.
+     */
+    static bool isAvailable();
+
+    /**
+     * @return Number of allocations since the start of the process.
+     */
+    static qint64 allocations();
+};
+
+#endif
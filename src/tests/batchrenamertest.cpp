@@ -0,0 +1,234 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "views/batchrenamer.h"
+#include "views/localoperationundo.h"
+#include "testdir.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSignalSpy>
+#include <QTest>
+
+#include <algorithm>
+
+class BatchRenamerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testValidPattern_data();
+    void testValidPattern();
+    void testNewNames();
+    void testDuplicateNames();
+    void testRenameLocalFiles();
+    void testShiftNumbers();
+    void testSwapNames();
+    void testExistingFile();
+    void testUndo();
+
+private:
+    KFileItemList createItems(const QString& prefix, int count);
+
+private:
+    TestDir* m_testDir;
+};
+
+void BatchRenamerTest::initTestCase()
+{
+    qRegisterMetaType<QList<QUrl>>("QList<QUrl>");
+}
+
+void BatchRenamerTest::init()
+{
+    m_testDir = new TestDir();
+}
+
+void BatchRenamerTest::cleanup()
+{
+    delete m_testDir;
+    m_testDir = nullptr;
+}
+
+void BatchRenamerTest::testValidPattern_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<bool>("valid");
+
+    QTest::newRow("placeholder") << "a#" << true;
+    QTest::newRow("sequence") << "a ### b" << true;
+    QTest::newRow("no placeholder") << "a" << false;
+    QTest::newRow("two sequences") << "#a#" << false;
+    QTest::newRow("slash") << "a/#" << false;
+}
+
+void BatchRenamerTest::testValidPattern()
+{
+    QFETCH(QString, pattern);
+    QFETCH(bool, valid);
+
+    QCOMPARE(BatchRenamer::isValidPattern(pattern), valid);
+}
+
+void BatchRenamerTest::testNewNames()
+{
+    const KFileItemList items = {
+        KFileItem(QUrl::fromLocalFile(m_testDir->path() + "/a.txt")),
+        KFileItem(QUrl::fromLocalFile(m_testDir->path() + "/b")),
+        KFileItem(QUrl::fromLocalFile(m_testDir->path() + "/c.tar.gz"))
+    };
+
+    QCOMPARE(BatchRenamer::newNames(items, "New ##", 9),
+             QStringList({"New 09.txt", "New 10", "New 11.tar.gz"}));
+}
+
+void BatchRenamerTest::testDuplicateNames()
+{
+    m_testDir->createDir("sub");
+    const KFileItemList items = {
+        KFileItem(QUrl::fromLocalFile(m_testDir->path() + "/a")),
+        KFileItem(QUrl::fromLocalFile(m_testDir->path() + "/sub/a")),
+        KFileItem(QUrl::fromLocalFile(m_testDir->path() + "/b"))
+    };
+
+    QCOMPARE(BatchRenamer::findDuplicateName(items, {"x", "x", "y"}), -1);
+    QCOMPARE(BatchRenamer::findDuplicateName(items, {"x", "y", "x"}), 2);
+}
+
+void BatchRenamerTest::testRenameLocalFiles()
+{
+    const KFileItemList items = createItems("a", 150);
+
+    BatchRenamer renamer;
+    QSignalSpy finishedSpy(&renamer, &BatchRenamer::finished);
+    QSignalSpy errorSpy(&renamer, &BatchRenamer::errorMessage);
+    renamer.start(items, "b###", 1);
+    QVERIFY(renamer.isRunning());
+    QVERIFY(finishedSpy.wait());
+    QVERIFY(!renamer.isRunning());
+    QCOMPARE(errorSpy.count(), 0);
+
+    const QList<QUrl> renamedUrls = finishedSpy.takeFirst().at(0).value<QList<QUrl>>();
+    QCOMPARE(renamedUrls.count(), 150);
+    QCOMPARE(renamedUrls.first(), QUrl::fromLocalFile(m_testDir->path() + "/b001.txt"));
+    QVERIFY(QFileInfo::exists(m_testDir->path() + "/b001.txt"));
+    QVERIFY(QFileInfo::exists(m_testDir->path() + "/b150.txt"));
+    QVERIFY(!QFileInfo::exists(m_testDir->path() + "/a1.txt"));
+}
+
+void BatchRenamerTest::testShiftNumbers()
+{
+    // Each item is renamed to the current name of the next item
+    const KFileItemList items = createItems("a", 150);
+
+    BatchRenamer renamer;
+    QSignalSpy finishedSpy(&renamer, &BatchRenamer::finished);
+    QSignalSpy errorSpy(&renamer, &BatchRenamer::errorMessage);
+    renamer.start(items, "a#", 2);
+    QVERIFY(finishedSpy.wait());
+    QCOMPARE(errorSpy.count(), 0);
+
+    QCOMPARE(finishedSpy.takeFirst().at(0).value<QList<QUrl>>().count(), 150);
+    QVERIFY(!QFileInfo::exists(m_testDir->path() + "/a1.txt"));
+    QVERIFY(QFileInfo::exists(m_testDir->path() + "/a2.txt"));
+    QVERIFY(QFileInfo::exists(m_testDir->path() + "/a151.txt"));
+    QCOMPARE(QDir(m_testDir->path()).entryList(QDir::Files).count(), 150);
+}
+
+void BatchRenamerTest::testSwapNames()
+{
+    // The items are renamed in reverse order, so each item gets the name
+    // of another item that gets its name, which requires temporary names
+    KFileItemList items = createItems("a", 150);
+    std::reverse(items.begin(), items.end());
+    for (int i = 1; i <= 150; ++i) {
+        QFile file(m_testDir->path() + QStringLiteral("/a%1.txt").arg(i));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(QByteArray::number(i));
+    }
+
+    BatchRenamer renamer;
+    QSignalSpy finishedSpy(&renamer, &BatchRenamer::finished);
+    QSignalSpy errorSpy(&renamer, &BatchRenamer::errorMessage);
+    renamer.start(items, "a#", 1);
+    QVERIFY(finishedSpy.wait());
+    QCOMPARE(errorSpy.count(), 0);
+
+    QCOMPARE(finishedSpy.takeFirst().at(0).value<QList<QUrl>>().count(), 150);
+    QCOMPARE(QDir(m_testDir->path()).entryList(QDir::Files).count(), 150);
+    for (int i = 1; i <= 150; ++i) {
+        QFile file(m_testDir->path() + QStringLiteral("/a%1.txt").arg(i));
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(file.readAll(), QByteArray::number(151 - i));
+    }
+}
+
+void BatchRenamerTest::testExistingFile()
+{
+    // Existing files that are not renamed must not be replaced
+    const KFileItemList items = createItems("a", 100);
+    m_testDir->createFile("b5.txt", "existing");
+
+    BatchRenamer renamer;
+    QSignalSpy finishedSpy(&renamer, &BatchRenamer::finished);
+    QSignalSpy errorSpy(&renamer, &BatchRenamer::errorMessage);
+    renamer.start(items, "b#", 1);
+    QVERIFY(finishedSpy.wait());
+    QCOMPARE(errorSpy.count(), 1);
+
+    QCOMPARE(finishedSpy.takeFirst().at(0).value<QList<QUrl>>().count(), 99);
+    QVERIFY(QFileInfo::exists(m_testDir->path() + "/a5.txt"));
+
+    QFile existingFile(m_testDir->path() + "/b5.txt");
+    QVERIFY(existingFile.open(QIODevice::ReadOnly));
+    QCOMPARE(existingFile.readAll(), QByteArray("existing"));
+}
+
+void BatchRenamerTest::testUndo()
+{
+    const KFileItemList items = createItems("a", 150);
+
+    BatchRenamer renamer;
+    QSignalSpy finishedSpy(&renamer, &BatchRenamer::finished);
+    renamer.start(items, "a#", 2);
+    QVERIFY(finishedSpy.wait());
+    QVERIFY(QFileInfo::exists(m_testDir->path() + "/a151.txt"));
+
+    LocalOperationUndo& undo = LocalOperationUndo::instance();
+    QVERIFY(undo.isUndoAvailable());
+
+    QSignalSpy undoFinishedSpy(&undo, &LocalOperationUndo::undoFinished);
+    QSignalSpy errorSpy(&undo, &LocalOperationUndo::errorMessage);
+    undo.undo();
+    QVERIFY(!undo.isUndoAvailable());
+    QVERIFY(undoFinishedSpy.wait());
+    QCOMPARE(errorSpy.count(), 0);
+
+    QVERIFY(QFileInfo::exists(m_testDir->path() + "/a1.txt"));
+    QVERIFY(QFileInfo::exists(m_testDir->path() + "/a150.txt"));
+    QVERIFY(!QFileInfo::exists(m_testDir->path() + "/a151.txt"));
+    QCOMPARE(QDir(m_testDir->path()).entryList(QDir::Files).count(), 150);
+}
+
+KFileItemList BatchRenamerTest::createItems(const QString& prefix, int count)
+{
+    KFileItemList items;
+    for (int i = 1; i <= count; ++i) {
+        const QString name = prefix + QString::number(i) + ".txt";
+        m_testDir->createFile(name);
+        items.append(KFileItem(QUrl::fromLocalFile(m_testDir->path() + '/' + name)));
+    }
+    return items;
+}
+
+QTEST_GUILESS_MAIN(BatchRenamerTest)
+
+#include "batchrenamertest.moc"
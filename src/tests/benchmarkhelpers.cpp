@@ -0,0 +1,246 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "benchmarkhelpers.h"
+
+#include "kitemviews/kfileitemmodel.h"
+
+#include <KIO/UDSEntry>
+
+#include <QDateTime>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QJsonDocument>
+#include <QSet>
+#include <QStringList>
+#include <QtMath>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    void messageOutput(QtMsgType type, const QMessageLogContext& context, const QString& msg)
+    {
+        Q_UNUSED(context)
+
+        switch (type) {
+        case QtCriticalMsg:
+            fprintf(stderr, "Critical: %s\n", msg.toLocal8Bit().data());
+            break;
+        case QtFatalMsg:
+            fprintf(stderr, "Fatal: %s\n", msg.toLocal8Bit().data());
+            abort();
+        default:
+            break;
+        }
+    }
+}
+
+void BenchmarkHelpers::installMessageHandler()
+{
+    qInstallMessageHandler(messageOutput);
+}
+
+QJsonObject BenchmarkHelpers::percentiles(QVector<qint64> samples)
+{
+    QJsonObject object;
+    if (samples.isEmpty()) {
+        return object;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    const auto percentile = [&samples](int p) {
+        const int index = qCeil(samples.count() * p / 100.0) - 1;
+        return samples.at(qBound(0, index, samples.count() - 1)) / 1000000.0;
+    };
+    object.insert(QStringLiteral("p50Msecs"), percentile(50));
+    object.insert(QStringLiteral("p90Msecs"), percentile(90));
+    object.insert(QStringLiteral("p99Msecs"), percentile(99));
+    object.insert(QStringLiteral("maxMsecs"), samples.last() / 1000000.0);
+    return object;
+}
+
+qint64 BenchmarkHelpers::residentMemory()
+{
+#ifdef Q_OS_LINUX
+    // The second field is the number of resident pages
+    QFile file(QStringLiteral("/proc/self/statm"));
+    if (file.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> fields = file.readAll().split(' ');
+        if (fields.count() >= 2) {
+            bool ok = false;
+            const qint64 pages = fields.at(1).toLongLong(&ok);
+            if (ok) {
+                return pages * sysconf(_SC_PAGESIZE);
+            }
+        }
+    }
+#endif
+    return -1;
+}
+
+int BenchmarkHelpers::writeResults(const QJsonObject& results, const QString& fileName)
+{
+    const QByteArray json = QJsonDocument(results).toJson();
+    if (fileName.isEmpty()) {
+        fwrite(json.constData(), 1, json.size(), stdout);
+        return 0;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        fprintf(stderr, "Cannot write %s\n", qPrintable(fileName));
+        return 1;
+    }
+    file.write(json);
+    return 0;
+}
+
+KFileItem BenchmarkHelpers::createItem(const QUrl& directoryUrl, const QString& name, const QString& mimeType,
+                                       qint64 size, qint64 modificationTime, std::mt19937* random)
+{
+    static const QStringList users = {QStringLiteral("alice"), QStringLiteral("bob"), QStringLiteral("root")};
+    static const mode_t permissions[] = {0644, 0600, 0664, 0755};
+
+    const bool isDir = (mimeType == QLatin1String("inode/directory"));
+
+    KIO::UDSEntry entry;
+    entry.reserve(10);
+    entry.fastInsert(KIO::UDSEntry::UDS_NAME, name);
+    entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, isDir ? S_IFDIR : S_IFREG);
+    entry.fastInsert(KIO::UDSEntry::UDS_SIZE, isDir ? 0 : size);
+    entry.fastInsert(KIO::UDSEntry::UDS_MODIFICATION_TIME, modificationTime);
+    entry.fastInsert(KIO::UDSEntry::UDS_MIME_TYPE, mimeType);
+
+    if (random) {
+        const auto randomInt = [random](int max) {
+            return std::uniform_int_distribution<int>(0, max - 1)(*random);
+        };
+        const qint64 now = QDateTime::currentSecsSinceEpoch();
+        entry.fastInsert(KIO::UDSEntry::UDS_ACCESS, isDir ? 0755 : permissions[randomInt(4)]);
+        entry.fastInsert(KIO::UDSEntry::UDS_CREATION_TIME, modificationTime - randomInt(3600 * 24 * 30));
+        entry.fastInsert(KIO::UDSEntry::UDS_ACCESS_TIME, now - randomInt(3600 * 24 * 7));
+        entry.fastInsert(KIO::UDSEntry::UDS_USER, users.at(randomInt(users.count())));
+        entry.fastInsert(KIO::UDSEntry::UDS_GROUP, users.at(randomInt(users.count())));
+    } else {
+        entry.fastInsert(KIO::UDSEntry::UDS_ACCESS, isDir ? 0755 : 0644);
+    }
+
+    return KFileItem(entry, directoryUrl, false, true);
+}
+
+KFileItemList BenchmarkHelpers::createItems(int count, const QUrl& directoryUrl, int seed, int directoryPercentage)
+{
+    static const QStringList words = {
+        QStringLiteral("report"), QStringLiteral("Invoice"), QStringLiteral("holiday"), QStringLiteral("Übersicht"),
+        QStringLiteral("résumé"), QStringLiteral("backup"), QStringLiteral("Notes"), QStringLiteral("final"),
+        QStringLiteral("draft"), QStringLiteral("東京"), QStringLiteral("project"), QStringLiteral("Meeting"),
+        QStringLiteral("screenshot"), QStringLiteral("README"), QStringLiteral("data"), QStringLiteral("v2"),
+    };
+    static const QList<QPair<QString, QString> > extensions = {
+        {QStringLiteral("jpg"), QStringLiteral("image/jpeg")},
+        {QStringLiteral("png"), QStringLiteral("image/png")},
+        {QStringLiteral("pdf"), QStringLiteral("application/pdf")},
+        {QStringLiteral("odt"), QStringLiteral("application/vnd.oasis.opendocument.text")},
+        {QStringLiteral("txt"), QStringLiteral("text/plain")},
+        {QStringLiteral("cpp"), QStringLiteral("text/x-c++src")},
+        {QStringLiteral("h"), QStringLiteral("text/x-c++hdr")},
+        {QStringLiteral("mp3"), QStringLiteral("audio/mpeg")},
+        {QStringLiteral("tar.gz"), QStringLiteral("application/x-compressed-tar")},
+    };
+
+    std::mt19937 random(seed);
+    const auto randomInt = [&random](int max) {
+        return std::uniform_int_distribution<int>(0, max - 1)(random);
+    };
+
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    const qint64 threeYears = 3 * 365 * 24 * 3600;
+
+    QSet<QString> names;
+    names.reserve(count);
+
+    KFileItemList items;
+    items.reserve(count);
+    while (items.count() < count) {
+        const bool isDir = randomInt(100) < directoryPercentage;
+        const auto& extension = extensions.at(randomInt(extensions.count()));
+
+        QString name;
+        switch (randomInt(5)) {
+        case 0:
+            // Photos of a camera
+            name = QStringLiteral("IMG_%1.jpg").arg(randomInt(100000), 5, 10, QLatin1Char('0'));
+            break;
+        case 1:
+            // Numbered files, which benefit from natural sorting
+            name = QStringLiteral("%1 %2.%3").arg(words.at(randomInt(words.count()))).arg(randomInt(1000)).arg(extension.first);
+            break;
+        case 2:
+            // Several words
+            name = QStringLiteral("%1_%2-%3.%4").arg(words.at(randomInt(words.count())), words.at(randomInt(words.count())))
+                                                 .arg(randomInt(100)).arg(extension.first);
+            break;
+        case 3:
+            // Copies
+            name = QStringLiteral("%1 (%2).%3").arg(words.at(randomInt(words.count()))).arg(randomInt(50)).arg(extension.first);
+            break;
+        default:
+            // Hidden files
+            name = QStringLiteral(".%1%2").arg(words.at(randomInt(words.count())).toLower()).arg(randomInt(10000));
+            break;
+        }
+
+        if (isDir) {
+            const int extensionIndex = name.lastIndexOf(QLatin1Char('.'));
+            if (extensionIndex > 0) {
+                name.truncate(extensionIndex);
+            }
+        }
+        if (name.isEmpty() || names.contains(name)) {
+            continue;
+        }
+        names.insert(name);
+
+        // Most files are small and have been modified recently.
+        const qint64 size = isDir ? 0 : static_cast<qint64>(std::exp(std::uniform_real_distribution<double>(0, 22)(random)));
+        const qint64 age = static_cast<qint64>(threeYears * std::pow(std::uniform_real_distribution<double>(0, 1)(random), 3));
+        const QString mimeType = isDir ? QStringLiteral("inode/directory") : extension.second;
+
+        items << createItem(directoryUrl, name, mimeType, size, now - age, &random);
+    }
+
+    return items;
+}
+
+void BenchmarkHelpers::addItems(KFileItemModel& model, const KFileItemList& items)
+{
+    model.slotItemsAdded(model.directory(), items);
+    model.slotCompleted(QUrl());
+}
+
+void BenchmarkHelpers::loadItems(KFileItemModel& model, const KFileItemList& items)
+{
+    model.slotClear();
+    addItems(model, items);
+}
+
+void BenchmarkHelpers::removeItems(KFileItemModel& model, const KFileItemList& items)
+{
+    model.slotItemsDeleted(items);
+}
+
+void BenchmarkHelpers::finishResorting(KFileItemModel& model)
+{
+    if (model.isAsyncResortRunning()) {
+        model.m_asyncResortWatcher->waitForFinished();
+        model.slotAsyncResortFinished();
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef BENCHMARKHELPERS_H
+#define BENCHMARKHELPERS_H
+
+#include <KFileItem>
+
+#include <QJsonObject>
+#include <QVector>
+
+#include <random>
+
+class KFileItemModel;
+class QUrl;
+
+/**
+ * @brief Functions that are shared by the benchmarks, which print their
+ *        results as JSON.
+ *
+ * The benchmarks create synthetic items from UDS entries, so no files
+ * are created on the disk, and pass them to KFileItemModel like its
+ * directory lister would do.
+ */
+class BenchmarkHelpers
+{
+public:
+    /**
+     * Installs a message handler that only prints critical and fatal
+     * messages, so that the output of the benchmark stays readable.
+     */
+    static void installMessageHandler();
+
+    /**
+     * @return The 50th, 90th and 99th percentile and the maximum of the
+     *         \a samples in ns, as "p50Msecs", "p90Msecs", "p99Msecs" and
+     *         "maxMsecs" in ms. The object is empty if there are no samples.
+     */
+    static QJsonObject percentiles(QVector<qint64> samples);
+
+    /**
+     * @return Resident memory of the process in bytes, or -1 if it is unknown.
+     */
+    static qint64 residentMemory();
+
+    /**
+     * Writes \a results as JSON to the file \a fileName, or to stdout if
+     * \a fileName is empty.
+     * @return Exit code of the benchmark.
+     */
+    static int writeResults(const QJsonObject& results, const QString& fileName);
+
+    /**
+     * @return Item \a name of the directory \a directoryUrl. Its type is taken
+     *         from \a mimeType. If \a random is passed, the permissions, owners
+     *         and the other times are distributed like in real folders.
+     */
+    static KFileItem createItem(const QUrl& directoryUrl, const QString& name, const QString& mimeType,
+                                qint64 size, qint64 modificationTime, std::mt19937* random = nullptr);
+
+    /**
+     * @return Items with names, sizes, times and types that are distributed
+     *         like in real folders, of which \a directoryPercentage percent are
+     *         folders. The result only depends on \a count and \a seed.
+     */
+    static KFileItemList createItems(int count, const QUrl& directoryUrl, int seed, int directoryPercentage = 5);
+
+    /**
+     * Adds \a items to \a model and completes the listing, like
+     * the directory lister does.
+     */
+    static void addItems(KFileItemModel& model, const KFileItemList& items);
+
+    /**
+     * Clears \a model before adding \a items.
+     */
+    static void loadItems(KFileItemModel& model, const KFileItemList& items);
+
+    static void removeItems(KFileItemModel& model, const KFileItemList& items);
+
+    /**
+     * Waits until the resorting of large models in a worker thread is done
+     * and applies the result.
+     */
+    static void finishResorting(KFileItemModel& model);
+};
+
+#endif
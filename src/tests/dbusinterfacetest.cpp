@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "dbusinterface.h"
+#include "dolphinmainwindow.h"
+#include "dolphinmainwindowinterface.h"
+#include "global.h"
+#include "testdir.h"
+
+#include <QApplication>
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QStandardPaths>
+#include <QTest>
+
+class DBusInterfaceTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testSpareWindowHiddenUntilShown();
+
+private:
+    /**
+     * @return Number of main windows that are found by
+     *         Dolphin::dolphinGuiInstances() and answer requests.
+     */
+    int reachableInstancesCount() const;
+
+    /**
+     * @return Number of main windows of the process.
+     */
+    int mainWindowsCount() const;
+
+private:
+    QString m_serviceName;
+};
+
+void DBusInterfaceTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+
+    // Like KDBusService, so that Dolphin::dolphinGuiInstances() can
+    // find the windows of this process as preferred service
+    m_serviceName = QStringLiteral("org.kde.dolphin-%1").arg(QCoreApplication::applicationPid());
+    QVERIFY(QDBusConnection::sessionBus().registerService(m_serviceName));
+}
+
+void DBusInterfaceTest::cleanupTestCase()
+{
+    QDBusConnection::sessionBus().unregisterService(m_serviceName);
+}
+
+void DBusInterfaceTest::testSpareWindowHiddenUntilShown()
+{
+    TestDir testDir;
+    testDir.createDir("a");
+
+    DBusInterface interface;
+    interface.setAsDaemon();
+    QTRY_COMPARE(mainWindowsCount(), 1);
+
+    // The hidden window must not receive requests of other instances,
+    // which would open folders in a window that the user cannot see
+    QCOMPARE(reachableInstancesCount(), 0);
+
+    interface.ShowFolders({testDir.url().toString() + QStringLiteral("/a")}, QString());
+    QTRY_COMPARE(reachableInstancesCount(), 1);
+    QCOMPARE(mainWindowsCount(), 1);
+
+    qDeleteAll(QApplication::topLevelWidgets());
+}
+
+int DBusInterfaceTest::reachableInstancesCount() const
+{
+    int count = 0;
+    const auto instances = Dolphin::dolphinGuiInstances(m_serviceName);
+    for (const auto& instance : instances) {
+        auto reply = instance.first->isUrlOpen(QString());
+        reply.waitForFinished();
+        if (!reply.isError()) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+int DBusInterfaceTest::mainWindowsCount() const
+{
+    int count = 0;
+    const QWidgetList widgets = QApplication::topLevelWidgets();
+    for (const QWidget* widget : widgets) {
+        if (qobject_cast<const DolphinMainWindow*>(widget)) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+QTEST_MAIN(DBusInterfaceTest)
+
+#include "dbusinterfacetest.moc"
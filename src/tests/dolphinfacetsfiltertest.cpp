@@ -0,0 +1,168 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "search/dolphinfacetsfilter.h"
+#include "search/dolphinquery.h"
+
+#include <Baloo/Query>
+#include <KFileItem>
+#include <KIO/UDSEntry>
+
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QTest>
+
+#include <sys/stat.h>
+
+class DolphinFacetsFilterTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void testIsNarrowedBy_data();
+    void testIsNarrowedBy();
+    void testMatches();
+    void testCount();
+
+private:
+    static DolphinFacetsFilter filter(const QString& searchString, const QString& type = QString());
+    static KFileItem createItem(const QString& name, const QString& mimeType, const QDate& modificationDate);
+};
+
+DolphinFacetsFilter DolphinFacetsFilterTest::filter(const QString& searchString, const QString& type)
+{
+    Baloo::Query query;
+    query.setSearchString(searchString);
+    if (!type.isEmpty()) {
+        query.addType(type);
+    }
+    return DolphinFacetsFilter::fromQuery(DolphinQuery::fromSearchUrl(query.toSearchUrl()));
+}
+
+KFileItem DolphinFacetsFilterTest::createItem(const QString& name, const QString& mimeType, const QDate& modificationDate)
+{
+    const bool isDir = (mimeType == QLatin1String("inode/directory"));
+
+    KIO::UDSEntry entry;
+    entry.fastInsert(KIO::UDSEntry::UDS_NAME, name);
+    entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, isDir ? S_IFDIR : S_IFREG);
+    entry.fastInsert(KIO::UDSEntry::UDS_MODIFICATION_TIME, QDateTime(modificationDate, QTime(12, 0)).toSecsSinceEpoch());
+    entry.fastInsert(KIO::UDSEntry::UDS_MIME_TYPE, mimeType);
+    return KFileItem(entry, QUrl::fromLocalFile(QStringLiteral("/results")), false, true);
+}
+
+void DolphinFacetsFilterTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void DolphinFacetsFilterTest::testIsNarrowedBy_data()
+{
+    QTest::addColumn<QString>("searchString");
+    QTest::addColumn<QString>("type");
+    QTest::addColumn<QString>("narrowedSearchString");
+    QTest::addColumn<QString>("narrowedType");
+    QTest::addColumn<bool>("isNarrowed");
+
+    QTest::newRow("same") << "abc" << "" << "abc" << "" << true;
+    QTest::newRow("type") << "abc" << "" << "abc" << "Image" << true;
+    QTest::newRow("type/widened") << "abc" << "Image" << "abc" << "" << false;
+    QTest::newRow("type/changed") << "abc" << "Image" << "abc" << "Audio" << false;
+    QTest::newRow("modified") << "abc" << "" << "abc modified>=2021-03-01" << "" << true;
+    QTest::newRow("modified/later") << "abc modified>=2021-03-01" << "" << "abc modified>=2021-04-01" << "" << true;
+    QTest::newRow("modified/earlier") << "abc modified>=2021-03-01" << "" << "abc modified>=2021-02-01" << "" << false;
+    QTest::newRow("rating") << "abc rating>=2" << "" << "abc rating>=4" << "" << true;
+    QTest::newRow("rating/lower") << "abc rating>=4" << "" << "abc rating>=2" << "" << false;
+    QTest::newRow("tag") << "abc" << "" << "abc tag:tagA" << "" << true;
+    QTest::newRow("tag/removed") << "abc tag:tagA" << "" << "abc" << "" << false;
+}
+
+void DolphinFacetsFilterTest::testIsNarrowedBy()
+{
+    QFETCH(QString, searchString);
+    QFETCH(QString, type);
+    QFETCH(QString, narrowedSearchString);
+    QFETCH(QString, narrowedType);
+    QFETCH(bool, isNarrowed);
+
+    QCOMPARE(filter(searchString, type).isNarrowedBy(filter(narrowedSearchString, narrowedType)), isNarrowed);
+}
+
+void DolphinFacetsFilterTest::testMatches()
+{
+    const KFileItem image = createItem(QStringLiteral("a.png"), QStringLiteral("image/png"), QDate(2021, 3, 15));
+    const KFileItem document = createItem(QStringLiteral("b.pdf"), QStringLiteral("application/pdf"), QDate(2021, 1, 15));
+    const KFileItem folder = createItem(QStringLiteral("c"), QStringLiteral("inode/directory"), QDate(2021, 3, 15));
+
+    const DolphinFacetsFilter images = filter(QStringLiteral("abc"), QStringLiteral("Image"));
+    QVERIFY(images.matches(image, {}));
+    QVERIFY(!images.matches(document, {}));
+    QVERIFY(!images.matches(folder, {}));
+    QVERIFY(filter(QStringLiteral("abc"), QStringLiteral("Folder")).matches(folder, {}));
+
+    const DolphinFacetsFilter modified = filter(QStringLiteral("abc modified>=2021-03-01"));
+    QVERIFY(modified.matches(image, {}));
+    QVERIFY(!modified.matches(document, {}));
+
+    // Items whose rating or tags are unknown are kept
+    const DolphinFacetsFilter rated = filter(QStringLiteral("abc rating>=4"));
+    QVERIFY(rated.matches(image, {}));
+    QVERIFY(rated.matches(image, {{"rating", 6}}));
+    QVERIFY(!rated.matches(image, {{"rating", 2}}));
+
+    const DolphinFacetsFilter tagged = filter(QStringLiteral("abc tag:tagA"));
+    QVERIFY(tagged.matches(image, {}));
+    QVERIFY(tagged.matches(image, {{"tags", QStringLiteral("tagA, tagB")}}));
+    QVERIFY(!tagged.matches(image, {{"tags", QStringLiteral("tagB")}}));
+}
+
+void DolphinFacetsFilterTest::testCount()
+{
+    const QList<KFileItem> items = {
+        createItem(QStringLiteral("a.png"), QStringLiteral("image/png"), QDate(2021, 3, 15)),
+        createItem(QStringLiteral("b.png"), QStringLiteral("image/png"), QDate(2021, 1, 15)),
+        createItem(QStringLiteral("c.pdf"), QStringLiteral("application/pdf"), QDate(2021, 3, 15)),
+        createItem(QStringLiteral("d"), QStringLiteral("inode/directory"), QDate(2021, 3, 15)),
+    };
+
+    const auto count = [&items](const DolphinFacetsFilter& filter) {
+        DolphinFacetsFilter::Counts counts;
+        for (const KFileItem& item : items) {
+            filter.count(item, {}, counts);
+        }
+        return counts;
+    };
+
+    DolphinFacetsFilter::Counts counts = count(filter(QStringLiteral("abc")));
+    QCOMPARE(counts.anyType, 4);
+    QCOMPARE(counts.anyModificationDate, 4);
+    QCOMPARE(counts.types.value(QStringLiteral("Image")), 2);
+    QCOMPARE(counts.types.value(QStringLiteral("Document")), 1);
+    QCOMPARE(counts.types.value(QStringLiteral("Folder")), 1);
+    QCOMPARE(counts.modificationDates.value(QDate(2021, 3, 15)), 3);
+
+    // The types are counted for the results of the selected date and
+    // the dates for the results of the selected type
+    counts = count(filter(QStringLiteral("abc modified>=2021-03-01"), QStringLiteral("Image")));
+    QCOMPARE(counts.anyType, 3);
+    QCOMPARE(counts.types.value(QStringLiteral("Image")), 1);
+    QCOMPARE(counts.types.value(QStringLiteral("Document")), 1);
+    QCOMPARE(counts.types.value(QStringLiteral("Folder")), 1);
+    QCOMPARE(counts.anyModificationDate, 2);
+    QCOMPARE(counts.modificationDates.value(QDate(2021, 3, 15)), 1);
+    QCOMPARE(counts.modificationDates.value(QDate(2021, 1, 15)), 1);
+
+    // Results that do not match with the rating are not counted at all
+    DolphinFacetsFilter::Counts ratedCounts;
+    filter(QStringLiteral("abc rating>=4")).count(items.first(), {{"rating", 2}}, ratedCounts);
+    QCOMPARE(ratedCounts.anyType, 0);
+    QCOMPARE(ratedCounts.anyModificationDate, 0);
+}
+
+QTEST_GUILESS_MAIN(DolphinFacetsFilterTest)
+
+#include "dolphinfacetsfiltertest.moc"
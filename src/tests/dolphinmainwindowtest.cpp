@@ -11,6 +11,8 @@
 #include "dolphinviewcontainer.h"
 
 #include <KActionCollection>
+#include <KConfig>
+#include <KConfigGroup>
 
 #include <QSignalSpy>
 #include <QStandardPaths>
@@ -29,6 +31,7 @@ private Q_SLOTS:
     void testUpdateWindowTitleAfterClosingSplitView();
     void testUpdateWindowTitleAfterChangingSplitView();
     void testOpenInNewTabTitle();
+    void testRestoringTabsDefersLoading();
     void testNewFileMenuEnabled_data();
     void testNewFileMenuEnabled();
     void testWindowTitle_data();
@@ -215,6 +218,48 @@ void DolphinMainWindowTest::testOpenInNewTabTitle()
     }
 }
 
+void DolphinMainWindowTest::testRestoringTabsDefersLoading()
+{
+    m_mainWindow->openDirectories({ QUrl::fromLocalFile(QDir::homePath()) }, false);
+    m_mainWindow->show();
+    QVERIFY(QTest::qWaitForWindowExposed(m_mainWindow.data()));
+
+    auto tabWidget = m_mainWindow->findChild<DolphinTabWidget*>("tabWidget");
+    QVERIFY(tabWidget);
+    tabWidget->openNewTab(QUrl::fromLocalFile(QDir::tempPath()));
+    tabWidget->openNewTab(QUrl::fromLocalFile(QDir::rootPath()));
+    QCOMPARE(tabWidget->count(), 3);
+    const QUrl lastTabUrl = tabWidget->tabPageAt(2)->activeViewContainer()->url();
+
+    KConfig config(QString(), KConfig::SimpleConfig);
+    KConfigGroup group(&config, "Tabs");
+    tabWidget->saveProperties(group);
+
+    m_mainWindow.reset(new DolphinMainWindow());
+    m_mainWindow->openDirectories({ QUrl::fromLocalFile(QDir::homePath()) }, false);
+    m_mainWindow->show();
+    QVERIFY(QTest::qWaitForWindowExposed(m_mainWindow.data()));
+
+    tabWidget = m_mainWindow->findChild<DolphinTabWidget*>("tabWidget");
+    QVERIFY(tabWidget);
+    tabWidget->readProperties(group);
+    QCOMPARE(tabWidget->count(), 3);
+    QCOMPARE(tabWidget->currentIndex(), 0);
+    QVERIFY(!tabWidget->tabPageAt(0)->isLoadingDeferred());
+
+    // The tab next to the active tab is loaded in the background
+    QTRY_VERIFY(!tabWidget->tabPageAt(1)->isLoadingDeferred());
+
+    DolphinTabPage* lastTabPage = tabWidget->tabPageAt(2);
+    QVERIFY(lastTabPage->isLoadingDeferred());
+    QCOMPARE(lastTabPage->activeViewContainer()->url(), lastTabUrl);
+    QVERIFY(lastTabPage->activeViewContainer()->view()->isLoadingDeferred());
+
+    tabWidget->setCurrentIndex(2);
+    QVERIFY(!lastTabPage->isLoadingDeferred());
+    QVERIFY(!lastTabPage->activeViewContainer()->view()->isLoadingDeferred());
+}
+
 void DolphinMainWindowTest::testNewFileMenuEnabled_data()
 {
     QTest::addColumn<QUrl>("activeViewUrl");
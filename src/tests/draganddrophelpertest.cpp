@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: GPL-2.0-or-later
  */
 
+#include <QMimeData>
 #include <QStandardPaths>
 #include <QTest>
 #include <views/draganddrophelper.h>
@@ -16,6 +17,7 @@ private Q_SLOTS:
     void initTestCase();
     void testUrlListMatchesUrl_data();
     void testUrlListMatchesUrl();
+    void testMimeDataMatchesUrl();
 };
 
 void DragAndDropHelperTest::initTestCase()
@@ -69,6 +71,26 @@ void DragAndDropHelperTest::testUrlListMatchesUrl()
     QCOMPARE(DragAndDropHelper::urlListMatchesUrl(urlList, url), expected);
 }
 
+void DragAndDropHelperTest::testMimeDataMatchesUrl()
+{
+    QMimeData mimeData;
+    mimeData.setUrls({QUrl::fromLocalFile("/usr/share/"), QUrl("ftp://server:2211/dir")});
+
+    DragAndDropHelper::clearUrlListMatchesUrlCache();
+    QVERIFY(DragAndDropHelper::mimeDataMatchesUrl(&mimeData, QUrl::fromLocalFile("/usr/share")));
+    QVERIFY(DragAndDropHelper::mimeDataMatchesUrl(&mimeData, QUrl("ftp://server:2211/dir/")));
+    QVERIFY(!DragAndDropHelper::mimeDataMatchesUrl(&mimeData, QUrl::fromLocalFile("/usr")));
+    QVERIFY(!DragAndDropHelper::mimeDataMatchesUrl(&mimeData, QUrl()));
+
+    // The URLs of the next drag are used after the cache has been cleared
+    QMimeData otherMimeData;
+    otherMimeData.setUrls({QUrl::fromLocalFile("/usr")});
+
+    DragAndDropHelper::clearUrlListMatchesUrlCache();
+    QVERIFY(DragAndDropHelper::mimeDataMatchesUrl(&otherMimeData, QUrl::fromLocalFile("/usr")));
+    QVERIFY(!DragAndDropHelper::mimeDataMatchesUrl(&otherMimeData, QUrl::fromLocalFile("/usr/share")));
+}
+
 
 QTEST_MAIN(DragAndDropHelperTest)
 
@@ -0,0 +1,182 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "views/fileoperationqueue.h"
+#include "testjob.h"
+
+#include <QDir>
+#include <QStandardPaths>
+#include <QTest>
+
+class FileOperationQueueTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testSameDevice();
+    void testDifferentDevices();
+    void testLocalDevice();
+    void testPause();
+    void testMoveUp();
+    void testCancel();
+    void testUnlimited();
+
+private:
+    int enqueue(const QUrl& destination);
+
+private:
+    QVector<TestJob*> m_jobs;
+};
+
+void FileOperationQueueTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void FileOperationQueueTest::init()
+{
+    FileOperationQueue::instance().setMaximumConcurrentOperations(1);
+}
+
+void FileOperationQueueTest::cleanup()
+{
+    FileOperationQueue& queue = FileOperationQueue::instance();
+    const QVector<FileOperationQueue::Operation> operations = queue.operations();
+    for (const FileOperationQueue::Operation& operation : operations) {
+        queue.cancel(operation.id);
+    }
+    QVERIFY(queue.operations().isEmpty());
+    m_jobs.clear();
+}
+
+void FileOperationQueueTest::testSameDevice()
+{
+    const QUrl destination(QStringLiteral("sftp://host/a"));
+    enqueue(destination);
+    enqueue(QUrl(QStringLiteral("sftp://host/b")));
+    QCOMPARE(m_jobs.count(), 1);
+
+    const QVector<FileOperationQueue::Operation> operations = FileOperationQueue::instance().operations();
+    QCOMPARE(operations.count(), 2);
+    QCOMPARE(operations.at(0).state, FileOperationQueue::State::Running);
+    QCOMPARE(operations.at(1).state, FileOperationQueue::State::Queued);
+
+    // The second operation is started when the first one has been finished
+    m_jobs.first()->finish();
+    QCOMPARE(m_jobs.count(), 2);
+    QCOMPARE(FileOperationQueue::instance().operations().count(), 1);
+    QCOMPARE(FileOperationQueue::instance().operations().first().state, FileOperationQueue::State::Running);
+
+    m_jobs.last()->finish();
+    QVERIFY(FileOperationQueue::instance().operations().isEmpty());
+}
+
+void FileOperationQueueTest::testDifferentDevices()
+{
+    enqueue(QUrl(QStringLiteral("sftp://host/a")));
+    enqueue(QUrl(QStringLiteral("sftp://otherhost/a")));
+    QCOMPARE(m_jobs.count(), 2);
+}
+
+void FileOperationQueueTest::testLocalDevice()
+{
+    FileOperationQueue& queue = FileOperationQueue::instance();
+    enqueue(QUrl::fromLocalFile(QDir::tempPath() + QLatin1String("/a")));
+    enqueue(QUrl::fromLocalFile(QDir::tempPath() + QLatin1String("/b")));
+
+    // The device of local destinations is determined in a worker thread
+    QCOMPARE(m_jobs.count(), 0);
+    QTRY_VERIFY(!queue.operations().at(0).device.isEmpty() && !queue.operations().at(1).device.isEmpty());
+    QCOMPARE(m_jobs.count(), 1);
+
+    const QVector<FileOperationQueue::Operation> operations = queue.operations();
+    QCOMPARE(operations.count(), 2);
+    QCOMPARE(operations.at(0).device, operations.at(1).device);
+    QCOMPARE(operations.at(1).state, FileOperationQueue::State::Queued);
+}
+
+void FileOperationQueueTest::testPause()
+{
+    FileOperationQueue& queue = FileOperationQueue::instance();
+    const int first = enqueue(QUrl(QStringLiteral("sftp://host/a")));
+    enqueue(QUrl(QStringLiteral("sftp://host/b")));
+    QCOMPARE(m_jobs.count(), 1);
+
+    // A paused operation does not prevent other operations from starting
+    queue.pause(first);
+    QCOMPARE(m_jobs.count(), 2);
+    QCOMPARE(queue.operations().at(0).state, FileOperationQueue::State::Paused);
+    QVERIFY(m_jobs.first()->isSuspended());
+
+    // The resumed operation waits until the device is available again
+    queue.resume(first);
+    QCOMPARE(queue.operations().at(0).state, FileOperationQueue::State::Queued);
+    QVERIFY(m_jobs.first()->isSuspended());
+
+    m_jobs.last()->finish();
+    QCOMPARE(m_jobs.count(), 2);
+    QCOMPARE(queue.operations().count(), 1);
+    QCOMPARE(queue.operations().at(0).state, FileOperationQueue::State::Running);
+    QVERIFY(!m_jobs.first()->isSuspended());
+}
+
+void FileOperationQueueTest::testMoveUp()
+{
+    FileOperationQueue& queue = FileOperationQueue::instance();
+    enqueue(QUrl(QStringLiteral("sftp://host/a")));
+    const int second = enqueue(QUrl(QStringLiteral("sftp://host/b")));
+    const int third = enqueue(QUrl(QStringLiteral("sftp://host/c")));
+
+    queue.moveUp(third);
+    QCOMPARE(queue.operations().at(1).id, third);
+
+    m_jobs.first()->finish();
+    QCOMPARE(m_jobs.count(), 2);
+    QCOMPARE(queue.operations().at(0).id, third);
+    QCOMPARE(queue.operations().at(0).state, FileOperationQueue::State::Running);
+    QCOMPARE(queue.operations().at(1).id, second);
+    QCOMPARE(queue.operations().at(1).state, FileOperationQueue::State::Queued);
+}
+
+void FileOperationQueueTest::testCancel()
+{
+    FileOperationQueue& queue = FileOperationQueue::instance();
+    const int first = enqueue(QUrl(QStringLiteral("sftp://host/a")));
+    const int second = enqueue(QUrl(QStringLiteral("sftp://host/b")));
+
+    queue.cancel(first);
+    QCOMPARE(m_jobs.count(), 2);
+    QCOMPARE(queue.operations().count(), 1);
+    QCOMPARE(queue.operations().first().id, second);
+}
+
+void FileOperationQueueTest::testUnlimited()
+{
+    FileOperationQueue& queue = FileOperationQueue::instance();
+    enqueue(QUrl(QStringLiteral("sftp://host/a")));
+    enqueue(QUrl(QStringLiteral("sftp://host/b")));
+    QCOMPARE(m_jobs.count(), 1);
+
+    queue.setMaximumConcurrentOperations(0);
+    QCOMPARE(m_jobs.count(), 2);
+}
+
+int FileOperationQueueTest::enqueue(const QUrl& destination)
+{
+    return FileOperationQueue::instance().enqueue(QString(), destination, [this]() -> KJob* {
+        TestJob* job = new TestJob();
+        m_jobs.append(job);
+        return job;
+    });
+}
+
+QTEST_GUILESS_MAIN(FileOperationQueueTest)
+
+#include "fileoperationqueuetest.moc"
@@ -0,0 +1,91 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "views/jobscope.h"
+#include "testjob.h"
+
+#include <QSignalSpy>
+#include <QTest>
+
+class JobScopeTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testKillJobs();
+    void testFinishedJobs();
+    void testContext();
+    void testDestruction();
+};
+
+void JobScopeTest::testKillJobs()
+{
+    JobScope scope;
+    QPointer<TestJob> job = scope.add(new TestJob());
+    QSignalSpy resultSpy(job.data(), &KJob::result);
+    QCOMPARE(scope.pendingCount(), 1);
+
+    scope.cancel();
+    QCOMPARE(scope.pendingCount(), 0);
+    QCOMPARE(job->error(), int(KJob::KilledJobError));
+
+    // The job has been killed quietly
+    QCOMPARE(resultSpy.count(), 0);
+    QTRY_VERIFY(job.isNull());
+}
+
+void JobScopeTest::testFinishedJobs()
+{
+    JobScope scope;
+    TestJob* job = scope.add(new TestJob());
+    job->finish();
+    QCOMPARE(scope.pendingCount(), 0);
+
+    // Killing a finished job has no effect
+    scope.cancel();
+    QCOMPARE(job->error(), 0);
+}
+
+void JobScopeTest::testContext()
+{
+    JobScope scope;
+    QObject* context = scope.context();
+
+    int calls = 0;
+    QObject sender;
+    connect(&sender, &QObject::objectNameChanged, scope.context(), [&calls]() {
+        ++calls;
+    });
+    sender.setObjectName(QStringLiteral("a"));
+    QCOMPARE(calls, 1);
+
+    scope.cancel();
+    QVERIFY(scope.context() != context);
+    sender.setObjectName(QStringLiteral("b"));
+    QCOMPARE(calls, 1);
+
+    // The scope can be used again
+    connect(&sender, &QObject::objectNameChanged, scope.context(), [&calls]() {
+        ++calls;
+    });
+    sender.setObjectName(QStringLiteral("c"));
+    QCOMPARE(calls, 2);
+}
+
+void JobScopeTest::testDestruction()
+{
+    QPointer<TestJob> job = new TestJob();
+    {
+        JobScope scope;
+        scope.add(job.data());
+    }
+    QCOMPARE(job->error(), int(KJob::KilledJobError));
+    QTRY_VERIFY(job.isNull());
+}
+
+QTEST_GUILESS_MAIN(JobScopeTest)
+
+#include "jobscopetest.moc"
@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kdirlisterrecorder.h"
+#include "testhelpers.h"
+
+#include <kio_version.h>
+#include <KCoreDirLister>
+
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+namespace {
+    const QUrl directoryUrl = TestHelpers::directoryUrl();
+}
+
+class KDirListerRecorderTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void testRecordAndRead();
+    void testInvalidRecording();
+};
+
+void KDirListerRecorderTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void KDirListerRecorderTest::testRecordAndRead()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filePath = dir.filePath(QStringLiteral("recording.jsonl"));
+
+    KCoreDirLister dirLister;
+    KDirListerRecorder* recorder = new KDirListerRecorder(&dirLister, filePath);
+    QVERIFY(recorder->isRecording());
+
+    const KFileItem a = TestHelpers::fileItem(QStringLiteral("a.txt"), 10);
+    // The size cannot be represented exactly by a double
+    const KIO::filesize_t largeSize = (KIO::filesize_t(1) << 53) + 1;
+    const KFileItem b = TestHelpers::fileItem(QStringLiteral("b.txt"), largeSize);
+    const KFileItem changedA = TestHelpers::fileItem(QStringLiteral("a.txt"), 30);
+
+    Q_EMIT dirLister.itemsAdded(directoryUrl, {a, b});
+    Q_EMIT dirLister.refreshItems({qMakePair(a, changedA)});
+    Q_EMIT dirLister.itemsDeleted({b});
+#if KIO_VERSION < QT_VERSION_CHECK(5, 79, 0)
+    Q_EMIT dirLister.completed(directoryUrl);
+#else
+    Q_EMIT dirLister.listingDirCompleted(directoryUrl);
+#endif
+    Q_EMIT dirLister.clear();
+
+    QVector<KDirListerRecorder::Event> events;
+    QVERIFY(KDirListerRecorder::readEvents(filePath, events));
+    QCOMPARE(events.count(), 5);
+
+    QCOMPARE(events.at(0).type, KDirListerRecorder::Event::ItemsAdded);
+    QCOMPARE(events.at(0).url, directoryUrl);
+    QCOMPARE(events.at(0).items.count(), 2);
+    QCOMPARE(events.at(0).items.at(0).url(), a.url());
+    QCOMPARE(events.at(0).items.at(0).name(), QStringLiteral("a.txt"));
+    QCOMPARE(events.at(0).items.at(1).size(), largeSize);
+    QVERIFY(!events.at(0).items.at(1).isDir());
+
+    QCOMPARE(events.at(1).type, KDirListerRecorder::Event::RefreshItems);
+    QCOMPARE(events.at(1).refreshedItems.count(), 1);
+    QCOMPARE(events.at(1).refreshedItems.at(0).first.size(), KIO::filesize_t(10));
+    QCOMPARE(events.at(1).refreshedItems.at(0).second.size(), KIO::filesize_t(30));
+
+    QCOMPARE(events.at(2).type, KDirListerRecorder::Event::ItemsDeleted);
+    QCOMPARE(events.at(2).items.count(), 1);
+    QCOMPARE(events.at(2).items.at(0).url(), b.url());
+
+    QCOMPARE(events.at(3).type, KDirListerRecorder::Event::Completed);
+    QCOMPARE(events.at(3).url, directoryUrl);
+
+    QCOMPARE(events.at(4).type, KDirListerRecorder::Event::Clear);
+
+    // The events are stored in the order of their times
+    for (int i = 1; i < events.count(); ++i) {
+        QVERIFY(events.at(i).time >= events.at(i - 1).time);
+    }
+}
+
+void KDirListerRecorderTest::testInvalidRecording()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QVector<KDirListerRecorder::Event> events;
+    QVERIFY(!KDirListerRecorder::readEvents(dir.filePath(QStringLiteral("missing.jsonl")), events));
+
+    QFile file(dir.filePath(QStringLiteral("invalid.jsonl")));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("{\"time\": 0, \"type\": \"unknown\"}\n");
+    file.close();
+    QVERIFY(!KDirListerRecorder::readEvents(file.fileName(), events));
+}
+
+QTEST_GUILESS_MAIN(KDirListerRecorderTest)
+
+#include "kdirlisterrecordertest.moc"
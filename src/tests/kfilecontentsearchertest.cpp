@@ -0,0 +1,210 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kfilecontentsearcher.h"
+#include "kitemviews/private/kfileitemmodeldirlister.h"
+#include "testdir.h"
+#include "testhelpers.h"
+
+#include <KFileItem>
+
+#include <QSignalSpy>
+#include <QTest>
+
+class KFileContentSearcherTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testIsSupported();
+    void testSearch_data();
+    void testSearch();
+    void testLargeFile();
+    void testIgnoreFiles();
+    void testIgnorePatterns();
+    void testCancel();
+    void testDirLister();
+
+private:
+    /**
+     * @return Paths relative to the test directory of the files that
+     *         contain \a text.
+     */
+    QStringList search(const QString& text);
+
+    TestDir* m_testDir;
+};
+
+void KFileContentSearcherTest::init()
+{
+    m_testDir = new TestDir();
+    m_testDir->createFile("a.txt", "The quick brown fox");
+    m_testDir->createFile("b.txt", "THE LAZY DOG");
+    m_testDir->createFile("src/main.cpp", "int main() { return quickSort(); }");
+    m_testDir->createFile("src/fox.h", "nothing");
+    m_testDir->createFile("binary.dat", QByteArray("fox\0fox", 7));
+    m_testDir->createFile("unicode.txt", QStringLiteral("Grüße aus Köln").toUtf8());
+    m_testDir->createFile("empty.txt", QByteArray());
+}
+
+void KFileContentSearcherTest::cleanup()
+{
+    delete m_testDir;
+    m_testDir = nullptr;
+}
+
+void KFileContentSearcherTest::testIsSupported()
+{
+    const QUrl folderUrl = m_testDir->url();
+    QVERIFY(KFileContentSearcher::isSupported(TestHelpers::searchUrl("fox", folderUrl, true)));
+    QVERIFY(!KFileContentSearcher::isSupported(TestHelpers::searchUrl("fox", folderUrl)));
+    QVERIFY(!KFileContentSearcher::isSupported(TestHelpers::searchUrl("f.*x", folderUrl, true)));
+    QVERIFY(!KFileContentSearcher::isSupported(TestHelpers::searchUrl("*.txt", folderUrl, true)));
+    QVERIFY(!KFileContentSearcher::isSupported(TestHelpers::searchUrl(QString(), folderUrl, true)));
+    QVERIFY(!KFileContentSearcher::isSupported(TestHelpers::searchUrl("fox", QUrl(QStringLiteral("smb://server/share")), true)));
+}
+
+void KFileContentSearcherTest::testSearch_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QStringList>("expectedPaths");
+
+    // Binary files are not scanned, but their names are matched
+    QTest::newRow("content and name") << "fox" << QStringList{"a.txt", "src/fox.h"};
+    QTest::newRow("case-insensitive") << "lazy dog" << QStringList{"b.txt"};
+    QTest::newRow("mixed case") << "QUICK" << QStringList{"a.txt", "src/main.cpp"};
+    QTest::newRow("folder name") << "src" << QStringList{"src"};
+    QTest::newRow("non-ASCII") << QStringLiteral("köln") << QStringList{"unicode.txt"};
+    QTest::newRow("no match") << "missing" << QStringList();
+}
+
+void KFileContentSearcherTest::testSearch()
+{
+    QFETCH(QString, text);
+    QFETCH(QStringList, expectedPaths);
+
+    QCOMPARE(search(text), expectedPaths);
+}
+
+void KFileContentSearcherTest::testLargeFile()
+{
+    // The text is placed at the positions that are special for the
+    // vectorized search, and across the chunks of 256 KiB that are read
+    QByteArray data(600 * 1024, 'x');
+    data.replace(15, 6, "Needle");
+    m_testDir->createFile("start.txt", data);
+
+    data.fill('x');
+    data.replace(data.size() - 6, 6, "nEEDLE");
+    m_testDir->createFile("end.txt", data);
+
+    data.fill('x');
+    data.replace(256 * 1024 - 3, 6, "NeeDle");
+    m_testDir->createFile("chunks.txt", data);
+
+    data.fill('x');
+    data.replace(1000, 5, "needl");
+    m_testDir->createFile("partial.txt", data);
+
+    QCOMPARE(search("needle"), QStringList({"chunks.txt", "end.txt", "start.txt"}));
+}
+
+void KFileContentSearcherTest::testIgnoreFiles()
+{
+    m_testDir->createFile(".gitignore", "# Build results\nbuild/\n*.log\n!keep.log\n/generated.txt\n");
+    m_testDir->createFile("build/fox.txt", "fox");
+    m_testDir->createFile("debug.log", "fox");
+    m_testDir->createFile("keep.log", "fox");
+    m_testDir->createFile("generated.txt", "fox");
+    m_testDir->createFile("src/generated.txt", "fox");
+    m_testDir->createFile("src/.gitignore", "*.h\n");
+    m_testDir->createFile(".git/objects/fox", "fox");
+
+    QCOMPARE(search("fox"), QStringList({"a.txt", "keep.log", "src/generated.txt"}));
+}
+
+void KFileContentSearcherTest::testIgnorePatterns()
+{
+    m_testDir->createFile(".gitignore", "docs/**/*.txt\nout/**\n**/cache\n*.o\n");
+    m_testDir->createFile("docs/fox.txt", "fox");
+    m_testDir->createFile("docs/api/fox.txt", "fox");
+    m_testDir->createFile("docs/fox.md", "fox");
+    m_testDir->createFile("out/fox.md", "fox");
+    m_testDir->createFile("src/cache/fox.md", "fox");
+    m_testDir->createFile("src/fox.o", "fox");
+
+    // The rules of a nested file take precedence
+    m_testDir->createFile("lib/.gitignore", "!*.o\n");
+    m_testDir->createFile("lib/fox.o", "fox");
+
+    QCOMPARE(search("fox"), QStringList({"a.txt", "docs/fox.md", "lib/fox.o", "src/fox.h"}));
+}
+
+void KFileContentSearcherTest::testCancel()
+{
+    KFileContentSearcher searcher;
+    QSignalSpy filesFoundSpy(&searcher, &KFileContentSearcher::filesFound);
+    QSignalSpy completedSpy(&searcher, &KFileContentSearcher::searchCompleted);
+
+    const QUrl url = TestHelpers::searchUrl("fox", m_testDir->url(), true);
+    searcher.search(url);
+    QVERIFY(searcher.isSearching(url));
+    searcher.cancel(url);
+    QVERIFY(!searcher.isSearching());
+
+    QTest::qWait(100);
+    QVERIFY(filesFoundSpy.isEmpty());
+    QVERIFY(completedSpy.isEmpty());
+}
+
+void KFileContentSearcherTest::testDirLister()
+{
+    KFileItemModelDirLister dirLister;
+    dirLister.setContentSearchEnabled(true);
+
+    QStringList paths;
+    connect(&dirLister, &KFileItemModelDirLister::itemsAdded, this, [this, &paths](const QUrl&, const KFileItemList& items) {
+        for (const KFileItem& item : items) {
+            paths.append(item.localPath().mid(m_testDir->path().length() + 1));
+        }
+    });
+
+    // The found files are added to the listing while the content is searched
+    QSignalSpy completedSpy(&dirLister, static_cast<void (KCoreDirLister::*)()>(&KCoreDirLister::completed));
+    QVERIFY(dirLister.openUrl(TestHelpers::searchUrl("fox", m_testDir->url(), true)));
+    QVERIFY(dirLister.isListingLocally());
+    QVERIFY(completedSpy.wait());
+
+    paths.sort();
+    QCOMPARE(paths, search("fox"));
+}
+
+QStringList KFileContentSearcherTest::search(const QString& text)
+{
+    KFileContentSearcher searcher;
+    QStringList paths;
+    connect(&searcher, &KFileContentSearcher::filesFound, this, [&paths, this](const QUrl&, const QStringList& foundPaths) {
+        for (const QString& path : foundPaths) {
+            paths.append(path.mid(m_testDir->path().length() + 1));
+        }
+    });
+
+    QSignalSpy completedSpy(&searcher, &KFileContentSearcher::searchCompleted);
+    searcher.search(TestHelpers::searchUrl(text, m_testDir->url(), true));
+    if (!completedSpy.wait()) {
+        return {QStringLiteral("<not completed>")};
+    }
+
+    paths.sort();
+    return paths;
+}
+
+QTEST_GUILESS_MAIN(KFileContentSearcherTest)
+
+#include "kfilecontentsearchertest.moc"
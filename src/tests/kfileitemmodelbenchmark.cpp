@@ -164,12 +164,12 @@ void KFileItemModelBenchmark::insertAndRemoveManyItems()
     QBENCHMARK {
         model.slotClear();
         model.slotItemsAdded(model.directory(), initialItems);
-        model.slotCompleted();
+        model.slotCompleted(QUrl());
         QCOMPARE(model.count(), initialItems.count());
 
         if (!newItems.isEmpty()) {
             model.slotItemsAdded(model.directory(), newItems);
-            model.slotCompleted();
+            model.slotCompleted(QUrl());
         }
         QCOMPARE(model.count(), initialItems.count() + newItems.count());
 
@@ -0,0 +1,136 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kfileitemmodelchangecoalescer.h"
+#include "testhelpers.h"
+
+#include <QStandardPaths>
+#include <QTest>
+
+namespace {
+    const QUrl directoryUrl = TestHelpers::directoryUrl();
+}
+
+class KFileItemModelChangeCoalescerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void testSeparateChanges();
+    void testAddAndDelete();
+    void testDeleteAndAdd();
+    void testRefreshTwice();
+    void testRefreshAndDelete();
+    void testClear();
+};
+
+void KFileItemModelChangeCoalescerTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void KFileItemModelChangeCoalescerTest::testSeparateChanges()
+{
+    KFileItemModelChangeCoalescer coalescer;
+    QVERIFY(coalescer.isEmpty());
+
+    const KFileItem a = TestHelpers::fileItem(QStringLiteral("a"));
+    const KFileItem b = TestHelpers::fileItem(QStringLiteral("b"));
+    const KFileItem c = TestHelpers::fileItem(QStringLiteral("c"));
+    const KFileItem changedC = TestHelpers::fileItem(QStringLiteral("c"), 10);
+
+    coalescer.addItems(directoryUrl, {a});
+    coalescer.deleteItems({b});
+    coalescer.refreshItems({qMakePair(c, changedC)});
+    QCOMPARE(coalescer.count(), 3);
+
+    const KFileItemModelChangeCoalescer::Changes changes = coalescer.takeChanges();
+    QVERIFY(coalescer.isEmpty());
+    QCOMPARE(changes.addedItems.count(), 1);
+    QCOMPARE(changes.addedItems.value(directoryUrl), KFileItemList({a}));
+    QCOMPARE(changes.deletedItems, KFileItemList({b}));
+    QCOMPARE(changes.refreshedItems.count(), 1);
+    QCOMPARE(changes.refreshedItems.first().first, c);
+    QCOMPARE(changes.refreshedItems.first().second.size(), KIO::filesize_t(10));
+}
+
+void KFileItemModelChangeCoalescerTest::testAddAndDelete()
+{
+    KFileItemModelChangeCoalescer coalescer;
+    const KFileItem a = TestHelpers::fileItem(QStringLiteral("a"));
+
+    // An item that has been created and deleted is dropped
+    coalescer.addItems(directoryUrl, {a});
+    coalescer.refreshItems({qMakePair(a, TestHelpers::fileItem(QStringLiteral("a"), 10))});
+    coalescer.deleteItems({a});
+    QVERIFY(coalescer.isEmpty());
+}
+
+void KFileItemModelChangeCoalescerTest::testDeleteAndAdd()
+{
+    KFileItemModelChangeCoalescer coalescer;
+    const KFileItem a = TestHelpers::fileItem(QStringLiteral("a"));
+    const KFileItem newA = TestHelpers::fileItem(QStringLiteral("a"), 10);
+
+    // An item that has been replaced is refreshed
+    coalescer.deleteItems({a});
+    coalescer.addItems(directoryUrl, {newA});
+
+    const KFileItemModelChangeCoalescer::Changes changes = coalescer.takeChanges();
+    QVERIFY(changes.addedItems.isEmpty());
+    QVERIFY(changes.deletedItems.isEmpty());
+    QCOMPARE(changes.refreshedItems.count(), 1);
+    QCOMPARE(changes.refreshedItems.first().first, a);
+    QCOMPARE(changes.refreshedItems.first().second.size(), KIO::filesize_t(10));
+}
+
+void KFileItemModelChangeCoalescerTest::testRefreshTwice()
+{
+    KFileItemModelChangeCoalescer coalescer;
+    const KFileItem a = TestHelpers::fileItem(QStringLiteral("a"));
+    const KFileItem a1 = TestHelpers::fileItem(QStringLiteral("a"), 1);
+    const KFileItem a2 = TestHelpers::fileItem(QStringLiteral("a"), 2);
+
+    // The item of the model is refreshed only once to the latest item
+    coalescer.refreshItems({qMakePair(a, a1)});
+    coalescer.refreshItems({qMakePair(a1, a2)});
+
+    const KFileItemModelChangeCoalescer::Changes changes = coalescer.takeChanges();
+    QCOMPARE(changes.refreshedItems.count(), 1);
+    QCOMPARE(changes.refreshedItems.first().first, a);
+    QCOMPARE(changes.refreshedItems.first().second.size(), KIO::filesize_t(2));
+}
+
+void KFileItemModelChangeCoalescerTest::testRefreshAndDelete()
+{
+    KFileItemModelChangeCoalescer coalescer;
+    const KFileItem a = TestHelpers::fileItem(QStringLiteral("a"));
+    const KFileItem a1 = TestHelpers::fileItem(QStringLiteral("a"), 1);
+
+    coalescer.refreshItems({qMakePair(a, a1)});
+    coalescer.deleteItems({a1});
+
+    const KFileItemModelChangeCoalescer::Changes changes = coalescer.takeChanges();
+    QVERIFY(changes.refreshedItems.isEmpty());
+    QCOMPARE(changes.deletedItems, KFileItemList({a}));
+}
+
+void KFileItemModelChangeCoalescerTest::testClear()
+{
+    KFileItemModelChangeCoalescer coalescer;
+    coalescer.addItems(directoryUrl, {TestHelpers::fileItem(QStringLiteral("a"))});
+    coalescer.deleteItems({TestHelpers::fileItem(QStringLiteral("b"))});
+    QCOMPARE(coalescer.count(), 2);
+
+    coalescer.clear();
+    QVERIFY(coalescer.isEmpty());
+    QVERIFY(coalescer.takeChanges().addedItems.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(KFileItemModelChangeCoalescerTest)
+
+#include "kfileitemmodelchangecoalescertest.moc"
@@ -0,0 +1,375 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/*
+ * Measures the comparison functions of KFileItemModel for each sort role,
+ * with natural sorting on and off, for several locales and corpora of names
+ * and prints the results as JSON. Changes of Qt or ICU that slow down the
+ * collation show up as larger times per comparison. Example:
+ *
+ *   kfileitemmodelcomparatorbenchmark --locales de_DE,tr_TR --corpora camera --output results.json
+ */
+
+#include "benchmarkhelpers.h"
+#include "dolphin_generalsettings.h"
+#include "kitemviews/kfileitemmodel.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSet>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <random>
+
+namespace {
+    const char* const DirectoryUrl = "file:///dolphin-benchmark";
+
+    // The sorting choices of the settings, natural sorting is measured
+    // with and without the collation keys of the items.
+    enum SortingMode {
+        NaturalWithKeys,
+        NaturalWithoutKeys,
+        CaseInsensitive,
+        CaseSensitive
+    };
+
+    const QList<QPair<SortingMode, QString> > SortingModes = {
+        {NaturalWithKeys, QStringLiteral("natural")},
+        {NaturalWithoutKeys, QStringLiteral("natural-without-keys")},
+        {CaseInsensitive, QStringLiteral("case-insensitive")},
+        {CaseSensitive, QStringLiteral("case-sensitive")},
+    };
+}
+
+/**
+ * @brief Runs the benchmarks and collects the results.
+ *
+ * For each combination of locale, corpus and sorting mode a model with
+ * \a itemCount items is created. lessThan() and sortRoleCompare() are
+ * measured for each sort role on \a comparisons random pairs of items,
+ * stringCompare() on the names of the same pairs, and sorting all items
+ * for each sort role.
+ */
+class KFileItemModelComparatorBenchmark
+{
+public:
+    KFileItemModelComparatorBenchmark(int itemCount, int comparisons, const QStringList& roles);
+
+    void run(const QString& localeName, const QString& corpus);
+    QJsonObject results() const;
+
+    static QStringList corpora();
+
+private:
+    /**
+     * Applies \a mode to \a model like after changing the settings.
+     */
+    void setSortingMode(KFileItemModel& model, SortingMode mode) const;
+
+    /**
+     * Measures \a compare for all pairs and adds the time per comparison
+     * to the results.
+     */
+    void measureComparisons(const QJsonObject& variant, const QString& function,
+                            const std::function<int(int, int)>& compare);
+    void measureSorting(const QJsonObject& variant, KFileItemModel& model);
+
+    /**
+     * @return Items whose names are typical for the corpus \a corpus. The
+     *         other properties are distributed like in real folders. The
+     *         result only depends on \a corpus, \a count and \a seed.
+     */
+    static KFileItemList createItems(const QString& corpus, int count, int seed);
+
+    int m_itemCount;
+    int m_comparisons;
+    QStringList m_roles;
+    QVector<QPair<int, int> > m_pairs;  // Indexes of the compared items of the running corpus
+    QJsonArray m_results;
+    int m_sink; // Prevents that the comparisons are optimized away
+};
+
+KFileItemModelComparatorBenchmark::KFileItemModelComparatorBenchmark(int itemCount, int comparisons, const QStringList& roles) :
+    m_itemCount(itemCount),
+    m_comparisons(comparisons),
+    m_roles(roles),
+    m_pairs(),
+    m_results(),
+    m_sink(0)
+{
+}
+
+void KFileItemModelComparatorBenchmark::run(const QString& localeName, const QString& corpus)
+{
+    // A corpus might not provide enough different names
+    const KFileItemList items = createItems(corpus, m_itemCount, m_itemCount);
+    if (items.count() < m_itemCount) {
+        fprintf(stderr, "%s: only %i of %i items\n", qPrintable(corpus), items.count(), m_itemCount);
+    }
+
+    std::mt19937 random(m_itemCount);
+    std::uniform_int_distribution<int> index(0, items.count() - 1);
+    m_pairs.clear();
+    m_pairs.reserve(m_comparisons);
+    for (int i = 0; i < m_comparisons; ++i) {
+        m_pairs.append(qMakePair(index(random), index(random)));
+    }
+
+    // The collator of the model uses the default locale
+    QLocale::setDefault(QLocale(localeName));
+
+    KFileItemModel model;
+    model.setRoles({"text", "isDir", "isLink", "isHidden", "size", "modificationtime", "type", "permissions", "owner", "group"});
+    BenchmarkHelpers::addItems(model, items);
+
+    QList<QByteArray> roles;
+    const QList<KFileItemModel::RoleInfo> rolesInfo = KFileItemModel::rolesInformation();
+    for (const KFileItemModel::RoleInfo& info : rolesInfo) {
+        if (m_roles.isEmpty() || m_roles.contains(QString::fromLatin1(info.role))) {
+            roles << info.role;
+        }
+    }
+
+    for (const auto& mode : SortingModes) {
+        setSortingMode(model, mode.first);
+        const QList<KFileItemModel::ItemData*>& itemData = model.m_itemData;
+
+        QJsonObject variant;
+        variant.insert(QStringLiteral("locale"), localeName);
+        variant.insert(QStringLiteral("corpus"), corpus);
+        variant.insert(QStringLiteral("sorting"), mode.second);
+
+        measureComparisons(variant, QStringLiteral("stringCompare"), [&](int a, int b) {
+            return model.stringCompare(itemData.at(a)->item.text(), itemData.at(b)->item.text(), model.m_collator);
+        });
+
+        for (const QByteArray& role : qAsConst(roles)) {
+            // The items are not resorted, so that the pairs stay the same
+            model.setSortRole(role, false);
+
+            QJsonObject roleVariant = variant;
+            roleVariant.insert(QStringLiteral("role"), QString::fromLatin1(role));
+
+            measureComparisons(roleVariant, QStringLiteral("lessThan"), [&](int a, int b) {
+                return model.lessThan(itemData.at(a), itemData.at(b), model.m_collator) ? 1 : 0;
+            });
+            measureComparisons(roleVariant, QStringLiteral("sortRoleCompare"), [&](int a, int b) {
+                return model.sortRoleCompare(itemData.at(a), itemData.at(b), model.m_collator);
+            });
+            measureSorting(roleVariant, model);
+        }
+        model.setSortRole("text", false);
+    }
+}
+
+QJsonObject KFileItemModelComparatorBenchmark::results() const
+{
+    QJsonObject object;
+    object.insert(QStringLiteral("benchmark"), QStringLiteral("kfileitemmodelcomparatorbenchmark"));
+    object.insert(QStringLiteral("qtVersion"), QString::fromLatin1(qVersion()));
+    object.insert(QStringLiteral("itemCount"), m_itemCount);
+    object.insert(QStringLiteral("comparisons"), m_comparisons);
+    object.insert(QStringLiteral("results"), m_results);
+    return object;
+}
+
+QStringList KFileItemModelComparatorBenchmark::corpora()
+{
+    return {QStringLiteral("versions"), QStringLiteral("camera"), QStringLiteral("cjk"), QStringLiteral("mixed")};
+}
+
+void KFileItemModelComparatorBenchmark::setSortingMode(KFileItemModel& model, SortingMode mode) const
+{
+    using Choice = GeneralSettings::EnumSortingChoice;
+    switch (mode) {
+    case NaturalWithKeys:
+    case NaturalWithoutKeys:
+        GeneralSettings::setSortingChoice(Choice::NaturalSorting);
+        break;
+    case CaseInsensitive:
+        GeneralSettings::setSortingChoice(Choice::CaseInsensitiveSorting);
+        break;
+    case CaseSensitive:
+        GeneralSettings::setSortingChoice(Choice::CaseSensitiveSorting);
+        break;
+    }
+    GeneralSettings::self()->save();
+
+    // The collation keys are omitted like under memory pressure if the
+    // sorting may use at most one byte
+    model.setSortingMemoryLimit(mode == NaturalWithoutKeys ? 1 : 0);
+    BenchmarkHelpers::finishResorting(model);
+}
+
+void KFileItemModelComparatorBenchmark::measureComparisons(const QJsonObject& variant, const QString& function,
+                                                           const std::function<int(int, int)>& compare)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (const auto& pair : qAsConst(m_pairs)) {
+        m_sink += compare(pair.first, pair.second);
+    }
+    const double nsecsPerComparison = double(timer.nsecsElapsed()) / qMax(1, m_pairs.count());
+
+    QJsonObject result = variant;
+    result.insert(QStringLiteral("function"), function);
+    result.insert(QStringLiteral("nsecsPerComparison"), nsecsPerComparison);
+    m_results << result;
+}
+
+void KFileItemModelComparatorBenchmark::measureSorting(const QJsonObject& variant, KFileItemModel& model)
+{
+    QList<KFileItemModel::ItemData*> items = model.m_itemData;
+    std::shuffle(items.begin(), items.end(), std::mt19937(items.count()));
+
+    QElapsedTimer timer;
+    timer.start();
+    model.sort(items.begin(), items.end());
+    const double msecs = timer.nsecsElapsed() / 1000000.0;
+
+    QJsonObject result = variant;
+    result.insert(QStringLiteral("function"), QStringLiteral("sort"));
+    result.insert(QStringLiteral("msecs"), msecs);
+    m_results << result;
+
+    fprintf(stderr, "%s %s %s %s: sort %.1f ms\n",
+            qPrintable(variant.value(QStringLiteral("locale")).toString()),
+            qPrintable(variant.value(QStringLiteral("corpus")).toString()),
+            qPrintable(variant.value(QStringLiteral("sorting")).toString()),
+            qPrintable(variant.value(QStringLiteral("role")).toString()), msecs);
+}
+
+KFileItemList KFileItemModelComparatorBenchmark::createItems(const QString& corpus, int count, int seed)
+{
+    static const QStringList projects = {
+        QStringLiteral("libfoo"), QStringLiteral("linux"), QStringLiteral("Qt"), QStringLiteral("kio-extras"),
+        QStringLiteral("firefox"), QStringLiteral("gcc"),
+    };
+    static const QStringList cameraPrefixes = {
+        QStringLiteral("IMG_"), QStringLiteral("DSC"), QStringLiteral("DSCF"), QStringLiteral("PXL_2021"), QStringLiteral("P"),
+    };
+    static const QStringList cjkWords = {
+        QStringLiteral("東京"), QStringLiteral("写真"), QStringLiteral("資料"), QStringLiteral("会議"),
+        QStringLiteral("ひらがな"), QStringLiteral("カタカナ"), QStringLiteral("报告"), QStringLiteral("照片"),
+        QStringLiteral("文档"), QStringLiteral("项目"), QStringLiteral("北京"), QStringLiteral("한국어"),
+    };
+    static const QStringList mixedWords = {
+        QStringLiteral("report"), QStringLiteral("Invoice"), QStringLiteral("Übersicht"), QStringLiteral("résumé"),
+        QStringLiteral("İstanbul"), QStringLiteral("ılık"), QStringLiteral("Işık"), QStringLiteral("şehir"),
+        QStringLiteral("Straße"), QStringLiteral("README"), QStringLiteral("données"), QStringLiteral("østers"),
+    };
+    static const QList<QPair<QString, QString> > extensions = {
+        {QStringLiteral("jpg"), QStringLiteral("image/jpeg")},
+        {QStringLiteral("pdf"), QStringLiteral("application/pdf")},
+        {QStringLiteral("txt"), QStringLiteral("text/plain")},
+        {QStringLiteral("tar.gz"), QStringLiteral("application/x-compressed-tar")},
+    };
+    std::mt19937 random(seed);
+    const auto randomInt = [&random](int max) {
+        return std::uniform_int_distribution<int>(0, max - 1)(random);
+    };
+
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+
+    QSet<QString> names;
+    names.reserve(count);
+
+    KFileItemList items;
+    items.reserve(count);
+    int attempts = 0;
+    while (items.count() < count && attempts < count * 100) {
+        ++attempts;
+        const auto& extension = extensions.at(randomInt(extensions.count()));
+
+        QString name;
+        if (corpus == QLatin1String("versions")) {
+            name = QStringLiteral("%1-%2.%3.%4.%5").arg(projects.at(randomInt(projects.count())))
+                                                   .arg(randomInt(10)).arg(randomInt(30)).arg(randomInt(200))
+                                                   .arg(extension.first);
+        } else if (corpus == QLatin1String("camera")) {
+            name = QStringLiteral("%1%2.%3").arg(cameraPrefixes.at(randomInt(cameraPrefixes.count())))
+                                            .arg(randomInt(100000), 5, 10, QLatin1Char('0'))
+                                            .arg(randomInt(2) ? QStringLiteral("JPG") : QStringLiteral("jpg"));
+        } else if (corpus == QLatin1String("cjk")) {
+            name = QStringLiteral("%1%2 %3.%4").arg(cjkWords.at(randomInt(cjkWords.count())),
+                                                    cjkWords.at(randomInt(cjkWords.count())))
+                                               .arg(randomInt(1000)).arg(extension.first);
+        } else {
+            name = QStringLiteral("%1 %2 (%3).%4").arg(mixedWords.at(randomInt(mixedWords.count())),
+                                                       mixedWords.at(randomInt(mixedWords.count())).toLower())
+                                                  .arg(randomInt(100)).arg(extension.first);
+        }
+
+        if (names.contains(name)) {
+            continue;
+        }
+        names.insert(name);
+
+        const bool isDir = randomInt(100) < 5;
+        const QString mimeType = isDir ? QStringLiteral("inode/directory") : extension.second;
+        const qint64 modificationTime = now - randomInt(3 * 365 * 24 * 3600);
+
+        items << BenchmarkHelpers::createItem(QUrl(DirectoryUrl), name, mimeType, randomInt(100 * 1000 * 1000), modificationTime, &random);
+    }
+
+    return items;
+}
+
+int main(int argc, char** argv)
+{
+    QApplication app(argc, argv);
+    QStandardPaths::setTestModeEnabled(true);
+    BenchmarkHelpers::installMessageHandler();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Measures the comparison functions of KFileItemModel."));
+    parser.addHelpOption();
+    const QCommandLineOption localesOption(QStringLiteral("locales"),
+                                           QStringLiteral("Comma separated locales."),
+                                           QStringLiteral("locales"), QStringLiteral("en_US,de_DE,ja_JP,zh_CN,tr_TR"));
+    const QCommandLineOption corporaOption(QStringLiteral("corpora"),
+                                           QStringLiteral("Comma separated corpora of names: versions, camera, cjk, mixed. All by default."),
+                                           QStringLiteral("corpora"));
+    const QCommandLineOption rolesOption(QStringLiteral("roles"),
+                                         QStringLiteral("Comma separated sort roles, e.g. text,size. All by default."),
+                                         QStringLiteral("roles"));
+    const QCommandLineOption countOption(QStringLiteral("count"),
+                                         QStringLiteral("Number of items of each model."),
+                                         QStringLiteral("count"), QStringLiteral("5000"));
+    const QCommandLineOption comparisonsOption(QStringLiteral("comparisons"),
+                                               QStringLiteral("Number of measured comparisons of each function."),
+                                               QStringLiteral("count"), QStringLiteral("100000"));
+    const QCommandLineOption outputOption(QStringLiteral("output"),
+                                          QStringLiteral("Writes the JSON results to the file instead of stdout."),
+                                          QStringLiteral("file"));
+    parser.addOptions({localesOption, corporaOption, rolesOption, countOption, comparisonsOption, outputOption});
+    parser.process(app);
+
+    const int itemCount = qMax(2, parser.value(countOption).toInt());
+    const int comparisons = qMax(1, parser.value(comparisonsOption).toInt());
+    const QStringList roles = parser.value(rolesOption).split(QLatin1Char(','), Qt::SkipEmptyParts);
+    QStringList corpora = parser.value(corporaOption).split(QLatin1Char(','), Qt::SkipEmptyParts);
+    if (corpora.isEmpty()) {
+        corpora = KFileItemModelComparatorBenchmark::corpora();
+    }
+
+    KFileItemModelComparatorBenchmark benchmark(itemCount, comparisons, roles);
+    const QStringList locales = parser.value(localesOption).split(QLatin1Char(','), Qt::SkipEmptyParts);
+    for (const QString& locale : locales) {
+        for (const QString& corpus : qAsConst(corpora)) {
+            benchmark.run(locale, corpus);
+        }
+    }
+
+    return BenchmarkHelpers::writeResults(benchmark.results(), parser.value(outputOption));
+}
@@ -0,0 +1,493 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/*
+ * Measures the time and the heap allocations of the most important operations
+ * of KFileItemModel on synthetic folders and prints the results as JSON, which
+ * allows to compare the results of different releases. The items are created
+ * from UDS entries, so no files are created on the disk. Example:
+ *
+ *   kfileitemmodeloperationsbenchmark --sizes 10000,100000 --iterations 5 --output results.json
+ */
+
+#include "allocationcounter.h"
+#include "benchmarkhelpers.h"
+#include "kitemviews/kfileitemmodel.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSet>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <random>
+
+namespace {
+    const char* const DirectoryUrl = "file:///dolphin-benchmark";
+}
+
+/**
+ * @brief Runs the benchmarks and collects the results.
+ *
+ * Each operation is measured \a iterations times on a fresh setup, and
+ * the minimum and median of the samples are reported.
+ */
+class KFileItemModelOperationsBenchmark
+{
+public:
+    KFileItemModelOperationsBenchmark(int iterations, const QStringList& operations);
+
+    void run(int itemCount);
+    QJsonObject results() const;
+
+private:
+    void benchmarkLoading(int itemCount);
+    void benchmarkSorting(int itemCount);
+    void benchmarkFiltering(int itemCount);
+    void benchmarkGrouping(int itemCount);
+    void benchmarkExpanding(int itemCount);
+    void benchmarkIndexLookup(int itemCount);
+    void benchmarkSettingData(int itemCount);
+
+    bool isEnabled(const QString& operation) const;
+
+    /**
+     * Calls \a setup and measures \a callback for each iteration.
+     */
+    void measure(const QString& operation, const QString& variant, int itemCount,
+                 const std::function<void()>& setup, const std::function<void()>& callback);
+
+    void setSortRole(KFileItemModel& model, const QByteArray& role) const;
+    void setSortOrder(KFileItemModel& model, Qt::SortOrder order) const;
+
+    static QSet<QByteArray> defaultRoles();
+
+    int m_iterations;
+    QStringList m_operations;
+    QJsonArray m_results;
+};
+
+KFileItemModelOperationsBenchmark::KFileItemModelOperationsBenchmark(int iterations, const QStringList& operations) :
+    m_iterations(iterations),
+    m_operations(operations),
+    m_results()
+{
+}
+
+void KFileItemModelOperationsBenchmark::run(int itemCount)
+{
+    if (isEnabled(QStringLiteral("load"))) {
+        benchmarkLoading(itemCount);
+    }
+    if (isEnabled(QStringLiteral("sort"))) {
+        benchmarkSorting(itemCount);
+    }
+    if (isEnabled(QStringLiteral("filter"))) {
+        benchmarkFiltering(itemCount);
+    }
+    if (isEnabled(QStringLiteral("group"))) {
+        benchmarkGrouping(itemCount);
+    }
+    if (isEnabled(QStringLiteral("expand"))) {
+        benchmarkExpanding(itemCount);
+    }
+    if (isEnabled(QStringLiteral("index"))) {
+        benchmarkIndexLookup(itemCount);
+    }
+    if (isEnabled(QStringLiteral("setdata"))) {
+        benchmarkSettingData(itemCount);
+    }
+}
+
+QJsonObject KFileItemModelOperationsBenchmark::results() const
+{
+    QJsonObject object;
+    object.insert(QStringLiteral("benchmark"), QStringLiteral("kfileitemmodeloperationsbenchmark"));
+    object.insert(QStringLiteral("qtVersion"), QString::fromLatin1(qVersion()));
+    object.insert(QStringLiteral("iterations"), m_iterations);
+    object.insert(QStringLiteral("results"), m_results);
+    return object;
+}
+
+void KFileItemModelOperationsBenchmark::benchmarkLoading(int itemCount)
+{
+    const KFileItemList items = BenchmarkHelpers::createItems(itemCount, QUrl(DirectoryUrl), itemCount);
+
+    KFileItemModel model;
+    model.setRoles(defaultRoles());
+
+    measure(QStringLiteral("load"), QStringLiteral("natural"), itemCount,
+            [&]() { model.slotClear(); },
+            [&]() { BenchmarkHelpers::loadItems(model, items); });
+
+    // Loading the items in several chunks, like KDirLister does for large
+    // folders, inserts items into the already sorted model.
+    measure(QStringLiteral("load"), QStringLiteral("chunks"), itemCount,
+            [&]() { model.slotClear(); },
+            [&]() {
+                const int chunkSize = qMax(1, itemCount / 10);
+                for (int i = 0; i < items.count(); i += chunkSize) {
+                    model.slotItemsAdded(model.directory(), items.mid(i, chunkSize));
+                    model.dispatchPendingItemsToInsert();
+                }
+                model.slotCompleted(QUrl());
+            });
+
+    measure(QStringLiteral("clear"), QString(), itemCount,
+            [&]() { BenchmarkHelpers::loadItems(model, items); },
+            [&]() { model.slotClear(); });
+}
+
+void KFileItemModelOperationsBenchmark::benchmarkSorting(int itemCount)
+{
+    const KFileItemList items = BenchmarkHelpers::createItems(itemCount, QUrl(DirectoryUrl), itemCount);
+
+    KFileItemModel model;
+    model.setRoles(defaultRoles());
+    BenchmarkHelpers::loadItems(model, items);
+
+    const QList<KFileItemModel::RoleInfo> rolesInfo = KFileItemModel::rolesInformation();
+    for (const KFileItemModel::RoleInfo& info : rolesInfo) {
+        // The items are sorted by another role before each sample, so that
+        // the items must really be moved.
+        const QByteArray previousRole = (info.role == "text") ? QByteArray("size") : QByteArray("text");
+        measure(QStringLiteral("sort"), QString::fromLatin1(info.role), itemCount,
+                [&]() { setSortRole(model, previousRole); },
+                [&]() { setSortRole(model, info.role); });
+    }
+
+    setSortRole(model, "text");
+    measure(QStringLiteral("sort"), QStringLiteral("text-descending"), itemCount,
+            [&]() { setSortOrder(model, Qt::AscendingOrder); },
+            [&]() { setSortOrder(model, Qt::DescendingOrder); });
+    setSortOrder(model, Qt::AscendingOrder);
+}
+
+void KFileItemModelOperationsBenchmark::benchmarkFiltering(int itemCount)
+{
+    const KFileItemList items = BenchmarkHelpers::createItems(itemCount, QUrl(DirectoryUrl), itemCount);
+
+    KFileItemModel model;
+    model.setRoles(defaultRoles());
+    BenchmarkHelpers::loadItems(model, items);
+
+    measure(QStringLiteral("filter"), QStringLiteral("name"), itemCount,
+            [&]() { model.setNameFilter(QString()); },
+            [&]() { model.setNameFilter(QStringLiteral("img")); });
+
+    measure(QStringLiteral("filter"), QStringLiteral("name-reset"), itemCount,
+            [&]() { model.setNameFilter(QStringLiteral("img")); },
+            [&]() { model.setNameFilter(QString()); });
+
+    const QStringList mimeTypes = {QStringLiteral("image/jpeg"), QStringLiteral("application/pdf")};
+    measure(QStringLiteral("filter"), QStringLiteral("mimetype"), itemCount,
+            [&]() { model.setMimeTypeFilters(QStringList()); },
+            [&]() { model.setMimeTypeFilters(mimeTypes); });
+
+    measure(QStringLiteral("filter"), QStringLiteral("mimetype-reset"), itemCount,
+            [&]() { model.setMimeTypeFilters(mimeTypes); },
+            [&]() { model.setMimeTypeFilters(QStringList()); });
+}
+
+void KFileItemModelOperationsBenchmark::benchmarkGrouping(int itemCount)
+{
+    const KFileItemList items = BenchmarkHelpers::createItems(itemCount, QUrl(DirectoryUrl), itemCount);
+
+    KFileItemModel model;
+    QSet<QByteArray> roles = defaultRoles();
+    roles << "permissions";
+    model.setRoles(roles);
+    model.setGroupedSorting(true);
+    BenchmarkHelpers::loadItems(model, items);
+
+    const QList<QByteArray> groupRoles = {"text", "size", "modificationtime", "permissions"};
+    for (const QByteArray& role : groupRoles) {
+        setSortRole(model, role);
+
+        measure(QStringLiteral("group"), QString::fromLatin1(role), itemCount,
+                [&]() {
+                    model.m_groups.clear();
+                    model.m_nameGroupValues.clear();
+                    model.m_timeGroupValues.clear();
+                    model.m_permissionGroupValues.clear();
+                },
+                [&]() { model.groups(); });
+
+        // Toggling the grouping only requires to compare the memoized values.
+        measure(QStringLiteral("group"), QString::fromLatin1(role) + QStringLiteral("-memoized"), itemCount,
+                [&]() { model.m_groups.clear(); },
+                [&]() { model.groups(); });
+    }
+
+    setSortRole(model, "text");
+
+    // Insert 1 % new items into the grouped model.
+    KFileItemList newItems;
+    const KFileItemList candidates = BenchmarkHelpers::createItems(qMax(1, itemCount / 100), QUrl(DirectoryUrl), itemCount + 1);
+    for (const KFileItem& item : candidates) {
+        if (model.index(item.url()) < 0) {
+            newItems << item;
+        }
+    }
+    measure(QStringLiteral("group"), QStringLiteral("insert"), itemCount,
+            [&]() {
+                if (model.count() > items.count()) {
+                    model.slotItemsDeleted(newItems);
+                }
+                model.groups();
+            },
+            [&]() {
+                model.slotItemsAdded(model.directory(), newItems);
+                model.slotCompleted(QUrl());
+                model.groups();
+            });
+}
+
+void KFileItemModelOperationsBenchmark::benchmarkExpanding(int itemCount)
+{
+    // Each folder on the top level contains 99 items.
+    const int childrenPerFolder = 99;
+    const int folderCount = qMax(1, itemCount / (childrenPerFolder + 1));
+
+    const QUrl directoryUrl(DirectoryUrl);
+    KFileItemList folders;
+    QList<KFileItemList> children;
+    for (int i = 0; i < folderCount; ++i) {
+        const KFileItem folder = BenchmarkHelpers::createItem(directoryUrl, QStringLiteral("folder %1").arg(i),
+                                                              QStringLiteral("inode/directory"), 0, 0);
+        folders << folder;
+        children << BenchmarkHelpers::createItems(childrenPerFolder, folder.url(), i, 0);
+    }
+
+    KFileItemModel model;
+    QSet<QByteArray> roles = defaultRoles();
+    roles << "isExpanded" << "isExpandable" << "expandedParentsCount";
+    model.setRoles(roles);
+    model.m_dirLister->setAutoUpdate(false);
+    BenchmarkHelpers::loadItems(model, folders);
+
+    const auto expandAll = [&]() {
+        for (int i = 0; i < folderCount; ++i) {
+            const int index = model.index(folders.at(i));
+            model.setExpanded(index, true);
+            model.slotItemsAdded(folders.at(i).url(), children.at(i));
+            model.dispatchPendingItemsToInsert();
+        }
+        model.slotCompleted(QUrl());
+    };
+
+    const auto collapseAll = [&]() {
+        for (int i = 0; i < folderCount; ++i) {
+            model.setExpanded(model.index(folders.at(i)), false);
+        }
+    };
+
+    measure(QStringLiteral("expand"), QString(), itemCount, collapseAll, expandAll);
+    measure(QStringLiteral("collapse"), QString(), itemCount, expandAll, collapseAll);
+}
+
+void KFileItemModelOperationsBenchmark::benchmarkIndexLookup(int itemCount)
+{
+    const KFileItemList items = BenchmarkHelpers::createItems(itemCount, QUrl(DirectoryUrl), itemCount);
+
+    QList<QUrl> urls;
+    urls.reserve(items.count());
+    for (const KFileItem& item : items) {
+        urls << item.url();
+    }
+    std::shuffle(urls.begin(), urls.end(), std::mt19937(itemCount));
+
+    KFileItemModel model;
+    model.setRoles(defaultRoles());
+
+    // The index cache is filled by the first lookups after loading.
+    measure(QStringLiteral("index"), QStringLiteral("after-loading"), itemCount,
+            [&]() { BenchmarkHelpers::loadItems(model, items); },
+            [&]() {
+                for (const QUrl& url : qAsConst(urls)) {
+                    model.index(url);
+                }
+            });
+
+    measure(QStringLiteral("index"), QStringLiteral("cached"), itemCount,
+            [&]() {},
+            [&]() {
+                for (const QUrl& url : qAsConst(urls)) {
+                    model.index(url);
+                }
+            });
+}
+
+void KFileItemModelOperationsBenchmark::benchmarkSettingData(int itemCount)
+{
+    const KFileItemList items = BenchmarkHelpers::createItems(itemCount, QUrl(DirectoryUrl), itemCount);
+
+    KFileItemModel model;
+    QSet<QByteArray> roles = defaultRoles();
+    roles << "rating";
+    model.setRoles(roles);
+    BenchmarkHelpers::loadItems(model, items);
+
+    // Like KItemListView, the receiver only reads the values of the changed items
+    int changedItems = 0;
+    QObject::connect(&model, &KFileItemModel::itemsChanged, [&](const KItemRangeList& itemRanges, const QSet<QByteArray>& changedRoles) {
+        for (const KItemRange& range : itemRanges) {
+            for (int index = range.index; index < range.index + range.count; ++index) {
+                changedItems += model.data(index).contains(*changedRoles.cbegin()) ? 1 : 0;
+            }
+        }
+    });
+
+    // Each sample sets other values, so that all items are changed
+    int rating = 0;
+
+    // The roles updater sets the values of single items, e.g. if
+    // the baloo roles or the MIME type of an item have been determined.
+    measure(QStringLiteral("setdata"), QStringLiteral("single"), itemCount,
+            [&]() { ++rating; },
+            [&]() {
+                for (int index = 0; index < itemCount; ++index) {
+                    model.setData(index, {{"rating", rating}});
+                }
+            });
+
+    // The unchanged values are compared without changing the items.
+    measure(QStringLiteral("setdata"), QStringLiteral("single-unchanged"), itemCount,
+            [&]() {},
+            [&]() {
+                for (int index = 0; index < itemCount; ++index) {
+                    model.setData(index, {{"rating", rating}});
+                }
+            });
+
+    measure(QStringLiteral("setdata"), QStringLiteral("batch"), itemCount,
+            [&]() { ++rating; },
+            [&]() {
+                QHash<int, QHash<QByteArray, QVariant> > itemsValues;
+                itemsValues.reserve(itemCount);
+                for (int index = 0; index < itemCount; ++index) {
+                    itemsValues.insert(index, {{"rating", rating}});
+                }
+                model.setItemsData(itemsValues);
+            });
+
+    measure(QStringLiteral("setdata"), QStringLiteral("role-values"), itemCount,
+            [&]() { ++rating; },
+            [&]() { model.setRoleValues("rating", KItemRangeList() << KItemRange(0, itemCount), QVector<QVariant>(itemCount, rating)); });
+
+    Q_ASSERT(changedItems > 0);
+}
+
+bool KFileItemModelOperationsBenchmark::isEnabled(const QString& operation) const
+{
+    return m_operations.isEmpty() || m_operations.contains(operation);
+}
+
+void KFileItemModelOperationsBenchmark::measure(const QString& operation, const QString& variant, int itemCount,
+                                                const std::function<void()>& setup, const std::function<void()>& callback)
+{
+    QVector<qint64> samples;
+    samples.reserve(m_iterations);
+    QVector<qint64> allocations;
+    allocations.reserve(m_iterations);
+
+    QElapsedTimer timer;
+    for (int i = 0; i < m_iterations; ++i) {
+        setup();
+        const qint64 previousAllocations = AllocationCounter::allocations();
+        timer.start();
+        callback();
+        samples << timer.nsecsElapsed();
+        allocations << AllocationCounter::allocations() - previousAllocations;
+    }
+
+    QJsonArray samplesMsecs;
+    for (const qint64 sample : qAsConst(samples)) {
+        samplesMsecs << sample / 1000000.0;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    std::sort(allocations.begin(), allocations.end());
+
+    QJsonObject result;
+    result.insert(QStringLiteral("operation"), operation);
+    if (!variant.isEmpty()) {
+        result.insert(QStringLiteral("variant"), variant);
+    }
+    result.insert(QStringLiteral("itemCount"), itemCount);
+    result.insert(QStringLiteral("minMsecs"), samples.first() / 1000000.0);
+    result.insert(QStringLiteral("medianMsecs"), samples.at(samples.count() / 2) / 1000000.0);
+    result.insert(QStringLiteral("samplesMsecs"), samplesMsecs);
+    if (AllocationCounter::isAvailable()) {
+        // The allocations of the worker threads are included
+        result.insert(QStringLiteral("medianAllocations"), allocations.at(allocations.count() / 2));
+    }
+    m_results << result;
+
+    fprintf(stderr, "%s %s n=%i: %.1f ms, %lli allocations\n", qPrintable(operation), qPrintable(variant), itemCount,
+            samples.at(samples.count() / 2) / 1000000.0, allocations.at(allocations.count() / 2));
+}
+
+void KFileItemModelOperationsBenchmark::setSortRole(KFileItemModel& model, const QByteArray& role) const
+{
+    model.setSortRole(role);
+    BenchmarkHelpers::finishResorting(model);
+}
+
+void KFileItemModelOperationsBenchmark::setSortOrder(KFileItemModel& model, Qt::SortOrder order) const
+{
+    model.setSortOrder(order);
+    BenchmarkHelpers::finishResorting(model);
+}
+
+QSet<QByteArray> KFileItemModelOperationsBenchmark::defaultRoles()
+{
+    return {"text", "isDir", "isLink", "isHidden", "size", "modificationtime"};
+}
+
+int main(int argc, char** argv)
+{
+    QApplication app(argc, argv);
+    QStandardPaths::setTestModeEnabled(true);
+    BenchmarkHelpers::installMessageHandler();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Measures the operations of KFileItemModel on synthetic folders."));
+    parser.addHelpOption();
+    const QCommandLineOption sizesOption(QStringLiteral("sizes"),
+                                         QStringLiteral("Comma separated numbers of items."),
+                                         QStringLiteral("sizes"), QStringLiteral("10000,100000"));
+    const QCommandLineOption iterationsOption(QStringLiteral("iterations"),
+                                              QStringLiteral("Number of samples of each operation."),
+                                              QStringLiteral("count"), QStringLiteral("3"));
+    const QCommandLineOption operationsOption(QStringLiteral("operations"),
+                                              QStringLiteral("Comma separated operations: load, sort, filter, group, expand, index, setdata. All by default."),
+                                              QStringLiteral("operations"));
+    const QCommandLineOption outputOption(QStringLiteral("output"),
+                                          QStringLiteral("Writes the JSON results to the file instead of stdout."),
+                                          QStringLiteral("file"));
+    parser.addOptions({sizesOption, iterationsOption, operationsOption, outputOption});
+    parser.process(app);
+
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+    const QStringList operations = parser.value(operationsOption).split(QLatin1Char(','), Qt::SkipEmptyParts);
+
+    KFileItemModelOperationsBenchmark benchmark(iterations, operations);
+    const QStringList sizes = parser.value(sizesOption).split(QLatin1Char(','), Qt::SkipEmptyParts);
+    for (const QString& size : sizes) {
+        const int itemCount = size.toInt();
+        if (itemCount > 0) {
+            benchmark.run(itemCount);
+        }
+    }
+
+    return BenchmarkHelpers::writeResults(benchmark.results(), parser.value(outputOption));
+}
@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kfileitemmodelprefixindex.h"
+
+#include <QTest>
+
+class KFileItemModelPrefixIndexTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void testIndexOf_data();
+    void testIndexOf();
+    void testClear();
+
+private:
+    KFileItemModelPrefixIndex m_index;
+};
+
+void KFileItemModelPrefixIndexTest::init()
+{
+    // The same names as in KFileItemModelTest::testIndexForKeyboardSearch()
+    m_index.build({"a", "aa", "Image.jpg", "Image.png", "Text", "Text1", "Text2", "Text11"});
+}
+
+void KFileItemModelPrefixIndexTest::testIndexOf_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<int>("startFromIndex");
+    QTest::addColumn<int>("expectedIndex");
+
+    QTest::newRow("First match") << "a" << 0 << 0;
+    QTest::newRow("Longer prefix") << "aa" << 0 << 1;
+    QTest::newRow("Full name") << "image.png" << 0 << 3;
+    QTest::newRow("Start index") << "text1" << 6 << 7;
+    QTest::newRow("Wrap around") << "i" << 7 << 2;
+    QTest::newRow("Wrap around to full name") << "text2" << 7 << 6;
+    QTest::newRow("Case insensitive") << "IMAGE" << 4 << 2;
+    QTest::newRow("No match") << "aaa" << 0 << -1;
+    QTest::newRow("No match after prefix") << "text3" << 5 << -1;
+}
+
+void KFileItemModelPrefixIndexTest::testIndexOf()
+{
+    QFETCH(QString, text);
+    QFETCH(int, startFromIndex);
+    QFETCH(int, expectedIndex);
+
+    QVERIFY(m_index.isBuilt());
+    QCOMPARE(m_index.indexOf(text, startFromIndex), expectedIndex);
+}
+
+void KFileItemModelPrefixIndexTest::testClear()
+{
+    m_index.clear();
+    QVERIFY(!m_index.isBuilt());
+    QCOMPARE(m_index.indexOf("a", 0), -1);
+
+    m_index.build({});
+    QVERIFY(m_index.isBuilt());
+    QCOMPARE(m_index.indexOf("a", 0), -1);
+}
+
+QTEST_GUILESS_MAIN(KFileItemModelPrefixIndexTest)
+
+#include "kfileitemmodelprefixindextest.moc"
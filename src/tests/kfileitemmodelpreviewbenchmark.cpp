@@ -0,0 +1,328 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/*
+ * Measures the throughput of the preview pipeline of KFileItemModelRolesUpdater
+ * and prints the results as JSON. The previews are not created by
+ * KIO::PreviewJob, but by fake preview jobs that deliver images of a
+ * configurable size with a configurable latency to the same slot the real
+ * jobs are connected to. The processing in the worker threads, the
+ * conversion to pixmaps and the updating of the model are measured without
+ * the noise of the thumbnailers. Example:
+ *
+ *   kfileitemmodelpreviewbenchmark --items 5000 --jobs 4 --latency 2 --image-size 512x384
+ */
+
+#include "benchmarkhelpers.h"
+#include "kitemviews/kfileitemmodel.h"
+#include "kitemviews/kfileitemmodelrolesupdater.h"
+#include "kitemviews/private/kmemorybudget.h"
+
+#include <QApplication>
+#include <QColor>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHash>
+#include <QImage>
+#include <QJsonObject>
+#include <QPixmap>
+#include <QStandardPaths>
+#include <QTimer>
+
+#include <ctime>
+
+namespace {
+    const char* const DirectoryUrl = "file:///dolphin-benchmark";
+
+    // Number of different images that are delivered by the fake preview jobs
+    const int ImageCount = 8;
+
+    // CPU time in ns that has been spent by the calling thread
+    qint64 threadCpuTime()
+    {
+        timespec time;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+            return 0;
+        }
+        return qint64(time.tv_sec) * 1000000000LL + time.tv_nsec;
+    }
+
+    KFileItemList createItems(int count)
+    {
+        const qint64 modificationTime = QDateTime::currentSecsSinceEpoch() - 3600;
+
+        KFileItemList items;
+        items.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            items << BenchmarkHelpers::createItem(QUrl(DirectoryUrl), QStringLiteral("IMG_%1.jpg").arg(i, 6, 10, QLatin1Char('0')),
+                                                  QStringLiteral("image/jpeg"), 3 * 1000 * 1000 + i, modificationTime + i);
+        }
+        return items;
+    }
+}
+
+/**
+ * @brief Delivers fake previews to KFileItemModelRolesUpdater and collects the measurements.
+ *
+ * Each of the fake preview jobs delivers one preview per latency interval,
+ * like a KIO::PreviewJob whose thumbnailer needs that time per file. The
+ * images are converted to pixmaps in the main thread before they are passed
+ * to KFileItemModelRolesUpdater::slotGotPreview(), as KIO::PreviewJob does.
+ * A preview has reached the view when the model emits itemsChanged() with
+ * the role "iconPixmap" for its item.
+ */
+class KFileItemModelPreviewBenchmark
+{
+public:
+    KFileItemModelPreviewBenchmark(int itemCount, int jobCount, int latency, const QSize& imageSize, int iconSize);
+    ~KFileItemModelPreviewBenchmark();
+
+    /**
+     * Delivers the previews of all items and waits until they have
+     * reached the model, at most \a timeout ms.
+     */
+    void run(int timeout);
+    QJsonObject results() const;
+
+private:
+    void deliverNextPreview();
+    void slotItemsChanged(const KItemRangeList& itemRanges, const QSet<QByteArray>& roles);
+
+    int m_itemCount;
+    int m_jobCount;
+    int m_latency;
+    QSize m_imageSize;
+    int m_iconSize;
+
+    KFileItemModel m_model;
+    KFileItemModelRolesUpdater* m_rolesUpdater;
+    KFileItemList m_items;
+    QVector<QImage> m_images;
+
+    QEventLoop* m_loop;
+    QElapsedTimer m_clock;
+    int m_deliveredCount;
+    int m_receivedCount;
+    QHash<int, qint64> m_deliveryTimes;     // Index of the item -> time of the delivery in ns
+
+    QVector<qint64> m_deliveryDurations;
+    QVector<qint64> m_latencies;
+    qint64 m_runTime;
+    qint64 m_cpuTime;
+    qint64 m_residentMemoryGrowth;
+    qint64 m_budgetUsageGrowth;
+};
+
+KFileItemModelPreviewBenchmark::KFileItemModelPreviewBenchmark(int itemCount, int jobCount, int latency, const QSize& imageSize, int iconSize) :
+    m_itemCount(itemCount),
+    m_jobCount(jobCount),
+    m_latency(latency),
+    m_imageSize(imageSize),
+    m_iconSize(iconSize),
+    m_model(),
+    m_rolesUpdater(nullptr),
+    m_items(),
+    m_images(),
+    m_loop(nullptr),
+    m_clock(),
+    m_deliveredCount(0),
+    m_receivedCount(0),
+    m_deliveryTimes(),
+    m_deliveryDurations(),
+    m_latencies(),
+    m_runTime(0),
+    m_cpuTime(0),
+    m_residentMemoryGrowth(0),
+    m_budgetUsageGrowth(0)
+{
+    m_model.setRoles({"text", "isDir", "isLink", "isHidden", "size", "modificationtime"});
+
+    // The roles updater is paused while the items are inserted, so that
+    // no real preview jobs are started
+    m_rolesUpdater = new KFileItemModelRolesUpdater(&m_model);
+    m_rolesUpdater->setPaused(true);
+    m_rolesUpdater->setIconSize(QSize(m_iconSize, m_iconSize));
+    m_rolesUpdater->setPreviewsShown(true);
+
+    m_items = createItems(m_itemCount);
+    m_model.queueItemsAdded(QUrl(DirectoryUrl), m_items);
+    m_model.slotCompleted(QUrl(DirectoryUrl));
+    m_rolesUpdater->setVisibleIndexRange(0, m_model.count());
+
+    for (int i = 0; i < ImageCount; ++i) {
+        QImage image(m_imageSize, QImage::Format_RGB32);
+        image.fill(QColor::fromHsv(i * 360 / ImageCount, 160, 200));
+        m_images.append(image);
+    }
+
+    QObject::connect(&m_model, &KFileItemModel::itemsChanged, [this](const KItemRangeList& itemRanges, const QSet<QByteArray>& roles) {
+        slotItemsChanged(itemRanges, roles);
+    });
+}
+
+KFileItemModelPreviewBenchmark::~KFileItemModelPreviewBenchmark()
+{
+    // The roles updater may not outlive the model
+    delete m_rolesUpdater;
+}
+
+void KFileItemModelPreviewBenchmark::run(int timeout)
+{
+    const qint64 residentMemoryStart = BenchmarkHelpers::residentMemory();
+    const qint64 budgetUsageStart = KMemoryBudget::instance().totalUsage();
+
+    // Pretend that the preview jobs have been started
+    m_rolesUpdater->setState(KFileItemModelRolesUpdater::PreviewJobRunning);
+
+    QEventLoop loop;
+    m_loop = &loop;
+
+    QVector<QTimer*> jobs;
+    for (int i = 0; i < m_jobCount; ++i) {
+        QTimer* job = new QTimer();
+        job->setInterval(m_latency);
+        QObject::connect(job, &QTimer::timeout, [this, job]() {
+            if (m_deliveredCount >= m_items.count()) {
+                job->stop();
+                return;
+            }
+            deliverNextPreview();
+        });
+        jobs.append(job);
+    }
+
+    QTimer::singleShot(timeout, &loop, &QEventLoop::quit);
+
+    const qint64 cpuTimeStart = threadCpuTime();
+    m_clock.start();
+    for (QTimer* job : qAsConst(jobs)) {
+        job->start();
+    }
+    loop.exec();
+    m_runTime = m_clock.nsecsElapsed();
+    m_cpuTime = threadCpuTime() - cpuTimeStart;
+
+    qDeleteAll(jobs);
+    m_loop = nullptr;
+
+    m_residentMemoryGrowth = BenchmarkHelpers::residentMemory() - residentMemoryStart;
+    m_budgetUsageGrowth = KMemoryBudget::instance().totalUsage() - budgetUsageStart;
+}
+
+QJsonObject KFileItemModelPreviewBenchmark::results() const
+{
+    const qreal runSecs = m_runTime / 1000000000.0;
+
+    QJsonObject object;
+    object.insert(QStringLiteral("benchmark"), QStringLiteral("kfileitemmodelpreviewbenchmark"));
+    object.insert(QStringLiteral("qtVersion"), QString::fromLatin1(qVersion()));
+    object.insert(QStringLiteral("items"), m_itemCount);
+    object.insert(QStringLiteral("jobs"), m_jobCount);
+    object.insert(QStringLiteral("latencyMsecs"), m_latency);
+    object.insert(QStringLiteral("imageSize"), QStringLiteral("%1x%2").arg(m_imageSize.width()).arg(m_imageSize.height()));
+    object.insert(QStringLiteral("iconSize"), m_iconSize);
+    object.insert(QStringLiteral("delivered"), m_deliveredCount);
+    object.insert(QStringLiteral("received"), m_receivedCount);
+    object.insert(QStringLiteral("completed"), m_receivedCount == m_itemCount);
+    object.insert(QStringLiteral("runMsecs"), m_runTime / 1000000.0);
+    object.insert(QStringLiteral("previewsPerSec"), runSecs > 0 ? m_receivedCount / runSecs : 0.0);
+    object.insert(QStringLiteral("mainThreadCpuMsecs"), m_cpuTime / 1000000.0);
+    object.insert(QStringLiteral("mainThreadCpuMsecsPerPreview"), m_receivedCount > 0 ? m_cpuTime / 1000000.0 / m_receivedCount : 0.0);
+    object.insert(QStringLiteral("deliveryDurations"), BenchmarkHelpers::percentiles(m_deliveryDurations));
+    object.insert(QStringLiteral("latencyToModel"), BenchmarkHelpers::percentiles(m_latencies));
+    object.insert(QStringLiteral("residentMemoryGrowthBytes"), double(m_residentMemoryGrowth));
+    object.insert(QStringLiteral("budgetUsageGrowthBytes"), double(m_budgetUsageGrowth));
+    object.insert(QStringLiteral("rolesUpdaterMemoryBytes"), double(m_rolesUpdater->memoryUsage()));
+    return object;
+}
+
+void KFileItemModelPreviewBenchmark::deliverNextPreview()
+{
+    const KFileItem& item = m_items.at(m_deliveredCount);
+    const QImage& image = m_images.at(m_deliveredCount % ImageCount);
+    ++m_deliveredCount;
+
+    const int index = m_model.index(item);
+    m_deliveryTimes.insert(index, m_clock.nsecsElapsed());
+
+    QElapsedTimer timer;
+    timer.start();
+    m_rolesUpdater->slotGotPreview(item, QPixmap::fromImage(image));
+    m_deliveryDurations << timer.nsecsElapsed();
+}
+
+void KFileItemModelPreviewBenchmark::slotItemsChanged(const KItemRangeList& itemRanges, const QSet<QByteArray>& roles)
+{
+    if (!roles.contains("iconPixmap")) {
+        return;
+    }
+
+    const qint64 now = m_clock.nsecsElapsed();
+    for (const KItemRange& range : itemRanges) {
+        for (int index = range.index; index < range.index + range.count; ++index) {
+            const auto it = m_deliveryTimes.find(index);
+            if (it != m_deliveryTimes.end()) {
+                m_latencies << now - it.value();
+                m_deliveryTimes.erase(it);
+                ++m_receivedCount;
+            }
+        }
+    }
+
+    if (m_loop && m_receivedCount >= m_itemCount) {
+        m_loop->quit();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    QApplication app(argc, argv);
+    QStandardPaths::setTestModeEnabled(true);
+    BenchmarkHelpers::installMessageHandler();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Measures the throughput of the preview pipeline of KFileItemModelRolesUpdater."));
+    parser.addHelpOption();
+    const QCommandLineOption itemsOption(QStringLiteral("items"),
+                                         QStringLiteral("Number of items that get a preview."),
+                                         QStringLiteral("count"), QStringLiteral("2000"));
+    const QCommandLineOption jobsOption(QStringLiteral("jobs"),
+                                        QStringLiteral("Number of fake preview jobs that deliver previews in parallel."),
+                                        QStringLiteral("count"), QStringLiteral("1"));
+    const QCommandLineOption latencyOption(QStringLiteral("latency"),
+                                           QStringLiteral("Time in ms that a fake preview job needs per preview."),
+                                           QStringLiteral("msecs"), QStringLiteral("0"));
+    const QCommandLineOption imageSizeOption(QStringLiteral("image-size"),
+                                             QStringLiteral("Size of the delivered previews."),
+                                             QStringLiteral("widthxheight"), QStringLiteral("256x192"));
+    const QCommandLineOption iconSizeOption(QStringLiteral("icon-size"),
+                                            QStringLiteral("Icon size of the view."),
+                                            QStringLiteral("pixels"), QStringLiteral("128"));
+    const QCommandLineOption timeoutOption(QStringLiteral("timeout"),
+                                           QStringLiteral("Time in ms after which the measurement is stopped."),
+                                           QStringLiteral("msecs"), QStringLiteral("60000"));
+    const QCommandLineOption outputOption(QStringLiteral("output"),
+                                          QStringLiteral("Writes the JSON results to the file instead of stdout."),
+                                          QStringLiteral("file"));
+    parser.addOptions({itemsOption, jobsOption, latencyOption, imageSizeOption, iconSizeOption, timeoutOption, outputOption});
+    parser.process(app);
+
+    const QStringList imageSize = parser.value(imageSizeOption).split(QLatin1Char('x'));
+    if (imageSize.count() != 2 || imageSize.at(0).toInt() <= 0 || imageSize.at(1).toInt() <= 0) {
+        parser.showHelp(1);
+    }
+
+    KFileItemModelPreviewBenchmark benchmark(qMax(1, parser.value(itemsOption).toInt()),
+                                             qMax(1, parser.value(jobsOption).toInt()),
+                                             qMax(0, parser.value(latencyOption).toInt()),
+                                             QSize(imageSize.at(0).toInt(), imageSize.at(1).toInt()),
+                                             qMax(16, parser.value(iconSizeOption).toInt()));
+    benchmark.run(qMax(0, parser.value(timeoutOption).toInt()));
+
+    return BenchmarkHelpers::writeResults(benchmark.results(), parser.value(outputOption));
+}
@@ -0,0 +1,274 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/*
+ * Replays a recording of the signals of a directory lister against
+ * KFileItemModel and KFileItemModelRolesUpdater and prints the latency of
+ * the main thread and the number of emitted model signals as JSON. The
+ * recordings are created by running Dolphin with the environment variable
+ * DOLPHIN_DIRLISTER_RECORDING, see KDirListerRecorder. Example:
+ *
+ *   DOLPHIN_DIRLISTER_RECORDING=/tmp/build dolphin ~/src/project/build
+ *   kfileitemmodelreplaybenchmark --speed 10 /tmp/build-1.jsonl
+ */
+
+#include "benchmarkhelpers.h"
+#include "kitemviews/kfileitemmodel.h"
+#include "kitemviews/kfileitemmodelrolesupdater.h"
+#include "kitemviews/private/kdirlisterrecorder.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHash>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QTimer>
+
+#include <cstdio>
+
+namespace {
+    // Interval in ms of the timer that measures the latency of the main thread
+    const int ProbeInterval = 5;
+
+    // Number of items that are assumed to be visible in a view
+    const int VisibleItemCount = 100;
+}
+
+/**
+ * @brief Replays the recorded events and collects the measurements.
+ *
+ * The events are passed to the same slots of KFileItemModel that are
+ * connected to its directory lister, so the coalescing of changes is
+ * included. The latency of the main thread is measured by a timer with the
+ * interval ProbeInterval: The time by which a timeout is delayed is the time
+ * in which the main thread could not react on user input.
+ */
+class KFileItemModelReplayBenchmark
+{
+public:
+    KFileItemModelReplayBenchmark(const QVector<KDirListerRecorder::Event>& events, qreal speed, bool previews);
+    ~KFileItemModelReplayBenchmark();
+
+    /**
+     * Replays all events and waits \a drainTime ms for the pending
+     * changes and roles afterwards.
+     */
+    void run(int drainTime);
+    QJsonObject results() const;
+
+private:
+    void replay(const KDirListerRecorder::Event& event);
+    void connectCounters();
+
+    QVector<KDirListerRecorder::Event> m_events;
+    qreal m_speed;
+    bool m_previews;
+
+    KFileItemModel m_model;
+    KFileItemModelRolesUpdater* m_rolesUpdater;
+
+    QVector<qint64> m_eventDurations;
+    QVector<qint64> m_probeDelays;
+    QHash<QString, int> m_signalCounts;
+    QHash<QString, int> m_signalItemCounts;
+    qint64 m_replayTime;
+};
+
+KFileItemModelReplayBenchmark::KFileItemModelReplayBenchmark(const QVector<KDirListerRecorder::Event>& events, qreal speed, bool previews) :
+    m_events(events),
+    m_speed(speed),
+    m_previews(previews),
+    m_model(),
+    m_rolesUpdater(nullptr),
+    m_eventDurations(),
+    m_probeDelays(),
+    m_signalCounts(),
+    m_signalItemCounts(),
+    m_replayTime(0)
+{
+    m_model.setRoles({"text", "isDir", "isLink", "isHidden", "size", "modificationtime", "type"});
+
+    m_rolesUpdater = new KFileItemModelRolesUpdater(&m_model);
+    m_rolesUpdater->setIconSize(QSize(48, 48));
+    m_rolesUpdater->setPreviewsShown(m_previews);
+    m_rolesUpdater->setRoles({"size", "type"});
+    m_rolesUpdater->setVisibleIndexRange(0, VisibleItemCount);
+    m_rolesUpdater->setPaused(false);
+
+    connectCounters();
+}
+
+KFileItemModelReplayBenchmark::~KFileItemModelReplayBenchmark()
+{
+    // The roles updater may not outlive the model
+    delete m_rolesUpdater;
+}
+
+void KFileItemModelReplayBenchmark::run(int drainTime)
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    QElapsedTimer probeClock;
+    QTimer probe;
+    probe.setInterval(ProbeInterval);
+    QObject::connect(&probe, &QTimer::timeout, [&]() {
+        m_probeDelays << qMax<qint64>(0, probeClock.nsecsElapsed() - ProbeInterval * 1000000LL);
+        probeClock.restart();
+    });
+    probeClock.start();
+    probe.start();
+
+    QEventLoop loop;
+    QTimer eventTimer;
+    eventTimer.setSingleShot(true);
+    int next = 0;
+    const auto replayDueEvents = [&]() {
+        // Events that are due already are replayed without returning
+        // to the event loop, like KDirLister emits them.
+        while (next < m_events.count()) {
+            const KDirListerRecorder::Event& event = m_events.at(next);
+            const qint64 due = m_speed > 0 ? qint64(event.time / m_speed) : 0;
+            const qint64 remaining = due - clock.elapsed();
+            if (remaining > 0) {
+                eventTimer.start(int(remaining));
+                return;
+            }
+            replay(event);
+            ++next;
+        }
+        m_replayTime = clock.elapsed();
+        QTimer::singleShot(drainTime, &loop, &QEventLoop::quit);
+    };
+    QObject::connect(&eventTimer, &QTimer::timeout, replayDueEvents);
+
+    QTimer::singleShot(0, replayDueEvents);
+    loop.exec();
+}
+
+QJsonObject KFileItemModelReplayBenchmark::results() const
+{
+    QJsonObject signalCounts;
+    for (auto it = m_signalCounts.constBegin(); it != m_signalCounts.constEnd(); ++it) {
+        QJsonObject counts;
+        counts.insert(QStringLiteral("emitted"), it.value());
+        counts.insert(QStringLiteral("items"), m_signalItemCounts.value(it.key()));
+        signalCounts.insert(it.key(), counts);
+    }
+
+    QJsonObject object;
+    object.insert(QStringLiteral("benchmark"), QStringLiteral("kfileitemmodelreplaybenchmark"));
+    object.insert(QStringLiteral("qtVersion"), QString::fromLatin1(qVersion()));
+    object.insert(QStringLiteral("speed"), m_speed);
+    object.insert(QStringLiteral("previews"), m_previews);
+    object.insert(QStringLiteral("events"), m_events.count());
+    object.insert(QStringLiteral("replayMsecs"), double(m_replayTime));
+    object.insert(QStringLiteral("finalItemCount"), m_model.count());
+    object.insert(QStringLiteral("eventDurations"), BenchmarkHelpers::percentiles(m_eventDurations));
+    object.insert(QStringLiteral("mainThreadLatency"), BenchmarkHelpers::percentiles(m_probeDelays));
+    object.insert(QStringLiteral("modelSignals"), signalCounts);
+    return object;
+}
+
+void KFileItemModelReplayBenchmark::replay(const KDirListerRecorder::Event& event)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    switch (event.type) {
+    case KDirListerRecorder::Event::ItemsAdded:
+        m_model.queueItemsAdded(event.url, event.items);
+        break;
+    case KDirListerRecorder::Event::ItemsDeleted:
+        m_model.queueItemsDeleted(event.items);
+        break;
+    case KDirListerRecorder::Event::RefreshItems:
+        m_model.queueRefreshItems(event.refreshedItems);
+        break;
+    case KDirListerRecorder::Event::Completed:
+        m_model.slotCompleted(event.url);
+        break;
+    case KDirListerRecorder::Event::Clear:
+        m_model.slotClear();
+        break;
+    }
+
+    m_eventDurations << timer.nsecsElapsed();
+}
+
+void KFileItemModelReplayBenchmark::connectCounters()
+{
+    const auto count = [this](const QString& name, int items) {
+        ++m_signalCounts[name];
+        m_signalItemCounts[name] += items;
+    };
+    const auto rangeItems = [](const KItemRangeList& ranges) {
+        int items = 0;
+        for (const KItemRange& range : ranges) {
+            items += range.count;
+        }
+        return items;
+    };
+
+    QObject::connect(&m_model, &KFileItemModel::itemsInserted, [=](const KItemRangeList& ranges) {
+        count(QStringLiteral("itemsInserted"), rangeItems(ranges));
+    });
+    QObject::connect(&m_model, &KFileItemModel::itemsRemoved, [=](const KItemRangeList& ranges) {
+        count(QStringLiteral("itemsRemoved"), rangeItems(ranges));
+    });
+    QObject::connect(&m_model, &KFileItemModel::itemsChanged, [=](const KItemRangeList& ranges) {
+        count(QStringLiteral("itemsChanged"), rangeItems(ranges));
+    });
+    QObject::connect(&m_model, &KFileItemModel::itemsMoved, [=](const KItemRange& range) {
+        count(QStringLiteral("itemsMoved"), range.count);
+    });
+    QObject::connect(&m_model, &KFileItemModel::directoryLoadingCompleted, [=]() {
+        count(QStringLiteral("directoryLoadingCompleted"), 0);
+    });
+}
+
+int main(int argc, char** argv)
+{
+    QApplication app(argc, argv);
+    QStandardPaths::setTestModeEnabled(true);
+    BenchmarkHelpers::installMessageHandler();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Replays a recording of KDirLister signals against KFileItemModel."));
+    parser.addHelpOption();
+    const QCommandLineOption speedOption(QStringLiteral("speed"),
+                                         QStringLiteral("Factor by which the replay is accelerated. 0 replays all events at once."),
+                                         QStringLiteral("factor"), QStringLiteral("1"));
+    const QCommandLineOption previewsOption(QStringLiteral("previews"),
+                                            QStringLiteral("Creates previews for the visible items."));
+    const QCommandLineOption drainOption(QStringLiteral("drain"),
+                                         QStringLiteral("Time in ms that is measured after the last event."),
+                                         QStringLiteral("msecs"), QStringLiteral("2000"));
+    const QCommandLineOption outputOption(QStringLiteral("output"),
+                                          QStringLiteral("Writes the JSON results to the file instead of stdout."),
+                                          QStringLiteral("file"));
+    parser.addOptions({speedOption, previewsOption, drainOption, outputOption});
+    parser.addPositionalArgument(QStringLiteral("recording"), QStringLiteral("File that has been recorded by KDirListerRecorder."));
+    parser.process(app);
+
+    if (parser.positionalArguments().count() != 1) {
+        parser.showHelp(1);
+    }
+
+    QVector<KDirListerRecorder::Event> events;
+    const QString recording = parser.positionalArguments().first();
+    if (!KDirListerRecorder::readEvents(recording, events)) {
+        fprintf(stderr, "Cannot read %s\n", qPrintable(recording));
+        return 1;
+    }
+
+    KFileItemModelReplayBenchmark benchmark(events, qMax(0.0, parser.value(speedOption).toDouble()), parser.isSet(previewsOption));
+    benchmark.run(qMax(0, parser.value(drainOption).toInt()));
+
+    return BenchmarkHelpers::writeResults(benchmark.results(), parser.value(outputOption));
+}
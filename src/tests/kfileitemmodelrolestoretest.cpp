@@ -0,0 +1,93 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kfileitemmodelrolestore.h"
+
+#include <QStandardPaths>
+#include <QTest>
+
+class KFileItemModelRoleStoreTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void testUnsetValues();
+    void testSetValues();
+    void testSlotReuse();
+    void testClear();
+};
+
+void KFileItemModelRoleStoreTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void KFileItemModelRoleStoreTest::testUnsetValues()
+{
+    KFileItemModelRoleStore store;
+    const int slot = store.acquireSlot();
+
+    QCOMPARE(store.int64(slot, KFileItemModelRoleStore::SizeColumn), qint64(-1));
+    QVERIFY(!store.hasString(slot, KFileItemModelRoleStore::OwnerColumn));
+    QVERIFY(store.string(slot, KFileItemModelRoleStore::OwnerColumn).isEmpty());
+}
+
+void KFileItemModelRoleStoreTest::testSetValues()
+{
+    KFileItemModelRoleStore store;
+    const int slot1 = store.acquireSlot();
+    const int slot2 = store.acquireSlot();
+    QVERIFY(slot1 != slot2);
+
+    store.setInt64(slot1, KFileItemModelRoleStore::ModificationTimeColumn, 1000);
+    store.setInt64(slot2, KFileItemModelRoleStore::ModificationTimeColumn, 2000);
+    store.setString(slot1, KFileItemModelRoleStore::OwnerColumn, QStringLiteral("alice"));
+    store.setString(slot2, KFileItemModelRoleStore::OwnerColumn, QStringLiteral("alice"));
+    store.setString(slot2, KFileItemModelRoleStore::GroupColumn, QStringLiteral("users"));
+
+    QCOMPARE(store.int64(slot1, KFileItemModelRoleStore::ModificationTimeColumn), qint64(1000));
+    QCOMPARE(store.int64(slot2, KFileItemModelRoleStore::ModificationTimeColumn), qint64(2000));
+    QCOMPARE(store.string(slot1, KFileItemModelRoleStore::OwnerColumn), QStringLiteral("alice"));
+    QCOMPARE(store.string(slot2, KFileItemModelRoleStore::GroupColumn), QStringLiteral("users"));
+    QVERIFY(!store.hasString(slot1, KFileItemModelRoleStore::GroupColumn));
+
+    // Equal strings are interned and hence share their data.
+    QVERIFY(store.string(slot1, KFileItemModelRoleStore::OwnerColumn).constData() ==
+            store.string(slot2, KFileItemModelRoleStore::OwnerColumn).constData());
+}
+
+void KFileItemModelRoleStoreTest::testSlotReuse()
+{
+    KFileItemModelRoleStore store;
+    const int slot1 = store.acquireSlot();
+    store.acquireSlot();
+    store.setInt64(slot1, KFileItemModelRoleStore::SizeColumn, 42);
+
+    store.releaseSlot(slot1);
+    const int slot3 = store.acquireSlot();
+    QCOMPARE(slot3, slot1);
+    QCOMPARE(store.slotCount(), 2);
+
+    // A reused slot must not contain stale values.
+    QCOMPARE(store.int64(slot3, KFileItemModelRoleStore::SizeColumn), qint64(-1));
+}
+
+void KFileItemModelRoleStoreTest::testClear()
+{
+    KFileItemModelRoleStore store;
+    store.acquireSlot();
+    store.acquireSlot();
+    QCOMPARE(store.slotCount(), 2);
+
+    store.clear();
+    QCOMPARE(store.slotCount(), 0);
+    QCOMPARE(store.acquireSlot(), 0);
+}
+
+QTEST_GUILESS_MAIN(KFileItemModelRoleStoreTest)
+
+#include "kfileitemmodelrolestoretest.moc"
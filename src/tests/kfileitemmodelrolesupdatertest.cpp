@@ -0,0 +1,252 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/kfileitemmodel.h"
+#include "kitemviews/kfileitemmodelrolesupdater.h"
+#include "kitemviews/private/kpreviewcache.h"
+#include "testdir.h"
+
+#include <KIO/PreviewJob>
+
+#include <QImage>
+#include <QPixmap>
+#include <QSignalSpy>
+#include <QTest>
+
+class KFileItemModelRolesUpdaterTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testItemsChangedBeforeInserted();
+    void testItemsChangedBeforeRemoved();
+    void testTimedOutPreviews();
+    void testCachedHoverSequence();
+    void testHoverSequenceFrames();
+
+private:
+    /**
+     * Creates the updater after the slots of the test have been connected
+     * to the model, so that they are invoked before the slots of the updater.
+     */
+    void createUpdater();
+
+    /**
+     * Changes the rating of the item \a index.
+     */
+    void changeItem(int index);
+
+    /**
+     * Loads the test directory with the additional video \a name
+     * and shows the previews.
+     * @return Item of the video.
+     */
+    KFileItem loadVideo(const QString& name);
+
+    /**
+     * @return Value of "iconSequenceFrames" of \a item.
+     */
+    int sequenceFrames(const KFileItem& item) const;
+
+    static QPixmap createFrame(const QColor& color);
+
+    KFileItemModel* m_model;
+    KFileItemModelRolesUpdater* m_updater;
+    TestDir* m_testDir;
+    // Is set if the model has been changed while the flags of the updater
+    // did not match the number of items
+    bool m_changedBeforeUpdater;
+};
+
+void KFileItemModelRolesUpdaterTest::init()
+{
+    m_testDir = new TestDir();
+    m_testDir->createFiles({"a.txt", "b.txt", "c.txt"});
+    m_model = new KFileItemModel();
+    m_updater = nullptr;
+    m_changedBeforeUpdater = false;
+}
+
+void KFileItemModelRolesUpdaterTest::cleanup()
+{
+    delete m_updater;
+    m_updater = nullptr;
+    delete m_model;
+    m_model = nullptr;
+    delete m_testDir;
+    m_testDir = nullptr;
+}
+
+void KFileItemModelRolesUpdaterTest::testItemsChangedBeforeInserted()
+{
+    connect(m_model, &KFileItemModel::itemsInserted, this, [this](const KItemRangeList& itemRanges) {
+        if (m_updater && m_model->count() > 3) {
+            changeItem(itemRanges.last().index);
+        }
+    });
+    createUpdater();
+
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(m_updater->m_itemStates.count(), 3);
+
+    // The changed item is resolved after the updater has applied the inserted item
+    m_testDir->createFile("d.txt");
+    QTRY_COMPARE(m_model->count(), 4);
+    QVERIFY(m_changedBeforeUpdater);
+    QCOMPARE(m_updater->m_itemStates.count(), 4);
+    QTRY_COMPARE(m_updater->m_itemStates.flagCount(KFileItemModelRolesUpdater::ChangedItem), 0);
+    QCOMPARE(m_model->data(m_model->index(QUrl::fromLocalFile(m_testDir->path() + "/d.txt"))).value("rating").toInt(), 1);
+}
+
+void KFileItemModelRolesUpdaterTest::testItemsChangedBeforeRemoved()
+{
+    connect(m_model, &KFileItemModel::itemsRemoved, this, [this]() {
+        if (m_updater && m_model->count() > 0) {
+            changeItem(m_model->count() - 1);
+        }
+    });
+    createUpdater();
+
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+
+    // The flags of the updater still contain the removed item while the last item is changed
+    m_testDir->removeFile("a.txt");
+    QTRY_COMPARE(m_model->count(), 2);
+    QVERIFY(m_changedBeforeUpdater);
+    QCOMPARE(m_updater->m_itemStates.count(), 2);
+    QTRY_COMPARE(m_updater->m_itemStates.flagCount(KFileItemModelRolesUpdater::ChangedItem), 0);
+}
+
+void KFileItemModelRolesUpdaterTest::testTimedOutPreviews()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    const KFileItem item = m_model->fileItem(0);
+    QVERIFY(!KFileItemModelRolesUpdater::isPreviewTimedOut(item));
+
+    // The preview is tried once more after the first timeout
+    KFileItemModelRolesUpdater::markPreviewTimedOut(item);
+    QVERIFY(!KFileItemModelRolesUpdater::isPreviewTimedOut(item));
+    KFileItemModelRolesUpdater::markPreviewTimedOut(item);
+    QVERIFY(KFileItemModelRolesUpdater::isPreviewTimedOut(item));
+    QVERIFY(!KFileItemModelRolesUpdater::isPreviewTimedOut(m_model->fileItem(1)));
+
+    // Reloading the directory retries the preview
+    KFileItemModelRolesUpdater::retryTimedOutPreviews(m_testDir->url());
+    QVERIFY(!KFileItemModelRolesUpdater::isPreviewTimedOut(item));
+
+    // Downloading a remote file may take longer than reading a local one
+    const KFileItem remoteItem(QUrl(QStringLiteral("sftp://example.org/a.txt")), QStringLiteral("text/plain"));
+    QVERIFY(KFileItemModelRolesUpdater::previewTimeout(remoteItem) > KFileItemModelRolesUpdater::previewTimeout(item));
+}
+
+void KFileItemModelRolesUpdaterTest::testCachedHoverSequence()
+{
+    const KFileItem video = loadVideo(QStringLiteral("a.mp4"));
+    const QSize frameSize = m_updater->sequenceFrameSize();
+    QImage strip(frameSize.width() * 3, frameSize.height(), QImage::Format_ARGB32_Premultiplied);
+    strip.fill(Qt::red);
+    KPreviewCache::instance().insertSequence(video, frameSize, m_updater->m_enabledPlugins, strip, 3);
+
+    // A cached sequence is applied without a job
+    m_updater->setHoverSequenceItem(video);
+    QVERIFY(!m_updater->m_sequenceJob);
+    QCOMPARE(sequenceFrames(video), 3);
+
+    m_updater->setHoverSequenceItem(KFileItem());
+    QCOMPARE(sequenceFrames(video), 0);
+
+    // Only videos get a sequence
+    const KFileItem text = m_model->fileItem(m_model->index(QUrl::fromLocalFile(m_testDir->path() + "/b.txt")));
+    m_updater->setHoverSequenceItem(text);
+    QVERIFY(m_updater->m_sequenceItem.isNull());
+}
+
+void KFileItemModelRolesUpdaterTest::testHoverSequenceFrames()
+{
+    const KFileItem video = loadVideo(QStringLiteral("b.mp4"));
+    m_updater->setHoverSequenceItem(video);
+    KIO::PreviewJob* job = m_updater->m_sequenceJob;
+    QVERIFY(job);
+    QCOMPARE(job->sequenceIndex(), 0);
+
+    // All frames are requested by one job, which gets the next index after each frame
+    m_updater->slotGotSequenceFrame(video, createFrame(Qt::red));
+    QCOMPARE(m_updater->m_sequenceJob, job);
+    QCOMPARE(job->sequenceIndex(), 1);
+    QCOMPARE(sequenceFrames(video), 0);
+
+    m_updater->slotGotSequenceFrame(video, createFrame(Qt::blue));
+    QCOMPARE(job->sequenceIndex(), 2);
+    QCOMPARE(sequenceFrames(video), 2);
+
+    // The thumbnailer starts again with the first frame, so the remaining frames are not created
+    m_updater->slotGotSequenceFrame(video, createFrame(Qt::red));
+    QVERIFY(!m_updater->m_sequenceJob);
+    QCOMPARE(sequenceFrames(video), 2);
+
+    int frameCount = 0;
+    const QImage strip = KPreviewCache::instance().findSequence(video, m_updater->sequenceFrameSize(),
+                                                                m_updater->m_enabledPlugins, &frameCount);
+    QVERIFY(!strip.isNull());
+    QCOMPARE(frameCount, 2);
+}
+
+KFileItem KFileItemModelRolesUpdaterTest::loadVideo(const QString& name)
+{
+    m_testDir->createFile(name);
+    createUpdater();
+    m_updater->setPreviewsShown(true);
+
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+    m_model->loadDirectory(m_testDir->url());
+    if (!loadingCompletedSpy.wait()) {
+        return KFileItem();
+    }
+    return m_model->fileItem(m_model->index(QUrl::fromLocalFile(m_testDir->path() + QLatin1Char('/') + name)));
+}
+
+int KFileItemModelRolesUpdaterTest::sequenceFrames(const KFileItem& item) const
+{
+    return m_model->data(m_model->index(item)).value("iconSequenceFrames").toInt();
+}
+
+QPixmap KFileItemModelRolesUpdaterTest::createFrame(const QColor& color)
+{
+    QPixmap pixmap(16, 16);
+    pixmap.fill(color);
+    return pixmap;
+}
+
+void KFileItemModelRolesUpdaterTest::createUpdater()
+{
+    m_updater = new KFileItemModelRolesUpdater(m_model);
+    m_updater->setRoles({"text", "rating"});
+    m_updater->setVisibleIndexRange(0, 10);
+}
+
+void KFileItemModelRolesUpdaterTest::changeItem(int index)
+{
+    if (m_updater->m_itemStates.count() != m_model->count()) {
+        m_changedBeforeUpdater = true;
+    }
+
+    QHash<QByteArray, QVariant> rating;
+    rating.insert("rating", 1);
+    m_model->setData(index, rating);
+}
+
+QTEST_MAIN(KFileItemModelRolesUpdaterTest)
+
+#include "kfileitemmodelrolesupdatertest.moc"
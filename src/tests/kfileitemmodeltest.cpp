@@ -5,17 +5,20 @@
  * SPDX-License-Identifier: GPL-2.0-or-later
  */
 
+#include <QDir>
 #include <QRandomGenerator>
 #include <QTest>
 #include <QSignalSpy>
 #include <QStandardPaths>
 #include <QTimer>
 #include <QMimeData>
+#include <QRegularExpression>
 
 #include <kio/job.h>
 
 #include "kitemviews/kfileitemmodel.h"
 #include "kitemviews/private/kfileitemmodeldirlister.h"
+#include "kitemviews/private/kitemlistcostmodel.h"
 #include "testdir.h"
 
 void myMessageOutput(QtMsgType type, const QMessageLogContext& context, const QString& msg)
@@ -58,34 +61,62 @@ private Q_SLOTS:
     void testRemoveItems();
     void testDirLoadingCompleted();
     void testSetData();
+    void testSetItemsData();
+    void testSetRoleValues();
     void testSetDataWithModifiedSortRole_data();
     void testSetDataWithModifiedSortRole();
     void testChangeSortRole();
+    void testResolveMimeTypes();
     void testResortAfterChangingName();
+    void testRepositionChangedItems();
+    void testDeferredResorting();
     void testModelConsistencyWhenInsertingItems();
     void testItemRangeConsistencyWhenInsertingItems();
     void testExpandItems();
     void testExpandParentItems();
+    void testRestoreManyExpandedItems();
+    void testRecursiveListing();
+    void testSortingMemoryLimit();
+    void testLocaleChange();
     void testMakeExpandedItemHidden();
     void testRemoveFilteredExpandedItems();
     void testSorting();
+    void testSortingByIntegerRoles();
     void testIndexForKeyboardSearch();
     void testNameFilter();
     void testEmptyPath();
     void testRefreshExpandedItem();
     void testRemoveHiddenItems();
+    void testHiddenItemsKeepValues();
+    void testDirectoriesFirstAndOnly();
+    void testItemIds();
+    void testRefreshDirectory();
+    void testRefreshRemovedDirectory();
     void collapseParentOfHiddenItems();
     void removeParentOfHiddenItems();
     void testGeneralParentChildRelationships();
     void testNameRoleGroups();
     void testNameRoleGroupsWithExpandedItems();
+    void testGroupsAfterInsertingAndRemovingItems();
     void testInconsistentModel();
     void testChangeRolesForFilteredItems();
     void testChangeSortRoleWhileFiltering();
+    void testSortByDeletionTime();
     void testRefreshFilteredItems();
     void testCollapseFolderWhileLoading();
     void testCreateMimeData();
+    void testIndexesMatching();
     void testDeleteFileMoreThanOnce();
+    void testLocalListing();
+    void testSnapshots();
+    void testRetainedSnapshots();
+    void testNarrowedSearch();
+    void testSharedStringValues();
+    void testSharedItems();
+    void testItemsSnapshot();
+    void testItemsSnapshotReleased();
+    void testSearchResults();
+    void testItemsAddedWhileResorting();
 
 private:
     QStringList itemsInModel() const;
@@ -260,6 +291,84 @@ void KFileItemModelTest::testSetData()
     QVERIFY(m_model->isConsistent());
 }
 
+void KFileItemModelTest::testSetItemsData()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QVERIFY(itemsInsertedSpy.isValid());
+    QSignalSpy itemsChangedSpy(m_model, &KFileItemModel::itemsChanged);
+    QVERIFY(itemsChangedSpy.isValid());
+
+    m_testDir->createFiles({"a.txt", "b.txt", "c.txt", "d.txt"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(m_model->count(), 4);
+
+    QHash<int, QHash<QByteArray, QVariant> > itemsValues;
+    itemsValues[0].insert("customRole1", "Test0");
+    itemsValues[1].insert("customRole1", "Test1");
+    itemsValues[3].insert("customRole2", "Test3");
+
+    QVERIFY(m_model->setItemsData(itemsValues));
+
+    // All changes are reported with one signal.
+    QCOMPARE(itemsChangedSpy.count(), 1);
+    const QList<QVariant> arguments = itemsChangedSpy.takeFirst();
+    QCOMPARE(arguments.at(0).value<KItemRangeList>(), KItemRangeList() << KItemRange(0, 2) << KItemRange(3, 1));
+    QCOMPARE(arguments.at(1).value<QSet<QByteArray> >(), QSet<QByteArray>({"customRole1", "customRole2"}));
+
+    QCOMPARE(m_model->data(0).value("customRole1").toString(), QString("Test0"));
+    QCOMPARE(m_model->data(1).value("customRole1").toString(), QString("Test1"));
+    QVERIFY(!m_model->data(2).contains("customRole1"));
+    QCOMPARE(m_model->data(3).value("customRole2").toString(), QString("Test3"));
+
+    // Setting the same values again does not change anything.
+    QVERIFY(!m_model->setItemsData(itemsValues));
+    QCOMPARE(itemsChangedSpy.count(), 0);
+
+    QVERIFY(m_model->isConsistent());
+}
+
+void KFileItemModelTest::testSetRoleValues()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QVERIFY(itemsInsertedSpy.isValid());
+    QSignalSpy itemsChangedSpy(m_model, &KFileItemModel::itemsChanged);
+    QVERIFY(itemsChangedSpy.isValid());
+
+    m_testDir->createFiles({"a.txt", "b.txt", "c.txt", "d.txt", "e.txt"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(m_model->count(), 5);
+
+    const KItemRangeList itemRanges = KItemRangeList() << KItemRange(0, 2) << KItemRange(3, 2);
+    QVERIFY(m_model->setRoleValues("version", itemRanges, {1, 2, 3, 4}));
+
+    // All changes are reported with one signal.
+    QCOMPARE(itemsChangedSpy.count(), 1);
+    QList<QVariant> arguments = itemsChangedSpy.takeFirst();
+    QCOMPARE(arguments.at(0).value<KItemRangeList>(), itemRanges);
+    QCOMPARE(arguments.at(1).value<QSet<QByteArray> >(), QSet<QByteArray>({"version"}));
+
+    QCOMPARE(m_model->data(0).value("version").toInt(), 1);
+    QCOMPARE(m_model->data(1).value("version").toInt(), 2);
+    QVERIFY(!m_model->data(2).contains("version"));
+    QCOMPARE(m_model->data(3).value("version").toInt(), 3);
+    QCOMPARE(m_model->data(4).value("version").toInt(), 4);
+
+    // Only the items whose value has been changed are reported.
+    QVERIFY(m_model->setRoleValues("version", itemRanges, {1, 5, 3, 6}));
+    QCOMPARE(itemsChangedSpy.count(), 1);
+    arguments = itemsChangedSpy.takeFirst();
+    QCOMPARE(arguments.at(0).value<KItemRangeList>(), KItemRangeList() << KItemRange(1, 1) << KItemRange(4, 1));
+
+    QVERIFY(!m_model->setRoleValues("version", itemRanges, {1, 5, 3, 6}));
+    QCOMPARE(itemsChangedSpy.count(), 0);
+
+    QVERIFY(m_model->isConsistent());
+}
+
 void KFileItemModelTest::testSetDataWithModifiedSortRole_data()
 {
     QTest::addColumn<int>("changedIndex");
@@ -385,6 +494,40 @@ void KFileItemModelTest::testChangeSortRole()
     QVERIFY(ok1 || ok2);
 }
 
+void KFileItemModelTest::testResolveMimeTypes()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QSignalSpy itemsChangedSpy(m_model, &KFileItemModel::itemsChanged);
+    QVERIFY(itemsChangedSpy.isValid());
+
+    QSet<QByteArray> modelRoles = m_model->roles();
+    modelRoles << "type";
+    m_model->setRoles(modelRoles);
+
+    // The MIME-type of a file without extension can only be
+    // determined by reading its content.
+    m_testDir->createFile("script", "#!/bin/sh\necho test\n");
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(m_model->count(), 1);
+    QVERIFY(!m_model->fileItem(0).isMimeTypeKnown());
+
+    m_model->resolveMimeTypes(KFileItemList() << m_model->fileItem(0));
+    QVERIFY(itemsChangedSpy.wait());
+
+    QCOMPARE(itemsChangedSpy.count(), 1);
+    QList<QVariant> arguments = itemsChangedSpy.takeFirst();
+    QCOMPARE(arguments.at(0).value<KItemRangeList>(), KItemRangeList() << KItemRange(0, 1));
+    QVERIFY(arguments.at(1).value<QSet<QByteArray> >().contains("type"));
+
+    const KFileItem item = m_model->fileItem(0);
+    QVERIFY(item.isMimeTypeKnown());
+    QCOMPARE(item.mimetype(), QStringLiteral("application/x-shellscript"));
+    QCOMPARE(item.url(), QUrl::fromLocalFile(m_testDir->path() + "/script"));
+    QCOMPARE(m_model->data(0).value("type").toString(), item.mimeComment());
+}
+
 void KFileItemModelTest::testResortAfterChangingName()
 {
     QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
@@ -423,6 +566,99 @@ void KFileItemModelTest::testResortAfterChangingName()
     QCOMPARE(itemsInModel(), QStringList() << "a.txt" << "b.txt" << "c.txt");
 }
 
+void KFileItemModelTest::testRepositionChangedItems()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QSignalSpy itemsMovedSpy(m_model, &KFileItemModel::itemsMoved);
+    QVERIFY(itemsMovedSpy.isValid());
+
+    // All files have the same rating, so they are sorted by their names.
+    m_model->setSortRole("rating");
+
+    m_testDir->createFiles({"a.txt", "b.txt", "c.txt", "d.txt", "e.txt", "f.txt"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a.txt" << "b.txt" << "c.txt" << "d.txt" << "e.txt" << "f.txt");
+
+    // Only the changed item and the items that it passes are moved.
+    QHash<QByteArray, QVariant> rating;
+    rating.insert("rating", 2);
+    m_model->setData(2, rating);
+
+    QVERIFY(itemsMovedSpy.wait());
+    QCOMPARE(itemsMovedSpy.count(), 1);
+    QList<QVariant> arguments = itemsMovedSpy.takeFirst();
+    QCOMPARE(arguments.at(0).value<KItemRange>(), KItemRange(2, 4));
+    QCOMPARE(arguments.at(1).value<QList<int> >(), QList<int>() << 5 << 2 << 3 << 4);
+    QCOMPARE(itemsInModel(), QStringList() << "a.txt" << "b.txt" << "d.txt" << "e.txt" << "f.txt" << "c.txt");
+    QVERIFY(m_model->isConsistent());
+
+    // Several changed items are moved at once.
+    rating.insert("rating", 1);
+    m_model->setData(0, rating);
+    m_model->setData(3, rating);
+
+    QVERIFY(itemsMovedSpy.wait());
+    QCOMPARE(itemsMovedSpy.count(), 1);
+    arguments = itemsMovedSpy.takeFirst();
+    QCOMPARE(arguments.at(0).value<KItemRange>(), KItemRange(0, 5));
+    QCOMPARE(arguments.at(1).value<QList<int> >(), QList<int>() << 3 << 0 << 1 << 4 << 2);
+    QCOMPARE(itemsInModel(), QStringList() << "b.txt" << "d.txt" << "f.txt" << "a.txt" << "e.txt" << "c.txt");
+    QVERIFY(m_model->isConsistent());
+}
+
+void KFileItemModelTest::testDeferredResorting()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QSignalSpy itemsMovedSpy(m_model, &KFileItemModel::itemsMoved);
+    QVERIFY(itemsMovedSpy.isValid());
+
+    // The views anchor the current item only for the moves in the background
+    QList<bool> movedInBackground;
+    connect(m_model, &KFileItemModel::itemsMoved, this, [this, &movedInBackground]() {
+        movedInBackground.append(m_model->isMovingItemsInBackground());
+    });
+
+    m_model->setSortRole("rating");
+    m_testDir->createFiles({"a.txt", "b.txt", "c.txt", "d.txt"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+
+    // The resorting is deferred while the sort role values are resolved.
+    m_model->setResortingDeferred(true);
+    m_model->setResortProgressThreshold(50);
+    m_model->emitSortProgress(1);
+
+    QHash<QByteArray, QVariant> rating;
+    rating.insert("rating", 1);
+    m_model->setData(0, rating);
+    QVERIFY(!itemsMovedSpy.wait(500));
+    QCOMPARE(itemsInModel(), QStringList() << "a.txt" << "b.txt" << "c.txt" << "d.txt");
+
+    // Reaching the threshold applies the resorting.
+    m_model->emitSortProgress(2);
+    QCOMPARE(itemsMovedSpy.count(), 1);
+    QCOMPARE(itemsInModel(), QStringList() << "b.txt" << "c.txt" << "d.txt" << "a.txt");
+
+    // Not deferring the resortings anymore applies them too.
+    itemsMovedSpy.clear();
+    m_model->setResortProgressThreshold(100);
+    m_model->emitSortProgress(3);
+    m_model->setData(0, rating);
+    QVERIFY(!itemsMovedSpy.wait(500));
+
+    m_model->setResortingDeferred(false);
+    QCOMPARE(itemsMovedSpy.count(), 1);
+    QCOMPARE(itemsInModel(), QStringList() << "c.txt" << "d.txt" << "a.txt" << "b.txt");
+    QVERIFY(m_model->isConsistent());
+
+    m_model->setSortOrder(Qt::DescendingOrder);
+    QCOMPARE(movedInBackground, QList<bool>() << true << true << false);
+    QVERIFY(!m_model->isMovingItemsInBackground());
+}
+
 void KFileItemModelTest::testModelConsistencyWhenInsertingItems()
 {
     QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
@@ -717,6 +953,155 @@ void KFileItemModelTest::testExpandParentItems()
     QVERIFY(m_model->isConsistent());
 }
 
+void KFileItemModelTest::testRestoreManyExpandedItems()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+    QVERIFY(loadingCompletedSpy.isValid());
+
+    QSet<QByteArray> modelRoles = m_model->roles();
+    modelRoles << "isExpanded" << "isExpandable" << "expandedParentsCount";
+    m_model->setRoles(modelRoles);
+
+    // Create more sibling folders than are listed at the same time, each of them
+    // containing a sub-folder, so that several levels are restored in parallel.
+    QStringList files;
+    QSet<QUrl> allFolders;
+    for (int i = 0; i < 20; ++i) {
+        const QString folder = QStringLiteral("d%1").arg(i, 2, 10, QLatin1Char('0'));
+        files << folder + QStringLiteral("/sub/file");
+        allFolders << QUrl::fromLocalFile(m_testDir->path() + '/' + folder)
+                   << QUrl::fromLocalFile(m_testDir->path() + '/' + folder + QStringLiteral("/sub"));
+    }
+    m_testDir->createFiles(files);
+
+    m_model->loadDirectory(m_testDir->url());
+    m_model->restoreExpandedDirectories(allFolders);
+    while (m_model->count() < 60) {
+        QVERIFY(loadingCompletedSpy.wait());
+    }
+
+    // The loading is completed only once after all folders have been expanded
+    QCOMPARE(loadingCompletedSpy.count(), 1);
+    QCOMPARE(m_model->count(), 60);
+    QCOMPARE(m_model->expandedDirectories(), allFolders);
+    QVERIFY(m_model->directoriesToBeExpanded().isEmpty());
+    QVERIFY(m_model->isConsistent());
+
+    // The children are in tree order, independent of the order the listings have been completed
+    for (int i = 0; i < 20; ++i) {
+        QCOMPARE(m_model->expandedParentsCount(3 * i), 0);
+        QCOMPARE(m_model->expandedParentsCount(3 * i + 1), 1);
+        QCOMPARE(m_model->expandedParentsCount(3 * i + 2), 2);
+        QCOMPARE(m_model->fileItem(3 * i + 2).text(), QStringLiteral("file"));
+    }
+}
+
+void KFileItemModelTest::testRecursiveListing()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+    QVERIFY(loadingCompletedSpy.isValid());
+
+    QSet<QByteArray> modelRoles = m_model->roles();
+    modelRoles << "isExpanded" << "isExpandable" << "expandedParentsCount";
+    m_model->setRoles(modelRoles);
+
+    m_testDir->createFiles({"a/1", "a/b/2", "a/b/c/3", "d"});
+
+    m_model->setRecursiveListing(true);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+
+    // All items are shown as one flat list: "a/", "d", "a/1", "a/b/", "a/b/2", "a/b/c/", "a/b/c/3"
+    QCOMPARE(m_model->count(), 7);
+    QVERIFY(m_model->isConsistent());
+    for (int i = 0; i < m_model->count(); ++i) {
+        QCOMPARE(m_model->expandedParentsCount(i), 0);
+        QVERIFY(!m_model->isExpandable(i));
+    }
+    QVERIFY(m_model->index(QUrl::fromLocalFile(m_testDir->path() + "/a/b/c/3")) >= 0);
+
+    // Only the items of the first level of sub-folders are shown
+    m_model->setRecursiveListingDepth(1);
+    m_model->setRecursiveListing(false);
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(m_model->count(), 2);
+
+    m_model->setRecursiveListing(true);
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(m_model->count(), 4); // "a/", "d", "a/1", "a/b/"
+    QVERIFY(m_model->index(QUrl::fromLocalFile(m_testDir->path() + "/a/b/2")) < 0);
+    QVERIFY(m_model->isConsistent());
+
+    // The items of a renamed sub-folder are listed again with their new URLs
+    KIO::SimpleJob* job = KIO::rename(QUrl::fromLocalFile(m_testDir->path() + "/a"),
+                                      QUrl::fromLocalFile(m_testDir->path() + "/e"), KIO::HideProgressInfo);
+    QVERIFY(job->exec());
+    QTRY_VERIFY(m_model->index(QUrl::fromLocalFile(m_testDir->path() + "/e/1")) >= 0);
+    QVERIFY(m_model->index(QUrl::fromLocalFile(m_testDir->path() + "/a/1")) < 0);
+    QTRY_COMPARE(m_model->count(), 4); // "d", "e/", "e/1", "e/b/"
+    QVERIFY(m_model->isConsistent());
+}
+
+/**
+ * Verify that the items are sorted by the rules of the new default locale
+ * after it has been changed.
+ */
+void KFileItemModelTest::testLocaleChange()
+{
+    const QLocale previousLocale;
+    QLocale::setDefault(QLocale(QLocale::German, QLocale::Germany));
+
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    m_testDir->createFiles({QStringLiteral("a"), QStringLiteral("z"), QStringLiteral("ä")});
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "ä" << "z");
+
+    // In Swedish, "ä" is a letter of its own after "z"
+    QLocale::setDefault(QLocale(QLocale::Swedish, QLocale::Sweden));
+    m_model->setSortOrder(Qt::DescendingOrder);
+    m_model->setSortOrder(Qt::AscendingOrder);
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "z" << "ä");
+    QVERIFY(m_model->isConsistent());
+
+    QLocale::setDefault(previousLocale);
+}
+
+void KFileItemModelTest::testSortingMemoryLimit()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QVERIFY(itemsInsertedSpy.isValid());
+
+    QStringList files;
+    for (int i = 0; i < 200; ++i) {
+        files << QStringLiteral("file%1").arg(i);
+    }
+    m_testDir->createFiles(files);
+
+    // The limit is exceeded by the first item, so neither collation
+    // keys nor sort buffers may be used
+    m_model->setSortingMemoryLimit(1);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QTRY_COMPARE(m_model->count(), 200);
+    QVERIFY(m_model->isConsistent());
+    const QStringList limitedOrder = itemsInModel();
+
+    // The order must not depend on the limit
+    m_model->setSortingMemoryLimit(0);
+    m_model->setSortOrder(Qt::DescendingOrder);
+    m_model->setSortOrder(Qt::AscendingOrder);
+    QVERIFY(m_model->isConsistent());
+    QCOMPARE(itemsInModel(), limitedOrder);
+
+    m_model->setSortingMemoryLimit(1);
+    m_model->setSortOrder(Qt::DescendingOrder);
+    QVERIFY(m_model->isConsistent());
+    QStringList reversedOrder = limitedOrder;
+    std::reverse(reversedOrder.begin(), reversedOrder.end());
+    QCOMPARE(itemsInModel(), reversedOrder);
+}
+
 /**
  * Renaming an expanded folder by prepending its name with a dot makes it
  * hidden. Verify that this does not cause an inconsistent model state and
@@ -945,6 +1330,46 @@ void KFileItemModelTest::testSorting()
     // TODO: Sort by other roles; show/hide hidden files
 }
 
+void KFileItemModelTest::testSortingByIntegerRoles()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+
+    // Items of a single folder are sorted by a radix sort if the sort role
+    // has an integer value. Items with equal values must be sorted by name.
+    const QDateTime now = QDateTime::currentDateTime();
+
+    m_testDir->createFile("a", "12", now.addDays(-1));
+    m_testDir->createFile("b", "12", now.addDays(-1));
+    m_testDir->createFile("c", "1", now);
+    m_testDir->createFile("dd", "123", now.addDays(-2));
+    m_testDir->createDir("e", now.addDays(-3));
+    m_testDir->createDir("f", now);
+
+    m_model->setSortRole("modificationtime");
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+
+    QVERIFY(m_model->sortDirectoriesFirst());
+    QCOMPARE(m_model->sortOrder(), Qt::AscendingOrder);
+    QCOMPARE(itemsInModel(), QStringList() << "e" << "f" << "dd" << "a" << "b" << "c");
+
+    m_model->setSortOrder(Qt::DescendingOrder);
+    QCOMPARE(itemsInModel(), QStringList() << "f" << "e" << "c" << "b" << "a" << "dd");
+
+    m_model->setSortDirectoriesFirst(false);
+    QCOMPARE(itemsInModel(), QStringList() << "f" << "c" << "b" << "a" << "dd" << "e");
+
+    // The order of the folders depends on the settings if sorting by size,
+    // so only the files are checked.
+    m_model->setSortDirectoriesFirst(true);
+    m_model->setSortRole("size");
+    m_model->setSortOrder(Qt::AscendingOrder);
+    QCOMPARE(itemsInModel().mid(2), QStringList() << "c" << "a" << "b" << "dd");
+
+    m_model->setSortOrder(Qt::DescendingOrder);
+    QCOMPARE(itemsInModel().mid(2), QStringList() << "dd" << "b" << "a" << "c");
+}
+
 void KFileItemModelTest::testIndexForKeyboardSearch()
 {
     QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
@@ -1019,6 +1444,16 @@ void KFileItemModelTest::testNameFilter()
     m_model->setNameFilter("bC"); // Shows "Abc" and "Bcd"
     QCOMPARE(m_model->count(), 2);
 
+    // Typing a name narrows the filter, so only the shown items are checked
+    m_model->setNameFilter("b"); // Shows "Abc" and "Bcd"
+    QCOMPARE(m_model->count(), 2);
+    m_model->setNameFilter("bcD"); // Shows only "Bcd"
+    QCOMPARE(m_model->count(), 1);
+    QCOMPARE(m_model->fileItem(0).text(), QStringLiteral("Bcd"));
+
+    m_model->setNameFilter("c"); // Shows "Abc", "Bcd" and "Cde"
+    QCOMPARE(m_model->count(), 3);
+
     m_model->setNameFilter(QString()); // Shows again all items
     QCOMPARE(m_model->count(), 5);
 }
@@ -1045,7 +1480,7 @@ void KFileItemModelTest::testEmptyPath()
     KFileItemList items;
     items << KFileItem(emptyUrl, QString(), KFileItem::Unknown) << KFileItem(url, QString(), KFileItem::Unknown);
     m_model->slotItemsAdded(emptyUrl, items);
-    m_model->slotCompleted();
+    m_model->slotCompleted(QUrl());
 }
 
 /**
@@ -1132,48 +1567,231 @@ void KFileItemModelTest::testRemoveHiddenItems()
 }
 
 /**
- * Verify that filtered items are removed when their parent is collapsed.
+ * Verify that the hidden items keep their role values while they are not shown.
  */
-void KFileItemModelTest::collapseParentOfHiddenItems()
+void KFileItemModelTest::testHiddenItemsKeepValues()
 {
-    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
-    QSignalSpy itemsRemovedSpy(m_model, &KFileItemModel::itemsRemoved);
-
-    QSet<QByteArray> modelRoles = m_model->roles();
-    modelRoles << "isExpanded" << "isExpandable" << "expandedParentsCount";
-    m_model->setRoles(modelRoles);
+    m_testDir->createFiles({".a", ".c", "b", "d"});
 
-    m_testDir->createFiles({"a/1", "a/b/1", "a/b/c/1", "a/b/c/d/1"});
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
 
+    m_model->setShowHiddenFiles(true);
     m_model->loadDirectory(m_testDir->url());
     QVERIFY(itemsInsertedSpy.wait());
-    QCOMPARE(m_model->count(), 1); // Only "a/"
+    QCOMPARE(itemsInModel(), QStringList() << ".a" << ".c" << "b" << "d");
 
-    // Expand "a/".
-    m_model->setExpanded(0, true);
-    QVERIFY(itemsInsertedSpy.wait());
-    QCOMPARE(m_model->count(), 3); // 3 items: "a/", "a/b/", "a/1"
+    QHash<QByteArray, QVariant> rating;
+    rating.insert("rating", 4);
+    m_model->setData(1, rating);
 
-    // Expand "a/b/".
-    m_model->setExpanded(1, true);
-    QVERIFY(itemsInsertedSpy.wait());
-    QCOMPARE(m_model->count(), 5); // 5 items: "a/", "a/b/", "a/b/c", "a/b/1", "a/1"
+    m_model->setShowHiddenFiles(false);
+    QCOMPARE(itemsInModel(), QStringList() << "b" << "d");
+    QVERIFY(m_model->isConsistent());
 
-    // Expand "a/b/c/".
-    m_model->setExpanded(2, true);
-    QVERIFY(itemsInsertedSpy.wait());
-    QCOMPARE(m_model->count(), 7); // 7 items: "a/", "a/b/", "a/b/c", "a/b/c/d/", "a/b/c/1", "a/b/1", "a/1"
+    itemsInsertedSpy.clear();
+    m_model->setShowHiddenFiles(true);
+    QCOMPARE(itemsInModel(), QStringList() << ".a" << ".c" << "b" << "d");
+    QCOMPARE(itemsInsertedSpy.count(), 1);
+    QCOMPARE(itemsInsertedSpy.first().at(0).value<KItemRangeList>(), KItemRangeList() << KItemRange(0, 2));
+    QCOMPARE(m_model->data(1).value("rating").toInt(), 4);
+    QVERIFY(m_model->isConsistent());
 
-    // Set a name filter that matches nothing -> only the expanded folders remain.
-    m_model->setNameFilter("xyz");
-    QCOMPARE(itemsRemovedSpy.count(), 1);
-    QCOMPARE(m_model->count(), 3);
-    QCOMPARE(itemsInModel(), QStringList() << "a" << "b" << "c");
+    // The kept items can be released, showing them again lists them as new items
+    m_model->setShowHiddenFiles(false);
+    QVERIFY(m_model->releasableMemory() > 0);
+    QVERIFY(m_model->releaseMemory(m_model->releasableMemory()) > 0);
+    QCOMPARE(m_model->releasableMemory(), qint64(0));
 
-    // Collapse the folder "a/".
-    m_model->setExpanded(0, false);
-    QCOMPARE(itemsRemovedSpy.count(), 2);
-    QCOMPARE(m_model->count(), 1);
+    itemsInsertedSpy.clear();
+    m_model->setShowHiddenFiles(true);
+    QCOMPARE(itemsInModel(), QStringList() << ".a" << ".c" << "b" << "d");
+    QCOMPARE(itemsInsertedSpy.count(), 1);
+    QVERIFY(!m_model->data(1).contains("rating"));
+    QVERIFY(m_model->isConsistent());
+}
+
+/**
+ * Verify that the directories and the files are merged and separated
+ * again, and that showing only directories is applied when the directory
+ * is loaded again.
+ */
+void KFileItemModelTest::testDirectoriesFirstAndOnly()
+{
+    m_testDir->createFiles({"a", "c"});
+    m_testDir->createDir("b");
+    m_testDir->createDir("d");
+
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QSignalSpy itemsRemovedSpy(m_model, &KFileItemModel::itemsRemoved);
+    QSignalSpy itemsMovedSpy(m_model, &KFileItemModel::itemsMoved);
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QVERIFY(m_model->sortDirectoriesFirst());
+    QCOMPARE(itemsInModel(), QStringList() << "b" << "d" << "a" << "c");
+
+    m_model->setSortDirectoriesFirst(false);
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "b" << "c" << "d");
+    QCOMPARE(itemsMovedSpy.count(), 1);
+    QCOMPARE(itemsMovedSpy.first().at(0).value<KItemRange>(), KItemRange(0, 4));
+    QCOMPARE(itemsMovedSpy.takeFirst().at(1).value<QList<int> >(), QList<int>() << 1 << 3 << 0 << 2);
+
+    m_model->setSortDirectoriesFirst(true);
+    QCOMPARE(itemsInModel(), QStringList() << "b" << "d" << "a" << "c");
+    QCOMPARE(itemsMovedSpy.count(), 1);
+    QVERIFY(m_model->isConsistent());
+
+    QHash<QByteArray, QVariant> rating;
+    rating.insert("rating", 2);
+    m_model->setData(2, rating);
+
+    m_model->setShowDirectoriesOnly(true);
+    QCOMPARE(itemsInModel(), QStringList() << "b" << "d" << "a" << "c");
+    QCOMPARE(itemsRemovedSpy.count(), 0);
+    QCOMPARE(m_model->data(2).value("rating").toInt(), 2);
+
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "b" << "d");
+    QVERIFY(m_model->isConsistent());
+}
+
+/**
+ * Verify that the item identifiers stay valid if the items are moved or filtered.
+ */
+void KFileItemModelTest::testItemIds()
+{
+    m_testDir->createFiles({"a", "b", "c"});
+
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "b" << "c");
+
+    const quint32 idA = m_model->itemId(0);
+    const quint32 idC = m_model->itemId(2);
+    QVERIFY(idA != 0);
+    QVERIFY(idA != idC);
+    QCOMPARE(m_model->itemId(3), quint32(0));
+    QCOMPARE(m_model->indexForItemId(0), -1);
+
+    m_model->setSortOrder(Qt::DescendingOrder);
+    QCOMPARE(itemsInModel(), QStringList() << "c" << "b" << "a");
+    QCOMPARE(m_model->itemId(0), idC);
+    QCOMPARE(m_model->indexForItemId(idA), 2);
+    QCOMPARE(m_model->indexForItemId(idC), 0);
+
+    m_model->setNameFilter("c");
+    QCOMPARE(itemsInModel(), QStringList() << "c");
+    QCOMPARE(m_model->indexForItemId(idA), -1);
+    QCOMPARE(m_model->indexForItemId(idC), 0);
+
+    m_model->setNameFilter(QString());
+    QCOMPARE(m_model->indexForItemId(idA), 2);
+    QVERIFY(m_model->isConsistent());
+}
+
+/**
+ * Verify that refreshing the directory only applies the changes of the directory
+ * and keeps the role values of the unchanged items.
+ */
+void KFileItemModelTest::testRefreshDirectory()
+{
+    m_testDir->createFiles({"a", "b", "c"});
+
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+    QSignalSpy itemsRemovedSpy(m_model, &KFileItemModel::itemsRemoved);
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "b" << "c");
+
+    QHash<QByteArray, QVariant> rating;
+    rating.insert("rating", 2);
+    m_model->setData(1, rating);
+    const quint32 idB = m_model->itemId(1);
+
+    m_testDir->removeFile("c");
+    m_testDir->createFile("d");
+    itemsRemovedSpy.clear();
+    itemsInsertedSpy.clear();
+
+    m_model->refreshDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "b" << "d");
+    QCOMPARE(m_model->itemId(1), idB);
+    QCOMPARE(m_model->data(1).value("rating").toInt(), 2);
+
+    // Only the deleted item has been removed and only the new item has been inserted
+    QCOMPARE(itemsRemovedSpy.count(), 1);
+    QCOMPARE(itemsRemovedSpy.first().at(0).value<KItemRangeList>(), KItemRangeList() << KItemRange(2, 1));
+    QCOMPARE(itemsInsertedSpy.count(), 1);
+    QCOMPARE(itemsInsertedSpy.first().at(0).value<KItemRangeList>(), KItemRangeList() << KItemRange(3, 1));
+    QVERIFY(m_model->isConsistent());
+}
+
+void KFileItemModelTest::testRefreshRemovedDirectory()
+{
+    m_testDir->createFiles({"sub/a", "sub/b"});
+    const QUrl url = QUrl::fromLocalFile(m_testDir->path() + QLatin1String("/sub"));
+
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+    m_model->loadDirectory(url);
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "b");
+
+    // The kept items are removed if the reloading fails
+    QVERIFY(QDir(url.toLocalFile()).removeRecursively());
+    m_model->refreshDirectory(url);
+    QTRY_COMPARE(m_model->count(), 0);
+    QVERIFY(m_model->isConsistent());
+}
+
+/**
+ * Verify that filtered items are removed when their parent is collapsed.
+ */
+void KFileItemModelTest::collapseParentOfHiddenItems()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QSignalSpy itemsRemovedSpy(m_model, &KFileItemModel::itemsRemoved);
+
+    QSet<QByteArray> modelRoles = m_model->roles();
+    modelRoles << "isExpanded" << "isExpandable" << "expandedParentsCount";
+    m_model->setRoles(modelRoles);
+
+    m_testDir->createFiles({"a/1", "a/b/1", "a/b/c/1", "a/b/c/d/1"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(m_model->count(), 1); // Only "a/"
+
+    // Expand "a/".
+    m_model->setExpanded(0, true);
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(m_model->count(), 3); // 3 items: "a/", "a/b/", "a/1"
+
+    // Expand "a/b/".
+    m_model->setExpanded(1, true);
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(m_model->count(), 5); // 5 items: "a/", "a/b/", "a/b/c", "a/b/1", "a/1"
+
+    // Expand "a/b/c/".
+    m_model->setExpanded(2, true);
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(m_model->count(), 7); // 7 items: "a/", "a/b/", "a/b/c", "a/b/c/d/", "a/b/c/1", "a/b/1", "a/1"
+
+    // Set a name filter that matches nothing -> only the expanded folders remain.
+    m_model->setNameFilter("xyz");
+    QCOMPARE(itemsRemovedSpy.count(), 1);
+    QCOMPARE(m_model->count(), 3);
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "b" << "c");
+
+    // Collapse the folder "a/".
+    m_model->setExpanded(0, false);
+    QCOMPARE(itemsRemovedSpy.count(), 2);
+    QCOMPARE(m_model->count(), 1);
     QCOMPARE(itemsInModel(), QStringList() << "a");
 
     // Remove the filter -> no files should appear (and we should not get a crash).
@@ -1276,23 +1894,23 @@ void KFileItemModelTest::testGeneralParentChildRelationships()
     const QUrl realChild2 = m_model->fileItem(4).url();
 
     m_model->slotItemsAdded(parent1, KFileItemList() << KFileItem(QUrl("child1"), QString(), KFileItem::Unknown));
-    m_model->slotCompleted();
+    m_model->slotCompleted(QUrl());
     QCOMPARE(itemsInModel(), QStringList() << "parent1" << "realChild1" << "realGrandChild1" << "child1" << "parent2" << "realChild2" << "realGrandChild2");
 
     m_model->slotItemsAdded(parent2, KFileItemList() << KFileItem(QUrl("child2"), QString(), KFileItem::Unknown));
-    m_model->slotCompleted();
+    m_model->slotCompleted(QUrl());
     QCOMPARE(itemsInModel(), QStringList() << "parent1" << "realChild1" << "realGrandChild1" << "child1" << "parent2" << "realChild2" << "realGrandChild2" << "child2");
 
     m_model->slotItemsAdded(realChild1, KFileItemList() << KFileItem(QUrl("grandChild1"), QString(), KFileItem::Unknown));
-    m_model->slotCompleted();
+    m_model->slotCompleted(QUrl());
     QCOMPARE(itemsInModel(), QStringList() << "parent1" << "realChild1" << "grandChild1" << "realGrandChild1" << "child1" << "parent2" << "realChild2" << "realGrandChild2" << "child2");
 
     m_model->slotItemsAdded(realChild1, KFileItemList() << KFileItem(QUrl("grandChild1"), QString(), KFileItem::Unknown));
-    m_model->slotCompleted();
+    m_model->slotCompleted(QUrl());
     QCOMPARE(itemsInModel(), QStringList() << "parent1" << "realChild1" << "grandChild1" << "realGrandChild1" << "child1" << "parent2" << "realChild2" << "realGrandChild2" << "child2");
 
     m_model->slotItemsAdded(realChild2, KFileItemList() << KFileItem(QUrl("grandChild2"), QString(), KFileItem::Unknown));
-    m_model->slotCompleted();
+    m_model->slotCompleted(QUrl());
     QCOMPARE(itemsInModel(), QStringList() << "parent1" << "realChild1" << "grandChild1" << "realGrandChild1" << "child1" << "parent2" << "realChild2" << "grandChild2" << "realGrandChild2" << "child2");
 
     // Set a name filter that matches nothing -> only expanded folders remain.
@@ -1392,6 +2010,52 @@ void KFileItemModelTest::testNameRoleGroups()
     QCOMPARE(m_model->groups(), expectedGroups);
 }
 
+void KFileItemModelTest::testGroupsAfterInsertingAndRemovingItems()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QSignalSpy itemsRemovedSpy(m_model, &KFileItemModel::itemsRemoved);
+
+    m_testDir->createFiles({"b1.txt", "b2.txt", "d1.txt", "f1.txt"});
+
+    m_model->setGroupedSorting(true);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+
+    QList<QPair<int, QVariant> > expectedGroups;
+    expectedGroups << QPair<int, QVariant>(0, QLatin1String("B"));
+    expectedGroups << QPair<int, QVariant>(2, QLatin1String("D"));
+    expectedGroups << QPair<int, QVariant>(3, QLatin1String("F"));
+    QCOMPARE(m_model->groups(), expectedGroups);
+
+    // The groups are updated for the inserted items.
+    m_testDir->createFiles({"a1.txt", "c1.txt", "d2.txt"});
+    m_model->m_dirLister->updateDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a1.txt" << "b1.txt" << "b2.txt" << "c1.txt" << "d1.txt" << "d2.txt" << "f1.txt");
+
+    expectedGroups.clear();
+    expectedGroups << QPair<int, QVariant>(0, QLatin1String("A"));
+    expectedGroups << QPair<int, QVariant>(1, QLatin1String("B"));
+    expectedGroups << QPair<int, QVariant>(3, QLatin1String("C"));
+    expectedGroups << QPair<int, QVariant>(4, QLatin1String("D"));
+    expectedGroups << QPair<int, QVariant>(6, QLatin1String("F"));
+    QCOMPARE(m_model->groups(), expectedGroups);
+
+    // The groups are updated for the removed items.
+    m_testDir->removeFiles({"b1.txt", "b2.txt", "c1.txt", "d1.txt"});
+    m_model->m_dirLister->updateDirectory(m_testDir->url());
+    QVERIFY(itemsRemovedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a1.txt" << "d2.txt" << "f1.txt");
+
+    expectedGroups.clear();
+    expectedGroups << QPair<int, QVariant>(0, QLatin1String("A"));
+    expectedGroups << QPair<int, QVariant>(1, QLatin1String("D"));
+    expectedGroups << QPair<int, QVariant>(2, QLatin1String("F"));
+    QCOMPARE(m_model->groups(), expectedGroups);
+
+    QVERIFY(m_model->isConsistent());
+}
+
 void KFileItemModelTest::testNameRoleGroupsWithExpandedItems()
 {
     QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
@@ -1470,7 +2134,7 @@ void KFileItemModelTest::testInconsistentModel()
     KFileItemList items;
     items << newItem << m_model->fileItem(2) << m_model->fileItem(3);
     m_model->slotItemsAdded(m_model->directory(), items);
-    m_model->slotCompleted();
+    m_model->slotCompleted(QUrl());
     QCOMPARE(itemsInModel(), QStringList() << "a" << "b" << "c1.txt" << "c2.txt" << "a2" << "c1.txt" << "c2.txt");
 
     m_model->setExpanded(0, false);
@@ -1568,7 +2232,7 @@ void KFileItemModelTest::testChangeSortRoleWhileFiltering()
     }
 
     m_model->slotItemsAdded(m_testDir->url(), items);
-    m_model->slotCompleted();
+    m_model->slotCompleted(QUrl());
 
     QCOMPARE(itemsInModel(), QStringList() << "a.txt" << "b.txt" << "c.txt");
 
@@ -1584,6 +2248,37 @@ void KFileItemModelTest::testChangeSortRoleWhileFiltering()
     QCOMPARE(itemsInModel(), QStringList() << "c.txt" << "a.txt" << "b.txt");
 }
 
+void KFileItemModelTest::testSortByDeletionTime()
+{
+    const QUrl trashUrl(QStringLiteral("trash:/"));
+    KFileItemList items;
+
+    KIO::UDSEntry entry[3];
+
+    entry[0].fastInsert(KIO::UDSEntry::UDS_NAME, "a.txt");
+    entry[0].fastInsert(KIO::UDSEntry::UDS_EXTRA + 1, "2021-03-01T10:00:00");
+
+    entry[1].fastInsert(KIO::UDSEntry::UDS_NAME, "b.txt");
+    entry[1].fastInsert(KIO::UDSEntry::UDS_EXTRA + 1, "2020-01-01T10:00:00");
+
+    // An item without a valid deletion time is ordered before the others
+    entry[2].fastInsert(KIO::UDSEntry::UDS_NAME, "c.txt");
+
+    for (int i = 0; i < 3; ++i) {
+        entry[i].fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, 0100000);    // S_IFREG might not be defined on non-Unix platforms.
+        items.append(KFileItem(entry[i], trashUrl, false, true));
+    }
+
+    m_model->setSortRole("deletiontime");
+    m_model->slotItemsAdded(trashUrl, items);
+    m_model->slotCompleted(QUrl());
+
+    QCOMPARE(itemsInModel(), QStringList() << "c.txt" << "b.txt" << "a.txt");
+
+    m_model->setSortOrder(Qt::DescendingOrder);
+    QCOMPARE(itemsInModel(), QStringList() << "a.txt" << "b.txt" << "c.txt");
+}
+
 void KFileItemModelTest::testRefreshFilteredItems()
 {
     QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
@@ -1637,6 +2332,10 @@ void KFileItemModelTest::testCreateMimeData()
     KItemSet selection;
     selection.insert(1);
     QMimeData* mimeData = m_model->createMimeData(selection);
+
+    // The URLs are created when they are requested
+    QVERIFY(mimeData->hasUrls());
+    QCOMPARE(mimeData->urls(), QList<QUrl>() << m_model->fileItem(1).url());
     delete mimeData;
 }
 
@@ -1689,7 +2388,7 @@ void KFileItemModelTest::testCollapseFolderWhileLoading()
     // https://bugs.kde.org/show_bug.cgi?id=332102. Even if the crash is not
     // reproducible here, Valgrind will complain, and the item "c2.txt" will appear
     // without parent in the model.
-    m_model->slotCompleted();
+    m_model->slotCompleted(QUrl());
     QCOMPARE(itemsInModel(), QStringList() << "a2");
 
     // Expand "a2/" again.
@@ -1718,6 +2417,22 @@ void KFileItemModelTest::testCollapseFolderWhileLoading()
     QVERIFY(!m_model->isExpanded(1));
 }
 
+void KFileItemModelTest::testIndexesMatching()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+
+    m_testDir->createFiles({"a.txt", "b.txt", "c.png", "d.txt", "e.png"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a.txt" << "b.txt" << "c.png" << "d.txt" << "e.png");
+
+    const KItemSet matches = m_model->indexesMatching(QRegularExpression(QStringLiteral("\\.txt$")));
+    QCOMPARE(matches, KItemSet(KItemRangeList() << KItemRange(0, 2) << KItemRange(3, 1)));
+
+    QVERIFY(m_model->indexesMatching(QRegularExpression(QStringLiteral("^x"))).isEmpty());
+}
+
 void KFileItemModelTest::testDeleteFileMoreThanOnce()
 {
     QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
@@ -1739,6 +2454,348 @@ void KFileItemModelTest::testDeleteFileMoreThanOnce()
     QCOMPARE(itemsInModel(), QStringList() << "a.txt" << "c.txt" << "d.txt");
 }
 
+void KFileItemModelTest::testLocalListing()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+    QSignalSpy itemsRemovedSpy(m_model, &KFileItemModel::itemsRemoved);
+
+    QSet<QByteArray> modelRoles = m_model->roles();
+    modelRoles << "isExpanded" << "isExpandable" << "expandedParentsCount";
+    m_model->setRoles(modelRoles);
+
+    m_testDir->createFiles({"a.txt", "c.txt", ".hidden", "d/1"});
+
+    m_model->m_dirLister->setLocalListingEnabled(true);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(m_model->m_dirLister->isListingLocally());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "a.txt" << "c.txt");
+    QCOMPARE(m_model->rootItem().url(), m_testDir->url());
+    QVERIFY(m_model->rootItem().isDir());
+    QVERIFY(m_model->isConsistent());
+
+    // Hidden files
+    m_model->setShowHiddenFiles(true);
+    QCOMPARE(itemsInModel(), QStringList() << "d" << ".hidden" << "a.txt" << "c.txt");
+    m_model->setShowHiddenFiles(false);
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "a.txt" << "c.txt");
+    itemsRemovedSpy.clear();
+
+    // Changes of the directory
+    m_testDir->removeFile("a.txt");
+    m_testDir->createFile("b.txt");
+    m_model->m_dirLister->updateDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsRemovedSpy.count(), 1);
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "b.txt" << "c.txt");
+
+    // Expanding a folder
+    m_model->setExpanded(0, true);
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "1" << "b.txt" << "c.txt");
+    QVERIFY(m_model->isConsistent());
+
+    m_model->setExpanded(0, false);
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "b.txt" << "c.txt");
+
+    // Disabling the local listing
+    m_model->m_dirLister->setLocalListingEnabled(false);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(!m_model->m_dirLister->isListingLocally());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "b.txt" << "c.txt");
+    QVERIFY(!m_model->m_dirLister->directories().isEmpty());
+
+    // KDirLister does not report changes of the directory that has been
+    // listed by KIO while a local directory is shown
+    m_model->m_dirLister->setLocalListingEnabled(true);
+    m_model->loadDirectory(QUrl::fromLocalFile(m_testDir->path() + "/d"));
+    QVERIFY(m_model->m_dirLister->isListingLocally());
+    QVERIFY(loadingCompletedSpy.wait());
+    QVERIFY(m_model->m_dirLister->directories().isEmpty());
+    QCOMPARE(itemsInModel(), QStringList() << "1");
+}
+
+void KFileItemModelTest::testSnapshots()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+
+    m_testDir->createFiles({"a.txt", "b.txt", "d/1"});
+    const QUrl subDirUrl = QUrl::fromLocalFile(m_testDir->path() + "/d");
+
+    m_model->setSnapshotsEnabled(true);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "a.txt" << "b.txt");
+
+    m_model->loadDirectory(subDirUrl);
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "1");
+
+    // The items of the unchanged directory are shown before it is listed
+    m_model->loadDirectory(m_testDir->url());
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "a.txt" << "b.txt");
+    QVERIFY(m_model->isConsistent());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "a.txt" << "b.txt");
+    QVERIFY(m_model->isConsistent());
+
+    // The snapshot of a changed directory is not used
+    m_model->loadDirectory(subDirUrl);
+    QVERIFY(loadingCompletedSpy.wait());
+    m_testDir->createFile("c.txt");
+    m_model->loadDirectory(m_testDir->url());
+    QCOMPARE(m_model->count(), 0);
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "a.txt" << "b.txt" << "c.txt");
+
+    // No snapshots are taken if they are disabled
+    m_model->setSnapshotsEnabled(false);
+    m_model->loadDirectory(subDirUrl);
+    QVERIFY(loadingCompletedSpy.wait());
+    m_model->loadDirectory(m_testDir->url());
+    QCOMPARE(m_model->count(), 0);
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "a.txt" << "b.txt" << "c.txt");
+}
+
+void KFileItemModelTest::testRetainedSnapshots()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+
+    m_testDir->createFiles({"a.txt", "b.txt"});
+    m_model->setSnapshotsEnabled(true);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+
+    // The snapshot is kept if the model is deleted, e.g. when closing a tab
+    m_model->retainSnapshot();
+    delete m_model;
+    m_model = nullptr;
+
+    const auto retainedUsage = []() {
+        const QVector<KMemoryBudget::Usage> usage = KMemoryBudget::instance().usage();
+        for (const KMemoryBudget::Usage& consumerUsage : usage) {
+            if (consumerUsage.name == QLatin1String("KFileItemModel retained snapshots")) {
+                return consumerUsage.bytes;
+            }
+        }
+        return qint64(-1);
+    };
+    QVERIFY(retainedUsage() > 0);
+
+    KFileItemList items;
+    QVERIFY(KFileItemModel::cachedListing(m_testDir->url(), false, items));
+    QCOMPARE(items.count(), 2);
+
+    // The retained snapshots are released if the budget is exceeded
+    KMemoryBudget& budget = KMemoryBudget::instance();
+    budget.setBudget(1);
+    budget.enforceBudget();
+    budget.setBudget(0);
+    QCOMPARE(retainedUsage(), qint64(0));
+    QVERIFY(!KFileItemModel::cachedListing(m_testDir->url(), false, items));
+}
+
+void KFileItemModelTest::testNarrowedSearch()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+
+    m_testDir->createFiles({"a.txt", "b.txt", "c.png"});
+    const QUrl otherUrl = QUrl::fromLocalFile(m_testDir->path() + "/d");
+    m_testDir->createDir("d");
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "a.txt" << "b.txt" << "c.png");
+
+    m_model->cacheSearchResults();
+    QCOMPARE(m_model->cachedSearchResultsUrl(), m_testDir->url());
+
+    QStringList visitedItems;
+    m_model->forEachCachedSearchResult([&visitedItems](const KFileItem& item, const QHash<QByteArray, QVariant>&) {
+        visitedItems.append(item.name());
+    });
+    QCOMPARE(visitedItems, QStringList() << "d" << "a.txt" << "b.txt" << "c.png");
+
+    const auto isTextFile = [](const KFileItem& item, const QHash<QByteArray, QVariant>&) {
+        return item.name().endsWith(QLatin1String(".txt"));
+    };
+
+    // The matching cached results are shown before the narrowed search is listed
+    m_model->prepareNarrowedSearch(m_testDir->url(), isTextFile);
+    m_model->loadDirectory(m_testDir->url());
+    QCOMPARE(itemsInModel(), QStringList() << "a.txt" << "b.txt");
+    QVERIFY(m_model->isConsistent());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "a.txt" << "b.txt" << "c.png");
+    QVERIFY(m_model->isConsistent());
+
+    // The prepared results are only used for the prepared URL
+    m_model->prepareNarrowedSearch(m_testDir->url(), isTextFile);
+    m_model->loadDirectory(otherUrl);
+    QCOMPARE(m_model->count(), 0);
+    QVERIFY(loadingCompletedSpy.wait());
+
+    // The cached results are not used if the filters have been changed
+    m_model->setNameFilter(QStringLiteral("a"));
+    m_model->prepareNarrowedSearch(m_testDir->url(), isTextFile);
+    m_model->loadDirectory(m_testDir->url());
+    QCOMPARE(m_model->count(), 0);
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a.txt");
+}
+
+void KFileItemModelTest::testSharedStringValues()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+
+    QSet<QByteArray> modelRoles = m_model->roles();
+    modelRoles << "owner" << "group";
+    m_model->setRoles(modelRoles);
+
+    m_testDir->createFiles({"a.txt", "b.txt"});
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(m_model->count(), 2);
+
+    // The equal owners and groups of the items share their data
+    const QString owner0 = m_model->data(0).value("owner").toString();
+    const QString owner1 = m_model->data(1).value("owner").toString();
+    QVERIFY(!owner0.isEmpty());
+    QCOMPARE(owner0, owner1);
+    QCOMPARE(owner0.constData(), owner1.constData());
+
+    const QString group0 = m_model->data(0).value("group").toString();
+    const QString group1 = m_model->data(1).value("group").toString();
+    QCOMPARE(group0, group1);
+    QCOMPARE(group0.constData(), group1.constData());
+
+    // Values set by the roles updater are shared, too
+    m_model->setData(0, {{"iconName", QStringLiteral("text-plain")}});
+    m_model->setData(1, {{"iconName", QStringLiteral("text-plain")}});
+    QCOMPARE(m_model->data(0).value("iconName").toString().constData(),
+             m_model->data(1).value("iconName").toString().constData());
+}
+
+void KFileItemModelTest::testSharedItems()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+
+    m_testDir->createFiles({"a.txt", "b.txt", "c.txt"});
+    m_model->setSnapshotsEnabled(true);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a.txt" << "b.txt" << "c.txt");
+
+    QHash<QByteArray, QVariant> values;
+    values.insert("rating", 4);
+    m_model->setData(1, values);
+
+    // A second model on the same directory shows the items and their
+    // role values before the directory is listed
+    KFileItemModel otherModel;
+    otherModel.m_dirLister->setAutoUpdate(false);
+    otherModel.setSortOrder(Qt::DescendingOrder);
+    otherModel.setSnapshotsEnabled(true);
+
+    QSignalSpy otherLoadingCompletedSpy(&otherModel, &KFileItemModel::directoryLoadingCompleted);
+    otherModel.loadDirectory(m_testDir->url());
+    QCOMPARE(otherModel.count(), 3);
+    QCOMPARE(otherModel.data(1).value("text").toString(), QStringLiteral("b.txt"));
+    QCOMPARE(otherModel.data(1).value("rating").toInt(), 4);
+    QVERIFY(otherModel.isConsistent());
+
+    // The sorting is kept per model
+    QCOMPARE(otherModel.data(0).value("text").toString(), QStringLiteral("c.txt"));
+
+    QVERIFY(otherLoadingCompletedSpy.wait());
+    QCOMPARE(otherModel.count(), 3);
+    QVERIFY(otherModel.isConsistent());
+
+    // Models with other settings don't share the items
+    KFileItemModel hiddenFilesModel;
+    hiddenFilesModel.m_dirLister->setAutoUpdate(false);
+    hiddenFilesModel.setSnapshotsEnabled(true);
+    hiddenFilesModel.setShowHiddenFiles(true);
+    hiddenFilesModel.loadDirectory(m_testDir->url());
+    QCOMPARE(hiddenFilesModel.count(), 0);
+}
+
+void KFileItemModelTest::testItemsSnapshot()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+    QSignalSpy itemsRemovedSpy(m_model, &KFileItemModel::itemsRemoved);
+
+    m_testDir->createFiles({"a.txt", "b.txt", "c.txt", "d.txt", "e.txt", "f.txt"});
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+
+    QCOMPARE(m_model->itemsSnapshot().count(), 6);
+
+    KFileItemModelSnapshotTracker tracker(m_model, 2);
+    const KFileItemModelSnapshot first = tracker.snapshot();
+    QCOMPARE(first.count(), 6);
+    QCOMPARE(first.fileItem(3).text(), QStringLiteral("d.txt"));
+    QVERIFY(first.fileItem(6).isNull());
+    QCOMPARE(first.int64(3, KFileItemModelRoleStore::SizeColumn), static_cast<qint64>(m_model->fileItem(3).size()));
+    QCOMPARE(first.int64(3, KFileItemModelRoleStore::DeletionTimeColumn), qint64(-1));
+    QCOMPARE(first.int64(6, KFileItemModelRoleStore::SizeColumn), qint64(-1));
+
+    // Only the chunk of the changed item is copied
+    QHash<QByteArray, QVariant> values;
+    values.insert("rating", 4);
+    m_model->setData(3, values);
+
+    const KFileItemModelSnapshot second = tracker.snapshot();
+    QVERIFY(second.sharesChunk(first, 0));
+    QVERIFY(!second.sharesChunk(first, 3));
+    QVERIFY(second.sharesChunk(first, 5));
+    QCOMPARE(second.data(3).value("rating").toInt(), 4);
+    QVERIFY(!first.data(3).contains("rating"));
+
+    // The chunks behind a removed item are copied
+    m_testDir->removeFile("e.txt");
+    QVERIFY(itemsRemovedSpy.wait());
+
+    const KFileItemModelSnapshot third = tracker.snapshot();
+    QCOMPARE(third.count(), 5);
+    QVERIFY(third.sharesChunk(second, 0));
+    QVERIFY(third.sharesChunk(second, 3));
+    QVERIFY(!third.sharesChunk(second, 4));
+    QCOMPARE(third.fileItem(4).text(), QStringLiteral("f.txt"));
+
+    // The previous snapshots are unchanged
+    QCOMPARE(second.count(), 6);
+    QCOMPARE(second.fileItem(4).text(), QStringLiteral("e.txt"));
+}
+
+void KFileItemModelTest::testItemsSnapshotReleased()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+
+    m_testDir->createFiles({"a.txt", "b.txt", "c.txt"});
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+
+    QHash<QByteArray, QVariant> values;
+    values.insert("rating", 4);
+    m_model->setData(1, values);
+
+    KFileItemModelSnapshotTracker tracker(m_model, 2);
+    {
+        const KFileItemModelSnapshot snapshot = tracker.snapshot();
+        QVERIFY(!m_model->m_itemData.at(1)->values.isDetached());
+    }
+
+    // The tracker does not keep the values of the destroyed snapshot
+    QVERIFY(m_model->m_itemData.at(1)->values.isDetached());
+
+    const KFileItemModelSnapshot snapshot = tracker.snapshot();
+    QCOMPARE(snapshot.count(), 3);
+    QCOMPARE(snapshot.data(1).value("rating").toInt(), 4);
+}
+
 QStringList KFileItemModelTest::itemsInModel() const
 {
     QStringList items;
@@ -1748,6 +2805,83 @@ QStringList KFileItemModelTest::itemsInModel() const
     return items;
 }
 
+void KFileItemModelTest::testSearchResults()
+{
+    const QUrl url = m_testDir->url();
+    const auto searchResult = [&url](const QString& name) {
+        QUrl itemUrl = url;
+        itemUrl.setPath(url.path() + QLatin1Char('/') + name);
+        return KFileItem(itemUrl, QString(), KFileItem::Unknown);
+    };
+
+    m_model->setSearchModeEnabled(true);
+    m_model->m_listing = true;
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+
+    // The first results are inserted immediately
+    KFileItemList items;
+    for (int i = 0; i < 150; ++i) {
+        items << searchResult(QStringLiteral("b%1").arg(i, 3, 10, QLatin1Char('0')));
+    }
+    m_model->slotItemsAdded(url, items);
+    QCOMPARE(itemsInsertedSpy.count(), 1);
+    QCOMPARE(m_model->count(), 150);
+    QVERIFY(m_model->isConsistent());
+
+    // Results that rank higher than the last ranked item are sorted into the
+    // ranked items, results that rank lower into the items behind them.
+    m_model->slotItemsAdded(url, KFileItemList() << searchResult(QStringLiteral("b120x")) << searchResult(QStringLiteral("a")));
+    m_model->dispatchPendingItemsToInsert();
+    QCOMPARE(m_model->count(), 152);
+    QCOMPARE(m_model->fileItem(0).name(), QStringLiteral("a"));
+    QCOMPARE(m_model->fileItem(122).name(), QStringLiteral("b120x"));
+    QCOMPARE(m_model->fileItem(151).name(), QStringLiteral("b149"));
+    QVERIFY(m_model->isConsistent());
+
+    // The results stay sorted when the search has been completed
+    m_model->slotCompleted(QUrl());
+    QCOMPARE(m_model->fileItem(122).name(), QStringLiteral("b120x"));
+    QCOMPARE(m_model->fileItem(151).name(), QStringLiteral("b149"));
+    QVERIFY(m_model->isConsistent());
+}
+
+void KFileItemModelTest::testItemsAddedWhileResorting()
+{
+    const QUrl url = m_testDir->url();
+    const auto listedItem = [&url](const QString& name) {
+        QUrl itemUrl = url;
+        itemUrl.setPath(url.path() + QLatin1Char('/') + name);
+        return KFileItem(itemUrl, QString(), KFileItem::Unknown);
+    };
+
+    const int itemCount = KItemListCostModel::instance().asyncResortItemsLimit();
+    KFileItemList items;
+    for (int i = 0; i < itemCount; ++i) {
+        items << listedItem(QStringLiteral("b%1").arg(i, 5, 10, QLatin1Char('0')));
+    }
+    m_model->slotItemsAdded(url, items);
+    m_model->slotCompleted(QUrl());
+    QCOMPARE(m_model->count(), itemCount);
+
+    // Resorting this many items is done by a worker thread
+    m_model->setSortOrder(Qt::DescendingOrder);
+    QVERIFY(m_model->isAsyncResortRunning());
+
+    // Items that are listed while resorting don't cancel the resorting
+    m_model->slotItemsAdded(url, KFileItemList() << listedItem(QStringLiteral("a")) << listedItem(QStringLiteral("c")));
+    QVERIFY(m_model->isAsyncResortRunning());
+    QCOMPARE(m_model->count(), itemCount);
+
+    // They are inserted into the sorted items
+    QTRY_VERIFY(!m_model->isAsyncResortRunning());
+    m_model->slotCompleted(QUrl());
+    QCOMPARE(m_model->count(), itemCount + 2);
+    QCOMPARE(m_model->fileItem(0).name(), QStringLiteral("c"));
+    QCOMPARE(m_model->fileItem(1).name(), QStringLiteral("b%1").arg(itemCount - 1, 5, 10, QLatin1Char('0')));
+    QCOMPARE(m_model->fileItem(itemCount + 1).name(), QStringLiteral("a"));
+    QVERIFY(m_model->isConsistent());
+}
+
 QTEST_MAIN(KFileItemModelTest)
 
 #include "kfileitemmodeltest.moc"
@@ -0,0 +1,183 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/kfileitemmodel.h"
+#include "kitemviews/kfileitemselection.h"
+#include "testdir.h"
+
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTest>
+
+class KFileItemSelectionTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testEmpty();
+    void testSummary();
+    void testChangedSelection();
+    void testInvalidateSummary();
+    void testIteration();
+
+private:
+    /**
+     * @return Set of the indexes of the items with the names \a names.
+     */
+    KItemSet indexes(const QStringList& names) const;
+
+private:
+    KFileItemModel* m_model;
+    TestDir* m_testDir;
+};
+
+void KFileItemSelectionTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void KFileItemSelectionTest::init()
+{
+    m_testDir = new TestDir();
+    m_model = new KFileItemModel();
+
+    // The sizes of the files are 1, 10 and 100 bytes
+    m_testDir->createFile(QStringLiteral("a"), QByteArray(1, 'a'));
+    m_testDir->createFile(QStringLiteral("b"), QByteArray(10, 'b'));
+    m_testDir->createFile(QStringLiteral("c"), QByteArray(100, 'c'));
+    m_testDir->createDir(QStringLiteral("d"));
+    m_testDir->createDir(QStringLiteral("e"));
+
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(m_model->count(), 5);
+}
+
+void KFileItemSelectionTest::cleanup()
+{
+    delete m_model;
+    m_model = nullptr;
+    delete m_testDir;
+    m_testDir = nullptr;
+}
+
+void KFileItemSelectionTest::testEmpty()
+{
+    const KFileItemSelection withoutModel;
+    QVERIFY(withoutModel.isEmpty());
+    QVERIFY(withoutModel.first().isNull());
+    QCOMPARE(withoutModel.folderCount(), 0);
+    QCOMPARE(withoutModel.fileCount(), 0);
+    QCOMPARE(withoutModel.totalFileSize(), KIO::filesize_t(0));
+    QVERIFY(withoutModel.begin() == withoutModel.end());
+
+    const KFileItemSelection selection(m_model);
+    QVERIFY(selection.isEmpty());
+    QCOMPARE(selection.count(), 0);
+    QCOMPARE(selection.folderCount(), 0);
+    QCOMPARE(selection.fileCount(), 0);
+    QVERIFY(selection.toList().isEmpty());
+}
+
+void KFileItemSelectionTest::testSummary()
+{
+    KFileItemSelection selection(m_model);
+    selection.setIndexes(indexes({"a", "c", "d"}));
+
+    QCOMPARE(selection.count(), 3);
+    QCOMPARE(selection.folderCount(), 1);
+    QCOMPARE(selection.fileCount(), 2);
+    QCOMPARE(selection.totalFileSize(), KIO::filesize_t(101));
+}
+
+/**
+ * Verify that the summary is correct if the selection is extended or reduced,
+ * which only takes the added and removed items into account.
+ */
+void KFileItemSelectionTest::testChangedSelection()
+{
+    KFileItemSelection selection(m_model);
+    selection.setIndexes(indexes({"a", "b", "c", "d", "e"}));
+    QCOMPARE(selection.folderCount(), 2);
+    QCOMPARE(selection.fileCount(), 3);
+    QCOMPARE(selection.totalFileSize(), KIO::filesize_t(111));
+
+    selection.setIndexes(indexes({"a", "b", "c", "d"}));
+    QCOMPARE(selection.folderCount(), 1);
+    QCOMPARE(selection.fileCount(), 3);
+    QCOMPARE(selection.totalFileSize(), KIO::filesize_t(111));
+
+    selection.setIndexes(indexes({"b", "c", "d"}));
+    QCOMPARE(selection.folderCount(), 1);
+    QCOMPARE(selection.fileCount(), 2);
+    QCOMPARE(selection.totalFileSize(), KIO::filesize_t(110));
+
+    selection.setIndexes(indexes({"a"}));
+    QCOMPARE(selection.folderCount(), 0);
+    QCOMPARE(selection.fileCount(), 1);
+    QCOMPARE(selection.totalFileSize(), KIO::filesize_t(1));
+
+    selection.setIndexes(KItemSet());
+    QCOMPARE(selection.folderCount(), 0);
+    QCOMPARE(selection.fileCount(), 0);
+    QCOMPARE(selection.totalFileSize(), KIO::filesize_t(0));
+}
+
+/**
+ * Verify that the summary is calculated again for the same indexes
+ * after the items of the model have been changed.
+ */
+void KFileItemSelectionTest::testInvalidateSummary()
+{
+    KFileItemSelection selection(m_model);
+    selection.setIndexes(indexes({"a", "b"}));
+    QCOMPARE(selection.fileCount(), 2);
+    QCOMPARE(selection.totalFileSize(), KIO::filesize_t(11));
+
+    // The indexes of "a" and "b" refer to "c" and "b" after reversing the order
+    m_model->setSortOrder(Qt::DescendingOrder);
+    QCOMPARE(selection.totalFileSize(), KIO::filesize_t(11));
+
+    selection.invalidateSummary();
+    QCOMPARE(selection.fileCount(), 2);
+    QCOMPARE(selection.totalFileSize(), KIO::filesize_t(110));
+}
+
+void KFileItemSelectionTest::testIteration()
+{
+    KFileItemSelection selection(m_model);
+    selection.setIndexes(indexes({"b", "e"}));
+
+    QCOMPARE(selection.first(), m_model->fileItem(indexes({"b", "e"}).first()));
+
+    QList<QUrl> urls;
+    for (const KFileItem& item : selection) {
+        urls.append(item.url());
+    }
+    QCOMPARE(urls, selection.urlList());
+    QCOMPARE(selection.toList().count(), 2);
+    QCOMPARE(selection.toList().urlList(), urls);
+}
+
+KItemSet KFileItemSelectionTest::indexes(const QStringList& names) const
+{
+    KItemSet result;
+    for (const QString& name : names) {
+        const int index = m_model->index(QUrl::fromLocalFile(m_testDir->path() + QLatin1Char('/') + name));
+        Q_ASSERT(index >= 0);
+        result.insert(index);
+    }
+    return result;
+}
+
+QTEST_GUILESS_MAIN(KFileItemSelectionTest)
+
+#include "kfileitemselectiontest.moc"
@@ -0,0 +1,215 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kfileitemmodeldirlister.h"
+#include "kitemviews/private/kfilenamesearchindex.h"
+#include "testdir.h"
+#include "testhelpers.h"
+
+#include <KFileItem>
+
+#include <QDir>
+#include <QSignalSpy>
+#include <QTest>
+#include <QUrlQuery>
+
+class KFileNameSearchIndexTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testIsSupported();
+    void testSearch_data();
+    void testSearch();
+    void testIsIndexed();
+    void testSubfolder();
+    void testUpdate();
+    void testDirLister();
+
+private:
+    /**
+     * Searches the folder \a folderUrl for \a text after it has been indexed.
+     * @return Paths relative to the test directory.
+     */
+    QStringList indexedSearch(const QString& text, const QUrl& folderUrl);
+
+    TestDir* m_testDir;
+};
+
+void KFileNameSearchIndexTest::init()
+{
+    m_testDir = new TestDir();
+    m_testDir->createFiles({"Notes.txt", "notes-2021.odt", "report.pdf", "a.cpp", "b.h"});
+    m_testDir->createFiles({"src/main.cpp", "src/main.h", "src/lib/notes.cpp", ".hidden/notes.txt"});
+    m_testDir->createDir("empty");
+}
+
+void KFileNameSearchIndexTest::cleanup()
+{
+    KFileNameSearchIndex::instance().clear();
+    delete m_testDir;
+    m_testDir = nullptr;
+}
+
+void KFileNameSearchIndexTest::testIsSupported()
+{
+    const QUrl folderUrl = m_testDir->url();
+    QVERIFY(KFileNameSearchIndex::isSupported(TestHelpers::searchUrl("notes", folderUrl)));
+    QVERIFY(KFileNameSearchIndex::isSupported(TestHelpers::searchUrl("*.cpp", folderUrl)));
+
+    // Regular expressions and searches for the content are done by KIO
+    QVERIFY(!KFileNameSearchIndex::isSupported(TestHelpers::searchUrl("^notes$", folderUrl)));
+    QVERIFY(!KFileNameSearchIndex::isSupported(TestHelpers::searchUrl("(a|b)", folderUrl)));
+    QVERIFY(!KFileNameSearchIndex::isSupported(TestHelpers::searchUrl(QString(), folderUrl)));
+
+    QUrl contentUrl = TestHelpers::searchUrl("notes", folderUrl);
+    QUrlQuery query(contentUrl);
+    query.addQueryItem(QStringLiteral("checkContent"), QStringLiteral("yes"));
+    contentUrl.setQuery(query);
+    QVERIFY(!KFileNameSearchIndex::isSupported(contentUrl));
+
+    QVERIFY(!KFileNameSearchIndex::isSupported(TestHelpers::searchUrl("notes", QUrl(QStringLiteral("smb://server/share")))));
+    QVERIFY(!KFileNameSearchIndex::isSupported(m_testDir->url()));
+}
+
+void KFileNameSearchIndexTest::testSearch_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QStringList>("expectedPaths");
+
+    QTest::newRow("substring") << "notes"
+                               << QStringList{"Notes.txt", "notes-2021.odt", "src/lib/notes.cpp"};
+    QTest::newRow("case-insensitive") << "NOTES.T"
+                                      << QStringList{"Notes.txt"};
+    QTest::newRow("hidden") << "hidden"
+                            << QStringList();
+    QTest::newRow("short text") << "b."
+                                << QStringList{"b.h"};
+    QTest::newRow("folder") << "src"
+                            << QStringList{"src"};
+    QTest::newRow("glob") << "*.cpp"
+                          << QStringList{"a.cpp", "src/lib/notes.cpp", "src/main.cpp"};
+    QTest::newRow("glob without literal") << "?.*"
+                                          << QStringList{"a.cpp", "b.h"};
+    QTest::newRow("glob with brackets") << "main.[ch]*"
+                                        << QStringList{"src/main.cpp", "src/main.h"};
+    QTest::newRow("no match") << "missing"
+                              << QStringList();
+}
+
+void KFileNameSearchIndexTest::testSearch()
+{
+    QFETCH(QString, text);
+    QFETCH(QStringList, expectedPaths);
+
+    QStringList paths = indexedSearch(text, m_testDir->url());
+    paths.sort();
+    QCOMPARE(paths, expectedPaths);
+}
+
+void KFileNameSearchIndexTest::testIsIndexed()
+{
+    KFileNameSearchIndex& index = KFileNameSearchIndex::instance();
+    const QUrl url = TestHelpers::searchUrl("notes", m_testDir->url());
+
+    // Asking for the index does not build it
+    QSignalSpy indexedSpy(&index, &KFileNameSearchIndex::indexed);
+    QVERIFY(!index.isIndexed(url));
+    QVERIFY(!indexedSpy.wait(500));
+    QVERIFY(!index.isIndexed(url));
+
+    QVERIFY(!index.prepare(url));
+    QVERIFY(indexedSpy.wait());
+    QVERIFY(index.isIndexed(url));
+    QVERIFY(!index.isIndexed(TestHelpers::searchUrl("notes", QUrl::fromLocalFile(QDir::tempPath()))));
+}
+
+void KFileNameSearchIndexTest::testSubfolder()
+{
+    // The index of the test directory answers the searches in its subfolders
+    QCOMPARE(indexedSearch("notes", m_testDir->url()).count(), 3);
+
+    const QUrl subfolderUrl = QUrl::fromLocalFile(m_testDir->path() + QLatin1String("/src"));
+    QVERIFY(KFileNameSearchIndex::instance().prepare(TestHelpers::searchUrl("main", subfolderUrl)));
+
+    QStringList paths = indexedSearch("*", subfolderUrl);
+    paths.sort();
+    QCOMPARE(paths, QStringList({"src/lib", "src/lib/notes.cpp", "src/main.cpp", "src/main.h"}));
+}
+
+void KFileNameSearchIndexTest::testUpdate()
+{
+    QCOMPARE(indexedSearch("added", m_testDir->url()), QStringList());
+
+    QSignalSpy changedSpy(&KFileNameSearchIndex::instance(), &KFileNameSearchIndex::indexChanged);
+    m_testDir->createFile("src/added.txt");
+    m_testDir->createFile("new/added.cpp");
+    m_testDir->removeFile("report.pdf");
+
+    QTRY_COMPARE(indexedSearch("added", m_testDir->url()).count(), 2);
+    QTRY_COMPARE(indexedSearch("report", m_testDir->url()), QStringList());
+    QVERIFY(!changedSpy.isEmpty());
+
+    QStringList paths = indexedSearch("added", m_testDir->url());
+    paths.sort();
+    QCOMPARE(paths, QStringList({"new/added.cpp", "src/added.txt"}));
+}
+
+void KFileNameSearchIndexTest::testDirLister()
+{
+    KFileNameSearchIndex& index = KFileNameSearchIndex::instance();
+    const QUrl url = TestHelpers::searchUrl("*.cpp", m_testDir->url());
+    QSignalSpy indexedSpy(&index, &KFileNameSearchIndex::indexed);
+    QVERIFY(!index.prepare(url));
+    QVERIFY(indexedSpy.wait());
+
+    KFileItemModelDirLister dirLister;
+    dirLister.setIndexedSearchEnabled(true);
+
+    QStringList paths;
+    connect(&dirLister, &KFileItemModelDirLister::itemsAdded, this, [this, &paths](const QUrl&, const KFileItemList& items) {
+        for (const KFileItem& item : items) {
+            paths.append(item.localPath().mid(m_testDir->path().length() + 1));
+        }
+    });
+
+    // The search is answered by the index instead of KIO
+    QSignalSpy completedSpy(&dirLister, static_cast<void (KCoreDirLister::*)()>(&KCoreDirLister::completed));
+    QVERIFY(dirLister.openUrl(url));
+    QVERIFY(dirLister.isListingLocally());
+    QVERIFY(completedSpy.wait());
+
+    paths.sort();
+    QCOMPARE(paths, QStringList({"a.cpp", "src/lib/notes.cpp", "src/main.cpp"}));
+}
+
+QStringList KFileNameSearchIndexTest::indexedSearch(const QString& text, const QUrl& folderUrl)
+{
+    KFileNameSearchIndex& index = KFileNameSearchIndex::instance();
+    const QUrl url = TestHelpers::searchUrl(text, folderUrl);
+    if (!index.prepare(url)) {
+        QSignalSpy indexedSpy(&index, &KFileNameSearchIndex::indexed);
+        indexedSpy.wait();
+        if (!index.prepare(url)) {
+            return {QStringLiteral("<not indexed>")};
+        }
+    }
+
+    QStringList paths;
+    const int prefixLength = m_testDir->path().length() + 1;
+    const QStringList foundPaths = index.search(url).result();
+    for (const QString& path : foundPaths) {
+        paths.append(path.mid(prefixLength));
+    }
+    return paths;
+}
+
+QTEST_GUILESS_MAIN(KFileNameSearchIndexTest)
+
+#include "kfilenamesearchindextest.moc"
@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kfilestatengine.h"
+#include "testdir.h"
+
+#include <QFile>
+#include <QTest>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class KFileStatEngineTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testStat();
+    void testStatBatch();
+    void testSymbolicLink();
+
+private:
+    TestDir* m_testDir;
+    int m_dirFd;
+};
+
+void KFileStatEngineTest::init()
+{
+    m_testDir = new TestDir();
+    m_testDir->createFile("a", QByteArray(10, 'a'));
+    m_testDir->createFile("b", QByteArray(20, 'b'));
+    m_testDir->createDir("c");
+    QVERIFY(QFile::link(m_testDir->path() + "/a", m_testDir->path() + "/link"));
+
+    m_dirFd = open(QFile::encodeName(m_testDir->path()).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    QVERIFY(m_dirFd >= 0);
+}
+
+void KFileStatEngineTest::cleanup()
+{
+    close(m_dirFd);
+    delete m_testDir;
+    m_testDir = nullptr;
+}
+
+void KFileStatEngineTest::testStat()
+{
+    KFileStatEngine::Stat fileStat;
+    QVERIFY(KFileStatEngine::stat(m_dirFd, "a", KFileStatEngine::NoFollowSymlinks, fileStat));
+    QVERIFY(S_ISREG(fileStat.mode));
+    QCOMPARE(fileStat.size, qint64(10));
+    QCOMPARE(fileStat.linkCount, quint64(1));
+    QCOMPARE(fileStat.userId, getuid());
+
+    QVERIFY(KFileStatEngine::stat(m_dirFd, "c", KFileStatEngine::BasicFieldsOnly, fileStat));
+    QVERIFY(S_ISDIR(fileStat.mode));
+
+    QVERIFY(!KFileStatEngine::stat(m_dirFd, "missing", KFileStatEngine::NoFlags, fileStat));
+}
+
+void KFileStatEngineTest::testStatBatch()
+{
+    const QVector<QByteArray> names = {"a", "missing", "b", "c"};
+    QVector<KFileStatEngine::Stat> fileStats;
+    const QVector<bool> found = KFileStatEngine::statBatch(m_dirFd, names, KFileStatEngine::NoFollowSymlinks, fileStats);
+
+    QCOMPARE(found, QVector<bool>({true, false, true, true}));
+    QCOMPARE(fileStats.count(), names.count());
+    QCOMPARE(fileStats.at(0).size, qint64(10));
+    QCOMPARE(fileStats.at(2).size, qint64(20));
+    QVERIFY(S_ISDIR(fileStats.at(3).mode));
+
+    // The results are the same as by single system calls
+    for (int i = 0; i < names.count(); ++i) {
+        if (found.at(i)) {
+            KFileStatEngine::Stat fileStat;
+            QVERIFY(KFileStatEngine::stat(m_dirFd, names.at(i).constData(), KFileStatEngine::NoFollowSymlinks, fileStat));
+            QCOMPARE(fileStats.at(i).mode, fileStat.mode);
+            QCOMPARE(fileStats.at(i).inode, fileStat.inode);
+            QCOMPARE(fileStats.at(i).modificationTime, fileStat.modificationTime);
+        }
+    }
+
+    fileStats.clear();
+    QVERIFY(KFileStatEngine::statBatch(m_dirFd, QVector<QByteArray>(), KFileStatEngine::NoFlags, fileStats).isEmpty());
+    QVERIFY(fileStats.isEmpty());
+}
+
+void KFileStatEngineTest::testSymbolicLink()
+{
+    const QVector<QByteArray> names = {"link", "link"};
+    QVector<KFileStatEngine::Stat> linkStats;
+    QVector<KFileStatEngine::Stat> targetStats;
+    KFileStatEngine::statBatch(m_dirFd, names, KFileStatEngine::NoFollowSymlinks, linkStats);
+    KFileStatEngine::statBatch(m_dirFd, names, KFileStatEngine::NoFlags, targetStats);
+
+    QVERIFY(S_ISLNK(linkStats.at(0).mode));
+    QVERIFY(S_ISREG(targetStats.at(0).mode));
+    QCOMPARE(targetStats.at(1).size, qint64(10));
+}
+
+QTEST_GUILESS_MAIN(KFileStatEngineTest)
+
+#include "kfilestatenginetest.moc"
@@ -0,0 +1,150 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kiconpixmapcache.h"
+
+#include <QTest>
+
+class KIconPixmapCacheTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+
+    void testFindInsertedPixmap();
+    void testDifferentKeys();
+    void testVariants();
+    void testWorkingSetHint();
+    void testManyNames();
+
+private:
+    static QPixmap createPixmap(int size);
+};
+
+void KIconPixmapCacheTest::init()
+{
+    KIconPixmapCache& cache = KIconPixmapCache::instance();
+    cache.clear();
+    cache.resetStatistics();
+}
+
+void KIconPixmapCacheTest::testFindInsertedPixmap()
+{
+    KIconPixmapCache& cache = KIconPixmapCache::instance();
+    const QStringList overlays = {QStringLiteral("emblem-symbolic-link")};
+
+    QPixmap pixmap;
+    QVERIFY(!cache.find(QStringLiteral("folder"), overlays, 32, QIcon::Normal, 1.0, &pixmap));
+    QCOMPARE(cache.misses(), quint64(1));
+    QCOMPARE(cache.hits(), quint64(0));
+
+    cache.insert(QStringLiteral("folder"), overlays, 32, QIcon::Normal, 1.0, createPixmap(32));
+    QVERIFY(cache.find(QStringLiteral("folder"), overlays, 32, QIcon::Normal, 1.0, &pixmap));
+    QCOMPARE(pixmap.size(), QSize(32, 32));
+    QCOMPARE(cache.hits(), quint64(1));
+
+    cache.resetStatistics();
+    QCOMPARE(cache.hits(), quint64(0));
+    QCOMPARE(cache.misses(), quint64(0));
+}
+
+void KIconPixmapCacheTest::testDifferentKeys()
+{
+    KIconPixmapCache& cache = KIconPixmapCache::instance();
+    cache.insert(QStringLiteral("folder"), QStringList(), 32, QIcon::Normal, 1.0, createPixmap(32));
+
+    QPixmap pixmap;
+    QVERIFY(cache.find(QStringLiteral("folder"), QStringList(), 32, QIcon::Normal, 1.0, &pixmap));
+    QVERIFY(!cache.find(QStringLiteral("text-plain"), QStringList(), 32, QIcon::Normal, 1.0, &pixmap));
+    QVERIFY(!cache.find(QStringLiteral("folder"), {QStringLiteral("emblem-locked")}, 32, QIcon::Normal, 1.0, &pixmap));
+    QVERIFY(!cache.find(QStringLiteral("folder"), QStringList(), 48, QIcon::Normal, 1.0, &pixmap));
+    QVERIFY(!cache.find(QStringLiteral("folder"), QStringList(), 32, QIcon::Selected, 1.0, &pixmap));
+    QVERIFY(!cache.find(QStringLiteral("folder"), QStringList(), 32, QIcon::Normal, 2.0, &pixmap));
+}
+
+void KIconPixmapCacheTest::testVariants()
+{
+    KIconPixmapCache& cache = KIconPixmapCache::instance();
+    const QPixmap pixmap = createPixmap(32);
+    const QPixmap otherPixmap = createPixmap(32);
+    const QRgb color = qRgb(0, 0, 255);
+
+    QPixmap variant;
+    QVERIFY(!cache.findVariant(pixmap, 1, color, &variant));
+
+    const QPixmap cutPixmap = createPixmap(32);
+    cache.insertVariant(pixmap, 1, color, cutPixmap);
+    QVERIFY(cache.findVariant(pixmap, 1, color, &variant));
+    QCOMPARE(variant.cacheKey(), cutPixmap.cacheKey());
+
+    // Copies of the pixmap share the variants
+    const QPixmap copy = pixmap;
+    QVERIFY(cache.findVariant(copy, 1, color, &variant));
+
+    QVERIFY(!cache.findVariant(pixmap, 2, color, &variant));
+    QVERIFY(!cache.findVariant(pixmap, 1, qRgb(255, 0, 0), &variant));
+    QVERIFY(!cache.findVariant(otherPixmap, 1, color, &variant));
+}
+
+void KIconPixmapCacheTest::testWorkingSetHint()
+{
+    KIconPixmapCache& cache = KIconPixmapCache::instance();
+
+    const QObject firstView;
+    const QObject secondView;
+
+    cache.setWorkingSetHint(&firstView, 10, 16);
+    const int defaultCost = cache.maximumCost();
+
+    // 1000 pixmaps with 256x256 pixels require 250 MiB, which exceeds the maximum
+    cache.setWorkingSetHint(&firstView, 1000, 256);
+    const int maximumCost = cache.maximumCost();
+    QVERIFY(maximumCost > defaultCost);
+    QVERIFY(maximumCost < 1000 * 256);
+
+    cache.setWorkingSetHint(&firstView, 200, 128);
+    QCOMPARE(cache.maximumCost(), 200 * 128 * 128 * 4 / 1024);
+
+    // The working sets of the views are added up
+    cache.setWorkingSetHint(&secondView, 100, 128);
+    QCOMPARE(cache.maximumCost(), 300 * 128 * 128 * 4 / 1024);
+
+    cache.setWorkingSetHint(&firstView, 10, 16);
+    QCOMPARE(cache.maximumCost(), 100 * 128 * 128 * 4 / 1024);
+
+    cache.removeWorkingSetHint(&secondView);
+    QCOMPARE(cache.maximumCost(), defaultCost);
+
+    cache.removeWorkingSetHint(&firstView);
+    QCOMPARE(cache.maximumCost(), defaultCost);
+}
+
+void KIconPixmapCacheTest::testManyNames()
+{
+    KIconPixmapCache& cache = KIconPixmapCache::instance();
+    const QPixmap pixmap = createPixmap(1);
+
+    // Icons that are given as paths don't let the interned names grow without bound
+    for (int i = 0; i < 10000; ++i) {
+        cache.insert(QStringLiteral("/icons/%1.png").arg(i), QStringList(), 1, QIcon::Normal, 1.0, pixmap);
+    }
+
+    QPixmap cachedPixmap;
+    QVERIFY(!cache.find(QStringLiteral("/icons/0.png"), QStringList(), 1, QIcon::Normal, 1.0, &cachedPixmap));
+    QVERIFY(cache.find(QStringLiteral("/icons/9999.png"), QStringList(), 1, QIcon::Normal, 1.0, &cachedPixmap));
+}
+
+QPixmap KIconPixmapCacheTest::createPixmap(int size)
+{
+    QPixmap pixmap(size, size);
+    pixmap.fill(Qt::red);
+    return pixmap;
+}
+
+QTEST_MAIN(KIconPixmapCacheTest)
+
+#include "kiconpixmapcachetest.moc"
@@ -0,0 +1,100 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kiogovernor.h"
+
+#include <QDir>
+#include <QSignalSpy>
+#include <QTest>
+
+class KIoGovernorTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+
+    void testMountPoint();
+    void testSlowMount();
+    void testBudget();
+};
+
+void KIoGovernorTest::init()
+{
+    KIoGovernor::instance().resetLatencies();
+}
+
+void KIoGovernorTest::testMountPoint()
+{
+    const KIoGovernor& governor = KIoGovernor::instance();
+    const QString path = QDir::tempPath();
+    const QString mountPoint = governor.mountPoint(path);
+    QVERIFY(!mountPoint.isEmpty());
+    QVERIFY(path.startsWith(mountPoint));
+    QCOMPARE(governor.mountPoint(path + QStringLiteral("/a/b")), mountPoint);
+}
+
+void KIoGovernorTest::testSlowMount()
+{
+    KIoGovernor& governor = KIoGovernor::instance();
+    QSignalSpy spy(&governor, &KIoGovernor::slowMountsChanged);
+    const QString path = QDir::tempPath();
+
+    // A single slow access is not enough
+    governor.reportLatency(path, 1000);
+    QVERIFY(!governor.isSlow(path));
+    QVERIFY(!governor.hasSlowMounts());
+
+    for (int i = 0; i < 3; ++i) {
+        governor.reportLatency(path, 1000);
+    }
+    QVERIFY(governor.isSlow(path));
+    QVERIFY(governor.hasSlowMounts());
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.first().first().toString(), governor.mountPoint(path));
+
+    // The mount only becomes fast again if the latencies are low for a while
+    governor.reportLatency(path, 0);
+    QVERIFY(governor.isSlow(path));
+
+    for (int i = 0; i < 50; ++i) {
+        governor.reportLatency(path, 0);
+    }
+    QVERIFY(!governor.isSlow(path));
+    QVERIFY(!governor.hasSlowMounts());
+    QCOMPARE(spy.count(), 2);
+}
+
+void KIoGovernorTest::testBudget()
+{
+    KIoGovernor& governor = KIoGovernor::instance();
+    QSignalSpy spy(&governor, &KIoGovernor::released);
+    const QString path = QDir::tempPath();
+
+    const int budget = governor.budget(KIoGovernor::DirectoryCounting, path);
+    QVERIFY(budget > 1);
+    QCOMPARE(governor.acquire(KIoGovernor::DirectoryCounting, path, budget + 1), budget);
+    QCOMPARE(governor.acquire(KIoGovernor::DirectoryCounting, path), 0);
+
+    // The budgets of the subsystems are independent
+    QCOMPARE(governor.acquire(KIoGovernor::MimeTypes, path), 1);
+    governor.release(KIoGovernor::MimeTypes, path);
+
+    governor.release(KIoGovernor::DirectoryCounting, path, budget);
+    QCOMPARE(spy.count(), 2);
+
+    // Only one task may access a slow mount
+    for (int i = 0; i < 4; ++i) {
+        governor.reportLatency(path, 1000);
+    }
+    QCOMPARE(governor.budget(KIoGovernor::DirectoryCounting, path), 1);
+    QCOMPARE(governor.acquire(KIoGovernor::DirectoryCounting, path, 2), 1);
+    governor.release(KIoGovernor::DirectoryCounting, path);
+}
+
+QTEST_GUILESS_MAIN(KIoGovernorTest)
+
+#include "kiogovernortest.moc"
@@ -0,0 +1,126 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kitemlistcolumnwidthcache.h"
+
+#include <QTest>
+
+class KItemListColumnWidthCacheTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void testMaximumWidth();
+    void testItemsInserted();
+    void testItemsRemoved();
+    void testItemsMoved();
+    void testItemsChanged();
+
+private:
+    /**
+     * Sets the width of the role "text" to \a textWidths and the width
+     * of the role "size" to 10 for all items.
+     */
+    void setWidths(const QVector<qreal>& textWidths);
+
+    KItemListColumnWidthCache m_cache;
+};
+
+void KItemListColumnWidthCacheTest::init()
+{
+    m_cache.setRoles({"text", "size"});
+    m_cache.reset(0);
+}
+
+void KItemListColumnWidthCacheTest::setWidths(const QVector<qreal>& textWidths)
+{
+    m_cache.reset(textWidths.count());
+    for (int i = 0; i < textWidths.count(); ++i) {
+        m_cache.setWidth(i, 0, textWidths.at(i));
+        m_cache.setWidth(i, 1, 10);
+    }
+}
+
+void KItemListColumnWidthCacheTest::testMaximumWidth()
+{
+    setWidths({30, 50, 20});
+
+    QCOMPARE(m_cache.count(), 3);
+    QVERIFY(m_cache.isCalculated(0));
+    QCOMPARE(m_cache.maximumWidth(0), qreal(50));
+    QCOMPARE(m_cache.maximumWidth(1), qreal(10));
+
+    m_cache.reset(3);
+    QVERIFY(!m_cache.isCalculated(0));
+    QCOMPARE(m_cache.maximumWidth(0), qreal(0));
+}
+
+void KItemListColumnWidthCacheTest::testItemsInserted()
+{
+    setWidths({30, 50, 20});
+
+    // Insert one item before the first item and two items before the last item
+    m_cache.itemsInserted(KItemRangeList() << KItemRange(0, 1) << KItemRange(2, 2));
+    QCOMPARE(m_cache.count(), 6);
+    QVERIFY(!m_cache.isCalculated(0));
+    QVERIFY(m_cache.isCalculated(1));
+    QVERIFY(m_cache.isCalculated(2));
+    QVERIFY(!m_cache.isCalculated(3));
+    QVERIFY(!m_cache.isCalculated(4));
+    QVERIFY(m_cache.isCalculated(5));
+    QCOMPARE(m_cache.maximumWidth(0), qreal(50));
+
+    m_cache.setWidth(3, 0, 80);
+    QCOMPARE(m_cache.maximumWidth(0), qreal(80));
+}
+
+void KItemListColumnWidthCacheTest::testItemsRemoved()
+{
+    setWidths({30, 50, 20, 40});
+
+    // Removing an item that is smaller than the maximum keeps the maximum
+    m_cache.itemsRemoved(KItemRangeList() << KItemRange(0, 1));
+    QCOMPARE(m_cache.count(), 3);
+    QCOMPARE(m_cache.maximumWidth(0), qreal(50));
+
+    // Removing the item with the maximum width requires a new maximum
+    m_cache.itemsRemoved(KItemRangeList() << KItemRange(0, 1));
+    QCOMPARE(m_cache.count(), 2);
+    QCOMPARE(m_cache.maximumWidth(0), qreal(40));
+    QCOMPARE(m_cache.maximumWidth(1), qreal(10));
+}
+
+void KItemListColumnWidthCacheTest::testItemsMoved()
+{
+    setWidths({30, 50, 20});
+    m_cache.itemsChanged(KItemRangeList() << KItemRange(2, 1));
+
+    // Move the uncalculated last item to the front
+    m_cache.itemsMoved(KItemRange(0, 3), {1, 2, 0});
+    QVERIFY(!m_cache.isCalculated(0));
+    QVERIFY(m_cache.isCalculated(1));
+    QVERIFY(m_cache.isCalculated(2));
+    QCOMPARE(m_cache.maximumWidth(0), qreal(50));
+}
+
+void KItemListColumnWidthCacheTest::testItemsChanged()
+{
+    setWidths({30, 50, 20});
+
+    m_cache.itemsChanged(KItemRangeList() << KItemRange(1, 1));
+    QVERIFY(!m_cache.isCalculated(1));
+    QCOMPARE(m_cache.maximumWidth(0), qreal(30));
+
+    m_cache.setWidth(1, 0, 25);
+    m_cache.setWidth(1, 1, 10);
+    QVERIFY(m_cache.isCalculated(1));
+    QCOMPARE(m_cache.maximumWidth(0), qreal(30));
+}
+
+QTEST_GUILESS_MAIN(KItemListColumnWidthCacheTest)
+
+#include "kitemlistcolumnwidthcachetest.moc"
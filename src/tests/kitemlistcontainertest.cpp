@@ -0,0 +1,87 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/kitemlistcontainer.h"
+
+#include <QHash>
+#include <QTest>
+
+namespace {
+    const char* const SessionVariables[] = {"XRDP_SESSION", "VNCDESKTOP", "SSH_CONNECTION", "DISPLAY"};
+}
+
+class KItemListContainerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanup();
+
+    void testIsRemoteSession_data();
+    void testIsRemoteSession();
+
+private:
+    QHash<QByteArray, QByteArray> m_environment;
+};
+
+void KItemListContainerTest::initTestCase()
+{
+    for (const char* variable : SessionVariables) {
+        if (qEnvironmentVariableIsSet(variable)) {
+            m_environment.insert(variable, qgetenv(variable));
+        }
+    }
+}
+
+void KItemListContainerTest::cleanup()
+{
+    // Restore the environment of the session for the next test
+    for (const char* variable : SessionVariables) {
+        if (m_environment.contains(variable)) {
+            qputenv(variable, m_environment.value(variable));
+        } else {
+            qunsetenv(variable);
+        }
+    }
+}
+
+void KItemListContainerTest::testIsRemoteSession_data()
+{
+    QTest::addColumn<QByteArray>("variable");
+    QTest::addColumn<QByteArray>("value");
+    QTest::addColumn<QByteArray>("display");
+    QTest::addColumn<bool>("remoteSession");
+
+    QTest::newRow("local") << QByteArray() << QByteArray() << QByteArray(":0") << false;
+    QTest::newRow("xrdp") << QByteArray("XRDP_SESSION") << QByteArray("1") << QByteArray(":10") << true;
+    QTest::newRow("vnc") << QByteArray("VNCDESKTOP") << QByteArray("host:1") << QByteArray(":1") << true;
+    QTest::newRow("ssh") << QByteArray("SSH_CONNECTION") << QByteArray("10.0.0.1 22 10.0.0.2 22") << QByteArray(":0") << false;
+    QTest::newRow("ssh/forwarded") << QByteArray("SSH_CONNECTION") << QByteArray("10.0.0.1 22 10.0.0.2 22") << QByteArray("localhost:10.0") << true;
+    QTest::newRow("forwarded/without ssh") << QByteArray() << QByteArray() << QByteArray("localhost:10.0") << false;
+}
+
+void KItemListContainerTest::testIsRemoteSession()
+{
+    QFETCH(QByteArray, variable);
+    QFETCH(QByteArray, value);
+    QFETCH(QByteArray, display);
+    QFETCH(bool, remoteSession);
+
+    for (const char* sessionVariable : SessionVariables) {
+        qunsetenv(sessionVariable);
+    }
+    if (!variable.isEmpty()) {
+        qputenv(variable.constData(), value);
+    }
+    qputenv("DISPLAY", display);
+
+    QCOMPARE(KItemListContainer::isRemoteSession(), remoteSession);
+}
+
+QTEST_GUILESS_MAIN(KItemListContainerTest)
+
+#include "kitemlistcontainertest.moc"
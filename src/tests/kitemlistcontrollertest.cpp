@@ -8,6 +8,7 @@
 #include "kitemviews/kfileitemlistview.h"
 #include "kitemviews/kfileitemmodel.h"
 #include "kitemviews/kitemlistcontroller.h"
+#include "kitemviews/kitemlistgroupheader.h"
 #include "kitemviews/kitemlistselectionmanager.h"
 #include "kitemviews/private/kitemlistviewlayouter.h"
 #include "testdir.h"
@@ -79,6 +80,11 @@ private Q_SLOTS:
     void testKeyboardNavigation_data();
     void testKeyboardNavigation();
     void testMouseClickActivation();
+    void testItemRangesInRect_data();
+    void testItemRangesInRect();
+    void testIndexAt();
+    void testGroupHeaderRecycling();
+    void testChangedGroupsLayout();
 
 private:
     /**
@@ -629,6 +635,172 @@ void KItemListControllerTest::testMouseClickActivation()
     m_testStyle->setActivateItemOnSingleClick(restoreSettingsSingleClick);
 }
 
+void KItemListControllerTest::testItemRangesInRect_data()
+{
+    QTest::addColumn<KFileItemListView::ItemLayout>("layout");
+    QTest::addColumn<Qt::Orientation>("scrollOrientation");
+    QTest::addColumn<bool>("groupingEnabled");
+
+    QTest::newRow("Icons") << KFileItemListView::IconsLayout << Qt::Vertical << false;
+    QTest::newRow("Icons, grouped") << KFileItemListView::IconsLayout << Qt::Vertical << true;
+    QTest::newRow("Compact") << KFileItemListView::CompactLayout << Qt::Horizontal << false;
+    QTest::newRow("Compact, grouped") << KFileItemListView::CompactLayout << Qt::Horizontal << true;
+    QTest::newRow("Details") << KFileItemListView::DetailsLayout << Qt::Vertical << false;
+}
+
+/**
+ * Verify that the item ranges of KItemListViewLayouter::itemRangesInRect() are
+ * the items whose rectangles intersect with the rectangle like for a rubberband.
+ */
+void KItemListControllerTest::testItemRangesInRect()
+{
+    QFETCH(KFileItemListView::ItemLayout, layout);
+    QFETCH(Qt::Orientation, scrollOrientation);
+    QFETCH(bool, groupingEnabled);
+
+    m_view->setItemLayout(layout);
+    m_view->setScrollOrientation(scrollOrientation);
+    m_model->setGroupedSorting(groupingEnabled);
+    adjustGeometryForColumnCount(3);
+
+    const KItemListViewLayouter* layouter = m_view->m_layouter;
+    const int itemCount = m_model->count();
+    const QSizeF size = layouter->size();
+
+    QVector<QRectF> rects;
+    rects << QRectF(QPointF(0, 0), size)
+          << QRectF(QPointF(-10, -10), size * 2)
+          << QRectF(0, 0, 1, 1)
+          << QRectF(size.width() / 3, size.height() / 3, size.width() / 3, size.height() / 3)
+          << QRectF(0, 0, 0, size.height());
+    for (int i = 0; i < itemCount; i += 3) {
+        // The rectangles start inside of an item and end in the margin
+        const QRectF itemRect = layouter->itemRect(i);
+        rects << QRectF(itemRect.center(), itemRect.size())
+              << QRectF(itemRect.bottomRight() + QPointF(1, 1), itemRect.size() * 2);
+    }
+
+    for (const QRectF& rect : qAsConst(rects)) {
+        QVector<int> expected;
+        for (int i = 0; i < itemCount; ++i) {
+            if (layouter->itemRect(i).intersects(rect)) {
+                expected.append(i);
+            }
+        }
+        QCOMPARE(layouter->itemRangesInRect(rect), KItemRangeList::fromSortedContainer(expected));
+    }
+
+    m_model->setGroupedSorting(false);
+}
+
+/**
+ * Verify that KItemListViewLayouter::indexAt() returns the item whose rectangle
+ * contains the position, and -1 for the margins between the items.
+ */
+void KItemListControllerTest::testIndexAt()
+{
+    m_view->setItemLayout(KFileItemListView::IconsLayout);
+    m_view->setScrollOrientation(Qt::Vertical);
+    adjustGeometryForColumnCount(3);
+
+    const KItemListViewLayouter* layouter = m_view->m_layouter;
+    const int itemCount = m_model->count();
+    QCOMPARE(layouter->indexAt(QPointF(-1, -1)), -1);
+
+    for (int i = 0; i < itemCount; ++i) {
+        const QRectF itemRect = layouter->itemRect(i);
+        QCOMPARE(layouter->indexAt(itemRect.center()), i);
+        QCOMPARE(layouter->indexAt(itemRect.topLeft()), i);
+
+        // Like for the rubberband, the right and bottom edges are not part of an item
+        const QPointF outside = itemRect.bottomRight() + QPointF(0.5, 0.5);
+        int expected = -1;
+        for (int j = 0; j < itemCount; ++j) {
+            const QRectF rect = layouter->itemRect(j);
+            if (outside.x() >= rect.left() && outside.x() < rect.right()
+                    && outside.y() >= rect.top() && outside.y() < rect.bottom()) {
+                expected = j;
+                break;
+            }
+        }
+        QCOMPARE(layouter->indexAt(outside), expected);
+    }
+}
+
+/**
+ * Verify that the group header of an item that has left the viewport is
+ * shown again, without creating a new one, if the item gets visible again.
+ */
+void KItemListControllerTest::testGroupHeaderRecycling()
+{
+    m_view->setItemLayout(KFileItemListView::IconsLayout);
+    m_view->setScrollOrientation(Qt::Vertical);
+    m_model->setGroupedSorting(true);
+    adjustGeometryForColumnCount(1);
+    QVERIFY(m_view->maximumScrollOffset() > 0);
+
+    m_view->setScrollOffset(0);
+    QTRY_VERIFY(m_view->m_visibleItems.contains(0));
+    KItemListGroupHeader* header = m_view->m_visibleGroups.value(m_view->m_visibleItems.value(0));
+    QVERIFY(header);
+
+    m_view->setScrollOffset(m_view->maximumScrollOffset());
+    QVERIFY(!m_view->m_visibleItems.contains(0));
+    QCOMPARE(m_view->m_recycledGroupHeaders.value(0), header);
+    QVERIFY(!header->isVisible());
+
+    m_view->setScrollOffset(0);
+    QTRY_VERIFY(m_view->m_visibleItems.contains(0));
+    QCOMPARE(m_view->m_visibleGroups.value(m_view->m_visibleItems.value(0)), header);
+    QVERIFY(!m_view->m_recycledGroupHeaders.contains(0));
+    QVERIFY(header->isVisible());
+
+    m_model->setGroupedSorting(false);
+    QVERIFY(m_view->m_recycledGroupHeaders.isEmpty());
+}
+
+/**
+ * Verify that the layout after changing the group boundaries, which only
+ * layouts the rows behind the first changed boundary again, is the same
+ * as a complete layout.
+ */
+void KItemListControllerTest::testChangedGroupsLayout()
+{
+    m_view->setItemLayout(KFileItemListView::IconsLayout);
+    m_view->setScrollOrientation(Qt::Vertical);
+    m_model->setGroupedSorting(true);
+    adjustGeometryForColumnCount(3);
+
+    KItemListViewLayouter* layouter = m_view->m_layouter;
+    const int itemCount = m_model->count();
+    const auto rects = [layouter, itemCount]() {
+        QVector<QRectF> rects;
+        for (int i = 0; i < itemCount; ++i) {
+            rects << layouter->itemRect(i);
+            if (layouter->isFirstGroupItem(i)) {
+                rects << layouter->groupHeaderRect(i);
+            }
+        }
+        return rects;
+    };
+
+    // The groups of the reversed order start at other items
+    m_model->setSortOrder(Qt::DescendingOrder);
+    const QVector<QRectF> changedRects = rects();
+    layouter->markAsDirty();
+    QCOMPARE(changedRects, rects());
+
+    m_model->setSortOrder(Qt::AscendingOrder);
+    const QVector<QRectF> restoredRects = rects();
+    layouter->markAsDirty();
+    QCOMPARE(restoredRects, rects());
+
+    m_model->setGroupedSorting(false);
+    const QVector<QRectF> ungroupedRects = rects();
+    layouter->markAsDirty();
+    QCOMPARE(ungroupedRects, rects());
+}
+
 void KItemListControllerTest::adjustGeometryForColumnCount(int count)
 {
     const QSize size = m_view->itemSize().toSize();
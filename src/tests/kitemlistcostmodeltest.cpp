@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kitemlistcostmodel.h"
+
+#include <QTest>
+
+class KItemListCostModelTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+
+    void testDefaultBudgets();
+    void testResolveCost();
+    void testSlowPainting();
+    void testInsertionAndResortCosts();
+};
+
+void KItemListCostModelTest::init()
+{
+    KItemListCostModel::instance().reset();
+}
+
+void KItemListCostModelTest::testDefaultBudgets()
+{
+    const KItemListCostModel& costModel = KItemListCostModel::instance();
+
+    // Without measurements the previously fixed budgets are used
+    QCOMPARE(costModel.resolveAllItemsLimit(), 500);
+    QCOMPARE(costModel.maximumUpdateInterval(), 2000);
+    QCOMPARE(costModel.resortDelay(5000), 500);
+    QCOMPARE(costModel.asyncResortItemsLimit(), 20000);
+    QVERIFY(costModel.maxBlockTimeout(100) > 0);
+    QVERIFY(costModel.maxBlockTimeout(100) <= 200);
+}
+
+void KItemListCostModelTest::testResolveCost()
+{
+    KItemListCostModel& costModel = KItemListCostModel::instance();
+    const int defaultLimit = costModel.resolveAllItemsLimit();
+    const int defaultTimeout = costModel.maxBlockTimeout(100);
+
+    // Resolving an item takes 10 µs
+    for (int i = 0; i < 100; ++i) {
+        costModel.addResolveSample(100, 100 * 10 * 1000);
+    }
+    QVERIFY(costModel.resolveCost() < 20 * 1000);
+    QVERIFY(costModel.resolveAllItemsLimit() > defaultLimit);
+    QVERIFY(costModel.maxBlockTimeout(100) < defaultTimeout);
+
+    // Samples of a few items are ignored
+    const qreal cost = costModel.resolveCost();
+    costModel.addResolveSample(1, 1000 * 1000 * 1000);
+    QCOMPARE(costModel.resolveCost(), cost);
+}
+
+void KItemListCostModelTest::testSlowPainting()
+{
+    KItemListCostModel& costModel = KItemListCostModel::instance();
+    const qreal defaultBudget = costModel.frameBudget();
+    const int defaultTimeout = costModel.maxBlockTimeout(100);
+
+    // Painting takes longer than a frame, so little time is left
+    for (int i = 0; i < 100; ++i) {
+        costModel.addPaintSample(100 * 1000 * 1000);
+    }
+    QVERIFY(costModel.frameBudget() < defaultBudget);
+    QVERIFY(costModel.frameBudget() > 0);
+    QVERIFY(costModel.maxBlockTimeout(100) < defaultTimeout);
+}
+
+void KItemListCostModelTest::testInsertionAndResortCosts()
+{
+    KItemListCostModel& costModel = KItemListCostModel::instance();
+
+    // Fast insertions are shown earlier, slow ones are bundled more
+    for (int i = 0; i < 100; ++i) {
+        costModel.addInsertionSample(1000, 1000 * 1000);
+    }
+    QVERIFY(costModel.maximumUpdateInterval() < 2000);
+
+    for (int i = 0; i < 100; ++i) {
+        costModel.addInsertionSample(1000, 1000 * 1000 * 1000);
+    }
+    QVERIFY(costModel.maximumUpdateInterval() > 2000);
+
+    // The resort delay grows with the number of items
+    QVERIFY(costModel.resortDelay(100) <= costModel.resortDelay(100000));
+
+    // Slow resorting is done in a worker thread for fewer items, but the
+    // limit for fast resorting does not exceed the previously fixed one
+    for (int i = 0; i < 100; ++i) {
+        costModel.addResortSample(1000, 100 * 1000 * 1000);
+    }
+    QVERIFY(costModel.asyncResortItemsLimit() < 20000);
+    QVERIFY(costModel.asyncResortItemsLimit() >= 1000);
+
+    for (int i = 0; i < 100; ++i) {
+        costModel.addResortSample(1000, 1000 * 1000);
+    }
+    QCOMPARE(costModel.asyncResortItemsLimit(), 20000);
+}
+
+QTEST_GUILESS_MAIN(KItemListCostModelTest)
+
+#include "kitemlistcostmodeltest.moc"
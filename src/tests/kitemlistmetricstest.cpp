@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kitemlistmetrics.h"
+
+#include <QSet>
+#include <QTest>
+#include <QtConcurrentMap>
+
+class KItemListMetricsTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+
+    void testAdd();
+    void testConcurrentAdd();
+    void testResetKeepsGauges();
+    void testNames();
+};
+
+void KItemListMetricsTest::init()
+{
+    KItemListMetrics::instance().reset();
+}
+
+void KItemListMetricsTest::testAdd()
+{
+    KItemListMetrics& metrics = KItemListMetrics::instance();
+    QCOMPARE(metrics.value(KItemListMetrics::ItemsLoaded), 0);
+
+    metrics.add(KItemListMetrics::ItemsLoaded, 100);
+    metrics.add(KItemListMetrics::ItemsLoaded);
+    QCOMPARE(metrics.value(KItemListMetrics::ItemsLoaded), 101);
+    QCOMPARE(metrics.value(KItemListMetrics::Sorts), 0);
+}
+
+void KItemListMetricsTest::testConcurrentAdd()
+{
+    KItemListMetrics& metrics = KItemListMetrics::instance();
+
+    QVector<int> values(1000);
+    QtConcurrent::blockingMap(values, [&metrics](int&) {
+        metrics.add(KItemListMetrics::SortNsecs, 10);
+    });
+    QCOMPARE(metrics.value(KItemListMetrics::SortNsecs), 10000);
+}
+
+void KItemListMetricsTest::testResetKeepsGauges()
+{
+    KItemListMetrics& metrics = KItemListMetrics::instance();
+    const qint64 queuedDirectories = metrics.value(KItemListMetrics::QueuedDirectories);
+
+    metrics.add(KItemListMetrics::QueuedDirectories, 3);
+    metrics.add(KItemListMetrics::PreviewCacheHits, 5);
+    metrics.reset();
+    QCOMPARE(metrics.value(KItemListMetrics::PreviewCacheHits), 0);
+    QCOMPARE(metrics.value(KItemListMetrics::QueuedDirectories), queuedDirectories + 3);
+
+    metrics.add(KItemListMetrics::QueuedDirectories, -3);
+    QCOMPARE(metrics.value(KItemListMetrics::QueuedDirectories), queuedDirectories);
+}
+
+void KItemListMetricsTest::testNames()
+{
+    QSet<QString> names;
+    for (int i = 0; i < KItemListMetrics::MetricCount; ++i) {
+        const QString name = KItemListMetrics::name(static_cast<KItemListMetrics::Metric>(i));
+        QVERIFY(!name.isEmpty());
+        names.insert(name);
+    }
+    QCOMPARE(names.count(), int(KItemListMetrics::MetricCount));
+    QCOMPARE(KItemListMetrics::name(KItemListMetrics::ItemsLoaded), QStringLiteral("itemsLoaded"));
+}
+
+QTEST_GUILESS_MAIN(KItemListMetricsTest)
+
+#include "kitemlistmetricstest.moc"
@@ -0,0 +1,168 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kitemlistringbuffer.h"
+
+#include <QTest>
+
+class KItemListRingBufferTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void testInsertAndRemove();
+    void testMoveRange();
+    void testShiftIndexes();
+    void testShiftIndexesOverwrite();
+    void testIterator();
+
+private:
+    /**
+     * Inserts the values 10 * index for the indexes
+     * \a firstIndex to \a lastIndex.
+     */
+    void insertRange(int firstIndex, int lastIndex);
+
+    KItemListRingBuffer<int> m_buffer;
+};
+
+void KItemListRingBufferTest::init()
+{
+    m_buffer.clear();
+}
+
+void KItemListRingBufferTest::insertRange(int firstIndex, int lastIndex)
+{
+    for (int i = firstIndex; i <= lastIndex; ++i) {
+        m_buffer.insert(i, 10 * i);
+    }
+}
+
+void KItemListRingBufferTest::testInsertAndRemove()
+{
+    QVERIFY(m_buffer.isEmpty());
+    QCOMPARE(m_buffer.firstIndex(), -1);
+    QCOMPARE(m_buffer.value(5, -1), -1);
+
+    insertRange(5, 8);
+    m_buffer.insert(2, 20);
+    QCOMPARE(m_buffer.count(), 5);
+    QCOMPARE(m_buffer.firstIndex(), 2);
+    QCOMPARE(m_buffer.lastIndex(), 8);
+    QVERIFY(!m_buffer.contains(3));
+    QCOMPARE(m_buffer.values(), QList<int>({20, 50, 60, 70, 80}));
+
+    m_buffer.insert(6, 61);
+    QCOMPARE(m_buffer.count(), 5);
+    QCOMPARE(m_buffer.value(6), 61);
+
+    // Removing the first and last values shrinks the range
+    m_buffer.remove(2);
+    m_buffer.remove(8);
+    QCOMPARE(m_buffer.firstIndex(), 5);
+    QCOMPARE(m_buffer.lastIndex(), 7);
+
+    m_buffer.remove(5);
+    m_buffer.remove(6);
+    m_buffer.remove(7);
+    QVERIFY(m_buffer.isEmpty());
+    QCOMPARE(m_buffer.lastIndex(), -1);
+}
+
+void KItemListRingBufferTest::testMoveRange()
+{
+    // Moving the range like it is done when scrolling
+    // makes the ring wrap around several times.
+    insertRange(0, 19);
+    for (int i = 0; i < 100; ++i) {
+        m_buffer.remove(i);
+        m_buffer.insert(i + 20, 10 * (i + 20));
+    }
+
+    QCOMPARE(m_buffer.count(), 20);
+    QCOMPARE(m_buffer.firstIndex(), 100);
+    QCOMPARE(m_buffer.lastIndex(), 119);
+    for (int i = 100; i <= 119; ++i) {
+        QCOMPARE(m_buffer.value(i), 10 * i);
+    }
+
+    // Moving backwards
+    for (int i = 99; i >= 50; --i) {
+        m_buffer.remove(i + 20);
+        m_buffer.insert(i, 10 * i);
+    }
+    QCOMPARE(m_buffer.firstIndex(), 50);
+    QCOMPARE(m_buffer.lastIndex(), 69);
+    QCOMPARE(m_buffer.value(50), 500);
+    QCOMPARE(m_buffer.value(69), 690);
+}
+
+void KItemListRingBufferTest::testShiftIndexes()
+{
+    insertRange(10, 14);
+
+    // Inserting items before the range only moves the range
+    m_buffer.shiftIndexes(0, 3);
+    QCOMPARE(m_buffer.firstIndex(), 13);
+    QCOMPARE(m_buffer.lastIndex(), 17);
+    QCOMPARE(m_buffer.value(13), 100);
+
+    // Inserting items inside the range
+    m_buffer.shiftIndexes(15, 2);
+    QCOMPARE(m_buffer.lastIndex(), 19);
+    QVERIFY(!m_buffer.contains(15));
+    QVERIFY(!m_buffer.contains(16));
+    QCOMPARE(m_buffer.value(14), 110);
+    QCOMPARE(m_buffer.value(17), 120);
+    QCOMPARE(m_buffer.value(19), 140);
+
+    // Removing the inserted items again
+    m_buffer.shiftIndexes(17, -2);
+    QCOMPARE(m_buffer.values(), QList<int>({100, 110, 120, 130, 140}));
+    QCOMPARE(m_buffer.firstIndex(), 13);
+    QCOMPARE(m_buffer.lastIndex(), 17);
+}
+
+void KItemListRingBufferTest::testShiftIndexesOverwrite()
+{
+    insertRange(0, 5);
+
+    // The values of the removed indexes 2 and 3 get overwritten
+    m_buffer.shiftIndexes(4, -2);
+    QCOMPARE(m_buffer.count(), 4);
+    QCOMPARE(m_buffer.lastIndex(), 3);
+    QCOMPARE(m_buffer.values(), QList<int>({0, 10, 40, 50}));
+}
+
+void KItemListRingBufferTest::testIterator()
+{
+    insertRange(3, 5);
+    m_buffer.insert(8, 80);
+
+    QList<int> keys;
+    QList<int> values;
+    KItemListRingBuffer<int>::Iterator it(m_buffer);
+
+    // Changing the buffer does not influence the iteration
+    m_buffer.clear();
+
+    while (it.hasNext()) {
+        it.next();
+        keys.append(it.key());
+        values.append(it.value());
+    }
+
+    QCOMPARE(keys, QList<int>({3, 4, 5, 8}));
+    QCOMPARE(values, QList<int>({30, 40, 50, 80}));
+
+    KItemListRingBuffer<int>::Iterator emptyIt(m_buffer);
+    QVERIFY(!emptyIt.hasNext());
+}
+
+QTEST_GUILESS_MAIN(KItemListRingBufferTest)
+
+#include "kitemlistringbuffertest.moc"
@@ -0,0 +1,258 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/kitemmodelbase.h"
+#include "kitemviews/kitemlistselectionmanager.h"
+
+#include <QTest>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+class DummyModel : public KItemModelBase
+{
+    Q_OBJECT
+public:
+    DummyModel();
+    void setCount(int count);
+    int count() const override;
+    QHash<QByteArray, QVariant> data(int index) const override;
+
+private:
+    int m_count;
+};
+
+DummyModel::DummyModel() :
+    KItemModelBase(),
+    m_count(0)
+{
+}
+
+void DummyModel::setCount(int count)
+{
+    m_count = count;
+}
+
+int DummyModel::count() const
+{
+    return m_count;
+}
+
+QHash<QByteArray, QVariant> DummyModel::data(int index) const
+{
+    Q_UNUSED(index)
+    return QHash<QByteArray, QVariant>();
+}
+
+namespace {
+    // A fixed seed keeps the results comparable between runs
+    const unsigned int Seed = 42;
+
+    /**
+     * @return A selection of the \a count items of the form \a selection:
+     *         - "all":      all items (one range)
+     *         - "half":     the first half of the items (one range)
+     *         - "resorted": a random half of the items, like the selection
+     *                       of the "half" case after the items have been
+     *                       resorted by another role
+     */
+    KItemSet createSelection(const QByteArray& selection, int count)
+    {
+        KItemSet items;
+        if (selection == "all") {
+            items = KItemSet(KItemRangeList() << KItemRange(0, count));
+        } else if (selection == "half") {
+            items = KItemSet(KItemRangeList() << KItemRange(0, count / 2));
+        } else {
+            std::mt19937 generator(Seed);
+            std::bernoulli_distribution selected(0.5);
+            for (int i = 0; i < count; ++i) {
+                if (selected(generator)) {
+                    items.insert(i);
+                }
+            }
+        }
+        return items;
+    }
+
+    /**
+     * @return \a rangeCount ranges with one item each, that are spread
+     *         over the \a count items.
+     */
+    KItemRangeList spreadRanges(int count, int rangeCount)
+    {
+        KItemRangeList itemRanges;
+        const int step = qMax(2, count / rangeCount);
+        for (int index = 0; index < count && itemRanges.count() < rangeCount; index += step) {
+            itemRanges.append(KItemRange(index, 1));
+        }
+        return itemRanges;
+    }
+}
+
+/**
+ * Measures how KItemListSelectionManager updates large selections if the
+ * model inserts, removes or moves items, and how fast an anchored selection
+ * that spans all items is resolved. Every change of the model or the
+ * selection in the view passes through these functions.
+ */
+class KItemListSelectionManagerBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void itemsInserted_data();
+    void itemsInserted();
+    void itemsRemoved_data();
+    void itemsRemoved();
+    void itemsMoved_data();
+    void itemsMoved();
+    void anchoredSelection_data();
+    void anchoredSelection();
+
+private:
+    static void addSelectionRows(const QList<int>& counts);
+
+    DummyModel* m_model;
+    KItemListSelectionManager* m_selectionManager;
+};
+
+void KItemListSelectionManagerBenchmark::init()
+{
+    m_model = new DummyModel();
+    m_selectionManager = new KItemListSelectionManager();
+    m_selectionManager->setModel(m_model);
+}
+
+void KItemListSelectionManagerBenchmark::cleanup()
+{
+    delete m_selectionManager;
+    m_selectionManager = nullptr;
+    delete m_model;
+    m_model = nullptr;
+}
+
+void KItemListSelectionManagerBenchmark::addSelectionRows(const QList<int>& counts)
+{
+    QTest::addColumn<QByteArray>("selection");
+    QTest::addColumn<int>("count");
+
+    const QList<QByteArray> selections = {"all", "half", "resorted"};
+    for (const QByteArray& selection : selections) {
+        for (int count : counts) {
+            QTest::newRow(QByteArray(selection + ' ' + QByteArray::number(count)).constData()) << selection << count;
+        }
+    }
+}
+
+void KItemListSelectionManagerBenchmark::itemsInserted_data()
+{
+    addSelectionRows({100000, 1000000});
+}
+
+void KItemListSelectionManagerBenchmark::itemsInserted()
+{
+    QFETCH(QByteArray, selection);
+    QFETCH(int, count);
+
+    const KItemSet selectedItems = createSelection(selection, count);
+    const KItemRangeList insertedRanges = spreadRanges(count, 1000);
+    m_model->setCount(count + insertedRanges.count());
+
+    QBENCHMARK {
+        m_selectionManager->setSelectedItems(selectedItems);
+        m_selectionManager->setCurrentItem(count / 2);
+        m_selectionManager->itemsInserted(insertedRanges);
+    }
+    QCOMPARE(m_selectionManager->selectedItems().count(), selectedItems.count());
+}
+
+void KItemListSelectionManagerBenchmark::itemsRemoved_data()
+{
+    addSelectionRows({100000, 1000000});
+}
+
+void KItemListSelectionManagerBenchmark::itemsRemoved()
+{
+    QFETCH(QByteArray, selection);
+    QFETCH(int, count);
+
+    const KItemSet selectedItems = createSelection(selection, count);
+    const KItemRangeList removedRanges = spreadRanges(count, 1000);
+
+    QBENCHMARK {
+        // The current item must be valid before the removing
+        m_model->setCount(count);
+        m_selectionManager->setSelectedItems(selectedItems);
+        m_selectionManager->setCurrentItem(count / 2 + 1);
+        m_model->setCount(count - removedRanges.count());
+        m_selectionManager->itemsRemoved(removedRanges);
+    }
+}
+
+void KItemListSelectionManagerBenchmark::itemsMoved_data()
+{
+    addSelectionRows({100000, 1000000});
+}
+
+void KItemListSelectionManagerBenchmark::itemsMoved()
+{
+    QFETCH(QByteArray, selection);
+    QFETCH(int, count);
+
+    // A resort moves all items to random positions
+    QList<int> movedToIndexes;
+    movedToIndexes.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        movedToIndexes.append(i);
+    }
+    std::mt19937 generator(Seed);
+    std::shuffle(movedToIndexes.begin(), movedToIndexes.end(), generator);
+
+    const KItemSet selectedItems = createSelection(selection, count);
+    m_model->setCount(count);
+
+    QBENCHMARK {
+        m_selectionManager->setSelectedItems(selectedItems);
+        m_selectionManager->setCurrentItem(0);
+        m_selectionManager->itemsMoved(KItemRange(0, count), movedToIndexes);
+    }
+    QCOMPARE(m_selectionManager->selectedItems().count(), selectedItems.count());
+}
+
+void KItemListSelectionManagerBenchmark::anchoredSelection_data()
+{
+    addSelectionRows({1000000});
+}
+
+void KItemListSelectionManagerBenchmark::anchoredSelection()
+{
+    QFETCH(QByteArray, selection);
+    QFETCH(int, count);
+
+    // Shift-clicking the last item after the first one, with an existing
+    // selection that has been made with Ctrl before
+    const KItemSet selectedItems = createSelection(selection, count);
+    m_model->setCount(count);
+
+    QBENCHMARK {
+        m_selectionManager->setSelectedItems(selectedItems);
+        m_selectionManager->setCurrentItem(0);
+        m_selectionManager->beginAnchoredSelection(0);
+        m_selectionManager->setCurrentItem(count - 1);
+        QVERIFY(m_selectionManager->isSelected(count / 2));
+        m_selectionManager->endAnchoredSelection();
+    }
+    QCOMPARE(m_selectionManager->selectedItems().count(), count);
+}
+
+QTEST_GUILESS_MAIN(KItemListSelectionManagerBenchmark)
+
+#include "kitemlistselectionmanagerbenchmark.moc"
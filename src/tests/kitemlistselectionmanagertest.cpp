@@ -62,6 +62,7 @@ private Q_SLOTS:
     void testCurrentItemAnchorItem();
     void testSetSelected_data();
     void testSetSelected();
+    void testSetSelectedItemSet();
     void testItemsInserted();
     void testItemsRemoved();
     void testAnchoredSelection();
@@ -205,6 +206,27 @@ void KItemListSelectionManagerTest::testSetSelected()
     QCOMPARE(m_selectionManager->selectedItems().count(), expectedSelectionCount);
 }
 
+void KItemListSelectionManagerTest::testSetSelectedItemSet()
+{
+    QSignalSpy spySelectionChanged(m_selectionManager, &KItemListSelectionManager::selectionChanged);
+
+    const KItemSet items(KItemRangeList() << KItemRange(10, 5) << KItemRange(50, 10));
+    m_selectionManager->setSelected(items);
+    QCOMPARE(m_selectionManager->selectedItems(), items);
+    QCOMPARE(spySelectionChanged.count(), 1);
+
+    // Toggling all items inverts the selection
+    m_selectionManager->setSelected(KItemSet(KItemRangeList() << KItemRange(0, 100)), KItemListSelectionManager::Toggle);
+    QCOMPARE(m_selectionManager->selectedItems(),
+             KItemSet(KItemRangeList() << KItemRange(0, 10) << KItemRange(15, 35) << KItemRange(60, 40)));
+    QCOMPARE(spySelectionChanged.count(), 2);
+
+    m_selectionManager->setSelected(KItemSet(KItemRangeList() << KItemRange(0, 15)), KItemListSelectionManager::Deselect);
+    QCOMPARE(m_selectionManager->selectedItems(),
+             KItemSet(KItemRangeList() << KItemRange(15, 35) << KItemRange(60, 40)));
+    QCOMPARE(spySelectionChanged.count(), 3);
+}
+
 void KItemListSelectionManagerTest::testItemsInserted()
 {
     // Select items 10 to 12
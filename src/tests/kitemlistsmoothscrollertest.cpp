@@ -0,0 +1,118 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kitemlistsmoothscroller.h"
+
+#include <QScrollBar>
+#include <QTest>
+
+class KItemListSmoothScrollerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testWithoutAnimation();
+    void testCoalescedUpdates();
+    void testDisableUpdateInterval();
+
+private:
+    /**
+     * Moves the scrollbar to \a value and passes the distance to the
+     * smooth scroller, like KItemListContainer::scrollContentsBy() does.
+     */
+    void scrollTo(int value);
+
+    qreal offset() const;
+
+private:
+    QScrollBar* m_scrollBar;
+    QObject* m_target;
+    KItemListSmoothScroller* m_smoothScroller;
+};
+
+void KItemListSmoothScrollerTest::init()
+{
+    m_scrollBar = new QScrollBar(Qt::Vertical);
+    m_scrollBar->setRange(0, 1000);
+    m_target = new QObject();
+    m_target->setProperty("scrollOffset", 0.0);
+
+    m_smoothScroller = new KItemListSmoothScroller(m_scrollBar);
+    m_smoothScroller->setTargetObject(m_target);
+    m_smoothScroller->setPropertyName("scrollOffset");
+    m_smoothScroller->setAnimationEnabled(false);
+}
+
+void KItemListSmoothScrollerTest::cleanup()
+{
+    delete m_smoothScroller;
+    m_smoothScroller = nullptr;
+    delete m_target;
+    m_target = nullptr;
+    delete m_scrollBar;
+    m_scrollBar = nullptr;
+}
+
+void KItemListSmoothScrollerTest::testWithoutAnimation()
+{
+    // Each change is applied at once
+    scrollTo(10);
+    QCOMPARE(offset(), 10.0);
+    scrollTo(20);
+    QCOMPARE(offset(), 20.0);
+}
+
+void KItemListSmoothScrollerTest::testCoalescedUpdates()
+{
+    m_smoothScroller->setMinimumUpdateInterval(50);
+
+    // The first change is applied at once, the following ones after the interval
+    scrollTo(10);
+    QCOMPARE(offset(), 10.0);
+    scrollTo(20);
+    scrollTo(30);
+    QCOMPARE(offset(), 10.0);
+
+    // Only the last position of the scrollbar is applied
+    QTRY_COMPARE(offset(), 30.0);
+
+    // A change of the maximum of the scrollbar does not overwrite a pending position
+    scrollTo(40);
+    scrollTo(50);
+    QVERIFY(!m_smoothScroller->requestScrollBarUpdate(m_scrollBar->maximum()));
+    QTRY_COMPARE(offset(), 50.0);
+}
+
+void KItemListSmoothScrollerTest::testDisableUpdateInterval()
+{
+    m_smoothScroller->setMinimumUpdateInterval(1000);
+    scrollTo(10);
+    scrollTo(20);
+    QCOMPARE(offset(), 10.0);
+
+    // The pending position is applied without waiting for the interval
+    m_smoothScroller->setMinimumUpdateInterval(0);
+    QCOMPARE(offset(), 20.0);
+}
+
+void KItemListSmoothScrollerTest::scrollTo(int value)
+{
+    const int distance = m_scrollBar->value() - value;
+    m_scrollBar->setValue(value);
+    m_smoothScroller->scrollContentsBy(distance);
+}
+
+qreal KItemListSmoothScrollerTest::offset() const
+{
+    return m_target->property("scrollOffset").toReal();
+}
+
+QTEST_MAIN(KItemListSmoothScrollerTest)
+
+#include "kitemlistsmoothscrollertest.moc"
@@ -0,0 +1,533 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/*
+ * Measures the frame times of KFileItemListView for scripted scrolls, zooms,
+ * rubberband drags, resorts and insertions of single items and prints the percentiles as JSON, which
+ * allows to catch layout, text cache and paint regressions before a release.
+ * The view is shown in an offscreen KItemListContainer over a synthetic
+ * KFileItemModel, so neither a display nor files on the disk are required.
+ * Example:
+ *
+ *   kitemlistviewbenchmark --sizes 1000,100000 --layouts icons,details --font-sizes 10,16 --output results.json
+ */
+
+#include "benchmarkhelpers.h"
+#include "kitemviews/kfileitemlistview.h"
+#include "kitemviews/kfileitemmodel.h"
+#include "kitemviews/kitemlistcontainer.h"
+#include "kitemviews/kitemlistcontroller.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QGraphicsSceneMouseEvent>
+#include <QGraphicsView>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QTimer>
+
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+
+namespace {
+    const char* const DirectoryUrl = "file:///dolphin-benchmark";
+
+    // Size of the offscreen container in pixels
+    const int ContainerWidth = 1280;
+    const int ContainerHeight = 800;
+
+    // Number of frames of each scripted interaction
+    const int ScrollFrames = 120;
+    const int ZoomFrames = 24;
+    const int RubberBandFrames = 60;
+    const int ResortFrames = 6;
+    const int InsertFrames = 40;
+
+    // Time in ms for the roles updater and the animations to settle
+    // before an interaction is recorded
+    const int SettleTime = 300;
+
+    // Icon sizes of the zoom levels that are passed while zooming
+    const int ZoomIconSizes[] = {16, 22, 32, 48, 64, 96, 128, 192, 256};
+
+    /**
+     * Exposes the grid calculation of DolphinItemListView, which cannot be
+     * used without the view mode settings.
+     */
+    class BenchmarkItemListView : public KFileItemListView
+    {
+    public:
+        void setGrid(int iconSize, const QFont& font)
+        {
+            KItemListStyleOption option = styleOption();
+            option.font = font;
+            option.fontMetrics = QFontMetrics(font);
+
+            const int padding = 2;
+            int itemWidth = -1;
+            int itemHeight = -1;
+            option.horizontalMargin = 0;
+            option.verticalMargin = 0;
+            option.maxTextLines = 0;
+            option.maxTextWidth = 0;
+
+            switch (itemLayout()) {
+            case IconsLayout:
+                itemWidth = qMax(48 + 2 * 64 * option.fontMetrics.averageCharWidth() / 9, iconSize + padding * 2);
+                itemHeight = padding * 3 + iconSize + option.fontMetrics.lineSpacing();
+                option.horizontalMargin = 4;
+                option.verticalMargin = 8;
+                option.maxTextLines = 2;
+                break;
+            case CompactLayout:
+                itemWidth = padding * 4 + iconSize + option.fontMetrics.height() * 5;
+                itemHeight = padding * 2 + qMax(iconSize, visibleRoles().count() * option.fontMetrics.lineSpacing());
+                option.horizontalMargin = 8;
+                break;
+            case DetailsLayout:
+                itemHeight = padding * 2 + qMax(iconSize, option.fontMetrics.lineSpacing());
+                break;
+            }
+
+            option.padding = padding;
+            option.iconSize = iconSize;
+            beginTransaction();
+            setStyleOption(option);
+            setItemSize(QSizeF(itemWidth, itemHeight));
+            endTransaction();
+        }
+    };
+}
+
+/**
+ * @brief Runs the interactions and collects the frame times.
+ *
+ * A frame consists of one step of an interaction, processing the posted
+ * events and repainting the viewport synchronously. The 50th, 90th and 99th
+ * percentiles and the maximum of the frame times of each interaction are
+ * reported.
+ */
+class KItemListViewBenchmark
+{
+public:
+    explicit KItemListViewBenchmark(const QStringList& interactions);
+
+    void run(KFileItemListView::ItemLayout layout, int itemCount, int fontSize);
+    QJsonObject results() const;
+
+private:
+    void benchmarkScrolling();
+    void benchmarkZooming();
+    void benchmarkRubberBand();
+    void benchmarkResorting();
+
+    /**
+     * Inserts single items between the existing items and removes them
+     * again, like files that are created and deleted in the directory.
+     */
+    void benchmarkInserting();
+
+    bool isEnabled(const QString& interaction) const;
+
+    /**
+     * Performs one frame with the step \a step.
+     *
+     * @return Duration of the frame in nanoseconds.
+     */
+    qint64 frame(const std::function<void()>& step);
+
+    void addResult(const QString& interaction, const QVector<qint64>& samples);
+
+    /**
+     * @return Position in the view that is not above any item, where a
+     *         rubberband can be started. A null point is returned if the
+     *         visible items cover the whole view.
+     */
+    QPointF emptyPosition() const;
+
+    bool sendMouseEvent(QEvent::Type type, const QPointF& pos, Qt::MouseButtons buttons);
+
+    static void settle(int msecs);
+    static QString layoutName(KFileItemListView::ItemLayout layout);
+
+    /**
+     * @return Items with names, sizes and types like in real folders.
+     *         The result only depends on \a count.
+     */
+    static KFileItemList createItems(int count);
+
+    QStringList m_interactions;
+    QJsonArray m_results;
+
+    // Setup of the running benchmark
+    KFileItemListView::ItemLayout m_layout;
+    int m_itemCount;
+    int m_fontSize;
+    QFont m_font;
+    KFileItemModel* m_model;
+    BenchmarkItemListView* m_view;
+    KItemListController* m_controller;
+    QGraphicsView* m_graphicsView;
+};
+
+KItemListViewBenchmark::KItemListViewBenchmark(const QStringList& interactions) :
+    m_interactions(interactions),
+    m_results(),
+    m_layout(KFileItemListView::IconsLayout),
+    m_itemCount(0),
+    m_fontSize(0),
+    m_font(),
+    m_model(nullptr),
+    m_view(nullptr),
+    m_controller(nullptr),
+    m_graphicsView(nullptr)
+{
+}
+
+void KItemListViewBenchmark::run(KFileItemListView::ItemLayout layout, int itemCount, int fontSize)
+{
+    m_layout = layout;
+    m_itemCount = itemCount;
+    m_fontSize = fontSize;
+    m_font = QApplication::font();
+    m_font.setPointSize(fontSize);
+
+    std::unique_ptr<KFileItemModel> model(new KFileItemModel());
+    m_model = model.get();
+    BenchmarkHelpers::addItems(*m_model, createItems(itemCount));
+
+    m_view = new BenchmarkItemListView();
+    m_view->setItemLayout(layout);
+    if (layout == KFileItemListView::DetailsLayout) {
+        m_view->setVisibleRoles({"text", "size", "modificationtime", "type"});
+    } else {
+        m_view->setVisibleRoles({"text"});
+    }
+    m_view->setGrid(48, m_font);
+
+    m_controller = new KItemListController(m_model, m_view);
+    m_controller->setSelectionBehavior(KItemListController::MultiSelection);
+
+    std::unique_ptr<KItemListContainer> container(new KItemListContainer(m_controller));
+    container->resize(ContainerWidth, ContainerHeight);
+    container->show();
+    m_graphicsView = qobject_cast<QGraphicsView*>(container->viewport());
+    settle(SettleTime);
+
+    if (isEnabled(QStringLiteral("scroll"))) {
+        benchmarkScrolling();
+    }
+    if (isEnabled(QStringLiteral("zoom"))) {
+        benchmarkZooming();
+    }
+    if (isEnabled(QStringLiteral("rubberband"))) {
+        benchmarkRubberBand();
+    }
+    if (isEnabled(QStringLiteral("resort"))) {
+        benchmarkResorting();
+    }
+    if (isEnabled(QStringLiteral("insert"))) {
+        benchmarkInserting();
+    }
+
+    // The controller deletes the view later, which may not outlive the model
+    container.reset();
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+
+    m_graphicsView = nullptr;
+    m_controller = nullptr;
+    m_view = nullptr;
+    m_model = nullptr;
+}
+
+QJsonObject KItemListViewBenchmark::results() const
+{
+    QJsonObject object;
+    object.insert(QStringLiteral("benchmark"), QStringLiteral("kitemlistviewbenchmark"));
+    object.insert(QStringLiteral("qtVersion"), QString::fromLatin1(qVersion()));
+    object.insert(QStringLiteral("platform"), QApplication::platformName());
+    object.insert(QStringLiteral("results"), m_results);
+    return object;
+}
+
+void KItemListViewBenchmark::benchmarkScrolling()
+{
+    // Scroll by an eighth of a page per frame, like a smooth scroller,
+    // and start from the top again when the end has been reached.
+    const qreal step = m_view->size().height() / 8;
+    QVector<qint64> samples;
+    for (int i = 0; i < ScrollFrames; ++i) {
+        samples << frame([&]() {
+            const qreal offset = m_view->scrollOffset() + step;
+            m_view->setScrollOffset(offset > m_view->maximumScrollOffset() ? 0 : offset);
+        });
+    }
+    addResult(QStringLiteral("scroll"), samples);
+
+    m_view->setScrollOffset(0);
+    settle(SettleTime);
+}
+
+void KItemListViewBenchmark::benchmarkZooming()
+{
+    // Zoom in and out through all zoom levels
+    const int levelCount = sizeof(ZoomIconSizes) / sizeof(ZoomIconSizes[0]);
+    int level = 3;
+    int direction = 1;
+    QVector<qint64> samples;
+    for (int i = 0; i < ZoomFrames; ++i) {
+        if (level + direction < 0 || level + direction >= levelCount) {
+            direction = -direction;
+        }
+        level += direction;
+        samples << frame([&]() { m_view->setGrid(ZoomIconSizes[level], m_font); });
+    }
+    addResult(QStringLiteral("zoom"), samples);
+
+    m_view->setGrid(48, m_font);
+    settle(SettleTime);
+}
+
+void KItemListViewBenchmark::benchmarkRubberBand()
+{
+    const QPointF startPos = emptyPosition();
+    if (startPos.isNull()) {
+        fprintf(stderr, "rubberband %s n=%i: skipped, no empty space\n",
+                qPrintable(layoutName(m_layout)), m_itemCount);
+        return;
+    }
+
+    sendMouseEvent(QEvent::GraphicsSceneMousePress, startPos, Qt::LeftButton);
+
+    // Drag the rubberband to the opposite corner of the view and back
+    const QPointF endPos(m_view->size().width() - startPos.x(), m_view->size().height() - 1);
+    QVector<qint64> samples;
+    for (int i = 1; i <= RubberBandFrames; ++i) {
+        const qreal progress = 1.0 - qAbs(1.0 - 2.0 * i / RubberBandFrames);
+        const QPointF pos = startPos + (endPos - startPos) * progress;
+        samples << frame([&]() { sendMouseEvent(QEvent::GraphicsSceneMouseMove, pos, Qt::LeftButton); });
+    }
+    addResult(QStringLiteral("rubberband"), samples);
+
+    sendMouseEvent(QEvent::GraphicsSceneMouseRelease, startPos, Qt::NoButton);
+    m_controller->selectionManager()->clearSelection();
+    m_view->setScrollOffset(0);
+    settle(SettleTime);
+}
+
+void KItemListViewBenchmark::benchmarkResorting()
+{
+    const QList<QByteArray> sortRoles = {"size", "modificationtime", "text"};
+    QVector<qint64> samples;
+    for (int i = 0; i < ResortFrames; ++i) {
+        const QByteArray& role = sortRoles.at(i % sortRoles.count());
+        samples << frame([&]() {
+            m_model->setSortRole(role);
+            BenchmarkHelpers::finishResorting(*m_model);
+        });
+        // The items are moved by animations after resorting
+        settle(SettleTime);
+    }
+    addResult(QStringLiteral("resort"), samples);
+}
+
+void KItemListViewBenchmark::benchmarkInserting()
+{
+    // The names of the additional items are sorted between the existing ones
+    const KFileItemList items = createItems(m_itemCount + InsertFrames / 2).mid(m_itemCount);
+    if (items.isEmpty()) {
+        return;
+    }
+
+    m_model->setSortRole("text");
+    BenchmarkHelpers::finishResorting(*m_model);
+    settle(SettleTime);
+
+    QVector<qint64> samples;
+    for (int i = 0; i < InsertFrames; ++i) {
+        const KFileItem& item = items.at((i / 2) % items.count());
+        samples << frame([&]() {
+            if (i % 2 == 0) {
+                BenchmarkHelpers::addItems(*m_model, KFileItemList() << item);
+            } else {
+                BenchmarkHelpers::removeItems(*m_model, KFileItemList() << item);
+            }
+        });
+    }
+    addResult(QStringLiteral("insert"), samples);
+    settle(SettleTime);
+}
+
+bool KItemListViewBenchmark::isEnabled(const QString& interaction) const
+{
+    return m_interactions.isEmpty() || m_interactions.contains(interaction);
+}
+
+qint64 KItemListViewBenchmark::frame(const std::function<void()>& step)
+{
+    QElapsedTimer timer;
+    timer.start();
+    step();
+    QCoreApplication::processEvents();
+    m_graphicsView->viewport()->repaint();
+    return timer.nsecsElapsed();
+}
+
+void KItemListViewBenchmark::addResult(const QString& interaction, const QVector<qint64>& samples)
+{
+    if (samples.isEmpty()) {
+        return;
+    }
+
+    QJsonObject result = BenchmarkHelpers::percentiles(samples);
+    result.insert(QStringLiteral("interaction"), interaction);
+    result.insert(QStringLiteral("layout"), layoutName(m_layout));
+    result.insert(QStringLiteral("itemCount"), m_itemCount);
+    result.insert(QStringLiteral("fontSize"), m_fontSize);
+    result.insert(QStringLiteral("frames"), samples.count());
+    m_results << result;
+
+    fprintf(stderr, "%s %s n=%i font=%i: p50 %.1f ms, p99 %.1f ms\n", qPrintable(interaction),
+            qPrintable(layoutName(m_layout)), m_itemCount, m_fontSize,
+            result.value(QStringLiteral("p50Msecs")).toDouble(), result.value(QStringLiteral("p99Msecs")).toDouble());
+}
+
+QPointF KItemListViewBenchmark::emptyPosition() const
+{
+    const QSizeF size = m_view->size();
+    for (qreal y = 1; y < size.height(); y += 4) {
+        for (qreal x = size.width() - 1; x > 0; x -= 4) {
+            const QPointF pos(x, y);
+            if (m_view->itemAt(pos) < 0) {
+                return pos;
+            }
+        }
+    }
+    return QPointF();
+}
+
+bool KItemListViewBenchmark::sendMouseEvent(QEvent::Type type, const QPointF& pos, Qt::MouseButtons buttons)
+{
+    QGraphicsSceneMouseEvent event(type);
+    event.setPos(pos);
+    event.setScenePos(pos);
+    event.setButton(type == QEvent::GraphicsSceneMouseMove ? Qt::NoButton : Qt::LeftButton);
+    event.setButtons(buttons);
+    return m_controller->processEvent(&event, QTransform());
+}
+
+void KItemListViewBenchmark::settle(int msecs)
+{
+    QEventLoop loop;
+    QTimer::singleShot(msecs, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+QString KItemListViewBenchmark::layoutName(KFileItemListView::ItemLayout layout)
+{
+    switch (layout) {
+    case KFileItemListView::IconsLayout:   return QStringLiteral("icons");
+    case KFileItemListView::CompactLayout: return QStringLiteral("compact");
+    case KFileItemListView::DetailsLayout: return QStringLiteral("details");
+    }
+    return QString();
+}
+
+KFileItemList KItemListViewBenchmark::createItems(int count)
+{
+    static const QList<QPair<QString, QString> > types = {
+        {QStringLiteral("IMG_%1.jpg"), QStringLiteral("image/jpeg")},
+        {QStringLiteral("Report %1 (final draft).pdf"), QStringLiteral("application/pdf")},
+        {QStringLiteral("notes_%1.txt"), QStringLiteral("text/plain")},
+        {QStringLiteral("Übersicht der Ergebnisse %1.odt"), QStringLiteral("application/vnd.oasis.opendocument.text")},
+        {QStringLiteral("project %1"), QStringLiteral("inode/directory")},
+    };
+
+    std::mt19937 random(count);
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+
+    KFileItemList items;
+    items.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const auto& type = types.at(i % types.count());
+        const qint64 size = std::uniform_int_distribution<qint64>(0, 1 << 30)(random);
+        const qint64 modificationTime = now - std::uniform_int_distribution<qint64>(0, 1 << 26)(random);
+        items << BenchmarkHelpers::createItem(QUrl(DirectoryUrl), type.first.arg(i), type.second, size, modificationTime);
+    }
+
+    return items;
+}
+
+int main(int argc, char** argv)
+{
+    // The view is shown offscreen, so that no display is required and
+    // the frame times are not influenced by the compositor
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QApplication app(argc, argv);
+    QStandardPaths::setTestModeEnabled(true);
+    BenchmarkHelpers::installMessageHandler();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Measures the frame times of KFileItemListView for scripted interactions."));
+    parser.addHelpOption();
+    const QCommandLineOption sizesOption(QStringLiteral("sizes"),
+                                         QStringLiteral("Comma separated numbers of items."),
+                                         QStringLiteral("sizes"), QStringLiteral("1000,100000"));
+    const QCommandLineOption layoutsOption(QStringLiteral("layouts"),
+                                           QStringLiteral("Comma separated view modes: icons, compact, details."),
+                                           QStringLiteral("layouts"), QStringLiteral("icons,compact,details"));
+    const QCommandLineOption fontSizesOption(QStringLiteral("font-sizes"),
+                                             QStringLiteral("Comma separated font sizes in points."),
+                                             QStringLiteral("sizes"), QStringLiteral("10,16"));
+    const QCommandLineOption interactionsOption(QStringLiteral("interactions"),
+                                                QStringLiteral("Comma separated interactions: scroll, zoom, rubberband, resort, insert. All by default."),
+                                                QStringLiteral("interactions"));
+    const QCommandLineOption outputOption(QStringLiteral("output"),
+                                          QStringLiteral("Writes the JSON results to the file instead of stdout."),
+                                          QStringLiteral("file"));
+    parser.addOptions({sizesOption, layoutsOption, fontSizesOption, interactionsOption, outputOption});
+    parser.process(app);
+
+    const QStringList interactions = parser.value(interactionsOption).split(QLatin1Char(','), Qt::SkipEmptyParts);
+    KItemListViewBenchmark benchmark(interactions);
+
+    const QStringList layouts = parser.value(layoutsOption).split(QLatin1Char(','), Qt::SkipEmptyParts);
+    const QStringList sizes = parser.value(sizesOption).split(QLatin1Char(','), Qt::SkipEmptyParts);
+    const QStringList fontSizes = parser.value(fontSizesOption).split(QLatin1Char(','), Qt::SkipEmptyParts);
+    for (const QString& layoutName : layouts) {
+        KFileItemListView::ItemLayout layout;
+        if (layoutName == QLatin1String("icons")) {
+            layout = KFileItemListView::IconsLayout;
+        } else if (layoutName == QLatin1String("compact")) {
+            layout = KFileItemListView::CompactLayout;
+        } else if (layoutName == QLatin1String("details")) {
+            layout = KFileItemListView::DetailsLayout;
+        } else {
+            fprintf(stderr, "Unknown layout %s\n", qPrintable(layoutName));
+            return 1;
+        }
+
+        for (const QString& size : sizes) {
+            const int itemCount = size.toInt();
+            for (const QString& fontSize : fontSizes) {
+                if (itemCount > 0 && fontSize.toInt() > 0) {
+                    benchmark.run(layout, itemCount, fontSize.toInt());
+                }
+            }
+        }
+    }
+
+    return BenchmarkHelpers::writeResults(benchmark.results(), parser.value(outputOption));
+}
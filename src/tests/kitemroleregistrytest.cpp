@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kitemroleregistry.h"
+
+#include <QSet>
+#include <QTest>
+#include <QtConcurrentMap>
+
+class KItemRoleRegistryTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testBuiltInRoles();
+    void testRegisterRole();
+    void testSharedData();
+    void testConcurrentRegistration();
+};
+
+void KItemRoleRegistryTest::testBuiltInRoles()
+{
+    QVERIFY(KItemRoleRegistry::isBuiltIn("text"));
+    QVERIFY(KItemRoleRegistry::isBuiltIn("url"));
+    QVERIFY(KItemRoleRegistry::isBuiltIn("expandedParentsCount"));
+
+    const int id = KItemRoleRegistry::id("text");
+    QVERIFY(id >= 0);
+    QCOMPARE(KItemRoleRegistry::name(id), QByteArray("text"));
+    QCOMPARE(KItemRoleRegistry::id(""), -1);
+    QCOMPARE(KItemRoleRegistry::name(-1), QByteArray());
+}
+
+void KItemRoleRegistryTest::testRegisterRole()
+{
+    QVERIFY(!KItemRoleRegistry::isBuiltIn("registryTestRole"));
+
+    const int count = KItemRoleRegistry::count();
+    const int id = KItemRoleRegistry::id("registryTestRole");
+    QCOMPARE(id, count);
+    QCOMPARE(KItemRoleRegistry::count(), count + 1);
+    QCOMPARE(KItemRoleRegistry::id("registryTestRole"), id);
+    QCOMPARE(KItemRoleRegistry::name(id), QByteArray("registryTestRole"));
+    QCOMPARE(KItemRoleRegistry::name(count + 1), QByteArray());
+}
+
+void KItemRoleRegistryTest::testSharedData()
+{
+    const QByteArray a = KItemRoleRegistry::intern(QByteArray("size"));
+    const QByteArray b = KItemRoleRegistry::intern(QByteArray("size"));
+    QCOMPARE(a.constData(), b.constData());
+
+    const QByteArray c = KItemRoleRegistry::intern(QByteArray("registryTestSharedRole"));
+    const QByteArray d = KItemRoleRegistry::intern(QByteArray("registryTestSharedRole"));
+    QCOMPARE(c.constData(), d.constData());
+}
+
+void KItemRoleRegistryTest::testConcurrentRegistration()
+{
+    QVector<QByteArray> roles;
+    for (int i = 0; i < 1000; ++i) {
+        roles.append("registryTestConcurrentRole" + QByteArray::number(i % 50));
+    }
+
+    const QVector<int> ids = QtConcurrent::blockingMapped<QVector<int>>(roles, [](const QByteArray& role) {
+        return KItemRoleRegistry::id(role);
+    });
+
+    // Each role must have got exactly one id
+    for (int i = 0; i < roles.count(); ++i) {
+        QCOMPARE(ids.at(i), KItemRoleRegistry::id(roles.at(i)));
+        QCOMPARE(KItemRoleRegistry::name(ids.at(i)), roles.at(i));
+    }
+    QCOMPARE(QSet<int>(ids.begin(), ids.end()).count(), 50);
+}
+
+QTEST_GUILESS_MAIN(KItemRoleRegistryTest)
+
+#include "kitemroleregistrytest.moc"
@@ -0,0 +1,194 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/kitemset.h"
+
+#include <QTest>
+
+#include <algorithm>
+#include <random>
+
+namespace {
+    /**
+     * @return The indexes of \a count items in the order of the pattern
+     *         \a pattern:
+     *         - "contiguous":          0, 1, 2, ... (one range)
+     *         - "contiguous-reversed": count - 1, ..., 1, 0 (one range, every insert extends it at the front)
+     *         - "fragmented":          0, 2, 4, ... (one range per item)
+     *         - "fragmented-random":   the indexes of "fragmented" in a random order,
+     *                                  like a selection after a resort
+     */
+    QVector<int> patternIndexes(const QByteArray& pattern, int count)
+    {
+        QVector<int> indexes;
+        indexes.reserve(count);
+        if (pattern.startsWith("contiguous")) {
+            for (int i = 0; i < count; ++i) {
+                indexes.append(i);
+            }
+            if (pattern == "contiguous-reversed") {
+                std::reverse(indexes.begin(), indexes.end());
+            }
+        } else {
+            for (int i = 0; i < count; ++i) {
+                indexes.append(2 * i);
+            }
+            if (pattern == "fragmented-random") {
+                // A fixed seed keeps the results comparable between runs
+                std::mt19937 generator(42);
+                std::shuffle(indexes.begin(), indexes.end(), generator);
+            }
+        }
+        return indexes;
+    }
+}
+
+/**
+ * Measures the basic operations of KItemSet, which stores the selection of
+ * the views as sorted ranges. Contiguous selections consist of one range,
+ * fragmented selections of one range per item.
+ */
+class KItemSetBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void insert_data();
+    void insert();
+    void contains_data();
+    void contains();
+    void remove_data();
+    void remove();
+    void shiftedForInsertedRanges_data();
+    void shiftedForInsertedRanges();
+
+private:
+    static void addPatternRows(const QList<int>& counts);
+};
+
+void KItemSetBenchmark::addPatternRows(const QList<int>& counts)
+{
+    QTest::addColumn<QByteArray>("pattern");
+    QTest::addColumn<int>("count");
+
+    const QList<QByteArray> patterns = {"contiguous", "contiguous-reversed", "fragmented", "fragmented-random"};
+    for (const QByteArray& pattern : patterns) {
+        for (int count : counts) {
+            QTest::newRow(QByteArray(pattern + ' ' + QByteArray::number(count)).constData()) << pattern << count;
+        }
+    }
+}
+
+void KItemSetBenchmark::insert_data()
+{
+    addPatternRows({10000, 100000});
+}
+
+void KItemSetBenchmark::insert()
+{
+    QFETCH(QByteArray, pattern);
+    QFETCH(int, count);
+
+    const QVector<int> indexes = patternIndexes(pattern, count);
+
+    QBENCHMARK {
+        KItemSet itemSet;
+        for (int index : indexes) {
+            itemSet.insert(index);
+        }
+        QCOMPARE(itemSet.count(), count);
+    }
+}
+
+void KItemSetBenchmark::contains_data()
+{
+    addPatternRows({10000, 1000000});
+}
+
+void KItemSetBenchmark::contains()
+{
+    QFETCH(QByteArray, pattern);
+    QFETCH(int, count);
+
+    const QVector<int> indexes = patternIndexes(pattern, count);
+    KItemSet itemSet;
+    for (int index : indexes) {
+        itemSet.insert(index);
+    }
+
+    // Every second lookup misses for the fragmented patterns
+    const int lastIndex = itemSet.last();
+    int found = 0;
+    QBENCHMARK {
+        found = 0;
+        for (int i = 0; i <= lastIndex; ++i) {
+            if (itemSet.contains(i)) {
+                ++found;
+            }
+        }
+    }
+    QCOMPARE(found, count);
+}
+
+void KItemSetBenchmark::remove_data()
+{
+    addPatternRows({10000, 100000});
+}
+
+void KItemSetBenchmark::remove()
+{
+    QFETCH(QByteArray, pattern);
+    QFETCH(int, count);
+
+    const QVector<int> indexes = patternIndexes(pattern, count);
+    KItemSet initialSet;
+    for (int index : indexes) {
+        initialSet.insert(index);
+    }
+
+    // The copying of the set is measured too, but it is cheap compared to
+    // the removing of all items
+    QBENCHMARK {
+        KItemSet itemSet = initialSet;
+        for (int index : indexes) {
+            itemSet.remove(index);
+        }
+        QVERIFY(itemSet.isEmpty());
+    }
+}
+
+void KItemSetBenchmark::shiftedForInsertedRanges_data()
+{
+    addPatternRows({10000, 1000000});
+}
+
+void KItemSetBenchmark::shiftedForInsertedRanges()
+{
+    QFETCH(QByteArray, pattern);
+    QFETCH(int, count);
+
+    const QVector<int> indexes = patternIndexes(pattern, count);
+    KItemSet itemSet;
+    for (int index : indexes) {
+        itemSet.insert(index);
+    }
+
+    // Inserts 1000 single items that are spread over the whole set
+    KItemRangeList insertedRanges;
+    const int step = qMax(1, (itemSet.last() + 1) / 1000);
+    for (int index = 0; index <= itemSet.last(); index += step) {
+        insertedRanges.append(KItemRange(index, 1));
+    }
+
+    QBENCHMARK {
+        const KItemSet shiftedSet = itemSet.shiftedForInsertedRanges(insertedRanges);
+        QCOMPARE(shiftedSet.count(), count);
+    }
+}
+
+QTEST_GUILESS_MAIN(KItemSetBenchmark)
+
+#include "kitemsetbenchmark.moc"
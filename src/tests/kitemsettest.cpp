@@ -9,6 +9,8 @@
 #include <QStandardPaths>
 #include <QTest>
 
+#include <algorithm>
+
 Q_DECLARE_METATYPE(KItemRangeList)
 
 /**
@@ -98,12 +100,17 @@ private Q_SLOTS:
     void testChangingOneItem();
     void testAddSets_data();
     void testAddSets();
-    /*
     void testSubtractSets_data();
     void testSubtractSets();
-    */
     void testSymmetricDifference_data();
     void testSymmetricDifference();
+    void testIntersectSets_data();
+    void testIntersectSets();
+    void testShiftForInsertedRanges_data();
+    void testShiftForInsertedRanges();
+    void testShiftForRemovedRanges_data();
+    void testShiftForRemovedRanges();
+    void testPermuted();
 
 private:
     QHash<const char*, KItemRangeList> m_testCases;
@@ -154,6 +161,14 @@ void KItemSetTest::testConstruction()
     QVERIFY(itemSet.count() == itemsQSet.count());
     QCOMPARE(KItemSet2QSet(itemSet), itemsQSet);
 
+    // Test the construction from the ranges, also if the
+    // ranges are unsorted and overlap.
+    QCOMPARE(KItemSet(itemRanges), itemSet);
+    KItemRangeList shuffledRanges = itemRanges;
+    std::reverse(shuffledRanges.begin(), shuffledRanges.end());
+    shuffledRanges << itemRanges;
+    QCOMPARE(KItemSet(shuffledRanges), itemSet);
+
     // Test copy constructor.
     KItemSet copy(itemSet);
     QCOMPARE(itemSet, copy);
@@ -546,6 +561,30 @@ void KItemSetTest::testAddSets()
     QCOMPARE(KItemSet2QSet(sum), sumQSet);
 }
 
+void KItemSetTest::testSubtractSets_data()
+{
+    testAddSets_data();
+}
+
+void KItemSetTest::testSubtractSets()
+{
+    QFETCH(KItemRangeList, itemRanges1);
+    QFETCH(KItemRangeList, itemRanges2);
+
+    KItemSet itemSet1 = KItemRangeList2KItemSet(itemRanges1);
+    QSet<int> itemsQSet1 = KItemRangeList2QSet(itemRanges1);
+
+    KItemSet itemSet2 = KItemRangeList2KItemSet(itemRanges2);
+    QSet<int> itemsQSet2 = KItemRangeList2QSet(itemRanges2);
+
+    KItemSet difference = itemSet1 - itemSet2;
+    QSet<int> differenceQSet = itemsQSet1 - itemsQSet2;
+
+    QVERIFY(difference.isValid());
+    QCOMPARE(difference.count(), differenceQSet.count());
+    QCOMPARE(KItemSet2QSet(difference), differenceQSet);
+}
+
 void KItemSetTest::testSymmetricDifference_data()
 {
     QTest::addColumn<KItemRangeList>("itemRanges1");
@@ -594,6 +633,171 @@ void KItemSetTest::testSymmetricDifference()
     QCOMPARE(itemSet2 ^ symmetricDifference, itemSet1);
 }
 
+void KItemSetTest::testIntersectSets_data()
+{
+    testAddSets_data();
+}
+
+void KItemSetTest::testIntersectSets()
+{
+    QFETCH(KItemRangeList, itemRanges1);
+    QFETCH(KItemRangeList, itemRanges2);
+
+    KItemSet itemSet1 = KItemRangeList2KItemSet(itemRanges1);
+    QSet<int> itemsQSet1 = KItemRangeList2QSet(itemRanges1);
+
+    KItemSet itemSet2 = KItemRangeList2KItemSet(itemRanges2);
+    QSet<int> itemsQSet2 = KItemRangeList2QSet(itemRanges2);
+
+    KItemSet intersection = itemSet1 & itemSet2;
+    QSet<int> intersectionQSet = itemsQSet1 & itemsQSet2;
+
+    QVERIFY(intersection.isValid());
+    QCOMPARE(KItemSet2QSet(intersection), intersectionQSet);
+
+    // Check commutativity.
+    QCOMPARE(itemSet2 & itemSet1, intersection);
+
+    // The set is the union of the intersection and the difference.
+    QCOMPARE(intersection + (itemSet1 - itemSet2), itemSet1);
+}
+
+void KItemSetTest::testShiftForInsertedRanges_data()
+{
+    QTest::addColumn<KItemRangeList>("itemRanges");
+    QTest::addColumn<KItemRangeList>("insertedRanges");
+
+    const KItemRangeList insertedRanges[] = {
+        KItemRangeList() << KItemRange(0, 1),
+        KItemRangeList() << KItemRange(2, 3),
+        KItemRangeList() << KItemRange(1, 1) << KItemRange(5, 2) << KItemRange(9, 1),
+        KItemRangeList() << KItemRange(-5, 2) << KItemRange(20, 4)
+    };
+
+    QHash<const char*, KItemRangeList>::const_iterator it = m_testCases.constBegin();
+    const QHash<const char*, KItemRangeList>::const_iterator end = m_testCases.constEnd();
+
+    while (it != end) {
+        for (int i = 0; i < 4; ++i) {
+            QByteArray name = it.key() + QByteArray(" inserted ") + QByteArray::number(i);
+            QTest::newRow(name) << it.value() << insertedRanges[i];
+        }
+        ++it;
+    }
+}
+
+void KItemSetTest::testShiftForInsertedRanges()
+{
+    QFETCH(KItemRangeList, itemRanges);
+    QFETCH(KItemRangeList, insertedRanges);
+
+    const KItemSet itemSet = KItemRangeList2KItemSet(itemRanges);
+
+    QSet<int> expected;
+    for (int index : KItemRangeList2QVector(itemRanges)) {
+        int inc = 0;
+        for (const KItemRange& range : qAsConst(insertedRanges)) {
+            if (index < range.index) {
+                break;
+            }
+            inc += range.count;
+        }
+        expected.insert(index + inc);
+    }
+
+    const KItemSet shifted = itemSet.shiftedForInsertedRanges(insertedRanges);
+    QVERIFY(shifted.isValid());
+    QCOMPARE(KItemSet2QSet(shifted), expected);
+}
+
+void KItemSetTest::testShiftForRemovedRanges_data()
+{
+    QTest::addColumn<KItemRangeList>("itemRanges");
+    QTest::addColumn<KItemRangeList>("removedRanges");
+
+    const KItemRangeList removedRanges[] = {
+        KItemRangeList() << KItemRange(0, 1),
+        KItemRangeList() << KItemRange(3, 1),
+        KItemRangeList() << KItemRange(2, 3),
+        KItemRangeList() << KItemRange(1, 1) << KItemRange(5, 2) << KItemRange(9, 1),
+        KItemRangeList() << KItemRange(-5, 2) << KItemRange(20, 4)
+    };
+
+    QHash<const char*, KItemRangeList>::const_iterator it = m_testCases.constBegin();
+    const QHash<const char*, KItemRangeList>::const_iterator end = m_testCases.constEnd();
+
+    while (it != end) {
+        for (int i = 0; i < 5; ++i) {
+            QByteArray name = it.key() + QByteArray(" removed ") + QByteArray::number(i);
+            QTest::newRow(name) << it.value() << removedRanges[i];
+        }
+        ++it;
+    }
+}
+
+void KItemSetTest::testShiftForRemovedRanges()
+{
+    QFETCH(KItemRangeList, itemRanges);
+    QFETCH(KItemRangeList, removedRanges);
+
+    const KItemSet itemSet = KItemRangeList2KItemSet(itemRanges);
+
+    QSet<int> expected;
+    for (int index : KItemRangeList2QVector(itemRanges)) {
+        int dec = 0;
+        bool removed = false;
+        for (const KItemRange& range : qAsConst(removedRanges)) {
+            if (index < range.index) {
+                break;
+            }
+            if (index < range.index + range.count) {
+                removed = true;
+                break;
+            }
+            dec += range.count;
+        }
+        if (!removed) {
+            expected.insert(index - dec);
+        }
+    }
+
+    const KItemSet shifted = itemSet.shiftedForRemovedRanges(removedRanges);
+    QVERIFY(shifted.isValid());
+    QCOMPARE(KItemSet2QSet(shifted), expected);
+}
+
+void KItemSetTest::testPermuted()
+{
+    const KItemRange movedRange(2, 4);
+    const QList<int> movedToIndexes = {5, 2, 4, 3};
+
+    // Ranges that contain the moved range are not changed
+    const KItemSet allItems(KItemRangeList() << KItemRange(0, 10));
+    QCOMPARE(allItems.permuted(movedRange, movedToIndexes), allItems);
+
+    // Ranges outside of the moved range are not changed
+    const KItemSet outsideItems(KItemRangeList() << KItemRange(0, 2) << KItemRange(7, 3));
+    QCOMPARE(outsideItems.permuted(movedRange, movedToIndexes), outsideItems);
+
+    // 1 -> 1, 2 -> 5, 3 -> 2, 7 -> 7
+    KItemSet itemSet;
+    itemSet << 1 << 2 << 3 << 7;
+    KItemSet expected;
+    expected << 1 << 2 << 5 << 7;
+    KItemSet permuted = itemSet.permuted(movedRange, movedToIndexes);
+    QVERIFY(permuted.isValid());
+    QCOMPARE(permuted, expected);
+
+    // 0 -> 0, 1 -> 1, 3 -> 2, 4 -> 4, 5 -> 3
+    itemSet.clear();
+    itemSet << 0 << 1 << 3 << 4 << 5;
+    expected.clear();
+    expected << 0 << 1 << 2 << 3 << 4;
+    permuted = itemSet.permuted(movedRange, movedToIndexes);
+    QVERIFY(permuted.isValid());
+    QCOMPARE(permuted, expected);
+}
+
 
 QTEST_GUILESS_MAIN(KItemSetTest)
 
@@ -0,0 +1,142 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kitemstateflags.h"
+
+#include <QTest>
+
+namespace {
+    const quint8 FlagA = 0x1;
+    const quint8 FlagB = 0x4;
+}
+
+class KItemStateFlagsTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testSetFlag();
+    void testInsertItems();
+    void testRemoveItems();
+    void testMoveItems();
+    void testFirstIndexWithFlag();
+    void testClearFlag();
+};
+
+void KItemStateFlagsTest::testSetFlag()
+{
+    KItemStateFlags flags(5);
+    QCOMPARE(flags.count(), 5);
+    QCOMPARE(flags.flagCount(FlagA), 0);
+
+    flags.setFlag(1, FlagA);
+    flags.setFlag(1, FlagA);
+    flags.setFlag(3, FlagA);
+    flags.setFlag(3, FlagB);
+    QVERIFY(flags.testFlag(1, FlagA));
+    QVERIFY(!flags.testFlag(1, FlagB));
+    QCOMPARE(flags.flagCount(FlagA), 2);
+    QCOMPARE(flags.flagCount(FlagB), 1);
+    QCOMPARE(flags.indexesWithFlag(FlagA), QVector<int>({1, 3}));
+
+    flags.setFlag(1, FlagA, false);
+    flags.setFlag(2, FlagA, false);
+    QCOMPARE(flags.flagCount(FlagA), 1);
+    QCOMPARE(flags.indexesWithFlag(FlagA), QVector<int>({3}));
+}
+
+void KItemStateFlagsTest::testInsertItems()
+{
+    KItemStateFlags flags(4);
+    flags.setFlag(0, FlagA);
+    flags.setFlag(2, FlagA);
+    flags.setFlag(3, FlagB);
+
+    // Insert two items at the beginning and one item before the old index 3
+    flags.insertItems(KItemRangeList() << KItemRange(0, 2) << KItemRange(3, 1));
+    QCOMPARE(flags.count(), 7);
+    QCOMPARE(flags.indexesWithFlag(FlagA), QVector<int>({2, 4}));
+    QCOMPARE(flags.indexesWithFlag(FlagB), QVector<int>({6}));
+
+    flags.insertItems(KItemRangeList() << KItemRange(7, 2));
+    QCOMPARE(flags.count(), 9);
+    QCOMPARE(flags.indexesWithFlag(FlagB), QVector<int>({6}));
+}
+
+void KItemStateFlagsTest::testRemoveItems()
+{
+    KItemStateFlags flags(8);
+    for (int i = 0; i < 8; i += 2) {
+        flags.setFlag(i, FlagA);
+    }
+    flags.setFlag(7, FlagB);
+
+    flags.removeItems(KItemRangeList() << KItemRange(1, 2) << KItemRange(5, 2));
+    QCOMPARE(flags.count(), 4);
+    QCOMPARE(flags.flagCount(FlagA), 2);
+    QCOMPARE(flags.indexesWithFlag(FlagA), QVector<int>({0, 2}));
+    QCOMPARE(flags.indexesWithFlag(FlagB), QVector<int>({3}));
+
+    flags.removeItems(KItemRangeList() << KItemRange(0, 4));
+    QCOMPARE(flags.count(), 0);
+    QCOMPARE(flags.flagCount(FlagA), 0);
+    QCOMPARE(flags.flagCount(FlagB), 0);
+}
+
+void KItemStateFlagsTest::testMoveItems()
+{
+    KItemStateFlags flags(5);
+    flags.setFlag(1, FlagA);
+    flags.setFlag(2, FlagB);
+
+    // The items 1, 2 and 3 are moved to 3, 1 and 2
+    flags.moveItems(KItemRange(1, 3), QList<int>() << 3 << 1 << 2);
+    QCOMPARE(flags.indexesWithFlag(FlagA), QVector<int>({3}));
+    QCOMPARE(flags.indexesWithFlag(FlagB), QVector<int>({1}));
+    QCOMPARE(flags.firstIndexWithFlag(FlagB), 1);
+}
+
+void KItemStateFlagsTest::testFirstIndexWithFlag()
+{
+    KItemStateFlags flags(6);
+    QCOMPARE(flags.firstIndexWithFlag(FlagA), -1);
+
+    flags.setFlag(4, FlagA);
+    flags.setFlag(2, FlagA);
+    QCOMPARE(flags.firstIndexWithFlag(FlagA), 2);
+
+    flags.setFlag(2, FlagA, false);
+    QCOMPARE(flags.firstIndexWithFlag(FlagA), 4);
+
+    // An item before the previous result gets the flag
+    flags.setFlag(0, FlagA);
+    QCOMPARE(flags.firstIndexWithFlag(FlagA), 0);
+
+    flags.removeItems(KItemRangeList() << KItemRange(0, 1));
+    QCOMPARE(flags.firstIndexWithFlag(FlagA), 3);
+}
+
+void KItemStateFlagsTest::testClearFlag()
+{
+    KItemStateFlags flags(3);
+    flags.setFlag(0, FlagA);
+    flags.setFlag(0, FlagB);
+    flags.setFlag(2, FlagA);
+
+    flags.clearFlag(FlagA);
+    QCOMPARE(flags.flagCount(FlagA), 0);
+    QCOMPARE(flags.firstIndexWithFlag(FlagA), -1);
+    QVERIFY(flags.testFlag(0, FlagB));
+
+    flags.reset(2);
+    QCOMPARE(flags.count(), 2);
+    QCOMPARE(flags.flagCount(FlagB), 0);
+    QVERIFY(!flags.testFlag(0, FlagB));
+}
+
+QTEST_GUILESS_MAIN(KItemStateFlagsTest)
+
+#include "kitemstateflagstest.moc"
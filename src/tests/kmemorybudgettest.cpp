@@ -0,0 +1,199 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kmemorybudget.h"
+
+#include <QSignalSpy>
+#include <QTest>
+
+namespace {
+    class TestConsumer : public KMemoryBudget::Consumer
+    {
+    public:
+        TestConsumer(const QString& name, qint64 usage, bool evictable, ReleaseOrder order = ReleaseDefault) :
+            m_name(name),
+            m_usage(usage),
+            m_evictable(evictable),
+            m_order(order)
+        {
+        }
+
+        QString memoryConsumerName() const override
+        {
+            return m_name;
+        }
+
+        qint64 memoryUsage() const override
+        {
+            return m_usage;
+        }
+
+        qint64 releaseMemory(qint64 bytes) override
+        {
+            if (!m_evictable) {
+                return 0;
+            }
+            const qint64 released = qMin(bytes, m_usage);
+            m_usage -= released;
+            return released;
+        }
+
+        qint64 releasableMemory() const override
+        {
+            return m_evictable ? m_usage : 0;
+        }
+
+        ReleaseOrder releaseOrder() const override
+        {
+            return m_order;
+        }
+
+    private:
+        QString m_name;
+        qint64 m_usage;
+        bool m_evictable;
+        ReleaseOrder m_order;
+    };
+}
+
+class KMemoryBudgetTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void cleanup();
+
+    void testUsage();
+    void testConsumerRemoved();
+    void testEnforceBudget();
+    void testUnlimitedBudget();
+    void testScheduleCheck();
+    void testReleaseOrder();
+    void testReleaseMemoryUnderPressure();
+};
+
+void KMemoryBudgetTest::cleanup()
+{
+    KMemoryBudget::instance().setBudget(0);
+}
+
+void KMemoryBudgetTest::testUsage()
+{
+    TestConsumer small(QStringLiteral("small"), 100, false);
+    TestConsumer large(QStringLiteral("large"), 1000, false);
+
+    const KMemoryBudget& budget = KMemoryBudget::instance();
+    QCOMPARE(budget.totalUsage(), qint64(1100));
+
+    const QVector<KMemoryBudget::Usage> usage = budget.usage();
+    QCOMPARE(usage.count(), 2);
+    QCOMPARE(usage.at(0).name, QStringLiteral("large"));
+    QCOMPARE(usage.at(0).bytes, qint64(1000));
+    QCOMPARE(usage.at(1).name, QStringLiteral("small"));
+
+    const QString report = budget.report();
+    QVERIFY(report.contains(QLatin1String("large")));
+    QVERIFY(report.contains(QLatin1String("small")));
+}
+
+void KMemoryBudgetTest::testConsumerRemoved()
+{
+    TestConsumer consumer(QStringLiteral("consumer"), 100, false);
+    {
+        TestConsumer temporary(QStringLiteral("temporary"), 1000, false);
+        QCOMPARE(KMemoryBudget::instance().totalUsage(), qint64(1100));
+    }
+    QCOMPARE(KMemoryBudget::instance().totalUsage(), qint64(100));
+}
+
+void KMemoryBudgetTest::testEnforceBudget()
+{
+    TestConsumer items(QStringLiteral("items"), 1000, false);
+    TestConsumer smallCache(QStringLiteral("smallCache"), 200, true);
+    TestConsumer largeCache(QStringLiteral("largeCache"), 500, true);
+
+    KMemoryBudget& budget = KMemoryBudget::instance();
+    QSignalSpy budgetExceededSpy(&budget, &KMemoryBudget::budgetExceeded);
+    budget.setBudget(2000);
+    QCOMPARE(budget.enforceBudget(), qint64(0));
+    QCOMPARE(budgetExceededSpy.count(), 0);
+
+    // The largest cache is asked first
+    budget.setBudget(1400);
+    QCOMPARE(budget.enforceBudget(), qint64(300));
+    QCOMPARE(budgetExceededSpy.count(), 1);
+    QCOMPARE(budgetExceededSpy.first().at(0).toLongLong(), qint64(1700));
+    QCOMPARE(largeCache.memoryUsage(), qint64(200));
+    QCOMPARE(smallCache.memoryUsage(), qint64(200));
+
+    // The items are not released, even if the budget is still exceeded
+    budget.setBudget(500);
+    QCOMPARE(budget.enforceBudget(), qint64(400));
+    QCOMPARE(largeCache.memoryUsage(), qint64(0));
+    QCOMPARE(smallCache.memoryUsage(), qint64(0));
+    QCOMPARE(items.memoryUsage(), qint64(1000));
+}
+
+void KMemoryBudgetTest::testUnlimitedBudget()
+{
+    TestConsumer cache(QStringLiteral("cache"), 1000, true);
+
+    KMemoryBudget& budget = KMemoryBudget::instance();
+    budget.setBudget(0);
+    QCOMPARE(budget.enforceBudget(), qint64(0));
+    QCOMPARE(cache.memoryUsage(), qint64(1000));
+}
+
+void KMemoryBudgetTest::testScheduleCheck()
+{
+    TestConsumer cache(QStringLiteral("cache"), 1000, true);
+
+    KMemoryBudget& budget = KMemoryBudget::instance();
+    QSignalSpy budgetExceededSpy(&budget, &KMemoryBudget::budgetExceeded);
+    budget.setBudget(600);
+    budget.scheduleCheck();
+    QTest::qWait(10);
+    budget.scheduleCheck();
+    QCOMPARE(cache.memoryUsage(), qint64(1000));
+
+    QVERIFY(budgetExceededSpy.wait());
+    QCOMPARE(budgetExceededSpy.count(), 1);
+    QCOMPARE(cache.memoryUsage(), qint64(600));
+}
+
+void KMemoryBudgetTest::testReleaseOrder()
+{
+    TestConsumer previews(QStringLiteral("previews"), 1000, true, KMemoryBudget::Consumer::ReleaseLast);
+    TestConsumer widgets(QStringLiteral("widgets"), 100, true, KMemoryBudget::Consumer::ReleaseFirst);
+    TestConsumer pixmaps(QStringLiteral("pixmaps"), 300, true);
+
+    // The consumers are asked in the release order, independent from their usage
+    KMemoryBudget& budget = KMemoryBudget::instance();
+    budget.setBudget(1200);
+    QCOMPARE(budget.enforceBudget(), qint64(200));
+    QCOMPARE(widgets.memoryUsage(), qint64(0));
+    QCOMPARE(pixmaps.memoryUsage(), qint64(200));
+    QCOMPARE(previews.memoryUsage(), qint64(1000));
+}
+
+void KMemoryBudgetTest::testReleaseMemoryUnderPressure()
+{
+    TestConsumer items(QStringLiteral("items"), 400, false);
+    TestConsumer cache(QStringLiteral("cache"), 600, true);
+
+    // The budget is not relevant for memory pressure, and only
+    // half of the memory that can be released is released
+    KMemoryBudget& budget = KMemoryBudget::instance();
+    QSignalSpy memoryPressureSpy(&budget, &KMemoryBudget::memoryPressure);
+    QCOMPARE(budget.releaseMemoryUnderPressure(), qint64(300));
+    QCOMPARE(memoryPressureSpy.count(), 1);
+    QCOMPARE(cache.memoryUsage(), qint64(300));
+    QCOMPARE(items.memoryUsage(), qint64(400));
+}
+
+QTEST_GUILESS_MAIN(KMemoryBudgetTest)
+
+#include "kmemorybudgettest.moc"
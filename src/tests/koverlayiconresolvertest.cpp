@@ -0,0 +1,136 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/koverlayiconresolver.h"
+
+#include <KOverlayIconPlugin>
+
+#include <QSignalSpy>
+#include <QTest>
+#include <QThread>
+
+class TestOverlayIconPlugin : public KOverlayIconPlugin
+{
+    Q_OBJECT
+
+public:
+    QStringList getOverlays(const QUrl& url) override
+    {
+        ++m_callCount;
+        if (QThread::currentThread() != qApp->thread()) {
+            m_calledByOtherThread = true;
+        }
+        return {QStringLiteral("emblem-") + url.fileName()};
+    }
+
+    int m_callCount = 0;
+    bool m_calledByOtherThread = false;
+};
+
+class TestOverlayIconResolver : public KOverlayIconResolver
+{
+public:
+    explicit TestOverlayIconResolver(const QList<KOverlayIconPlugin*>& plugins) :
+        KOverlayIconResolver(plugins)
+    {
+    }
+};
+
+class KOverlayIconResolverTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testResolveOverlays();
+    void testCache();
+    void testOverlaysChanged();
+
+private:
+    TestOverlayIconPlugin* m_plugin;
+    TestOverlayIconResolver* m_resolver;
+};
+
+void KOverlayIconResolverTest::initTestCase()
+{
+    qRegisterMetaType<QHash<QUrl, QStringList>>();
+}
+
+void KOverlayIconResolverTest::init()
+{
+    m_plugin = new TestOverlayIconPlugin();
+    m_resolver = new TestOverlayIconResolver({m_plugin});
+}
+
+void KOverlayIconResolverTest::cleanup()
+{
+    delete m_resolver;
+    m_resolver = nullptr;
+    delete m_plugin;
+    m_plugin = nullptr;
+}
+
+void KOverlayIconResolverTest::testResolveOverlays()
+{
+    QVERIFY(m_resolver->hasPlugins());
+
+    QSignalSpy resolvedSpy(m_resolver, &KOverlayIconResolver::overlaysResolved);
+    m_resolver->requestOverlays({QUrl("file:///a"), QUrl("file:///b"), QUrl("file:///a")});
+    QVERIFY(resolvedSpy.wait());
+
+    const QHash<QUrl, QStringList> overlays = resolvedSpy.takeFirst().at(0).value<QHash<QUrl, QStringList>>();
+    QCOMPARE(overlays.count(), 2);
+    QCOMPARE(overlays.value(QUrl("file:///a")), QStringList({"emblem-a"}));
+    QCOMPARE(overlays.value(QUrl("file:///b")), QStringList({"emblem-b"}));
+
+    // The plugins are not thread-safe
+    QCOMPARE(m_plugin->m_callCount, 2);
+    QVERIFY(!m_plugin->m_calledByOtherThread);
+}
+
+void KOverlayIconResolverTest::testCache()
+{
+    QSignalSpy resolvedSpy(m_resolver, &KOverlayIconResolver::overlaysResolved);
+    m_resolver->requestOverlays({QUrl("file:///a")});
+    QVERIFY(resolvedSpy.wait());
+
+    QStringList overlays;
+    QVERIFY(m_resolver->cachedOverlays(QUrl("file:///a"), overlays));
+    QCOMPARE(overlays, QStringList({"emblem-a"}));
+    QVERIFY(!m_resolver->cachedOverlays(QUrl("file:///b"), overlays));
+
+    // Cached overlays are not requested from the plugins again
+    m_resolver->requestOverlays({QUrl("file:///a")});
+    QVERIFY(!resolvedSpy.wait(100));
+    QCOMPARE(m_plugin->m_callCount, 1);
+
+    m_resolver->invalidate({QUrl("file:///a")});
+    QVERIFY(!m_resolver->cachedOverlays(QUrl("file:///a"), overlays));
+    m_resolver->requestOverlays({QUrl("file:///a")});
+    QVERIFY(resolvedSpy.wait());
+    QCOMPARE(m_plugin->m_callCount, 2);
+}
+
+void KOverlayIconResolverTest::testOverlaysChanged()
+{
+    QSignalSpy resolvedSpy(m_resolver, &KOverlayIconResolver::overlaysResolved);
+    m_resolver->requestOverlays({QUrl("file:///a")});
+    QVERIFY(resolvedSpy.wait());
+    resolvedSpy.clear();
+
+    // The overlays of all plugins are determined again
+    Q_EMIT m_plugin->overlaysChanged(QUrl("file:///a"), {});
+    QVERIFY(resolvedSpy.wait());
+    QCOMPARE(m_plugin->m_callCount, 2);
+    QVERIFY(resolvedSpy.takeFirst().at(0).value<QHash<QUrl, QStringList>>().contains(QUrl("file:///a")));
+}
+
+QTEST_GUILESS_MAIN(KOverlayIconResolverTest)
+
+#include "koverlayiconresolvertest.moc"
@@ -0,0 +1,123 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kpluginregistry.h"
+
+#include <KIO/PreviewJob>
+#include <KPluginLoader>
+#include <KServiceTypeTrader>
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QTest>
+
+class KPluginRegistryTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanup();
+
+    void testServices();
+    void testJsonPlugins();
+    void testIndex();
+
+private:
+    static QStringList pluginIds(const QVector<KPluginMetaData>& plugins);
+};
+
+void KPluginRegistryTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QFile::remove(KPluginRegistry::instance().indexFilePath());
+}
+
+void KPluginRegistryTest::cleanup()
+{
+    KPluginRegistry::instance().reset();
+}
+
+void KPluginRegistryTest::testServices()
+{
+    KPluginRegistry& registry = KPluginRegistry::instance();
+    registry.startDiscovery();
+
+    QCOMPARE(registry.defaultPreviewPlugins(), KIO::PreviewJob::defaultPlugins());
+    QCOMPARE(registry.thumbCreators().count(),
+             KServiceTypeTrader::self()->query(QStringLiteral("ThumbCreator")).count());
+    QCOMPARE(registry.versionControlPlugins().count(),
+             KServiceTypeTrader::self()->query(QStringLiteral("FileViewVersionControlPlugin")).count());
+}
+
+void KPluginRegistryTest::testJsonPlugins()
+{
+    KPluginRegistry& registry = KPluginRegistry::instance();
+
+    QCOMPARE(pluginIds(registry.overlayIconPlugins()),
+             pluginIds(KPluginLoader::findPlugins(QStringLiteral("kf5/overlayicon"))));
+    QCOMPARE(pluginIds(registry.fileItemActionPlugins()),
+             pluginIds(KPluginLoader::findPlugins(QStringLiteral("kf5/kfileitemaction"))));
+}
+
+void KPluginRegistryTest::testIndex()
+{
+    KPluginRegistry& registry = KPluginRegistry::instance();
+    QFile::remove(registry.indexFilePath());
+
+    const QStringList discoveredIds = pluginIds(registry.fileItemActionPlugins());
+    QVERIFY(QFile::exists(registry.indexFilePath()));
+
+    // The plugins are read from the index by the next discovery
+    registry.reset();
+    QCOMPARE(pluginIds(registry.fileItemActionPlugins()), discoveredIds);
+
+    if (discoveredIds.isEmpty()) {
+        QSKIP("No file item action plugins are installed");
+    }
+
+    // Let the index refer to another version of the first plugin, as if the
+    // plugin had been overwritten without changing its directory
+    QFile file(registry.indexFilePath());
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QJsonObject index = QJsonDocument::fromJson(file.readAll()).object();
+    QJsonObject plugins = index.value(QLatin1String("plugins")).toObject();
+    QJsonArray entries = plugins.value(QLatin1String("kf5/kfileitemaction")).toArray();
+    QJsonObject entry = entries.first().toObject();
+    const qint64 size = qint64(entry.value(QLatin1String("size")).toDouble());
+    entry.insert(QLatin1String("size"), double(size + 1));
+    entries.replace(0, entry);
+    plugins.insert(QLatin1String("kf5/kfileitemaction"), entries);
+    index.insert(QLatin1String("plugins"), plugins);
+    file.resize(0);
+    file.write(QJsonDocument(index).toJson());
+    file.close();
+
+    // The outdated index is replaced by the next discovery
+    registry.reset();
+    QCOMPARE(pluginIds(registry.fileItemActionPlugins()), discoveredIds);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    index = QJsonDocument::fromJson(file.readAll()).object();
+    entry = index.value(QLatin1String("plugins")).toObject().value(QLatin1String("kf5/kfileitemaction")).toArray().first().toObject();
+    QCOMPARE(qint64(entry.value(QLatin1String("size")).toDouble()), size);
+}
+
+QStringList KPluginRegistryTest::pluginIds(const QVector<KPluginMetaData>& plugins)
+{
+    QStringList ids;
+    for (const KPluginMetaData& metaData : plugins) {
+        ids.append(metaData.pluginId());
+    }
+    ids.sort();
+    return ids;
+}
+
+QTEST_GUILESS_MAIN(KPluginRegistryTest)
+
+#include "kpluginregistrytest.moc"
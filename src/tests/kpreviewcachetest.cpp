@@ -0,0 +1,178 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/kpreviewcache.h"
+
+#include <KFileItem>
+#include <KIO/UDSEntry>
+
+#include <QImage>
+#include <QStandardPaths>
+#include <QTest>
+
+class KPreviewCacheTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void testFindInsertedPreview();
+    void testMissingPreview();
+    void testOutdatedPreview();
+    void testDifferentPlugins();
+    void testFindClosest();
+    void testSequence();
+
+private:
+    static KFileItem createItem(const QString& name, qint64 modificationTime, qint64 size);
+    static QImage createPreview(bool hasAlpha);
+};
+
+void KPreviewCacheTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void KPreviewCacheTest::init()
+{
+    KPreviewCache::instance().clear();
+}
+
+void KPreviewCacheTest::testFindInsertedPreview()
+{
+    KPreviewCache& cache = KPreviewCache::instance();
+    const QStringList plugins = {QStringLiteral("imagethumbnail")};
+
+    const KFileItem opaqueItem = createItem(QStringLiteral("a.jpg"), 1000, 10);
+    const QImage opaquePreview = createPreview(false);
+    cache.insert(opaqueItem, QSize(128, 128), plugins, opaquePreview);
+
+    const KFileItem transparentItem = createItem(QStringLiteral("b.png"), 1000, 10);
+    const QImage transparentPreview = createPreview(true);
+    cache.insert(transparentItem, QSize(128, 128), plugins, transparentPreview);
+
+    const QImage cachedOpaquePreview = cache.find(opaqueItem, QSize(128, 128), plugins);
+    QCOMPARE(cachedOpaquePreview.size(), opaquePreview.size());
+    QVERIFY(!cachedOpaquePreview.hasAlphaChannel());
+    QCOMPARE(cachedOpaquePreview, opaquePreview);
+
+    const QImage cachedTransparentPreview = cache.find(transparentItem, QSize(128, 128), plugins);
+    QCOMPARE(cachedTransparentPreview.size(), transparentPreview.size());
+    QVERIFY(cachedTransparentPreview.hasAlphaChannel());
+    QCOMPARE(cachedTransparentPreview, transparentPreview);
+}
+
+void KPreviewCacheTest::testMissingPreview()
+{
+    KPreviewCache& cache = KPreviewCache::instance();
+    const QStringList plugins = {QStringLiteral("imagethumbnail")};
+
+    const KFileItem item = createItem(QStringLiteral("a.jpg"), 1000, 10);
+    QVERIFY(cache.find(item, QSize(128, 128), plugins).isNull());
+
+    cache.insert(item, QSize(128, 128), plugins, createPreview(false));
+    QVERIFY(cache.find(item, QSize(256, 256), plugins).isNull());
+    QVERIFY(cache.find(createItem(QStringLiteral("b.jpg"), 1000, 10), QSize(128, 128), plugins).isNull());
+
+    // Previews of items without modification time cannot be validated and
+    // are never cached.
+    const KFileItem itemWithoutTime = createItem(QStringLiteral("c.jpg"), -1, 10);
+    cache.insert(itemWithoutTime, QSize(128, 128), plugins, createPreview(false));
+    QVERIFY(cache.find(itemWithoutTime, QSize(128, 128), plugins).isNull());
+}
+
+void KPreviewCacheTest::testOutdatedPreview()
+{
+    KPreviewCache& cache = KPreviewCache::instance();
+    const QStringList plugins = {QStringLiteral("imagethumbnail")};
+
+    cache.insert(createItem(QStringLiteral("a.jpg"), 1000, 10), QSize(128, 128), plugins, createPreview(false));
+
+    QVERIFY(!cache.find(createItem(QStringLiteral("a.jpg"), 1000, 10), QSize(128, 128), plugins).isNull());
+    QVERIFY(cache.find(createItem(QStringLiteral("a.jpg"), 2000, 10), QSize(128, 128), plugins).isNull());
+    QVERIFY(cache.find(createItem(QStringLiteral("a.jpg"), 1000, 20), QSize(128, 128), plugins).isNull());
+}
+
+void KPreviewCacheTest::testDifferentPlugins()
+{
+    KPreviewCache& cache = KPreviewCache::instance();
+    const KFileItem item = createItem(QStringLiteral("a.jpg"), 1000, 10);
+
+    const QStringList plugins = {QStringLiteral("imagethumbnail"), QStringLiteral("jpegthumbnail")};
+    cache.insert(item, QSize(128, 128), plugins, createPreview(false));
+
+    const QStringList reorderedPlugins = {QStringLiteral("jpegthumbnail"), QStringLiteral("imagethumbnail")};
+    QVERIFY(!cache.find(item, QSize(128, 128), reorderedPlugins).isNull());
+
+    const QStringList otherPlugins = {QStringLiteral("imagethumbnail")};
+    QVERIFY(cache.find(item, QSize(128, 128), otherPlugins).isNull());
+}
+
+void KPreviewCacheTest::testFindClosest()
+{
+    KPreviewCache& cache = KPreviewCache::instance();
+    const QStringList plugins = {QStringLiteral("imagethumbnail")};
+    const KFileItem item = createItem(QStringLiteral("a.jpg"), 1000, 10);
+
+    cache.insert(item, QSize(256, 256), plugins, createPreview(false));
+    QVERIFY(cache.find(item, QSize(128, 128), plugins).isNull());
+
+    // Larger previews can be downscaled, smaller previews are not upscaled
+    QVERIFY(!cache.findClosest(item, QSize(128, 128), plugins).isNull());
+    QVERIFY(!cache.findClosest(item, QSize(256, 256), plugins).isNull());
+    QVERIFY(cache.findClosest(item, QSize(512, 512), plugins).isNull());
+}
+
+void KPreviewCacheTest::testSequence()
+{
+    KPreviewCache& cache = KPreviewCache::instance();
+    const QStringList plugins = {QStringLiteral("ffmpegthumbs")};
+    const KFileItem item = createItem(QStringLiteral("a.mp4"), 1000, 10);
+
+    int frameCount = -1;
+    QVERIFY(cache.findSequence(item, QSize(96, 64), plugins, &frameCount).isNull());
+    QCOMPARE(frameCount, 0);
+
+    const QImage strip = createPreview(false);
+    cache.insertSequence(item, QSize(96, 64), plugins, strip, 4);
+
+    // The sequence does not replace the preview with the same size
+    QVERIFY(cache.find(item, QSize(96, 64), plugins).isNull());
+
+    QCOMPARE(cache.findSequence(item, QSize(96, 64), plugins, &frameCount), strip);
+    QCOMPARE(frameCount, 4);
+    QVERIFY(cache.findSequence(item, QSize(128, 128), plugins, &frameCount).isNull());
+}
+
+KFileItem KPreviewCacheTest::createItem(const QString& name, qint64 modificationTime, qint64 size)
+{
+    KIO::UDSEntry entry;
+    entry.fastInsert(KIO::UDSEntry::UDS_NAME, name);
+    entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, 0100000);    // S_IFREG might not be defined on non-Unix platforms.
+    entry.fastInsert(KIO::UDSEntry::UDS_SIZE, size);
+    if (modificationTime >= 0) {
+        entry.fastInsert(KIO::UDSEntry::UDS_MODIFICATION_TIME, modificationTime);
+    }
+    return KFileItem(entry, QUrl::fromLocalFile(QStringLiteral("/tmp/kpreviewcachetest/") + name));
+}
+
+QImage KPreviewCacheTest::createPreview(bool hasAlpha)
+{
+    QImage image(96, 64, hasAlpha ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x) {
+            const int alpha = hasAlpha ? (x * 255) / image.width() : 255;
+            image.setPixel(x, y, qPremultiply(qRgba(x * 2, y * 3, 128, alpha)));
+        }
+    }
+    return image;
+}
+
+QTEST_GUILESS_MAIN(KPreviewCacheTest)
+
+#include "kpreviewcachetest.moc"
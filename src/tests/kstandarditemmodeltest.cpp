@@ -10,9 +10,12 @@
 #include "kitemviews/kstandarditem.h"
 #include "kitemviews/kstandarditemmodel.h"
 
+#include <QSignalSpy>
 #include <QStandardPaths>
 #include <QTest>
 
+Q_DECLARE_METATYPE(KItemRangeList)
+
 class KStandardItemModelTest : public QObject
 {
     Q_OBJECT
@@ -24,6 +27,8 @@ private Q_SLOTS:
 
     void testNewItems();
     void testRemoveItems();
+    void testInsertItems();
+    void testIndexForUrl();
 
 private:
     bool isModelConsistent() const;
@@ -35,6 +40,7 @@ private:
 void KStandardItemModelTest::initTestCase()
 {
     QStandardPaths::setTestModeEnabled(true);
+    qRegisterMetaType<KItemRangeList>("KItemRangeList");
 }
 
 void KStandardItemModelTest::init()
@@ -85,6 +91,54 @@ void KStandardItemModelTest::testRemoveItems()
     QCOMPARE(m_model->item(6)->text(), QString("item 10"));
 }
 
+void KStandardItemModelTest::testInsertItems()
+{
+    m_model->appendItem(new KStandardItem("item 1"));
+    m_model->appendItem(new KStandardItem("item 4"));
+
+    QSignalSpy spyItemsInserted(m_model, &KStandardItemModel::itemsInserted);
+    m_model->insertItems(1, {new KStandardItem("item 2"), new KStandardItem("item 3")});
+    QCOMPARE(spyItemsInserted.count(), 1);
+    QCOMPARE(spyItemsInserted.first().at(0).value<KItemRangeList>(), KItemRangeList() << KItemRange(1, 2));
+
+    m_model->insertItems(5, {new KStandardItem("invalid")});
+    QCOMPARE(m_model->count(), 4);
+    QCOMPARE(m_model->item(0)->text(), QString("item 1"));
+    QCOMPARE(m_model->item(1)->text(), QString("item 2"));
+    QCOMPARE(m_model->item(2)->text(), QString("item 3"));
+    QCOMPARE(m_model->item(3)->text(), QString("item 4"));
+
+    QVERIFY(isModelConsistent());
+}
+
+void KStandardItemModelTest::testIndexForUrl()
+{
+    const QUrl url1 = QUrl::fromLocalFile("/a");
+    const QUrl url2 = QUrl::fromLocalFile("/b");
+
+    for (int i = 1; i <= 3; ++i) {
+        m_model->appendItem(new KStandardItem("item " + QString::number(i)));
+    }
+    m_model->item(2)->setDataValue("url", url1);
+    QCOMPARE(m_model->indexForUrl(url1), 2);
+    QCOMPARE(m_model->indexForUrl(url2), -1);
+
+    // The first item with the URL is returned
+    m_model->item(1)->setDataValue("url", url1);
+    QCOMPARE(m_model->indexForUrl(url1), 1);
+
+    m_model->item(1)->setDataValue("url", url2);
+    QCOMPARE(m_model->indexForUrl(url1), 2);
+    QCOMPARE(m_model->indexForUrl(url2), 1);
+
+    m_model->removeItem(0);
+    QCOMPARE(m_model->indexForUrl(url1), 1);
+    QCOMPARE(m_model->indexForUrl(url2), 0);
+
+    m_model->removeItem(1);
+    QCOMPARE(m_model->indexForUrl(url1), -1);
+}
+
 bool KStandardItemModelTest::isModelConsistent() const
 {
     if (m_model->m_items.count() != m_model->m_indexesForItems.count()) {
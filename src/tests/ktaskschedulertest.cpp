@@ -0,0 +1,259 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kitemviews/private/ktaskscheduler.h"
+
+#include <QMutex>
+#include <QSemaphore>
+#include <QTest>
+#include <QVector>
+
+#include <atomic>
+
+#ifdef Q_OS_LINUX
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+class KTaskSchedulerTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testResult();
+    void testMaximumConcurrency();
+    void testQueueOrder();
+    void testInteractiveHoldsBack();
+    void testInteractiveScope();
+    void testHoldBackTimeout();
+    void testCancelQueuedTask();
+    void testDropQueuedTasks();
+    void testLowPriorityThreads();
+};
+
+namespace {
+    int add(int a, int b)
+    {
+        return a + b;
+    }
+}
+
+void KTaskSchedulerTest::testResult()
+{
+    KTaskScheduler scheduler;
+    QFuture<int> future = scheduler.run(KTaskScheduler::Visible, &add, 2, 3);
+    future.waitForFinished();
+    QCOMPARE(future.result(), 5);
+
+    std::atomic<bool> done(false);
+    QFuture<void> voidFuture = scheduler.run(KTaskScheduler::Background, [&done]() {
+        done = true;
+    });
+    voidFuture.waitForFinished();
+    QVERIFY(done);
+}
+
+void KTaskSchedulerTest::testMaximumConcurrency()
+{
+    KTaskScheduler scheduler;
+    scheduler.setMaximumConcurrency(KTaskScheduler::Background, 2);
+
+    QSemaphore started;
+    QSemaphore release;
+    for (int i = 0; i < 5; ++i) {
+        scheduler.run(KTaskScheduler::Background, [&started, &release]() {
+            started.release();
+            release.acquire();
+        });
+    }
+
+    QVERIFY(started.tryAcquire(2, 5000));
+    QVERIFY(!started.tryAcquire(1, 100));
+    QCOMPARE(scheduler.runningCount(KTaskScheduler::Background), 2);
+    QCOMPARE(scheduler.queuedCount(KTaskScheduler::Background), 3);
+
+    release.release(5);
+    QVERIFY(scheduler.waitForDone(5000));
+    QCOMPARE(scheduler.runningCount(KTaskScheduler::Background), 0);
+    QCOMPARE(scheduler.queuedCount(KTaskScheduler::Background), 0);
+}
+
+void KTaskSchedulerTest::testQueueOrder()
+{
+    KTaskScheduler scheduler;
+    scheduler.setMaximumConcurrency(KTaskScheduler::Prefetch, 1);
+
+    // Occupy the only Prefetch slot, so that the following tasks are queued
+    QSemaphore blockerStarted;
+    QSemaphore release;
+    scheduler.run(KTaskScheduler::Prefetch, [&blockerStarted, &release]() {
+        blockerStarted.release();
+        release.acquire();
+    });
+    QVERIFY(blockerStarted.tryAcquire(1, 5000));
+
+    QMutex mutex;
+    QVector<int> order;
+    for (int i = 0; i < 3; ++i) {
+        scheduler.run(KTaskScheduler::Prefetch, [&mutex, &order, i]() {
+            QMutexLocker locker(&mutex);
+            order.append(i);
+        });
+    }
+    QCOMPARE(scheduler.queuedCount(KTaskScheduler::Prefetch), 3);
+
+    release.release();
+    QVERIFY(scheduler.waitForDone(5000));
+    QCOMPARE(order, QVector<int>({0, 1, 2}));
+}
+
+void KTaskSchedulerTest::testInteractiveHoldsBack()
+{
+    KTaskScheduler scheduler;
+
+    QSemaphore interactiveStarted;
+    QSemaphore release;
+    scheduler.run(KTaskScheduler::Interactive, [&interactiveStarted, &release]() {
+        interactiveStarted.release();
+        release.acquire();
+    });
+    QVERIFY(interactiveStarted.tryAcquire(1, 5000));
+
+    std::atomic<bool> visibleDone(false);
+    std::atomic<bool> backgroundDone(false);
+    scheduler.run(KTaskScheduler::Visible, [&visibleDone]() {
+        visibleDone = true;
+    });
+    scheduler.run(KTaskScheduler::Background, [&backgroundDone]() {
+        backgroundDone = true;
+    });
+
+    // Visible tasks are not held back by the Interactive task
+    QTRY_VERIFY(visibleDone);
+    QTest::qWait(50);
+    QVERIFY(!backgroundDone);
+    QCOMPARE(scheduler.queuedCount(KTaskScheduler::Background), 1);
+
+    release.release();
+    QVERIFY(scheduler.waitForDone(5000));
+    QVERIFY(backgroundDone);
+}
+
+void KTaskSchedulerTest::testInteractiveScope()
+{
+    KTaskScheduler scheduler;
+    std::atomic<bool> done(false);
+
+    {
+        const KTaskScheduler::InteractiveScope scope(scheduler);
+        scheduler.run(KTaskScheduler::Prefetch, [&done]() {
+            done = true;
+        });
+        QVERIFY(!scheduler.waitForDone(50));
+        QVERIFY(!done);
+    }
+
+    QVERIFY(scheduler.waitForDone(5000));
+    QVERIFY(done);
+}
+
+void KTaskSchedulerTest::testHoldBackTimeout()
+{
+    KTaskScheduler scheduler;
+    scheduler.setHoldBackTimeout(200);
+
+    QSemaphore interactiveStarted;
+    QSemaphore release;
+    scheduler.run(KTaskScheduler::Interactive, [&interactiveStarted, &release]() {
+        interactiveStarted.release();
+        release.acquire();
+    });
+    QVERIFY(interactiveStarted.tryAcquire(1, 5000));
+
+    std::atomic<bool> done(false);
+    scheduler.run(KTaskScheduler::Prefetch, [&done]() {
+        done = true;
+    });
+    QTest::qWait(50);
+    QVERIFY(!done);
+
+    // The Interactive task does not make progress, e.g. because it hangs on
+    // a slow mount, so the Prefetch task is started after the timeout
+    QTRY_VERIFY_WITH_TIMEOUT(done, 5000);
+
+    release.release();
+    QVERIFY(scheduler.waitForDone(5000));
+}
+
+void KTaskSchedulerTest::testCancelQueuedTask()
+{
+    KTaskScheduler scheduler;
+    std::atomic<bool> done(false);
+
+    QFuture<void> future;
+    {
+        const KTaskScheduler::InteractiveScope scope(scheduler);
+        future = scheduler.run(KTaskScheduler::Background, [&done]() {
+            done = true;
+        });
+        future.cancel();
+    }
+
+    QVERIFY(scheduler.waitForDone(5000));
+    QVERIFY(future.isCanceled());
+    QVERIFY(future.isFinished());
+    QVERIFY(!done);
+}
+
+void KTaskSchedulerTest::testDropQueuedTasks()
+{
+    std::atomic<bool> done(false);
+    QFuture<int> future;
+    {
+        KTaskScheduler scheduler;
+        // Is not ended, so the task is still queued when the scheduler is destroyed
+        scheduler.beginInteractiveWork();
+        future = scheduler.run(KTaskScheduler::Background, [&done]() {
+            done = true;
+            return 1;
+        });
+        QCOMPARE(scheduler.queuedCount(KTaskScheduler::Background), 1);
+    }
+
+    future.waitForFinished();
+    QVERIFY(future.isCanceled());
+    QVERIFY(future.isFinished());
+    QVERIFY(!done);
+}
+
+void KTaskSchedulerTest::testLowPriorityThreads()
+{
+#ifdef Q_OS_LINUX
+    KTaskScheduler scheduler;
+    const auto niceness = []() {
+        return getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)));
+    };
+
+    const int processNiceness = getpriority(PRIO_PROCESS, 0);
+    QFuture<int> visible = scheduler.run(KTaskScheduler::Visible, niceness);
+    QFuture<int> background = scheduler.run(KTaskScheduler::Background, niceness);
+    QCOMPARE(visible.result(), processNiceness);
+    QVERIFY(background.result() > processNiceness || processNiceness >= 10);
+
+    // Visible tasks with a low thread priority are not held back
+    const KTaskScheduler::InteractiveScope scope(scheduler);
+    QFuture<int> lowVisible = scheduler.run(KTaskScheduler::Visible, KTaskScheduler::LowThreadPriority, niceness);
+    QVERIFY(lowVisible.result() > processNiceness || processNiceness >= 10);
+    QCOMPARE(scheduler.queuedCount(KTaskScheduler::Visible), 0);
+#else
+    QSKIP("The thread priorities are only checked on Linux");
+#endif
+}
+
+QTEST_GUILESS_MAIN(KTaskSchedulerTest)
+
+#include "ktaskschedulertest.moc"
@@ -0,0 +1,278 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "views/localcopyjob.h"
+#include "testdir.h"
+
+#include <KIO/CopyJob>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QScopedPointer>
+#include <QSignalSpy>
+#include <QTest>
+
+#ifndef Q_OS_WIN
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+class LocalCopyJobTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testCopyFiles();
+    void testCopyDirectory();
+    void testExistingFile();
+    void testAutoRename();
+    void testPermissions();
+    void testTimes();
+    void testIncompleteCopy();
+    void testCopyIntoItself();
+    void testCopyInto();
+    void testCopyIntoByKio_data();
+    void testCopyIntoByKio();
+
+private:
+    QUrl url(const QString& path) const;
+    QByteArray fileData(const QString& path) const;
+
+private:
+    TestDir* m_testDir;
+};
+
+void LocalCopyJobTest::init()
+{
+    m_testDir = new TestDir();
+}
+
+void LocalCopyJobTest::cleanup()
+{
+    delete m_testDir;
+    m_testDir = nullptr;
+}
+
+void LocalCopyJobTest::testCopyFiles()
+{
+    const QByteArray largeData(3 * 1024 * 1024 + 17, 'x');
+    m_testDir->createFile("a.txt", "a");
+    m_testDir->createFile("b", largeData);
+
+    QScopedPointer<LocalCopyJob> job(new LocalCopyJob({url("a.txt"), url("b")}, {url("a copy.txt"), url("b copy")}));
+    job->setAutoDelete(false);
+    QVERIFY(job->exec());
+
+    QCOMPARE(job->copiedUrls(), QList<QUrl>({url("a copy.txt"), url("b copy")}));
+    QCOMPARE(fileData("a copy.txt"), QByteArray("a"));
+    QCOMPARE(fileData("b copy"), largeData);
+    QCOMPARE(job->processedAmount(KJob::Files), qulonglong(2));
+    QCOMPARE(job->processedAmount(KJob::Bytes), qulonglong(largeData.size() + 1));
+    QVERIFY(job->strategies() != LocalCopyJob::Strategies());
+}
+
+void LocalCopyJobTest::testCopyDirectory()
+{
+    m_testDir->createFile("a/b.txt", "b");
+    m_testDir->createFile("a/c/d", "d");
+    m_testDir->createDir("a/e");
+    QVERIFY(QFile::link("b.txt", m_testDir->path() + "/a/f"));
+
+    QScopedPointer<LocalCopyJob> job(new LocalCopyJob({url("a")}, {url("g")}));
+    job->setAutoDelete(false);
+    QVERIFY(job->exec());
+
+    QCOMPARE(fileData("g/b.txt"), QByteArray("b"));
+    QCOMPARE(fileData("g/c/d"), QByteArray("d"));
+    QVERIFY(QFileInfo(m_testDir->path() + "/g/e").isDir());
+    QCOMPARE(QFileInfo(m_testDir->path() + "/g/f").symLinkTarget(), m_testDir->path() + "/g/b.txt");
+}
+
+void LocalCopyJobTest::testExistingFile()
+{
+    m_testDir->createFile("a", "a");
+    m_testDir->createFile("b", "b");
+    m_testDir->createFile("c", "c");
+
+    // Existing files are never replaced, the other items are copied anyway
+    QScopedPointer<LocalCopyJob> job(new LocalCopyJob({url("a"), url("c")}, {url("b"), url("d")}));
+    job->setAutoDelete(false);
+    QVERIFY(!job->exec());
+    QVERIFY(!job->errorString().isEmpty());
+
+    QCOMPARE(job->copiedUrls(), QList<QUrl>({url("d")}));
+    QCOMPARE(fileData("b"), QByteArray("b"));
+    QCOMPARE(fileData("d"), QByteArray("c"));
+}
+
+void LocalCopyJobTest::testAutoRename()
+{
+    m_testDir->createFile("a", "a");
+    m_testDir->createFile("b", "b");
+
+    QScopedPointer<LocalCopyJob> job(new LocalCopyJob({url("a")}, {url("b")}));
+    job->setAutoRename(true);
+    job->setAutoDelete(false);
+    QVERIFY(job->exec());
+
+    QCOMPARE(job->copiedUrls().count(), 1);
+    const QUrl copiedUrl = job->copiedUrls().first();
+    QVERIFY(copiedUrl != url("b"));
+    QCOMPARE(fileData(copiedUrl.fileName()), QByteArray("a"));
+    QCOMPARE(fileData("b"), QByteArray("b"));
+}
+
+void LocalCopyJobTest::testPermissions()
+{
+#ifdef Q_OS_WIN
+    QSKIP("The permissions are not copied on Windows");
+#endif
+    m_testDir->createFile("a", "a");
+    const QFile::Permissions permissions = QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner
+                                         | QFile::ReadGroup | QFile::WriteGroup | QFile::ExeGroup
+                                         | QFile::ReadOther | QFile::WriteOther;
+    QVERIFY(QFile::setPermissions(m_testDir->path() + "/a", permissions));
+
+    // The permissions must not be restricted by the umask
+    QScopedPointer<LocalCopyJob> job(new LocalCopyJob({url("a")}, {url("b")}));
+    job->setAutoDelete(false);
+    QVERIFY(job->exec());
+    QCOMPARE(QFile::permissions(m_testDir->path() + "/b") & ~(QFile::ReadUser | QFile::WriteUser | QFile::ExeUser),
+             permissions);
+}
+
+void LocalCopyJobTest::testTimes()
+{
+#ifdef Q_OS_WIN
+    QSKIP("The times are not copied on Windows");
+#else
+    m_testDir->createFile("a/b", "b");
+
+    // The times of the folder must be applied after its items have been
+    // copied, and the milliseconds must not get lost
+    struct timespec times[2];
+    times[0].tv_sec = 1262347200;
+    times[0].tv_nsec = 0;
+    times[1].tv_sec = 1262347200;
+    times[1].tv_nsec = 123456789;
+    QCOMPARE(::utimensat(AT_FDCWD, QFile::encodeName(m_testDir->path() + "/a/b").constData(), times, 0), 0);
+    times[1].tv_sec = 1262433600;
+    QCOMPARE(::utimensat(AT_FDCWD, QFile::encodeName(m_testDir->path() + "/a").constData(), times, 0), 0);
+
+    QScopedPointer<LocalCopyJob> job(new LocalCopyJob({url("a")}, {url("c")}));
+    job->setAutoDelete(false);
+    QVERIFY(job->exec());
+    QCOMPARE(QFileInfo(m_testDir->path() + "/c/b").lastModified(), QFileInfo(m_testDir->path() + "/a/b").lastModified());
+    QCOMPARE(QFileInfo(m_testDir->path() + "/c").lastModified(), QFileInfo(m_testDir->path() + "/a").lastModified());
+    QCOMPARE(QFileInfo(m_testDir->path() + "/c").lastModified().time().msec(), 123);
+#endif
+}
+
+void LocalCopyJobTest::testIncompleteCopy()
+{
+#ifdef Q_OS_WIN
+    QSKIP("Special files are not supported on Windows");
+#else
+    m_testDir->createFile("a/b", "b");
+    QCOMPARE(::mkfifo(QFile::encodeName(m_testDir->path() + "/a/c").constData(), 0600), 0);
+
+    // The special file cannot be copied, so the folder must not be left behind
+    QScopedPointer<LocalCopyJob> job(new LocalCopyJob({url("a")}, {url("d")}));
+    job->setAutoDelete(false);
+    QVERIFY(!job->exec());
+    QVERIFY(job->copiedUrls().isEmpty());
+    QVERIFY(!QFileInfo::exists(m_testDir->path() + "/d"));
+#endif
+}
+
+void LocalCopyJobTest::testCopyIntoItself()
+{
+    m_testDir->createFile("a/b", "b");
+
+    QScopedPointer<LocalCopyJob> job(new LocalCopyJob({url("a")}, {url("a/c")}));
+    job->setAutoDelete(false);
+    QVERIFY(!job->exec());
+    QVERIFY(!QFileInfo::exists(m_testDir->path() + "/a/c"));
+}
+
+void LocalCopyJobTest::testCopyInto()
+{
+#ifndef Q_OS_LINUX
+    QSKIP("LocalCopyJob::copyInto() is only supported on Linux");
+#endif
+    m_testDir->createFile("a", "a");
+    m_testDir->createFile("b/c", "c");
+    m_testDir->createDir("d");
+
+    QScopedPointer<LocalCopyJob> job(LocalCopyJob::copyInto({url("a"), url("b")}, url("d")));
+    QVERIFY(job);
+    job->setAutoDelete(false);
+    QVERIFY(job->exec());
+    QCOMPARE(job->copiedUrls(), QList<QUrl>({url("d/a"), url("d/b")}));
+    QCOMPARE(fileData("d/b/c"), QByteArray("c"));
+
+    QVERIFY(!LocalCopyJob::copyInto({QUrl(QStringLiteral("sftp://host/a"))}, url("d")));
+}
+
+void LocalCopyJobTest::testCopyIntoByKio_data()
+{
+    QTest::addColumn<QString>("source");
+    QTest::addColumn<QString>("destination");
+
+    // Conflicts must be resolved by KIO
+    QTest::newRow("conflict") << "a" << "d";
+    // Copying a folder into itself is rejected by KIO
+    QTest::newRow("into itself") << "b" << "b";
+}
+
+void LocalCopyJobTest::testCopyIntoByKio()
+{
+#ifndef Q_OS_LINUX
+    QSKIP("LocalCopyJob::copyInto() is only supported on Linux");
+#endif
+    QFETCH(QString, source);
+    QFETCH(QString, destination);
+
+    m_testDir->createFile("a", "a");
+    m_testDir->createFile("b/c", "c");
+    m_testDir->createFile("d/a", "existing");
+
+    QScopedPointer<LocalCopyJob> job(LocalCopyJob::copyInto({url(source)}, url(destination)));
+    QVERIFY(job);
+    job->setAutoDelete(false);
+
+    // The job must leave the copying to KIO without copying anything
+    QSignalSpy copyJobStartedSpy(job.data(), &LocalCopyJob::copyJobStarted);
+    connect(job.data(), &LocalCopyJob::copyJobStarted, this, [](KIO::CopyJob* copyJob) {
+        copyJob->kill();
+    });
+    QVERIFY(!job->exec());
+    QCOMPARE(copyJobStartedSpy.count(), 1);
+    QVERIFY(job->copiedUrls().isEmpty());
+    QCOMPARE(fileData("d/a"), QByteArray("existing"));
+    QVERIFY(!QFileInfo::exists(m_testDir->path() + "/b/b"));
+}
+
+QUrl LocalCopyJobTest::url(const QString& path) const
+{
+    return QUrl::fromLocalFile(m_testDir->path() + QLatin1Char('/') + path);
+}
+
+QByteArray LocalCopyJobTest::fileData(const QString& path) const
+{
+    QFile file(m_testDir->path() + QLatin1Char('/') + path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+QTEST_GUILESS_MAIN(LocalCopyJobTest)
+
+#include "localcopyjobtest.moc"
@@ -0,0 +1,194 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "views/versioncontrol/repositoryrootcache.h"
+#include "testdir.h"
+
+#include <QDir>
+#include <QSignalSpy>
+#include <QTest>
+
+class RepositoryRootCacheTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testLookup();
+    void testDirectoriesBelowRoot();
+    void testInheritedFromParent();
+    void testNotVersioned();
+    void testInvalidateOnCreatedMetadata();
+    void testInvalidateOnRemovedMetadata();
+
+private:
+    QString path(const QString& relativePath) const;
+
+    /**
+     * Caches \a entry for \a directory like VersionControlObserver, which
+     * reads the metadata in the worker thread of the discovery.
+     */
+    void insert(const QString& directory, const RepositoryRootCache::Entry& entry);
+
+private:
+    TestDir* m_testDir;
+};
+
+void RepositoryRootCacheTest::initTestCase()
+{
+    RepositoryRootCache::instance().addMetadataFileNames({".git", ".svn", ".hg"});
+}
+
+void RepositoryRootCacheTest::init()
+{
+    m_testDir = new TestDir();
+    RepositoryRootCache::instance().clear();
+}
+
+void RepositoryRootCacheTest::cleanup()
+{
+    RepositoryRootCache::instance().clear();
+    delete m_testDir;
+    m_testDir = nullptr;
+}
+
+void RepositoryRootCacheTest::testLookup()
+{
+    RepositoryRootCache& cache = RepositoryRootCache::instance();
+    m_testDir->createDir("repo/.git");
+
+    RepositoryRootCache::Entry entry;
+    QVERIFY(!cache.lookup(path("repo"), entry));
+
+    insert(path("repo"), {".git", path("repo")});
+    QVERIFY(cache.lookup(path("repo"), entry));
+    QCOMPARE(entry.fileName, QString(".git"));
+    QCOMPARE(entry.root, path("repo"));
+
+    // A trailing slash does not matter
+    QVERIFY(cache.lookup(path("repo") + '/', entry));
+    QCOMPARE(entry.root, path("repo"));
+}
+
+void RepositoryRootCacheTest::testDirectoriesBelowRoot()
+{
+    RepositoryRootCache& cache = RepositoryRootCache::instance();
+    m_testDir->createDir("repo/.git");
+    m_testDir->createDir("repo/a/b/c");
+
+    insert(path("repo/a/b/c"), {".git", path("repo")});
+    QCOMPARE(cache.count(), 4);
+
+    // The directories between the directory and the root are cached, too
+    RepositoryRootCache::Entry entry;
+    QVERIFY(cache.lookup(path("repo/a"), entry));
+    QCOMPARE(entry.root, path("repo"));
+    QVERIFY(cache.lookup(path("repo/a/b"), entry));
+    QCOMPARE(entry.root, path("repo"));
+    QVERIFY(!cache.lookup(m_testDir->path(), entry));
+}
+
+void RepositoryRootCacheTest::testInheritedFromParent()
+{
+    RepositoryRootCache& cache = RepositoryRootCache::instance();
+    m_testDir->createDir("repo/.git");
+    m_testDir->createDir("repo/a/b");
+    m_testDir->createDir("other/a");
+
+    insert(path("repo"), {".git", path("repo")});
+    insert(path("other"), RepositoryRootCache::Entry());
+
+    // Subdirectories of a versioned directory get the repository of the parent
+    RepositoryRootCache::Entry entry;
+    bool inherited = false;
+    QVERIFY(cache.lookup(path("repo/a/b"), entry, &inherited));
+    QVERIFY(inherited);
+    QCOMPARE(entry.fileName, QString(".git"));
+    QCOMPARE(entry.root, path("repo"));
+    QCOMPARE(cache.count(), 2);
+
+    QVERIFY(cache.lookup(path("repo"), entry, &inherited));
+    QVERIFY(!inherited);
+
+    // Subdirectories of an unversioned directory might contain a repository
+    QVERIFY(!cache.lookup(path("other/a"), entry, &inherited));
+}
+
+void RepositoryRootCacheTest::testNotVersioned()
+{
+    RepositoryRootCache& cache = RepositoryRootCache::instance();
+    m_testDir->createDir("a/b");
+
+    insert(path("a/b"), RepositoryRootCache::Entry());
+
+    RepositoryRootCache::Entry entry;
+    QVERIFY(cache.lookup(path("a/b"), entry));
+    QVERIFY(entry.fileName.isEmpty());
+
+    // Parent directories of a directory that is not versioned are not cached
+    QVERIFY(!cache.lookup(path("a"), entry));
+}
+
+void RepositoryRootCacheTest::testInvalidateOnCreatedMetadata()
+{
+    RepositoryRootCache& cache = RepositoryRootCache::instance();
+    QSignalSpy invalidatedSpy(&cache, &RepositoryRootCache::invalidated);
+    QVERIFY(invalidatedSpy.isValid());
+
+    m_testDir->createDir("a/b");
+    insert(path("a/b"), RepositoryRootCache::Entry());
+    insert(path("a"), RepositoryRootCache::Entry());
+
+    // Other changes in the watched directories don't invalidate the results
+    m_testDir->createFile("a/file.txt");
+    QTest::qWait(500);
+    QCOMPARE(invalidatedSpy.count(), 0);
+
+    m_testDir->createDir("a/b/.hg");
+    QTRY_COMPARE(invalidatedSpy.count(), 1);
+
+    RepositoryRootCache::Entry entry;
+    QVERIFY(!cache.lookup(path("a/b"), entry));
+    QVERIFY(cache.lookup(path("a"), entry));
+}
+
+void RepositoryRootCacheTest::testInvalidateOnRemovedMetadata()
+{
+    RepositoryRootCache& cache = RepositoryRootCache::instance();
+    QSignalSpy invalidatedSpy(&cache, &RepositoryRootCache::invalidated);
+    QVERIFY(invalidatedSpy.isValid());
+
+    m_testDir->createDir("repo/.git");
+    m_testDir->createDir("repo/a");
+    insert(path("repo/a"), {".git", path("repo")});
+
+    QVERIFY(QDir(path("repo/.git")).removeRecursively());
+    QTRY_COMPARE(invalidatedSpy.count(), 1);
+
+    RepositoryRootCache::Entry entry;
+    QVERIFY(!cache.lookup(path("repo"), entry));
+    QVERIFY(!cache.lookup(path("repo/a"), entry));
+    QCOMPARE(cache.count(), 0);
+}
+
+QString RepositoryRootCacheTest::path(const QString& relativePath) const
+{
+    return m_testDir->path() + '/' + relativePath;
+}
+
+void RepositoryRootCacheTest::insert(const QString& directory, const RepositoryRootCache::Entry& entry)
+{
+    RepositoryRootCache& cache = RepositoryRootCache::instance();
+    const QStringList dependencies = RepositoryRootCache::dependencies(directory, entry);
+    cache.insert(directory, entry, RepositoryRootCache::readMetadata(dependencies, cache.metadataFileNames()));
+}
+
+QTEST_GUILESS_MAIN(RepositoryRootCacheTest)
+
+#include "repositoryrootcachetest.moc"
@@ -0,0 +1,44 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "testhelpers.h"
+
+#include <KIO/UDSEntry>
+
+#include <QUrlQuery>
+
+QUrl TestHelpers::directoryUrl()
+{
+    return QUrl::fromLocalFile(QStringLiteral("/dir"));
+}
+
+KFileItem TestHelpers::fileItem(const QString& name, KIO::filesize_t size)
+{
+    KIO::UDSEntry entry;
+    entry.fastInsert(KIO::UDSEntry::UDS_NAME, name);
+    entry.fastInsert(KIO::UDSEntry::UDS_FILE_TYPE, S_IFREG);
+    entry.fastInsert(KIO::UDSEntry::UDS_SIZE, size);
+    entry.fastInsert(KIO::UDSEntry::UDS_MIME_TYPE, QStringLiteral("text/plain"));
+
+    QUrl url = directoryUrl();
+    url.setPath(url.path() + QLatin1Char('/') + name);
+    return KFileItem(entry, url);
+}
+
+QUrl TestHelpers::searchUrl(const QString& text, const QUrl& folderUrl, bool checkContent)
+{
+    QUrl url;
+    url.setScheme(QStringLiteral("filenamesearch"));
+
+    QUrlQuery query;
+    query.addQueryItem(QStringLiteral("search"), text);
+    if (checkContent) {
+        query.addQueryItem(QStringLiteral("checkContent"), QStringLiteral("yes"));
+    }
+    query.addQueryItem(QStringLiteral("url"), folderUrl.url());
+    url.setQuery(query);
+    return url;
+}
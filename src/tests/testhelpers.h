@@ -0,0 +1,41 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef TESTHELPERS_H
+#define TESTHELPERS_H
+
+#include <KFileItem>
+
+#include <QUrl>
+
+/**
+ * @brief Functions that are shared by the unit tests.
+ */
+class TestHelpers
+{
+public:
+    /**
+     * @return URL of the directory that contains the items of fileItem().
+     *         The directory does not exist on the disk.
+     */
+    static QUrl directoryUrl();
+
+    /**
+     * @return Text file with the name \a name and the size \a size inside
+     *         directoryUrl(), which is created from an UDS entry, so that
+     *         no file is created on the disk.
+     */
+    static KFileItem fileItem(const QString& name, KIO::filesize_t size = 0);
+
+    /**
+     * @return URL of the file name search for \a text in the folder
+     *         \a folderUrl. If \a checkContent is true, the contents
+     *         of the files are searched too.
+     */
+    static QUrl searchUrl(const QString& text, const QUrl& folderUrl, bool checkContent = false);
+};
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef TESTJOB_H
+#define TESTJOB_H
+
+#include <KJob>
+
+/**
+ * @brief Job for the unit tests that does nothing until finish() is invoked.
+ *
+ * Killing, suspending and resuming the job always succeeds.
+ */
+class TestJob : public KJob
+{
+public:
+    void start() override
+    {
+    }
+
+    /**
+     * Emits the result of the job without an error.
+     */
+    void finish()
+    {
+        emitResult();
+    }
+
+protected:
+    bool doKill() override
+    {
+        return true;
+    }
+
+    bool doSuspend() override
+    {
+        return true;
+    }
+
+    bool doResume() override
+    {
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,326 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "testtree.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QTemporaryDir>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // Is increased if the generated trees change, so that outdated
+    // trees in the cache are not used anymore
+    const int TreeVersion = 1;
+
+    const char* const CompleteSuffix = ".complete";
+    const char* const TemplateSuffix = ".template";
+
+    // A generator of its own is used instead of the distributions of <random>,
+    // whose results differ between the implementations of the standard library
+    quint32 nextRandom(quint32& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    const QStringList& words()
+    {
+        static const QStringList words = {
+            QStringLiteral("Notes"), QStringLiteral("report"), QStringLiteral("Übersicht"),
+            QStringLiteral("résumé"), QStringLiteral("holiday"), QStringLiteral("写真"),
+            QStringLiteral("draft"), QStringLiteral("final"), QStringLiteral("Budget"),
+            QStringLiteral("data"), QStringLiteral("backup"), QStringLiteral("Ελληνικά"),
+            QStringLiteral("build"), QStringLiteral("README"), QStringLiteral("año"),
+            QStringLiteral("Invoice")
+        };
+        return words;
+    }
+
+    const QStringList& extensions()
+    {
+        static const QStringList extensions = {
+            QString(), QStringLiteral("txt"), QStringLiteral("pdf"), QStringLiteral("jpg"),
+            QStringLiteral("png"), QStringLiteral("odt"), QStringLiteral("cpp"), QStringLiteral("h"),
+            QStringLiteral("tar.gz"), QStringLiteral("mp3"), QStringLiteral("mkv"), QStringLiteral("JPG")
+        };
+        return extensions;
+    }
+
+    const QStringList& separators()
+    {
+        static const QStringList separators = {
+            QStringLiteral(" "), QStringLiteral("_"), QStringLiteral("-"), QString()
+        };
+        return separators;
+    }
+
+    const QString& pick(const QStringList& list, quint32& random)
+    {
+        return list.at(nextRandom(random) % list.count());
+    }
+}
+
+TestTree::TestTree(const Options& options) :
+    m_options(options),
+    m_temporaryDir(),
+    m_path(),
+    m_templateFilePath(),
+    m_fileCount(0),
+    m_directoryCount(0)
+{
+}
+
+TestTree::~TestTree()
+{
+}
+
+bool TestTree::create()
+{
+    const QString base = baseDirectory();
+    if (base.isEmpty()) {
+        const QFileInfo sharedMemory(QStringLiteral("/dev/shm"));
+        const QString temporaryPath = (sharedMemory.isDir() && sharedMemory.isWritable())
+                                    ? sharedMemory.filePath() : QDir::tempPath();
+        m_temporaryDir.reset(new QTemporaryDir(temporaryPath + QLatin1String("/dolphin-testtree-XXXXXX")));
+        if (!m_temporaryDir->isValid()) {
+            return false;
+        }
+        return createAt(m_temporaryDir->path() + QLatin1String("/tree"));
+    }
+
+    if (!QDir().mkpath(base)) {
+        return false;
+    }
+
+    const QString path = base + QLatin1Char('/') + cacheKey(m_options);
+    QFile completeFile(path + QLatin1String(CompleteSuffix));
+    if (completeFile.open(QIODevice::ReadOnly)) {
+        // The file contains the number of files and directories
+        const QList<QByteArray> counts = completeFile.readAll().trimmed().split(' ');
+        if (counts.count() == 2) {
+            m_path = path;
+            m_fileCount = counts.at(0).toInt();
+            m_directoryCount = counts.at(1).toInt();
+            return true;
+        }
+        completeFile.close();
+    }
+
+    // The creation of the tree has been interrupted by a previous run
+    QDir(path).removeRecursively();
+
+    if (!createAt(path)) {
+        return false;
+    }
+
+    if (!completeFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    completeFile.write(QByteArray::number(m_fileCount) + ' ' + QByteArray::number(m_directoryCount));
+    return true;
+}
+
+bool TestTree::createAt(const QString& path)
+{
+    m_path = QFileInfo(path).absoluteFilePath();
+    m_templateFilePath = m_path + QLatin1String(TemplateSuffix);
+    m_fileCount = 0;
+    m_directoryCount = 0;
+
+#ifdef Q_OS_UNIX
+    if (!QDir().mkpath(m_path)) {
+        return false;
+    }
+
+    // The hard links are created to a file next to the tree, so
+    // that the file does not show up in the listings
+    if (m_options.hardLinks && !createTemplateFile()) {
+        return false;
+    }
+
+    const int rootFd = ::open(QFile::encodeName(m_path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) {
+        return false;
+    }
+
+    quint32 random = m_options.seed ^ 0x9e3779b9;
+    if (random == 0) {
+        random = 1;
+    }
+    const bool created = createDirectory(rootFd, 0, random);
+    ::close(rootFd);
+    return created;
+#else
+    return false;
+#endif
+}
+
+QString TestTree::path() const
+{
+    return m_path;
+}
+
+QUrl TestTree::url() const
+{
+    return QUrl::fromLocalFile(m_path);
+}
+
+int TestTree::fileCount() const
+{
+    return m_fileCount;
+}
+
+int TestTree::directoryCount() const
+{
+    return m_directoryCount;
+}
+
+QString TestTree::baseDirectory()
+{
+    return qEnvironmentVariable("DOLPHIN_TEST_TREE_DIR");
+}
+
+QString TestTree::cacheKey(const Options& options)
+{
+    static const char* const distributionNames[] = {"numbered", "camera", "mixed"};
+
+    return QStringLiteral("v%1-depth%2-%3x%4-hidden%5-%6-%7-seed%8")
+            .arg(TreeVersion)
+            .arg(options.depth)
+            .arg(options.directoriesPerDirectory)
+            .arg(options.filesPerDirectory)
+            .arg(qRound(options.hiddenRatio * 1000))
+            .arg(QLatin1String(distributionNames[options.names]))
+            .arg(options.hardLinks ? QLatin1String("links") : QLatin1String("empty"))
+            .arg(options.seed);
+}
+
+bool TestTree::createDirectory(int directoryFd, int level, quint32& random)
+{
+#ifdef Q_OS_UNIX
+    for (int i = 0; i < m_options.filesPerDirectory; ++i) {
+        const QByteArray name = QFile::encodeName(entryName(random, i, false));
+        if (m_options.hardLinks) {
+            int result = ::linkat(AT_FDCWD, QFile::encodeName(m_templateFilePath).constData(),
+                                  directoryFd, name.constData(), 0);
+            if (result < 0 && errno == EMLINK) {
+                // The maximum number of links of the file system is reached,
+                // the file that has been linked so far keeps its links
+                if (!createTemplateFile()) {
+                    return false;
+                }
+                result = ::linkat(AT_FDCWD, QFile::encodeName(m_templateFilePath).constData(),
+                                  directoryFd, name.constData(), 0);
+            }
+            if (result < 0) {
+                return false;
+            }
+        } else {
+            const int fd = ::openat(directoryFd, name.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                return false;
+            }
+            ::close(fd);
+        }
+        ++m_fileCount;
+    }
+
+    if (level >= m_options.depth) {
+        return true;
+    }
+
+    for (int i = 0; i < m_options.directoriesPerDirectory; ++i) {
+        const QByteArray name = QFile::encodeName(entryName(random, i, true));
+        if (::mkdirat(directoryFd, name.constData(), 0755) < 0) {
+            return false;
+        }
+        ++m_directoryCount;
+
+        const int subDirectoryFd = ::openat(directoryFd, name.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (subDirectoryFd < 0) {
+            return false;
+        }
+        const bool created = createDirectory(subDirectoryFd, level + 1, random);
+        ::close(subDirectoryFd);
+        if (!created) {
+            return false;
+        }
+    }
+    return true;
+#else
+    Q_UNUSED(directoryFd)
+    Q_UNUSED(level)
+    Q_UNUSED(random)
+    return false;
+#endif
+}
+
+QString TestTree::entryName(quint32& random, int index, bool isDir) const
+{
+    // The index is part of each name, so that the names of a directory are unique
+    QString name;
+    switch (m_options.names) {
+    case NumberedNames:
+        name = isDir ? QStringLiteral("dir-%1").arg(index, 4, 10, QLatin1Char('0'))
+                     : QStringLiteral("file-%1.txt").arg(index, 6, 10, QLatin1Char('0'));
+        break;
+    case CameraNames:
+        if (isDir) {
+            name = QStringLiteral("%1CANON").arg(100 + index);
+        } else if (nextRandom(random) % 2 == 0) {
+            name = QStringLiteral("IMG_%1.JPG").arg(index, 4, 10, QLatin1Char('0'));
+        } else {
+            name = QStringLiteral("DSC%1.jpg").arg(index, 5, 10, QLatin1Char('0'));
+        }
+        break;
+    case MixedNames:
+        if (isDir) {
+            name = pick(words(), random) + QLatin1Char(' ') + QString::number(index);
+        } else {
+            const QString& extension = pick(extensions(), random);
+            name = pick(words(), random) + pick(separators(), random) + pick(words(), random)
+                 + pick(separators(), random) + QString::number(index);
+            if (!extension.isEmpty()) {
+                name += QLatin1Char('.') + extension;
+            }
+        }
+        break;
+    }
+
+    const quint32 hiddenThreshold = quint32(qBound(0.0, m_options.hiddenRatio, 1.0) * 10000);
+    if (nextRandom(random) % 10000 < hiddenThreshold) {
+        name.prepend(QLatin1Char('.'));
+    }
+    return name;
+}
+
+bool TestTree::createTemplateFile()
+{
+#ifdef Q_OS_UNIX
+    const QByteArray path = QFile::encodeName(m_templateFilePath);
+    ::unlink(path.constData());
+    const int fd = ::open(path.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    ::close(fd);
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef TESTTREE_H
+#define TESTTREE_H
+
+#include <QScopedPointer>
+#include <QString>
+#include <QUrl>
+
+class QTemporaryDir;
+
+/**
+ * TestTree creates large directory trees for benchmarks. In contrast to
+ * TestDir, which creates a few files one by one, it creates millions of
+ * empty or hard linked files with openat() and linkat() relative to the
+ * file descriptors of their directories.
+ *
+ * The trees are reproducible: The same options always result in the same
+ * names. If the environment variable DOLPHIN_TEST_TREE_DIR is set, a created
+ * tree is kept in that directory and is reused by later runs with the same
+ * options, so that the benchmarks don't spend most of their time creating
+ * their data. Otherwise the tree is created in a temporary directory, which
+ * is removed together with the TestTree. The temporary directory is created
+ * in the tmpfs /dev/shm if it is available, so that the benchmarks don't
+ * measure the disk.
+ */
+class TestTree
+{
+
+public:
+    enum NameDistribution {
+        NumberedNames,  // "file-000042.txt", all names have the same length
+        CameraNames,    // "IMG_0042.JPG", "DSC00042.jpg", like the folders of a camera
+        MixedNames      // Words, spaces, digits, non-ASCII letters and many extensions
+    };
+
+    struct Options
+    {
+        int depth = 2;                      // Levels of subdirectories below the root
+        int directoriesPerDirectory = 10;
+        int filesPerDirectory = 100;
+        qreal hiddenRatio = 0.0;            // Fraction of the files and directories that are hidden
+        NameDistribution names = MixedNames;
+        bool hardLinks = true;              // Hard links to one file are created faster than empty files
+        quint32 seed = 1;
+    };
+
+    explicit TestTree(const Options& options);
+    virtual ~TestTree();
+
+    /**
+     * Creates the tree in baseDirectory() if it has not been created by a
+     * previous run yet. A tree whose creation has been interrupted is
+     * removed and created again. If baseDirectory() is empty, the tree is
+     * created in a temporary directory, which is removed by the destructor.
+     *
+     * @return False if the tree could not be created.
+     */
+    bool create();
+
+    /**
+     * Creates the tree in the directory \a path, which is created if it
+     * does not exist yet. The tree is not cached.
+     *
+     * @return False if the tree could not be created.
+     */
+    bool createAt(const QString& path);
+
+    QString path() const;
+    QUrl url() const;
+
+    /**
+     * @return Number of the files and directories of the tree, without the
+     *         root. Are valid after create() or createAt() has succeeded.
+     */
+    int fileCount() const;
+    int directoryCount() const;
+
+    /**
+     * @return Directory that contains the cached trees, or an empty string
+     *         if DOLPHIN_TEST_TREE_DIR is not set and the trees are not cached.
+     */
+    static QString baseDirectory();
+
+    /**
+     * @return Name that identifies the tree of \a options in baseDirectory().
+     */
+    static QString cacheKey(const Options& options);
+
+private:
+    bool createDirectory(int directoryFd, int level, quint32& random);
+    QString entryName(quint32& random, int index, bool isDir) const;
+    bool createTemplateFile();
+
+private:
+    Options m_options;
+    QScopedPointer<QTemporaryDir> m_temporaryDir;
+    QString m_path;
+    QString m_templateFilePath;
+    int m_fileCount;
+    int m_directoryCount;
+};
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "testtree.h"
+
+#include <QDirIterator>
+#include <QTemporaryDir>
+#include <QTest>
+
+namespace {
+    QStringList entries(const QString& path)
+    {
+        QStringList entries;
+        QDirIterator it(path, QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            entries.append(it.next().mid(path.length()));
+        }
+        entries.sort();
+        return entries;
+    }
+}
+
+class TestTreeTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testCounts_data();
+    void testCounts();
+    void testReproducible();
+    void testHiddenRatio();
+    void testTemporaryTree();
+};
+
+void TestTreeTest::testCounts_data()
+{
+    QTest::addColumn<int>("names");
+    QTest::addColumn<bool>("hardLinks");
+
+    QTest::newRow("numbered, links") << int(TestTree::NumberedNames) << true;
+    QTest::newRow("camera, empty files") << int(TestTree::CameraNames) << false;
+    QTest::newRow("mixed, links") << int(TestTree::MixedNames) << true;
+}
+
+void TestTreeTest::testCounts()
+{
+    QFETCH(int, names);
+    QFETCH(bool, hardLinks);
+
+    TestTree::Options options;
+    options.depth = 2;
+    options.directoriesPerDirectory = 3;
+    options.filesPerDirectory = 5;
+    options.names = static_cast<TestTree::NameDistribution>(names);
+    options.hardLinks = hardLinks;
+
+    QTemporaryDir dir;
+    TestTree tree(options);
+    QVERIFY(tree.createAt(dir.path() + QLatin1String("/tree")));
+
+    // 1 + 3 + 9 directories contain the files, the root is not counted
+    QCOMPARE(tree.directoryCount(), 3 + 9);
+    QCOMPARE(tree.fileCount(), (1 + 3 + 9) * 5);
+    QCOMPARE(entries(tree.path()).count(), tree.directoryCount() + tree.fileCount());
+}
+
+void TestTreeTest::testReproducible()
+{
+    TestTree::Options options;
+    options.directoriesPerDirectory = 4;
+    options.filesPerDirectory = 20;
+    options.hiddenRatio = 0.2;
+
+    QTemporaryDir dir;
+    TestTree tree1(options);
+    QVERIFY(tree1.createAt(dir.path() + QLatin1String("/tree1")));
+    TestTree tree2(options);
+    QVERIFY(tree2.createAt(dir.path() + QLatin1String("/tree2")));
+    QCOMPARE(entries(tree1.path()), entries(tree2.path()));
+
+    options.seed = 2;
+    TestTree tree3(options);
+    QVERIFY(tree3.createAt(dir.path() + QLatin1String("/tree3")));
+    QVERIFY(entries(tree1.path()) != entries(tree3.path()));
+}
+
+void TestTreeTest::testHiddenRatio()
+{
+    TestTree::Options options;
+    options.depth = 0;
+    options.filesPerDirectory = 50;
+    options.names = TestTree::NumberedNames;
+
+    QTemporaryDir dir;
+    options.hiddenRatio = 1.0;
+    TestTree hiddenTree(options);
+    QVERIFY(hiddenTree.createAt(dir.path() + QLatin1String("/hidden")));
+    QCOMPARE(QDir(hiddenTree.path()).entryList(QDir::Files).count(), 0);
+    QCOMPARE(QDir(hiddenTree.path()).entryList(QDir::Files | QDir::Hidden).count(), 50);
+
+    options.hiddenRatio = 0.0;
+    TestTree visibleTree(options);
+    QVERIFY(visibleTree.createAt(dir.path() + QLatin1String("/visible")));
+    QCOMPARE(QDir(visibleTree.path()).entryList(QDir::Files).count(), 50);
+}
+
+void TestTreeTest::testTemporaryTree()
+{
+    qunsetenv("DOLPHIN_TEST_TREE_DIR");
+
+    TestTree::Options options;
+    options.depth = 1;
+    options.directoriesPerDirectory = 2;
+    options.filesPerDirectory = 5;
+
+    QString path;
+    {
+        TestTree tree(options);
+        QVERIFY(tree.create());
+        path = tree.path();
+        QCOMPARE(entries(path).count(), tree.directoryCount() + tree.fileCount());
+    }
+
+    // The tree is not cached and is removed together with the TestTree
+    QVERIFY(!QFileInfo::exists(path));
+}
+
+QTEST_GUILESS_MAIN(TestTreeTest)
+
+#include "testtreetest.moc"
@@ -0,0 +1,116 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "trash/trashstatistics.h"
+
+#include <QDir>
+#include <QFile>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTest>
+
+class TrashStatisticsTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testIsTrashRoot();
+    void testSize();
+
+private:
+    /**
+     * Creates the trashed item \a name with its .trashinfo file. If \a size
+     * is negative, a folder that contains a file of -\a size bytes is created.
+     */
+    void trash(const QString& name, int size);
+
+    /**
+     * Computes the statistics and waits for the result.
+     */
+    bool update();
+
+    QString m_trashPath;
+};
+
+void TrashStatisticsTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+
+    m_trashPath = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1String("/Trash");
+    QDir(m_trashPath).removeRecursively();
+    QVERIFY(QDir().mkpath(m_trashPath + QLatin1String("/info")));
+    QVERIFY(QDir().mkpath(m_trashPath + QLatin1String("/files")));
+}
+
+void TrashStatisticsTest::cleanupTestCase()
+{
+    QDir(m_trashPath).removeRecursively();
+}
+
+void TrashStatisticsTest::testIsTrashRoot()
+{
+    QVERIFY(TrashStatistics::isTrashRoot(QUrl(QStringLiteral("trash:/"))));
+    QVERIFY(TrashStatistics::isTrashRoot(QUrl(QStringLiteral("trash:"))));
+    QVERIFY(!TrashStatistics::isTrashRoot(QUrl(QStringLiteral("trash:/0-folder"))));
+    QVERIFY(!TrashStatistics::isTrashRoot(QUrl::fromLocalFile(m_trashPath)));
+}
+
+void TrashStatisticsTest::testSize()
+{
+    TrashStatistics& statistics = TrashStatistics::instance();
+    QVERIFY(update());
+    QVERIFY(statistics.isValid());
+    QCOMPARE(statistics.size(), qint64(0));
+
+    trash(QStringLiteral("a.txt"), 100);
+    trash(QStringLiteral("folder"), -1000);
+    QVERIFY(update());
+    QCOMPARE(statistics.size(), qint64(1100));
+
+    // A file without .trashinfo file is no trashed item
+    QFile file(m_trashPath + QLatin1String("/files/orphan.txt"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(QByteArray(10, 'x'));
+    file.close();
+
+    QVERIFY(QFile::remove(m_trashPath + QLatin1String("/info/a.txt.trashinfo")));
+    QVERIFY(QFile::remove(m_trashPath + QLatin1String("/files/a.txt")));
+    QVERIFY(update());
+    QCOMPARE(statistics.size(), qint64(1000));
+}
+
+void TrashStatisticsTest::trash(const QString& name, int size)
+{
+    QString filePath = m_trashPath + QLatin1String("/files/") + name;
+    if (size < 0) {
+        QVERIFY(QDir().mkpath(filePath));
+        filePath += QLatin1String("/file");
+        size = -size;
+    }
+
+    QFile file(filePath);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(QByteArray(size, 'x'));
+    file.close();
+
+    QFile infoFile(m_trashPath + QLatin1String("/info/") + name + QLatin1String(".trashinfo"));
+    QVERIFY(infoFile.open(QIODevice::WriteOnly));
+    infoFile.write("[Trash Info]\nPath=/tmp/" + name.toUtf8() + "\nDeletionDate=2021-01-01T00:00:00\n");
+}
+
+bool TrashStatisticsTest::update()
+{
+    QSignalSpy changedSpy(&TrashStatistics::instance(), &TrashStatistics::statisticsChanged);
+    TrashStatistics::instance().update();
+    return changedSpy.wait();
+}
+
+QTEST_GUILESS_MAIN(TrashStatisticsTest)
+
+#include "trashstatisticstest.moc"
@@ -5,9 +5,13 @@
  */
 
 #include "dolphin_generalsettings.h"
+#include "views/directoryloadprofile.h"
 #include "views/viewproperties.h"
 #include "testdir.h"
 
+#include <KConfigGroup>
+#include <KConfig>
+
 #include <QTest>
 
 class ViewPropertiesTest : public QObject
@@ -21,6 +25,9 @@ private Q_SLOTS:
 
     void testReadOnlyBehavior();
     void testAutoSave();
+    void testLegacyDirectoryFile();
+    void testSaveToDirectories();
+    void testLoadProfile();
 
 private:
     bool m_globalViewProps;
@@ -55,8 +62,8 @@ void ViewPropertiesTest::cleanup()
 }
 
 /**
- * Test whether only reading properties won't result in creating
- * a .directory file when destructing the ViewProperties instance
+ * Test whether only reading properties won't result in storing
+ * properties when destructing the ViewProperties instance
  * and autosaving is enabled.
  */
 void ViewPropertiesTest::testReadOnlyBehavior()
@@ -71,6 +78,7 @@ void ViewPropertiesTest::testReadOnlyBehavior()
     props.reset();
 
     QVERIFY(!QFile::exists(dotDirectoryFile));
+    QVERIFY(!ViewProperties(m_testDir->url()).exist());
 }
 
 void ViewPropertiesTest::testAutoSave()
@@ -83,7 +91,123 @@ void ViewPropertiesTest::testAutoSave()
     props->setSortRole("someNewSortRole");
     props.reset();
 
+    // The properties are kept by the ViewPropertiesStore instead of
+    // a .directory file inside the directory
+    QVERIFY(!QFile::exists(dotDirectoryFile));
+    QVERIFY(QFile::exists(ViewPropertiesStore::instance().filePath()));
+
+    props.reset(new ViewProperties(m_testDir->url()));
+    QVERIFY(props->exist());
+    QCOMPARE(props->sortRole(), QByteArray("someNewSortRole"));
+}
+
+/**
+ * Test whether the properties of an existing .directory file are used
+ * and moved to the ViewPropertiesStore when they are saved.
+ */
+void ViewPropertiesTest::testLegacyDirectoryFile()
+{
+    const QString dotDirectoryFile = m_testDir->url().toLocalFile() + "/.directory";
+    {
+        KConfig legacyConfig(dotDirectoryFile, KConfig::SimpleConfig);
+        KConfigGroup group(&legacyConfig, "Dolphin");
+        group.writeEntry("Version", 4);
+        group.writeEntry("SortRole", "size");
+        group.writeEntry("Timestamp", QDateTime::currentDateTime());
+
+        KConfigGroup desktopGroup(&legacyConfig, "Desktop Entry");
+        desktopGroup.writeEntry("Icon", "folder-red");
+    }
+    QVERIFY(QFile::exists(dotDirectoryFile));
+
+    // Reading the properties does not move them
+    QScopedPointer<ViewProperties> props(new ViewProperties(m_testDir->url()));
+    QVERIFY(props->exist());
+    QCOMPARE(props->sortRole(), QByteArray("size"));
+    props.reset();
     QVERIFY(QFile::exists(dotDirectoryFile));
+
+    props.reset(new ViewProperties(m_testDir->url()));
+    QCOMPARE(props->sortRole(), QByteArray("size"));
+    props->setSortOrder(Qt::DescendingOrder);
+    props.reset();
+
+    // The view properties are removed from the .directory file,
+    // the other groups are kept
+    {
+        const KConfig legacyConfig(dotDirectoryFile, KConfig::SimpleConfig);
+        QVERIFY(!legacyConfig.hasGroup("Dolphin"));
+        QCOMPARE(legacyConfig.group("Desktop Entry").readEntry("Icon"), QStringLiteral("folder-red"));
+    }
+
+    // The .directory file is not read anymore
+    QVERIFY(QFile::remove(dotDirectoryFile));
+    props.reset(new ViewProperties(m_testDir->url()));
+    QVERIFY(props->exist());
+    QCOMPARE(props->sortRole(), QByteArray("size"));
+    QCOMPARE(props->sortOrder(), Qt::DescendingOrder);
+}
+
+void ViewPropertiesTest::testSaveToDirectories()
+{
+    m_testDir->createDir("a");
+    m_testDir->createDir("a/b");
+    QUrl urlA = m_testDir->url();
+    urlA.setPath(urlA.path() + "/a");
+    QUrl urlB = m_testDir->url();
+    urlB.setPath(urlB.path() + "/a/b");
+
+    QScopedPointer<ViewProperties> props(new ViewProperties(m_testDir->url()));
+    props->setViewMode(DolphinView::DetailsView);
+    props->setSortRole("size");
+    props->saveToDirectories({urlA, urlB});
+    props.reset();
+
+    for (const QUrl& url : {urlA, urlB}) {
+        ViewProperties dirProps(url);
+        QVERIFY(dirProps.exist());
+        QCOMPARE(dirProps.viewMode(), DolphinView::DetailsView);
+        QCOMPARE(dirProps.sortRole(), QByteArray("size"));
+    }
+}
+
+void ViewPropertiesTest::testLoadProfile()
+{
+    const QUrl url = m_testDir->url();
+    QVERIFY(!DirectoryLoadProfile::load(url).isValid());
+
+    // The profiles of ordinary directories are not stored
+    DirectoryLoadProfile profile;
+    profile.record(url, 100, 50, 20);
+    QVERIFY(!DirectoryLoadProfile::load(url).isValid());
+
+    profile.record(url, 200000, 500, -1);
+    DirectoryLoadProfile loaded = DirectoryLoadProfile::load(url);
+    QVERIFY(loaded.isValid());
+    QCOMPARE(loaded.entryCount(), 200000);
+    QCOMPARE(loaded.listingTime(), 275);
+    QCOMPARE(loaded.previewTime(), 20);
+    QVERIFY(!loaded.resolveVisibleItemsOnly());
+
+    // The properties of the directory are not affected by its profile
+    QVERIFY(!ViewProperties(url).exist());
+
+    loaded.record(url, 200500, -1, 3000);
+    loaded = DirectoryLoadProfile::load(url);
+    QCOMPARE(loaded.entryCount(), 200500);
+    QVERIFY(loaded.resolveVisibleItemsOnly());
+
+    // The profile is not written again if the strategy stays the same
+    loaded.record(url, 201000, -1, 1510);
+    QCOMPARE(DirectoryLoadProfile::load(url).entryCount(), 200500);
+
+    // An incomplete visit only raises the values, as they are lower bounds
+    loaded = DirectoryLoadProfile::load(url);
+    loaded.record(url, 1000, 400, -1, false);
+    QCOMPARE(loaded.entryCount(), 200500);
+    QCOMPARE(loaded.listingTime(), 400);
+    loaded.record(url, 1000, 100, -1, false);
+    QCOMPARE(loaded.listingTime(), 400);
 }
 
 QTEST_GUILESS_MAIN(ViewPropertiesTest)
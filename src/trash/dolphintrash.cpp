@@ -13,28 +13,47 @@
 #include <KNotification>
 #include <KConfig>
 #include <KConfigGroup>
+#include <KDirNotify>
+#include <KDirWatch>
 #include <KLocalizedString>
 
+#include <QDBusConnection>
+#include <QStandardPaths>
+#include <QTimer>
+
 Trash::Trash()
-    : m_trashDirLister(new KDirLister())
+    : m_trashConfigWatcher(nullptr),
+      m_updateTimer(nullptr),
+      m_isEmpty(isEmpty())
 {
-    // The trash icon must always be updated dependent on whether
-    // the trash is empty or not. We use a KDirLister that automatically
-    // watches for changes if the number of items has been changed.
-    m_trashDirLister->setAutoErrorHandlingEnabled(false, nullptr);
-    m_trashDirLister->setDelayedMimeTypes(true);
-    auto trashDirContentChanged = [this]() {
-        bool isTrashEmpty = m_trashDirLister->items().isEmpty();
-        Q_EMIT emptinessChanged(isTrashEmpty);
-    };
-    connect(m_trashDirLister, QOverload<>::of(&KCoreDirLister::completed), this, trashDirContentChanged);
-    connect(m_trashDirLister, &KDirLister::itemsDeleted, this, trashDirContentChanged);
-    m_trashDirLister->openUrl(QUrl(QStringLiteral("trash:/")));
+    // The trash icon must always be updated dependent on whether the trash
+    // is empty or not. Listing the trash for this is expensive, instead the
+    // status that the trash KIO worker writes into trashrc is watched.
+    m_updateTimer = new QTimer(this);
+    m_updateTimer->setSingleShot(true);
+    m_updateTimer->setInterval(100);
+    connect(m_updateTimer, &QTimer::timeout, this, &Trash::updateEmptiness);
+
+    const QString trashConfigPath = QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation)
+                                    + QLatin1String("/trashrc");
+    m_trashConfigWatcher = new KDirWatch(this);
+    m_trashConfigWatcher->addFile(trashConfigPath);
+    connect(m_trashConfigWatcher, &KDirWatch::dirty, m_updateTimer, QOverload<>::of(&QTimer::start));
+    connect(m_trashConfigWatcher, &KDirWatch::created, m_updateTimer, QOverload<>::of(&QTimer::start));
+    connect(m_trashConfigWatcher, &KDirWatch::deleted, m_updateTimer, QOverload<>::of(&QTimer::start));
+
+    // The trash KIO worker announces the changes of the trash, which covers
+    // the case that the change of trashrc is not noticed by KDirWatch.
+    org::kde::KDirNotify* dirNotify = new org::kde::KDirNotify(QString(), QString(),
+                                                               QDBusConnection::sessionBus(), this);
+    connect(dirNotify, &OrgKdeKDirNotifyInterface::FilesAdded, this, [this](const QString& directory) {
+        slotFilesChanged({directory});
+    });
+    connect(dirNotify, &OrgKdeKDirNotifyInterface::FilesRemoved, this, &Trash::slotFilesChanged);
 }
 
 Trash::~Trash()
 {
-    delete m_trashDirLister;
 }
 
 Trash &Trash::instance()
@@ -69,3 +88,22 @@ bool Trash::isEmpty()
     return (trashConfig.group("Status").readEntry("Empty", true));
 }
 
+void Trash::updateEmptiness()
+{
+    const bool isTrashEmpty = isEmpty();
+    if (isTrashEmpty != m_isEmpty) {
+        m_isEmpty = isTrashEmpty;
+        Q_EMIT emptinessChanged(isTrashEmpty);
+    }
+}
+
+void Trash::slotFilesChanged(const QStringList& urls)
+{
+    for (const QString& url : urls) {
+        if (url.startsWith(QLatin1String("trash:"))) {
+            m_updateTimer->start();
+            return;
+        }
+    }
+}
+
@@ -11,8 +11,17 @@
 #include <QWidget>
 
 #include <KIO/EmptyTrashJob>
-#include <KIOWidgets/KDirLister>
 
+class KDirWatch;
+class QTimer;
+
+/**
+ * @brief Provides whether the trash is empty and allows to empty it.
+ *
+ * The emptiness is read from the status that the trash KIO worker stores
+ * in trashrc, which is watched for changes. The content of the trash is
+ * not listed, as the trash may contain a huge number of items.
+ */
 class Trash: public QObject
 {
     Q_OBJECT
@@ -31,8 +40,19 @@ public:
 Q_SIGNALS:
     void emptinessChanged(bool isEmpty);
 
+private Q_SLOTS:
+    /**
+     * Reads the emptiness of the trash and emits emptinessChanged()
+     * if it has been changed.
+     */
+    void updateEmptiness();
+
+    void slotFilesChanged(const QStringList& urls);
+
 private:
-    KDirLister *m_trashDirLister;
+    KDirWatch *m_trashConfigWatcher;
+    QTimer *m_updateTimer;
+    bool m_isEmpty;
 
     Trash();
     ~Trash();
@@ -0,0 +1,253 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "trashstatistics.h"
+
+#include "kitemviews/private/kiogovernor.h"
+#include "kitemviews/private/ktaskscheduler.h"
+
+#include <KDirWatch>
+#include <KMountPoint>
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QTimer>
+#include <QUrl>
+
+#ifndef Q_OS_WIN
+#include <unistd.h>
+#endif
+
+namespace {
+    // Several .trashinfo files are written at once if many items are trashed
+    const int UpdateDelay = 300;
+
+    const char TrashInfoSuffix[] = ".trashinfo";
+}
+
+struct TrashStatisticsSingleton
+{
+    TrashStatistics instance;
+};
+Q_GLOBAL_STATIC(TrashStatisticsSingleton, s_trashStatistics)
+
+TrashStatistics& TrashStatistics::instance()
+{
+    return s_trashStatistics->instance;
+}
+
+bool TrashStatistics::isTrashRoot(const QUrl& url)
+{
+    return url.scheme() == QLatin1String("trash") && (url.path().isEmpty() || url.path() == QLatin1String("/"));
+}
+
+bool TrashStatistics::isValid() const
+{
+    return m_valid;
+}
+
+qint64 TrashStatistics::size() const
+{
+    return m_size;
+}
+
+void TrashStatistics::update()
+{
+    if (m_watcher) {
+        m_updatePending = true;
+        return;
+    }
+
+    if (!m_infoWatcher) {
+        // The trash is watched as soon as the statistics are used
+        m_infoWatcher = new KDirWatch(this);
+        connect(m_infoWatcher, &KDirWatch::dirty, m_updateTimer, QOverload<>::of(&QTimer::start));
+        connect(m_infoWatcher, &KDirWatch::created, m_updateTimer, QOverload<>::of(&QTimer::start));
+        connect(m_infoWatcher, &KDirWatch::deleted, m_updateTimer, QOverload<>::of(&QTimer::start));
+        watchTrashPaths({m_homeTrashPath});
+    }
+
+    m_updatePending = false;
+    m_watcher = new QFutureWatcher<Statistics>(this);
+    connect(m_watcher, &QFutureWatcher<Statistics>::finished, this, &TrashStatistics::slotComputed);
+    m_watcher->setFuture(KTaskScheduler::instance().run(KTaskScheduler::Background, &TrashStatistics::computeStatistics,
+                                                        m_homeTrashPath, m_entries));
+}
+
+TrashStatistics::TrashStatistics() :
+    QObject(nullptr),
+    m_homeTrashPath(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1String("/Trash")),
+    m_watchedTrashPaths(),
+    m_infoWatcher(nullptr),
+    m_updateTimer(nullptr),
+    m_watcher(nullptr),
+    m_updatePending(false),
+    m_entries(),
+    m_valid(false),
+    m_size(0)
+{
+    m_updateTimer = new QTimer(this);
+    m_updateTimer->setSingleShot(true);
+    m_updateTimer->setInterval(UpdateDelay);
+    connect(m_updateTimer, &QTimer::timeout, this, &TrashStatistics::update);
+}
+
+TrashStatistics::~TrashStatistics()
+{
+}
+
+void TrashStatistics::slotComputed()
+{
+    const Statistics statistics = m_watcher->result();
+    m_watcher->deleteLater();
+    m_watcher = nullptr;
+
+    m_entries = statistics.entries;
+    watchTrashPaths(statistics.trashPaths);
+
+    m_size = 0;
+    for (const Entry& entry : qAsConst(m_entries)) {
+        m_size += entry.size;
+    }
+    m_valid = true;
+
+    if (m_updatePending) {
+        update();
+    }
+    Q_EMIT statisticsChanged();
+}
+
+void TrashStatistics::watchTrashPaths(const QStringList& trashPaths)
+{
+    for (const QString& trashPath : trashPaths) {
+        if (!m_watchedTrashPaths.contains(trashPath)) {
+            m_watchedTrashPaths.append(trashPath);
+            m_infoWatcher->addDir(trashPath + QLatin1String("/info"));
+        }
+    }
+}
+
+TrashStatistics::Statistics TrashStatistics::computeStatistics(const QString& homeTrashPath, const EntryHash& previousEntries)
+{
+    Statistics statistics;
+    statistics.trashPaths = trashPaths(homeTrashPath);
+    for (const QString& trashPath : qAsConst(statistics.trashPaths)) {
+        addEntries(trashPath, previousEntries, statistics.entries);
+    }
+    return statistics;
+}
+
+QStringList TrashStatistics::trashPaths(const QString& homeTrashPath)
+{
+    QStringList paths = {homeTrashPath};
+
+#ifndef Q_OS_WIN
+    // Items of other mounts are trashed into ".Trash/$uid" or ".Trash-$uid"
+    // at the top of the mount, see the trash specification
+    const QString uid = QString::number(getuid());
+    const KMountPoint::List mountPoints = KMountPoint::currentMountPoints();
+    for (const KMountPoint::Ptr& mountPoint : mountPoints) {
+        const QString topPath = mountPoint->mountPoint();
+        if (mountPoint->probablySlow() || KIoGovernor::instance().isSlow(topPath)) {
+            continue;
+        }
+
+        const QString prefix = topPath.endsWith(QLatin1Char('/')) ? topPath : topPath + QLatin1Char('/');
+        for (const QString& path : {prefix + QLatin1String(".Trash/") + uid, prefix + QLatin1String(".Trash-") + uid}) {
+            if (!paths.contains(path) && QFileInfo(path + QLatin1String("/info")).isDir()) {
+                paths.append(path);
+            }
+        }
+    }
+#endif
+
+    return paths;
+}
+
+void TrashStatistics::addEntries(const QString& trashPath, const EntryHash& previousEntries, EntryHash& entries)
+{
+    QHash<QString, Entry> directorySizes;
+    bool directorySizesRead = false;
+
+    const QString filesPath = trashPath + QLatin1String("/files/");
+    const int suffixLength = qstrlen(TrashInfoSuffix);
+
+    QDirIterator it(trashPath + QLatin1String("/info"), {QLatin1String("*") + QLatin1String(TrashInfoSuffix)}, QDir::Files | QDir::Hidden);
+    while (it.hasNext()) {
+        it.next();
+        const QString name = it.fileName().chopped(suffixLength);
+        const QFileInfo info(filesPath + name);
+        if (!info.exists() && !info.isSymLink()) {
+            continue;
+        }
+
+        Entry entry;
+        entry.modificationTime = info.lastModified().toMSecsSinceEpoch();
+
+        const auto previousIt = previousEntries.constFind(info.filePath());
+        if (previousIt != previousEntries.constEnd() && previousIt->modificationTime == entry.modificationTime) {
+            entry.size = previousIt->size;
+        } else if (info.isDir() && !info.isSymLink()) {
+            if (!directorySizesRead) {
+                directorySizes = readDirectorySizes(trashPath);
+                directorySizesRead = true;
+            }
+
+            const auto cachedIt = directorySizes.constFind(name);
+            if (cachedIt != directorySizes.constEnd() && cachedIt->modificationTime == entry.modificationTime) {
+                entry.size = cachedIt->size;
+            } else {
+                entry.size = folderSize(info.filePath());
+            }
+        } else {
+            entry.size = info.size();
+        }
+
+        entries.insert(info.filePath(), entry);
+    }
+}
+
+QHash<QString, TrashStatistics::Entry> TrashStatistics::readDirectorySizes(const QString& trashPath)
+{
+    // Each line contains the size, the modification time in milliseconds
+    // and the percent-encoded name of a trashed folder
+    QHash<QString, Entry> sizes;
+
+    QFile file(trashPath + QLatin1String("/directorysizes"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return sizes;
+    }
+
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        const QList<QByteArray> fields = line.split(' ');
+        if (fields.count() != 3) {
+            continue;
+        }
+
+        Entry entry;
+        entry.size = fields.at(0).toLongLong();
+        entry.modificationTime = fields.at(1).toLongLong();
+        sizes.insert(QFile::decodeName(QByteArray::fromPercentEncoding(fields.at(2))), entry);
+    }
+
+    return sizes;
+}
+
+qint64 TrashStatistics::folderSize(const QString& path)
+{
+    qint64 size = 0;
+    QDirIterator it(path, QDir::Files | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        size += it.fileInfo().size();
+    }
+    return size;
+}
@@ -0,0 +1,129 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef TRASHSTATISTICS_H
+#define TRASHSTATISTICS_H
+
+#include "dolphin_export.h"
+
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+class KDirWatch;
+class QTimer;
+class QUrl;
+
+/**
+ * @brief Provides the size of the trash.
+ *
+ * The statistics are computed in a worker thread from the .trashinfo files
+ * of the trash directories, without listing the trash by KIO. Like the trash
+ * KIO worker, the trash in the home folder and the trash directories at the
+ * top of the other mounts are measured, except for mounts that are slow.
+ * The sizes of the trashed items are kept, so that after a change of the
+ * trash only the added items must be measured. The size of trashed folders
+ * is taken from the cache "directorysizes" of the trash KIO worker, if it
+ * is up to date.
+ *
+ * The statistics are computed when they are requested the first time by
+ * update() and are updated after changes of the trash afterwards.
+ */
+class DOLPHIN_EXPORT TrashStatistics : public QObject
+{
+    Q_OBJECT
+
+public:
+    static TrashStatistics& instance();
+
+    /**
+     * @return True if \a url is the root of the trash.
+     */
+    static bool isTrashRoot(const QUrl& url);
+
+    /**
+     * @return True if the statistics have been computed.
+     */
+    bool isValid() const;
+    qint64 size() const;
+
+    /**
+     * Computes the statistics again. If the statistics are computed
+     * already, they are computed again afterwards.
+     */
+    void update();
+
+Q_SIGNALS:
+    /**
+     * Is emitted if the statistics have been computed.
+     */
+    void statisticsChanged();
+
+protected:
+    TrashStatistics();
+    ~TrashStatistics() override;
+
+private:
+    struct Entry
+    {
+        qint64 modificationTime = 0;
+        qint64 size = 0;
+    };
+    // The keys are the paths of the trashed items
+    typedef QHash<QString, Entry> EntryHash;
+
+    struct Statistics
+    {
+        QStringList trashPaths;
+        EntryHash entries;
+    };
+
+    void slotComputed();
+
+    /**
+     * Watches the info folders of \a trashPaths, as they are changed
+     * whenever items are trashed or restored.
+     */
+    void watchTrashPaths(const QStringList& trashPaths);
+
+    /**
+     * @return The sizes of the items that are described by the .trashinfo
+     *         files of the trash directories. The sizes of
+     *         \a previousEntries are used if the items are unchanged.
+     */
+    static Statistics computeStatistics(const QString& homeTrashPath, const EntryHash& previousEntries);
+
+    /**
+     * @return The trash directories of the home folder \a homeTrashPath
+     *         and of the mounts that are not slow.
+     */
+    static QStringList trashPaths(const QString& homeTrashPath);
+
+    static void addEntries(const QString& trashPath, const EntryHash& previousEntries, EntryHash& entries);
+
+    /**
+     * Reads the sizes of the folders from the file "directorysizes".
+     */
+    static QHash<QString, Entry> readDirectorySizes(const QString& trashPath);
+    static qint64 folderSize(const QString& path);
+
+private:
+    QString m_homeTrashPath;
+    QStringList m_watchedTrashPaths;
+    KDirWatch* m_infoWatcher;
+    QTimer* m_updateTimer;
+    QFutureWatcher<Statistics>* m_watcher;
+    bool m_updatePending;
+    EntryHash m_entries;
+    bool m_valid;
+    qint64 m_size;
+
+    friend struct TrashStatisticsSingleton;
+};
+
+#endif
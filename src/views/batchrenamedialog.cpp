@@ -0,0 +1,189 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "batchrenamedialog.h"
+
+#include "batchrenamer.h"
+
+#include <KGuiItem>
+#include <KLocalizedString>
+#include <KMessageWidget>
+#include <KStandardGuiItem>
+
+#include <QDialogButtonBox>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QMimeDatabase>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+namespace {
+    // Only the new names of the first items are shown, showing the
+    // names of thousands of items would slow down typing.
+    const int PreviewItemCount = 100;
+
+    const int UpdatePreviewDelay = 100;
+}
+
+BatchRenameDialog::BatchRenameDialog(const KFileItemList& items, QWidget* parent) :
+    QDialog(parent),
+    m_items(items),
+    m_nameEdit(nullptr),
+    m_startIndexBox(nullptr),
+    m_preview(nullptr),
+    m_moreItemsLabel(nullptr),
+    m_errorMessage(nullptr),
+    m_renameButton(nullptr),
+    m_updatePreviewTimer(nullptr)
+{
+    Q_ASSERT(!items.isEmpty());
+
+    setWindowTitle(i18nc("@title:window", "Rename Items"));
+    setMinimumWidth(500);
+
+    auto layout = new QVBoxLayout(this);
+
+    auto label = new QLabel(i18ncp("@label:textbox", "Rename the %1 selected item to:",
+                                   "Rename the %1 selected items to:", items.count()), this);
+    layout->addWidget(label);
+
+    // Propose the name of the first item without its extension
+    const QString firstName = items.first().name();
+    const QString extension = QMimeDatabase().suffixForFileName(firstName);
+    QString name = firstName;
+    if (!extension.isEmpty()) {
+        name.chop(extension.length() + 1);
+    }
+
+    m_nameEdit = new QLineEdit(this);
+    m_nameEdit->setText(name + QLatin1String(" #"));
+    m_nameEdit->setSelection(0, name.length());
+    label->setBuddy(m_nameEdit);
+    layout->addWidget(m_nameEdit);
+
+    auto startIndexLayout = new QHBoxLayout();
+    auto startIndexLabel = new QLabel(i18nc("@label:spinbox", "# will be replaced by ascending numbers starting with:"), this);
+    m_startIndexBox = new QSpinBox(this);
+    m_startIndexBox->setMinimum(0);
+    m_startIndexBox->setMaximum(1000000000);
+    m_startIndexBox->setValue(1);
+    startIndexLabel->setBuddy(m_startIndexBox);
+    startIndexLayout->addWidget(startIndexLabel);
+    startIndexLayout->addWidget(m_startIndexBox);
+    layout->addLayout(startIndexLayout);
+
+    m_preview = new QTreeWidget(this);
+    m_preview->setColumnCount(2);
+    m_preview->setHeaderLabels({i18nc("@title:column", "Name"), i18nc("@title:column", "New Name")});
+    m_preview->setRootIsDecorated(false);
+    m_preview->setSelectionMode(QAbstractItemView::NoSelection);
+    m_preview->header()->setSectionResizeMode(QHeaderView::Stretch);
+    layout->addWidget(m_preview);
+
+    m_moreItemsLabel = new QLabel(this);
+    m_moreItemsLabel->setVisible(items.count() > PreviewItemCount);
+    m_moreItemsLabel->setText(i18ncp("@info", "and one more item", "and %1 more items",
+                                     items.count() - PreviewItemCount));
+    layout->addWidget(m_moreItemsLabel);
+
+    m_errorMessage = new KMessageWidget(this);
+    m_errorMessage->setMessageType(KMessageWidget::Error);
+    m_errorMessage->setCloseButtonVisible(false);
+    m_errorMessage->setWordWrap(true);
+    m_errorMessage->hide();
+    layout->addWidget(m_errorMessage);
+
+    auto buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+    connect(buttonBox, &QDialogButtonBox::accepted, this, &BatchRenameDialog::accept);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &BatchRenameDialog::reject);
+    m_renameButton = buttonBox->button(QDialogButtonBox::Ok);
+    m_renameButton->setDefault(true);
+    m_renameButton->setShortcut(Qt::CTRL | Qt::Key_Return);
+    KGuiItem::assign(m_renameButton, KGuiItem(i18nc("@action:button", "&Rename"), QStringLiteral("edit-rename")));
+    KGuiItem::assign(buttonBox->button(QDialogButtonBox::Cancel), KStandardGuiItem::cancel());
+    layout->addWidget(buttonBox);
+
+    // Determining the new names of all items takes a while for
+    // large selections, so the preview is not updated for each key.
+    m_updatePreviewTimer = new QTimer(this);
+    m_updatePreviewTimer->setSingleShot(true);
+    m_updatePreviewTimer->setInterval(UpdatePreviewDelay);
+    connect(m_updatePreviewTimer, &QTimer::timeout, this, &BatchRenameDialog::updatePreview);
+    connect(m_nameEdit, &QLineEdit::textChanged, m_updatePreviewTimer, QOverload<>::of(&QTimer::start));
+    connect(m_startIndexBox, QOverload<int>::of(&QSpinBox::valueChanged), m_updatePreviewTimer, QOverload<>::of(&QTimer::start));
+
+    updatePreview();
+}
+
+BatchRenameDialog::~BatchRenameDialog()
+{
+}
+
+KFileItemList BatchRenameDialog::items() const
+{
+    return m_items;
+}
+
+QString BatchRenameDialog::pattern() const
+{
+    return m_nameEdit->text();
+}
+
+int BatchRenameDialog::startIndex() const
+{
+    return m_startIndexBox->value();
+}
+
+void BatchRenameDialog::accept()
+{
+    // The dialog might be accepted before the delayed update of the preview
+    if (m_updatePreviewTimer->isActive()) {
+        updatePreview();
+    }
+
+    if (m_renameButton->isEnabled()) {
+        QDialog::accept();
+    }
+}
+
+void BatchRenameDialog::updatePreview()
+{
+    m_updatePreviewTimer->stop();
+
+    const QString pattern = m_nameEdit->text();
+    const bool validPattern = BatchRenamer::isValidPattern(pattern);
+    const QStringList names = BatchRenamer::newNames(m_items, pattern, startIndex());
+
+    m_preview->clear();
+    QList<QTreeWidgetItem*> previewItems;
+    const int previewCount = qMin(m_items.count(), PreviewItemCount);
+    previewItems.reserve(previewCount);
+    for (int i = 0; i < previewCount; ++i) {
+        previewItems.append(new QTreeWidgetItem({m_items.at(i).name(), names.at(i)}));
+    }
+    m_preview->addTopLevelItems(previewItems);
+
+    QString errorText;
+    if (pattern.contains(QLatin1Char('/'))) {
+        errorText = i18nc("@info", "The name must not contain \"/\".");
+    } else if (!validPattern) {
+        errorText = i18nc("@info", "The name must contain one sequence of # characters.");
+    } else {
+        const int duplicateIndex = BatchRenamer::findDuplicateName(m_items, names);
+        if (duplicateIndex >= 0) {
+            errorText = i18nc("@info", "The name %1 would be used for several items.", names.at(duplicateIndex));
+        }
+    }
+
+    m_errorMessage->setText(errorText);
+    m_errorMessage->setVisible(!errorText.isEmpty());
+    m_renameButton->setEnabled(errorText.isEmpty());
+}
@@ -0,0 +1,66 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef BATCHRENAMEDIALOG_H
+#define BATCHRENAMEDIALOG_H
+
+#include "dolphin_export.h"
+
+#include <KFileItem>
+
+#include <QDialog>
+
+class KMessageWidget;
+class QLabel;
+class QLineEdit;
+class QPushButton;
+class QSpinBox;
+class QTimer;
+class QTreeWidget;
+
+/**
+ * @brief Dialog for renaming several items by a common name with ascending numbers.
+ *
+ * The new names of the first items are shown while the name is entered.
+ * Names that would be used twice within the same directory are rejected.
+ * The renaming itself is done by BatchRenamer after the dialog has been
+ * accepted, see pattern() and startIndex().
+ */
+class DOLPHIN_EXPORT BatchRenameDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit BatchRenameDialog(const KFileItemList& items, QWidget* parent = nullptr);
+    ~BatchRenameDialog() override;
+
+    KFileItemList items() const;
+
+    /**
+     * @return Name of the items, which contains the placeholders that are
+     *         replaced by the numbers of the items.
+     */
+    QString pattern() const;
+    int startIndex() const;
+
+public Q_SLOTS:
+    void accept() override;
+
+private Q_SLOTS:
+    void updatePreview();
+
+private:
+    KFileItemList m_items;
+    QLineEdit* m_nameEdit;
+    QSpinBox* m_startIndexBox;
+    QTreeWidget* m_preview;
+    QLabel* m_moreItemsLabel;
+    KMessageWidget* m_errorMessage;
+    QPushButton* m_renameButton;
+    QTimer* m_updatePreviewTimer;
+};
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "batchrenamer.h"
+
+#include "kitemviews/private/ktaskscheduler.h"
+#include "views/localoperationundo.h"
+
+#include <KIO/BatchRenameJob>
+#include <KIO/FileUndoManager>
+#include <KJobWidgets>
+#include <KLocalizedString>
+
+#include <QMimeDatabase>
+#include <QSet>
+#include <QWidget>
+
+#include <algorithm>
+
+namespace {
+    const QChar PlaceHolder = QLatin1Char('#');
+
+    // Smaller batches of local items are renamed by KIO
+    const int LocalRenamingMinimumCount = 100;
+}
+
+BatchRenamer::BatchRenamer(QWidget* parent) :
+    QObject(parent),
+    m_sourceUrls(),
+    m_targetUrls(),
+    m_renamedUrls(),
+    m_watcher(nullptr),
+    m_job(nullptr)
+{
+}
+
+BatchRenamer::~BatchRenamer()
+{
+}
+
+bool BatchRenamer::isValidPattern(const QString& pattern)
+{
+    if (pattern.contains(QLatin1Char('/'))) {
+        return false;
+    }
+
+    int pos = pattern.indexOf(PlaceHolder);
+    if (pos < 0) {
+        return false;
+    }
+    while (pos < pattern.length() && pattern.at(pos) == PlaceHolder) {
+        ++pos;
+    }
+    return pattern.indexOf(PlaceHolder, pos) < 0;
+}
+
+QStringList BatchRenamer::newNames(const KFileItemList& items, const QString& pattern, int startIndex)
+{
+    const int placeHolderPos = pattern.indexOf(PlaceHolder);
+    int placeHolderLength = 0;
+    if (placeHolderPos >= 0) {
+        while (placeHolderPos + placeHolderLength < pattern.length()
+               && pattern.at(placeHolderPos + placeHolderLength) == PlaceHolder) {
+            ++placeHolderLength;
+        }
+    }
+
+    QMimeDatabase db;
+    QStringList names;
+    names.reserve(items.count());
+    int index = startIndex;
+    for (const KFileItem& item : items) {
+        QString name = pattern;
+        if (placeHolderPos >= 0) {
+            name.replace(placeHolderPos, placeHolderLength,
+                         QString::number(index).rightJustified(placeHolderLength, QLatin1Char('0')));
+        }
+
+        const QString extension = db.suffixForFileName(item.name());
+        if (!extension.isEmpty()) {
+            name += QLatin1Char('.') + extension;
+        }
+
+        names.append(name);
+        ++index;
+    }
+
+    return names;
+}
+
+int BatchRenamer::findDuplicateName(const KFileItemList& items, const QStringList& names)
+{
+    Q_ASSERT(items.count() == names.count());
+
+    QSet<QString> paths;
+    paths.reserve(names.count());
+    for (int i = 0; i < names.count(); ++i) {
+        const QString directory = items.at(i).url().adjusted(QUrl::RemoveFilename | QUrl::StripTrailingSlash).toString();
+        const QString path = directory + QLatin1Char('/') + names.at(i);
+        if (paths.contains(path)) {
+            return i;
+        }
+        paths.insert(path);
+    }
+
+    return -1;
+}
+
+void BatchRenamer::start(const KFileItemList& items, const QString& pattern, int startIndex)
+{
+    Q_ASSERT(!isRunning());
+
+    m_sourceUrls.clear();
+    m_targetUrls.clear();
+    m_renamedUrls.clear();
+
+    const bool renameLocally = items.count() >= LocalRenamingMinimumCount
+        && std::all_of(items.begin(), items.end(), [](const KFileItem& item) {
+               return item.url().isLocalFile();
+           });
+
+    if (renameLocally) {
+        const QStringList names = newNames(items, pattern, startIndex);
+        QVector<QPair<QString, QString>> paths;
+        paths.reserve(items.count());
+        for (int i = 0; i < items.count(); ++i) {
+            const QUrl url = items.at(i).url();
+            QUrl targetUrl = url.adjusted(QUrl::RemoveFilename);
+            targetUrl.setPath(targetUrl.path() + names.at(i));
+            m_sourceUrls.append(url);
+            m_targetUrls.append(targetUrl);
+            paths.append(qMakePair(url.toLocalFile(), targetUrl.toLocalFile()));
+        }
+
+        m_watcher = new QFutureWatcher<LocalFileOperations::RenamingResult>(this);
+        connect(m_watcher, &QFutureWatcher<LocalFileOperations::RenamingResult>::finished,
+                this, &BatchRenamer::slotLocalRenamingFinished);
+        m_watcher->setFuture(KTaskScheduler::instance().run(KTaskScheduler::Visible,
+                                                            &LocalFileOperations::renameItems, paths));
+        return;
+    }
+
+    KIO::BatchRenameJob* job = KIO::batchRename(items.urlList(), pattern, startIndex, PlaceHolder);
+    KIO::FileUndoManager::self()->recordJob(KIO::FileUndoManager::BatchRename, QList<QUrl>(), QUrl(), job);
+    if (QWidget* window = qobject_cast<QWidget*>(parent())) {
+        KJobWidgets::setWindow(job, window);
+    }
+    connect(job, &KIO::BatchRenameJob::fileRenamed, this, &BatchRenamer::slotJobFileRenamed);
+    connect(job, &KJob::result, this, &BatchRenamer::slotJobResult);
+    m_job = job;
+}
+
+bool BatchRenamer::isRunning() const
+{
+    return m_watcher || m_job;
+}
+
+void BatchRenamer::slotLocalRenamingFinished()
+{
+    const LocalFileOperations::RenamingResult result = m_watcher->result();
+    m_watcher->deleteLater();
+    m_watcher = nullptr;
+
+    QList<QUrl> sourceUrls;
+    sourceUrls.reserve(result.renamedIndexes.count());
+    for (int index : result.renamedIndexes) {
+        sourceUrls.append(m_sourceUrls.at(index));
+        m_renamedUrls.append(m_targetUrls.at(index));
+    }
+    m_sourceUrls.clear();
+    m_targetUrls.clear();
+
+    LocalFileOperations::emitFilesAdded(m_renamedUrls);
+    LocalOperationUndo::instance().recordRenaming(sourceUrls, m_renamedUrls);
+
+    if (result.failedCount > 0) {
+        Q_EMIT errorMessage(i18ncp("@info:status", "Could not rename one item: %2", "Could not rename %1 items: %2",
+                                   result.failedCount, result.errorString));
+    }
+    Q_EMIT finished(m_renamedUrls);
+}
+
+void BatchRenamer::slotJobFileRenamed(const QUrl& oldUrl, const QUrl& newUrl)
+{
+    Q_UNUSED(oldUrl)
+    m_renamedUrls.append(newUrl);
+}
+
+void BatchRenamer::slotJobResult(KJob* job)
+{
+    m_job = nullptr;
+    if (job->error() != 0 && job->error() != KIO::ERR_USER_CANCELED) {
+        Q_EMIT errorMessage(job->errorString());
+    }
+    Q_EMIT finished(m_renamedUrls);
+}
@@ -0,0 +1,97 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef BATCHRENAMER_H
+#define BATCHRENAMER_H
+
+#include "dolphin_export.h"
+#include "views/localfileoperations.h"
+
+#include <KFileItem>
+
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+
+class KJob;
+class QWidget;
+
+/**
+ * @brief Renames several items by a common name with ascending numbers.
+ *
+ * All new names are determined before renaming starts, so that they can be
+ * shown in advance and duplicates can be rejected. The sequence of
+ * placeholders in the name is replaced by the number of the item and the
+ * extension of each item is kept, like KIO::BatchRenameJob does.
+ *
+ * Renaming many local items one by one with KIO takes very long, as each
+ * item requires a request to the file worker. Large batches of local items
+ * are renamed by LocalFileOperations::renameItems() in a task of
+ * KTaskScheduler instead, which never replaces existing files, and the
+ * renaming is recorded by LocalOperationUndo. Smaller batches and remote
+ * items are renamed by KIO::BatchRenameJob.
+ */
+class DOLPHIN_EXPORT BatchRenamer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BatchRenamer(QWidget* parent = nullptr);
+    ~BatchRenamer() override;
+
+    /**
+     * @return True if \a pattern contains exactly one sequence of placeholders.
+     */
+    static bool isValidPattern(const QString& pattern);
+
+    /**
+     * @return New names of \a items, the sequence of placeholders in
+     *         \a pattern is replaced by ascending numbers starting with
+     *         \a startIndex, which are padded to the length of the sequence.
+     */
+    static QStringList newNames(const KFileItemList& items, const QString& pattern, int startIndex);
+
+    /**
+     * @return Index of the first name in \a names that is also the new
+     *         name of another item of the same directory, or -1.
+     */
+    static int findDuplicateName(const KFileItemList& items, const QStringList& names);
+
+    /**
+     * Renames \a items by the new names that are determined by
+     * newNames(). finished() is emitted afterwards.
+     */
+    void start(const KFileItemList& items, const QString& pattern, int startIndex);
+
+    bool isRunning() const;
+
+Q_SIGNALS:
+    /**
+     * Is emitted when the renaming has been finished. \a renamedUrls
+     * contains the new URLs of the items that have been renamed.
+     */
+    void finished(const QList<QUrl>& renamedUrls);
+
+    /** Is emitted if not all items could be renamed. */
+    void errorMessage(const QString& message);
+
+private Q_SLOTS:
+    void slotLocalRenamingFinished();
+    void slotJobFileRenamed(const QUrl& oldUrl, const QUrl& newUrl);
+    void slotJobResult(KJob* job);
+
+private:
+    QList<QUrl> m_sourceUrls;
+    QList<QUrl> m_targetUrls;
+    QList<QUrl> m_renamedUrls;
+    QFutureWatcher<LocalFileOperations::RenamingResult>* m_watcher;
+    KJob* m_job;
+};
+
+#endif
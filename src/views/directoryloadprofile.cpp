@@ -0,0 +1,124 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "directoryloadprofile.h"
+
+#include "views/viewproperties.h"
+#include "views/viewpropertiesstore.h"
+
+#include <QUrl>
+
+namespace {
+    // Directories with fewer entries are loaded fast enough without a profile
+    const int NotableEntryCount = 10000;
+
+    const int SlowListingTime = 2000;
+    const int ExpensivePreviewTime = 1000;
+
+    // The profile is not written again for small changes of the number of entries
+    const int EntryCountTolerancePercent = 10;
+
+    const char ProfileGroup[] = "LoadProfile";
+
+    int averageTime(int previousTime, int time)
+    {
+        if (time < 0) {
+            return previousTime;
+        }
+        return previousTime < 0 ? time : (previousTime + time) / 2;
+    }
+}
+
+DirectoryLoadProfile::DirectoryLoadProfile() :
+    m_valid(false),
+    m_entryCount(-1),
+    m_listingTime(-1),
+    m_previewTime(-1)
+{
+}
+
+DirectoryLoadProfile DirectoryLoadProfile::load(const QUrl& url)
+{
+    DirectoryLoadProfile profile;
+    ViewPropertiesStore::Properties properties;
+    if (!url.isValid() || !ViewPropertiesStore::instance().find(storeKey(url), properties)) {
+        return profile;
+    }
+
+    const QMap<QString, QString> entries = properties.value(QLatin1String(ProfileGroup));
+    profile.m_valid = true;
+    profile.m_entryCount = entries.value(QStringLiteral("EntryCount"), QStringLiteral("-1")).toInt();
+    profile.m_listingTime = entries.value(QStringLiteral("ListingTime"), QStringLiteral("-1")).toInt();
+    profile.m_previewTime = entries.value(QStringLiteral("PreviewTime"), QStringLiteral("-1")).toInt();
+    return profile;
+}
+
+void DirectoryLoadProfile::record(const QUrl& url, int entryCount, int listingTime, int previewTime, bool listingCompleted)
+{
+    const DirectoryLoadProfile previous = *this;
+    if (listingCompleted) {
+        m_entryCount = entryCount;
+        m_listingTime = averageTime(m_listingTime, listingTime);
+    } else {
+        m_entryCount = qMax(m_entryCount, entryCount);
+        m_listingTime = qMax(m_listingTime, listingTime);
+    }
+    m_previewTime = averageTime(m_previewTime, previewTime);
+
+    if (!m_valid && !isNotable()) {
+        return;
+    }
+
+    if (m_valid && resolveVisibleItemsOnly() == previous.resolveVisibleItemsOnly()
+            && qAbs(m_entryCount - previous.m_entryCount) * 100 <= previous.m_entryCount * EntryCountTolerancePercent) {
+        return;
+    }
+
+    QMap<QString, QString> entries;
+    entries.insert(QStringLiteral("EntryCount"), QString::number(m_entryCount));
+    entries.insert(QStringLiteral("ListingTime"), QString::number(m_listingTime));
+    entries.insert(QStringLiteral("PreviewTime"), QString::number(m_previewTime));
+
+    ViewPropertiesStore::Properties properties;
+    properties.insert(QLatin1String(ProfileGroup), entries);
+    ViewPropertiesStore::instance().insert(storeKey(url), properties);
+    m_valid = true;
+}
+
+bool DirectoryLoadProfile::isValid() const
+{
+    return m_valid;
+}
+
+int DirectoryLoadProfile::entryCount() const
+{
+    return m_entryCount;
+}
+
+int DirectoryLoadProfile::listingTime() const
+{
+    return m_listingTime;
+}
+
+int DirectoryLoadProfile::previewTime() const
+{
+    return m_previewTime;
+}
+
+bool DirectoryLoadProfile::resolveVisibleItemsOnly() const
+{
+    return m_listingTime >= SlowListingTime || m_previewTime >= ExpensivePreviewTime;
+}
+
+bool DirectoryLoadProfile::isNotable() const
+{
+    return m_entryCount >= NotableEntryCount || resolveVisibleItemsOnly();
+}
+
+QString DirectoryLoadProfile::storeKey(const QUrl& url)
+{
+    return QLatin1String("loadprofile/") + ViewProperties::directoryHashForUrl(url.adjusted(QUrl::StripTrailingSlash));
+}
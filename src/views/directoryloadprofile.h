@@ -0,0 +1,80 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef DIRECTORYLOADPROFILE_H
+#define DIRECTORYLOADPROFILE_H
+
+#include "dolphin_export.h"
+
+#include <QString>
+
+class QUrl;
+
+/**
+ * @brief Remembers how expensive the loading of a directory has been.
+ *
+ * The number of entries, the time needed for listing the directory and the
+ * average time needed for creating a preview are recorded when a directory
+ * is left, and are stored in the ViewPropertiesStore next to the view
+ * properties of the directory. When the directory is entered again,
+ * DolphinView uses the profile to choose how the directory is loaded
+ * before anything about it has been listed:
+ *
+ * - The expected number of entries is passed to the model, so that a huge
+ *   directory is inserted like one from the start and the loading progress
+ *   is estimated even if the directory is not listed locally.
+ * - If the listing has been slow or the previews have been expensive, only
+ *   the visible items are resolved, like in the inactive view of a split view.
+ *
+ * Profiles are only stored for directories that are notable in any of these
+ * respects, and are only written again if the chosen strategy would change,
+ * so visiting ordinary directories does not write anything.
+ */
+class DOLPHIN_EXPORT DirectoryLoadProfile
+{
+public:
+    DirectoryLoadProfile();
+
+    /**
+     * @return The stored profile of the directory \a url, which is
+     *         invalid if no profile has been stored.
+     */
+    static DirectoryLoadProfile load(const QUrl& url);
+
+    /**
+     * Adds the statistics of a visit of the directory \a url and stores the
+     * profile if required. \a listingTime and \a previewTime are in
+     * milliseconds and may be -1 if they have not been measured, e.g. because
+     * no previews have been created. If the directory has been left before
+     * \a listingCompleted, \a entryCount and \a listingTime are only lower
+     * bounds, which raise the stored values instead of being averaged in.
+     */
+    void record(const QUrl& url, int entryCount, int listingTime, int previewTime, bool listingCompleted = true);
+
+    bool isValid() const;
+    int entryCount() const;
+    int listingTime() const;
+    int previewTime() const;
+
+    /**
+     * @return True if the items apart from the visible ones should not
+     *         be resolved, as the directory is slow or its previews are
+     *         expensive.
+     */
+    bool resolveVisibleItemsOnly() const;
+
+private:
+    bool isNotable() const;
+    static QString storeKey(const QUrl& url);
+
+private:
+    bool m_valid;
+    int m_entryCount;
+    int m_listingTime;
+    int m_previewTime;
+};
+
+#endif
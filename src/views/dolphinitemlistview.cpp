@@ -13,10 +13,13 @@
 #include "dolphinfileitemlistwidget.h"
 #include "kitemviews/kfileitemmodel.h"
 #include "kitemviews/kitemlistcontroller.h"
+#include "kitemviews/private/kpluginregistry.h"
 #include "views/viewmodecontroller.h"
 #include "zoomlevelinfo.h"
 
-#include <KIO/PreviewJob>
+#include <KConfigGroup>
+#include <KSharedConfig>
+
 #include <QtMath>
 
 
@@ -72,13 +75,14 @@ void DolphinItemListView::readSettings()
     beginTransaction();
 
     setEnabledSelectionToggles(GeneralSettings::showSelectionToggle());
+    setEnabledWidgetPixmapCache(GeneralSettings::cacheItemPixmaps());
     setSupportsItemExpanding(itemLayoutSupportsItemExpanding(itemLayout()));
 
     updateFont();
     updateGridSize();
 
     const KConfigGroup globalConfig(KSharedConfig::openConfig(), "PreviewSettings");
-    setEnabledPlugins(globalConfig.readEntry("Plugins", KIO::PreviewJob::defaultPlugins()));
+    setEnabledPlugins(globalConfig.readEntry("Plugins", KPluginRegistry::instance().defaultPreviewPlugins()));
     setLocalFileSizePreviewLimit(globalConfig.readEntry("MaximumSize", 0));
     endTransaction();
 }
@@ -39,6 +39,8 @@ DolphinRemoteEncoding::DolphinRemoteEncoding(QObject* parent, DolphinViewActionH
     m_actionHandler->actionCollection()->addAction(QStringLiteral("change_remote_encoding"), m_menu);
     connect(m_menu->menu(), &QMenu::aboutToShow,
           this, &DolphinRemoteEncoding::slotAboutToShow);
+    connect(m_menu->menu(), &QMenu::triggered,
+          this, &DolphinRemoteEncoding::slotItemSelected);
 
     m_menu->setEnabled(false);
     m_menu->setDelayed(false);
@@ -56,6 +58,7 @@ void DolphinRemoteEncoding::slotReload()
 void DolphinRemoteEncoding::loadSettings()
 {
     m_loaded = true;
+    m_charsets.clear();
     m_encodingDescriptions = KCharsets::charsets()->descriptiveEncodingNames();
 
     fillMenu();
@@ -68,20 +71,10 @@ void DolphinRemoteEncoding::slotAboutToOpenUrl()
 
     if (m_currentURL.scheme() != oldURL.scheme()) {
         // This plugin works on ftp, fish, etc.
-        // everything whose type is T_FILESYSTEM except for local files
-        if (!m_currentURL.isLocalFile() &&
-            KProtocolManager::outputType(m_currentURL) == KProtocolInfo::T_FILESYSTEM) {
-
-            m_menu->setEnabled(true);
-            loadSettings();
-        } else {
-            m_menu->setEnabled(false);
-        }
-        return;
-    }
-
-    if (m_currentURL.host() != oldURL.host()) {
-        updateMenu();
+        // everything whose type is T_FILESYSTEM except for local files.
+        // The menu is filled and updated by slotAboutToShow().
+        m_menu->setEnabled(!m_currentURL.isLocalFile() &&
+                           KProtocolManager::outputType(m_currentURL) == KProtocolInfo::T_FILESYSTEM);
     }
 }
 
@@ -102,8 +95,6 @@ void DolphinRemoteEncoding::fillMenu()
     menu->addAction(i18n("Reload"), this, SLOT(slotReload()), 0);
     menu->addAction(i18n("Default"), this, SLOT(slotDefault()), 0)->setCheckable(true);
     m_idDefault = m_encodingDescriptions.size() + 2;
-
-    connect(menu, &QMenu::triggered, this, &DolphinRemoteEncoding::slotItemSelected);
 }
 
 void DolphinRemoteEncoding::updateMenu()
@@ -117,7 +108,7 @@ void DolphinRemoteEncoding::updateMenu()
         m_menu->menu()->actions().at(i)->setChecked(false);
     }
 
-    const QString charset = KCharsets::charsets()->descriptionForEncoding(KProtocolManager::charsetFor(m_currentURL));
+    const QString charset = KCharsets::charsets()->descriptionForEncoding(charsetFor(m_currentURL));
     if (!charset.isEmpty()) {
         int id = 0;
         bool isFound = false;
@@ -162,6 +153,7 @@ void DolphinRemoteEncoding::slotItemSelected(QAction* action)
             KConfigGroup cg(&config, host);
             cg.writeEntry(DATA_KEY, charset);
             config.sync();
+            m_charsets.clear();
 
             // Update the io-slaves...
             updateView();
@@ -208,11 +200,23 @@ void DolphinRemoteEncoding::slotDefault()
         }
     }
     config.sync();
+    m_charsets.clear();
 
     // Update the io-slaves.
     updateView();
 }
 
+QString DolphinRemoteEncoding::charsetFor(const QUrl& url)
+{
+    // The charset depends on the worker and the host only
+    const QString key = url.scheme() + QLatin1String("://") + url.host();
+    auto it = m_charsets.constFind(key);
+    if (it == m_charsets.constEnd()) {
+        it = m_charsets.insert(key, KProtocolManager::charsetFor(url));
+    }
+    return *it;
+}
+
 void DolphinRemoteEncoding::updateView()
 {
     KIO::Scheduler::emitReparseSlaveConfiguration();
@@ -10,6 +10,7 @@
 #include "dolphin_export.h"
 
 #include <QAction>
+#include <QHash>
 #include <QStringList>
 #include <QUrl>
 
@@ -20,6 +21,7 @@ class DolphinViewActionHandler;
  * @brief Allows to change character encoding for remote urls like ftp.
  *
  * When browsing remote url, its possible to change encoding from Tools Menu.
+ * The menu is filled and updated only when it is shown.
  */
 
 class DOLPHIN_EXPORT DolphinRemoteEncoding: public QObject
@@ -44,10 +46,17 @@ private:
   void fillMenu();
   void updateMenu();
 
+  /**
+   * @return The charset of the host of \a url as configured for the
+   *         KIO worker. The charsets are cached until the settings change.
+   */
+  QString charsetFor(const QUrl& url);
+
   KActionMenu* m_menu;
   QStringList m_encodingDescriptions;
   QUrl m_currentURL;
   DolphinViewActionHandler* m_actionHandler;
+  QHash<QString, QString> m_charsets;
 
   bool m_loaded;
   int m_idDefault;
@@ -7,17 +7,26 @@
 
 #include "dolphinview.h"
 
+#include "batchrenamedialog.h"
+#include "batchrenamer.h"
 #include "dolphin_detailsmodesettings.h"
 #include "dolphin_generalsettings.h"
 #include "dolphinitemlistview.h"
 #include "dolphinnewfilemenuobserver.h"
 #include "draganddrophelper.h"
+#include "fileoperationqueue.h"
+#include "jobscope.h"
 #include "kitemviews/kfileitemlistview.h"
 #include "kitemviews/kfileitemmodel.h"
+#include "kitemviews/kfileitemmodelrolesupdater.h"
 #include "kitemviews/kitemlistcontainer.h"
 #include "kitemviews/kitemlistcontroller.h"
 #include "kitemviews/kitemlistheader.h"
 #include "kitemviews/kitemlistselectionmanager.h"
+#include "kitemviews/private/kmemorybudget.h"
+#include "localcopyjob.h"
+#include "localoperationundo.h"
+#include "trash/trashstatistics.h"
 #include "versioncontrol/versioncontrolobserver.h"
 #include "viewproperties.h"
 #include "views/tooltips/tooltipmanager.h"
@@ -34,6 +43,7 @@
 #include <KIO/CopyJob>
 #include <KIO/DeleteJob>
 #include <KIO/DropJob>
+#include <KIO/JobTracker>
 #include <KIO/JobUiDelegate>
 #include <KIO/Paste>
 #include <KIO/PasteJob>
@@ -43,6 +53,7 @@
 #include <KLocalizedString>
 #include <KMessageBox>
 #include <KProtocolManager>
+#include <KUrlMimeData>
 
 #include <QAbstractItemView>
 #include <QActionGroup>
@@ -51,15 +62,46 @@
 #include <QDropEvent>
 #include <QGraphicsOpacityEffect>
 #include <QGraphicsSceneDragDropEvent>
+#include <QGraphicsSceneMouseEvent>
 #include <QLabel>
 #include <QMenu>
+#include <QMimeData>
 #include <QMimeDatabase>
 #include <QPixmapCache>
 #include <QPointer>
 #include <QScrollBar>
+#include <QSharedPointer>
 #include <QSize>
 #include <QTimer>
 #include <QVBoxLayout>
+#include <QtMath>
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+    // Smaller batches of local items are duplicated by KIO
+    const int LocalDuplicationMinimumCount = 100;
+
+    // Delay in milliseconds after the last interaction of the user with
+    // the view, after which the deferred resortings are applied.
+    const int InteractionIdleDelay = 1000;
+
+    bool remoteRenderingEnabled()
+    {
+        using Choice = GeneralSettings::EnumRemoteRendering;
+        switch (GeneralSettings::remoteRendering()) {
+        case Choice::AlwaysRemoteRendering:
+            return true;
+        case Choice::NeverRemoteRendering:
+            return false;
+        default: {
+            static const bool remoteSession = KItemListContainer::isRemoteSession();
+            return remoteSession;
+        }
+        }
+    }
+}
 
 DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     QWidget(parent),
@@ -69,16 +111,31 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     m_isFolderWritable(true),
     m_dragging(false),
     m_loading(false),
+    m_loadingDeferred(false),
+    m_deferredLoadingPending(false),
+    m_inBackground(false),
     m_url(url),
     m_viewPropertiesContext(),
     m_mode(DolphinView::IconsView),
     m_visibleRoles(),
+    m_urlJobScope(nullptr),
+    m_loadProfileUrl(),
+    m_loadProfile(),
+    m_listingTimer(),
+    m_listingTime(-1),
+    m_allItems(),
+    m_rootStatValid(false),
+    m_hasRootRecursiveSize(false),
+    m_rootRecursiveSize(0),
     m_topLayout(nullptr),
     m_model(nullptr),
     m_view(nullptr),
     m_container(nullptr),
     m_toolTipManager(nullptr),
     m_selectionChangedTimer(nullptr),
+    m_selection(),
+    m_selectedItemsProperties(nullptr),
+    m_selectedItemsPropertiesIndexes(),
     m_currentItemUrl(),
     m_scrollToCurrentItem(false),
     m_restoredContentsPosition(),
@@ -87,6 +144,8 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     m_markFirstNewlySelectedItemAsCurrent(false),
     m_versionControlObserver(nullptr),
     m_twoClicksRenamingTimer(nullptr),
+    m_interactionTimer(nullptr),
+    m_prefetchedUrl(),
     m_placeholderLabel(nullptr)
 {
     m_topLayout = new QVBoxLayout(this);
@@ -99,13 +158,29 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     connect(&DolphinNewFileMenuObserver::instance(), &DolphinNewFileMenuObserver::itemCreated,
             this, &DolphinView::observeCreatedItem);
 
+    m_urlJobScope = new JobScope(this);
+
     m_selectionChangedTimer = new QTimer(this);
     m_selectionChangedTimer->setSingleShot(true);
     m_selectionChangedTimer->setInterval(300);
     connect(m_selectionChangedTimer, &QTimer::timeout,
             this, &DolphinView::emitSelectionChangedSignal);
 
+    m_interactionTimer = new QTimer(this);
+    m_interactionTimer->setSingleShot(true);
+    m_interactionTimer->setInterval(InteractionIdleDelay);
+    connect(m_interactionTimer, &QTimer::timeout, this, [this]() {
+        m_model->setResortingDeferred(false);
+    });
+
     m_model = new KFileItemModel(this);
+    m_model->setSnapshotsEnabled(true);
+    m_model->setChangeCoalescingInterval(GeneralSettings::directoryChangesCoalescingInterval());
+    m_model->setRecursiveListingDepth(GeneralSettings::recursiveListingDepth());
+    m_model->setSortingMemoryLimit(static_cast<qint64>(GeneralSettings::sortingMemoryLimit()) * 1024 * 1024);
+    KMemoryBudget::instance().setBudget(static_cast<qint64>(GeneralSettings::memoryBudget()) * 1024 * 1024);
+    m_selection = KFileItemSelection(m_model);
+    m_allItems = KFileItemSelection(m_model);
     m_view = new DolphinItemListView();
     m_view->setEnabledSelectionToggles(GeneralSettings::showSelectionToggle());
     m_view->setVisibleRoles({"text"});
@@ -120,10 +195,22 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     m_view->setEnlargeSmallPreviews(GeneralSettings::enlargeSmallPreviews());
 
     m_container = new KItemListContainer(controller, this);
+    m_container->setEnabledHardwareAcceleration(GeneralSettings::hardwareAcceleratedViews());
+    m_container->setEnabledRemoteRendering(remoteRenderingEnabled());
     m_container->installEventFilter(this);
     setFocusProxy(m_container);
-    connect(m_container->horizontalScrollBar(), &QScrollBar::valueChanged, this, [=] { hideToolTip(); });
-    connect(m_container->verticalScrollBar(), &QScrollBar::valueChanged, this, [=] { hideToolTip(); });
+    connect(m_container->horizontalScrollBar(), &QScrollBar::valueChanged, this, [=] {
+        hideToolTip();
+    });
+    connect(m_container->verticalScrollBar(), &QScrollBar::valueChanged, this, [=] {
+        hideToolTip();
+    });
+
+    // Only the scrolling by the user defers the resortings. The scroll
+    // offset that is changed by the view, e.g. to keep the current item
+    // at its position, would defer them again and again.
+    connect(m_container->horizontalScrollBar(), &QScrollBar::actionTriggered, this, &DolphinView::deferResortingWhileInteracting);
+    connect(m_container->verticalScrollBar(), &QScrollBar::actionTriggered, this, &DolphinView::deferResortingWhileInteracting);
 
     // Show some placeholder text for empty folders
     // This is made using a heavily-modified QLabel rather than a KTitleWidget
@@ -161,8 +248,7 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     connect(controller, &KItemListController::escapePressed, this, &DolphinView::stopLoading);
     connect(controller, &KItemListController::modelChanged, this, &DolphinView::slotModelChanged);
     connect(controller, &KItemListController::selectedItemTextPressed, this, &DolphinView::slotSelectedItemTextPressed);
-    connect(controller, &KItemListController::increaseZoom, this, &DolphinView::slotIncreaseZoom);
-    connect(controller, &KItemListController::decreaseZoom, this, &DolphinView::slotDecreaseZoom);
+    connect(controller, &KItemListController::pinchZoomFinished, this, &DolphinView::slotPinchZoomFinished);
     connect(controller, &KItemListController::swipeUp, this, &DolphinView::slotSwipeUp);
 
     connect(m_model, &KFileItemModel::directoryLoadingStarted,       this, &DolphinView::slotDirectoryLoadingStarted);
@@ -170,6 +256,7 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     connect(m_model, &KFileItemModel::directoryLoadingCanceled,      this, &DolphinView::slotDirectoryLoadingCanceled);
     connect(m_model, &KFileItemModel::directoryLoadingProgress,   this, &DolphinView::directoryLoadingProgress);
     connect(m_model, &KFileItemModel::directorySortingProgress,   this, &DolphinView::directorySortingProgress);
+    connect(m_model, &KFileItemModel::directoryLoadingEstimateChanged, this, &DolphinView::directoryLoadingEstimateChanged);
     connect(m_model, &KFileItemModel::itemsChanged,
             this, &DolphinView::slotItemsChanged);
     connect(m_model, &KFileItemModel::itemsRemoved,    this, &DolphinView::itemCountChanged);
@@ -179,6 +266,41 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     connect(m_model, &KFileItemModel::directoryRedirection, this, &DolphinView::slotDirectoryRedirection);
     connect(m_model, &KFileItemModel::urlIsFileError,            this, &DolphinView::urlIsFileError);
 
+    // The cached summaries for the status bar refer to the indexes and data of the items
+    const auto invalidateSummaries = [this]() {
+        m_selection.invalidateSummary();
+        m_allItems.invalidateSummary();
+        m_rootStatValid = false;
+    };
+    connect(m_model, &KFileItemModel::itemsInserted, this, invalidateSummaries);
+    connect(m_model, &KFileItemModel::itemsRemoved, this, invalidateSummaries);
+    connect(m_model, &KFileItemModel::itemsMoved, this, invalidateSummaries);
+    connect(m_model, &KFileItemModel::itemsChanged, this, invalidateSummaries);
+    connect(m_model, &KFileItemModel::directoryLoadingStarted, this, invalidateSummaries);
+    connect(&TrashStatistics::instance(), &TrashStatistics::statisticsChanged, this, [this]() {
+        if (TrashStatistics::isTrashRoot(m_url)) {
+            m_rootStatValid = false;
+            requestStatusBarText();
+        }
+    });
+
+    // The capabilities of the selected items only depend on few roles
+    const auto invalidateSelectedItemsProperties = [this]() {
+        delete m_selectedItemsProperties;
+        m_selectedItemsProperties = nullptr;
+    };
+    connect(m_model, &KFileItemModel::itemsInserted, this, invalidateSelectedItemsProperties);
+    connect(m_model, &KFileItemModel::itemsRemoved, this, invalidateSelectedItemsProperties);
+    connect(m_model, &KFileItemModel::itemsMoved, this, invalidateSelectedItemsProperties);
+    connect(m_model, &KFileItemModel::directoryLoadingStarted, this, invalidateSelectedItemsProperties);
+    connect(m_model, &KFileItemModel::itemsChanged, this,
+            [invalidateSelectedItemsProperties](const KItemRangeList&, const QSet<QByteArray>& roles) {
+        static const QSet<QByteArray> capabilityRoles = {"url", "text", "type", "permissions", "isDir", "isLink"};
+        if (roles.intersects(capabilityRoles)) {
+            invalidateSelectedItemsProperties();
+        }
+    });
+
     connect(this, &DolphinView::itemCountChanged,
             this, &DolphinView::updatePlaceholderLabel);
 
@@ -197,6 +319,8 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     KItemListSelectionManager* selectionManager = controller->selectionManager();
     connect(selectionManager, &KItemListSelectionManager::selectionChanged,
             this, &DolphinView::slotSelectionChanged);
+    connect(selectionManager, &KItemListSelectionManager::currentChanged,
+            this, &DolphinView::slotCurrentChanged);
 
 #ifdef HAVE_BALOO
     m_toolTipManager = new ToolTipManager(this);
@@ -222,6 +346,9 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
 
 DolphinView::~DolphinView()
 {
+    recordLoadProfile();
+    delete m_selectedItemsProperties;
+    m_selectedItemsProperties = nullptr;
 }
 
 QUrl DolphinView::url() const
@@ -239,6 +366,8 @@ void DolphinView::setActive(bool active)
 
     updatePalette();
 
+    updateResolvingPriority();
+
     if (active) {
         m_container->setFocus();
         Q_EMIT activated();
@@ -251,6 +380,41 @@ bool DolphinView::isActive() const
     return m_active;
 }
 
+void DolphinView::setLoadingDeferred(bool deferred)
+{
+    if (deferred == m_loadingDeferred) {
+        return;
+    }
+
+    m_loadingDeferred = deferred;
+    if (!deferred && m_deferredLoadingPending) {
+        m_deferredLoadingPending = false;
+        loadDirectory(url());
+    }
+}
+
+bool DolphinView::isLoadingDeferred() const
+{
+    return m_loadingDeferred;
+}
+
+void DolphinView::setInBackground(bool background)
+{
+    if (background == m_inBackground) {
+        return;
+    }
+
+    m_inBackground = background;
+    m_model->setChangesDeferred(background);
+    m_view->setInBackground(background);
+    m_versionControlObserver->setPaused(background);
+}
+
+bool DolphinView::isInBackground() const
+{
+    return m_inBackground;
+}
+
 void DolphinView::setMode(Mode mode)
 {
     if (mode != m_mode) {
@@ -300,9 +464,7 @@ void DolphinView::setHiddenFilesShown(bool show)
         return;
     }
 
-    const KFileItemList itemList = selectedItems();
-    m_selectedUrls.clear();
-    m_selectedUrls = itemList.urlList();
+    m_selectedUrls = selection().urlList();
 
     ViewProperties props(viewPropertiesUrl());
     props.setHiddenFilesShown(show);
@@ -316,6 +478,23 @@ bool DolphinView::hiddenFilesShown() const
     return m_model->showHiddenFiles();
 }
 
+void DolphinView::setRecursiveListing(bool show)
+{
+    if (m_model->recursiveListing() == show) {
+        return;
+    }
+
+    m_selectedUrls = selection().urlList();
+
+    m_model->setRecursiveListing(show);
+    Q_EMIT recursiveListingChanged(show);
+}
+
+bool DolphinView::recursiveListing() const
+{
+    return m_model->recursiveListing();
+}
+
 void DolphinView::setGroupedSorting(bool grouped)
 {
     if (grouped == groupedSorting()) {
@@ -355,16 +534,28 @@ int DolphinView::itemsCount() const
 }
 
 KFileItemList DolphinView::selectedItems() const
+{
+    return selection().toList();
+}
+
+const KFileItemSelection& DolphinView::selection() const
 {
     const KItemListSelectionManager* selectionManager = m_container->controller()->selectionManager();
+    m_selection.setIndexes(selectionManager->selectedItems());
+    return m_selection;
+}
 
-    KFileItemList selectedItems;
-    const auto items = selectionManager->selectedItems();
-    selectedItems.reserve(items.count());
-    for (int index : items) {
-        selectedItems.append(m_model->fileItem(index));
+const KFileItemListProperties& DolphinView::selectedItemsProperties() const
+{
+    const KFileItemSelection& items = selection();
+    if (!m_selectedItemsProperties) {
+        m_selectedItemsProperties = new KFileItemListProperties(items.toList());
+        m_selectedItemsPropertiesIndexes = items.indexes();
+    } else if (m_selectedItemsPropertiesIndexes != items.indexes()) {
+        m_selectedItemsProperties->setItems(items.toList());
+        m_selectedItemsPropertiesIndexes = items.indexes();
     }
-    return selectedItems;
+    return *m_selectedItemsProperties;
 }
 
 int DolphinView::selectedItemsCount() const
@@ -373,6 +564,20 @@ int DolphinView::selectedItemsCount() const
     return selectionManager->selectedItems().count();
 }
 
+KFileItemList DolphinView::visibleItems() const
+{
+    KFileItemList items;
+    const int firstIndex = m_view->firstVisibleIndex();
+    const int lastIndex = qMin(m_view->lastVisibleIndex(), m_model->count() - 1);
+    if (firstIndex >= 0) {
+        items.reserve(lastIndex - firstIndex + 1);
+        for (int i = firstIndex; i <= lastIndex; ++i) {
+            items.append(m_model->fileItem(i));
+        }
+    }
+    return items;
+}
+
 void DolphinView::markUrlsAsSelected(const QList<QUrl>& urls)
 {
     m_selectedUrls = urls;
@@ -390,17 +595,7 @@ void DolphinView::selectItems(const QRegularExpression &regexp, bool enabled)
                                                         ? KItemListSelectionManager::Select
                                                         : KItemListSelectionManager::Deselect;
     KItemListSelectionManager* selectionManager = m_container->controller()->selectionManager();
-
-    for (int index = 0; index < m_model->count(); index++) {
-        const KFileItem item = m_model->fileItem(index);
-        if (regexp.match(item.text()).hasMatch()) {
-            // An alternative approach would be to store the matching items in a KItemSet and
-            // select them in one go after the loop, but we'd need a new function
-            // KItemListSelectionManager::setSelected(KItemSet, SelectionMode mode)
-            // for that.
-            selectionManager->setSelected(index, 1, mode);
-        }
-    }
+    selectionManager->setSelected(m_model->indexesMatching(regexp), mode);
 }
 
 void DolphinView::setZoomLevel(int level)
@@ -479,6 +674,9 @@ void DolphinView::reload()
     QDataStream saveStream(&viewState, QIODevice::WriteOnly);
     saveState(saveStream);
 
+    // Previews that have timed out before get another chance
+    KFileItemModelRolesUpdater::retryTimedOutPreviews(url());
+
     setUrl(url());
     loadDirectory(url(), true);
 
@@ -496,6 +694,11 @@ void DolphinView::readSettings()
 
     const int delay = GeneralSettings::autoExpandFolders() ? 750 : -1;
     m_container->controller()->setAutoActivationDelay(delay);
+    m_model->setRecursiveListingDepth(GeneralSettings::recursiveListingDepth());
+    m_model->setSortingMemoryLimit(static_cast<qint64>(GeneralSettings::sortingMemoryLimit()) * 1024 * 1024);
+    KMemoryBudget::instance().setBudget(static_cast<qint64>(GeneralSettings::memoryBudget()) * 1024 * 1024);
+    m_container->setEnabledHardwareAcceleration(GeneralSettings::hardwareAcceleratedViews());
+    m_container->setEnabledRemoteRendering(remoteRenderingEnabled());
 
     const int newZoomLevel = m_view->zoomLevel();
     if (newZoomLevel != oldZoomLevel) {
@@ -537,37 +740,45 @@ void DolphinView::requestStatusBarText()
     }
 
     if (m_container->controller()->selectionManager()->hasSelection()) {
-        int folderCount = 0;
-        int fileCount = 0;
-        KIO::filesize_t totalFileSize = 0;
-
         // Give a summary of the status of the selected files
-        const KFileItemList list = selectedItems();
-        for (const KFileItem& item : list) {
-            if (item.isDir()) {
-                ++folderCount;
-            } else {
-                ++fileCount;
-                totalFileSize += item.size();
-            }
-        }
-
-        if (folderCount + fileCount == 1) {
+        const KFileItemSelection& items = selection();
+        if (items.count() == 1) {
             // If only one item is selected, show info about it
-            Q_EMIT statusBarTextChanged(list.first().getStatusBarInfo());
+            Q_EMIT statusBarTextChanged(items.first().getStatusBarInfo());
         } else {
             // At least 2 items are selected
-            emitStatusBarText(folderCount, fileCount, totalFileSize, HasSelection);
+            emitStatusBarText(items.folderCount(), items.fileCount(), items.totalFileSize(), HasSelection);
         }
     } else { // has no selection
         if (!m_model->rootItem().url().isValid()) {
             return;
         }
 
-        m_statJobForStatusBarText = KIO::statDetails(m_model->rootItem().url(),
-                        KIO::StatJob::SourceSide, KIO::StatRecursiveSize, KIO::HideProgressInfo);
+        if (m_rootStatValid) {
+            // Nothing has changed since the last stat job
+            emitItemsStatusBarText();
+            return;
+        }
+
+        if (TrashStatistics::isTrashRoot(m_model->rootItem().url())) {
+            // The trash worker measures all trashed items for each stat job,
+            // the statistics only measure the items that have been added
+            TrashStatistics& statistics = TrashStatistics::instance();
+            if (statistics.isValid()) {
+                m_hasRootRecursiveSize = true;
+                m_rootRecursiveSize = static_cast<KIO::filesize_t>(statistics.size());
+                m_rootStatValid = true;
+                emitItemsStatusBarText();
+            } else {
+                statistics.update();
+            }
+            return;
+        }
+
+        m_statJobForStatusBarText = m_urlJobScope->add(KIO::statDetails(m_model->rootItem().url(),
+                        KIO::StatJob::SourceSide, KIO::StatRecursiveSize, KIO::HideProgressInfo));
         connect(m_statJobForStatusBarText, &KJob::result,
-                this, &DolphinView::slotStatJobResult);
+                m_urlJobScope->context(), [this](KJob* job) { slotStatJobResult(job); });
         m_statJobForStatusBarText->start();
     }
 }
@@ -631,6 +842,10 @@ void DolphinView::setUrl(const QUrl& url)
 
     m_url = url;
 
+    // E.g. the recursive size of the previous URL must
+    // not be measured or shown anymore
+    m_urlJobScope->cancel();
+
     hideToolTip();
 
     disconnect(m_view, &DolphinItemListView::roleEditingFinished,
@@ -647,6 +862,26 @@ void DolphinView::setUrl(const QUrl& url)
     Q_EMIT urlChanged(url);
 }
 
+void DolphinView::cacheSearchResults()
+{
+    m_model->cacheSearchResults();
+}
+
+QUrl DolphinView::cachedSearchResultsUrl() const
+{
+    return m_model->cachedSearchResultsUrl();
+}
+
+void DolphinView::forEachCachedSearchResult(const ItemVisitor& visitor) const
+{
+    m_model->forEachCachedSearchResult(visitor);
+}
+
+void DolphinView::prepareNarrowedSearch(const QUrl& url, const ItemPredicate& matches)
+{
+    m_model->prepareNarrowedSearch(url, matches);
+}
+
 void DolphinView::selectAll()
 {
     KItemListSelectionManager* selectionManager = m_container->controller()->selectionManager();
@@ -655,6 +890,8 @@ void DolphinView::selectAll()
 
 void DolphinView::invertSelection()
 {
+    // Toggling all items complements the selection range by range
+    // against [0, count), without iterating the items.
     KItemListSelectionManager* selectionManager = m_container->controller()->selectionManager();
     selectionManager->setSelected(0, m_model->count(), KItemListSelectionManager::Toggle);
 }
@@ -680,6 +917,22 @@ void DolphinView::renameSelectedItems()
 
         connect(m_view, &DolphinItemListView::roleEditingFinished,
                 this, &DolphinView::slotRoleEditingFinished);
+    } else if (items.count() > 1) {
+        BatchRenameDialog* dialog = new BatchRenameDialog(items, this);
+        dialog->setAttribute(Qt::WA_DeleteOnClose);
+        connect(dialog, &BatchRenameDialog::accepted, this, [this, dialog]() {
+            BatchRenamer* renamer = new BatchRenamer(this);
+            connect(renamer, &BatchRenamer::errorMessage, this, &DolphinView::errorMessage);
+            connect(renamer, &BatchRenamer::finished, this, [this, renamer](const QList<QUrl>& urls) {
+                renamer->deleteLater();
+                if (!urls.isEmpty()) {
+                    slotRenameDialogRenamingFinished(urls);
+                }
+            });
+            renamer->start(dialog->items(), dialog->pattern(), dialog->startIndex());
+        });
+
+        dialog->open();
     } else {
         KIO::RenameFileDialog* dialog = new KIO::RenameFileDialog(items, this);
         connect(dialog, &KIO::RenameFileDialog::renamingFinished,
@@ -737,23 +990,74 @@ void DolphinView::copySelectedItemsToClipboard()
 
 void DolphinView::copySelectedItems(const KFileItemList &selection, const QUrl &destinationUrl)
 {
-    KIO::CopyJob* job = KIO::copy(selection.urlList(), destinationUrl, KIO::DefaultFlags);
-    KJobWidgets::setWindow(job, this);
-
-    connect(job, &KIO::DropJob::result, this, &DolphinView::slotJobResult);
-    connect(job, &KIO::CopyJob::copyingDone, this, &DolphinView::slotCopyingDone);
-    KIO::FileUndoManager::self()->recordCopyJob(job);
+    const QList<QUrl> urls = selection.urlList();
+    const QPointer<DolphinView> view(this);
+    const QString description = i18ncp("@info", "Copying one item", "Copying %1 items", urls.count());
+    FileOperationQueue::instance().enqueue(description, destinationUrl, [urls, destinationUrl, view]() -> KJob* {
+        KIO::CopyJob* job = KIO::copy(urls, destinationUrl, KIO::DefaultFlags);
+        KIO::FileUndoManager::self()->recordCopyJob(job);
+        if (view) {
+            view->connectCopyJob(job);
+        }
+        return job;
+    });
 }
 
 void DolphinView::moveSelectedItems(const KFileItemList &selection, const QUrl &destinationUrl)
 {
-    KIO::CopyJob* job = KIO::move(selection.urlList(), destinationUrl, KIO::DefaultFlags);
-    KJobWidgets::setWindow(job, this);
+    const QList<QUrl> urls = selection.urlList();
+    const QPointer<DolphinView> view(this);
+    const QString description = i18ncp("@info", "Moving one item", "Moving %1 items", urls.count());
+    FileOperationQueue::instance().enqueue(description, destinationUrl, [urls, destinationUrl, view]() -> KJob* {
+        KIO::CopyJob* job = KIO::move(urls, destinationUrl, KIO::DefaultFlags);
+        KIO::FileUndoManager::self()->recordCopyJob(job);
+        if (view) {
+            view->connectCopyJob(job);
+        }
+        return job;
+    });
+}
 
-    connect(job, &KIO::DropJob::result, this, &DolphinView::slotJobResult);
+void DolphinView::connectCopyJob(KIO::CopyJob* job)
+{
+    KJobWidgets::setWindow(job, this);
+    connect(job, &KIO::CopyJob::result, this, &DolphinView::slotJobResult);
     connect(job, &KIO::CopyJob::copyingDone, this, &DolphinView::slotCopyingDone);
-    KIO::FileUndoManager::self()->recordCopyJob(job);
+}
+
+KJob* DolphinView::startLocalCopyJob(const QList<QUrl>& sources, const QUrl& destination, bool selectCopies)
+{
+    LocalCopyJob* job = LocalCopyJob::copyInto(sources, destination);
+    if (!job) {
+        return nullptr;
+    }
 
+    KJobWidgets::setWindow(job, this);
+    KIO::getJobTracker()->registerJob(job);
+    connect(job, &LocalCopyJob::copyJobStarted, this, [this, selectCopies](KIO::CopyJob* copyJob) {
+        KIO::FileUndoManager::self()->recordCopyJob(copyJob);
+        KJobWidgets::setWindow(copyJob, this);
+        if (selectCopies) {
+            m_clearSelectionBeforeSelectingNewItems = true;
+            m_markFirstNewlySelectedItemAsCurrent = true;
+            connect(copyJob, &KIO::CopyJob::copyingDone, this, &DolphinView::slotCopyingDone);
+        }
+    });
+    connect(job, &KJob::result, this, [this, selectCopies](KJob* copyJob) {
+        // The items that have been copied by KIO are recorded by KIO::FileUndoManager
+        const QList<QUrl> copiedUrls = static_cast<LocalCopyJob*>(copyJob)->copiedUrls();
+        LocalOperationUndo::instance().recordCopying(copiedUrls);
+        if (selectCopies && !copiedUrls.isEmpty()) {
+            m_clearSelectionBeforeSelectingNewItems = true;
+            m_markFirstNewlySelectedItemAsCurrent = true;
+            for (const QUrl& url : copiedUrls) {
+                slotItemCreated(url);
+            }
+        }
+        slotJobResult(copyJob);
+    });
+    job->start();
+    return job;
 }
 
 void DolphinView::paste()
@@ -763,7 +1067,7 @@ void DolphinView::paste()
 
 void DolphinView::pasteIntoFolder()
 {
-    const KFileItemList items = selectedItems();
+    const KFileItemSelection& items = selection();
     if ((items.count() == 1) && items.first().isDir()) {
         pasteToUrl(items.first().url());
     }
@@ -778,37 +1082,77 @@ void DolphinView::duplicateSelectedItems()
 
     const QMimeDatabase db;
 
+    // Names that are taken by the duplicates of previous items
+    QSet<QUrl> reservedUrls;
+    reservedUrls.reserve(itemList.count());
+
     // Duplicate all selected items and append "copy" to the end of the file name
-    // but before the filename extension, if present
+    // but before the filename extension, if present. If the name is used already,
+    // a number is appended to "copy".
+    QList<QUrl> sources;
     QList<QUrl> newSelection;
+    sources.reserve(itemList.count());
+    newSelection.reserve(itemList.count());
     for (const auto &item : itemList) {
         const QUrl originalURL  = item.url();
         const QString originalDirectoryPath = originalURL.adjusted(QUrl::RemoveFilename).path();
         const QString originalFileName = item.name();
 
         QString extension = db.suffixForFileName(originalFileName);
-
-        QUrl duplicateURL = originalURL;
-
-        // No extension; new filename is "<oldfilename> copy"
-        if (extension.isEmpty()) {
-            duplicateURL.setPath(originalDirectoryPath + i18nc("<filename> copy", "%1 copy", originalFileName));
-        // There's an extension; new filename is "<oldfilename> copy.<extension>"
-        } else {
+        QString originalFilenameWithoutExtension = originalFileName;
+        QString originalExtension;
+        if (!extension.isEmpty()) {
             // Need to add a dot since QMimeDatabase::suffixForFileName() doesn't include it
             extension = QLatin1String(".") + extension;
-            const QString originalFilenameWithoutExtension = originalFileName.chopped(extension.size());
+            originalFilenameWithoutExtension = originalFileName.chopped(extension.size());
             // Preserve file's original filename extension in case the casing differs
             // from what QMimeDatabase::suffixForFileName() returned
-            const QString originalExtension = originalFileName.right(extension.size());
-            duplicateURL.setPath(originalDirectoryPath + i18nc("<filename> copy", "%1 copy", originalFilenameWithoutExtension) + originalExtension);
+            originalExtension = originalFileName.right(extension.size());
         }
 
-        KIO::CopyJob* job = KIO::copyAs(originalURL, duplicateURL);
+        QUrl duplicateURL = originalURL;
+        int number = 1;
+        do {
+            // No extension; new filename is "<oldfilename> copy"
+            // There's an extension; new filename is "<oldfilename> copy.<extension>"
+            const QString baseName = number == 1
+                ? i18nc("<filename> copy", "%1 copy", originalFilenameWithoutExtension)
+                : i18nc("<filename> copy <number>", "%1 copy %2", originalFilenameWithoutExtension, number);
+            duplicateURL.setPath(originalDirectoryPath + baseName + originalExtension);
+            ++number;
+        } while (reservedUrls.contains(duplicateURL) || m_model->index(duplicateURL) >= 0);
+
+        reservedUrls.insert(duplicateURL);
+        sources << originalURL;
+        newSelection << duplicateURL;
+    }
+
+    const bool duplicateLocally = itemList.count() >= LocalDuplicationMinimumCount
+        && std::all_of(sources.cbegin(), sources.cend(), [](const QUrl& url) {
+               return url.isLocalFile();
+           });
+
+    if (duplicateLocally) {
+        // The duplicates are on the same file system as the items, so the
+        // data of the files can be shared by reflinks on Btrfs and XFS.
+        // Names that are used by items which are not shown are replaced
+        // by the job, which checks the existence outside the main thread.
+        LocalCopyJob* job = new LocalCopyJob(sources, newSelection);
+        job->setAutoRename(true);
         KJobWidgets::setWindow(job, this);
-
-        if (job) {
-            newSelection << duplicateURL;
+        KIO::getJobTracker()->registerJob(job);
+        connect(job, &KJob::result, this, [this](KJob* copyJob) {
+            const QList<QUrl> copiedUrls = static_cast<LocalCopyJob*>(copyJob)->copiedUrls();
+            LocalOperationUndo::instance().recordCopying(copiedUrls);
+            if (copyJob->error() != 0 && copyJob->error() != KJob::KilledJobError) {
+                Q_EMIT errorMessage(copyJob->errorString());
+            }
+        });
+        job->start();
+    } else {
+        for (int i = 0; i < sources.count(); ++i) {
+            KIO::CopyJob* job = KIO::copyAs(sources.at(i), newSelection.at(i));
+            KJobWidgets::setWindow(job, this);
             KIO::FileUndoManager::self()->recordCopyJob(job);
         }
     }
@@ -873,6 +1217,21 @@ bool DolphinView::eventFilter(QObject* watched, QEvent* event)
         }
         break;
 
+    case QEvent::GraphicsSceneMouseMove:
+        // Moving the mouse with a pressed button drags the items or
+        // selects them by the rubber band, hovering the items is ignored
+        if (watched == m_view && static_cast<QGraphicsSceneMouseEvent*>(event)->buttons() != Qt::NoButton) {
+            deferResortingWhileInteracting();
+        }
+        break;
+
+    case QEvent::GraphicsSceneWheel:
+    case QEvent::GraphicsSceneDragMove:
+        if (watched == m_view) {
+            deferResortingWhileInteracting();
+        }
+        break;
+
     case QEvent::GraphicsSceneDragEnter:
         if (watched == m_view) {
             m_dragging = true;
@@ -1155,10 +1514,16 @@ void DolphinView::slotItemHovered(int index)
         itemRect.moveTo(pos);
 
 #ifdef HAVE_BALOO
-        m_toolTipManager->showToolTip(item, itemRect, nativeParentWidget()->windowHandle());
+        // The preview that is shown by the view is used until a larger one is available
+        const QPixmap itemPixmap = m_model->data(index).value("iconPixmap").value<QPixmap>();
+        m_toolTipManager->showToolTip(item, itemRect, nativeParentWidget()->windowHandle(), itemPixmap);
 #endif
     }
 
+    if (item.isDir()) {
+        prefetchFolder(item.url());
+    }
+
     Q_EMIT requestItemInfo(item);
 }
 
@@ -1166,9 +1531,24 @@ void DolphinView::slotItemUnhovered(int index)
 {
     Q_UNUSED(index)
     hideToolTip();
+    prefetchFolder(QUrl());
     Q_EMIT requestItemInfo(KFileItem());
 }
 
+void DolphinView::slotCurrentChanged(int current, int previous)
+{
+    // The current item is changed without a previous one when a folder is
+    // loaded. Only the folders the user moves to are prefetched.
+    if (previous < 0) {
+        return;
+    }
+
+    const KFileItem item = m_model->fileItem(current);
+    if (item.isDir()) {
+        prefetchFolder(item.url());
+    }
+}
+
 void DolphinView::slotItemDropEvent(int index, QGraphicsSceneDragDropEvent* event)
 {
     QUrl destUrl;
@@ -1195,6 +1575,17 @@ void DolphinView::slotItemDropEvent(int index, QGraphicsSceneDragDropEvent* even
 
 void DolphinView::dropUrls(const QUrl &destUrl, QDropEvent *dropEvent, QWidget *dropWidget)
 {
+    // Holding Control requests copying, otherwise KIO::DropJob asks for
+    // the operation or moves the items
+    const Qt::KeyboardModifiers modifiers = dropEvent->keyboardModifiers() & (Qt::ControlModifier | Qt::ShiftModifier);
+    if (modifiers == Qt::ControlModifier && dropEvent->mimeData()->hasUrls()) {
+        const QList<QUrl> urls = KUrlMimeData::urlsFromMimeData(dropEvent->mimeData(), KUrlMimeData::PreferLocalUrls);
+        if (startLocalCopyJob(urls, destUrl, destUrl == url())) {
+            dropEvent->acceptProposedAction();
+            return;
+        }
+    }
+
     KIO::DropJob* job = DragAndDropHelper::dropUrls(destUrl, dropEvent, dropWidget);
 
     if (job) {
@@ -1297,32 +1688,26 @@ void DolphinView::emitSelectionChangedSignal()
 
 void DolphinView::slotStatJobResult(KJob *job)
 {
-    int folderCount = 0;
-    int fileCount = 0;
-    KIO::filesize_t totalFileSize = 0;
-    bool countFileSize = true;
-
     const auto entry =  static_cast<KIO::StatJob *>(job)->statResult();
-    if (entry.contains(KIO::UDSEntry::UDS_RECURSIVE_SIZE)) {
+    m_hasRootRecursiveSize = entry.contains(KIO::UDSEntry::UDS_RECURSIVE_SIZE);
+    if (m_hasRootRecursiveSize) {
         // We have a precomputed value.
-        totalFileSize = static_cast<KIO::filesize_t>(
+        m_rootRecursiveSize = static_cast<KIO::filesize_t>(
                                 entry.numberValue(KIO::UDSEntry::UDS_RECURSIVE_SIZE));
-        countFileSize = false;
     }
+    m_rootStatValid = true;
 
-    const int itemCount = m_model->count();
-    for (int i = 0; i < itemCount; ++i) {
-        const KFileItem item = m_model->fileItem(i);
-        if (item.isDir()) {
-            ++folderCount;
-        } else {
-            ++fileCount;
-            if (countFileSize) {
-                totalFileSize += item.size();
-            }
-        }
-    }
-    emitStatusBarText(folderCount, fileCount, totalFileSize, NoSelection);
+    emitItemsStatusBarText();
+}
+
+void DolphinView::emitItemsStatusBarText()
+{
+    // The summary is only calculated again if the items have been changed
+    m_allItems.setIndexes(KItemSet(KItemRangeList() << KItemRange(0, m_model->count())));
+
+    const KIO::filesize_t totalFileSize = m_hasRootRecursiveSize ? m_rootRecursiveSize
+                                                                 : m_allItems.totalFileSize();
+    emitStatusBarText(m_allItems.folderCount(), m_allItems.fileCount(), totalFileSize, NoSelection);
 }
 
 void DolphinView::updateSortRole(const QByteArray& role)
@@ -1420,15 +1805,22 @@ void DolphinView::saveState(QDataStream& stream)
     }
 
     // Save the selected urls
-    stream << selectedItems().urlList();
+    stream << selection().urlList();
 
     // Save view position
     const qreal x = m_container->horizontalScrollBar()->value();
     const qreal y = m_container->verticalScrollBar()->value();
     stream << QPoint(x, y);
 
-    // Save expanded folders (only relevant for the details view - the set will be empty in other view modes)
-    stream << m_model->expandedDirectories();
+    // Save expanded folders (only relevant for the details view - the set will be empty in other view modes).
+    // Folders that are still being restored are saved too, so that the state is not lost if the tab is
+    // saved before all folders have been listed.
+    stream << (m_model->expandedDirectories() | m_model->directoriesToBeExpanded());
+}
+
+void DolphinView::retainSnapshot()
+{
+    m_model->retainSnapshot();
 }
 
 KFileItem DolphinView::rootItem() const
@@ -1561,18 +1953,26 @@ void DolphinView::updateViewState()
                 m_clearSelectionBeforeSelectingNewItems = false;
             }
 
-            KItemSet selectedItems = selectionManager->selectedItems();
-
-            QList<QUrl>::iterator it = m_selectedUrls.begin();
-            while (it != m_selectedUrls.end()) {
-                const int index = m_model->index(*it);
+            // Inserting many unsorted indexes one by one into a KItemSet and
+            // erasing the found URLs from the list is slow, e.g. after thousands
+            // of items have been duplicated. The ranges are created at once instead.
+            QVector<int> indexes;
+            QList<QUrl> missingUrls;
+            indexes.reserve(m_selectedUrls.count());
+            for (const QUrl& url : qAsConst(m_selectedUrls)) {
+                const int index = m_model->index(url);
                 if (index >= 0) {
-                    selectedItems.insert(index);
-                    it = m_selectedUrls.erase(it);
+                    indexes.append(index);
                 } else {
-                    ++it;
+                    missingUrls.append(url);
                 }
             }
+            m_selectedUrls = missingUrls;
+
+            std::sort(indexes.begin(), indexes.end());
+            indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+            const KItemSet selectedItems = selectionManager->selectedItems()
+                + KItemSet(KItemRangeList::fromSortedContainer(indexes));
 
             selectionManager->beginAnchoredSelection(selectionManager->currentItem());
             selectionManager->setSelectedItems(selectedItems);
@@ -1645,6 +2045,7 @@ void DolphinView::slotDirectoryLoadingStarted()
 {
     m_loading = true;
     updatePlaceholderLabel();
+    m_model->setVisibleItemCountHint(visibleItemCountHint());
 
     // Disable the writestate temporary until it can be determined in a fast way
     // in DolphinView::slotDirectoryLoadingCompleted()
@@ -1659,6 +2060,9 @@ void DolphinView::slotDirectoryLoadingStarted()
 void DolphinView::slotDirectoryLoadingCompleted()
 {
     m_loading = false;
+    if (m_listingTime < 0 && m_listingTimer.isValid()) {
+        m_listingTime = m_listingTimer.elapsed();
+    }
 
     // Update the view-state. This has to be done asynchronously
     // because the view might not be in its final state yet.
@@ -1812,6 +2216,31 @@ void DolphinView::loadDirectory(const QUrl& url, bool reload)
         return;
     }
 
+    if (m_loadingDeferred) {
+        // The directory is loaded by setLoadingDeferred(false). Stop
+        // loading the previous directory, so that its items don't
+        // get inserted into the cleared model.
+        m_model->cancelDirectoryLoading();
+        m_deferredLoadingPending = true;
+        return;
+    }
+
+    // Search results are shown while they arrive and are sorted afterwards
+    const bool searchUrl = url.scheme().contains(QLatin1String("search"));
+    m_model->setSearchModeEnabled(searchUrl);
+
+    // The strategy for loading the directory is chosen from its previous visits
+    recordLoadProfile();
+    m_loadProfileUrl = searchUrl ? QUrl() : url;
+    m_loadProfile = DirectoryLoadProfile::load(m_loadProfileUrl);
+    if (m_loadProfile.isValid() && !reload) {
+        m_model->setExpectedItemCount(m_loadProfile.entryCount());
+    }
+    m_listingTime = -1;
+    m_listingTimer.start();
+    m_view->resetPreviewStatistics();
+    updateResolvingPriority();
+
     if (reload) {
         m_model->refreshDirectory(url);
     } else {
@@ -1819,6 +2248,12 @@ void DolphinView::loadDirectory(const QUrl& url, bool reload)
     }
 }
 
+void DolphinView::deferResortingWhileInteracting()
+{
+    m_model->setResortingDeferred(true);
+    m_interactionTimer->start();
+}
+
 void DolphinView::applyViewProperties()
 {
     const ViewProperties props(viewPropertiesUrl());
@@ -1931,23 +2366,49 @@ void DolphinView::applyModeToView()
 
 void DolphinView::pasteToUrl(const QUrl& url)
 {
-    KIO::PasteJob *job = KIO::paste(QApplication::clipboard()->mimeData(), url);
-    KJobWidgets::setWindow(job, this);
-    m_clearSelectionBeforeSelectingNewItems = true;
-    m_markFirstNewlySelectedItemAsCurrent = true;
-    connect(job, &KIO::PasteJob::itemCreated, this, &DolphinView::slotItemCreated);
-    connect(job, &KIO::PasteJob::result, this, &DolphinView::slotJobResult);
+    // The clipboard might be changed before the paste operation is
+    // started by the queue, so its current content is copied.
+    const QMimeData* clipboardData = QApplication::clipboard()->mimeData();
+    QSharedPointer<QMimeData> mimeData(new QMimeData());
+    if (clipboardData) {
+        const QStringList formats = clipboardData->formats();
+        for (const QString& format : formats) {
+            mimeData->setData(format, clipboardData->data(format));
+        }
+    }
+
+    const int urlsCount = KUrlMimeData::urlsFromMimeData(mimeData.data()).count();
+    const QString description = (urlsCount > 0)
+        ? i18ncp("@info", "Pasting one item", "Pasting %1 items", urlsCount)
+        : i18nc("@info", "Pasting clipboard contents");
+    const QPointer<DolphinView> view(this);
+    FileOperationQueue::instance().enqueue(description, url, [mimeData, url, view]() -> KJob* {
+        // Items on the same file system as the destination are copied
+        // without KIO, moving them is done by renaming anyway.
+        if (view && !KIO::isClipboardDataCut(mimeData.data())) {
+            const QList<QUrl> urls = KUrlMimeData::urlsFromMimeData(mimeData.data(), KUrlMimeData::PreferLocalUrls);
+            if (KJob* job = view->startLocalCopyJob(urls, url, true)) {
+                return job;
+            }
+        }
+
+        // The queue keeps this function and therefore the mime data
+        // until the job has been finished.
+        KIO::PasteJob* job = KIO::paste(mimeData.data(), url);
+        if (view) {
+            KJobWidgets::setWindow(job, view);
+            view->m_clearSelectionBeforeSelectingNewItems = true;
+            view->m_markFirstNewlySelectedItemAsCurrent = true;
+            connect(job, &KIO::PasteJob::itemCreated, view, &DolphinView::slotItemCreated);
+            connect(job, &KIO::PasteJob::result, view, &DolphinView::slotJobResult);
+        }
+        return job;
+    });
 }
 
 QList<QUrl> DolphinView::simplifiedSelectedUrls() const
 {
-    QList<QUrl> urls;
-
-    const KFileItemList items = selectedItems();
-    urls.reserve(items.count());
-    for (const KFileItem& item : items) {
-        urls.append(item.url());
-    }
+    QList<QUrl> urls = selection().urlList();
 
     if (itemsExpandable()) {
         // TODO: Check if we still need KDirModel for this in KDE 5.0
@@ -2029,14 +2490,23 @@ void DolphinView::copyPathToClipboard()
     clipboard->setText(path);
 }
 
-void DolphinView::slotIncreaseZoom()
+void DolphinView::slotPinchZoomFinished(qreal scaleFactor)
 {
-    setZoomLevel(zoomLevel() + 1);
-}
+    // The previews are stretched to the new icon size, unless it differs
+    // too much from their size, see KFileItemModelRolesUpdater::setIconSize()
+    const qreal scaledIconSize = ZoomLevelInfo::iconSizeForZoomLevel(zoomLevel()) * scaleFactor;
 
-void DolphinView::slotDecreaseZoom()
-{
-    setZoomLevel(zoomLevel() - 1);
+    // Apply the zoom level whose icon size is closest to the scaled items
+    int newZoomLevel = zoomLevel();
+    qreal minimumDistance = std::numeric_limits<qreal>::max();
+    for (int level = ZoomLevelInfo::minimumLevel(); level <= ZoomLevelInfo::maximumLevel(); ++level) {
+        const qreal distance = qAbs(ZoomLevelInfo::iconSizeForZoomLevel(level) - scaledIconSize);
+        if (distance < minimumDistance) {
+            minimumDistance = distance;
+            newZoomLevel = level;
+        }
+    }
+    setZoomLevel(newZoomLevel);
 }
 
 void DolphinView::slotSwipeUp()
@@ -2044,6 +2514,42 @@ void DolphinView::slotSwipeUp()
     Q_EMIT goUpRequested();
 }
 
+int DolphinView::visibleItemCountHint() const
+{
+    const QSizeF viewSize = m_view->size();
+    const QSizeF itemSize = m_view->itemSize();
+    if (viewSize.isEmpty() || itemSize.height() <= 0) {
+        return 0;
+    }
+
+    // In the details view the width of the items is not fixed and each row shows one item
+    const int columns = itemSize.width() > 0 ? qMax(1, static_cast<int>(viewSize.width() / itemSize.width())) : 1;
+    const int rows = qMax(1, qCeil(viewSize.height() / itemSize.height()));
+    return columns * rows;
+}
+
+void DolphinView::recordLoadProfile()
+{
+    if (m_loadProfileUrl.isEmpty()) {
+        return;
+    }
+
+    // If the directory is left before it has been listed completely, the
+    // listing has taken at least the time until then
+    const bool listingCompleted = (m_listingTime >= 0);
+    const int listingTime = listingCompleted ? m_listingTime : m_listingTimer.elapsed();
+    m_loadProfile.record(m_loadProfileUrl, m_model->listedItemCount(), listingTime,
+                         m_view->averagePreviewTime(), listingCompleted);
+    m_loadProfileUrl.clear();
+}
+
+void DolphinView::updateResolvingPriority()
+{
+    // The inactive view of a split view leaves most of the preview
+    // jobs to the active view
+    m_view->setLowPriority(!m_active || m_loadProfile.resolveVisibleItemsOnly());
+}
+
 void DolphinView::updatePlaceholderLabel()
 {
     if (m_loading || itemsCount() > 0) {
@@ -2075,3 +2581,19 @@ void DolphinView::updatePlaceholderLabel()
 
     m_placeholderLabel->setVisible(true);
 }
+
+void DolphinView::prefetchFolder(const QUrl& url)
+{
+    if (url == m_prefetchedUrl) {
+        return;
+    }
+
+    if (!m_prefetchedUrl.isEmpty()) {
+        m_model->cancelPrefetching(m_prefetchedUrl);
+    }
+
+    m_prefetchedUrl = url;
+    if (!url.isEmpty()) {
+        m_model->prefetchDirectory(url);
+    }
+}
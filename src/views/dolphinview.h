@@ -10,7 +10,9 @@
 
 #include "dolphintabwidget.h"
 #include "dolphin_export.h"
+#include "kitemviews/kfileitemselection.h"
 #include "tooltips/tooltipmanager.h"
+#include "views/directoryloadprofile.h"
 
 #include <KFileItem>
 #include <KIO/Job>
@@ -18,18 +20,23 @@
 #include <kio/fileundomanager.h>
 #include <kparts/part.h>
 
+#include <QElapsedTimer>
 #include <QMimeData>
 #include <QPointer>
 #include <QUrl>
 #include <QWidget>
 
+#include <functional>
+
 typedef KIO::FileUndoManager::CommandType CommandType;
 class QVBoxLayout;
 class DolphinItemListView;
+class KFileItemListProperties;
 class KFileItemModel;
 class KItemListContainer;
 class KItemModelBase;
 class KItemSet;
+class JobScope;
 class ToolTipManager;
 class VersionControlObserver;
 class ViewProperties;
@@ -37,6 +44,10 @@ class QLabel;
 class QGraphicsSceneDragDropEvent;
 class QRegularExpression;
 
+namespace KIO {
+    class CopyJob;
+}
+
 /**
  * @short Represents a view for the directory content.
  *
@@ -99,6 +110,25 @@ public:
     void setActive(bool active);
     bool isActive() const;
 
+    /**
+     * If \a deferred is true, the directory of the view is not loaded
+     * until setLoadingDeferred(false) is invoked. The URL can be changed
+     * and the state can be restored as usual in the meantime. Is used
+     * for tabs that have been restored but not activated yet.
+     */
+    void setLoadingDeferred(bool deferred);
+    bool isLoadingDeferred() const;
+
+    /**
+     * If \a background is true, the view is not visible to the user because
+     * it is part of an inactive tab. The roles of the items are not resolved,
+     * the version control states are not retrieved and the changes of the
+     * directory are only collected. They are applied at once when the view
+     * is in the foreground again.
+     */
+    void setInBackground(bool background);
+    bool isInBackground() const;
+
     /**
      * Changes the view mode for the current directory to \a mode.
      * If the view properties should be remembered for each directory
@@ -128,6 +158,16 @@ public:
     void setHiddenFilesShown(bool show);
     bool hiddenFilesShown() const;
 
+    /**
+     * Shows the files of all subfolders of the current directory as
+     * one flat list, if \a show is true. The number of subfolder levels
+     * is limited by GeneralSettings::recursiveListingDepth(). The setting
+     * is kept by the view when the directory is changed, but it is not
+     * stored in the view properties.
+     */
+    void setRecursiveListing(bool show);
+    bool recursiveListing() const;
+
     /**
      * Turns on sorting by groups if \a enable is true.
      */
@@ -151,12 +191,32 @@ public:
      */
     KFileItemList selectedItems() const;
 
+    /**
+     * Returns a view on the selected items, which does not copy the items
+     * and caches the number of selected folders and files. Should be
+     * preferred to selectedItems() if no KFileItemList is required.
+     */
+    const KFileItemSelection& selection() const;
+
+    /**
+     * Returns the capabilities of the selected items. They are only
+     * determined once for each selection and shared by the actions of the
+     * main window and the context menu, as determining them is expensive
+     * for large selections.
+     */
+    const KFileItemListProperties& selectedItemsProperties() const;
+
     /**
      * Returns the number of selected items (this is faster than
      * invoking selectedItems().count()).
      */
     int selectedItemsCount() const;
 
+    /**
+     * Returns the items that are currently visible in the view.
+     */
+    KFileItemList visibleItems() const;
+
     /**
      * Marks the items indicated by \p urls to get selected after the
      * directory DolphinView::url() has been loaded. Note that nothing
@@ -287,6 +347,12 @@ public:
      */
     void saveState(QDataStream& stream);
 
+    /**
+     * Keeps the snapshot of the shown folder after the view has been deleted,
+     * e.g. if its tab is closed. See KFileItemModel::retainSnapshot().
+     */
+    void retainSnapshot();
+
     /**
      * Returns the root item which represents the current URL.
      */
@@ -310,6 +376,25 @@ public:
      */
     static QUrl openItemAsFolderUrl(const KFileItem& item, const bool browseThroughArchives = true);
 
+    // Same as KFileItemModel::ItemPredicate and KFileItemModel::ItemVisitor
+    typedef std::function<bool(const KFileItem& item, const QHash<QByteArray, QVariant>& values)> ItemPredicate;
+    typedef std::function<void(const KFileItem& item, const QHash<QByteArray, QVariant>& values)> ItemVisitor;
+
+    /**
+     * Keeps the shown search results after another URL has been set,
+     * see KFileItemModel::cacheSearchResults().
+     */
+    void cacheSearchResults();
+    QUrl cachedSearchResultsUrl() const;
+    void forEachCachedSearchResult(const ItemVisitor& visitor) const;
+
+    /**
+     * Shows the kept search results for which \a matches returns true at
+     * once when the search \a url is set by setUrl(), see
+     * KFileItemModel::prepareNarrowedSearch().
+     */
+    void prepareNarrowedSearch(const QUrl& url, const ItemPredicate& matches);
+
     /**
      * Hides tooltip displayed over element.
      */
@@ -451,6 +536,9 @@ Q_SIGNALS:
     /** Is emitted if the 'show hidden files' property has been changed. */
     void hiddenFilesShownChanged(bool shown);
 
+    /** Is emitted if the recursive listing has been turned on or off. */
+    void recursiveListingChanged(bool enabled);
+
     /** Is emitted if the 'grouped sorting' property has been changed. */
     void groupedSortingChanged(bool groupedSorting);
 
@@ -549,6 +637,13 @@ Q_SIGNALS:
      */
     void directorySortingProgress(int percent);
 
+    /**
+     * Is emitted periodically while a huge directory is loaded and provides
+     * the number of loaded items and the estimated totals, see
+     * KFileItemModel::directoryLoadingEstimateChanged().
+     */
+    void directoryLoadingEstimateChanged(int listedCount, int estimatedCount, KIO::filesize_t estimatedSize);
+
     /**
      * Emitted when the file-item-model emits redirection.
      * Testcase: fish://localhost
@@ -616,14 +711,14 @@ private Q_SLOTS:
     void slotHeaderColumnWidthChangeFinished(const QByteArray& role, qreal current);
     void slotItemHovered(int index);
     void slotItemUnhovered(int index);
+    void slotCurrentChanged(int current, int previous);
     void slotItemDropEvent(int index, QGraphicsSceneDragDropEvent* event);
     void slotModelChanged(KItemModelBase* current, KItemModelBase* previous);
     void slotMouseButtonPressed(int itemIndex, Qt::MouseButtons buttons);
     void slotRenameDialogRenamingFinished(const QList<QUrl>& urls);
     void slotSelectedItemTextPressed(int index);
     void slotCopyingDone(KIO::Job *, const QUrl &, const QUrl &to);
-    void slotIncreaseZoom();
-    void slotDecreaseZoom();
+    void slotPinchZoomFinished(qreal scaleFactor);
     void slotSwipeUp();
 
     /*
@@ -652,13 +747,20 @@ private Q_SLOTS:
 
     /**
      * Helper method for DolphinView::requestStatusBarText().
-     * Calculates the amount of folders and files and their total size in
-     * response to a KStatJob::result(), then calls emitStatusBarText().
+     * Remembers the recursive size of the folder from the result of the
+     * KStatJob, then calls emitItemsStatusBarText().
      * @see requestStatusBarText()
      * @see emitStatusBarText()
      */
     void slotStatJobResult(KJob *job);
 
+    /**
+     * Helper method for DolphinView::requestStatusBarText().
+     * Emits the status bar text for all items from the cached amount of
+     * folders and files and their total size.
+     */
+    void emitItemsStatusBarText();
+
     /**
      * Updates the view properties of the current URL to the
      * sorting given by \a role.
@@ -757,6 +859,14 @@ private Q_SLOTS:
 private:
     void loadDirectory(const QUrl& url, bool reload = false);
 
+    /**
+     * Defers the resortings of the model that are caused by the resolved
+     * sort role values until the user has not scrolled, dragged or selected
+     * by the rubber band for a while, so that the items do not move under
+     * the cursor.
+     */
+    void deferResortingWhileInteracting();
+
     /**
      * Applies the view properties which are defined by the current URL
      * to the DolphinView properties. The view properties are read from a
@@ -797,6 +907,23 @@ private:
      */
     void pasteToUrl(const QUrl& url);
 
+    /**
+     * Connects the copy or move \a job, which has been started by
+     * copySelectedItems() or moveSelectedItems(), to the view.
+     */
+    void connectCopyJob(KIO::CopyJob* job);
+
+    /**
+     * Copies \a sources into \a destination by LocalCopyJob, which can share
+     * the data of the files on Btrfs and XFS instead of copying it, or which
+     * copies them by KIO if required, e.g. because they are on different
+     * file systems. Both kinds of copies can be undone. If \a selectCopies
+     * is true, the copies are selected afterwards.
+     * @return The started job, or nullptr if the items must be copied by
+     *         KIO, because they are not local.
+     */
+    KJob* startLocalCopyJob(const QList<QUrl>& sources, const QUrl& destination, bool selectCopies);
+
     /**
      * Returns a list of URLs for all selected items. The list is
      * simplified, so that when the URLs are part of different tree
@@ -835,6 +962,30 @@ private:
 
     void updatePlaceholderLabel();
 
+    /**
+     * @return Estimated number of items that fill the visible area of the view.
+     */
+    int visibleItemCountHint() const;
+
+    /**
+     * Prefetches the folder \a url, so that it can be opened at once, and
+     * cancels prefetching the previous folder. An empty URL only cancels
+     * the prefetching.
+     */
+    void prefetchFolder(const QUrl& url);
+
+    /**
+     * Records the statistics of the loaded directory in its
+     * DirectoryLoadProfile.
+     */
+    void recordLoadProfile();
+
+    /**
+     * Resolves only the visible items if the view is inactive or the
+     * profile of the directory suggests it.
+     */
+    void updateResolvingPriority();
+
 private:
     void updatePalette();
 
@@ -845,6 +996,9 @@ private:
     bool m_dragging; // True if a dragging is done. Required to be able to decide whether a
                      // tooltip may be shown when hovering an item.
     bool m_loading;
+    bool m_loadingDeferred;
+    bool m_deferredLoadingPending; // True if loadDirectory() has been invoked while the loading is deferred
+    bool m_inBackground;
 
     QUrl m_url;
     QString m_viewPropertiesContext;
@@ -853,6 +1007,23 @@ private:
 
     QPointer<KIO::StatJob> m_statJobForStatusBarText;
 
+    // Work that refers to m_url, which is dropped if another URL is shown
+    JobScope* m_urlJobScope;
+
+    // Statistics of the loaded directory m_loadProfileUrl, which are
+    // recorded when another directory is loaded, see recordLoadProfile()
+    QUrl m_loadProfileUrl;
+    DirectoryLoadProfile m_loadProfile;
+    QElapsedTimer m_listingTimer;
+    int m_listingTime;
+
+    // Summary of all items and the result of the last stat job for the status
+    // bar text. Both get invalidated if the items of the model change.
+    KFileItemSelection m_allItems;
+    bool m_rootStatValid;
+    bool m_hasRootRecursiveSize;
+    KIO::filesize_t m_rootRecursiveSize;
+
     QVBoxLayout* m_topLayout;
 
     KFileItemModel* m_model;
@@ -862,6 +1033,9 @@ private:
     ToolTipManager* m_toolTipManager;
 
     QTimer* m_selectionChangedTimer;
+    mutable KFileItemSelection m_selection;
+    mutable KFileItemListProperties* m_selectedItemsProperties; // Is valid for m_selectedItemsPropertiesIndexes
+    mutable KItemSet m_selectedItemsPropertiesIndexes;
 
     QUrl m_currentItemUrl; // Used for making the view to remember the current URL after F5
     bool m_scrollToCurrentItem; // Used for marking we need to scroll to current item or not
@@ -875,6 +1049,8 @@ private:
 
     QTimer* m_twoClicksRenamingTimer;
     QUrl m_twoClicksRenamingItemUrl;
+    QTimer* m_interactionTimer; // Ends the deferring of resortings, see deferResortingWhileInteracting()
+    QUrl m_prefetchedUrl; // Folder that is prefetched because it is hovered or current
     QLabel* m_placeholderLabel;
 
     // For unit tests
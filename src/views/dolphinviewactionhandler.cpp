@@ -62,6 +62,8 @@ void DolphinViewActionHandler::setCurrentView(DolphinView* view)
             this, &DolphinViewActionHandler::slotGroupedSortingChanged);
     connect(view, &DolphinView::hiddenFilesShownChanged,
             this, &DolphinViewActionHandler::slotHiddenFilesShownChanged);
+    connect(view, &DolphinView::recursiveListingChanged,
+            this, &DolphinViewActionHandler::slotRecursiveListingChanged);
     connect(view, &DolphinView::sortRoleChanged,
             this, &DolphinViewActionHandler::slotSortRoleChanged);
     connect(view, &DolphinView::zoomLevelChanged,
@@ -288,6 +290,17 @@ void DolphinViewActionHandler::createActions()
     m_actionCollection->setDefaultShortcuts(showHiddenFiles, KStandardShortcut::showHideHiddenFiles());
     connect(showHiddenFiles, &KToggleAction::triggered, this, &DolphinViewActionHandler::toggleShowHiddenFiles);
 
+    KToggleAction* showRecursive = m_actionCollection->add<KToggleAction>(QStringLiteral("show_recursive"));
+    showRecursive->setIcon(QIcon::fromTheme(QStringLiteral("view-list-tree")));
+    showRecursive->setText(i18nc("@action:inmenu View", "Show Files in Subfolders"));
+    showRecursive->setWhatsThis(xi18nc("@info:whatsthis", "<para>When "
+        "this is enabled the files of all subfolders are shown together with "
+        "the files of the current folder as one list, which can be sorted and "
+        "filtered like the files of a single folder.</para>"
+        "<para>Showing the <emphasis>Path</emphasis> in the details view "
+        "tells the subfolders of the files apart.</para>"));
+    connect(showRecursive, &KToggleAction::triggered, this, &DolphinViewActionHandler::toggleRecursiveListing);
+
     QAction* adjustViewProps = m_actionCollection->addAction(QStringLiteral("view_properties"));
     adjustViewProps->setText(i18nc("@action:inmenu View", "Adjust View Display Style..."));
     adjustViewProps->setIcon(QIcon::fromTheme(QStringLiteral("view-choose")));
@@ -457,6 +470,7 @@ void DolphinViewActionHandler::updateViewActions()
 
     // Updates the "show_hidden_files" action state and icon
     slotHiddenFilesShownChanged(m_currentView->hiddenFilesShown());
+    slotRecursiveListingChanged(m_currentView->recursiveListing());
 }
 
 void DolphinViewActionHandler::zoomIn()
@@ -559,6 +573,18 @@ void DolphinViewActionHandler::slotHiddenFilesShownChanged(bool shown)
     showHiddenFilesAction->setChecked(shown);
 }
 
+void DolphinViewActionHandler::toggleRecursiveListing(bool show)
+{
+    Q_EMIT actionBeingHandled();
+    m_currentView->setRecursiveListing(show);
+}
+
+void DolphinViewActionHandler::slotRecursiveListingChanged(bool enabled)
+{
+    QAction* showRecursiveAction = m_actionCollection->action(QStringLiteral("show_recursive"));
+    showRecursiveAction->setChecked(enabled);
+}
+
 void DolphinViewActionHandler::slotWriteStateChanged(bool isFolderWritable)
 {
     m_actionCollection->action(QStringLiteral("create_dir"))->setEnabled(isFolderWritable &&
@@ -182,6 +182,17 @@ private Q_SLOTS:
      */
     void slotHiddenFilesShownChanged(bool shown);
 
+    /**
+     * Switches between showing the files of the current folder
+     * and showing the files of all subfolders too.
+     */
+    void toggleRecursiveListing(bool show);
+
+    /**
+     * Updates the state of the 'Show Files in Subfolders' menu action.
+     */
+    void slotRecursiveListingChanged(bool enabled);
+
     /**
      * Updates the state of the 'Create Folder...' action.
      */
@@ -16,19 +16,35 @@
 #include <QMimeData>
 
 QHash<QUrl, bool> DragAndDropHelper::m_urlListMatchesUrlCache;
+const QMimeData* DragAndDropHelper::m_draggedMimeData = nullptr;
+QSet<QUrl> DragAndDropHelper::m_draggedUrls;
 
 bool DragAndDropHelper::urlListMatchesUrl(const QList<QUrl>& urls, const QUrl& destUrl)
 {
+    return std::find_if(urls.constBegin(), urls.constEnd(), [destUrl](const QUrl& url) {
+        return url.matches(destUrl, QUrl::StripTrailingSlash);
+    }) != urls.constEnd();
+}
+
+bool DragAndDropHelper::mimeDataMatchesUrl(const QMimeData* mimeData, const QUrl& destUrl)
+{
+    if (mimeData != m_draggedMimeData) {
+        clearUrlListMatchesUrlCache();
+        m_draggedMimeData = mimeData;
+
+        const QList<QUrl> urls = mimeData->urls();
+        m_draggedUrls.reserve(urls.count());
+        for (const QUrl& url : urls) {
+            m_draggedUrls.insert(url.adjusted(QUrl::StripTrailingSlash));
+        }
+    }
+
     auto iteratorResult = m_urlListMatchesUrlCache.constFind(destUrl);
     if (iteratorResult != m_urlListMatchesUrlCache.constEnd()) {
         return *iteratorResult;
     }
 
-    const bool destUrlMatches =
-        std::find_if(urls.constBegin(), urls.constEnd(), [destUrl](const QUrl& url) {
-            return url.matches(destUrl, QUrl::StripTrailingSlash);
-        }) != urls.constEnd();
-
+    const bool destUrlMatches = !destUrl.isEmpty() && m_draggedUrls.contains(destUrl.adjusted(QUrl::StripTrailingSlash));
     return *m_urlListMatchesUrlCache.insert(destUrl, destUrlMatches);
 }
 
@@ -61,5 +77,7 @@ KIO::DropJob* DragAndDropHelper::dropUrls(const QUrl& destUrl, QDropEvent* event
 void DragAndDropHelper::clearUrlListMatchesUrlCache()
 {
     DragAndDropHelper::m_urlListMatchesUrlCache.clear();
+    DragAndDropHelper::m_draggedMimeData = nullptr;
+    DragAndDropHelper::m_draggedUrls.clear();
 }
 
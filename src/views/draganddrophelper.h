@@ -10,10 +10,13 @@
 
 #include "dolphin_export.h"
 
+#include <QHash>
 #include <QList>
+#include <QSet>
 #include <QUrl>
 
 class QDropEvent;
+class QMimeData;
 class QWidget;
 namespace KIO { class DropJob; }
 
@@ -43,14 +46,29 @@ public:
     static bool urlListMatchesUrl(const QList<QUrl>& urls, const QUrl& destUrl);
 
     /**
-     * clear the internal cache.
+     * @return True if destUrl is contained in the URLs of \a mimeData.
+     *
+     * Is used while a drag is moved: The URLs of the drag are decoded and
+     * hashed once, and the result is cached for each destUrl, so that the
+     * check does not depend on the number of dragged URLs.
+     */
+    static bool mimeDataMatchesUrl(const QMimeData* mimeData, const QUrl& destUrl);
+
+    /**
+     * clear the internal cache. Must be called when a new drag enters.
      */
     static void clearUrlListMatchesUrlCache();
 private:
     /**
-     * Stores the results of the expensive checks made in urlListMatchesUrl.
+     * Stores the results of the expensive checks made in mimeDataMatchesUrl.
      */
     static QHash<QUrl, bool> m_urlListMatchesUrlCache;
+
+    /**
+     * The URLs of the drag without trailing slashes.
+     */
+    static const QMimeData* m_draggedMimeData;
+    static QSet<QUrl> m_draggedUrls;
 };
 
 #endif
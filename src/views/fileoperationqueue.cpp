@@ -0,0 +1,242 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "fileoperationqueue.h"
+
+#include "dolphin_generalsettings.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QStorageInfo>
+#include <QtConcurrentRun>
+
+FileOperationQueue& FileOperationQueue::instance()
+{
+    static FileOperationQueue result;
+    return result;
+}
+
+FileOperationQueue::FileOperationQueue() :
+    QObject(),
+    m_operations(),
+    m_maximumConcurrentOperations(GeneralSettings::concurrentFileOperationsPerDevice()),
+    m_nextId(1)
+{
+}
+
+FileOperationQueue::~FileOperationQueue()
+{
+}
+
+int FileOperationQueue::enqueue(const QString& description, const QUrl& destination, const std::function<KJob*()>& createJob)
+{
+    Operation operation;
+    operation.id = m_nextId++;
+    operation.description = description;
+    operation.destination = destination;
+    operation.createJob = createJob;
+
+    if (destination.isLocalFile()) {
+        const int id = operation.id;
+        auto watcher = new QFutureWatcher<QString>(this);
+        connect(watcher, &QFutureWatcher<QString>::finished, this, [this, watcher, id]() {
+            setDevice(id, watcher->result());
+            watcher->deleteLater();
+        });
+        watcher->setFuture(QtConcurrent::run(&FileOperationQueue::deviceForUrl, destination));
+    } else {
+        operation.device = deviceForUrl(destination);
+    }
+    m_operations.append(operation);
+
+    startOperations();
+    Q_EMIT operationsChanged();
+    return operation.id;
+}
+
+void FileOperationQueue::setMaximumConcurrentOperations(int count)
+{
+    if (count != m_maximumConcurrentOperations) {
+        m_maximumConcurrentOperations = qMax(0, count);
+        startOperations();
+        Q_EMIT operationsChanged();
+    }
+}
+
+int FileOperationQueue::maximumConcurrentOperations() const
+{
+    return m_maximumConcurrentOperations;
+}
+
+QVector<FileOperationQueue::Operation> FileOperationQueue::operations() const
+{
+    return m_operations;
+}
+
+void FileOperationQueue::pause(int id)
+{
+    const int index = indexOf(id);
+    if (index < 0 || m_operations[index].state == State::Paused) {
+        return;
+    }
+
+    Operation& operation = m_operations[index];
+    if (operation.job) {
+        operation.job->suspend();
+    }
+    operation.state = State::Paused;
+
+    // Other operations may write to the device now
+    startOperations();
+    Q_EMIT operationsChanged();
+}
+
+void FileOperationQueue::resume(int id)
+{
+    const int index = indexOf(id);
+    if (index < 0 || m_operations[index].state != State::Paused) {
+        return;
+    }
+
+    // The suspended job is resumed by startOperations() as soon as
+    // the device is available
+    m_operations[index].state = State::Queued;
+    startOperations();
+    Q_EMIT operationsChanged();
+}
+
+void FileOperationQueue::cancel(int id)
+{
+    const int index = indexOf(id);
+    if (index < 0) {
+        return;
+    }
+
+    const QPointer<KJob> job = m_operations[index].job;
+    m_operations.remove(index);
+    if (job) {
+        job->kill();
+    }
+
+    startOperations();
+    Q_EMIT operationsChanged();
+}
+
+void FileOperationQueue::moveUp(int id)
+{
+    const int index = indexOf(id);
+    if (index > 0) {
+        std::swap(m_operations[index], m_operations[index - 1]);
+        startOperations();
+        Q_EMIT operationsChanged();
+    }
+}
+
+void FileOperationQueue::moveDown(int id)
+{
+    const int index = indexOf(id);
+    if (index >= 0 && index < m_operations.count() - 1) {
+        std::swap(m_operations[index], m_operations[index + 1]);
+        startOperations();
+        Q_EMIT operationsChanged();
+    }
+}
+
+QString FileOperationQueue::deviceForUrl(const QUrl& url)
+{
+    if (!url.isLocalFile()) {
+        return url.adjusted(QUrl::RemovePath | QUrl::RemoveQuery | QUrl::RemoveFragment | QUrl::RemoveUserInfo).toString();
+    }
+
+    // The destination might not exist yet, in this case the
+    // device of the nearest existing parent is used.
+    QString path = url.toLocalFile();
+    QStorageInfo storage(path);
+    while (!storage.isValid() && !QDir(path).isRoot() && !path.isEmpty()) {
+        path = QFileInfo(path).absolutePath();
+        storage.setPath(path);
+    }
+
+    // The root path identifies the file system, while the device
+    // is not unique e.g. for tmpfs.
+    return QLatin1String("file:") + storage.rootPath();
+}
+
+void FileOperationQueue::slotJobFinished(KJob* job)
+{
+    for (int i = 0; i < m_operations.count(); ++i) {
+        if (m_operations.at(i).job == job) {
+            m_operations.remove(i);
+            startOperations();
+            Q_EMIT operationsChanged();
+            return;
+        }
+    }
+}
+
+int FileOperationQueue::indexOf(int id) const
+{
+    for (int i = 0; i < m_operations.count(); ++i) {
+        if (m_operations.at(i).id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void FileOperationQueue::setDevice(int id, const QString& device)
+{
+    // The operation might have been canceled in the meantime
+    const int index = indexOf(id);
+    if (index >= 0) {
+        m_operations[index].device = device;
+        startOperations();
+        Q_EMIT operationsChanged();
+    }
+}
+
+void FileOperationQueue::startOperations()
+{
+    QHash<QString, int> runningOperations;
+    for (const Operation& operation : qAsConst(m_operations)) {
+        if (operation.state == State::Running) {
+            ++runningOperations[operation.device];
+        }
+    }
+
+    int i = 0;
+    while (i < m_operations.count()) {
+        Operation& operation = m_operations[i];
+        if (operation.state != State::Queued || operation.device.isEmpty()
+            || (m_maximumConcurrentOperations > 0 && runningOperations.value(operation.device) >= m_maximumConcurrentOperations)) {
+            ++i;
+            continue;
+        }
+
+        if (operation.job) {
+            // The job has been paused and resumed while the device was busy
+            operation.job->resume();
+            operation.state = State::Running;
+            ++runningOperations[operation.device];
+            ++i;
+            continue;
+        }
+
+        KJob* job = operation.createJob();
+        if (!job) {
+            m_operations.remove(i);
+            continue;
+        }
+
+        operation.job = job;
+        operation.state = State::Running;
+        ++runningOperations[operation.device];
+        connect(job, &KJob::finished, this, &FileOperationQueue::slotJobFinished);
+        ++i;
+    }
+}
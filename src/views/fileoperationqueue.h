@@ -0,0 +1,145 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef FILEOPERATIONQUEUE_H
+#define FILEOPERATIONQUEUE_H
+
+#include "dolphin_export.h"
+
+#include <KJob>
+
+#include <QObject>
+#include <QPointer>
+#include <QUrl>
+#include <QVector>
+
+#include <functional>
+
+/**
+ * @brief Serializes the file operations that write to the same device.
+ *
+ * Several copy operations to the same USB disk or network share compete
+ * with each other and lower the total throughput. Each operation is
+ * enqueued with its destination and a function that creates the job. The
+ * job is created as soon as fewer than maximumConcurrentOperations()
+ * operations write to the device of the destination, so operations on
+ * different devices still run concurrently.
+ *
+ * The queued and running operations can be paused, canceled and
+ * reordered. The progress and the speed of the running jobs are
+ * provided for showing the remaining time.
+ */
+class DOLPHIN_EXPORT FileOperationQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class State {
+        Queued,
+        Running,
+        Paused
+    };
+
+    struct Operation
+    {
+        int id = 0;
+        QString description;
+        QUrl destination;
+        /** Is empty while the device of a local destination is determined. */
+        QString device;
+        State state = State::Queued;
+        QPointer<KJob> job;
+        std::function<KJob*()> createJob;
+    };
+
+    // delete copy and move constructors and assign operators
+    FileOperationQueue(FileOperationQueue const&) = delete;
+    FileOperationQueue(FileOperationQueue&&) = delete;
+    FileOperationQueue& operator=(FileOperationQueue const&) = delete;
+    FileOperationQueue& operator=(FileOperationQueue &&) = delete;
+
+    static FileOperationQueue& instance();
+
+    /**
+     * Enqueues an operation that writes to \a destination. \a createJob
+     * creates and returns the job, or returns nullptr if the operation is
+     * not possible anymore. If fewer than maximumConcurrentOperations()
+     * operations write to the device of \a destination, the job is created
+     * at once. The device of a local destination is determined in a worker
+     * thread, as the file system might not respond, so in this case the
+     * job is created asynchronously.
+     * @return Identifier of the operation.
+     */
+    int enqueue(const QString& description, const QUrl& destination, const std::function<KJob*()>& createJob);
+
+    /**
+     * Sets the number of operations that may write to one device at
+     * the same time. 0 means that the number is not limited.
+     */
+    void setMaximumConcurrentOperations(int count);
+    int maximumConcurrentOperations() const;
+
+    /**
+     * @return All queued and running operations in the order in which
+     *         they are started.
+     */
+    QVector<Operation> operations() const;
+
+    /**
+     * Pauses the operation \a id. A paused operation that is running
+     * does not prevent other operations on the device from starting.
+     * Resuming it queues the operation again, so its job continues only
+     * if the number of operations on the device allows it.
+     */
+    void pause(int id);
+    void resume(int id);
+    void cancel(int id);
+
+    /**
+     * Moves the operation \a id by one position towards the begin
+     * or the end of the queue.
+     */
+    void moveUp(int id);
+    void moveDown(int id);
+
+    /**
+     * @return Identifier of the device that contains \a url. Remote URLs
+     *         are identified by their authority. As QStorageInfo is used
+     *         for local URLs, the function might block.
+     */
+    static QString deviceForUrl(const QUrl& url);
+
+Q_SIGNALS:
+    /** Is emitted if an operation has been added, removed, started, paused or moved. */
+    void operationsChanged();
+
+private Q_SLOTS:
+    void slotJobFinished(KJob* job);
+
+private:
+    FileOperationQueue();
+    ~FileOperationQueue() override;
+
+    int indexOf(int id) const;
+
+    /**
+     * Sets the determined \a device of the operation \a id and
+     * starts it if possible.
+     */
+    void setDevice(int id, const QString& device);
+
+    /**
+     * Starts the queued operations that are allowed to write to their device.
+     */
+    void startOperations();
+
+private:
+    QVector<Operation> m_operations;
+    int m_maximumConcurrentOperations;
+    int m_nextId;
+};
+
+#endif
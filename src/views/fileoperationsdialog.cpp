@@ -0,0 +1,267 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "fileoperationsdialog.h"
+
+#include "dolphin_generalsettings.h"
+#include "fileoperationqueue.h"
+
+#include <KGuiItem>
+#include <KIO/Global>
+#include <KLocalizedString>
+#include <KStandardGuiItem>
+
+#include <QDialogButtonBox>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QIcon>
+#include <QLabel>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+namespace {
+    enum Column {
+        DescriptionColumn,
+        DestinationColumn,
+        StateColumn,
+        SpeedColumn,
+        RemainingTimeColumn
+    };
+
+    const int ProgressUpdateInterval = 1000;
+}
+
+FileOperationsDialog::FileOperationsDialog(QWidget* parent) :
+    QDialog(parent),
+    m_operationsWidget(nullptr),
+    m_pauseButton(nullptr),
+    m_moveUpButton(nullptr),
+    m_moveDownButton(nullptr),
+    m_cancelButton(nullptr),
+    m_concurrentOperationsBox(nullptr),
+    m_progressTimer(nullptr),
+    m_elapsedTimer(),
+    m_processedBytes()
+{
+    setWindowTitle(i18nc("@title:window", "File Operations"));
+    setMinimumSize(650, 300);
+
+    auto layout = new QVBoxLayout(this);
+
+    m_operationsWidget = new QTreeWidget(this);
+    m_operationsWidget->setHeaderLabels({i18nc("@title:column", "Operation"),
+                                         i18nc("@title:column", "Destination"),
+                                         i18nc("@title:column", "State"),
+                                         i18nc("@title:column", "Speed"),
+                                         i18nc("@title:column", "Remaining Time")});
+    m_operationsWidget->setRootIsDecorated(false);
+    m_operationsWidget->header()->setSectionResizeMode(DescriptionColumn, QHeaderView::Stretch);
+    connect(m_operationsWidget, &QTreeWidget::itemSelectionChanged, this, &FileOperationsDialog::updateButtons);
+
+    auto buttonsLayout = new QVBoxLayout();
+    m_pauseButton = new QPushButton(this);
+    connect(m_pauseButton, &QPushButton::clicked, this, &FileOperationsDialog::togglePaused);
+    m_moveUpButton = new QPushButton(QIcon::fromTheme(QStringLiteral("go-up")), i18nc("@action:button", "Move Up"), this);
+    connect(m_moveUpButton, &QPushButton::clicked, this, &FileOperationsDialog::moveUp);
+    m_moveDownButton = new QPushButton(QIcon::fromTheme(QStringLiteral("go-down")), i18nc("@action:button", "Move Down"), this);
+    connect(m_moveDownButton, &QPushButton::clicked, this, &FileOperationsDialog::moveDown);
+    m_cancelButton = new QPushButton(QIcon::fromTheme(QStringLiteral("process-stop")), i18nc("@action:button", "Cancel Operation"), this);
+    connect(m_cancelButton, &QPushButton::clicked, this, &FileOperationsDialog::cancelOperation);
+    buttonsLayout->addWidget(m_pauseButton);
+    buttonsLayout->addWidget(m_moveUpButton);
+    buttonsLayout->addWidget(m_moveDownButton);
+    buttonsLayout->addWidget(m_cancelButton);
+    buttonsLayout->addStretch();
+
+    auto operationsLayout = new QHBoxLayout();
+    operationsLayout->addWidget(m_operationsWidget);
+    operationsLayout->addLayout(buttonsLayout);
+    layout->addLayout(operationsLayout);
+
+    auto concurrentOperationsLayout = new QHBoxLayout();
+    auto concurrentOperationsLabel = new QLabel(i18nc("@label:spinbox", "Operations per device at the same time:"), this);
+    m_concurrentOperationsBox = new QSpinBox(this);
+    m_concurrentOperationsBox->setMinimum(0);
+    m_concurrentOperationsBox->setMaximum(99);
+    m_concurrentOperationsBox->setSpecialValueText(i18nc("@item:inlistbox Number of operations", "Unlimited"));
+    m_concurrentOperationsBox->setValue(FileOperationQueue::instance().maximumConcurrentOperations());
+    concurrentOperationsLabel->setBuddy(m_concurrentOperationsBox);
+    connect(m_concurrentOperationsBox, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &FileOperationsDialog::slotConcurrentOperationsChanged);
+    concurrentOperationsLayout->addWidget(concurrentOperationsLabel);
+    concurrentOperationsLayout->addWidget(m_concurrentOperationsBox);
+    concurrentOperationsLayout->addStretch();
+    layout->addLayout(concurrentOperationsLayout);
+
+    auto buttonBox = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    KGuiItem::assign(buttonBox->button(QDialogButtonBox::Close), KStandardGuiItem::close());
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &FileOperationsDialog::reject);
+    layout->addWidget(buttonBox);
+
+    connect(&FileOperationQueue::instance(), &FileOperationQueue::operationsChanged,
+            this, &FileOperationsDialog::updateOperations);
+
+    m_progressTimer = new QTimer(this);
+    m_progressTimer->setInterval(ProgressUpdateInterval);
+    connect(m_progressTimer, &QTimer::timeout, this, &FileOperationsDialog::updateProgress);
+    m_progressTimer->start();
+    m_elapsedTimer.start();
+
+    updateOperations();
+}
+
+FileOperationsDialog::~FileOperationsDialog()
+{
+}
+
+void FileOperationsDialog::updateOperations()
+{
+    const int selectedId = selectedOperation();
+
+    m_operationsWidget->clear();
+    const QVector<FileOperationQueue::Operation> operations = FileOperationQueue::instance().operations();
+    for (const FileOperationQueue::Operation& operation : operations) {
+        auto item = new QTreeWidgetItem(m_operationsWidget);
+        item->setData(DescriptionColumn, Qt::UserRole, operation.id);
+        item->setText(DescriptionColumn, operation.description);
+        item->setText(DestinationColumn, operation.destination.toDisplayString(QUrl::PreferLocalFile));
+    }
+
+    selectOperation(selectedId);
+    updateProgress();
+    updateButtons();
+}
+
+void FileOperationsDialog::updateProgress()
+{
+    const QVector<FileOperationQueue::Operation> operations = FileOperationQueue::instance().operations();
+    const qint64 elapsedTime = qMax(qint64(1), m_elapsedTimer.restart());
+    QHash<int, qulonglong> processedBytes;
+
+    for (int i = 0; i < m_operationsWidget->topLevelItemCount() && i < operations.count(); ++i) {
+        QTreeWidgetItem* item = m_operationsWidget->topLevelItem(i);
+        const FileOperationQueue::Operation& operation = operations.at(i);
+
+        QString state;
+        QString speed;
+        QString remainingTime;
+        switch (operation.state) {
+        case FileOperationQueue::State::Queued:
+            state = i18nc("@item:intable State of a file operation", "Queued");
+            break;
+        case FileOperationQueue::State::Paused:
+            state = i18nc("@item:intable State of a file operation", "Paused");
+            break;
+        case FileOperationQueue::State::Running:
+            state = i18nc("@item:intable State of a file operation", "Running");
+            break;
+        }
+
+        if (operation.job) {
+            const qulonglong processed = operation.job->processedAmount(KJob::Bytes);
+            const qulonglong total = operation.job->totalAmount(KJob::Bytes);
+            if (operation.state == FileOperationQueue::State::Running) {
+                state = i18nc("@item:intable State of a file operation", "Running (%1%)", operation.job->percent());
+
+                const auto it = m_processedBytes.constFind(operation.id);
+                if (it != m_processedBytes.constEnd() && processed >= it.value()) {
+                    const qulonglong bytesPerSecond = (processed - it.value()) * 1000 / elapsedTime;
+                    speed = i18nc("@item:intable Transfer speed", "%1/s", KIO::convertSize(bytesPerSecond));
+                    if (bytesPerSecond > 0 && total > processed) {
+                        remainingTime = KIO::convertSeconds((total - processed) / bytesPerSecond);
+                    }
+                }
+            }
+            processedBytes.insert(operation.id, processed);
+        }
+
+        item->setText(StateColumn, state);
+        item->setText(SpeedColumn, speed);
+        item->setText(RemainingTimeColumn, remainingTime);
+    }
+
+    m_processedBytes = processedBytes;
+}
+
+void FileOperationsDialog::updateButtons()
+{
+    const QVector<FileOperationQueue::Operation> operations = FileOperationQueue::instance().operations();
+    const int id = selectedOperation();
+    int index = -1;
+    for (int i = 0; i < operations.count(); ++i) {
+        if (operations.at(i).id == id) {
+            index = i;
+            break;
+        }
+    }
+
+    const bool paused = index >= 0 && operations.at(index).state == FileOperationQueue::State::Paused;
+    m_pauseButton->setText(paused ? i18nc("@action:button", "Resume") : i18nc("@action:button", "Pause"));
+    m_pauseButton->setIcon(QIcon::fromTheme(paused ? QStringLiteral("media-playback-start")
+                                                   : QStringLiteral("media-playback-pause")));
+    m_pauseButton->setEnabled(index >= 0);
+    m_moveUpButton->setEnabled(index > 0);
+    m_moveDownButton->setEnabled(index >= 0 && index < operations.count() - 1);
+    m_cancelButton->setEnabled(index >= 0);
+}
+
+void FileOperationsDialog::togglePaused()
+{
+    const int id = selectedOperation();
+    const QVector<FileOperationQueue::Operation> operations = FileOperationQueue::instance().operations();
+    for (const FileOperationQueue::Operation& operation : operations) {
+        if (operation.id == id) {
+            if (operation.state == FileOperationQueue::State::Paused) {
+                FileOperationQueue::instance().resume(id);
+            } else {
+                FileOperationQueue::instance().pause(id);
+            }
+            return;
+        }
+    }
+}
+
+void FileOperationsDialog::moveUp()
+{
+    FileOperationQueue::instance().moveUp(selectedOperation());
+}
+
+void FileOperationsDialog::moveDown()
+{
+    FileOperationQueue::instance().moveDown(selectedOperation());
+}
+
+void FileOperationsDialog::cancelOperation()
+{
+    FileOperationQueue::instance().cancel(selectedOperation());
+}
+
+void FileOperationsDialog::slotConcurrentOperationsChanged(int count)
+{
+    GeneralSettings::setConcurrentFileOperationsPerDevice(count);
+    GeneralSettings::self()->save();
+    FileOperationQueue::instance().setMaximumConcurrentOperations(count);
+}
+
+int FileOperationsDialog::selectedOperation() const
+{
+    const QList<QTreeWidgetItem*> items = m_operationsWidget->selectedItems();
+    return items.isEmpty() ? 0 : items.first()->data(DescriptionColumn, Qt::UserRole).toInt();
+}
+
+void FileOperationsDialog::selectOperation(int id)
+{
+    for (int i = 0; i < m_operationsWidget->topLevelItemCount(); ++i) {
+        QTreeWidgetItem* item = m_operationsWidget->topLevelItem(i);
+        if (item->data(DescriptionColumn, Qt::UserRole).toInt() == id) {
+            m_operationsWidget->setCurrentItem(item);
+            return;
+        }
+    }
+}
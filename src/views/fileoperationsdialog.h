@@ -0,0 +1,72 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef FILEOPERATIONSDIALOG_H
+#define FILEOPERATIONSDIALOG_H
+
+#include "dolphin_export.h"
+
+#include <QDialog>
+#include <QElapsedTimer>
+#include <QHash>
+
+class QPushButton;
+class QSpinBox;
+class QTimer;
+class QTreeWidget;
+
+/**
+ * @brief Shows the copy and move operations of FileOperationQueue.
+ *
+ * The throughput and the remaining time of the running operations are
+ * updated each second. The operations can be paused, canceled and
+ * reordered, and the number of operations that may write to the same
+ * device at the same time can be changed.
+ */
+class DOLPHIN_EXPORT FileOperationsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit FileOperationsDialog(QWidget* parent = nullptr);
+    ~FileOperationsDialog() override;
+
+private Q_SLOTS:
+    /** Recreates the rows for all operations of the queue. */
+    void updateOperations();
+
+    /** Updates the throughput and the remaining time of the running operations. */
+    void updateProgress();
+
+    void updateButtons();
+    void togglePaused();
+    void moveUp();
+    void moveDown();
+    void cancelOperation();
+    void slotConcurrentOperationsChanged(int count);
+
+private:
+    /**
+     * @return Identifier of the selected operation or 0.
+     */
+    int selectedOperation() const;
+    void selectOperation(int id);
+
+private:
+    QTreeWidget* m_operationsWidget;
+    QPushButton* m_pauseButton;
+    QPushButton* m_moveUpButton;
+    QPushButton* m_moveDownButton;
+    QPushButton* m_cancelButton;
+    QSpinBox* m_concurrentOperationsBox;
+    QTimer* m_progressTimer;
+    QElapsedTimer m_elapsedTimer;
+
+    // Processed bytes of the running operations at the last update
+    QHash<int, qulonglong> m_processedBytes;
+};
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "jobscope.h"
+
+#include <algorithm>
+
+JobScope::JobScope(QObject* parent) :
+    QObject(parent),
+    m_context(nullptr),
+    m_jobs()
+{
+    m_context = new QObject(this);
+}
+
+JobScope::~JobScope()
+{
+    cancel();
+}
+
+QObject* JobScope::context() const
+{
+    return m_context;
+}
+
+void JobScope::cancel()
+{
+    // The list is taken before killing the jobs, as the
+    // result handlers might add new jobs to the scope
+    const QVector<QPointer<KJob>> jobs = m_jobs;
+    m_jobs.clear();
+    for (const QPointer<KJob>& job : jobs) {
+        if (job && !job->isFinished()) {
+            job->kill(KJob::Quietly);
+        }
+    }
+
+    // Deleting the context disconnects all connections that use it
+    delete m_context;
+    m_context = new QObject(this);
+}
+
+int JobScope::pendingCount() const
+{
+    return std::count_if(m_jobs.cbegin(), m_jobs.cend(), [](const QPointer<KJob>& job) {
+        return job && !job->isFinished();
+    });
+}
+
+void JobScope::addJob(KJob* job)
+{
+    if (!job) {
+        return;
+    }
+
+    // Finished jobs delete themselves, so the list only
+    // grows by the jobs of the current state
+    m_jobs.erase(std::remove_if(m_jobs.begin(), m_jobs.end(), [](const QPointer<KJob>& job) {
+        return job.isNull() || job->isFinished();
+    }), m_jobs.end());
+    m_jobs.append(job);
+}
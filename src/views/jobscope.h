@@ -0,0 +1,85 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef JOBSCOPE_H
+#define JOBSCOPE_H
+
+#include "dolphin_export.h"
+
+#include <KJob>
+
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+
+/**
+ * @brief Groups the asynchronous work that refers to the same state, e.g. to the URL of a view.
+ *
+ * Jobs that are added to the scope are killed quietly when the scope
+ * is canceled. Connections that use context() as context object are
+ * disconnected as well, so that no handler is invoked for work that
+ * has been superseded.
+ *
+ * The scope is canceled when it is destroyed, so work whose result
+ * refers to another object can be bound to the lifetime of the object.
+ * A scope can be used again after it has been canceled.
+ *
+ * Example:
+ * \code
+ * KIO::StatJob* job = m_urlScope->add(KIO::statDetails(url));
+ * connect(job, &KJob::result, m_urlScope->context(), [this](KJob* job) { ... });
+ * \endcode
+ */
+class DOLPHIN_EXPORT JobScope : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit JobScope(QObject* parent = nullptr);
+    ~JobScope() override;
+
+    /**
+     * Adds \a job to the scope. The job is killed if the scope is
+     * canceled before the job has been finished.
+     * @return \a job, which allows to add a job where it is created.
+     */
+    template<class Job>
+    Job* add(Job* job);
+
+    /**
+     * @return Context object for connections that must not be invoked
+     *         after the scope has been canceled. Each cancellation
+     *         replaces the context object.
+     */
+    QObject* context() const;
+
+    /**
+     * Kills the jobs and disconnects the connections that use context().
+     */
+    void cancel();
+
+    /**
+     * @return Number of added jobs that have not been finished
+     *         or killed yet.
+     */
+    int pendingCount() const;
+
+private:
+    void addJob(KJob* job);
+
+private:
+    QObject* m_context;
+    QVector<QPointer<KJob>> m_jobs;
+};
+
+template<class Job>
+Job* JobScope::add(Job* job)
+{
+    addJob(job);
+    return job;
+}
+
+#endif
@@ -0,0 +1,618 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "localcopyjob.h"
+
+#include "kitemviews/private/ktaskscheduler.h"
+#include "views/localfileoperations.h"
+
+#include <KFileUtils>
+#include <KIO/CopyJob>
+#include <KIO/JobTracker>
+#include <KJobTrackerInterface>
+#include <KLocalizedString>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QTimer>
+
+#include <atomic>
+#include <functional>
+
+#ifndef Q_OS_WIN
+#include <qplatformdefs.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef Q_OS_LINUX
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/xattr.h>
+#endif
+#endif
+
+struct LocalCopyJob::State
+{
+    std::atomic<bool> canceled{false};
+    std::atomic<qulonglong> totalBytes{0};
+    std::atomic<qulonglong> processedBytes{0};
+    std::atomic<qulonglong> processedFiles{0};
+    std::atomic<int> strategies{0};
+};
+
+namespace {
+    const int ProgressUpdateInterval = 200;
+
+    // Number of bytes that are copied at once if the data must be read
+    // and written, or copied by copy_file_range()
+    const size_t ChunkSize = 1024 * 1024;
+
+    /**
+     * @return Number of bytes of all files in \a path, including the
+     *         files of subdirectories.
+     */
+    qulonglong itemSize(const QString& path)
+    {
+        const QFileInfo info(path);
+        if (info.isSymLink()) {
+            return 0;
+        }
+        if (!info.isDir()) {
+            return info.size();
+        }
+
+        qulonglong size = 0;
+        const QStringList entries = QDir(path).entryList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+        for (const QString& entry : entries) {
+            size += itemSize(path + QLatin1Char('/') + entry);
+        }
+        return size;
+    }
+
+    /**
+     * @return True if an item exists at \a path, which may also
+     *         be a broken symbolic link.
+     */
+    bool isExistingItem(const QString& path)
+    {
+        const QFileInfo info(path);
+        return info.exists() || info.isSymLink();
+    }
+
+    /**
+     * @return True if the sources of \a paths must be copied into
+     *         \a directory by KIO, see LocalCopyJob::copyInto().
+     */
+    bool requiresKio(const QString& directory, const QVector<QPair<QString, QString>>& paths)
+    {
+#ifdef Q_OS_LINUX
+        QT_STATBUF directoryBuf;
+        if (QT_STAT(QFile::encodeName(directory).constData(), &directoryBuf) != 0 || !S_ISDIR(directoryBuf.st_mode)) {
+            return true;
+        }
+        const QString canonicalDirectory = QFileInfo(directory).canonicalFilePath();
+
+        for (const auto& path : paths) {
+            QT_STATBUF buf;
+            if (QT_LSTAT(QFile::encodeName(path.first).constData(), &buf) != 0 || buf.st_dev != directoryBuf.st_dev) {
+                return true;
+            }
+            // KIO asks the user how to resolve conflicts
+            if (QT_LSTAT(QFile::encodeName(path.second).constData(), &buf) == 0) {
+                return true;
+            }
+            // Copying a folder into itself is rejected by KIO
+            const QString canonicalPath = QFileInfo(path.first).canonicalFilePath();
+            if (canonicalDirectory == canonicalPath || canonicalDirectory.startsWith(canonicalPath + QLatin1Char('/'))) {
+                return true;
+            }
+        }
+        return false;
+#else
+        Q_UNUSED(directory)
+        Q_UNUSED(paths)
+        return true;
+#endif
+    }
+
+#ifndef Q_OS_WIN
+    QString errnoString(int error)
+    {
+        return QString::fromLocal8Bit(strerror(error));
+    }
+
+    /**
+     * Copies the data of the file \a in to the file \a out, which must be empty.
+     * @return 0 if the data has been copied, otherwise the error number.
+     */
+    int copyFileData(int in, int out, qulonglong size, const std::atomic<bool>& canceled,
+                     std::atomic<qulonglong>& processedBytes, std::atomic<int>& strategies)
+    {
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+        // Shares the data with the source on Btrfs and XFS, which is done
+        // at once independent of the size of the file
+        if (::ioctl(out, FICLONE, in) == 0) {
+            processedBytes += size;
+            strategies |= LocalCopyJob::Reflink;
+            return 0;
+        }
+#endif
+
+        qulonglong copiedBytes = 0;
+
+#if defined(Q_OS_LINUX) && defined(SYS_copy_file_range)
+        // Lets the kernel copy the data without reading it into userspace,
+        // which also allows NFS and SMB servers to copy the data by themselves
+        while (!canceled) {
+            const ssize_t count = ::syscall(SYS_copy_file_range, in, nullptr, out, nullptr, ChunkSize, 0);
+            if (count > 0) {
+                copiedBytes += count;
+                processedBytes += count;
+                continue;
+            }
+            if (count == 0) {
+                strategies |= LocalCopyJob::CopyFileRange;
+                return 0;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (copiedBytes > 0 || (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP && errno != EBADF)) {
+                return errno;
+            }
+            break;
+        }
+#endif
+
+        QByteArray buffer(ChunkSize, Qt::Uninitialized);
+        while (!canceled) {
+            const ssize_t readCount = QT_READ(in, buffer.data(), buffer.size());
+            if (readCount < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return errno;
+            }
+            if (readCount == 0) {
+                strategies |= LocalCopyJob::ReadWrite;
+                return 0;
+            }
+
+            ssize_t writtenCount = 0;
+            while (writtenCount < readCount) {
+                const ssize_t count = QT_WRITE(out, buffer.constData() + writtenCount, readCount - writtenCount);
+                if (count < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return errno;
+                }
+                writtenCount += count;
+            }
+            processedBytes += readCount;
+        }
+
+        return ECANCELED;
+    }
+
+    /**
+     * Copies the extended attributes of the item \a source to the item
+     * \a target without following symbolic links. On Linux this includes
+     * the ACLs, which are stored as system.posix_acl_* attributes.
+     * Like KIO, attributes that cannot be set on the target are skipped.
+     */
+    void copyExtendedAttributes(const QByteArray& source, const QByteArray& target)
+    {
+#ifdef Q_OS_LINUX
+        const ssize_t namesLength = ::llistxattr(source.constData(), nullptr, 0);
+        if (namesLength <= 0) {
+            return;
+        }
+        QByteArray names(namesLength, '\0');
+        if (::llistxattr(source.constData(), names.data(), names.size()) != namesLength) {
+            return;
+        }
+
+        QByteArray value;
+        for (const QByteArray& name : names.split('\0')) {
+            if (name.isEmpty()) {
+                continue;
+            }
+            const ssize_t valueLength = ::lgetxattr(source.constData(), name.constData(), nullptr, 0);
+            if (valueLength < 0) {
+                continue;
+            }
+            value.resize(valueLength);
+            if (::lgetxattr(source.constData(), name.constData(), value.data(), value.size()) == valueLength) {
+                ::lsetxattr(target.constData(), name.constData(), value.constData(), value.size(), 0);
+            }
+        }
+#else
+        Q_UNUSED(source)
+        Q_UNUSED(target)
+#endif
+    }
+
+    /**
+     * Applies the access and modification time of \a buf with nanosecond
+     * precision to the item \a target without following symbolic links.
+     */
+    void copyTimes(const QT_STATBUF& buf, const QByteArray& target)
+    {
+        struct timespec times[2];
+#ifdef Q_OS_LINUX
+        times[0] = buf.st_atim;
+        times[1] = buf.st_mtim;
+#else
+        times[0].tv_sec = buf.st_atime;
+        times[0].tv_nsec = 0;
+        times[1].tv_sec = buf.st_mtime;
+        times[1].tv_nsec = 0;
+#endif
+        ::utimensat(AT_FDCWD, target.constData(), times, AT_SYMLINK_NOFOLLOW);
+    }
+#endif
+
+    QString strategiesText(LocalCopyJob::Strategies strategies)
+    {
+        QStringList texts;
+        if (strategies & LocalCopyJob::Reflink) {
+            texts.append(i18nc("@info:progress Method for copying files", "sharing the data (reflink)"));
+        }
+        if (strategies & LocalCopyJob::CopyFileRange) {
+            texts.append(i18nc("@info:progress Method for copying files", "copying in the kernel (copy_file_range)"));
+        }
+        if (strategies & LocalCopyJob::ReadWrite) {
+            texts.append(i18nc("@info:progress Method for copying files", "reading and writing the data"));
+        }
+        return i18nc("@info:progress %1 is a list of methods for copying files", "Copying locally by %1",
+                     texts.join(i18nc("Separator of a list", ", ")));
+    }
+}
+
+LocalCopyJob::LocalCopyJob(const QList<QUrl>& sources, const QList<QUrl>& destinations, QObject* parent) :
+    KJob(parent),
+    m_sources(sources),
+    m_destinations(destinations),
+    m_copiedUrls(),
+    m_destinationDirectory(),
+    m_state(new State()),
+    m_watcher(nullptr),
+    m_copyJob(nullptr),
+    m_progressTimer(nullptr),
+    m_reportedStrategies(),
+    m_autoRename(false)
+{
+    Q_ASSERT(sources.count() == destinations.count());
+    setCapabilities(Killable);
+}
+
+LocalCopyJob::~LocalCopyJob()
+{
+    // The worker thread stops as soon as possible, the state is
+    // shared with it until it has been stopped
+    m_state->canceled = true;
+}
+
+LocalCopyJob* LocalCopyJob::copyInto(const QList<QUrl>& sources, const QUrl& destinationDirectory)
+{
+#ifdef Q_OS_LINUX
+    if (sources.isEmpty() || !destinationDirectory.isLocalFile()) {
+        return nullptr;
+    }
+
+    // Only the URLs are checked here, the items are checked by the worker
+    const QString directory = destinationDirectory.toLocalFile();
+    QList<QUrl> destinations;
+    QSet<QString> names;
+    destinations.reserve(sources.count());
+    for (const QUrl& source : sources) {
+        const QString name = source.fileName();
+        if (!source.isLocalFile() || name.isEmpty() || names.contains(name)) {
+            return nullptr;
+        }
+        names.insert(name);
+        destinations.append(QUrl::fromLocalFile(QDir(directory).filePath(name)));
+    }
+
+    LocalCopyJob* job = new LocalCopyJob(sources, destinations);
+    job->m_destinationDirectory = destinationDirectory;
+    return job;
+#else
+    // Without reflinks and copy_file_range() the job cannot be faster than KIO
+    Q_UNUSED(sources)
+    Q_UNUSED(destinationDirectory)
+    return nullptr;
+#endif
+}
+
+void LocalCopyJob::start()
+{
+    QVector<QPair<QString, QString>> paths;
+    paths.reserve(m_sources.count());
+    for (int i = 0; i < m_sources.count(); ++i) {
+        paths.append(qMakePair(m_sources.at(i).toLocalFile(), m_destinations.at(i).toLocalFile()));
+    }
+
+    if (!m_sources.isEmpty()) {
+        Q_EMIT description(this, i18nc("@title job", "Copying"),
+                           qMakePair(i18nc("The source of a file operation", "Source"),
+                                     m_sources.first().toDisplayString(QUrl::PreferLocalFile)),
+                           qMakePair(i18nc("The destination of a file operation", "Destination"),
+                                     m_destinations.first().toDisplayString(QUrl::PreferLocalFile)));
+    }
+    setTotalAmount(Files, m_sources.count());
+
+    m_progressTimer = new QTimer(this);
+    m_progressTimer->setInterval(ProgressUpdateInterval);
+    connect(m_progressTimer, &QTimer::timeout, this, &LocalCopyJob::updateProgress);
+    m_progressTimer->start();
+
+    m_watcher = new QFutureWatcher<Result>(this);
+    connect(m_watcher, &QFutureWatcher<Result>::finished, this, &LocalCopyJob::slotCopyingFinished);
+    m_watcher->setFuture(KTaskScheduler::instance().run(KTaskScheduler::Visible,
+                                                        &LocalCopyJob::copyItems, m_state, paths, m_autoRename,
+                                                        m_destinationDirectory.toLocalFile()));
+}
+
+void LocalCopyJob::setAutoRename(bool autoRename)
+{
+    m_autoRename = autoRename;
+}
+
+QList<QUrl> LocalCopyJob::copiedUrls() const
+{
+    return m_copiedUrls;
+}
+
+LocalCopyJob::Strategies LocalCopyJob::strategies() const
+{
+    return Strategies(m_state->strategies.load());
+}
+
+bool LocalCopyJob::doKill()
+{
+    if (m_copyJob) {
+        m_copyJob->kill();
+        return true;
+    }
+
+    // The worker cannot be stopped at once, slotCopyingFinished() emits
+    // the result as soon as it has stopped
+    m_state->canceled = true;
+    return false;
+}
+
+void LocalCopyJob::updateProgress()
+{
+    setTotalAmount(Bytes, m_state->totalBytes);
+    setProcessedAmount(Bytes, m_state->processedBytes);
+    setProcessedAmount(Files, m_state->processedFiles);
+
+    const Strategies usedStrategies = strategies();
+    if (usedStrategies != m_reportedStrategies) {
+        m_reportedStrategies = usedStrategies;
+        Q_EMIT infoMessage(this, strategiesText(usedStrategies));
+    }
+}
+
+void LocalCopyJob::slotCopyingFinished()
+{
+    m_progressTimer->stop();
+    updateProgress();
+
+    const Result result = m_watcher->result();
+    m_watcher->deleteLater();
+    m_watcher = nullptr;
+
+    if (result.requiresKio && !m_state->canceled) {
+        // The copy job shows its own progress
+        KIO::getJobTracker()->unregisterJob(this);
+        m_copyJob = KIO::copy(m_sources, m_destinationDirectory);
+        connect(m_copyJob, &KJob::result, this, &LocalCopyJob::slotCopyJobResult);
+        Q_EMIT copyJobStarted(m_copyJob);
+        return;
+    }
+
+    for (const QString& path : result.copiedPaths) {
+        m_copiedUrls.append(QUrl::fromLocalFile(path));
+    }
+    LocalFileOperations::emitFilesAdded(m_copiedUrls);
+
+    if (m_state->canceled) {
+        setError(KilledJobError);
+    } else if (result.failedCount > 0) {
+        setError(UserDefinedError);
+        setErrorText(i18ncp("@info:status", "Could not copy one item: %2", "Could not copy %1 items: %2",
+                            result.failedCount, result.errorString));
+    }
+    emitResult();
+}
+
+void LocalCopyJob::slotCopyJobResult(KJob* job)
+{
+    m_copyJob = nullptr;
+    setError(job->error());
+    setErrorText(job->errorText());
+    emitResult();
+}
+
+LocalCopyJob::Result LocalCopyJob::copyItems(const QSharedPointer<State>& state,
+                                             const QVector<QPair<QString, QString>>& paths,
+                                             bool autoRename,
+                                             const QString& checkedDirectory)
+{
+    Result result;
+    if (!checkedDirectory.isEmpty() && requiresKio(checkedDirectory, paths)) {
+        result.requiresKio = true;
+        return result;
+    }
+
+    qulonglong totalBytes = 0;
+    for (const auto& path : paths) {
+        totalBytes += itemSize(path.first);
+    }
+    state->totalBytes = totalBytes;
+
+    // Copies the item source to target, directories are copied recursively.
+    // Returns false if the item or one of its children could not be copied.
+    std::function<bool(const QString&, const QString&, QString*)> copyItem;
+    copyItem = [&state, &copyItem](const QString& source, const QString& target, QString* errorString) {
+        if (state->canceled) {
+            *errorString = i18nc("@info", "The copying has been canceled.");
+            return false;
+        }
+        if (target.startsWith(source + QLatin1Char('/'))) {
+            *errorString = i18nc("@info", "A folder cannot be copied into itself.");
+            return false;
+        }
+
+#ifdef Q_OS_WIN
+        const QFileInfo info(source);
+        if (info.isDir() && !info.isSymLink()) {
+            if (!QDir().mkdir(target)) {
+                *errorString = i18nc("@info", "Could not create the folder %1.", target);
+                return false;
+            }
+        } else {
+            if (QFileInfo::exists(target)) {
+                *errorString = i18nc("@info", "The file %1 already exists.", target);
+                return false;
+            }
+            QFile file(source);
+            if (!file.copy(target)) {
+                *errorString = file.errorString();
+                return false;
+            }
+            state->processedBytes += info.size();
+            ++state->processedFiles;
+            return true;
+        }
+#else
+        const QByteArray encodedSource = QFile::encodeName(source);
+        const QByteArray encodedTarget = QFile::encodeName(target);
+
+        QT_STATBUF buf;
+        if (QT_LSTAT(encodedSource.constData(), &buf) != 0) {
+            *errorString = errnoString(errno);
+            return false;
+        }
+
+        if (S_ISLNK(buf.st_mode)) {
+            char linkTarget[PATH_MAX];
+            const ssize_t length = ::readlink(encodedSource.constData(), linkTarget, sizeof(linkTarget) - 1);
+            if (length < 0) {
+                *errorString = errnoString(errno);
+                return false;
+            }
+            linkTarget[length] = '\0';
+            if (::symlink(linkTarget, encodedTarget.constData()) != 0) {
+                *errorString = errnoString(errno);
+                return false;
+            }
+            copyTimes(buf, encodedTarget);
+            ++state->processedFiles;
+            return true;
+        }
+
+        if (S_ISREG(buf.st_mode)) {
+            const int in = QT_OPEN(encodedSource.constData(), O_RDONLY | O_CLOEXEC);
+            if (in < 0) {
+                *errorString = errnoString(errno);
+                return false;
+            }
+            // O_EXCL never replaces an existing item
+            const int out = QT_OPEN(encodedTarget.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, buf.st_mode & 07777);
+            if (out < 0) {
+                *errorString = errnoString(errno);
+                QT_CLOSE(in);
+                return false;
+            }
+
+            int error = copyFileData(in, out, buf.st_size, state->canceled, state->processedBytes, state->strategies);
+            if (error == 0) {
+                // The mode passed to open() is restricted by the umask
+                if (::fchmod(out, buf.st_mode & 07777) != 0) {
+                    error = errno;
+                }
+            }
+            QT_CLOSE(in);
+            const bool closed = QT_CLOSE(out) == 0;
+            if (error != 0 || !closed) {
+                *errorString = error == ECANCELED ? i18nc("@info", "The copying has been canceled.")
+                                                  : errnoString(error != 0 ? error : errno);
+                // Do not leave incomplete copies
+                QT_UNLINK(encodedTarget.constData());
+                return false;
+            }
+            copyExtendedAttributes(encodedSource, encodedTarget);
+            copyTimes(buf, encodedTarget);
+            ++state->processedFiles;
+            return true;
+        }
+
+        if (!S_ISDIR(buf.st_mode)) {
+            *errorString = i18nc("@info", "The special file %1 cannot be copied.", source);
+            return false;
+        }
+
+        if (QT_MKDIR(encodedTarget.constData(), S_IRWXU) != 0) {
+            *errorString = errnoString(errno);
+            return false;
+        }
+#endif
+
+        const QStringList entries = QDir(source).entryList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+        for (const QString& entry : entries) {
+            if (!copyItem(source + QLatin1Char('/') + entry, target + QLatin1Char('/') + entry, errorString)) {
+                // The folder has been created by the job, so all of its
+                // items are incomplete copies
+                QDir(target).removeRecursively();
+                return false;
+            }
+        }
+
+#ifndef Q_OS_WIN
+        // The permissions are applied as last, as they might not allow
+        // to create items inside the directory. The times are applied
+        // after the items have been created, which changes them.
+        ::chmod(encodedTarget.constData(), buf.st_mode & 07777);
+        copyExtendedAttributes(encodedSource, encodedTarget);
+        copyTimes(buf, encodedTarget);
+#endif
+        return true;
+    };
+
+    QString errorString;
+    for (int i = 0; i < paths.count(); ++i) {
+        if (state->canceled) {
+            break;
+        }
+        QString target = paths.at(i).second;
+        if (autoRename && isExistingItem(target)) {
+            const QFileInfo info(target);
+            target = info.path() + QLatin1Char('/')
+                + KFileUtils::suggestName(QUrl::fromLocalFile(info.path()), info.fileName());
+        }
+        if (copyItem(paths.at(i).first, target, &errorString)) {
+            result.copiedPaths.append(target);
+        } else {
+            ++result.failedCount;
+            result.errorString = errorString;
+        }
+    }
+
+    return result;
+}
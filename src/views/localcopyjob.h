@@ -0,0 +1,160 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef LOCALCOPYJOB_H
+#define LOCALCOPYJOB_H
+
+#include "dolphin_export.h"
+
+#include <KJob>
+
+#include <QFutureWatcher>
+#include <QList>
+#include <QPair>
+#include <QSharedPointer>
+#include <QString>
+#include <QUrl>
+#include <QVector>
+
+class QTimer;
+
+namespace KIO {
+    class CopyJob;
+}
+
+/**
+ * @brief Copies local items in a worker thread.
+ *
+ * KIO copies each file by reading and writing its data in the file worker
+ * and requires a request per item, which is slow for many small files and
+ * for large files on file systems that support sharing the data between
+ * files. The job tries to clone each file by FICLONE first, then lets the
+ * kernel copy the data by copy_file_range() and reads and writes the data
+ * only if both are not supported.
+ *
+ * Directories are copied recursively and symbolic links are recreated, the
+ * permissions, extended attributes including the ACLs and the times of the
+ * sources are kept. Existing items are never replaced,
+ * and if an item cannot be copied completely, its incomplete copy is
+ * removed. The used strategies are reported by KJob::infoMessage().
+ *
+ * Killing the job only requests the worker to stop, so KJob::kill()
+ * returns false and the result is emitted with KJob::KilledJobError as
+ * soon as the worker has stopped. The copying can be undone by
+ * LocalOperationUndo::recordCopying().
+ */
+class DOLPHIN_EXPORT LocalCopyJob : public KJob
+{
+    Q_OBJECT
+
+public:
+    enum Strategy {
+        Reflink = 0x1,
+        CopyFileRange = 0x2,
+        ReadWrite = 0x4
+    };
+    Q_DECLARE_FLAGS(Strategies, Strategy)
+
+    /**
+     * Copies each of the local \a sources to the destination with the same
+     * index in \a destinations. The destinations are the URLs of the
+     * copies, not of the directories that will contain them.
+     */
+    LocalCopyJob(const QList<QUrl>& sources, const QList<QUrl>& destinations, QObject* parent = nullptr);
+    ~LocalCopyJob() override;
+
+    /**
+     * @return Job that copies \a sources into \a destinationDirectory, or
+     *         nullptr if not all items are local or the job cannot be faster
+     *         than KIO on this system.
+     *
+     * The job checks in the worker whether KIO is required anyway, as the
+     * checks may block on slow disks. This is the case if not all items are
+     * on the same file system as the destination, if an item with the name
+     * of a source exists in the destination, which KIO asks the user about,
+     * or if a folder would be copied into itself. Then nothing is copied
+     * by the job and it copies the items by KIO::copy() instead, see
+     * copyJobStarted().
+     */
+    static LocalCopyJob* copyInto(const QList<QUrl>& sources, const QUrl& destinationDirectory);
+
+    void start() override;
+
+    /**
+     * If \a autoRename is true, an item whose destination exists is copied
+     * to a free name suggested by KFileUtils::suggestName(), like
+     * KIO::CopyJob::setAutoRename() does. Otherwise copying the item fails.
+     * Must be invoked before start().
+     */
+    void setAutoRename(bool autoRename);
+
+    /**
+     * @return Destinations of the items that have been copied completely,
+     *         which differ from the given ones for renamed items.
+     */
+    QList<QUrl> copiedUrls() const;
+
+    /**
+     * @return Strategies that have been used for copying the data of the files.
+     */
+    Strategies strategies() const;
+
+Q_SIGNALS:
+    /**
+     * Is emitted if the items are copied by \a job instead, see copyInto().
+     * The result of the job is emitted as the result of this job. The
+     * receiver may record \a job by KIO::FileUndoManager::recordCopyJob().
+     */
+    void copyJobStarted(KIO::CopyJob* job);
+
+protected:
+    bool doKill() override;
+
+private Q_SLOTS:
+    void updateProgress();
+    void slotCopyingFinished();
+    void slotCopyJobResult(KJob* job);
+
+private:
+    struct State;
+
+    struct Result
+    {
+        // Destinations of the items that have been copied
+        QVector<QString> copiedPaths;
+        int failedCount = 0;
+        QString errorString;
+        // Nothing has been copied, as KIO is required for the items
+        bool requiresKio = false;
+    };
+
+    /**
+     * Copies the items and updates the progress in \a state. If
+     * \a checkedDirectory is not empty, it is the destination directory
+     * of copyInto() and nothing is copied if KIO is required. Is invoked
+     * in a worker thread.
+     */
+    static Result copyItems(const QSharedPointer<State>& state,
+                            const QVector<QPair<QString, QString>>& paths,
+                            bool autoRename,
+                            const QString& checkedDirectory);
+
+private:
+    QList<QUrl> m_sources;
+    QList<QUrl> m_destinations;
+    QList<QUrl> m_copiedUrls;
+    QUrl m_destinationDirectory;
+    QSharedPointer<State> m_state;
+    QFutureWatcher<Result>* m_watcher;
+    KIO::CopyJob* m_copyJob;
+    QTimer* m_progressTimer;
+    Strategies m_reportedStrategies;
+    bool m_autoRename;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(LocalCopyJob::Strategies)
+
+#endif
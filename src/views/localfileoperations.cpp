@@ -0,0 +1,195 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "localfileoperations.h"
+
+#include <KDirNotify>
+#include <KLocalizedString>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSet>
+
+#ifndef Q_OS_WIN
+#include <qplatformdefs.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#endif
+
+namespace {
+    // Number of temporary names that are tried for an item of a cycle
+    const int MaximumTemporaryNameAttempts = 10;
+}
+
+bool LocalFileOperations::renameNoReplace(const QString& source, const QString& target, QString* errorString)
+{
+#ifdef Q_OS_WIN
+    if (QFileInfo::exists(target)) {
+        *errorString = i18nc("@info", "The file %1 already exists.", target);
+        return false;
+    }
+    QFile file(source);
+    if (!file.rename(target)) {
+        *errorString = file.errorString();
+        return false;
+    }
+    return true;
+#else
+    const QByteArray encodedSource = QFile::encodeName(source);
+    const QByteArray encodedTarget = QFile::encodeName(target);
+#if defined(Q_OS_LINUX) && defined(RENAME_NOREPLACE)
+    // Checks and renames atomically, but some file systems do not support it
+    if (::renameat2(AT_FDCWD, encodedSource.constData(), AT_FDCWD, encodedTarget.constData(), RENAME_NOREPLACE) == 0) {
+        return true;
+    }
+    if (errno != EINVAL && errno != ENOSYS) {
+        *errorString = QString::fromLocal8Bit(strerror(errno));
+        return false;
+    }
+#endif
+    QT_STATBUF buf;
+    if (QT_LSTAT(encodedTarget.constData(), &buf) == 0) {
+        *errorString = QString::fromLocal8Bit(strerror(EEXIST));
+        return false;
+    }
+    if (::rename(encodedSource.constData(), encodedTarget.constData()) != 0) {
+        *errorString = QString::fromLocal8Bit(strerror(errno));
+        return false;
+    }
+    return true;
+#endif
+}
+
+LocalFileOperations::RenamingResult LocalFileOperations::renameItems(const QVector<QPair<QString, QString>>& paths)
+{
+    RenamingResult result;
+    const int count = paths.count();
+
+    QHash<QString, int> sourceIndexes;
+    sourceIndexes.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        sourceIndexes.insert(paths.at(i).first, i);
+    }
+
+    // As sources and targets are unique, each item waits for at most one
+    // item to free its target and at most one item waits for it. So the
+    // items form chains, which are renamed starting with their last item,
+    // and cycles.
+    QVector<int> blockingIndexes(count, -1);
+    QVector<int> waitingIndexes(count, -1);
+    for (int i = 0; i < count; ++i) {
+        const QPair<QString, QString>& path = paths.at(i);
+        const int blockingIndex = path.first == path.second ? -1 : sourceIndexes.value(path.second, -1);
+        if (blockingIndex >= 0) {
+            blockingIndexes[i] = blockingIndex;
+            waitingIndexes[blockingIndex] = i;
+        }
+    }
+
+    QVector<bool> handled(count, false);
+    QString errorString;
+
+    auto renameItem = [&](int index, const QString& source) {
+        if (renameNoReplace(source, paths.at(index).second, &errorString)) {
+            result.renamedIndexes.append(index);
+            return true;
+        }
+        ++result.failedCount;
+        result.errorString = errorString;
+        return false;
+    };
+
+    for (int i = 0; i < count; ++i) {
+        if (blockingIndexes.at(i) >= 0) {
+            continue;
+        }
+        // If an item cannot be renamed, the items waiting for it fail as
+        // their targets still exist
+        for (int index = i; index >= 0; index = waitingIndexes.at(index)) {
+            handled[index] = true;
+            const QPair<QString, QString>& path = paths.at(index);
+            if (path.first != path.second) {
+                renameItem(index, path.first);
+            }
+        }
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (handled.at(i)) {
+            continue;
+        }
+
+        QVector<int> cycle;
+        for (int index = i; !handled.at(index); index = waitingIndexes.at(index)) {
+            handled[index] = true;
+            cycle.append(index);
+        }
+
+        // The first item gets a temporary name, which frees the target of
+        // the item waiting for it, and gets its new name as last
+        const QString& firstSource = paths.at(i).first;
+        QString temporaryPath;
+        for (int attempt = 0; attempt < MaximumTemporaryNameAttempts && temporaryPath.isEmpty(); ++attempt) {
+            const QString path = firstSource + QStringLiteral(".dolphin-rename-%1").arg(attempt);
+            if (renameNoReplace(firstSource, path, &errorString)) {
+                temporaryPath = path;
+            }
+        }
+        if (temporaryPath.isEmpty()) {
+            result.failedCount += cycle.count();
+            result.errorString = errorString;
+            continue;
+        }
+
+        QVector<int> renamedIndexes;
+        for (int k = 1; k < cycle.count(); ++k) {
+            const QPair<QString, QString>& path = paths.at(cycle.at(k));
+            if (!renameNoReplace(path.first, path.second, &errorString)) {
+                break;
+            }
+            renamedIndexes.append(cycle.at(k));
+        }
+        if (renamedIndexes.count() == cycle.count() - 1) {
+            result.renamedIndexes.append(renamedIndexes);
+            renameItem(i, temporaryPath);
+            continue;
+        }
+
+        // Restores the names of the items that have been renamed, so that no
+        // temporary name is left behind
+        result.errorString = errorString;
+        int failedCount = cycle.count();
+        for (int k = renamedIndexes.count() - 1; k >= 0; --k) {
+            const QPair<QString, QString>& path = paths.at(renamedIndexes.at(k));
+            if (!renameNoReplace(path.second, path.first, &errorString)) {
+                result.renamedIndexes.append(renamedIndexes.at(k));
+                --failedCount;
+            }
+        }
+        if (!renameNoReplace(temporaryPath, firstSource, &errorString)) {
+            result.errorString = i18nc("@info", "The file %1 could not get its name back.", temporaryPath);
+        }
+        result.failedCount += failedCount;
+    }
+
+    return result;
+}
+
+void LocalFileOperations::emitFilesAdded(const QList<QUrl>& urls)
+{
+    QSet<QUrl> directories;
+    for (const QUrl& url : urls) {
+        directories.insert(url.adjusted(QUrl::RemoveFilename | QUrl::StripTrailingSlash));
+    }
+    for (const QUrl& directory : qAsConst(directories)) {
+        org::kde::KDirNotify::emitFilesAdded(directory);
+    }
+}
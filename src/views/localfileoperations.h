@@ -0,0 +1,66 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef LOCALFILEOPERATIONS_H
+#define LOCALFILEOPERATIONS_H
+
+#include "dolphin_export.h"
+
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QUrl>
+#include <QVector>
+
+/**
+ * @brief Helpers for the operations that bypass KIO for local items.
+ *
+ * BatchRenamer and LocalCopyJob rename and copy large numbers of local
+ * items in a task of KTaskScheduler, as KIO would require a request to
+ * the file worker per item. The tasks have the class Visible, as an
+ * Interactive task would hold back the prefetching of all views for as
+ * long as the operation takes. The functions that may block on the disk
+ * must only be invoked in such a task.
+ */
+namespace LocalFileOperations
+{
+    struct RenamingResult
+    {
+        // Indexes of the renamed paths
+        QVector<int> renamedIndexes;
+        int failedCount = 0;
+        QString errorString;
+    };
+
+    /**
+     * Renames \a source to \a target, if \a target does not exist.
+     * @return True if the renaming has succeeded. Otherwise \a errorString
+     *         contains the reason.
+     */
+    DOLPHIN_EXPORT bool renameNoReplace(const QString& source, const QString& target, QString* errorString);
+
+    /**
+     * Renames each source path of \a paths to its target path without
+     * replacing existing files. The sources and the targets must be unique.
+     *
+     * An item whose target is the source of another item is renamed after
+     * the other item, so shifted numbers need no temporary names. Only the
+     * items of a cycle, e.g. of swapped names, are renamed by a temporary
+     * name. If an item of a cycle cannot be renamed, the other items of the
+     * cycle get their names back.
+     */
+    DOLPHIN_EXPORT RenamingResult renameItems(const QVector<QPair<QString, QString>>& paths);
+
+    /**
+     * Notifies the directory listers of all processes that the items
+     * \a urls have been added or renamed. The listers would notice the
+     * changes by KDirWatch anyway, but updating each directory at once is
+     * considerably faster than being notified about each item.
+     */
+    DOLPHIN_EXPORT void emitFilesAdded(const QList<QUrl>& urls);
+}
+
+#endif
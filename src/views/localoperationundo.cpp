@@ -0,0 +1,167 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "localoperationundo.h"
+
+#include "kitemviews/private/ktaskscheduler.h"
+
+#include <KIO/DeleteJob>
+#include <KIO/FileUndoManager>
+#include <KJobWidgets>
+#include <KLocalizedString>
+
+class LocalOperationUndoSingleton
+{
+public:
+    LocalOperationUndo instance;
+};
+Q_GLOBAL_STATIC(LocalOperationUndoSingleton, s_localOperationUndo)
+
+LocalOperationUndo& LocalOperationUndo::instance()
+{
+    return s_localOperationUndo->instance;
+}
+
+LocalOperationUndo::LocalOperationUndo() :
+    QObject(),
+    m_operation(NoOperation),
+    m_sources(),
+    m_targets(),
+    m_restoredUrls(),
+    m_renamingWatcher(nullptr)
+{
+    connect(KIO::FileUndoManager::self(), &KIO::FileUndoManager::jobRecordingStarted,
+            this, &LocalOperationUndo::clear);
+}
+
+LocalOperationUndo::~LocalOperationUndo()
+{
+}
+
+void LocalOperationUndo::recordRenaming(const QList<QUrl>& sources, const QList<QUrl>& targets)
+{
+    Q_ASSERT(sources.count() == targets.count());
+    if (sources.isEmpty()) {
+        return;
+    }
+
+    m_operation = Renaming;
+    m_sources = sources;
+    m_targets = targets;
+    Q_EMIT undoChanged();
+}
+
+void LocalOperationUndo::recordCopying(const QList<QUrl>& copies)
+{
+    if (copies.isEmpty()) {
+        return;
+    }
+
+    m_operation = Copying;
+    m_sources.clear();
+    m_targets = copies;
+    Q_EMIT undoChanged();
+}
+
+bool LocalOperationUndo::isUndoAvailable() const
+{
+    return m_operation != NoOperation;
+}
+
+QString LocalOperationUndo::undoText() const
+{
+    switch (m_operation) {
+    case Renaming:
+        return i18nc("@action:inmenu", "Und&o: Rename");
+    case Copying:
+        return i18nc("@action:inmenu", "Und&o: Copy");
+    default:
+        return i18nc("@action:inmenu", "Und&o");
+    }
+}
+
+void LocalOperationUndo::undo()
+{
+    if (!isUndoAvailable() || m_renamingWatcher) {
+        return;
+    }
+
+    if (m_operation == Copying) {
+        KIO::FileUndoManager::UiInterface* uiInterface = KIO::FileUndoManager::self()->uiInterface();
+        if (!uiInterface->confirmDeletion(m_targets)) {
+            return;
+        }
+
+        KIO::DeleteJob* job = KIO::del(m_targets);
+        KJobWidgets::setWindow(job, uiInterface->parentWidget());
+        connect(job, &KJob::result, this, &LocalOperationUndo::slotCopyingUndone);
+        m_operation = NoOperation;
+        m_targets.clear();
+        Q_EMIT undoChanged();
+        return;
+    }
+
+    QVector<QPair<QString, QString>> paths;
+    paths.reserve(m_targets.count());
+    for (int i = 0; i < m_targets.count(); ++i) {
+        paths.append(qMakePair(m_targets.at(i).toLocalFile(), m_sources.at(i).toLocalFile()));
+    }
+
+    // Operations that are recorded while undoing are kept
+    m_restoredUrls = m_sources;
+    m_operation = NoOperation;
+    m_sources.clear();
+    m_targets.clear();
+
+    m_renamingWatcher = new QFutureWatcher<LocalFileOperations::RenamingResult>(this);
+    connect(m_renamingWatcher, &QFutureWatcher<LocalFileOperations::RenamingResult>::finished,
+            this, &LocalOperationUndo::slotRenamingUndone);
+    m_renamingWatcher->setFuture(KTaskScheduler::instance().run(KTaskScheduler::Visible,
+                                                                &LocalFileOperations::renameItems, paths));
+    Q_EMIT undoChanged();
+}
+
+void LocalOperationUndo::clear()
+{
+    if (m_operation == NoOperation) {
+        return;
+    }
+
+    m_operation = NoOperation;
+    m_sources.clear();
+    m_targets.clear();
+    Q_EMIT undoChanged();
+}
+
+void LocalOperationUndo::slotCopyingUndone(KJob* job)
+{
+    if (job->error() != 0 && job->error() != KIO::ERR_USER_CANCELED) {
+        Q_EMIT errorMessage(job->errorString());
+    }
+    Q_EMIT undoFinished();
+}
+
+void LocalOperationUndo::slotRenamingUndone()
+{
+    const LocalFileOperations::RenamingResult result = m_renamingWatcher->result();
+    m_renamingWatcher->deleteLater();
+    m_renamingWatcher = nullptr;
+
+    QList<QUrl> restoredUrls;
+    restoredUrls.reserve(result.renamedIndexes.count());
+    for (int index : result.renamedIndexes) {
+        restoredUrls.append(m_restoredUrls.at(index));
+    }
+    m_restoredUrls.clear();
+    LocalFileOperations::emitFilesAdded(restoredUrls);
+
+    if (result.failedCount > 0) {
+        Q_EMIT errorMessage(i18ncp("@info:status", "Could not restore the name of one item: %2",
+                                   "Could not restore the names of %1 items: %2",
+                                   result.failedCount, result.errorString));
+    }
+    Q_EMIT undoFinished();
+}
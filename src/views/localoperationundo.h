@@ -0,0 +1,101 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef LOCALOPERATIONUNDO_H
+#define LOCALOPERATIONUNDO_H
+
+#include "dolphin_export.h"
+#include "views/localfileoperations.h"
+
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+#include <QUrl>
+
+class KJob;
+
+/**
+ * @brief Allows to undo the last operation that has bypassed KIO.
+ *
+ * KIO::FileUndoManager only records the operations of KIO jobs, so the
+ * operations of BatchRenamer and LocalCopyJob are recorded here. Only the
+ * last operation is kept: It is dropped as soon as KIO::FileUndoManager
+ * starts recording another operation, so that the operations are always
+ * undone in the reverse order. DolphinMainWindow undoes the recorded
+ * operation before the ones of KIO::FileUndoManager.
+ */
+class DOLPHIN_EXPORT LocalOperationUndo : public QObject
+{
+    Q_OBJECT
+
+public:
+    static LocalOperationUndo& instance();
+
+    /**
+     * Records that the items \a sources have been renamed to \a targets,
+     * replacing the recorded operation.
+     */
+    void recordRenaming(const QList<QUrl>& sources, const QList<QUrl>& targets);
+
+    /**
+     * Records that the items \a copies have been created by copying,
+     * replacing the recorded operation.
+     */
+    void recordCopying(const QList<QUrl>& copies);
+
+    bool isUndoAvailable() const;
+
+    /**
+     * @return Text for the undo action, like KIO::FileUndoManager::undoText().
+     */
+    QString undoText() const;
+
+    /**
+     * Undoes the recorded operation. Renamed items get their names back
+     * in a task of KTaskScheduler, copies are deleted by KIO after the
+     * user has confirmed it by KIO::FileUndoManager::UiInterface.
+     * undoFinished() is emitted afterwards.
+     */
+    void undo();
+
+    /** Drops the recorded operation. */
+    void clear();
+
+Q_SIGNALS:
+    /** Is emitted if isUndoAvailable() or undoText() have been changed. */
+    void undoChanged();
+
+    /** Is emitted when undoing has been finished. */
+    void undoFinished();
+
+    /** Is emitted if not all items could be restored. */
+    void errorMessage(const QString& message);
+
+private Q_SLOTS:
+    void slotRenamingUndone();
+    void slotCopyingUndone(KJob* job);
+
+private:
+    enum Operation {
+        NoOperation,
+        Renaming,
+        Copying
+    };
+
+    LocalOperationUndo();
+    ~LocalOperationUndo() override;
+
+private:
+    Operation m_operation;
+    QList<QUrl> m_sources;
+    QList<QUrl> m_targets;
+    QList<QUrl> m_restoredUrls;
+    QFutureWatcher<LocalFileOperations::RenamingResult>* m_renamingWatcher;
+
+    friend class LocalOperationUndoSingleton;
+};
+
+#endif
@@ -7,6 +7,8 @@
 #include "tooltipmanager.h"
 
 #include "dolphinfilemetadatawidget.h"
+#include "kitemviews/private/kpluginregistry.h"
+#include "kitemviews/private/kpreviewcache.h"
 
 #include <KIO/JobUiDelegate>
 #include <KIO/PreviewJob>
@@ -19,6 +21,7 @@
 #include <QApplication>
 #include <QDesktopWidget>
 #include <QIcon>
+#include <QImage>
 #include <QLayout>
 #include <QStyle>
 #include <QTimer>
@@ -33,6 +36,17 @@ public:
 
 Q_GLOBAL_STATIC(IconLoaderSingleton, iconLoader)
 
+namespace {
+    const int PreviewSize = 256;
+    const int MaxCachedPreviews = 16;
+
+    QStringList previewPlugins()
+    {
+        const KConfigGroup globalConfig(KSharedConfig::openConfig(), "PreviewSettings");
+        return globalConfig.readEntry("Plugins", KPluginRegistry::instance().defaultPreviewPlugins());
+    }
+}
+
 ToolTipManager::ToolTipManager(QWidget* parent) :
     QObject(parent),
     m_showToolTipTimer(nullptr),
@@ -44,7 +58,10 @@ ToolTipManager::ToolTipManager(QWidget* parent) :
     m_appliedWaitCursor(false),
     m_margin(4),
     m_item(),
-    m_itemRect()
+    m_itemPixmap(),
+    m_itemRect(),
+    m_metaDataItem(),
+    m_previewCache(MaxCachedPreviews)
 {
     if (parent) {
         m_margin = qMax(m_margin, parent->style()->pixelMetric(QStyle::PM_ToolTipLabelFrameWidth));
@@ -67,7 +84,8 @@ ToolTipManager::~ToolTipManager()
 {
 }
 
-void ToolTipManager::showToolTip(const KFileItem& item, const QRectF& itemRect, QWindow *transientParent)
+void ToolTipManager::showToolTip(const KFileItem& item, const QRectF& itemRect, QWindow *transientParent,
+                                 const QPixmap& itemPixmap)
 {
     hideToolTip();
 
@@ -75,17 +93,27 @@ void ToolTipManager::showToolTip(const KFileItem& item, const QRectF& itemRect,
 
     m_itemRect.adjust(-m_margin, -m_margin, m_margin, m_margin);
     m_item = item;
+    m_itemPixmap = itemPixmap;
 
     m_transientParent = transientParent;
 
+    // The meta data of an item that has been hovered before can be shown
+    // again, as long as the item has not been modified in the meantime.
+    const QString key = previewCacheKey(item);
+    const bool reuseMetaData = m_fileMetaDataWidget && !m_metaDataItem.isNull()
+                               && !key.isEmpty() && previewCacheKey(m_metaDataItem) == key;
+
     // Only start the retrieving of the content, when the mouse has been over this
     // item for 200 milliseconds. This prevents a lot of useless preview jobs and
     // meta data retrieval, when passing rapidly over a lot of items.
-    m_fileMetaDataWidget.reset(new DolphinFileMetaDataWidget());
-    connect(m_fileMetaDataWidget.data(), &DolphinFileMetaDataWidget::metaDataRequestFinished,
-            this, &ToolTipManager::slotMetaDataRequestFinished);
-    connect(m_fileMetaDataWidget.data(), &DolphinFileMetaDataWidget::urlActivated,
-            this, &ToolTipManager::urlActivated);
+    if (!reuseMetaData) {
+        m_metaDataItem = KFileItem();
+        m_fileMetaDataWidget.reset(new DolphinFileMetaDataWidget());
+        connect(m_fileMetaDataWidget.data(), &DolphinFileMetaDataWidget::metaDataRequestFinished,
+                this, &ToolTipManager::slotMetaDataRequestFinished);
+        connect(m_fileMetaDataWidget.data(), &DolphinFileMetaDataWidget::urlActivated,
+                this, &ToolTipManager::urlActivated);
+    }
 
     m_contentRetrievalTimer->start();
     m_showToolTipTimer->start();
@@ -122,23 +150,55 @@ void ToolTipManager::startContentRetrieval()
         return;
     }
 
-    m_fileMetaDataWidget->setName(m_item.text());
+    if (m_metaDataItem.isNull()) {
+        m_fileMetaDataWidget->setName(m_item.text());
 
-    // Request the retrieval of meta-data. The slot
-    // slotMetaDataRequestFinished() is invoked after the
-    // meta-data have been received.
-    m_metaDataRequested = true;
-    m_fileMetaDataWidget->setItems(KFileItemList() << m_item);
-    m_fileMetaDataWidget->adjustSize();
+        // Request the retrieval of meta-data. The slot
+        // slotMetaDataRequestFinished() is invoked after the
+        // meta-data have been received.
+        m_metaDataRequested = true;
+        m_fileMetaDataWidget->setItems(KFileItemList() << m_item);
+        m_fileMetaDataWidget->adjustSize();
+    }
+
+    requestPreview();
+}
+
+void ToolTipManager::requestPreview()
+{
+    const QString key = previewCacheKey(m_item);
+    if (const QPixmap* pixmap = m_previewCache.object(key)) {
+        m_fileMetaDataWidget->setPreview(*pixmap);
+        return;
+    }
+
+    const QStringList plugins = previewPlugins();
+    const QSize size(PreviewSize, PreviewSize);
+    if (!key.isEmpty()) {
+        const QImage image = KPreviewCache::instance().find(m_item, size, plugins);
+        if (!image.isNull()) {
+            const QPixmap pixmap = QPixmap::fromImage(image);
+            m_previewCache.insert(key, new QPixmap(pixmap));
+            m_fileMetaDataWidget->setPreview(pixmap);
+            return;
+        }
+    }
+
+    if (!m_itemPixmap.isNull()) {
+        const QSize pixmapSize = m_itemPixmap.size() / m_itemPixmap.devicePixelRatio();
+        if (qMax(pixmapSize.width(), pixmapSize.height()) >= PreviewSize) {
+            // The preview of the view is large enough already
+            m_fileMetaDataWidget->setPreview(m_itemPixmap);
+            return;
+        }
+    }
 
-    // Request a preview of the item
-    m_fileMetaDataWidget->setPreview(QPixmap());
+    // Show the preview of the view until the larger preview
+    // has been generated. If there is none, the tooltip waits
+    // for the preview.
+    m_fileMetaDataWidget->setPreview(m_itemPixmap);
 
-    const KConfigGroup globalConfig(KSharedConfig::openConfig(), "PreviewSettings");
-    const QStringList plugins = globalConfig.readEntry("Plugins", KIO::PreviewJob::defaultPlugins());
-    KIO::PreviewJob* job = new KIO::PreviewJob(KFileItemList() << m_item,
-                                               QSize(256, 256),
-                                               &plugins);
+    KIO::PreviewJob* job = new KIO::PreviewJob(KFileItemList() << m_item, size, &plugins);
     job->setIgnoreMaximumSize(m_item.isLocalFile());
     if (job->uiDelegate()) {
         KJobWidgets::setWindow(job, qApp->activeWindow());
@@ -154,8 +214,27 @@ void ToolTipManager::startContentRetrieval()
 void ToolTipManager::setPreviewPix(const KFileItem& item,
                                    const QPixmap& pixmap)
 {
-    if (!m_toolTipRequested || (m_item.url() != item.url())) {
-        // No tooltip is requested anymore or an old preview has been received
+    // Remember the preview also if the tooltip is not requested anymore,
+    // as it is likely that the item will be hovered again.
+    const QString key = previewCacheKey(item);
+    if (!key.isEmpty() && !pixmap.isNull()) {
+        m_previewCache.insert(key, new QPixmap(pixmap));
+        KPreviewCache::instance().insert(item, QSize(PreviewSize, PreviewSize), previewPlugins(), pixmap.toImage());
+    }
+
+    if (m_item.url() != item.url()) {
+        // An old preview has been received
+        return;
+    }
+
+    if (!m_toolTipRequested) {
+        // Replace the preview of the view, which has been shown until the
+        // larger preview was available, if the tooltip is still shown.
+        if (!pixmap.isNull() && m_tooltipWidget && m_tooltipWidget->isVisible()) {
+            m_fileMetaDataWidget->setPreview(pixmap);
+            m_fileMetaDataWidget->adjustSize();
+            m_tooltipWidget->adjustSize();
+        }
         return;
     }
 
@@ -174,6 +253,15 @@ void ToolTipManager::previewFailed()
     if (!m_toolTipRequested) {
         return;
     }
+
+    if (!m_itemPixmap.isNull()) {
+        // Keep the preview of the view instead of showing the icon
+        if (!m_showToolTipTimer->isActive()) {
+            showToolTip();
+        }
+        return;
+    }
+
     QPalette pal;
     for (auto state : { QPalette::Active, QPalette::Inactive, QPalette::Disabled }) {
         pal.setBrush(state, QPalette::WindowText, pal.toolTipText());
@@ -189,6 +277,10 @@ void ToolTipManager::previewFailed()
 
 void ToolTipManager::slotMetaDataRequestFinished()
 {
+    // The widget is recreated for each item that is hovered,
+    // so the received meta data belongs to m_item.
+    m_metaDataItem = m_item;
+
     if (!m_toolTipRequested) {
         return;
     }
@@ -224,3 +316,13 @@ void ToolTipManager::showToolTip()
     m_toolTipRequested = false;
 }
 
+QString ToolTipManager::previewCacheKey(const KFileItem& item)
+{
+    const QDateTime modificationTime = item.time(KFileItem::ModificationTime);
+    if (!modificationTime.isValid()) {
+        return QString();
+    }
+
+    return item.url().toString() + QLatin1Char('|') + QString::number(modificationTime.toMSecsSinceEpoch());
+}
+
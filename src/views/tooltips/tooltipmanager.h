@@ -9,7 +9,9 @@
 
 #include <KFileItem>
 
+#include <QCache>
 #include <QObject>
+#include <QPixmap>
 #include <QRect>
 
 class DolphinFileMetaDataWidget;
@@ -42,8 +44,11 @@ public:
      * where the item has the maximum boundaries of \p itemRect.
      * The tooltip manager takes care that the tooltip is shown
      * slightly delayed and with a proper \p transientParent.
+     * The preview \p itemPixmap that is shown by the view for the item
+     * is used until a larger preview is available.
      */
-    void showToolTip(const KFileItem& item, const QRectF& itemRect, QWindow *transientParent);
+    void showToolTip(const KFileItem& item, const QRectF& itemRect, QWindow *transientParent,
+                     const QPixmap& itemPixmap = QPixmap());
 
     /**
      * Hides the currently shown tooltip.
@@ -64,6 +69,20 @@ private Q_SLOTS:
     void slotMetaDataRequestFinished();
     void showToolTip();
 
+private:
+    /**
+     * Shows the preview for m_item. A preview that has been generated
+     * before is used if available, otherwise a preview job is started.
+     */
+    void requestPreview();
+
+    /**
+     * @return Key for the preview of \a item, which is based on the URL
+     *         and the modification time of the item. An empty string is
+     *         returned if the item has no modification time.
+     */
+    static QString previewCacheKey(const KFileItem& item);
+
 private:
     /// Timeout from requesting a tooltip until the tooltip
     /// should be shown
@@ -84,7 +103,15 @@ private:
     bool m_appliedWaitCursor;
     int m_margin;
     KFileItem m_item;
+    QPixmap m_itemPixmap;
     QRect m_itemRect;
+
+    /// Item for which m_fileMetaDataWidget contains the received meta data.
+    /// The meta data is reused if the same item is hovered again.
+    KFileItem m_metaDataItem;
+
+    /// Previews that have been generated for the tooltips recently
+    QCache<QString, QPixmap> m_previewCache;
 };
 
 #endif
@@ -16,6 +16,19 @@ KVersionControlPlugin::~KVersionControlPlugin()
 {
 }
 
+void KVersionControlPlugin::setRetrievalConcurrency(RetrievalConcurrency concurrency)
+{
+    // The value is stored as property to keep the size of the class,
+    // which is part of the binary interface of the plugins.
+    setProperty("_k_retrievalConcurrency", int(concurrency));
+}
+
+KVersionControlPlugin::RetrievalConcurrency KVersionControlPlugin::retrievalConcurrency() const
+{
+    const QVariant concurrency = property("_k_retrievalConcurrency");
+    return concurrency.isValid() ? static_cast<RetrievalConcurrency>(concurrency.toInt()) : SerializedRetrieval;
+}
+
 QString KVersionControlPlugin::localRepositoryRoot(const QString &/*directory*/) const
 {
     return QString();
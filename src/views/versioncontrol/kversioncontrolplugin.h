@@ -64,6 +64,10 @@ class KFileItem;
  *    all other methods are invoked in a serialized way, so that it is not necessary for
  *    the plugin to use any mutex.
  *
+ *  - Per default the retrievals of all plugins are serialized. Plugins that
+ *    can retrieve the versions of different repositories in parallel should
+ *    declare this by setRetrievalConcurrency().
+ *
  * -  Dolphin keeps only one instance of the plugin, which is instantiated shortly after
  *    starting Dolphin. Take care that the constructor does no expensive and time
  *    consuming operations.
@@ -133,9 +137,40 @@ public:
         MissingVersion
     };
 
+    /**
+     * Describes which retrievals of version control information may
+     * be done in parallel, see setRetrievalConcurrency().
+     * @since 21.08
+     */
+    enum RetrievalConcurrency
+    {
+        /**
+         * The retrievals are serialized with the retrievals of all
+         * other plugins that use this value. This is the default.
+         */
+        SerializedRetrieval,
+        /**
+         * Only the retrievals for the same repository are serialized,
+         * the retrievals for different repositories are done in parallel.
+         */
+        PerRepositoryRetrieval,
+        /**
+         * The plugin is reentrant and its retrievals must not be serialized.
+         */
+        ReentrantRetrieval
+    };
+
     KVersionControlPlugin(QObject* parent = nullptr);
     ~KVersionControlPlugin() override;
 
+    /**
+     * Declares which retrievals of the plugin may be done in parallel.
+     * Should be invoked in the constructor of the plugin.
+     * @since 21.08
+     */
+    void setRetrievalConcurrency(RetrievalConcurrency concurrency);
+    RetrievalConcurrency retrievalConcurrency() const;
+
     /**
      * Returns the name of the file which stores
      * the version controls information.
@@ -146,6 +181,10 @@ public:
     /**
      * Returns the path of the local repository root for the versionned directory
      * Returns an emtpy QString when directory is not part of a working copy
+     *
+     * Like beginRetrieval(), this method is invoked in a separate thread. It
+     * is serialized with the retrievals of all plugins, unless the plugin
+     * declares ReentrantRetrieval by setRetrievalConcurrency().
      */
     virtual QString localRepositoryRoot(const QString& directory) const;
 
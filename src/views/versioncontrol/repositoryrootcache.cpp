@@ -0,0 +1,317 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "repositoryrootcache.h"
+#include "kitemviews/private/ktaskscheduler.h"
+
+#include <KDirWatch>
+
+#include <QDir>
+#include <QFileInfo>
+
+namespace {
+    // Maximum number of cached results. All results are discarded if it
+    // is exceeded, which only happens when browsing through many folders.
+    const int MaximumEntries = 2000;
+
+    QString normalizedPath(const QString& path)
+    {
+        if (path.length() > 1 && path.endsWith(QLatin1Char('/'))) {
+            return path.left(path.length() - 1);
+        }
+        return path;
+    }
+
+    /**
+     * @return Parent directory of the local path \a path, or an
+     *         empty string if \a path is the root of the filesystem.
+     */
+    QString parentPath(const QString& path)
+    {
+        const int index = path.lastIndexOf(QLatin1Char('/'));
+        if (index < 0 || path == QLatin1String("/")) {
+            return QString();
+        }
+        return index == 0 ? QStringLiteral("/") : path.left(index);
+    }
+
+    bool isSameOrSubdirectory(const QString& path, const QString& directory)
+    {
+        return path == directory
+            || directory == QLatin1String("/")
+            || (path.startsWith(directory) && path.at(directory.length()) == QLatin1Char('/'));
+    }
+}
+
+struct RepositoryRootCacheSingleton
+{
+    RepositoryRootCache instance;
+};
+Q_GLOBAL_STATIC(RepositoryRootCacheSingleton, s_repositoryRootCache)
+
+
+RepositoryRootCache& RepositoryRootCache::instance()
+{
+    return s_repositoryRootCache->instance;
+}
+
+RepositoryRootCache::~RepositoryRootCache()
+{
+}
+
+QStringList RepositoryRootCache::metadataFileNames() const
+{
+    return m_metadataFileNames;
+}
+
+void RepositoryRootCache::addMetadataFileNames(const QStringList& fileNames)
+{
+    bool added = false;
+    for (const QString& fileName : fileNames) {
+        if (!fileName.isEmpty() && !m_metadataFileNames.contains(fileName)) {
+            m_metadataFileNames.append(fileName);
+            added = true;
+        }
+    }
+
+    if (added) {
+        // The negative results don't consider the new plugins
+        clear();
+    }
+}
+
+bool RepositoryRootCache::lookup(const QString& directory, Entry& entry, bool* inherited) const
+{
+    const QString path = normalizedPath(directory);
+    const auto it = m_entries.constFind(path);
+    if (it != m_entries.constEnd()) {
+        entry = it.value();
+        if (inherited) {
+            *inherited = false;
+        }
+        return true;
+    }
+
+    // The closest cached parent decides whether the directory is
+    // part of a repository. A parent that is not versioned says
+    // nothing about its subdirectories.
+    for (QString dir = parentPath(path); !dir.isEmpty(); dir = parentPath(dir)) {
+        const auto parentIt = m_entries.constFind(dir);
+        if (parentIt == m_entries.constEnd()) {
+            continue;
+        }
+
+        const Entry& parentEntry = parentIt.value();
+        if (parentEntry.fileName.isEmpty() || !isSameOrSubdirectory(path, normalizedPath(parentEntry.root))) {
+            return false;
+        }
+
+        entry = parentEntry;
+        if (inherited) {
+            *inherited = true;
+        }
+        return true;
+    }
+    return false;
+}
+
+void RepositoryRootCache::insert(const QString& directory, const Entry& entry, const Metadata& metadata)
+{
+    if (m_entries.count() >= MaximumEntries) {
+        clear();
+    }
+
+    const QString path = normalizedPath(directory);
+    QStringList directories;
+    if (entry.fileName.isEmpty()) {
+        directories.append(path);
+    } else {
+        // All directories between the directory and the repository
+        // root belong to the same repository
+        directories = dependencies(path, entry);
+    }
+
+    for (const QString& dir : qAsConst(directories)) {
+        if (m_entries.contains(dir)) {
+            continue;
+        }
+
+        m_entries.insert(dir, entry);
+        const QStringList dependentDirectories = dependencies(dir, entry);
+        for (const QString& dependentDirectory : dependentDirectories) {
+            watch(dependentDirectory, metadata.value(dependentDirectory));
+        }
+    }
+}
+
+void RepositoryRootCache::clear()
+{
+    for (auto it = m_watchedDirectories.constBegin(); it != m_watchedDirectories.constEnd(); ++it) {
+        m_dirWatch->removeDir(it.key());
+    }
+    m_watchedDirectories.clear();
+    m_entries.clear();
+    m_changedDirectories.clear();
+}
+
+int RepositoryRootCache::count() const
+{
+    return m_entries.count();
+}
+
+RepositoryRootCache::RepositoryRootCache() :
+    QObject(),
+    m_metadataFileNames(),
+    m_entries(),
+    m_watchedDirectories(),
+    m_dirWatch(nullptr),
+    m_changedDirectories(),
+    m_metadataWatcher(nullptr)
+{
+    m_dirWatch = new KDirWatch(this);
+    connect(m_dirWatch, &KDirWatch::dirty, this, &RepositoryRootCache::slotDirectoryChanged);
+    connect(m_dirWatch, &KDirWatch::created, this, &RepositoryRootCache::slotDirectoryChanged);
+    connect(m_dirWatch, &KDirWatch::deleted, this, &RepositoryRootCache::slotDirectoryChanged);
+
+    m_metadataWatcher = new QFutureWatcher<Metadata>(this);
+    connect(m_metadataWatcher, &QFutureWatcher<Metadata>::finished, this, &RepositoryRootCache::slotMetadataRead);
+}
+
+void RepositoryRootCache::slotDirectoryChanged(const QString& path)
+{
+    const QString directory = normalizedPath(path);
+    if (m_watchedDirectories.contains(directory)) {
+        m_changedDirectories.insert(directory);
+        readChangedMetadata();
+    }
+}
+
+void RepositoryRootCache::slotMetadataRead()
+{
+    const Metadata metadata = m_metadataWatcher->result();
+
+    QStringList invalidDirectories;
+    for (auto metadataIt = metadata.constBegin(); metadataIt != metadata.constEnd(); ++metadataIt) {
+        // Most changes of a watched directory don't affect the metadata
+        const QString& directory = metadataIt.key();
+        const auto watched = m_watchedDirectories.find(directory);
+        if (watched == m_watchedDirectories.end() || watched->metadata == metadataIt.value()) {
+            continue;
+        }
+        watched->metadata = metadataIt.value();
+
+        for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+            if (isSameOrSubdirectory(it.key(), directory) && !invalidDirectories.contains(it.key())) {
+                invalidDirectories.append(it.key());
+            }
+        }
+    }
+
+    for (const QString& invalidDirectory : qAsConst(invalidDirectories)) {
+        remove(invalidDirectory);
+    }
+
+    if (!invalidDirectories.isEmpty()) {
+        Q_EMIT invalidated();
+    }
+
+    // The directories that have been changed while reading
+    readChangedMetadata();
+}
+
+void RepositoryRootCache::readChangedMetadata()
+{
+    if (m_changedDirectories.isEmpty() || m_metadataWatcher->isRunning()) {
+        return;
+    }
+
+    const QStringList directories(m_changedDirectories.constBegin(), m_changedDirectories.constEnd());
+    m_changedDirectories.clear();
+    m_metadataWatcher->setFuture(KTaskScheduler::instance().run(KTaskScheduler::Visible, &RepositoryRootCache::readMetadata,
+                                                                directories, m_metadataFileNames));
+}
+
+QStringList RepositoryRootCache::dependencies(const QString& directory, const Entry& entry)
+{
+    QStringList directories;
+    const bool versioned = !entry.fileName.isEmpty();
+    const QString root = normalizedPath(entry.root);
+    if (versioned && !isSameOrSubdirectory(directory, root)) {
+        // The plugin did not find the root in a parent directory
+        directories << directory << root;
+        return directories;
+    }
+
+    // Watching all parents up to the root of the filesystem for a directory
+    // that is not versioned would add watches for many unrelated directories
+    const QString homePath = normalizedPath(QDir::homePath());
+    const bool insideHome = isSameOrSubdirectory(directory, homePath);
+
+    QString dir = directory;
+    while (!dir.isEmpty()) {
+        directories.append(dir);
+        if (versioned ? dir == root : (!insideHome || dir == homePath)) {
+            break;
+        }
+        dir = parentPath(dir);
+    }
+    return directories;
+}
+
+RepositoryRootCache::Metadata RepositoryRootCache::readMetadata(const QStringList& directories, const QStringList& fileNames)
+{
+    Metadata metadata;
+    for (const QString& directory : directories) {
+        const QString prefix = directory.endsWith(QLatin1Char('/')) ? directory : directory + QLatin1Char('/');
+
+        QSet<QString>& existing = metadata[directory];
+        for (const QString& fileName : fileNames) {
+            if (QFileInfo::exists(prefix + fileName)) {
+                existing.insert(fileName);
+            }
+        }
+    }
+    return metadata;
+}
+
+void RepositoryRootCache::watch(const QString& directory, const QSet<QString>& metadata)
+{
+    auto it = m_watchedDirectories.find(directory);
+    if (it != m_watchedDirectories.end()) {
+        ++it->references;
+        return;
+    }
+
+    m_watchedDirectories.insert(directory, {metadata, 1});
+    m_dirWatch->addDir(directory);
+}
+
+void RepositoryRootCache::unwatch(const QString& directory)
+{
+    auto it = m_watchedDirectories.find(directory);
+    if (it == m_watchedDirectories.end()) {
+        return;
+    }
+
+    if (--it->references <= 0) {
+        m_watchedDirectories.erase(it);
+        m_dirWatch->removeDir(directory);
+    }
+}
+
+void RepositoryRootCache::remove(const QString& directory)
+{
+    const auto it = m_entries.find(directory);
+    if (it == m_entries.end()) {
+        return;
+    }
+
+    const QStringList dependentDirectories = dependencies(directory, it.value());
+    m_entries.erase(it);
+    for (const QString& dependentDirectory : dependentDirectories) {
+        unwatch(dependentDirectory);
+    }
+}
@@ -0,0 +1,162 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef REPOSITORYROOTCACHE_H
+#define REPOSITORYROOTCACHE_H
+
+#include "dolphin_export.h"
+
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+class KDirWatch;
+
+/**
+ * @brief Caches the repository roots that have been discovered by the version control plugins.
+ *
+ * Discovering whether a directory is part of a working copy usually requires
+ * walking up the parent directories, and some plugins even start a process.
+ * The VersionControlObserver of each view asks the cache first and only
+ * discovers the repository if the directory is unknown. Both the repository
+ * roots and the directories that are not under version control are cached.
+ * Discovering the root of a directory also caches the root for the directories
+ * between the directory and the root. The subdirectories of a cached versioned
+ * directory are assumed to be part of the same repository, until their own
+ * result is known.
+ *
+ * The directories that the results depend on are watched. If a metadata file
+ * or directory of a plugin, like ".git", ".svn" or ".hg", is created or removed
+ * in one of them, the results of the directory and its subdirectories are
+ * discarded. The results for directories that are not versioned only depend on
+ * the parent directories inside the home folder, a repository that is created
+ * in a parent directory outside of it is not recognized until clear() is invoked.
+ *
+ * The metadata is checked by worker threads. The cache is shared by all views
+ * and may only be used by the main thread, except for the static methods.
+ */
+class DOLPHIN_EXPORT RepositoryRootCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Entry
+    {
+        QString fileName;   // File name of the metadata of the plugin, e.g. ".git",
+                            // or an empty string if the directory is not versioned
+        QString root;       // Local path of the repository root
+    };
+
+    /**
+     * Metadata file names that exist in the directories, the keys
+     * are the local paths of the directories.
+     */
+    typedef QHash<QString, QSet<QString>> Metadata;
+
+    static RepositoryRootCache& instance();
+    ~RepositoryRootCache() override;
+
+    /**
+     * Adds the file names of the metadata of the plugins, see
+     * KVersionControlPlugin::fileName(). Only the creation or removal of
+     * files with these names invalidates the results.
+     */
+    void addMetadataFileNames(const QStringList& fileNames);
+    QStringList metadataFileNames() const;
+
+    /**
+     * @return True if a result for the local path \a directory is known,
+     *         which is stored in \a entry. If the result of \a directory
+     *         has not been cached, but one of its parent directories is
+     *         versioned, the result of the parent is stored and
+     *         \a inherited is set to true.
+     */
+    bool lookup(const QString& directory, Entry& entry, bool* inherited = nullptr) const;
+
+    /**
+     * Caches \a entry as result for the local path \a directory. If the
+     * directory is versioned, the root is cached for all directories between
+     * \a directory and the repository root, too. \a metadata must contain the
+     * metadata of the dependencies() of the result, see readMetadata().
+     */
+    void insert(const QString& directory, const Entry& entry, const Metadata& metadata);
+
+    /**
+     * Discards all results, e.g. if the enabled plugins have been changed.
+     */
+    void clear();
+
+    /**
+     * @return Number of cached results.
+     */
+    int count() const;
+
+    /**
+     * @return Directories whose metadata decides the result \a entry
+     *         for \a directory, which are \a directory and its parents
+     *         up to the repository root. If the directory is not versioned,
+     *         these are its parents inside the home folder. May be invoked
+     *         by any thread.
+     */
+    static QStringList dependencies(const QString& directory, const Entry& entry);
+
+    /**
+     * @return Metadata file names out of \a fileNames that exist in \a directories.
+     *         Is usually invoked by a worker thread.
+     */
+    static Metadata readMetadata(const QStringList& directories, const QStringList& fileNames);
+
+Q_SIGNALS:
+    /**
+     * Is emitted if cached results have been discarded because
+     * of the creation or removal of metadata.
+     */
+    void invalidated();
+
+protected:
+    RepositoryRootCache();
+
+private Q_SLOTS:
+    void slotDirectoryChanged(const QString& path);
+
+    /**
+     * Discards the results that depend on the changed metadata
+     * that has been read by readChangedMetadata().
+     */
+    void slotMetadataRead();
+
+private:
+    /**
+     * Reads the metadata of the changed directories in a worker thread,
+     * unless it is being read already.
+     */
+    void readChangedMetadata();
+
+    void watch(const QString& directory, const QSet<QString>& metadata);
+    void unwatch(const QString& directory);
+    void remove(const QString& directory);
+
+private:
+    struct WatchedDirectory
+    {
+        QSet<QString> metadata;
+        int references;
+    };
+
+    QStringList m_metadataFileNames;
+    QHash<QString, Entry> m_entries;
+    QHash<QString, WatchedDirectory> m_watchedDirectories;
+    KDirWatch* m_dirWatch;
+    QSet<QString> m_changedDirectories;
+    QFutureWatcher<Metadata>* m_metadataWatcher;
+
+    friend struct RepositoryRootCacheSingleton;
+};
+
+#endif
@@ -6,49 +6,165 @@
 
 #include "updateitemstatesthread.h"
 
+#include "kitemviews/private/ktaskscheduler.h"
+
+#include <QHash>
+
+#include <algorithm>
+
+namespace {
+    // Number of retrieved item states after which they are passed to the observer
+    const int ItemStatesChunkSize = 200;
+
+    /**
+     * @return Mutex that serializes the retrievals of the plugin class
+     *         \a pluginClass for the repository \a repositoryRoot.
+     *         The mutexes are kept until Dolphin is closed, as only
+     *         few repositories are visited.
+     */
+    QMutex* repositoryMutex(const QByteArray& pluginClass, const QString& repositoryRoot)
+    {
+        static QMutex mutexesMutex;
+        static QHash<QString, QMutex*> mutexes;
+
+        QMutexLocker locker(&mutexesMutex);
+        const QString key = QString::fromLatin1(pluginClass) + QLatin1Char(':') + repositoryRoot;
+        QMutex*& mutex = mutexes[key];
+        if (!mutex) {
+            mutex = new QMutex();
+        }
+        return mutex;
+    }
+}
 
 UpdateItemStatesThread::UpdateItemStatesThread(KVersionControlPlugin* plugin,
-                                               const QMap<QString, QVector<VersionControlObserver::ItemState> >& itemStates) :
+                                               const QString& repositoryRoot,
+                                               const QMap<QString, QVector<VersionControlObserver::ItemState> >& itemStates,
+                                               const QSet<KFileItem>& visibleItems) :
     QThread(),
-    m_globalPluginMutex(nullptr),
+    m_pluginMutex(nullptr),
     m_plugin(plugin),
-    m_itemStates(itemStates)
+    m_itemStates(itemStates),
+    m_directories(),
+    m_visibleItemsCount(0),
+    m_lowPriority(false),
+    m_retrievedItemStatesMutex(),
+    m_retrievedItemStates()
 {
-    // Several threads may share one instance of a plugin. A global
-    // mutex is required to serialize the retrieval of version control
-    // states inside run().
-    static QMutex globalMutex;
-    m_globalPluginMutex = &globalMutex;
+    // Retrieve the states of the visible items first: The directories that
+    // contain visible items are processed first, and inside each directory
+    // the visible items are placed before the other items.
+    QStringList otherDirectories;
+    QMap<QString, QVector<VersionControlObserver::ItemState> >::iterator it = m_itemStates.begin();
+    for (; it != m_itemStates.end(); ++it) {
+        QVector<VersionControlObserver::ItemState>& items = it.value();
+        const auto firstInvisible = std::stable_partition(items.begin(), items.end(),
+            [&visibleItems](const VersionControlObserver::ItemState& itemState) {
+                return visibleItems.contains(itemState.first);
+            });
+        const int count = int(firstInvisible - items.begin());
+        if (count > 0) {
+            m_directories.append(it.key());
+            m_visibleItemsCount += count;
+        } else {
+            otherDirectories.append(it.key());
+        }
+    }
+    m_directories += otherDirectories;
+
+    switch (plugin->retrievalConcurrency()) {
+    case KVersionControlPlugin::SerializedRetrieval:
+        // Plugins that don't declare their concurrency might not be
+        // thread-safe at all. A global mutex is required to serialize
+        // the retrieval of version control states inside run().
+        m_pluginMutex = serializedRetrievalMutex();
+        break;
+    case KVersionControlPlugin::PerRepositoryRetrieval:
+        m_pluginMutex = repositoryMutex(plugin->metaObject()->className(), repositoryRoot);
+        break;
+    case KVersionControlPlugin::ReentrantRetrieval:
+        break;
+    }
 }
 
 UpdateItemStatesThread::~UpdateItemStatesThread()
 {
 }
 
+void UpdateItemStatesThread::setLowPriority(bool lowPriority)
+{
+    m_lowPriority = lowPriority;
+}
+
+QMutex* UpdateItemStatesThread::serializedRetrievalMutex()
+{
+    static QMutex globalMutex;
+    return &globalMutex;
+}
+
 void UpdateItemStatesThread::run()
 {
     Q_ASSERT(!m_itemStates.isEmpty());
     Q_ASSERT(m_plugin);
 
-    QMutexLocker pluginLocker(m_globalPluginMutex);
-    QMap<QString, QVector<VersionControlObserver::ItemState> >::iterator it = m_itemStates.begin();
-    for (; it != m_itemStates.end(); ++it) {
-        if (m_plugin->beginRetrieval(it.key())) {
-            QVector<VersionControlObserver::ItemState>& items = it.value();
-            const int count = items.count();
-            for (int i = 0; i < count; ++i) {
-                const KFileItem& item = items.at(i).first;
-                const KVersionControlPlugin::ItemVersion version = m_plugin->itemVersion(item);
-                items[i].second = version;
+    if (m_lowPriority) {
+        // The thread is only used for this update
+        KTaskScheduler::lowerCurrentThreadPriority();
+    }
+
+    // QMutexLocker does nothing if the mutex is null
+    QMutexLocker pluginLocker(m_pluginMutex);
+
+    QVector<VersionControlObserver::ItemState> chunk;
+    int visibleItemsLeft = m_visibleItemsCount;
+    for (const QString& directory : qAsConst(m_directories)) {
+        QVector<VersionControlObserver::ItemState>& items = m_itemStates[directory];
+        if (m_plugin->beginRetrieval(directory)) {
+            for (VersionControlObserver::ItemState& itemState : items) {
+                itemState.second = m_plugin->itemVersion(itemState.first);
+                chunk.append(itemState);
+
+                // Pass the states of the visible items as soon as they are known
+                --visibleItemsLeft;
+                if (visibleItemsLeft == 0 || chunk.count() >= ItemStatesChunkSize) {
+                    addItemStates(chunk);
+                    chunk.clear();
+                }
             }
+        } else {
+            visibleItemsLeft -= items.count();
+            chunk += items;
         }
 
         m_plugin->endRetrieval();
     }
+
+    if (!chunk.isEmpty()) {
+        addItemStates(chunk);
+    }
 }
 
-QMap<QString, QVector<VersionControlObserver::ItemState> > UpdateItemStatesThread::itemStates() const
+QVector<VersionControlObserver::ItemState> UpdateItemStatesThread::takeItemStates()
 {
-    return m_itemStates;
+    QMutexLocker locker(&m_retrievedItemStatesMutex);
+    QVector<VersionControlObserver::ItemState> itemStates;
+    itemStates.swap(m_retrievedItemStates);
+    return itemStates;
+}
+
+void UpdateItemStatesThread::addItemStates(const QVector<VersionControlObserver::ItemState>& itemStates)
+{
+    bool wasEmpty;
+    {
+        QMutexLocker locker(&m_retrievedItemStatesMutex);
+        wasEmpty = m_retrievedItemStates.isEmpty();
+        m_retrievedItemStates += itemStates;
+    }
+
+    if (wasEmpty) {
+        // The observer takes all item states that have
+        // been added until it handles the signal
+        Q_EMIT itemStatesAvailable();
+    }
 }
 
@@ -11,6 +11,8 @@
 #include "views/versioncontrol/versioncontrolobserver.h"
 
 #include <QMutex>
+#include <QSet>
+#include <QStringList>
 #include <QThread>
 
 /**
@@ -29,22 +31,62 @@ public:
      *                   from the thread creator after starting the thread,
      *                   UpdateItemStatesThread::lockPlugin() and
      *                   UpdateItemStatesThread::unlockPlugin() must be used.
+     * @param repositoryRoot Local root of the repository that contains the items.
+     *                   Is used to serialize the retrievals of plugins
+     *                   that use KVersionControlPlugin::PerRepositoryRetrieval.
      * @param itemStates List of items, where the states get updated.
+     * @param visibleItems Items whose states are retrieved first.
      */
     UpdateItemStatesThread(KVersionControlPlugin* plugin,
-                           const QMap<QString, QVector<VersionControlObserver::ItemState> >& itemStates);
+                           const QString& repositoryRoot,
+                           const QMap<QString, QVector<VersionControlObserver::ItemState> >& itemStates,
+                           const QSet<KFileItem>& visibleItems = QSet<KFileItem>());
     ~UpdateItemStatesThread() override;
 
-    QMap<QString, QVector<VersionControlObserver::ItemState> > itemStates() const;
+    /**
+     * Lowers the CPU and I/O priority of the thread, and of the processes
+     * that are started by the plugin. Must be invoked before starting.
+     */
+    void setLowPriority(bool lowPriority);
+
+    /**
+     * @return The item states that have been retrieved since the last
+     *         invocation. May be invoked while the thread is running.
+     */
+    QVector<VersionControlObserver::ItemState> takeItemStates();
+
+    /**
+     * @return Mutex that serializes the accesses to all plugins that use
+     *         KVersionControlPlugin::SerializedRetrieval, e.g. when their
+     *         repository root is discovered in another thread.
+     */
+    static QMutex* serializedRetrievalMutex();
+
+Q_SIGNALS:
+    /**
+     * Is emitted by the running thread if item states have been retrieved,
+     * see takeItemStates(). The states of the visible items are
+     * emitted first.
+     */
+    void itemStatesAvailable();
 
 protected:
     void run() override;
 
 private:
-    QMutex* m_globalPluginMutex; // Protects the m_plugin globally
+    void addItemStates(const QVector<VersionControlObserver::ItemState>& itemStates);
+
+private:
+    QMutex* m_pluginMutex; // Serializes the retrievals, is null for reentrant plugins
     KVersionControlPlugin* m_plugin;
 
     QMap<QString, QVector<VersionControlObserver::ItemState> > m_itemStates;
+    QStringList m_directories; // Directories of m_itemStates in the order of the retrieval
+    int m_visibleItemsCount;
+    bool m_lowPriority;
+
+    QMutex m_retrievedItemStatesMutex; // Protects m_retrievedItemStates
+    QVector<VersionControlObserver::ItemState> m_retrievedItemStates;
 };
 
 #endif // UPDATEITEMSTATESTHREAD_H
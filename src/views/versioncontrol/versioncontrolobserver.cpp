@@ -6,18 +6,35 @@
 
 #include "versioncontrolobserver.h"
 
+#include "dolphin_generalsettings.h"
 #include "dolphin_versioncontrolsettings.h"
 #include "dolphindebug.h"
 #include "views/dolphinview.h"
 #include "kitemviews/kfileitemmodel.h"
+#include "kitemviews/private/kiogovernor.h"
+#include "kitemviews/private/kitemlistmetrics.h"
+#include "kitemviews/private/kpluginregistry.h"
+#include "kitemviews/private/ktaskscheduler.h"
+#include "repositoryrootcache.h"
 #include "updateitemstatesthread.h"
 
+#include <KDirWatch>
 #include <KLocalizedString>
 #include <KService>
-#include <KServiceTypeTrader>
 
+#include <QFileInfo>
+#include <QMutexLocker>
 #include <QTimer>
 
+#include <algorithm>
+
+namespace {
+    // Plugins might update the metadata of the repository while retrieving
+    // the versions. Changes of the metadata within this interval after
+    // a retrieval are ignored.
+    const int RetrievalMetadataChangeInterval = 1000;
+}
+
 VersionControlObserver::VersionControlObserver(QObject* parent) :
     QObject(parent),
     m_pendingItemStatesUpdate(false),
@@ -25,9 +42,19 @@ VersionControlObserver::VersionControlObserver(QObject* parent) :
     m_view(nullptr),
     m_model(nullptr),
     m_dirVerificationTimer(nullptr),
+    m_paused(false),
+    m_verificationPending(false),
     m_pluginsInitialized(false),
     m_plugin(nullptr),
-    m_updateItemStatesThread(nullptr)
+    m_updateItemStatesThread(nullptr),
+    m_versionCache(),
+    m_watchedRepoRoot(),
+    m_watchedMetadataPath(),
+    m_repositoryWatcher(nullptr),
+    m_lastRetrieval(),
+    m_retrievalTimer(),
+    m_ioTokenPath(),
+    m_discoveryWatcher(nullptr)
 {
     // The verification timer specifies the timeout until the shown directory
     // is checked whether it is versioned. Per default it is assumed that users
@@ -39,10 +66,48 @@ VersionControlObserver::VersionControlObserver(QObject* parent) :
     m_dirVerificationTimer->setInterval(500);
     connect(m_dirVerificationTimer, &QTimer::timeout,
             this, &VersionControlObserver::verifyDirectory);
+
+    m_repositoryWatcher = new KDirWatch(this);
+    connect(m_repositoryWatcher, &KDirWatch::dirty,
+            this, &VersionControlObserver::slotRepositoryMetadataChanged);
+    connect(m_repositoryWatcher, &KDirWatch::created,
+            this, &VersionControlObserver::slotRepositoryMetadataChanged);
+    connect(m_repositoryWatcher, &KDirWatch::deleted,
+            this, &VersionControlObserver::slotRepositoryMetadataChanged);
+
+    m_discoveryWatcher = new QFutureWatcher<Discovery>(this);
+    connect(m_discoveryWatcher, &QFutureWatcher<Discovery>::finished,
+            this, &VersionControlObserver::slotDiscoveryFinished);
+
+    // A repository might have been created or removed
+    connect(&RepositoryRootCache::instance(), &RepositoryRootCache::invalidated,
+            this, &VersionControlObserver::silentDirectoryVerification);
+
+    // Queued, as the own token is released in slotThreadFinished() before the
+    // states of the finished thread have been applied.
+    connect(&KIoGovernor::instance(), &KIoGovernor::released, this, [this]() {
+        // The retrieval could not be started, as other views used the whole
+        // budget of the mount (see updateItemStates())
+        if (m_pendingItemStatesUpdate && !m_updateItemStatesThread && m_plugin) {
+            m_pendingItemStatesUpdate = false;
+            updateItemStates();
+        }
+    }, Qt::QueuedConnection);
 }
 
 VersionControlObserver::~VersionControlObserver()
 {
+    // The discovery accesses the plugins, which are deleted with the observer
+    m_discoveryWatcher->disconnect(this);
+    m_discoveryWatcher->waitForFinished();
+
+    // The running thread deletes itself, but nobody would release its token
+    KIoGovernor& governor = KIoGovernor::instance();
+    disconnect(&governor, nullptr, this, nullptr);
+    if (m_updateItemStatesThread) {
+        governor.release(KIoGovernor::VersionControl, m_ioTokenPath);
+    }
+
     if (m_plugin) {
         m_plugin->disconnect(this);
         m_plugin = nullptr;
@@ -110,6 +175,10 @@ QList<QAction*> VersionControlObserver::actions(const KFileItemList& items) cons
 
     if (isVersionControlled()) {
         return m_plugin->versionControlActions(items);
+    } else if (m_discoveryWatcher->isRunning()) {
+        // It is not known yet whether the directory is versioned,
+        // the actions for unversioned directories might be wrong
+        return {};
     } else {
         QList<QAction*> actions;
         for (const QPointer<KVersionControlPlugin> &plugin : qAsConst(m_plugins)) {
@@ -119,16 +188,47 @@ QList<QAction*> VersionControlObserver::actions(const KFileItemList& items) cons
     }
 }
 
+void VersionControlObserver::setPaused(bool paused)
+{
+    if (m_paused == paused) {
+        return;
+    }
+
+    m_paused = paused;
+    if (paused) {
+        if (m_dirVerificationTimer->isActive()) {
+            m_dirVerificationTimer->stop();
+            m_verificationPending = true;
+        }
+    } else if (m_verificationPending) {
+        m_verificationPending = false;
+        m_dirVerificationTimer->start();
+    }
+}
+
+bool VersionControlObserver::isPaused() const
+{
+    return m_paused;
+}
+
 void VersionControlObserver::delayedDirectoryVerification()
 {
     m_silentUpdate = false;
-    m_dirVerificationTimer->start();
+    if (m_paused) {
+        m_verificationPending = true;
+    } else {
+        m_dirVerificationTimer->start();
+    }
 }
 
 void VersionControlObserver::silentDirectoryVerification()
 {
     m_silentUpdate = true;
-    m_dirVerificationTimer->start();
+    if (m_paused) {
+        m_verificationPending = true;
+    } else {
+        m_dirVerificationTimer->start();
+    }
 }
 
 void VersionControlObserver::slotItemsChanged(const KItemRangeList& itemRanges, const QSet<QByteArray>& roles)
@@ -170,6 +270,7 @@ void VersionControlObserver::verifyDirectory()
         // The directory is versioned. Assume that the user will further browse through
         // versioned directories and decrease the verification timer.
         m_dirVerificationTimer->setInterval(100);
+        watchRepository();
         updateItemStates();
     }
 }
@@ -178,24 +279,21 @@ void VersionControlObserver::slotThreadFinished()
 {
     UpdateItemStatesThread* thread = m_updateItemStatesThread;
     m_updateItemStatesThread = nullptr; // The thread deletes itself automatically (see updateItemStates())
+    m_lastRetrieval.start();
+    if (thread) {
+        KIoGovernor::instance().release(KIoGovernor::VersionControl, m_ioTokenPath);
+        m_ioTokenPath.clear();
+
+        KItemListMetrics& metrics = KItemListMetrics::instance();
+        metrics.add(KItemListMetrics::VersionControlPasses);
+        metrics.add(KItemListMetrics::VersionControlNsecs, m_retrievalTimer.nsecsElapsed());
+    }
 
     if (!m_plugin || !thread) {
         return;
     }
 
-    const QMap<QString, QVector<ItemState> >& itemStates = thread->itemStates();
-    QMap<QString, QVector<ItemState> >::const_iterator it = itemStates.constBegin();
-    for (; it != itemStates.constEnd(); ++it) {
-        const QVector<ItemState>& items = it.value();
-
-        for (const ItemState& item : items) {
-            const KFileItem& fileItem = item.first;
-            const KVersionControlPlugin::ItemVersion version = item.second;
-            QHash<QByteArray, QVariant> values;
-            values.insert("version", QVariant(version));
-            m_model->setData(m_model->index(fileItem), values);
-        }
-    }
+    applyItemStates(thread->takeItemStates());
 
     if (!m_silentUpdate) {
         // Using an empty message results in clearing the previously shown information message and showing
@@ -210,6 +308,67 @@ void VersionControlObserver::slotThreadFinished()
     }
 }
 
+void VersionControlObserver::slotItemStatesAvailable()
+{
+    if (m_plugin && m_updateItemStatesThread) {
+        applyItemStates(m_updateItemStatesThread->takeItemStates());
+    }
+}
+
+void VersionControlObserver::applyItemStates(const QVector<ItemState>& itemStates)
+{
+    // The versions are applied at once, so that the model only emits
+    // one itemsChanged() signal for all items whose version has changed.
+    QVector<IndexedVersion> indexedVersions;
+    indexedVersions.reserve(itemStates.count());
+    for (const ItemState& item : itemStates) {
+        const KFileItem& fileItem = item.first;
+        const KVersionControlPlugin::ItemVersion version = item.second;
+        if (!fileItem.isDir()) {
+            m_versionCache.insert(fileItem.localPath(), {fileItem.time(KFileItem::ModificationTime), version});
+        }
+
+        const int index = m_model->index(fileItem);
+        if (index >= 0) {
+            indexedVersions.append(qMakePair(index, version));
+        }
+    }
+
+    setModelVersions(indexedVersions);
+}
+
+void VersionControlObserver::setModelVersions(QVector<IndexedVersion>& indexedVersions)
+{
+    if (indexedVersions.isEmpty()) {
+        return;
+    }
+
+    std::stable_sort(indexedVersions.begin(), indexedVersions.end(), [](const IndexedVersion& a, const IndexedVersion& b) {
+        return a.first < b.first;
+    });
+
+    KItemRangeList itemRanges;
+    QVector<QVariant> values;
+    values.reserve(indexedVersions.count());
+    for (int i = 0; i < indexedVersions.count(); ++i) {
+        const int index = indexedVersions.at(i).first;
+        if (i > 0 && index == indexedVersions.at(i - 1).first) {
+            // The same item has been passed twice, the last version wins
+            values.last() = QVariant(indexedVersions.at(i).second);
+            continue;
+        }
+
+        if (!itemRanges.isEmpty() && itemRanges.last().index + itemRanges.last().count == index) {
+            ++itemRanges.last().count;
+        } else {
+            itemRanges.append(KItemRange(index, 1));
+        }
+        values.append(QVariant(indexedVersions.at(i).second));
+    }
+
+    m_model->setRoleValues("version", itemRanges, values);
+}
+
 void VersionControlObserver::updateItemStates()
 {
     Q_ASSERT(m_plugin);
@@ -222,21 +381,122 @@ void VersionControlObserver::updateItemStates()
 
     QMap<QString, QVector<ItemState> > itemStates;
     createItemStatesList(itemStates);
+    applyCachedItemStates(itemStates);
 
     if (!itemStates.isEmpty()) {
+        if (KIoGovernor::instance().acquire(KIoGovernor::VersionControl, m_localRepoRoot) == 0) {
+            // Other views are retrieving versions from the same mount. The
+            // retrieval is started as soon as they release their tokens.
+            m_pendingItemStatesUpdate = true;
+            return;
+        }
+        m_ioTokenPath = m_localRepoRoot;
+
         if (!m_silentUpdate) {
             Q_EMIT infoMessage(i18nc("@info:status", "Updating version information..."));
         }
-        m_updateItemStatesThread = new UpdateItemStatesThread(m_plugin, itemStates);
+        QSet<KFileItem> visibleItems;
+        if (m_view) {
+            const KFileItemList items = m_view->visibleItems();
+            visibleItems = QSet<KFileItem>(items.begin(), items.end());
+        }
+
+        m_updateItemStatesThread = new UpdateItemStatesThread(m_plugin, m_localRepoRoot, itemStates, visibleItems);
+        m_updateItemStatesThread->setLowPriority(GeneralSettings::lowPriorityVersionControl());
+        connect(m_updateItemStatesThread, &UpdateItemStatesThread::itemStatesAvailable,
+                this, &VersionControlObserver::slotItemStatesAvailable);
         connect(m_updateItemStatesThread, &UpdateItemStatesThread::finished,
                 this, &VersionControlObserver::slotThreadFinished);
         connect(m_updateItemStatesThread, &UpdateItemStatesThread::finished,
                 m_updateItemStatesThread, &UpdateItemStatesThread::deleteLater);
 
+        m_retrievalTimer.start();
         m_updateItemStatesThread->start(); // slotThreadFinished() is called when finished
     }
 }
 
+void VersionControlObserver::applyCachedItemStates(QMap<QString, QVector<ItemState> >& itemStates)
+{
+    if (m_versionCache.isEmpty()) {
+        return;
+    }
+
+    QVector<IndexedVersion> indexedVersions;
+    QMap<QString, QVector<ItemState> >::iterator it = itemStates.begin();
+    while (it != itemStates.end()) {
+        QVector<ItemState>& items = it.value();
+        QVector<ItemState> uncachedItems;
+        for (const ItemState& item : qAsConst(items)) {
+            const KFileItem& fileItem = item.first;
+            const auto cached = fileItem.isDir() ? m_versionCache.constEnd()
+                                                 : m_versionCache.constFind(fileItem.localPath());
+            if (cached == m_versionCache.constEnd()
+                || cached->modificationTime != fileItem.time(KFileItem::ModificationTime)) {
+                uncachedItems.append(item);
+                continue;
+            }
+
+            const int index = m_model->index(fileItem);
+            if (index >= 0) {
+                indexedVersions.append(qMakePair(index, cached->version));
+            }
+        }
+
+        if (uncachedItems.isEmpty()) {
+            it = itemStates.erase(it);
+        } else {
+            items = uncachedItems;
+            ++it;
+        }
+    }
+
+    // Only the items whose version differs are changed by setModelVersions()
+    setModelVersions(indexedVersions);
+}
+
+void VersionControlObserver::watchRepository()
+{
+    if (m_localRepoRoot == m_watchedRepoRoot) {
+        return;
+    }
+
+    m_versionCache.clear();
+    if (!m_watchedMetadataPath.isEmpty()) {
+        m_repositoryWatcher->removeDir(m_watchedMetadataPath);
+        m_repositoryWatcher->removeFile(m_watchedMetadataPath);
+    }
+
+    m_watchedRepoRoot = m_localRepoRoot;
+    m_watchedMetadataPath = m_localRepoRoot + QLatin1Char('/') + m_plugin->fileName();
+
+    // The metadata are changed by repository-level operations like a
+    // checkout, a commit or a rebase. Depending on the version control
+    // system, the metadata might be stored in a file instead of a folder.
+    if (QFileInfo(m_watchedMetadataPath).isDir()) {
+        m_repositoryWatcher->addDir(m_watchedMetadataPath);
+    } else {
+        m_repositoryWatcher->addFile(m_watchedMetadataPath);
+    }
+}
+
+void VersionControlObserver::slotRepositoryChanged()
+{
+    m_versionCache.clear();
+    silentDirectoryVerification();
+}
+
+void VersionControlObserver::slotRepositoryMetadataChanged()
+{
+    if (m_updateItemStatesThread
+        || (m_lastRetrieval.isValid() && m_lastRetrieval.elapsed() < RetrievalMetadataChangeInterval)) {
+        // The change has most probably been caused by the
+        // plugin, like refreshing the index of git
+        return;
+    }
+
+    slotRepositoryChanged();
+}
+
 int VersionControlObserver::createItemStatesList(QMap<QString, QVector<ItemState> >& itemStates,
                                                  const int firstIndex)
 {
@@ -275,17 +535,18 @@ int VersionControlObserver::createItemStatesList(QMap<QString, QVector<ItemState
 void VersionControlObserver::initPlugins()
 {
     if (!m_pluginsInitialized) {
-        // No searching for plugins has been done yet. Query the KServiceTypeTrader for
+        // No searching for plugins has been done yet. Query the plugin registry for
         // all fileview version control plugins and remember them in 'plugins'.
         const QStringList enabledPlugins = VersionControlSettings::enabledPlugins();
 
-        const KService::List pluginServices = KServiceTypeTrader::self()->query(QStringLiteral("FileViewVersionControlPlugin"));
+        const KService::List pluginServices = KPluginRegistry::instance().versionControlPlugins();
+        QStringList metadataFileNames;
         for (KService::List::ConstIterator it = pluginServices.constBegin(); it != pluginServices.constEnd(); ++it) {
             if (enabledPlugins.contains((*it)->name())) {
                 KVersionControlPlugin* plugin = (*it)->createInstance<KVersionControlPlugin>(this);
                 if (plugin) {
                     connect(plugin, &KVersionControlPlugin::itemVersionsChanged,
-                            this, &VersionControlObserver::silentDirectoryVerification);
+                            this, &VersionControlObserver::slotRepositoryChanged);
                     connect(plugin, &KVersionControlPlugin::infoMessage,
                             this, &VersionControlObserver::infoMessage);
                     connect(plugin, &KVersionControlPlugin::errorMessage,
@@ -294,10 +555,12 @@ void VersionControlObserver::initPlugins()
                             this, &VersionControlObserver::operationCompletedMessage);
 
                     m_plugins.append(plugin);
+                    metadataFileNames.append(plugin->fileName());
                 }
             }
         }
         m_pluginsInitialized = true;
+        RepositoryRootCache::instance().addMetadataFileNames(metadataFileNames);
     }
 }
 
@@ -305,25 +568,115 @@ KVersionControlPlugin* VersionControlObserver::searchPlugin(const QUrl& director
 {
     initPlugins();
 
-    // Verify whether the current directory is under a version system
+    const QString path = directory.path();
+    RepositoryRootCache::Entry entry;
+    bool inherited = false;
+    if (RepositoryRootCache::instance().lookup(path, entry, &inherited)) {
+        if (inherited) {
+            // The directory probably belongs to the repository of its parent,
+            // unless it contains another repository like a submodule. The
+            // discovery replaces the repository if necessary.
+            startDiscovery(path);
+        }
+
+        if (entry.fileName.isEmpty()) {
+            return nullptr;
+        }
+
+        for (const QPointer<KVersionControlPlugin> &plugin : qAsConst(m_plugins)) {
+            if (plugin && plugin->fileName() == entry.fileName) {
+                m_localRepoRoot = entry.root;
+                return plugin;
+            }
+        }
+        return nullptr;
+    }
+
+    startDiscovery(path);
+    return nullptr;
+}
+
+void VersionControlObserver::startDiscovery(const QString& path)
+{
+    if (m_discoveryWatcher->isRunning()) {
+        // The directory is verified again when the running discovery has
+        // been finished, see slotDiscoveryFinished()
+        return;
+    }
+
+    QVector<KVersionControlPlugin*> plugins;
     for (const QPointer<KVersionControlPlugin> &plugin : qAsConst(m_plugins)) {
-        if (!plugin) {
-            continue;
+        if (plugin) {
+            plugins.append(plugin);
         }
+    }
+    if (plugins.isEmpty()) {
+        return;
+    }
+
+    // The repository of the shown folder is discovered with a low priority,
+    // but it is neither held back nor queued behind the background work
+    const KTaskScheduler::ThreadPriority threadPriority = GeneralSettings::lowPriorityVersionControl() ? KTaskScheduler::LowThreadPriority
+                                                                                                       : KTaskScheduler::DefaultThreadPriority;
+    m_discoveryWatcher->setFuture(KTaskScheduler::instance().run(KTaskScheduler::Visible, threadPriority,
+                                                                 &VersionControlObserver::discoverRepository, path, plugins,
+                                                                 RepositoryRootCache::instance().metadataFileNames()));
+}
 
+VersionControlObserver::Discovery VersionControlObserver::discoverRepository(const QString& directory,
+                                                                             const QVector<KVersionControlPlugin*>& plugins,
+                                                                             const QStringList& metadataFileNames)
+{
+    Discovery discovery;
+    discovery.directory = directory;
+
+    // Verify whether the directory is under a version system
+    for (KVersionControlPlugin* plugin : plugins) {
         // first naively check if we are at working copy root
-        const QString fileName = directory.path() + '/' + plugin->fileName();
+        const QString fileName = directory + '/' + plugin->fileName();
         if (QFile::exists(fileName)) {
-            m_localRepoRoot = directory.path();
-            return plugin;
+            discovery.entry = {plugin->fileName(), directory};
+            break;
         }
-        const QString root = plugin->localRepositoryRoot(directory.path());
+
+        // Only the retrieval of reentrant plugins may run in parallel to other
+        // retrievals, see KVersionControlPlugin::localRepositoryRoot().
+        // QMutexLocker does nothing if the mutex is null.
+        QMutexLocker locker(plugin->retrievalConcurrency() != KVersionControlPlugin::ReentrantRetrieval
+                            ? UpdateItemStatesThread::serializedRetrievalMutex() : nullptr);
+        const QString root = plugin->localRepositoryRoot(directory);
         if (!root.isEmpty()) {
-            m_localRepoRoot = root;
-            return plugin;
+            discovery.entry = {plugin->fileName(), root};
+            break;
         }
     }
-    return nullptr;
+
+    // The metadata is read here, so that the main thread does not access
+    // the directories when caching the result
+    discovery.metadata = RepositoryRootCache::readMetadata(RepositoryRootCache::dependencies(directory, discovery.entry),
+                                                           metadataFileNames);
+    return discovery;
+}
+
+void VersionControlObserver::slotDiscoveryFinished()
+{
+    const Discovery discovery = m_discoveryWatcher->result();
+    RepositoryRootCache::instance().insert(discovery.directory, discovery.entry, discovery.metadata);
+
+    if (m_plugin && m_model && discovery.directory == m_model->rootItem().url().path()
+        && (discovery.entry.fileName != m_plugin->fileName() || discovery.entry.root != m_localRepoRoot)) {
+        // The repository that has been assumed for the shown directory is
+        // wrong, e.g. as the directory contains a submodule
+        m_plugin = nullptr;
+    }
+
+    // The shown directory might have been changed in the meantime,
+    // it is verified with the cached result
+    if (m_paused) {
+        m_verificationPending = true;
+    } else {
+        verifyDirectory();
+    }
 }
 
 bool VersionControlObserver::isVersionControlled() const
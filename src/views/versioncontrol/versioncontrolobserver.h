@@ -10,14 +10,20 @@
 #include "dolphin_export.h"
 
 #include "kversioncontrolplugin.h"
+#include "repositoryrootcache.h"
 
 #include <KFileItem>
 
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
 #include <QList>
 #include <QObject>
 #include <QString>
 #include <QUrl>
 
+class KDirWatch;
 class KFileItemList;
 class KFileItemModel;
 class KItemRangeList;
@@ -33,6 +39,12 @@ class DolphinView;
  * The items of the directory-model get updated automatically if the currently
  * shown directory is under version control.
  *
+ * The versions of the files are cached per repository. Only files whose
+ * modification time has been changed are passed to the plugin again. The
+ * cache is cleared if the metadata of the repository has been changed, e. g.
+ * by a checkout or a rebase, or if the plugin emits itemVersionsChanged().
+ * The versions of folders are not cached, as they depend on their contents.
+ *
  * @see VersionControlPlugin
  */
 class DOLPHIN_EXPORT VersionControlObserver : public QObject
@@ -50,6 +62,15 @@ public:
 
     QList<QAction*> actions(const KFileItemList& items) const;
 
+    /**
+     * If \a paused is true, the directory is not verified and no versions
+     * are retrieved, e.g. because the view is part of an inactive tab. The
+     * changes in the meantime only result in one verification when the
+     * observer is resumed.
+     */
+    void setPaused(bool paused);
+    bool isPaused() const;
+
 Q_SIGNALS:
     /**
      * Is emitted if an information message with the content \a msg
@@ -99,11 +120,72 @@ private Q_SLOTS:
      */
     void slotThreadFinished();
 
+    /**
+     * Applies the item states that have been retrieved by the running
+     * thread m_updateItemStatesThread so far.
+     */
+    void slotItemStatesAvailable();
+
+    /**
+     * Clears the cached versions and verifies the directory silently. Is
+     * invoked if the plugin reports changed versions or if the metadata of
+     * the repository has been changed.
+     */
+    void slotRepositoryChanged();
+
+    /**
+     * Invokes slotRepositoryChanged() if the change of the metadata of the
+     * repository has not been caused by the plugin itself.
+     */
+    void slotRepositoryMetadataChanged();
+
+    /**
+     * Caches the result of the discovery that has been started by
+     * searchPlugin() and verifies the directory again.
+     */
+    void slotDiscoveryFinished();
+
 private:
+    struct Discovery
+    {
+        QString directory;
+        RepositoryRootCache::Entry entry;
+        RepositoryRootCache::Metadata metadata;
+    };
+
     typedef QPair<KFileItem, KVersionControlPlugin::ItemVersion> ItemState;
+    typedef QPair<int, KVersionControlPlugin::ItemVersion> IndexedVersion;
 
     void updateItemStates();
 
+    /**
+     * Applies the cached versions of the files in \a itemStates to the model
+     * and removes them from \a itemStates. Only the versions of files whose
+     * modification time has not been changed since they have been cached are
+     * applied.
+     */
+    void applyCachedItemStates(QMap<QString, QVector<ItemState> >& itemStates);
+
+    /**
+     * Sets the versions of \a itemStates as "version" role of the
+     * model and stores them in the cache.
+     */
+    void applyItemStates(const QVector<ItemState>& itemStates);
+
+    /**
+     * Sets the versions of the items with the indexes of \a indexedVersions
+     * as "version" role of the model at once, so that itemsChanged() is only
+     * emitted once for the items whose version has been changed. The
+     * versions are sorted by their indexes.
+     */
+    void setModelVersions(QVector<IndexedVersion>& indexedVersions);
+
+    /**
+     * Watches the metadata of the repository m_localRepoRoot. The cached
+     * versions are cleared if the repository root has been changed.
+     */
+    void watchRepository();
+
     /**
      * It creates a item state list for every expanded directory and stores
      * this list together with the directory url in the \a itemStates map.
@@ -123,9 +205,29 @@ private:
     /**
      * Returns a matching plugin for the given directory.
      * 0 is returned, if no matching plugin has been found.
+     *
+     * The result is taken from RepositoryRootCache. If the directory is not
+     * cached yet, the repository is discovered in a worker thread and 0 is
+     * returned, see slotDiscoveryFinished(). As long as the discovery is
+     * running, neither the actions for versioned nor the ones for unversioned
+     * directories are offered.
      */
     KVersionControlPlugin* searchPlugin(const QUrl& directory);
 
+    /**
+     * Starts discovering the repository of the local path \a path,
+     * unless a discovery is running already.
+     */
+    void startDiscovery(const QString& path);
+
+    /**
+     * Asks \a plugins whether the local path \a directory is under version
+     * control and reads the metadata \a metadataFileNames that the result depends
+     * on, see RepositoryRootCache::insert(). Is invoked in a worker thread.
+     */
+    static Discovery discoverRepository(const QString& directory, const QVector<KVersionControlPlugin*>& plugins,
+                                        const QStringList& metadataFileNames);
+
     /**
      * Returns true, if the directory contains a version control information.
      */
@@ -143,12 +245,32 @@ private:
     KFileItemModel* m_model;
 
     QTimer* m_dirVerificationTimer;
+    bool m_paused;
+    bool m_verificationPending; // Is set if a verification has been requested while paused
 
     bool m_pluginsInitialized;
     KVersionControlPlugin* m_plugin;
     QList<QPointer<KVersionControlPlugin>> m_plugins;
     UpdateItemStatesThread* m_updateItemStatesThread;
 
+    struct CachedVersion
+    {
+        QDateTime modificationTime;
+        KVersionControlPlugin::ItemVersion version;
+    };
+
+    // Versions of the files of the repository m_watchedRepoRoot, the
+    // keys are the local paths
+    QHash<QString, CachedVersion> m_versionCache;
+    QString m_watchedRepoRoot;
+    QString m_watchedMetadataPath;
+    KDirWatch* m_repositoryWatcher;
+    QElapsedTimer m_lastRetrieval; // Is restarted when a retrieval has been finished
+    QElapsedTimer m_retrievalTimer; // Is started when a retrieval is started, for KItemListMetrics
+    QString m_ioTokenPath; // Path the token of KIoGovernor has been acquired for by the running thread
+
+    QFutureWatcher<Discovery>* m_discoveryWatcher;
+
     friend class UpdateItemStatesThread;
 };
 
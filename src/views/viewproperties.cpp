@@ -10,10 +10,13 @@
 #include "dolphin_directoryviewpropertysettings.h"
 #include "dolphin_generalsettings.h"
 #include "dolphindebug.h"
+#include "viewpropertiesstore.h"
 
+#include <QCache>
 #include <QCryptographicHash>
+#include <QElapsedTimer>
 
-#include <KFileItem>
+#include <KConfigGroup>
 
 namespace {
     const int AdditionalInfoViewPropertiesVersion = 1;
@@ -26,13 +29,173 @@ namespace {
     // ViewProperties::visibleRoles() for more information.
     const char CustomizedDetailsString[] = "CustomizedDetails";
 
-    // Filename that is used for storing the properties
+    // Filename that has been used for storing the properties before
+    // the ViewPropertiesStore has been introduced
     const char ViewPropertiesFileName[] = ".directory";
+
+    // Groups of the view properties inside the .directory files. The files
+    // inside the viewed directories may contain other groups, e.g. the icon
+    // of the directory, which must be kept.
+    const char* const LegacyPropertiesGroups[] = {"Dolphin", "Settings"};
+
+    // Maximum number of keys that are remembered to have no .directory
+    // file, and the time in ms after which the files are checked again
+    const int MaxKeysWithoutLegacyProperties = 1000;
+    const int LegacyPropertiesCheckInterval = 60 * 1000;
+}
+
+// Keys of directories for which no .directory file is available,
+// so that they are not checked again when entering the directory
+// another time within LegacyPropertiesCheckInterval.
+typedef QCache<QString, QElapsedTimer> CheckedKeysCache;
+Q_GLOBAL_STATIC_WITH_ARGS(CheckedKeysCache, s_keysWithoutLegacyProperties, (MaxKeysWithoutLegacyProperties))
+
+namespace {
+    /**
+     * The configuration from which the ViewPropertySettings instances read
+     * their values and to which they write them. It is not backed by a file,
+     * the values are copied from and to the ViewPropertiesStore and removed
+     * again afterwards, so it can be shared by all ViewProperties instances.
+     * It must only be accessed within a PropertiesConfigScope.
+     */
+    KSharedConfig::Ptr propertiesConfig()
+    {
+        return KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    }
+
+    void clearProperties(KConfig* config)
+    {
+        const QStringList groups = config->groupList();
+        for (const QString& group : groups) {
+            config->deleteGroup(group);
+        }
+    }
+
+    void writeProperties(KConfig* config, const ViewPropertiesStore::Properties& properties)
+    {
+        clearProperties(config);
+        for (auto it = properties.constBegin(); it != properties.constEnd(); ++it) {
+            KConfigGroup group(config, it.key());
+            const QMap<QString, QString>& entries = it.value();
+            for (auto entryIt = entries.constBegin(); entryIt != entries.constEnd(); ++entryIt) {
+                group.writeEntry(entryIt.key(), entryIt.value());
+            }
+        }
+    }
+
+    ViewPropertiesStore::Properties readProperties(const KConfig* config)
+    {
+        ViewPropertiesStore::Properties properties;
+        const QStringList groups = config->groupList();
+        for (const QString& group : groups) {
+            properties.insert(group, config->group(group).entryMap());
+        }
+        return properties;
+    }
+
+    /**
+     * Provides the values of \a properties by the shared configuration as
+     * long as the scope exists, afterwards the configuration is empty again.
+     * If the scopes are nested, the values of the outer scope are restored.
+     */
+    class PropertiesConfigScope
+    {
+    public:
+        explicit PropertiesConfigScope(const ViewPropertiesStore::Properties& properties) :
+            m_config(propertiesConfig()),
+            m_outerProperties(readProperties(m_config.data()))
+        {
+            writeProperties(m_config.data(), properties);
+        }
+
+        ~PropertiesConfigScope()
+        {
+            writeProperties(m_config.data(), m_outerProperties);
+        }
+
+        KSharedConfig::Ptr config() const
+        {
+            return m_config;
+        }
+
+    private:
+        KSharedConfig::Ptr m_config;
+        ViewPropertiesStore::Properties m_outerProperties;
+
+        Q_DISABLE_COPY(PropertiesConfigScope)
+    };
+
+    /**
+     * Reads the properties for \a key from the ViewPropertiesStore. If none are
+     * stored, the .directory files inside \a legacyDirs are read. The path of
+     * the read file is assigned to \a legacyFile, the properties are moved to
+     * the store when they are saved.
+     * @return True if properties are available.
+     */
+    bool loadProperties(const QString& key, const QStringList& legacyDirs,
+                        ViewPropertiesStore::Properties& properties, QString& legacyFile)
+    {
+        if (ViewPropertiesStore::instance().find(key, properties)) {
+            return true;
+        }
+
+        const QElapsedTimer* checked = s_keysWithoutLegacyProperties->object(key);
+        if (checked && !checked->hasExpired(LegacyPropertiesCheckInterval)) {
+            return false;
+        }
+
+        for (const QString& dir : legacyDirs) {
+            const QString file = dir + QDir::separator() + ViewPropertiesFileName;
+            if (QFile::exists(file)) {
+                const KConfig legacyConfig(file, KConfig::SimpleConfig);
+                for (const char* group : LegacyPropertiesGroups) {
+                    if (legacyConfig.hasGroup(group)) {
+                        properties.insert(QLatin1String(group), legacyConfig.group(group).entryMap());
+                    }
+                }
+                if (!properties.isEmpty()) {
+                    s_keysWithoutLegacyProperties->remove(key);
+                    legacyFile = file;
+                    return true;
+                }
+            }
+        }
+
+        QElapsedTimer* timer = new QElapsedTimer();
+        timer->start();
+        s_keysWithoutLegacyProperties->insert(key, timer);
+        return false;
+    }
+
+    /**
+     * Removes the view properties from the .directory file \a file. The file
+     * is removed if it does not contain anything else.
+     */
+    void removeLegacyProperties(const QString& file)
+    {
+        {
+            KConfig legacyConfig(file, KConfig::SimpleConfig);
+            for (const char* group : LegacyPropertiesGroups) {
+                legacyConfig.deleteGroup(group);
+            }
+            if (!legacyConfig.groupList().isEmpty()) {
+                legacyConfig.sync();
+                return;
+            }
+        }
+
+        if (!QFile::remove(file)) {
+            qCWarning(DolphinDebug) << "Cannot remove" << file;
+        }
+    }
 }
 
 ViewProperties::ViewProperties(const QUrl& url) :
     m_changedProps(false),
     m_autoSave(true),
+    m_key(storeKey(url)),
+    m_storedProperties(),
+    m_legacyFile(),
     m_node(nullptr)
 {
     GeneralSettings* settings = GeneralSettings::self();
@@ -41,57 +204,53 @@ ViewProperties::ViewProperties(const QUrl& url) :
     bool useRecentDocumentsView = false;
     bool useDownloadsView = false;
 
-    // We try and save it to the file .directory in the directory being viewed.
-    // If the directory is not writable by the user or the directory is not local,
-    // we store the properties information in a local file.
+    // The properties of all directories are kept by the ViewPropertiesStore.
+    // Previously they have been stored in the file .directory inside the
+    // directory being viewed, or inside a local directory if the directory is not
+    // writable by the user or not local. These files are only read if the
+    // store does not contain the properties yet.
+    QStringList legacyDirs;
     if (useGlobalViewProps) {
-        m_filePath = destinationDir(QStringLiteral("global"));
+        legacyDirs.append(destinationDir(QStringLiteral("global")));
     } else if (url.scheme().contains(QLatin1String("search"))) {
-        m_filePath = destinationDir(QStringLiteral("search/")) + directoryHashForUrl(url);
+        legacyDirs.append(destinationDir(QStringLiteral("search/")) + directoryHashForUrl(url));
         useDetailsViewWithPath = true;
     } else if (url.scheme() == QLatin1String("trash")) {
-        m_filePath = destinationDir(QStringLiteral("trash"));
+        legacyDirs.append(destinationDir(QStringLiteral("trash")));
         useDetailsViewWithPath = true;
     } else if (url.scheme() == QLatin1String("recentdocuments")) {
-        m_filePath = destinationDir(QStringLiteral("recentdocuments"));
+        legacyDirs.append(destinationDir(QStringLiteral("recentdocuments")));
         useRecentDocumentsView = true;
     } else if (url.isLocalFile()) {
-        m_filePath = url.toLocalFile();
-
-        bool useDestinationDir = !isPartOfHome(m_filePath);
-        if (!useDestinationDir) {
-            const KFileItem fileItem(url);
-            useDestinationDir = fileItem.isSlow();
+        QString filePath = url.toLocalFile();
+        if (isPartOfHome(filePath)) {
+            legacyDirs.append(filePath);
         }
 
-        if (!useDestinationDir) {
-            const QFileInfo dirInfo(m_filePath);
-            const QFileInfo fileInfo(m_filePath + QDir::separator() + ViewPropertiesFileName);
-            useDestinationDir = !dirInfo.isWritable() || (dirInfo.size() > 0 && fileInfo.exists() && !(fileInfo.isReadable() && fileInfo.isWritable()));
+        if (filePath == QStandardPaths::writableLocation(QStandardPaths::DownloadLocation)) {
+            useDownloadsView = true;
         }
 
-        if (useDestinationDir) {
     #ifdef Q_OS_WIN
-            // m_filePath probably begins with C:/ - the colon is not a valid character for paths though
-            m_filePath =  QDir::separator() + m_filePath.remove(QLatin1Char(':'));
+        // filePath probably begins with C:/ - the colon is not a valid character for paths though
+        filePath = QDir::separator() + filePath.remove(QLatin1Char(':'));
     #endif
-            m_filePath = destinationDir(QStringLiteral("local")) + m_filePath;
-        }
-
-        if (m_filePath == QStandardPaths::writableLocation(QStandardPaths::DownloadLocation)) {
-            useDownloadsView = true;
-        }
+        legacyDirs.append(destinationDir(QStringLiteral("local")) + filePath);
     } else {
-        m_filePath = destinationDir(QStringLiteral("remote")) + m_filePath;
+        legacyDirs.append(destinationDir(QStringLiteral("remote")));
     }
 
-    const QString file = m_filePath + QDir::separator() + ViewPropertiesFileName;
-    m_node = new ViewPropertySettings(KSharedConfig::openConfig(file));
+    const bool propertiesAvailable = loadProperties(m_key, legacyDirs, m_storedProperties, m_legacyFile);
+
+    {
+        const PropertiesConfigScope scope(m_storedProperties);
+        m_node = new ViewPropertySettings(scope.config());
+    }
 
-    // If the .directory file does not exist or the timestamp is too old,
+    // If no properties are stored or the timestamp is too old,
     // use default values instead.
     const bool useDefaultProps = (!useGlobalViewProps || useDetailsViewWithPath) &&
-                                 (!QFile::exists(file) ||
+                                 (!propertiesAvailable ||
                                   (m_node->timestamp() < settings->viewPropsTimestamp()));
     if (useDefaultProps) {
         if (useDetailsViewWithPath) {
@@ -376,18 +535,56 @@ void ViewProperties::update()
 
 void ViewProperties::save()
 {
-    qCDebug(DolphinDebug) << "Saving view-properties to" << m_filePath;
-    QDir dir;
-    dir.mkpath(m_filePath);
-    m_node->setVersion(CurrentViewPropertiesVersion);
-    m_node->save();
+    qCDebug(DolphinDebug) << "Saving view-properties for" << m_key;
+    updateStoredProperties();
+    if (ViewPropertiesStore::instance().insert(m_key, m_storedProperties) && !m_legacyFile.isEmpty()) {
+        // The properties have been moved to the store
+        removeLegacyProperties(m_legacyFile);
+        m_legacyFile.clear();
+    }
     m_changedProps = false;
 }
 
+void ViewProperties::saveToDirectories(const QList<QUrl>& urls)
+{
+    updateStoredProperties();
+
+    QVector<QPair<QString, ViewPropertiesStore::Properties>> entries;
+    entries.reserve(urls.count());
+    for (const QUrl& url : urls) {
+        entries.append(qMakePair(storeKey(url), m_storedProperties));
+    }
+    ViewPropertiesStore::instance().insert(entries);
+}
+
 bool ViewProperties::exist() const
 {
-    const QString file = m_filePath + QDir::separator() + ViewPropertiesFileName;
-    return QFile::exists(file);
+    return !m_legacyFile.isEmpty() || ViewPropertiesStore::instance().contains(m_key);
+}
+
+QString ViewProperties::storeKey(const QUrl& url)
+{
+    if (GeneralSettings::globalViewProps() || url.isEmpty()) {
+        return QStringLiteral("global");
+    } else if (url.scheme().contains(QLatin1String("search"))) {
+        return QLatin1String("search/") + directoryHashForUrl(url);
+    } else if (url.scheme() == QLatin1String("trash")) {
+        return QStringLiteral("trash");
+    } else if (url.scheme() == QLatin1String("recentdocuments")) {
+        return QStringLiteral("recentdocuments");
+    }
+    return directoryHashForUrl(url.adjusted(QUrl::StripTrailingSlash));
+}
+
+void ViewProperties::updateStoredProperties()
+{
+    // The settings only write the values that have been changed since they have
+    // been read, so the stored values must be available in the configuration.
+    const PropertiesConfigScope scope(m_storedProperties);
+    Q_ASSERT(scope.config() == m_node->sharedConfig());
+    m_node->setVersion(CurrentViewPropertiesVersion);
+    m_node->save();
+    m_storedProperties = readProperties(scope.config().data());
 }
 
 QString ViewProperties::destinationDir(const QString& subDir) const
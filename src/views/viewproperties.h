@@ -10,6 +10,7 @@
 
 #include "dolphin_export.h"
 #include "views/dolphinview.h"
+#include "views/viewpropertiesstore.h"
 
 #include <QUrl>
 
@@ -18,8 +19,9 @@ class ViewPropertySettings;
  * @brief Maintains the view properties like 'view mode' or
  *        'show hidden files' for a directory.
  *
- * The view properties are automatically stored as part of the file
- * .directory inside the corresponding path. To read out the view properties
+ * The view properties are automatically stored by the ViewPropertiesStore,
+ * which has replaced the .directory files inside the corresponding
+ * paths. Existing .directory files are still read once. To read out the view properties
  * just construct an instance by passing the path of the directory:
  *
  * \code
@@ -28,11 +30,11 @@ class ViewPropertySettings;
  * const bool hiddenFilesShown = props.hiddenFilesShown();
  * \endcode
  *
- * When modifying a view property, the '.directory' file is automatically updated
- * inside the destructor.
+ * When modifying a view property, the stored properties are automatically
+ * updated inside the destructor.
  *
- * If no .directory file is available or the global view mode is turned on
- * (see GeneralSettings::globalViewMode()), the values from the global .directory file
+ * If no properties are stored for the directory or the global view mode is turned on
+ * (see GeneralSettings::globalViewMode()), the global view properties
  * are used for initialization.
  */
 class DOLPHIN_EXPORT ViewProperties
@@ -105,6 +107,13 @@ public:
      */
     void save();
 
+    /**
+     * Saves the view properties as the properties of the directories \a urls.
+     * In contrast to creating a ViewProperties instance for each directory,
+     * the properties of all directories are written at once.
+     */
+    void saveToDirectories(const QList<QUrl>& urls);
+
     /**
      * @return True if properties for the given URL exist:
      *         As soon as the properties for an URL have been saved with
@@ -113,7 +122,23 @@ public:
      */
     bool exist() const;
 
+    /**
+     * @return A hash-value for an URL that can be used as directory name.
+     *         Is used to be able to remember view-properties for long baloo-URLs.
+     */
+    static QString directoryHashForUrl(const QUrl &url);
+
 private:
+    /**
+     * @return The key of the properties for \a url in the ViewPropertiesStore.
+     */
+    static QString storeKey(const QUrl& url);
+
+    /**
+     * Writes the current values into m_storedProperties.
+     */
+    void updateStoredProperties();
+
     /**
      * Returns the destination directory path where the view
      * properties are stored. \a subDir specifies the used sub
@@ -152,18 +177,15 @@ private:
      */
     static bool isPartOfHome(const QString& filePath);
 
-    /**
-     * @return A hash-value for an URL that can be used as directory name.
-     *         Is used to be able to remember view-properties for long baloo-URLs.
-     */
-    static QString directoryHashForUrl(const QUrl &url);
 
     Q_DISABLE_COPY(ViewProperties)
 
 private:
     bool m_changedProps;
     bool m_autoSave;
-    QString m_filePath;
+    QString m_key;
+    ViewPropertiesStore::Properties m_storedProperties;
+    QString m_legacyFile;   // .directory file that has been read, until the properties are saved
     ViewPropertySettings* m_node;
 };
 
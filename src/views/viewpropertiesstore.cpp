@@ -0,0 +1,386 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "viewpropertiesstore.h"
+
+#include "dolphindebug.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+
+#include <algorithm>
+
+namespace {
+    const char StoreFileName[] = "viewproperties.store";
+
+    // The file starts with a header that contains the magic number, the
+    // format version and the generation, which is increased whenever the
+    // file is rewritten.
+    const quint32 StoreMagic = 0x44565053; // "DVPS"
+    const quint32 StoreFormatVersion = 1;
+    const int HeaderSize = 16;
+
+    // Each entry consists of the size of the key, the size of the value,
+    // the UTF-8 encoded key and the value.
+    const int RecordHeaderSize = 8;
+    const quint32 MaximumKeySize = 4096;
+    const quint32 MaximumValueSize = 1024 * 1024;
+
+    const int MaxCachedProperties = 256;
+    const int StoreRefreshInterval = 2000;
+    const qint64 CompactionMinimumGarbageSize = 1024 * 1024;
+
+    // Maximum number of stored keys. Each visited folder adds up to two
+    // keys (the view properties and the load profile), so the file would
+    // grow without limit otherwise.
+    const int MaximumEntryCount = 20000;
+
+    void appendHeader(QByteArray& data, quint32 generation)
+    {
+        uchar header[HeaderSize];
+        qToBigEndian<quint32>(StoreMagic, header);
+        qToBigEndian<quint32>(StoreFormatVersion, header + 4);
+        qToBigEndian<quint32>(generation, header + 8);
+        qToBigEndian<quint32>(0, header + 12);
+        data.append(reinterpret_cast<const char*>(header), HeaderSize);
+    }
+
+    bool readHeader(const QByteArray& data, quint32* generation)
+    {
+        if (data.size() < HeaderSize) {
+            return false;
+        }
+
+        const uchar* header = reinterpret_cast<const uchar*>(data.constData());
+        if (qFromBigEndian<quint32>(header) != StoreMagic
+            || qFromBigEndian<quint32>(header + 4) != StoreFormatVersion) {
+            return false;
+        }
+
+        *generation = qFromBigEndian<quint32>(header + 8);
+        return true;
+    }
+
+    void appendRecord(QByteArray& data, const QString& key, const QByteArray& value)
+    {
+        const QByteArray encodedKey = key.toUtf8();
+        uchar header[RecordHeaderSize];
+        qToBigEndian<quint32>(encodedKey.size(), header);
+        qToBigEndian<quint32>(value.size(), header + 4);
+        data.append(reinterpret_cast<const char*>(header), RecordHeaderSize);
+        data.append(encodedKey);
+        data.append(value);
+    }
+}
+
+struct ViewPropertiesStoreSingleton
+{
+    ViewPropertiesStore instance;
+};
+Q_GLOBAL_STATIC(ViewPropertiesStoreSingleton, s_viewPropertiesStore)
+
+
+ViewPropertiesStore& ViewPropertiesStore::instance()
+{
+    return s_viewPropertiesStore->instance;
+}
+
+ViewPropertiesStore::ViewPropertiesStore() :
+    m_filePath(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+               + QLatin1String("/view_properties/") + QLatin1String(StoreFileName)),
+    m_file(),
+    m_map(nullptr),
+    m_mappedSize(0),
+    m_size(0),
+    m_generation(0),
+    m_garbageSize(0),
+    m_opened(false),
+    m_refreshTimer(),
+    m_index(),
+    m_cache(MaxCachedProperties)
+{
+}
+
+ViewPropertiesStore::~ViewPropertiesStore()
+{
+    closeFile();
+}
+
+bool ViewPropertiesStore::contains(const QString& key)
+{
+    if (!m_opened || m_refreshTimer.hasExpired(StoreRefreshInterval)) {
+        refresh();
+    }
+
+    return m_index.contains(key) || m_cache.contains(key);
+}
+
+bool ViewPropertiesStore::find(const QString& key, Properties& properties)
+{
+    if (!m_opened || m_refreshTimer.hasExpired(StoreRefreshInterval)) {
+        refresh();
+    }
+
+    if (const Properties* cachedProperties = m_cache.object(key)) {
+        properties = *cachedProperties;
+        return true;
+    }
+
+    const auto it = m_index.constFind(key);
+    if (it == m_index.constEnd()) {
+        return false;
+    }
+
+    const uchar* data = mappedData(it->offset, it->size);
+    if (!data) {
+        return false;
+    }
+
+    const QByteArray value = QByteArray::fromRawData(reinterpret_cast<const char*>(data), it->size);
+    QDataStream stream(value);
+    stream.setVersion(QDataStream::Qt_5_0);
+    Properties decodedProperties;
+    stream >> decodedProperties;
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(DolphinDebug) << "Invalid view properties in" << m_filePath;
+        return false;
+    }
+
+    m_cache.insert(key, new Properties(decodedProperties));
+    properties = decodedProperties;
+    return true;
+}
+
+bool ViewPropertiesStore::insert(const QString& key, const Properties& properties)
+{
+    if (!insert({qMakePair(key, properties)})) {
+        return false;
+    }
+
+    m_cache.insert(key, new Properties(properties));
+    return true;
+}
+
+bool ViewPropertiesStore::insert(const QVector<QPair<QString, Properties>>& entries)
+{
+    if (entries.isEmpty()) {
+        return true;
+    }
+
+    // Usually all entries share the same properties, which
+    // need to be encoded only once in this case.
+    QVector<QPair<QString, QByteArray>> encodedEntries;
+    encodedEntries.reserve(entries.count());
+    const Properties* previousProperties = nullptr;
+    QByteArray value;
+    for (const auto& entry : entries) {
+        if (!previousProperties || entry.second != *previousProperties) {
+            value.clear();
+            QDataStream stream(&value, QIODevice::WriteOnly);
+            stream.setVersion(QDataStream::Qt_5_0);
+            stream << entry.second;
+            previousProperties = &entry.second;
+        }
+        encodedEntries.append(qMakePair(entry.first, value));
+    }
+
+    QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+    QLockFile lock(m_filePath + QLatin1String(".lock"));
+    if (!lock.lock()) {
+        // Writing without the lock might interleave the entries with
+        // the ones of another process and corrupt the file
+        qCWarning(DolphinDebug) << "Cannot lock" << m_filePath << lock.error();
+        return false;
+    }
+
+    refresh();
+    if (!appendRecords(encodedEntries)) {
+        qCWarning(DolphinDebug) << "Cannot write the view properties to" << m_filePath;
+        return false;
+    }
+
+    // Adds the written entries to the index
+    refresh();
+    compactIfNeeded();
+    return true;
+}
+
+QString ViewPropertiesStore::filePath() const
+{
+    return m_filePath;
+}
+
+void ViewPropertiesStore::refresh()
+{
+    m_opened = true;
+    m_refreshTimer.start();
+
+    QFile file(m_filePath);
+    quint32 generation = 0;
+    if (!file.open(QIODevice::ReadOnly) || !readHeader(file.read(HeaderSize), &generation)) {
+        closeFile();
+        m_index.clear();
+        m_cache.clear();
+        m_size = 0;
+        m_garbageSize = 0;
+        return;
+    }
+
+    const qint64 size = file.size();
+    const bool sameFile = m_file.isOpen() && (generation == m_generation) && (size >= m_size);
+    if (sameFile && size == m_size) {
+        return;
+    }
+    file.close();
+
+    closeFile();
+    m_file.setFileName(m_filePath);
+    if (m_file.open(QIODevice::ReadOnly)) {
+        m_map = m_file.map(0, size);
+        m_mappedSize = m_map ? size : 0;
+    }
+
+    if (sameFile) {
+        readRecords(m_size);
+    } else {
+        m_index.clear();
+        m_cache.clear();
+        m_garbageSize = 0;
+        m_generation = generation;
+        readRecords(HeaderSize);
+    }
+}
+
+void ViewPropertiesStore::readRecords(qint64 offset)
+{
+    qint64 pos = offset;
+    while (const uchar* header = mappedData(pos, RecordHeaderSize)) {
+        const quint32 keySize = qFromBigEndian<quint32>(header);
+        const quint32 valueSize = qFromBigEndian<quint32>(header + 4);
+        if (keySize == 0 || keySize > MaximumKeySize || valueSize > MaximumValueSize) {
+            break;
+        }
+
+        // An incomplete entry is ignored, it is either being written
+        // by another process or the writing has been interrupted.
+        const uchar* data = mappedData(pos + RecordHeaderSize, keySize + valueSize);
+        if (!data) {
+            break;
+        }
+
+        const QString key = QString::fromUtf8(reinterpret_cast<const char*>(data), keySize);
+        Record record;
+        record.offset = pos + RecordHeaderSize + keySize;
+        record.size = valueSize;
+
+        auto it = m_index.find(key);
+        if (it == m_index.end()) {
+            m_index.insert(key, record);
+        } else {
+            m_garbageSize += RecordHeaderSize + keySize + it->size;
+            *it = record;
+            m_cache.remove(key);
+        }
+
+        pos += RecordHeaderSize + keySize + valueSize;
+    }
+
+    m_size = qMax(pos, qint64(HeaderSize));
+}
+
+bool ViewPropertiesStore::appendRecords(const QVector<QPair<QString, QByteArray>>& entries)
+{
+    if (m_file.isOpen() && !m_map) {
+        return false;
+    }
+
+    QByteArray data;
+    QFile file(m_filePath);
+    if (m_file.isOpen()) {
+        if (!file.open(QIODevice::ReadWrite)) {
+            return false;
+        }
+        // Remove an incomplete entry that has been left by an interrupted write
+        if (file.size() > m_size && !file.resize(m_size)) {
+            return false;
+        }
+        file.seek(m_size);
+    } else {
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            return false;
+        }
+        appendHeader(data, m_generation + 1);
+    }
+
+    for (const auto& entry : entries) {
+        appendRecord(data, entry.first, entry.second);
+    }
+
+    return file.write(data) == data.size();
+}
+
+void ViewPropertiesStore::compactIfNeeded()
+{
+    const qint64 usedSize = m_size - HeaderSize - m_garbageSize;
+    const bool tooMuchGarbage = (m_garbageSize >= CompactionMinimumGarbageSize && m_garbageSize >= usedSize);
+    if (!tooMuchGarbage && m_index.count() <= MaximumEntryCount) {
+        return;
+    }
+
+    // The entries are written in the order in which they have been written
+    // before, so that the least recently written keys stay at the start.
+    QVector<QPair<qint64, QString>> keys;
+    keys.reserve(m_index.count());
+    for (auto it = m_index.constBegin(); it != m_index.constEnd(); ++it) {
+        keys.append(qMakePair(it->offset, it.key()));
+    }
+    std::sort(keys.begin(), keys.end());
+    if (keys.count() > MaximumEntryCount) {
+        keys.remove(0, keys.count() - MaximumEntryCount);
+    }
+
+    QByteArray data;
+    data.reserve(HeaderSize + usedSize);
+    appendHeader(data, m_generation + 1);
+    for (const auto& key : qAsConst(keys)) {
+        const Record record = m_index.value(key.second);
+        const uchar* value = mappedData(record.offset, record.size);
+        if (value) {
+            appendRecord(data, key.second, QByteArray::fromRawData(reinterpret_cast<const char*>(value), record.size));
+        }
+    }
+
+    QSaveFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qCWarning(DolphinDebug) << "Cannot compact" << m_filePath;
+        return;
+    }
+
+    refresh();
+}
+
+const uchar* ViewPropertiesStore::mappedData(qint64 offset, qint64 size)
+{
+    if (!m_map || offset < 0 || size < 0 || offset + size > m_mappedSize) {
+        return nullptr;
+    }
+    return m_map + offset;
+}
+
+void ViewPropertiesStore::closeFile()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+    m_mappedSize = 0;
+    m_file.close();
+}
@@ -0,0 +1,148 @@
+/*
+ * SPDX-FileCopyrightText: 2021 agent <agent@local>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef VIEWPROPERTIESSTORE_H
+#define VIEWPROPERTIESSTORE_H
+
+#include "dolphin_export.h"
+
+#include <QCache>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Stores the view properties of all directories in one file.
+ *
+ * Reading the view properties from a .directory file inside each directory
+ * requires several file system operations whenever a directory is entered,
+ * which is especially expensive for network shares. Instead the properties
+ * of all directories are stored in a single file, which is mapped into
+ * memory. Each entry is identified by a key like the hash of the directory
+ * URL (see ViewProperties::directoryHashForUrl()).
+ *
+ * The file is only appended to: An index from the keys to the positions of
+ * the latest entries is built once when the file is read the first time,
+ * and superseded entries are removed when they take up more space than the
+ * current ones. If more than MaximumEntryCount keys are stored, the keys
+ * that have been written least recently are removed at the same time. The
+ * decoded properties of the recently used keys are kept in memory.
+ *
+ * Several Dolphin processes may use the store at the same time, writing is
+ * serialized by a lock file. Entries that have been written by other
+ * processes are recognized when writing or after StoreRefreshInterval.
+ */
+class DOLPHIN_EXPORT ViewPropertiesStore
+{
+public:
+    /**
+     * The entries of the groups of a view properties configuration,
+     * as provided by KConfigGroup::entryMap(). The keys are the group names.
+     */
+    typedef QMap<QString, QMap<QString, QString>> Properties;
+
+    static ViewPropertiesStore& instance();
+    virtual ~ViewPropertiesStore();
+
+    /**
+     * @return True if properties are stored for \a key.
+     */
+    bool contains(const QString& key);
+
+    /**
+     * Reads the properties that are stored for \a key into \a properties.
+     * @return True if properties are stored for \a key.
+     */
+    bool find(const QString& key, Properties& properties);
+
+    /**
+     * Stores \a properties for \a key. The properties are written immediately.
+     * @return True if the properties have been written.
+     */
+    bool insert(const QString& key, const Properties& properties);
+
+    /**
+     * Stores the properties of all \a entries at once, which is considerably
+     * faster than storing them one by one. The properties are not kept
+     * in the memory cache.
+     * @return True if the properties have been written.
+     */
+    bool insert(const QVector<QPair<QString, Properties>>& entries);
+
+    /**
+     * @return Path of the file that contains the view properties.
+     */
+    QString filePath() const;
+
+protected:
+    ViewPropertiesStore();
+
+private:
+    struct Record
+    {
+        qint64 offset = 0; // Position of the encoded properties
+        quint32 size = 0;
+    };
+
+    /**
+     * Opens the file and updates the index by the entries that have been
+     * written since the last update. If the file has been rewritten by
+     * another process, the index is rebuilt.
+     */
+    void refresh();
+
+    /**
+     * Adds the entries starting at \a offset to the index. Afterwards
+     * m_size points behind the last complete entry.
+     */
+    void readRecords(qint64 offset);
+
+    /**
+     * Appends the encoded \a entries to the file. Must be called while the
+     * lock file is held.
+     */
+    bool appendRecords(const QVector<QPair<QString, QByteArray>>& entries);
+
+    /**
+     * Rewrites the file with the current entries only, if the superseded
+     * entries take up too much space or if too many keys are stored. Only
+     * the MaximumEntryCount keys that have been written most recently are
+     * kept. Must be called while the lock file is held.
+     */
+    void compactIfNeeded();
+
+    /**
+     * @return Pointer to the mapped data at \a offset, which provides at
+     *         least \a size bytes, or nullptr.
+     */
+    const uchar* mappedData(qint64 offset, qint64 size);
+
+    void closeFile();
+
+private:
+    QString m_filePath;
+    QFile m_file;
+    uchar* m_map;
+    qint64 m_mappedSize;
+
+    // Size of the part of the file that is covered by the index
+    qint64 m_size;
+    quint32 m_generation;
+    qint64 m_garbageSize;
+    bool m_opened;
+    QElapsedTimer m_refreshTimer;
+
+    QHash<QString, Record> m_index;
+    QCache<QString, Properties> m_cache;
+
+    friend struct ViewPropertiesStoreSingleton;
+};
+
+#endif